@@ -0,0 +1,798 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+/*
+ * Microbenchmarks of the core primitives, built with
+ *
+ *     make -f misc/GNUmakefile bench
+ *
+ * Each benchmark runs a fixed number of operations on fixed input several
+ * times, and one JSON object per line is written to the standard output:
+ *
+ *     {"name":"rbtree_insert_delete","ops":200000,"runs":7,
+ *      "ns_min":85.12,"ns_median":86.40}
+ *
+ * The arguments, if any, select the benchmarks by a name substring.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_BENCH_RUNS  7
+
+
+typedef struct {
+    char                 *name;
+    ngx_int_t           (*init)(void);
+    void                (*run)(ngx_uint_t n);
+    ngx_uint_t            ops;
+} ngx_bench_t;
+
+
+static uint64_t ngx_bench_now(void);
+static uint32_t ngx_bench_random(void);
+static int ngx_libc_cdecl ngx_bench_cmp_time(const void *one,
+    const void *two);
+static int ngx_libc_cdecl ngx_bench_cmp_dns_wildcards(const void *one,
+    const void *two);
+
+static ngx_int_t ngx_bench_init_request(void);
+static void ngx_bench_parse_request_line(ngx_uint_t n);
+static void ngx_bench_parse_header_line(ngx_uint_t n);
+#if (NGX_HTTP_V2 || NGX_HTTP_V3)
+static ngx_int_t ngx_bench_init_huff(void);
+static void ngx_bench_huff_encode(ngx_uint_t n);
+static void ngx_bench_huff_decode(ngx_uint_t n);
+#endif
+static ngx_int_t ngx_bench_init_hash(void);
+static void ngx_bench_hash_find(ngx_uint_t n);
+static void ngx_bench_hash_find_wc_head(ngx_uint_t n);
+static ngx_int_t ngx_bench_init_rbtree(void);
+static void ngx_bench_rbtree_insert_delete(ngx_uint_t n);
+static ngx_int_t ngx_bench_init_slab(void);
+static void ngx_bench_slab_alloc_free(ngx_uint_t n);
+static ngx_int_t ngx_bench_init_pool(void);
+static void ngx_bench_palloc(ngx_uint_t n);
+static void ngx_bench_escape_uri(ngx_uint_t n);
+static void ngx_bench_sprintf(ngx_uint_t n);
+static void ngx_bench_crc32_short(ngx_uint_t n);
+static ngx_int_t ngx_bench_init_crc32(void);
+static void ngx_bench_crc32_long(ngx_uint_t n);
+static void ngx_bench_crc32c(ngx_uint_t n);
+
+
+static ngx_bench_t  ngx_bench_list[] = {
+    { "http_parse_request_line", ngx_bench_init_request,
+      ngx_bench_parse_request_line, 1000000 },
+    { "http_parse_header_line", ngx_bench_init_request,
+      ngx_bench_parse_header_line, 1000000 },
+#if (NGX_HTTP_V2 || NGX_HTTP_V3)
+    { "http_huff_encode", ngx_bench_init_huff,
+      ngx_bench_huff_encode, 1000000 },
+    { "http_huff_decode", ngx_bench_init_huff,
+      ngx_bench_huff_decode, 1000000 },
+#endif
+    { "hash_find", ngx_bench_init_hash,
+      ngx_bench_hash_find, 2000000 },
+    { "hash_find_wc_head", ngx_bench_init_hash,
+      ngx_bench_hash_find_wc_head, 2000000 },
+    { "rbtree_insert_delete", ngx_bench_init_rbtree,
+      ngx_bench_rbtree_insert_delete, 200000 },
+    { "slab_alloc_free", ngx_bench_init_slab,
+      ngx_bench_slab_alloc_free, 1000000 },
+    { "palloc", ngx_bench_init_pool,
+      ngx_bench_palloc, 4000000 },
+    { "escape_uri", NULL,
+      ngx_bench_escape_uri, 1000000 },
+    { "vslprintf", NULL,
+      ngx_bench_sprintf, 1000000 },
+    { "crc32_short", NULL,
+      ngx_bench_crc32_short, 4000000 },
+    { "crc32_long", ngx_bench_init_crc32,
+      ngx_bench_crc32_long, 100000 },
+    { "crc32c", NULL,
+      ngx_bench_crc32c, 4000000 },
+    { NULL, NULL, NULL, 0 }
+};
+
+
+/* results are accumulated here to keep the compiler from dropping the work */
+
+static volatile uintptr_t   ngx_bench_sink;
+
+static uint32_t             ngx_bench_seed = 1;
+
+static ngx_log_t            ngx_bench_log;
+static ngx_open_file_t      ngx_bench_log_file;
+static ngx_cycle_t          ngx_bench_cycle;
+static ngx_pool_t          *ngx_bench_pool;
+
+
+static u_char  ngx_bench_request_line[] =
+    "GET /static/images/logo.png?version=1.27&lang=en HTTP/1.1" CRLF;
+
+static u_char  ngx_bench_headers[] =
+    "Host: www.example.com" CRLF
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) "
+        "Gecko/20100101 Firefox/128.0" CRLF
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+        "*/*;q=0.8" CRLF
+    "Accept-Language: en-US,en;q=0.5" CRLF
+    "Accept-Encoding: gzip, deflate, br, zstd" CRLF
+    "Referer: https://www.example.com/index.html" CRLF
+    "Connection: keep-alive" CRLF
+    "Cookie: session=0123456789abcdef; theme=dark" CRLF
+    "Upgrade-Insecure-Requests: 1" CRLF
+    "If-Modified-Since: Mon, 14 Oct 2024 10:00:00 GMT" CRLF
+    CRLF;
+
+static u_char  ngx_bench_uri[] =
+    "/search/results page?q=nginx benchmark&filter=\"recent\"&"
+    "sort=date desc&name=\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82";
+
+static ngx_http_request_t   ngx_bench_request;
+
+#if (NGX_HTTP_V2 || NGX_HTTP_V3)
+static u_char               ngx_bench_huff[256];
+static size_t               ngx_bench_huff_len;
+#endif
+
+#define NGX_BENCH_HASH_KEYS  1024
+
+static ngx_hash_combined_t  ngx_bench_hash;
+static ngx_str_t            ngx_bench_hash_names[NGX_BENCH_HASH_KEYS];
+static ngx_uint_t           ngx_bench_hash_keys[NGX_BENCH_HASH_KEYS];
+static ngx_str_t            ngx_bench_wc_names[NGX_BENCH_HASH_KEYS];
+
+#define NGX_BENCH_RBTREE_NODES  1024
+
+static ngx_rbtree_t         ngx_bench_rbtree;
+static ngx_rbtree_node_t    ngx_bench_rbtree_sentinel;
+static ngx_rbtree_node_t    ngx_bench_rbtree_nodes[NGX_BENCH_RBTREE_NODES];
+
+#define NGX_BENCH_SLAB_SIZE     (16 * 1024 * 1024)
+#define NGX_BENCH_SLAB_OBJECTS  256
+
+static ngx_slab_pool_t     *ngx_bench_slab;
+static void                *ngx_bench_slab_objects[NGX_BENCH_SLAB_OBJECTS];
+
+static ngx_pool_t          *ngx_bench_palloc_pool;
+
+static u_char               ngx_bench_crc32_data[4096];
+
+
+int ngx_cdecl
+main(int argc, char *const *argv)
+{
+    u_char        *p;
+    uint64_t       start, times[NGX_BENCH_RUNS];
+    ngx_int_t      i, j;
+    ngx_uint_t     run;
+    ngx_bench_t   *b;
+    u_char         line[NGX_MAX_ERROR_STR];
+
+    if (ngx_strerror_init() != NGX_OK) {
+        return 1;
+    }
+
+    ngx_time_init();
+
+    ngx_bench_log_file.fd = ngx_stderr;
+    ngx_bench_log.file = &ngx_bench_log_file;
+    ngx_bench_log.log_level = NGX_LOG_NOTICE;
+
+    ngx_bench_cycle.log = &ngx_bench_log;
+    ngx_cycle = &ngx_bench_cycle;
+
+    /* ngx_init_setproctitle() needs the arguments */
+
+    ngx_os_argv = (char **) argv;
+
+    if (ngx_os_init(&ngx_bench_log) != NGX_OK) {
+        return 1;
+    }
+
+    if (ngx_crc32_table_init() != NGX_OK) {
+        return 1;
+    }
+
+    ngx_slab_sizes_init();
+
+    ngx_bench_pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, &ngx_bench_log);
+    if (ngx_bench_pool == NULL) {
+        return 1;
+    }
+
+    for (b = ngx_bench_list; b->name; b++) {
+
+        if (argc > 1) {
+            for (i = 1; i < argc; i++) {
+                if (ngx_strstr(b->name, argv[i])) {
+                    break;
+                }
+            }
+
+            if (i == argc) {
+                continue;
+            }
+        }
+
+        if (b->init && b->init() != NGX_OK) {
+            ngx_log_error(NGX_LOG_EMERG, &ngx_bench_log, 0,
+                          "benchmark \"%s\" initialization failed", b->name);
+            return 1;
+        }
+
+        /* warm up caches and branch predictors */
+
+        b->run(b->ops / 10);
+
+        for (run = 0; run < NGX_BENCH_RUNS; run++) {
+            start = ngx_bench_now();
+            b->run(b->ops);
+            times[run] = ngx_bench_now() - start;
+        }
+
+        ngx_qsort(times, NGX_BENCH_RUNS, sizeof(uint64_t),
+                  ngx_bench_cmp_time);
+
+        p = ngx_slprintf(line, line + sizeof(line),
+                         "{\"name\":\"%s\",\"ops\":%ui,\"runs\":%d,"
+                         "\"ns_min\":%.2f,\"ns_median\":%.2f}" NGX_LINEFEED,
+                         b->name, b->ops, NGX_BENCH_RUNS,
+                         (double) times[0] / b->ops,
+                         (double) times[NGX_BENCH_RUNS / 2] / b->ops);
+
+        j = ngx_write_fd(ngx_stdout, line, p - line);
+
+        if (j != p - line) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static uint64_t
+ngx_bench_now(void)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval   tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
+
+static uint32_t
+ngx_bench_random(void)
+{
+    /* a fixed sequence, so that every run sees the same data */
+
+    ngx_bench_seed = ngx_bench_seed * 1103515245 + 12345;
+
+    return ngx_bench_seed >> 8;
+}
+
+
+static int ngx_libc_cdecl
+ngx_bench_cmp_time(const void *one, const void *two)
+{
+    uint64_t  a = *(uint64_t *) one;
+    uint64_t  b = *(uint64_t *) two;
+
+    return (a > b) - (a < b);
+}
+
+
+static int ngx_libc_cdecl
+ngx_bench_cmp_dns_wildcards(const void *one, const void *two)
+{
+    ngx_hash_key_t  *first, *second;
+
+    first = (ngx_hash_key_t *) one;
+    second = (ngx_hash_key_t *) two;
+
+    return ngx_dns_strcmp(first->key.data, second->key.data);
+}
+
+
+static ngx_int_t
+ngx_bench_init_request(void)
+{
+    ngx_memzero(&ngx_bench_request, sizeof(ngx_http_request_t));
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_parse_request_line(ngx_uint_t n)
+{
+    ngx_buf_t            b;
+    ngx_http_request_t  *r;
+
+    r = &ngx_bench_request;
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+
+    b.start = ngx_bench_request_line;
+    b.end = ngx_bench_request_line + sizeof(ngx_bench_request_line) - 1;
+    b.last = b.end;
+
+    while (n--) {
+        b.pos = b.start;
+        r->state = 0;
+
+        if (ngx_http_parse_request_line(r, &b) != NGX_OK) {
+            return;
+        }
+
+        ngx_bench_sink += r->method;
+    }
+}
+
+
+static void
+ngx_bench_parse_header_line(ngx_uint_t n)
+{
+    ngx_int_t            rc;
+    ngx_buf_t            b;
+    ngx_uint_t           headers;
+    ngx_http_request_t  *r;
+
+    r = &ngx_bench_request;
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+
+    b.start = ngx_bench_headers;
+    b.end = ngx_bench_headers + sizeof(ngx_bench_headers) - 1;
+    b.last = b.end;
+
+    headers = 10;
+
+    /* an operation is one header line */
+
+    n = (n + headers - 1) / headers;
+
+    while (n--) {
+        b.pos = b.start;
+        r->state = 0;
+
+        do {
+            rc = ngx_http_parse_header_line(r, &b, 0);
+            ngx_bench_sink += r->header_hash;
+
+        } while (rc == NGX_OK);
+
+        if (rc != NGX_HTTP_PARSE_HEADER_DONE) {
+            return;
+        }
+    }
+}
+
+
+#if (NGX_HTTP_V2 || NGX_HTTP_V3)
+
+static ngx_int_t
+ngx_bench_init_huff(void)
+{
+    u_char  *src;
+    size_t   len;
+
+    src = ngx_bench_headers + sizeof("Host: www.example.com" CRLF
+                                     "User-Agent: ") - 1;
+    len = sizeof("Mozilla/5.0 (X11; Linux x86_64; rv:128.0) "
+                 "Gecko/20100101 Firefox/128.0") - 1;
+
+    ngx_bench_huff_len = ngx_http_huff_encode(src, len, ngx_bench_huff, 0);
+
+    if (ngx_bench_huff_len == 0) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_huff_encode(ngx_uint_t n)
+{
+    u_char  *src;
+    size_t   len;
+    u_char   dst[256];
+
+    src = ngx_bench_headers + sizeof("Host: www.example.com" CRLF
+                                     "User-Agent: ") - 1;
+    len = sizeof("Mozilla/5.0 (X11; Linux x86_64; rv:128.0) "
+                 "Gecko/20100101 Firefox/128.0") - 1;
+
+    while (n--) {
+        ngx_bench_sink += ngx_http_huff_encode(src, len, dst, 0);
+    }
+}
+
+
+static void
+ngx_bench_huff_decode(ngx_uint_t n)
+{
+    u_char   state, *p;
+    u_char   dst[256];
+
+    while (n--) {
+        state = 0;
+        p = dst;
+
+        if (ngx_http_huff_decode(&state, ngx_bench_huff, ngx_bench_huff_len,
+                                 &p, 1, &ngx_bench_log)
+            != NGX_OK)
+        {
+            return;
+        }
+
+        ngx_bench_sink += p - dst;
+    }
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_bench_init_hash(void)
+{
+    u_char                  *p;
+    ngx_uint_t               i;
+    ngx_str_t                name;
+    ngx_hash_init_t          hash;
+    ngx_hash_keys_arrays_t   ha;
+
+    if (ngx_bench_hash.hash.buckets) {
+        return NGX_OK;
+    }
+
+    ngx_memzero(&ha, sizeof(ngx_hash_keys_arrays_t));
+
+    ha.pool = ngx_bench_pool;
+    ha.temp_pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, &ngx_bench_log);
+    if (ha.temp_pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_hash_keys_array_init(&ha, NGX_HASH_LARGE) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < NGX_BENCH_HASH_KEYS; i++) {
+
+        p = ngx_pnalloc(ngx_bench_pool, sizeof("www.host.example.com")
+                                        + NGX_INT_T_LEN);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        name.data = p;
+        name.len = ngx_sprintf(p, "www.host%ui.example.com", i) - p;
+
+        ngx_bench_hash_names[i] = name;
+        ngx_bench_hash_keys[i] = ngx_hash_key(name.data, name.len);
+
+        if (ngx_hash_add_key(&ha, &name, &ngx_bench_hash_names[i], 0)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        p = ngx_pnalloc(ngx_bench_pool, sizeof("*.wild.example.org")
+                                        + NGX_INT_T_LEN);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        name.data = p;
+        name.len = ngx_sprintf(p, "*.wild%ui.example.org", i) - p;
+
+        if (ngx_hash_add_key(&ha, &name, &ngx_bench_wc_names[i],
+                             NGX_HASH_WILDCARD_KEY)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        p = ngx_pnalloc(ngx_bench_pool, sizeof("www.mail.wild.example.org")
+                                        + NGX_INT_T_LEN);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_bench_wc_names[i].data = p;
+        ngx_bench_wc_names[i].len =
+                         ngx_sprintf(p, "www.mail.wild%ui.example.org", i) - p;
+    }
+
+    hash.key = ngx_hash_key_lc;
+    hash.max_size = 4096;
+    hash.bucket_size = ngx_align(64, ngx_cacheline_size);
+    hash.name = "bench_hash";
+    hash.pool = ngx_bench_pool;
+
+    hash.hash = &ngx_bench_hash.hash;
+    hash.temp_pool = NULL;
+
+    if (ngx_hash_init(&hash, ha.keys.elts, ha.keys.nelts) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_qsort(ha.dns_wc_head.elts, (size_t) ha.dns_wc_head.nelts,
+              sizeof(ngx_hash_key_t), ngx_bench_cmp_dns_wildcards);
+
+    hash.hash = NULL;
+    hash.temp_pool = ha.temp_pool;
+
+    if (ngx_hash_wildcard_init(&hash, ha.dns_wc_head.elts,
+                               ha.dns_wc_head.nelts)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_hash.wc_head = (ngx_hash_wildcard_t *) hash.hash;
+
+    ngx_destroy_pool(ha.temp_pool);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_hash_find(ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; n--; i = (i + 1) % NGX_BENCH_HASH_KEYS) {
+        ngx_bench_sink += (uintptr_t) ngx_hash_find(&ngx_bench_hash.hash,
+                                                  ngx_bench_hash_keys[i],
+                                                  ngx_bench_hash_names[i].data,
+                                                  ngx_bench_hash_names[i].len);
+    }
+}
+
+
+static void
+ngx_bench_hash_find_wc_head(ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; n--; i = (i + 1) % NGX_BENCH_HASH_KEYS) {
+        ngx_bench_sink += (uintptr_t) ngx_hash_find_wc_head(
+                                                  ngx_bench_hash.wc_head,
+                                                  ngx_bench_wc_names[i].data,
+                                                  ngx_bench_wc_names[i].len);
+    }
+}
+
+
+static ngx_int_t
+ngx_bench_init_rbtree(void)
+{
+    ngx_uint_t  i;
+
+    ngx_rbtree_init(&ngx_bench_rbtree, &ngx_bench_rbtree_sentinel,
+                    ngx_rbtree_insert_value);
+
+    ngx_bench_seed = 1;
+
+    for (i = 0; i < NGX_BENCH_RBTREE_NODES; i++) {
+        ngx_bench_rbtree_nodes[i].key = ngx_bench_random();
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_rbtree_insert_delete(ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    /* an operation is one insertion and one deletion */
+
+    n = (n + NGX_BENCH_RBTREE_NODES - 1) / NGX_BENCH_RBTREE_NODES;
+
+    while (n--) {
+        for (i = 0; i < NGX_BENCH_RBTREE_NODES; i++) {
+            ngx_rbtree_insert(&ngx_bench_rbtree, &ngx_bench_rbtree_nodes[i]);
+        }
+
+        ngx_bench_sink += ngx_bench_rbtree.root->key;
+
+        for (i = 0; i < NGX_BENCH_RBTREE_NODES; i++) {
+            ngx_rbtree_delete(&ngx_bench_rbtree, &ngx_bench_rbtree_nodes[i]);
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_bench_init_slab(void)
+{
+    u_char  *p;
+
+    if (ngx_bench_slab) {
+        return NGX_OK;
+    }
+
+    p = ngx_memalign(ngx_pagesize, NGX_BENCH_SLAB_SIZE, &ngx_bench_log);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_slab = (ngx_slab_pool_t *) p;
+
+    ngx_bench_slab->end = p + NGX_BENCH_SLAB_SIZE;
+    ngx_bench_slab->min_shift = 3;
+    ngx_bench_slab->addr = p;
+
+    if (ngx_shmtx_create(&ngx_bench_slab->mutex, &ngx_bench_slab->lock, NULL)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ngx_slab_init(ngx_bench_slab);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_slab_alloc_free(ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    static size_t  sizes[] = { 16, 48, 128, 300, 1024, 3000 };
+
+    /* an operation is one allocation and one free */
+
+    n = (n + NGX_BENCH_SLAB_OBJECTS - 1) / NGX_BENCH_SLAB_OBJECTS;
+
+    while (n--) {
+        for (i = 0; i < NGX_BENCH_SLAB_OBJECTS; i++) {
+            ngx_bench_slab_objects[i] = ngx_slab_alloc(ngx_bench_slab,
+                                            sizes[i % (sizeof(sizes)
+                                                       / sizeof(size_t))]);
+        }
+
+        for (i = 0; i < NGX_BENCH_SLAB_OBJECTS; i++) {
+            if (ngx_bench_slab_objects[i]) {
+                ngx_slab_free(ngx_bench_slab, ngx_bench_slab_objects[i]);
+            }
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_bench_init_pool(void)
+{
+    if (ngx_bench_palloc_pool) {
+        return NGX_OK;
+    }
+
+    ngx_bench_palloc_pool = ngx_create_pool(16384, &ngx_bench_log);
+    if (ngx_bench_palloc_pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_palloc(ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    /* allocations typical for a request, the pool is reset as it fills */
+
+    for (i = 0; n--; i++) {
+
+        if ((i & 255) == 0) {
+            ngx_reset_pool(ngx_bench_palloc_pool);
+        }
+
+        ngx_bench_sink += (uintptr_t) ngx_palloc(ngx_bench_palloc_pool,
+                                                 8 + (i & 7) * 8);
+    }
+}
+
+
+static void
+ngx_bench_escape_uri(ngx_uint_t n)
+{
+    u_char  dst[3 * sizeof(ngx_bench_uri)];
+
+    while (n--) {
+        ngx_bench_sink += ngx_escape_uri(dst, ngx_bench_uri,
+                                         sizeof(ngx_bench_uri) - 1,
+                                         NGX_ESCAPE_ARGS);
+    }
+}
+
+
+static void
+ngx_bench_sprintf(ngx_uint_t n)
+{
+    u_char     *p;
+    ngx_str_t   s;
+    u_char      buf[NGX_MAX_ERROR_STR];
+
+    ngx_str_set(&s, "upstream timed out");
+
+    while (n--) {
+        p = ngx_snprintf(buf, sizeof(buf),
+                         "%V (%d: %s) while reading response header, "
+                         "client: %ui, bytes: %O, time: %M, addr: %p",
+                         &s, 110, "Connection timed out", n, (off_t) 123456,
+                         (ngx_msec_t) 60000, buf);
+
+        ngx_bench_sink += p - buf;
+    }
+}
+
+
+/* short keys, as in limit_req and other shared memory zones */
+
+static void
+ngx_bench_crc32_short(ngx_uint_t n)
+{
+    while (n--) {
+        ngx_bench_sink += ngx_crc32_short(ngx_bench_uri, 32);
+    }
+}
+
+
+static ngx_int_t
+ngx_bench_init_crc32(void)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < sizeof(ngx_bench_crc32_data); i++) {
+        ngx_bench_crc32_data[i] = (u_char) ngx_bench_random();
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_crc32_long(ngx_uint_t n)
+{
+    while (n--) {
+        ngx_bench_sink += ngx_crc32_long(ngx_bench_crc32_data,
+                                         sizeof(ngx_bench_crc32_data));
+    }
+}
+
+
+static void
+ngx_bench_crc32c(ngx_uint_t n)
+{
+    while (n--) {
+        ngx_bench_sink += ngx_crc32c(ngx_bench_uri, 32);
+    }
+}
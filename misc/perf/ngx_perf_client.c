@@ -0,0 +1,542 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+/*
+ * HTTP/1.1 load generator of the performance harness, see misc/perf/run.sh.
+ *
+ *     ngx_perf_client [-c connections] [-d seconds] [-n] [-s] host port uri
+ *
+ *     -c   number of concurrent connections, 16 by default
+ *     -d   test duration in seconds, 10 by default
+ *     -n   a new connection for each request, e.g. to load TLS handshakes
+ *     -s   use TLS, available if built with -DNGX_PERF_SSL
+ *
+ * Each connection is served by its own thread with blocking sockets,
+ * which keeps the client simple and costs little compared to the server.
+ * The result is a single JSON object on the standard output.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#if (NGX_PERF_SSL)
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
+
+
+#define NGX_PERF_BUFSIZE  65536
+
+
+typedef struct {
+    pthread_t          thread;
+    int                fd;
+#if (NGX_PERF_SSL)
+    SSL               *ssl;
+#endif
+
+    uint32_t          *latency;      /* usec */
+    size_t             nlatency;
+    size_t             nalloc;
+
+    uint64_t           requests;
+    uint64_t           errors;
+    uint64_t           connects;
+
+    char               buf[NGX_PERF_BUFSIZE];
+} ngx_perf_conn_t;
+
+
+static void *ngx_perf_thread(void *data);
+static int ngx_perf_connect(ngx_perf_conn_t *c);
+static void ngx_perf_close(ngx_perf_conn_t *c);
+static int ngx_perf_request(ngx_perf_conn_t *c);
+static ssize_t ngx_perf_send(ngx_perf_conn_t *c, char *buf, size_t len);
+static ssize_t ngx_perf_recv(ngx_perf_conn_t *c, char *buf, size_t len);
+static int ngx_perf_add_latency(ngx_perf_conn_t *c, uint64_t usec);
+static uint64_t ngx_perf_now(void);
+static int ngx_perf_cmp_latency(const void *one, const void *two);
+static void ngx_perf_usage(void);
+
+
+static struct addrinfo  *ngx_perf_addr;
+static char              ngx_perf_request_buf[2048];
+static size_t            ngx_perf_request_len;
+static int               ngx_perf_close_each;
+static int               ngx_perf_use_ssl;
+static volatile int      ngx_perf_stop;
+
+#if (NGX_PERF_SSL)
+static SSL_CTX          *ngx_perf_ssl_ctx;
+#endif
+
+
+int
+main(int argc, char **argv)
+{
+    int               ch, rc;
+    char             *host, *port, *uri;
+    size_t            i, n, total;
+    uint32_t         *all;
+    uint64_t          start, elapsed, requests, errors, connects;
+    unsigned          conns, duration;
+    struct addrinfo   hints;
+    ngx_perf_conn_t  *c;
+
+    conns = 16;
+    duration = 10;
+
+    while ((ch = getopt(argc, argv, "c:d:ns")) != -1) {
+        switch (ch) {
+
+        case 'c':
+            conns = (unsigned) atoi(optarg);
+            break;
+
+        case 'd':
+            duration = (unsigned) atoi(optarg);
+            break;
+
+        case 'n':
+            ngx_perf_close_each = 1;
+            break;
+
+        case 's':
+            ngx_perf_use_ssl = 1;
+            break;
+
+        default:
+            ngx_perf_usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 3 || conns == 0 || duration == 0) {
+        ngx_perf_usage();
+        return 1;
+    }
+
+    host = argv[optind];
+    port = argv[optind + 1];
+    uri = argv[optind + 2];
+
+#if (NGX_PERF_SSL)
+
+    if (ngx_perf_use_ssl) {
+        ngx_perf_ssl_ctx = SSL_CTX_new(TLS_client_method());
+        if (ngx_perf_ssl_ctx == NULL) {
+            fprintf(stderr, "SSL_CTX_new() failed\n");
+            return 1;
+        }
+
+        /* the server is expected to use a self-signed certificate */
+
+        SSL_CTX_set_verify(ngx_perf_ssl_ctx, SSL_VERIFY_NONE, NULL);
+    }
+
+#else
+
+    if (ngx_perf_use_ssl) {
+        fprintf(stderr, "built without TLS support\n");
+        return 1;
+    }
+
+#endif
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    rc = getaddrinfo(host, port, &hints, &ngx_perf_addr);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo(\"%s\") failed: %s\n",
+                host, gai_strerror(rc));
+        return 1;
+    }
+
+    n = snprintf(ngx_perf_request_buf, sizeof(ngx_perf_request_buf),
+                 "GET %s HTTP/1.1\r\n"
+                 "Host: %s\r\n"
+                 "User-Agent: ngx_perf_client\r\n"
+                 "%s"
+                 "\r\n",
+                 uri, host,
+                 ngx_perf_close_each ? "Connection: close\r\n" : "");
+
+    if (n >= sizeof(ngx_perf_request_buf)) {
+        fprintf(stderr, "uri is too long\n");
+        return 1;
+    }
+
+    ngx_perf_request_len = n;
+
+    c = calloc(conns, sizeof(ngx_perf_conn_t));
+    if (c == NULL) {
+        fprintf(stderr, "calloc() failed\n");
+        return 1;
+    }
+
+    start = ngx_perf_now();
+
+    for (i = 0; i < conns; i++) {
+        c[i].fd = -1;
+
+        if (pthread_create(&c[i].thread, NULL, ngx_perf_thread, &c[i]) != 0) {
+            fprintf(stderr, "pthread_create() failed\n");
+            return 1;
+        }
+    }
+
+    sleep(duration);
+
+    ngx_perf_stop = 1;
+
+    requests = 0;
+    errors = 0;
+    connects = 0;
+    total = 0;
+
+    for (i = 0; i < conns; i++) {
+        pthread_join(c[i].thread, NULL);
+
+        requests += c[i].requests;
+        errors += c[i].errors;
+        connects += c[i].connects;
+        total += c[i].nlatency;
+    }
+
+    elapsed = ngx_perf_now() - start;
+
+    all = malloc((total ? total : 1) * sizeof(uint32_t));
+    if (all == NULL) {
+        fprintf(stderr, "malloc() failed\n");
+        return 1;
+    }
+
+    n = 0;
+
+    for (i = 0; i < conns; i++) {
+        memcpy(all + n, c[i].latency, c[i].nlatency * sizeof(uint32_t));
+        n += c[i].nlatency;
+    }
+
+    qsort(all, total, sizeof(uint32_t), ngx_perf_cmp_latency);
+
+    printf("{\"requests\":%llu,\"errors\":%llu,\"connections\":%llu,"
+           "\"rps\":%.1f,\"p50_ms\":%.3f,\"p99_ms\":%.3f}\n",
+           (unsigned long long) requests, (unsigned long long) errors,
+           (unsigned long long) connects,
+           requests * 1000000.0 / (elapsed ? elapsed : 1),
+           total ? all[total / 2] / 1000.0 : 0.0,
+           total ? all[total * 99 / 100] / 1000.0 : 0.0);
+
+    return 0;
+}
+
+
+static void *
+ngx_perf_thread(void *data)
+{
+    ngx_perf_conn_t  *c = data;
+
+    uint64_t  start;
+
+    while (!ngx_perf_stop) {
+
+        start = ngx_perf_now();
+
+        if (c->fd == -1 && ngx_perf_connect(c) != 0) {
+            c->errors++;
+            usleep(10000);
+            continue;
+        }
+
+        if (ngx_perf_request(c) != 0) {
+            c->errors++;
+            ngx_perf_close(c);
+            continue;
+        }
+
+        c->requests++;
+
+        if (ngx_perf_add_latency(c, ngx_perf_now() - start) != 0) {
+            break;
+        }
+
+        if (ngx_perf_close_each) {
+            ngx_perf_close(c);
+        }
+    }
+
+    ngx_perf_close(c);
+
+    return NULL;
+}
+
+
+static int
+ngx_perf_connect(ngx_perf_conn_t *c)
+{
+    int  one;
+
+    c->fd = socket(ngx_perf_addr->ai_family, ngx_perf_addr->ai_socktype,
+                   ngx_perf_addr->ai_protocol);
+    if (c->fd == -1) {
+        return -1;
+    }
+
+    one = 1;
+    (void) setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(int));
+
+    if (connect(c->fd, ngx_perf_addr->ai_addr, ngx_perf_addr->ai_addrlen)
+        == -1)
+    {
+        ngx_perf_close(c);
+        return -1;
+    }
+
+    c->connects++;
+
+#if (NGX_PERF_SSL)
+
+    if (ngx_perf_use_ssl) {
+        c->ssl = SSL_new(ngx_perf_ssl_ctx);
+        if (c->ssl == NULL) {
+            ngx_perf_close(c);
+            return -1;
+        }
+
+        SSL_set_fd(c->ssl, c->fd);
+
+        if (SSL_connect(c->ssl) != 1) {
+            ERR_clear_error();
+            ngx_perf_close(c);
+            return -1;
+        }
+    }
+
+#endif
+
+    return 0;
+}
+
+
+static void
+ngx_perf_close(ngx_perf_conn_t *c)
+{
+#if (NGX_PERF_SSL)
+    if (c->ssl) {
+        SSL_free(c->ssl);
+        c->ssl = NULL;
+    }
+#endif
+
+    if (c->fd != -1) {
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+
+static int
+ngx_perf_request(ngx_perf_conn_t *c)
+{
+    int       keepalive;
+    char     *p, *last, *header_end, *line;
+    size_t    len, body;
+    ssize_t   n;
+
+    if (ngx_perf_send(c, ngx_perf_request_buf, ngx_perf_request_len)
+        != (ssize_t) ngx_perf_request_len)
+    {
+        return -1;
+    }
+
+    last = c->buf;
+    header_end = NULL;
+
+    /* the response header */
+
+    for ( ;; ) {
+        len = c->buf + NGX_PERF_BUFSIZE - 1 - last;
+
+        if (len == 0) {
+            return -1;
+        }
+
+        n = ngx_perf_recv(c, last, len);
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        last += n;
+        *last = '\0';
+
+        for (p = c->buf; p + 3 < last; p++) {
+            if (p[0] == '\r' && p[1] == '\n' && p[2] == '\r' && p[3] == '\n') {
+                header_end = p + 4;
+                break;
+            }
+        }
+
+        if (header_end) {
+            break;
+        }
+    }
+
+    if (strncmp(c->buf, "HTTP/1.1 200 ", 13) != 0) {
+        if (strncmp(c->buf, "HTTP/1.", 7) != 0) {
+            return -1;
+        }
+
+        c->errors++;
+    }
+
+    body = 0;
+    keepalive = 1;
+
+    for (line = strstr(c->buf, "\r\n"); line && line < header_end - 2;
+         line = strstr(line, "\r\n"))
+    {
+        line += 2;
+
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            body = strtoul(line + 15, NULL, 10);
+            continue;
+        }
+
+        if (strncasecmp(line, "Connection:", 11) == 0
+            && strncasecmp(line + 11, " close", 6) == 0)
+        {
+            keepalive = 0;
+            continue;
+        }
+
+        if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            /* chunked responses are not used by the reference configs */
+            return -1;
+        }
+    }
+
+    /* the response body is read and discarded */
+
+    len = last - header_end;
+
+    while (len < body) {
+        n = ngx_perf_recv(c, c->buf, NGX_PERF_BUFSIZE);
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        len += n;
+    }
+
+    if (len != body) {
+        /* pipelining is not used, so there must be no extra data */
+        return -1;
+    }
+
+    if (!keepalive) {
+        ngx_perf_close(c);
+    }
+
+    return 0;
+}
+
+
+static ssize_t
+ngx_perf_send(ngx_perf_conn_t *c, char *buf, size_t len)
+{
+#if (NGX_PERF_SSL)
+    if (c->ssl) {
+        return SSL_write(c->ssl, buf, (int) len);
+    }
+#endif
+
+    return send(c->fd, buf, len, 0);
+}
+
+
+static ssize_t
+ngx_perf_recv(ngx_perf_conn_t *c, char *buf, size_t len)
+{
+#if (NGX_PERF_SSL)
+    if (c->ssl) {
+        return SSL_read(c->ssl, buf, (int) len);
+    }
+#endif
+
+    return recv(c->fd, buf, len, 0);
+}
+
+
+static int
+ngx_perf_add_latency(ngx_perf_conn_t *c, uint64_t usec)
+{
+    size_t     n;
+    uint32_t  *latency;
+
+    if (c->nlatency == c->nalloc) {
+        n = c->nalloc ? c->nalloc * 2 : 65536;
+
+        latency = realloc(c->latency, n * sizeof(uint32_t));
+        if (latency == NULL) {
+            return -1;
+        }
+
+        c->latency = latency;
+        c->nalloc = n;
+    }
+
+    c->latency[c->nlatency++] = usec > UINT32_MAX ? UINT32_MAX
+                                                  : (uint32_t) usec;
+
+    return 0;
+}
+
+
+static uint64_t
+ngx_perf_now(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static int
+ngx_perf_cmp_latency(const void *one, const void *two)
+{
+    uint32_t  a = *(uint32_t *) one;
+    uint32_t  b = *(uint32_t *) two;
+
+    return (a > b) - (a < b);
+}
+
+
+static void
+ngx_perf_usage(void)
+{
+    fprintf(stderr, "usage: ngx_perf_client [-c connections] [-d seconds] "
+                    "[-n] [-s] host port uri\n");
+}
@@ -0,0 +1,190 @@
+#!/bin/sh
+
+# Copyright (C) Nginx, Inc.
+
+
+# Runs the reference configurations of misc/perf/conf against nginx
+# built in the given directory, usually by "make -f misc/GNUmakefile perf".
+# One JSON object is written per scenario:
+#
+#     {"scenario":"static","version":"1.27.3","requests":...,"errors":...,
+#      "connections":...,"rps":...,"p50_ms":...,"p99_ms":...,
+#      "cpu_us_per_req":...,"rss_kb":...}
+#
+# CPU time and RSS are summed over the nginx processes and taken from
+# /proc, so the harness is Linux only.  The http2 and http3 scenarios
+# use h2load from nghttp2, and are skipped if it is not found.
+#
+# usage: run.sh [-c connections] [-d seconds] [-w workers] builddir
+#               [scenario ...]
+
+
+set -e
+
+ngx_conns=64
+ngx_duration=10
+ngx_workers=1
+ngx_port=18080
+ngx_backend=18081
+
+while getopts c:d:w: ngx_opt; do
+    case $ngx_opt in
+        c) ngx_conns=$OPTARG ;;
+        d) ngx_duration=$OPTARG ;;
+        w) ngx_workers=$OPTARG ;;
+        *) exit 1 ;;
+    esac
+done
+
+shift `expr $OPTIND - 1`
+
+if [ $# -eq 0 ]; then
+    echo "usage: $0 [-c connections] [-d seconds] [-w workers]" \
+         "builddir [scenario ...]" >&2
+    exit 1
+fi
+
+ngx_build=`cd $1 && pwd`
+shift
+
+ngx_scenarios=${*:-static proxy cache tls http2 http3}
+
+ngx_nginx=$ngx_build/nginx
+ngx_client=$ngx_build/ngx_perf_client
+ngx_prefix=$ngx_build/perf
+ngx_confs=`dirname $0`/conf
+
+ngx_version=`$ngx_nginx -v 2>&1 | sed -e 's|^.*/||'`
+ngx_tck=`getconf CLK_TCK`
+
+
+rm -rf $ngx_prefix
+mkdir -p $ngx_prefix/conf $ngx_prefix/html $ngx_prefix/logs
+
+dd if=/dev/zero of=$ngx_prefix/html/1k.html bs=1024 count=1 2>/dev/null
+
+openssl req -x509 -newkey rsa:2048 -nodes -days 1 -subj /CN=localhost \
+    -keyout $ngx_prefix/conf/cert.key -out $ngx_prefix/conf/cert.pem \
+    2>/dev/null
+
+for ngx_conf in $ngx_confs/*.conf; do
+    sed -e "s/@PORT@/$ngx_port/g" \
+        -e "s/@BACKEND@/$ngx_backend/g" \
+        -e "s/@WORKERS@/$ngx_workers/g" \
+        $ngx_conf > $ngx_prefix/conf/`basename $ngx_conf`
+done
+
+
+ngx_cpu() {
+    # utime and stime in ticks of the master process and its children
+
+    cat /proc/[0-9]*/stat 2>/dev/null \
+        | awk -v m=$1 '$1 == m || $4 == m { t += $14 + $15 } END { print t }'
+}
+
+
+ngx_rss() {
+    for ngx_pid in `awk -v m=$1 '$4 == m { print $1 }' /proc/[0-9]*/stat \
+                    2>/dev/null`
+    do
+        awk '/^VmRSS:/ { print $2 }' /proc/$ngx_pid/status 2>/dev/null
+    done | awk '{ t += $1 } END { print t + 0 }'
+}
+
+
+ngx_h2load() {
+    if ! type h2load >/dev/null 2>&1; then
+        return 1
+    fi
+
+    h2load $* -D $ngx_duration -c $ngx_conns -m 10 \
+        https://127.0.0.1:$ngx_port/1k.html 2>/dev/null \
+        | awk '
+            /^finished in/ { rps = $4 }
+            /^requests:/ { n = $2; started = $4; failed = $10 }
+            END {
+                printf("{\"requests\":%d,\"errors\":%d,\"connections\":%d,"
+                       "\"rps\":%.1f,\"p50_ms\":null,\"p99_ms\":null}\n",
+                       n, failed, '$ngx_conns', rps)
+            }'
+}
+
+
+for ngx_scenario in $ngx_scenarios; do
+
+    if [ ! -f $ngx_prefix/conf/$ngx_scenario.conf ]; then
+        echo "unknown scenario \"$ngx_scenario\"" >&2
+        exit 1
+    fi
+
+    if ! $ngx_nginx -p $ngx_prefix -c conf/$ngx_scenario.conf -t \
+         >/dev/null 2>&1
+    then
+        echo "{\"scenario\":\"$ngx_scenario\",\"skipped\":\"config\"}"
+        continue
+    fi
+
+    $ngx_nginx -p $ngx_prefix -c conf/$ngx_scenario.conf
+
+    sleep 1
+
+    ngx_master=`cat $ngx_prefix/logs/nginx.pid`
+
+    # warm up
+
+    case $ngx_scenario in
+        cache|proxy)
+            $ngx_client -c 1 -d 1 127.0.0.1 $ngx_port /1k.html >/dev/null
+            ;;
+    esac
+
+    ngx_start=`ngx_cpu $ngx_master`
+
+    case $ngx_scenario in
+
+        tls)
+            ngx_result=`$ngx_client -s -n -c $ngx_conns -d $ngx_duration \
+                        127.0.0.1 $ngx_port /1k.html`
+            ;;
+
+        http2)
+            ngx_result=`ngx_h2load || :`
+            ;;
+
+        http3)
+            ngx_result=`ngx_h2load --alpn-list=h3 || :`
+            ;;
+
+        *)
+            ngx_result=`$ngx_client -c $ngx_conns -d $ngx_duration \
+                        127.0.0.1 $ngx_port /1k.html`
+            ;;
+    esac
+
+    ngx_end=`ngx_cpu $ngx_master`
+    ngx_rss_kb=`ngx_rss $ngx_master`
+
+    kill -QUIT $ngx_master
+
+    while kill -0 $ngx_master 2>/dev/null; do
+        sleep 0.1
+    done
+
+    if [ -z "$ngx_result" ]; then
+        echo "{\"scenario\":\"$ngx_scenario\",\"skipped\":\"client\"}"
+        continue
+    fi
+
+    ngx_requests=`echo "$ngx_result" \
+                  | sed -e 's/.*"requests":\([0-9]*\).*/\1/'`
+
+    ngx_cpu_us=`awk -v s=$ngx_start -v e=$ngx_end -v n=$ngx_requests \
+                    -v t=$ngx_tck 'BEGIN {
+                        printf("%.2f", n ? (e - s) * 1000000 / t / n : 0)
+                    }'`
+
+    ngx_head="\"scenario\":\"$ngx_scenario\",\"version\":\"$ngx_version\""
+    ngx_tail="\"cpu_us_per_req\":$ngx_cpu_us,\"rss_kb\":$ngx_rss_kb"
+
+    echo "$ngx_result" | sed -e "s/^{/{$ngx_head,/" -e "s/}\$/,$ngx_tail}/"
+done
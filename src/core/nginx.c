@@ -27,6 +27,12 @@ static char *ngx_set_cpu_affinity(ngx_conf_t *cf, ngx_command_t *cmd,
 static char *ngx_set_worker_processes(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_load_module(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+#if (NGX_HAVE_MEMFD)
+static char *ngx_set_temp_file_memory(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_int_t ngx_init_temp_file_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+#endif
 #if (NGX_HAVE_DLOPEN)
 static void ngx_unload_module(void *data);
 #endif
@@ -39,6 +45,21 @@ static ngx_conf_enum_t  ngx_debug_points[] = {
 };
 
 
+static ngx_conf_enum_t  ngx_numa_memory[] = {
+    { ngx_string("off"), NGX_NUMA_OFF },
+    { ngx_string("local"), NGX_NUMA_LOCAL },
+    { ngx_string("bind"), NGX_NUMA_BIND },
+    { ngx_null_string, 0 }
+};
+
+
+static ngx_conf_enum_t  ngx_numa_shared_memory[] = {
+    { ngx_string("off"), 0 },
+    { ngx_string("interleave"), 1 },
+    { ngx_null_string, 0 }
+};
+
+
 static ngx_command_t  ngx_core_commands[] = {
 
     { ngx_string("daemon"),
@@ -62,6 +83,20 @@ static ngx_command_t  ngx_core_commands[] = {
       offsetof(ngx_core_conf_t, timer_resolution),
       NULL },
 
+    { ngx_string("pool_cache"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_core_conf_t, pool_cache),
+      NULL },
+
+    { ngx_string("slab_magazine"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_core_conf_t, slab_magazine),
+      NULL },
+
     { ngx_string("pid"),
       NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_str_slot,
@@ -83,6 +118,13 @@ static ngx_command_t  ngx_core_commands[] = {
       0,
       NULL },
 
+    { ngx_string("cache_manager_processes"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_core_conf_t, cache_manager_processes),
+      NULL },
+
     { ngx_string("debug_points"),
       NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_enum_slot,
@@ -111,6 +153,20 @@ static ngx_command_t  ngx_core_commands[] = {
       0,
       NULL },
 
+    { ngx_string("worker_numa_memory"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_enum_slot,
+      0,
+      offsetof(ngx_core_conf_t, numa_memory),
+      &ngx_numa_memory },
+
+    { ngx_string("shared_memory_numa"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_enum_slot,
+      0,
+      offsetof(ngx_core_conf_t, numa_shared_memory),
+      &ngx_numa_shared_memory },
+
     { ngx_string("worker_rlimit_nofile"),
       NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_num_slot,
@@ -132,6 +188,17 @@ static ngx_command_t  ngx_core_commands[] = {
       offsetof(ngx_core_conf_t, shutdown_timeout),
       NULL },
 
+#if (NGX_HAVE_MEMFD)
+
+    { ngx_string("temp_file_memory"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_set_temp_file_memory,
+      0,
+      0,
+      NULL },
+
+#endif
+
     { ngx_string("working_directory"),
       NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_str_slot,
@@ -1117,7 +1184,12 @@ ngx_core_module_create_conf(ngx_cycle_t *cycle)
     ccf->shutdown_timeout = NGX_CONF_UNSET_MSEC;
 
     ccf->worker_processes = NGX_CONF_UNSET;
+    ccf->cache_manager_processes = NGX_CONF_UNSET;
     ccf->debug_points = NGX_CONF_UNSET;
+    ccf->pool_cache = NGX_CONF_UNSET;
+    ccf->slab_magazine = NGX_CONF_UNSET;
+    ccf->numa_memory = NGX_CONF_UNSET_UINT;
+    ccf->numa_shared_memory = NGX_CONF_UNSET_UINT;
 
     ccf->rlimit_nofile = NGX_CONF_UNSET;
     ccf->rlimit_core = NGX_CONF_UNSET;
@@ -1146,7 +1218,21 @@ ngx_core_module_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_msec_value(ccf->shutdown_timeout, 0);
 
     ngx_conf_init_value(ccf->worker_processes, 1);
+    ngx_conf_init_value(ccf->cache_manager_processes, 1);
     ngx_conf_init_value(ccf->debug_points, 0);
+    ngx_conf_init_value(ccf->pool_cache, 0);
+    ngx_conf_init_value(ccf->slab_magazine, 0);
+    ngx_conf_init_uint_value(ccf->numa_memory, NGX_NUMA_OFF);
+    ngx_conf_init_uint_value(ccf->numa_shared_memory, 0);
+
+    if (ccf->cache_manager_processes < 1
+        || ccf->cache_manager_processes > NGX_MAX_CACHE_MANAGERS)
+    {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "\"cache_manager_processes\" must be between 1 and %d",
+                      NGX_MAX_CACHE_MANAGERS);
+        return NGX_CONF_ERROR;
+    }
 
 #if (NGX_HAVE_CPU_AFFINITY)
 
@@ -1161,6 +1247,24 @@ ngx_core_module_init_conf(ngx_cycle_t *cycle, void *conf)
                       "using last mask for remaining worker processes");
     }
 
+#endif
+
+#if (NGX_HAVE_NUMA)
+
+    if (ccf->numa_memory != NGX_NUMA_OFF && ccf->cpu_affinity == NULL) {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                      "\"worker_numa_memory\" requires "
+                      "\"worker_cpu_affinity\", ignored");
+    }
+
+#else
+
+    if (ccf->numa_memory != NGX_NUMA_OFF || ccf->numa_shared_memory) {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                      "NUMA memory policies are not supported "
+                      "on this platform, ignored");
+    }
+
 #endif
 
 
@@ -1497,17 +1601,25 @@ ngx_set_cpu_affinity(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
 ngx_cpuset_t *
 ngx_get_cpu_affinity(ngx_uint_t n)
+{
+    ngx_core_conf_t  *ccf;
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
+                                           ngx_core_module);
+
+    return ngx_get_conf_cpu_affinity(ccf, n);
+}
+
+
+ngx_cpuset_t *
+ngx_get_conf_cpu_affinity(ngx_core_conf_t *ccf, ngx_uint_t n)
 {
 #if (NGX_HAVE_CPU_AFFINITY)
     ngx_uint_t        i, j;
     ngx_cpuset_t     *mask;
-    ngx_core_conf_t  *ccf;
 
     static ngx_cpuset_t  result;
 
-    ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
-                                           ngx_core_module);
-
     if (ccf->cpu_affinity == NULL) {
         return NULL;
     }
@@ -1578,6 +1690,79 @@ ngx_set_worker_processes(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+#if (NGX_HAVE_MEMFD)
+
+static char *
+ngx_set_temp_file_memory(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_core_conf_t  *ccf = conf;
+
+    ngx_str_t  *value, name;
+
+    if (ccf->temp_file_zone) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    ccf->temp_file_memory = ngx_parse_offset(&value[1]);
+
+    if (ccf->temp_file_memory == NGX_ERROR) {
+        return "invalid value";
+    }
+
+    if (ccf->temp_file_memory == 0) {
+        return NGX_CONF_OK;
+    }
+
+    /* the memory used by temporary files of all processes */
+
+    ngx_str_set(&name, "temp_file_memory");
+
+    ccf->temp_file_zone = ngx_shared_memory_add(cf, &name, 8 * ngx_pagesize,
+                                                &ngx_core_module);
+    if (ccf->temp_file_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ccf->temp_file_zone->init = ngx_init_temp_file_zone;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_init_temp_file_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_atomic_t     *used;
+    ngx_slab_pool_t  *shpool;
+
+    if (data) {
+        shm_zone->data = data;
+        return NGX_OK;
+    }
+
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        shm_zone->data = shpool->data;
+        return NGX_OK;
+    }
+
+    used = ngx_slab_calloc(shpool, sizeof(ngx_atomic_t));
+    if (used == NULL) {
+        return NGX_ERROR;
+    }
+
+    shpool->data = (void *) used;
+    shm_zone->data = (void *) used;
+
+    return NGX_OK;
+}
+
+#endif
+
+
 static char *
 ngx_load_module(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -68,6 +68,29 @@ typedef struct {
 } ngx_bufs_t;
 
 
+/*
+ * A per-worker region of aligned memory, which directio bufs are
+ * borrowed from and returned to, instead of being allocated from
+ * each request pool; the region is allocated on first use.
+ */
+
+#define NGX_DIRECTIO_POOL_MIN      4096
+#define NGX_DIRECTIO_POOL_CLASSES  16
+
+
+typedef struct {
+    u_char                      *start;
+    u_char                      *last;
+    u_char                      *end;
+    size_t                       size;
+
+    void                        *free[NGX_DIRECTIO_POOL_CLASSES];
+
+    unsigned                     hugepages:1;
+    unsigned                     failed:1;
+} ngx_directio_pool_t;
+
+
 typedef struct ngx_output_chain_ctx_s  ngx_output_chain_ctx_t;
 
 typedef ngx_int_t (*ngx_output_chain_filter_pt)(void *ctx, ngx_chain_t *in);
@@ -99,6 +122,8 @@ struct ngx_output_chain_ctx_s {
 #endif
 
     off_t                        alignment;
+    ngx_directio_pool_t         *directio_pool;
+    size_t                       read_ahead;
 
     ngx_pool_t                  *pool;
     ngx_int_t                    allocated;
@@ -153,6 +178,8 @@ ngx_chain_t *ngx_alloc_chain_link(ngx_pool_t *pool);
 
 ngx_int_t ngx_output_chain(ngx_output_chain_ctx_t *ctx, ngx_chain_t *in);
 ngx_int_t ngx_chain_writer(void *ctx, ngx_chain_t *in);
+ngx_directio_pool_t *ngx_directio_pool_create(ngx_pool_t *pool, size_t size,
+    ngx_uint_t hugepages);
 
 ngx_int_t ngx_chain_add_copy(ngx_pool_t *pool, ngx_chain_t **chain,
     ngx_chain_t *in);
@@ -13,6 +13,7 @@
 ngx_os_io_t  ngx_io;
 
 
+static ngx_connection_t *ngx_get_unused_connection(ngx_cycle_t *cycle);
 static void ngx_drain_connections(ngx_cycle_t *cycle);
 
 
@@ -1085,6 +1086,23 @@ ngx_configure_listening_sockets(ngx_cycle_t *cycle)
 
 #endif
 
+#endif
+
+#if (NGX_HAVE_GRO_CMSG)
+
+        if (ls[i].quic) {
+            value = 1;
+
+            if (setsockopt(ls[i].fd, SOL_UDP, UDP_GRO,
+                           (const void *) &value, sizeof(int))
+                == -1)
+            {
+                ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                              "setsockopt(UDP_GRO) for %V failed, ignored",
+                              &ls[i].addr_text);
+            }
+        }
+
 #endif
     }
 
@@ -1192,7 +1210,13 @@ ngx_get_connection(ngx_socket_t s, ngx_log_t *log)
 
     c = ngx_cycle->free_connections;
 
-    if (c == NULL) {
+    if (c) {
+        ngx_cycle->free_connections = c->data;
+
+    } else if (ngx_cycle->connection_used < ngx_cycle->connection_n) {
+        c = ngx_get_unused_connection((ngx_cycle_t *) ngx_cycle);
+
+    } else {
         ngx_log_error(NGX_LOG_ALERT, log, 0,
                       "%ui worker_connections are not enough",
                       ngx_cycle->connection_n);
@@ -1200,7 +1224,6 @@ ngx_get_connection(ngx_socket_t s, ngx_log_t *log)
         return NULL;
     }
 
-    ngx_cycle->free_connections = c->data;
     ngx_cycle->free_connection_n--;
 
     if (ngx_cycle->files && ngx_cycle->files[s] == NULL) {
@@ -1237,6 +1260,27 @@ ngx_get_connection(ngx_socket_t s, ngx_log_t *log)
 }
 
 
+static ngx_connection_t *
+ngx_get_unused_connection(ngx_cycle_t *cycle)
+{
+    ngx_uint_t         n;
+    ngx_connection_t  *c;
+
+    n = cycle->connection_used++;
+
+    c = &cycle->connections[n];
+
+    c->read = &cycle->read_events[n];
+    c->write = &cycle->write_events[n];
+
+    c->read->closed = 1;
+    c->read->instance = 1;
+    c->write->closed = 1;
+
+    return c;
+}
+
+
 void
 ngx_free_connection(ngx_connection_t *c)
 {
@@ -1434,7 +1478,7 @@ ngx_close_idle_connections(ngx_cycle_t *cycle)
 
     c = cycle->connections;
 
-    for (i = 0; i < cycle->connection_n; i++) {
+    for (i = 0; i < cycle->connection_used; i++) {
 
         /* THREAD: lock */
 
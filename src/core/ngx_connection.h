@@ -52,6 +52,10 @@ struct ngx_listening_s {
     ngx_rbtree_t        rbtree;
     ngx_rbtree_node_t   sentinel;
 
+    ngx_udp_connection_t  **udp_hash;
+    ngx_uint_t              udp_hash_size;
+    ngx_uint_t              udp_hash_nelts;
+
     ngx_uint_t          worker;
 
     unsigned            open:1;
@@ -72,6 +76,7 @@ struct ngx_listening_s {
 #endif
     unsigned            reuseport:1;
     unsigned            add_reuseport:1;
+    unsigned            cpu_steer:1;
     unsigned            keepalive:2;
     unsigned            quic:1;
 
@@ -200,6 +205,10 @@ struct ngx_connection_s {
 #if (NGX_THREADS || NGX_COMPAT)
     ngx_thread_task_t  *sendfile_task;
 #endif
+
+#if (NGX_HAVE_MSG_ZEROCOPY)
+    ngx_linux_zerocopy_t  *zerocopy;
+#endif
 };
 
 
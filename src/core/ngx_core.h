@@ -78,6 +78,7 @@ typedef void (*ngx_connection_handler_pt)(ngx_connection_t *c);
 #include <ngx_rwlock.h>
 #include <ngx_shmtx.h>
 #include <ngx_slab.h>
+#include <ngx_shm_index.h>
 #include <ngx_inet.h>
 #include <ngx_cycle.h>
 #include <ngx_resolver.h>
@@ -94,6 +95,8 @@ typedef void (*ngx_connection_handler_pt)(ngx_connection_t *c);
 #include <ngx_os.h>
 #include <ngx_connection.h>
 #include <ngx_syslog.h>
+#include <ngx_log_ring.h>
+#include <ngx_probe.h>
 #include <ngx_proxy_protocol.h>
 #if (NGX_HAVE_BPF)
 #include <ngx_bpf.h>
@@ -109,6 +112,12 @@ typedef void (*ngx_connection_handler_pt)(ngx_connection_t *c);
 #define ngx_max(val1, val2)  ((val1 < val2) ? (val2) : (val1))
 #define ngx_min(val1, val2)  ((val1 > val2) ? (val2) : (val1))
 
+#define NGX_CPU_SSE42        0x01
+#define NGX_CPU_PCLMUL       0x02
+#define NGX_CPU_ARM_CRC32    0x04
+
+extern ngx_uint_t  ngx_cpu_features;
+
 void ngx_cpuinfo(void);
 
 #if (NGX_HAVE_OPENAT)
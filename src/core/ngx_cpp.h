@@ -0,0 +1,309 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_CPP_H_INCLUDED_
+#define _NGX_CPP_H_INCLUDED_
+
+
+/*
+ * Allocators and RAII helpers for modules written in C++11 or later.
+ * The nginx headers are to be included first, within extern "C":
+ *
+ *     extern "C" {
+ *     #include <ngx_config.h>
+ *     #include <ngx_core.h>
+ *     }
+ *
+ *     #include <ngx_cpp.h>
+ *
+ *     std::vector<ngx_str_t, ngx::pool_allocator<ngx_str_t>>
+ *         v(ngx::pool_allocator<ngx_str_t>(r->pool));
+ *
+ * The allocators throw std::bad_alloc on allocation errors, as standard
+ * containers expect, so exceptions must be caught before returning
+ * to nginx code.
+ */
+
+
+#ifndef __cplusplus
+#error ngx_cpp.h is a C++ header
+#endif
+
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+
+namespace ngx {
+
+
+/*
+ * Memory from a pool is released when the pool is destroyed;
+ * deallocate() only returns large blocks to the system early.
+ */
+
+template <typename T>
+class pool_allocator {
+public:
+    typedef T  value_type;
+
+    explicit pool_allocator(ngx_pool_t *pool) noexcept : pool_(pool) {}
+
+    template <typename U>
+    pool_allocator(const pool_allocator<U> &a) noexcept : pool_(a.pool()) {}
+
+    T *allocate(std::size_t n)
+    {
+        void  *p;
+
+        if (n > (std::size_t) -1 / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+
+        if (alignof(T) > NGX_ALIGNMENT) {
+            p = ngx_pmemalign(pool_, n * sizeof(T), alignof(T));
+
+        } else {
+            p = ngx_palloc(pool_, n * sizeof(T));
+        }
+
+        if (p == NULL) {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept
+    {
+        if (n * sizeof(T) > pool_->max || alignof(T) > NGX_ALIGNMENT) {
+            (void) ngx_pfree(pool_, p);
+        }
+    }
+
+    ngx_pool_t *pool() const noexcept { return pool_; }
+
+private:
+    ngx_pool_t  *pool_;
+};
+
+
+template <typename T, typename U>
+bool
+operator==(const pool_allocator<T> &a, const pool_allocator<U> &b) noexcept
+{
+    return a.pool() == b.pool();
+}
+
+
+template <typename T, typename U>
+bool
+operator!=(const pool_allocator<T> &a, const pool_allocator<U> &b) noexcept
+{
+    return a.pool() != b.pool();
+}
+
+
+/*
+ * Memory from a shared memory zone.  The zone is mapped at the same
+ * address in all worker processes, so containers which are themselves
+ * placed in the zone may be used by all of them under the zone mutex.
+ * With Locked set, the caller is expected to hold the mutex already,
+ * see slab_lock below.
+ */
+
+template <typename T, bool Locked = false>
+class slab_allocator {
+public:
+    typedef T  value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef slab_allocator<U, Locked>  other;
+    };
+
+    explicit slab_allocator(ngx_slab_pool_t *shpool) noexcept
+        : shpool_(shpool) {}
+
+    template <typename U>
+    slab_allocator(const slab_allocator<U, Locked> &a) noexcept
+        : shpool_(a.shpool()) {}
+
+    T *allocate(std::size_t n)
+    {
+        void  *p;
+
+        static_assert(alignof(T) <= NGX_ALIGNMENT,
+                      "slab allocations are aligned to NGX_ALIGNMENT only");
+
+        if (n > (std::size_t) -1 / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+
+        if (Locked) {
+            p = ngx_slab_alloc_locked(shpool_, n * sizeof(T));
+
+        } else {
+            p = ngx_slab_alloc(shpool_, n * sizeof(T));
+        }
+
+        if (p == NULL) {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, std::size_t) noexcept
+    {
+        if (Locked) {
+            ngx_slab_free_locked(shpool_, p);
+
+        } else {
+            ngx_slab_free(shpool_, p);
+        }
+    }
+
+    ngx_slab_pool_t *shpool() const noexcept { return shpool_; }
+
+private:
+    ngx_slab_pool_t  *shpool_;
+};
+
+
+template <typename T, typename U, bool Locked>
+bool
+operator==(const slab_allocator<T, Locked> &a,
+    const slab_allocator<U, Locked> &b) noexcept
+{
+    return a.shpool() == b.shpool();
+}
+
+
+template <typename T, typename U, bool Locked>
+bool
+operator!=(const slab_allocator<T, Locked> &a,
+    const slab_allocator<U, Locked> &b) noexcept
+{
+    return a.shpool() != b.shpool();
+}
+
+
+template <typename T>
+void
+pool_cleanup_destroy(void *data)
+{
+    static_cast<T *>(data)->~T();
+}
+
+
+/*
+ * Constructs an object in a pool; its destructor is called by a pool
+ * cleanup handler when the pool is destroyed.  No cleanup is added for
+ * types with trivial destructors.  Returns NULL on allocation errors.
+ */
+
+template <typename T, typename... Args>
+T *
+pool_new(ngx_pool_t *pool, Args&&... args)
+{
+    void                *p;
+    ngx_pool_cleanup_t  *cln;
+
+    if (std::is_trivially_destructible<T>::value) {
+        p = ngx_palloc(pool, sizeof(T));
+        if (p == NULL) {
+            return NULL;
+        }
+
+        return new (p) T(std::forward<Args>(args)...);
+    }
+
+    cln = ngx_pool_cleanup_add(pool, sizeof(T));
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    /* the handler is only set once the object is fully constructed */
+
+    p = new (cln->data) T(std::forward<Args>(args)...);
+
+    cln->handler = pool_cleanup_destroy<T>;
+
+    return static_cast<T *>(p);
+}
+
+
+/* owns a pool, e.g. a temporary one, and destroys it */
+
+class pool {
+public:
+    explicit pool(ngx_pool_t *p = NULL) noexcept : pool_(p) {}
+
+    ~pool() { reset(); }
+
+    pool(const pool &) = delete;
+    pool &operator=(const pool &) = delete;
+
+    pool(pool &&p) noexcept : pool_(p.release()) {}
+
+    pool &operator=(pool &&p) noexcept
+    {
+        reset(p.release());
+        return *this;
+    }
+
+    ngx_pool_t *get() const noexcept { return pool_; }
+
+    ngx_pool_t *release() noexcept
+    {
+        ngx_pool_t  *p = pool_;
+
+        pool_ = NULL;
+        return p;
+    }
+
+    void reset(ngx_pool_t *p = NULL) noexcept
+    {
+        if (pool_) {
+            ngx_destroy_pool(pool_);
+        }
+
+        pool_ = p;
+    }
+
+    explicit operator bool() const noexcept { return pool_ != NULL; }
+
+private:
+    ngx_pool_t  *pool_;
+};
+
+
+/* holds the mutex of a shared memory zone for the scope */
+
+class slab_lock {
+public:
+    explicit slab_lock(ngx_slab_pool_t *shpool) noexcept : shpool_(shpool)
+    {
+        ngx_shmtx_lock(&shpool_->mutex);
+    }
+
+    ~slab_lock() { ngx_shmtx_unlock(&shpool_->mutex); }
+
+    slab_lock(const slab_lock &) = delete;
+    slab_lock &operator=(const slab_lock &) = delete;
+
+private:
+    ngx_slab_pool_t  *shpool_;
+};
+
+
+} /* namespace ngx */
+
+
+#endif /* _NGX_CPP_H_INCLUDED_ */
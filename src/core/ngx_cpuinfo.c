@@ -8,6 +8,17 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 
+#if (NGX_HAVE_ARM_CRC32 && NGX_LINUX)
+#include <sys/auxv.h>
+
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32  (1 << 7)
+#endif
+#endif
+
+
+ngx_uint_t  ngx_cpu_features;
+
 
 #if (( __i386__ || __amd64__ ) && ( __GNUC__ || __INTEL_COMPILER ))
 
@@ -67,7 +78,10 @@ ngx_cpuid(uint32_t i, uint32_t *buf)
 #endif
 
 
-/* auto detect the L2 cache line size of modern and widespread CPUs */
+/*
+ * auto detect the L2 cache line size of modern and widespread CPUs,
+ * and the instruction set extensions used for hashing
+ */
 
 void
 ngx_cpuinfo(void)
@@ -91,6 +105,14 @@ ngx_cpuinfo(void)
 
     ngx_cpuid(1, cpu);
 
+    if (cpu[3] & (1 << 20)) {
+        ngx_cpu_features |= NGX_CPU_SSE42;
+    }
+
+    if (cpu[3] & (1 << 1)) {
+        ngx_cpu_features |= NGX_CPU_PCLMUL;
+    }
+
     if (ngx_strcmp(vendor, "GenuineIntel") == 0) {
 
         switch ((cpu[0] & 0xf00) >> 8) {
@@ -133,6 +155,19 @@ ngx_cpuinfo(void)
 void
 ngx_cpuinfo(void)
 {
+#if (NGX_HAVE_ARM_CRC32 && NGX_LINUX)
+
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        ngx_cpu_features |= NGX_CPU_ARM_CRC32;
+    }
+
+#elif (NGX_HAVE_ARM_CRC32 && NGX_DARWIN)
+
+    /* all Apple ARM CPUs support CRC32 instructions */
+
+    ngx_cpu_features |= NGX_CPU_ARM_CRC32;
+
+#endif
 }
 
 
@@ -8,6 +8,13 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 
+#if (NGX_HAVE_PCLMUL)
+#include <wmmintrin.h>
+#include <nmmintrin.h>
+#elif (NGX_HAVE_ARM_CRC32)
+#include <arm_acle.h>
+#endif
+
 
 /*
  * The code and lookup tables are based on the algorithm
@@ -102,10 +109,66 @@ uint32_t  ngx_crc32_table256[] = {
 uint32_t *ngx_crc32_table_short = ngx_crc32_table16;
 
 
+/*
+ * CRC32C uses the Castagnoli polynomial, which is supported by the SSE4.2
+ * crc32 instruction; it is used for hashes which are only kept in memory
+ */
+
+static uint32_t  ngx_crc32c_table256[256];
+
+
+static uint32_t ngx_crc32c_sw(u_char *p, size_t len);
+
+#if (NGX_HAVE_PCLMUL)
+static uint32_t ngx_crc32_pclmul(uint32_t crc, u_char *p, size_t len);
+static uint32_t ngx_crc32c_sse42(u_char *p, size_t len);
+#elif (NGX_HAVE_ARM_CRC32 && NGX_HAVE_LITTLE_ENDIAN)
+static uint32_t ngx_crc32_armv8(uint32_t crc, u_char *p, size_t len);
+static uint32_t ngx_crc32c_armv8(u_char *p, size_t len);
+#endif
+
+
+uint32_t  (*ngx_crc32_fast)(uint32_t crc, u_char *p, size_t len);
+uint32_t  (*ngx_crc32c)(u_char *p, size_t len) = ngx_crc32c_sw;
+
+
 ngx_int_t
 ngx_crc32_table_init(void)
 {
-    void  *p;
+    void        *p;
+    uint32_t     c;
+    ngx_uint_t   i, k;
+
+    for (i = 0; i < 256; i++) {
+        c = (uint32_t) i;
+
+        for (k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : (c >> 1);
+        }
+
+        ngx_crc32c_table256[i] = c;
+    }
+
+    /* ngx_cpu_features are set by ngx_cpuinfo() in ngx_os_init() */
+
+#if (NGX_HAVE_PCLMUL)
+
+    if (ngx_cpu_features & NGX_CPU_PCLMUL) {
+        ngx_crc32_fast = ngx_crc32_pclmul;
+    }
+
+    if (ngx_cpu_features & NGX_CPU_SSE42) {
+        ngx_crc32c = ngx_crc32c_sse42;
+    }
+
+#elif (NGX_HAVE_ARM_CRC32 && NGX_HAVE_LITTLE_ENDIAN)
+
+    if (ngx_cpu_features & NGX_CPU_ARM_CRC32) {
+        ngx_crc32_fast = ngx_crc32_armv8;
+        ngx_crc32c = ngx_crc32c_armv8;
+    }
+
+#endif
 
     if (((uintptr_t) ngx_crc32_table_short
           & ~((uintptr_t) ngx_cacheline_size - 1))
@@ -127,3 +190,216 @@ ngx_crc32_table_init(void)
 
     return NGX_OK;
 }
+
+
+static uint32_t
+ngx_crc32c_sw(u_char *p, size_t len)
+{
+    uint32_t  crc;
+
+    crc = 0xffffffff;
+
+    while (len--) {
+        crc = ngx_crc32c_table256[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xffffffff;
+}
+
+
+#if (NGX_HAVE_PCLMUL)
+
+/*
+ * CRC32 of 64 bytes and more by folding 4 blocks of 16 bytes in parallel
+ * with carry-less multiplication, see "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" by Intel; the constants are
+ * for the bit-reflected polynomial 0x104c11db7
+ */
+
+__attribute__((target("pclmul,sse4.2")))
+static uint32_t
+ngx_crc32_pclmul(uint32_t crc, u_char *p, size_t len)
+{
+    __m128i  x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8, k;
+
+    x1 = _mm_loadu_si128((__m128i *) (p + 0x00));
+    x2 = _mm_loadu_si128((__m128i *) (p + 0x10));
+    x3 = _mm_loadu_si128((__m128i *) (p + 0x20));
+    x4 = _mm_loadu_si128((__m128i *) (p + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+
+    k = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+
+    p += 64;
+    len -= 64;
+
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+
+        y5 = _mm_loadu_si128((__m128i *) (p + 0x00));
+        y6 = _mm_loadu_si128((__m128i *) (p + 0x10));
+        y7 = _mm_loadu_si128((__m128i *) (p + 0x20));
+        y8 = _mm_loadu_si128((__m128i *) (p + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        p += 64;
+        len -= 64;
+    }
+
+    /* fold 4 blocks into one */
+
+    k = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((__m128i *) p);
+
+        x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        p += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits to 64 bits */
+
+    x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    k = _mm_set_epi64x(0, 0x0163cd6124);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+
+    k = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    crc = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+
+    while (len--) {
+        crc = ngx_crc32_table256[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+__attribute__((target("sse4.2")))
+static uint32_t
+ngx_crc32c_sse42(u_char *p, size_t len)
+{
+#if (__x86_64__)
+    uint64_t  v, crc;
+#else
+    uint32_t  v, crc;
+#endif
+
+    crc = 0xffffffff;
+
+    while (len >= sizeof(v)) {
+        ngx_memcpy(&v, p, sizeof(v));
+
+#if (__x86_64__)
+        crc = _mm_crc32_u64(crc, v);
+#else
+        crc = _mm_crc32_u32(crc, v);
+#endif
+
+        p += sizeof(v);
+        len -= sizeof(v);
+    }
+
+    while (len--) {
+        crc = _mm_crc32_u8((uint32_t) crc, *p++);
+    }
+
+    return (uint32_t) crc ^ 0xffffffff;
+}
+
+
+#elif (NGX_HAVE_ARM_CRC32 && NGX_HAVE_LITTLE_ENDIAN)
+
+
+__attribute__((target("+crc")))
+static uint32_t
+ngx_crc32_armv8(uint32_t crc, u_char *p, size_t len)
+{
+    uint64_t  v;
+
+    while (len >= 8) {
+        ngx_memcpy(&v, p, 8);
+        crc = __crc32d(crc, v);
+
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = __crc32b(crc, *p++);
+    }
+
+    return crc;
+}
+
+
+__attribute__((target("+crc")))
+static uint32_t
+ngx_crc32c_armv8(u_char *p, size_t len)
+{
+    uint32_t  crc;
+    uint64_t  v;
+
+    crc = 0xffffffff;
+
+    while (len >= 8) {
+        ngx_memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = __crc32cb(crc, *p++);
+    }
+
+    return crc ^ 0xffffffff;
+}
+
+#endif
@@ -13,9 +13,18 @@
 #include <ngx_core.h>
 
 
+/* PCLMUL folding needs at least 64 bytes */
+#define NGX_CRC32_FAST_MIN  64
+
+
 extern uint32_t  *ngx_crc32_table_short;
 extern uint32_t   ngx_crc32_table256[];
 
+/* set if the CPU supports CRC32 in hardware, same results as the tables */
+extern uint32_t  (*ngx_crc32_fast)(uint32_t crc, u_char *p, size_t len);
+
+extern uint32_t  (*ngx_crc32c)(u_char *p, size_t len);
+
 
 static ngx_inline uint32_t
 ngx_crc32_short(u_char *p, size_t len)
@@ -40,6 +49,10 @@ ngx_crc32_long(u_char *p, size_t len)
 {
     uint32_t  crc;
 
+    if (len >= NGX_CRC32_FAST_MIN && ngx_crc32_fast) {
+        return ngx_crc32_fast(0xffffffff, p, len) ^ 0xffffffff;
+    }
+
     crc = 0xffffffff;
 
     while (len--) {
@@ -59,6 +72,11 @@ ngx_crc32_update(uint32_t *crc, u_char *p, size_t len)
 {
     uint32_t  c;
 
+    if (len >= NGX_CRC32_FAST_MIN && ngx_crc32_fast) {
+        *crc = ngx_crc32_fast(*crc, p, len);
+        return;
+    }
+
     c = *crc;
 
     while (len--) {
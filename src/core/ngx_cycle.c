@@ -46,7 +46,7 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
     ngx_conf_t           conf;
     ngx_pool_t          *pool;
     ngx_cycle_t         *cycle, **old;
-    ngx_shm_zone_t      *shm_zone, *oshm_zone;
+    ngx_shm_zone_t      *shm_zone, *oshm_zone, *resized;
     ngx_list_part_t     *part, *opart;
     ngx_open_file_t     *file;
     ngx_listening_t     *ls, *nls;
@@ -434,6 +434,9 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
         }
 
         shm_zone[i].shm.log = cycle->log;
+        shm_zone[i].shm.interleave = ccf->numa_shared_memory;
+
+        resized = NULL;
 
         opart = &old_cycle->shared_memory.part;
         oshm_zone = opart->elts;
@@ -469,6 +472,9 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
 #if (NGX_WIN32)
                 shm_zone[i].shm.handle = oshm_zone[n].shm.handle;
 #endif
+#if (NGX_HAVE_MAP_HUGETLB)
+                shm_zone[i].shm.huge_size = oshm_zone[n].shm.huge_size;
+#endif
 
                 if (shm_zone[i].init(&shm_zone[i], oshm_zone[n].data)
                     != NGX_OK)
@@ -479,6 +485,12 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
                 goto shm_zone_found;
             }
 
+            if (shm_zone[i].tag == oshm_zone[n].tag
+                && shm_zone[i].resize)
+            {
+                resized = &oshm_zone[n];
+            }
+
             break;
         }
 
@@ -494,6 +506,12 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
             goto failed;
         }
 
+        /* the old zone is still mapped, its state is copied */
+
+        if (resized && shm_zone[i].resize(&shm_zone[i], resized) != NGX_OK) {
+            goto failed;
+        }
+
     shm_zone_found:
 
         continue;
@@ -1354,7 +1372,11 @@ ngx_shared_memory_add(ngx_conf_t *cf, ngx_str_t *name, size_t size, void *tag)
     shm_zone->shm.size = size;
     shm_zone->shm.name = *name;
     shm_zone->shm.exists = 0;
+    shm_zone->shm.hugepages = 0;
+    shm_zone->shm.interleave = 0;
     shm_zone->init = NULL;
+    shm_zone->defrag = NULL;
+    shm_zone->resize = NULL;
     shm_zone->tag = tag;
     shm_zone->noreuse = 0;
 
@@ -1385,7 +1407,7 @@ ngx_clean_old_cycles(ngx_event_t *ev)
 
         found = 0;
 
-        for (n = 0; n < cycle[i]->connection_n; n++) {
+        for (n = 0; n < cycle[i]->connection_used; n++) {
             if (cycle[i]->connections[n].fd != (ngx_socket_t) -1) {
                 found = 1;
 
@@ -1448,7 +1470,7 @@ ngx_shutdown_timer_handler(ngx_event_t *ev)
 
     c = cycle->connections;
 
-    for (i = 0; i < cycle->connection_n; i++) {
+    for (i = 0; i < cycle->connection_used; i++) {
 
         if (c[i].fd == (ngx_socket_t) -1
             || c[i].read == NULL
@@ -22,14 +22,22 @@
 #define NGX_DEBUG_POINTS_ABORT  2
 
 
+#define NGX_MAX_CACHE_MANAGERS  32
+
+
 typedef struct ngx_shm_zone_s  ngx_shm_zone_t;
 
 typedef ngx_int_t (*ngx_shm_zone_init_pt) (ngx_shm_zone_t *zone, void *data);
+typedef void (*ngx_shm_zone_defrag_pt) (ngx_shm_zone_t *zone);
+typedef ngx_int_t (*ngx_shm_zone_resize_pt) (ngx_shm_zone_t *zone,
+    ngx_shm_zone_t *ozone);
 
 struct ngx_shm_zone_s {
     void                     *data;
     ngx_shm_t                 shm;
     ngx_shm_zone_init_pt      init;
+    ngx_shm_zone_defrag_pt    defrag;
+    ngx_shm_zone_resize_pt    resize;
     void                     *tag;
     void                     *sync;
     ngx_uint_t                noreuse;  /* unsigned  noreuse:1; */
@@ -68,6 +76,7 @@ struct ngx_cycle_s {
     ngx_list_t                shared_memory;
 
     ngx_uint_t                connection_n;
+    ngx_uint_t                connection_used;
     ngx_uint_t                files_n;
 
     ngx_connection_t         *connections;
@@ -94,8 +103,12 @@ typedef struct {
     ngx_msec_t                shutdown_timeout;
 
     ngx_int_t                 worker_processes;
+    ngx_int_t                 cache_manager_processes;
     ngx_int_t                 debug_points;
 
+    ngx_int_t                 pool_cache;
+    ngx_int_t                 slab_magazine;
+
     ngx_int_t                 rlimit_nofile;
     off_t                     rlimit_core;
 
@@ -105,6 +118,14 @@ typedef struct {
     ngx_uint_t                cpu_affinity_n;
     ngx_cpuset_t             *cpu_affinity;
 
+    ngx_uint_t                numa_memory;
+    ngx_uint_t                numa_shared_memory;
+
+#if (NGX_HAVE_MEMFD)
+    off_t                     temp_file_memory;
+    ngx_shm_zone_t           *temp_file_zone;
+#endif
+
     char                     *username;
     ngx_uid_t                 user;
     ngx_gid_t                 group;
@@ -133,6 +154,7 @@ void ngx_reopen_files(ngx_cycle_t *cycle, ngx_uid_t user);
 char **ngx_set_environment(ngx_cycle_t *cycle, ngx_uint_t *last);
 ngx_pid_t ngx_exec_new_binary(ngx_cycle_t *cycle, char *const *argv);
 ngx_cpuset_t *ngx_get_cpu_affinity(ngx_uint_t n);
+ngx_cpuset_t *ngx_get_conf_cpu_affinity(ngx_core_conf_t *ccf, ngx_uint_t n);
 ngx_shm_zone_t *ngx_shared_memory_add(ngx_conf_t *cf, ngx_str_t *name,
     size_t size, void *tag);
 void ngx_set_shutdown_timer(ngx_cycle_t *cycle);
@@ -10,6 +10,12 @@
 
 
 static ngx_int_t ngx_test_full_name(ngx_str_t *name);
+#if (NGX_HAVE_MEMFD)
+static ngx_int_t ngx_temp_file_memory(ngx_temp_file_t *tf, ngx_chain_t *chain);
+static ngx_int_t ngx_create_temp_memory_file(ngx_temp_file_t *tf);
+static ngx_int_t ngx_temp_file_spill(ngx_temp_file_t *tf);
+static void ngx_temp_file_memory_cleanup(void *data);
+#endif
 
 
 static ngx_atomic_t   temp_number = 0;
@@ -110,6 +116,12 @@ ngx_write_chain_to_temp_file(ngx_temp_file_t *tf, ngx_chain_t *chain)
 {
     ngx_int_t  rc;
 
+#if (NGX_HAVE_MEMFD)
+    if (ngx_temp_file_memory(tf, chain) == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+#endif
+
     if (tf->file.fd == NGX_INVALID_FILE) {
         rc = ngx_create_temp_file(&tf->file, tf->path, tf->pool,
                                   tf->persistent, tf->clean, tf->access);
@@ -137,6 +149,300 @@ ngx_write_chain_to_temp_file(ngx_temp_file_t *tf, ngx_chain_t *chain)
 }
 
 
+/*
+ * The read ahead window of a file starts small and is doubled up to
+ * file->prefetch_max while the file is read sequentially, the next
+ * window being requested when a half of the previous one is consumed.
+ * Any other access resets the window, so seeks and ranges only read
+ * the data needed.  The data past "last" is not going to be sent.
+ */
+
+void
+ngx_file_read_ahead(ngx_file_t *file, off_t offset, size_t size, off_t last)
+{
+    off_t   start, end;
+    size_t  n;
+
+    if (file->prefetch_max == 0 || file->directio) {
+        return;
+    }
+
+    end = offset + size;
+
+    if (offset < file->prefetch_start || offset > file->prefetch_next) {
+
+        /* random access */
+
+        ngx_log_debug2(NGX_LOG_DEBUG_CORE, file->log, 0,
+                       "read ahead reset: %O, expected %O",
+                       offset, file->prefetch_next);
+
+        file->prefetch = 0;
+        file->prefetch_last = end;
+
+        goto done;
+    }
+
+    if (end + (off_t) (file->prefetch / 2) < file->prefetch_last) {
+        goto done;
+    }
+
+    start = ngx_max(file->prefetch_last, end);
+
+    if (start >= last) {
+        goto done;
+    }
+
+    n = file->prefetch ? file->prefetch * 2 : NGX_FILE_READ_AHEAD_MIN;
+    n = ngx_min(n, file->prefetch_max);
+    n = (size_t) ngx_min((off_t) n, last - start);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_CORE, file->log, 0,
+                   "read ahead \"%V\": %O, %uz", &file->name, start, n);
+
+    if (ngx_prefetch_file(file->fd, start, n) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_NOTICE, file->log, ngx_errno,
+                      ngx_prefetch_file_n " \"%V\" failed", &file->name);
+
+        file->prefetch_max = 0;
+        return;
+    }
+
+    file->prefetch = n;
+    file->prefetch_last = start + n;
+
+done:
+
+    file->prefetch_start = offset;
+    file->prefetch_next = end;
+}
+
+
+#if (NGX_HAVE_MEMFD)
+
+/*
+ * temporary files which are not kept are created in memory as long as
+ * the files of all processes fit into temp_file_memory; a file which does
+ * not fit anymore is copied to disk under the same descriptor, so buffers
+ * and operations in progress are not affected
+ */
+
+static ngx_int_t
+ngx_temp_file_memory(ngx_temp_file_t *tf, ngx_chain_t *chain)
+{
+    off_t              size;
+    ngx_atomic_t      *used;
+    ngx_chain_t       *cl;
+    ngx_core_conf_t   *ccf;
+    ngx_atomic_uint_t  n;
+
+    if (tf->persistent
+        || (tf->file.fd != NGX_INVALID_FILE && !tf->in_memory))
+    {
+        return NGX_DECLINED;
+    }
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
+                                           ngx_core_module);
+
+    if (ccf->temp_file_zone == NULL) {
+        return NGX_DECLINED;
+    }
+
+    used = ccf->temp_file_zone->data;
+
+    size = tf->offset;
+
+    for (cl = chain; cl; cl = cl->next) {
+        size += ngx_buf_size(cl->buf);
+    }
+
+    size -= tf->memory;
+
+    if (size > 0) {
+        n = ngx_atomic_fetch_add(used, (ngx_atomic_int_t) size);
+
+        if ((off_t) n + size > ccf->temp_file_memory) {
+            (void) ngx_atomic_fetch_add(used, (ngx_atomic_int_t) -size);
+
+            if (tf->in_memory) {
+                return ngx_temp_file_spill(tf);
+            }
+
+            return NGX_DECLINED;
+        }
+
+        tf->memory += size;
+    }
+
+    if (tf->file.fd == NGX_INVALID_FILE
+        && ngx_create_temp_memory_file(tf) != NGX_OK)
+    {
+        (void) ngx_atomic_fetch_add(used, (ngx_atomic_int_t) -tf->memory);
+        tf->memory = 0;
+
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_create_temp_memory_file(ngx_temp_file_t *tf)
+{
+    ngx_fd_t                  fd;
+    ngx_pool_cleanup_t       *cln, *mcln;
+    ngx_pool_cleanup_file_t  *clnf;
+
+    cln = ngx_pool_cleanup_add(tf->pool, sizeof(ngx_pool_cleanup_file_t));
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    mcln = ngx_pool_cleanup_add(tf->pool, 0);
+    if (mcln == NULL) {
+        return NGX_ERROR;
+    }
+
+    fd = memfd_create("nginx", MFD_CLOEXEC);
+
+    if (fd == -1) {
+        ngx_log_error(NGX_LOG_ALERT, tf->file.log, ngx_errno,
+                      "memfd_create() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_str_set(&tf->file.name, "[memory]");
+
+    tf->file.fd = fd;
+    tf->in_memory = 1;
+
+    /* the descriptor may be closed early by ngx_pool_run_cleanup_file() */
+
+    cln->handler = ngx_pool_cleanup_file;
+    clnf = cln->data;
+
+    clnf->fd = fd;
+    clnf->name = tf->file.name.data;
+    clnf->log = tf->pool->log;
+
+    mcln->handler = ngx_temp_file_memory_cleanup;
+    mcln->data = tf;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, tf->file.log, 0,
+                   "temp memory fd:%d", fd);
+
+    if (tf->log_level) {
+        ngx_log_error(tf->log_level, tf->file.log, 0, "%s in memory",
+                      tf->warn);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_temp_file_spill(ngx_temp_file_t *tf)
+{
+    off_t             offset;
+    ssize_t           n;
+    ngx_file_t        file;
+    ngx_atomic_t     *used;
+    ngx_core_conf_t  *ccf;
+
+    ngx_memzero(&file, sizeof(ngx_file_t));
+
+    file.fd = NGX_INVALID_FILE;
+    file.log = tf->file.log;
+
+    /* the file is not persistent, and thus is already unlinked */
+
+    if (ngx_create_temp_file(&file, tf->path, tf->pool, 0, 0, tf->access)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    offset = 0;
+
+    while (offset < tf->memory) {
+        n = sendfile(file.fd, tf->file.fd, &offset,
+                     (size_t) (tf->memory - offset));
+
+        if (n == -1) {
+            if (ngx_errno == NGX_EINTR) {
+                continue;
+            }
+
+            ngx_log_error(NGX_LOG_CRIT, tf->file.log, ngx_errno,
+                          "sendfile() to \"%s\" failed", file.name.data);
+            ngx_pool_run_cleanup_file(tf->pool, file.fd);
+            return NGX_ERROR;
+        }
+
+        if (n == 0) {
+            break;
+        }
+    }
+
+    if (dup2(file.fd, tf->file.fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, tf->file.log, ngx_errno,
+                      "dup2(%d, %d) failed", file.fd, tf->file.fd);
+        ngx_pool_run_cleanup_file(tf->pool, file.fd);
+        return NGX_ERROR;
+    }
+
+    ngx_pool_run_cleanup_file(tf->pool, file.fd);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, tf->file.log, 0,
+                   "temp memory spill: %O to \"%s\"",
+                   tf->memory, file.name.data);
+
+    if (tf->log_level) {
+        ngx_log_error(tf->log_level, tf->file.log, 0, "%s %V",
+                      tf->warn, &file.name);
+    }
+
+    tf->file.name = file.name;
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
+                                           ngx_core_module);
+    used = ccf->temp_file_zone->data;
+
+    (void) ngx_atomic_fetch_add(used, (ngx_atomic_int_t) -tf->memory);
+
+    tf->memory = 0;
+    tf->in_memory = 0;
+
+    return NGX_DECLINED;
+}
+
+
+static void
+ngx_temp_file_memory_cleanup(void *data)
+{
+    ngx_temp_file_t  *tf = data;
+
+    ngx_atomic_t     *used;
+    ngx_core_conf_t  *ccf;
+
+    if (tf->memory == 0) {
+        return;
+    }
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
+                                           ngx_core_module);
+    used = ccf->temp_file_zone->data;
+
+    (void) ngx_atomic_fetch_add(used, (ngx_atomic_int_t) -tf->memory);
+
+    tf->memory = 0;
+}
+
+#endif
+
+
 ngx_int_t
 ngx_create_temp_file(ngx_file_t *file, ngx_path_t *path, ngx_pool_t *pool,
     ngx_uint_t persistent, ngx_uint_t clean, ngx_uint_t access)
@@ -803,6 +1109,9 @@ ngx_copy_file(u_char *from, u_char *to, ngx_copy_file_t *cf)
     ngx_int_t         rc;
     ngx_uint_t        access;
     ngx_file_info_t   fi;
+#if (NGX_HAVE_COPY_FILE_RANGE)
+    ngx_err_t         err;
+#endif
 
     rc = NGX_ERROR;
     buf = NULL;
@@ -834,17 +1143,6 @@ ngx_copy_file(u_char *from, u_char *to, ngx_copy_file_t *cf)
         time = (cf->time != -1) ? cf->time : ngx_file_mtime(&fi);
     }
 
-    len = cf->buf_size ? cf->buf_size : 65536;
-
-    if ((off_t) len > size) {
-        len = (size_t) size;
-    }
-
-    buf = ngx_alloc(len, cf->log);
-    if (buf == NULL) {
-        goto failed;
-    }
-
     nfd = ngx_open_file(to, NGX_FILE_WRONLY, NGX_FILE_TRUNCATE, access);
 
     if (nfd == NGX_INVALID_FILE) {
@@ -853,6 +1151,81 @@ ngx_copy_file(u_char *from, u_char *to, ngx_copy_file_t *cf)
         goto failed;
     }
 
+#if (NGX_HAVE_FICLONE)
+
+    /* a reflink shares the data blocks if the file system supports it */
+
+    if (size > 0) {
+        if (ngx_clone_file(fd, nfd, size) != NGX_FILE_ERROR) {
+            size = 0;
+
+        } else {
+            ngx_log_debug2(NGX_LOG_DEBUG_CORE, cf->log, ngx_errno,
+                           ngx_clone_file_n " \"%s\" to \"%s\" failed",
+                           from, to);
+        }
+    }
+
+#endif
+
+#if (NGX_HAVE_COPY_FILE_RANGE)
+
+    /*
+     * the data are copied by the kernel; if this is not supported,
+     * for example, between file systems, the copy continues with
+     * read() and write() from the current file offsets
+     */
+
+    while (size > 0) {
+
+        len = (size > NGX_MAX_INT32_VALUE) ? NGX_MAX_INT32_VALUE
+                                           : (size_t) size;
+
+        n = ngx_copy_file_range(fd, nfd, len);
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EXDEV || err == NGX_EINVAL || err == NGX_ENOSYS
+                || err == NGX_EOPNOTSUPP)
+            {
+                ngx_log_debug2(NGX_LOG_DEBUG_CORE, cf->log, err,
+                               ngx_copy_file_range_n
+                               " \"%s\" to \"%s\" failed", from, to);
+                break;
+            }
+
+            ngx_log_error(NGX_LOG_ALERT, cf->log, err,
+                          ngx_copy_file_range_n " \"%s\" to \"%s\" failed",
+                          from, to);
+            goto failed;
+        }
+
+        if (n == 0) {
+            ngx_log_error(NGX_LOG_ALERT, cf->log, 0,
+                          ngx_copy_file_range_n " \"%s\" reached end of file, "
+                          "%O bytes left", from, size);
+            goto failed;
+        }
+
+        size -= n;
+    }
+
+#endif
+
+    len = cf->buf_size ? cf->buf_size : 65536;
+
+    if ((off_t) len > size) {
+        len = (size_t) size;
+    }
+
+    if (size > 0) {
+        buf = ngx_alloc(len, cf->log);
+        if (buf == NULL) {
+            goto failed;
+        }
+    }
+
     while (size > 0) {
 
         if ((off_t) len > size) {
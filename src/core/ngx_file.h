@@ -34,6 +34,12 @@ struct ngx_file_s {
     ngx_event_aio_t           *aio;
 #endif
 
+    off_t                      prefetch_start;
+    off_t                      prefetch_next;
+    off_t                      prefetch_last;
+    size_t                     prefetch;
+    size_t                     prefetch_max;
+
     unsigned                   valid_info:1;
     unsigned                   directio:1;
 };
@@ -41,6 +47,8 @@ struct ngx_file_s {
 
 #define NGX_MAX_PATH_LEVEL  3
 
+#define NGX_FILE_READ_AHEAD_MIN  (128 * 1024)
+
 
 typedef ngx_msec_t (*ngx_path_manager_pt) (void *data);
 typedef ngx_msec_t (*ngx_path_purger_pt) (void *data);
@@ -81,6 +89,12 @@ typedef struct {
     unsigned                   persistent:1;
     unsigned                   clean:1;
     unsigned                   thread_write:1;
+
+#if (NGX_HAVE_MEMFD)
+    /* the size accounted against temp_file_memory */
+    off_t                      memory;
+    unsigned                   in_memory:1;
+#endif
 } ngx_temp_file_t;
 
 
@@ -136,6 +150,8 @@ ngx_int_t ngx_get_full_name(ngx_pool_t *pool, ngx_str_t *prefix,
     ngx_str_t *name);
 
 ssize_t ngx_write_chain_to_temp_file(ngx_temp_file_t *tf, ngx_chain_t *chain);
+void ngx_file_read_ahead(ngx_file_t *file, off_t offset, size_t size,
+    off_t last);
 ngx_int_t ngx_create_temp_file(ngx_file_t *file, ngx_path_t *path,
     ngx_pool_t *pool, ngx_uint_t persistent, ngx_uint_t clean,
     ngx_uint_t access);
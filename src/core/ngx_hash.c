@@ -254,7 +254,8 @@ ngx_hash_init(ngx_hash_init_t *hinit, ngx_hash_key_t *names, ngx_uint_t nelts)
     u_char          *elts;
     size_t           len;
     u_short         *test;
-    ngx_uint_t       i, n, key, size, start, bucket_size;
+    ngx_uint_t       i, n, key, size, start, step, bucket_size, total,
+                     work;
     ngx_hash_elt_t  *elt, **buckets;
 
     if (hinit->max_size == 0) {
@@ -273,11 +274,15 @@ ngx_hash_init(ngx_hash_init_t *hinit, ngx_hash_key_t *names, ngx_uint_t nelts)
         return NGX_ERROR;
     }
 
+    total = 0;
+
     for (n = 0; n < nelts; n++) {
         if (names[n].key.data == NULL) {
             continue;
         }
 
+        total += NGX_HASH_ELT_SIZE(&names[n]);
+
         if (hinit->bucket_size < NGX_HASH_ELT_SIZE(&names[n]) + sizeof(void *))
         {
             ngx_log_error(NGX_LOG_EMERG, hinit->pool->log, 0,
@@ -296,13 +301,29 @@ ngx_hash_init(ngx_hash_init_t *hinit, ngx_hash_key_t *names, ngx_uint_t nelts)
     bucket_size = hinit->bucket_size - sizeof(void *);
 
     start = nelts / (bucket_size / (2 * sizeof(void *)));
+
+    /* smaller hashes cannot hold all the elements */
+
+    start = ngx_max(start, (total + bucket_size - 1) / bucket_size);
     start = start ? start : 1;
 
     if (hinit->max_size > 10000 && nelts && hinit->max_size / nelts < 100) {
-        start = hinit->max_size - 1000;
+        start = ngx_max(start, hinit->max_size - 1000);
     }
 
-    for (size = start; size <= hinit->max_size; size++) {
+    /*
+     * each try costs a pass over all elements, so with large hashes
+     * the step grows once about 16M elements were tested: the number
+     * of further tries is logarithmic, while the size found is at most
+     * 1/64 larger than the smallest one that fits
+     */
+
+    work = 0;
+
+    for (size = start; size <= hinit->max_size; size += step) {
+
+        work += nelts;
+        step = (work > 0x1000000) ? 1 + (size - start) / 64 : 1;
 
         ngx_memzero(test, size * sizeof(u_short));
 
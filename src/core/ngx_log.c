@@ -7,12 +7,105 @@
 
 #include <ngx_config.h>
 #include <ngx_core.h>
+#include <ngx_event.h>
+
+#if (NGX_THREADS)
+#include <ngx_thread_pool.h>
+#endif
+
+
+/* a prime, as the addresses of format strings are usually aligned */
+#define NGX_LOG_LIMIT_SITES  61
+
+
+typedef struct {
+    const char          *fmt;
+    time_t               start;
+    ngx_uint_t           level;
+    ngx_uint_t           count;
+    ngx_uint_t           suppressed;
+} ngx_log_site_t;
+
+
+struct ngx_log_limit_s {
+    ngx_uint_t           rate;
+    time_t               period;
+    time_t               sweep;
+    ngx_log_site_t       sites[NGX_LOG_LIMIT_SITES];
+};
+
+
+typedef struct ngx_log_buf_s  ngx_log_buf_t;
+
+struct ngx_log_buf_s {
+    ngx_open_file_t     *file;
+
+    u_char              *start;
+    u_char              *pos;
+    u_char              *last;
+
+    ngx_msec_t           flush;
+    ngx_event_t          event;
+
+    /* the flush timer is logged to a silent log to avoid recursion */
+    ngx_log_t            log;
+
+#if (NGX_THREADS)
+    ngx_thread_pool_t   *thread_pool;
+    ngx_thread_task_t   *task;
+    ngx_tid_t            tid;
+#endif
+
+    ngx_log_buf_t       *next;
+
+    unsigned             active:1;
+    unsigned             busy:1;
+};
+
+
+#if (NGX_THREADS)
+
+typedef struct {
+    ngx_log_buf_t       *buffer;
+    u_char              *start;
+    size_t               len;
+    ngx_fd_t             fd;
+    ssize_t              n;
+    ngx_err_t            err;
+} ngx_log_thread_ctx_t;
+
+#endif
+
+
+typedef struct {
+    ngx_log_buf_t       *buffers;
+} ngx_log_conf_t;
 
 
+static void *ngx_log_create_conf(ngx_cycle_t *cycle);
+static ngx_int_t ngx_log_init_process(ngx_cycle_t *cycle);
+static void ngx_log_exit_process(ngx_cycle_t *cycle);
 static char *ngx_error_log(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 static char *ngx_log_set_levels(ngx_conf_t *cf, ngx_log_t *log);
+static char *ngx_log_set_params(ngx_conf_t *cf, ngx_log_t *log);
 static void ngx_log_insert(ngx_log_t *log, ngx_log_t *new_log);
 
+static ngx_int_t ngx_log_limit(ngx_log_t *log, ngx_uint_t level,
+    const char *fmt);
+static void ngx_log_limit_report(ngx_log_t *log, ngx_log_site_t *site);
+
+static void ngx_log_buffer_writer(ngx_log_t *log, ngx_uint_t level,
+    u_char *buf, size_t len);
+static void ngx_log_buffer_flush(ngx_log_buf_t *buffer);
+static void ngx_log_buffer_flush_handler(ngx_event_t *ev);
+static void ngx_log_buffer_cleanup(void *data);
+#if (NGX_THREADS)
+static ngx_int_t ngx_log_buffer_thread_write(ngx_log_buf_t *buffer,
+    size_t len);
+static void ngx_log_buffer_thread_handler(void *data, ngx_log_t *log);
+static void ngx_log_buffer_thread_event_handler(ngx_event_t *ev);
+#endif
+
 
 #if (NGX_DEBUG)
 
@@ -46,7 +139,7 @@ static ngx_command_t  ngx_errlog_commands[] = {
 
 static ngx_core_module_t  ngx_errlog_module_ctx = {
     ngx_string("errlog"),
-    NULL,
+    ngx_log_create_conf,
     NULL
 };
 
@@ -58,10 +151,10 @@ ngx_module_t  ngx_errlog_module = {
     NGX_CORE_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_log_init_process,                  /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
-    NULL,                                  /* exit process */
+    ngx_log_exit_process,                  /* exit process */
     NULL,                                  /* exit master */
     NGX_MODULE_V1_PADDING
 };
@@ -164,6 +257,12 @@ ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
             break;
         }
 
+        if (log->limit && level != NGX_LOG_DEBUG
+            && ngx_log_limit(log, level, fmt) != NGX_OK)
+        {
+            goto next;
+        }
+
         if (log->writer) {
             log->writer(log, level, errstr, p - errstr);
             goto next;
@@ -481,16 +580,16 @@ ngx_log_set_levels(ngx_conf_t *cf, ngx_log_t *log)
     ngx_uint_t   i, n, d, found;
     ngx_str_t   *value;
 
-    if (cf->args->nelts == 2) {
-        log->log_level = NGX_LOG_ERR;
-        return NGX_CONF_OK;
-    }
-
     value = cf->args->elts;
 
     for (i = 2; i < cf->args->nelts; i++) {
         found = 0;
 
+        if (ngx_strlchr(value[i].data, value[i].data + value[i].len, '=')) {
+            /* parameters are processed by ngx_log_set_params() */
+            continue;
+        }
+
         for (n = 1; n <= NGX_LOG_DEBUG; n++) {
             if (ngx_strcmp(value[i].data, err_levels[n].data) == 0) {
 
@@ -530,7 +629,10 @@ ngx_log_set_levels(ngx_conf_t *cf, ngx_log_t *log)
         }
     }
 
-    if (log->log_level == NGX_LOG_DEBUG) {
+    if (log->log_level == 0) {
+        log->log_level = NGX_LOG_ERR;
+
+    } else if (log->log_level == NGX_LOG_DEBUG) {
         log->log_level = NGX_LOG_DEBUG_ALL;
     }
 
@@ -665,6 +767,10 @@ ngx_log_set_log(ngx_conf_t *cf, ngx_log_t **head)
         return NGX_CONF_ERROR;
     }
 
+    if (ngx_log_set_params(cf, new_log) != NGX_CONF_OK) {
+        return NGX_CONF_ERROR;
+    }
+
     if (*head != new_log) {
         ngx_log_insert(*head, new_log);
     }
@@ -707,6 +813,636 @@ ngx_log_insert(ngx_log_t *log, ngx_log_t *new_log)
 }
 
 
+static char *
+ngx_log_set_params(ngx_conf_t *cf, ngx_log_t *log)
+{
+    u_char              *p;
+    ssize_t              size;
+    ngx_int_t            rate;
+    ngx_str_t           *value, s;
+    time_t               period;
+    ngx_uint_t           i;
+    ngx_msec_t           flush;
+    ngx_log_buf_t       *buffer;
+    ngx_log_conf_t      *lcf;
+    ngx_log_limit_t     *limit;
+    ngx_pool_cleanup_t  *cln;
+#if (NGX_THREADS)
+    ngx_thread_pool_t   *tp;
+#endif
+
+    value = cf->args->elts;
+
+    size = 0;
+    flush = 0;
+    rate = 0;
+    period = 1;
+#if (NGX_THREADS)
+    tp = NULL;
+#endif
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "buffer=", 7) == 0) {
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            size = ngx_parse_size(&s);
+
+            if (size == NGX_ERROR || size == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid buffer size \"%V\"", &s);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "flush=", 6) == 0) {
+            s.len = value[i].len - 6;
+            s.data = value[i].data + 6;
+
+            flush = ngx_parse_time(&s, 0);
+
+            if (flush == (ngx_msec_t) NGX_ERROR || flush == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid flush time \"%V\"", &s);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "limit=", 6) == 0) {
+            s.len = value[i].len - 6;
+            s.data = value[i].data + 6;
+
+            p = s.data + s.len - 2;
+
+            if (s.len > 2 && ngx_strncmp(p, "/s", 2) == 0) {
+                period = 1;
+
+            } else if (s.len > 2 && ngx_strncmp(p, "/m", 2) == 0) {
+                period = 60;
+
+            } else {
+                goto invalid_limit;
+            }
+
+            rate = ngx_atoi(s.data, s.len - 2);
+
+            if (rate == NGX_ERROR || rate == 0) {
+                goto invalid_limit;
+            }
+
+            continue;
+
+        invalid_limit:
+
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid rate \"%V\"", &s);
+            return NGX_CONF_ERROR;
+        }
+
+        if (ngx_strncmp(value[i].data, "aio=", 4) == 0) {
+#if (NGX_THREADS)
+            s.len = value[i].len - 4;
+            s.data = value[i].data + 4;
+
+            if (s.len >= 7 && ngx_strncmp(s.data, "threads", 7) == 0
+                && (s.len == 7 || s.data[7] == ':'))
+            {
+                if (s.len == 7) {
+                    tp = ngx_thread_pool_add(cf, NULL);
+
+                } else {
+                    s.len -= 8;
+                    s.data += 8;
+
+                    tp = ngx_thread_pool_add(cf, &s);
+                }
+
+                if (tp == NULL) {
+                    return NGX_CONF_ERROR;
+                }
+
+                if (size == 0) {
+                    size = 64 * 1024;
+                }
+
+                continue;
+            }
+
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid aio \"%V\"", &s);
+            return NGX_CONF_ERROR;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"aio\" requires threads support, "
+                               "use the \"--with-threads\" "
+                               "configuration parameter");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
+        if (ngx_strlchr(value[i].data, value[i].data + value[i].len, '=')) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[i]);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    if (rate) {
+        limit = ngx_pcalloc(cf->pool, sizeof(ngx_log_limit_t));
+        if (limit == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        limit->rate = rate;
+        limit->period = period;
+
+        log->limit = limit;
+    }
+
+    if (size == 0) {
+
+        if (flush) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "no buffer is defined for error_log \"%V\"",
+                               &value[1]);
+            return NGX_CONF_ERROR;
+        }
+
+        return NGX_CONF_OK;
+    }
+
+    if (log->writer || log->file == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "buffered error_log \"%V\" must be a file",
+                           &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    buffer = ngx_pcalloc(cf->pool, sizeof(ngx_log_buf_t));
+    if (buffer == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    buffer->start = ngx_pnalloc(cf->pool, size);
+    if (buffer->start == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    buffer->pos = buffer->start;
+    buffer->last = buffer->start + size;
+
+    buffer->file = log->file;
+    buffer->flush = flush ? flush : 1000;
+    buffer->log.file = log->file;
+
+#if (NGX_THREADS)
+    buffer->thread_pool = tp;
+#endif
+
+    cln = ngx_pool_cleanup_add(cf->pool, 0);
+    if (cln == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    cln->handler = ngx_log_buffer_cleanup;
+    cln->data = buffer;
+
+    lcf = (ngx_log_conf_t *) ngx_get_conf(cf->cycle->conf_ctx,
+                                          ngx_errlog_module);
+
+    buffer->next = lcf->buffers;
+    lcf->buffers = buffer;
+
+    log->writer = ngx_log_buffer_writer;
+    log->wdata = buffer;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_log_limit(ngx_log_t *log, ngx_uint_t level, const char *fmt)
+{
+    time_t            now;
+    ngx_uint_t        i;
+    ngx_log_site_t   *site;
+    ngx_log_limit_t  *limit;
+
+    limit = log->limit;
+    now = ngx_time();
+
+    if (limit->sweep != now) {
+        limit->sweep = now;
+
+        /* report the sites which went quiet */
+
+        for (i = 0; i < NGX_LOG_LIMIT_SITES; i++) {
+            site = &limit->sites[i];
+
+            if (site->suppressed && now - site->start >= limit->period) {
+                ngx_log_limit_report(log, site);
+            }
+        }
+    }
+
+    /* the call sites are told apart by their format strings */
+
+    site = &limit->sites[(uintptr_t) fmt % NGX_LOG_LIMIT_SITES];
+
+    if (site->fmt != fmt || now - site->start >= limit->period) {
+
+        if (site->suppressed) {
+            ngx_log_limit_report(log, site);
+        }
+
+        site->fmt = fmt;
+        site->start = now;
+        site->level = level;
+        site->count = 0;
+    }
+
+    if (site->count < limit->rate) {
+        site->count++;
+        return NGX_OK;
+    }
+
+    site->suppressed++;
+
+    return NGX_DECLINED;
+}
+
+
+static void
+ngx_log_limit_report(ngx_log_t *log, ngx_log_site_t *site)
+{
+    u_char      *p, *last;
+    ssize_t      n;
+    ngx_uint_t   level;
+    u_char       errstr[NGX_MAX_ERROR_STR];
+
+    last = errstr + NGX_MAX_ERROR_STR;
+
+    level = site->level;
+
+    p = ngx_cpymem(errstr, ngx_cached_err_log_time.data,
+                   ngx_cached_err_log_time.len);
+
+    p = ngx_slprintf(p, last, " [%V] %P#" NGX_TID_T_FMT ": "
+                     "%ui similar messages suppressed: \"%s\"",
+                     &err_levels[level], ngx_log_pid, ngx_log_tid,
+                     site->suppressed, site->fmt);
+
+    if (p > last - NGX_LINEFEED_SIZE) {
+        p = last - NGX_LINEFEED_SIZE;
+    }
+
+    ngx_linefeed(p);
+
+    site->suppressed = 0;
+
+    if (log->writer) {
+        log->writer(log, level, errstr, p - errstr);
+        return;
+    }
+
+    if (ngx_time() == log->disk_full_time) {
+        return;
+    }
+
+    n = ngx_write_fd(log->file->fd, errstr, p - errstr);
+
+    if (n == -1 && ngx_errno == NGX_ENOSPC) {
+        log->disk_full_time = ngx_time();
+    }
+}
+
+
+static void *
+ngx_log_create_conf(ngx_cycle_t *cycle)
+{
+    ngx_log_conf_t  *lcf;
+
+    lcf = ngx_pcalloc(cycle->pool, sizeof(ngx_log_conf_t));
+    if (lcf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     lcf->buffers = NULL;
+     */
+
+    return lcf;
+}
+
+
+static ngx_int_t
+ngx_log_init_process(ngx_cycle_t *cycle)
+{
+    ngx_log_buf_t   *buffer;
+    ngx_log_conf_t  *lcf;
+
+    /*
+     * buffers need the flush timer, and so are only used in workers;
+     * other processes, including a single one, write messages directly
+     */
+
+    if (ngx_process != NGX_PROCESS_WORKER) {
+        return NGX_OK;
+    }
+
+    lcf = (ngx_log_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_errlog_module);
+
+    for (buffer = lcf->buffers; buffer; buffer = buffer->next) {
+        buffer->event.handler = ngx_log_buffer_flush_handler;
+        buffer->event.data = buffer;
+        buffer->event.log = &buffer->log;
+        buffer->event.cancelable = 1;
+
+#if (NGX_THREADS)
+        buffer->tid = ngx_log_tid;
+#endif
+
+        buffer->active = 1;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_log_exit_process(ngx_cycle_t *cycle)
+{
+    ngx_log_buf_t   *buffer;
+    ngx_log_conf_t  *lcf;
+
+    lcf = (ngx_log_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_errlog_module);
+
+    for (buffer = lcf->buffers; buffer; buffer = buffer->next) {
+        ngx_log_buffer_cleanup(buffer);
+    }
+}
+
+
+static void
+ngx_log_buffer_writer(ngx_log_t *log, ngx_uint_t level, u_char *buf,
+    size_t len)
+{
+    ssize_t         n;
+    ngx_log_buf_t  *buffer;
+
+    buffer = log->wdata;
+
+    if (!buffer->active) {
+        goto write;
+    }
+
+#if (NGX_THREADS)
+    if (buffer->tid != ngx_log_tid) {
+        /* the buffer is only used by the main thread */
+        goto write;
+    }
+#endif
+
+    if (level <= NGX_LOG_CRIT) {
+
+        /* critical messages are not delayed, e.g., as before a crash */
+
+        ngx_log_buffer_flush(buffer);
+        goto write;
+    }
+
+    if (len > (size_t) (buffer->last - buffer->pos)) {
+        ngx_log_buffer_flush(buffer);
+
+        if (len > (size_t) (buffer->last - buffer->pos)) {
+            goto write;
+        }
+    }
+
+    buffer->pos = ngx_cpymem(buffer->pos, buf, len);
+
+    if (!buffer->event.timer_set) {
+        ngx_add_timer(&buffer->event, buffer->flush);
+    }
+
+    return;
+
+write:
+
+    if (ngx_time() == log->disk_full_time) {
+        return;
+    }
+
+    n = ngx_write_fd(log->file->fd, buf, len);
+
+    if (n == -1 && ngx_errno == NGX_ENOSPC) {
+        log->disk_full_time = ngx_time();
+    }
+}
+
+
+static void
+ngx_log_buffer_flush(ngx_log_buf_t *buffer)
+{
+    size_t    len;
+    ssize_t   n;
+
+    len = buffer->pos - buffer->start;
+
+    if (len == 0) {
+        return;
+    }
+
+    /*
+     * the buffer is emptied first, as errors below are logged
+     * and may get here again
+     */
+
+    buffer->pos = buffer->start;
+
+    if (buffer->event.timer_set) {
+        ngx_del_timer(&buffer->event);
+    }
+
+#if (NGX_THREADS)
+
+    if (buffer->thread_pool
+        && ngx_log_buffer_thread_write(buffer, len) == NGX_OK)
+    {
+        return;
+    }
+
+#endif
+
+    n = ngx_write_fd(buffer->file->fd, buffer->start, len);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      ngx_write_fd_n " to \"%s\" failed",
+                      buffer->file->name.data);
+
+    } else if ((size_t) n != len) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                      ngx_write_fd_n " to \"%s\" was incomplete: %z of %uz",
+                      buffer->file->name.data, n, len);
+    }
+}
+
+
+static void
+ngx_log_buffer_flush_handler(ngx_event_t *ev)
+{
+    ngx_log_buffer_flush(ev->data);
+}
+
+
+static void
+ngx_log_buffer_cleanup(void *data)
+{
+    ngx_log_buf_t  *buffer = data;
+
+    if (!buffer->active) {
+        return;
+    }
+
+    /* the thread pools are about to exit, so the rest is written directly */
+
+#if (NGX_THREADS)
+    buffer->thread_pool = NULL;
+#endif
+
+    ngx_log_buffer_flush(buffer);
+
+    buffer->active = 0;
+}
+
+
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_log_buffer_thread_write(ngx_log_buf_t *buffer, size_t len)
+{
+    u_char                *p;
+    size_t                 size;
+    ngx_fd_t               fd;
+    ngx_thread_task_t     *task;
+    ngx_log_thread_ctx_t  *ctx;
+
+    size = buffer->last - buffer->start;
+
+    task = buffer->task;
+
+    if (task == NULL) {
+
+        /* the task owns a spare buffer which is swapped with the full one */
+
+        task = ngx_thread_task_alloc(ngx_cycle->pool,
+                                     sizeof(ngx_log_thread_ctx_t) + size);
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        ctx = task->ctx;
+
+        ctx->buffer = buffer;
+        ctx->start = (u_char *) ctx + sizeof(ngx_log_thread_ctx_t);
+
+        task->handler = ngx_log_buffer_thread_handler;
+        task->event.data = task;
+        task->event.handler = ngx_log_buffer_thread_event_handler;
+        task->event.log = &buffer->log;
+
+        buffer->task = task;
+
+    } else if (buffer->busy) {
+
+        /* the previous write is still in progress */
+
+        return NGX_DECLINED;
+    }
+
+    /*
+     * the descriptor is duplicated, so the file can be safely
+     * reopened while the task is in progress
+     */
+
+    fd = dup(buffer->file->fd);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "dup() \"%s\" failed", buffer->file->name.data);
+        return NGX_ERROR;
+    }
+
+    ctx = task->ctx;
+
+    p = ctx->start;
+
+    ctx->start = buffer->start;
+    ctx->len = len;
+    ctx->fd = fd;
+
+    if (ngx_thread_task_post(buffer->thread_pool, task) != NGX_OK) {
+        ctx->start = p;
+        (void) ngx_close_file(fd);
+        return NGX_ERROR;
+    }
+
+    buffer->busy = 1;
+
+    buffer->start = p;
+    buffer->pos = p;
+    buffer->last = p + size;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_log_buffer_thread_handler(void *data, ngx_log_t *log)
+{
+    ngx_log_thread_ctx_t *ctx = data;
+
+    ctx->n = ngx_write_fd(ctx->fd, ctx->start, ctx->len);
+    ctx->err = (ctx->n == -1) ? ngx_errno : 0;
+
+    (void) ngx_close_file(ctx->fd);
+}
+
+
+static void
+ngx_log_buffer_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_thread_task_t     *task;
+    ngx_log_thread_ctx_t  *ctx;
+
+    task = ev->data;
+    ctx = task->ctx;
+
+    ctx->buffer->busy = 0;
+
+    if (ctx->n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ctx->err,
+                      ngx_write_fd_n " to \"%s\" failed",
+                      ctx->buffer->file->name.data);
+
+    } else if ((size_t) ctx->n != ctx->len) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                      ngx_write_fd_n " to \"%s\" was incomplete: %z of %uz",
+                      ctx->buffer->file->name.data, ctx->n, ctx->len);
+    }
+}
+
+#endif
+
+
 #if (NGX_DEBUG)
 
 static void
@@ -42,6 +42,9 @@
 #define NGX_LOG_DEBUG_ALL         0x7ffffff0
 
 
+typedef struct ngx_log_limit_s  ngx_log_limit_t;
+
+
 typedef u_char *(*ngx_log_handler_pt) (ngx_log_t *log, u_char *buf, size_t len);
 typedef void (*ngx_log_writer_pt) (ngx_log_t *log, ngx_uint_t level,
     u_char *buf, size_t len);
@@ -61,6 +64,8 @@ struct ngx_log_s {
     ngx_log_writer_pt    writer;
     void                *wdata;
 
+    ngx_log_limit_t     *limit;
+
     /*
      * we declare "action" as "char *" because the actions are usually
      * the static strings and in the "u_char *" case we have to override
@@ -0,0 +1,375 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+#define NGX_LOG_RING_MIN_SIZE  8192
+
+
+#if !(NGX_WIN32)
+static ngx_int_t ngx_log_ring_init(ngx_conf_t *cf, ngx_log_ring_t *ring);
+static ngx_fd_t ngx_log_ring_open(ngx_conf_t *cf, ngx_log_ring_t *ring);
+static void ngx_log_ring_cleanup(void *data);
+#endif
+
+
+ngx_log_ring_t *
+ngx_log_ring_process_conf(ngx_conf_t *cf, ngx_str_t *value)
+{
+    u_char          *p, *last;
+    ssize_t          size;
+    ngx_str_t        name, s;
+    ngx_log_ring_t  *ring;
+
+    p = value->data + sizeof("shm:") - 1;
+    last = value->data + value->len;
+
+    s.data = last;
+
+    while (s.data > p && s.data[-1] != ':') {
+        s.data--;
+    }
+
+    if (s.data - 1 <= p) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid shared memory log \"%V\"", value);
+        return NULL;
+    }
+
+    s.len = last - s.data;
+
+    size = ngx_parse_size(&s);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid shared memory log size \"%V\"", &s);
+        return NULL;
+    }
+
+    if (size < NGX_LOG_RING_MIN_SIZE || (size & (size - 1))) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "shared memory log size \"%V\" must be a power "
+                           "of two and at least %d", &s,
+                           NGX_LOG_RING_MIN_SIZE);
+        return NULL;
+    }
+
+#if (NGX_WIN32)
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "shared memory logs are not supported "
+                       "on this platform");
+    return NULL;
+
+#else
+
+    name.len = s.data - 1 - p;
+    name.data = ngx_pnalloc(cf->pool, name.len + 1);
+    if (name.data == NULL) {
+        return NULL;
+    }
+
+    ngx_cpystrn(name.data, p, name.len + 1);
+
+    if (ngx_conf_full_name(cf->cycle, &name, 0) != NGX_OK) {
+        return NULL;
+    }
+
+    ring = ngx_pcalloc(cf->pool, sizeof(ngx_log_ring_t));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->name = name;
+    ring->size = size;
+
+    if (ngx_log_ring_init(cf, ring) != NGX_OK) {
+        return NULL;
+    }
+
+    return ring;
+
+#endif
+}
+
+
+#if !(NGX_WIN32)
+
+static ngx_int_t
+ngx_log_ring_init(ngx_conf_t *cf, ngx_log_ring_t *ring)
+{
+    u_char                 *addr;
+    size_t                  size;
+    ngx_fd_t                fd;
+    ngx_pool_cleanup_t     *cln;
+    ngx_log_ring_header_t  *header;
+
+    fd = ngx_log_ring_open(cf, ring);
+
+    if (fd == NGX_INVALID_FILE) {
+        return NGX_ERROR;
+    }
+
+    size = NGX_LOG_RING_HEADER_SIZE + ring->size;
+
+    addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (addr == MAP_FAILED) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, ngx_errno,
+                           "mmap(%uz) \"%s\" failed", size, ring->name.data);
+        (void) ngx_close_file(fd);
+        return NGX_ERROR;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, cf->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", ring->name.data);
+    }
+
+    cln = ngx_pool_cleanup_add(cf->cycle->pool, 0);
+    if (cln == NULL) {
+        (void) munmap(addr, size);
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_log_ring_cleanup;
+    cln->data = ring;
+
+    header = (ngx_log_ring_header_t *) addr;
+
+    ring->header = header;
+    ring->data = addr + NGX_LOG_RING_HEADER_SIZE;
+
+    if (header->magic == NGX_LOG_RING_MAGIC) {
+
+        /* the ring is preserved across reconfigurations */
+
+        return NGX_OK;
+    }
+
+    header->version = NGX_LOG_RING_VERSION;
+    header->header_size = NGX_LOG_RING_HEADER_SIZE;
+    header->word_size = sizeof(ngx_atomic_t);
+    header->size = ring->size;
+
+    /* zeroed records never match positions starting at the size */
+
+    header->head = ring->size;
+    header->tail = ring->size;
+    header->dropped = 0;
+
+    ngx_memory_barrier();
+
+    header->magic = NGX_LOG_RING_MAGIC;
+
+    return NGX_OK;
+}
+
+
+static ngx_fd_t
+ngx_log_ring_open(ngx_conf_t *cf, ngx_log_ring_t *ring)
+{
+    off_t                  size;
+    ssize_t                n;
+    ngx_fd_t               fd;
+    ngx_file_info_t        fi;
+    ngx_log_ring_header_t  header;
+
+    fd = ngx_open_file(ring->name.data, NGX_FILE_RDWR,
+                       NGX_FILE_CREATE_OR_OPEN, NGX_FILE_DEFAULT_ACCESS);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, ngx_errno,
+                           ngx_open_file_n " \"%s\" failed", ring->name.data);
+        return NGX_INVALID_FILE;
+    }
+
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, ngx_errno,
+                           ngx_fd_info_n " \"%s\" failed", ring->name.data);
+        goto failed;
+    }
+
+    if (!ngx_is_file(&fi)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"%s\" is not a regular file", ring->name.data);
+        goto failed;
+    }
+
+    size = NGX_LOG_RING_HEADER_SIZE + ring->size;
+
+    if (ngx_file_size(&fi) == 0) {
+        goto create;
+    }
+
+    n = ngx_read_fd(fd, &header, sizeof(ngx_log_ring_header_t));
+
+    if (n == -1) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, ngx_errno,
+                           ngx_read_fd_n " \"%s\" failed", ring->name.data);
+        goto failed;
+    }
+
+    if ((size_t) n != sizeof(ngx_log_ring_header_t)
+        || header.magic != NGX_LOG_RING_MAGIC)
+    {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"%s\" is not a shared memory log",
+                           ring->name.data);
+        goto failed;
+    }
+
+    if (ngx_file_size(&fi) == size
+        && header.version == NGX_LOG_RING_VERSION
+        && header.header_size == NGX_LOG_RING_HEADER_SIZE
+        && header.word_size == sizeof(ngx_atomic_t)
+        && header.size == ring->size)
+    {
+        return fd;
+    }
+
+    /*
+     * the layout has changed: the file is replaced, so that processes
+     * still using the old mapping do not corrupt the new one
+     */
+
+    ngx_log_error(NGX_LOG_NOTICE, cf->log, 0,
+                  "shared memory log \"%s\" is recreated", ring->name.data);
+
+    if (ngx_delete_file(ring->name.data) == NGX_FILE_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, ngx_errno,
+                           ngx_delete_file_n " \"%s\" failed",
+                           ring->name.data);
+        goto failed;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, cf->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", ring->name.data);
+    }
+
+    fd = ngx_open_file(ring->name.data, NGX_FILE_RDWR,
+                       NGX_FILE_TRUNCATE, NGX_FILE_DEFAULT_ACCESS);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, ngx_errno,
+                           ngx_open_file_n " \"%s\" failed", ring->name.data);
+        return NGX_INVALID_FILE;
+    }
+
+create:
+
+    if (ftruncate(fd, size) == -1) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, ngx_errno,
+                           "ftruncate() \"%s\" failed", ring->name.data);
+        goto failed;
+    }
+
+    return fd;
+
+failed:
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, cf->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", ring->name.data);
+    }
+
+    return NGX_INVALID_FILE;
+}
+
+
+static void
+ngx_log_ring_cleanup(void *data)
+{
+    ngx_log_ring_t  *ring = data;
+
+    if (munmap((void *) ring->header, NGX_LOG_RING_HEADER_SIZE + ring->size)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "munmap(%uz) \"%s\" failed",
+                      NGX_LOG_RING_HEADER_SIZE + ring->size, ring->name.data);
+    }
+}
+
+#endif
+
+
+u_char *
+ngx_log_ring_reserve(ngx_log_ring_t *ring, size_t len, ngx_atomic_uint_t *pos)
+{
+    size_t                  need, pad;
+    ngx_atomic_uint_t       head, tail, off;
+    ngx_log_ring_header_t  *header;
+    ngx_log_ring_record_t  *rec;
+
+    header = ring->header;
+
+    need = ngx_align(sizeof(ngx_log_ring_record_t) + len, NGX_LOG_RING_ALIGN);
+
+    if (need > ring->size / 4) {
+        (void) ngx_atomic_fetch_add(&header->dropped, 1);
+        return NULL;
+    }
+
+    for ( ;; ) {
+        head = header->head;
+        tail = header->tail;
+
+        off = head & (ring->size - 1);
+
+        /* records are contiguous, the rest of the data area is padded */
+
+        pad = (off + need > ring->size) ? ring->size - off : 0;
+
+        if ((size_t) (head - tail) + pad + need > ring->size) {
+            (void) ngx_atomic_fetch_add(&header->dropped, 1);
+            return NULL;
+        }
+
+        if (ngx_atomic_cmp_set(&header->head, head, head + pad + need)) {
+            break;
+        }
+    }
+
+    if (pad) {
+        rec = (ngx_log_ring_record_t *) (ring->data + off);
+
+        rec->size = (uint32_t) pad;
+        rec->len = 0;
+
+        ngx_memory_barrier();
+
+        rec->pos = head;
+
+        head += pad;
+    }
+
+    rec = (ngx_log_ring_record_t *) (ring->data + (head & (ring->size - 1)));
+
+    rec->size = (uint32_t) need;
+
+    *pos = head;
+
+    return (u_char *) rec + sizeof(ngx_log_ring_record_t);
+}
+
+
+void
+ngx_log_ring_commit(ngx_log_ring_t *ring, ngx_atomic_uint_t pos, size_t len)
+{
+    ngx_log_ring_record_t  *rec;
+
+    rec = (ngx_log_ring_record_t *) (ring->data + (pos & (ring->size - 1)));
+
+    rec->len = (uint32_t) len;
+
+    ngx_memory_barrier();
+
+    rec->pos = pos;
+}
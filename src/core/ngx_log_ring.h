@@ -0,0 +1,106 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_LOG_RING_H_INCLUDED_
+#define _NGX_LOG_RING_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * A log ring is a file mapped into all worker processes, which append
+ * records to it without locks and system calls, while an external agent
+ * maps the same file and consumes them.  Placing the file on a memory
+ * filesystem, such as /dev/shm, avoids disk I/O completely.
+ *
+ * The file starts with a header of NGX_LOG_RING_HEADER_SIZE bytes:
+ *
+ *   offset    size   field
+ *        0       4   magic, "NGXR"
+ *        4       4   version, 1
+ *        8       4   header size, offset of the data area
+ *       12       4   word size, the size of positions in bytes
+ *       16       8   data area size, a power of two
+ *       64    word   head, written by worker processes
+ *      128    word   tail, written by the consumer
+ *      192    word   number of records dropped as the ring was full
+ *
+ * All integers are in host byte order.  Positions are free running byte
+ * counters of the word size, starting at the data area size; the offset
+ * of a position in the data area is the position modulo the size.
+ *
+ * The data area consists of records aligned to NGX_LOG_RING_ALIGN bytes,
+ * each starting with ngx_log_ring_record_t.  A record is committed when
+ * its "pos" field is equal to the record position, and "len" bytes of
+ * data without a trailing newline follow the header.  Records with zero
+ * "len" pad the data area up to its end and should be skipped.
+ *
+ * The consumer reads records as follows:
+ *
+ *     for ( ;; ) {
+ *         rec = data + (tail & (size - 1));
+ *         if (load_acquire(rec->pos) != tail) break;
+ *         if (rec->len) consume(rec + 1, rec->len);
+ *         tail += rec->size;
+ *         store_release(header->tail, tail);
+ *     }
+ *
+ * Workers never overwrite data beyond the tail, so records are dropped
+ * when the consumer does not keep up.  When nginx is reconfigured with
+ * a different size, the file is replaced, and the consumer is expected
+ * to map it again once the file inode changes.
+ */
+
+
+#define NGX_LOG_RING_MAGIC        0x5258474e  /* "NGXR" */
+#define NGX_LOG_RING_VERSION      1
+#define NGX_LOG_RING_HEADER_SIZE  256
+#define NGX_LOG_RING_ALIGN        16
+
+
+typedef struct {
+    uint32_t             magic;
+    uint32_t             version;
+    uint32_t             header_size;
+    uint32_t             word_size;
+    uint64_t             size;
+    u_char               pad0[40];
+
+    ngx_atomic_t         head;
+    u_char               pad1[64 - sizeof(ngx_atomic_t)];
+
+    ngx_atomic_t         tail;
+    u_char               pad2[64 - sizeof(ngx_atomic_t)];
+
+    ngx_atomic_t         dropped;
+} ngx_log_ring_header_t;
+
+
+typedef struct {
+    uint32_t             size;
+    uint32_t             len;
+    ngx_atomic_t         pos;
+} ngx_log_ring_record_t;
+
+
+typedef struct {
+    ngx_str_t               name;
+    size_t                  size;
+    ngx_log_ring_header_t  *header;
+    u_char                 *data;
+} ngx_log_ring_t;
+
+
+ngx_log_ring_t *ngx_log_ring_process_conf(ngx_conf_t *cf, ngx_str_t *value);
+u_char *ngx_log_ring_reserve(ngx_log_ring_t *ring, size_t len,
+    ngx_atomic_uint_t *pos);
+void ngx_log_ring_commit(ngx_log_ring_t *ring, ngx_atomic_uint_t pos,
+    size_t len);
+
+
+#endif /* _NGX_LOG_RING_H_INCLUDED_ */
@@ -8,6 +8,22 @@
 #include <ngx_core.h>
 
 
+#define ngx_murmur_rotl64(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+#define ngx_murmur_get64(p)                                                   \
+    ((uint64_t) (p)[0] | (uint64_t) (p)[1] << 8                               \
+     | (uint64_t) (p)[2] << 16 | (uint64_t) (p)[3] << 24                      \
+     | (uint64_t) (p)[4] << 32 | (uint64_t) (p)[5] << 40                      \
+     | (uint64_t) (p)[6] << 48 | (uint64_t) (p)[7] << 56)
+
+#define NGX_MURMUR_C1  0x87c37b91114253d5ULL
+#define NGX_MURMUR_C2  0x4cf5ad432745937fULL
+
+
+static void ngx_murmur_hash3_block(ngx_murmur_hash3_t *ctx, const u_char *p);
+static uint64_t ngx_murmur_hash3_fmix(uint64_t k);
+
+
 uint32_t
 ngx_murmur_hash2(u_char *data, size_t len)
 {
@@ -50,3 +66,184 @@ ngx_murmur_hash2(u_char *data, size_t len)
 
     return h;
 }
+
+
+/*
+ * MurmurHash3 x64 128-bit variant with zero seed; the blocks are read
+ * as little-endian on all platforms, so the results are portable
+ */
+
+void
+ngx_murmur_hash3_init(ngx_murmur_hash3_t *ctx)
+{
+    ctx->h1 = 0;
+    ctx->h2 = 0;
+    ctx->bytes = 0;
+}
+
+
+void
+ngx_murmur_hash3_update(ngx_murmur_hash3_t *ctx, const void *data, size_t size)
+{
+    size_t         used, free;
+    const u_char  *p;
+
+    p = data;
+
+    used = (size_t) (ctx->bytes & 15);
+    ctx->bytes += size;
+
+    if (used) {
+        free = 16 - used;
+
+        if (size < free) {
+            ngx_memcpy(&ctx->buffer[used], p, size);
+            return;
+        }
+
+        ngx_memcpy(&ctx->buffer[used], p, free);
+        p += free;
+        size -= free;
+
+        ngx_murmur_hash3_block(ctx, ctx->buffer);
+    }
+
+    while (size >= 16) {
+        ngx_murmur_hash3_block(ctx, p);
+        p += 16;
+        size -= 16;
+    }
+
+    ngx_memcpy(ctx->buffer, p, size);
+}
+
+
+void
+ngx_murmur_hash3_final(u_char result[16], ngx_murmur_hash3_t *ctx)
+{
+    u_char      *tail;
+    uint64_t     h1, h2, k1, k2;
+    ngx_uint_t   i;
+
+    h1 = ctx->h1;
+    h2 = ctx->h2;
+
+    tail = ctx->buffer;
+    k1 = 0;
+    k2 = 0;
+
+    switch (ctx->bytes & 15) {
+    case 15:
+        k2 ^= (uint64_t) tail[14] << 48;
+        /* fall through */
+    case 14:
+        k2 ^= (uint64_t) tail[13] << 40;
+        /* fall through */
+    case 13:
+        k2 ^= (uint64_t) tail[12] << 32;
+        /* fall through */
+    case 12:
+        k2 ^= (uint64_t) tail[11] << 24;
+        /* fall through */
+    case 11:
+        k2 ^= (uint64_t) tail[10] << 16;
+        /* fall through */
+    case 10:
+        k2 ^= (uint64_t) tail[9] << 8;
+        /* fall through */
+    case 9:
+        k2 ^= (uint64_t) tail[8];
+        k2 *= NGX_MURMUR_C2;
+        k2 = ngx_murmur_rotl64(k2, 33);
+        k2 *= NGX_MURMUR_C1;
+        h2 ^= k2;
+        /* fall through */
+    case 8:
+        k1 ^= (uint64_t) tail[7] << 56;
+        /* fall through */
+    case 7:
+        k1 ^= (uint64_t) tail[6] << 48;
+        /* fall through */
+    case 6:
+        k1 ^= (uint64_t) tail[5] << 40;
+        /* fall through */
+    case 5:
+        k1 ^= (uint64_t) tail[4] << 32;
+        /* fall through */
+    case 4:
+        k1 ^= (uint64_t) tail[3] << 24;
+        /* fall through */
+    case 3:
+        k1 ^= (uint64_t) tail[2] << 16;
+        /* fall through */
+    case 2:
+        k1 ^= (uint64_t) tail[1] << 8;
+        /* fall through */
+    case 1:
+        k1 ^= (uint64_t) tail[0];
+        k1 *= NGX_MURMUR_C1;
+        k1 = ngx_murmur_rotl64(k1, 31);
+        k1 *= NGX_MURMUR_C2;
+        h1 ^= k1;
+    }
+
+    h1 ^= ctx->bytes;
+    h2 ^= ctx->bytes;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = ngx_murmur_hash3_fmix(h1);
+    h2 = ngx_murmur_hash3_fmix(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    for (i = 0; i < 8; i++) {
+        result[i] = (u_char) (h1 >> (i * 8));
+        result[i + 8] = (u_char) (h2 >> (i * 8));
+    }
+
+    ngx_memzero(ctx, sizeof(*ctx));
+}
+
+
+static void
+ngx_murmur_hash3_block(ngx_murmur_hash3_t *ctx, const u_char *p)
+{
+    uint64_t  k1, k2;
+
+    k1 = ngx_murmur_get64(p);
+    k2 = ngx_murmur_get64(p + 8);
+
+    k1 *= NGX_MURMUR_C1;
+    k1 = ngx_murmur_rotl64(k1, 31);
+    k1 *= NGX_MURMUR_C2;
+    ctx->h1 ^= k1;
+
+    ctx->h1 = ngx_murmur_rotl64(ctx->h1, 27);
+    ctx->h1 += ctx->h2;
+    ctx->h1 = ctx->h1 * 5 + 0x52dce729;
+
+    k2 *= NGX_MURMUR_C2;
+    k2 = ngx_murmur_rotl64(k2, 33);
+    k2 *= NGX_MURMUR_C1;
+    ctx->h2 ^= k2;
+
+    ctx->h2 = ngx_murmur_rotl64(ctx->h2, 31);
+    ctx->h2 += ctx->h1;
+    ctx->h2 = ctx->h2 * 5 + 0x38495ab5;
+}
+
+
+static uint64_t
+ngx_murmur_hash3_fmix(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+
+    return k;
+}
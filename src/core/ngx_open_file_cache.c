@@ -14,7 +14,9 @@
  * open file cache caches
  *    open file handles with stat() info;
  *    directories stat() info;
- *    files and directories errors: not found, access denied, etc.
+ *    files and directories errors: not found, access denied, etc.;
+ *    optionally, open handles of directories, to open and stat files
+ *    relative to them without resolving the whole path again.
  */
 
 
@@ -22,6 +24,10 @@
 
 
 static void ngx_open_file_cache_cleanup(void *data);
+#if !(NGX_WIN32)
+static void ngx_open_file_cache_invalidate(ngx_message_handler_t *h,
+    ngx_str_t *msg);
+#endif
 #if (NGX_HAVE_OPENAT)
 static ngx_fd_t ngx_openat_file_owner(ngx_fd_t at_fd, const u_char *name,
     ngx_int_t mode, ngx_int_t create, ngx_int_t access, ngx_log_t *log);
@@ -31,12 +37,17 @@ static ngx_int_t ngx_file_o_path_info(ngx_fd_t fd, ngx_file_info_t *fi,
 #endif
 #endif
 static ngx_fd_t ngx_open_file_wrapper(ngx_str_t *name,
-    ngx_open_file_info_t *of, ngx_int_t mode, ngx_int_t create,
-    ngx_int_t access, ngx_log_t *log);
+    ngx_open_file_info_t *of, ngx_open_file_dir_t *dir, ngx_int_t mode,
+    ngx_int_t create, ngx_int_t access, ngx_log_t *log);
 static ngx_int_t ngx_file_info_wrapper(ngx_str_t *name,
-    ngx_open_file_info_t *of, ngx_file_info_t *fi, ngx_log_t *log);
+    ngx_open_file_info_t *of, ngx_open_file_dir_t *dir, ngx_file_info_t *fi,
+    ngx_log_t *log);
 static ngx_int_t ngx_open_and_stat_file(ngx_str_t *name,
-    ngx_open_file_info_t *of, ngx_log_t *log);
+    ngx_open_file_info_t *of, ngx_open_file_dir_t *dir, ngx_log_t *log);
+#if (NGX_HAVE_OPENAT)
+static ngx_open_file_dir_t *ngx_open_file_dir(ngx_open_file_cache_t *cache,
+    ngx_str_t *name, ngx_open_file_info_t *of, ngx_log_t *log);
+#endif
 static void ngx_open_file_add_event(ngx_open_file_cache_t *cache,
     ngx_cached_open_file_t *file, ngx_open_file_info_t *of, ngx_log_t *log);
 static void ngx_open_file_cleanup(void *data);
@@ -51,6 +62,61 @@ static ngx_cached_open_file_t *
     ngx_open_file_lookup(ngx_open_file_cache_t *cache, ngx_str_t *name,
     uint32_t hash);
 static void ngx_open_file_cache_remove(ngx_event_t *ev);
+static ngx_int_t ngx_open_file_zone_init(ngx_shm_zone_t *shm_zone,
+    void *data);
+static ngx_int_t ngx_open_file_stat(ngx_open_file_cache_t *cache,
+    ngx_str_t *name, uint32_t hash, ngx_open_file_info_t *of,
+    time_t *created, ngx_log_t *log);
+static ngx_int_t ngx_open_file_zone_get(ngx_open_file_zone_t *zone,
+    ngx_str_t *name, uint32_t hash, ngx_open_file_info_t *of,
+    time_t *created);
+static void ngx_open_file_zone_set(ngx_open_file_cache_t *cache,
+    ngx_str_t *name, uint32_t hash, ngx_open_file_info_t *of, time_t created);
+static void ngx_open_file_zone_expire(ngx_open_file_cache_t *cache,
+    ngx_uint_t force, time_t now);
+static void ngx_open_file_zone_rbtree_insert_value(ngx_rbtree_node_t *temp,
+    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel);
+static ngx_open_file_node_t *ngx_open_file_zone_lookup(
+    ngx_open_file_zone_t *zone, ngx_str_t *name, uint32_t hash);
+
+#if (NGX_HAVE_INOTIFY)
+
+#define NGX_OPEN_FILE_INOTIFY_MASK                                            \
+    (IN_ATTRIB|IN_MODIFY|IN_DELETE_SELF|IN_MOVE_SELF)
+
+static ngx_int_t ngx_open_file_inotify_init(ngx_log_t *log);
+static ngx_int_t ngx_open_file_inotify_add(ngx_open_file_cache_event_t *fev,
+    ngx_log_t *log);
+static void ngx_open_file_inotify_del(ngx_open_file_cache_event_t *fev);
+static void ngx_open_file_inotify_handler(ngx_event_t *ev);
+static void ngx_open_file_inotify_remove(int wd, ngx_uint_t ignored);
+static ngx_open_file_cache_event_t *ngx_open_file_inotify_lookup(int wd);
+
+
+static ngx_connection_t   *ngx_open_file_inotify;
+static ngx_uint_t          ngx_open_file_inotify_failed;
+static ngx_uint_t          ngx_open_file_inotify_full;
+static ngx_rbtree_t        ngx_open_file_inotify_tree;
+static ngx_rbtree_node_t   ngx_open_file_inotify_sentinel;
+
+#endif
+
+
+#if !(NGX_WIN32)
+
+/*
+ * a worker which finds a cached file changed tells other workers to drop
+ * their descriptors of the file, instead of using them till of->valid
+ * expires
+ */
+
+static ngx_queue_t            ngx_open_file_caches;
+
+static ngx_message_handler_t  ngx_open_file_cache_message = {
+    ngx_string("open_file_cache"), ngx_open_file_cache_invalidate, NULL, NULL
+};
+
+#endif
 
 
 ngx_open_file_cache_t *
@@ -72,6 +138,9 @@ ngx_open_file_cache_init(ngx_pool_t *pool, ngx_uint_t max, time_t inactive)
     cache->current = 0;
     cache->max = max;
     cache->inactive = inactive;
+    cache->zone = NULL;
+    cache->dirs = NULL;
+    cache->ndirs = 0;
 
     cln = ngx_pool_cleanup_add(pool, 0);
     if (cln == NULL) {
@@ -81,21 +150,162 @@ ngx_open_file_cache_init(ngx_pool_t *pool, ngx_uint_t max, time_t inactive)
     cln->handler = ngx_open_file_cache_cleanup;
     cln->data = cache;
 
+#if !(NGX_WIN32)
+
+    if (ngx_open_file_caches.next == NULL) {
+        ngx_queue_init(&ngx_open_file_caches);
+    }
+
+    ngx_queue_insert_tail(&ngx_open_file_caches, &cache->caches);
+
+    ngx_subscribe_messages(&ngx_open_file_cache_message);
+
+#endif
+
     return cache;
 }
 
 
+ngx_int_t
+ngx_open_file_cache_dirs(ngx_pool_t *pool, ngx_open_file_cache_t *cache,
+    ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    cache->dirs = ngx_pcalloc(pool, n * sizeof(ngx_open_file_dir_t));
+    if (cache->dirs == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        cache->dirs[i].fd = NGX_INVALID_FILE;
+    }
+
+    cache->ndirs = n;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_open_file_cache_zone(ngx_conf_t *cf, ngx_open_file_cache_t *cache,
+    ngx_str_t *name, size_t size, void *tag)
+{
+    ngx_shm_zone_t        *shm_zone;
+    ngx_open_file_zone_t  *zone;
+
+    shm_zone = ngx_shared_memory_add(cf, name, size, tag);
+    if (shm_zone == NULL) {
+        return NGX_ERROR;
+    }
+
+    /* the zone may be shared by several caches */
+
+    if (shm_zone->data) {
+        cache->zone = shm_zone->data;
+        return NGX_OK;
+    }
+
+    zone = ngx_pcalloc(cf->pool, sizeof(ngx_open_file_zone_t));
+    if (zone == NULL) {
+        return NGX_ERROR;
+    }
+
+    zone->shm_zone = shm_zone;
+
+    shm_zone->init = ngx_open_file_zone_init;
+    shm_zone->data = zone;
+
+    cache->zone = zone;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_open_file_zone_init(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_open_file_zone_t  *ozone = data;
+
+    size_t                 len;
+    ngx_open_file_zone_t  *zone;
+
+    zone = shm_zone->data;
+
+    if (ozone) {
+        zone->sh = ozone->sh;
+        zone->shpool = ozone->shpool;
+        return NGX_OK;
+    }
+
+    zone->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        zone->sh = zone->shpool->data;
+        return NGX_OK;
+    }
+
+    zone->sh = ngx_slab_alloc(zone->shpool, sizeof(ngx_open_file_sh_t));
+    if (zone->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    zone->shpool->data = zone->sh;
+
+    ngx_rbtree_init(&zone->sh->rbtree, &zone->sh->sentinel,
+                    ngx_open_file_zone_rbtree_insert_value);
+
+    ngx_queue_init(&zone->sh->queue);
+
+    len = sizeof(" in open file cache zone \"\"") + shm_zone->shm.name.len;
+
+    zone->shpool->log_ctx = ngx_slab_alloc(zone->shpool, len);
+    if (zone->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(zone->shpool->log_ctx, " in open file cache zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    zone->shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
 static void
 ngx_open_file_cache_cleanup(void *data)
 {
     ngx_open_file_cache_t  *cache = data;
 
+    ngx_uint_t               i;
     ngx_queue_t             *q;
+    ngx_open_file_dir_t     *dir;
     ngx_cached_open_file_t  *file;
 
     ngx_log_debug0(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
                    "open file cache cleanup");
 
+    for (i = 0; i < cache->ndirs; i++) {
+        dir = &cache->dirs[i];
+
+        if (dir->fd != NGX_INVALID_FILE
+            && ngx_close_file(dir->fd) == NGX_FILE_ERROR)
+        {
+            ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                          ngx_close_file_n " \"%*s\" failed",
+                          dir->len, dir->name);
+        }
+
+        if (dir->name) {
+            ngx_free(dir->name);
+        }
+    }
+
+#if !(NGX_WIN32)
+    ngx_queue_remove(&cache->caches);
+#endif
+
     for ( ;; ) {
 
         if (ngx_queue_empty(&cache->expire_queue)) {
@@ -144,7 +354,7 @@ ngx_int_t
 ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
     ngx_open_file_info_t *of, ngx_pool_t *pool)
 {
-    time_t                          now;
+    time_t                          now, created;
     uint32_t                        hash;
     ngx_int_t                       rc;
     ngx_file_info_t                 fi;
@@ -160,7 +370,7 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
 
         if (of->test_only) {
 
-            if (ngx_file_info_wrapper(name, of, &fi, pool->log)
+            if (ngx_file_info_wrapper(name, of, NULL, &fi, pool->log)
                 == NGX_FILE_ERROR)
             {
                 return NGX_ERROR;
@@ -183,7 +393,7 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
             return NGX_ERROR;
         }
 
-        rc = ngx_open_and_stat_file(name, of, pool->log);
+        rc = ngx_open_and_stat_file(name, of, NULL, pool->log);
 
         if (rc == NGX_OK && !of->is_dir) {
             cln->handler = ngx_pool_cleanup_file;
@@ -218,7 +428,8 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
 
             /* file was not used often enough to keep open */
 
-            rc = ngx_open_and_stat_file(name, of, pool->log);
+            rc = ngx_open_file_stat(cache, name, hash, of, &created,
+                                    pool->log);
 
             if (rc != NGX_OK && (of->err == 0 || !of->errors)) {
                 goto failed;
@@ -286,7 +497,7 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
         of->fd = file->fd;
         of->uniq = file->uniq;
 
-        rc = ngx_open_and_stat_file(name, of, pool->log);
+        rc = ngx_open_file_stat(cache, name, hash, of, &created, pool->log);
 
         if (rc != NGX_OK && (of->err == 0 || !of->errors)) {
             goto failed;
@@ -328,6 +539,15 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
             /* file was removed, etc. */
         }
 
+#if !(NGX_WIN32)
+
+        if (name->len + sizeof("open_file_cache") < NGX_MESSAGE_LEN) {
+            (void) ngx_broadcast_message(&ngx_open_file_cache_message.type,
+                                         name->data, name->len + 1);
+        }
+
+#endif
+
         if (file->count == 0) {
 
             ngx_open_file_del_event(file);
@@ -351,7 +571,7 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
 
     /* not found */
 
-    rc = ngx_open_and_stat_file(name, of, pool->log);
+    rc = ngx_open_file_stat(cache, name, hash, of, &created, pool->log);
 
     if (rc != NGX_OK && (of->err == 0 || !of->errors)) {
         goto failed;
@@ -421,7 +641,7 @@ update:
         }
     }
 
-    file->created = now;
+    file->created = created;
 
 found:
 
@@ -612,7 +832,8 @@ ngx_file_o_path_info(ngx_fd_t fd, ngx_file_info_t *fi, ngx_log_t *log)
 
 static ngx_fd_t
 ngx_open_file_wrapper(ngx_str_t *name, ngx_open_file_info_t *of,
-    ngx_int_t mode, ngx_int_t create, ngx_int_t access, ngx_log_t *log)
+    ngx_open_file_dir_t *dir, ngx_int_t mode, ngx_int_t create,
+    ngx_int_t access, ngx_log_t *log)
 {
     ngx_fd_t  fd;
 
@@ -635,6 +856,20 @@ ngx_open_file_wrapper(ngx_str_t *name, ngx_open_file_info_t *of,
     ngx_str_t         at_name;
 
     if (of->disable_symlinks == NGX_DISABLE_SYMLINKS_OFF) {
+
+        if (dir) {
+            fd = ngx_openat_file(dir->fd, name->data + dir->len,
+                                 mode, create, access);
+
+            if (fd == NGX_INVALID_FILE) {
+                of->err = ngx_errno;
+                of->failed = ngx_openat_file_n;
+                return NGX_INVALID_FILE;
+            }
+
+            return fd;
+        }
+
         fd = ngx_open_file(name->data, mode, create, access);
 
         if (fd == NGX_INVALID_FILE) {
@@ -779,7 +1014,7 @@ failed:
 
 static ngx_int_t
 ngx_file_info_wrapper(ngx_str_t *name, ngx_open_file_info_t *of,
-    ngx_file_info_t *fi, ngx_log_t *log)
+    ngx_open_file_dir_t *dir, ngx_file_info_t *fi, ngx_log_t *log)
 {
     ngx_int_t  rc;
 
@@ -801,6 +1036,18 @@ ngx_file_info_wrapper(ngx_str_t *name, ngx_open_file_info_t *of,
 
     if (of->disable_symlinks == NGX_DISABLE_SYMLINKS_OFF) {
 
+        if (dir) {
+            rc = ngx_file_at_info(dir->fd, name->data + dir->len, fi, 0);
+
+            if (rc == NGX_FILE_ERROR) {
+                of->err = ngx_errno;
+                of->failed = ngx_file_at_info_n;
+                return NGX_FILE_ERROR;
+            }
+
+            return rc;
+        }
+
         rc = ngx_file_info(name->data, fi);
 
         if (rc == NGX_FILE_ERROR) {
@@ -812,7 +1059,8 @@ ngx_file_info_wrapper(ngx_str_t *name, ngx_open_file_info_t *of,
         return rc;
     }
 
-    fd = ngx_open_file_wrapper(name, of, NGX_FILE_RDONLY|NGX_FILE_NONBLOCK,
+    fd = ngx_open_file_wrapper(name, of, dir,
+                               NGX_FILE_RDONLY|NGX_FILE_NONBLOCK,
                                NGX_FILE_OPEN, 0, log);
 
     if (fd == NGX_INVALID_FILE) {
@@ -838,14 +1086,14 @@ ngx_file_info_wrapper(ngx_str_t *name, ngx_open_file_info_t *of,
 
 static ngx_int_t
 ngx_open_and_stat_file(ngx_str_t *name, ngx_open_file_info_t *of,
-    ngx_log_t *log)
+    ngx_open_file_dir_t *dir, ngx_log_t *log)
 {
     ngx_fd_t         fd;
     ngx_file_info_t  fi;
 
     if (of->fd != NGX_INVALID_FILE) {
 
-        if (ngx_file_info_wrapper(name, of, &fi, log) == NGX_FILE_ERROR) {
+        if (ngx_file_info_wrapper(name, of, dir, &fi, log) == NGX_FILE_ERROR) {
             of->fd = NGX_INVALID_FILE;
             return NGX_ERROR;
         }
@@ -856,7 +1104,7 @@ ngx_open_and_stat_file(ngx_str_t *name, ngx_open_file_info_t *of,
 
     } else if (of->test_dir) {
 
-        if (ngx_file_info_wrapper(name, of, &fi, log) == NGX_FILE_ERROR) {
+        if (ngx_file_info_wrapper(name, of, dir, &fi, log) == NGX_FILE_ERROR) {
             of->fd = NGX_INVALID_FILE;
             return NGX_ERROR;
         }
@@ -873,11 +1121,12 @@ ngx_open_and_stat_file(ngx_str_t *name, ngx_open_file_info_t *of,
          * This flag has no effect on a regular files.
          */
 
-        fd = ngx_open_file_wrapper(name, of, NGX_FILE_RDONLY|NGX_FILE_NONBLOCK,
+        fd = ngx_open_file_wrapper(name, of, dir,
+                                   NGX_FILE_RDONLY|NGX_FILE_NONBLOCK,
                                    NGX_FILE_OPEN, 0, log);
 
     } else {
-        fd = ngx_open_file_wrapper(name, of, NGX_FILE_APPEND,
+        fd = ngx_open_file_wrapper(name, of, dir, NGX_FILE_APPEND,
                                    NGX_FILE_CREATE_OR_OPEN,
                                    NGX_FILE_DEFAULT_ACCESS, log);
     }
@@ -956,8 +1205,7 @@ ngx_open_file_add_event(ngx_open_file_cache_t *cache,
 {
     ngx_open_file_cache_event_t  *fev;
 
-    if (!(ngx_event_flags & NGX_USE_VNODE_EVENT)
-        || !of->events
+    if (!of->events
         || file->event
         || of->fd == NGX_INVALID_FILE
         || file->uses < of->min_uses)
@@ -965,6 +1213,24 @@ ngx_open_file_add_event(ngx_open_file_cache_t *cache,
         return;
     }
 
+#if (NGX_HAVE_INOTIFY)
+
+    /* inotify is used if there are no vnode events */
+
+    if (!(ngx_event_flags & NGX_USE_VNODE_EVENT)
+        && (ngx_open_file_inotify_failed || ngx_open_file_inotify_full))
+    {
+        return;
+    }
+
+#else
+
+    if (!(ngx_event_flags & NGX_USE_VNODE_EVENT)) {
+        return;
+    }
+
+#endif
+
     file->use_event = 0;
 
     file->event = ngx_calloc(sizeof(ngx_event_t), log);
@@ -994,6 +1260,21 @@ ngx_open_file_add_event(ngx_open_file_cache_t *cache,
 
     file->event->log = ngx_cycle->log;
 
+#if (NGX_HAVE_INOTIFY)
+
+    if (!(ngx_event_flags & NGX_USE_VNODE_EVENT)) {
+
+        if (ngx_open_file_inotify_add(fev, log) != NGX_OK) {
+            ngx_free(file->event->data);
+            ngx_free(file->event);
+            file->event = NULL;
+        }
+
+        return;
+    }
+
+#endif
+
     if (ngx_add_event(file->event, NGX_VNODE_EVENT, NGX_ONESHOT_EVENT)
         != NGX_OK)
     {
@@ -1028,6 +1309,63 @@ ngx_open_file_cleanup(void *data)
 }
 
 
+#if !(NGX_WIN32)
+
+static void
+ngx_open_file_cache_invalidate(ngx_message_handler_t *h, ngx_str_t *msg)
+{
+    uint32_t                 hash;
+    ngx_str_t                name;
+    ngx_queue_t             *q;
+    ngx_open_file_cache_t   *cache;
+    ngx_cached_open_file_t  *file;
+
+    /* the name is null-terminated */
+
+    if (msg->len == 0 || msg->data[msg->len - 1] != '\0') {
+        return;
+    }
+
+    name.len = msg->len - 1;
+    name.data = msg->data;
+
+    hash = ngx_crc32_long(name.data, name.len);
+
+    for (q = ngx_queue_head(&ngx_open_file_caches);
+         q != ngx_queue_sentinel(&ngx_open_file_caches);
+         q = ngx_queue_next(q))
+    {
+        cache = ngx_queue_data(q, ngx_open_file_cache_t, caches);
+
+        file = ngx_open_file_lookup(cache, &name, hash);
+
+        if (file == NULL) {
+            continue;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                       "invalidate cached open file: %s", file->name);
+
+        ngx_queue_remove(&file->queue);
+
+        ngx_rbtree_delete(&cache->rbtree, &file->node);
+
+        cache->current--;
+
+        if (!file->err && !file->is_dir) {
+            file->close = 1;
+            ngx_close_cached_file(cache, file, 0, ngx_cycle->log);
+
+        } else {
+            ngx_free(file->name);
+            ngx_free(file);
+        }
+    }
+}
+
+#endif
+
+
 static void
 ngx_close_cached_file(ngx_open_file_cache_t *cache,
     ngx_cached_open_file_t *file, ngx_uint_t min_uses, ngx_log_t *log)
@@ -1081,9 +1419,23 @@ ngx_open_file_del_event(ngx_cached_open_file_t *file)
         return;
     }
 
+#if (NGX_HAVE_INOTIFY)
+
+    if (!(ngx_event_flags & NGX_USE_VNODE_EVENT)) {
+        ngx_open_file_inotify_del(file->event->data);
+
+    } else {
+        (void) ngx_del_event(file->event, NGX_VNODE_EVENT,
+                             file->count ? NGX_FLUSH_EVENT : NGX_CLOSE_EVENT);
+    }
+
+#else
+
     (void) ngx_del_event(file->event, NGX_VNODE_EVENT,
                          file->count ? NGX_FLUSH_EVENT : NGX_CLOSE_EVENT);
 
+#endif
+
     ngx_free(file->event->data);
     ngx_free(file->event);
     file->event = NULL;
@@ -1223,31 +1575,750 @@ ngx_open_file_lookup(ngx_open_file_cache_t *cache, ngx_str_t *name,
 }
 
 
-static void
-ngx_open_file_cache_remove(ngx_event_t *ev)
+/*
+ * the results of stat() and errors are shared by workers via the zone:
+ * a fresh entry saves the periodic retests of a file opened by a worker,
+ * and the syscalls for directories and errors; descriptors are not shared
+ */
+
+static ngx_int_t
+ngx_open_file_stat(ngx_open_file_cache_t *cache, ngx_str_t *name,
+    uint32_t hash, ngx_open_file_info_t *of, time_t *created, ngx_log_t *log)
 {
-    ngx_cached_open_file_t       *file;
-    ngx_open_file_cache_event_t  *fev;
+    ngx_int_t             rc;
+    ngx_open_file_dir_t  *dir;
 
-    fev = ev->data;
-    file = fev->file;
+    *created = ngx_time();
 
-    ngx_queue_remove(&file->queue);
+    if (cache->zone && !of->log) {
+        rc = ngx_open_file_zone_get(cache->zone, name, hash, of, created);
 
-    ngx_rbtree_delete(&fev->cache->rbtree, &file->node);
+        if (rc != NGX_DECLINED) {
+            return rc;
+        }
+    }
 
-    fev->cache->current--;
+    dir = NULL;
 
-    /* NGX_ONESHOT_EVENT was already deleted */
-    file->event = NULL;
-    file->use_event = 0;
+#if (NGX_HAVE_OPENAT)
 
-    file->close = 1;
+    if (cache->dirs) {
+        dir = ngx_open_file_dir(cache, name, of, log);
+    }
 
-    ngx_close_cached_file(fev->cache, file, 0, ev->log);
+    if (dir && dir->err) {
 
-    /* free memory only when fev->cache and fev->file are already not needed */
+        /* the directory is known not to exist, etc. */
 
-    ngx_free(ev->data);
-    ngx_free(ev);
+        of->fd = NGX_INVALID_FILE;
+        of->err = dir->err;
+        of->failed = ngx_open_file_n;
+
+        rc = NGX_ERROR;
+
+    } else {
+        rc = ngx_open_and_stat_file(name, of, dir, log);
+    }
+
+#else
+
+    rc = ngx_open_and_stat_file(name, of, dir, log);
+
+#endif
+
+    if (cache->zone && !of->log && (rc == NGX_OK || (of->err && of->errors)))
+    {
+        ngx_open_file_zone_set(cache, name, hash, of, *created);
+    }
+
+    return rc;
 }
+
+
+#if (NGX_HAVE_OPENAT)
+
+/*
+ * directories of files looked up are kept open in a small table indexed
+ * by hash, so a file is opened or tested with a single openat() or fstatat()
+ * without walking its whole path; as with cached file descriptors, a
+ * directory is reopened once the "valid" time passes, and errors are only
+ * reused when errors are cached
+ */
+
+static ngx_open_file_dir_t *
+ngx_open_file_dir(ngx_open_file_cache_t *cache, ngx_str_t *name,
+    ngx_open_file_info_t *of, ngx_log_t *log)
+{
+    u_char               *p, c;
+    size_t                len;
+    time_t                now;
+    uint32_t              hash;
+    ngx_open_file_dir_t  *dir;
+
+    if (of->log || of->disable_symlinks != NGX_DISABLE_SYMLINKS_OFF) {
+        return NULL;
+    }
+
+    /* a name with the last component after a slash */
+
+    for (p = name->data + name->len; p > name->data; p--) {
+        if (p[-1] == '/') {
+            break;
+        }
+    }
+
+    if (p == name->data || p == name->data + name->len) {
+        return NULL;
+    }
+
+    len = p - name->data;
+    hash = ngx_crc32_long(name->data, len);
+
+    dir = &cache->dirs[hash % cache->ndirs];
+
+    now = ngx_time();
+
+    if (dir->hash == hash
+        && dir->len == len
+        && ngx_strncmp(dir->name, name->data, len) == 0
+        && now - dir->created < of->valid
+        && (dir->err == 0 || of->errors))
+    {
+        return dir;
+    }
+
+    if (dir->fd != NGX_INVALID_FILE) {
+        if (ngx_close_file(dir->fd) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          ngx_close_file_n " \"%*s\" failed",
+                          dir->len, dir->name);
+        }
+
+        dir->fd = NGX_INVALID_FILE;
+    }
+
+    if (dir->len < len) {
+        if (dir->name) {
+            ngx_free(dir->name);
+        }
+
+        dir->name = ngx_alloc(len, log);
+        if (dir->name == NULL) {
+            dir->len = 0;
+            return NULL;
+        }
+    }
+
+    ngx_memcpy(dir->name, name->data, len);
+
+    dir->len = len;
+    dir->hash = hash;
+    dir->created = now;
+
+    c = *p;
+    *p = '\0';
+
+    dir->fd = ngx_open_file(name->data, NGX_FILE_SEARCH|NGX_FILE_NONBLOCK,
+                            NGX_FILE_OPEN, 0);
+
+    *p = c;
+
+    dir->err = (dir->fd == NGX_INVALID_FILE) ? ngx_errno : 0;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_CORE, log, 0,
+                   "open file cache dir: \"%*s\" fd:%d",
+                   len, name->data, dir->fd);
+
+    return dir;
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_open_file_zone_get(ngx_open_file_zone_t *zone, ngx_str_t *name,
+    uint32_t hash, ngx_open_file_info_t *of, time_t *created)
+{
+    time_t                 now;
+    ngx_int_t              rc;
+    ngx_open_file_node_t  *fn;
+
+    now = *created;
+
+    ngx_shmtx_lock(&zone->shpool->mutex);
+
+    fn = ngx_open_file_zone_lookup(zone, name, hash);
+
+    if (fn == NULL
+        || now - fn->created >= of->valid
+#if (NGX_HAVE_OPENAT)
+        || of->disable_symlinks != fn->disable_symlinks
+        || of->disable_symlinks_from != fn->disable_symlinks_from
+#endif
+       )
+    {
+        ngx_shmtx_unlock(&zone->shpool->mutex);
+        return NGX_DECLINED;
+    }
+
+    if (fn->err) {
+
+        if (!of->errors) {
+            ngx_shmtx_unlock(&zone->shpool->mutex);
+            return NGX_DECLINED;
+        }
+
+        of->fd = NGX_INVALID_FILE;
+        of->err = fn->err;
+#if (NGX_HAVE_OPENAT)
+        of->failed = fn->disable_symlinks ? ngx_openat_file_n
+                                          : ngx_open_file_n;
+#else
+        of->failed = ngx_open_file_n;
+#endif
+
+        rc = NGX_ERROR;
+
+    } else if (fn->is_dir
+               || (of->fd != NGX_INVALID_FILE && of->uniq == fn->uniq))
+    {
+        /* the descriptor of a file is opened by a worker itself */
+
+        if (fn->is_dir) {
+            of->fd = NGX_INVALID_FILE;
+        }
+
+        of->uniq = fn->uniq;
+        of->mtime = fn->mtime;
+        of->size = fn->size;
+        of->fs_size = fn->fs_size;
+        of->is_dir = fn->is_dir;
+        of->is_file = fn->is_file;
+        of->is_link = fn->is_link;
+        of->is_exec = fn->is_exec;
+
+        rc = NGX_OK;
+
+    } else {
+        ngx_shmtx_unlock(&zone->shpool->mutex);
+        return NGX_DECLINED;
+    }
+
+    *created = fn->created;
+
+    fn->accessed = now;
+
+    ngx_queue_remove(&fn->queue);
+    ngx_queue_insert_head(&zone->sh->queue, &fn->queue);
+
+    ngx_shmtx_unlock(&zone->shpool->mutex);
+
+    return rc;
+}
+
+
+static void
+ngx_open_file_zone_set(ngx_open_file_cache_t *cache, ngx_str_t *name,
+    uint32_t hash, ngx_open_file_info_t *of, time_t created)
+{
+    size_t                 n;
+    ngx_open_file_zone_t  *zone;
+    ngx_open_file_node_t  *fn;
+
+    zone = cache->zone;
+
+    ngx_shmtx_lock(&zone->shpool->mutex);
+
+    ngx_open_file_zone_expire(cache, 0, created);
+
+    fn = ngx_open_file_zone_lookup(zone, name, hash);
+
+    if (fn) {
+        ngx_queue_remove(&fn->queue);
+
+    } else {
+        n = offsetof(ngx_open_file_node_t, name) + name->len;
+
+        fn = ngx_slab_alloc_locked(zone->shpool, n);
+
+        if (fn == NULL) {
+            ngx_open_file_zone_expire(cache, 1, created);
+
+            fn = ngx_slab_alloc_locked(zone->shpool, n);
+
+            if (fn == NULL) {
+                ngx_shmtx_unlock(&zone->shpool->mutex);
+                return;
+            }
+        }
+
+        fn->node.key = hash;
+        fn->len = name->len;
+        ngx_memcpy(fn->name, name->data, name->len);
+
+        ngx_rbtree_insert(&zone->sh->rbtree, &fn->node);
+    }
+
+    fn->created = created;
+    fn->accessed = created;
+    fn->err = of->err;
+#if (NGX_HAVE_OPENAT)
+    fn->disable_symlinks = of->disable_symlinks;
+    fn->disable_symlinks_from = of->disable_symlinks_from;
+#endif
+
+    if (of->err == 0) {
+        fn->uniq = of->uniq;
+        fn->mtime = of->mtime;
+        fn->size = of->size;
+        fn->fs_size = of->fs_size;
+        fn->is_dir = of->is_dir;
+        fn->is_file = of->is_file;
+        fn->is_link = of->is_link;
+        fn->is_exec = of->is_exec;
+    }
+
+    ngx_queue_insert_head(&zone->sh->queue, &fn->queue);
+
+    ngx_shmtx_unlock(&zone->shpool->mutex);
+}
+
+
+static void
+ngx_open_file_zone_expire(ngx_open_file_cache_t *cache, ngx_uint_t force,
+    time_t now)
+{
+    ngx_uint_t             n;
+    ngx_queue_t           *q;
+    ngx_open_file_zone_t  *zone;
+    ngx_open_file_node_t  *fn;
+
+    /*
+     * n == 1 deletes one or two inactive entries
+     * n == 0 deletes least recently used entry by force
+     * and one or two inactive entries
+     */
+
+    zone = cache->zone;
+
+    n = force ? 0 : 1;
+
+    while (n < 3) {
+
+        if (ngx_queue_empty(&zone->sh->queue)) {
+            return;
+        }
+
+        q = ngx_queue_last(&zone->sh->queue);
+
+        fn = ngx_queue_data(q, ngx_open_file_node_t, queue);
+
+        if (n++ != 0 && now - fn->accessed <= cache->inactive) {
+            return;
+        }
+
+        ngx_queue_remove(q);
+
+        ngx_rbtree_delete(&zone->sh->rbtree, &fn->node);
+
+        ngx_slab_free_locked(zone->shpool, fn);
+    }
+}
+
+
+static void
+ngx_open_file_zone_rbtree_insert_value(ngx_rbtree_node_t *temp,
+    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
+{
+    ngx_rbtree_node_t     **p;
+    ngx_open_file_node_t   *fn, *fnt;
+
+    for ( ;; ) {
+
+        if (node->key < temp->key) {
+
+            p = &temp->left;
+
+        } else if (node->key > temp->key) {
+
+            p = &temp->right;
+
+        } else { /* node->key == temp->key */
+
+            fn = (ngx_open_file_node_t *) node;
+            fnt = (ngx_open_file_node_t *) temp;
+
+            p = (ngx_memn2cmp(fn->name, fnt->name, fn->len, fnt->len) < 0)
+                    ? &temp->left : &temp->right;
+        }
+
+        if (*p == sentinel) {
+            break;
+        }
+
+        temp = *p;
+    }
+
+    *p = node;
+    node->parent = temp;
+    node->left = sentinel;
+    node->right = sentinel;
+    ngx_rbt_red(node);
+}
+
+
+static ngx_open_file_node_t *
+ngx_open_file_zone_lookup(ngx_open_file_zone_t *zone, ngx_str_t *name,
+    uint32_t hash)
+{
+    ngx_int_t              rc;
+    ngx_rbtree_node_t     *node, *sentinel;
+    ngx_open_file_node_t  *fn;
+
+    node = zone->sh->rbtree.root;
+    sentinel = zone->sh->rbtree.sentinel;
+
+    while (node != sentinel) {
+
+        if (hash < node->key) {
+            node = node->left;
+            continue;
+        }
+
+        if (hash > node->key) {
+            node = node->right;
+            continue;
+        }
+
+        /* hash == node->key */
+
+        fn = (ngx_open_file_node_t *) node;
+
+        rc = ngx_memn2cmp(name->data, fn->name, name->len, fn->len);
+
+        if (rc == 0) {
+            return fn;
+        }
+
+        node = (rc < 0) ? node->left : node->right;
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_open_file_cache_remove(ngx_event_t *ev)
+{
+    ngx_cached_open_file_t       *file;
+    ngx_open_file_cache_event_t  *fev;
+
+    fev = ev->data;
+    file = fev->file;
+
+    ngx_queue_remove(&file->queue);
+
+    ngx_rbtree_delete(&fev->cache->rbtree, &file->node);
+
+    fev->cache->current--;
+
+    /* NGX_ONESHOT_EVENT was already deleted */
+    file->event = NULL;
+    file->use_event = 0;
+
+    file->close = 1;
+
+    ngx_close_cached_file(fev->cache, file, 0, ev->log);
+
+    /* free memory only when fev->cache and fev->file are already not needed */
+
+    ngx_free(ev->data);
+    ngx_free(ev);
+}
+
+
+#if (NGX_HAVE_INOTIFY)
+
+/*
+ * a single inotify instance per process; a watch is an inode, and may be
+ * shared by several entries, e.g., of different caches
+ */
+
+static ngx_int_t
+ngx_open_file_inotify_init(ngx_log_t *log)
+{
+    int                fd;
+    ngx_event_t       *rev;
+    ngx_connection_t  *c;
+
+    ngx_open_file_inotify_failed = 1;
+
+    fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+
+    if (fd == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "inotify_init1() failed");
+        return NGX_ERROR;
+    }
+
+    c = ngx_get_connection(fd, ngx_cycle->log);
+
+    if (c == NULL) {
+        if (close(fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          "inotify close() failed");
+        }
+
+        return NGX_ERROR;
+    }
+
+    c->log = ngx_cycle->log;
+
+    rev = c->read;
+    rev->log = c->log;
+    rev->handler = ngx_open_file_inotify_handler;
+
+    /* not a client connection, it is left open on worker exit */
+    rev->channel = 1;
+    c->write->channel = 1;
+
+    if (ngx_add_event(rev, NGX_READ_EVENT, 0) == NGX_ERROR) {
+        ngx_close_connection(c);
+        return NGX_ERROR;
+    }
+
+    ngx_rbtree_init(&ngx_open_file_inotify_tree,
+                    &ngx_open_file_inotify_sentinel, ngx_rbtree_insert_value);
+
+    ngx_open_file_inotify = c;
+    ngx_open_file_inotify_failed = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_open_file_inotify_add(ngx_open_file_cache_event_t *fev, ngx_log_t *log)
+{
+    int        wd;
+    u_char    *name;
+    ngx_err_t  err;
+    u_char     path[sizeof("/proc/self/fd/") + NGX_INT_T_LEN];
+
+    if (ngx_open_file_inotify == NULL
+        && ngx_open_file_inotify_init(log) != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    /* the opened file is watched, even if it was renamed since open */
+
+    ngx_sprintf(path, "/proc/self/fd/%d%Z", fev->fd);
+
+    name = path;
+
+    wd = inotify_add_watch(ngx_open_file_inotify->fd, (char *) name,
+                           NGX_OPEN_FILE_INOTIFY_MASK);
+
+    if (wd == -1 && ngx_errno == NGX_ENOENT) {
+
+        /* no procfs */
+
+        name = fev->file->name;
+
+        wd = inotify_add_watch(ngx_open_file_inotify->fd, (char *) name,
+                               NGX_OPEN_FILE_INOTIFY_MASK);
+    }
+
+    if (wd == -1) {
+        err = ngx_errno;
+
+        if (err == NGX_ENOSPC) {
+            ngx_log_error(NGX_LOG_WARN, log, err,
+                          "inotify_add_watch(\"%s\") failed, "
+                          "the files are retested until watches are freed, "
+                          "consider increasing fs.inotify.max_user_watches",
+                          name);
+
+            ngx_open_file_inotify_full = 1;
+            return NGX_ERROR;
+        }
+
+        ngx_log_error(NGX_LOG_ALERT, log, err,
+                      "inotify_add_watch(\"%s\") failed", name);
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, log, 0,
+                   "inotify add watch: %s, wd:%d", fev->file->name, wd);
+
+    fev->node.key = (ngx_rbtree_key_t) wd;
+
+    ngx_rbtree_insert(&ngx_open_file_inotify_tree, &fev->node);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_open_file_inotify_del(ngx_open_file_cache_event_t *fev)
+{
+    int  wd;
+
+    wd = (int) fev->node.key;
+
+    ngx_rbtree_delete(&ngx_open_file_inotify_tree, &fev->node);
+
+    if (ngx_open_file_inotify_lookup(wd)) {
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                   "inotify rm watch: %d", wd);
+
+    /* EINVAL: the watch was already removed by kernel */
+
+    if (inotify_rm_watch(ngx_open_file_inotify->fd, wd) == -1
+        && ngx_errno != NGX_EINVAL)
+    {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "inotify_rm_watch() failed");
+    }
+
+    ngx_open_file_inotify_full = 0;
+}
+
+
+static void
+ngx_open_file_inotify_handler(ngx_event_t *ev)
+{
+    u_char                *p, *last;
+    ssize_t                n;
+    ngx_err_t              err;
+    ngx_rbtree_node_t     *node;
+    ngx_connection_t      *c;
+    struct inotify_event  *ie;
+    uint32_t               buf[1024];
+
+    c = ev->data;
+
+    for ( ;; ) {
+
+        n = read(c->fd, buf, sizeof(buf));
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EAGAIN) {
+                return;
+            }
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            ngx_log_error(NGX_LOG_ALERT, ev->log, err,
+                          "inotify read() failed");
+            return;
+        }
+
+        if (n == 0) {
+            return;
+        }
+
+        last = (u_char *) buf + n;
+
+        for (p = (u_char *) buf; p < last; p += sizeof(*ie) + ie->len) {
+            ie = (struct inotify_event *) p;
+
+            ngx_log_debug2(NGX_LOG_DEBUG_CORE, ev->log, 0,
+                           "inotify event: wd:%d mask:%uxD",
+                           ie->wd, ie->mask);
+
+            if (!(ie->mask & IN_Q_OVERFLOW)) {
+                ngx_open_file_inotify_remove(ie->wd, ie->mask & IN_IGNORED);
+                continue;
+            }
+
+            ngx_log_error(NGX_LOG_WARN, ev->log, 0,
+                          "inotify queue overflow, "
+                          "all open file cache entries are removed");
+
+            while (ngx_open_file_inotify_tree.root
+                   != ngx_open_file_inotify_tree.sentinel)
+            {
+                node = ngx_rbtree_min(ngx_open_file_inotify_tree.root,
+                                      ngx_open_file_inotify_tree.sentinel);
+
+                ngx_open_file_inotify_remove((int) node->key, 0);
+            }
+        }
+    }
+}
+
+
+static void
+ngx_open_file_inotify_remove(int wd, ngx_uint_t ignored)
+{
+    ngx_event_t                  *ev;
+    ngx_open_file_cache_event_t  *fev;
+
+    fev = ngx_open_file_inotify_lookup(wd);
+
+    if (fev == NULL) {
+        return;
+    }
+
+    while (fev) {
+        ngx_rbtree_delete(&ngx_open_file_inotify_tree, &fev->node);
+
+        ev = fev->file->event;
+        ev->handler(ev);
+
+        fev = ngx_open_file_inotify_lookup(wd);
+    }
+
+    if (!ignored
+        && inotify_rm_watch(ngx_open_file_inotify->fd, wd) == -1
+        && ngx_errno != NGX_EINVAL)
+    {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "inotify_rm_watch() failed");
+    }
+
+    ngx_open_file_inotify_full = 0;
+}
+
+
+static ngx_open_file_cache_event_t *
+ngx_open_file_inotify_lookup(int wd)
+{
+    ngx_rbtree_key_t    key;
+    ngx_rbtree_node_t  *node, *sentinel;
+
+    key = (ngx_rbtree_key_t) wd;
+
+    node = ngx_open_file_inotify_tree.root;
+    sentinel = ngx_open_file_inotify_tree.sentinel;
+
+    while (node != sentinel) {
+
+        if (key < node->key) {
+            node = node->left;
+            continue;
+        }
+
+        if (key > node->key) {
+            node = node->right;
+            continue;
+        }
+
+        return (ngx_open_file_cache_event_t *)
+                   ((u_char *) node
+                    - offsetof(ngx_open_file_cache_event_t, node));
+    }
+
+    return NULL;
+}
+
+#endif
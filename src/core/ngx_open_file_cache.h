@@ -88,6 +88,62 @@ struct ngx_cached_open_file_s {
 };
 
 
+typedef struct {
+    ngx_rbtree_node_t        node;
+    ngx_queue_t              queue;
+
+    time_t                   created;
+    time_t                   accessed;
+
+    ngx_file_uniq_t          uniq;
+    time_t                   mtime;
+    off_t                    size;
+    off_t                    fs_size;
+    ngx_err_t                err;
+
+#if (NGX_HAVE_OPENAT)
+    size_t                   disable_symlinks_from;
+    unsigned                 disable_symlinks:2;
+#endif
+
+    unsigned                 is_dir:1;
+    unsigned                 is_file:1;
+    unsigned                 is_link:1;
+    unsigned                 is_exec:1;
+
+    size_t                   len;
+    u_char                   name[1];
+} ngx_open_file_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t             rbtree;
+    ngx_rbtree_node_t        sentinel;
+    ngx_queue_t              queue;
+} ngx_open_file_sh_t;
+
+
+/* the file information shared by the caches of worker processes */
+
+typedef struct {
+    ngx_open_file_sh_t      *sh;
+    ngx_slab_pool_t         *shpool;
+    ngx_shm_zone_t          *shm_zone;
+} ngx_open_file_zone_t;
+
+
+/* an open directory, to look up files in it with relative names */
+
+typedef struct {
+    u_char                  *name;
+    size_t                   len;
+    uint32_t                 hash;
+    ngx_fd_t                 fd;
+    ngx_err_t                err;
+    time_t                   created;
+} ngx_open_file_dir_t;
+
+
 typedef struct {
     ngx_rbtree_t             rbtree;
     ngx_rbtree_node_t        sentinel;
@@ -96,6 +152,14 @@ typedef struct {
     ngx_uint_t               current;
     ngx_uint_t               max;
     time_t                   inactive;
+
+    ngx_open_file_zone_t    *zone;
+
+    ngx_open_file_dir_t     *dirs;
+    ngx_uint_t               ndirs;
+
+    /* all caches of a process, for invalidations by other processes */
+    ngx_queue_t              caches;
 } ngx_open_file_cache_t;
 
 
@@ -117,11 +181,20 @@ typedef struct {
 
     ngx_cached_open_file_t  *file;
     ngx_open_file_cache_t   *cache;
+
+#if (NGX_HAVE_INOTIFY)
+    /* the key is the inotify watch descriptor */
+    ngx_rbtree_node_t        node;
+#endif
 } ngx_open_file_cache_event_t;
 
 
 ngx_open_file_cache_t *ngx_open_file_cache_init(ngx_pool_t *pool,
     ngx_uint_t max, time_t inactive);
+ngx_int_t ngx_open_file_cache_zone(ngx_conf_t *cf,
+    ngx_open_file_cache_t *cache, ngx_str_t *name, size_t size, void *tag);
+ngx_int_t ngx_open_file_cache_dirs(ngx_pool_t *pool,
+    ngx_open_file_cache_t *cache, ngx_uint_t n);
 ngx_int_t ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
     ngx_open_file_info_t *of, ngx_pool_t *pool);
 
@@ -26,6 +26,15 @@
 
 #define NGX_NONE            1
 
+#define NGX_DIRECTIO_POOL_HUGE_PAGE  (2 * 1024 * 1024)
+
+
+typedef struct {
+    ngx_directio_pool_t  *pool;
+    u_char               *block;
+    ngx_uint_t            class;
+} ngx_directio_pool_cleanup_t;
+
 
 static ngx_inline ngx_int_t
     ngx_output_chain_as_is(ngx_output_chain_ctx_t *ctx, ngx_buf_t *buf);
@@ -35,6 +44,11 @@ static ngx_int_t ngx_output_chain_align_file_buf(ngx_output_chain_ctx_t *ctx,
     off_t bsize);
 static ngx_int_t ngx_output_chain_get_buf(ngx_output_chain_ctx_t *ctx,
     off_t bsize);
+static ngx_int_t ngx_output_chain_get_directio_buf(ngx_output_chain_ctx_t *ctx,
+    ngx_buf_t *b, size_t size);
+static ngx_int_t ngx_directio_pool_init(ngx_directio_pool_t *pool,
+    ngx_log_t *log);
+static void ngx_directio_pool_cleanup(void *data);
 static ngx_int_t ngx_output_chain_copy_buf(ngx_output_chain_ctx_t *ctx);
 
 
@@ -255,6 +269,10 @@ ngx_output_chain_as_is(ngx_output_chain_ctx_t *ctx, ngx_buf_t *buf)
         return 1;
     }
 
+    if (buf->in_file) {
+        buf->file->prefetch_max = ctx->read_ahead;
+    }
+
 #if (NGX_THREADS)
     if (buf->in_file) {
         buf->file->thread_handler = ctx->thread_handler;
@@ -429,6 +447,7 @@ static ngx_int_t
 ngx_output_chain_get_buf(ngx_output_chain_ctx_t *ctx, off_t bsize)
 {
     size_t       size;
+    ngx_int_t    rc;
     ngx_buf_t   *b, *in;
     ngx_uint_t   recycled;
 
@@ -470,6 +489,18 @@ ngx_output_chain_get_buf(ngx_output_chain_ctx_t *ctx, off_t bsize)
 
     if (ctx->directio) {
 
+        if (ctx->directio_pool) {
+            rc = ngx_output_chain_get_directio_buf(ctx, b, size);
+
+            if (rc == NGX_ERROR) {
+                return NGX_ERROR;
+            }
+
+            if (rc == NGX_OK) {
+                goto done;
+            }
+        }
+
         /*
          * allocate block aligned to a disk sector size to enable
          * userland buffer direct usage conjunctly with directio
@@ -487,6 +518,8 @@ ngx_output_chain_get_buf(ngx_output_chain_ctx_t *ctx, off_t bsize)
         }
     }
 
+done:
+
     b->pos = b->start;
     b->last = b->start;
     b->end = b->last + size;
@@ -501,6 +534,158 @@ ngx_output_chain_get_buf(ngx_output_chain_ctx_t *ctx, off_t bsize)
 }
 
 
+static ngx_int_t
+ngx_output_chain_get_directio_buf(ngx_output_chain_ctx_t *ctx, ngx_buf_t *b,
+    size_t size)
+{
+    u_char                       *p;
+    ngx_uint_t                    n;
+    ngx_pool_cleanup_t           *cln;
+    ngx_directio_pool_t          *pool;
+    ngx_directio_pool_cleanup_t  *dc;
+
+    pool = ctx->directio_pool;
+
+    /* blocks are aligned to the page size */
+
+    if ((size_t) ctx->alignment > ngx_pagesize) {
+        return NGX_DECLINED;
+    }
+
+    for (n = 0; (size_t) NGX_DIRECTIO_POOL_MIN << n < size; n++) {
+        if (n == NGX_DIRECTIO_POOL_CLASSES - 1) {
+            return NGX_DECLINED;
+        }
+    }
+
+    cln = ngx_pool_cleanup_add(ctx->pool,
+                               sizeof(ngx_directio_pool_cleanup_t));
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (pool->free[n]) {
+        p = pool->free[n];
+        pool->free[n] = *(void **) p;
+
+    } else {
+
+        if (pool->start == NULL) {
+            if (pool->failed) {
+                return NGX_DECLINED;
+            }
+
+            if (ngx_directio_pool_init(pool, ctx->pool->log) != NGX_OK) {
+                pool->failed = 1;
+                return NGX_DECLINED;
+            }
+        }
+
+        p = ngx_align_ptr(pool->last, ngx_pagesize);
+
+        if (p >= pool->end
+            || (size_t) (pool->end - p) < (size_t) NGX_DIRECTIO_POOL_MIN << n)
+        {
+            ngx_log_debug1(NGX_LOG_DEBUG_CORE, ctx->pool->log, 0,
+                           "directio pool exhausted, size: %uz", size);
+
+            return NGX_DECLINED;
+        }
+
+        pool->last = p + ((size_t) NGX_DIRECTIO_POOL_MIN << n);
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, ctx->pool->log, 0,
+                   "directio pool borrow: %p, size: %uz", p, size);
+
+    dc = cln->data;
+
+    dc->pool = pool;
+    dc->block = p;
+    dc->class = n;
+
+    cln->handler = ngx_directio_pool_cleanup;
+
+    b->start = p;
+
+    return NGX_OK;
+}
+
+
+ngx_directio_pool_t *
+ngx_directio_pool_create(ngx_pool_t *pool, size_t size, ngx_uint_t hugepages)
+{
+    ngx_directio_pool_t  *dp;
+
+    dp = ngx_pcalloc(pool, sizeof(ngx_directio_pool_t));
+    if (dp == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     dp->start = NULL;
+     *     dp->free[] = NULL;
+     *     dp->failed = 0;
+     */
+
+    dp->size = size;
+    dp->hugepages = hugepages ? 1 : 0;
+
+    return dp;
+}
+
+
+static ngx_int_t
+ngx_directio_pool_init(ngx_directio_pool_t *pool, ngx_log_t *log)
+{
+    size_t  alignment;
+
+    alignment = ngx_pagesize;
+
+#if (NGX_HAVE_MADV_HUGEPAGE)
+    if (pool->hugepages) {
+        alignment = NGX_DIRECTIO_POOL_HUGE_PAGE;
+    }
+#endif
+
+    pool->start = ngx_memalign(alignment, pool->size, log);
+    if (pool->start == NULL) {
+        return NGX_ERROR;
+    }
+
+#if (NGX_HAVE_MADV_HUGEPAGE)
+
+    if (pool->hugepages
+        && madvise((void *) pool->start, pool->size, MADV_HUGEPAGE) == -1)
+    {
+        ngx_log_error(NGX_LOG_NOTICE, log, ngx_errno,
+                      "madvise(MADV_HUGEPAGE) for directio pool failed, "
+                      "ignored");
+    }
+
+#endif
+
+    pool->last = pool->start;
+    pool->end = pool->start + pool->size;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, log, 0,
+                   "directio pool: %p, size: %uz", pool->start, pool->size);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_directio_pool_cleanup(void *data)
+{
+    ngx_directio_pool_cleanup_t  *dc = data;
+
+    *(void **) dc->block = dc->pool->free[dc->class];
+    dc->pool->free[dc->class] = dc->block;
+}
+
 static ngx_int_t
 ngx_output_chain_copy_buf(ngx_output_chain_ctx_t *ctx)
 {
@@ -556,6 +741,9 @@ ngx_output_chain_copy_buf(ngx_output_chain_ctx_t *ctx)
 
     } else {
 
+        ngx_file_read_ahead(src->file, src->file_pos, (size_t) size,
+                            src->file_last);
+
 #if (NGX_HAVE_ALIGNED_DIRECTIO)
 
         if (ctx->unaligned) {
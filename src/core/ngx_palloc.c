@@ -13,6 +13,30 @@ static ngx_inline void *ngx_palloc_small(ngx_pool_t *pool, size_t size,
     ngx_uint_t align);
 static void *ngx_palloc_block(ngx_pool_t *pool, size_t size);
 static void *ngx_palloc_large(ngx_pool_t *pool, size_t size);
+static void *ngx_pool_alloc_block(size_t size, ngx_log_t *log);
+static void ngx_pool_free_block(ngx_pool_t *p);
+static ngx_int_t ngx_pool_cache_slot(size_t size);
+
+
+/*
+ * blocks of power of two sizes from 256 bytes to 64k freed by pools
+ * are kept in per-process lists, up to "pool_cache" blocks of each size
+ */
+
+#define NGX_POOL_CACHE_MIN_SHIFT  8
+#define NGX_POOL_CACHE_SLOTS      9
+
+
+typedef struct {
+    ngx_pool_t               *free;
+    ngx_uint_t                number;
+} ngx_pool_cache_slot_t;
+
+
+static ngx_uint_t             ngx_pool_cache_max;
+static ngx_pool_cache_slot_t  ngx_pool_cache[NGX_POOL_CACHE_SLOTS];
+
+ngx_pool_cache_stats_t        ngx_pool_cache_stats;
 
 
 ngx_pool_t *
@@ -20,7 +44,7 @@ ngx_create_pool(size_t size, ngx_log_t *log)
 {
     ngx_pool_t  *p;
 
-    p = ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+    p = ngx_pool_alloc_block(size, log);
     if (p == NULL) {
         return NULL;
     }
@@ -87,7 +111,7 @@ ngx_destroy_pool(ngx_pool_t *pool)
     }
 
     for (p = pool, n = pool->d.next; /* void */; p = n, n = n->d.next) {
-        ngx_free(p);
+        ngx_pool_free_block(p);
 
         if (n == NULL) {
             break;
@@ -183,7 +207,7 @@ ngx_palloc_block(ngx_pool_t *pool, size_t size)
 
     psize = (size_t) (pool->d.end - (u_char *) pool);
 
-    m = ngx_memalign(NGX_POOL_ALIGNMENT, psize, pool->log);
+    m = ngx_pool_alloc_block(psize, pool->log);
     if (m == NULL) {
         return NULL;
     }
@@ -294,6 +318,28 @@ ngx_pfree(ngx_pool_t *pool, void *p)
 }
 
 
+void
+ngx_pool_usage(ngx_pool_t *pool, ngx_pool_usage_t *u)
+{
+    ngx_pool_t        *p;
+    ngx_pool_large_t  *l;
+
+    u->size = (size_t) (pool->d.end - (u_char *) pool);
+    u->used = 0;
+    u->blocks = 0;
+    u->large = 0;
+
+    for (p = pool; p; p = p->d.next) {
+        u->used += (size_t) (p->d.last - (u_char *) p);
+        u->blocks++;
+    }
+
+    for (l = pool->large; l; l = l->next) {
+        u->large++;
+    }
+}
+
+
 void *
 ngx_pcalloc(ngx_pool_t *pool, size_t size)
 {
@@ -401,30 +447,103 @@ ngx_pool_delete_file(void *data)
 }
 
 
-#if 0
+void
+ngx_pool_cache_init(ngx_uint_t max)
+{
+    ngx_uint_t   i;
+    ngx_pool_t  *p;
+
+    ngx_pool_cache_max = max;
+
+    /* free the blocks above the new limit */
+
+    for (i = 0; i < NGX_POOL_CACHE_SLOTS; i++) {
+        while (ngx_pool_cache[i].number > max) {
+            p = ngx_pool_cache[i].free;
+            ngx_pool_cache[i].free = p->d.next;
+            ngx_pool_cache[i].number--;
+            ngx_pool_cache_stats.cached--;
+
+            ngx_free(p);
+        }
+    }
+}
+
 
 static void *
-ngx_get_cached_block(size_t size)
+ngx_pool_alloc_block(size_t size, ngx_log_t *log)
 {
-    void                     *p;
-    ngx_cached_block_slot_t  *slot;
+    ngx_int_t               n;
+    ngx_pool_t             *p;
+    ngx_pool_cache_slot_t  *slot;
 
-    if (ngx_cycle->cache == NULL) {
-        return NULL;
+    if (ngx_pool_cache_max) {
+        n = ngx_pool_cache_slot(size);
+
+        if (n != NGX_DECLINED) {
+            slot = &ngx_pool_cache[n];
+
+            if (slot->free) {
+                p = slot->free;
+                slot->free = p->d.next;
+                slot->number--;
+
+                ngx_pool_cache_stats.hits++;
+                ngx_pool_cache_stats.cached--;
+
+                return p;
+            }
+
+            ngx_pool_cache_stats.misses++;
+        }
     }
 
-    slot = &ngx_cycle->cache[(size + ngx_pagesize - 1) / ngx_pagesize];
+    return ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+}
+
+
+static void
+ngx_pool_free_block(ngx_pool_t *p)
+{
+    ngx_int_t               n;
+    ngx_pool_cache_slot_t  *slot;
+
+    if (ngx_pool_cache_max) {
+        n = ngx_pool_cache_slot((size_t) (p->d.end - (u_char *) p));
 
-    slot->tries++;
+        if (n != NGX_DECLINED) {
+            slot = &ngx_pool_cache[n];
 
-    if (slot->number) {
-        p = slot->block;
-        slot->block = slot->block->next;
-        slot->number--;
-        return p;
+            if (slot->number < ngx_pool_cache_max) {
+                p->d.next = slot->free;
+                slot->free = p;
+                slot->number++;
+
+                ngx_pool_cache_stats.cached++;
+
+                return;
+            }
+        }
     }
 
-    return NULL;
+    ngx_free(p);
 }
 
-#endif
+
+static ngx_int_t
+ngx_pool_cache_slot(size_t size)
+{
+    ngx_uint_t  n;
+
+    if (size & (size - 1)) {
+        return NGX_DECLINED;
+    }
+
+    for (n = 0; n < NGX_POOL_CACHE_SLOTS; n++) {
+        if (size == (size_t) 1 << (n + NGX_POOL_CACHE_MIN_SHIFT)) {
+            return n;
+        }
+    }
+
+    return NGX_DECLINED;
+}
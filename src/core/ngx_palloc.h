@@ -72,6 +72,21 @@ typedef struct {
 } ngx_pool_cleanup_file_t;
 
 
+typedef struct {
+    size_t                size;
+    size_t                used;
+    size_t                blocks;
+    size_t                large;
+} ngx_pool_usage_t;
+
+
+typedef struct {
+    ngx_uint_t            hits;
+    ngx_uint_t            misses;
+    ngx_uint_t            cached;
+} ngx_pool_cache_stats_t;
+
+
 ngx_pool_t *ngx_create_pool(size_t size, ngx_log_t *log);
 void ngx_destroy_pool(ngx_pool_t *pool);
 void ngx_reset_pool(ngx_pool_t *pool);
@@ -81,6 +96,7 @@ void *ngx_pnalloc(ngx_pool_t *pool, size_t size);
 void *ngx_pcalloc(ngx_pool_t *pool, size_t size);
 void *ngx_pmemalign(ngx_pool_t *pool, size_t size, size_t alignment);
 ngx_int_t ngx_pfree(ngx_pool_t *pool, void *p);
+void ngx_pool_usage(ngx_pool_t *pool, ngx_pool_usage_t *u);
 
 
 ngx_pool_cleanup_t *ngx_pool_cleanup_add(ngx_pool_t *p, size_t size);
@@ -88,5 +104,10 @@ void ngx_pool_run_cleanup_file(ngx_pool_t *p, ngx_fd_t fd);
 void ngx_pool_cleanup_file(void *data);
 void ngx_pool_delete_file(void *data);
 
+void ngx_pool_cache_init(ngx_uint_t max);
+
+
+extern ngx_pool_cache_stats_t  ngx_pool_cache_stats;
+
 
 #endif /* _NGX_PALLOC_H_INCLUDED_ */
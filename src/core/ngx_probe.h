@@ -0,0 +1,67 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_PROBE_H_INCLUDED_
+#define _NGX_PROBE_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * Statically defined tracing probes of the "nginx" provider, enabled
+ * with --with-usdt.  A probe is a nop instruction and an ELF note, so it
+ * costs nothing until a tracer such as bpftrace attaches to it, e.g.:
+ *
+ *     bpftrace -e 'usdt:./nginx:nginx:http__request__done
+ *                  { @[arg1] = hist(arg2); }'
+ *
+ * The probes and their arguments:
+ *
+ *     event__loop__wait           timer in msec
+ *     event__loop__wakeup         msec waited for events
+ *     event__loop__done
+ *     event__timer__expire        event, handler
+ *     ssl__handshake__done        connection, protocol version, reused
+ *     http__request__start        request, uri, uri length
+ *     http__request__done         request, status, bytes sent
+ *     http__upstream__connect     request, peer name, name length, rc
+ *     http__upstream__response    request, status
+ *     http__cache__lookup         request, cache status
+ *
+ * Durations are left to the tracer, which can match the probes of the
+ * same request by its address.  Without --with-usdt no code is generated.
+ */
+
+
+#if (NGX_HAVE_USDT)
+
+#include <sys/sdt.h>
+
+#define ngx_probe(name)                                                       \
+    DTRACE_PROBE(nginx, name)
+#define ngx_probe1(name, a1)                                                  \
+    DTRACE_PROBE1(nginx, name, a1)
+#define ngx_probe2(name, a1, a2)                                              \
+    DTRACE_PROBE2(nginx, name, a1, a2)
+#define ngx_probe3(name, a1, a2, a3)                                          \
+    DTRACE_PROBE3(nginx, name, a1, a2, a3)
+#define ngx_probe4(name, a1, a2, a3, a4)                                      \
+    DTRACE_PROBE4(nginx, name, a1, a2, a3, a4)
+
+#else
+
+#define ngx_probe(name)
+#define ngx_probe1(name, a1)
+#define ngx_probe2(name, a1, a2)
+#define ngx_probe3(name, a1, a2, a3)
+#define ngx_probe4(name, a1, a2, a3, a4)
+
+#endif
+
+
+#endif /* _NGX_PROBE_H_INCLUDED_ */
@@ -72,8 +72,10 @@ static u_char *ngx_proxy_protocol_read_port(u_char *p, u_char *last,
     in_port_t *port, u_char sep);
 static u_char *ngx_proxy_protocol_v2_read(ngx_connection_t *c, u_char *buf,
     u_char *last);
+static ngx_int_t ngx_proxy_protocol_index_tlvs(ngx_connection_t *c,
+    ngx_str_t *tlvs, ngx_proxy_protocol_tlv_index_t **index);
 static ngx_int_t ngx_proxy_protocol_lookup_tlv(ngx_connection_t *c,
-    ngx_str_t *tlvs, ngx_uint_t type, ngx_str_t *value);
+    ngx_proxy_protocol_tlv_index_t *index, ngx_uint_t type, ngx_str_t *value);
 
 
 static ngx_proxy_protocol_tlv_entry_t  ngx_proxy_protocol_tlv_entries[] = {
@@ -96,6 +98,10 @@ static ngx_proxy_protocol_tlv_entry_t  ngx_proxy_protocol_tlv_ssl_entries[] = {
 };
 
 
+static const u_char  ngx_proxy_protocol_v2_signature[] =
+    "\r\n\r\n\0\r\nQUIT\n";
+
+
 u_char *
 ngx_proxy_protocol_read(ngx_connection_t *c, u_char *buf, u_char *last)
 {
@@ -103,13 +109,13 @@ ngx_proxy_protocol_read(ngx_connection_t *c, u_char *buf, u_char *last)
     u_char                *p;
     ngx_proxy_protocol_t  *pp;
 
-    static const u_char signature[] = "\r\n\r\n\0\r\nQUIT\n";
-
     p = buf;
     len = last - buf;
 
     if (len >= sizeof(ngx_proxy_protocol_header_t)
-        && ngx_memcmp(p, signature, sizeof(signature) - 1) == 0)
+        && ngx_memcmp(p, ngx_proxy_protocol_v2_signature,
+                      sizeof(ngx_proxy_protocol_v2_signature) - 1)
+           == 0)
     {
         return ngx_proxy_protocol_v2_read(c, buf, last);
     }
@@ -322,12 +328,141 @@ ngx_proxy_protocol_write(ngx_connection_t *c, u_char *buf, u_char *last)
 }
 
 
+u_char *
+ngx_proxy_protocol_v2_write(ngx_connection_t *c, u_char *buf, u_char *last,
+    ngx_proxy_protocol_tlv_value_t *tlvs, ngx_uint_t n)
+{
+    u_char                             *p;
+    size_t                              len;
+    ngx_uint_t                          i, family;
+    struct sockaddr_in                 *sin, *lsin;
+    ngx_proxy_protocol_header_t        *header;
+    ngx_proxy_protocol_inet_addrs_t    *in;
+#if (NGX_HAVE_INET6)
+    struct sockaddr_in6                *sin6, *lsin6;
+    ngx_proxy_protocol_inet6_addrs_t   *in6;
+#endif
+
+    if (ngx_connection_local_sockaddr(c, NULL, 0) != NGX_OK) {
+        return NULL;
+    }
+
+    family = c->sockaddr->sa_family;
+
+    if (c->local_sockaddr->sa_family != family) {
+        family = AF_UNSPEC;
+    }
+
+    switch (family) {
+
+    case AF_INET:
+        len = sizeof(ngx_proxy_protocol_inet_addrs_t);
+        break;
+
+#if (NGX_HAVE_INET6)
+    case AF_INET6:
+        len = sizeof(ngx_proxy_protocol_inet6_addrs_t);
+        break;
+#endif
+
+    default:
+        family = AF_UNSPEC;
+        len = 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        len += sizeof(ngx_proxy_protocol_tlv_t) + tlvs[i].value.len;
+    }
+
+    if (len > 0xffff) {
+        ngx_log_error(NGX_LOG_ERR, c->log, 0,
+                      "too large PROXY protocol header");
+        return NULL;
+    }
+
+    if ((size_t) (last - buf) < sizeof(ngx_proxy_protocol_header_t) + len) {
+        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
+                      "too small buffer for PROXY protocol");
+        return NULL;
+    }
+
+    header = (ngx_proxy_protocol_header_t *) buf;
+
+    ngx_memcpy(header->signature, ngx_proxy_protocol_v2_signature, 12);
+
+    /* version 2, PROXY command */
+    header->version_command = 0x21;
+
+    header->len[0] = (u_char) (len >> 8);
+    header->len[1] = (u_char) len;
+
+    p = buf + sizeof(ngx_proxy_protocol_header_t);
+
+    switch (family) {
+
+    case AF_INET:
+        /* STREAM transport */
+        header->family_transport = (NGX_PROXY_PROTOCOL_AF_INET << 4) | 1;
+
+        sin = (struct sockaddr_in *) c->sockaddr;
+        lsin = (struct sockaddr_in *) c->local_sockaddr;
+
+        in = (ngx_proxy_protocol_inet_addrs_t *) p;
+
+        /* addresses and ports are in network byte order */
+
+        ngx_memcpy(in->src_addr, &sin->sin_addr, 4);
+        ngx_memcpy(in->dst_addr, &lsin->sin_addr, 4);
+        ngx_memcpy(in->src_port, &sin->sin_port, 2);
+        ngx_memcpy(in->dst_port, &lsin->sin_port, 2);
+
+        p += sizeof(ngx_proxy_protocol_inet_addrs_t);
+
+        break;
+
+#if (NGX_HAVE_INET6)
+    case AF_INET6:
+        header->family_transport = (NGX_PROXY_PROTOCOL_AF_INET6 << 4) | 1;
+
+        sin6 = (struct sockaddr_in6 *) c->sockaddr;
+        lsin6 = (struct sockaddr_in6 *) c->local_sockaddr;
+
+        in6 = (ngx_proxy_protocol_inet6_addrs_t *) p;
+
+        ngx_memcpy(in6->src_addr, &sin6->sin6_addr, 16);
+        ngx_memcpy(in6->dst_addr, &lsin6->sin6_addr, 16);
+        ngx_memcpy(in6->src_port, &sin6->sin6_port, 2);
+        ngx_memcpy(in6->dst_port, &lsin6->sin6_port, 2);
+
+        p += sizeof(ngx_proxy_protocol_inet6_addrs_t);
+
+        break;
+#endif
+
+    default:
+        /* AF_UNSPEC, the receiver ignores addresses */
+        header->family_transport = 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        *p++ = (u_char) tlvs[i].type;
+        *p++ = (u_char) (tlvs[i].value.len >> 8);
+        *p++ = (u_char) tlvs[i].value.len;
+
+        p = ngx_cpymem(p, tlvs[i].value.data, tlvs[i].value.len);
+    }
+
+    return p;
+}
+
+
 static u_char *
 ngx_proxy_protocol_v2_read(ngx_connection_t *c, u_char *buf, u_char *last)
 {
     u_char                             *end;
     size_t                              len;
     socklen_t                           socklen;
+    ngx_str_t                           ssl;
     ngx_uint_t                          version, command, family, transport;
     ngx_sockaddr_t                      src_sockaddr, dst_sockaddr;
     ngx_proxy_protocol_t               *pp;
@@ -475,6 +610,33 @@ ngx_proxy_protocol_v2_read(ngx_connection_t *c, u_char *buf, u_char *last)
 
         ngx_memcpy(pp->tlvs.data, buf, end - buf);
         pp->tlvs.len = end - buf;
+
+        /* TLVs are indexed once, so variables do not scan them */
+
+        if (ngx_proxy_protocol_index_tlvs(c, &pp->tlvs, &pp->tlv_index)
+            != NGX_OK)
+        {
+            return NULL;
+        }
+
+        if (ngx_proxy_protocol_lookup_tlv(c, pp->tlv_index, 0x20, &ssl)
+            == NGX_OK)
+        {
+            if (ssl.len < sizeof(ngx_proxy_protocol_tlv_ssl_t)) {
+                ngx_log_error(NGX_LOG_ERR, c->log, 0,
+                              "broken PROXY protocol TLV");
+                return NULL;
+            }
+
+            ssl.data += sizeof(ngx_proxy_protocol_tlv_ssl_t);
+            ssl.len -= sizeof(ngx_proxy_protocol_tlv_ssl_t);
+
+            if (ngx_proxy_protocol_index_tlvs(c, &ssl, &pp->ssl_tlv_index)
+                != NGX_OK)
+            {
+                return NULL;
+            }
+        }
     }
 
     c->proxy_protocol = pp;
@@ -490,10 +652,11 @@ ngx_proxy_protocol_get_tlv(ngx_connection_t *c, ngx_str_t *name,
     u_char                          *p;
     size_t                           n;
     uint32_t                         verify;
-    ngx_str_t                        ssl, *tlvs;
+    ngx_str_t                        ssl;
     ngx_int_t                        rc, type;
     ngx_proxy_protocol_tlv_ssl_t    *tlv_ssl;
     ngx_proxy_protocol_tlv_entry_t  *te;
+    ngx_proxy_protocol_tlv_index_t  *index;
 
     if (c->proxy_protocol == NULL) {
         return NGX_DECLINED;
@@ -503,22 +666,18 @@ ngx_proxy_protocol_get_tlv(ngx_connection_t *c, ngx_str_t *name,
                    "PROXY protocol v2 get tlv \"%V\"", name);
 
     te = ngx_proxy_protocol_tlv_entries;
-    tlvs = &c->proxy_protocol->tlvs;
+    index = c->proxy_protocol->tlv_index;
 
     p = name->data;
     n = name->len;
 
     if (n >= 4 && p[0] == 's' && p[1] == 's' && p[2] == 'l' && p[3] == '_') {
 
-        rc = ngx_proxy_protocol_lookup_tlv(c, tlvs, 0x20, &ssl);
+        rc = ngx_proxy_protocol_lookup_tlv(c, index, 0x20, &ssl);
         if (rc != NGX_OK) {
             return rc;
         }
 
-        if (ssl.len < sizeof(ngx_proxy_protocol_tlv_ssl_t)) {
-            return NGX_ERROR;
-        }
-
         p += 4;
         n -= 4;
 
@@ -537,11 +696,8 @@ ngx_proxy_protocol_get_tlv(ngx_connection_t *c, ngx_str_t *name,
             return NGX_OK;
         }
 
-        ssl.data += sizeof(ngx_proxy_protocol_tlv_ssl_t);
-        ssl.len -= sizeof(ngx_proxy_protocol_tlv_ssl_t);
-
         te = ngx_proxy_protocol_tlv_ssl_entries;
-        tlvs = &ssl;
+        index = c->proxy_protocol->ssl_tlv_index;
     }
 
     if (n >= 2 && p[0] == '0' && p[1] == 'x') {
@@ -553,12 +709,12 @@ ngx_proxy_protocol_get_tlv(ngx_connection_t *c, ngx_str_t *name,
             return NGX_ERROR;
         }
 
-        return ngx_proxy_protocol_lookup_tlv(c, tlvs, type, value);
+        return ngx_proxy_protocol_lookup_tlv(c, index, type, value);
     }
 
     for ( /* void */ ; te->type; te++) {
         if (te->name.len == n && ngx_strncmp(te->name.data, p, n) == 0) {
-            return ngx_proxy_protocol_lookup_tlv(c, tlvs, te->type, value);
+            return ngx_proxy_protocol_lookup_tlv(c, index, te->type, value);
         }
     }
 
@@ -569,24 +725,53 @@ ngx_proxy_protocol_get_tlv(ngx_connection_t *c, ngx_str_t *name,
 }
 
 
+ngx_int_t
+ngx_proxy_protocol_tlv_type(ngx_str_t *name)
+{
+    ngx_int_t                        type;
+    ngx_proxy_protocol_tlv_entry_t  *te;
+
+    if (name->len > 2 && name->data[0] == '0' && name->data[1] == 'x') {
+
+        type = ngx_hextoi(name->data + 2, name->len - 2);
+        if (type == NGX_ERROR || type > 0xff) {
+            return NGX_ERROR;
+        }
+
+        return type;
+    }
+
+    for (te = ngx_proxy_protocol_tlv_entries; te->type; te++) {
+        if (te->name.len == name->len
+            && ngx_strncmp(te->name.data, name->data, name->len) == 0)
+        {
+            return te->type;
+        }
+    }
+
+    return NGX_ERROR;
+}
+
+
 static ngx_int_t
-ngx_proxy_protocol_lookup_tlv(ngx_connection_t *c, ngx_str_t *tlvs,
-    ngx_uint_t type, ngx_str_t *value)
+ngx_proxy_protocol_index_tlvs(ngx_connection_t *c, ngx_str_t *tlvs,
+    ngx_proxy_protocol_tlv_index_t **index)
 {
-    u_char                    *p;
-    size_t                     n, len;
-    ngx_proxy_protocol_tlv_t  *tlv;
+    u_char                          *p;
+    size_t                           n, len;
+    ngx_uint_t                       i;
+    ngx_proxy_protocol_tlv_t        *tlv;
+    ngx_proxy_protocol_tlv_index_t  *idx;
 
-    ngx_log_debug1(NGX_LOG_DEBUG_CORE, c->log, 0,
-                   "PROXY protocol v2 lookup tlv:%02xi", type);
+    /* TLVs are validated and counted first */
 
+    i = 0;
     p = tlvs->data;
     n = tlvs->len;
 
     while (n) {
         if (n < sizeof(ngx_proxy_protocol_tlv_t)) {
-            ngx_log_error(NGX_LOG_ERR, c->log, 0, "broken PROXY protocol TLV");
-            return NGX_ERROR;
+            goto broken;
         }
 
         tlv = (ngx_proxy_protocol_tlv_t *) p;
@@ -596,19 +781,78 @@ ngx_proxy_protocol_lookup_tlv(ngx_connection_t *c, ngx_str_t *tlvs,
         n -= sizeof(ngx_proxy_protocol_tlv_t);
 
         if (n < len) {
-            ngx_log_error(NGX_LOG_ERR, c->log, 0, "broken PROXY protocol TLV");
-            return NGX_ERROR;
+            goto broken;
         }
 
-        if (tlv->type == type) {
-            value->data = p;
-            value->len = len;
-            return NGX_OK;
+        p += len;
+        n -= len;
+
+        i++;
+    }
+
+    if (i == 0) {
+        *index = NULL;
+        return NGX_OK;
+    }
+
+    idx = ngx_pcalloc(c->pool, offsetof(ngx_proxy_protocol_tlv_index_t, value)
+                               + i * sizeof(ngx_str_t));
+    if (idx == NULL) {
+        return NGX_ERROR;
+    }
+
+    i = 0;
+    p = tlvs->data;
+    n = tlvs->len;
+
+    while (n) {
+        tlv = (ngx_proxy_protocol_tlv_t *) p;
+        len = ngx_proxy_protocol_parse_uint16(tlv->len);
+
+        p += sizeof(ngx_proxy_protocol_tlv_t);
+
+        if (idx->slot[tlv->type] == 0) {
+            idx->value[i].len = len;
+            idx->value[i].data = p;
+            idx->slot[tlv->type] = (uint16_t) ++i;
         }
 
         p += len;
-        n -= len;
+        n -= sizeof(ngx_proxy_protocol_tlv_t) + len;
     }
 
-    return NGX_DECLINED;
+    *index = idx;
+
+    return NGX_OK;
+
+broken:
+
+    ngx_log_error(NGX_LOG_ERR, c->log, 0, "broken PROXY protocol TLV");
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_proxy_protocol_lookup_tlv(ngx_connection_t *c,
+    ngx_proxy_protocol_tlv_index_t *index, ngx_uint_t type, ngx_str_t *value)
+{
+    ngx_uint_t  n;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, c->log, 0,
+                   "PROXY protocol v2 lookup tlv:%02xi", type);
+
+    if (index == NULL || type > 0xff) {
+        return NGX_DECLINED;
+    }
+
+    n = index->slot[type];
+
+    if (n == 0) {
+        return NGX_DECLINED;
+    }
+
+    *value = index->value[n - 1];
+
+    return NGX_OK;
 }
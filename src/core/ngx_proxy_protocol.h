@@ -16,13 +16,32 @@
 #define NGX_PROXY_PROTOCOL_V1_MAX_HEADER  107
 #define NGX_PROXY_PROTOCOL_MAX_HEADER     4096
 
+/* the v2 header and addresses, TLVs excluded */
+#define NGX_PROXY_PROTOCOL_V2_MAX_HEADER  52
+
+
+/* TLVs by type, values point to the first TLV of each type */
+
+typedef struct {
+    uint16_t            slot[256];
+    ngx_str_t           value[1];
+} ngx_proxy_protocol_tlv_index_t;
+
+
+typedef struct {
+    ngx_uint_t          type;
+    ngx_str_t           value;
+} ngx_proxy_protocol_tlv_value_t;
+
 
 struct ngx_proxy_protocol_s {
-    ngx_str_t           src_addr;
-    ngx_str_t           dst_addr;
-    in_port_t           src_port;
-    in_port_t           dst_port;
-    ngx_str_t           tlvs;
+    ngx_str_t                        src_addr;
+    ngx_str_t                        dst_addr;
+    in_port_t                        src_port;
+    in_port_t                        dst_port;
+    ngx_str_t                        tlvs;
+    ngx_proxy_protocol_tlv_index_t  *tlv_index;
+    ngx_proxy_protocol_tlv_index_t  *ssl_tlv_index;
 };
 
 
@@ -30,6 +49,9 @@ u_char *ngx_proxy_protocol_read(ngx_connection_t *c, u_char *buf,
     u_char *last);
 u_char *ngx_proxy_protocol_write(ngx_connection_t *c, u_char *buf,
     u_char *last);
+u_char *ngx_proxy_protocol_v2_write(ngx_connection_t *c, u_char *buf,
+    u_char *last, ngx_proxy_protocol_tlv_value_t *tlvs, ngx_uint_t n);
+ngx_int_t ngx_proxy_protocol_tlv_type(ngx_str_t *name);
 ngx_int_t ngx_proxy_protocol_get_tlv(ngx_connection_t *c, ngx_str_t *name,
     ngx_str_t *value);
 
@@ -9,6 +9,12 @@
 #include <ngx_core.h>
 
 
+#define NGX_RADIX_STRIDE   4
+#define NGX_RADIX_ENTRIES  (1 << NGX_RADIX_STRIDE)
+
+
+static ngx_int_t ngx_radix_compile(ngx_radix_tree_t *tree,
+    ngx_radix_node_t *node, uintptr_t value, ngx_radix_entry_t *table);
 static ngx_radix_node_t *ngx_radix_alloc(ngx_radix_tree_t *tree);
 
 
@@ -27,6 +33,7 @@ ngx_radix_tree_create(ngx_pool_t *pool, ngx_int_t preallocate)
     tree->free = NULL;
     tree->start = NULL;
     tree->size = 0;
+    tree->table = NULL;
 
     tree->root = ngx_radix_alloc(tree);
     if (tree->root == NULL) {
@@ -112,6 +119,8 @@ ngx_radix32tree_insert(ngx_radix_tree_t *tree, uint32_t key, uint32_t mask,
     uint32_t           bit;
     ngx_radix_node_t  *node, *next;
 
+    tree->table = NULL;
+
     bit = 0x80000000;
 
     node = tree->root;
@@ -176,6 +185,8 @@ ngx_radix32tree_delete(ngx_radix_tree_t *tree, uint32_t key, uint32_t mask)
     uint32_t           bit;
     ngx_radix_node_t  *node;
 
+    tree->table = NULL;
+
     bit = 0x80000000;
     node = tree->root;
 
@@ -236,9 +247,25 @@ ngx_radix32tree_delete(ngx_radix_tree_t *tree, uint32_t key, uint32_t mask)
 uintptr_t
 ngx_radix32tree_find(ngx_radix_tree_t *tree, uint32_t key)
 {
-    uint32_t           bit;
-    uintptr_t          value;
-    ngx_radix_node_t  *node;
+    uint32_t            bit;
+    uintptr_t           value;
+    ngx_uint_t          shift;
+    ngx_radix_node_t   *node;
+    ngx_radix_entry_t  *entry;
+
+    if (tree->table) {
+        entry = tree->table;
+        shift = 32;
+
+        do {
+            shift -= NGX_RADIX_STRIDE;
+            entry = &entry[(key >> shift) & (NGX_RADIX_ENTRIES - 1)];
+            value = entry->value;
+            entry = entry->next;
+        } while (entry && shift);
+
+        return value;
+    }
 
     bit = 0x80000000;
     value = NGX_RADIX_NO_VALUE;
@@ -273,6 +300,8 @@ ngx_radix128tree_insert(ngx_radix_tree_t *tree, u_char *key, u_char *mask,
     ngx_uint_t         i;
     ngx_radix_node_t  *node, *next;
 
+    tree->table = NULL;
+
     i = 0;
     bit = 0x80;
 
@@ -355,6 +384,8 @@ ngx_radix128tree_delete(ngx_radix_tree_t *tree, u_char *key, u_char *mask)
     ngx_uint_t         i;
     ngx_radix_node_t  *node;
 
+    tree->table = NULL;
+
     i = 0;
     bit = 0x80;
     node = tree->root;
@@ -424,10 +455,24 @@ ngx_radix128tree_delete(ngx_radix_tree_t *tree, u_char *key, u_char *mask)
 uintptr_t
 ngx_radix128tree_find(ngx_radix_tree_t *tree, u_char *key)
 {
-    u_char             bit;
-    uintptr_t          value;
-    ngx_uint_t         i;
-    ngx_radix_node_t  *node;
+    u_char              bit;
+    uintptr_t           value;
+    ngx_uint_t          i;
+    ngx_radix_node_t   *node;
+    ngx_radix_entry_t  *entry;
+
+    if (tree->table) {
+        entry = tree->table;
+        i = 0;
+
+        do {
+            entry = &entry[(i & 1) ? key[i >> 1] & 0x0f : key[i >> 1] >> 4];
+            value = entry->value;
+            entry = entry->next;
+        } while (entry && ++i < 32);
+
+        return value;
+    }
 
     i = 0;
     bit = 0x80;
@@ -460,6 +505,90 @@ ngx_radix128tree_find(ngx_radix_tree_t *tree, u_char *key)
 #endif
 
 
+ngx_int_t
+ngx_radix_tree_compile(ngx_radix_tree_t *tree)
+{
+    ngx_radix_entry_t  *table;
+
+    table = ngx_palloc(tree->pool,
+                       NGX_RADIX_ENTRIES * sizeof(ngx_radix_entry_t));
+    if (table == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_radix_compile(tree, tree->root, tree->root->value, table)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    tree->table = table;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_radix_compile(ngx_radix_tree_t *tree, ngx_radix_node_t *node,
+    uintptr_t value, ngx_radix_entry_t *table)
+{
+    uintptr_t           v;
+    ngx_uint_t          i, k, bit;
+    ngx_radix_node_t   *n;
+    ngx_radix_entry_t   sub[NGX_RADIX_ENTRIES];
+
+    for (k = 0; k < NGX_RADIX_ENTRIES; k++) {
+
+        n = node;
+        v = value;
+
+        for (bit = NGX_RADIX_ENTRIES >> 1; bit; bit >>= 1) {
+            n = (k & bit) ? n->right : n->left;
+
+            if (n == NULL) {
+                break;
+            }
+
+            if (n->value != NGX_RADIX_NO_VALUE) {
+                v = n->value;
+            }
+        }
+
+        table[k].value = v;
+        table[k].next = NULL;
+
+        if (n == NULL || (n->left == NULL && n->right == NULL)) {
+            continue;
+        }
+
+        if (ngx_radix_compile(tree, n, v, sub) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        /* no table is needed if nothing more specific is below */
+
+        for (i = 0; i < NGX_RADIX_ENTRIES; i++) {
+            if (sub[i].value != v || sub[i].next) {
+                break;
+            }
+        }
+
+        if (i == NGX_RADIX_ENTRIES) {
+            continue;
+        }
+
+        table[k].next = ngx_palloc(tree->pool, sizeof(sub));
+        if (table[k].next == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(table[k].next, sub, sizeof(sub));
+    }
+
+    return NGX_OK;
+}
+
+
 static ngx_radix_node_t *
 ngx_radix_alloc(ngx_radix_tree_t *tree)
 {
@@ -163,7 +163,13 @@ ngx_regex_compile(ngx_regex_compile_t *rc)
         options |= PCRE2_MULTILINE;
     }
 
-    if (rc->options & ~(NGX_REGEX_CASELESS|NGX_REGEX_MULTILINE)) {
+    if (rc->options & NGX_REGEX_DUPNAMES) {
+        options |= PCRE2_DUPNAMES;
+    }
+
+    if (rc->options
+        & ~(NGX_REGEX_CASELESS|NGX_REGEX_MULTILINE|NGX_REGEX_DUPNAMES))
+    {
         rc->err.len = ngx_snprintf(rc->err.data, rc->err.len,
                             "regex \"%V\" compilation failed: invalid options",
                             &rc->pattern)
@@ -283,7 +289,13 @@ ngx_regex_compile(ngx_regex_compile_t *rc)
         options |= PCRE_MULTILINE;
     }
 
-    if (rc->options & ~(NGX_REGEX_CASELESS|NGX_REGEX_MULTILINE)) {
+    if (rc->options & NGX_REGEX_DUPNAMES) {
+        options |= PCRE_DUPNAMES;
+    }
+
+    if (rc->options
+        & ~(NGX_REGEX_CASELESS|NGX_REGEX_MULTILINE|NGX_REGEX_DUPNAMES))
+    {
         rc->err.len = ngx_snprintf(rc->err.data, rc->err.len,
                             "regex \"%V\" compilation failed: invalid options",
                             &rc->pattern)
@@ -495,6 +507,217 @@ ngx_regex_exec_array(ngx_array_t *a, ngx_str_t *s, ngx_log_t *log)
 }
 
 
+/*
+ * A set of patterns is compiled into a single regex
+ *
+ *     \A(?:(?s:.*?)(?:re0)(*MARK:0)|(?s:.*?)(?i:re1)(*MARK:1)|...)
+ *
+ * where an alternative is tried at all positions of the subject before
+ * the next one, so the mark is the index of the first pattern in the set
+ * that matches.  Patterns with backreferences, recursion, verbs, or
+ * options that affect the rest of the set are not supported.
+ */
+
+ngx_uint_t
+ngx_regex_set_supported(ngx_str_t *pattern)
+{
+    u_char  *p, *last;
+
+    p = pattern->data;
+    last = p + pattern->len;
+
+    while (p < last) {
+
+        if (*p == '\\') {
+            p++;
+
+            if (p == last
+                || (*p >= '1' && *p <= '9')
+                || *p == 'g' || *p == 'k' || *p == 'Q' || *p == 'E')
+            {
+                return 0;
+            }
+
+            p++;
+            continue;
+        }
+
+        if (*p++ != '(' || p == last) {
+            continue;
+        }
+
+        if (*p == '*') {
+            return 0;
+        }
+
+        if (*p++ != '?' || p == last) {
+            continue;
+        }
+
+        switch (*p) {
+
+        case ':':
+        case '=':
+        case '!':
+        case '|':
+        case '>':
+        case '<':
+        case '\'':
+        case '#':
+            continue;
+
+        case 'P':
+            if (p + 1 < last && p[1] == '<') {
+                continue;
+            }
+
+            return 0;
+        }
+
+        /* inline options */
+
+        while (p < last && *p != ':' && *p != ')') {
+            if (ngx_strchr("imnsJU^-", *p) == NULL) {
+                return 0;
+            }
+
+            p++;
+        }
+    }
+
+    return 1;
+}
+
+
+ngx_int_t
+ngx_regex_compile_set(ngx_regex_compile_t *rc, ngx_regex_compile_t *elts,
+    ngx_uint_t n)
+{
+    u_char      *p;
+    size_t       len;
+    ngx_uint_t   i;
+
+    len = sizeof("\\A(?:)") - 1;
+
+    for (i = 0; i < n; i++) {
+        if (!ngx_regex_set_supported(&elts[i].pattern)
+            || (elts[i].options & ~NGX_REGEX_CASELESS))
+        {
+            return NGX_DECLINED;
+        }
+
+        len += sizeof("(?s:.*?)(?i:)(*MARK:)|") - 1 + NGX_INT_T_LEN
+               + elts[i].pattern.len;
+    }
+
+    p = ngx_pnalloc(rc->pool, len);
+    if (p == NULL) {
+        rc->err.len = ngx_snprintf(rc->err.data, rc->err.len,
+                                   "regex set compilation failed: no memory")
+                      - rc->err.data;
+        return NGX_ERROR;
+    }
+
+    rc->pattern.data = p;
+
+    p = ngx_cpymem(p, "\\A(?:", sizeof("\\A(?:") - 1);
+
+    for (i = 0; i < n; i++) {
+        if (i) {
+            *p++ = '|';
+        }
+
+        /* an anchored pattern is only tried at the start */
+
+        if (elts[i].pattern.len == 0 || elts[i].pattern.data[0] != '^') {
+            p = ngx_cpymem(p, "(?s:.*?)", sizeof("(?s:.*?)") - 1);
+        }
+
+        if (elts[i].options & NGX_REGEX_CASELESS) {
+            p = ngx_cpymem(p, "(?i:", sizeof("(?i:") - 1);
+
+        } else {
+            p = ngx_cpymem(p, "(?:", sizeof("(?:") - 1);
+        }
+
+        p = ngx_cpymem(p, elts[i].pattern.data, elts[i].pattern.len);
+        p = ngx_sprintf(p, ")(*MARK:%ui)", i);
+    }
+
+    *p++ = ')';
+
+    rc->pattern.len = p - rc->pattern.data;
+    rc->options = NGX_REGEX_DUPNAMES;
+
+    return ngx_regex_compile(rc);
+}
+
+
+#if (NGX_PCRE2)
+
+ngx_int_t
+ngx_regex_exec_set(ngx_regex_t *re, ngx_str_t *s)
+{
+    ngx_int_t   rc;
+    PCRE2_SPTR  mark;
+
+    rc = ngx_regex_exec(re, s, NULL, 0);
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    mark = pcre2_get_mark(ngx_regex_match_data);
+
+    if (mark == NULL) {
+        return PCRE2_ERROR_INTERNAL;
+    }
+
+    rc = ngx_atoi((u_char *) mark, ngx_strlen(mark));
+
+    return (rc == NGX_ERROR) ? PCRE2_ERROR_INTERNAL : rc;
+}
+
+#else
+
+ngx_int_t
+ngx_regex_exec_set(ngx_regex_t *re, ngx_str_t *s)
+{
+    u_char      *mark;
+    ngx_int_t    rc;
+    pcre_extra   extra;
+
+    if (re->extra) {
+        extra = *re->extra;
+
+    } else {
+        ngx_memzero(&extra, sizeof(pcre_extra));
+    }
+
+    mark = NULL;
+
+    extra.flags |= PCRE_EXTRA_MARK;
+    extra.mark = &mark;
+
+    rc = pcre_exec(re->code, &extra, (const char *) s->data, s->len,
+                   0, 0, NULL, 0);
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    if (mark == NULL) {
+        return PCRE_ERROR_INTERNAL;
+    }
+
+    rc = ngx_atoi(mark, ngx_strlen(mark));
+
+    return (rc == NGX_ERROR) ? PCRE_ERROR_INTERNAL : rc;
+}
+
+#endif
+
+
 #if (NGX_PCRE2)
 
 static void * ngx_libc_cdecl
@@ -38,6 +38,7 @@ typedef struct {
 
 #define NGX_REGEX_CASELESS     0x00000001
 #define NGX_REGEX_MULTILINE    0x00000002
+#define NGX_REGEX_DUPNAMES     0x00000004
 
 
 typedef struct {
@@ -74,5 +75,10 @@ ngx_int_t ngx_regex_exec(ngx_regex_t *re, ngx_str_t *s, int *captures,
 
 ngx_int_t ngx_regex_exec_array(ngx_array_t *a, ngx_str_t *s, ngx_log_t *log);
 
+ngx_uint_t ngx_regex_set_supported(ngx_str_t *pattern);
+ngx_int_t ngx_regex_compile_set(ngx_regex_compile_t *rc,
+    ngx_regex_compile_t *elts, ngx_uint_t n);
+ngx_int_t ngx_regex_exec_set(ngx_regex_t *re, ngx_str_t *s);
+
 
 #endif /* _NGX_REGEX_H_INCLUDED_ */
@@ -54,6 +54,26 @@ typedef struct {
 #define ngx_resolver_node(n)  ngx_rbtree_data(n, ngx_resolver_node_t, node)
 
 
+/*
+ * a shared answer: the name, IPv4 and IPv6 addresses, and CNAME, or
+ * the error code; "pending" is set while a worker process resolves it
+ */
+
+typedef struct {
+    ngx_str_node_t            sn;
+    ngx_queue_t               queue;
+    time_t                    valid;
+    time_t                    pending;
+    u_char                    code;
+    u_char                    ipv4;
+    u_char                    ipv6;
+    u_short                   naddrs;
+    u_short                   naddrs6;
+    u_short                   cnlen;
+    u_char                    data[1];
+} ngx_resolver_zone_node_t;
+
+
 static ngx_int_t ngx_udp_connect(ngx_resolver_connection_t *rec);
 static ngx_int_t ngx_tcp_connect(ngx_resolver_connection_t *rec);
 
@@ -120,6 +140,25 @@ static void ngx_resolver_resolve_srv_names(ngx_resolver_ctx_t *ctx,
     ngx_resolver_node_t *rn);
 static void ngx_resolver_srv_names_handler(ngx_resolver_ctx_t *ctx);
 static ngx_int_t ngx_resolver_cmp_srvs(const void *one, const void *two);
+static ngx_int_t ngx_resolver_zone_add(ngx_conf_t *cf, ngx_resolver_t *r,
+    ngx_str_t *value);
+static ngx_int_t ngx_resolver_zone_init(ngx_shm_zone_t *shm_zone, void *data);
+static ngx_int_t ngx_resolver_zone_lookup(ngx_resolver_t *r,
+    ngx_resolver_node_t *rn);
+static ngx_int_t ngx_resolver_zone_copy(ngx_resolver_t *r,
+    ngx_resolver_node_t *rn, ngx_resolver_zone_node_t *zn);
+static void ngx_resolver_zone_update(ngx_resolver_t *r,
+    ngx_resolver_node_t *rn, ngx_uint_t code, time_t valid);
+static ngx_resolver_zone_node_t *ngx_resolver_zone_alloc(
+    ngx_resolver_zone_t *zone, ngx_str_t *name, uint32_t hash, size_t size);
+static void ngx_resolver_zone_expire(ngx_resolver_zone_t *zone,
+    ngx_uint_t force);
+static void ngx_resolver_zone_handler(ngx_event_t *ev);
+static void ngx_resolver_refresh(ngx_resolver_t *r, ngx_resolver_node_t *rn,
+    ngx_queue_t *resend_queue);
+static ngx_int_t ngx_resolver_report_stale(ngx_resolver_t *r,
+    ngx_resolver_ctx_t *ctx, ngx_resolver_node_t *rn);
+static void ngx_resolver_restore(ngx_resolver_t *r, ngx_resolver_node_t *rn);
 
 #if (NGX_HAVE_INET6)
 static void ngx_resolver_rbtree_insert_addr6_value(ngx_rbtree_node_t *temp,
@@ -132,6 +171,7 @@ static ngx_resolver_node_t *ngx_resolver_lookup_addr6(ngx_resolver_t *r,
 ngx_resolver_t *
 ngx_resolver_create(ngx_conf_t *cf, ngx_str_t *names, ngx_uint_t n)
 {
+    ngx_int_t                   pct;
     ngx_str_t                   s;
     ngx_url_t                   u;
     ngx_uint_t                  i, j;
@@ -226,6 +266,51 @@ ngx_resolver_create(ngx_conf_t *cf, ngx_str_t *names, ngx_uint_t n)
             continue;
         }
 
+        if (ngx_strncmp(names[i].data, "stale=", 6) == 0) {
+            s.len = names[i].len - 6;
+            s.data = names[i].data + 6;
+
+            r->stale = ngx_parse_time(&s, 1);
+
+            if (r->stale == (time_t) NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid parameter: %V", &names[i]);
+                return NULL;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(names[i].data, "prefetch=", 9) == 0) {
+
+            if (names[i].data[names[i].len - 1] != '%') {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid parameter: %V", &names[i]);
+                return NULL;
+            }
+
+            pct = ngx_atoi(names[i].data + 9, names[i].len - 10);
+
+            if (pct == NGX_ERROR || pct > 100) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid parameter: %V", &names[i]);
+                return NULL;
+            }
+
+            r->prefetch = pct;
+
+            continue;
+        }
+
+        if (ngx_strncmp(names[i].data, "zone=", 5) == 0) {
+
+            if (ngx_resolver_zone_add(cf, r, &names[i]) != NGX_OK) {
+                return NULL;
+            }
+
+            continue;
+        }
+
 #if (NGX_HAVE_INET6)
         if (ngx_strncmp(names[i].data, "ipv4=", 5) == 0) {
 
@@ -333,6 +418,10 @@ ngx_resolver_cleanup(void *data)
         ngx_del_timer(r->event);
     }
 
+    if (r->zone_event && r->zone_event->timer_set) {
+        ngx_del_timer(r->zone_event);
+    }
+
     rec = r->connections.elts;
 
     for (i = 0; i < r->connections.nelts; i++) {
@@ -609,7 +698,7 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
     uint32_t              hash;
     ngx_int_t             rc;
     ngx_str_t             cname;
-    ngx_uint_t            i, naddrs;
+    ngx_uint_t            i, naddrs, code;
     ngx_queue_t          *resend_queue, *expire_queue;
     ngx_rbtree_t         *tree;
     ngx_resolver_ctx_t   *next, *last;
@@ -640,6 +729,20 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
         /* ctx can be a list after NGX_RESOLVE_CNAME */
         for (last = ctx; last->next; last = last->next);
 
+        if ((r->prefetch || r->stale) && ctx->service.len == 0) {
+            ngx_resolver_refresh(r, rn, resend_queue);
+        }
+
+        if (rn->stale
+            && (rn->stale_valid ? rn->stale_valid
+                                : rn->stale->valid + r->stale)
+               >= ngx_time())
+        {
+            ngx_log_debug0(NGX_LOG_DEBUG_CORE, r->log, 0, "resolve stale");
+
+            return ngx_resolver_report_stale(r, ctx, rn->stale);
+        }
+
         if (rn->valid >= ngx_time()) {
 
             ngx_log_debug0(NGX_LOG_DEBUG_CORE, r->log, 0, "resolve cached");
@@ -779,6 +882,13 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
 #endif
         }
 
+        if (rn->stale) {
+            ngx_resolver_free_node(r, rn->stale);
+            rn->stale = NULL;
+        }
+
+        rn->stale_valid = 0;
+
         if (rn->cnlen) {
             ngx_resolver_free_locked(r, rn->u.cname);
         }
@@ -824,6 +934,8 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
 #if (NGX_HAVE_INET6)
         rn->query6 = NULL;
 #endif
+        rn->stale = NULL;
+        rn->stale_valid = 0;
 
         ngx_rbtree_insert(tree, &rn->node);
     }
@@ -870,8 +982,57 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
     rn->tcp6 = 0;
 #endif
     rn->nsrvs = 0;
+    rn->zone_wait = 0;
 
-    if (ngx_resolver_send_query(r, rn) != NGX_OK) {
+    rc = NGX_AGAIN;
+
+    if (r->zone && ctx->service.len == 0) {
+
+        rc = ngx_resolver_zone_lookup(r, rn);
+
+        if (rc == NGX_OK) {
+
+            /* resolved by another worker process */
+
+            rn->expire = ngx_time() + r->expire;
+            rn->waiting = NULL;
+
+            ngx_queue_insert_head(expire_queue, &rn->queue);
+
+            return ngx_resolve_name_locked(r, ctx, name);
+        }
+
+        if (rc == NGX_DECLINED) {
+            code = rn->code;
+
+            ngx_rbtree_delete(tree, &rn->node);
+            ngx_resolver_free_node(r, rn);
+
+            do {
+                ctx->state = code;
+                ctx->valid = ngx_time() + (r->valid ? r->valid : 10);
+                next = ctx->next;
+
+                ctx->handler(ctx);
+
+                ctx = next;
+            } while (ctx);
+
+            return NGX_OK;
+        }
+    }
+
+    if (rc == NGX_BUSY) {
+
+        /* wait for the answer of another worker process */
+
+        rn->zone_wait = 1;
+
+        if (!r->zone_event->timer_set) {
+            ngx_add_timer(r->zone_event, NGX_RESOLVER_ZONE_POLL);
+        }
+
+    } else if (ngx_resolver_send_query(r, rn) != NGX_OK) {
 
         /* immediately retry once on failure */
 
@@ -1063,6 +1224,7 @@ ngx_resolve_addr(ngx_resolver_ctx_t *ctx)
 #if (NGX_HAVE_INET6)
         rn->query6 = NULL;
 #endif
+        rn->stale = NULL;
 
         ngx_rbtree_insert(tree, &rn->node);
     }
@@ -1547,6 +1709,8 @@ ngx_resolver_resend(ngx_resolver_t *r, ngx_rbtree_t *tree, ngx_queue_t *queue)
                 rn->last_connection = 0;
             }
 
+            rn->zone_wait = 0;
+
             (void) ngx_resolver_send_query(r, rn);
 
             rn->expire = now + r->resend_timeout;
@@ -1556,6 +1720,17 @@ ngx_resolver_resend(ngx_resolver_t *r, ngx_rbtree_t *tree, ngx_queue_t *queue)
             continue;
         }
 
+        if (rn->stale) {
+
+            /* the name servers did not answer the refresh in time */
+
+            ngx_resolver_restore(r, rn);
+
+            ngx_queue_insert_head(&r->name_expire_queue, q);
+
+            continue;
+        }
+
         ngx_rbtree_delete(tree, &rn->node);
 
         ngx_resolver_free_node(r, rn);
@@ -2128,6 +2303,29 @@ ngx_resolver_process_a(ngx_resolver_t *r, u_char *buf, size_t n,
         }
 #endif
 
+        if (rn->stale && rn->waiting == NULL
+            && code != NGX_RESOLVE_NXDOMAIN)
+        {
+            ngx_log_error(r->log_level, r->log, 0,
+                          "\"%*s\" could not be refreshed (%ui: %s), "
+                          "using previous answer",
+                          (size_t) rn->nlen, rn->name, code,
+                          ngx_resolver_strerror(code));
+
+            ngx_queue_remove(&rn->queue);
+
+            ngx_resolver_restore(r, rn);
+
+            ngx_queue_insert_head(&r->name_expire_queue, &rn->queue);
+
+            return;
+        }
+
+        if (r->zone) {
+            ngx_resolver_zone_update(r, rn, code,
+                                     ngx_time() + (r->valid ? r->valid : 10));
+        }
+
         next = rn->waiting;
         rn->waiting = NULL;
 
@@ -2447,6 +2645,17 @@ ngx_resolver_process_a(ngx_resolver_t *r, u_char *buf, size_t n,
 
         ngx_queue_insert_head(&r->name_expire_queue, &rn->queue);
 
+        if (rn->stale) {
+            ngx_resolver_free_node(r, rn->stale);
+            rn->stale = NULL;
+        }
+
+        rn->stale_valid = 0;
+
+        if (r->zone) {
+            ngx_resolver_zone_update(r, rn, 0, rn->valid);
+        }
+
         next = rn->waiting;
         rn->waiting = NULL;
 
@@ -2519,6 +2728,17 @@ ngx_resolver_process_a(ngx_resolver_t *r, u_char *buf, size_t n,
 
         ngx_queue_insert_head(&r->name_expire_queue, &rn->queue);
 
+        if (rn->stale) {
+            ngx_resolver_free_node(r, rn->stale);
+            rn->stale = NULL;
+        }
+
+        rn->stale_valid = 0;
+
+        if (r->zone) {
+            ngx_resolver_zone_update(r, rn, 0, rn->valid);
+        }
+
         ngx_resolver_free(r, rn->query);
         rn->query = NULL;
 #if (NGX_HAVE_INET6)
@@ -4121,6 +4341,10 @@ ngx_resolver_free_node(ngx_resolver_t *r, ngx_resolver_node_t *rn)
         ngx_resolver_free_locked(r, rn->name);
     }
 
+    if (rn->stale) {
+        ngx_resolver_free_node(r, rn->stale);
+    }
+
     if (rn->cnlen) {
         ngx_resolver_free_locked(r, rn->u.cname);
     }
@@ -4739,3 +4963,799 @@ ngx_resolver_cmp_srvs(const void *one, const void *two)
 
     return p1 - p2;
 }
+
+
+static ngx_int_t
+ngx_resolver_zone_add(ngx_conf_t *cf, ngx_resolver_t *r, ngx_str_t *value)
+{
+    u_char               *p;
+    ssize_t               size;
+    ngx_str_t             name, s;
+    ngx_shm_zone_t       *shm_zone;
+    ngx_resolver_zone_t  *zone;
+
+    name.data = value->data + 5;
+
+    p = (u_char *) ngx_strchr(name.data, ':');
+
+    if (p == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", value);
+        return NGX_ERROR;
+    }
+
+    name.len = p - name.data;
+
+    s.data = p + 1;
+    s.len = value->data + value->len - s.data;
+
+    size = ngx_parse_size(&s);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", value);
+        return NGX_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * ngx_pagesize)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", value);
+        return NGX_ERROR;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &name, size, &ngx_core_module);
+    if (shm_zone == NULL) {
+        return NGX_ERROR;
+    }
+
+    r->zone_event = ngx_pcalloc(cf->pool, sizeof(ngx_event_t));
+    if (r->zone_event == NULL) {
+        return NGX_ERROR;
+    }
+
+    r->zone_event->handler = ngx_resolver_zone_handler;
+    r->zone_event->data = r;
+    r->zone_event->log = &cf->cycle->new_log;
+    r->zone_event->cancelable = 1;
+
+    /* the zone may be shared by several resolvers */
+
+    if (shm_zone->data) {
+        r->zone = shm_zone->data;
+        return NGX_OK;
+    }
+
+    zone = ngx_pcalloc(cf->pool, sizeof(ngx_resolver_zone_t));
+    if (zone == NULL) {
+        return NGX_ERROR;
+    }
+
+    zone->shm_zone = shm_zone;
+
+    shm_zone->init = ngx_resolver_zone_init;
+    shm_zone->data = zone;
+
+    r->zone = zone;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_resolver_zone_init(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_resolver_zone_t  *ozone = data;
+
+    size_t                len;
+    ngx_resolver_zone_t  *zone;
+
+    zone = shm_zone->data;
+
+    if (ozone) {
+        zone->sh = ozone->sh;
+        zone->shpool = ozone->shpool;
+        return NGX_OK;
+    }
+
+    zone->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        zone->sh = zone->shpool->data;
+        return NGX_OK;
+    }
+
+    zone->sh = ngx_slab_alloc(zone->shpool, sizeof(ngx_resolver_sh_t));
+    if (zone->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    zone->shpool->data = zone->sh;
+
+    ngx_rbtree_init(&zone->sh->rbtree, &zone->sh->sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&zone->sh->queue);
+
+    len = sizeof(" in resolver zone \"\"") + shm_zone->shm.name.len;
+
+    zone->shpool->log_ctx = ngx_slab_alloc(zone->shpool, len);
+    if (zone->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(zone->shpool->log_ctx, " in resolver zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    zone->shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
+/*
+ * NGX_OK or NGX_DECLINED: the answer or the error another worker process
+ * got is copied to the node, NGX_BUSY: another worker process resolves
+ * the name, NGX_AGAIN: the name is to be resolved by this worker process
+ */
+
+static ngx_int_t
+ngx_resolver_zone_lookup(ngx_resolver_t *r, ngx_resolver_node_t *rn)
+{
+    time_t                     now;
+    ngx_int_t                  rc;
+    ngx_str_t                  name;
+    ngx_resolver_zone_t       *zone;
+    ngx_resolver_zone_node_t  *zn;
+
+    zone = r->zone;
+
+    name.len = rn->nlen;
+    name.data = rn->name;
+
+    now = ngx_time();
+
+    ngx_shmtx_lock(&zone->shpool->mutex);
+
+    zn = (ngx_resolver_zone_node_t *)
+             ngx_str_rbtree_lookup(&zone->sh->rbtree, &name, rn->node.key);
+
+    if (zn == NULL) {
+        zn = ngx_resolver_zone_alloc(zone, &name, rn->node.key, 0);
+
+        if (zn) {
+            goto pending;
+        }
+
+        ngx_shmtx_unlock(&zone->shpool->mutex);
+
+        return NGX_AGAIN;
+    }
+
+    ngx_queue_remove(&zn->queue);
+    ngx_queue_insert_head(&zone->sh->queue, &zn->queue);
+
+    /* an answer without the address families needed is not used */
+
+    if (zn->ipv4 < r->ipv4
+#if (NGX_HAVE_INET6)
+        || zn->ipv6 < r->ipv6
+#endif
+       )
+    {
+        if (zn->pending < now) {
+            zn->valid = 0;
+            goto pending;
+        }
+
+        ngx_shmtx_unlock(&zone->shpool->mutex);
+        return NGX_AGAIN;
+    }
+
+    if (zn->valid >= now) {
+        rc = ngx_resolver_zone_copy(r, rn, zn);
+
+        if (rc != NGX_AGAIN) {
+            ngx_shmtx_unlock(&zone->shpool->mutex);
+            return rc;
+        }
+    }
+
+    if (zn->pending >= now) {
+        ngx_shmtx_unlock(&zone->shpool->mutex);
+        return NGX_BUSY;
+    }
+
+pending:
+
+    zn->pending = now + r->resend_timeout;
+    zn->ipv4 = r->ipv4;
+#if (NGX_HAVE_INET6)
+    zn->ipv6 = r->ipv6;
+#endif
+
+    ngx_shmtx_unlock(&zone->shpool->mutex);
+
+    return NGX_AGAIN;
+}
+
+
+static ngx_int_t
+ngx_resolver_zone_copy(ngx_resolver_t *r, ngx_resolver_node_t *rn,
+    ngx_resolver_zone_node_t *zn)
+{
+    u_char           *p, *cname;
+    in_addr_t        *addrs;
+    ngx_uint_t        naddrs;
+#if (NGX_HAVE_INET6)
+    ngx_uint_t        naddrs6;
+    struct in6_addr  *addrs6;
+#endif
+
+    /* the node data may still refer to freed memory */
+
+    rn->cnlen = 0;
+
+    if (zn->code) {
+        rn->code = zn->code;
+        return NGX_DECLINED;
+    }
+
+    p = zn->data + zn->sn.str.len;
+
+    naddrs = r->ipv4 ? zn->naddrs : 0;
+    addrs = NULL;
+    cname = NULL;
+
+#if (NGX_HAVE_INET6)
+    naddrs6 = r->ipv6 ? zn->naddrs6 : 0;
+    addrs6 = NULL;
+
+    if (naddrs + naddrs6 == 0 && zn->cnlen == 0) {
+        return NGX_AGAIN;
+    }
+#else
+    if (naddrs == 0 && zn->cnlen == 0) {
+        return NGX_AGAIN;
+    }
+#endif
+
+    if (naddrs > 1) {
+        addrs = ngx_resolver_dup(r, p, naddrs * sizeof(in_addr_t));
+        if (addrs == NULL) {
+            return NGX_AGAIN;
+        }
+    }
+
+#if (NGX_HAVE_INET6)
+    if (naddrs6 > 1) {
+        addrs6 = ngx_resolver_dup(r, p + zn->naddrs * sizeof(in_addr_t),
+                                  naddrs6 * sizeof(struct in6_addr));
+        if (addrs6 == NULL) {
+            ngx_resolver_free(r, addrs);
+            return NGX_AGAIN;
+        }
+    }
+#endif
+
+    if (zn->cnlen) {
+        cname = ngx_resolver_dup(r, p + zn->naddrs * sizeof(in_addr_t)
+                                      + zn->naddrs6 * sizeof(struct in6_addr),
+                                 zn->cnlen);
+        if (cname == NULL) {
+            ngx_resolver_free(r, addrs);
+#if (NGX_HAVE_INET6)
+            ngx_resolver_free(r, addrs6);
+#endif
+            return NGX_AGAIN;
+        }
+
+        rn->cnlen = zn->cnlen;
+        rn->u.cname = cname;
+    }
+
+    rn->naddrs = (u_short) naddrs;
+
+    if (naddrs == 1) {
+        ngx_memcpy(&rn->u.addr, p, sizeof(in_addr_t));
+
+    } else if (naddrs > 1) {
+        rn->u.addrs = addrs;
+    }
+
+#if (NGX_HAVE_INET6)
+    p += zn->naddrs * sizeof(in_addr_t);
+
+    rn->naddrs6 = (u_short) naddrs6;
+
+    if (naddrs6 == 1) {
+        ngx_memcpy(&rn->u6.addr6, p, sizeof(struct in6_addr));
+
+    } else if (naddrs6 > 1) {
+        rn->u6.addrs6 = addrs6;
+    }
+#endif
+
+    rn->code = 0;
+    rn->valid = zn->valid;
+    rn->ttl = (uint32_t) (zn->valid - ngx_time());
+
+    ngx_resolver_free(r, rn->query);
+    rn->query = NULL;
+#if (NGX_HAVE_INET6)
+    rn->query6 = NULL;
+#endif
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_resolver_zone_update(ngx_resolver_t *r, ngx_resolver_node_t *rn,
+    ngx_uint_t code, time_t valid)
+{
+    u_char                    *p;
+    size_t                     size;
+    ngx_str_t                  name;
+    ngx_uint_t                 naddrs, naddrs6;
+    ngx_resolver_zone_t       *zone;
+    ngx_resolver_zone_node_t  *zn;
+
+    zone = r->zone;
+
+    name.len = rn->nlen;
+    name.data = rn->name;
+
+    naddrs = 0;
+    naddrs6 = 0;
+    size = 0;
+
+    if (code == 0) {
+        naddrs = rn->naddrs;
+        size = naddrs * sizeof(in_addr_t) + rn->cnlen;
+
+#if (NGX_HAVE_INET6)
+        naddrs6 = rn->naddrs6;
+        size += naddrs6 * sizeof(struct in6_addr);
+#endif
+    }
+
+    ngx_shmtx_lock(&zone->shpool->mutex);
+
+    zn = (ngx_resolver_zone_node_t *)
+             ngx_str_rbtree_lookup(&zone->sh->rbtree, &name, rn->node.key);
+
+    if (zn) {
+        ngx_queue_remove(&zn->queue);
+        ngx_rbtree_delete(&zone->sh->rbtree, &zn->sn.node);
+        ngx_slab_free_locked(zone->shpool, zn);
+    }
+
+    ngx_resolver_zone_expire(zone, 0);
+
+    zn = ngx_resolver_zone_alloc(zone, &name, rn->node.key, size);
+
+    if (zn == NULL) {
+        ngx_shmtx_unlock(&zone->shpool->mutex);
+        return;
+    }
+
+    zn->valid = valid;
+    zn->code = (u_char) code;
+    zn->ipv4 = r->ipv4;
+#if (NGX_HAVE_INET6)
+    zn->ipv6 = r->ipv6;
+#endif
+    zn->naddrs = (u_short) naddrs;
+    zn->naddrs6 = (u_short) naddrs6;
+
+    p = zn->data + name.len;
+
+    if (naddrs == 1) {
+        p = ngx_cpymem(p, &rn->u.addr, sizeof(in_addr_t));
+
+    } else if (naddrs > 1) {
+        p = ngx_cpymem(p, rn->u.addrs, naddrs * sizeof(in_addr_t));
+    }
+
+#if (NGX_HAVE_INET6)
+    if (naddrs6 == 1) {
+        p = ngx_cpymem(p, &rn->u6.addr6, sizeof(struct in6_addr));
+
+    } else if (naddrs6 > 1) {
+        p = ngx_cpymem(p, rn->u6.addrs6, naddrs6 * sizeof(struct in6_addr));
+    }
+#endif
+
+    if (code == 0 && rn->cnlen) {
+        ngx_memcpy(p, rn->u.cname, rn->cnlen);
+        zn->cnlen = rn->cnlen;
+    }
+
+    ngx_shmtx_unlock(&zone->shpool->mutex);
+}
+
+
+static ngx_resolver_zone_node_t *
+ngx_resolver_zone_alloc(ngx_resolver_zone_t *zone, ngx_str_t *name,
+    uint32_t hash, size_t size)
+{
+    size_t                     n;
+    ngx_resolver_zone_node_t  *zn;
+
+    n = offsetof(ngx_resolver_zone_node_t, data) + name->len + size;
+
+    zn = ngx_slab_alloc_locked(zone->shpool, n);
+
+    if (zn == NULL) {
+        ngx_resolver_zone_expire(zone, 1);
+
+        zn = ngx_slab_alloc_locked(zone->shpool, n);
+        if (zn == NULL) {
+            return NULL;
+        }
+    }
+
+    ngx_memzero(zn, offsetof(ngx_resolver_zone_node_t, data));
+
+    zn->sn.node.key = hash;
+    zn->sn.str.len = name->len;
+    zn->sn.str.data = zn->data;
+
+    ngx_memcpy(zn->data, name->data, name->len);
+
+    ngx_rbtree_insert(&zone->sh->rbtree, &zn->sn.node);
+    ngx_queue_insert_head(&zone->sh->queue, &zn->queue);
+
+    return zn;
+}
+
+
+static void
+ngx_resolver_zone_expire(ngx_resolver_zone_t *zone, ngx_uint_t force)
+{
+    time_t                     now;
+    ngx_uint_t                 i;
+    ngx_queue_t               *q;
+    ngx_resolver_zone_node_t  *zn;
+
+    now = ngx_time();
+
+    /*
+     * the least recently used node is removed when memory is exhausted,
+     * and up to two nodes are released if they are no longer valid
+     */
+
+    for (i = 0; i < 3; i++) {
+
+        if (ngx_queue_empty(&zone->sh->queue)) {
+            return;
+        }
+
+        q = ngx_queue_last(&zone->sh->queue);
+
+        zn = ngx_queue_data(q, ngx_resolver_zone_node_t, queue);
+
+        if (!force || i) {
+            if (zn->valid >= now || zn->pending >= now) {
+                return;
+            }
+        }
+
+        ngx_queue_remove(q);
+        ngx_rbtree_delete(&zone->sh->rbtree, &zn->sn.node);
+        ngx_slab_free_locked(zone->shpool, zn);
+    }
+}
+
+
+static void
+ngx_resolver_zone_handler(ngx_event_t *ev)
+{
+    time_t                now;
+    ngx_int_t             rc;
+    ngx_str_t             name;
+    ngx_uint_t            wait, code;
+    ngx_queue_t          *q, *prev, *queue;
+    ngx_resolver_t       *r;
+    ngx_resolver_ctx_t   *ctx, *next;
+    ngx_resolver_node_t  *rn;
+
+    r = ev->data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_CORE, r->log, 0,
+                   "resolver zone handler");
+
+    now = ngx_time();
+    wait = 0;
+
+    queue = &r->name_resend_queue;
+
+    for (q = ngx_queue_last(queue);
+         q != ngx_queue_sentinel(queue);
+         q = prev)
+    {
+        prev = ngx_queue_prev(q);
+
+        rn = ngx_queue_data(q, ngx_resolver_node_t, queue);
+
+        if (!rn->zone_wait || rn->waiting == NULL) {
+            continue;
+        }
+
+        rc = ngx_resolver_zone_lookup(r, rn);
+
+        if (rc == NGX_BUSY) {
+            wait = 1;
+            continue;
+        }
+
+        rn->zone_wait = 0;
+
+        if (rc == NGX_AGAIN) {
+
+            /* another worker process has not got the answer in time */
+
+            (void) ngx_resolver_send_query(r, rn);
+
+            ngx_queue_remove(q);
+
+            rn->expire = now + r->resend_timeout;
+
+            ngx_queue_insert_head(queue, q);
+
+            continue;
+        }
+
+        ngx_queue_remove(q);
+
+        ctx = rn->waiting;
+        rn->waiting = NULL;
+
+        if (rc == NGX_DECLINED) {
+            code = rn->code;
+
+            ngx_rbtree_delete(&r->name_rbtree, &rn->node);
+            ngx_resolver_free_node(r, rn);
+
+            do {
+                ctx->state = code;
+                ctx->valid = now + (r->valid ? r->valid : 10);
+                next = ctx->next;
+
+                ctx->handler(ctx);
+
+                ctx = next;
+            } while (ctx);
+
+            continue;
+        }
+
+        /* NGX_OK */
+
+        rn->expire = now + r->expire;
+
+        ngx_queue_insert_head(&r->name_expire_queue, &rn->queue);
+
+        for (next = ctx; next; next = next->next) {
+            next->node = NULL;
+        }
+
+        name.len = rn->nlen;
+        name.data = rn->name;
+
+        (void) ngx_resolve_name_locked(r, ctx, &name);
+    }
+
+    if (wait) {
+        ngx_add_timer(ev, NGX_RESOLVER_ZONE_POLL);
+    }
+
+    if (r->event->timer_set && ngx_resolver_resend_empty(r)) {
+        ngx_del_timer(r->event);
+    }
+}
+
+
+static void
+ngx_resolver_refresh(ngx_resolver_t *r, ngx_resolver_node_t *rn,
+    ngx_queue_t *resend_queue)
+{
+    time_t                now, ttl;
+    ngx_str_t             name;
+    ngx_resolver_node_t  *stale;
+
+    /* only an idle node with addresses is refreshed */
+
+    if (rn->query || rn->stale || rn->waiting || rn->cnlen || rn->nsrvs) {
+        return;
+    }
+
+    now = ngx_time();
+
+    if (rn->valid >= now) {
+
+        /* prefetch a name used in the last part of its lifetime */
+
+        ttl = r->valid ? r->valid : (time_t) rn->ttl;
+
+        if ((rn->valid - now) * 100 >= ttl * (time_t) r->prefetch) {
+            return;
+        }
+
+    } else if ((rn->stale_valid ? rn->stale_valid : rn->valid + r->stale)
+               < now)
+    {
+        return;
+    }
+
+    stale = ngx_resolver_calloc(r, sizeof(ngx_resolver_node_t));
+    if (stale == NULL) {
+        return;
+    }
+
+    name.len = rn->nlen;
+    name.data = rn->name;
+
+    if (ngx_resolver_create_name_query(r, rn, &name) != NGX_OK) {
+        ngx_resolver_free(r, stale);
+        return;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, r->log, 0,
+                   "resolver refresh \"%V\" %T", &name, rn->valid - now);
+
+    stale->u = rn->u;
+    stale->naddrs = rn->naddrs;
+#if (NGX_HAVE_INET6)
+    stale->u6 = rn->u6;
+    stale->naddrs6 = rn->naddrs6;
+#endif
+    stale->valid = rn->valid;
+
+    rn->stale = stale;
+
+    ngx_queue_remove(&rn->queue);
+
+    rn->last_connection = r->last_connection++;
+    if (r->last_connection == r->connections.nelts) {
+        r->last_connection = 0;
+    }
+
+    rn->naddrs = r->ipv4 ? (u_short) -1 : 0;
+    rn->tcp = 0;
+#if (NGX_HAVE_INET6)
+    rn->naddrs6 = r->ipv6 ? (u_short) -1 : 0;
+    rn->tcp6 = 0;
+#endif
+    rn->zone_wait = 0;
+    rn->code = 0;
+    rn->valid = 0;
+    rn->ttl = NGX_MAX_UINT32_VALUE;
+
+    if (ngx_resolver_send_query(r, rn) != NGX_OK) {
+
+        rn->last_connection++;
+        if (rn->last_connection == r->connections.nelts) {
+            rn->last_connection = 0;
+        }
+
+        (void) ngx_resolver_send_query(r, rn);
+    }
+
+    if (ngx_resolver_resend_empty(r)) {
+        ngx_add_timer(r->event, (ngx_msec_t) (r->resend_timeout * 1000));
+    }
+
+    rn->expire = now + r->resend_timeout;
+
+    ngx_queue_insert_head(resend_queue, &rn->queue);
+}
+
+
+static ngx_int_t
+ngx_resolver_report_stale(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx,
+    ngx_resolver_node_t *rn)
+{
+    time_t                valid;
+    ngx_uint_t            naddrs;
+    ngx_resolver_ctx_t   *next;
+    ngx_resolver_addr_t  *addrs;
+
+    naddrs = rn->naddrs;
+#if (NGX_HAVE_INET6)
+    naddrs += rn->naddrs6;
+#endif
+
+    if (naddrs == 1 && rn->naddrs == 1) {
+        addrs = NULL;
+
+    } else {
+        addrs = ngx_resolver_export(r, rn, 1);
+        if (addrs == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    valid = ngx_max(rn->valid, ngx_time());
+
+    do {
+        ctx->state = NGX_OK;
+        ctx->valid = valid;
+        ctx->naddrs = naddrs;
+
+        if (addrs == NULL) {
+            ctx->addrs = &ctx->addr;
+            ctx->addr.sockaddr = (struct sockaddr *) &ctx->sin;
+            ctx->addr.socklen = sizeof(struct sockaddr_in);
+            ngx_memzero(&ctx->sin, sizeof(struct sockaddr_in));
+            ctx->sin.sin_family = AF_INET;
+            ctx->sin.sin_addr.s_addr = rn->u.addr;
+
+        } else {
+            ctx->addrs = addrs;
+        }
+
+        next = ctx->next;
+
+        ctx->handler(ctx);
+
+        ctx = next;
+    } while (ctx);
+
+    if (addrs != NULL) {
+        ngx_resolver_free(r, addrs->sockaddr);
+        ngx_resolver_free(r, addrs);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_resolver_restore(ngx_resolver_t *r, ngx_resolver_node_t *rn)
+{
+    time_t                now;
+    ngx_resolver_node_t  *stale;
+
+    stale = rn->stale;
+    rn->stale = NULL;
+
+    now = ngx_time();
+
+    /* the previous answer is used until the first expiry plus "stale" */
+
+    if (rn->stale_valid == 0) {
+        rn->stale_valid = stale->valid + r->stale;
+    }
+
+    ngx_resolver_free(r, rn->query);
+    rn->query = NULL;
+#if (NGX_HAVE_INET6)
+    rn->query6 = NULL;
+#endif
+
+    if (rn->naddrs > 1 && rn->naddrs != (u_short) -1) {
+        ngx_resolver_free(r, rn->u.addrs);
+    }
+
+    rn->u = stale->u;
+    rn->naddrs = stale->naddrs;
+
+#if (NGX_HAVE_INET6)
+    if (rn->naddrs6 > 1 && rn->naddrs6 != (u_short) -1) {
+        ngx_resolver_free(r, rn->u6.addrs6);
+    }
+
+    rn->u6 = stale->u6;
+    rn->naddrs6 = stale->naddrs6;
+#endif
+
+    ngx_resolver_free(r, stale);
+
+    /* the name is refreshed again after resend_timeout, not prefetched */
+
+    rn->code = 0;
+    rn->ttl = 0;
+    rn->valid = ngx_min(now + r->resend_timeout, rn->stale_valid);
+    rn->expire = now + r->expire;
+}
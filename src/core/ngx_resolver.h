@@ -36,10 +36,28 @@
 
 #define NGX_RESOLVER_MAX_RECURSION    50
 
+#define NGX_RESOLVER_ZONE_POLL        10
+
 
 typedef struct ngx_resolver_s  ngx_resolver_t;
 
 
+typedef struct {
+    ngx_rbtree_t              rbtree;
+    ngx_rbtree_node_t         sentinel;
+    ngx_queue_t               queue;
+} ngx_resolver_sh_t;
+
+
+/* the answers shared by the resolvers of worker processes */
+
+typedef struct {
+    ngx_resolver_sh_t        *sh;
+    ngx_slab_pool_t          *shpool;
+    ngx_shm_zone_t           *shm_zone;
+} ngx_resolver_zone_t;
+
+
 typedef struct {
     ngx_connection_t         *udp;
     ngx_connection_t         *tcp;
@@ -89,7 +107,9 @@ typedef struct {
 } ngx_resolver_srv_name_t;
 
 
-typedef struct {
+typedef struct ngx_resolver_node_s  ngx_resolver_node_t;
+
+struct ngx_resolver_node_s {
     ngx_rbtree_node_t         node;
     ngx_queue_t               queue;
 
@@ -139,10 +159,17 @@ typedef struct {
     unsigned                  tcp6:1;
 #endif
 
+    /* another worker process resolves the name */
+    unsigned                  zone_wait:1;
+
+    /* the previous answer, used while the name is refreshed */
+    ngx_resolver_node_t      *stale;
+    time_t                    stale_valid;
+
     ngx_uint_t                last_connection;
 
     ngx_resolver_ctx_t       *waiting;
-} ngx_resolver_node_t;
+};
 
 
 struct ngx_resolver_s {
@@ -189,8 +216,13 @@ struct ngx_resolver_s {
     time_t                    tcp_timeout;
     time_t                    expire;
     time_t                    valid;
+    time_t                    stale;
+    ngx_uint_t                prefetch;   /* percent of TTL */
 
     ngx_uint_t                log_level;
+
+    ngx_resolver_zone_t      *zone;
+    ngx_event_t              *zone_event;
 };
 
 
@@ -106,6 +106,117 @@ ngx_rwlock_downgrade(ngx_atomic_t *lock)
 }
 
 
+void
+ngx_brlock_wlock(ngx_brlock_t *lock)
+{
+    ngx_uint_t     i, n;
+    ngx_atomic_t  *writer;
+
+    /* the writer is the process, so unlocking can tell it from readers */
+
+    writer = &lock->writer.lock;
+
+    for ( ;; ) {
+
+        if (*writer == 0 && ngx_atomic_cmp_set(writer, 0, ngx_pid)) {
+            break;
+        }
+
+        if (ngx_ncpu > 1) {
+
+            for (n = 1; n < NGX_RWLOCK_SPIN; n <<= 1) {
+
+                for (i = 0; i < n; i++) {
+                    ngx_cpu_pause();
+                }
+
+                if (*writer == 0 && ngx_atomic_cmp_set(writer, 0, ngx_pid)) {
+                    goto locked;
+                }
+            }
+        }
+
+        ngx_sched_yield();
+    }
+
+locked:
+
+    /* new readers back off, the current ones are waited for */
+
+    for (n = 0; n < NGX_BRLOCK_SLOTS; n++) {
+
+        for (i = 0; lock->readers[n].lock; i++) {
+
+            if (ngx_ncpu > 1 && i < NGX_RWLOCK_SPIN) {
+                ngx_cpu_pause();
+
+            } else {
+                ngx_sched_yield();
+            }
+        }
+    }
+}
+
+
+void
+ngx_brlock_rlock(ngx_brlock_t *lock)
+{
+    ngx_uint_t     i;
+    ngx_atomic_t  *readers;
+
+    readers = &lock->readers[ngx_worker % NGX_BRLOCK_SLOTS].lock;
+
+    for ( ;; ) {
+
+        /* the increment is a full barrier before the writer is tested */
+
+        (void) ngx_atomic_fetch_add(readers, 1);
+
+        if (lock->writer.lock == 0) {
+            return;
+        }
+
+        (void) ngx_atomic_fetch_add(readers, -1);
+
+        for (i = 0; lock->writer.lock; i++) {
+
+            if (ngx_ncpu > 1 && i < NGX_RWLOCK_SPIN) {
+                ngx_cpu_pause();
+
+            } else {
+                ngx_sched_yield();
+            }
+        }
+    }
+}
+
+
+void
+ngx_brlock_unlock(ngx_brlock_t *lock)
+{
+    if (lock->writer.lock == (ngx_atomic_uint_t) ngx_pid) {
+        (void) ngx_atomic_cmp_set(&lock->writer.lock, ngx_pid, 0);
+
+    } else {
+        (void) ngx_atomic_fetch_add(
+                           &lock->readers[ngx_worker % NGX_BRLOCK_SLOTS].lock,
+                           -1);
+    }
+}
+
+
+void
+ngx_brlock_downgrade(ngx_brlock_t *lock)
+{
+    if (lock->writer.lock == (ngx_atomic_uint_t) ngx_pid) {
+        (void) ngx_atomic_fetch_add(
+                           &lock->readers[ngx_worker % NGX_BRLOCK_SLOTS].lock,
+                           1);
+        (void) ngx_atomic_cmp_set(&lock->writer.lock, ngx_pid, 0);
+    }
+}
+
+
 #else
 
 #if (NGX_HTTP_UPSTREAM_ZONE || NGX_STREAM_UPSTREAM_ZONE)
@@ -19,4 +19,33 @@ void ngx_rwlock_unlock(ngx_atomic_t *lock);
 void ngx_rwlock_downgrade(ngx_atomic_t *lock);
 
 
+/*
+ * A big reader lock: readers count themselves in the slot of the worker
+ * process, so read locking only writes to a cache line of the worker,
+ * while a writer sets the writer word and waits for all slots to drain.
+ * Read locking costs about the same as with ngx_rwlock_rlock() without
+ * contention, write locking reads all the slots.
+ */
+
+#define NGX_BRLOCK_SLOTS  32
+
+
+typedef struct {
+    ngx_atomic_t        lock;
+    u_char              pad[NGX_CPU_CACHE_LINE - sizeof(ngx_atomic_t)];
+} ngx_brlock_slot_t;
+
+
+typedef struct {
+    ngx_brlock_slot_t   writer;
+    ngx_brlock_slot_t   readers[NGX_BRLOCK_SLOTS];
+} ngx_brlock_t;
+
+
+void ngx_brlock_wlock(ngx_brlock_t *lock);
+void ngx_brlock_rlock(ngx_brlock_t *lock);
+void ngx_brlock_unlock(ngx_brlock_t *lock);
+void ngx_brlock_downgrade(ngx_brlock_t *lock);
+
+
 #endif /* _NGX_RWLOCK_H_INCLUDED_ */
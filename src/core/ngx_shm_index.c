@@ -0,0 +1,207 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+static ngx_int_t ngx_shm_index_alloc(ngx_shm_index_t *index, ngx_uint_t n);
+static void ngx_shm_index_add(ngx_shm_index_t *index, uint32_t hash,
+    void *value);
+
+
+ngx_int_t
+ngx_shm_index_init(ngx_shm_index_t *index, ngx_slab_pool_t *shpool,
+    ngx_uint_t n)
+{
+    ngx_uint_t  size;
+
+    /* the index is sized to hold n entries before growing */
+
+    size = 8;
+
+    while (size * NGX_SHM_INDEX_SLOTS * 3 / 4 < n) {
+        size *= 2;
+    }
+
+    index->shpool = shpool;
+    index->count = 0;
+
+    return ngx_shm_index_alloc(index, size);
+}
+
+
+static ngx_int_t
+ngx_shm_index_alloc(ngx_shm_index_t *index, ngx_uint_t n)
+{
+    size_t                   size;
+    ngx_shm_index_bucket_t  *buckets;
+
+    /*
+     * slab allocations of power of two sizes are aligned to the size
+     * or to the page, so buckets do not cross cache lines
+     */
+
+    size = n * sizeof(ngx_shm_index_bucket_t);
+
+    buckets = ngx_slab_alloc_locked(index->shpool, size);
+    if (buckets == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(buckets, size);
+
+    index->buckets = buckets;
+    index->mask = n - 1;
+    index->grow = n * NGX_SHM_INDEX_SLOTS * 3 / 4;
+
+    return NGX_OK;
+}
+
+
+void *
+ngx_shm_index_lookup(ngx_shm_index_t *index, uint32_t hash,
+    ngx_shm_index_iter_t *it)
+{
+    it->n = hash & index->mask;
+    it->slot = 0;
+    it->probes = 0;
+    it->hash = hash;
+
+    return ngx_shm_index_next(index, it);
+}
+
+
+void *
+ngx_shm_index_next(ngx_shm_index_t *index, ngx_shm_index_iter_t *it)
+{
+    ngx_uint_t               i;
+    ngx_shm_index_bucket_t  *b;
+
+    for ( ;; ) {
+        b = &index->buckets[it->n];
+
+        for (i = it->slot; i < NGX_SHM_INDEX_SLOTS; i++) {
+            if (b->hash[i] == it->hash && b->value[i] != NULL) {
+                it->slot = i + 1;
+                return b->value[i];
+            }
+        }
+
+        if (b->overflow == 0 || it->probes++ == index->mask) {
+            it->slot = NGX_SHM_INDEX_SLOTS;
+            return NULL;
+        }
+
+        it->n = (it->n + 1) & index->mask;
+        it->slot = 0;
+    }
+}
+
+
+ngx_int_t
+ngx_shm_index_insert(ngx_shm_index_t *index, uint32_t hash, void *value)
+{
+    ngx_uint_t               i, n, size;
+    ngx_shm_index_bucket_t  *b, *buckets;
+
+    if (index->count >= index->grow) {
+
+        /*
+         * if there is no memory to grow, the index is full: the caller
+         * is expected to delete some entries and to try again
+         */
+
+        buckets = index->buckets;
+        size = index->mask + 1;
+
+        if (ngx_shm_index_alloc(index, size * 2) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        for (n = 0; n < size; n++) {
+            b = &buckets[n];
+
+            for (i = 0; i < NGX_SHM_INDEX_SLOTS; i++) {
+                if (b->value[i] != NULL) {
+                    ngx_shm_index_add(index, b->hash[i], b->value[i]);
+                }
+            }
+        }
+
+        ngx_slab_free_locked(index->shpool, buckets);
+    }
+
+    ngx_shm_index_add(index, hash, value);
+
+    index->count++;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_shm_index_add(ngx_shm_index_t *index, uint32_t hash, void *value)
+{
+    ngx_uint_t               i, n;
+    ngx_shm_index_bucket_t  *b;
+
+    /* there is a free slot */
+
+    n = hash & index->mask;
+
+    for ( ;; ) {
+        b = &index->buckets[n];
+
+        for (i = 0; i < NGX_SHM_INDEX_SLOTS; i++) {
+            if (b->value[i] == NULL) {
+                b->hash[i] = hash;
+                b->value[i] = value;
+                return;
+            }
+        }
+
+        b->overflow++;
+
+        n = (n + 1) & index->mask;
+    }
+}
+
+
+void
+ngx_shm_index_delete(ngx_shm_index_t *index, uint32_t hash, void *value)
+{
+    ngx_uint_t               i, n, probes;
+    ngx_shm_index_bucket_t  *b;
+
+    n = hash & index->mask;
+
+    for (probes = 0; probes <= index->mask; probes++) {
+        b = &index->buckets[n];
+
+        for (i = 0; i < NGX_SHM_INDEX_SLOTS; i++) {
+            if (b->value[i] == value) {
+                goto found;
+            }
+        }
+
+        n = (n + 1) & index->mask;
+    }
+
+    return;
+
+found:
+
+    b->value[i] = NULL;
+    index->count--;
+
+    n = hash & index->mask;
+
+    while (probes--) {
+        index->buckets[n].overflow--;
+        n = (n + 1) & index->mask;
+    }
+}
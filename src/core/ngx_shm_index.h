@@ -0,0 +1,74 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_SHM_INDEX_H_INCLUDED_
+#define _NGX_SHM_INDEX_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * An open addressing hash index of nodes in a shared memory zone.
+ *
+ * A bucket holds the hashes and values of several entries and fits in
+ * a cache line, so a lookup usually costs one or two cache misses instead
+ * of one per level of a tree.  When a bucket is full, entries go to the
+ * next buckets; the number of entries which probed past a bucket is kept
+ * in the bucket, so lookups stop at the first bucket not overflowed, and
+ * deletion needs no tombstones.  The index doubles in size when 3/4 full;
+ * if there is no memory for this, insertion fails, much like a failed
+ * node allocation.
+ *
+ * As with rbtrees, the index only compares hashes: nodes found are to be
+ * compared with the key by the caller.  All functions are called with
+ * the zone mutex held.
+ */
+
+
+#if (NGX_PTR_SIZE == 8)
+#define NGX_SHM_INDEX_SLOTS  5
+#else
+#define NGX_SHM_INDEX_SLOTS  7
+#endif
+
+
+typedef struct {
+    uint32_t                 hash[NGX_SHM_INDEX_SLOTS];
+    uint32_t                 overflow;
+    void                    *value[NGX_SHM_INDEX_SLOTS];
+} ngx_shm_index_bucket_t;
+
+
+typedef struct {
+    ngx_shm_index_bucket_t  *buckets;
+    ngx_uint_t               mask;
+    ngx_uint_t               count;
+    ngx_uint_t               grow;
+    ngx_slab_pool_t         *shpool;
+} ngx_shm_index_t;
+
+
+typedef struct {
+    ngx_uint_t               n;
+    ngx_uint_t               slot;
+    ngx_uint_t               probes;
+    uint32_t                 hash;
+} ngx_shm_index_iter_t;
+
+
+ngx_int_t ngx_shm_index_init(ngx_shm_index_t *index, ngx_slab_pool_t *shpool,
+    ngx_uint_t n);
+void *ngx_shm_index_lookup(ngx_shm_index_t *index, uint32_t hash,
+    ngx_shm_index_iter_t *it);
+void *ngx_shm_index_next(ngx_shm_index_t *index, ngx_shm_index_iter_t *it);
+ngx_int_t ngx_shm_index_insert(ngx_shm_index_t *index, uint32_t hash,
+    void *value);
+void ngx_shm_index_delete(ngx_shm_index_t *index, uint32_t hash, void *value);
+
+
+#endif /* _NGX_SHM_INDEX_H_INCLUDED_ */
@@ -14,19 +14,37 @@
 
 static void ngx_shmtx_wakeup(ngx_shmtx_t *mtx);
 
+#if (NGX_HAVE_FUTEX)
+
+static void ngx_shmtx_owner(ngx_shmtx_t *mtx);
+static ngx_uint_t ngx_shmtx_owner_preempted(ngx_shmtx_t *mtx);
+
+#define ngx_futex(addr, op, val)                                             \
+    syscall(SYS_futex, addr, op, val, NULL, NULL, 0)
+
+#endif
+
 
 ngx_int_t
 ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 {
     mtx->lock = &addr->lock;
 
+#if (NGX_HAVE_FUTEX)
+    mtx->sh = addr;
+#endif
+
     if (mtx->spin == (ngx_uint_t) -1) {
         return NGX_OK;
     }
 
     mtx->spin = 2048;
 
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_FUTEX)
+
+    /* futex() needs no initialization */
+
+#elif (NGX_HAVE_POSIX_SEM)
 
     mtx->wait = &addr->wait;
 
@@ -46,7 +64,7 @@ ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 void
 ngx_shmtx_destroy(ngx_shmtx_t *mtx)
 {
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_POSIX_SEM && !(NGX_HAVE_FUTEX))
 
     if (mtx->semaphore) {
         if (sem_destroy(&mtx->sem) == -1) {
@@ -59,6 +77,134 @@ ngx_shmtx_destroy(ngx_shmtx_t *mtx)
 }
 
 
+#if (NGX_HAVE_FUTEX)
+
+ngx_uint_t
+ngx_shmtx_trylock(ngx_shmtx_t *mtx)
+{
+    if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+        ngx_shmtx_owner(mtx);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+void
+ngx_shmtx_lock(ngx_shmtx_t *mtx)
+{
+    uint32_t         seq;
+    ngx_err_t        err;
+    ngx_uint_t       i, limit;
+    ngx_shmtx_sh_t  *sh;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0, "shmtx lock");
+
+    if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+        goto locked;
+    }
+
+    sh = mtx->sh;
+
+    (void) ngx_atomic_fetch_add(&sh->contended, 1);
+
+    for ( ;; ) {
+
+        if (ngx_ncpu > 1 && !ngx_shmtx_owner_preempted(mtx)) {
+
+            /*
+             * spin up to twice as long as it usually takes to get
+             * the mutex, and adjust the estimate by 1/8 of the difference
+             */
+
+            limit = ngx_min(mtx->spin, sh->spin * 2 + 16);
+
+            for (i = 0; i < limit; i++) {
+                ngx_cpu_pause();
+
+                if (*mtx->lock == 0
+                    && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid))
+                {
+                    sh->spin += ((ngx_int_t) i - (ngx_int_t) sh->spin) / 8;
+                    goto locked;
+                }
+            }
+
+            sh->spin += ((ngx_int_t) limit - (ngx_int_t) sh->spin) / 8;
+        }
+
+        /*
+         * the sequence number is read before the lock is tested again,
+         * so a wakeup after the test changes it and futex() returns
+         */
+
+        seq = sh->futex;
+
+        (void) ngx_atomic_fetch_add(&sh->wait, 1);
+
+        if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+            (void) ngx_atomic_fetch_add(&sh->wait, -1);
+            goto locked;
+        }
+
+        (void) ngx_atomic_fetch_add(&sh->sleeps, 1);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                       "shmtx wait %uA", sh->wait);
+
+        /* as with semaphores, the waker decrements the number of waiters */
+
+        if (ngx_futex(&sh->futex, FUTEX_WAIT, seq) == -1) {
+            err = ngx_errno;
+
+            if (err != NGX_EAGAIN && err != NGX_EINTR) {
+                ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, err,
+                              "futex() failed while waiting on shmtx");
+                ngx_sched_yield();
+            }
+        }
+
+        ngx_log_debug0(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                       "shmtx awoke");
+    }
+
+locked:
+
+    ngx_shmtx_owner(mtx);
+}
+
+
+static void
+ngx_shmtx_owner(ngx_shmtx_t *mtx)
+{
+#if (NGX_HAVE_SCHED_GETCPU)
+    mtx->sh->cpu = (uint32_t) sched_getcpu();
+#endif
+}
+
+
+static ngx_uint_t
+ngx_shmtx_owner_preempted(ngx_shmtx_t *mtx)
+{
+#if (NGX_HAVE_SCHED_GETCPU)
+    int  cpu;
+
+    /*
+     * the owner cannot run on the CPU the waiter runs on; it could
+     * migrate since the mutex was locked, but this is rare
+     */
+
+    cpu = sched_getcpu();
+
+    return (cpu != -1 && mtx->sh->cpu == (uint32_t) cpu);
+#else
+    return 0;
+#endif
+}
+
+#else
+
 ngx_uint_t
 ngx_shmtx_trylock(ngx_shmtx_t *mtx)
 {
@@ -132,6 +278,8 @@ ngx_shmtx_lock(ngx_shmtx_t *mtx)
     }
 }
 
+#endif
+
 
 void
 ngx_shmtx_unlock(ngx_shmtx_t *mtx)
@@ -164,7 +312,38 @@ ngx_shmtx_force_unlock(ngx_shmtx_t *mtx, ngx_pid_t pid)
 static void
 ngx_shmtx_wakeup(ngx_shmtx_t *mtx)
 {
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_FUTEX)
+    ngx_shmtx_sh_t     *sh;
+    ngx_atomic_uint_t   wait;
+
+    sh = mtx->sh;
+
+    for ( ;; ) {
+
+        wait = sh->wait;
+
+        if ((ngx_atomic_int_t) wait <= 0) {
+            return;
+        }
+
+        if (ngx_atomic_cmp_set(&sh->wait, wait, wait - 1)) {
+            break;
+        }
+    }
+
+    /* the sequence number is changed atomically by concurrent wakeups */
+
+    (void) __sync_fetch_and_add(&sh->futex, 1);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                   "shmtx wake %uA", wait);
+
+    if (ngx_futex(&sh->futex, FUTEX_WAKE, 1) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "futex() failed while wake shmtx");
+    }
+
+#elif (NGX_HAVE_POSIX_SEM)
     ngx_atomic_uint_t  wait;
 
     if (!mtx->semaphore) {
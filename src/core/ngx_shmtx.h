@@ -13,27 +13,45 @@
 #include <ngx_core.h>
 
 
+/*
+ * With futex(), waiters sleep on the "futex" sequence number which
+ * is incremented on each wakeup, and the number of spins before sleeping
+ * adapts to the time the mutex is usually held for; the spins are skipped
+ * if the owner has been running on the CPU of the waiter, and therefore
+ * is preempted.  The counters are of times the mutex was found locked
+ * and of sleeps.
+ */
+
 typedef struct {
-    ngx_atomic_t   lock;
-#if (NGX_HAVE_POSIX_SEM)
-    ngx_atomic_t   wait;
+    ngx_atomic_t        lock;
+#if (NGX_HAVE_FUTEX)
+    ngx_atomic_t        wait;
+    ngx_atomic_t        contended;
+    ngx_atomic_t        sleeps;
+    ngx_uint_t          spin;
+    volatile uint32_t   cpu;
+    volatile uint32_t   futex;
+#elif (NGX_HAVE_POSIX_SEM)
+    ngx_atomic_t        wait;
 #endif
 } ngx_shmtx_sh_t;
 
 
 typedef struct {
 #if (NGX_HAVE_ATOMIC_OPS)
-    ngx_atomic_t  *lock;
-#if (NGX_HAVE_POSIX_SEM)
-    ngx_atomic_t  *wait;
-    ngx_uint_t     semaphore;
-    sem_t          sem;
+    ngx_atomic_t       *lock;
+#if (NGX_HAVE_FUTEX)
+    ngx_shmtx_sh_t     *sh;
+#elif (NGX_HAVE_POSIX_SEM)
+    ngx_atomic_t       *wait;
+    ngx_uint_t          semaphore;
+    sem_t               sem;
 #endif
 #else
-    ngx_fd_t       fd;
-    u_char        *name;
+    ngx_fd_t            fd;
+    u_char             *name;
 #endif
-    ngx_uint_t     spin;
+    ngx_uint_t          spin;
 } ngx_shmtx_t;
 
 
@@ -69,10 +69,35 @@
 
 #endif
 
+#define NGX_SLAB_MAGAZINE_SLOTS  16
+#define NGX_SLAB_MAGAZINE_POOLS  32
+
+
+/*
+ * Small chunks freed by a worker are kept in its process-local magazine
+ * of the pool, up to "slab_magazine" chunks of each size, and are reused
+ * by its next allocations without locking the pool.  The chunks remain
+ * allocated in the pool and are linked through their first word.
+ */
+
+typedef struct {
+    ngx_slab_pool_t  *pool;
+    void             *free[NGX_SLAB_MAGAZINE_SLOTS];
+    ngx_uint_t        number[NGX_SLAB_MAGAZINE_SLOTS];
+} ngx_slab_magazine_t;
+
+
+static void *ngx_slab_alloc_chunk(ngx_slab_pool_t *pool, size_t size);
+static void ngx_slab_free_chunk(ngx_slab_pool_t *pool, void *p);
+static ngx_slab_magazine_t *ngx_slab_magazine(ngx_slab_pool_t *pool,
+    ngx_uint_t create);
+static void *ngx_slab_magazine_pop(ngx_slab_pool_t *pool, size_t size);
+static ngx_uint_t ngx_slab_magazine_push(ngx_slab_pool_t *pool, void *p);
 static ngx_slab_page_t *ngx_slab_alloc_pages(ngx_slab_pool_t *pool,
     ngx_uint_t pages);
 static void ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
     ngx_uint_t pages);
+static ngx_uint_t ngx_slab_largest_free(ngx_slab_pool_t *pool);
 static void ngx_slab_error(ngx_slab_pool_t *pool, ngx_uint_t level,
     char *text);
 
@@ -81,6 +106,10 @@ static ngx_uint_t  ngx_slab_max_size;
 static ngx_uint_t  ngx_slab_exact_size;
 static ngx_uint_t  ngx_slab_exact_shift;
 
+static ngx_uint_t           ngx_slab_magazine_max;
+static ngx_uint_t           ngx_slab_magazine_n;
+static ngx_slab_magazine_t  ngx_slab_magazines[NGX_SLAB_MAGAZINE_POOLS];
+
 
 void
 ngx_slab_sizes_init(void)
@@ -170,9 +199,16 @@ ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size)
 {
     void  *p;
 
+    if (ngx_slab_magazine_max) {
+        p = ngx_slab_magazine_pop(pool, size);
+        if (p) {
+            return p;
+        }
+    }
+
     ngx_shmtx_lock(&pool->mutex);
 
-    p = ngx_slab_alloc_locked(pool, size);
+    p = ngx_slab_alloc_chunk(pool, size);
 
     ngx_shmtx_unlock(&pool->mutex);
 
@@ -182,6 +218,22 @@ ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size)
 
 void *
 ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
+{
+    void  *p;
+
+    if (ngx_slab_magazine_max) {
+        p = ngx_slab_magazine_pop(pool, size);
+        if (p) {
+            return p;
+        }
+    }
+
+    return ngx_slab_alloc_chunk(pool, size);
+}
+
+
+static void *
+ngx_slab_alloc_chunk(ngx_slab_pool_t *pool, size_t size)
 {
     size_t            s;
     uintptr_t         p, m, mask, *bitmap;
@@ -422,12 +474,24 @@ ngx_slab_calloc(ngx_slab_pool_t *pool, size_t size)
 {
     void  *p;
 
+    if (ngx_slab_magazine_max) {
+        p = ngx_slab_magazine_pop(pool, size);
+        if (p) {
+            ngx_memzero(p, size);
+            return p;
+        }
+    }
+
     ngx_shmtx_lock(&pool->mutex);
 
-    p = ngx_slab_calloc_locked(pool, size);
+    p = ngx_slab_alloc_chunk(pool, size);
 
     ngx_shmtx_unlock(&pool->mutex);
 
+    if (p) {
+        ngx_memzero(p, size);
+    }
+
     return p;
 }
 
@@ -449,9 +513,13 @@ ngx_slab_calloc_locked(ngx_slab_pool_t *pool, size_t size)
 void
 ngx_slab_free(ngx_slab_pool_t *pool, void *p)
 {
+    if (ngx_slab_magazine_max && ngx_slab_magazine_push(pool, p)) {
+        return;
+    }
+
     ngx_shmtx_lock(&pool->mutex);
 
-    ngx_slab_free_locked(pool, p);
+    ngx_slab_free_chunk(pool, p);
 
     ngx_shmtx_unlock(&pool->mutex);
 }
@@ -459,6 +527,17 @@ ngx_slab_free(ngx_slab_pool_t *pool, void *p)
 
 void
 ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
+{
+    if (ngx_slab_magazine_max && ngx_slab_magazine_push(pool, p)) {
+        return;
+    }
+
+    ngx_slab_free_chunk(pool, p);
+}
+
+
+static void
+ngx_slab_free_chunk(ngx_slab_pool_t *pool, void *p)
 {
     size_t            size;
     uintptr_t         slab, m, *bitmap;
@@ -674,6 +753,201 @@ fail:
 }
 
 
+void
+ngx_slab_info(ngx_slab_pool_t *pool, ngx_slab_info_t *info)
+{
+    ngx_uint_t  n;
+
+    /* info->stats should have room for ngx_pagesize_shift slots */
+
+    n = ngx_pagesize_shift - pool->min_shift;
+
+    ngx_shmtx_lock(&pool->mutex);
+
+    info->pages = pool->last - pool->pages;
+    info->free = pool->pfree;
+    info->largest_free = ngx_slab_largest_free(pool);
+
+    info->slots = n;
+    ngx_memcpy(info->stats, pool->stats, n * sizeof(ngx_slab_stat_t));
+
+    ngx_shmtx_unlock(&pool->mutex);
+}
+
+
+void
+ngx_slab_magazine_init(ngx_uint_t max)
+{
+    ngx_slab_magazine_max = ngx_min(max, NGX_MAX_INT32_VALUE);
+}
+
+
+void
+ngx_slab_magazine_flush(void)
+{
+    void                 *p;
+    ngx_uint_t            i, n;
+    ngx_slab_magazine_t  *mg;
+
+    ngx_slab_magazine_max = 0;
+
+    for (i = 0; i < ngx_slab_magazine_n; i++) {
+        mg = &ngx_slab_magazines[i];
+
+        ngx_shmtx_lock(&mg->pool->mutex);
+
+        for (n = 0; n < NGX_SLAB_MAGAZINE_SLOTS; n++) {
+            while (mg->free[n]) {
+                p = mg->free[n];
+                mg->free[n] = *(void **) p;
+
+                ngx_slab_free_chunk(mg->pool, p);
+            }
+
+            mg->number[n] = 0;
+        }
+
+        ngx_shmtx_unlock(&mg->pool->mutex);
+    }
+
+    ngx_slab_magazine_n = 0;
+}
+
+
+static ngx_slab_magazine_t *
+ngx_slab_magazine(ngx_slab_pool_t *pool, ngx_uint_t create)
+{
+    ngx_uint_t            i;
+    ngx_slab_magazine_t  *mg;
+
+    for (i = 0; i < ngx_slab_magazine_n; i++) {
+        if (ngx_slab_magazines[i].pool == pool) {
+            return &ngx_slab_magazines[i];
+        }
+    }
+
+    if (!create || ngx_slab_magazine_n == NGX_SLAB_MAGAZINE_POOLS) {
+        return NULL;
+    }
+
+    mg = &ngx_slab_magazines[ngx_slab_magazine_n++];
+
+    ngx_memzero(mg, sizeof(ngx_slab_magazine_t));
+    mg->pool = pool;
+
+    return mg;
+}
+
+
+static void *
+ngx_slab_magazine_pop(ngx_slab_pool_t *pool, size_t size)
+{
+    void                 *p;
+    size_t                s;
+    ngx_uint_t            slot, shift;
+    ngx_slab_magazine_t  *mg;
+
+    if (size > ngx_slab_max_size) {
+        return NULL;
+    }
+
+    if (size > pool->min_size) {
+        shift = 1;
+        for (s = size - 1; s >>= 1; shift++) { /* void */ }
+        slot = shift - pool->min_shift;
+
+    } else {
+        slot = 0;
+    }
+
+    if (slot >= NGX_SLAB_MAGAZINE_SLOTS) {
+        return NULL;
+    }
+
+    mg = ngx_slab_magazine(pool, 0);
+
+    if (mg == NULL || mg->free[slot] == NULL) {
+        return NULL;
+    }
+
+    p = mg->free[slot];
+    mg->free[slot] = *(void **) p;
+    mg->number[slot]--;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab magazine alloc: %p slot: %ui", p, slot);
+
+    return p;
+}
+
+
+static ngx_uint_t
+ngx_slab_magazine_push(ngx_slab_pool_t *pool, void *p)
+{
+    size_t                size;
+    ngx_uint_t            slot, shift;
+    ngx_slab_page_t      *page;
+    ngx_slab_magazine_t  *mg;
+
+    /* invalid pointers are left to ngx_slab_free_chunk() to report */
+
+    if ((u_char *) p < pool->start || (u_char *) p >= pool->end) {
+        return 0;
+    }
+
+    /*
+     * the page type and the chunk size are not changed
+     * while the chunk is allocated, so no lock is needed
+     */
+
+    page = &pool->pages[((u_char *) p - pool->start) >> ngx_pagesize_shift];
+
+    switch (ngx_slab_page_type(page)) {
+
+    case NGX_SLAB_SMALL:
+    case NGX_SLAB_BIG:
+        shift = page->slab & NGX_SLAB_SHIFT_MASK;
+        break;
+
+    case NGX_SLAB_EXACT:
+        shift = ngx_slab_exact_shift;
+        break;
+
+    default: /* NGX_SLAB_PAGE */
+        return 0;
+    }
+
+    size = (size_t) 1 << shift;
+
+    if (shift < pool->min_shift || ((uintptr_t) p & (size - 1))) {
+        return 0;
+    }
+
+    slot = shift - pool->min_shift;
+
+    if (slot >= NGX_SLAB_MAGAZINE_SLOTS) {
+        return 0;
+    }
+
+    mg = ngx_slab_magazine(pool, 1);
+
+    if (mg == NULL || mg->number[slot] >= ngx_slab_magazine_max) {
+        return 0;
+    }
+
+    ngx_slab_junk(p, size);
+
+    *(void **) p = mg->free[slot];
+    mg->free[slot] = p;
+    mg->number[slot]++;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab magazine free: %p slot: %ui", p, slot);
+
+    return 1;
+}
+
+
 static ngx_slab_page_t *
 ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
 {
@@ -722,8 +996,13 @@ ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
     }
 
     if (pool->log_nomem) {
-        ngx_slab_error(pool, NGX_LOG_CRIT,
-                       "ngx_slab_alloc() failed: no memory");
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, 0,
+                      "ngx_slab_alloc() failed: no memory%s "
+                      "(%ui pages requested, %ui of %ui pages free, "
+                      "largest free run: %ui pages)",
+                      pool->log_ctx, pages, pool->pfree,
+                      (ngx_uint_t) (pool->last - pool->pages),
+                      ngx_slab_largest_free(pool));
     }
 
     return NULL;
@@ -810,6 +1089,24 @@ ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
 }
 
 
+static ngx_uint_t
+ngx_slab_largest_free(ngx_slab_pool_t *pool)
+{
+    ngx_uint_t        n;
+    ngx_slab_page_t  *page;
+
+    n = 0;
+
+    for (page = pool->free.next; page != &pool->free; page = page->next) {
+        if (page->slab > n) {
+            n = page->slab;
+        }
+    }
+
+    return n;
+}
+
+
 static void
 ngx_slab_error(ngx_slab_pool_t *pool, ngx_uint_t level, char *text)
 {
@@ -59,6 +59,16 @@ typedef struct {
 } ngx_slab_pool_t;
 
 
+typedef struct {
+    ngx_uint_t        pages;
+    ngx_uint_t        free;
+    ngx_uint_t        largest_free;
+
+    ngx_uint_t        slots;
+    ngx_slab_stat_t  *stats;
+} ngx_slab_info_t;
+
+
 void ngx_slab_sizes_init(void);
 void ngx_slab_init(ngx_slab_pool_t *pool);
 void *ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size);
@@ -67,6 +77,9 @@ void *ngx_slab_calloc(ngx_slab_pool_t *pool, size_t size);
 void *ngx_slab_calloc_locked(ngx_slab_pool_t *pool, size_t size);
 void ngx_slab_free(ngx_slab_pool_t *pool, void *p);
 void ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p);
+void ngx_slab_info(ngx_slab_pool_t *pool, ngx_slab_info_t *info);
+void ngx_slab_magazine_init(ngx_uint_t max);
+void ngx_slab_magazine_flush(void);
 
 
 #endif /* _NGX_SLAB_H_INCLUDED_ */
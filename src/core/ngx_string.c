@@ -8,9 +8,31 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 
+#if (NGX_HAVE_SSE2)
+#include <emmintrin.h>
+#elif (NGX_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+#define NGX_STR_RUN_URI              0
+#define NGX_STR_RUN_URI_PATH         1
+#define NGX_STR_RUN_ASCII            2
+#define NGX_STR_RUN_HTML             3
+#define NGX_STR_RUN_PERCENT          4
+#define NGX_STR_RUN_PERCENT_QUERY    5
+
+static ngx_inline size_t ngx_str_run(u_char *p, size_t n, ngx_uint_t type);
+static ngx_inline u_char *ngx_str_skip_lc(u_char *p, u_char *last,
+    u_char c);
+
+#endif
 
 static u_char *ngx_sprintf_num(u_char *buf, u_char *last, uint64_t ui64,
     u_char zero, ngx_uint_t hexadecimal, ngx_uint_t width);
+static u_char *ngx_sprintf_int(u_char *buf, u_char *last, int64_t i64);
 static u_char *ngx_sprintf_str(u_char *buf, u_char *last, u_char *src,
     size_t len, ngx_uint_t hexadecimal);
 static void ngx_encode_base64_internal(ngx_str_t *dst, ngx_str_t *src,
@@ -22,6 +44,45 @@ static ngx_int_t ngx_decode_base64_internal(ngx_str_t *dst, ngx_str_t *src,
 void
 ngx_strlow(u_char *dst, u_char *src, size_t n)
 {
+#if (NGX_HAVE_SSE2)
+
+    __m128i  v, d, m;
+
+    while (n >= 16) {
+        v = _mm_loadu_si128((const __m128i *) src);
+
+        /* v - 'A' <= 25 */
+
+        d = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+        m = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(25)), d);
+        v = _mm_or_si128(v, _mm_and_si128(m, _mm_set1_epi8(0x20)));
+
+        _mm_storeu_si128((__m128i *) dst, v);
+
+        dst += 16;
+        src += 16;
+        n -= 16;
+    }
+
+#elif (NGX_HAVE_NEON)
+
+    uint8x16_t  v, m;
+
+    while (n >= 16) {
+        v = vld1q_u8(src);
+
+        m = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8(25));
+        v = vorrq_u8(v, vandq_u8(m, vdupq_n_u8(0x20)));
+
+        vst1q_u8(dst, v);
+
+        dst += 16;
+        src += 16;
+        n -= 16;
+    }
+
+#endif
+
     while (n) {
         *dst = ngx_tolower(*src);
         dst++;
@@ -184,6 +245,58 @@ ngx_vslprintf(u_char *buf, u_char *last, const char *fmt, va_list args)
 
         if (*fmt == '%') {
 
+            /* the most common conversions without flags and width */
+
+            switch (fmt[1]) {
+
+            case 'V':
+                v = va_arg(args, ngx_str_t *);
+
+                slen = ngx_min((size_t) (last - buf), v->len);
+                buf = ngx_cpymem(buf, v->data, slen);
+                fmt += 2;
+
+                continue;
+
+            case 'O':
+                buf = ngx_sprintf_int(buf, last,
+                                      (int64_t) va_arg(args, off_t));
+                fmt += 2;
+
+                continue;
+
+            case 'T':
+                buf = ngx_sprintf_int(buf, last,
+                                      (int64_t) va_arg(args, time_t));
+                fmt += 2;
+
+                continue;
+
+            case 'i':
+                buf = ngx_sprintf_int(buf, last,
+                                      (int64_t) va_arg(args, ngx_int_t));
+                fmt += 2;
+
+                continue;
+
+            case 'd':
+                buf = ngx_sprintf_int(buf, last, (int64_t) va_arg(args, int));
+                fmt += 2;
+
+                continue;
+
+            case 'u':
+                if (fmt[2] == 'i') {
+                    ui64 = (uint64_t) va_arg(args, ngx_uint_t);
+                    buf = ngx_sprintf_num(buf, last, ui64, ' ', 0, 0);
+                    fmt += 3;
+
+                    continue;
+                }
+
+                break;
+            }
+
             i64 = 0;
             ui64 = 0;
 
@@ -473,7 +586,17 @@ ngx_vslprintf(u_char *buf, u_char *last, const char *fmt, va_list args)
             fmt++;
 
         } else {
-            *buf++ = *fmt++;
+
+            /* a run of plain characters */
+
+            for (p = (u_char *) fmt + 1; *p && *p != '%'; p++) {
+                /* void */
+            }
+
+            slen = p - (u_char *) fmt;
+            slen = ngx_min((size_t) (last - buf), slen);
+            buf = ngx_cpymem(buf, fmt, slen);
+            fmt += slen;
         }
     }
 
@@ -481,6 +604,25 @@ ngx_vslprintf(u_char *buf, u_char *last, const char *fmt, va_list args)
 }
 
 
+static u_char *
+ngx_sprintf_int(u_char *buf, u_char *last, int64_t i64)
+{
+    uint64_t  ui64;
+
+    /* "buf < last" is checked by the caller */
+
+    if (i64 < 0) {
+        *buf++ = '-';
+        ui64 = (uint64_t) -i64;
+
+    } else {
+        ui64 = (uint64_t) i64;
+    }
+
+    return ngx_sprintf_num(buf, last, ui64, ' ', 0, 0);
+}
+
+
 static u_char *
 ngx_sprintf_num(u_char *buf, u_char *last, uint64_t ui64, u_char zero,
     ngx_uint_t hexadecimal, ngx_uint_t width)
@@ -491,41 +633,64 @@ ngx_sprintf_num(u_char *buf, u_char *last, uint64_t ui64, u_char zero,
                         * but icc issues the warning
                         */
     size_t          len;
-    uint32_t        ui32;
+    uint32_t        ui32, n;
     static u_char   hex[] = "0123456789abcdef";
     static u_char   HEX[] = "0123456789ABCDEF";
+    static u_char   dec[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
 
     p = temp + NGX_INT64_LEN;
 
     if (hexadecimal == 0) {
 
-        if (ui64 <= (uint64_t) NGX_MAX_UINT32_VALUE) {
+        /*
+         * To divide 64-bit numbers and to find remainders
+         * on the x86 platform gcc and icc call the libc functions
+         * [u]divdi3() and [u]moddi3(), they call another function
+         * in its turn.  On FreeBSD it is the qdivrem() function,
+         * its source code is about 170 lines of the code.
+         * The glibc counterpart is about 150 lines of the code.
+         *
+         * For 32-bit numbers and some divisors gcc and icc use
+         * a inlined multiplication and shifts.  For example,
+         * unsigned "i32 / 10" is compiled to
+         *
+         *     (i32 * 0xCCCCCCCD) >> 35
+         *
+         * so 64-bit arithmetic is used only for the upper digits.
+         * Two digits are converted at once using the "dec" table.
+         */
 
-            /*
-             * To divide 64-bit numbers and to find remainders
-             * on the x86 platform gcc and icc call the libc functions
-             * [u]divdi3() and [u]moddi3(), they call another function
-             * in its turn.  On FreeBSD it is the qdivrem() function,
-             * its source code is about 170 lines of the code.
-             * The glibc counterpart is about 150 lines of the code.
-             *
-             * For 32-bit numbers and some divisors gcc and icc use
-             * a inlined multiplication and shifts.  For example,
-             * unsigned "i32 / 10" is compiled to
-             *
-             *     (i32 * 0xCCCCCCCD) >> 35
-             */
+        while (ui64 > (uint64_t) NGX_MAX_UINT32_VALUE) {
+            n = (uint32_t) (ui64 % 100) * 2;
+            ui64 /= 100;
 
-            ui32 = (uint32_t) ui64;
+            *--p = dec[n + 1];
+            *--p = dec[n];
+        }
 
-            do {
-                *--p = (u_char) (ui32 % 10 + '0');
-            } while (ui32 /= 10);
+        ui32 = (uint32_t) ui64;
+
+        while (ui32 >= 100) {
+            n = (ui32 % 100) * 2;
+            ui32 /= 100;
+
+            *--p = dec[n + 1];
+            *--p = dec[n];
+        }
+
+        if (ui32 >= 10) {
+            n = ui32 * 2;
+
+            *--p = dec[n + 1];
+            *--p = dec[n];
 
         } else {
-            do {
-                *--p = (u_char) (ui64 % 10 + '0');
-            } while (ui64 /= 10);
+            *--p = (u_char) (ui32 + '0');
         }
 
     } else if (hexadecimal == 1) {
@@ -753,6 +918,14 @@ ngx_strstrn(u_char *s1, char *s2, size_t n)
 u_char *
 ngx_strcasestrn(u_char *s1, char *s2, size_t n)
 {
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+    /* the same search, with the end found by the libc strlen() */
+
+    return ngx_strlcasestrn(s1, s1 + ngx_strlen(s1), (u_char *) s2, n);
+
+#else
+
     ngx_uint_t  c1, c2;
 
     c2 = (ngx_uint_t) *s2++;
@@ -773,6 +946,8 @@ ngx_strcasestrn(u_char *s1, char *s2, size_t n)
     } while (ngx_strncasecmp(s1, (u_char *) s2, n) != 0);
 
     return --s1;
+
+#endif
 }
 
 
@@ -792,6 +967,11 @@ ngx_strlcasestrn(u_char *s1, u_char *last, u_char *s2, size_t n)
     last -= n;
 
     do {
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+        s1 = ngx_str_skip_lc(s1, last, (u_char) c2);
+#endif
+
         do {
             if (s1 >= last) {
                 return NULL;
@@ -1449,6 +1629,9 @@ u_char *
 ngx_utf8_cpystrn(u_char *dst, u_char *src, size_t n, size_t len)
 {
     u_char  c, *next;
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+    size_t  k;
+#endif
 
     if (n == 0) {
         return dst;
@@ -1456,6 +1639,25 @@ ngx_utf8_cpystrn(u_char *dst, u_char *src, size_t n, size_t len)
 
     while (--n) {
 
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+        if (n >= 16 && len >= 16) {
+            k = ngx_str_run(src, ngx_min(n, len), NGX_STR_RUN_ASCII);
+
+            if (k) {
+                ngx_memcpy(dst, src, k);
+
+                dst += k;
+                src += k;
+                len -= k;
+                n -= k - 1;
+
+                continue;
+            }
+        }
+
+#endif
+
         c = *src;
         *dst = c;
 
@@ -1496,6 +1698,10 @@ ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
 {
     ngx_uint_t      n;
     uint32_t       *escape;
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+    size_t          k;
+    ngx_uint_t      path;
+#endif
     static u_char   hex[] = "0123456789ABCDEF";
 
     /*
@@ -1639,6 +1845,17 @@ ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
 
     escape = map[type];
 
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+    /*
+     * letters, digits, "-", ".", and "_" are not escaped in all the maps,
+     * and "/" is only escaped in uri_component
+     */
+
+    path = !(escape['/' >> 5] & (1U << ('/' & 0x1f)));
+
+#endif
+
     if (dst == NULL) {
 
         /* find the number of the characters to be escaped */
@@ -1648,7 +1865,23 @@ ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
         while (size) {
             if (escape[*src >> 5] & (1U << (*src & 0x1f))) {
                 n++;
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+            } else if (size >= 16) {
+
+                k = path ? ngx_str_run(src, size, NGX_STR_RUN_URI_PATH)
+                         : ngx_str_run(src, size, NGX_STR_RUN_URI);
+
+                if (k) {
+                    src += k;
+                    size -= k;
+                    continue;
+                }
+
+#endif
             }
+
             src++;
             size--;
         }
@@ -1664,6 +1897,23 @@ ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
             src++;
 
         } else {
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+            if (size >= 16) {
+                k = path ? ngx_str_run(src, size, NGX_STR_RUN_URI_PATH)
+                         : ngx_str_run(src, size, NGX_STR_RUN_URI);
+
+                if (k) {
+                    dst = ngx_cpymem(dst, src, k);
+                    src += k;
+                    size -= k;
+                    continue;
+                }
+            }
+
+#endif
+
             *dst++ = *src++;
         }
         size--;
@@ -1677,6 +1927,9 @@ void
 ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type)
 {
     u_char  *d, *s, ch, c, decoded;
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+    size_t   k;
+#endif
     enum {
         sw_usual = 0,
         sw_quoted,
@@ -1691,6 +1944,30 @@ ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type)
 
     while (size--) {
 
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+        if (state == sw_usual && size >= 16) {
+            k = ngx_str_run(s, size + 1,
+                            (type & (NGX_UNESCAPE_URI|NGX_UNESCAPE_REDIRECT))
+                            ? NGX_STR_RUN_PERCENT_QUERY : NGX_STR_RUN_PERCENT);
+
+            if (k) {
+                /* unescaping is often done in place */
+
+                if (d != s) {
+                    ngx_memmove(d, s, k);
+                }
+
+                d += k;
+                s += k;
+                size -= k - 1;
+
+                continue;
+            }
+        }
+
+#endif
+
         ch = *s++;
 
         switch (state) {
@@ -1808,12 +2085,31 @@ ngx_escape_html(u_char *dst, u_char *src, size_t size)
 {
     u_char      ch;
     ngx_uint_t  len;
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+    size_t      k;
+#endif
 
     if (dst == NULL) {
 
         len = 0;
 
         while (size) {
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+            if (size >= 16) {
+                k = ngx_str_run(src, size, NGX_STR_RUN_HTML);
+
+                src += k;
+                size -= k;
+
+                if (size == 0) {
+                    break;
+                }
+            }
+
+#endif
+
             switch (*src++) {
 
             case '<':
@@ -1842,6 +2138,23 @@ ngx_escape_html(u_char *dst, u_char *src, size_t size)
     }
 
     while (size) {
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+        if (size >= 16) {
+            k = ngx_str_run(src, size, NGX_STR_RUN_HTML);
+
+            dst = ngx_cpymem(dst, src, k);
+            src += k;
+            size -= k;
+
+            if (size == 0) {
+                break;
+            }
+        }
+
+#endif
+
         ch = *src++;
 
         switch (ch) {
@@ -2102,3 +2415,230 @@ ngx_memcpy(void *dst, const void *src, size_t n)
 }
 
 #endif
+
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+/*
+ * returns the length of the leading bytes which need no special handling,
+ * checked 16 bytes at a time up to n; the rest is left to the caller
+ */
+
+static ngx_inline size_t
+ngx_str_run(u_char *p, size_t n, ngx_uint_t type)
+{
+    size_t      i;
+#if (NGX_HAVE_SSE2)
+    int         mask;
+    __m128i     v, d, m;
+#else
+    uint64_t    mask;
+    uint8x16_t  v, m;
+#endif
+
+    for (i = 0; n - i >= 16; i += 16) {
+
+#if (NGX_HAVE_SSE2)
+
+        v = _mm_loadu_si128((const __m128i *) (p + i));
+
+        switch (type) {
+
+        case NGX_STR_RUN_URI:
+        case NGX_STR_RUN_URI_PATH:
+
+            /*
+             * v - '0' <= 9 || (v | 0x20) - 'a' <= 25 || v == '_'
+             * || v - '-' <= 1, or <= 2 to include "/"
+             */
+
+            d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+            m = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+
+            d = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                             _mm_set1_epi8('a'));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(
+                                    _mm_min_epu8(d, _mm_set1_epi8(25)), d));
+
+            d = _mm_sub_epi8(v, _mm_set1_epi8('-'));
+            d = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(
+                                   type == NGX_STR_RUN_URI_PATH ? 2 : 1)), d);
+
+            m = _mm_or_si128(_mm_or_si128(m, d),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+            mask = _mm_movemask_epi8(m) ^ 0xffff;
+            break;
+
+        case NGX_STR_RUN_ASCII:
+
+            /* v - 1 >= 0x7f, that is, '\0' or not ASCII */
+
+            d = _mm_sub_epi8(v, _mm_set1_epi8(1));
+            m = _mm_cmpeq_epi8(_mm_max_epu8(d, _mm_set1_epi8(0x7f)), d);
+
+            mask = _mm_movemask_epi8(m);
+            break;
+
+        case NGX_STR_RUN_HTML:
+            m = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('<')),
+                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('>'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')),
+                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))));
+
+            mask = _mm_movemask_epi8(m);
+            break;
+
+        case NGX_STR_RUN_PERCENT_QUERY:
+            m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('%')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('?')));
+
+            mask = _mm_movemask_epi8(m);
+            break;
+
+        default: /* NGX_STR_RUN_PERCENT */
+            m = _mm_cmpeq_epi8(v, _mm_set1_epi8('%'));
+
+            mask = _mm_movemask_epi8(m);
+            break;
+        }
+
+        if (mask) {
+            while (!(mask & 1)) {
+                mask >>= 1;
+                i++;
+            }
+
+            return i;
+        }
+
+#else /* NGX_HAVE_NEON */
+
+        v = vld1q_u8(p + i);
+
+        switch (type) {
+
+        case NGX_STR_RUN_URI:
+        case NGX_STR_RUN_URI_PATH:
+            m = vorrq_u8(vcleq_u8(vsubq_u8(v, vdupq_n_u8('0')),
+                                  vdupq_n_u8(9)),
+                         vcleq_u8(vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)),
+                                           vdupq_n_u8('a')),
+                                  vdupq_n_u8(25)));
+            m = vorrq_u8(m, vcleq_u8(vsubq_u8(v, vdupq_n_u8('-')),
+                                     vdupq_n_u8(type == NGX_STR_RUN_URI_PATH
+                                                ? 2 : 1)));
+            m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('_')));
+            m = vmvnq_u8(m);
+            break;
+
+        case NGX_STR_RUN_ASCII:
+            m = vcgeq_u8(vsubq_u8(v, vdupq_n_u8(1)), vdupq_n_u8(0x7f));
+            break;
+
+        case NGX_STR_RUN_HTML:
+            m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('<')),
+                                  vceqq_u8(v, vdupq_n_u8('>'))),
+                         vorrq_u8(vceqq_u8(v, vdupq_n_u8('&')),
+                                  vceqq_u8(v, vdupq_n_u8('"'))));
+            break;
+
+        case NGX_STR_RUN_PERCENT_QUERY:
+            m = vorrq_u8(vceqq_u8(v, vdupq_n_u8('%')),
+                         vceqq_u8(v, vdupq_n_u8('?')));
+            break;
+
+        default: /* NGX_STR_RUN_PERCENT */
+            m = vceqq_u8(v, vdupq_n_u8('%'));
+            break;
+        }
+
+        /* 4 bits of the mask per byte */
+
+        mask = vget_lane_u64(vreinterpret_u64_u8(
+                   vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+
+        if (mask) {
+            while (!(mask & 0xf)) {
+                mask >>= 4;
+                i++;
+            }
+
+            return i;
+        }
+
+#endif
+    }
+
+    return i;
+}
+
+
+/* skips 16 bytes at a time up to a byte which is c after ngx_tolower() */
+
+static ngx_inline u_char *
+ngx_str_skip_lc(u_char *p, u_char *last, u_char c)
+{
+#if (NGX_HAVE_SSE2)
+
+    int         mask;
+    __m128i     v, d, m, cv;
+
+    cv = _mm_set1_epi8((char) c);
+
+    while (last - p >= 16) {
+        v = _mm_loadu_si128((const __m128i *) p);
+
+        d = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+        m = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(25)), d);
+        v = _mm_or_si128(v, _mm_and_si128(m, _mm_set1_epi8(0x20)));
+
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, cv));
+
+        if (mask) {
+            while (!(mask & 1)) {
+                mask >>= 1;
+                p++;
+            }
+
+            return p;
+        }
+
+        p += 16;
+    }
+
+#else /* NGX_HAVE_NEON */
+
+    uint64_t    mask;
+    uint8x16_t  v, m, cv;
+
+    cv = vdupq_n_u8(c);
+
+    while (last - p >= 16) {
+        v = vld1q_u8(p);
+
+        m = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8(25));
+        v = vorrq_u8(v, vandq_u8(m, vdupq_n_u8(0x20)));
+
+        mask = vget_lane_u64(vreinterpret_u64_u8(
+                   vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(v, cv)), 4)), 0);
+
+        if (mask) {
+            while (!(mask & 0xf)) {
+                mask >>= 4;
+                p++;
+            }
+
+            return p;
+        }
+
+        p += 16;
+    }
+
+#endif
+
+    return p;
+}
+
+#endif
@@ -17,6 +17,12 @@
 
 static char *ngx_syslog_parse_args(ngx_conf_t *cf, ngx_syslog_peer_t *peer);
 static ngx_int_t ngx_syslog_init_peer(ngx_syslog_peer_t *peer);
+static ssize_t ngx_syslog_queue(ngx_syslog_peer_t *peer, u_char *buf,
+    size_t len);
+static void ngx_syslog_flush(ngx_syslog_peer_t *peer);
+static void ngx_syslog_flush_handler(ngx_event_t *ev);
+static size_t ngx_syslog_partial(u_char *p, size_t n, size_t partial);
+static void ngx_syslog_close(ngx_syslog_peer_t *peer);
 static void ngx_syslog_cleanup(void *data);
 static u_char *ngx_syslog_log_error(ngx_log_t *log, u_char *buf, size_t len);
 
@@ -94,12 +100,17 @@ ngx_syslog_parse_args(ngx_conf_t *cf, ngx_syslog_peer_t *peer)
 {
     u_char      *p, *comma, c;
     size_t       len;
-    ngx_str_t   *value;
+    ssize_t      size;
+    ngx_str_t   *value, s;
     ngx_url_t    u;
     ngx_uint_t   i;
+    ngx_msec_t   flush;
 
     value = cf->args->elts;
 
+    size = 0;
+    flush = 0;
+
     p = value[1].data + sizeof("syslog:") - 1;
 
     for ( ;; ) {
@@ -215,6 +226,38 @@ ngx_syslog_parse_args(ngx_conf_t *cf, ngx_syslog_peer_t *peer)
         } else if (len == 10 && ngx_strncmp(p, "nohostname", 10) == 0) {
             peer->nohostname = 1;
 
+        } else if (ngx_strcmp(p, "transport=stream") == 0) {
+            peer->stream = 1;
+
+        } else if (ngx_strcmp(p, "transport=dgram") == 0) {
+            peer->stream = 0;
+
+        } else if (ngx_strncmp(p, "buffer=", 7) == 0) {
+            s.len = len - 7;
+            s.data = p + 7;
+
+            size = ngx_parse_size(&s);
+
+            if (size == NGX_ERROR
+                || (size_t) size < NGX_SYSLOG_MAX_STR + NGX_SIZE_T_LEN + 1)
+            {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid syslog buffer size \"%V\"", &s);
+                return NGX_CONF_ERROR;
+            }
+
+        } else if (ngx_strncmp(p, "flush=", 6) == 0) {
+            s.len = len - 6;
+            s.data = p + 6;
+
+            flush = ngx_parse_time(&s, 0);
+
+            if (flush == (ngx_msec_t) NGX_ERROR || flush == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid syslog flush time \"%V\"", &s);
+                return NGX_CONF_ERROR;
+            }
+
         } else {
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                                "unknown syslog parameter \"%s\"", p);
@@ -230,6 +273,40 @@ ngx_syslog_parse_args(ngx_conf_t *cf, ngx_syslog_peer_t *peer)
         p = comma + 1;
     }
 
+    if (!peer->stream) {
+
+        if (size || flush) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "syslog \"buffer\" and \"flush\" require "
+                               "\"transport=stream\"");
+            return NGX_CONF_ERROR;
+        }
+
+        return NGX_CONF_OK;
+    }
+
+    /*
+     * records sent over a stream are collected in a buffer, which is
+     * written when it is full or after the flush time
+     */
+
+    peer->buffer = ngx_create_temp_buf(cf->pool, size ? size : 64 * 1024);
+    if (peer->buffer == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    peer->event = ngx_pcalloc(cf->pool, sizeof(ngx_event_t));
+    if (peer->event == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    peer->event->handler = ngx_syslog_flush_handler;
+    peer->event->data = peer;
+    peer->event->log = &ngx_syslog_dummy_log;
+    peer->event->cancelable = 1;
+
+    peer->flush = flush ? flush : 1000;
+
     return NGX_CONF_OK;
 }
 
@@ -281,6 +358,10 @@ ngx_syslog_writer(ngx_log_t *log, ngx_uint_t level, u_char *buf,
 
     (void) ngx_syslog_send(peer, msg, p - msg);
 
+    if (peer->buffer && level <= NGX_LOG_CRIT) {
+        ngx_syslog_flush(peer);
+    }
+
     peer->busy = 0;
 }
 
@@ -297,6 +378,10 @@ ngx_syslog_send(ngx_syslog_peer_t *peer, u_char *buf, size_t len)
         peer->log.action = "logging to syslog";
     }
 
+    if (peer->buffer) {
+        return ngx_syslog_queue(peer, buf, len);
+    }
+
     if (peer->conn.fd == (ngx_socket_t) -1) {
         if (ngx_syslog_init_peer(peer) != NGX_OK) {
             return NGX_ERROR;
@@ -312,13 +397,7 @@ ngx_syslog_send(ngx_syslog_peer_t *peer, u_char *buf, size_t len)
     }
 
     if (n == NGX_ERROR) {
-
-        if (ngx_close_socket(peer->conn.fd) == -1) {
-            ngx_log_error(NGX_LOG_ALERT, &peer->log, ngx_socket_errno,
-                          ngx_close_socket_n " failed");
-        }
-
-        peer->conn.fd = (ngx_socket_t) -1;
+        ngx_syslog_close(peer);
     }
 
     return n;
@@ -330,7 +409,8 @@ ngx_syslog_init_peer(ngx_syslog_peer_t *peer)
 {
     ngx_socket_t  fd;
 
-    fd = ngx_socket(peer->server.sockaddr->sa_family, SOCK_DGRAM, 0);
+    fd = ngx_socket(peer->server.sockaddr->sa_family,
+                    peer->stream ? SOCK_STREAM : SOCK_DGRAM, 0);
     if (fd == (ngx_socket_t) -1) {
         ngx_log_error(NGX_LOG_ALERT, &peer->log, ngx_socket_errno,
                       ngx_socket_n " failed");
@@ -343,7 +423,9 @@ ngx_syslog_init_peer(ngx_syslog_peer_t *peer)
         goto failed;
     }
 
-    if (connect(fd, peer->server.sockaddr, peer->server.socklen) == -1) {
+    if (connect(fd, peer->server.sockaddr, peer->server.socklen) == -1
+        && !(peer->stream && ngx_socket_errno == NGX_EINPROGRESS))
+    {
         ngx_log_error(NGX_LOG_ALERT, &peer->log, ngx_socket_errno,
                       "connect() failed");
         goto failed;
@@ -352,7 +434,10 @@ ngx_syslog_init_peer(ngx_syslog_peer_t *peer)
     peer->conn.fd = fd;
     peer->conn.log = &peer->log;
 
-    /* UDP sockets are always ready to write */
+    /*
+     * UDP sockets are always ready to write; until a stream connection
+     * is established, send() fails with EAGAIN and the data are kept
+     */
     peer->conn.write->ready = 1;
 
     return NGX_OK;
@@ -376,14 +461,217 @@ ngx_syslog_cleanup(void *data)
     /* prevents further use of this peer */
     peer->busy = 1;
 
+    if (peer->buffer) {
+
+        /* the last attempt to send the rest, without blocking */
+
+        ngx_syslog_flush(peer);
+
+        if (peer->event->timer_set) {
+            ngx_del_timer(peer->event);
+        }
+    }
+
+    if (peer->conn.fd == (ngx_socket_t) -1) {
+        return;
+    }
+
+    if (ngx_close_socket(peer->conn.fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, &peer->log, ngx_socket_errno,
+                      ngx_close_socket_n " failed");
+    }
+}
+
+
+static ssize_t
+ngx_syslog_queue(ngx_syslog_peer_t *peer, u_char *buf, size_t len)
+{
+    ngx_buf_t  *b;
+
+    b = peer->buffer;
+
+    if (peer->pid != ngx_pid) {
+
+        /*
+         * the connection and the records queued were inherited
+         * from the parent process, which sends them itself
+         */
+
+        if (peer->conn.fd != (ngx_socket_t) -1) {
+            (void) ngx_close_socket(peer->conn.fd);
+            peer->conn.fd = (ngx_socket_t) -1;
+        }
+
+        b->pos = b->start;
+        b->last = b->start;
+
+        peer->partial = 0;
+        peer->dropped = 0;
+        peer->pid = ngx_pid;
+    }
+
+    /* RFC 6587, octet-counting framing */
+
+    if ((size_t) (b->end - b->last) < NGX_SIZE_T_LEN + 1 + len) {
+        ngx_syslog_flush(peer);
+
+        if ((size_t) (b->end - b->last) < NGX_SIZE_T_LEN + 1 + len) {
+
+            /*
+             * the server does not keep up: the record is dropped
+             * and accounted, so that callers do not log each one
+             */
+
+            peer->dropped++;
+            return len;
+        }
+    }
+
+    b->last = ngx_sprintf(b->last, "%uz ", len);
+    b->last = ngx_cpymem(b->last, buf, len);
+
+    if (ngx_event_timer_rbtree.root == NULL) {
+
+        /* no timers in the master process and before the event loop */
+
+        ngx_syslog_flush(peer);
+
+    } else if (!peer->event->timer_set) {
+        ngx_add_timer(peer->event, peer->flush);
+    }
+
+    return len;
+}
+
+
+static void
+ngx_syslog_flush(ngx_syslog_peer_t *peer)
+{
+    ssize_t     n;
+    ngx_buf_t  *b;
+
+    b = peer->buffer;
+
+    if (b->pos == b->last || peer->pid != ngx_pid) {
+        return;
+    }
+
     if (peer->conn.fd == (ngx_socket_t) -1) {
+        if (ngx_syslog_init_peer(peer) != NGX_OK) {
+            goto retry;
+        }
+    }
+
+    if (ngx_send) {
+        n = ngx_send(&peer->conn, b->pos, b->last - b->pos);
+
+    } else {
+        n = ngx_os_io.send(&peer->conn, b->pos, b->last - b->pos);
+    }
+
+    if (n == NGX_ERROR) {
+        ngx_syslog_close(peer);
+
+        /* the rest of a partially sent record cannot be sent anew */
+
+        b->pos += peer->partial;
+        peer->partial = 0;
+
+    } else if (n > 0) {
+        peer->partial = ngx_syslog_partial(b->pos, n, peer->partial);
+        b->pos += n;
+
+        if (peer->dropped) {
+            ngx_log_error(NGX_LOG_WARN, &peer->log, 0,
+                          "%ui records dropped as the syslog server "
+                          "did not keep up", peer->dropped);
+            peer->dropped = 0;
+        }
+    }
+
+    if (b->pos == b->last) {
+        b->pos = b->start;
+        b->last = b->start;
+
+    } else if (b->pos != b->start) {
+        b->last = ngx_movemem(b->start, b->pos, b->last - b->pos);
+        b->pos = b->start;
+    }
+
+retry:
+
+    if (ngx_event_timer_rbtree.root == NULL) {
+        return;
+    }
+
+    if (b->pos == b->last) {
+        if (peer->event->timer_set) {
+            ngx_del_timer(peer->event);
+        }
+
         return;
     }
 
+    /* the rest is sent, or the connection is retried, later */
+
+    if (!peer->event->timer_set) {
+        ngx_add_timer(peer->event, peer->flush);
+    }
+}
+
+
+static void
+ngx_syslog_flush_handler(ngx_event_t *ev)
+{
+    ngx_syslog_peer_t  *peer = ev->data;
+
+    if (peer->busy) {
+        return;
+    }
+
+    peer->busy = 1;
+
+    ngx_syslog_flush(peer);
+
+    peer->busy = 0;
+}
+
+
+static size_t
+ngx_syslog_partial(u_char *p, size_t n, size_t partial)
+{
+    size_t   len;
+    u_char  *last;
+
+    /* returns the number of bytes of the last record not yet sent */
+
+    last = p + n;
+    p += partial;
+
+    while (p < last) {
+
+        /* the buffer always contains whole records */
+
+        for (len = 0; *p != ' '; p++) {
+            len = len * 10 + (*p - '0');
+        }
+
+        p += 1 + len;
+    }
+
+    return p - last;
+}
+
+
+static void
+ngx_syslog_close(ngx_syslog_peer_t *peer)
+{
     if (ngx_close_socket(peer->conn.fd) == -1) {
         ngx_log_error(NGX_LOG_ALERT, &peer->log, ngx_socket_errno,
                       ngx_close_socket_n " failed");
     }
+
+    peer->conn.fd = (ngx_socket_t) -1;
 }
 
 
@@ -21,8 +21,17 @@ typedef struct {
     ngx_log_t          log;
     ngx_log_t         *logp;
 
+    /* stream transport */
+    ngx_buf_t         *buffer;
+    ngx_msec_t         flush;
+    ngx_event_t       *event;
+    size_t             partial;
+    ngx_uint_t         dropped;
+    ngx_pid_t          pid;
+
     unsigned           busy:1;
     unsigned           nohostname:1;
+    unsigned           stream:1;
 } ngx_syslog_peer_t;
 
 
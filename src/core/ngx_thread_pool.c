@@ -26,17 +26,39 @@ typedef struct {
     (q)->last = &(q)->first
 
 
+/* a per-thread queue of the work stealing mode */
+
+typedef struct {
+    ngx_thread_mutex_t        mtx;
+    ngx_thread_pool_queue_t   queue;
+    ngx_thread_cond_t         cond;
+    ngx_uint_t                index;
+    ngx_thread_pool_t        *tp;
+
+    /* the thread does not run a task */
+    volatile ngx_uint_t       idle;
+
+    u_char                    padding[NGX_CPU_CACHE_LINE];
+} ngx_thread_pool_local_t;
+
+
 struct ngx_thread_pool_s {
     ngx_thread_mutex_t        mtx;
     ngx_thread_pool_queue_t   queue;
     ngx_int_t                 waiting;
     ngx_thread_cond_t         cond;
 
+    ngx_thread_pool_local_t  *locals;
+    ngx_uint_t                next;
+
+    ngx_thread_pool_stats_t   stats;
+
     ngx_log_t                *log;
 
     ngx_str_t                 name;
     ngx_uint_t                threads;
     ngx_int_t                 max_queue;
+    ngx_uint_t                steal;
 
     u_char                   *file;
     ngx_uint_t                line;
@@ -48,7 +70,16 @@ static ngx_int_t ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log,
 static void ngx_thread_pool_destroy(ngx_thread_pool_t *tp);
 static void ngx_thread_pool_exit_handler(void *data, ngx_log_t *log);
 
+static ngx_int_t ngx_thread_pool_init_locals(ngx_thread_pool_t *tp,
+    ngx_log_t *log, ngx_pool_t *pool);
+static void ngx_thread_pool_push(ngx_thread_pool_local_t *lt,
+    ngx_thread_task_t *task);
+static ngx_int_t ngx_thread_pool_block_signals(ngx_thread_pool_t *tp);
 static void *ngx_thread_pool_cycle(void *data);
+static void *ngx_thread_pool_steal_cycle(void *data);
+static ngx_thread_task_t *ngx_thread_pool_steal(ngx_thread_pool_local_t *lt);
+static void ngx_thread_pool_run(ngx_thread_pool_t *tp,
+    ngx_thread_task_t *task);
 static void ngx_thread_pool_handler(ngx_event_t *ev);
 
 static char *ngx_thread_pool(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
@@ -63,7 +94,7 @@ static void ngx_thread_pool_exit_worker(ngx_cycle_t *cycle);
 static ngx_command_t  ngx_thread_pool_commands[] = {
 
     { ngx_string("thread_pool"),
-      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE23,
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_2MORE,
       ngx_thread_pool,
       0,
       0,
@@ -99,8 +130,9 @@ ngx_module_t  ngx_thread_pool_module = {
 static ngx_str_t  ngx_thread_pool_default = ngx_string("default");
 
 static ngx_uint_t               ngx_thread_pool_task_id;
-static ngx_atomic_t             ngx_thread_pool_done_lock;
-static ngx_thread_pool_queue_t  ngx_thread_pool_done;
+
+/* a lock-free list of completed tasks, in reverse order */
+static ngx_atomic_t             ngx_thread_pool_done;
 
 
 static ngx_int_t
@@ -130,6 +162,12 @@ ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
 
     tp->log = log;
 
+    ngx_memzero(&tp->stats, sizeof(ngx_thread_pool_stats_t));
+
+    if (tp->steal && ngx_thread_pool_init_locals(tp, log, pool) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     err = pthread_attr_init(&attr);
     if (err) {
         ngx_log_error(NGX_LOG_ALERT, log, err,
@@ -154,7 +192,14 @@ ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
 #endif
 
     for (n = 0; n < tp->threads; n++) {
-        err = pthread_create(&tid, &attr, ngx_thread_pool_cycle, tp);
+        if (tp->steal) {
+            err = pthread_create(&tid, &attr, ngx_thread_pool_steal_cycle,
+                                 &tp->locals[n]);
+
+        } else {
+            err = pthread_create(&tid, &attr, ngx_thread_pool_cycle, tp);
+        }
+
         if (err) {
             ngx_log_error(NGX_LOG_ALERT, log, err,
                           "pthread_create() failed");
@@ -168,6 +213,43 @@ ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
 }
 
 
+static ngx_int_t
+ngx_thread_pool_init_locals(ngx_thread_pool_t *tp, ngx_log_t *log,
+    ngx_pool_t *pool)
+{
+    ngx_uint_t                n;
+    ngx_thread_pool_local_t  *lt;
+
+    tp->locals = ngx_pcalloc(pool,
+                             tp->threads * sizeof(ngx_thread_pool_local_t));
+    if (tp->locals == NULL) {
+        return NGX_ERROR;
+    }
+
+    tp->next = 0;
+
+    for (n = 0; n < tp->threads; n++) {
+        lt = &tp->locals[n];
+
+        ngx_thread_pool_queue_init(&lt->queue);
+
+        if (ngx_thread_mutex_create(&lt->mtx, log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        if (ngx_thread_cond_create(&lt->cond, log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        lt->index = n;
+        lt->tp = tp;
+        lt->idle = 1;
+    }
+
+    return NGX_OK;
+}
+
+
 static void
 ngx_thread_pool_destroy(ngx_thread_pool_t *tp)
 {
@@ -175,6 +257,12 @@ ngx_thread_pool_destroy(ngx_thread_pool_t *tp)
     ngx_thread_task_t    task;
     volatile ngx_uint_t  lock;
 
+    ngx_log_error(NGX_LOG_INFO, tp->log, 0,
+                  "thread pool \"%V\": %uA tasks, max queue %uA, "
+                  "wait %uA usec, max wait %uA usec, stolen %uA",
+                  &tp->name, tp->stats.tasks, tp->stats.max_queued,
+                  tp->stats.wait, tp->stats.max_wait, tp->stats.stolen);
+
     ngx_memzero(&task, sizeof(ngx_thread_task_t));
 
     task.handler = ngx_thread_pool_exit_handler;
@@ -183,7 +271,14 @@ ngx_thread_pool_destroy(ngx_thread_pool_t *tp)
     for (n = 0; n < tp->threads; n++) {
         lock = 1;
 
-        if (ngx_thread_task_post(tp, &task) != NGX_OK) {
+        if (tp->steal) {
+
+            /* exit tasks are never stolen, see ngx_thread_pool_steal() */
+
+            task.posted = ngx_event_stats_usec();
+            ngx_thread_pool_push(&tp->locals[n], &task);
+
+        } else if (ngx_thread_task_post(tp, &task) != NGX_OK) {
             return;
         }
 
@@ -194,6 +289,13 @@ ngx_thread_pool_destroy(ngx_thread_pool_t *tp)
         task.event.active = 0;
     }
 
+    if (tp->steal) {
+        for (n = 0; n < tp->threads; n++) {
+            (void) ngx_thread_cond_destroy(&tp->locals[n].cond, tp->log);
+            (void) ngx_thread_mutex_destroy(&tp->locals[n].mtx, tp->log);
+        }
+    }
+
     (void) ngx_thread_cond_destroy(&tp->cond, tp->log);
 
     (void) ngx_thread_mutex_destroy(&tp->mtx, tp->log);
@@ -230,12 +332,57 @@ ngx_thread_task_alloc(ngx_pool_t *pool, size_t size)
 ngx_int_t
 ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 {
+    ngx_uint_t                i, n;
+    ngx_atomic_uint_t         queued;
+    ngx_thread_pool_local_t  *lt;
+
     if (task->event.active) {
         ngx_log_error(NGX_LOG_ALERT, tp->log, 0,
                       "task #%ui already active", task->id);
         return NGX_ERROR;
     }
 
+    task->posted = ngx_event_stats_usec();
+
+    if (tp->steal) {
+
+        if ((ngx_int_t) tp->stats.queued >= tp->max_queue) {
+            ngx_log_error(NGX_LOG_ERR, tp->log, 0,
+                          "thread pool \"%V\" queue overflow: "
+                          "%uA tasks waiting", &tp->name, tp->stats.queued);
+            return NGX_ERROR;
+        }
+
+        task->event.active = 1;
+
+        task->id = ngx_thread_pool_task_id++;
+
+        /* prefer an idle thread, the flags are read without locking */
+
+        n = tp->next;
+
+        for (i = 0; i < tp->threads; i++) {
+            if (tp->locals[(n + i) % tp->threads].idle) {
+                break;
+            }
+        }
+
+        if (i == tp->threads) {
+            i = 0;
+        }
+
+        lt = &tp->locals[(n + i) % tp->threads];
+        tp->next = (n + i + 1) % tp->threads;
+
+        ngx_thread_pool_push(lt, task);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_CORE, tp->log, 0,
+                       "task #%ui added to thread %ui in pool \"%V\"",
+                       task->id, lt->index, &tp->name);
+
+        return NGX_OK;
+    }
+
     if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
         return NGX_ERROR;
     }
@@ -264,6 +411,12 @@ ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 
     tp->waiting++;
 
+    queued = ngx_atomic_fetch_add(&tp->stats.queued, 1) + 1;
+
+    if (queued > tp->stats.max_queued) {
+        tp->stats.max_queued = queued;
+    }
+
     (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
 
     ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
@@ -274,21 +427,40 @@ ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 }
 
 
-static void *
-ngx_thread_pool_cycle(void *data)
+static void
+ngx_thread_pool_push(ngx_thread_pool_local_t *lt, ngx_thread_task_t *task)
 {
-    ngx_thread_pool_t *tp = data;
+    ngx_atomic_uint_t   queued;
+    ngx_thread_pool_t  *tp;
 
-    int                 err;
-    sigset_t            set;
-    ngx_thread_task_t  *task;
+    tp = lt->tp;
 
-#if 0
-    ngx_time_update();
-#endif
+    queued = ngx_atomic_fetch_add(&tp->stats.queued, 1) + 1;
 
-    ngx_log_debug1(NGX_LOG_DEBUG_CORE, tp->log, 0,
-                   "thread in pool \"%V\" started", &tp->name);
+    if (queued > tp->stats.max_queued) {
+        tp->stats.max_queued = queued;
+    }
+
+    task->next = NULL;
+
+    (void) ngx_thread_mutex_lock(&lt->mtx, tp->log);
+
+    *lt->queue.last = task;
+    lt->queue.last = &task->next;
+
+    if (lt->idle) {
+        (void) ngx_thread_cond_signal(&lt->cond, tp->log);
+    }
+
+    (void) ngx_thread_mutex_unlock(&lt->mtx, tp->log);
+}
+
+
+static ngx_int_t
+ngx_thread_pool_block_signals(ngx_thread_pool_t *tp)
+{
+    int       err;
+    sigset_t  set;
 
     sigfillset(&set);
 
@@ -300,6 +472,28 @@ ngx_thread_pool_cycle(void *data)
     err = pthread_sigmask(SIG_BLOCK, &set, NULL);
     if (err) {
         ngx_log_error(NGX_LOG_ALERT, tp->log, err, "pthread_sigmask() failed");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_thread_pool_cycle(void *data)
+{
+    ngx_thread_pool_t *tp = data;
+
+    ngx_thread_task_t  *task;
+
+#if 0
+    ngx_time_update();
+#endif
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, tp->log, 0,
+                   "thread in pool \"%V\" started", &tp->name);
+
+    if (ngx_thread_pool_block_signals(tp) != NGX_OK) {
         return NULL;
     }
 
@@ -335,27 +529,177 @@ ngx_thread_pool_cycle(void *data)
         ngx_time_update();
 #endif
 
-        ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
-                       "run task #%ui in thread pool \"%V\"",
-                       task->id, &tp->name);
+        ngx_thread_pool_run(tp, task);
+    }
+}
+
+
+static void *
+ngx_thread_pool_steal_cycle(void *data)
+{
+    ngx_thread_pool_local_t *lt = data;
+
+    ngx_thread_pool_t  *tp;
+    ngx_thread_task_t  *task;
+
+    tp = lt->tp;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
+                   "thread %ui in pool \"%V\" started", lt->index, &tp->name);
+
+    if (ngx_thread_pool_block_signals(tp) != NGX_OK) {
+        return NULL;
+    }
+
+    for ( ;; ) {
+        if (ngx_thread_mutex_lock(&lt->mtx, tp->log) != NGX_OK) {
+            return NULL;
+        }
+
+        lt->idle = 1;
+
+        for ( ;; ) {
+            task = lt->queue.first;
 
-        task->handler(task->ctx, tp->log);
+            if (task) {
+                lt->queue.first = task->next;
+
+                if (lt->queue.first == NULL) {
+                    lt->queue.last = &lt->queue.first;
+                }
+
+                break;
+            }
 
-        ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
-                       "complete task #%ui in thread pool \"%V\"",
-                       task->id, &tp->name);
+            (void) ngx_thread_mutex_unlock(&lt->mtx, tp->log);
 
-        task->next = NULL;
+            task = ngx_thread_pool_steal(lt);
 
-        ngx_spinlock(&ngx_thread_pool_done_lock, 1, 2048);
+            if (ngx_thread_mutex_lock(&lt->mtx, tp->log) != NGX_OK) {
+                return NULL;
+            }
 
-        *ngx_thread_pool_done.last = task;
-        ngx_thread_pool_done.last = &task->next;
+            if (task) {
+                break;
+            }
 
-        ngx_memory_barrier();
+            /* a task may have been added while stealing */
 
-        ngx_unlock(&ngx_thread_pool_done_lock);
+            if (lt->queue.first) {
+                continue;
+            }
 
+            if (ngx_thread_cond_wait(&lt->cond, &lt->mtx, tp->log)
+                != NGX_OK)
+            {
+                (void) ngx_thread_mutex_unlock(&lt->mtx, tp->log);
+                return NULL;
+            }
+        }
+
+        lt->idle = 0;
+
+        if (ngx_thread_mutex_unlock(&lt->mtx, tp->log) != NGX_OK) {
+            return NULL;
+        }
+
+        ngx_thread_pool_run(tp, task);
+    }
+}
+
+
+static ngx_thread_task_t *
+ngx_thread_pool_steal(ngx_thread_pool_local_t *lt)
+{
+    ngx_uint_t                i;
+    ngx_thread_pool_t        *tp;
+    ngx_thread_task_t        *task;
+    ngx_thread_pool_local_t  *victim;
+
+    tp = lt->tp;
+
+    for (i = 1; i < tp->threads; i++) {
+        victim = &tp->locals[(lt->index + i) % tp->threads];
+
+        if (victim->queue.first == NULL) {
+            continue;
+        }
+
+        if (ngx_thread_mutex_lock(&victim->mtx, tp->log) != NGX_OK) {
+            return NULL;
+        }
+
+        task = victim->queue.first;
+
+        /* exit tasks must be run by the thread they were posted to */
+
+        if (task == NULL || task->handler == ngx_thread_pool_exit_handler) {
+            (void) ngx_thread_mutex_unlock(&victim->mtx, tp->log);
+            continue;
+        }
+
+        victim->queue.first = task->next;
+
+        if (victim->queue.first == NULL) {
+            victim->queue.last = &victim->queue.first;
+        }
+
+        (void) ngx_thread_mutex_unlock(&victim->mtx, tp->log);
+
+        (void) ngx_atomic_fetch_add(&tp->stats.stolen, 1);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_CORE, tp->log, 0,
+                       "thread %ui stole task #%ui from thread %ui",
+                       lt->index, task->id, victim->index);
+
+        return task;
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_thread_pool_run(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
+{
+    uint64_t           wait;
+    ngx_atomic_uint_t  head;
+
+    wait = ngx_event_stats_usec() - task->posted;
+
+    (void) ngx_atomic_fetch_add(&tp->stats.queued, -1);
+    (void) ngx_atomic_fetch_add(&tp->stats.tasks, 1);
+    (void) ngx_atomic_fetch_add(&tp->stats.wait, (ngx_atomic_int_t) wait);
+
+    /* races only lose a maximum update */
+
+    if (wait > tp->stats.max_wait) {
+        tp->stats.max_wait = (ngx_atomic_uint_t) wait;
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_CORE, tp->log, 0,
+                   "run task #%ui in thread pool \"%V\", waited %uL usec",
+                   task->id, &tp->name, wait);
+
+    task->handler(task->ctx, tp->log);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
+                   "complete task #%ui in thread pool \"%V\"",
+                   task->id, &tp->name);
+
+    do {
+        head = ngx_thread_pool_done;
+        task->next = (ngx_thread_task_t *) head;
+
+    } while (!ngx_atomic_cmp_set(&ngx_thread_pool_done, head,
+                                 (ngx_atomic_uint_t) task));
+
+    /*
+     * only the first task of a batch notifies the event loop,
+     * the handler takes all tasks completed until it runs
+     */
+
+    if (head == 0) {
         (void) ngx_notify(ngx_thread_pool_handler);
     }
 }
@@ -365,19 +709,27 @@ static void
 ngx_thread_pool_handler(ngx_event_t *ev)
 {
     ngx_event_t        *event;
-    ngx_thread_task_t  *task;
+    ngx_atomic_uint_t   head;
+    ngx_thread_task_t  *task, *next;
 
     ngx_log_debug0(NGX_LOG_DEBUG_CORE, ev->log, 0, "thread pool handler");
 
-    ngx_spinlock(&ngx_thread_pool_done_lock, 1, 2048);
+    do {
+        head = ngx_thread_pool_done;
+
+    } while (!ngx_atomic_cmp_set(&ngx_thread_pool_done, head, 0));
 
-    task = ngx_thread_pool_done.first;
-    ngx_thread_pool_done.first = NULL;
-    ngx_thread_pool_done.last = &ngx_thread_pool_done.first;
+    /* restore the completion order */
 
-    ngx_memory_barrier();
+    task = NULL;
 
-    ngx_unlock(&ngx_thread_pool_done_lock);
+    while (head) {
+        next = (ngx_thread_task_t *) head;
+        head = (ngx_atomic_uint_t) next->next;
+
+        next->next = task;
+        task = next;
+    }
 
     while (task) {
         ngx_log_debug1(NGX_LOG_DEBUG_CORE, ev->log, 0,
@@ -502,6 +854,11 @@ ngx_thread_pool(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
             continue;
         }
+
+        if (ngx_strcmp(value[i].data, "steal") == 0) {
+            tp->steal = 1;
+            continue;
+        }
     }
 
     if (tp->threads == 0) {
@@ -554,6 +911,13 @@ ngx_thread_pool_add(ngx_conf_t *cf, ngx_str_t *name)
 }
 
 
+ngx_thread_pool_stats_t *
+ngx_thread_pool_stats(ngx_thread_pool_t *tp)
+{
+    return &tp->stats;
+}
+
+
 ngx_thread_pool_t *
 ngx_thread_pool_get(ngx_cycle_t *cycle, ngx_str_t *name)
 {
@@ -599,7 +963,7 @@ ngx_thread_pool_init_worker(ngx_cycle_t *cycle)
         return NGX_OK;
     }
 
-    ngx_thread_pool_queue_init(&ngx_thread_pool_done);
+    ngx_thread_pool_done = 0;
 
     tpp = tcf->pools.elts;
 
@@ -20,14 +20,26 @@ struct ngx_thread_task_s {
     void                *ctx;
     void               (*handler)(void *data, ngx_log_t *log);
     ngx_event_t          event;
+    uint64_t             posted;
 };
 
 
 typedef struct ngx_thread_pool_s  ngx_thread_pool_t;
 
 
+typedef struct {
+    ngx_atomic_t         queued;
+    ngx_atomic_t         max_queued;
+    ngx_atomic_t         tasks;
+    ngx_atomic_t         wait;        /* usec */
+    ngx_atomic_t         max_wait;    /* usec */
+    ngx_atomic_t         stolen;
+} ngx_thread_pool_stats_t;
+
+
 ngx_thread_pool_t *ngx_thread_pool_add(ngx_conf_t *cf, ngx_str_t *name);
 ngx_thread_pool_t *ngx_thread_pool_get(ngx_cycle_t *cycle, ngx_str_t *name);
+ngx_thread_pool_stats_t *ngx_thread_pool_stats(ngx_thread_pool_t *tp);
 
 ngx_thread_task_t *ngx_thread_task_alloc(ngx_pool_t *pool, size_t size);
 ngx_int_t ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task);
@@ -213,6 +213,33 @@ ngx_monotonic_time(time_t sec, ngx_uint_t msec)
 }
 
 
+uint64_t
+ngx_monotonic_usec(void)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+    struct timespec  ts;
+
+    /*
+     * CLOCK_MONOTONIC is read without a system call using vDSO on Linux
+     * and the shared timekeeping page on FreeBSD, that is, the TSC
+     * on x86; the coarse clocks are updated only once per tick
+     */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+#else
+    struct timeval   tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+
+#endif
+}
+
+
 #if !(NGX_WIN32)
 
 void
@@ -48,5 +48,12 @@ extern volatile ngx_str_t    ngx_cached_syslog_time;
  */
 extern volatile ngx_msec_t  ngx_current_msec;
 
+/*
+ * microseconds elapsed since some unspecified point in the past, read
+ * from the clock on each call; the cached values above are to be used
+ * unless the precision is required
+ */
+uint64_t ngx_monotonic_usec(void);
+
 
 #endif /* _NGX_TIMES_H_INCLUDED_ */
@@ -95,9 +95,28 @@ struct io_event {
 #endif /* NGX_TEST_BUILD_EPOLL */
 
 
+#if (NGX_HAVE_SO_BUSY_POLL && !NGX_HAVE_EPIOCSPARAMS)
+
+/* the ioctl appeared in Linux 6.9, its ABI is stable */
+
+struct epoll_params {
+    uint32_t  busy_poll_usecs;
+    uint16_t  busy_poll_budget;
+    uint8_t   prefer_busy_poll;
+    uint8_t   __pad;
+};
+
+#define EPIOCSPARAMS  _IOW(0x8A, 0x01, struct epoll_params)
+
+#endif
+
+
 typedef struct {
     ngx_uint_t  events;
     ngx_uint_t  aio_requests;
+    ngx_uint_t  busy_poll;
+    ngx_uint_t  busy_poll_budget;
+    ngx_uint_t  prefer_busy_poll;
 } ngx_epoll_conf_t;
 
 
@@ -110,6 +129,10 @@ static void ngx_epoll_notify_handler(ngx_event_t *ev);
 static void ngx_epoll_test_rdhup(ngx_cycle_t *cycle);
 #endif
 static void ngx_epoll_done(ngx_cycle_t *cycle);
+#if (NGX_HAVE_SO_BUSY_POLL)
+static void ngx_epoll_busy_poll_init(ngx_cycle_t *cycle,
+    ngx_epoll_conf_t *epcf);
+#endif
 static ngx_int_t ngx_epoll_add_event(ngx_event_t *ev, ngx_int_t event,
     ngx_uint_t flags);
 static ngx_int_t ngx_epoll_del_event(ngx_event_t *ev, ngx_int_t event,
@@ -127,8 +150,11 @@ static ngx_int_t ngx_epoll_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
 static void ngx_epoll_eventfd_handler(ngx_event_t *ev);
 #endif
 
+static ngx_int_t ngx_epoll_module_init(ngx_cycle_t *cycle);
 static void *ngx_epoll_create_conf(ngx_cycle_t *cycle);
 static char *ngx_epoll_init_conf(ngx_cycle_t *cycle, void *conf);
+static char *ngx_epoll_busy_poll(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 static int                  ep = -1;
 static struct epoll_event  *event_list;
@@ -172,6 +198,13 @@ static ngx_command_t  ngx_epoll_commands[] = {
       offsetof(ngx_epoll_conf_t, aio_requests),
       NULL },
 
+    { ngx_string("epoll_busy_poll"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE123,
+      ngx_epoll_busy_poll,
+      0,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -205,7 +238,7 @@ ngx_module_t  ngx_epoll_module = {
     ngx_epoll_commands,                  /* module directives */
     NGX_EVENT_MODULE,                    /* module type */
     NULL,                                /* init master */
-    NULL,                                /* init module */
+    ngx_epoll_module_init,               /* init module */
     NULL,                                /* init process */
     NULL,                                /* init thread */
     NULL,                                /* exit thread */
@@ -348,6 +381,12 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
 #if (NGX_HAVE_EPOLLRDHUP)
         ngx_epoll_test_rdhup(cycle);
 #endif
+
+#if (NGX_HAVE_SO_BUSY_POLL)
+        if (epcf->busy_poll) {
+            ngx_epoll_busy_poll_init(cycle, epcf);
+        }
+#endif
     }
 
     if (nevents < epcf->events) {
@@ -380,6 +419,42 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
 }
 
 
+#if (NGX_HAVE_SO_BUSY_POLL)
+
+static void
+ngx_epoll_busy_poll_init(ngx_cycle_t *cycle, ngx_epoll_conf_t *epcf)
+{
+    struct epoll_params  params;
+
+    ngx_memzero(&params, sizeof(struct epoll_params));
+
+    params.busy_poll_usecs = (uint32_t) epcf->busy_poll;
+    params.busy_poll_budget = (uint16_t) epcf->busy_poll_budget;
+    params.prefer_busy_poll = (uint8_t) epcf->prefer_busy_poll;
+
+    if (ioctl(ep, EPIOCSPARAMS, &params) == -1) {
+
+        /*
+         * before Linux 6.9 epoll_wait() busy polls
+         * according to the net.core.busy_poll sysctl only
+         */
+
+        ngx_log_error(NGX_LOG_NOTICE, cycle->log, ngx_errno,
+                      "ioctl(EPIOCSPARAMS) failed, "
+                      "epoll busy polling is controlled "
+                      "by the net.core.busy_poll sysctl");
+        return;
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "epoll busy poll: %ui usec, budget:%ui, prefer:%ui",
+                   epcf->busy_poll, epcf->busy_poll_budget,
+                   epcf->prefer_busy_poll);
+}
+
+#endif
+
+
 #if (NGX_HAVE_EVENTFD)
 
 static ngx_int_t
@@ -1022,6 +1097,77 @@ ngx_epoll_eventfd_handler(ngx_event_t *ev)
 #endif
 
 
+static ngx_int_t
+ngx_epoll_module_init(ngx_cycle_t *cycle)
+{
+#if (NGX_HAVE_SO_BUSY_POLL)
+    int                i;
+    ngx_uint_t         n;
+    ngx_listening_t   *ls;
+    ngx_event_conf_t  *ecf;
+    ngx_epoll_conf_t  *epcf;
+
+    ecf = ngx_event_get_conf(cycle->conf_ctx, ngx_event_core_module);
+    epcf = ngx_event_get_conf(cycle->conf_ctx, ngx_epoll_module);
+
+    if (ecf->use != ngx_epoll_module.ctx_index || epcf->busy_poll == 0) {
+        return NGX_OK;
+    }
+
+    /*
+     * the options are set in the master process as increasing them
+     * over the sysctl values requires CAP_NET_ADMIN,
+     * accepted sockets inherit them from listening ones
+     */
+
+    ls = cycle->listening.elts;
+    for (n = 0; n < cycle->listening.nelts; n++) {
+
+        if (ls[n].fd == (ngx_socket_t) -1) {
+            continue;
+        }
+
+        i = (int) epcf->busy_poll;
+
+        if (setsockopt(ls[n].fd, SOL_SOCKET, SO_BUSY_POLL,
+                       (const void *) &i, sizeof(int))
+            == -1)
+        {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                          "setsockopt(SO_BUSY_POLL, %d) %V failed, ignored",
+                          i, &ls[n].addr_text);
+            continue;
+        }
+
+        i = (int) epcf->busy_poll_budget;
+
+        if (setsockopt(ls[n].fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET,
+                       (const void *) &i, sizeof(int))
+            == -1)
+        {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                          "setsockopt(SO_BUSY_POLL_BUDGET, %d) %V failed, "
+                          "ignored", i, &ls[n].addr_text);
+        }
+
+        i = (int) epcf->prefer_busy_poll;
+
+        if (setsockopt(ls[n].fd, SOL_SOCKET, SO_PREFER_BUSY_POLL,
+                       (const void *) &i, sizeof(int))
+            == -1)
+        {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                          "setsockopt(SO_PREFER_BUSY_POLL, %d) %V failed, "
+                          "ignored", i, &ls[n].addr_text);
+        }
+    }
+
+#endif
+
+    return NGX_OK;
+}
+
+
 static void *
 ngx_epoll_create_conf(ngx_cycle_t *cycle)
 {
@@ -1034,6 +1180,9 @@ ngx_epoll_create_conf(ngx_cycle_t *cycle)
 
     epcf->events = NGX_CONF_UNSET;
     epcf->aio_requests = NGX_CONF_UNSET;
+    epcf->busy_poll = NGX_CONF_UNSET_UINT;
+    epcf->busy_poll_budget = NGX_CONF_UNSET_UINT;
+    epcf->prefer_busy_poll = NGX_CONF_UNSET_UINT;
 
     return epcf;
 }
@@ -1046,6 +1195,88 @@ ngx_epoll_init_conf(ngx_cycle_t *cycle, void *conf)
 
     ngx_conf_init_uint_value(epcf->events, 512);
     ngx_conf_init_uint_value(epcf->aio_requests, 32);
+    ngx_conf_init_uint_value(epcf->busy_poll, 0);
+    ngx_conf_init_uint_value(epcf->busy_poll_budget, 8);
+    ngx_conf_init_uint_value(epcf->prefer_busy_poll, 0);
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_epoll_busy_poll(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+#if (NGX_HAVE_SO_BUSY_POLL)
+    ngx_epoll_conf_t *epcf = conf;
+
+    ngx_int_t    n;
+    ngx_str_t   *value;
+    ngx_uint_t   i;
+
+    if (epcf->busy_poll != NGX_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts > 2) {
+            return "has invalid parameters";
+        }
+
+        epcf->busy_poll = 0;
+        return NGX_CONF_OK;
+    }
+
+    n = ngx_atoi(value[1].data, value[1].len);
+
+    if (n == NGX_ERROR || n == 0 || n > 0x7fffffff) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid busy poll time \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    epcf->busy_poll = n;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "budget=", 7) == 0) {
+
+            n = ngx_atoi(value[i].data + 7, value[i].len - 7);
+
+            if (n == NGX_ERROR || n == 0 || n > 0xffff) {
+                goto invalid;
+            }
+
+            epcf->busy_poll_budget = n;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "prefer") == 0) {
+            epcf->prefer_busy_poll = 1;
+            continue;
+        }
+
+        goto invalid;
+    }
 
     return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+
+#else
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "\"epoll_busy_poll\" is not supported "
+                       "on this platform");
+
+    return NGX_CONF_ERROR;
+
+#endif
 }
@@ -0,0 +1,1015 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * The module keeps the readiness model used by the rest of nginx:
+ * for every active event a poll request is armed in the ring, and
+ * the ngx_os_io handlers do the actual I/O once the event is ready.
+ * Poll arming, cancellation and file AIO reads are queued in the
+ * submission ring and passed to the kernel in a single io_uring_enter()
+ * call together with waiting for completions.
+ *
+ * The low bits of the completion user data are used as follows:
+ * bit 0 holds the event instance, bits 1 and 2 keep the request type.
+ */
+
+#define NGX_IO_URING_POLL         0
+#define NGX_IO_URING_AIO          2
+#define NGX_IO_URING_NOTIFY       4
+
+#define NGX_IO_URING_TYPE_MASK    6
+
+
+typedef struct {
+    ngx_uint_t               entries;
+    ngx_uint_t               events;
+} ngx_io_uring_conf_t;
+
+
+typedef struct {
+    void                    *sq_ring;
+    size_t                   sq_ring_size;
+    void                    *cq_ring;
+    size_t                   cq_ring_size;
+
+    struct io_uring_sqe     *sqes;
+    size_t                   sqes_size;
+
+    uint32_t                *sq_head;
+    uint32_t                *sq_tail;
+    uint32_t                 sq_mask;
+    uint32_t                 sq_entries;
+    uint32_t                 sqe_tail;
+
+    uint32_t                *cq_head;
+    uint32_t                *cq_tail;
+    uint32_t                 cq_mask;
+    struct io_uring_cqe     *cqes;
+} ngx_io_uring_t;
+
+
+static ngx_int_t ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer);
+static ngx_int_t ngx_io_uring_setup(ngx_cycle_t *cycle,
+    ngx_io_uring_conf_t *urcf);
+static void ngx_io_uring_unmap(void);
+#if (NGX_HAVE_EVENTFD)
+static ngx_int_t ngx_io_uring_notify_init(ngx_log_t *log);
+static ngx_int_t ngx_io_uring_arm_notify(ngx_log_t *log);
+static void ngx_io_uring_notify_handler(ngx_event_t *ev);
+#endif
+static void ngx_io_uring_done(ngx_cycle_t *cycle);
+static struct io_uring_sqe *ngx_io_uring_get_sqe(ngx_log_t *log);
+static ngx_int_t ngx_io_uring_submit(ngx_log_t *log);
+static ngx_int_t ngx_io_uring_arm(ngx_event_t *ev, uint64_t data,
+    ngx_uint_t level);
+static ngx_int_t ngx_io_uring_cancel(ngx_event_t *ev);
+static ngx_int_t ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+#if (NGX_HAVE_EVENTFD)
+static ngx_int_t ngx_io_uring_notify(ngx_event_handler_pt handler);
+#endif
+static ngx_int_t ngx_io_uring_process_events(ngx_cycle_t *cycle,
+    ngx_msec_t timer, ngx_uint_t flags);
+static void ngx_io_uring_process_poll(ngx_cycle_t *cycle,
+    struct io_uring_cqe *cqe, ngx_uint_t flags);
+#if (NGX_HAVE_FILE_AIO)
+static void ngx_io_uring_process_aio(ngx_cycle_t *cycle,
+    struct io_uring_cqe *cqe);
+#endif
+
+static void *ngx_io_uring_create_conf(ngx_cycle_t *cycle);
+static char *ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf);
+
+
+static int                  ring_fd = -1;
+static ngx_io_uring_t       ring;
+
+#if (NGX_HAVE_EVENTFD)
+static int                  notify_fd = -1;
+static ngx_event_t          notify_event;
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+ngx_uint_t                  ngx_io_uring_aio;
+#endif
+
+static ngx_str_t      io_uring_name = ngx_string("io_uring");
+
+static ngx_command_t  ngx_io_uring_commands[] = {
+
+    { ngx_string("io_uring_entries"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_io_uring_conf_t, entries),
+      NULL },
+
+    { ngx_string("io_uring_events"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_io_uring_conf_t, events),
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_event_module_t  ngx_io_uring_module_ctx = {
+    &io_uring_name,
+    ngx_io_uring_create_conf,            /* create configuration */
+    ngx_io_uring_init_conf,              /* init configuration */
+
+    {
+        ngx_io_uring_add_event,          /* add an event */
+        ngx_io_uring_del_event,          /* delete an event */
+        ngx_io_uring_add_event,          /* enable an event */
+        ngx_io_uring_del_event,          /* disable an event */
+        NULL,                            /* add an connection */
+        NULL,                            /* delete an connection */
+#if (NGX_HAVE_EVENTFD)
+        ngx_io_uring_notify,             /* trigger a notify */
+#else
+        NULL,                            /* trigger a notify */
+#endif
+        ngx_io_uring_process_events,     /* process the events */
+        ngx_io_uring_init,               /* init the events */
+        ngx_io_uring_done,               /* done the events */
+    }
+};
+
+ngx_module_t  ngx_io_uring_module = {
+    NGX_MODULE_V1,
+    &ngx_io_uring_module_ctx,            /* module context */
+    ngx_io_uring_commands,               /* module directives */
+    NGX_EVENT_MODULE,                    /* module type */
+    NULL,                                /* init master */
+    NULL,                                /* init module */
+    NULL,                                /* init process */
+    NULL,                                /* init thread */
+    NULL,                                /* exit thread */
+    NULL,                                /* exit process */
+    NULL,                                /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * We call io_uring_setup() and io_uring_enter() directly as syscalls
+ * instead of liburing usage to avoid an external dependency.
+ */
+
+static int
+io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(SYS_io_uring_setup, entries, p);
+}
+
+
+static int
+io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags, void *arg, size_t argsz)
+{
+    return syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+
+static ngx_int_t
+ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer)
+{
+    ngx_io_uring_conf_t  *urcf;
+
+    urcf = ngx_event_get_conf(cycle->conf_ctx, ngx_io_uring_module);
+
+    if (ring_fd == -1) {
+        if (ngx_io_uring_setup(cycle, urcf) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+#if (NGX_HAVE_EVENTFD)
+        if (ngx_io_uring_notify_init(cycle->log) != NGX_OK) {
+            ngx_io_uring_module_ctx.actions.notify = NULL;
+        }
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+        ngx_io_uring_aio = 1;
+#endif
+    }
+
+    ngx_io = ngx_os_io;
+
+    ngx_event_actions = ngx_io_uring_module_ctx.actions;
+
+    ngx_event_flags = NGX_USE_CLEAR_EVENT
+                      |NGX_USE_GREEDY_EVENT;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_setup(ngx_cycle_t *cycle, ngx_io_uring_conf_t *urcf)
+{
+    u_char                  *p;
+    uint32_t                 i, *array;
+    struct io_uring_params   params;
+
+    ngx_memzero(&params, sizeof(struct io_uring_params));
+
+    params.flags = IORING_SETUP_CQSIZE|IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = urcf->events;
+
+    ring_fd = io_uring_setup(urcf->entries, &params);
+
+    if (ring_fd == -1 && ngx_errno == NGX_EINVAL) {
+
+        /* IORING_SETUP_COOP_TASKRUN appeared in Linux 5.19 */
+
+        params.flags &= ~IORING_SETUP_COOP_TASKRUN;
+
+        ring_fd = io_uring_setup(urcf->entries, &params);
+    }
+
+    if (ring_fd == -1) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                      "io_uring_setup() failed");
+        return NGX_ERROR;
+    }
+
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "io_uring does not support IORING_FEAT_EXT_ARG");
+        goto failed;
+    }
+
+    ring.sq_ring_size = params.sq_off.array
+                        + params.sq_entries * sizeof(uint32_t);
+    ring.cq_ring_size = params.cq_off.cqes
+                        + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring.sq_ring_size = ngx_max(ring.sq_ring_size, ring.cq_ring_size);
+        ring.cq_ring_size = 0;
+    }
+
+    ring.sq_ring = mmap(NULL, ring.sq_ring_size, PROT_READ|PROT_WRITE,
+                        MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+
+    if (ring.sq_ring == MAP_FAILED) {
+        ring.sq_ring = NULL;
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                      "mmap(IORING_OFF_SQ_RING) failed");
+        goto failed;
+    }
+
+    if (ring.cq_ring_size) {
+        ring.cq_ring = mmap(NULL, ring.cq_ring_size, PROT_READ|PROT_WRITE,
+                            MAP_SHARED|MAP_POPULATE, ring_fd,
+                            IORING_OFF_CQ_RING);
+
+        if (ring.cq_ring == MAP_FAILED) {
+            ring.cq_ring = NULL;
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "mmap(IORING_OFF_CQ_RING) failed");
+            goto failed;
+        }
+
+    } else {
+        ring.cq_ring = ring.sq_ring;
+    }
+
+    ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring.sqes = mmap(NULL, ring.sqes_size, PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+    if (ring.sqes == MAP_FAILED) {
+        ring.sqes = NULL;
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                      "mmap(IORING_OFF_SQES) failed");
+        goto failed;
+    }
+
+    p = ring.sq_ring;
+
+    ring.sq_head = (uint32_t *) (p + params.sq_off.head);
+    ring.sq_tail = (uint32_t *) (p + params.sq_off.tail);
+    ring.sq_mask = *(uint32_t *) (p + params.sq_off.ring_mask);
+    ring.sq_entries = params.sq_entries;
+    ring.sqe_tail = *ring.sq_tail;
+
+    array = (uint32_t *) (p + params.sq_off.array);
+
+    for (i = 0; i < params.sq_entries; i++) {
+        array[i] = i;
+    }
+
+    p = ring.cq_ring;
+
+    ring.cq_head = (uint32_t *) (p + params.cq_off.head);
+    ring.cq_tail = (uint32_t *) (p + params.cq_off.tail);
+    ring.cq_mask = *(uint32_t *) (p + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *) (p + params.cq_off.cqes);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring: fd:%d sq:%uD cq:%uD",
+                   ring_fd, params.sq_entries, params.cq_entries);
+
+    return NGX_OK;
+
+failed:
+
+    ngx_io_uring_unmap();
+
+    if (close(ring_fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ring_fd = -1;
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_io_uring_unmap(void)
+{
+    if (ring.sqes) {
+        (void) munmap(ring.sqes, ring.sqes_size);
+        ring.sqes = NULL;
+    }
+
+    if (ring.cq_ring && ring.cq_ring != ring.sq_ring) {
+        (void) munmap(ring.cq_ring, ring.cq_ring_size);
+    }
+
+    ring.cq_ring = NULL;
+
+    if (ring.sq_ring) {
+        (void) munmap(ring.sq_ring, ring.sq_ring_size);
+        ring.sq_ring = NULL;
+    }
+}
+
+
+#if (NGX_HAVE_EVENTFD)
+
+static ngx_int_t
+ngx_io_uring_notify_init(ngx_log_t *log)
+{
+#if (NGX_HAVE_SYS_EVENTFD_H)
+    notify_fd = eventfd(0, 0);
+#else
+    notify_fd = syscall(SYS_eventfd, 0);
+#endif
+
+    if (notify_fd == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno, "eventfd() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "notify eventfd: %d", notify_fd);
+
+    notify_event.handler = ngx_io_uring_notify_handler;
+    notify_event.log = log;
+    notify_event.active = 1;
+
+    if (ngx_io_uring_arm_notify(log) == NGX_OK
+        && ngx_io_uring_submit(log) == NGX_OK)
+    {
+        return NGX_OK;
+    }
+
+    if (close(notify_fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "eventfd close() failed");
+    }
+
+    notify_fd = -1;
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_io_uring_arm_notify(ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = notify_fd;
+    sqe->poll32_events = EPOLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = (uintptr_t) &notify_event | NGX_IO_URING_NOTIFY;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_io_uring_notify_handler(ngx_event_t *ev)
+{
+    ssize_t               n;
+    uint64_t              count;
+    ngx_err_t             err;
+    ngx_event_handler_pt  handler;
+
+    if (++ev->index == NGX_MAX_UINT32_VALUE) {
+        ev->index = 0;
+
+        n = read(notify_fd, &count, sizeof(uint64_t));
+
+        err = ngx_errno;
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "read() eventfd %d: %z count:%uL", notify_fd, n, count);
+
+        if ((size_t) n != sizeof(uint64_t)) {
+            ngx_log_error(NGX_LOG_ALERT, ev->log, err,
+                          "read() eventfd %d failed", notify_fd);
+        }
+    }
+
+    handler = ev->data;
+    handler(ev);
+}
+
+#endif
+
+
+static void
+ngx_io_uring_done(ngx_cycle_t *cycle)
+{
+    ngx_io_uring_unmap();
+
+    if (close(ring_fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ring_fd = -1;
+
+#if (NGX_HAVE_EVENTFD)
+
+    if (notify_fd != -1) {
+        if (close(notify_fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "eventfd close() failed");
+        }
+
+        notify_fd = -1;
+    }
+
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+    ngx_io_uring_aio = 0;
+#endif
+}
+
+
+static struct io_uring_sqe *
+ngx_io_uring_get_sqe(ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    if (ring.sqe_tail - *ring.sq_head >= ring.sq_entries) {
+
+        /* the submission queue is full, pass it to the kernel */
+
+        if (ngx_io_uring_submit(log) != NGX_OK) {
+            return NULL;
+        }
+
+        if (ring.sqe_tail - *ring.sq_head >= ring.sq_entries) {
+            ngx_log_error(NGX_LOG_ALERT, log, 0,
+                          "io_uring submission queue overflow");
+            return NULL;
+        }
+    }
+
+    sqe = &ring.sqes[ring.sqe_tail & ring.sq_mask];
+    ring.sqe_tail++;
+
+    ngx_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    return sqe;
+}
+
+
+static ngx_int_t
+ngx_io_uring_submit(ngx_log_t *log)
+{
+    int        n;
+    uint32_t   pending;
+    ngx_err_t  err;
+
+    ngx_memory_barrier();
+
+    *ring.sq_tail = ring.sqe_tail;
+
+    pending = ring.sqe_tail - *ring.sq_head;
+
+    while (pending) {
+        n = io_uring_enter(ring_fd, pending, 0, 0, NULL, 0);
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            if (err == NGX_EAGAIN || err == NGX_EBUSY) {
+
+                /* the completion queue is backed up, retry later */
+
+                return NGX_OK;
+            }
+
+            ngx_log_error(NGX_LOG_ALERT, log, err, "io_uring_enter() failed");
+            return NGX_ERROR;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                       "io_uring submit: %d", n);
+
+        if (n == 0) {
+            break;
+        }
+
+        pending -= n;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_arm(ngx_event_t *ev, uint64_t data, ngx_uint_t level)
+{
+    ngx_connection_t     *c;
+    struct io_uring_sqe  *sqe;
+
+    c = ev->data;
+
+    sqe = ngx_io_uring_get_sqe(ev->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = c->fd;
+    sqe->poll32_events = ev->write ? EPOLLOUT : EPOLLIN|EPOLLRDHUP;
+    sqe->user_data = data;
+
+    /*
+     * edge-triggered events are armed once as multishot polls,
+     * level-triggered ones are rearmed as oneshot polls after
+     * every completion, as multishot polls are not reliably
+     * retriggered while the condition holds
+     */
+
+    if (!level) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring poll add: fd:%d ev:%08XD lvl:%ui",
+                   c->fd, sqe->poll32_events, level);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_cancel(ngx_event_t *ev)
+{
+    struct io_uring_sqe  *sqe;
+
+    /*
+     * io_uring keeps a reference to the file while poll is armed,
+     * so unlike epoll the poll must be removed explicitly even
+     * if the descriptor is going to be closed; the cancellation
+     * matches by user data, hence it is safe to queue it
+     */
+
+    sqe = ngx_io_uring_get_sqe(ev->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uintptr_t) ev | ev->instance;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = 0;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring poll cancel: %p", ev);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    ngx_uint_t  level;
+
+    if (ev->active) {
+        return NGX_OK;
+    }
+
+    level = (flags & NGX_CLEAR_EVENT) ? 0 : 1;
+
+    if (ngx_io_uring_arm(ev, (uintptr_t) ev | ev->instance, level)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ev->active = 1;
+    ev->oneshot = level;
+
+    if (flags & NGX_FLUSH_EVENT) {
+        return ngx_io_uring_submit(ev->log);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    if (!ev->active) {
+        return NGX_OK;
+    }
+
+    if (ngx_io_uring_cancel(ev) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ev->active = 0;
+    ev->oneshot = 0;
+
+    return NGX_OK;
+}
+
+
+#if (NGX_HAVE_EVENTFD)
+
+static ngx_int_t
+ngx_io_uring_notify(ngx_event_handler_pt handler)
+{
+    static uint64_t inc = 1;
+
+    notify_event.data = handler;
+
+    if ((size_t) write(notify_fd, &inc, sizeof(uint64_t)) != sizeof(uint64_t)) {
+        ngx_log_error(NGX_LOG_ALERT, notify_event.log, ngx_errno,
+                      "write() to eventfd %d failed", notify_fd);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_io_uring_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
+    ngx_uint_t flags)
+{
+    int                             n;
+    uint32_t                        head, tail, pending;
+    uint64_t                        data;
+    ngx_err_t                       err;
+    ngx_uint_t                      i, level, events;
+    struct __kernel_timespec        ts;
+    struct io_uring_cqe            *cqe;
+    struct io_uring_getevents_arg   arg;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring timer: %M", timer);
+
+    ngx_memzero(&arg, sizeof(struct io_uring_getevents_arg));
+
+    if (timer != NGX_TIMER_INFINITE) {
+        ts.tv_sec = timer / 1000;
+        ts.tv_nsec = (timer % 1000) * 1000000;
+        arg.ts = (uintptr_t) &ts;
+    }
+
+    ngx_memory_barrier();
+
+    *ring.sq_tail = ring.sqe_tail;
+
+    pending = ring.sqe_tail - *ring.sq_head;
+
+    /* submit the queued requests and wait for completions at once */
+
+    n = io_uring_enter(ring_fd, pending, 1,
+                       IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG,
+                       &arg, sizeof(struct io_uring_getevents_arg));
+
+    err = (n == -1) ? ngx_errno : 0;
+
+    if (flags & NGX_UPDATE_TIME || ngx_event_timer_alarm) {
+        ngx_time_update();
+    }
+
+    if (err && err != ETIME && err != NGX_EBUSY) {
+        if (err == NGX_EINTR) {
+
+            if (ngx_event_timer_alarm) {
+                ngx_event_timer_alarm = 0;
+                return NGX_OK;
+            }
+
+            level = NGX_LOG_INFO;
+
+        } else {
+            level = NGX_LOG_ALERT;
+        }
+
+        ngx_log_error(level, cycle->log, err, "io_uring_enter() failed");
+        return NGX_ERROR;
+    }
+
+    head = *ring.cq_head;
+    tail = *ring.cq_tail;
+
+    ngx_memory_barrier();
+
+    events = tail - head;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring: submitted:%d completed:%ui", n, events);
+
+    if (events == 0) {
+        if (timer != NGX_TIMER_INFINITE || err == NGX_EBUSY) {
+            return NGX_OK;
+        }
+
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, 0,
+                      "io_uring_enter() returned no events without timeout");
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < events; i++) {
+        cqe = &ring.cqes[(head + i) & ring.cq_mask];
+
+        data = cqe->user_data;
+
+        switch (data & NGX_IO_URING_TYPE_MASK) {
+
+        case NGX_IO_URING_POLL:
+
+            if (data == 0) {
+                /* completion of the cancellation request */
+                continue;
+            }
+
+            ngx_io_uring_process_poll(cycle, cqe, flags);
+            continue;
+
+#if (NGX_HAVE_FILE_AIO)
+        case NGX_IO_URING_AIO:
+            ngx_io_uring_process_aio(cycle, cqe);
+            continue;
+#endif
+
+#if (NGX_HAVE_EVENTFD)
+        case NGX_IO_URING_NOTIFY:
+
+            if (cqe->res < 0) {
+                ngx_log_error(NGX_LOG_ALERT, cycle->log, -cqe->res,
+                              "io_uring eventfd poll failed");
+                continue;
+            }
+
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                (void) ngx_io_uring_arm_notify(cycle->log);
+            }
+
+            notify_event.handler(&notify_event);
+            continue;
+#endif
+
+        default:
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, 0,
+                          "unexpected io_uring completion %uL", data);
+            continue;
+        }
+    }
+
+    ngx_memory_barrier();
+
+    *ring.cq_head = head + events;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_io_uring_process_poll(ngx_cycle_t *cycle, struct io_uring_cqe *cqe,
+    ngx_uint_t flags)
+{
+    uint32_t           revents;
+    ngx_int_t          instance;
+    ngx_event_t       *ev;
+    ngx_queue_t       *queue;
+    ngx_connection_t  *c;
+
+    ev = (ngx_event_t *) (uintptr_t) cqe->user_data;
+
+    instance = (uintptr_t) ev & 1;
+    ev = (ngx_event_t *) ((uintptr_t) ev & (uintptr_t) ~1);
+
+    c = ev->data;
+
+    if (cqe->res == -NGX_ECANCELED) {
+        return;
+    }
+
+    if (c->fd == -1 || ev->instance != instance || !ev->active) {
+
+        /*
+         * the stale event from a file descriptor
+         * that was just closed or deleted in this iteration
+         */
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: stale event %p", ev);
+        return;
+    }
+
+    if (cqe->res < 0) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, -cqe->res,
+                      "io_uring poll on fd:%d failed", c->fd);
+
+        ev->active = 0;
+        ev->oneshot = 0;
+
+        revents = EPOLLERR;
+
+    } else {
+        revents = cqe->res;
+
+        if (ev->oneshot || !(cqe->flags & IORING_CQE_F_MORE)) {
+
+            /* the poll was completed, arm it again */
+
+            if (ngx_io_uring_arm(ev, cqe->user_data, ev->oneshot) != NGX_OK) {
+                ev->active = 0;
+                ev->oneshot = 0;
+            }
+        }
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring: fd:%d ev:%04XD d:%p",
+                   c->fd, revents, cqe->user_data);
+
+    if (ev->write) {
+        ev->ready = 1;
+#if (NGX_THREADS)
+        ev->complete = 1;
+#endif
+
+        if (flags & NGX_POST_EVENTS) {
+            ngx_post_event(ev, &ngx_posted_events);
+
+        } else {
+            ev->handler(ev);
+        }
+
+        return;
+    }
+
+    if (revents & EPOLLRDHUP) {
+        ev->pending_eof = 1;
+    }
+
+    ev->ready = 1;
+    ev->available = -1;
+
+    if (flags & NGX_POST_EVENTS) {
+        queue = ev->accept ? &ngx_posted_accept_events
+                           : &ngx_posted_events;
+
+        ngx_post_event(ev, queue);
+
+    } else {
+        ev->handler(ev);
+    }
+}
+
+
+#if (NGX_HAVE_FILE_AIO)
+
+static void
+ngx_io_uring_process_aio(ngx_cycle_t *cycle, struct io_uring_cqe *cqe)
+{
+    ngx_event_t      *e;
+    ngx_event_aio_t  *aio;
+
+    e = (ngx_event_t *) (uintptr_t) (cqe->user_data
+                                     & ~(uint64_t) NGX_IO_URING_TYPE_MASK);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring aio: %p res:%d", e, cqe->res);
+
+    e->complete = 1;
+    e->active = 0;
+    e->ready = 1;
+
+    aio = e->data;
+    aio->res = cqe->res;
+
+    ngx_post_event(e, &ngx_posted_events);
+}
+
+
+ngx_int_t
+ngx_io_uring_aio_read(ngx_event_aio_t *aio, u_char *buf, size_t size,
+    off_t offset)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(aio->event.log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = aio->fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = (uintptr_t) &aio->event | NGX_IO_URING_AIO;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, aio->event.log, 0,
+                   "io_uring read: fd:%d @%O:%uz", aio->fd, offset, size);
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static void *
+ngx_io_uring_create_conf(ngx_cycle_t *cycle)
+{
+    ngx_io_uring_conf_t  *urcf;
+
+    urcf = ngx_palloc(cycle->pool, sizeof(ngx_io_uring_conf_t));
+    if (urcf == NULL) {
+        return NULL;
+    }
+
+    urcf->entries = NGX_CONF_UNSET;
+    urcf->events = NGX_CONF_UNSET;
+
+    return urcf;
+}
+
+
+static char *
+ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_io_uring_conf_t *urcf = conf;
+
+    ngx_conf_init_uint_value(urcf->entries, 1024);
+    ngx_conf_init_uint_value(urcf->events, 4 * urcf->entries);
+
+    if (urcf->events < urcf->entries) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "\"io_uring_events\" must not be less "
+                      "than \"io_uring_entries\"");
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
@@ -30,6 +30,9 @@ static char *ngx_event_connections(ngx_conf_t *cf, ngx_command_t *cmd,
 static char *ngx_event_use(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 static char *ngx_event_debug_connection(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static void ngx_event_slab_defrag_handler(ngx_event_t *ev);
+static char *ngx_event_set_loop_stats(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 static void *ngx_event_core_create_conf(ngx_cycle_t *cycle);
 static char *ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf);
@@ -40,6 +43,9 @@ sig_atomic_t          ngx_event_timer_alarm;
 
 static ngx_uint_t     ngx_event_max_module;
 
+static ngx_event_t    ngx_event_slab_defrag;
+static ngx_msec_t     ngx_event_slab_defrag_interval;
+
 ngx_uint_t            ngx_event_flags;
 ngx_event_actions_t   ngx_event_actions;
 
@@ -118,6 +124,11 @@ ngx_module_t  ngx_events_module = {
 static ngx_str_t  event_core_name = ngx_string("event_core");
 
 
+static ngx_conf_num_bounds_t  ngx_event_udp_recv_batch_bounds = {
+    ngx_conf_check_num_bounds, 1, NGX_UDP_RECV_BATCH_MAX
+};
+
+
 static ngx_command_t  ngx_event_core_commands[] = {
 
     { ngx_string("worker_connections"),
@@ -155,6 +166,41 @@ static ngx_command_t  ngx_event_core_commands[] = {
       offsetof(ngx_event_conf_t, accept_mutex_delay),
       NULL },
 
+    { ngx_string("timer_wheel"),
+      NGX_EVENT_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      0,
+      offsetof(ngx_event_conf_t, timer_wheel),
+      NULL },
+
+    { ngx_string("udp_recv_batch"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_event_conf_t, udp_recv_batch),
+      &ngx_event_udp_recv_batch_bounds },
+
+    { ngx_string("low_priority_budget"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_event_conf_t, low_priority_budget),
+      NULL },
+
+    { ngx_string("slab_defrag"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      0,
+      offsetof(ngx_event_conf_t, slab_defrag),
+      NULL },
+
+    { ngx_string("loop_stats"),
+      NGX_EVENT_CONF|NGX_CONF_FLAG,
+      ngx_event_set_loop_stats,
+      0,
+      0,
+      NULL },
+
     { ngx_string("debug_connection"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_event_debug_connection,
@@ -194,6 +240,7 @@ ngx_module_t  ngx_event_core_module = {
 void
 ngx_process_events_and_timers(ngx_cycle_t *cycle)
 {
+    uint64_t    start;
     ngx_uint_t  flags;
     ngx_msec_t  timer, delta;
 
@@ -243,15 +290,40 @@ ngx_process_events_and_timers(ngx_cycle_t *cycle)
         timer = 0;
     }
 
+    if (ngx_posted_low_budget) {
+
+        /* the events of new connections are posted to be deferred */
+
+        flags |= NGX_POST_EVENTS;
+
+        if (!ngx_queue_empty(&ngx_posted_low_events)) {
+            timer = 0;
+        }
+    }
+
+    if (ngx_event_loop_stats) {
+
+        /* handlers are timed from the posted queues */
+
+        flags |= NGX_POST_EVENTS;
+        ngx_event_loop_nevents = 0;
+    }
+
+    ngx_probe1(event__loop__wait, timer);
+
     delta = ngx_current_msec;
 
     (void) ngx_process_events(cycle, timer, flags);
 
     delta = ngx_current_msec - delta;
 
+    ngx_probe1(event__loop__wakeup, delta);
+
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
                    "timer delta: %M", delta);
 
+    start = ngx_event_loop_stats ? ngx_event_stats_usec() : 0;
+
     ngx_event_process_posted(cycle, &ngx_posted_accept_events);
 
     if (ngx_accept_mutex_held) {
@@ -261,6 +333,23 @@ ngx_process_events_and_timers(ngx_cycle_t *cycle)
     ngx_event_expire_timers();
 
     ngx_event_process_posted(cycle, &ngx_posted_events);
+
+    if (ngx_posted_low_budget) {
+        ngx_event_process_posted_low(cycle);
+    }
+
+#if (NGX_QUIC && NGX_HAVE_SENDMMSG)
+    ngx_quic_flush_batch(cycle->log);
+#endif
+
+    if (ngx_event_loop_stats) {
+        ngx_event_histogram_add(&ngx_event_loop_stats->loop,
+                                ngx_event_stats_usec() - start);
+        ngx_event_histogram_add(&ngx_event_loop_stats->events,
+                                ngx_event_loop_nevents);
+    }
+
+    ngx_probe(event__loop__done);
 }
 
 
@@ -437,6 +526,7 @@ ngx_event_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_core_conf_t  *ccf;
     ngx_listening_t  *ls;
 #endif
+    ngx_event_conf_t  *ecf;
 
     if (ngx_get_conf(cycle->conf_ctx, ngx_events_module) == NULL) {
         ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
@@ -444,6 +534,12 @@ ngx_event_init_conf(ngx_cycle_t *cycle, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    ecf = ngx_event_get_conf(cycle->conf_ctx, ngx_event_core_module);
+
+    if (ecf->loop_stats) {
+        ngx_event_stats_init_conf(cycle, ecf->loop_stats);
+    }
+
     if (cycle->connection_n < cycle->listening.nelts + 1) {
 
         /*
@@ -570,6 +666,8 @@ ngx_event_module_init(ngx_cycle_t *cycle)
     shm.size = size;
     ngx_str_set(&shm.name, "nginx_shared_zone");
     shm.log = cycle->log;
+    shm.hugepages = 0;
+    shm.interleave = 0;
 
     if (ngx_shm_alloc(&shm) != NGX_OK) {
         return NGX_ERROR;
@@ -601,6 +699,14 @@ ngx_event_module_init(ngx_cycle_t *cycle)
 
     ngx_random_number = (tp->msec << 16) + ngx_pid;
 
+#if (NGX_HAVE_REUSEPORT && NGX_HAVE_INCOMING_CPU)
+
+    if (ngx_event_cpu_steer_init(cycle) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+#endif
+
 #if (NGX_STAT_STUB)
 
     ngx_stat_accepted = (ngx_atomic_t *) (shared + 3 * cl);
@@ -636,9 +742,9 @@ static ngx_int_t
 ngx_event_process_init(ngx_cycle_t *cycle)
 {
     ngx_uint_t           m, i;
-    ngx_event_t         *rev, *wev;
+    ngx_event_t         *rev;
     ngx_listening_t     *ls;
-    ngx_connection_t    *c, *next, *old;
+    ngx_connection_t    *c, *old;
     ngx_core_conf_t     *ccf;
     ngx_event_conf_t    *ecf;
     ngx_event_module_t  *module;
@@ -671,11 +777,34 @@ ngx_event_process_init(ngx_cycle_t *cycle)
     ngx_queue_init(&ngx_posted_accept_events);
     ngx_queue_init(&ngx_posted_next_events);
     ngx_queue_init(&ngx_posted_events);
+    ngx_queue_init(&ngx_posted_low_events);
+
+    ngx_posted_low_budget = ecf->low_priority_budget;
+
+    ngx_event_timer_wheel = ecf->timer_wheel;
+
+    ngx_event_stats_init_process(cycle, ecf->loop_stats);
 
     if (ngx_event_timer_init(cycle->log) == NGX_ERROR) {
         return NGX_ERROR;
     }
 
+    /* zones are defragmented by a single process */
+
+    if (ecf->slab_defrag
+        && (ngx_process == NGX_PROCESS_SINGLE
+            || (ngx_process == NGX_PROCESS_WORKER && ngx_worker == 0)))
+    {
+        ngx_event_slab_defrag_interval = ecf->slab_defrag;
+
+        ngx_event_slab_defrag.handler = ngx_event_slab_defrag_handler;
+        ngx_event_slab_defrag.log = cycle->log;
+        ngx_event_slab_defrag.data = cycle;
+        ngx_event_slab_defrag.cancelable = 1;
+
+        ngx_add_timer(&ngx_event_slab_defrag, ecf->slab_defrag);
+    }
+
     for (m = 0; cycle->modules[m]; m++) {
         if (cycle->modules[m]->type != NGX_EVENT_MODULE) {
             continue;
@@ -757,46 +886,26 @@ ngx_event_process_init(ngx_cycle_t *cycle)
         return NGX_ERROR;
     }
 
-    c = cycle->connections;
-
     cycle->read_events = ngx_alloc(sizeof(ngx_event_t) * cycle->connection_n,
                                    cycle->log);
     if (cycle->read_events == NULL) {
         return NGX_ERROR;
     }
 
-    rev = cycle->read_events;
-    for (i = 0; i < cycle->connection_n; i++) {
-        rev[i].closed = 1;
-        rev[i].instance = 1;
-    }
-
     cycle->write_events = ngx_alloc(sizeof(ngx_event_t) * cycle->connection_n,
                                     cycle->log);
     if (cycle->write_events == NULL) {
         return NGX_ERROR;
     }
 
-    wev = cycle->write_events;
-    for (i = 0; i < cycle->connection_n; i++) {
-        wev[i].closed = 1;
-    }
-
-    i = cycle->connection_n;
-    next = NULL;
-
-    do {
-        i--;
-
-        c[i].data = next;
-        c[i].read = &cycle->read_events[i];
-        c[i].write = &cycle->write_events[i];
-        c[i].fd = (ngx_socket_t) -1;
-
-        next = &c[i];
-    } while (i);
+    /*
+     * the arrays are not touched here: the connections are initialized
+     * on first use by ngx_get_connection(), so the memory is only backed
+     * as far as the number of concurrent connections has ever reached
+     */
 
-    cycle->free_connections = next;
+    cycle->connection_used = 0;
+    cycle->free_connections = NULL;
     cycle->free_connection_n = cycle->connection_n;
 
     /* for each listening socket */
@@ -983,6 +1092,46 @@ ngx_send_lowat(ngx_connection_t *c, size_t lowat)
 }
 
 
+static void
+ngx_event_slab_defrag_handler(ngx_event_t *ev)
+{
+    ngx_uint_t        i;
+    ngx_cycle_t      *cycle;
+    ngx_list_part_t  *part;
+    ngx_shm_zone_t   *shm_zone;
+
+    cycle = ev->data;
+
+    part = &cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        if (shm_zone[i].defrag == NULL) {
+            continue;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "slab defrag \"%V\"", &shm_zone[i].shm.name);
+
+        shm_zone[i].defrag(&shm_zone[i]);
+    }
+
+    if (!ngx_exiting) {
+        ngx_add_timer(ev, ngx_event_slab_defrag_interval);
+    }
+}
+
+
 static char *
 ngx_events_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -1254,6 +1403,41 @@ ngx_event_debug_connection(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+static char *
+ngx_event_set_loop_stats(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_event_conf_t  *ecf = conf;
+
+    ngx_str_t  *value;
+
+    if (ecf->loop_stats != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcasecmp(value[1].data, (u_char *) "off") == 0) {
+        ecf->loop_stats = NULL;
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strcasecmp(value[1].data, (u_char *) "on") != 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid value \"%s\" in \"%s\" directive, "
+                           "it must be \"on\" or \"off\"",
+                           value[1].data, cmd->name.data);
+        return NGX_CONF_ERROR;
+    }
+
+    ecf->loop_stats = ngx_event_stats_create(cf);
+    if (ecf->loop_stats == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 static void *
 ngx_event_core_create_conf(ngx_cycle_t *cycle)
 {
@@ -1269,6 +1453,11 @@ ngx_event_core_create_conf(ngx_cycle_t *cycle)
     ecf->multi_accept = NGX_CONF_UNSET;
     ecf->accept_mutex = NGX_CONF_UNSET;
     ecf->accept_mutex_delay = NGX_CONF_UNSET_MSEC;
+    ecf->timer_wheel = NGX_CONF_UNSET;
+    ecf->low_priority_budget = NGX_CONF_UNSET;
+    ecf->udp_recv_batch = NGX_CONF_UNSET_UINT;
+    ecf->slab_defrag = NGX_CONF_UNSET_MSEC;
+    ecf->loop_stats = NGX_CONF_UNSET_PTR;
     ecf->name = (void *) NGX_CONF_UNSET;
 
 #if (NGX_DEBUG)
@@ -1368,6 +1557,11 @@ ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_value(ecf->multi_accept, 0);
     ngx_conf_init_value(ecf->accept_mutex, 0);
     ngx_conf_init_msec_value(ecf->accept_mutex_delay, 500);
+    ngx_conf_init_value(ecf->timer_wheel, 0);
+    ngx_conf_init_value(ecf->low_priority_budget, 0);
+    ngx_conf_init_uint_value(ecf->udp_recv_batch, 1);
+    ngx_conf_init_msec_value(ecf->slab_defrag, 0);
+    ngx_conf_init_ptr_value(ecf->loop_stats, NULL);
 
     return NGX_CONF_OK;
 }
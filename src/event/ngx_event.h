@@ -68,6 +68,9 @@ struct ngx_event_s {
 
     unsigned         posted:1;
 
+    /* posted to ngx_posted_low_events instead of ngx_posted_events */
+    unsigned         low_priority:1;
+
     unsigned         closed:1;
 
     /* to test on worker exit */
@@ -435,6 +438,16 @@ typedef struct {
 
     ngx_msec_t    accept_mutex_delay;
 
+    ngx_flag_t    timer_wheel;
+
+    ngx_int_t     low_priority_budget;
+
+    ngx_uint_t    udp_recv_batch;
+
+    ngx_msec_t    slab_defrag;
+
+    void         *loop_stats;
+
     u_char       *name;
 
 #if (NGX_DEBUG)
@@ -494,12 +507,16 @@ extern ngx_module_t           ngx_event_core_module;
 
 
 void ngx_event_accept(ngx_event_t *ev);
+void ngx_event_accept_passed(ngx_cycle_t *cycle, ngx_socket_t s);
 ngx_int_t ngx_trylock_accept_mutex(ngx_cycle_t *cycle);
 ngx_int_t ngx_enable_accept_events(ngx_cycle_t *cycle);
 u_char *ngx_accept_log_error(ngx_log_t *log, u_char *buf, size_t len);
 #if (NGX_DEBUG)
 void ngx_debug_accepted_connection(ngx_event_conf_t *ecf, ngx_connection_t *c);
 #endif
+#if (NGX_HAVE_REUSEPORT && NGX_HAVE_INCOMING_CPU)
+ngx_int_t ngx_event_cpu_steer_init(ngx_cycle_t *cycle);
+#endif
 
 
 void ngx_process_events_and_timers(ngx_cycle_t *cycle);
@@ -524,6 +541,7 @@ ngx_int_t ngx_send_lowat(ngx_connection_t *c, size_t lowat);
 #include <ngx_event_timer.h>
 #include <ngx_event_posted.h>
 #include <ngx_event_udp.h>
+#include <ngx_event_stats.h>
 
 #if (NGX_WIN32)
 #include <ngx_iocp_module.h>
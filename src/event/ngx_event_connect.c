@@ -85,6 +85,37 @@ ngx_event_connect_peer(ngx_peer_connection_t *pc)
         }
     }
 
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+
+    /*
+     * connect() returns at once and the SYN is sent with the first data
+     * written; without a cookie from the server the kernel falls back
+     * to a normal handshake
+     */
+
+    if (pc->fastopen && type == SOCK_STREAM
+        && pc->sockaddr->sa_family != AF_UNIX)
+    {
+        value = 1;
+
+        if (setsockopt(s, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+                       (const void *) &value, sizeof(int))
+            == -1)
+        {
+            err = ngx_socket_errno;
+
+            /* client TCP Fast Open may be disabled with sysctl */
+
+            if (err != NGX_EOPNOTSUPP && err != NGX_ENOPROTOOPT) {
+                ngx_log_error(NGX_LOG_ALERT, pc->log, err,
+                              "setsockopt(TCP_FASTOPEN_CONNECT) failed, "
+                              "ignored");
+            }
+        }
+    }
+
+#endif
+
     if (ngx_nonblocking(s) == -1) {
         ngx_log_error(NGX_LOG_ALERT, pc->log, ngx_socket_errno,
                       ngx_nonblocking_n " failed");
@@ -0,0 +1,317 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+#if (NGX_HAVE_REUSEPORT && NGX_HAVE_INCOMING_CPU)
+
+static ngx_int_t ngx_event_cpu_steer_group(ngx_cycle_t *cycle,
+    ngx_listening_t *ls, ngx_uint_t n);
+static ngx_int_t ngx_event_cpu_steer_worker_cpu(ngx_core_conf_t *ccf,
+    ngx_uint_t worker, ngx_uint_t cpu);
+#if (NGX_HAVE_BPF)
+static ngx_int_t ngx_event_cpu_steer_bpf(ngx_cycle_t *cycle,
+    ngx_listening_t *ls, ngx_uint_t n);
+#endif
+
+
+#if (NGX_HAVE_BPF)
+
+/*
+ * the program is an equivalent of
+ *
+ *     int ngx_cpu_steer(struct sk_reuseport_md *ctx)
+ *     {
+ *         __u32  key = bpf_get_smp_processor_id();
+ *
+ *         bpf_sk_select_reuseport(ctx, &ngx_cpu_steer_map, &key, 0);
+ *
+ *         return SK_PASS;
+ *     }
+ *
+ * if there is no socket for the CPU, the kernel selects one by hash
+ */
+
+static ngx_bpf_reloc_t  ngx_event_cpu_steer_relocs[] = {
+    { "ngx_cpu_steer_map", 4 },
+};
+
+static struct bpf_insn  ngx_event_cpu_steer_insns[] = {
+    /* opcode dst          src         offset imm */
+    { 0xbf,   BPF_REG_6,   BPF_REG_1, (int16_t)      0,        0x0 },
+    { 0x85,   BPF_REG_0,   BPF_REG_0, (int16_t)      0,        0x8 },
+    { 0x63,  BPF_REG_10,   BPF_REG_0, (int16_t)     -4,        0x0 },
+    { 0xbf,   BPF_REG_1,   BPF_REG_6, (int16_t)      0,        0x0 },
+    { 0x18,   BPF_REG_2,   BPF_REG_0, (int16_t)      0,        0x0 },
+    {  0x0,   BPF_REG_0,   BPF_REG_0, (int16_t)      0,        0x0 },
+    { 0xbf,   BPF_REG_3,  BPF_REG_10, (int16_t)      0,        0x0 },
+    {  0x7,   BPF_REG_3,   BPF_REG_0, (int16_t)      0, 0xfffffffc },
+    { 0xb7,   BPF_REG_4,   BPF_REG_0, (int16_t)      0,        0x0 },
+    { 0x85,   BPF_REG_0,   BPF_REG_0, (int16_t)      0,       0x52 },
+    { 0xb7,   BPF_REG_0,   BPF_REG_0, (int16_t)      0,        0x1 },
+    { 0x95,   BPF_REG_0,   BPF_REG_0, (int16_t)      0,        0x0 },
+};
+
+static ngx_bpf_program_t  ngx_event_cpu_steer_program = {
+    "BSD",
+    BPF_PROG_TYPE_SK_REUSEPORT,
+    ngx_event_cpu_steer_insns,
+    sizeof(ngx_event_cpu_steer_insns) / sizeof(struct bpf_insn),
+    ngx_event_cpu_steer_relocs,
+    sizeof(ngx_event_cpu_steer_relocs) / sizeof(ngx_bpf_reloc_t)
+};
+
+#endif
+
+
+ngx_int_t
+ngx_event_cpu_steer_init(ngx_cycle_t *cycle)
+{
+    ngx_uint_t        i;
+    ngx_listening_t  *ls;
+    ngx_core_conf_t  *ccf;
+
+    if (ngx_test_config) {
+        return NGX_OK;
+    }
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    if (!ccf->master || ccf->worker_processes == 1) {
+        return NGX_OK;
+    }
+
+    ls = cycle->listening.elts;
+    for (i = 0; i < cycle->listening.nelts; i++) {
+
+        /* the first socket of a reuseport group belongs to worker 0 */
+
+        if (!ls[i].cpu_steer
+            || ls[i].worker != 0
+            || ls[i].fd == (ngx_socket_t) -1)
+        {
+            continue;
+        }
+
+        if (ccf->cpu_affinity == NULL) {
+            ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                          "cpu_steer for %V has no effect "
+                          "without \"worker_cpu_affinity\"",
+                          &ls[i].addr_text);
+            continue;
+        }
+
+        if (ngx_event_cpu_steer_group(cycle, ls, i) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_event_cpu_steer_group(ngx_cycle_t *cycle, ngx_listening_t *ls,
+    ngx_uint_t n)
+{
+    int               cpu;
+    ngx_uint_t        i, c;
+    ngx_core_conf_t  *ccf;
+
+#if (NGX_HAVE_BPF)
+
+    if (ngx_event_cpu_steer_bpf(cycle, ls, n) == NGX_OK) {
+        return NGX_OK;
+    }
+
+#endif
+
+    /*
+     * fallback to SO_INCOMING_CPU: since Linux 6.2 a reuseport socket
+     * with a matching CPU is preferred, the first CPU of a worker is used
+     */
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    for (i = n; i < cycle->listening.nelts; i++) {
+
+        if (!ls[i].cpu_steer
+            || ls[i].fd == (ngx_socket_t) -1
+            || ls[i].type != ls[n].type
+            || ngx_cmp_sockaddr(ls[i].sockaddr, ls[i].socklen,
+                                ls[n].sockaddr, ls[n].socklen, 1)
+               != NGX_OK)
+        {
+            continue;
+        }
+
+        for (c = 0; c < CPU_SETSIZE; c++) {
+            if (ngx_event_cpu_steer_worker_cpu(ccf, ls[i].worker, c)) {
+                break;
+            }
+        }
+
+        if (c == CPU_SETSIZE) {
+            continue;
+        }
+
+        cpu = (int) c;
+
+        if (setsockopt(ls[i].fd, SOL_SOCKET, SO_INCOMING_CPU,
+                       (const void *) &cpu, sizeof(int))
+            == -1)
+        {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                          "setsockopt(SO_INCOMING_CPU, %d) %V failed, ignored",
+                          cpu, &ls[i].addr_text);
+            continue;
+        }
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "cpu steer %V: worker %ui incoming cpu %d",
+                       &ls[i].addr_text, ls[i].worker, cpu);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_event_cpu_steer_worker_cpu(ngx_core_conf_t *ccf, ngx_uint_t worker,
+    ngx_uint_t cpu)
+{
+    ngx_cpuset_t  *mask;
+
+    mask = ngx_get_conf_cpu_affinity(ccf, worker);
+
+    if (mask == NULL) {
+        return 0;
+    }
+
+    return CPU_ISSET(cpu, mask) ? 1 : 0;
+}
+
+
+#if (NGX_HAVE_BPF)
+
+static ngx_int_t
+ngx_event_cpu_steer_bpf(ngx_cycle_t *cycle, ngx_listening_t *ls,
+    ngx_uint_t n)
+{
+    int               map, prog, fd;
+    uint32_t          key;
+    ngx_int_t         rc;
+    ngx_uint_t        i, cpus, c;
+    ngx_core_conf_t  *ccf;
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    cpus = ngx_max((ngx_uint_t) ngx_ncpu, 1);
+
+    for (c = 0; c < CPU_SETSIZE; c++) {
+        for (i = 0; i < (ngx_uint_t) ccf->worker_processes; i++) {
+            if (ngx_event_cpu_steer_worker_cpu(ccf, i, c)) {
+                cpus = ngx_max(cpus, c + 1);
+            }
+        }
+    }
+
+    /* map[cpu] = listening socket of a worker bound to the cpu */
+
+    map = ngx_bpf_map_create(cycle->log, BPF_MAP_TYPE_REUSEPORT_SOCKARRAY,
+                             sizeof(uint32_t), sizeof(int), cpus, 0);
+    if (map == -1) {
+        return NGX_DECLINED;
+    }
+
+    rc = NGX_DECLINED;
+    prog = -1;
+
+    for (i = n; i < cycle->listening.nelts; i++) {
+
+        if (!ls[i].cpu_steer
+            || ls[i].fd == (ngx_socket_t) -1
+            || ls[i].type != ls[n].type
+            || ngx_cmp_sockaddr(ls[i].sockaddr, ls[i].socklen,
+                                ls[n].sockaddr, ls[n].socklen, 1)
+               != NGX_OK)
+        {
+            continue;
+        }
+
+        fd = ls[i].fd;
+
+        for (c = 0; c < cpus; c++) {
+            if (!ngx_event_cpu_steer_worker_cpu(ccf, ls[i].worker, c)) {
+                continue;
+            }
+
+            key = (uint32_t) c;
+
+            if (ngx_bpf_map_update(map, &key, &fd, BPF_ANY) == -1) {
+                ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                              "cpu steer failed to update map for %V",
+                              &ls[i].addr_text);
+                goto done;
+            }
+
+            ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "cpu steer %V: cpu %ui to worker %ui",
+                           &ls[i].addr_text, c, ls[i].worker);
+        }
+    }
+
+    ngx_bpf_program_link(&ngx_event_cpu_steer_program, "ngx_cpu_steer_map",
+                         map);
+
+    prog = ngx_bpf_load_program(cycle->log, &ngx_event_cpu_steer_program);
+    if (prog == -1) {
+        goto done;
+    }
+
+    /* the program replaces the one attached to the group, if any */
+
+    if (setsockopt(ls[n].fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF,
+                   &prog, sizeof(int))
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                      "setsockopt(SO_ATTACH_REUSEPORT_EBPF) %V failed",
+                      &ls[n].addr_text);
+        goto done;
+    }
+
+    rc = NGX_OK;
+
+done:
+
+    /* the attached program holds references to itself and to the map */
+
+    if (prog != -1 && close(prog) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "close() cpu steer program failed");
+    }
+
+    if (close(map) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "close() cpu steer map failed");
+    }
+
+    if (rc != NGX_OK) {
+        ngx_log_error(NGX_LOG_NOTICE, cycle->log, 0,
+                      "cpu steer BPF program is not used for %V, "
+                      "falling back to SO_INCOMING_CPU", &ls[n].addr_text);
+    }
+
+    return rc;
+}
+
+#endif
+
+#endif
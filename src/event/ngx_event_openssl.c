@@ -9,12 +9,22 @@
 #include <ngx_core.h>
 #include <ngx_event.h>
 
+#if (defined OPENSSL_IS_BORINGSSL && NGX_ZLIB)
+#include <zlib.h>
+#endif
+
 
 #define NGX_SSL_PASSWORD_BUFFER_SIZE  4096
 
+#define NGX_SSL_SESSION_SHARD_PAGES   64
+
+#define ngx_ssl_session_shard(cache, hash)                                    \
+    (&(cache)->shards[(hash) % (cache)->nshards])
+
 
 typedef struct {
-    ngx_uint_t  engine;   /* unsigned  engine:1; */
+    ngx_uint_t              engine;   /* unsigned  engine:1; */
+    ngx_ssl_stats_zone_t   *stats;
 } ngx_openssl_conf_t;
 
 
@@ -31,6 +41,13 @@ static int ngx_ssl_new_client_session(ngx_ssl_conn_t *ssl_conn,
 static ngx_int_t ngx_ssl_try_early_data(ngx_connection_t *c);
 #endif
 static void ngx_ssl_handshake_handler(ngx_event_t *ev);
+static ngx_int_t ngx_ssl_stats_init_zone(ngx_shm_zone_t *shm_zone, void *data);
+static void ngx_ssl_stats_handshake(ngx_connection_t *c, ngx_uint_t ok);
+#ifdef SSL_MODE_ASYNC
+static ngx_int_t ngx_ssl_async_wait(ngx_connection_t *c);
+static void ngx_ssl_async_handler(ngx_event_t *ev);
+#endif
+static void ngx_ssl_async_cleanup(ngx_connection_t *c);
 #ifdef SSL_READ_EARLY_DATA_SUCCESS
 static ssize_t ngx_ssl_recv_early(ngx_connection_t *c, u_char *buf,
     size_t size);
@@ -43,12 +60,20 @@ static ssize_t ngx_ssl_write_early(ngx_connection_t *c, u_char *data,
 #endif
 static ssize_t ngx_ssl_sendfile(ngx_connection_t *c, ngx_buf_t *file,
     size_t size);
+#if (defined BIO_get_ktls_send && !NGX_WIN32)
+static ngx_uint_t ngx_ssl_ktls_direct(ngx_connection_t *c);
+#endif
 static void ngx_ssl_read_handler(ngx_event_t *rev);
 static void ngx_ssl_shutdown_handler(ngx_event_t *ev);
 static void ngx_ssl_connection_error(ngx_connection_t *c, int sslerr,
     ngx_err_t err, char *text);
 static void ngx_ssl_clear_error(ngx_log_t *log);
 
+#if (defined OPENSSL_IS_BORINGSSL && defined TLSEXT_cert_compression_zlib     \
+     && NGX_ZLIB)
+static int ngx_ssl_compress_certificate(ngx_ssl_conn_t *ssl_conn, CBB *out,
+    const uint8_t *in, size_t in_len);
+#endif
 static ngx_int_t ngx_ssl_session_id_context(ngx_ssl_t *ssl,
     ngx_str_t *sess_ctx, ngx_array_t *certificates);
 static int ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn,
@@ -59,8 +84,10 @@ static ngx_ssl_session_t *ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn,
 #endif
     u_char *id, int len, int *copy);
 static void ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess);
-static void ngx_ssl_expire_sessions(ngx_ssl_session_cache_t *cache,
-    ngx_slab_pool_t *shpool, ngx_uint_t n);
+static ngx_int_t ngx_ssl_session_cache_shards(ngx_shm_zone_t *shm_zone,
+    ngx_ssl_session_cache_t *cache);
+static void ngx_ssl_expire_sessions(ngx_ssl_session_shard_t *shard,
+    ngx_uint_t n);
 static void ngx_ssl_session_rbtree_insert_value(ngx_rbtree_node_t *temp,
     ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel);
 
@@ -299,6 +326,8 @@ ngx_ssl_create(ngx_ssl_t *ssl, ngx_uint_t protocols, void *data)
                     ngx_rbtree_insert_value);
 
     ssl->buffer_size = NGX_SSL_BUFSIZE;
+    ssl->dynamic_records = 0;
+    ssl->dynamic_threshold = NGX_SSL_DYN_REC_THRESHOLD;
 
     /* client side options */
 
@@ -386,6 +415,11 @@ ngx_ssl_create(ngx_ssl_t *ssl, ngx_uint_t protocols, void *data)
     SSL_CTX_set_options(ssl->ctx, SSL_OP_NO_COMPRESSION);
 #endif
 
+#ifdef SSL_OP_NO_TX_CERTIFICATE_COMPRESSION
+    /* certificates are compressed in advance if enabled */
+    SSL_CTX_set_options(ssl->ctx, SSL_OP_NO_TX_CERTIFICATE_COMPRESSION);
+#endif
+
 #ifdef SSL_OP_NO_ANTI_REPLAY
     SSL_CTX_set_options(ssl->ctx, SSL_OP_NO_ANTI_REPLAY);
 #endif
@@ -562,15 +596,23 @@ ngx_ssl_certificate(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *cert,
 
 ngx_int_t
 ngx_ssl_connection_certificate(ngx_connection_t *c, ngx_pool_t *pool,
-    ngx_str_t *cert, ngx_str_t *key, ngx_array_t *passwords)
+    ngx_str_t *cert, ngx_str_t *key, ngx_array_t *passwords,
+    ngx_shm_zone_t *cache)
 {
     char            *err;
     X509            *x509;
     EVP_PKEY        *pkey;
     STACK_OF(X509)  *chain;
 
-    chain = ngx_ssl_cache_connection_fetch(pool, NGX_SSL_CACHE_CERT, &err,
-                                           cert, NULL);
+    if (cache) {
+        chain = ngx_ssl_cache_shared_fetch(cache, pool, NGX_SSL_CACHE_CERT,
+                                           &err, cert, NULL);
+
+    } else {
+        chain = ngx_ssl_cache_connection_fetch(pool, NGX_SSL_CACHE_CERT, &err,
+                                               cert, NULL);
+    }
+
     if (chain == NULL) {
         if (err != NULL) {
             ngx_ssl_error(NGX_LOG_ERR, c->log, 0,
@@ -610,8 +652,15 @@ ngx_ssl_connection_certificate(ngx_connection_t *c, ngx_pool_t *pool,
 
 #endif
 
-    pkey = ngx_ssl_cache_connection_fetch(pool, NGX_SSL_CACHE_PKEY, &err,
-                                          key, passwords);
+    if (cache) {
+        pkey = ngx_ssl_cache_shared_fetch(cache, pool, NGX_SSL_CACHE_PKEY,
+                                          &err, key, passwords);
+
+    } else {
+        pkey = ngx_ssl_cache_connection_fetch(pool, NGX_SSL_CACHE_PKEY, &err,
+                                              key, passwords);
+    }
+
     if (pkey == NULL) {
         if (err != NULL) {
             ngx_ssl_error(NGX_LOG_ERR, c->log, 0,
@@ -1474,6 +1523,280 @@ ngx_ssl_early_data(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_uint_t enable)
 }
 
 
+ngx_int_t
+ngx_ssl_async(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_uint_t enable)
+{
+    if (!enable) {
+        return NGX_OK;
+    }
+
+#ifdef SSL_MODE_ASYNC
+
+    /*
+     * private key operations of an asynchronous engine are resumed
+     * when the engine signals completion via a wait file descriptor
+     */
+
+    SSL_CTX_set_mode(ssl->ctx, SSL_MODE_ASYNC);
+
+#else
+    ngx_log_error(NGX_LOG_WARN, ssl->log, 0,
+                  "\"ssl_async\" is not supported on this platform, "
+                  "ignored");
+#endif
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_ssl_ktls(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_uint_t enable)
+{
+    if (!enable) {
+        return NGX_OK;
+    }
+
+#if (defined SSL_OP_ENABLE_KTLS && defined BIO_get_ktls_send && !NGX_WIN32)
+
+    /*
+     * OpenSSL enables kernel TLS for both sending and receiving
+     * when supported by the kernel and the negotiated cipher
+     */
+
+    SSL_CTX_set_options(ssl->ctx, SSL_OP_ENABLE_KTLS);
+
+#else
+    ngx_log_error(NGX_LOG_WARN, ssl->log, 0,
+                  "\"ssl_ktls\" is not supported on this platform, "
+                  "ignored");
+#endif
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_ssl_certificate_compression(ngx_conf_t *cf, ngx_ssl_t *ssl,
+    ngx_uint_t enable)
+{
+    if (!enable) {
+        return NGX_OK;
+    }
+
+#ifdef SSL_OP_NO_TX_CERTIFICATE_COMPRESSION
+
+    /*
+     * OpenSSL 3.2+: certificates loaded from the configuration are
+     * compressed once with all supported algorithms; certificates
+     * loaded at run time are compressed on each handshake
+     */
+
+    SSL_CTX_clear_options(ssl->ctx, SSL_OP_NO_TX_CERTIFICATE_COMPRESSION);
+
+    if (ssl->certs.nelts && SSL_CTX_compress_certs(ssl->ctx, 0) == 0) {
+        ngx_ssl_error(NGX_LOG_WARN, ssl->log, 0,
+                      "SSL_CTX_compress_certs() failed, ignored");
+    }
+
+#elif (defined OPENSSL_IS_BORINGSSL && defined TLSEXT_cert_compression_zlib   \
+       && NGX_ZLIB)
+
+    if (SSL_CTX_add_cert_compression_alg(ssl->ctx,
+                                         TLSEXT_cert_compression_zlib,
+                                         ngx_ssl_compress_certificate, NULL)
+        == 0)
+    {
+        ngx_ssl_error(NGX_LOG_EMERG, ssl->log, 0,
+                      "SSL_CTX_add_cert_compression_alg() failed");
+        return NGX_ERROR;
+    }
+
+#else
+
+    ngx_log_error(NGX_LOG_WARN, ssl->log, 0,
+                  "\"ssl_certificate_compression\" is not supported "
+                  "by this SSL library, ignored");
+
+#endif
+
+    return NGX_OK;
+}
+
+
+#if (defined OPENSSL_IS_BORINGSSL && defined TLSEXT_cert_compression_zlib     \
+     && NGX_ZLIB)
+
+static int
+ngx_ssl_compress_certificate(ngx_ssl_conn_t *ssl_conn, CBB *out,
+    const uint8_t *in, size_t in_len)
+{
+    uLongf    len;
+    uint8_t  *p;
+
+    len = compressBound(in_len);
+
+    if (CBB_reserve(out, &p, len) == 0) {
+        return 0;
+    }
+
+    if (compress2(p, &len, in, in_len, Z_BEST_COMPRESSION) != Z_OK) {
+        return 0;
+    }
+
+    return CBB_did_write(out, len);
+}
+
+#endif
+
+
+ngx_int_t
+ngx_ssl_stats(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *name)
+{
+    ngx_str_t             *s;
+    ngx_uint_t             i;
+    ngx_shm_zone_t        *shm_zone;
+    ngx_openssl_conf_t    *oscf;
+    ngx_ssl_stats_zone_t  *sz;
+
+    static ngx_str_t  zone_name = ngx_string("ssl_stats");
+
+    oscf = (ngx_openssl_conf_t *) ngx_get_conf(cf->cycle->conf_ctx,
+                                               ngx_openssl_module);
+
+    sz = oscf->stats;
+
+    if (sz == NULL) {
+
+        /* the size is updated as servers are added */
+
+        shm_zone = ngx_shared_memory_add(cf, &zone_name, 8 * ngx_pagesize,
+                                         &ngx_openssl_module);
+        if (shm_zone == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (shm_zone->data) {
+            ngx_log_error(NGX_LOG_EMERG, ssl->log, 0,
+                          "duplicate zone \"%V\"", &zone_name);
+            return NGX_ERROR;
+        }
+
+        sz = ngx_pcalloc(cf->pool, sizeof(ngx_ssl_stats_zone_t));
+        if (sz == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (ngx_array_init(&sz->names, cf->pool, 4, sizeof(ngx_str_t))
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        sz->shm_zone = shm_zone;
+
+        shm_zone->init = ngx_ssl_stats_init_zone;
+        shm_zone->data = sz;
+
+        oscf->stats = sz;
+    }
+
+    s = sz->names.elts;
+
+    for (i = 0; i < sz->names.nelts; i++) {
+        if (s[i].len == name->len
+            && ngx_strncmp(s[i].data, name->data, name->len) == 0)
+        {
+            goto found;
+        }
+    }
+
+    s = ngx_array_push(&sz->names);
+    if (s == NULL) {
+        return NGX_ERROR;
+    }
+
+    *s = *name;
+
+    sz->shm_zone->shm.size = 8 * ngx_pagesize
+                             + ngx_align(sz->names.nelts
+                                         * sizeof(ngx_ssl_stats_t),
+                                         ngx_pagesize);
+
+found:
+
+    ssl->stats = sz;
+    ssl->stats_index = i;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_ssl_stats_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_ssl_stats_zone_t  *osz = data;
+
+    ngx_str_t             *s, *os;
+    ngx_uint_t             i;
+    ngx_slab_pool_t       *shpool;
+    ngx_ssl_stats_zone_t  *sz;
+
+    sz = shm_zone->data;
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (osz) {
+
+        /* the counters are kept if the servers are the same */
+
+        if (osz->names.nelts == sz->names.nelts) {
+            s = sz->names.elts;
+            os = osz->names.elts;
+
+            for (i = 0; i < sz->names.nelts; i++) {
+                if (s[i].len != os[i].len
+                    || ngx_strncmp(s[i].data, os[i].data, s[i].len) != 0)
+                {
+                    break;
+                }
+            }
+
+            if (i == sz->names.nelts) {
+                sz->stats = osz->stats;
+                return NGX_OK;
+            }
+        }
+
+        ngx_slab_free(shpool, osz->stats);
+
+    } else if (shm_zone->shm.exists) {
+        sz->stats = shpool->data;
+        return NGX_OK;
+    }
+
+    sz->stats = ngx_slab_calloc(shpool,
+                                sz->names.nelts * sizeof(ngx_ssl_stats_t));
+    if (sz->stats == NULL) {
+        return NGX_ERROR;
+    }
+
+    shpool->data = sz->stats;
+
+    return NGX_OK;
+}
+
+
+ngx_ssl_stats_zone_t *
+ngx_ssl_stats_zone(ngx_cycle_t *cycle)
+{
+    ngx_openssl_conf_t  *oscf;
+
+    oscf = (ngx_openssl_conf_t *) ngx_get_conf(cycle->conf_ctx,
+                                               ngx_openssl_module);
+
+    return oscf->stats;
+}
+
+
 ngx_int_t
 ngx_ssl_conf_commands(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *commands)
 {
@@ -1594,6 +1917,13 @@ ngx_ssl_create_connection(ngx_ssl_t *ssl, ngx_connection_t *c, ngx_uint_t flags)
 
     sc->buffer = ((flags & NGX_SSL_BUFFER) != 0);
     sc->buffer_size = ssl->buffer_size;
+    sc->dynamic_records = (ssl->dynamic_records != 0);
+    sc->dynamic_threshold = ssl->dynamic_threshold;
+
+    if (!(flags & NGX_SSL_CLIENT)) {
+        sc->stats = (ngx_ssl_stats_zone((ngx_cycle_t *) ngx_cycle) != NULL);
+        sc->handshake_start = ngx_current_msec;
+    }
 
     sc->session_ctx = ssl->ctx;
 
@@ -1680,6 +2010,7 @@ ngx_int_t
 ngx_ssl_handshake(ngx_connection_t *c)
 {
     int        n, sslerr;
+    uint64_t   start;
     ngx_err_t  err;
     ngx_int_t  rc;
 
@@ -1695,8 +2026,14 @@ ngx_ssl_handshake(ngx_connection_t *c)
 
     ngx_ssl_clear_error(c->log);
 
+    start = c->ssl->stats ? ngx_event_stats_usec() : 0;
+
     n = SSL_do_handshake(c->ssl->connection);
 
+    if (c->ssl->stats) {
+        c->ssl->handshake_usec += ngx_event_stats_usec() - start;
+    }
+
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0, "SSL_do_handshake: %d", n);
 
     if (n == 1) {
@@ -1713,6 +2050,8 @@ ngx_ssl_handshake(ngx_connection_t *c)
         ngx_ssl_handshake_log(c);
 #endif
 
+        ngx_ssl_stats_handshake(c, 1);
+
         c->recv = ngx_ssl_recv;
         c->send = ngx_ssl_write;
         c->recv_chain = ngx_ssl_recv_chain;
@@ -1741,6 +2080,11 @@ ngx_ssl_handshake(ngx_connection_t *c)
             c->ssl->sendfile = 1;
         }
 
+        if (BIO_get_ktls_recv(SSL_get_rbio(c->ssl->connection)) == 1) {
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                           "BIO_get_ktls_recv(): 1");
+        }
+
 #endif
 
         rc = ngx_ssl_ocsp_validate(c);
@@ -1757,6 +2101,10 @@ ngx_ssl_handshake(ngx_connection_t *c)
 
         c->ssl->handshaked = 1;
 
+        ngx_probe3(ssl__handshake__done, c,
+                   SSL_version(c->ssl->connection),
+                   SSL_session_reused(c->ssl->connection));
+
         return NGX_OK;
     }
 
@@ -1764,6 +2112,12 @@ ngx_ssl_handshake(ngx_connection_t *c)
 
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0, "SSL_get_error: %d", sslerr);
 
+#ifdef SSL_MODE_ASYNC
+    if (sslerr == SSL_ERROR_WANT_ASYNC) {
+        return ngx_ssl_async_wait(c);
+    }
+#endif
+
     if (sslerr == SSL_ERROR_WANT_READ) {
         c->read->ready = 0;
         c->read->handler = ngx_ssl_handshake_handler;
@@ -1798,6 +2152,8 @@ ngx_ssl_handshake(ngx_connection_t *c)
 
     err = (sslerr == SSL_ERROR_SYSCALL) ? ngx_errno : 0;
 
+    ngx_ssl_stats_handshake(c, 0);
+
     c->ssl->no_wait_shutdown = 1;
     c->ssl->no_send_shutdown = 1;
     c->read->eof = 1;
@@ -1832,6 +2188,7 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
     int        n, sslerr;
     u_char     buf;
     size_t     readbytes;
+    uint64_t   start;
     ngx_err_t  err;
     ngx_int_t  rc;
 
@@ -1839,8 +2196,14 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
 
     readbytes = 0;
 
+    start = c->ssl->stats ? ngx_event_stats_usec() : 0;
+
     n = SSL_read_early_data(c->ssl->connection, &buf, 1, &readbytes);
 
+    if (c->ssl->stats) {
+        c->ssl->handshake_usec += ngx_event_stats_usec() - start;
+    }
+
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "SSL_read_early_data: %d, %uz", n, readbytes);
 
@@ -1863,6 +2226,8 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
         ngx_ssl_handshake_log(c);
 #endif
 
+        ngx_ssl_stats_handshake(c, 1);
+
         c->ssl->try_early_data = 0;
 
         c->ssl->early_buf = buf;
@@ -1886,6 +2251,11 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
             c->ssl->sendfile = 1;
         }
 
+        if (BIO_get_ktls_recv(SSL_get_rbio(c->ssl->connection)) == 1) {
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                           "BIO_get_ktls_recv(): 1");
+        }
+
 #endif
 
         rc = ngx_ssl_ocsp_validate(c);
@@ -1902,6 +2272,10 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
 
         c->ssl->handshaked = 1;
 
+        ngx_probe3(ssl__handshake__done, c,
+                   SSL_version(c->ssl->connection),
+                   SSL_session_reused(c->ssl->connection));
+
         return NGX_OK;
     }
 
@@ -1911,6 +2285,12 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
 
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0, "SSL_get_error: %d", sslerr);
 
+#ifdef SSL_MODE_ASYNC
+    if (sslerr == SSL_ERROR_WANT_ASYNC) {
+        return ngx_ssl_async_wait(c);
+    }
+#endif
+
     if (sslerr == SSL_ERROR_WANT_READ) {
         c->read->ready = 0;
         c->read->handler = ngx_ssl_handshake_handler;
@@ -1945,6 +2325,8 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
 
     err = (sslerr == SSL_ERROR_SYSCALL) ? ngx_errno : 0;
 
+    ngx_ssl_stats_handshake(c, 0);
+
     c->ssl->no_wait_shutdown = 1;
     c->ssl->no_send_shutdown = 1;
     c->read->eof = 1;
@@ -1966,6 +2348,119 @@ ngx_ssl_try_early_data(ngx_connection_t *c)
 #endif
 
 
+static void
+ngx_ssl_stats_handshake(ngx_connection_t *c, ngx_uint_t ok)
+{
+    int               version;
+    ngx_uint_t        i;
+    ngx_ssl_t        *ssl;
+    ngx_ssl_stats_t  *st;
+#ifdef SSL_get_negotiated_group
+    int               nid;
+#endif
+
+    if (!c->ssl->stats) {
+        return;
+    }
+
+    c->ssl->stats = 0;
+
+    /* the server selected by SNI, if any */
+
+    ssl = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(c->ssl->connection),
+                              ngx_ssl_index);
+
+    if (ssl == NULL || ssl->stats == NULL) {
+        return;
+    }
+
+    st = &ssl->stats->stats[ssl->stats_index];
+
+    (void) ngx_atomic_fetch_add(&st->handshakes, 1);
+
+    ngx_event_histogram_add_shared(&st->cpu, c->ssl->handshake_usec);
+
+    if (!ok) {
+        (void) ngx_atomic_fetch_add(&st->failed, 1);
+        return;
+    }
+
+    ngx_event_histogram_add_shared(&st->latency,
+                                   ngx_current_msec - c->ssl->handshake_start);
+
+    if (SSL_session_reused(c->ssl->connection)) {
+        if (c->ssl->session_cached) {
+            (void) ngx_atomic_fetch_add(&st->reused_cache, 1);
+
+        } else {
+            (void) ngx_atomic_fetch_add(&st->reused_ticket, 1);
+        }
+    }
+
+    version = SSL_version(c->ssl->connection);
+
+    switch (version) {
+
+    case TLS1_VERSION:
+        i = 0;
+        break;
+
+#ifdef TLS1_1_VERSION
+    case TLS1_1_VERSION:
+        i = 1;
+        break;
+#endif
+
+#ifdef TLS1_2_VERSION
+    case TLS1_2_VERSION:
+        i = 2;
+        break;
+#endif
+
+#ifdef TLS1_3_VERSION
+    case TLS1_3_VERSION:
+        i = 3;
+        break;
+#endif
+
+    default:
+        i = NGX_SSL_STATS_PROTOCOLS - 1;
+    }
+
+    (void) ngx_atomic_fetch_add(&st->protocol[i], 1);
+
+#ifdef SSL_get_negotiated_group
+
+    nid = SSL_get_negotiated_group(c->ssl->connection);
+
+    if (nid == NID_undef) {
+        return;
+    }
+
+    for (i = 0; i < NGX_SSL_STATS_GROUPS; i++) {
+
+        if (st->group_nid[i] == (ngx_atomic_uint_t) nid) {
+            break;
+        }
+
+        if (st->group_nid[i] == 0
+            && ngx_atomic_cmp_set(&st->group_nid[i], 0,
+                                  (ngx_atomic_uint_t) nid))
+        {
+            break;
+        }
+
+        if (st->group_nid[i] == (ngx_atomic_uint_t) nid) {
+            break;
+        }
+    }
+
+    (void) ngx_atomic_fetch_add(&st->group[i], 1);
+
+#endif
+}
+
+
 #if (NGX_DEBUG)
 
 void
@@ -2025,6 +2520,7 @@ ngx_ssl_handshake_log(ngx_connection_t *c)
 static void
 ngx_ssl_handshake_handler(ngx_event_t *ev)
 {
+    ngx_int_t          rc;
     ngx_connection_t  *c;
 
     c = ev->data;
@@ -2037,7 +2533,15 @@ ngx_ssl_handshake_handler(ngx_event_t *ev)
         return;
     }
 
-    if (ngx_ssl_handshake(c) == NGX_AGAIN) {
+    rc = ngx_ssl_handshake(c);
+
+#ifdef SSL_MODE_ASYNC
+    if (c->ssl->async && !SSL_waiting_for_async(c->ssl->connection)) {
+        ngx_ssl_async_cleanup(c);
+    }
+#endif
+
+    if (rc == NGX_AGAIN) {
         return;
     }
 
@@ -2045,6 +2549,124 @@ ngx_ssl_handshake_handler(ngx_event_t *ev)
 }
 
 
+#ifdef SSL_MODE_ASYNC
+
+static ngx_int_t
+ngx_ssl_async_wait(ngx_connection_t *c)
+{
+    size_t             n;
+    OSSL_ASYNC_FD      fd;
+    ngx_connection_t  *ac;
+
+    c->read->handler = ngx_ssl_handshake_handler;
+    c->write->handler = ngx_ssl_handshake_handler;
+
+    if (SSL_get_all_async_fds(c->ssl->connection, NULL, &n) == 0) {
+        ngx_ssl_error(NGX_LOG_ALERT, c->log, 0,
+                      "SSL_get_all_async_fds() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "SSL async wait fds: %uz", n);
+
+    if (n == 0) {
+        /* the engine provides no wait notification, retry */
+        ngx_post_event(c->read, &ngx_posted_events);
+        return NGX_AGAIN;
+    }
+
+    if (n > 1) {
+        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
+                      "SSL async with %uz wait fds is not supported", n);
+        return NGX_ERROR;
+    }
+
+    if (SSL_get_all_async_fds(c->ssl->connection, &fd, &n) == 0) {
+        ngx_ssl_error(NGX_LOG_ALERT, c->log, 0,
+                      "SSL_get_all_async_fds() failed");
+        return NGX_ERROR;
+    }
+
+    ac = c->ssl->async;
+
+    if (ac) {
+        if (ac->fd == fd) {
+            return NGX_AGAIN;
+        }
+
+        ngx_ssl_async_cleanup(c);
+    }
+
+    ac = ngx_get_connection(fd, c->log);
+    if (ac == NULL) {
+        return NGX_ERROR;
+    }
+
+    ac->data = c;
+    ac->read->handler = ngx_ssl_async_handler;
+    ac->read->log = c->log;
+    ac->write->log = c->log;
+
+    c->ssl->async = ac;
+
+    if (ngx_handle_read_event(ac->read, 0) != NGX_OK) {
+        ngx_ssl_async_cleanup(c);
+        return NGX_ERROR;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static void
+ngx_ssl_async_handler(ngx_event_t *ev)
+{
+    ngx_connection_t  *c, *ac;
+
+    ac = ev->data;
+    c = ac->data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0, "SSL async handler");
+
+    ngx_ssl_handshake_handler(c->read);
+}
+
+#endif
+
+
+static void
+ngx_ssl_async_cleanup(ngx_connection_t *c)
+{
+    ngx_connection_t  *ac;
+
+    ac = c->ssl->async;
+
+    if (ac == NULL) {
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "SSL async cleanup fd:%d", ac->fd);
+
+    /* the wait file descriptor is owned by the engine */
+
+    if (ac->read->active) {
+        ngx_del_event(ac->read, NGX_READ_EVENT, 0);
+    }
+
+    if (ac->read->posted) {
+        ngx_delete_posted_event(ac->read);
+    }
+
+    ngx_free_connection(ac);
+
+    ac->fd = (ngx_socket_t) -1;
+
+    c->ssl->async = NULL;
+}
+
+
 ssize_t
 ngx_ssl_recv_chain(ngx_connection_t *c, ngx_chain_t *cl, off_t limit)
 {
@@ -2498,11 +3120,20 @@ ngx_chain_t *
 ngx_ssl_send_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
 {
     int           n;
+    u_char       *end;
     ngx_uint_t    flush;
     ssize_t       send, size, file_size;
     ngx_buf_t    *buf;
     ngx_chain_t  *cl;
 
+#if (defined BIO_get_ktls_send && !NGX_WIN32)
+
+    if (ngx_ssl_ktls_direct(c)) {
+        return ngx_os_io.send_chain(c, in, limit);
+    }
+
+#endif
+
     if (!c->ssl->buffer) {
 
         while (in) {
@@ -2563,9 +3194,24 @@ ngx_ssl_send_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
     send = buf->last - buf->pos;
     flush = (in == NULL) ? 1 : buf->flush;
 
+    if (c->ssl->dynamic_records
+        && ngx_current_msec - c->ssl->last_write > NGX_SSL_DYN_REC_TIMEOUT)
+    {
+        c->ssl->dynamic_sent = 0;
+    }
+
     for ( ;; ) {
 
-        while (in && buf->last < buf->end && send < limit) {
+        end = buf->end;
+
+        if (c->ssl->dynamic_records
+            && c->ssl->dynamic_sent < c->ssl->dynamic_threshold
+            && end - buf->start > NGX_SSL_DYN_REC_SIZE)
+        {
+            end = buf->start + NGX_SSL_DYN_REC_SIZE;
+        }
+
+        while (in && buf->last < end && send < limit) {
             if (in->buf->last_buf || in->buf->flush) {
                 flush = 1;
             }
@@ -2582,8 +3228,8 @@ ngx_ssl_send_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
 
             size = in->buf->last - in->buf->pos;
 
-            if (size > buf->end - buf->last) {
-                size = buf->end - buf->last;
+            if (size > end - buf->last) {
+                size = end - buf->last;
             }
 
             if (send + size > limit) {
@@ -2604,7 +3250,7 @@ ngx_ssl_send_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
             }
         }
 
-        if (!flush && send < limit && buf->last < buf->end) {
+        if (!flush && send < limit && buf->last < end) {
             break;
         }
 
@@ -2655,6 +3301,9 @@ ngx_ssl_send_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
 
         buf->pos += n;
 
+        c->ssl->dynamic_sent += n;
+        c->ssl->last_write = ngx_current_msec;
+
         if (n < size) {
             break;
         }
@@ -2694,6 +3343,12 @@ ngx_ssl_write(ngx_connection_t *c, u_char *data, size_t size)
     }
 #endif
 
+#if (defined BIO_get_ktls_send && !NGX_WIN32)
+    if (ngx_ssl_ktls_direct(c)) {
+        return ngx_os_io.send(c, data, size);
+    }
+#endif
+
     ngx_ssl_clear_error(c->log);
 
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0, "SSL to write: %uz", size);
@@ -2910,6 +3565,43 @@ ngx_ssl_write_early(ngx_connection_t *c, u_char *data, size_t size)
 #endif
 
 
+#if (defined BIO_get_ktls_send && !NGX_WIN32)
+
+static ngx_uint_t
+ngx_ssl_ktls_direct(ngx_connection_t *c)
+{
+    ngx_buf_t  *buf;
+
+    /*
+     * with kernel TLS offload for sending, records are built and
+     * encrypted by the kernel, and application data written to the socket
+     * directly are sent as is; this is only safe as long as OpenSSL
+     * has nothing pending to be sent, such as a partially written record,
+     * or a KeyUpdate message in response to the peer's one
+     */
+
+    if (!c->ssl->sendfile || c->ssl->in_early) {
+        return 0;
+    }
+
+    buf = c->ssl->buf;
+
+    if (buf && buf->pos != buf->last) {
+        return 0;
+    }
+
+    if (SSL_want_write(c->ssl->connection)
+        || SSL_get_key_update_type(c->ssl->connection) != SSL_KEY_UPDATE_NONE)
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+#endif
+
+
 static ssize_t
 ngx_ssl_sendfile(ngx_connection_t *c, ngx_buf_t *file, size_t size)
 {
@@ -3129,6 +3821,7 @@ ngx_ssl_shutdown(ngx_connection_t *c)
     rc = NGX_OK;
 
     ngx_ssl_ocsp_cleanup(c);
+    ngx_ssl_async_cleanup(c);
 
     if (SSL_in_init(c->ssl->connection)) {
         /*
@@ -3808,11 +4501,6 @@ ngx_ssl_session_cache_init(ngx_shm_zone_t *shm_zone, void *data)
     shpool->data = cache;
     shm_zone->data = cache;
 
-    ngx_rbtree_init(&cache->session_rbtree, &cache->sentinel,
-                    ngx_ssl_session_rbtree_insert_value);
-
-    ngx_queue_init(&cache->expire_queue);
-
     cache->ticket_keys[0].expire = 0;
     cache->ticket_keys[1].expire = 0;
     cache->ticket_keys[2].expire = 0;
@@ -3831,6 +4519,96 @@ ngx_ssl_session_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 
     shpool->log_nomem = 0;
 
+    return ngx_ssl_session_cache_shards(shm_zone, cache);
+}
+
+
+/*
+ * The cache is split into shards selected by the session id hash,
+ * each with its own rbtree, expiration queue, and a slab pool carved
+ * from the zone, so that workers do not serialize on a single mutex.
+ * A shard per CPU is used as long as each shard is large enough.
+ */
+
+static ngx_int_t
+ngx_ssl_session_cache_shards(ngx_shm_zone_t *shm_zone,
+    ngx_ssl_session_cache_t *cache)
+{
+    u_char                   *p;
+    size_t                    size;
+    ngx_uint_t                i, n;
+    ngx_slab_pool_t          *shpool, *sp;
+    ngx_ssl_session_shard_t  *shard;
+
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    n = 1;
+
+#if (NGX_HAVE_ATOMIC_OPS)
+
+    while (n * 2 <= NGX_SSL_SESSION_CACHE_SHARDS
+           && n * 2 <= (ngx_uint_t) ngx_ncpu
+           && shpool->pfree / (n * 2) >= NGX_SSL_SESSION_SHARD_PAGES)
+    {
+        n *= 2;
+    }
+
+#endif
+
+    cache->nshards = n;
+
+    if (n == 1) {
+        shard = &cache->shards[0];
+
+        ngx_rbtree_init(&shard->session_rbtree, &shard->sentinel,
+                        ngx_ssl_session_rbtree_insert_value);
+
+        ngx_queue_init(&shard->expire_queue);
+
+        shard->shpool = shpool;
+
+        return NGX_OK;
+    }
+
+    /* keep a page in the zone pool */
+
+    size = ((shpool->pfree - 1) / n) << ngx_pagesize_shift;
+
+    for (i = 0; i < n; i++) {
+
+        p = ngx_slab_alloc(shpool, size);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        sp = (ngx_slab_pool_t *) p;
+
+        sp->end = p + size;
+        sp->min_shift = 3;
+        sp->addr = p;
+
+        if (ngx_shmtx_create(&sp->mutex, &sp->lock, NULL) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        ngx_slab_init(sp);
+
+        sp->log_ctx = shpool->log_ctx;
+        sp->log_nomem = 0;
+
+        shard = &cache->shards[i];
+
+        ngx_rbtree_init(&shard->session_rbtree, &shard->sentinel,
+                        ngx_ssl_session_rbtree_insert_value);
+
+        ngx_queue_init(&shard->expire_queue);
+
+        shard->shpool = sp;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
+                   "ssl session cache shards:%ui size:%uz", n, size);
+
     return NGX_OK;
 }
 
@@ -3865,6 +4643,7 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
     ngx_connection_t         *c;
     ngx_slab_pool_t          *shpool;
     ngx_ssl_sess_id_t        *sess_id;
+    ngx_ssl_session_shard_t  *shard;
     ngx_ssl_session_cache_t  *cache;
     u_char                    buf[NGX_SSL_MAX_SESSION_SIZE];
 
@@ -3910,12 +4689,16 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
     shm_zone = SSL_CTX_get_ex_data(ssl_ctx, ngx_ssl_session_cache_index);
 
     cache = shm_zone->data;
-    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    hash = ngx_crc32_short(session_id, session_id_length);
+
+    shard = ngx_ssl_session_shard(cache, hash);
+    shpool = shard->shpool;
 
     ngx_shmtx_lock(&shpool->mutex);
 
     /* drop one or two expired sessions */
-    ngx_ssl_expire_sessions(cache, shpool, 1);
+    ngx_ssl_expire_sessions(shard, 1);
 
 #if (NGX_PTR_SIZE == 8)
     n = sizeof(ngx_ssl_sess_id_t);
@@ -3929,7 +4712,7 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 
         /* drop the oldest non-expired session and try once more */
 
-        ngx_ssl_expire_sessions(cache, shpool, 0);
+        ngx_ssl_expire_sessions(shard, 0);
 
         sess_id = ngx_slab_alloc_locked(shpool, n);
 
@@ -3946,7 +4729,7 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 
         /* drop the oldest non-expired session and try once more */
 
-        ngx_ssl_expire_sessions(cache, shpool, 0);
+        ngx_ssl_expire_sessions(shard, 0);
 
         sess_id->session = ngx_slab_alloc_locked(shpool, len);
 
@@ -3960,8 +4743,6 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
     ngx_memcpy(sess_id->session, buf, len);
     ngx_memcpy(sess_id->id, session_id, session_id_length);
 
-    hash = ngx_crc32_short(session_id, session_id_length);
-
     ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "ssl new session: %08XD:%ud:%d",
                    hash, session_id_length, len);
@@ -3972,9 +4753,9 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 
     sess_id->expire = ngx_time() + SSL_CTX_get_timeout(ssl_ctx);
 
-    ngx_queue_insert_head(&cache->expire_queue, &sess_id->queue);
+    ngx_queue_insert_head(&shard->expire_queue, &sess_id->queue);
 
-    ngx_rbtree_insert(&cache->session_rbtree, &sess_id->node);
+    ngx_rbtree_insert(&shard->session_rbtree, &sess_id->node);
 
     ngx_shmtx_unlock(&shpool->mutex);
 
@@ -4014,6 +4795,7 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn,
     ngx_rbtree_node_t        *node, *sentinel;
     ngx_ssl_session_t        *sess;
     ngx_ssl_sess_id_t        *sess_id;
+    ngx_ssl_session_shard_t  *shard;
     ngx_ssl_session_cache_t  *cache;
     u_char                    buf[NGX_SSL_MAX_SESSION_SIZE];
     ngx_connection_t         *c;
@@ -4033,12 +4815,13 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn,
 
     sess = NULL;
 
-    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+    shard = ngx_ssl_session_shard(cache, hash);
+    shpool = shard->shpool;
 
     ngx_shmtx_lock(&shpool->mutex);
 
-    node = cache->session_rbtree.root;
-    sentinel = cache->session_rbtree.sentinel;
+    node = shard->session_rbtree.root;
+    sentinel = shard->session_rbtree.sentinel;
 
     while (node != sentinel) {
 
@@ -4071,12 +4854,16 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn,
                 p = buf;
                 sess = d2i_SSL_SESSION(NULL, &p, slen);
 
+                if (sess) {
+                    c->ssl->session_cached = 1;
+                }
+
                 return sess;
             }
 
             ngx_queue_remove(&sess_id->queue);
 
-            ngx_rbtree_delete(&cache->session_rbtree, node);
+            ngx_rbtree_delete(&shard->session_rbtree, node);
 
             ngx_explicit_memzero(sess_id->session, sess_id->len);
 
@@ -4121,6 +4908,7 @@ ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
     ngx_slab_pool_t          *shpool;
     ngx_rbtree_node_t        *node, *sentinel;
     ngx_ssl_sess_id_t        *sess_id;
+    ngx_ssl_session_shard_t  *shard;
     ngx_ssl_session_cache_t  *cache;
 
     shm_zone = SSL_CTX_get_ex_data(ssl, ngx_ssl_session_cache_index);
@@ -4138,12 +4926,13 @@ ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
                    "ssl remove session: %08XD:%ud", hash, len);
 
-    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+    shard = ngx_ssl_session_shard(cache, hash);
+    shpool = shard->shpool;
 
     ngx_shmtx_lock(&shpool->mutex);
 
-    node = cache->session_rbtree.root;
-    sentinel = cache->session_rbtree.sentinel;
+    node = shard->session_rbtree.root;
+    sentinel = shard->session_rbtree.sentinel;
 
     while (node != sentinel) {
 
@@ -4167,7 +4956,7 @@ ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
 
             ngx_queue_remove(&sess_id->queue);
 
-            ngx_rbtree_delete(&cache->session_rbtree, node);
+            ngx_rbtree_delete(&shard->session_rbtree, node);
 
             ngx_explicit_memzero(sess_id->session, sess_id->len);
 
@@ -4189,22 +4978,23 @@ done:
 
 
 static void
-ngx_ssl_expire_sessions(ngx_ssl_session_cache_t *cache,
-    ngx_slab_pool_t *shpool, ngx_uint_t n)
+ngx_ssl_expire_sessions(ngx_ssl_session_shard_t *shard, ngx_uint_t n)
 {
     time_t              now;
     ngx_queue_t        *q;
+    ngx_slab_pool_t    *shpool;
     ngx_ssl_sess_id_t  *sess_id;
 
     now = ngx_time();
+    shpool = shard->shpool;
 
     while (n < 3) {
 
-        if (ngx_queue_empty(&cache->expire_queue)) {
+        if (ngx_queue_empty(&shard->expire_queue)) {
             return;
         }
 
-        q = ngx_queue_last(&cache->expire_queue);
+        q = ngx_queue_last(&shard->expire_queue);
 
         sess_id = ngx_queue_data(q, ngx_ssl_sess_id_t, queue);
 
@@ -4217,7 +5007,7 @@ ngx_ssl_expire_sessions(ngx_ssl_session_cache_t *cache,
         ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
                        "expire session: %08Xi", sess_id->node.key);
 
-        ngx_rbtree_delete(&cache->session_rbtree, &sess_id->node);
+        ngx_rbtree_delete(&shard->session_rbtree, &sess_id->node);
 
         ngx_explicit_memzero(sess_id->session, sess_id->len);
 
@@ -4274,7 +5064,8 @@ ngx_ssl_session_rbtree_insert_value(ngx_rbtree_node_t *temp,
 #ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
 
 ngx_int_t
-ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *paths)
+ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *paths,
+    time_t rotation)
 {
     u_char                 buf[80];
     size_t                 size;
@@ -4287,6 +5078,32 @@ ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *paths)
     ngx_pool_cleanup_t    *cln;
     ngx_ssl_ticket_key_t  *key;
 
+    if (rotation) {
+
+        if (paths) {
+            ngx_log_error(NGX_LOG_WARN, cf->log, 0,
+                          "\"ssl_session_ticket_key_rotation\" ignored, "
+                          "session ticket keys are loaded from files");
+            rotation = 0;
+
+        } else if (SSL_CTX_get_ex_data(ssl->ctx, ngx_ssl_session_cache_index)
+                   == NULL)
+        {
+            ngx_log_error(NGX_LOG_WARN, cf->log, 0,
+                          "\"ssl_session_ticket_key_rotation\" ignored, "
+                          "requires shared session cache");
+            rotation = 0;
+
+        } else if (rotation < SSL_CTX_get_timeout(ssl->ctx)) {
+            ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                          "\"ssl_session_ticket_key_rotation\" must not be "
+                          "less than \"ssl_session_timeout\"");
+            return NGX_ERROR;
+        }
+    }
+
+    ssl->ticket_key_rotation = rotation;
+
     if (paths == NULL
         && SSL_CTX_get_ex_data(ssl->ctx, ngx_ssl_session_cache_index) == NULL)
     {
@@ -4331,10 +5148,13 @@ ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *paths)
         key = ngx_array_push_n(keys, 3);
         key[0].shared = 1;
         key[0].expire = 0;
+        key[0].rotate = 0;
         key[1].shared = 1;
         key[1].expire = 0;
+        key[1].rotate = 0;
         key[2].shared = 1;
         key[2].expire = 0;
+        key[2].rotate = 0;
 
         return NGX_OK;
     }
@@ -4395,6 +5215,7 @@ ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *paths)
 
         key->shared = 0;
         key->expire = 1;
+        key->rotate = 0;
 
         if (size == 48) {
             key->size = 48;
@@ -4574,7 +5395,8 @@ ngx_ssl_ticket_key_callback(ngx_ssl_conn_t *ssl_conn,
 static ngx_int_t
 ngx_ssl_rotate_ticket_keys(SSL_CTX *ssl_ctx, ngx_log_t *log)
 {
-    time_t                    now, expire;
+    time_t                    now, expire, rotation;
+    ngx_ssl_t                *ssl;
     ngx_array_t              *keys;
     ngx_shm_zone_t           *shm_zone;
     ngx_slab_pool_t          *shpool;
@@ -4595,7 +5417,8 @@ ngx_ssl_rotate_ticket_keys(SSL_CTX *ssl_ctx, ngx_log_t *log)
 
     /*
      * if we don't need to update expiration of the current key
-     * and the previous key is still needed, don't sync with shared
+     * and the previous key is still needed, or the current key
+     * is not yet scheduled for rotation, don't sync with shared
      * memory to save some work; in the worst case other worker process
      * will switch to the next key, but this process will still be able
      * to decrypt tickets encrypted with it
@@ -4604,10 +5427,15 @@ ngx_ssl_rotate_ticket_keys(SSL_CTX *ssl_ctx, ngx_log_t *log)
     now = ngx_time();
     expire = now + SSL_CTX_get_timeout(ssl_ctx);
 
-    if (key[0].expire >= expire && key[1].expire >= now) {
+    if (key[0].expire >= expire
+        && (key[1].expire >= now || key[0].rotate > now))
+    {
         return NGX_OK;
     }
 
+    ssl = SSL_CTX_get_ex_data(ssl_ctx, ngx_ssl_index);
+    rotation = ssl ? ssl->ticket_key_rotation : 0;
+
     shm_zone = SSL_CTX_get_ex_data(ssl_ctx, ngx_ssl_session_cache_index);
 
     cache = shm_zone->data;
@@ -4629,6 +5457,7 @@ ngx_ssl_rotate_ticket_keys(SSL_CTX *ssl_ctx, ngx_log_t *log)
 
         key[0].shared = 1;
         key[0].expire = expire;
+        key[0].rotate = 0;
         key[0].size = 80;
         ngx_memcpy(key[0].name, buf, 16);
         ngx_memcpy(key[0].hmac_key, buf + 16, 32);
@@ -4649,16 +5478,18 @@ ngx_ssl_rotate_ticket_keys(SSL_CTX *ssl_ctx, ngx_log_t *log)
         key[2] = key[0];
     }
 
-    if (key[1].expire < now) {
+    if (key[1].expire < now && key[0].rotate <= now) {
 
         /*
          * if the previous key is no longer needed (or not initialized),
-         * replace it with the current key, replace the current key with
-         * the next key, and generate new next key
+         * and the current key is not scheduled to be used any longer,
+         * replace the previous key with the current key, replace
+         * the current key with the next key, and generate new next key
          */
 
         key[1] = key[0];
         key[0] = key[2];
+        key[0].rotate = rotation ? now + rotation : 0;
 
         if (RAND_bytes(buf, 80) != 1) {
             ngx_ssl_error(NGX_LOG_ALERT, log, 0, "RAND_bytes() failed");
@@ -4668,6 +5499,7 @@ ngx_ssl_rotate_ticket_keys(SSL_CTX *ssl_ctx, ngx_log_t *log)
 
         key[2].shared = 1;
         key[2].expire = 0;
+        key[2].rotate = 0;
         key[2].size = 80;
         ngx_memcpy(key[2].name, buf, 16);
         ngx_memcpy(key[2].hmac_key, buf + 16, 32);
@@ -4712,13 +5544,20 @@ ngx_ssl_ticket_keys_cleanup(void *data)
 #else
 
 ngx_int_t
-ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *paths)
+ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_array_t *paths,
+    time_t rotation)
 {
     if (paths) {
         ngx_log_error(NGX_LOG_WARN, ssl->log, 0,
                       "\"ssl_session_ticket_key\" ignored, not supported");
     }
 
+    if (rotation) {
+        ngx_log_error(NGX_LOG_WARN, ssl->log, 0,
+                      "\"ssl_session_ticket_key_rotation\" ignored, "
+                      "not supported");
+    }
+
     return NGX_OK;
 }
 
@@ -5877,6 +6716,7 @@ ngx_openssl_create_conf(ngx_cycle_t *cycle)
      * set by ngx_pcalloc():
      *
      *     oscf->engine = 0;
+     *     oscf->stats = NULL;
      */
 
     return oscf;
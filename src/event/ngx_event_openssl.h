@@ -85,11 +85,19 @@
 
 typedef struct ngx_ssl_ocsp_s  ngx_ssl_ocsp_t;
 
+typedef struct ngx_ssl_stats_zone_s  ngx_ssl_stats_zone_t;
+
 
 struct ngx_ssl_s {
     SSL_CTX                    *ctx;
     ngx_log_t                  *log;
     size_t                      buffer_size;
+    ngx_flag_t                  dynamic_records;
+    size_t                      dynamic_threshold;
+    time_t                      ticket_key_rotation;
+
+    ngx_ssl_stats_zone_t       *stats;
+    ngx_uint_t                  stats_index;
 
     ngx_array_t                 certs;
 
@@ -106,6 +114,13 @@ struct ngx_ssl_connection_s {
     ngx_buf_t                  *buf;
     size_t                      buffer_size;
 
+    size_t                      dynamic_threshold;
+    size_t                      dynamic_sent;
+    ngx_msec_t                  last_write;
+
+    ngx_msec_t                  handshake_start;
+    uint64_t                    handshake_usec;
+
     ngx_connection_handler_pt   handler;
 
     ngx_ssl_session_t          *session;
@@ -116,6 +131,8 @@ struct ngx_ssl_connection_s {
 
     ngx_ssl_ocsp_t             *ocsp;
 
+    ngx_connection_t           *async;
+
     u_char                      early_buf;
 
     unsigned                    handshaked:1;
@@ -133,6 +150,9 @@ struct ngx_ssl_connection_s {
     unsigned                    in_ocsp:1;
     unsigned                    early_preread:1;
     unsigned                    write_blocked:1;
+    unsigned                    stats:1;
+    unsigned                    session_cached:1;
+    unsigned                    dynamic_records:1;
 };
 
 
@@ -165,15 +185,26 @@ typedef struct {
     u_char                      hmac_key[32];
     u_char                      aes_key[32];
     time_t                      expire;
+    time_t                      rotate;
     unsigned                    size:8;
     unsigned                    shared:1;
 } ngx_ssl_ticket_key_t;
 
 
+#define NGX_SSL_SESSION_CACHE_SHARDS  16
+
+
 typedef struct {
     ngx_rbtree_t                session_rbtree;
     ngx_rbtree_node_t           sentinel;
     ngx_queue_t                 expire_queue;
+    ngx_slab_pool_t            *shpool;
+} ngx_ssl_session_shard_t;
+
+
+typedef struct {
+    ngx_uint_t                  nshards;
+    ngx_ssl_session_shard_t     shards[NGX_SSL_SESSION_CACHE_SHARDS];
     ngx_ssl_ticket_key_t        ticket_keys[3];
     time_t                      fail_time;
 } ngx_ssl_session_cache_t;
@@ -192,6 +223,16 @@ typedef struct {
 
 #define NGX_SSL_BUFSIZE  16384
 
+/*
+ * with dynamic records, the first records after connection start or
+ * an idle period fit into a single TCP segment, so they can be decrypted
+ * as soon as they arrive while the congestion window is still small
+ */
+
+#define NGX_SSL_DYN_REC_SIZE       1369
+#define NGX_SSL_DYN_REC_THRESHOLD  (40 * NGX_SSL_DYN_REC_SIZE)
+#define NGX_SSL_DYN_REC_TIMEOUT    1000
+
 
 #define NGX_SSL_CACHE_CERT  0
 #define NGX_SSL_CACHE_PKEY  1
@@ -207,7 +248,8 @@ ngx_int_t ngx_ssl_certificates(ngx_conf_t *cf, ngx_ssl_t *ssl,
 ngx_int_t ngx_ssl_certificate(ngx_conf_t *cf, ngx_ssl_t *ssl,
     ngx_str_t *cert, ngx_str_t *key, ngx_array_t *passwords);
 ngx_int_t ngx_ssl_connection_certificate(ngx_connection_t *c, ngx_pool_t *pool,
-    ngx_str_t *cert, ngx_str_t *key, ngx_array_t *passwords);
+    ngx_str_t *cert, ngx_str_t *key, ngx_array_t *passwords,
+    ngx_shm_zone_t *cache);
 
 ngx_int_t ngx_ssl_ciphers(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *ciphers,
     ngx_uint_t prefer_server_ciphers);
@@ -220,6 +262,10 @@ ngx_int_t ngx_ssl_stapling(ngx_conf_t *cf, ngx_ssl_t *ssl,
     ngx_str_t *file, ngx_str_t *responder, ngx_uint_t verify);
 ngx_int_t ngx_ssl_stapling_resolver(ngx_conf_t *cf, ngx_ssl_t *ssl,
     ngx_resolver_t *resolver, ngx_msec_t resolver_timeout);
+ngx_shm_zone_t *ngx_ssl_stapling_cache_zone(ngx_conf_t *cf, ngx_str_t *name,
+    size_t size);
+ngx_int_t ngx_ssl_stapling_cache(ngx_conf_t *cf, ngx_ssl_t *ssl,
+    ngx_shm_zone_t *shm_zone);
 ngx_int_t ngx_ssl_ocsp(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *responder,
     ngx_uint_t depth, ngx_shm_zone_t *shm_zone);
 ngx_int_t ngx_ssl_ocsp_resolver(ngx_conf_t *cf, ngx_ssl_t *ssl,
@@ -234,6 +280,10 @@ void *ngx_ssl_cache_fetch(ngx_conf_t *cf, ngx_uint_t index, char **err,
     ngx_str_t *path, void *data);
 void *ngx_ssl_cache_connection_fetch(ngx_pool_t *pool, ngx_uint_t index,
     char **err, ngx_str_t *path, void *data);
+void *ngx_ssl_cache_shared_fetch(ngx_shm_zone_t *shm_zone, ngx_pool_t *pool,
+    ngx_uint_t index, char **err, ngx_str_t *path, void *data);
+ngx_shm_zone_t *ngx_ssl_cache_shared_zone(ngx_conf_t *cf, ngx_str_t *name,
+    size_t size, time_t valid);
 
 ngx_array_t *ngx_ssl_read_password_file(ngx_conf_t *cf, ngx_str_t *file);
 ngx_array_t *ngx_ssl_preserve_passwords(ngx_conf_t *cf,
@@ -242,6 +292,12 @@ ngx_int_t ngx_ssl_dhparam(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *file);
 ngx_int_t ngx_ssl_ecdh_curve(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *name);
 ngx_int_t ngx_ssl_early_data(ngx_conf_t *cf, ngx_ssl_t *ssl,
     ngx_uint_t enable);
+ngx_int_t ngx_ssl_async(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_uint_t enable);
+ngx_int_t ngx_ssl_ktls(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_uint_t enable);
+ngx_int_t ngx_ssl_certificate_compression(ngx_conf_t *cf, ngx_ssl_t *ssl,
+    ngx_uint_t enable);
+ngx_int_t ngx_ssl_stats(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *name);
+ngx_ssl_stats_zone_t *ngx_ssl_stats_zone(ngx_cycle_t *cycle);
 ngx_int_t ngx_ssl_conf_commands(ngx_conf_t *cf, ngx_ssl_t *ssl,
     ngx_array_t *commands);
 
@@ -251,7 +307,7 @@ ngx_int_t ngx_ssl_session_cache(ngx_ssl_t *ssl, ngx_str_t *sess_ctx,
     ngx_array_t *certificates, ssize_t builtin_session_cache,
     ngx_shm_zone_t *shm_zone, time_t timeout);
 ngx_int_t ngx_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_ssl_t *ssl,
-    ngx_array_t *paths);
+    ngx_array_t *paths, time_t rotation);
 ngx_int_t ngx_ssl_session_cache_init(ngx_shm_zone_t *shm_zone, void *data);
 
 ngx_int_t ngx_ssl_create_connection(ngx_ssl_t *ssl, ngx_connection_t *c,
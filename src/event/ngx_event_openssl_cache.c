@@ -25,12 +25,17 @@ typedef void *(*ngx_ssl_cache_create_pt)(ngx_ssl_cache_key_t *id, char **err,
     void *data);
 typedef void (*ngx_ssl_cache_free_pt)(void *data);
 typedef void *(*ngx_ssl_cache_ref_pt)(char **err, void *data);
+typedef u_char *(*ngx_ssl_cache_encode_pt)(ngx_pool_t *pool, char **err,
+    void *data, size_t *len);
+typedef void *(*ngx_ssl_cache_decode_pt)(char **err, u_char *p, size_t len);
 
 
 typedef struct {
     ngx_ssl_cache_create_pt     create;
     ngx_ssl_cache_free_pt       free;
     ngx_ssl_cache_ref_pt        ref;
+    ngx_ssl_cache_encode_pt     encode;
+    ngx_ssl_cache_decode_pt     decode;
 } ngx_ssl_cache_type_t;
 
 
@@ -39,24 +44,67 @@ typedef struct {
     ngx_ssl_cache_key_t         id;
     ngx_ssl_cache_type_t       *type;
     void                       *value;
+
+    time_t                      mtime;
+    off_t                       fsize;
+    ngx_file_uniq_t             uniq;
 } ngx_ssl_cache_node_t;
 
 
 typedef struct {
     ngx_rbtree_t                rbtree;
     ngx_rbtree_node_t           sentinel;
+
+    ngx_flag_t                  inheritable;
 } ngx_ssl_cache_t;
 
 
+typedef struct {
+    ngx_str_node_t              sn;
+    ngx_queue_t                 queue;
+    time_t                      checked;
+    time_t                      mtime;
+    off_t                       fsize;
+    ngx_file_uniq_t             uniq;
+    size_t                      len;
+    u_char                      data[1];
+} ngx_ssl_cache_shared_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t                rbtree;
+    ngx_rbtree_node_t           sentinel;
+    ngx_queue_t                 queue;
+} ngx_ssl_cache_shared_sh_t;
+
+
+typedef struct {
+    ngx_ssl_cache_shared_sh_t  *sh;
+    ngx_slab_pool_t            *shpool;
+    time_t                      valid;
+} ngx_ssl_cache_shared_t;
+
+
 static ngx_int_t ngx_ssl_cache_init_key(ngx_pool_t *pool, ngx_uint_t index,
     ngx_str_t *path, ngx_ssl_cache_key_t *id);
 static ngx_ssl_cache_node_t *ngx_ssl_cache_lookup(ngx_ssl_cache_t *cache,
     ngx_ssl_cache_type_t *type, ngx_ssl_cache_key_t *id, uint32_t hash);
 
+static ngx_int_t ngx_ssl_cache_shared_init(ngx_shm_zone_t *shm_zone,
+    void *data);
+static void ngx_ssl_cache_shared_store(ngx_ssl_cache_shared_t *cache,
+    ngx_str_t *key, uint32_t hash, ngx_file_info_t *fi, u_char *value,
+    size_t len, ngx_log_t *log);
+static void ngx_ssl_cache_shared_free(ngx_ssl_cache_shared_t *cache,
+    ngx_ssl_cache_shared_node_t *node);
+
 static void *ngx_ssl_cache_cert_create(ngx_ssl_cache_key_t *id, char **err,
     void *data);
 static void ngx_ssl_cache_cert_free(void *data);
 static void *ngx_ssl_cache_cert_ref(char **err, void *data);
+static u_char *ngx_ssl_cache_cert_encode(ngx_pool_t *pool, char **err,
+    void *data, size_t *len);
+static void *ngx_ssl_cache_cert_decode(char **err, u_char *p, size_t len);
 
 static void *ngx_ssl_cache_pkey_create(ngx_ssl_cache_key_t *id, char **err,
     void *data);
@@ -64,6 +112,9 @@ static int ngx_ssl_cache_pkey_password_callback(char *buf, int size, int rwflag,
     void *userdata);
 static void ngx_ssl_cache_pkey_free(void *data);
 static void *ngx_ssl_cache_pkey_ref(char **err, void *data);
+static u_char *ngx_ssl_cache_pkey_encode(ngx_pool_t *pool, char **err,
+    void *data, size_t *len);
+static void *ngx_ssl_cache_pkey_decode(char **err, u_char *p, size_t len);
 
 static void *ngx_ssl_cache_crl_create(ngx_ssl_cache_key_t *id, char **err,
     void *data);
@@ -75,23 +126,40 @@ static void *ngx_ssl_cache_ca_create(ngx_ssl_cache_key_t *id, char **err,
 
 static BIO *ngx_ssl_cache_create_bio(ngx_ssl_cache_key_t *id, char **err);
 
+static void *ngx_ssl_cache_inherit(ngx_conf_t *cf, ngx_ssl_cache_node_t *cn,
+    char **err);
+
 static void *ngx_openssl_cache_create_conf(ngx_cycle_t *cycle);
+static char *ngx_openssl_cache_init_conf(ngx_cycle_t *cycle, void *conf);
 static void ngx_ssl_cache_cleanup(void *data);
 static void ngx_ssl_cache_node_insert(ngx_rbtree_node_t *temp,
     ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel);
 
 
+static ngx_command_t  ngx_openssl_cache_commands[] = {
+
+    { ngx_string("ssl_object_cache_inheritable"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      0,
+      offsetof(ngx_ssl_cache_t, inheritable),
+      NULL },
+
+      ngx_null_command
+};
+
+
 static ngx_core_module_t  ngx_openssl_cache_module_ctx = {
     ngx_string("openssl_cache"),
     ngx_openssl_cache_create_conf,
-    NULL
+    ngx_openssl_cache_init_conf
 };
 
 
 ngx_module_t  ngx_openssl_cache_module = {
     NGX_MODULE_V1,
     &ngx_openssl_cache_module_ctx,         /* module context */
-    NULL,                                  /* module directives */
+    ngx_openssl_cache_commands,            /* module directives */
     NGX_CORE_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
@@ -109,22 +177,30 @@ static ngx_ssl_cache_type_t  ngx_ssl_cache_types[] = {
     /* NGX_SSL_CACHE_CERT */
     { ngx_ssl_cache_cert_create,
       ngx_ssl_cache_cert_free,
-      ngx_ssl_cache_cert_ref },
+      ngx_ssl_cache_cert_ref,
+      ngx_ssl_cache_cert_encode,
+      ngx_ssl_cache_cert_decode },
 
     /* NGX_SSL_CACHE_PKEY */
     { ngx_ssl_cache_pkey_create,
       ngx_ssl_cache_pkey_free,
-      ngx_ssl_cache_pkey_ref },
+      ngx_ssl_cache_pkey_ref,
+      ngx_ssl_cache_pkey_encode,
+      ngx_ssl_cache_pkey_decode },
 
     /* NGX_SSL_CACHE_CRL */
     { ngx_ssl_cache_crl_create,
       ngx_ssl_cache_crl_free,
-      ngx_ssl_cache_crl_ref },
+      ngx_ssl_cache_crl_ref,
+      NULL,
+      NULL },
 
     /* NGX_SSL_CACHE_CA */
     { ngx_ssl_cache_ca_create,
       ngx_ssl_cache_cert_free,
-      ngx_ssl_cache_cert_ref }
+      ngx_ssl_cache_cert_ref,
+      NULL,
+      NULL }
 };
 
 
@@ -134,6 +210,7 @@ ngx_ssl_cache_fetch(ngx_conf_t *cf, ngx_uint_t index, char **err,
 {
     uint32_t               hash;
     ngx_ssl_cache_t       *cache;
+    ngx_file_info_t        fi;
     ngx_ssl_cache_key_t    id;
     ngx_ssl_cache_type_t  *type;
     ngx_ssl_cache_node_t  *cn;
@@ -166,9 +243,33 @@ ngx_ssl_cache_fetch(ngx_conf_t *cf, ngx_uint_t index, char **err,
 
     ngx_cpystrn(cn->id.data, id.data, id.len + 1);
 
-    cn->value = type->create(&id, err, data);
+    cn->value = NULL;
+
+    cn->mtime = 0;
+    cn->fsize = 0;
+    cn->uniq = 0;
+
+    if (id.type != NGX_SSL_CACHE_PATH) {
+        cn->value = ngx_ssl_cache_inherit(cf, cn, err);
+
+    } else if (ngx_file_info(id.data, &fi) != NGX_FILE_ERROR) {
+
+        /* the file is checked before it is read, so changes are not missed */
+
+        cn->mtime = ngx_file_mtime(&fi);
+        cn->fsize = ngx_file_size(&fi);
+        cn->uniq = ngx_file_uniq(&fi);
+
+        cn->value = ngx_ssl_cache_inherit(cf, cn, err);
+    }
+
+    /* errors are reported by the create callback */
+
     if (cn->value == NULL) {
-        return NULL;
+        cn->value = type->create(&id, err, data);
+        if (cn->value == NULL) {
+            return NULL;
+        }
     }
 
     ngx_rbtree_insert(&cache->rbtree, &cn->node);
@@ -191,6 +292,326 @@ ngx_ssl_cache_connection_fetch(ngx_pool_t *pool, ngx_uint_t index, char **err,
 }
 
 
+/*
+ * certificates and keys loaded from files at run time are kept
+ * DER-encoded in a shared memory zone, so they are parsed once
+ * for all worker processes; a file is checked for modifications
+ * once in "valid" time, and least recently used entries are evicted
+ * if the zone is full
+ */
+
+void *
+ngx_ssl_cache_shared_fetch(ngx_shm_zone_t *shm_zone, ngx_pool_t *pool,
+    ngx_uint_t index, char **err, ngx_str_t *path, void *data)
+{
+    void                         *value;
+    u_char                       *p;
+    size_t                        len;
+    time_t                        now, mtime;
+    off_t                         fsize;
+    uint32_t                      hash;
+    ngx_str_t                     key;
+    ngx_uint_t                    found;
+    ngx_file_uniq_t               uniq;
+    ngx_file_info_t               fi;
+    ngx_ssl_cache_key_t           id;
+    ngx_ssl_cache_type_t         *type;
+    ngx_ssl_cache_shared_t       *cache;
+    ngx_ssl_cache_shared_node_t  *node;
+
+    *err = NULL;
+
+    if (ngx_ssl_cache_init_key(pool, index, path, &id) != NGX_OK) {
+        return NULL;
+    }
+
+    type = &ngx_ssl_cache_types[index];
+
+    if (id.type != NGX_SSL_CACHE_PATH || type->encode == NULL) {
+        return type->create(&id, err, data);
+    }
+
+    cache = shm_zone->data;
+
+    /* entries of different types may share the same file */
+
+    key.len = id.len + 1;
+    key.data = ngx_pnalloc(pool, key.len);
+    if (key.data == NULL) {
+        return NULL;
+    }
+
+    key.data[0] = (u_char) index;
+    ngx_memcpy(key.data + 1, id.data, id.len);
+
+    hash = ngx_crc32_short(key.data, key.len);
+
+    now = ngx_time();
+    found = 0;
+    p = NULL;
+    len = 0;
+    mtime = 0;
+    fsize = 0;
+    uniq = 0;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node = (ngx_ssl_cache_shared_node_t *)
+               ngx_str_rbtree_lookup(&cache->sh->rbtree, &key, hash);
+
+    if (node) {
+        ngx_queue_remove(&node->queue);
+        ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+        len = node->len;
+
+        p = ngx_pnalloc(pool, len);
+        if (p == NULL) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+            return NULL;
+        }
+
+        ngx_memcpy(p, node->sn.str.data + node->sn.str.len, len);
+
+        found = (now - node->checked < cache->valid) ? 2 : 1;
+
+        mtime = node->mtime;
+        fsize = node->fsize;
+        uniq = node->uniq;
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    if (found == 1) {
+
+        /* revalidate the file */
+
+        if (ngx_file_info(id.data, &fi) != NGX_FILE_ERROR
+            && ngx_file_mtime(&fi) == mtime
+            && ngx_file_size(&fi) == fsize
+            && ngx_file_uniq(&fi) == uniq)
+        {
+            ngx_shmtx_lock(&cache->shpool->mutex);
+
+            node = (ngx_ssl_cache_shared_node_t *)
+                       ngx_str_rbtree_lookup(&cache->sh->rbtree, &key, hash);
+
+            if (node && node->mtime == mtime) {
+                node->checked = now;
+            }
+
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+
+            found = 2;
+        }
+    }
+
+    if (found == 2) {
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, pool->log, 0,
+                       "ssl cache shared hit: \"%s\"", id.data);
+
+        value = type->decode(err, p, len);
+
+        ngx_explicit_memzero(p, len);
+
+        return value;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, pool->log, 0,
+                   "ssl cache shared miss: \"%s\"", id.data);
+
+    if (ngx_file_info(id.data, &fi) == NGX_FILE_ERROR) {
+        ngx_memzero(&fi, sizeof(ngx_file_info_t));
+    }
+
+    value = type->create(&id, err, data);
+    if (value == NULL) {
+        return NULL;
+    }
+
+    p = type->encode(pool, err, value, &len);
+    if (p == NULL) {
+        type->free(value);
+        return NULL;
+    }
+
+    ngx_ssl_cache_shared_store(cache, &key, hash, &fi, p, len, pool->log);
+
+    ngx_explicit_memzero(p, len);
+
+    return value;
+}
+
+
+static void
+ngx_ssl_cache_shared_store(ngx_ssl_cache_shared_t *cache, ngx_str_t *key,
+    uint32_t hash, ngx_file_info_t *fi, u_char *value, size_t len,
+    ngx_log_t *log)
+{
+    size_t                        size;
+    ngx_queue_t                  *q;
+    ngx_ssl_cache_shared_node_t  *node;
+
+    size = offsetof(ngx_ssl_cache_shared_node_t, data) + key->len + len;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node = (ngx_ssl_cache_shared_node_t *)
+               ngx_str_rbtree_lookup(&cache->sh->rbtree, key, hash);
+
+    if (node) {
+        ngx_ssl_cache_shared_free(cache, node);
+    }
+
+    for ( ;; ) {
+        node = ngx_slab_alloc_locked(cache->shpool, size);
+        if (node) {
+            break;
+        }
+
+        if (ngx_queue_empty(&cache->sh->queue)) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+
+            ngx_log_error(NGX_LOG_WARN, log, 0,
+                          "could not allocate node%s", cache->shpool->log_ctx);
+            return;
+        }
+
+        /* evict the least recently used entry */
+
+        q = ngx_queue_last(&cache->sh->queue);
+
+        ngx_ssl_cache_shared_free(cache,
+                   ngx_queue_data(q, ngx_ssl_cache_shared_node_t, queue));
+    }
+
+    node->sn.node.key = hash;
+    node->sn.str.len = key->len;
+    node->sn.str.data = node->data;
+    node->checked = ngx_time();
+    node->mtime = ngx_file_mtime(fi);
+    node->fsize = ngx_file_size(fi);
+    node->uniq = ngx_file_uniq(fi);
+    node->len = len;
+
+    ngx_memcpy(node->data, key->data, key->len);
+    ngx_memcpy(node->data + key->len, value, len);
+
+    ngx_rbtree_insert(&cache->sh->rbtree, &node->sn.node);
+    ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+}
+
+
+static void
+ngx_ssl_cache_shared_free(ngx_ssl_cache_shared_t *cache,
+    ngx_ssl_cache_shared_node_t *node)
+{
+    ngx_queue_remove(&node->queue);
+    ngx_rbtree_delete(&cache->sh->rbtree, &node->sn.node);
+
+    /* private keys are not left in the freed memory */
+
+    ngx_explicit_memzero(node->data + node->sn.str.len, node->len);
+
+    ngx_slab_free_locked(cache->shpool, node);
+}
+
+
+ngx_shm_zone_t *
+ngx_ssl_cache_shared_zone(ngx_conf_t *cf, ngx_str_t *name, size_t size,
+    time_t valid)
+{
+    ngx_shm_zone_t          *shm_zone;
+    ngx_ssl_cache_shared_t  *cache;
+
+    shm_zone = ngx_shared_memory_add(cf, name, size,
+                                     &ngx_openssl_cache_module);
+    if (shm_zone == NULL) {
+        return NULL;
+    }
+
+    if (shm_zone->data) {
+        cache = shm_zone->data;
+
+        if (cache->valid != valid) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "certificate cache \"%V\" is already used "
+                               "with different \"valid\" time", name);
+            return NULL;
+        }
+
+        return shm_zone;
+    }
+
+    cache = ngx_pcalloc(cf->pool, sizeof(ngx_ssl_cache_shared_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->valid = valid;
+
+    shm_zone->init = ngx_ssl_cache_shared_init;
+    shm_zone->data = cache;
+
+    return shm_zone;
+}
+
+
+static ngx_int_t
+ngx_ssl_cache_shared_init(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_ssl_cache_shared_t  *ocache = data;
+
+    size_t                   len;
+    ngx_ssl_cache_shared_t  *cache;
+
+    cache = shm_zone->data;
+
+    if (ocache) {
+        cache->sh = ocache->sh;
+        cache->shpool = ocache->shpool;
+        return NGX_OK;
+    }
+
+    cache->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cache->sh = cache->shpool->data;
+        return NGX_OK;
+    }
+
+    cache->sh = ngx_slab_alloc(cache->shpool,
+                               sizeof(ngx_ssl_cache_shared_sh_t));
+    if (cache->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->shpool->data = cache->sh;
+
+    ngx_rbtree_init(&cache->sh->rbtree, &cache->sh->sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&cache->sh->queue);
+
+    len = sizeof(" in SSL certificate cache \"\"") + shm_zone->shm.name.len;
+
+    cache->shpool->log_ctx = ngx_slab_alloc(cache->shpool, len);
+    if (cache->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(cache->shpool->log_ctx, " in SSL certificate cache \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    cache->shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_ssl_cache_init_key(ngx_pool_t *pool, ngx_uint_t index, ngx_str_t *path,
     ngx_ssl_cache_key_t *id)
@@ -387,6 +808,99 @@ ngx_ssl_cache_cert_ref(char **err, void *data)
 }
 
 
+static u_char *
+ngx_ssl_cache_cert_encode(ngx_pool_t *pool, char **err, void *data,
+    size_t *len)
+{
+    STACK_OF(X509)  *chain = data;
+
+    int      n, i, rc;
+    u_char  *p, *buf;
+    X509    *x509;
+
+    /* the certificate itself keeps auxiliary trust information */
+
+    n = sk_X509_num(chain);
+    *len = 0;
+
+    for (i = 0; i < n; i++) {
+        x509 = sk_X509_value(chain, i);
+
+        rc = (i == 0) ? i2d_X509_AUX(x509, NULL) : i2d_X509(x509, NULL);
+
+        if (rc <= 0) {
+            *err = "i2d_X509() failed";
+            return NULL;
+        }
+
+        *len += rc;
+    }
+
+    buf = ngx_pnalloc(pool, *len);
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    p = buf;
+
+    for (i = 0; i < n; i++) {
+        x509 = sk_X509_value(chain, i);
+
+        if (i == 0) {
+            (void) i2d_X509_AUX(x509, &p);
+
+        } else {
+            (void) i2d_X509(x509, &p);
+        }
+    }
+
+    return buf;
+}
+
+
+static void *
+ngx_ssl_cache_cert_decode(char **err, u_char *p, size_t len)
+{
+    X509            *x509;
+    const u_char    *pos, *end;
+    STACK_OF(X509)  *chain;
+
+    chain = sk_X509_new_null();
+    if (chain == NULL) {
+        *err = "sk_X509_new_null() failed";
+        return NULL;
+    }
+
+    pos = p;
+    end = p + len;
+
+    while (pos < end) {
+
+        if (pos == p) {
+            x509 = d2i_X509_AUX(NULL, &pos, end - pos);
+
+        } else {
+            x509 = d2i_X509(NULL, &pos, end - pos);
+        }
+
+        if (x509 == NULL) {
+            *err = "d2i_X509() failed";
+            sk_X509_pop_free(chain, X509_free);
+            return NULL;
+        }
+
+        if (sk_X509_push(chain, x509) == 0) {
+            *err = "sk_X509_push() failed";
+            X509_free(x509);
+            sk_X509_pop_free(chain, X509_free);
+            return NULL;
+        }
+    }
+
+    return chain;
+}
+
+
 static void *
 ngx_ssl_cache_pkey_create(ngx_ssl_cache_key_t *id, char **err, void *data)
 {
@@ -537,6 +1051,53 @@ ngx_ssl_cache_pkey_ref(char **err, void *data)
 }
 
 
+static u_char *
+ngx_ssl_cache_pkey_encode(ngx_pool_t *pool, char **err, void *data,
+    size_t *len)
+{
+    EVP_PKEY  *pkey = data;
+
+    int      n;
+    u_char  *p, *buf;
+
+    n = i2d_PrivateKey(pkey, NULL);
+    if (n <= 0) {
+        *err = "i2d_PrivateKey() failed";
+        return NULL;
+    }
+
+    buf = ngx_pnalloc(pool, n);
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    p = buf;
+    (void) i2d_PrivateKey(pkey, &p);
+
+    *len = n;
+
+    return buf;
+}
+
+
+static void *
+ngx_ssl_cache_pkey_decode(char **err, u_char *p, size_t len)
+{
+    EVP_PKEY      *pkey;
+    const u_char  *pos;
+
+    pos = p;
+
+    pkey = d2i_AutoPrivateKey(NULL, &pos, len);
+    if (pkey == NULL) {
+        *err = "d2i_AutoPrivateKey() failed";
+        return NULL;
+    }
+
+    return pkey;
+}
+
+
 static void *
 ngx_ssl_cache_crl_create(ngx_ssl_cache_key_t *id, char **err, void *data)
 {
@@ -714,6 +1275,55 @@ ngx_ssl_cache_create_bio(ngx_ssl_cache_key_t *id, char **err)
 }
 
 
+static void *
+ngx_ssl_cache_inherit(ngx_conf_t *cf, ngx_ssl_cache_node_t *cn, char **err)
+{
+    ngx_cycle_t           *old_cycle;
+    ngx_ssl_cache_t       *cache, *old_cache;
+    ngx_ssl_cache_node_t  *ocn;
+
+    /*
+     * on reconfiguration, objects loaded from unchanged files, as well as
+     * objects from the same "data:" strings, are taken from the old cache
+     * instead of being parsed again
+     */
+
+    cache = (ngx_ssl_cache_t *) ngx_get_conf(cf->cycle->conf_ctx,
+                                             ngx_openssl_cache_module);
+
+    old_cycle = cf->cycle->old_cycle;
+
+    if (!cache->inheritable
+        || cn->id.type == NGX_SSL_CACHE_ENGINE
+        || old_cycle == NULL
+        || ngx_is_init_cycle(old_cycle))
+    {
+        return NULL;
+    }
+
+    old_cache = (ngx_ssl_cache_t *) ngx_get_conf(old_cycle->conf_ctx,
+                                                 ngx_openssl_cache_module);
+    if (old_cache == NULL) {
+        return NULL;
+    }
+
+    ocn = ngx_ssl_cache_lookup(old_cache, cn->type, &cn->id, cn->node.key);
+
+    if (ocn == NULL
+        || ocn->mtime != cn->mtime
+        || ocn->fsize != cn->fsize
+        || ocn->uniq != cn->uniq)
+    {
+        return NULL;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, cf->log, 0,
+                   "ssl cache inherited \"%s\"", cn->id.data);
+
+    return cn->type->ref(err, ocn->value);
+}
+
+
 static void *
 ngx_openssl_cache_create_conf(ngx_cycle_t *cycle)
 {
@@ -736,10 +1346,23 @@ ngx_openssl_cache_create_conf(ngx_cycle_t *cycle)
     ngx_rbtree_init(&cache->rbtree, &cache->sentinel,
                     ngx_ssl_cache_node_insert);
 
+    cache->inheritable = NGX_CONF_UNSET;
+
     return cache;
 }
 
 
+static char *
+ngx_openssl_cache_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_ssl_cache_t *cache = conf;
+
+    ngx_conf_init_value(cache->inheritable, 1);
+
+    return NGX_CONF_OK;
+}
+
+
 static void
 ngx_ssl_cache_cleanup(void *data)
 {
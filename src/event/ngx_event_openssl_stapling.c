@@ -11,6 +11,9 @@
 #include <ngx_event_connect.h>
 
 
+extern ngx_module_t  ngx_openssl_module;
+
+
 #if (!defined OPENSSL_NO_OCSP && defined SSL_CTRL_SET_TLSEXT_STATUS_REQ_CB)
 
 
@@ -40,6 +43,9 @@ typedef struct {
     time_t                       valid;
     time_t                       refresh;
 
+    ngx_shm_zone_t              *shm_zone;
+    ngx_str_t                    key;
+
     unsigned                     verify:1;
     unsigned                     loading:1;
 } ngx_ssl_stapling_t;
@@ -76,6 +82,16 @@ typedef struct {
 } ngx_ssl_ocsp_cache_node_t;
 
 
+typedef struct {
+    ngx_str_node_t               node;
+    ngx_queue_t                  queue;
+    time_t                       valid;
+    time_t                       refresh;
+    time_t                       loading;
+    ngx_str_t                    staple;
+} ngx_ssl_stapling_cache_node_t;
+
+
 typedef struct ngx_ssl_ocsp_ctx_s  ngx_ssl_ocsp_ctx_t;
 
 
@@ -159,6 +175,9 @@ static int ngx_ssl_certificate_status_callback(ngx_ssl_conn_t *ssl_conn,
 static ngx_ssl_stapling_t *ngx_ssl_stapling_lookup(ngx_ssl_t *ssl, X509 *cert);
 static void ngx_ssl_stapling_update(ngx_ssl_stapling_t *staple);
 static void ngx_ssl_stapling_ocsp_handler(ngx_ssl_ocsp_ctx_t *ctx);
+static ngx_int_t ngx_ssl_stapling_cache_lookup(ngx_ssl_stapling_t *staple);
+static void ngx_ssl_stapling_cache_store(ngx_ssl_stapling_t *staple,
+    ngx_str_t *response);
 
 static time_t ngx_ssl_stapling_time(ASN1_GENERALIZEDTIME *asn1time);
 
@@ -570,6 +589,81 @@ ngx_ssl_stapling_resolver(ngx_conf_t *cf, ngx_ssl_t *ssl,
 }
 
 
+ngx_shm_zone_t *
+ngx_ssl_stapling_cache_zone(ngx_conf_t *cf, ngx_str_t *name, size_t size)
+{
+    ngx_shm_zone_t  *shm_zone;
+
+    shm_zone = ngx_shared_memory_add(cf, name, size, &ngx_openssl_module);
+    if (shm_zone == NULL) {
+        return NULL;
+    }
+
+    shm_zone->init = ngx_ssl_ocsp_cache_init;
+
+    return shm_zone;
+}
+
+
+ngx_int_t
+ngx_ssl_stapling_cache(ngx_conf_t *cf, ngx_ssl_t *ssl,
+    ngx_shm_zone_t *shm_zone)
+{
+    u_char              *p;
+    unsigned int         len;
+    ngx_rbtree_t        *tree;
+    ngx_rbtree_node_t   *node;
+    ngx_ssl_stapling_t  *staple;
+    u_char               buf[EVP_MAX_MD_SIZE];
+
+    if (shm_zone == NULL) {
+        return NGX_OK;
+    }
+
+    tree = &ssl->staple_rbtree;
+
+    if (tree->root == tree->sentinel) {
+        return NGX_OK;
+    }
+
+    for (node = ngx_rbtree_min(tree->root, tree->sentinel);
+         node;
+         node = ngx_rbtree_next(tree, node))
+    {
+        staple = ngx_rbtree_data(node, ngx_ssl_stapling_t, node);
+
+        if (staple->host.len == 0) {
+            continue;
+        }
+
+        /*
+         * the key is the certificate digest prefixed with the verification
+         * flag, so it never matches DER-encoded OCSP cache keys
+         */
+
+        if (X509_digest(staple->cert, EVP_sha1(), buf, &len) == 0) {
+            ngx_ssl_error(NGX_LOG_EMERG, ssl->log, 0,
+                          "X509_digest() failed");
+            return NGX_ERROR;
+        }
+
+        p = ngx_pnalloc(cf->pool, len + 1);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        p[0] = (u_char) staple->verify;
+        ngx_memcpy(p + 1, buf, len);
+
+        staple->key.data = p;
+        staple->key.len = len + 1;
+        staple->shm_zone = shm_zone;
+    }
+
+    return NGX_OK;
+}
+
+
 static int
 ngx_ssl_certificate_status_callback(ngx_ssl_conn_t *ssl_conn, void *data)
 {
@@ -603,6 +697,8 @@ ngx_ssl_certificate_status_callback(ngx_ssl_conn_t *ssl_conn, void *data)
         return rc;
     }
 
+    ngx_ssl_stapling_update(staple);
+
     if (staple->staple.len
         && staple->valid >= ngx_time())
     {
@@ -621,8 +717,6 @@ ngx_ssl_certificate_status_callback(ngx_ssl_conn_t *ssl_conn, void *data)
         rc = SSL_TLSEXT_ERR_OK;
     }
 
-    ngx_ssl_stapling_update(staple);
-
     return rc;
 }
 
@@ -662,6 +756,12 @@ ngx_ssl_stapling_update(ngx_ssl_stapling_t *staple)
         return;
     }
 
+    if (staple->shm_zone
+        && ngx_ssl_stapling_cache_lookup(staple) != NGX_DECLINED)
+    {
+        return;
+    }
+
     staple->loading = 1;
 
     ctx = ngx_ssl_ocsp_start(ngx_cycle->log);
@@ -742,6 +842,8 @@ ngx_ssl_stapling_ocsp_handler(ngx_ssl_ocsp_ctx_t *ctx)
     staple->loading = 0;
     staple->refresh = ngx_max(ngx_min(ctx->valid - 300, now + 3600), now + 300);
 
+    ngx_ssl_stapling_cache_store(staple, &response);
+
     ngx_ssl_ocsp_done(ctx);
     return;
 
@@ -750,10 +852,212 @@ error:
     staple->loading = 0;
     staple->refresh = now + 300;
 
+    ngx_ssl_stapling_cache_store(staple, NULL);
+
     ngx_ssl_ocsp_done(ctx);
 }
 
 
+static ngx_int_t
+ngx_ssl_stapling_cache_lookup(ngx_ssl_stapling_t *staple)
+{
+    time_t                          now;
+    size_t                          size;
+    u_char                         *p;
+    uint32_t                        hash;
+    ngx_slab_pool_t                *shpool;
+    ngx_ssl_ocsp_cache_t           *cache;
+    ngx_ssl_stapling_cache_node_t  *node;
+
+    cache = staple->shm_zone->data;
+    shpool = (ngx_slab_pool_t *) staple->shm_zone->shm.addr;
+    hash = ngx_hash_key(staple->key.data, staple->key.len);
+    now = ngx_time();
+
+    ngx_shmtx_lock(&shpool->mutex);
+
+    node = (ngx_ssl_stapling_cache_node_t *)
+               ngx_str_rbtree_lookup(&cache->rbtree, &staple->key, hash);
+
+    if (node == NULL) {
+
+        size = sizeof(ngx_ssl_stapling_cache_node_t) + staple->key.len;
+
+        node = ngx_slab_calloc_locked(shpool, size);
+        if (node == NULL) {
+            ngx_shmtx_unlock(&shpool->mutex);
+            return NGX_DECLINED;
+        }
+
+        node->node.str.len = staple->key.len;
+        node->node.str.data = (u_char *) node
+                              + sizeof(ngx_ssl_stapling_cache_node_t);
+        ngx_memcpy(node->node.str.data, staple->key.data, staple->key.len);
+        node->node.node.key = hash;
+
+        ngx_rbtree_insert(&cache->rbtree, &node->node.node);
+        ngx_queue_insert_head(&cache->expire_queue, &node->queue);
+
+        goto fetch;
+    }
+
+    ngx_queue_remove(&node->queue);
+    ngx_queue_insert_head(&cache->expire_queue, &node->queue);
+
+    if (node->staple.len && node->valid > staple->valid) {
+
+        /* a newer response was fetched by another process */
+
+        p = ngx_alloc(node->staple.len, ngx_cycle->log);
+
+        if (p) {
+            ngx_memcpy(p, node->staple.data, node->staple.len);
+
+            if (staple->staple.data) {
+                ngx_free(staple->staple.data);
+            }
+
+            staple->staple.data = p;
+            staple->staple.len = node->staple.len;
+            staple->valid = node->valid;
+        }
+    }
+
+    if (node->refresh >= now) {
+        staple->refresh = node->refresh;
+        ngx_shmtx_unlock(&shpool->mutex);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
+                       "ssl stapling cache hit, refresh:%T",
+                       node->refresh - now);
+
+        return NGX_OK;
+    }
+
+    if (node->loading >= now) {
+
+        /* another process is loading, check again in a second */
+
+        staple->refresh = now;
+        ngx_shmtx_unlock(&shpool->mutex);
+
+        ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
+                       "ssl stapling cache busy");
+
+        return NGX_BUSY;
+    }
+
+fetch:
+
+    node->loading = now + (staple->timeout + staple->resolver_timeout) / 1000
+                    + 1;
+
+    ngx_shmtx_unlock(&shpool->mutex);
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
+                   "ssl stapling cache miss");
+
+    return NGX_DECLINED;
+}
+
+
+static void
+ngx_ssl_stapling_cache_store(ngx_ssl_stapling_t *staple, ngx_str_t *response)
+{
+    size_t                          size;
+    uint32_t                        hash;
+    ngx_queue_t                    *q;
+    ngx_slab_pool_t                *shpool;
+    ngx_ssl_ocsp_cache_t           *cache;
+    ngx_ssl_stapling_cache_node_t  *node, *old;
+
+    if (staple->shm_zone == NULL) {
+        return;
+    }
+
+    cache = staple->shm_zone->data;
+    shpool = (ngx_slab_pool_t *) staple->shm_zone->shm.addr;
+    hash = ngx_hash_key(staple->key.data, staple->key.len);
+
+    ngx_shmtx_lock(&shpool->mutex);
+
+    old = (ngx_ssl_stapling_cache_node_t *)
+               ngx_str_rbtree_lookup(&cache->rbtree, &staple->key, hash);
+
+    if (response == NULL) {
+        goto failed;
+    }
+
+    size = sizeof(ngx_ssl_stapling_cache_node_t) + staple->key.len
+           + response->len;
+
+    node = ngx_slab_alloc_locked(shpool, size);
+
+    while (node == NULL) {
+
+        q = ngx_queue_last(&cache->expire_queue);
+
+        if (q == ngx_queue_sentinel(&cache->expire_queue)) {
+            break;
+        }
+
+        node = ngx_queue_data(q, ngx_ssl_stapling_cache_node_t, queue);
+
+        if (node == old) {
+            old = NULL;
+        }
+
+        ngx_rbtree_delete(&cache->rbtree, &node->node.node);
+        ngx_queue_remove(q);
+        ngx_slab_free_locked(shpool, node);
+
+        node = ngx_slab_alloc_locked(shpool, size);
+    }
+
+    if (node == NULL) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                      "could not allocate new entry%s", shpool->log_ctx);
+        goto failed;
+    }
+
+    if (old) {
+        ngx_rbtree_delete(&cache->rbtree, &old->node.node);
+        ngx_queue_remove(&old->queue);
+        ngx_slab_free_locked(shpool, old);
+    }
+
+    node->node.str.len = staple->key.len;
+    node->node.str.data = (u_char *) node
+                          + sizeof(ngx_ssl_stapling_cache_node_t);
+    ngx_memcpy(node->node.str.data, staple->key.data, staple->key.len);
+    node->node.node.key = hash;
+
+    node->staple.len = response->len;
+    node->staple.data = node->node.str.data + staple->key.len;
+    ngx_memcpy(node->staple.data, response->data, response->len);
+
+    node->valid = staple->valid;
+    node->refresh = staple->refresh;
+    node->loading = 0;
+
+    ngx_rbtree_insert(&cache->rbtree, &node->node.node);
+    ngx_queue_insert_head(&cache->expire_queue, &node->queue);
+
+    ngx_shmtx_unlock(&shpool->mutex);
+
+    return;
+
+failed:
+
+    if (old) {
+        old->refresh = staple->refresh;
+        old->loading = 0;
+    }
+
+    ngx_shmtx_unlock(&shpool->mutex);
+}
+
+
 static time_t
 ngx_ssl_stapling_time(ASN1_GENERALIZEDTIME *asn1time)
 {
@@ -2767,6 +3071,30 @@ ngx_ssl_stapling_resolver(ngx_conf_t *cf, ngx_ssl_t *ssl,
 }
 
 
+ngx_shm_zone_t *
+ngx_ssl_stapling_cache_zone(ngx_conf_t *cf, ngx_str_t *name, size_t size)
+{
+    ngx_shm_zone_t  *shm_zone;
+
+    shm_zone = ngx_shared_memory_add(cf, name, size, &ngx_openssl_module);
+    if (shm_zone == NULL) {
+        return NULL;
+    }
+
+    shm_zone->init = ngx_ssl_ocsp_cache_init;
+
+    return shm_zone;
+}
+
+
+ngx_int_t
+ngx_ssl_stapling_cache(ngx_conf_t *cf, ngx_ssl_t *ssl,
+    ngx_shm_zone_t *shm_zone)
+{
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_ssl_ocsp(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *responder,
     ngx_uint_t depth, ngx_shm_zone_t *shm_zone)
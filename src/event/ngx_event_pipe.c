@@ -18,6 +18,17 @@ static ngx_int_t ngx_event_pipe_write_chain_to_temp_file(ngx_event_pipe_t *p);
 static ngx_inline void ngx_event_pipe_remove_shadow_links(ngx_buf_t *buf);
 static ngx_int_t ngx_event_pipe_drain_chains(ngx_event_pipe_t *p);
 
+static ngx_int_t ngx_event_pipe_alloc_raw_buf(ngx_event_pipe_t *p,
+    ngx_chain_t **chain);
+static void ngx_event_pipe_return_raw_buf(ngx_event_pipe_t *p, ngx_buf_t *b);
+static void ngx_event_pipe_cleanup_buf_pool(void *data);
+
+
+typedef struct {
+    ngx_queue_t        queue;
+    ngx_uint_t         class;
+} ngx_event_pipe_block_t;
+
 
 ngx_int_t
 ngx_event_pipe(ngx_event_pipe_t *p, ngx_int_t do_write)
@@ -106,7 +117,6 @@ ngx_event_pipe_read_upstream(ngx_event_pipe_t *p)
     off_t         limit;
     ssize_t       n, size;
     ngx_int_t     rc;
-    ngx_buf_t    *b;
     ngx_msec_t    delay;
     ngx_chain_t  *chain, *cl, *ln;
 
@@ -233,25 +243,17 @@ ngx_event_pipe_read_upstream(ngx_event_pipe_t *p)
                     p->free_raw_bufs = NULL;
                 }
 
-            } else if (p->allocated < p->bufs.num) {
+            } else if (p->allocated < p->bufs.num
+                       && (rc = ngx_event_pipe_alloc_raw_buf(p, &chain))
+                          != NGX_DECLINED)
+            {
 
                 /* allocate a new buf if it's still allowed */
 
-                b = ngx_create_temp_buf(p->pool, p->bufs.size);
-                if (b == NULL) {
-                    return NGX_ABORT;
-                }
-
-                p->allocated++;
-
-                chain = ngx_alloc_chain_link(p->pool);
-                if (chain == NULL) {
+                if (rc != NGX_OK) {
                     return NGX_ABORT;
                 }
 
-                chain->buf = b;
-                chain->next = NULL;
-
             } else if (!p->cacheable
                        && p->downstream->data == p->output_ctx
                        && p->downstream->write->ready
@@ -479,7 +481,17 @@ ngx_event_pipe_read_upstream(ngx_event_pipe_t *p)
 
         if (p->free_bufs && p->buf_to_file == NULL) {
             for (cl = p->free_raw_bufs; cl; cl = cl->next) {
-                if (cl->buf->shadow == NULL) {
+                if (cl->buf->shadow != NULL) {
+                    continue;
+                }
+
+                if (p->buf_pool
+                    && cl->buf->tag == (ngx_buf_tag_t) p->buf_pool)
+                {
+                    ngx_event_pipe_return_raw_buf(p, cl->buf);
+                    cl->buf->tag = NULL;
+
+                } else {
                     ngx_pfree(p->pool, cl->buf->start);
                 }
             }
@@ -1066,6 +1078,21 @@ ngx_event_pipe_add_free_buf(ngx_event_pipe_t *p, ngx_buf_t *b)
         return NGX_ERROR;
     }
 
+    if (p->buf_pool && b->tag == (ngx_buf_tag_t) p->buf_pool) {
+
+        /* the buf is not needed anymore, return its memory to the pool */
+
+        ngx_event_pipe_return_raw_buf(p, b);
+
+        b->shadow = NULL;
+
+        cl->buf = b;
+        cl->next = p->free_pool_bufs;
+        p->free_pool_bufs = cl;
+
+        return NGX_OK;
+    }
+
     if (p->buf_to_file && b->start == p->buf_to_file->start) {
         b->pos = p->buf_to_file->last;
         b->last = p->buf_to_file->last;
@@ -1144,3 +1171,228 @@ ngx_event_pipe_drain_chains(ngx_event_pipe_t *p)
         }
     }
 }
+
+
+ngx_event_pipe_buf_pool_t *
+ngx_event_pipe_create_buf_pool(ngx_pool_t *pool, size_t max_size)
+{
+    ngx_uint_t                  i;
+    ngx_event_pipe_buf_pool_t  *bp;
+
+    bp = ngx_palloc(pool, sizeof(ngx_event_pipe_buf_pool_t));
+    if (bp == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < NGX_EVENT_PIPE_POOL_CLASSES; i++) {
+        ngx_queue_init(&bp->free[i]);
+    }
+
+    bp->size = 0;
+    bp->max_size = max_size;
+
+    return bp;
+}
+
+
+ngx_int_t
+ngx_event_pipe_set_buf_pool(ngx_event_pipe_t *p,
+    ngx_event_pipe_buf_pool_t *pool)
+{
+    ngx_uint_t           n;
+    ngx_pool_cleanup_t  *cln;
+
+    for (n = 0; (size_t) NGX_EVENT_PIPE_POOL_MIN << n < (size_t) p->bufs.size;
+         n++)
+    {
+        if (n == NGX_EVENT_PIPE_POOL_CLASSES - 1) {
+
+            /* too large bufs are allocated from the request pool */
+
+            return NGX_OK;
+        }
+    }
+
+    cln = ngx_pool_cleanup_add(p->pool, 0);
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_event_pipe_cleanup_buf_pool;
+    cln->data = p;
+
+    p->buf_pool = pool;
+    p->buf_class = n;
+
+    ngx_queue_init(&p->borrowed);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_event_pipe_alloc_raw_buf(ngx_event_pipe_t *p, ngx_chain_t **chain)
+{
+    size_t                      size;
+    ngx_buf_t                  *b;
+    ngx_uint_t                  i;
+    ngx_queue_t                *q;
+    ngx_chain_t                *cl;
+    ngx_event_pipe_block_t     *block;
+    ngx_event_pipe_buf_pool_t  *pool;
+
+    pool = p->buf_pool;
+
+    if (pool == NULL) {
+        goto local;
+    }
+
+    size = (size_t) NGX_EVENT_PIPE_POOL_MIN << p->buf_class;
+
+    if (!ngx_queue_empty(&pool->free[p->buf_class])) {
+        q = ngx_queue_head(&pool->free[p->buf_class]);
+        ngx_queue_remove(q);
+
+        block = ngx_queue_data(q, ngx_event_pipe_block_t, queue);
+
+        goto borrowed;
+    }
+
+    /* free the cached blocks of other sizes to fit in the budget */
+
+    for (i = 0; i < NGX_EVENT_PIPE_POOL_CLASSES; i++) {
+
+        while (pool->size + size > pool->max_size
+               && !ngx_queue_empty(&pool->free[i]))
+        {
+            q = ngx_queue_head(&pool->free[i]);
+            ngx_queue_remove(q);
+
+            ngx_free(ngx_queue_data(q, ngx_event_pipe_block_t, queue));
+
+            pool->size -= (size_t) NGX_EVENT_PIPE_POOL_MIN << i;
+        }
+    }
+
+    if (pool->size + size > pool->max_size) {
+
+        if (p->allocated) {
+            ngx_log_debug1(NGX_LOG_DEBUG_EVENT, p->log, 0,
+                           "pipe buf pool exhausted: %uz", pool->size);
+
+            return NGX_DECLINED;
+        }
+
+        /* the pipe is allowed to make progress with a buf of its own */
+
+        goto local;
+    }
+
+    block = ngx_alloc(sizeof(ngx_event_pipe_block_t) + size, p->log);
+    if (block == NULL) {
+        return NGX_ERROR;
+    }
+
+    block->class = p->buf_class;
+    pool->size += size;
+
+borrowed:
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, p->log, 0,
+                   "pipe buf pool borrow: %p, pool size: %uz",
+                   block, pool->size);
+
+    ngx_queue_insert_tail(&p->borrowed, &block->queue);
+
+    cl = p->free_pool_bufs;
+
+    if (cl) {
+        p->free_pool_bufs = cl->next;
+        b = cl->buf;
+
+        ngx_memzero(b, sizeof(ngx_buf_t));
+
+    } else {
+        b = ngx_calloc_buf(p->pool);
+        if (b == NULL) {
+            return NGX_ERROR;
+        }
+
+        cl = ngx_alloc_chain_link(p->pool);
+        if (cl == NULL) {
+            return NGX_ERROR;
+        }
+
+        cl->buf = b;
+    }
+
+    b->start = (u_char *) block + sizeof(ngx_event_pipe_block_t);
+    b->pos = b->start;
+    b->last = b->start;
+    b->end = b->start + p->bufs.size;
+    b->temporary = 1;
+    b->tag = (ngx_buf_tag_t) pool;
+
+    goto done;
+
+local:
+
+    b = ngx_create_temp_buf(p->pool, p->bufs.size);
+    if (b == NULL) {
+        return NGX_ERROR;
+    }
+
+    cl = ngx_alloc_chain_link(p->pool);
+    if (cl == NULL) {
+        return NGX_ERROR;
+    }
+
+    cl->buf = b;
+
+done:
+
+    p->allocated++;
+
+    cl->next = NULL;
+    *chain = cl;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_event_pipe_return_raw_buf(ngx_event_pipe_t *p, ngx_buf_t *b)
+{
+    ngx_event_pipe_block_t  *block;
+
+    block = (ngx_event_pipe_block_t *) (b->start
+                                        - sizeof(ngx_event_pipe_block_t));
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, p->log, 0,
+                   "pipe buf pool return: %p, pool size: %uz",
+                   block, p->buf_pool->size);
+
+    ngx_queue_remove(&block->queue);
+    ngx_queue_insert_head(&p->buf_pool->free[block->class], &block->queue);
+
+    p->allocated--;
+}
+
+
+static void
+ngx_event_pipe_cleanup_buf_pool(void *data)
+{
+    ngx_event_pipe_t  *p = data;
+
+    ngx_queue_t             *q;
+    ngx_event_pipe_block_t  *block;
+
+    while (!ngx_queue_empty(&p->borrowed)) {
+        q = ngx_queue_head(&p->borrowed);
+        ngx_queue_remove(q);
+
+        block = ngx_queue_data(q, ngx_event_pipe_block_t, queue);
+
+        ngx_queue_insert_head(&p->buf_pool->free[block->class], q);
+    }
+}
@@ -22,6 +22,26 @@ typedef ngx_int_t (*ngx_event_pipe_output_filter_pt)(void *data,
                                                      ngx_chain_t *chain);
 
 
+/*
+ * A per-worker pool of raw bufs shared by all pipes.  The bufs are
+ * borrowed when read into and are returned as soon as they are sent
+ * downstream, so the memory used depends on the data in flight rather
+ * than on the number of requests multiplied by the configured bufs.
+ * The free blocks are kept in power of two size classes; all blocks,
+ * busy and free, fit in max_size.
+ */
+
+#define NGX_EVENT_PIPE_POOL_MIN      1024
+#define NGX_EVENT_PIPE_POOL_CLASSES  16
+
+
+typedef struct {
+    ngx_queue_t        free[NGX_EVENT_PIPE_POOL_CLASSES];
+    size_t             size;
+    size_t             max_size;
+} ngx_event_pipe_buf_pool_t;
+
+
 struct ngx_event_pipe_s {
     ngx_connection_t  *upstream;
     ngx_connection_t  *downstream;
@@ -71,6 +91,11 @@ struct ngx_event_pipe_s {
     ngx_bufs_t         bufs;
     ngx_buf_tag_t      tag;
 
+    ngx_event_pipe_buf_pool_t  *buf_pool;
+    ngx_uint_t         buf_class;
+    ngx_queue_t        borrowed;
+    ngx_chain_t       *free_pool_bufs;
+
     ssize_t            busy_size;
 
     off_t              read_length;
@@ -102,6 +127,10 @@ struct ngx_event_pipe_s {
 ngx_int_t ngx_event_pipe(ngx_event_pipe_t *p, ngx_int_t do_write);
 ngx_int_t ngx_event_pipe_copy_input_filter(ngx_event_pipe_t *p, ngx_buf_t *buf);
 ngx_int_t ngx_event_pipe_add_free_buf(ngx_event_pipe_t *p, ngx_buf_t *b);
+ngx_event_pipe_buf_pool_t *ngx_event_pipe_create_buf_pool(ngx_pool_t *pool,
+    size_t max_size);
+ngx_int_t ngx_event_pipe_set_buf_pool(ngx_event_pipe_t *p,
+    ngx_event_pipe_buf_pool_t *pool);
 
 
 #endif /* _NGX_EVENT_PIPE_H_INCLUDED_ */
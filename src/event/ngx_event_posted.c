@@ -13,6 +13,9 @@
 ngx_queue_t  ngx_posted_accept_events;
 ngx_queue_t  ngx_posted_next_events;
 ngx_queue_t  ngx_posted_events;
+ngx_queue_t  ngx_posted_low_events;
+
+ngx_uint_t   ngx_posted_low_budget;
 
 
 void
@@ -31,6 +34,11 @@ ngx_event_process_posted(ngx_cycle_t *cycle, ngx_queue_t *posted)
 
         ngx_delete_posted_event(ev);
 
+        if (ngx_event_loop_stats) {
+            ngx_event_stats_handler(ev);
+            continue;
+        }
+
         ev->handler(ev);
     }
 }
@@ -58,3 +66,39 @@ ngx_event_move_posted_next(ngx_cycle_t *cycle)
     ngx_queue_add(&ngx_posted_events, &ngx_posted_next_events);
     ngx_queue_init(&ngx_posted_next_events);
 }
+
+
+void
+ngx_event_process_posted_low(ngx_cycle_t *cycle)
+{
+    ngx_uint_t    n;
+    ngx_queue_t  *q;
+    ngx_event_t  *ev;
+
+    /*
+     * the rest of the events is left for the next iteration,
+     * so the events of already established connections go first
+     */
+
+    for (n = 0; n < ngx_posted_low_budget; n++) {
+
+        if (ngx_queue_empty(&ngx_posted_low_events)) {
+            return;
+        }
+
+        q = ngx_queue_head(&ngx_posted_low_events);
+        ev = ngx_queue_data(q, ngx_event_t, queue);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                      "posted low priority event %p", ev);
+
+        ngx_delete_posted_event(ev);
+
+        if (ngx_event_loop_stats) {
+            ngx_event_stats_handler(ev);
+            continue;
+        }
+
+        ev->handler(ev);
+    }
+}
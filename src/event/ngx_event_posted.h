@@ -18,7 +18,8 @@
                                                                               \
     if (!(ev)->posted) {                                                      \
         (ev)->posted = 1;                                                     \
-        ngx_queue_insert_tail(q, &(ev)->queue);                               \
+        ngx_queue_insert_tail(((ev)->low_priority && (q) == &ngx_posted_events)\
+                              ? &ngx_posted_low_events : (q), &(ev)->queue);  \
                                                                               \
         ngx_log_debug1(NGX_LOG_DEBUG_CORE, (ev)->log, 0, "post event %p", ev);\
                                                                               \
@@ -40,11 +41,15 @@
 
 void ngx_event_process_posted(ngx_cycle_t *cycle, ngx_queue_t *posted);
 void ngx_event_move_posted_next(ngx_cycle_t *cycle);
+void ngx_event_process_posted_low(ngx_cycle_t *cycle);
 
 
 extern ngx_queue_t  ngx_posted_accept_events;
 extern ngx_queue_t  ngx_posted_next_events;
 extern ngx_queue_t  ngx_posted_events;
+extern ngx_queue_t  ngx_posted_low_events;
+
+extern ngx_uint_t   ngx_posted_low_budget;
 
 
 #endif /* _NGX_EVENT_POSTED_H_INCLUDED_ */
@@ -0,0 +1,320 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+static ngx_int_t ngx_event_stats_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+static ngx_uint_t ngx_event_histogram_bucket(uint64_t value);
+
+
+ngx_event_loop_stats_t  *ngx_event_loop_stats;
+ngx_uint_t               ngx_event_loop_nevents;
+
+
+static ngx_str_t  ngx_event_stats_zone_name = ngx_string("event_loop_stats");
+
+
+ngx_event_stats_t *
+ngx_event_stats_create(ngx_conf_t *cf)
+{
+    ngx_event_stats_t  *st;
+
+    st = ngx_pcalloc(cf->pool, sizeof(ngx_event_stats_t));
+    if (st == NULL) {
+        return NULL;
+    }
+
+    /* the size is known after the whole configuration is parsed */
+
+    st->shm_zone = ngx_shared_memory_add(cf, &ngx_event_stats_zone_name,
+                                         8 * ngx_pagesize,
+                                         &ngx_event_core_module);
+    if (st->shm_zone == NULL) {
+        return NULL;
+    }
+
+    if (st->shm_zone->data) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"",
+                           &ngx_event_stats_zone_name);
+        return NULL;
+    }
+
+    st->shm_zone->init = ngx_event_stats_init_zone;
+    st->shm_zone->data = st;
+
+    return st;
+}
+
+
+void
+ngx_event_stats_init_conf(ngx_cycle_t *cycle, ngx_event_stats_t *st)
+{
+    size_t            size;
+    ngx_core_conf_t  *ccf;
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    st->workers = ccf->master ? (ngx_uint_t) ccf->worker_processes : 1;
+
+    size = ngx_align(st->workers * sizeof(ngx_event_loop_stats_t),
+                     ngx_pagesize);
+
+    st->shm_zone->shm.size = 8 * ngx_pagesize + size;
+}
+
+
+static ngx_int_t
+ngx_event_stats_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_event_stats_t  *ost = data;
+
+    ngx_slab_pool_t    *shpool;
+    ngx_event_stats_t  *st;
+
+    st = shm_zone->data;
+
+    if (ost) {
+        st->stats = ost->stats;
+        return NGX_OK;
+    }
+
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        st->stats = shpool->data;
+        return NGX_OK;
+    }
+
+    st->stats = ngx_slab_calloc(shpool,
+                                st->workers * sizeof(ngx_event_loop_stats_t));
+    if (st->stats == NULL) {
+        return NGX_ERROR;
+    }
+
+    shpool->data = st->stats;
+
+    return NGX_OK;
+}
+
+
+void
+ngx_event_stats_init_process(ngx_cycle_t *cycle, ngx_event_stats_t *st)
+{
+    ngx_uint_t  n;
+
+    ngx_event_loop_stats = NULL;
+
+    if (st == NULL) {
+        return;
+    }
+
+    if (ngx_process == NGX_PROCESS_WORKER) {
+        n = ngx_worker;
+
+    } else if (ngx_process == NGX_PROCESS_SINGLE) {
+        n = 0;
+
+    } else {
+        return;
+    }
+
+    if (n >= st->workers) {
+        return;
+    }
+
+    ngx_event_loop_stats = &st->stats[n];
+    ngx_event_loop_stats->pid = ngx_pid;
+}
+
+
+void
+ngx_event_stats_handler(ngx_event_t *ev)
+{
+    uint64_t  start;
+
+    start = ngx_event_stats_usec();
+
+    ev->handler(ev);
+
+    ngx_event_histogram_add(&ngx_event_loop_stats->handler,
+                            ngx_event_stats_usec() - start);
+
+    ngx_event_loop_nevents++;
+}
+
+
+void
+ngx_event_stats_timer(ngx_event_t *ev)
+{
+    ngx_event_histogram_add(&ngx_event_loop_stats->lateness,
+                            (ngx_msec_t) (ngx_current_msec - ev->timer.key));
+
+    ngx_event_stats_handler(ev);
+}
+
+
+void
+ngx_event_histogram_add(ngx_event_histogram_t *h, uint64_t value)
+{
+    /* each worker updates its own histograms only */
+
+    h->count++;
+    h->sum += value;
+
+    if (value > h->max) {
+        h->max = value;
+    }
+
+    h->bucket[ngx_event_histogram_bucket(value)]++;
+}
+
+
+void
+ngx_event_histogram_add_shared(ngx_event_histogram_t *h, uint64_t value)
+{
+    ngx_atomic_uint_t  max;
+
+    /* the histogram is updated by several processes */
+
+    (void) ngx_atomic_fetch_add(&h->count, 1);
+    (void) ngx_atomic_fetch_add(&h->sum, (ngx_atomic_int_t) value);
+
+    for ( ;; ) {
+        max = h->max;
+
+        if (value <= max
+            || ngx_atomic_cmp_set(&h->max, max, (ngx_atomic_uint_t) value))
+        {
+            break;
+        }
+    }
+
+    (void) ngx_atomic_fetch_add(&h->bucket[ngx_event_histogram_bucket(value)],
+                                1);
+}
+
+
+static ngx_uint_t
+ngx_event_histogram_bucket(uint64_t value)
+{
+    ngx_uint_t  n, bit;
+
+    if (value < 4) {
+        return (ngx_uint_t) value;
+    }
+
+    bit = 2;
+
+    while (bit < 63 && (value >> (bit + 1))) {
+        bit++;
+    }
+
+    n = (bit - 1) * 4 + (ngx_uint_t) ((value >> (bit - 2)) & 3);
+
+    return ngx_min(n, NGX_EVENT_STATS_BUCKETS - 1);
+}
+
+
+uint64_t
+ngx_event_histogram_value(ngx_uint_t n)
+{
+    /* the lower bound of the bucket */
+
+    if (n < 4) {
+        return n;
+    }
+
+    return (uint64_t) (4 + n % 4) << (n / 4 - 1);
+}
+
+
+uint64_t
+ngx_event_histogram_percentile(ngx_event_histogram_t *h, ngx_uint_t percent)
+{
+    ngx_uint_t    i;
+    ngx_atomic_t  n, total;
+
+    total = 0;
+
+    for (i = 0; i < NGX_EVENT_STATS_BUCKETS; i++) {
+        total += h->bucket[i];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    n = 0;
+
+    for (i = 0; i < NGX_EVENT_STATS_BUCKETS; i++) {
+        n += h->bucket[i];
+
+        if (n * 100 >= total * percent) {
+            return ngx_min(ngx_event_histogram_value(i), (uint64_t) h->max);
+        }
+    }
+
+    return h->max;
+}
+
+
+u_char *
+ngx_event_histogram_print(u_char *p, char *name, ngx_event_histogram_t *hg)
+{
+    ngx_uint_t             i;
+    ngx_event_histogram_t  h;
+
+    /* the histogram is updated concurrently */
+
+    ngx_memcpy(&h, hg, sizeof(ngx_event_histogram_t));
+
+    p = ngx_sprintf(p, " %s count %uA sum %uA max %uA", name,
+                    h.count, h.sum, h.max);
+
+    p = ngx_sprintf(p, " p50 %uL p90 %uL p99 %uL\n",
+                    ngx_event_histogram_percentile(&h, 50),
+                    ngx_event_histogram_percentile(&h, 90),
+                    ngx_event_histogram_percentile(&h, 99));
+
+    for (i = 0; i < NGX_EVENT_STATS_BUCKETS; i++) {
+        if (h.bucket[i]) {
+            p = ngx_sprintf(p, "  %uL %uA\n",
+                            ngx_event_histogram_value(i), h.bucket[i]);
+        }
+    }
+
+    return p;
+}
+
+
+uint64_t
+ngx_event_stats_usec(void)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+    struct timespec  ts;
+
+#if defined(CLOCK_MONOTONIC_FAST)
+    clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+#else
+    struct timeval   tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
@@ -0,0 +1,106 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_EVENT_STATS_H_INCLUDED_
+#define _NGX_EVENT_STATS_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * log-linear histograms: values 0..3 have their own buckets,
+ * every following power of two is split into 4 buckets
+ */
+
+#define NGX_EVENT_STATS_BUCKETS  128
+
+#define NGX_EVENT_HISTOGRAM_LEN                                               \
+    (sizeof(" count  sum  max  p50  p90  p99 \n") - 1 + 6 * NGX_ATOMIC_T_LEN  \
+     + NGX_EVENT_STATS_BUCKETS * (sizeof("    \n") - 1 + 2 * NGX_ATOMIC_T_LEN))
+
+
+typedef struct {
+    ngx_atomic_t              count;
+    ngx_atomic_t              sum;
+    ngx_atomic_t              max;
+    ngx_atomic_t              bucket[NGX_EVENT_STATS_BUCKETS];
+} ngx_event_histogram_t;
+
+
+typedef struct {
+    ngx_atomic_t              pid;
+    ngx_event_histogram_t     loop;        /* usec from wakeup to next wait */
+    ngx_event_histogram_t     handler;     /* usec per event handler */
+    ngx_event_histogram_t     events;      /* events handled per iteration */
+    ngx_event_histogram_t     lateness;    /* msec of timer expiration delay */
+} ngx_event_loop_stats_t;
+
+
+#if (NGX_SSL)
+
+#define NGX_SSL_STATS_PROTOCOLS  5
+#define NGX_SSL_STATS_GROUPS     8
+
+
+typedef struct {
+    ngx_atomic_t              handshakes;
+    ngx_atomic_t              failed;
+    ngx_atomic_t              reused_cache;
+    ngx_atomic_t              reused_ticket;
+
+    /* TLSv1, TLSv1.1, TLSv1.2, TLSv1.3, and other protocols */
+    ngx_atomic_t              protocol[NGX_SSL_STATS_PROTOCOLS];
+
+    /* key exchange groups in order of appearance, and other groups */
+    ngx_atomic_t              group_nid[NGX_SSL_STATS_GROUPS];
+    ngx_atomic_t              group[NGX_SSL_STATS_GROUPS + 1];
+
+    ngx_event_histogram_t     latency;     /* msec from ClientHello */
+    ngx_event_histogram_t     cpu;         /* usec in handshake calls */
+} ngx_ssl_stats_t;
+
+
+struct ngx_ssl_stats_zone_s {
+    ngx_array_t               names;       /* ngx_str_t */
+    ngx_ssl_stats_t          *stats;
+    ngx_shm_zone_t           *shm_zone;
+};
+
+#endif
+
+
+typedef struct {
+    ngx_uint_t                workers;
+    ngx_event_loop_stats_t   *stats;
+    ngx_shm_zone_t           *shm_zone;
+} ngx_event_stats_t;
+
+
+ngx_event_stats_t *ngx_event_stats_create(ngx_conf_t *cf);
+void ngx_event_stats_init_conf(ngx_cycle_t *cycle, ngx_event_stats_t *st);
+void ngx_event_stats_init_process(ngx_cycle_t *cycle, ngx_event_stats_t *st);
+
+void ngx_event_stats_handler(ngx_event_t *ev);
+void ngx_event_stats_timer(ngx_event_t *ev);
+void ngx_event_histogram_add(ngx_event_histogram_t *h, uint64_t value);
+void ngx_event_histogram_add_shared(ngx_event_histogram_t *h, uint64_t value);
+uint64_t ngx_event_histogram_value(ngx_uint_t n);
+uint64_t ngx_event_histogram_percentile(ngx_event_histogram_t *h,
+    ngx_uint_t percent);
+u_char *ngx_event_histogram_print(u_char *p, char *name,
+    ngx_event_histogram_t *hg);
+uint64_t ngx_event_stats_usec(void);
+
+
+extern ngx_event_loop_stats_t  *ngx_event_loop_stats;
+extern ngx_uint_t               ngx_event_loop_nevents;
+
+
+#endif /* _NGX_EVENT_STATS_H_INCLUDED_ */
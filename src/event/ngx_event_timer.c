@@ -10,9 +10,64 @@
 #include <ngx_event.h>
 
 
+/*
+ * The timer wheel consists of the root level of 256 one millisecond slots
+ * and four upper levels of 64 slots each, every slot of an upper level
+ * covers the whole lower level.  Timers are placed into the level that
+ * covers their expiration time and are moved down when the lower level
+ * wraps around, so they expire with one millisecond precision.
+ *
+ * The wheel reuses the timer rbtree node: the "left" and "right" fields
+ * link the slot list, and the "parent" field points to the slot head.
+ */
+
+#define NGX_TIMER_WHEEL_ROOT_BITS   8
+#define NGX_TIMER_WHEEL_BITS        6
+#define NGX_TIMER_WHEEL_LEVELS      5
+
+#define NGX_TIMER_WHEEL_ROOT_SIZE   (1 << NGX_TIMER_WHEEL_ROOT_BITS)
+#define NGX_TIMER_WHEEL_SIZE        (1 << NGX_TIMER_WHEEL_BITS)
+
+#define NGX_TIMER_WHEEL_SLOTS                                                 \
+    (NGX_TIMER_WHEEL_ROOT_SIZE                                                \
+     + (NGX_TIMER_WHEEL_LEVELS - 1) * NGX_TIMER_WHEEL_SIZE)
+
+#define NGX_TIMER_WHEEL_MAX         (ngx_msec_t) 0xffffffff
+
+#define ngx_timer_wheel_shift(n)                                              \
+    ((n) ? NGX_TIMER_WHEEL_ROOT_BITS + ((n) - 1) * NGX_TIMER_WHEEL_BITS : 0)
+
+#define ngx_timer_wheel_base(n)                                               \
+    ((n) ? NGX_TIMER_WHEEL_ROOT_SIZE + ((n) - 1) * NGX_TIMER_WHEEL_SIZE : 0)
+
+#define ngx_timer_wheel_size(n)                                               \
+    ((n) ? NGX_TIMER_WHEEL_SIZE : NGX_TIMER_WHEEL_ROOT_SIZE)
+
+
+typedef struct {
+    /* the next tick to process */
+    ngx_msec_t          current;
+    ngx_uint_t          count;
+
+    uint64_t            bitmap[NGX_TIMER_WHEEL_SLOTS / 64];
+    ngx_rbtree_node_t   slots[NGX_TIMER_WHEEL_SLOTS];
+} ngx_event_timer_wheel_t;
+
+
+static ngx_msec_t ngx_event_timer_wheel_find(void);
+static void ngx_event_timer_wheel_expire(void);
+static void ngx_event_timer_wheel_cascade(ngx_uint_t slot);
+static ngx_int_t ngx_event_timer_wheel_next(ngx_uint_t level,
+    ngx_uint_t start);
+static ngx_int_t ngx_event_timer_wheel_no_timers_left(void);
+
+
 ngx_rbtree_t              ngx_event_timer_rbtree;
 static ngx_rbtree_node_t  ngx_event_timer_sentinel;
 
+ngx_uint_t                ngx_event_timer_wheel;
+static ngx_event_timer_wheel_t  ngx_timer_wheel;
+
 /*
  * the event timer rbtree may contain the duplicate keys, however,
  * it should not be a problem, because we use the rbtree to find
@@ -22,9 +77,26 @@ static ngx_rbtree_node_t  ngx_event_timer_sentinel;
 ngx_int_t
 ngx_event_timer_init(ngx_log_t *log)
 {
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *head;
+
     ngx_rbtree_init(&ngx_event_timer_rbtree, &ngx_event_timer_sentinel,
                     ngx_rbtree_insert_timer_value);
 
+    if (ngx_event_timer_wheel) {
+        ngx_memzero(&ngx_timer_wheel, sizeof(ngx_event_timer_wheel_t));
+
+        for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+            head = &ngx_timer_wheel.slots[i];
+            head->left = head;
+            head->right = head;
+        }
+
+        ngx_timer_wheel.current = ngx_current_msec;
+
+        ngx_log_debug0(NGX_LOG_DEBUG_EVENT, log, 0, "event timer wheel");
+    }
+
     return NGX_OK;
 }
 
@@ -35,6 +107,10 @@ ngx_event_find_timer(void)
     ngx_msec_int_t      timer;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        return ngx_event_timer_wheel_find();
+    }
+
     if (ngx_event_timer_rbtree.root == &ngx_event_timer_sentinel) {
         return NGX_TIMER_INFINITE;
     }
@@ -56,6 +132,11 @@ ngx_event_expire_timers(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        ngx_event_timer_wheel_expire();
+        return;
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
 
     for ( ;; ) {
@@ -91,6 +172,13 @@ ngx_event_expire_timers(void)
 
         ev->timedout = 1;
 
+        ngx_probe2(event__timer__expire, ev, ev->handler);
+
+        if (ngx_event_loop_stats) {
+            ngx_event_stats_timer(ev);
+            continue;
+        }
+
         ev->handler(ev);
     }
 }
@@ -102,6 +190,10 @@ ngx_event_no_timers_left(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        return ngx_event_timer_wheel_no_timers_left();
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
     root = ngx_event_timer_rbtree.root;
 
@@ -124,3 +216,303 @@ ngx_event_no_timers_left(void)
 
     return NGX_OK;
 }
+
+
+void
+ngx_event_timer_wheel_insert(ngx_rbtree_node_t *node)
+{
+    ngx_uint_t          n, slot;
+    ngx_msec_t          key, delta;
+    ngx_rbtree_node_t  *head;
+
+    key = node->key;
+
+    if ((ngx_msec_int_t) (key - ngx_timer_wheel.current) < 0) {
+        key = ngx_timer_wheel.current;
+    }
+
+    delta = key - ngx_timer_wheel.current;
+
+#if (NGX_PTR_SIZE == 8)
+    if (delta > NGX_TIMER_WHEEL_MAX) {
+        delta = NGX_TIMER_WHEEL_MAX;
+        key = ngx_timer_wheel.current + delta;
+    }
+#endif
+
+    for (n = 0; n < NGX_TIMER_WHEEL_LEVELS - 1; n++) {
+        if (delta < ((ngx_msec_t) 1 << ngx_timer_wheel_shift(n + 1))) {
+            break;
+        }
+    }
+
+    slot = (key >> ngx_timer_wheel_shift(n)) & (ngx_timer_wheel_size(n) - 1);
+    slot += ngx_timer_wheel_base(n);
+
+    head = &ngx_timer_wheel.slots[slot];
+
+    node->parent = head;
+    node->left = head;
+    node->right = head->right;
+    head->right->left = node;
+    head->right = node;
+
+    ngx_timer_wheel.bitmap[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+    ngx_timer_wheel.count++;
+}
+
+
+void
+ngx_event_timer_wheel_delete(ngx_rbtree_node_t *node)
+{
+    ngx_uint_t          slot;
+    ngx_rbtree_node_t  *head;
+
+    node->left->right = node->right;
+    node->right->left = node->left;
+
+    head = node->parent;
+
+    if (head->right == head) {
+        slot = head - ngx_timer_wheel.slots;
+        ngx_timer_wheel.bitmap[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+    }
+
+    ngx_timer_wheel.count--;
+}
+
+
+static ngx_msec_t
+ngx_event_timer_wheel_find(void)
+{
+    ngx_int_t       slot;
+    ngx_uint_t      n, shift, size, found;
+    ngx_msec_t      current, base, when, next;
+    ngx_msec_int_t  timer;
+
+    if (ngx_timer_wheel.count == 0) {
+        return NGX_TIMER_INFINITE;
+    }
+
+    current = ngx_timer_wheel.current;
+    next = current;
+    found = 0;
+
+    /*
+     * a slot of the root level expires at its tick, a slot of an upper
+     * level is moved down when the current time enters its range
+     */
+
+    for (n = 0; n < NGX_TIMER_WHEEL_LEVELS; n++) {
+        shift = ngx_timer_wheel_shift(n);
+        size = ngx_timer_wheel_size(n);
+
+        base = (current + ((ngx_msec_t) 1 << shift) - 1)
+               >> shift << shift;
+
+        slot = ngx_event_timer_wheel_next(n, (base >> shift) & (size - 1));
+
+        if (slot == NGX_ERROR) {
+            continue;
+        }
+
+        when = base + ((((ngx_msec_t) slot - (base >> shift)) & (size - 1))
+                       << shift);
+
+        if (!found || (ngx_msec_int_t) (when - next) < 0) {
+            next = when;
+            found = 1;
+        }
+    }
+
+    timer = (ngx_msec_int_t) (next - ngx_current_msec);
+
+    return (ngx_msec_t) (timer > 0 ? timer : 0);
+}
+
+
+static void
+ngx_event_timer_wheel_expire(void)
+{
+    ngx_int_t           next;
+    ngx_uint_t          n, idx, slot;
+    ngx_msec_t          ticks;
+    ngx_event_t        *ev;
+    ngx_rbtree_node_t  *head, *node;
+
+    for ( ;; ) {
+
+        if ((ngx_msec_int_t) (ngx_timer_wheel.current - ngx_current_msec) > 0)
+        {
+            return;
+        }
+
+        if (ngx_timer_wheel.count == 0) {
+            ngx_timer_wheel.current = ngx_current_msec + 1;
+            return;
+        }
+
+        idx = ngx_timer_wheel.current & (NGX_TIMER_WHEEL_ROOT_SIZE - 1);
+
+        if (idx == 0) {
+
+            /* the root level wrapped around, move timers down */
+
+            for (n = 1; n < NGX_TIMER_WHEEL_LEVELS; n++) {
+                slot = (ngx_timer_wheel.current >> ngx_timer_wheel_shift(n))
+                       & (NGX_TIMER_WHEEL_SIZE - 1);
+
+                ngx_event_timer_wheel_cascade(ngx_timer_wheel_base(n) + slot);
+
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+
+        head = &ngx_timer_wheel.slots[idx];
+
+        while (head->right != head) {
+            node = head->right;
+
+            ev = ngx_rbtree_data(node, ngx_event_t, timer);
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                           "event timer del: %d: %M",
+                           ngx_event_ident(ev->data), ev->timer.key);
+
+            ngx_event_timer_wheel_delete(node);
+
+#if (NGX_DEBUG)
+            ev->timer.left = NULL;
+            ev->timer.right = NULL;
+            ev->timer.parent = NULL;
+#endif
+
+            ev->timer_set = 0;
+
+            ev->timedout = 1;
+
+            ngx_probe2(event__timer__expire, ev, ev->handler);
+
+            if (ngx_event_loop_stats) {
+                ngx_event_stats_timer(ev);
+                continue;
+            }
+
+            ev->handler(ev);
+        }
+
+        /* skip empty slots up to the next wrap around of the root level */
+
+        next = ngx_event_timer_wheel_next(0, (idx + 1)
+                                             & (NGX_TIMER_WHEEL_ROOT_SIZE - 1));
+
+        if (next == NGX_ERROR || (ngx_uint_t) next <= idx) {
+            ticks = NGX_TIMER_WHEEL_ROOT_SIZE - idx;
+
+        } else {
+            ticks = next - idx;
+        }
+
+        n = ngx_current_msec - ngx_timer_wheel.current + 1;
+
+        ngx_timer_wheel.current += ngx_min(ticks, n);
+    }
+}
+
+
+static void
+ngx_event_timer_wheel_cascade(ngx_uint_t slot)
+{
+    ngx_rbtree_node_t  *head, *node, list;
+
+    head = &ngx_timer_wheel.slots[slot];
+
+    if (head->right == head) {
+        return;
+    }
+
+    /* move the slot list aside, as timers may be placed into the same slot */
+
+    list.left = head->left;
+    list.right = head->right;
+    list.left->right = &list;
+    list.right->left = &list;
+
+    head->left = head;
+    head->right = head;
+
+    ngx_timer_wheel.bitmap[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+
+    while (list.right != &list) {
+        node = list.right;
+
+        list.right = node->right;
+        node->right->left = &list;
+
+        ngx_timer_wheel.count--;
+
+        ngx_event_timer_wheel_insert(node);
+    }
+}
+
+
+static ngx_int_t
+ngx_event_timer_wheel_next(ngx_uint_t level, ngx_uint_t start)
+{
+    uint64_t    word;
+    ngx_uint_t  i, n, base, size;
+
+    base = ngx_timer_wheel_base(level);
+    size = ngx_timer_wheel_size(level);
+
+    for (n = 0; n < size; /* void */) {
+        i = (start + n) & (size - 1);
+
+        word = ngx_timer_wheel.bitmap[(base + i) >> 6] >> (i & 63);
+
+        if (word == 0) {
+            n += 64 - (i & 63);
+            continue;
+        }
+
+        while (!(word & 1)) {
+            word >>= 1;
+            n++;
+        }
+
+        if (n >= size) {
+            break;
+        }
+
+        return (start + n) & (size - 1);
+    }
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_event_timer_wheel_no_timers_left(void)
+{
+    ngx_uint_t          i;
+    ngx_event_t        *ev;
+    ngx_rbtree_node_t  *head, *node;
+
+    for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+        head = &ngx_timer_wheel.slots[i];
+
+        for (node = head->right; node != head; node = node->right) {
+            ev = ngx_rbtree_data(node, ngx_event_t, timer);
+
+            if (!ev->cancelable) {
+                return NGX_AGAIN;
+            }
+        }
+    }
+
+    /* only cancelable timers left */
+
+    return NGX_OK;
+}
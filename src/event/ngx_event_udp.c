@@ -12,36 +12,78 @@
 
 #if !(NGX_WIN32)
 
+#if (NGX_HAVE_RECVMMSG)
+
+typedef struct mmsghdr  ngx_udp_mmsghdr_t;
+
+#else
+
+typedef struct {
+    struct msghdr       msg_hdr;
+    unsigned int        msg_len;
+} ngx_udp_mmsghdr_t;
+
+#endif
+
+
+#if (NGX_HAVE_ADDRINFO_CMSG && NGX_HAVE_GRO_CMSG)
+#define NGX_UDP_RECV_CMSG_SIZE                                                \
+    (CMSG_SPACE(sizeof(ngx_addrinfo_t)) + CMSG_SPACE(sizeof(int)))
+#elif (NGX_HAVE_ADDRINFO_CMSG)
+#define NGX_UDP_RECV_CMSG_SIZE  CMSG_SPACE(sizeof(ngx_addrinfo_t))
+#elif (NGX_HAVE_GRO_CMSG)
+#define NGX_UDP_RECV_CMSG_SIZE  CMSG_SPACE(sizeof(int))
+#endif
+
+
+#define NGX_UDP_HASH_SIZE  64
+
+
+typedef struct {
+    struct iovec        iov;
+#if (NGX_HAVE_ADDRINFO_CMSG || NGX_HAVE_GRO_CMSG)
+    u_char              msg_control[NGX_UDP_RECV_CMSG_SIZE];
+#endif
+    ngx_sockaddr_t      sockaddr;
+} ngx_udp_recv_slot_t;
+
+
+static ssize_t ngx_udp_recv_datagram(ngx_event_t *ev,
+    ngx_udp_recv_batch_t *batch, struct msghdr *msg, ssize_t n, u_char **buf);
+static ngx_int_t ngx_udp_recv_batch_alloc(ngx_uint_t n, ngx_log_t *log);
 static void ngx_close_accepted_udp_connection(ngx_connection_t *c);
 static ssize_t ngx_udp_shared_recv(ngx_connection_t *c, u_char *buf,
     size_t size);
 static ngx_int_t ngx_insert_udp_connection(ngx_connection_t *c);
+static ngx_int_t ngx_udp_hash_resize(ngx_listening_t *ls, ngx_log_t *log);
 static ngx_connection_t *ngx_lookup_udp_connection(ngx_listening_t *ls,
     struct sockaddr *sockaddr, socklen_t socklen,
     struct sockaddr *local_sockaddr, socklen_t local_socklen);
 
 
+static ngx_udp_mmsghdr_t    *ngx_udp_msgs;
+static ngx_udp_recv_slot_t  *ngx_udp_slots;
+static u_char               *ngx_udp_buffers;
+static ngx_uint_t            ngx_udp_nmsgs;
+
+
 void
 ngx_event_recvmsg(ngx_event_t *ev)
 {
-    ssize_t            n;
-    ngx_buf_t          buf;
-    ngx_log_t         *log;
-    ngx_err_t          err;
-    socklen_t          socklen, local_socklen;
-    ngx_event_t       *rev, *wev;
-    struct iovec       iov[1];
-    struct msghdr      msg;
-    ngx_sockaddr_t     sa, lsa;
-    struct sockaddr   *sockaddr, *local_sockaddr;
-    ngx_listening_t   *ls;
-    ngx_event_conf_t  *ecf;
-    ngx_connection_t  *c, *lc;
-    static u_char      buffer[65535];
-
-#if (NGX_HAVE_ADDRINFO_CMSG)
-    u_char             msg_control[CMSG_SPACE(sizeof(ngx_addrinfo_t))];
-#endif
+    u_char                *buffer;
+    ssize_t                n;
+    ngx_buf_t              buf;
+    ngx_log_t             *log;
+    ngx_err_t              err;
+    socklen_t              socklen, local_socklen;
+    ngx_event_t           *rev, *wev;
+    struct msghdr         *msg;
+    ngx_sockaddr_t         lsa;
+    struct sockaddr       *sockaddr, *local_sockaddr;
+    ngx_listening_t       *ls;
+    ngx_event_conf_t      *ecf;
+    ngx_connection_t      *c, *lc;
+    ngx_udp_recv_batch_t   batch;
 
     if (ev->timedout) {
         if (ngx_enable_accept_events((ngx_cycle_t *) ngx_cycle) != NGX_OK) {
@@ -64,27 +106,15 @@ ngx_event_recvmsg(ngx_event_t *ev)
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
                    "recvmsg on %V, ready: %d", &ls->addr_text, ev->available);
 
-    do {
-        ngx_memzero(&msg, sizeof(struct msghdr));
+    batch.size = ecf->udp_recv_batch;
+    batch.nelts = 0;
+    batch.next = 0;
+    batch.pos = NULL;
+    batch.last = NULL;
 
-        iov[0].iov_base = (void *) buffer;
-        iov[0].iov_len = sizeof(buffer);
-
-        msg.msg_name = &sa;
-        msg.msg_namelen = sizeof(ngx_sockaddr_t);
-        msg.msg_iov = iov;
-        msg.msg_iovlen = 1;
-
-#if (NGX_HAVE_ADDRINFO_CMSG)
-        if (ls->wildcard) {
-            msg.msg_control = &msg_control;
-            msg.msg_controllen = sizeof(msg_control);
-
-            ngx_memzero(&msg_control, sizeof(msg_control));
-        }
-#endif
-
-        n = recvmsg(lc->fd, &msg, 0);
+    do {
+        n = ngx_udp_recvmsg(ev, &batch, NGX_UDP_RECV_BUFFER_SIZE, &msg,
+                            &buffer);
 
         if (n == -1) {
             err = ngx_socket_errno;
@@ -100,16 +130,16 @@ ngx_event_recvmsg(ngx_event_t *ev)
             return;
         }
 
-#if (NGX_HAVE_ADDRINFO_CMSG)
-        if (msg.msg_flags & (MSG_TRUNC|MSG_CTRUNC)) {
+#if (NGX_HAVE_ADDRINFO_CMSG || NGX_HAVE_GRO_CMSG)
+        if (msg->msg_flags & (MSG_TRUNC|MSG_CTRUNC)) {
             ngx_log_error(NGX_LOG_ALERT, ev->log, 0,
                           "recvmsg() truncated data");
             continue;
         }
 #endif
 
-        sockaddr = msg.msg_name;
-        socklen = msg.msg_namelen;
+        sockaddr = msg->msg_name;
+        socklen = msg->msg_namelen;
 
         if (socklen > (socklen_t) sizeof(ngx_sockaddr_t)) {
             socklen = sizeof(ngx_sockaddr_t);
@@ -123,8 +153,8 @@ ngx_event_recvmsg(ngx_event_t *ev)
              */
 
             socklen = sizeof(struct sockaddr);
-            ngx_memzero(&sa, sizeof(struct sockaddr));
-            sa.sockaddr.sa_family = ls->sockaddr->sa_family;
+            ngx_memzero(sockaddr, sizeof(struct sockaddr));
+            sockaddr->sa_family = ls->sockaddr->sa_family;
         }
 
         local_sockaddr = ls->sockaddr;
@@ -138,9 +168,9 @@ ngx_event_recvmsg(ngx_event_t *ev)
             ngx_memcpy(&lsa, local_sockaddr, local_socklen);
             local_sockaddr = &lsa.sockaddr;
 
-            for (cmsg = CMSG_FIRSTHDR(&msg);
+            for (cmsg = CMSG_FIRSTHDR(msg);
                  cmsg != NULL;
-                 cmsg = CMSG_NXTHDR(&msg, cmsg))
+                 cmsg = CMSG_NXTHDR(msg, cmsg))
             {
                 if (ngx_get_srcaddr_cmsg(cmsg, local_sockaddr) == NGX_OK) {
                     break;
@@ -344,7 +374,222 @@ ngx_event_recvmsg(ngx_event_t *ev)
             ev->available -= n;
         }
 
-    } while (ev->available);
+    } while (ev->available || ngx_udp_recv_pending(&batch));
+}
+
+
+ssize_t
+ngx_udp_recvmsg(ngx_event_t *ev, ngx_udp_recv_batch_t *batch, size_t size,
+    struct msghdr **msg, u_char **buf)
+{
+    ssize_t               n;
+    ngx_uint_t            i, nmsgs, control;
+    struct msghdr        *m;
+    ngx_listening_t      *ls;
+    ngx_connection_t     *lc;
+    ngx_udp_recv_slot_t  *slot;
+
+    /* segments left from a datagram coalesced by GRO */
+
+    if (batch->pos < batch->last) {
+        n = ngx_min(batch->segment, (size_t) (batch->last - batch->pos));
+
+        *msg = batch->msg;
+        *buf = batch->pos;
+
+        batch->pos += n;
+
+        return n;
+    }
+
+    /* datagrams left from the previous recvmmsg() call */
+
+    if (batch->next < batch->nelts) {
+        i = batch->next++;
+
+        *msg = &ngx_udp_msgs[i].msg_hdr;
+
+        return ngx_udp_recv_datagram(ev, batch, *msg, ngx_udp_msgs[i].msg_len,
+                                     buf);
+    }
+
+    lc = ev->data;
+    ls = lc->listening;
+
+    control = 0;
+
+#if (NGX_HAVE_ADDRINFO_CMSG)
+    control |= ls->wildcard;
+#endif
+
+#if (NGX_HAVE_GRO_CMSG)
+    control |= ls->quic;
+#endif
+
+#if (NGX_HAVE_RECVMMSG)
+    nmsgs = batch->size;
+#else
+    nmsgs = 1;
+#endif
+
+    if (nmsgs > ngx_udp_nmsgs) {
+        if (ngx_udp_recv_batch_alloc(nmsgs, ev->log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    for (i = 0; i < nmsgs; i++) {
+        m = &ngx_udp_msgs[i].msg_hdr;
+        slot = &ngx_udp_slots[i];
+
+        ngx_memzero(m, sizeof(struct msghdr));
+
+        slot->iov.iov_base = ngx_udp_buffers + i * NGX_UDP_RECV_BUFFER_SIZE;
+        slot->iov.iov_len = size;
+
+        m->msg_name = &slot->sockaddr;
+        m->msg_namelen = sizeof(ngx_sockaddr_t);
+        m->msg_iov = &slot->iov;
+        m->msg_iovlen = 1;
+
+#if (NGX_HAVE_ADDRINFO_CMSG || NGX_HAVE_GRO_CMSG)
+        if (control) {
+            m->msg_control = slot->msg_control;
+            m->msg_controllen = sizeof(slot->msg_control);
+
+            ngx_memzero(slot->msg_control, sizeof(slot->msg_control));
+        }
+#endif
+    }
+
+#if (NGX_HAVE_RECVMMSG)
+
+    if (nmsgs > 1) {
+        n = recvmmsg(lc->fd, ngx_udp_msgs, nmsgs, 0, NULL);
+
+        if (n == -1) {
+            return NGX_ERROR;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "recvmmsg: %z datagrams", n);
+
+        batch->nelts = n;
+        batch->next = 1;
+
+        *msg = &ngx_udp_msgs[0].msg_hdr;
+
+        return ngx_udp_recv_datagram(ev, batch, *msg, ngx_udp_msgs[0].msg_len,
+                                     buf);
+    }
+
+#endif
+
+    *msg = &ngx_udp_msgs[0].msg_hdr;
+
+    n = recvmsg(lc->fd, *msg, 0);
+
+    if (n == -1) {
+        return NGX_ERROR;
+    }
+
+    return ngx_udp_recv_datagram(ev, batch, *msg, n, buf);
+}
+
+
+static ssize_t
+ngx_udp_recv_datagram(ngx_event_t *ev, ngx_udp_recv_batch_t *batch,
+    struct msghdr *msg, ssize_t n, u_char **buf)
+{
+#if (NGX_HAVE_GRO_CMSG)
+    size_t           segment;
+    struct cmsghdr  *cmsg;
+#endif
+
+    *buf = msg->msg_iov[0].iov_base;
+
+#if (NGX_HAVE_GRO_CMSG)
+
+    if (msg->msg_controllen == 0 || (msg->msg_flags & (MSG_TRUNC|MSG_CTRUNC)))
+    {
+        return n;
+    }
+
+    segment = 0;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO
+            && cmsg->cmsg_len >= CMSG_LEN(sizeof(int)))
+        {
+            segment = *(int *) CMSG_DATA(cmsg);
+            break;
+        }
+    }
+
+    if (segment == 0 || segment >= (size_t) n) {
+        return n;
+    }
+
+    /*
+     * the kernel has coalesced several datagrams of the same size,
+     * they are returned one by one, and the last one may be shorter
+     */
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "recvmsg: coalesced datagram n:%z segment:%uz",
+                   n, segment);
+
+    batch->msg = msg;
+    batch->pos = *buf + segment;
+    batch->last = *buf + n;
+    batch->segment = segment;
+
+    return segment;
+
+#else
+
+    return n;
+
+#endif
+}
+
+
+static ngx_int_t
+ngx_udp_recv_batch_alloc(ngx_uint_t n, ngx_log_t *log)
+{
+    u_char               *buffers;
+    ngx_udp_mmsghdr_t    *msgs;
+    ngx_udp_recv_slot_t  *slots;
+
+    /*
+     * the buffers are allocated once per process for the largest batch,
+     * and only the pages touched by received datagrams use memory
+     */
+
+    msgs = ngx_alloc(n * sizeof(ngx_udp_mmsghdr_t), log);
+    slots = ngx_alloc(n * sizeof(ngx_udp_recv_slot_t), log);
+    buffers = ngx_alloc(n * NGX_UDP_RECV_BUFFER_SIZE, log);
+
+    if (msgs == NULL || slots == NULL || buffers == NULL) {
+        ngx_free(msgs);
+        ngx_free(slots);
+        ngx_free(buffers);
+        return NGX_ERROR;
+    }
+
+    if (ngx_udp_nmsgs) {
+        ngx_free(ngx_udp_msgs);
+        ngx_free(ngx_udp_slots);
+        ngx_free(ngx_udp_buffers);
+    }
+
+    ngx_udp_msgs = msgs;
+    ngx_udp_slots = slots;
+    ngx_udp_buffers = buffers;
+    ngx_udp_nmsgs = n;
+
+    return NGX_OK;
 }
 
 
@@ -446,9 +691,10 @@ ngx_udp_rbtree_insert_value(ngx_rbtree_node_t *temp,
 static ngx_int_t
 ngx_insert_udp_connection(ngx_connection_t *c)
 {
-    uint32_t               hash;
-    ngx_pool_cleanup_t    *cln;
-    ngx_udp_connection_t  *udp;
+    uint32_t                hash;
+    ngx_listening_t        *ls;
+    ngx_pool_cleanup_t     *cln;
+    ngx_udp_connection_t   *udp, **slot;
 
     if (c->udp) {
         return NGX_OK;
@@ -474,6 +720,15 @@ ngx_insert_udp_connection(ngx_connection_t *c)
     udp->key.data = (u_char *) c->sockaddr;
     udp->key.len = c->socklen;
 
+    ls = c->listening;
+
+    if (ls->udp_hash_nelts >= ls->udp_hash_size
+        && ngx_udp_hash_resize(ls, c->log) != NGX_OK
+        && ls->udp_hash == NULL)
+    {
+        return NGX_ERROR;
+    }
+
     cln = ngx_pool_cleanup_add(c->pool, 0);
     if (cln == NULL) {
         return NGX_ERROR;
@@ -482,7 +737,12 @@ ngx_insert_udp_connection(ngx_connection_t *c)
     cln->data = c;
     cln->handler = ngx_delete_udp_connection;
 
-    ngx_rbtree_insert(&c->listening->rbtree, &udp->node);
+    slot = &ls->udp_hash[hash & (ls->udp_hash_size - 1)];
+
+    udp->next = *slot;
+    *slot = udp;
+
+    ls->udp_hash_nelts++;
 
     c->udp = udp;
 
@@ -490,16 +750,73 @@ ngx_insert_udp_connection(ngx_connection_t *c)
 }
 
 
+static ngx_int_t
+ngx_udp_hash_resize(ngx_listening_t *ls, ngx_log_t *log)
+{
+    ngx_uint_t              i, size;
+    ngx_udp_connection_t   *udp, *next, **hash;
+
+    /*
+     * the table of client sessions is doubled when it is full;
+     * it is allocated from the cycle pool, and the old table is freed
+     */
+
+    size = ls->udp_hash_size ? 2 * ls->udp_hash_size : NGX_UDP_HASH_SIZE;
+
+    hash = ngx_pcalloc(ngx_cycle->pool, size * sizeof(ngx_udp_connection_t *));
+    if (hash == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < ls->udp_hash_size; i++) {
+
+        for (udp = ls->udp_hash[i]; udp; udp = next) {
+            next = udp->next;
+
+            udp->next = hash[udp->node.key & (size - 1)];
+            hash[udp->node.key & (size - 1)] = udp;
+        }
+    }
+
+    if (ls->udp_hash) {
+        ngx_pfree(ngx_cycle->pool, ls->udp_hash);
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "udp hash size: %ui, sessions: %ui",
+                   size, ls->udp_hash_nelts);
+
+    ls->udp_hash = hash;
+    ls->udp_hash_size = size;
+
+    return NGX_OK;
+}
+
+
 void
 ngx_delete_udp_connection(void *data)
 {
     ngx_connection_t  *c = data;
 
+    ngx_listening_t        *ls;
+    ngx_udp_connection_t  **udpp;
+
     if (c->udp == NULL) {
         return;
     }
 
-    ngx_rbtree_delete(&c->listening->rbtree, &c->udp->node);
+    ls = c->listening;
+
+    for (udpp = &ls->udp_hash[c->udp->node.key & (ls->udp_hash_size - 1)];
+         *udpp;
+         udpp = &(*udpp)->next)
+    {
+        if (*udpp == c->udp) {
+            *udpp = c->udp->next;
+            ls->udp_hash_nelts--;
+            break;
+        }
+    }
 
     c->udp = NULL;
 }
@@ -512,7 +829,6 @@ ngx_lookup_udp_connection(ngx_listening_t *ls, struct sockaddr *sockaddr,
     uint32_t               hash;
     ngx_int_t              rc;
     ngx_connection_t      *c;
-    ngx_rbtree_node_t     *node, *sentinel;
     ngx_udp_connection_t  *udp;
 
 #if (NGX_HAVE_UNIX_DOMAIN)
@@ -531,8 +847,9 @@ ngx_lookup_udp_connection(ngx_listening_t *ls, struct sockaddr *sockaddr,
 
 #endif
 
-    node = ls->rbtree.root;
-    sentinel = ls->rbtree.sentinel;
+    if (ls->udp_hash == NULL) {
+        return NULL;
+    }
 
     ngx_crc32_init(hash);
     ngx_crc32_update(&hash, (u_char *) sockaddr, socklen);
@@ -543,22 +860,14 @@ ngx_lookup_udp_connection(ngx_listening_t *ls, struct sockaddr *sockaddr,
 
     ngx_crc32_final(hash);
 
-    while (node != sentinel) {
-
-        if (hash < node->key) {
-            node = node->left;
-            continue;
-        }
-
-        if (hash > node->key) {
-            node = node->right;
+    for (udp = ls->udp_hash[hash & (ls->udp_hash_size - 1)];
+         udp;
+         udp = udp->next)
+    {
+        if (udp->node.key != hash) {
             continue;
         }
 
-        /* hash == node->key */
-
-        udp = (ngx_udp_connection_t *) node;
-
         c = udp->connection;
 
         rc = ngx_cmp_sockaddr(sockaddr, socklen,
@@ -572,8 +881,6 @@ ngx_lookup_udp_connection(ngx_listening_t *ls, struct sockaddr *sockaddr,
         if (rc == 0) {
             return c;
         }
-
-        node = (rc < 0) ? node->left : node->right;
     }
 
     return NULL;
@@ -23,11 +23,43 @@
 #endif
 
 
+#if ((NGX_HAVE_MSGHDR_MSG_CONTROL) && (NGX_HAVE_UDP_GRO))
+#define NGX_HAVE_GRO_CMSG  1
+#endif
+
+
+#if ((NGX_HAVE_MSGHDR_MSG_CONTROL) && (NGX_HAVE_IP_TOS_CMSG))
+#define NGX_HAVE_ECN_CMSG  1
+#endif
+
+
+#define NGX_UDP_RECV_BUFFER_SIZE  65535
+#define NGX_UDP_RECV_BATCH_MAX    1024
+
+
+typedef struct {
+    ngx_uint_t          size;
+    ngx_uint_t          nelts;
+    ngx_uint_t          next;
+
+    /* the rest of a datagram coalesced by GRO */
+    struct msghdr      *msg;
+    u_char             *pos;
+    u_char             *last;
+    size_t              segment;
+} ngx_udp_recv_batch_t;
+
+
+#define ngx_udp_recv_pending(batch)                                           \
+    ((batch)->next < (batch)->nelts || (batch)->pos < (batch)->last)
+
+
 struct ngx_udp_connection_s {
-    ngx_rbtree_node_t   node;
-    ngx_connection_t   *connection;
-    ngx_buf_t          *buffer;
-    ngx_str_t           key;
+    ngx_rbtree_node_t      node;
+    ngx_connection_t      *connection;
+    ngx_buf_t             *buffer;
+    ngx_str_t              key;
+    ngx_udp_connection_t  *next;
 };
 
 
@@ -54,7 +86,14 @@ ngx_int_t ngx_get_srcaddr_cmsg(struct cmsghdr *cmsg,
 
 #endif
 
+#if (NGX_HAVE_ECN_CMSG)
+size_t ngx_set_ecn_cmsg(struct cmsghdr *cmsg, struct sockaddr *sockaddr,
+    ngx_uint_t ecn);
+#endif
+
 void ngx_event_recvmsg(ngx_event_t *ev);
+ssize_t ngx_udp_recvmsg(ngx_event_t *ev, ngx_udp_recv_batch_t *batch,
+    size_t size, struct msghdr **msg, u_char **buf);
 ssize_t ngx_sendmsg(ngx_connection_t *c, struct msghdr *msg, int flags);
 void ngx_udp_rbtree_insert_value(ngx_rbtree_node_t *temp,
     ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel);
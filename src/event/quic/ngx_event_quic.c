@@ -178,6 +178,15 @@ ngx_quic_apply_transport_params(ngx_connection_t *c, ngx_quic_tp_t *ctp)
         return NGX_ERROR;
     }
 
+    if (ctp->min_ack_delay > ctp->max_ack_delay * 1000) {
+        qc->error = NGX_QUIC_ERR_TRANSPORT_PARAMETER_ERROR;
+        qc->error_reason = "invalid min_ack_delay";
+
+        ngx_log_error(NGX_LOG_INFO, c->log, 0,
+                      "quic min_ack_delay is invalid");
+        return NGX_ERROR;
+    }
+
     if (ctp->max_idle_timeout > 0
         && ctp->max_idle_timeout < qc->tp.max_idle_timeout)
     {
@@ -299,6 +308,11 @@ ngx_quic_new_connection(ngx_connection_t *c, ngx_quic_conf_t *conf,
     ctp->max_ack_delay = NGX_QUIC_DEFAULT_MAX_ACK_DELAY;
     ctp->active_connection_id_limit = 2;
 
+    /* RFC 9000 acknowledgment frequency until the client asks otherwise */
+    qc->ack_threshold = NGX_QUIC_DEFAULT_ACK_FREQUENCY - 1;
+    qc->ack_delay = qc->tp.max_ack_delay;
+    qc->ack_reordering = 1;
+
     ngx_queue_init(&qc->streams.uninitialized);
     ngx_queue_init(&qc->streams.free);
 
@@ -308,12 +322,6 @@ ngx_quic_new_connection(ngx_connection_t *c, ngx_quic_conf_t *conf,
     qc->streams.client_max_streams_uni = qc->tp.initial_max_streams_uni;
     qc->streams.client_max_streams_bidi = qc->tp.initial_max_streams_bidi;
 
-    qc->congestion.window = ngx_min(10 * qc->tp.max_udp_payload_size,
-                                    ngx_max(2 * qc->tp.max_udp_payload_size,
-                                            14720));
-    qc->congestion.ssthresh = (size_t) -1;
-    qc->congestion.recovery_start = ngx_current_msec;
-
     if (pkt->validated && pkt->retried) {
         qc->tp.retry_scid.len = pkt->dcid.len;
         qc->tp.retry_scid.data = ngx_pstrdup(c->pool, &pkt->dcid);
@@ -335,6 +343,8 @@ ngx_quic_new_connection(ngx_connection_t *c, ngx_quic_conf_t *conf,
         return NULL;
     }
 
+    ngx_quic_init_congestion(c);
+
     c->idle = 1;
     ngx_reusable_connection(c, 1);
 
@@ -584,6 +594,8 @@ ngx_quic_close_connection(ngx_connection_t *c, ngx_int_t rc)
 
     ngx_quic_keys_cleanup(qc->keys);
 
+    ngx_quic_release_memory(c);
+
     ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0, "quic close completed");
 
     /* may be tested from SSL callback during SSL shutdown */
@@ -1253,6 +1265,20 @@ ngx_quic_handle_frames(ngx_connection_t *c, ngx_quic_header_t *pkt)
         case NGX_QUIC_FT_PING:
             break;
 
+        case NGX_QUIC_FT_IMMEDIATE_ACK:
+            ngx_quic_handle_immediate_ack_frame(c, pkt);
+            break;
+
+        case NGX_QUIC_FT_ACK_FREQUENCY:
+
+            if (ngx_quic_handle_ack_frequency_frame(c, &frame.u.ack_frequency)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+
+            break;
+
         case NGX_QUIC_FT_STREAM:
 
             if (ngx_quic_handle_stream_frame(c, pkt, &frame) != NGX_OK) {
@@ -16,6 +16,8 @@
 
 #define NGX_QUIC_DEFAULT_ACK_DELAY_EXPONENT  3
 #define NGX_QUIC_DEFAULT_MAX_ACK_DELAY       25
+#define NGX_QUIC_MIN_ACK_DELAY               1000 /* us */
+#define NGX_QUIC_DEFAULT_ACK_FREQUENCY       2
 #define NGX_QUIC_DEFAULT_HOST_KEY_LEN        32
 #define NGX_QUIC_SR_KEY_LEN                  32
 #define NGX_QUIC_AV_KEY_LEN                  32
@@ -27,6 +29,10 @@
 #define NGX_QUIC_STREAM_SERVER_INITIATED     0x01
 #define NGX_QUIC_STREAM_UNIDIRECTIONAL       0x02
 
+#define NGX_QUIC_CC_RENO                     0
+#define NGX_QUIC_CC_CUBIC                    1
+#define NGX_QUIC_CC_BBR                      2
+
 
 typedef ngx_int_t (*ngx_quic_init_pt)(ngx_connection_t *c);
 typedef void (*ngx_quic_shutdown_pt)(ngx_connection_t *c);
@@ -61,19 +67,45 @@ typedef struct {
 } ngx_quic_buffer_t;
 
 
+typedef struct {
+    size_t                         window;
+    size_t                         in_flight;
+    ngx_msec_t                     rtt;
+    ngx_msec_t                     rttvar;
+    ngx_msec_t                     min_rtt;
+} ngx_quic_congestion_info_t;
+
+
+typedef struct {
+    size_t                         memory;
+    ngx_uint_t                     frames;
+    ngx_uint_t                     buffers;
+    size_t                         worker_memory;
+    ngx_uint_t                     worker_frames;
+    ngx_uint_t                     worker_buffers;
+} ngx_quic_memory_info_t;
+
+
 typedef struct {
     ngx_ssl_t                     *ssl;
 
     ngx_flag_t                     retry;
     ngx_flag_t                     gso_enabled;
+    ngx_flag_t                     batch;
+    ngx_flag_t                     pacing;
+    ngx_flag_t                     ecn;
     ngx_flag_t                     disable_active_migration;
     ngx_msec_t                     handshake_timeout;
     ngx_msec_t                     idle_timeout;
     ngx_str_t                      host_key;
     size_t                         stream_buffer_size;
+    size_t                         memory_limit;
+    size_t                         worker_memory_limit;
     ngx_uint_t                     max_concurrent_streams_bidi;
     ngx_uint_t                     max_concurrent_streams_uni;
     ngx_uint_t                     active_connection_id_limit;
+    ngx_uint_t                     congestion_control;
+    ngx_uint_t                     ack_frequency;
     ngx_int_t                      stream_close_code;
     ngx_int_t                      stream_reject_code_uni;
     ngx_int_t                      stream_reject_code_bidi;
@@ -121,6 +153,12 @@ void ngx_quic_shutdown_connection(ngx_connection_t *c, ngx_uint_t err,
 ngx_int_t ngx_quic_reset_stream(ngx_connection_t *c, ngx_uint_t err);
 ngx_int_t ngx_quic_shutdown_stream(ngx_connection_t *c, int how);
 void ngx_quic_cancelable_stream(ngx_connection_t *c);
+void ngx_quic_congestion_info(ngx_connection_t *c,
+    ngx_quic_congestion_info_t *ci);
+void ngx_quic_memory_info(ngx_connection_t *c, ngx_quic_memory_info_t *mi);
+#if (NGX_HAVE_SENDMMSG)
+void ngx_quic_flush_batch(ngx_log_t *log);
+#endif
 ngx_int_t ngx_quic_get_packet_dcid(ngx_log_t *log, u_char *data, size_t len,
     ngx_str_t *dcid);
 ngx_int_t ngx_quic_derive_key(ngx_log_t *log, const char *label,
@@ -10,7 +10,9 @@
 #include <ngx_event_quic_connection.h>
 
 
-#define NGX_QUIC_MAX_ACK_GAP                 2
+/* forces an acknowledgment regardless of the ack-eliciting threshold */
+#define NGX_QUIC_ACK_IMMEDIATE               NGX_MAX_INT32_VALUE
+#define NGX_QUIC_MAX_ACK_THRESHOLD           255
 
 /* RFC 9002, 6.1.1. Packet Threshold: kPacketThreshold */
 #define NGX_QUIC_PKT_THR                     3 /* packets */
@@ -26,6 +28,7 @@ typedef struct {
     ngx_msec_t                               max_pn;
     ngx_msec_t                               oldest;
     ngx_msec_t                               newest;
+    ngx_uint_t                               ecn;    /* ECT packets */
 } ngx_quic_ack_stat_t;
 
 
@@ -37,12 +40,14 @@ static ngx_int_t ngx_quic_handle_ack_frame_range(ngx_connection_t *c,
     ngx_quic_ack_stat_t *st);
 static void ngx_quic_drop_ack_ranges(ngx_connection_t *c,
     ngx_quic_send_ctx_t *ctx, uint64_t pn);
+static void ngx_quic_handle_ecn(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
+    ngx_quic_frame_t *f, ngx_quic_ack_stat_t *st);
+static void ngx_quic_ecn_lost(ngx_connection_t *c);
+static void ngx_quic_ecn_failed(ngx_connection_t *c, ngx_quic_path_t *path,
+    char *reason);
 static ngx_int_t ngx_quic_detect_lost(ngx_connection_t *c,
     ngx_quic_ack_stat_t *st);
 static ngx_msec_t ngx_quic_pcg_duration(ngx_connection_t *c);
-static void ngx_quic_persistent_congestion(ngx_connection_t *c);
-static void ngx_quic_congestion_lost(ngx_connection_t *c,
-    ngx_quic_frame_t *frame);
 static void ngx_quic_lost_handler(ngx_event_t *ev);
 
 
@@ -66,7 +71,7 @@ ngx_quic_handle_ack_frame(ngx_connection_t *c, ngx_quic_header_t *pkt,
     ssize_t                 n;
     u_char                 *pos, *end;
     uint64_t                min, max, gap, range;
-    ngx_uint_t              i;
+    ngx_uint_t              i, newest;
     ngx_quic_ack_stat_t     send_time;
     ngx_quic_send_ctx_t    *ctx;
     ngx_quic_ack_frame_t   *ack;
@@ -100,6 +105,7 @@ ngx_quic_handle_ack_frame(ngx_connection_t *c, ngx_quic_header_t *pkt,
 
     send_time.oldest = NGX_TIMER_INFINITE;
     send_time.newest = NGX_TIMER_INFINITE;
+    send_time.ecn = 0;
 
     if (ngx_quic_handle_ack_frame_range(c, ctx, min, max, &send_time)
         != NGX_OK)
@@ -107,9 +113,12 @@ ngx_quic_handle_ack_frame(ngx_connection_t *c, ngx_quic_header_t *pkt,
         return NGX_ERROR;
     }
 
+    newest = 0;
+
     /* RFC 9000, 13.2.4.  Limiting Ranges by Tracking ACK Frames */
     if (ctx->largest_ack < max || ctx->largest_ack == NGX_QUIC_UNSET_PN) {
         ctx->largest_ack = max;
+        newest = 1;
         ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
                        "quic updated largest received ack:%uL", max);
 
@@ -170,7 +179,18 @@ ngx_quic_handle_ack_frame(ngx_connection_t *c, ngx_quic_header_t *pkt,
         }
     }
 
-    return ngx_quic_detect_lost(c, &send_time);
+    if (newest) {
+        /* counts of reordered ACK frames are not compared */
+        ngx_quic_handle_ecn(c, ctx, f, &send_time);
+    }
+
+    if (ngx_quic_detect_lost(c, &send_time) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    /* acknowledged data may have brought memory usage below the limit */
+
+    return ngx_quic_resume_flow(c);
 }
 
 
@@ -222,6 +242,7 @@ static ngx_int_t
 ngx_quic_handle_ack_frame_range(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
     uint64_t min, uint64_t max, ngx_quic_ack_stat_t *st)
 {
+    uint64_t                pnum;
     ngx_uint_t              found;
     ngx_queue_t            *q;
     ngx_quic_frame_t       *f;
@@ -236,6 +257,7 @@ ngx_quic_handle_ack_frame_range(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
     }
 
     st->max_pn = NGX_TIMER_INFINITE;
+    pnum = NGX_QUIC_UNSET_PN;
     found = 0;
 
     q = ngx_queue_head(&ctx->sent);
@@ -277,6 +299,11 @@ ngx_quic_handle_ack_frame_range(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
                 st->newest = f->send_time;
             }
 
+            if (f->ecn && f->pnum != pnum) {
+                st->ecn++;
+                pnum = f->pnum;
+            }
+
             ngx_queue_remove(&f->queue);
             ngx_quic_free_frame(c, f);
             found = 1;
@@ -310,70 +337,6 @@ ngx_quic_handle_ack_frame_range(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
 }
 
 
-void
-ngx_quic_congestion_ack(ngx_connection_t *c, ngx_quic_frame_t *f)
-{
-    ngx_uint_t              blocked;
-    ngx_msec_t              timer;
-    ngx_quic_congestion_t  *cg;
-    ngx_quic_connection_t  *qc;
-
-    if (f->plen == 0) {
-        return;
-    }
-
-    qc = ngx_quic_get_connection(c);
-    cg = &qc->congestion;
-
-    if (f->pnum < qc->rst_pnum) {
-        return;
-    }
-
-    blocked = (cg->in_flight >= cg->window) ? 1 : 0;
-
-    cg->in_flight -= f->plen;
-
-    timer = f->send_time - cg->recovery_start;
-
-    if ((ngx_msec_int_t) timer <= 0) {
-        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion ack recovery win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-
-        goto done;
-    }
-
-    if (cg->window < cg->ssthresh) {
-        cg->window += f->plen;
-
-        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion slow start win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-
-    } else {
-        cg->window += qc->tp.max_udp_payload_size * f->plen / cg->window;
-
-        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion avoidance win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-    }
-
-    /* prevent recovery_start from wrapping */
-
-    timer = cg->recovery_start - ngx_current_msec + qc->tp.max_idle_timeout * 2;
-
-    if ((ngx_msec_int_t) timer < 0) {
-        cg->recovery_start = ngx_current_msec - qc->tp.max_idle_timeout * 2;
-    }
-
-done:
-
-    if (blocked && cg->in_flight < cg->window) {
-        ngx_post_event(&qc->push, &ngx_posted_events);
-    }
-}
-
-
 static void
 ngx_quic_drop_ack_ranges(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
     uint64_t pn)
@@ -432,6 +395,153 @@ ngx_quic_drop_ack_ranges(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
 }
 
 
+static void
+ngx_quic_handle_ecn(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
+    ngx_quic_frame_t *f, ngx_quic_ack_stat_t *st)
+{
+    uint64_t                ect0, ce;
+    ngx_quic_path_t        *path;
+    ngx_quic_ack_frame_t   *ack;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    path = qc->path;
+
+    if (path->ecn == NGX_QUIC_ECN_FAILED) {
+        return;
+    }
+
+    ack = &f->u.ack;
+
+    /*
+     * RFC 9000, 13.4.2.1.  Receiving ACK Frames with ECN Counts
+     *
+     *  If an ACK frame newly acknowledges a packet that the endpoint
+     *  sent with either the ECT(0) or ECT(1) codepoint set, ECN
+     *  validation fails if the corresponding ECN counts are not present
+     *  in the ACK frame.
+     */
+
+    if (f->type != NGX_QUIC_FT_ACK_ECN) {
+        if (st->ecn) {
+            ngx_quic_ecn_failed(c, path, "no counts");
+        }
+
+        return;
+    }
+
+    if (ack->ect0 < ctx->ecn_ect0
+        || ack->ect1 < ctx->ecn_ect1
+        || ack->ce < ctx->ecn_ce)
+    {
+        ngx_quic_ecn_failed(c, path, "counts decreased");
+        return;
+    }
+
+    ect0 = ack->ect0 - ctx->ecn_ect0;
+    ce = ack->ce - ctx->ecn_ce;
+
+    /*
+     *  ECN validation also fails if the sum of the increase in ECT(0)
+     *  and ECN-CE counts is less than the number of newly acknowledged
+     *  packets that were originally sent with an ECT(0) marking.
+     */
+
+    if (ect0 + ce < st->ecn) {
+        ngx_quic_ecn_failed(c, path, "marks cleared");
+        return;
+    }
+
+    ctx->ecn_ect0 = ack->ect0;
+    ctx->ecn_ect1 = ack->ect1;
+    ctx->ecn_ce = ack->ce;
+
+    if (st->ecn && path->ecn != NGX_QUIC_ECN_CAPABLE) {
+        path->ecn = NGX_QUIC_ECN_CAPABLE;
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic ecn validated path seq:%uL", path->seqnum);
+    }
+
+    /* RFC 9002, 7.1.  Explicit Congestion Notification */
+
+    if (ce
+        && path->ecn == NGX_QUIC_ECN_CAPABLE
+        && st->newest != NGX_TIMER_INFINITE)
+    {
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic ecn ce:%uL level:%d", ce, ctx->level);
+
+        ngx_quic_congestion_ecn(c, st->newest);
+    }
+}
+
+
+void
+ngx_quic_ecn_sent(ngx_connection_t *c, ngx_quic_path_t *path, ngx_uint_t n)
+{
+    if (path->ecn != NGX_QUIC_ECN_TESTING) {
+        return;
+    }
+
+    /*
+     * RFC 9000, 13.4.2.  ECN Validation
+     *
+     *  ... an endpoint could set the ECT(0) codepoint for only the first
+     *  ten outgoing packets on a path, or for a period of three PTOs ...
+     *  If all packets marked with non-zero ECN codepoints are subsequently
+     *  lost, it can disable marking on the assumption that the marking
+     *  caused the loss.
+     */
+
+    path->ecn_tested += n;
+
+    if (path->ecn_tested >= NGX_QUIC_ECN_TESTING_PACKETS) {
+        path->ecn = NGX_QUIC_ECN_UNKNOWN;
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic ecn testing done path seq:%uL sent:%ui",
+                       path->seqnum, path->ecn_tested);
+    }
+}
+
+
+static void
+ngx_quic_ecn_lost(ngx_connection_t *c)
+{
+    ngx_quic_path_t        *path;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    path = qc->path;
+
+    if (path->ecn != NGX_QUIC_ECN_TESTING
+        && path->ecn != NGX_QUIC_ECN_UNKNOWN)
+    {
+        return;
+    }
+
+    path->ecn_lost++;
+
+    if (path->ecn == NGX_QUIC_ECN_UNKNOWN
+        && path->ecn_lost >= path->ecn_tested)
+    {
+        ngx_quic_ecn_failed(c, path, "all marked packets lost");
+    }
+}
+
+
+static void
+ngx_quic_ecn_failed(ngx_connection_t *c, ngx_quic_path_t *path, char *reason)
+{
+    path->ecn = NGX_QUIC_ECN_FAILED;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic ecn validation failed path seq:%uL: %s",
+                   path->seqnum, reason);
+}
+
+
 static ngx_int_t
 ngx_quic_detect_lost(ngx_connection_t *c, ngx_quic_ack_stat_t *st)
 {
@@ -494,6 +604,10 @@ ngx_quic_detect_lost(ngx_connection_t *c, ngx_quic_ack_stat_t *st)
                 nlost++;
             }
 
+            if (start->ecn) {
+                ngx_quic_ecn_lost(c);
+            }
+
             ngx_quic_resend_frames(c, ctx);
         }
     }
@@ -538,23 +652,6 @@ ngx_quic_pcg_duration(ngx_connection_t *c)
 }
 
 
-static void
-ngx_quic_persistent_congestion(ngx_connection_t *c)
-{
-    ngx_quic_congestion_t  *cg;
-    ngx_quic_connection_t  *qc;
-
-    qc = ngx_quic_get_connection(c);
-    cg = &qc->congestion;
-
-    cg->recovery_start = ngx_current_msec;
-    cg->window = qc->tp.max_udp_payload_size * 2;
-
-    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                   "quic persistent congestion win:%uz", cg->window);
-}
-
-
 void
 ngx_quic_resend_frames(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx)
 {
@@ -590,13 +687,14 @@ ngx_quic_resend_frames(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx)
         case NGX_QUIC_FT_ACK_ECN:
             if (ctx->level == ssl_encryption_application) {
                 /* force generation of most recent acknowledgment */
-                ctx->send_ack = NGX_QUIC_MAX_ACK_GAP;
+                ctx->send_ack = NGX_QUIC_ACK_IMMEDIATE;
             }
 
             ngx_quic_free_frame(c, f);
             break;
 
         case NGX_QUIC_FT_PING:
+        case NGX_QUIC_FT_IMMEDIATE_ACK:
         case NGX_QUIC_FT_PATH_CHALLENGE:
         case NGX_QUIC_FT_PATH_RESPONSE:
         case NGX_QUIC_FT_CONNECTION_CLOSE:
@@ -655,61 +753,6 @@ ngx_quic_resend_frames(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx)
 }
 
 
-static void
-ngx_quic_congestion_lost(ngx_connection_t *c, ngx_quic_frame_t *f)
-{
-    ngx_uint_t              blocked;
-    ngx_msec_t              timer;
-    ngx_quic_congestion_t  *cg;
-    ngx_quic_connection_t  *qc;
-
-    if (f->plen == 0) {
-        return;
-    }
-
-    qc = ngx_quic_get_connection(c);
-    cg = &qc->congestion;
-
-    if (f->pnum < qc->rst_pnum) {
-        return;
-    }
-
-    blocked = (cg->in_flight >= cg->window) ? 1 : 0;
-
-    cg->in_flight -= f->plen;
-    f->plen = 0;
-
-    timer = f->send_time - cg->recovery_start;
-
-    if ((ngx_msec_int_t) timer <= 0) {
-        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion lost recovery win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-
-        goto done;
-    }
-
-    cg->recovery_start = ngx_current_msec;
-    cg->window /= 2;
-
-    if (cg->window < qc->tp.max_udp_payload_size * 2) {
-        cg->window = qc->tp.max_udp_payload_size * 2;
-    }
-
-    cg->ssthresh = cg->window;
-
-    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                   "quic congestion lost win:%uz ss:%z if:%uz",
-                   cg->window, cg->ssthresh, cg->in_flight);
-
-done:
-
-    if (blocked && cg->in_flight < cg->window) {
-        ngx_post_event(&qc->push, &ngx_posted_events);
-    }
-}
-
-
 void
 ngx_quic_set_lost_timer(ngx_connection_t *c)
 {
@@ -883,9 +926,19 @@ ngx_quic_pto_handler(ngx_event_t *ev)
             }
 
             f->level = ctx->level;
-            f->type = NGX_QUIC_FT_PING;
             f->ignore_congestion = 1;
 
+            /* a probe should not wait for the peer's ack threshold */
+
+            if (ctx->level == ssl_encryption_application
+                && qc->ctp.min_ack_delay)
+            {
+                f->type = NGX_QUIC_FT_IMMEDIATE_ACK;
+
+            } else {
+                f->type = NGX_QUIC_FT_PING;
+            }
+
             if (ngx_quic_frame_sendto(c, f, 0, qc->path) == NGX_ERROR) {
                 goto failed;
             }
@@ -970,6 +1023,21 @@ ngx_quic_ack_packet(ngx_connection_t *c, ngx_quic_header_t *pkt)
     if (pn > base) {
 
         if (pn - base == 1) {
+
+            /*
+             * draft-ietf-quic-ack-frequency, 6.2. Expediting
+             * Acknowledgment of Out-of-Order Packets
+             *
+             * the largest missing packet is now far enough behind
+             */
+            if (pkt->need_ack
+                && ctx->nranges
+                && qc->ack_reordering > 1
+                && pn - (smallest - 1) == qc->ack_reordering)
+            {
+                ctx->send_ack = NGX_QUIC_ACK_IMMEDIATE;
+            }
+
             ctx->first_range++;
             ctx->largest_range = pn;
             ctx->largest_received = pkt->received;
@@ -1001,8 +1069,11 @@ ngx_quic_ack_packet(ngx_connection_t *c, ngx_quic_header_t *pkt)
             ctx->largest_received = pkt->received;
 
             /* packet is out of order, force send */
-            if (pkt->need_ack) {
-                ctx->send_ack = NGX_QUIC_MAX_ACK_GAP;
+            if (pkt->need_ack
+                && qc->ack_reordering
+                && gap + 1 >= qc->ack_reordering)
+            {
+                ctx->send_ack = NGX_QUIC_ACK_IMMEDIATE;
             }
 
             i = 0;
@@ -1014,8 +1085,8 @@ ngx_quic_ack_packet(ngx_connection_t *c, ngx_quic_header_t *pkt)
     /*  pn < base, perform lookup in existing ranges */
 
     /* packet is out of order */
-    if (pkt->need_ack) {
-        ctx->send_ack = NGX_QUIC_MAX_ACK_GAP;
+    if (pkt->need_ack && qc->ack_reordering == 1) {
+        ctx->send_ack = NGX_QUIC_ACK_IMMEDIATE;
     }
 
     if (pn >= smallest && pn <= largest) {
@@ -1165,12 +1236,11 @@ ngx_quic_generate_ack(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx)
         qc = ngx_quic_get_connection(c);
 
         if (ngx_queue_empty(&ctx->frames)
-            && ctx->send_ack < NGX_QUIC_MAX_ACK_GAP
-            && delay < qc->tp.max_ack_delay)
+            && ctx->send_ack <= qc->ack_threshold
+            && delay < qc->ack_delay)
         {
             if (!qc->push.timer_set && !qc->closing) {
-                ngx_add_timer(&qc->push,
-                              qc->tp.max_ack_delay - delay);
+                ngx_add_timer(&qc->push, qc->ack_delay - delay);
             }
 
             return NGX_OK;
@@ -1185,3 +1255,105 @@ ngx_quic_generate_ack(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx)
 
     return NGX_OK;
 }
+
+
+ngx_int_t
+ngx_quic_handle_ack_frequency_frame(ngx_connection_t *c,
+    ngx_quic_ack_frequency_frame_t *f)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    /*
+     * draft-ietf-quic-ack-frequency, 4. ACK_FREQUENCY Frame
+     *
+     * Receipt of a value of Requested Max Ack Delay that is less than
+     * the min_ack_delay transport parameter MUST be treated as
+     * a connection error of type PROTOCOL_VIOLATION.
+     */
+
+    if (f->max_ack_delay < qc->tp.min_ack_delay) {
+        qc->error = NGX_QUIC_ERR_PROTOCOL_VIOLATION;
+        qc->error_reason = "invalid requested max ack delay";
+        return NGX_ERROR;
+    }
+
+    /* frames with an older sequence number are ignored */
+
+    if (f->sequence_number < qc->ack_frequency_seqnum) {
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic ack frequency seq:%uL ignored, expected:%uL",
+                       f->sequence_number, qc->ack_frequency_seqnum);
+        return NGX_OK;
+    }
+
+    qc->ack_frequency_seqnum = f->sequence_number + 1;
+
+    /* acknowledging more often than asked is always allowed */
+
+    qc->ack_threshold = ngx_min(f->threshold, NGX_QUIC_MAX_ACK_THRESHOLD);
+    qc->ack_delay = ngx_min(f->max_ack_delay / 1000, 16383);
+    qc->ack_reordering = ngx_min(f->reordering, NGX_QUIC_MAX_ACK_THRESHOLD);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic ack frequency threshold:%ui delay:%M reordering:%ui",
+                   qc->ack_threshold, qc->ack_delay, qc->ack_reordering);
+
+    return NGX_OK;
+}
+
+
+void
+ngx_quic_handle_immediate_ack_frame(ngx_connection_t *c,
+    ngx_quic_header_t *pkt)
+{
+    ngx_quic_send_ctx_t    *ctx;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    ctx = ngx_quic_get_send_ctx(qc, pkt->level);
+
+    ctx->send_ack = NGX_QUIC_ACK_IMMEDIATE;
+}
+
+
+ngx_int_t
+ngx_quic_send_ack_frequency(ngx_connection_t *c)
+{
+    ngx_quic_frame_t       *frame;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    if (qc->conf->ack_frequency == NGX_QUIC_DEFAULT_ACK_FREQUENCY
+        || qc->ctp.min_ack_delay == 0)
+    {
+        return NGX_OK;
+    }
+
+    frame = ngx_quic_alloc_frame(c);
+    if (frame == NULL) {
+        return NGX_ERROR;
+    }
+
+    /*
+     * the peer keeps its own max_ack_delay, so that the PTO computed
+     * from it stays valid; the reordering threshold matches the packet
+     * threshold, since an earlier acknowledgment does not make a packet
+     * declared lost any sooner
+     */
+
+    frame->level = ssl_encryption_application;
+    frame->type = NGX_QUIC_FT_ACK_FREQUENCY;
+    frame->u.ack_frequency.sequence_number = 0;
+    frame->u.ack_frequency.threshold = qc->conf->ack_frequency - 1;
+    frame->u.ack_frequency.max_ack_delay =
+                            ngx_max((uint64_t) qc->ctp.max_ack_delay * 1000,
+                                    qc->ctp.min_ack_delay);
+    frame->u.ack_frequency.reordering = NGX_QUIC_PKT_THR;
+
+    ngx_quic_queue_frame(qc, frame);
+
+    return NGX_OK;
+}
@@ -12,11 +12,26 @@
 #include <ngx_core.h>
 
 
+/* RFC 9000, 13.4.2.  ECN Validation */
+#define NGX_QUIC_ECN_FAILED                  0
+#define NGX_QUIC_ECN_TESTING                 1
+#define NGX_QUIC_ECN_UNKNOWN                 2
+#define NGX_QUIC_ECN_CAPABLE                 3
+
+#define NGX_QUIC_ECN_TESTING_PACKETS         10
+
+/* RFC 3168, 5.  Explicit Congestion Notification in IP: ECT(0) */
+#define NGX_QUIC_ECN_ECT0                    0x02
+
+
+#define ngx_quic_ecn_marking(path)                                            \
+    (((path)->ecn == NGX_QUIC_ECN_TESTING                                     \
+      || (path)->ecn == NGX_QUIC_ECN_CAPABLE) ? NGX_QUIC_ECN_ECT0 : 0)
+
+
 ngx_int_t ngx_quic_handle_ack_frame(ngx_connection_t *c,
     ngx_quic_header_t *pkt, ngx_quic_frame_t *f);
 
-void ngx_quic_congestion_ack(ngx_connection_t *c,
-    ngx_quic_frame_t *frame);
 void ngx_quic_resend_frames(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx);
 void ngx_quic_set_lost_timer(ngx_connection_t *c);
 void ngx_quic_pto_handler(ngx_event_t *ev);
@@ -27,4 +42,13 @@ ngx_int_t ngx_quic_ack_packet(ngx_connection_t *c,
 ngx_int_t ngx_quic_generate_ack(ngx_connection_t *c,
     ngx_quic_send_ctx_t *ctx);
 
+ngx_int_t ngx_quic_handle_ack_frequency_frame(ngx_connection_t *c,
+    ngx_quic_ack_frequency_frame_t *f);
+void ngx_quic_handle_immediate_ack_frame(ngx_connection_t *c,
+    ngx_quic_header_t *pkt);
+ngx_int_t ngx_quic_send_ack_frequency(ngx_connection_t *c);
+
+void ngx_quic_ecn_sent(ngx_connection_t *c, ngx_quic_path_t *path,
+    ngx_uint_t n);
+
 #endif /* _NGX_EVENT_QUIC_ACK_H_INCLUDED_ */
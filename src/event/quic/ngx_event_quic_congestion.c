@@ -0,0 +1,841 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+#include <ngx_event_quic_connection.h>
+
+
+#define NGX_QUIC_PACING_BURST                10 /* packets */
+
+#define NGX_QUIC_BBR_STARTUP                 0
+#define NGX_QUIC_BBR_DRAIN                   1
+#define NGX_QUIC_BBR_PROBE_BW                2
+
+#define NGX_QUIC_BBR_CYCLE_LEN               8
+#define NGX_QUIC_BBR_BW_ROUNDS               10
+#define NGX_QUIC_BBR_FULL_BW_ROUNDS          3
+#define NGX_QUIC_BBR_MIN_WINDOW              4 /* packets */
+#define NGX_QUIC_BBR_MIN_LOST                3 /* packets */
+#define NGX_QUIC_BBR_MAX_PROBE_UP            4
+
+
+#define ngx_quic_in_recovery(cg, f)                                           \
+    ((ngx_msec_int_t) ((f)->send_time - (cg)->recovery_start) <= 0)
+
+
+static void ngx_quic_reno_init(ngx_connection_t *c);
+static void ngx_quic_reno_ack(ngx_connection_t *c, ngx_quic_frame_t *f);
+static void ngx_quic_reno_lost(ngx_connection_t *c, ngx_quic_frame_t *f);
+static void ngx_quic_reno_persistent(ngx_connection_t *c);
+static void ngx_quic_cubic_init(ngx_connection_t *c);
+static void ngx_quic_cubic_ack(ngx_connection_t *c, ngx_quic_frame_t *f);
+static void ngx_quic_cubic_lost(ngx_connection_t *c, ngx_quic_frame_t *f);
+static void ngx_quic_cubic_persistent(ngx_connection_t *c);
+static uint64_t ngx_quic_cubic_root(uint64_t x);
+static void ngx_quic_bbr_init(ngx_connection_t *c);
+static void ngx_quic_bbr_ack(ngx_connection_t *c, ngx_quic_frame_t *f);
+static void ngx_quic_bbr_round(ngx_connection_t *c);
+static void ngx_quic_bbr_lost(ngx_connection_t *c, ngx_quic_frame_t *f);
+static void ngx_quic_bbr_persistent(ngx_connection_t *c);
+static size_t ngx_quic_bbr_bdp(ngx_connection_t *c);
+
+
+static ngx_quic_congestion_ops_t  ngx_quic_reno = {
+    ngx_string("reno"),
+    ngx_quic_reno_init,
+    ngx_quic_reno_ack,
+    ngx_quic_reno_lost,
+    ngx_quic_reno_persistent
+};
+
+
+static ngx_quic_congestion_ops_t  ngx_quic_cubic = {
+    ngx_string("cubic"),
+    ngx_quic_cubic_init,
+    ngx_quic_cubic_ack,
+    ngx_quic_cubic_lost,
+    ngx_quic_cubic_persistent
+};
+
+
+static ngx_quic_congestion_ops_t  ngx_quic_bbr = {
+    ngx_string("bbr"),
+    ngx_quic_bbr_init,
+    ngx_quic_bbr_ack,
+    ngx_quic_bbr_lost,
+    ngx_quic_bbr_persistent
+};
+
+
+/* indexed by NGX_QUIC_CC_* */
+
+static ngx_quic_congestion_ops_t  *ngx_quic_congestion_controls[] = {
+    &ngx_quic_reno,
+    &ngx_quic_cubic,
+    &ngx_quic_bbr
+};
+
+
+/* probe up, probe down, cruise; percents of the estimated BDP */
+
+static ngx_uint_t  ngx_quic_bbr_cycle_gain[NGX_QUIC_BBR_CYCLE_LEN] = {
+    175, 125, 150, 150, 150, 150, 150, 150
+};
+
+
+void
+ngx_quic_init_congestion(ngx_connection_t *c)
+{
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    ngx_memzero(cg, sizeof(ngx_quic_congestion_t));
+
+    cg->ops = ngx_quic_congestion_controls[qc->conf->congestion_control];
+    cg->ssthresh = (size_t) -1;
+    cg->recovery_start = ngx_current_msec;
+
+    cg->ops->init(c);
+
+    cg->pacing_budget = cg->window;
+    cg->pacing_time = ngx_current_msec;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic congestion %V win:%uz", &cg->ops->name, cg->window);
+}
+
+
+void
+ngx_quic_congestion_info(ngx_connection_t *c, ngx_quic_congestion_info_t *ci)
+{
+    ngx_connection_t       *pc;
+    ngx_quic_connection_t  *qc;
+
+    pc = c->quic ? c->quic->parent : c;
+    qc = ngx_quic_get_connection(pc);
+
+    ci->window = qc->congestion.window;
+    ci->in_flight = qc->congestion.in_flight;
+    ci->rtt = qc->avg_rtt;
+    ci->rttvar = qc->rttvar;
+    ci->min_rtt = qc->min_rtt;
+}
+
+
+void
+ngx_quic_congestion_ack(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    ngx_uint_t              blocked;
+    ngx_msec_t              timer;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    if (f->plen == 0) {
+        return;
+    }
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    if (f->pnum < qc->rst_pnum) {
+        return;
+    }
+
+    blocked = (cg->in_flight >= cg->window) ? 1 : 0;
+
+    cg->in_flight -= f->plen;
+
+    cg->ops->ack(c, f);
+
+    /* prevent recovery_start from wrapping */
+
+    timer = cg->recovery_start - ngx_current_msec + qc->tp.max_idle_timeout * 2;
+
+    if ((ngx_msec_int_t) timer < 0) {
+        cg->recovery_start = ngx_current_msec - qc->tp.max_idle_timeout * 2;
+    }
+
+    if (blocked && cg->in_flight < cg->window) {
+        ngx_post_event(&qc->push, &ngx_posted_events);
+    }
+}
+
+
+void
+ngx_quic_congestion_lost(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    ngx_uint_t              blocked;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    if (f->plen == 0) {
+        return;
+    }
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    if (f->pnum < qc->rst_pnum) {
+        return;
+    }
+
+    blocked = (cg->in_flight >= cg->window) ? 1 : 0;
+
+    cg->in_flight -= f->plen;
+
+    cg->ops->lost(c, f);
+
+    f->plen = 0;
+
+    if (blocked && cg->in_flight < cg->window) {
+        ngx_post_event(&qc->push, &ngx_posted_events);
+    }
+}
+
+
+void
+ngx_quic_congestion_ecn(ngx_connection_t *c, ngx_msec_t send_time)
+{
+    ngx_quic_frame_t        f;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    /*
+     * RFC 9002, 7.1.  Explicit Congestion Notification
+     *
+     *  If a path has been validated to support Explicit Congestion
+     *  Notification (ECN), QUIC treats a Congestion Experienced (CE)
+     *  codepoint in the IP header as a signal of congestion.
+     *
+     * the congestion controller reacts as if a packet sent at the time
+     * was lost, bytes in flight are not affected
+     */
+
+    ngx_memzero(&f, sizeof(ngx_quic_frame_t));
+
+    f.send_time = send_time;
+    f.plen = qc->path->mtu;
+
+    cg->ops->lost(c, &f);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic congestion ecn win:%uz if:%uz",
+                   cg->window, cg->in_flight);
+}
+
+
+void
+ngx_quic_persistent_congestion(ngx_connection_t *c)
+{
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    cg->recovery_start = ngx_current_msec;
+
+    cg->ops->persistent(c);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic persistent congestion win:%uz", cg->window);
+}
+
+
+/*
+ * The pacer spreads the congestion window over the smoothed RTT: the
+ * budget is refilled at window / RTT, twice as fast in slow start and
+ * with a 25% margin otherwise, and holds at most 10 packets or 2ms
+ * worth of data.  When the budget is exhausted, the push event is
+ * scheduled for when the next packet may be sent.
+ */
+
+size_t
+ngx_quic_pacing_budget(ngx_connection_t *c)
+{
+    size_t                  rate, burst, mtu;
+    ngx_msec_t              now, elapsed, delay;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    if (!qc->conf->pacing || !c->ssl->handshaked) {
+        return (size_t) -1;
+    }
+
+    mtu = qc->path->mtu;
+
+    /* bytes per millisecond */
+
+    rate = cg->window / ngx_max(qc->avg_rtt, 1);
+    rate = (cg->window < cg->ssthresh) ? rate * 2 : rate * 5 / 4;
+    rate = ngx_max(rate, 1);
+
+    burst = ngx_max(NGX_QUIC_PACING_BURST * mtu, rate * 2);
+
+    now = ngx_current_msec;
+    elapsed = now - cg->pacing_time;
+
+    if (elapsed) {
+        cg->pacing_time = now;
+
+        if (elapsed >= burst / rate) {
+            cg->pacing_budget = burst;
+
+        } else {
+            cg->pacing_budget = ngx_min(cg->pacing_budget + rate * elapsed,
+                                        burst);
+        }
+    }
+
+    if (cg->pacing_budget) {
+        return cg->pacing_budget;
+    }
+
+    if (!qc->push.timer_set) {
+        delay = ngx_max((mtu + rate - 1) / rate, 1);
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic pacing delay:%M rate:%uz", delay, rate);
+
+        ngx_add_timer(&qc->push, delay);
+    }
+
+    return 0;
+}
+
+
+void
+ngx_quic_pacing_sent(ngx_connection_t *c, size_t len)
+{
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    /* the last packet may exceed the budget */
+
+    cg->pacing_budget = (cg->pacing_budget > len) ? cg->pacing_budget - len
+                                                  : 0;
+}
+
+
+static void
+ngx_quic_reno_init(ngx_connection_t *c)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    qc->congestion.window = ngx_min(10 * qc->tp.max_udp_payload_size,
+                                    ngx_max(2 * qc->tp.max_udp_payload_size,
+                                            14720));
+}
+
+
+static void
+ngx_quic_reno_ack(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    if (ngx_quic_in_recovery(cg, f)) {
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion ack recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+        return;
+    }
+
+    if (cg->window < cg->ssthresh) {
+        cg->window += f->plen;
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion slow start win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+    } else {
+        cg->window += qc->tp.max_udp_payload_size * f->plen / cg->window;
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion avoidance win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+    }
+}
+
+
+static void
+ngx_quic_reno_lost(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    if (ngx_quic_in_recovery(cg, f)) {
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion lost recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+        return;
+    }
+
+    cg->recovery_start = ngx_current_msec;
+    cg->window /= 2;
+
+    if (cg->window < qc->tp.max_udp_payload_size * 2) {
+        cg->window = qc->tp.max_udp_payload_size * 2;
+    }
+
+    cg->ssthresh = cg->window;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic congestion lost win:%uz ss:%z if:%uz",
+                   cg->window, cg->ssthresh, cg->in_flight);
+}
+
+
+static void
+ngx_quic_reno_persistent(ngx_connection_t *c)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    qc->congestion.window = qc->tp.max_udp_payload_size * 2;
+}
+
+
+/*
+ * CUBIC and BBR operate on the maximum datagram size of the current path,
+ * RFC 9002, 7.2. Initial and Minimum Congestion Window
+ */
+
+static void
+ngx_quic_cubic_init(ngx_connection_t *c)
+{
+    size_t                  mss;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    mss = qc->path ? qc->path->mtu : NGX_QUIC_MIN_INITIAL_SIZE;
+
+    qc->congestion.window = ngx_min(10 * mss, ngx_max(2 * mss, 14720));
+}
+
+
+static void
+ngx_quic_cubic_ack(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    size_t                  mss, target;
+    int64_t                 t, offset;
+    ngx_msec_t              now;
+    ngx_quic_cubic_t       *cu;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+    cu = &cg->u.cubic;
+
+    if (ngx_quic_in_recovery(cg, f)) {
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic cubic ack recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+        return;
+    }
+
+    if (cg->window < cg->ssthresh) {
+        cg->window += f->plen;
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic cubic slow start win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+        return;
+    }
+
+    mss = qc->path->mtu;
+    now = ngx_current_msec;
+
+    if (cu->w_est == 0) {
+
+        /* RFC 9438, 4.2. Window Increase Function, new congestion epoch */
+
+        cu->epoch_start = now;
+        cu->w_est = cg->window;
+
+        if (cg->window < cu->w_max) {
+
+            /* K = cbrt((W_max - cwnd) / C), C = 0.4, in milliseconds */
+
+            cu->k = ngx_quic_cubic_root((uint64_t) (cu->w_max - cg->window)
+                                        * 25000 / mss * 100000);
+
+        } else {
+            cu->k = 0;
+            cu->w_max = cg->window;
+        }
+    }
+
+    /* W_cubic(t + RTT) = C * (t + RTT - K)^3 + W_max */
+
+    t = (int64_t) (now - cu->epoch_start + qc->avg_rtt) - (int64_t) cu->k;
+    t = ngx_min(t, 1000000);
+    t = ngx_max(t, -1000000);
+
+    offset = t * t * t / 10000000 * 4 * (int64_t) mss / 1000;
+
+    if ((int64_t) cu->w_max + offset < 0) {
+        target = 0;
+
+    } else {
+        target = cu->w_max + offset;
+    }
+
+    target = ngx_min(target, cg->window * 3 / 2);
+
+    /* RFC 9438, 4.3. Reno-Friendly Region, alpha = 3 * (1 - 0.7) / (1 + 0.7) */
+
+    cu->w_est += (uint64_t) mss * f->plen * 9 / 17 / cg->window;
+
+    if (target < cu->w_est) {
+        target = cu->w_est;
+    }
+
+    if (target > cg->window) {
+        cg->window += (uint64_t) (target - cg->window) * f->plen / cg->window;
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic cubic avoidance win:%uz target:%uz max:%uz if:%uz",
+                   cg->window, target, cu->w_max, cg->in_flight);
+}
+
+
+static void
+ngx_quic_cubic_lost(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    size_t                  mss;
+    ngx_quic_cubic_t       *cu;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+    cu = &cg->u.cubic;
+
+    if (ngx_quic_in_recovery(cg, f)) {
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic cubic lost recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+        return;
+    }
+
+    mss = qc->path->mtu;
+
+    cg->recovery_start = ngx_current_msec;
+
+    /* RFC 9438, 4.7. Fast Convergence */
+
+    if (cg->window < cu->w_max) {
+        cu->w_max = cg->window * 17 / 20;
+
+    } else {
+        cu->w_max = cg->window;
+    }
+
+    /* RFC 9438, 4.6. Multiplicative Decrease, beta = 0.7 */
+
+    cg->window = ngx_max(cg->window * 7 / 10, 2 * mss);
+    cg->ssthresh = cg->window;
+
+    cu->w_est = 0;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic cubic lost win:%uz ss:%z if:%uz",
+                   cg->window, cg->ssthresh, cg->in_flight);
+}
+
+
+static void
+ngx_quic_cubic_persistent(ngx_connection_t *c)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    qc->congestion.window = 2 * qc->path->mtu;
+    qc->congestion.u.cubic.w_est = 0;
+}
+
+
+static uint64_t
+ngx_quic_cubic_root(uint64_t x)
+{
+    uint64_t  lo, hi, mid;
+
+    lo = 0;
+    hi = 1 << 21;
+
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+
+        if (mid * mid * mid <= x) {
+            lo = mid;
+
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return lo;
+}
+
+
+/*
+ * A model-based controller after BBR: the window follows the estimated
+ * bandwidth-delay product, the maximum delivery rate measured per round
+ * trip over the last 10 rounds times the minimum RTT.  As there is no
+ * pacing, gains are applied to the window.  Losses do not reduce the
+ * window directly; as in BBRv2, a round with more than 2% of bytes lost
+ * ends startup and caps the window by inflight_hi, which is then probed
+ * upwards by 1, 2, 4, up to 16 packets per round until losses are seen
+ * again.
+ */
+
+static void
+ngx_quic_bbr_init(ngx_connection_t *c)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    ngx_quic_cubic_init(c);
+
+    qc->congestion.u.bbr.round_start = ngx_current_msec;
+}
+
+
+static void
+ngx_quic_bbr_ack(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    size_t                  bdp, target;
+    ngx_quic_bbr_t         *bbr;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+    bbr = &cg->u.bbr;
+
+    bbr->delivered += f->plen;
+
+    if (f->level == ssl_encryption_application && f->pnum >= bbr->round_end) {
+        ngx_quic_bbr_round(c);
+    }
+
+    bdp = ngx_quic_bbr_bdp(c);
+
+    if (bbr->state == NGX_QUIC_BBR_STARTUP || bdp == 0) {
+        cg->window += f->plen;
+        goto done;
+    }
+
+    if (bbr->state == NGX_QUIC_BBR_DRAIN) {
+        target = bdp;
+
+    } else {
+        target = (uint64_t) bdp * ngx_quic_bbr_cycle_gain[bbr->cycle] / 100;
+    }
+
+    if (bbr->inflight_hi) {
+        target = ngx_min(target, bbr->inflight_hi);
+    }
+
+    target = ngx_max(target, NGX_QUIC_BBR_MIN_WINDOW * qc->path->mtu);
+
+    if (cg->window > target) {
+        cg->window = target;
+
+    } else if (bbr->state != NGX_QUIC_BBR_DRAIN) {
+        cg->window = ngx_min(cg->window + f->plen, target);
+    }
+
+done:
+
+    ngx_log_debug5(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic bbr ack state:%ui win:%uz bdp:%uz hi:%uz if:%uz",
+                   bbr->state, cg->window, bdp, bbr->inflight_hi,
+                   cg->in_flight);
+}
+
+
+static void
+ngx_quic_bbr_round(ngx_connection_t *c)
+{
+    size_t                  min;
+    uint64_t                bw, acked;
+    ngx_msec_t              now, elapsed;
+    ngx_uint_t              excessive;
+    ngx_quic_bbr_t         *bbr;
+    ngx_quic_send_ctx_t    *ctx;
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+    bbr = &cg->u.bbr;
+
+    now = ngx_current_msec;
+    elapsed = ngx_max(now - bbr->round_start, 1);
+
+    acked = bbr->delivered - bbr->round_delivered;
+    bw = acked * 1000 / elapsed;
+
+    if (++bbr->rounds % NGX_QUIC_BBR_BW_ROUNDS == 0) {
+        bbr->bw[1] = bbr->bw[0];
+        bbr->bw[0] = 0;
+    }
+
+    bbr->bw[0] = ngx_max(bbr->bw[0], bw);
+    bw = ngx_max(bbr->bw[0], bbr->bw[1]);
+
+    /* loss rate above 2% */
+    excessive = (bbr->lost >= NGX_QUIC_BBR_MIN_LOST * qc->path->mtu
+                 && bbr->lost * 50 > bbr->lost + acked);
+
+    min = NGX_QUIC_BBR_MIN_WINDOW * qc->path->mtu;
+
+    switch (bbr->state) {
+
+    case NGX_QUIC_BBR_STARTUP:
+
+        if (excessive) {
+            bbr->inflight_hi = ngx_max(cg->window * 7 / 10, min);
+            bbr->state = NGX_QUIC_BBR_DRAIN;
+            break;
+        }
+
+        if (bw >= bbr->full_bw * 5 / 4) {
+            bbr->full_bw = bw;
+            bbr->full_bw_count = 0;
+            break;
+        }
+
+        if (++bbr->full_bw_count >= NGX_QUIC_BBR_FULL_BW_ROUNDS) {
+            bbr->state = NGX_QUIC_BBR_DRAIN;
+        }
+
+        break;
+
+    case NGX_QUIC_BBR_DRAIN:
+
+        if (cg->in_flight <= ngx_quic_bbr_bdp(c)) {
+            bbr->state = NGX_QUIC_BBR_PROBE_BW;
+            bbr->cycle = 0;
+        }
+
+        break;
+
+    default: /* NGX_QUIC_BBR_PROBE_BW */
+
+        if (excessive) {
+            bbr->inflight_hi = ngx_max(cg->window * 7 / 10, min);
+
+        } else if (bbr->cycle == 0 && bbr->inflight_hi
+                   && cg->window >= bbr->inflight_hi)
+        {
+            /* probing up continues while the window is capped */
+
+            bbr->inflight_hi += qc->path->mtu << bbr->probe_up;
+
+            if (bbr->probe_up < NGX_QUIC_BBR_MAX_PROBE_UP) {
+                bbr->probe_up++;
+            }
+
+            break;
+        }
+
+        bbr->probe_up = 0;
+        bbr->cycle = (bbr->cycle + 1) % NGX_QUIC_BBR_CYCLE_LEN;
+    }
+
+    ngx_log_debug6(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic bbr round:%ui state:%ui bw:%uL acked:%uL lost:%uz "
+                   "elapsed:%M", bbr->rounds, bbr->state, bw, acked,
+                   bbr->lost, elapsed);
+
+    ctx = ngx_quic_get_send_ctx(qc, ssl_encryption_application);
+
+    bbr->round_end = ctx->pnum;
+    bbr->round_start = now;
+    bbr->round_delivered = bbr->delivered;
+    bbr->lost = 0;
+}
+
+
+static void
+ngx_quic_bbr_lost(ngx_connection_t *c, ngx_quic_frame_t *f)
+{
+    ngx_quic_congestion_t  *cg;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    cg->u.bbr.lost += f->plen;
+
+    if (!ngx_quic_in_recovery(cg, f)) {
+        cg->recovery_start = ngx_current_msec;
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic bbr lost win:%uz lost:%uz if:%uz",
+                   cg->window, cg->u.bbr.lost, cg->in_flight);
+}
+
+
+static void
+ngx_quic_bbr_persistent(ngx_connection_t *c)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    qc->congestion.window = NGX_QUIC_BBR_MIN_WINDOW * qc->path->mtu;
+}
+
+
+static size_t
+ngx_quic_bbr_bdp(ngx_connection_t *c)
+{
+    ngx_quic_bbr_t         *bbr;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+    bbr = &qc->congestion.u.bbr;
+
+    if (qc->min_rtt == NGX_TIMER_INFINITE) {
+        return 0;
+    }
+
+    return ngx_max(bbr->bw[0], bbr->bw[1])
+           * ngx_max(qc->min_rtt, 1) / 1000;
+}
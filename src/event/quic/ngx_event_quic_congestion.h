@@ -0,0 +1,78 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_EVENT_QUIC_CONGESTION_H_INCLUDED_
+#define _NGX_EVENT_QUIC_CONGESTION_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+typedef struct {
+    size_t                            w_max;
+    size_t                            w_est;
+    ngx_msec_t                        epoch_start;
+    ngx_msec_t                        k;
+} ngx_quic_cubic_t;
+
+
+typedef struct {
+    ngx_uint_t                        state;
+    ngx_uint_t                        cycle;
+    ngx_uint_t                        rounds;
+    uint64_t                          round_end;
+    ngx_msec_t                        round_start;
+    uint64_t                          round_delivered;
+    uint64_t                          delivered;
+    size_t                            lost;
+    uint64_t                          bw[2];
+    uint64_t                          full_bw;
+    ngx_uint_t                        full_bw_count;
+    size_t                            inflight_hi;
+    ngx_uint_t                        probe_up;
+} ngx_quic_bbr_t;
+
+
+typedef struct ngx_quic_congestion_ops_s  ngx_quic_congestion_ops_t;
+
+typedef struct {
+    ngx_quic_congestion_ops_t        *ops;
+    size_t                            in_flight;
+    size_t                            window;
+    size_t                            ssthresh;
+    ngx_msec_t                        recovery_start;
+
+    size_t                            pacing_budget;
+    ngx_msec_t                        pacing_time;
+
+    union {
+        ngx_quic_cubic_t              cubic;
+        ngx_quic_bbr_t                bbr;
+    } u;
+} ngx_quic_congestion_t;
+
+
+struct ngx_quic_congestion_ops_s {
+    ngx_str_t                         name;
+    void                            (*init)(ngx_connection_t *c);
+    void                            (*ack)(ngx_connection_t *c,
+                                           ngx_quic_frame_t *f);
+    void                            (*lost)(ngx_connection_t *c,
+                                            ngx_quic_frame_t *f);
+    void                            (*persistent)(ngx_connection_t *c);
+};
+
+
+void ngx_quic_init_congestion(ngx_connection_t *c);
+void ngx_quic_congestion_ack(ngx_connection_t *c, ngx_quic_frame_t *f);
+void ngx_quic_congestion_lost(ngx_connection_t *c, ngx_quic_frame_t *f);
+void ngx_quic_congestion_ecn(ngx_connection_t *c, ngx_msec_t send_time);
+void ngx_quic_persistent_congestion(ngx_connection_t *c);
+size_t ngx_quic_pacing_budget(ngx_connection_t *c);
+void ngx_quic_pacing_sent(ngx_connection_t *c, size_t len);
+
+#endif /* _NGX_EVENT_QUIC_CONGESTION_H_INCLUDED_ */
@@ -37,6 +37,7 @@ typedef struct ngx_quic_keys_s        ngx_quic_keys_t;
 #include <ngx_event_quic_ssl.h>
 #include <ngx_event_quic_tokens.h>
 #include <ngx_event_quic_ack.h>
+#include <ngx_event_quic_congestion.h>
 #include <ngx_event_quic_output.h>
 #include <ngx_event_quic_socket.h>
 
@@ -113,6 +114,9 @@ struct ngx_quic_path_s {
     size_t                            max_mtu;
     off_t                             sent;
     off_t                             received;
+    ngx_uint_t                        ecn;
+    ngx_uint_t                        ecn_tested;
+    ngx_uint_t                        ecn_lost;
     u_char                            challenge[2][8];
     uint64_t                          seqnum;
     uint64_t                          mtu_pnum[NGX_QUIC_PATH_RETRIES];
@@ -161,17 +165,11 @@ typedef struct {
 
     ngx_uint_t                        initialized;
                                                  /* unsigned  initialized:1; */
+    ngx_uint_t                        flow_blocked;
+                                                 /* unsigned  flow_blocked:1; */
 } ngx_quic_streams_t;
 
 
-typedef struct {
-    size_t                            in_flight;
-    size_t                            window;
-    size_t                            ssthresh;
-    ngx_msec_t                        recovery_start;
-} ngx_quic_congestion_t;
-
-
 /*
  * RFC 9000, 12.3.  Packet Numbers
  *
@@ -202,6 +200,10 @@ struct ngx_quic_send_ctx_s {
     ngx_uint_t                        nranges;
     ngx_quic_ack_range_t              ranges[NGX_QUIC_MAX_RANGES];
     ngx_uint_t                        send_ack;
+
+    uint64_t                          ecn_ect0;    /* reported by peer */
+    uint64_t                          ecn_ect1;
+    uint64_t                          ecn_ce;
 };
 
 
@@ -249,11 +251,18 @@ struct ngx_quic_connection_s {
 
     ngx_uint_t                        pto_count;
 
+    uint64_t                          ack_frequency_seqnum;
+    ngx_uint_t                        ack_threshold;
+    ngx_msec_t                        ack_delay;
+    ngx_uint_t                        ack_reordering;
+
     ngx_queue_t                       free_frames;
     ngx_buf_t                        *free_bufs;
     ngx_buf_t                        *free_shadow_bufs;
 
     ngx_uint_t                        nframes;
+    ngx_uint_t                        nfree_bufs;
+    ngx_quic_mem_stat_t               mem;
 #ifdef NGX_QUIC_DEBUG_ALLOC
     ngx_uint_t                        nbufs;
     ngx_uint_t                        nshadowbufs;
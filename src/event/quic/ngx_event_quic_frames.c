@@ -10,7 +10,8 @@
 #include <ngx_event_quic_connection.h>
 
 
-#define NGX_QUIC_BUFFER_SIZE  4096
+#define NGX_QUIC_BUFFER_SIZE     4096
+#define NGX_QUIC_MAX_FREE_BUFS   16
 
 #define ngx_quic_buf_refs(b)         (b)->shadow->num
 #define ngx_quic_buf_inc_refs(b)     ngx_quic_buf_refs(b)++
@@ -25,6 +26,10 @@ static ngx_int_t ngx_quic_split_chain(ngx_connection_t *c, ngx_chain_t *cl,
     off_t offset);
 
 
+/* frames and buffers held by all QUIC connections of the worker */
+static ngx_quic_mem_stat_t  ngx_quic_worker_mem;
+
+
 static ngx_buf_t *
 ngx_quic_alloc_buf(ngx_connection_t *c)
 {
@@ -38,6 +43,7 @@ ngx_quic_alloc_buf(ngx_connection_t *c)
 
     if (b) {
         qc->free_bufs = b->shadow;
+        qc->nfree_bufs--;
         p = b->start;
 
     } else {
@@ -68,8 +74,14 @@ ngx_quic_alloc_buf(ngx_connection_t *c)
         if (p == NULL) {
             return NULL;
         }
+
+        qc->mem.memory += NGX_QUIC_BUFFER_SIZE;
+        ngx_quic_worker_mem.memory += NGX_QUIC_BUFFER_SIZE;
     }
 
+    qc->mem.buffers++;
+    ngx_quic_worker_mem.buffers++;
+
 #ifdef NGX_QUIC_DEBUG_ALLOC
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0, "quic alloc buffer %p", b);
 #endif
@@ -110,8 +122,29 @@ ngx_quic_free_buf(ngx_connection_t *c, ngx_buf_t *b)
     shadow = b->shadow;
 
     if (ngx_quic_buf_refs(b) == 0) {
-        shadow->shadow = qc->free_bufs;
-        qc->free_bufs = shadow;
+        qc->mem.buffers--;
+        ngx_quic_worker_mem.buffers--;
+
+        /*
+         * buffer memory is a large pool allocation, it is returned
+         * to the allocator instead of growing the free list
+         */
+
+        if ((qc->nfree_bufs >= NGX_QUIC_MAX_FREE_BUFS
+             || ngx_quic_memory_exceeded(c))
+            && ngx_pfree(c->pool, shadow->start) == NGX_OK)
+        {
+            qc->mem.memory -= NGX_QUIC_BUFFER_SIZE;
+            ngx_quic_worker_mem.memory -= NGX_QUIC_BUFFER_SIZE;
+
+            shadow->shadow = qc->free_shadow_bufs;
+            qc->free_shadow_bufs = shadow;
+
+        } else {
+            shadow->shadow = qc->free_bufs;
+            qc->free_bufs = shadow;
+            qc->nfree_bufs++;
+        }
     }
 
     if (b != shadow) {
@@ -222,6 +255,9 @@ ngx_quic_alloc_frame(ngx_connection_t *c)
 
         ++qc->nframes;
 
+        qc->mem.memory += sizeof(ngx_quic_frame_t);
+        ngx_quic_worker_mem.memory += sizeof(ngx_quic_frame_t);
+
 #ifdef NGX_QUIC_DEBUG_ALLOC
         ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
                        "quic alloc frame n:%ui", qc->nframes);
@@ -234,6 +270,9 @@ ngx_quic_alloc_frame(ngx_connection_t *c)
 
     ngx_memzero(frame, sizeof(ngx_quic_frame_t));
 
+    qc->mem.frames++;
+    ngx_quic_worker_mem.frames++;
+
     return frame;
 }
 
@@ -251,6 +290,9 @@ ngx_quic_free_frame(ngx_connection_t *c, ngx_quic_frame_t *frame)
 
     ngx_queue_insert_head(&qc->free_frames, &frame->queue);
 
+    qc->mem.frames--;
+    ngx_quic_worker_mem.frames--;
+
 #ifdef NGX_QUIC_DEBUG_ALLOC
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "quic free frame n:%ui", qc->nframes);
@@ -652,6 +694,63 @@ ngx_quic_free_buffer(ngx_connection_t *c, ngx_quic_buffer_t *qb)
 }
 
 
+ngx_uint_t
+ngx_quic_memory_exceeded(ngx_connection_t *c)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    if (qc->conf->memory_limit && qc->mem.memory > qc->conf->memory_limit) {
+        return 1;
+    }
+
+    if (qc->conf->worker_memory_limit
+        && ngx_quic_worker_mem.memory > qc->conf->worker_memory_limit)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+
+void
+ngx_quic_release_memory(ngx_connection_t *c)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic release memory:%uz frames:%ui buffers:%ui",
+                   qc->mem.memory, qc->mem.frames, qc->mem.buffers);
+
+    ngx_quic_worker_mem.memory -= qc->mem.memory;
+    ngx_quic_worker_mem.frames -= qc->mem.frames;
+    ngx_quic_worker_mem.buffers -= qc->mem.buffers;
+
+    ngx_memzero(&qc->mem, sizeof(ngx_quic_mem_stat_t));
+}
+
+
+void
+ngx_quic_memory_info(ngx_connection_t *c, ngx_quic_memory_info_t *mi)
+{
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    mi->memory = qc->mem.memory;
+    mi->frames = qc->mem.frames;
+    mi->buffers = qc->mem.buffers;
+
+    mi->worker_memory = ngx_quic_worker_mem.memory;
+    mi->worker_frames = ngx_quic_worker_mem.frames;
+    mi->worker_buffers = ngx_quic_worker_mem.buffers;
+}
+
+
 #if (NGX_DEBUG)
 
 void
@@ -882,6 +981,20 @@ ngx_quic_log_frame(ngx_log_t *log, ngx_quic_frame_t *f, ngx_uint_t tx)
         p = ngx_slprintf(p, last, "HANDSHAKE DONE");
         break;
 
+    case NGX_QUIC_FT_IMMEDIATE_ACK:
+        p = ngx_slprintf(p, last, "IMMEDIATE_ACK");
+        break;
+
+    case NGX_QUIC_FT_ACK_FREQUENCY:
+        p = ngx_slprintf(p, last,
+                         "ACK_FREQUENCY seq:%uL threshold:%uL"
+                         " delay:%uL reordering:%uL",
+                         f->u.ack_frequency.sequence_number,
+                         f->u.ack_frequency.threshold,
+                         f->u.ack_frequency.max_ack_delay,
+                         f->u.ack_frequency.reordering);
+        break;
+
     default:
         p = ngx_slprintf(p, last, "unknown type 0x%xi", f->type);
         break;
@@ -12,6 +12,13 @@
 #include <ngx_core.h>
 
 
+typedef struct {
+    size_t                  memory;
+    ngx_uint_t              frames;
+    ngx_uint_t              buffers;
+} ngx_quic_mem_stat_t;
+
+
 typedef ngx_int_t (*ngx_quic_frame_handler_pt)(ngx_connection_t *c,
     ngx_quic_frame_t *frame, void *data);
 
@@ -36,6 +43,9 @@ void ngx_quic_skip_buffer(ngx_connection_t *c, ngx_quic_buffer_t *qb,
     uint64_t offset);
 void ngx_quic_free_buffer(ngx_connection_t *c, ngx_quic_buffer_t *qb);
 
+ngx_uint_t ngx_quic_memory_exceeded(ngx_connection_t *c);
+void ngx_quic_release_memory(ngx_connection_t *c);
+
 #if (NGX_DEBUG)
 void ngx_quic_log_frame(ngx_log_t *log, ngx_quic_frame_t *f, ngx_uint_t tx);
 #else
@@ -180,13 +180,7 @@ valid:
         ctx = ngx_quic_get_send_ctx(qc, ssl_encryption_application);
         qc->rst_pnum = ctx->pnum;
 
-        ngx_memzero(&qc->congestion, sizeof(ngx_quic_congestion_t));
-
-        qc->congestion.window = ngx_min(10 * qc->tp.max_udp_payload_size,
-                                   ngx_max(2 * qc->tp.max_udp_payload_size,
-                                           14720));
-        qc->congestion.ssthresh = (size_t) -1;
-        qc->congestion.recovery_start = ngx_current_msec;
+        ngx_quic_init_congestion(c);
 
         ngx_quic_init_rtt(qc);
     }
@@ -265,6 +259,12 @@ ngx_quic_new_path(ngx_connection_t *c,
 
     path->mtu = NGX_QUIC_MIN_INITIAL_SIZE;
 
+#if (NGX_HAVE_ECN_CMSG)
+    if (qc->conf->ecn) {
+        path->ecn = NGX_QUIC_ECN_TESTING;
+    }
+#endif
+
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "quic path seq:%uL created addr:%V",
                    path->seqnum, &path->addr_text);
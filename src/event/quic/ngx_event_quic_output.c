@@ -34,6 +34,63 @@
 
 #define NGX_QUIC_SOCKET_RETRY_DELAY      10 /* ms, for NGX_AGAIN on write */
 
+#if (NGX_HAVE_ADDRINFO_CMSG)
+#define NGX_QUIC_ADDRINFO_CMSG_SPACE     CMSG_SPACE(sizeof(ngx_addrinfo_t))
+#else
+#define NGX_QUIC_ADDRINFO_CMSG_SPACE     0
+#endif
+
+#if (NGX_HAVE_ECN_CMSG)
+#define NGX_QUIC_ECN_CMSG_SPACE          CMSG_SPACE(sizeof(int))
+#else
+#define NGX_QUIC_ECN_CMSG_SPACE          0
+#endif
+
+
+#if (NGX_HAVE_SENDMMSG)
+
+#define NGX_QUIC_BATCH_MSGS              64
+#define NGX_QUIC_BATCH_BUFFER        262144
+
+#if ((NGX_HAVE_UDP_SEGMENT) && (NGX_HAVE_MSGHDR_MSG_CONTROL))
+#define NGX_QUIC_SEGMENT_CMSG_SPACE      CMSG_SPACE(sizeof(uint16_t))
+#else
+#define NGX_QUIC_SEGMENT_CMSG_SPACE      0
+#endif
+
+#if ((NGX_HAVE_UDP_SEGMENT) && (NGX_HAVE_MSGHDR_MSG_CONTROL)                  \
+     || NGX_HAVE_ADDRINFO_CMSG || NGX_HAVE_ECN_CMSG)
+#define NGX_QUIC_BATCH_CMSG              1
+#endif
+
+
+typedef struct {
+    struct iovec             iov;
+#if (NGX_QUIC_BATCH_CMSG)
+    char                     msg_control[NGX_QUIC_SEGMENT_CMSG_SPACE
+                                         + NGX_QUIC_ADDRINFO_CMSG_SPACE
+                                         + NGX_QUIC_ECN_CMSG_SPACE];
+#endif
+    ngx_sockaddr_t           sockaddr;
+} ngx_quic_batch_slot_t;
+
+
+/*
+ * datagrams of all connections sent in an event loop iteration are
+ * collected per worker process and sent with a single sendmmsg()
+ */
+
+typedef struct {
+    ngx_socket_t             fd;
+    ngx_uint_t               nmsgs;
+    size_t                   size;
+    struct mmsghdr          *msgs;
+    ngx_quic_batch_slot_t   *slots;
+    u_char                  *buffer;
+} ngx_quic_batch_t;
+
+#endif
+
 
 #define ngx_quic_log_packet(log, pkt)                                         \
     ngx_log_debug6(NGX_LOG_DEBUG_EVENT, log, 0,                               \
@@ -45,24 +102,36 @@
 
 
 static ngx_int_t ngx_quic_create_datagrams(ngx_connection_t *c);
-static void ngx_quic_commit_send(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx);
+static void ngx_quic_commit_send(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
+    ngx_uint_t ecn);
 static void ngx_quic_revert_send(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
     uint64_t pnum);
 #if ((NGX_HAVE_UDP_SEGMENT) && (NGX_HAVE_MSGHDR_MSG_CONTROL))
 static ngx_uint_t ngx_quic_allow_segmentation(ngx_connection_t *c);
 static ngx_int_t ngx_quic_create_segments(ngx_connection_t *c);
 static ssize_t ngx_quic_send_segments(ngx_connection_t *c, u_char *buf,
-    size_t len, struct sockaddr *sockaddr, socklen_t socklen, size_t segment);
+    size_t len, struct sockaddr *sockaddr, socklen_t socklen, size_t segment,
+    ngx_uint_t ecn);
 #endif
 static ssize_t ngx_quic_output_packet(ngx_connection_t *c,
-    ngx_quic_send_ctx_t *ctx, u_char *data, size_t max, size_t min);
+    ngx_quic_send_ctx_t *ctx, u_char *data, size_t max, size_t min,
+    ngx_quic_hp_batch_t *hb);
 static void ngx_quic_init_packet(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
     ngx_quic_header_t *pkt, ngx_quic_path_t *path);
 static ngx_uint_t ngx_quic_get_padding_level(ngx_connection_t *c);
 static ssize_t ngx_quic_send(ngx_connection_t *c, u_char *buf, size_t len,
-    struct sockaddr *sockaddr, socklen_t socklen);
+    struct sockaddr *sockaddr, socklen_t socklen, ngx_uint_t ecn);
 static void ngx_quic_set_packet_number(ngx_quic_header_t *pkt,
     ngx_quic_send_ctx_t *ctx);
+#if (NGX_HAVE_SENDMMSG)
+static ssize_t ngx_quic_batch_send(ngx_connection_t *c, u_char *buf,
+    size_t len, struct sockaddr *sockaddr, socklen_t socklen, size_t segment,
+    ngx_uint_t ecn);
+static ngx_int_t ngx_quic_batch_alloc(ngx_log_t *log);
+
+
+static ngx_quic_batch_t  ngx_quic_batch;
+#endif
 
 
 ngx_int_t
@@ -116,7 +185,7 @@ ngx_quic_create_datagrams(ngx_connection_t *c)
     ssize_t                 n;
     u_char                 *p;
     uint64_t                preserved_pnum[NGX_QUIC_SEND_CTX_LAST];
-    ngx_uint_t              i, pad;
+    ngx_uint_t              i, pad, ecn;
     ngx_quic_path_t        *path;
     ngx_quic_send_ctx_t    *ctx;
     ngx_quic_congestion_t  *cg;
@@ -129,6 +198,10 @@ ngx_quic_create_datagrams(ngx_connection_t *c)
 
     while (cg->in_flight < cg->window) {
 
+        if (ngx_quic_pacing_budget(c) == 0) {
+            break;
+        }
+
         p = dst;
 
         len = ngx_quic_path_limit(c, path, path->mtu);
@@ -159,7 +232,7 @@ ngx_quic_create_datagrams(ngx_connection_t *c)
                 return NGX_OK;
             }
 
-            n = ngx_quic_output_packet(c, ctx, p, len, min);
+            n = ngx_quic_output_packet(c, ctx, p, len, min, NULL);
             if (n == NGX_ERROR) {
                 return NGX_ERROR;
             }
@@ -173,7 +246,18 @@ ngx_quic_create_datagrams(ngx_connection_t *c)
             break;
         }
 
-        n = ngx_quic_send(c, dst, len, path->sockaddr, path->socklen);
+        ecn = ngx_quic_ecn_marking(path);
+
+#if (NGX_HAVE_SENDMMSG)
+        if (qc->conf->batch) {
+            n = ngx_quic_batch_send(c, dst, len, path->sockaddr,
+                                    path->socklen, 0, ecn);
+        } else
+#endif
+        {
+            n = ngx_quic_send(c, dst, len, path->sockaddr, path->socklen,
+                              ecn);
+        }
 
         if (n == NGX_ERROR) {
             return NGX_ERROR;
@@ -189,9 +273,15 @@ ngx_quic_create_datagrams(ngx_connection_t *c)
         }
 
         for (i = 0; i < NGX_QUIC_SEND_CTX_LAST; i++) {
-            ngx_quic_commit_send(c, &qc->send_ctx[i]);
+            ngx_quic_commit_send(c, &qc->send_ctx[i], ecn);
+        }
+
+        if (ecn) {
+            ngx_quic_ecn_sent(c, path, 1);
         }
 
+        ngx_quic_pacing_sent(c, len);
+
         path->sent += len;
     }
 
@@ -200,7 +290,8 @@ ngx_quic_create_datagrams(ngx_connection_t *c)
 
 
 static void
-ngx_quic_commit_send(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx)
+ngx_quic_commit_send(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
+    ngx_uint_t ecn)
 {
     ngx_queue_t            *q;
     ngx_quic_frame_t       *f;
@@ -221,6 +312,8 @@ ngx_quic_commit_send(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx)
         if (f->pkt_need_ack && !qc->closing) {
             ngx_queue_insert_tail(&ctx->sent, q);
 
+            f->ecn = ecn ? 1 : 0;
+
             cg->in_flight += f->plen;
 
         } else {
@@ -308,21 +401,24 @@ ngx_quic_allow_segmentation(ngx_connection_t *c)
 static ngx_int_t
 ngx_quic_create_segments(ngx_connection_t *c)
 {
-    size_t                  len, segsize;
-    ssize_t                 n;
-    u_char                 *p, *end;
-    uint64_t                preserved_pnum;
-    ngx_uint_t              nseg;
-    ngx_quic_path_t        *path;
-    ngx_quic_send_ctx_t    *ctx;
-    ngx_quic_congestion_t  *cg;
-    ngx_quic_connection_t  *qc;
-    static u_char           dst[NGX_QUIC_MAX_UDP_SEGMENT_BUF];
+    size_t                       len, segsize, budget;
+    ssize_t                      n;
+    u_char                      *p, *end;
+    uint64_t                     preserved_pnum;
+    ngx_uint_t                   nseg, ecn;
+    ngx_quic_path_t             *path;
+    ngx_quic_send_ctx_t         *ctx;
+    ngx_quic_congestion_t       *cg;
+    ngx_quic_connection_t       *qc;
+    static ngx_quic_hp_batch_t   hb;
+    static u_char                dst[NGX_QUIC_MAX_UDP_SEGMENT_BUF];
 
     qc = ngx_quic_get_connection(c);
     cg = &qc->congestion;
     path = qc->path;
 
+    hb.n = 0;
+
     ctx = ngx_quic_get_send_ctx(qc, ssl_encryption_application);
 
     if (ngx_quic_generate_ack(c, ctx) != NGX_OK) {
@@ -337,13 +433,17 @@ ngx_quic_create_segments(ngx_connection_t *c)
 
     preserved_pnum = ctx->pnum;
 
+    budget = ngx_quic_pacing_budget(c);
+
     for ( ;; ) {
 
         len = ngx_min(segsize, (size_t) (end - p));
 
-        if (len && cg->in_flight + (p - dst) < cg->window) {
+        if (len && cg->in_flight + (p - dst) < cg->window
+            && (size_t) (p - dst) < budget)
+        {
 
-            n = ngx_quic_output_packet(c, ctx, p, len, len);
+            n = ngx_quic_output_packet(c, ctx, p, len, len, &hb);
             if (n == NGX_ERROR) {
                 return NGX_ERROR;
             }
@@ -362,8 +462,24 @@ ngx_quic_create_segments(ngx_connection_t *c)
         }
 
         if (n == 0 || nseg == NGX_QUIC_MAX_SEGMENTS) {
-            n = ngx_quic_send_segments(c, dst, p - dst, path->sockaddr,
-                                       path->socklen, segsize);
+
+            if (ngx_quic_protect_headers(&hb, c->log) != NGX_OK) {
+                return NGX_ERROR;
+            }
+
+            ecn = ngx_quic_ecn_marking(path);
+
+#if (NGX_HAVE_SENDMMSG)
+            if (qc->conf->batch) {
+                n = ngx_quic_batch_send(c, dst, p - dst, path->sockaddr,
+                                        path->socklen, segsize, ecn);
+            } else
+#endif
+            {
+                n = ngx_quic_send_segments(c, dst, p - dst, path->sockaddr,
+                                           path->socklen, segsize, ecn);
+            }
+
             if (n == NGX_ERROR) {
                 return NGX_ERROR;
             }
@@ -375,13 +491,21 @@ ngx_quic_create_segments(ngx_connection_t *c)
                 break;
             }
 
-            ngx_quic_commit_send(c, ctx);
+            ngx_quic_commit_send(c, ctx, ecn);
+
+            if (ecn) {
+                ngx_quic_ecn_sent(c, path, nseg);
+            }
+
+            ngx_quic_pacing_sent(c, n);
 
             path->sent += n;
 
             p = dst;
             nseg = 0;
             preserved_pnum = ctx->pnum;
+
+            budget = ngx_quic_pacing_budget(c);
         }
     }
 
@@ -391,7 +515,8 @@ ngx_quic_create_segments(ngx_connection_t *c)
 
 static ssize_t
 ngx_quic_send_segments(ngx_connection_t *c, u_char *buf, size_t len,
-    struct sockaddr *sockaddr, socklen_t socklen, size_t segment)
+    struct sockaddr *sockaddr, socklen_t socklen, size_t segment,
+    ngx_uint_t ecn)
 {
     size_t           clen;
     ssize_t          n;
@@ -400,12 +525,9 @@ ngx_quic_send_segments(ngx_connection_t *c, u_char *buf, size_t len,
     struct msghdr    msg;
     struct cmsghdr  *cmsg;
 
-#if (NGX_HAVE_ADDRINFO_CMSG)
     char             msg_control[CMSG_SPACE(sizeof(uint16_t))
-                             + CMSG_SPACE(sizeof(ngx_addrinfo_t))];
-#else
-    char             msg_control[CMSG_SPACE(sizeof(uint16_t))];
-#endif
+                                 + NGX_QUIC_ADDRINFO_CMSG_SPACE
+                                 + NGX_QUIC_ECN_CMSG_SPACE];
 
     ngx_memzero(&msg, sizeof(struct msghdr));
     ngx_memzero(msg_control, sizeof(msg_control));
@@ -440,6 +562,13 @@ ngx_quic_send_segments(ngx_connection_t *c, u_char *buf, size_t len,
     }
 #endif
 
+#if (NGX_HAVE_ECN_CMSG)
+    if (ecn) {
+        cmsg = (struct cmsghdr *) (msg_control + clen);
+        clen += ngx_set_ecn_cmsg(cmsg, sockaddr, ecn);
+    }
+#endif
+
     msg.msg_controllen = clen;
 
     n = ngx_sendmsg(c, &msg, 0);
@@ -501,7 +630,7 @@ ngx_quic_get_padding_level(ngx_connection_t *c)
 
 static ssize_t
 ngx_quic_output_packet(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
-    u_char *data, size_t max, size_t min)
+    u_char *data, size_t max, size_t min, ngx_quic_hp_batch_t *hb)
 {
     size_t                  len, pad, min_payload, max_payload;
     u_char                 *p;
@@ -618,7 +747,14 @@ ngx_quic_output_packet(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
 
     ngx_quic_log_packet(c->log, &pkt);
 
-    if (ngx_quic_encrypt(&pkt, &res) != NGX_OK) {
+    if (hb) {
+        rc = ngx_quic_encrypt_batch(&pkt, &res, hb);
+
+    } else {
+        rc = ngx_quic_encrypt(&pkt, &res);
+    }
+
+    if (rc != NGX_OK) {
         return NGX_ERROR;
     }
 
@@ -686,14 +822,16 @@ ngx_quic_init_packet(ngx_connection_t *c, ngx_quic_send_ctx_t *ctx,
 
 static ssize_t
 ngx_quic_send(ngx_connection_t *c, u_char *buf, size_t len,
-    struct sockaddr *sockaddr, socklen_t socklen)
+    struct sockaddr *sockaddr, socklen_t socklen, ngx_uint_t ecn)
 {
     ssize_t          n;
     struct iovec     iov;
     struct msghdr    msg;
-#if (NGX_HAVE_ADDRINFO_CMSG)
+#if (NGX_HAVE_ADDRINFO_CMSG || NGX_HAVE_ECN_CMSG)
+    size_t           clen;
     struct cmsghdr  *cmsg;
-    char             msg_control[CMSG_SPACE(sizeof(ngx_addrinfo_t))];
+    char             msg_control[NGX_QUIC_ADDRINFO_CMSG_SPACE
+                                 + NGX_QUIC_ECN_CMSG_SPACE];
 #endif
 
     ngx_memzero(&msg, sizeof(struct msghdr));
@@ -707,17 +845,36 @@ ngx_quic_send(ngx_connection_t *c, u_char *buf, size_t len,
     msg.msg_name = sockaddr;
     msg.msg_namelen = socklen;
 
+#if (NGX_HAVE_ADDRINFO_CMSG || NGX_HAVE_ECN_CMSG)
+
+    msg.msg_control = msg_control;
+    msg.msg_controllen = sizeof(msg_control);
+    ngx_memzero(msg_control, sizeof(msg_control));
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    clen = 0;
+
 #if (NGX_HAVE_ADDRINFO_CMSG)
     if (c->listening && c->listening->wildcard && c->local_sockaddr) {
+        clen = ngx_set_srcaddr_cmsg(cmsg, c->local_sockaddr);
+    }
+#endif
 
-        msg.msg_control = msg_control;
-        msg.msg_controllen = sizeof(msg_control);
-        ngx_memzero(msg_control, sizeof(msg_control));
+#if (NGX_HAVE_ECN_CMSG)
+    if (ecn) {
+        cmsg = (struct cmsghdr *) (msg_control + clen);
+        clen += ngx_set_ecn_cmsg(cmsg, sockaddr, ecn);
+    }
+#endif
 
-        cmsg = CMSG_FIRSTHDR(&msg);
+    if (clen) {
+        msg.msg_controllen = clen;
 
-        msg.msg_controllen = ngx_set_srcaddr_cmsg(cmsg, c->local_sockaddr);
+    } else {
+        msg.msg_control = NULL;
+        msg.msg_controllen = 0;
     }
+
 #endif
 
     n = ngx_sendmsg(c, &msg, 0);
@@ -731,6 +888,197 @@ ngx_quic_send(ngx_connection_t *c, u_char *buf, size_t len,
 }
 
 
+#if (NGX_HAVE_SENDMMSG)
+
+static ssize_t
+ngx_quic_batch_send(ngx_connection_t *c, u_char *buf, size_t len,
+    struct sockaddr *sockaddr, socklen_t socklen, size_t segment,
+    ngx_uint_t ecn)
+{
+    u_char                 *p;
+    struct msghdr          *msg;
+    ngx_quic_batch_slot_t  *slot;
+#if (NGX_QUIC_BATCH_CMSG)
+    size_t                  clen;
+    struct cmsghdr         *cmsg;
+#endif
+#if ((NGX_HAVE_UDP_SEGMENT) && (NGX_HAVE_MSGHDR_MSG_CONTROL))
+    uint16_t               *valp;
+#endif
+
+    if (ngx_quic_batch.buffer == NULL) {
+        if (ngx_quic_batch_alloc(c->log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (ngx_quic_batch.nmsgs == NGX_QUIC_BATCH_MSGS
+        || ngx_quic_batch.size + len > NGX_QUIC_BATCH_BUFFER
+        || (ngx_quic_batch.nmsgs && ngx_quic_batch.fd != c->fd))
+    {
+        ngx_quic_flush_batch(c->log);
+    }
+
+    slot = &ngx_quic_batch.slots[ngx_quic_batch.nmsgs];
+    msg = &ngx_quic_batch.msgs[ngx_quic_batch.nmsgs].msg_hdr;
+
+    /* the datagram is copied, as the connection may be closed before flush */
+
+    p = ngx_quic_batch.buffer + ngx_quic_batch.size;
+    ngx_memcpy(p, buf, len);
+    ngx_memcpy(&slot->sockaddr, sockaddr, socklen);
+
+    slot->iov.iov_base = p;
+    slot->iov.iov_len = len;
+
+    ngx_memzero(msg, sizeof(struct msghdr));
+
+    msg->msg_iov = &slot->iov;
+    msg->msg_iovlen = 1;
+
+    msg->msg_name = &slot->sockaddr;
+    msg->msg_namelen = socklen;
+
+#if (NGX_QUIC_BATCH_CMSG)
+
+    ngx_memzero(slot->msg_control, sizeof(slot->msg_control));
+
+    msg->msg_control = slot->msg_control;
+    clen = 0;
+
+#if ((NGX_HAVE_UDP_SEGMENT) && (NGX_HAVE_MSGHDR_MSG_CONTROL))
+    if (segment) {
+        cmsg = (struct cmsghdr *) slot->msg_control;
+
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+        valp = (void *) CMSG_DATA(cmsg);
+        *valp = segment;
+
+        clen = CMSG_SPACE(sizeof(uint16_t));
+    }
+#endif
+
+#if (NGX_HAVE_ADDRINFO_CMSG)
+    if (c->listening && c->listening->wildcard && c->local_sockaddr) {
+        cmsg = (struct cmsghdr *) (slot->msg_control + clen);
+        clen += ngx_set_srcaddr_cmsg(cmsg, c->local_sockaddr);
+    }
+#endif
+
+#if (NGX_HAVE_ECN_CMSG)
+    if (ecn) {
+        cmsg = (struct cmsghdr *) (slot->msg_control + clen);
+        clen += ngx_set_ecn_cmsg(cmsg, sockaddr, ecn);
+    }
+#endif
+
+    if (clen) {
+        msg->msg_controllen = clen;
+
+    } else {
+        msg->msg_control = NULL;
+    }
+
+#endif
+
+    ngx_quic_batch.fd = c->fd;
+    ngx_quic_batch.nmsgs++;
+    ngx_quic_batch.size += len;
+
+    c->sent += len;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic batch add %uz bytes segment:%uz total:%ui",
+                   len, segment, ngx_quic_batch.nmsgs);
+
+    return len;
+}
+
+
+void
+ngx_quic_flush_batch(ngx_log_t *log)
+{
+    int         n;
+    ngx_err_t   err;
+    ngx_uint_t  i;
+
+    /*
+     * the frames of the datagrams are already accounted as sent,
+     * so the datagrams which cannot be sent are recovered as lost
+     */
+
+    i = 0;
+
+    while (i < ngx_quic_batch.nmsgs) {
+
+        n = sendmmsg(ngx_quic_batch.fd, &ngx_quic_batch.msgs[i],
+                     ngx_quic_batch.nmsgs - i, 0);
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            if (err == NGX_EAGAIN) {
+                ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, err,
+                               "sendmmsg() not ready, %ui datagrams dropped",
+                               ngx_quic_batch.nmsgs - i);
+                break;
+            }
+
+            ngx_log_error(NGX_LOG_ERR, log, err, "sendmmsg() failed");
+
+            /* the failed datagram is skipped, the rest are sent */
+
+            i++;
+            continue;
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, log, 0,
+                       "sendmmsg: %d of %ui", n, ngx_quic_batch.nmsgs - i);
+
+        i += n;
+    }
+
+    ngx_quic_batch.nmsgs = 0;
+    ngx_quic_batch.size = 0;
+}
+
+
+static ngx_int_t
+ngx_quic_batch_alloc(ngx_log_t *log)
+{
+    u_char                 *buffer;
+    struct mmsghdr         *msgs;
+    ngx_quic_batch_slot_t  *slots;
+
+    msgs = ngx_alloc(NGX_QUIC_BATCH_MSGS * sizeof(struct mmsghdr), log);
+    slots = ngx_alloc(NGX_QUIC_BATCH_MSGS * sizeof(ngx_quic_batch_slot_t),
+                      log);
+    buffer = ngx_alloc(NGX_QUIC_BATCH_BUFFER, log);
+
+    if (msgs == NULL || slots == NULL || buffer == NULL) {
+        ngx_free(msgs);
+        ngx_free(slots);
+        ngx_free(buffer);
+        return NGX_ERROR;
+    }
+
+    ngx_quic_batch.msgs = msgs;
+    ngx_quic_batch.slots = slots;
+    ngx_quic_batch.buffer = buffer;
+
+    return NGX_OK;
+}
+
+#endif
+
+
 static void
 ngx_quic_set_packet_number(ngx_quic_header_t *pkt, ngx_quic_send_ctx_t *ctx)
 {
@@ -783,7 +1131,7 @@ ngx_quic_negotiate_version(ngx_connection_t *c, ngx_quic_header_t *inpkt)
                    "quic vnego packet to send len:%uz %*xs", len, len, buf);
 #endif
 
-    (void) ngx_quic_send(c, buf, len, c->sockaddr, c->socklen);
+    (void) ngx_quic_send(c, buf, len, c->sockaddr, c->socklen, 0);
 
     return NGX_DONE;
 }
@@ -834,7 +1182,7 @@ ngx_quic_send_stateless_reset(ngx_connection_t *c, ngx_quic_conf_t *conf,
         return NGX_ERROR;
     }
 
-    (void) ngx_quic_send(c, buf, len, c->sockaddr, c->socklen);
+    (void) ngx_quic_send(c, buf, len, c->sockaddr, c->socklen, 0);
 
     return NGX_DECLINED;
 }
@@ -954,7 +1302,7 @@ ngx_quic_send_early_cc(ngx_connection_t *c, ngx_quic_header_t *inpkt,
         return NGX_ERROR;
     }
 
-    if (ngx_quic_send(c, res.data, res.len, c->sockaddr, c->socklen) < 0) {
+    if (ngx_quic_send(c, res.data, res.len, c->sockaddr, c->socklen, 0) < 0) {
         ngx_quic_keys_cleanup(pkt.keys);
         return NGX_ERROR;
     }
@@ -1019,7 +1367,7 @@ ngx_quic_send_retry(ngx_connection_t *c, ngx_quic_conf_t *conf,
                    "quic packet to send len:%uz %xV", res.len, &res);
 #endif
 
-    len = ngx_quic_send(c, res.data, res.len, c->sockaddr, c->socklen);
+    len = ngx_quic_send(c, res.data, res.len, c->sockaddr, c->socklen, 0);
     if (len < 0) {
         return NGX_ERROR;
     }
@@ -1269,7 +1617,8 @@ ngx_quic_frame_sendto(ngx_connection_t *c, ngx_quic_frame_t *frame,
 
     ctx->pnum++;
 
-    sent = ngx_quic_send(c, res.data, res.len, path->sockaddr, path->socklen);
+    sent = ngx_quic_send(c, res.data, res.len, path->sockaddr, path->socklen,
+                         0);
     if (sent < 0) {
         ngx_quic_free_frame(c, frame);
         return sent;
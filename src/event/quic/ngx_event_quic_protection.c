@@ -39,10 +39,12 @@ static ngx_int_t ngx_quic_crypto_hp_init(const EVP_CIPHER *cipher,
     ngx_quic_secret_t *s, ngx_log_t *log);
 static ngx_int_t ngx_quic_crypto_hp(ngx_quic_secret_t *s,
     u_char *out, u_char *in, ngx_log_t *log);
+static ngx_int_t ngx_quic_crypto_hp_batch(ngx_quic_secret_t *s,
+    u_char *out, u_char *in, ngx_uint_t n, ngx_log_t *log);
 static void ngx_quic_crypto_hp_cleanup(ngx_quic_secret_t *s);
 
 static ngx_int_t ngx_quic_create_packet(ngx_quic_header_t *pkt,
-    ngx_str_t *res);
+    ngx_str_t *res, ngx_quic_hp_batch_t *hb);
 static ngx_int_t ngx_quic_create_retry_packet(ngx_quic_header_t *pkt,
     ngx_str_t *res);
 
@@ -60,7 +62,7 @@ ngx_quic_ciphers(ngx_uint_t id, ngx_quic_ciphers_t *ciphers)
 #else
         ciphers->c = EVP_aes_128_gcm();
 #endif
-        ciphers->hp = EVP_aes_128_ctr();
+        ciphers->hp = EVP_aes_128_ecb();
         ciphers->d = EVP_sha256();
         len = 16;
         break;
@@ -71,7 +73,7 @@ ngx_quic_ciphers(ngx_uint_t id, ngx_quic_ciphers_t *ciphers)
 #else
         ciphers->c = EVP_aes_256_gcm();
 #endif
-        ciphers->hp = EVP_aes_256_ctr();
+        ciphers->hp = EVP_aes_256_ecb();
         ciphers->d = EVP_sha384();
         len = 32;
         break;
@@ -94,7 +96,7 @@ ngx_quic_ciphers(ngx_uint_t id, ngx_quic_ciphers_t *ciphers)
 #ifndef OPENSSL_IS_BORINGSSL
     case TLS1_3_CK_AES_128_CCM_SHA256:
         ciphers->c = EVP_aes_128_ccm();
-        ciphers->hp = EVP_aes_128_ctr();
+        ciphers->hp = EVP_aes_128_ecb();
         ciphers->d = EVP_sha256();
         len = 16;
         break;
@@ -595,6 +597,17 @@ ngx_quic_crypto_hp_init(const EVP_CIPHER *cipher, ngx_quic_secret_t *s,
         return NGX_ERROR;
     }
 
+    /*
+     * RFC 9001, 5.4.3.  AES-Based Header Protection
+     *
+     * the mask is a single AES-ECB block of the sample, so the context
+     * is keyed once and several samples may be encrypted in one call
+     */
+
+    if (EVP_CIPHER_CTX_mode(ctx) == EVP_CIPH_ECB_MODE) {
+        EVP_CIPHER_CTX_set_padding(ctx, 0);
+    }
+
     s->hp_ctx = ctx;
     return NGX_OK;
 }
@@ -607,6 +620,7 @@ ngx_quic_crypto_hp(ngx_quic_secret_t *s, u_char *out, u_char *in,
     int              outlen;
     EVP_CIPHER_CTX  *ctx;
     u_char           zero[NGX_QUIC_HP_LEN] = {0};
+    u_char           block[NGX_QUIC_HP_SAMPLE_LEN];
 
     ctx = s->hp_ctx;
 
@@ -620,6 +634,20 @@ ngx_quic_crypto_hp(ngx_quic_secret_t *s, u_char *out, u_char *in,
     }
 #endif
 
+    if (EVP_CIPHER_CTX_mode(ctx) == EVP_CIPH_ECB_MODE) {
+
+        if (!EVP_EncryptUpdate(ctx, block, &outlen, in,
+                               NGX_QUIC_HP_SAMPLE_LEN))
+        {
+            ngx_ssl_error(NGX_LOG_INFO, log, 0, "EVP_EncryptUpdate() failed");
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(out, block, NGX_QUIC_HP_LEN);
+
+        return NGX_OK;
+    }
+
     if (EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, in) != 1) {
         ngx_ssl_error(NGX_LOG_INFO, log, 0, "EVP_EncryptInit_ex() failed");
         return NGX_ERROR;
@@ -639,6 +667,40 @@ ngx_quic_crypto_hp(ngx_quic_secret_t *s, u_char *out, u_char *in,
 }
 
 
+static ngx_int_t
+ngx_quic_crypto_hp_batch(ngx_quic_secret_t *s, u_char *out, u_char *in,
+    ngx_uint_t n, ngx_log_t *log)
+{
+    int          outlen;
+    ngx_uint_t   i;
+
+    if (s->hp_ctx && EVP_CIPHER_CTX_mode(s->hp_ctx) == EVP_CIPH_ECB_MODE) {
+
+        if (!EVP_EncryptUpdate(s->hp_ctx, out, &outlen, in,
+                               n * NGX_QUIC_HP_SAMPLE_LEN))
+        {
+            ngx_ssl_error(NGX_LOG_INFO, log, 0, "EVP_EncryptUpdate() failed");
+            return NGX_ERROR;
+        }
+
+        return NGX_OK;
+    }
+
+    /* ChaCha20 takes the sample as an IV, one call per mask */
+
+    for (i = 0; i < n; i++) {
+        if (ngx_quic_crypto_hp(s, out, in, log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        out += NGX_QUIC_HP_SAMPLE_LEN;
+        in += NGX_QUIC_HP_SAMPLE_LEN;
+    }
+
+    return NGX_OK;
+}
+
+
 static void
 ngx_quic_crypto_hp_cleanup(ngx_quic_secret_t *s)
 {
@@ -895,13 +957,15 @@ ngx_quic_keys_cleanup(ngx_quic_keys_t *keys)
 
 
 static ngx_int_t
-ngx_quic_create_packet(ngx_quic_header_t *pkt, ngx_str_t *res)
+ngx_quic_create_packet(ngx_quic_header_t *pkt, ngx_str_t *res,
+    ngx_quic_hp_batch_t *hb)
 {
-    u_char             *pnp, *sample;
-    ngx_str_t           ad, out;
-    ngx_uint_t          i;
-    ngx_quic_secret_t  *secret;
-    u_char              nonce[NGX_QUIC_IV_LEN], mask[NGX_QUIC_HP_LEN];
+    u_char              *pnp, *sample;
+    ngx_str_t            ad, out;
+    ngx_uint_t           i;
+    ngx_quic_secret_t   *secret;
+    ngx_quic_hp_slot_t  *hs;
+    u_char               nonce[NGX_QUIC_IV_LEN], mask[NGX_QUIC_HP_LEN];
 
     ad.data = res->data;
     ad.len = ngx_quic_create_header(pkt, ad.data, &pnp);
@@ -925,7 +989,38 @@ ngx_quic_create_packet(ngx_quic_header_t *pkt, ngx_str_t *res)
         return NGX_ERROR;
     }
 
+    res->len = ad.len + out.len;
+
     sample = &out.data[4 - pkt->num_len];
+
+    if (hb) {
+
+        if (hb->n == NGX_QUIC_HP_BATCH
+            || (hb->n && hb->secret != secret))
+        {
+            if (ngx_quic_protect_headers(hb, pkt->log) != NGX_OK) {
+                return NGX_ERROR;
+            }
+        }
+
+        /* header protection is applied later by ngx_quic_protect_headers() */
+
+        hs = &hb->slots[hb->n];
+
+        hs->first = ad.data;
+        hs->pnp = pnp;
+        hs->num_len = pkt->num_len;
+        hs->mask = ngx_quic_pkt_hp_mask(pkt->flags);
+
+        ngx_memcpy(&hb->samples[hb->n * NGX_QUIC_HP_SAMPLE_LEN], sample,
+                   NGX_QUIC_HP_SAMPLE_LEN);
+
+        hb->secret = secret;
+        hb->n++;
+
+        return NGX_OK;
+    }
+
     if (ngx_quic_crypto_hp(secret, mask, sample, pkt->log) != NGX_OK) {
         return NGX_ERROR;
     }
@@ -937,8 +1032,6 @@ ngx_quic_create_packet(ngx_quic_header_t *pkt, ngx_str_t *res)
         pnp[i] ^= mask[i + 1];
     }
 
-    res->len = ad.len + out.len;
-
     return NGX_OK;
 }
 
@@ -1113,7 +1206,58 @@ ngx_quic_encrypt(ngx_quic_header_t *pkt, ngx_str_t *res)
         return ngx_quic_create_retry_packet(pkt, res);
     }
 
-    return ngx_quic_create_packet(pkt, res);
+    return ngx_quic_create_packet(pkt, res, NULL);
+}
+
+
+ngx_int_t
+ngx_quic_encrypt_batch(ngx_quic_header_t *pkt, ngx_str_t *res,
+    ngx_quic_hp_batch_t *hb)
+{
+    if (ngx_quic_pkt_retry(pkt->flags)) {
+        return ngx_quic_create_retry_packet(pkt, res);
+    }
+
+    return ngx_quic_create_packet(pkt, res, hb);
+}
+
+
+ngx_int_t
+ngx_quic_protect_headers(ngx_quic_hp_batch_t *hb, ngx_log_t *log)
+{
+    u_char              *mask;
+    ngx_uint_t           i, j;
+    ngx_quic_hp_slot_t  *hs;
+    u_char               masks[NGX_QUIC_HP_BATCH * NGX_QUIC_HP_SAMPLE_LEN];
+
+    if (hb->n == 0) {
+        return NGX_OK;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "quic header protection batch:%ui", hb->n);
+
+    if (ngx_quic_crypto_hp_batch(hb->secret, masks, hb->samples, hb->n, log)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < hb->n; i++) {
+        hs = &hb->slots[i];
+        mask = &masks[i * NGX_QUIC_HP_SAMPLE_LEN];
+
+        /* RFC 9001, 5.4.1.  Header Protection Application */
+        hs->first[0] ^= mask[0] & hs->mask;
+
+        for (j = 0; j < hs->num_len; j++) {
+            hs->pnp[j] ^= mask[j + 1];
+        }
+    }
+
+    hb->n = 0;
+
+    return NGX_OK;
 }
 
 
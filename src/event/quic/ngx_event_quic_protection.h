@@ -23,6 +23,12 @@
 /* largest hash used in TLS is SHA-384 */
 #define NGX_QUIC_MAX_MD_SIZE          48
 
+/* RFC 9001, 5.4.2.  Header Protection Sample */
+#define NGX_QUIC_HP_SAMPLE_LEN        16
+
+/* matches the maximum number of GSO segments */
+#define NGX_QUIC_HP_BATCH             64
+
 
 #ifdef OPENSSL_IS_BORINGSSL
 #define ngx_quic_cipher_t             EVP_AEAD
@@ -67,6 +73,23 @@ struct ngx_quic_keys_s {
 };
 
 
+typedef struct {
+    u_char                   *first;
+    u_char                   *pnp;
+    ngx_uint_t                num_len;
+    u_char                    mask;
+} ngx_quic_hp_slot_t;
+
+
+typedef struct {
+    ngx_quic_secret_t        *secret;
+    ngx_uint_t                n;
+    ngx_quic_hp_slot_t        slots[NGX_QUIC_HP_BATCH];
+    u_char                    samples[NGX_QUIC_HP_BATCH
+                                      * NGX_QUIC_HP_SAMPLE_LEN];
+} ngx_quic_hp_batch_t;
+
+
 typedef struct {
     const ngx_quic_cipher_t  *c;
     const EVP_CIPHER         *hp;
@@ -105,6 +128,9 @@ void ngx_quic_keys_switch(ngx_connection_t *c, ngx_quic_keys_t *keys);
 void ngx_quic_keys_update(ngx_event_t *ev);
 void ngx_quic_keys_cleanup(ngx_quic_keys_t *keys);
 ngx_int_t ngx_quic_encrypt(ngx_quic_header_t *pkt, ngx_str_t *res);
+ngx_int_t ngx_quic_encrypt_batch(ngx_quic_header_t *pkt, ngx_str_t *res,
+    ngx_quic_hp_batch_t *hb);
+ngx_int_t ngx_quic_protect_headers(ngx_quic_hp_batch_t *hb, ngx_log_t *log);
 ngx_int_t ngx_quic_decrypt(ngx_quic_header_t *pkt, uint64_t *largest_pn);
 void ngx_quic_compute_nonce(u_char *nonce, size_t len, uint64_t pn);
 ngx_int_t ngx_quic_ciphers(ngx_uint_t id, ngx_quic_ciphers_t *ciphers);
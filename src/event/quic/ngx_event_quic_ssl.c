@@ -471,6 +471,10 @@ ngx_quic_crypto_input(ngx_connection_t *c, ngx_chain_t *data,
         }
     }
 
+    if (ngx_quic_send_ack_frequency(c) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     /*
      * RFC 9001, 9.5.  Header Protection Timing Side Channels
      *
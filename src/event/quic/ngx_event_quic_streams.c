@@ -1752,6 +1752,14 @@ ngx_quic_update_max_stream_data(ngx_quic_stream_t *qs)
         return NGX_OK;
     }
 
+    if (ngx_quic_memory_exceeded(pc)) {
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, pc->log, 0,
+                       "quic stream id:0x%xL flow update deferred", qs->id);
+
+        qc->streams.flow_blocked = 1;
+        return NGX_OK;
+    }
+
     qs->recv_max_data = recv_max_data;
 
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, pc->log, 0,
@@ -1789,6 +1797,14 @@ ngx_quic_update_max_data(ngx_connection_t *c)
         return NGX_OK;
     }
 
+    if (ngx_quic_memory_exceeded(c)) {
+        ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic flow update deferred");
+
+        qc->streams.flow_blocked = 1;
+        return NGX_OK;
+    }
+
     qc->streams.recv_max_data = recv_max_data;
 
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
@@ -1809,6 +1825,53 @@ ngx_quic_update_max_data(ngx_connection_t *c)
 }
 
 
+ngx_int_t
+ngx_quic_resume_flow(ngx_connection_t *c)
+{
+    ngx_rbtree_t           *tree;
+    ngx_rbtree_node_t      *node;
+    ngx_quic_stream_t      *qs;
+    ngx_quic_connection_t  *qc;
+
+    qc = ngx_quic_get_connection(c);
+
+    if (!qc->streams.flow_blocked || ngx_quic_memory_exceeded(c)) {
+        return NGX_OK;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0, "quic flow resumed");
+
+    qc->streams.flow_blocked = 0;
+
+    tree = &qc->streams.tree;
+
+    if (tree->root != tree->sentinel) {
+        for (node = ngx_rbtree_min(tree->root, tree->sentinel);
+             node;
+             node = ngx_rbtree_next(tree, node))
+        {
+            qs = (ngx_quic_stream_t *) node;
+
+            if (qs->recv_max_data <= qs->recv_offset + qs->recv_window / 2) {
+                if (ngx_quic_update_max_stream_data(qs) != NGX_OK) {
+                    return NGX_ERROR;
+                }
+            }
+        }
+    }
+
+    if (qc->streams.recv_max_data
+        <= qc->streams.recv_offset + qc->streams.recv_window / 2)
+    {
+        if (ngx_quic_update_max_data(c) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
 static void
 ngx_quic_set_event(ngx_event_t *ev)
 {
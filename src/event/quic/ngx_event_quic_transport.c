@@ -126,10 +126,13 @@ static size_t ngx_quic_create_new_connection_id(u_char *p,
     ngx_quic_new_conn_id_frame_t *rcid);
 static size_t ngx_quic_create_retire_connection_id(u_char *p,
     ngx_quic_retire_cid_frame_t *rcid);
+static size_t ngx_quic_create_immediate_ack(u_char *p);
+static size_t ngx_quic_create_ack_frequency(u_char *p,
+    ngx_quic_ack_frequency_frame_t *af);
 static size_t ngx_quic_create_close(u_char *p, ngx_quic_frame_t *f);
 
 static ngx_int_t ngx_quic_parse_transport_param(u_char *p, u_char *end,
-    uint16_t id, ngx_quic_tp_t *dst);
+    uint64_t id, ngx_quic_tp_t *dst);
 
 
 uint32_t  ngx_quic_versions[] = {
@@ -756,7 +759,7 @@ ngx_quic_parse_frame(ngx_quic_header_t *pkt, u_char *start, u_char *end,
         return NGX_ERROR;
     }
 
-    if (varint > NGX_QUIC_FT_LAST) {
+    if (varint > NGX_QUIC_FT_LAST && varint != NGX_QUIC_FT_ACK_FREQUENCY) {
         pkt->error = NGX_QUIC_ERR_FRAME_ENCODING_ERROR;
         ngx_log_error(NGX_LOG_INFO, pkt->log, 0,
                       "quic unknown frame type 0x%xL", varint);
@@ -869,6 +872,31 @@ ngx_quic_parse_frame(ngx_quic_header_t *pkt, u_char *start, u_char *end,
         break;
 
     case NGX_QUIC_FT_PING:
+    case NGX_QUIC_FT_IMMEDIATE_ACK:
+        break;
+
+    case NGX_QUIC_FT_ACK_FREQUENCY:
+
+        p = ngx_quic_parse_int(p, end, &f->u.ack_frequency.sequence_number);
+        if (p == NULL) {
+            goto error;
+        }
+
+        p = ngx_quic_parse_int(p, end, &f->u.ack_frequency.threshold);
+        if (p == NULL) {
+            goto error;
+        }
+
+        p = ngx_quic_parse_int(p, end, &f->u.ack_frequency.max_ack_delay);
+        if (p == NULL) {
+            goto error;
+        }
+
+        p = ngx_quic_parse_int(p, end, &f->u.ack_frequency.reordering);
+        if (p == NULL) {
+            goto error;
+        }
+
         break;
 
     case NGX_QUIC_FT_NEW_CONNECTION_ID:
@@ -1155,7 +1183,7 @@ error:
 static ngx_int_t
 ngx_quic_frame_allowed(ngx_quic_header_t *pkt, ngx_uint_t frame_type)
 {
-    uint8_t  ptype;
+    uint8_t  ptype, mask;
 
     /*
      * RFC 9000, 12.4. Frames and Frame Types: Table 3
@@ -1194,6 +1222,7 @@ ngx_quic_frame_allowed(ngx_quic_header_t *pkt, ngx_uint_t frame_type)
          /* CONNECTION_CLOSE */      0xF,
          /* CONNECTION_CLOSE2 */     0x3,
          /* HANDSHAKE_DONE */        0x0, /* only sent by server */
+         /* IMMEDIATE_ACK */         0x3,
     };
 
     if (ngx_quic_long_pkt(pkt->flags)) {
@@ -1212,7 +1241,14 @@ ngx_quic_frame_allowed(ngx_quic_header_t *pkt, ngx_uint_t frame_type)
         ptype = 1; /* application data */
     }
 
-    if (ptype & ngx_quic_frame_masks[frame_type]) {
+    if (frame_type == NGX_QUIC_FT_ACK_FREQUENCY) {
+        mask = 0x3;
+
+    } else {
+        mask = ngx_quic_frame_masks[frame_type];
+    }
+
+    if (ptype & mask) {
         return NGX_OK;
     }
 
@@ -1335,6 +1371,12 @@ ngx_quic_create_frame(u_char *p, ngx_quic_frame_t *f)
     case NGX_QUIC_FT_RETIRE_CONNECTION_ID:
         return ngx_quic_create_retire_connection_id(p, &f->u.retire_cid);
 
+    case NGX_QUIC_FT_IMMEDIATE_ACK:
+        return ngx_quic_create_immediate_ack(p);
+
+    case NGX_QUIC_FT_ACK_FREQUENCY:
+        return ngx_quic_create_ack_frequency(p, &f->u.ack_frequency);
+
     default:
         /* BUG: unsupported frame type generated */
         return NGX_ERROR;
@@ -1611,7 +1653,7 @@ ngx_quic_create_max_streams(u_char *p, ngx_quic_max_streams_frame_t *ms)
 
 
 static ngx_int_t
-ngx_quic_parse_transport_param(u_char *p, u_char *end, uint16_t id,
+ngx_quic_parse_transport_param(u_char *p, u_char *end, uint64_t id,
     ngx_quic_tp_t *dst)
 {
     uint64_t   varint;
@@ -1641,6 +1683,7 @@ ngx_quic_parse_transport_param(u_char *p, u_char *end, uint16_t id,
     case NGX_QUIC_TP_ACK_DELAY_EXPONENT:
     case NGX_QUIC_TP_MAX_ACK_DELAY:
     case NGX_QUIC_TP_ACTIVE_CONNECTION_ID_LIMIT:
+    case NGX_QUIC_TP_MIN_ACK_DELAY:
 
         p = ngx_quic_parse_int(p, end, &varint);
         if (p == NULL) {
@@ -1704,6 +1747,10 @@ ngx_quic_parse_transport_param(u_char *p, u_char *end, uint16_t id,
         dst->active_connection_id_limit = varint;
         break;
 
+    case NGX_QUIC_TP_MIN_ACK_DELAY:
+        dst->min_ack_delay = varint;
+        break;
+
     case NGX_QUIC_TP_INITIAL_SCID:
         dst->initial_scid = str;
         break;
@@ -1828,6 +1875,9 @@ ngx_quic_parse_transport_params(u_char *p, u_char *end, ngx_quic_tp_t *tp,
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0, "quic tp max_ack_delay:%ui",
                    tp->max_ack_delay);
 
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0, "quic tp min_ack_delay:%ui",
+                   tp->min_ack_delay);
+
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
                    "quic tp active_connection_id_limit:%ui",
                    tp->active_connection_id_limit);
@@ -1977,6 +2027,50 @@ ngx_quic_create_retire_connection_id(u_char *p,
 }
 
 
+static size_t
+ngx_quic_create_immediate_ack(u_char *p)
+{
+    u_char  *start;
+
+    if (p == NULL) {
+        return ngx_quic_varint_len(NGX_QUIC_FT_IMMEDIATE_ACK);
+    }
+
+    start = p;
+
+    ngx_quic_build_int(&p, NGX_QUIC_FT_IMMEDIATE_ACK);
+
+    return p - start;
+}
+
+
+static size_t
+ngx_quic_create_ack_frequency(u_char *p, ngx_quic_ack_frequency_frame_t *af)
+{
+    size_t   len;
+    u_char  *start;
+
+    if (p == NULL) {
+        len = ngx_quic_varint_len(NGX_QUIC_FT_ACK_FREQUENCY);
+        len += ngx_quic_varint_len(af->sequence_number);
+        len += ngx_quic_varint_len(af->threshold);
+        len += ngx_quic_varint_len(af->max_ack_delay);
+        len += ngx_quic_varint_len(af->reordering);
+        return len;
+    }
+
+    start = p;
+
+    ngx_quic_build_int(&p, NGX_QUIC_FT_ACK_FREQUENCY);
+    ngx_quic_build_int(&p, af->sequence_number);
+    ngx_quic_build_int(&p, af->threshold);
+    ngx_quic_build_int(&p, af->max_ack_delay);
+    ngx_quic_build_int(&p, af->reordering);
+
+    return p - start;
+}
+
+
 ngx_int_t
 ngx_quic_init_transport_params(ngx_quic_tp_t *tp, ngx_quic_conf_t *qcf)
 {
@@ -2012,6 +2106,7 @@ ngx_quic_init_transport_params(ngx_quic_tp_t *tp, ngx_quic_conf_t *qcf)
     tp->initial_max_streams_uni = qcf->max_concurrent_streams_uni;
 
     tp->max_ack_delay = NGX_QUIC_DEFAULT_MAX_ACK_DELAY;
+    tp->min_ack_delay = NGX_QUIC_MIN_ACK_DELAY;
     tp->ack_delay_exponent = NGX_QUIC_DEFAULT_ACK_DELAY_EXPONENT;
 
     tp->active_connection_id_limit = qcf->active_connection_id_limit;
@@ -2094,6 +2189,8 @@ ngx_quic_create_transport_params(u_char *pos, u_char *end, ngx_quic_tp_t *tp,
     len += ngx_quic_tp_len(NGX_QUIC_TP_ACK_DELAY_EXPONENT,
                            tp->ack_delay_exponent);
 
+    len += ngx_quic_tp_len(NGX_QUIC_TP_MIN_ACK_DELAY, tp->min_ack_delay);
+
     len += ngx_quic_tp_strlen(NGX_QUIC_TP_ORIGINAL_DCID, tp->original_dcid);
     len += ngx_quic_tp_strlen(NGX_QUIC_TP_INITIAL_SCID, tp->initial_scid);
 
@@ -2149,6 +2246,8 @@ ngx_quic_create_transport_params(u_char *pos, u_char *end, ngx_quic_tp_t *tp,
     ngx_quic_tp_vint(NGX_QUIC_TP_ACK_DELAY_EXPONENT,
                      tp->ack_delay_exponent);
 
+    ngx_quic_tp_vint(NGX_QUIC_TP_MIN_ACK_DELAY, tp->min_ack_delay);
+
     ngx_quic_tp_str(NGX_QUIC_TP_ORIGINAL_DCID, tp->original_dcid);
     ngx_quic_tp_str(NGX_QUIC_TP_INITIAL_SCID, tp->initial_scid);
 
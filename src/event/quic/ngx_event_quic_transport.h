@@ -87,7 +87,11 @@
 #define NGX_QUIC_FT_CONNECTION_CLOSE_APP                 0x1D
 #define NGX_QUIC_FT_HANDSHAKE_DONE                       0x1E
 
-#define NGX_QUIC_FT_LAST  NGX_QUIC_FT_HANDSHAKE_DONE
+/* draft-ietf-quic-ack-frequency */
+#define NGX_QUIC_FT_IMMEDIATE_ACK                        0x1F
+#define NGX_QUIC_FT_ACK_FREQUENCY                        0xAF
+
+#define NGX_QUIC_FT_LAST  NGX_QUIC_FT_IMMEDIATE_ACK
 
 /* 22.5.  QUIC Transport Error Codes Registry */
 #define NGX_QUIC_ERR_NO_ERROR                            0x00
@@ -132,6 +136,9 @@
 #define NGX_QUIC_TP_INITIAL_SCID                         0x0F
 #define NGX_QUIC_TP_RETRY_SCID                           0x10
 
+/* draft-ietf-quic-ack-frequency */
+#define NGX_QUIC_TP_MIN_ACK_DELAY                        0xFF04DE1B
+
 #define NGX_QUIC_CID_LEN_MIN                                8
 #define NGX_QUIC_CID_LEN_MAX                               20
 
@@ -258,6 +265,14 @@ typedef struct {
 } ngx_quic_path_challenge_frame_t;
 
 
+typedef struct {
+    uint64_t                                    sequence_number;
+    uint64_t                                    threshold;
+    uint64_t                                    max_ack_delay; /* us */
+    uint64_t                                    reordering;
+} ngx_quic_ack_frequency_frame_t;
+
+
 typedef struct ngx_quic_frame_s                 ngx_quic_frame_t;
 
 struct ngx_quic_frame_s {
@@ -271,6 +286,7 @@ struct ngx_quic_frame_s {
     unsigned                                    need_ack:1;
     unsigned                                    pkt_need_ack:1;
     unsigned                                    ignore_congestion:1;
+    unsigned                                    ecn:1;
 
     ngx_chain_t                                *data;
     union {
@@ -292,6 +308,7 @@ struct ngx_quic_frame_s {
         ngx_quic_retire_cid_frame_t             retire_cid;
         ngx_quic_path_challenge_frame_t         path_challenge;
         ngx_quic_path_challenge_frame_t         path_response;
+        ngx_quic_ack_frequency_frame_t          ack_frequency;
     } u;
 };
 
@@ -343,6 +360,7 @@ typedef struct {
 typedef struct {
     ngx_msec_t                 max_idle_timeout;
     ngx_msec_t                 max_ack_delay;
+    ngx_msec_t                 min_ack_delay; /* us */
 
     size_t                     max_udp_payload_size;
     size_t                     initial_max_data;
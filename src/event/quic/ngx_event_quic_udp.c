@@ -19,26 +19,22 @@ static ngx_connection_t *ngx_quic_lookup_connection(ngx_listening_t *ls,
 void
 ngx_quic_recvmsg(ngx_event_t *ev)
 {
-    ssize_t             n;
-    ngx_str_t           key;
-    ngx_buf_t           buf;
-    ngx_log_t          *log;
-    ngx_err_t           err;
-    socklen_t           socklen, local_socklen;
-    ngx_event_t        *rev, *wev;
-    struct iovec        iov[1];
-    struct msghdr       msg;
-    ngx_sockaddr_t      sa, lsa;
-    struct sockaddr    *sockaddr, *local_sockaddr;
-    ngx_listening_t    *ls;
-    ngx_event_conf_t   *ecf;
-    ngx_connection_t   *c, *lc;
-    ngx_quic_socket_t  *qsock;
-    static u_char       buffer[NGX_QUIC_MAX_UDP_PAYLOAD_SIZE];
-
-#if (NGX_HAVE_ADDRINFO_CMSG)
-    u_char             msg_control[CMSG_SPACE(sizeof(ngx_addrinfo_t))];
-#endif
+    u_char                *buffer;
+    ssize_t                n;
+    ngx_str_t              key;
+    ngx_buf_t              buf;
+    ngx_log_t             *log;
+    ngx_err_t              err;
+    socklen_t              socklen, local_socklen;
+    ngx_event_t           *rev, *wev;
+    struct msghdr         *msg;
+    ngx_sockaddr_t         lsa;
+    struct sockaddr       *sockaddr, *local_sockaddr;
+    ngx_listening_t       *ls;
+    ngx_event_conf_t      *ecf;
+    ngx_connection_t      *c, *lc;
+    ngx_quic_socket_t     *qsock;
+    ngx_udp_recv_batch_t   batch;
 
     if (ev->timedout) {
         if (ngx_enable_accept_events((ngx_cycle_t *) ngx_cycle) != NGX_OK) {
@@ -62,27 +58,15 @@ ngx_quic_recvmsg(ngx_event_t *ev)
                    "quic recvmsg on %V, ready: %d",
                    &ls->addr_text, ev->available);
 
-    do {
-        ngx_memzero(&msg, sizeof(struct msghdr));
-
-        iov[0].iov_base = (void *) buffer;
-        iov[0].iov_len = sizeof(buffer);
+    batch.size = ecf->udp_recv_batch;
+    batch.nelts = 0;
+    batch.next = 0;
+    batch.pos = NULL;
+    batch.last = NULL;
 
-        msg.msg_name = &sa;
-        msg.msg_namelen = sizeof(ngx_sockaddr_t);
-        msg.msg_iov = iov;
-        msg.msg_iovlen = 1;
-
-#if (NGX_HAVE_ADDRINFO_CMSG)
-        if (ls->wildcard) {
-            msg.msg_control = &msg_control;
-            msg.msg_controllen = sizeof(msg_control);
-
-            ngx_memzero(&msg_control, sizeof(msg_control));
-        }
-#endif
-
-        n = recvmsg(lc->fd, &msg, 0);
+    do {
+        n = ngx_udp_recvmsg(ev, &batch, NGX_QUIC_MAX_UDP_PAYLOAD_SIZE, &msg,
+                            &buffer);
 
         if (n == -1) {
             err = ngx_socket_errno;
@@ -98,16 +82,16 @@ ngx_quic_recvmsg(ngx_event_t *ev)
             return;
         }
 
-#if (NGX_HAVE_ADDRINFO_CMSG)
-        if (msg.msg_flags & (MSG_TRUNC|MSG_CTRUNC)) {
+#if (NGX_HAVE_ADDRINFO_CMSG || NGX_HAVE_GRO_CMSG)
+        if (msg->msg_flags & (MSG_TRUNC|MSG_CTRUNC)) {
             ngx_log_error(NGX_LOG_ALERT, ev->log, 0,
                           "quic recvmsg() truncated data");
             continue;
         }
 #endif
 
-        sockaddr = msg.msg_name;
-        socklen = msg.msg_namelen;
+        sockaddr = msg->msg_name;
+        socklen = msg->msg_namelen;
 
         if (socklen > (socklen_t) sizeof(ngx_sockaddr_t)) {
             socklen = sizeof(ngx_sockaddr_t);
@@ -140,9 +124,9 @@ ngx_quic_recvmsg(ngx_event_t *ev)
             ngx_memcpy(&lsa, local_sockaddr, local_socklen);
             local_sockaddr = &lsa.sockaddr;
 
-            for (cmsg = CMSG_FIRSTHDR(&msg);
+            for (cmsg = CMSG_FIRSTHDR(msg);
                  cmsg != NULL;
-                 cmsg = CMSG_NXTHDR(&msg, cmsg))
+                 cmsg = CMSG_NXTHDR(msg, cmsg))
             {
                 if (ngx_get_srcaddr_cmsg(cmsg, local_sockaddr) == NGX_OK) {
                     break;
@@ -179,7 +163,7 @@ ngx_quic_recvmsg(ngx_event_t *ev)
             buf.pos = buffer;
             buf.last = buffer + n;
             buf.start = buf.pos;
-            buf.end = buffer + sizeof(buffer);
+            buf.end = buffer + NGX_QUIC_MAX_UDP_PAYLOAD_SIZE;
 
             qsock = ngx_quic_get_socket(c);
 
@@ -344,7 +328,7 @@ ngx_quic_recvmsg(ngx_event_t *ev)
             ev->available -= n;
         }
 
-    } while (ev->available);
+    } while (ev->available || ngx_udp_recv_pending(&batch));
 }
 
 
@@ -10,6 +10,10 @@
 #include <ngx_http.h>
 
 
+/* longer lists of rules are compiled into radix trees */
+#define NGX_HTTP_ACCESS_TREE_RULES  16
+
+
 typedef struct {
     in_addr_t         mask;
     in_addr_t         addr;
@@ -35,12 +39,14 @@ typedef struct {
 #endif
 
 typedef struct {
-    ngx_array_t      *rules;     /* array of ngx_http_access_rule_t */
+    ngx_array_t       *rules;     /* array of ngx_http_access_rule_t */
+    ngx_radix_tree_t  *tree;
 #if (NGX_HAVE_INET6)
-    ngx_array_t      *rules6;    /* array of ngx_http_access_rule6_t */
+    ngx_array_t       *rules6;    /* array of ngx_http_access_rule6_t */
+    ngx_radix_tree_t  *tree6;
 #endif
 #if (NGX_HAVE_UNIX_DOMAIN)
-    ngx_array_t      *rules_un;  /* array of ngx_http_access_rule_un_t */
+    ngx_array_t       *rules_un;  /* array of ngx_http_access_rule_un_t */
 #endif
 } ngx_http_access_loc_conf_t;
 
@@ -57,6 +63,10 @@ static ngx_int_t ngx_http_access_unix(ngx_http_request_t *r,
     ngx_http_access_loc_conf_t *alcf);
 #endif
 static ngx_int_t ngx_http_access_found(ngx_http_request_t *r, ngx_uint_t deny);
+static ngx_int_t ngx_http_access_compile(ngx_conf_t *cf,
+    ngx_http_access_loc_conf_t *alcf);
+static ngx_uint_t ngx_http_access_shadowed(ngx_radix_tree_t *tree,
+    u_char *key, u_char *mask, ngx_uint_t len);
 static char *ngx_http_access_rule(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static void *ngx_http_access_create_loc_conf(ngx_conf_t *cf);
@@ -183,9 +193,23 @@ static ngx_int_t
 ngx_http_access_inet(ngx_http_request_t *r, ngx_http_access_loc_conf_t *alcf,
     in_addr_t addr)
 {
+    uintptr_t                deny;
     ngx_uint_t               i;
     ngx_http_access_rule_t  *rule;
 
+    if (alcf->tree) {
+        deny = ngx_radix32tree_find(alcf->tree, ntohl(addr));
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "access: %08XD tree: %i", addr, (ngx_int_t) deny);
+
+        if (deny == NGX_RADIX_NO_VALUE) {
+            return NGX_DECLINED;
+        }
+
+        return ngx_http_access_found(r, deny);
+    }
+
     rule = alcf->rules->elts;
     for (i = 0; i < alcf->rules->nelts; i++) {
 
@@ -208,10 +232,24 @@ static ngx_int_t
 ngx_http_access_inet6(ngx_http_request_t *r, ngx_http_access_loc_conf_t *alcf,
     u_char *p)
 {
+    uintptr_t                 deny;
     ngx_uint_t                n;
     ngx_uint_t                i;
     ngx_http_access_rule6_t  *rule6;
 
+    if (alcf->tree6) {
+        deny = ngx_radix128tree_find(alcf->tree6, p);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "access6 tree: %i", (ngx_int_t) deny);
+
+        if (deny == NGX_RADIX_NO_VALUE) {
+            return NGX_DECLINED;
+        }
+
+        return ngx_http_access_found(r, deny);
+    }
+
     rule6 = alcf->rules6->elts;
     for (i = 0; i < alcf->rules6->nelts; i++) {
 
@@ -431,19 +469,154 @@ ngx_http_access_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         && conf->rules_un == NULL
 #endif
     ) {
+        if (ngx_http_access_compile(cf, prev) != NGX_OK) {
+            return NGX_CONF_ERROR;
+        }
+
         conf->rules = prev->rules;
+        conf->tree = prev->tree;
 #if (NGX_HAVE_INET6)
         conf->rules6 = prev->rules6;
+        conf->tree6 = prev->tree6;
 #endif
 #if (NGX_HAVE_UNIX_DOMAIN)
         conf->rules_un = prev->rules_un;
 #endif
+
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_http_access_compile(cf, conf) != NGX_OK) {
+        return NGX_CONF_ERROR;
     }
 
     return NGX_CONF_OK;
 }
 
 
+static ngx_int_t
+ngx_http_access_compile(ngx_conf_t *cf, ngx_http_access_loc_conf_t *alcf)
+{
+    uint32_t                  key, mask;
+    ngx_uint_t                i;
+    ngx_http_access_rule_t   *rule;
+#if (NGX_HAVE_INET6)
+    ngx_http_access_rule6_t  *rule6;
+#endif
+
+    /*
+     * a rule is not added to the tree if a preceding rule with the same
+     * or a shorter prefix matches all its addresses, so the longest prefix
+     * found by a lookup is that of the first rule matched
+     */
+
+    if (alcf->rules && alcf->tree == NULL
+        && alcf->rules->nelts >= NGX_HTTP_ACCESS_TREE_RULES)
+    {
+        alcf->tree = ngx_radix_tree_create(cf->pool, 0);
+        if (alcf->tree == NULL) {
+            return NGX_ERROR;
+        }
+
+        rule = alcf->rules->elts;
+        for (i = 0; i < alcf->rules->nelts; i++) {
+
+            if (ngx_http_access_shadowed(alcf->tree, (u_char *) &rule[i].addr,
+                                         (u_char *) &rule[i].mask, 4))
+            {
+                continue;
+            }
+
+            key = ntohl(rule[i].addr);
+            mask = ntohl(rule[i].mask);
+
+            if (ngx_radix32tree_insert(alcf->tree, key, mask, rule[i].deny)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+        }
+
+        if (ngx_radix_tree_compile(alcf->tree) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+#if (NGX_HAVE_INET6)
+
+    if (alcf->rules6 && alcf->tree6 == NULL
+        && alcf->rules6->nelts >= NGX_HTTP_ACCESS_TREE_RULES)
+    {
+        alcf->tree6 = ngx_radix_tree_create(cf->pool, 0);
+        if (alcf->tree6 == NULL) {
+            return NGX_ERROR;
+        }
+
+        rule6 = alcf->rules6->elts;
+        for (i = 0; i < alcf->rules6->nelts; i++) {
+
+            if (ngx_http_access_shadowed(alcf->tree6, rule6[i].addr.s6_addr,
+                                         rule6[i].mask.s6_addr, 16))
+            {
+                continue;
+            }
+
+            if (ngx_radix128tree_insert(alcf->tree6, rule6[i].addr.s6_addr,
+                                        rule6[i].mask.s6_addr, rule6[i].deny)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+        }
+
+        if (ngx_radix_tree_compile(alcf->tree6) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+#endif
+
+    return NGX_OK;
+}
+
+
+static ngx_uint_t
+ngx_http_access_shadowed(ngx_radix_tree_t *tree, u_char *key, u_char *mask,
+    ngx_uint_t len)
+{
+    u_char             bit;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node;
+
+    /* key and mask are in network byte order */
+
+    i = 0;
+    bit = 0x80;
+    node = tree->root;
+
+    while (node) {
+        if (node->value != NGX_RADIX_NO_VALUE) {
+            return 1;
+        }
+
+        if (i == len || !(mask[i] & bit)) {
+            break;
+        }
+
+        node = (key[i] & bit) ? node->right : node->left;
+
+        bit >>= 1;
+
+        if (bit == 0) {
+            i++;
+            bit = 0x80;
+        }
+    }
+
+    return 0;
+}
+
+
 static ngx_int_t
 ngx_http_access_init(ngx_conf_t *cf)
 {
@@ -13,6 +13,9 @@
 typedef struct {
     ngx_str_t                 uri;
     ngx_array_t              *vars;
+    ngx_shm_zone_t           *cache;
+    ngx_http_complex_value_t *cache_key;
+    time_t                    cache_valid;
 } ngx_http_auth_request_conf_t;
 
 
@@ -20,9 +23,34 @@ typedef struct {
     ngx_uint_t                done;
     ngx_uint_t                status;
     ngx_http_request_t       *subrequest;
+    ngx_str_t                 key;
+    ngx_str_t                *values;
 } ngx_http_auth_request_ctx_t;
 
 
+typedef struct {
+    ngx_str_node_t            sn;
+    ngx_queue_t               queue;
+    time_t                    expire;
+    ngx_uint_t                status;
+    ngx_uint_t                nvalues;
+    u_char                    data[1];
+} ngx_http_auth_request_cache_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t              rbtree;
+    ngx_rbtree_node_t         sentinel;
+    ngx_queue_t               queue;
+} ngx_http_auth_request_cache_shctx_t;
+
+
+typedef struct {
+    ngx_http_auth_request_cache_shctx_t  *sh;
+    ngx_slab_pool_t                      *shpool;
+} ngx_http_auth_request_cache_t;
+
+
 typedef struct {
     ngx_int_t                 index;
     ngx_http_complex_value_t  value;
@@ -37,6 +65,14 @@ static ngx_int_t ngx_http_auth_request_set_variables(ngx_http_request_t *r,
     ngx_http_auth_request_conf_t *arcf, ngx_http_auth_request_ctx_t *ctx);
 static ngx_int_t ngx_http_auth_request_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_auth_request_cache_lookup(ngx_http_request_t *r,
+    ngx_http_auth_request_conf_t *arcf, ngx_http_auth_request_ctx_t *ctx);
+static void ngx_http_auth_request_cache_store(ngx_http_request_t *r,
+    ngx_http_auth_request_conf_t *arcf, ngx_http_auth_request_ctx_t *ctx);
+static void ngx_http_auth_request_cache_expire(
+    ngx_http_auth_request_cache_t *cache, ngx_uint_t force);
+static ngx_int_t ngx_http_auth_request_cache_init_zone(
+    ngx_shm_zone_t *shm_zone, void *data);
 static void *ngx_http_auth_request_create_conf(ngx_conf_t *cf);
 static char *ngx_http_auth_request_merge_conf(ngx_conf_t *cf,
     void *parent, void *child);
@@ -45,6 +81,10 @@ static char *ngx_http_auth_request(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_auth_request_set(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_auth_request_cache_zone(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+static char *ngx_http_auth_request_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 
 static ngx_command_t  ngx_http_auth_request_commands[] = {
@@ -63,6 +103,20 @@ static ngx_command_t  ngx_http_auth_request_commands[] = {
       0,
       NULL },
 
+    { ngx_string("auth_request_cache_zone"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_http_auth_request_cache_zone,
+      0,
+      0,
+      NULL },
+
+    { ngx_string("auth_request_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE13,
+      ngx_http_auth_request_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -101,6 +155,7 @@ ngx_module_t  ngx_http_auth_request_module = {
 static ngx_int_t
 ngx_http_auth_request_handler(ngx_http_request_t *r)
 {
+    ngx_int_t                      rc;
     ngx_table_elt_t               *h, *ho, **ph;
     ngx_http_request_t            *sr;
     ngx_http_post_subrequest_t    *ps;
@@ -118,11 +173,25 @@ ngx_http_auth_request_handler(ngx_http_request_t *r)
 
     ctx = ngx_http_get_module_ctx(r, ngx_http_auth_request_module);
 
-    if (ctx != NULL) {
-        if (!ctx->done) {
-            return NGX_AGAIN;
+    if (ctx == NULL && arcf->cache) {
+        ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_auth_request_ctx_t));
+        if (ctx == NULL) {
+            return NGX_ERROR;
+        }
+
+        rc = ngx_http_auth_request_cache_lookup(r, arcf, ctx);
+
+        if (rc == NGX_ERROR) {
+            return NGX_ERROR;
         }
 
+        if (rc == NGX_OK) {
+            ngx_http_set_ctx(r, ctx, ngx_http_auth_request_module);
+        }
+    }
+
+    if (ctx != NULL && ctx->done) {
+
         /*
          * as soon as we are done - explicitly set variables to make
          * sure they will be available after internal redirects
@@ -132,6 +201,10 @@ ngx_http_auth_request_handler(ngx_http_request_t *r)
             return NGX_ERROR;
         }
 
+        if (ctx->subrequest && ctx->key.len) {
+            ngx_http_auth_request_cache_store(r, arcf, ctx);
+        }
+
         /* return appropriate status */
 
         if (ctx->status == NGX_HTTP_FORBIDDEN) {
@@ -179,9 +252,15 @@ ngx_http_auth_request_handler(ngx_http_request_t *r)
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
-    ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_auth_request_ctx_t));
+    if (ctx != NULL && ctx->subrequest) {
+        return NGX_AGAIN;
+    }
+
     if (ctx == NULL) {
-        return NGX_ERROR;
+        ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_auth_request_ctx_t));
+        if (ctx == NULL) {
+            return NGX_ERROR;
+        }
     }
 
     ps = ngx_palloc(r->pool, sizeof(ngx_http_post_subrequest_t));
@@ -239,9 +318,10 @@ ngx_http_auth_request_set_variables(ngx_http_request_t *r,
     ngx_http_auth_request_conf_t *arcf, ngx_http_auth_request_ctx_t *ctx)
 {
     ngx_str_t                          val;
+    ngx_uint_t                         i;
     ngx_http_variable_t               *v;
     ngx_http_variable_value_t         *vv;
-    ngx_http_auth_request_variable_t  *av, *last;
+    ngx_http_auth_request_variable_t  *av;
     ngx_http_core_main_conf_t         *cmcf;
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
@@ -255,20 +335,42 @@ ngx_http_auth_request_set_variables(ngx_http_request_t *r,
     v = cmcf->variables.elts;
 
     av = arcf->vars->elts;
-    last = av + arcf->vars->nelts;
 
-    while (av < last) {
+    if (ctx->subrequest && ctx->key.len && ctx->values == NULL) {
+
+        /* the values are kept to be stored in the cache */
+
+        ctx->values = ngx_palloc(r->pool,
+                                 arcf->vars->nelts * sizeof(ngx_str_t));
+        if (ctx->values == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    for (i = 0; i < arcf->vars->nelts; i++) {
         /*
          * explicitly set new value to make sure it will be available after
          * internal redirects
          */
 
-        vv = &r->variables[av->index];
+        vv = &r->variables[av[i].index];
 
-        if (ngx_http_complex_value(ctx->subrequest, &av->value, &val)
-            != NGX_OK)
-        {
-            return NGX_ERROR;
+        if (ctx->subrequest == NULL) {
+
+            /* cached response */
+
+            val = ctx->values[i];
+
+        } else {
+            if (ngx_http_complex_value(ctx->subrequest, &av[i].value, &val)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+
+            if (ctx->values) {
+                ctx->values[i] = val;
+            }
         }
 
         vv->valid = 1;
@@ -276,16 +378,14 @@ ngx_http_auth_request_set_variables(ngx_http_request_t *r,
         vv->data = val.data;
         vv->len = val.len;
 
-        if (av->set_handler) {
+        if (av[i].set_handler) {
             /*
              * set_handler only available in cmcf->variables_keys, so we store
              * it explicitly
              */
 
-            av->set_handler(r, vv, v[av->index].data);
+            av[i].set_handler(r, vv, v[av[i].index].data);
         }
-
-        av++;
     }
 
     return NGX_OK;
@@ -305,6 +405,272 @@ ngx_http_auth_request_variable(ngx_http_request_t *r,
 }
 
 
+static ngx_int_t
+ngx_http_auth_request_cache_lookup(ngx_http_request_t *r,
+    ngx_http_auth_request_conf_t *arcf, ngx_http_auth_request_ctx_t *ctx)
+{
+    u_char                              *p;
+    size_t                              *lens;
+    uint32_t                             hash;
+    ngx_uint_t                           i, n;
+    ngx_http_auth_request_cache_t       *cache;
+    ngx_http_auth_request_cache_node_t  *node;
+
+    if (ngx_http_complex_value(r, arcf->cache_key, &ctx->key) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (ctx->key.len == 0) {
+        return NGX_DECLINED;
+    }
+
+    n = arcf->vars ? arcf->vars->nelts : 0;
+
+    cache = arcf->cache->data;
+    hash = ngx_crc32_short(ctx->key.data, ctx->key.len);
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node = (ngx_http_auth_request_cache_node_t *)
+               ngx_str_rbtree_lookup(&cache->sh->rbtree, &ctx->key, hash);
+
+    if (node == NULL
+        || node->expire < ngx_time()
+        || node->nvalues != n)
+    {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "auth request cache miss: \"%V\"", &ctx->key);
+
+        return NGX_DECLINED;
+    }
+
+    ngx_queue_remove(&node->queue);
+    ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+    ctx->status = node->status;
+
+    if (n) {
+        ctx->values = ngx_palloc(r->pool, n * sizeof(ngx_str_t));
+        if (ctx->values == NULL) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+            return NGX_ERROR;
+        }
+
+        lens = (size_t *) node->data;
+        p = node->sn.str.data + node->sn.str.len;
+
+        for (i = 0; i < n; i++) {
+            ctx->values[i].len = lens[i];
+            ctx->values[i].data = ngx_pnalloc(r->pool, lens[i]);
+
+            if (ctx->values[i].data == NULL) {
+                ngx_shmtx_unlock(&cache->shpool->mutex);
+                return NGX_ERROR;
+            }
+
+            p = ngx_cpymem(ctx->values[i].data, p, lens[i]);
+        }
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "auth request cache hit: \"%V\" s:%ui",
+                   &ctx->key, ctx->status);
+
+    ctx->done = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_auth_request_cache_store(ngx_http_request_t *r,
+    ngx_http_auth_request_conf_t *arcf, ngx_http_auth_request_ctx_t *ctx)
+{
+    u_char                              *p;
+    size_t                               size, *lens;
+    uint32_t                             hash;
+    ngx_uint_t                           i, n;
+    ngx_http_auth_request_cache_t       *cache;
+    ngx_http_auth_request_cache_node_t  *node, *old;
+
+    /* only definite answers are cached */
+
+    if (!(ctx->status >= NGX_HTTP_OK
+          && ctx->status < NGX_HTTP_SPECIAL_RESPONSE)
+        && ctx->status != NGX_HTTP_FORBIDDEN)
+    {
+        ctx->key.len = 0;
+        return;
+    }
+
+    n = arcf->vars ? arcf->vars->nelts : 0;
+
+    size = offsetof(ngx_http_auth_request_cache_node_t, data)
+           + n * sizeof(size_t) + ctx->key.len;
+
+    for (i = 0; i < n; i++) {
+        size += ctx->values[i].len;
+    }
+
+    cache = arcf->cache->data;
+    hash = ngx_crc32_short(ctx->key.data, ctx->key.len);
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    old = (ngx_http_auth_request_cache_node_t *)
+              ngx_str_rbtree_lookup(&cache->sh->rbtree, &ctx->key, hash);
+
+    if (old) {
+        ngx_queue_remove(&old->queue);
+        ngx_rbtree_delete(&cache->sh->rbtree, &old->sn.node);
+        ngx_slab_free_locked(cache->shpool, old);
+    }
+
+    ngx_http_auth_request_cache_expire(cache, 0);
+
+    node = ngx_slab_alloc_locked(cache->shpool, size);
+
+    if (node == NULL) {
+        ngx_http_auth_request_cache_expire(cache, 1);
+
+        node = ngx_slab_alloc_locked(cache->shpool, size);
+        if (node == NULL) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+
+            ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                          "could not allocate node%s",
+                          cache->shpool->log_ctx);
+            ctx->key.len = 0;
+            return;
+        }
+    }
+
+    node->expire = ngx_time() + arcf->cache_valid;
+    node->status = ctx->status;
+    node->nvalues = n;
+
+    lens = (size_t *) node->data;
+
+    node->sn.node.key = hash;
+    node->sn.str.len = ctx->key.len;
+    node->sn.str.data = node->data + n * sizeof(size_t);
+
+    p = ngx_cpymem(node->sn.str.data, ctx->key.data, ctx->key.len);
+
+    for (i = 0; i < n; i++) {
+        lens[i] = ctx->values[i].len;
+        p = ngx_cpymem(p, ctx->values[i].data, ctx->values[i].len);
+    }
+
+    ngx_rbtree_insert(&cache->sh->rbtree, &node->sn.node);
+    ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "auth request cache store: \"%V\" s:%ui",
+                   &ctx->key, ctx->status);
+
+    ctx->key.len = 0;
+}
+
+
+static void
+ngx_http_auth_request_cache_expire(ngx_http_auth_request_cache_t *cache,
+    ngx_uint_t force)
+{
+    time_t                               now;
+    ngx_uint_t                           n;
+    ngx_queue_t                         *q;
+    ngx_http_auth_request_cache_node_t  *node;
+
+    now = ngx_time();
+
+    /*
+     * force == 0 deletes one or two expired entries
+     * force == 1 deletes the least recently used entry by force
+     *            and one or two expired entries
+     */
+
+    for (n = 0; n < 3; n++) {
+
+        if (ngx_queue_empty(&cache->sh->queue)) {
+            return;
+        }
+
+        q = ngx_queue_last(&cache->sh->queue);
+
+        node = ngx_queue_data(q, ngx_http_auth_request_cache_node_t, queue);
+
+        if (!(force && n == 0) && node->expire >= now) {
+            return;
+        }
+
+        ngx_queue_remove(q);
+        ngx_rbtree_delete(&cache->sh->rbtree, &node->sn.node);
+        ngx_slab_free_locked(cache->shpool, node);
+    }
+}
+
+
+static ngx_int_t
+ngx_http_auth_request_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_auth_request_cache_t  *ocache = data;
+
+    size_t                          len;
+    ngx_http_auth_request_cache_t  *cache;
+
+    cache = shm_zone->data;
+
+    if (ocache) {
+        cache->sh = ocache->sh;
+        cache->shpool = ocache->shpool;
+
+        return NGX_OK;
+    }
+
+    cache->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cache->sh = cache->shpool->data;
+
+        return NGX_OK;
+    }
+
+    cache->sh = ngx_slab_alloc(cache->shpool,
+                               sizeof(ngx_http_auth_request_cache_shctx_t));
+    if (cache->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->shpool->data = cache->sh;
+
+    ngx_rbtree_init(&cache->sh->rbtree, &cache->sh->sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&cache->sh->queue);
+
+    len = sizeof(" in auth request cache zone \"\"") + shm_zone->shm.name.len;
+
+    cache->shpool->log_ctx = ngx_slab_alloc(cache->shpool, len);
+    if (cache->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(cache->shpool->log_ctx, " in auth request cache zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    cache->shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
 static void *
 ngx_http_auth_request_create_conf(ngx_conf_t *cf)
 {
@@ -319,9 +685,12 @@ ngx_http_auth_request_create_conf(ngx_conf_t *cf)
      * set by ngx_pcalloc():
      *
      *     conf->uri = { 0, NULL };
+     *     conf->cache_key = NULL;
+     *     conf->cache_valid = 0;
      */
 
     conf->vars = NGX_CONF_UNSET_PTR;
+    conf->cache = NGX_CONF_UNSET_PTR;
 
     return conf;
 }
@@ -336,6 +705,16 @@ ngx_http_auth_request_merge_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_str_value(conf->uri, prev->uri, "");
     ngx_conf_merge_ptr_value(conf->vars, prev->vars, NULL);
 
+    if (conf->cache == NGX_CONF_UNSET_PTR) {
+        conf->cache = prev->cache;
+        conf->cache_key = prev->cache_key;
+        conf->cache_valid = prev->cache_valid;
+    }
+
+    if (conf->cache == NGX_CONF_UNSET_PTR) {
+        conf->cache = NULL;
+    }
+
     return NGX_CONF_OK;
 }
 
@@ -448,3 +827,141 @@ ngx_http_auth_request_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     return NGX_CONF_OK;
 }
+
+
+static char *
+ngx_http_auth_request_cache_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    u_char                         *p;
+    ssize_t                         size;
+    ngx_str_t                      *value, name, s;
+    ngx_shm_zone_t                 *shm_zone;
+    ngx_http_auth_request_cache_t  *cache;
+
+    value = cf->args->elts;
+
+    if (ngx_strncmp(value[1].data, "zone=", 5) != 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.data = value[1].data + 5;
+
+    p = (u_char *) ngx_strchr(name.data, ':');
+
+    if (p == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.len = p - name.data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = ngx_parse_size(&s);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * ngx_pagesize)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (name.len == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone name \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    cache = ngx_pcalloc(cf->pool, sizeof(ngx_http_auth_request_cache_t));
+    if (cache == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                     &ngx_http_auth_request_module);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (shm_zone->data) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"", &name);
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone->init = ngx_http_auth_request_cache_init_zone;
+    shm_zone->data = cache;
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_auth_request_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_auth_request_conf_t *arcf = conf;
+
+    ngx_str_t                         *value;
+    ngx_http_compile_complex_value_t   ccv;
+
+    if (arcf->cache != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts != 2) {
+            return "has invalid number of arguments";
+        }
+
+        arcf->cache = NULL;
+        return NGX_CONF_OK;
+    }
+
+    if (cf->args->nelts != 4) {
+        return "has invalid number of arguments";
+    }
+
+    arcf->cache = ngx_shared_memory_add(cf, &value[1], 0,
+                                        &ngx_http_auth_request_module);
+    if (arcf->cache == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    arcf->cache_key = ngx_palloc(cf->pool, sizeof(ngx_http_complex_value_t));
+    if (arcf->cache_key == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_memzero(&ccv, sizeof(ngx_http_compile_complex_value_t));
+
+    ccv.cf = cf;
+    ccv.value = &value[2];
+    ccv.complex_value = arcf->cache_key;
+
+    if (ngx_http_compile_complex_value(&ccv) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    arcf->cache_valid = ngx_parse_time(&value[3], 1);
+
+    if (arcf->cache_valid == (time_t) NGX_ERROR || arcf->cache_valid == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid time value \"%V\"", &value[3]);
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
@@ -0,0 +1,191 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_CACHE_STATUS_ZONE_LEN                                        \
+    (sizeof("Cache \"\" size  entries  shards \n") - 1                        \
+     + NGX_OFF_T_LEN + 2 * NGX_INT_T_LEN)
+
+#define NGX_HTTP_CACHE_STATUS_COUNTERS_LEN                                    \
+    (sizeof(" bytes  lock_waits  lock_timeouts  lock_wait_msec \n") - 1       \
+     + 4 * NGX_ATOMIC_T_LEN                                                   \
+     + NGX_HTTP_CACHE_SCARCE * (sizeof(" revalidated \n") - 1                 \
+                                + NGX_ATOMIC_T_LEN))
+
+
+static ngx_int_t ngx_http_cache_status_handler(ngx_http_request_t *r);
+static char *ngx_http_set_cache_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_cache_status_commands[] = {
+
+    { ngx_string("cache_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_set_cache_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_cache_status_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_cache_status_module = {
+    NGX_MODULE_V1,
+    &ngx_http_cache_status_module_ctx,     /* module context */
+    ngx_http_cache_status_commands,        /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/* indexed by $upstream_cache_status values */
+
+static char  *ngx_http_cache_status_names[] = {
+    NULL,
+    "miss",
+    "bypass",
+    "expired",
+    "stale",
+    "updating",
+    "revalidated",
+    "hit",
+    "scarce"
+};
+
+
+static ngx_int_t
+ngx_http_cache_status_handler(ngx_http_request_t *r)
+{
+    size_t                        size;
+    ngx_int_t                     rc;
+    ngx_buf_t                    *b;
+    ngx_uint_t                    i, k;
+    ngx_chain_t                   out;
+    ngx_cycle_t                  *cycle;
+    ngx_list_part_t              *part;
+    ngx_shm_zone_t               *shm_zone;
+    ngx_http_file_cache_stats_t   st;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    cycle = (ngx_cycle_t *) ngx_cycle;
+
+    size = 0;
+
+    for (part = &cycle->shared_memory.part; part; part = part->next) {
+        shm_zone = part->elts;
+
+        for (i = 0; i < part->nelts; i++) {
+            size += NGX_HTTP_CACHE_STATUS_ZONE_LEN + shm_zone[i].shm.name.len
+                    + NGX_HTTP_CACHE_STATUS_COUNTERS_LEN;
+        }
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    b = ngx_create_temp_buf(r->pool, size ? size : 1);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    for (part = &cycle->shared_memory.part; part; part = part->next) {
+        shm_zone = part->elts;
+
+        for (i = 0; i < part->nelts; i++) {
+
+            if (ngx_http_file_cache_stats(&shm_zone[i], &st) != NGX_OK) {
+                continue;
+            }
+
+            b->last = ngx_sprintf(b->last,
+                                  "Cache \"%V\" size %O entries %ui "
+                                  "shards %ui\n",
+                                  &shm_zone[i].shm.name, st.size, st.count,
+                                  st.shards);
+
+            for (k = 1; k <= NGX_HTTP_CACHE_SCARCE; k++) {
+                b->last = ngx_sprintf(b->last, " %s %uA",
+                                      ngx_http_cache_status_names[k],
+                                      st.counters.status[k]);
+            }
+
+            b->last = ngx_sprintf(b->last,
+                                  "\n bytes %uA lock_waits %uA "
+                                  "lock_timeouts %uA lock_wait_msec %uA\n",
+                                  st.counters.bytes, st.counters.lock_waits,
+                                  st.counters.lock_timeouts,
+                                  st.counters.lock_wait_msec);
+        }
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static char *
+ngx_http_set_cache_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_cache_status_handler;
+
+    return NGX_CONF_OK;
+}
@@ -9,6 +9,12 @@
 #include <ngx_core.h>
 #include <ngx_http.h>
 
+#if (NGX_HAVE_SSE2)
+#include <emmintrin.h>
+#elif (NGX_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
 
 #define NGX_HTTP_CHARSET_OFF    -2
 #define NGX_HTTP_NO_CHARSET     -3
@@ -22,6 +28,7 @@
 
 typedef struct {
     u_char                    **tables;
+    u_char                     *ascii;
     ngx_str_t                   name;
 
     unsigned                    length:16;
@@ -75,6 +82,7 @@ typedef struct {
     unsigned                    length:16;
     unsigned                    from_utf8:1;
     unsigned                    to_utf8:1;
+    unsigned                    ascii:1;
 } ngx_http_charset_ctx_t;
 
 
@@ -96,7 +104,8 @@ static ngx_inline void ngx_http_set_charset(ngx_http_request_t *r,
     ngx_str_t *charset);
 static ngx_int_t ngx_http_charset_ctx(ngx_http_request_t *r,
     ngx_http_charset_t *charsets, ngx_int_t charset, ngx_int_t source_charset);
-static ngx_uint_t ngx_http_charset_recode(ngx_buf_t *b, u_char *table);
+static ngx_uint_t ngx_http_charset_recode(ngx_buf_t *b, u_char *table,
+    ngx_uint_t ascii);
 static ngx_chain_t *ngx_http_charset_recode_from_utf8(ngx_pool_t *pool,
     ngx_buf_t *buf, ngx_http_charset_ctx_t *ctx);
 static ngx_chain_t *ngx_http_charset_recode_to_utf8(ngx_pool_t *pool,
@@ -106,6 +115,10 @@ static ngx_chain_t *ngx_http_charset_get_buf(ngx_pool_t *pool,
     ngx_http_charset_ctx_t *ctx);
 static ngx_chain_t *ngx_http_charset_get_buffer(ngx_pool_t *pool,
     ngx_http_charset_ctx_t *ctx, size_t size);
+static ngx_chain_t *ngx_http_charset_pass_ascii(ngx_pool_t *pool,
+    ngx_http_charset_ctx_t *ctx, ngx_buf_t *buf, u_char *pos, u_char *last);
+static ngx_inline u_char *ngx_http_charset_skip_ascii(u_char *p, u_char *last);
+static ngx_uint_t ngx_http_charset_ascii(u_char *table, ngx_uint_t utf8);
 
 static char *ngx_http_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
@@ -529,6 +542,7 @@ ngx_http_charset_ctx(ngx_http_request_t *r, ngx_http_charset_t *charsets,
     ctx->length = charsets[charset].length;
     ctx->from_utf8 = charsets[source_charset].utf8;
     ctx->to_utf8 = charsets[charset].utf8;
+    ctx->ascii = charsets[source_charset].ascii[charset];
 
     r->filter_need_in_memory = 1;
 
@@ -627,7 +641,7 @@ ngx_http_charset_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
                 b->shadow->pos = b->shadow->last;
             }
 
-            if (b->pos) {
+            if (b->start) {
                 cl->next = ctx->free_buffers;
                 ctx->free_buffers = cl;
                 continue;
@@ -641,7 +655,7 @@ ngx_http_charset_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
     }
 
     for (cl = in; cl; cl = cl->next) {
-        (void) ngx_http_charset_recode(cl->buf, ctx->table);
+        (void) ngx_http_charset_recode(cl->buf, ctx->table, ctx->ascii);
     }
 
     return ngx_http_next_body_filter(r, in);
@@ -649,7 +663,7 @@ ngx_http_charset_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
 
 static ngx_uint_t
-ngx_http_charset_recode(ngx_buf_t *b, u_char *table)
+ngx_http_charset_recode(ngx_buf_t *b, u_char *table, ngx_uint_t ascii)
 {
     u_char  *p, *last;
 
@@ -657,6 +671,14 @@ ngx_http_charset_recode(ngx_buf_t *b, u_char *table)
 
     for (p = b->pos; p < last; p++) {
 
+        if (ascii && *p < 0x80) {
+            p = ngx_http_charset_skip_ascii(p, last);
+
+            if (p == last) {
+                break;
+            }
+        }
+
         if (*p != table[*p]) {
             goto recode;
         }
@@ -667,6 +689,14 @@ ngx_http_charset_recode(ngx_buf_t *b, u_char *table)
 recode:
 
     do {
+        if (ascii && *p < 0x80) {
+            p = ngx_http_charset_skip_ascii(p, last);
+
+            if (p == last) {
+                break;
+            }
+        }
+
         if (*p != table[*p]) {
             *p = table[*p];
         }
@@ -696,11 +726,9 @@ ngx_http_charset_recode_from_utf8(ngx_pool_t *pool, ngx_buf_t *buf,
 
     if (ctx->saved_len == 0) {
 
-        for ( /* void */ ; src < buf->last; src++) {
+        src = ngx_http_charset_skip_ascii(src, buf->last);
 
-            if (*src < 0x80) {
-                continue;
-            }
+        if (src < buf->last) {
 
             len = src - buf->pos;
 
@@ -896,7 +924,36 @@ recode:
         }
 
         if (*src < 0x80) {
-            *dst++ = *src++;
+            p = ngx_http_charset_skip_ascii(src, buf->last);
+            len = p - src;
+
+            if (len > 512) {
+                b->last = dst;
+
+                if (b->pos == dst) {
+                    b->sync = 1;
+                    b->temporary = 0;
+                }
+
+                cl = ngx_http_charset_pass_ascii(pool, ctx, buf, src, p);
+                if (cl == NULL) {
+                    return NULL;
+                }
+
+                *ll = cl;
+                ll = &cl->next;
+
+                b = cl->buf;
+                src = dst = p;
+
+                continue;
+            }
+
+            len = ngx_min(len, (size_t) (b->end - dst));
+
+            dst = ngx_cpymem(dst, src, len);
+            src += len;
+
             continue;
         }
 
@@ -974,6 +1031,15 @@ ngx_http_charset_recode_to_utf8(ngx_pool_t *pool, ngx_buf_t *buf,
     table = ctx->table;
 
     for (src = buf->pos; src < buf->last; src++) {
+
+        if (ctx->ascii && *src < 0x80) {
+            src = ngx_http_charset_skip_ascii(src, buf->last);
+
+            if (src == buf->last) {
+                break;
+            }
+        }
+
         if (table[*src * NGX_UTF_LEN] == '\1') {
             continue;
         }
@@ -1050,6 +1116,42 @@ recode:
 
     while (src < buf->last) {
 
+        if (ctx->ascii && *src < 0x80) {
+            p = ngx_http_charset_skip_ascii(src, buf->last);
+            len = p - src;
+
+            if (len > 512) {
+                b->last = dst;
+
+                if (b->pos == dst) {
+                    b->sync = 1;
+                    b->temporary = 0;
+                }
+
+                cl = ngx_http_charset_pass_ascii(pool, ctx, buf, src, p);
+                if (cl == NULL) {
+                    return NULL;
+                }
+
+                *ll = cl;
+                ll = &cl->next;
+
+                b = cl->buf;
+                src = dst = p;
+
+                continue;
+            }
+
+            len = ngx_min(len, (size_t) (b->end - dst));
+
+            if (len) {
+                dst = ngx_cpymem(dst, src, len);
+                src += len;
+
+                continue;
+            }
+        }
+
         p = &table[*src++ * NGX_UTF_LEN];
         len = *p++;
 
@@ -1099,7 +1201,9 @@ ngx_http_charset_get_buf(ngx_pool_t *pool, ngx_http_charset_ctx_t *ctx)
     if (cl) {
         ctx->free_bufs = cl->next;
 
-        cl->buf->shadow = NULL;
+        ngx_memzero(cl->buf, sizeof(ngx_buf_t));
+
+        cl->buf->tag = (ngx_buf_tag_t) &ngx_http_charset_filter_module;
         cl->next = NULL;
 
         return cl;
@@ -1167,6 +1271,114 @@ ngx_http_charset_get_buffer(ngx_pool_t *pool, ngx_http_charset_ctx_t *ctx,
 }
 
 
+/*
+ * a long ASCII run is passed through as a buffer pointing into
+ * the original one; the "end" is set to the "last", so the recode loops
+ * allocate a new temporary buffer before the next character
+ */
+
+static ngx_chain_t *
+ngx_http_charset_pass_ascii(ngx_pool_t *pool, ngx_http_charset_ctx_t *ctx,
+    ngx_buf_t *buf, u_char *pos, u_char *last)
+{
+    ngx_buf_t    *b;
+    ngx_chain_t  *cl;
+
+    cl = ngx_http_charset_get_buf(pool, ctx);
+    if (cl == NULL) {
+        return NULL;
+    }
+
+    b = cl->buf;
+
+    b->temporary = buf->temporary;
+    b->memory = buf->memory;
+    b->mmap = buf->mmap;
+
+    b->pos = pos;
+    b->last = last;
+    b->end = last;
+
+    return cl;
+}
+
+
+/*
+ * skips 7-bit ASCII bytes, 16 bytes at a time if possible
+ */
+
+static ngx_inline u_char *
+ngx_http_charset_skip_ascii(u_char *p, u_char *last)
+{
+#if (NGX_HAVE_SSE2)
+
+    int       mask;
+    __m128i   v;
+
+    while (last - p >= 16) {
+        v = _mm_loadu_si128((const __m128i *) p);
+
+        mask = _mm_movemask_epi8(v);
+
+        if (mask) {
+            while (!(mask & 1)) {
+                mask >>= 1;
+                p++;
+            }
+
+            return p;
+        }
+
+        p += 16;
+    }
+
+#elif (NGX_HAVE_NEON)
+
+    uint8x16_t  v;
+
+    while (last - p >= 16) {
+        v = vld1q_u8(p);
+
+        if (vmaxvq_u8(v) >= 0x80) {
+            break;
+        }
+
+        p += 16;
+    }
+
+#endif
+
+    while (p < last && *p < 0x80) {
+        p++;
+    }
+
+    return p;
+}
+
+
+static ngx_uint_t
+ngx_http_charset_ascii(u_char *table, ngx_uint_t utf8)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < 0x80; i++) {
+
+        if (utf8) {
+            if (table[i * NGX_UTF_LEN] != 1
+                || table[i * NGX_UTF_LEN + 1] != i)
+            {
+                return 0;
+            }
+
+        } else if (table[i] != i) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
 static char *
 ngx_http_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -1568,6 +1780,10 @@ ngx_http_charset_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->source_charset, prev->source_charset,
                          NGX_HTTP_CHARSET_OFF);
 
+    if (conf->charset != NGX_HTTP_CHARSET_OFF) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
+
     if (conf->charset == NGX_HTTP_CHARSET_OFF
         || conf->source_charset == NGX_HTTP_CHARSET_OFF
         || conf->charset == conf->source_charset)
@@ -1658,6 +1874,12 @@ ngx_http_charset_postconfiguration(ngx_conf_t *cf)
             }
 
             charset[tables[t].src].tables = src;
+
+            charset[tables[t].src].ascii = ngx_pcalloc(cf->pool,
+                                                       mcf->charsets.nelts);
+            if (charset[tables[t].src].ascii == NULL) {
+                return NGX_ERROR;
+            }
         }
 
         dst = charset[tables[t].dst].tables;
@@ -1669,10 +1891,26 @@ ngx_http_charset_postconfiguration(ngx_conf_t *cf)
             }
 
             charset[tables[t].dst].tables = dst;
+
+            charset[tables[t].dst].ascii = ngx_pcalloc(cf->pool,
+                                                       mcf->charsets.nelts);
+            if (charset[tables[t].dst].ascii == NULL) {
+                return NGX_ERROR;
+            }
         }
 
         src[tables[t].dst] = tables[t].src2dst;
         dst[tables[t].src] = tables[t].dst2src;
+
+        /* ASCII is never looked up when recoding from UTF-8 */
+
+        charset[tables[t].src].ascii[tables[t].dst] =
+                 ngx_http_charset_ascii(tables[t].src2dst,
+                                        charset[tables[t].dst].utf8);
+
+        charset[tables[t].dst].ascii[tables[t].src] =
+                 charset[tables[t].dst].utf8
+                 || ngx_http_charset_ascii(tables[t].dst2src, 0);
     }
 
     ngx_http_next_header_filter = ngx_http_top_header_filter;
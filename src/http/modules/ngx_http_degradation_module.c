@@ -10,23 +10,45 @@
 #include <ngx_http.h>
 
 
+#if (NGX_THREADS)
+
+typedef struct {
+    ngx_thread_pool_t  *pool;
+    ngx_uint_t          queued;
+} ngx_http_degradation_threads_t;
+
+#endif
+
+
 typedef struct {
-    size_t      sbrk_size;
+    size_t        sbrk_size;
+    ngx_msec_t    lag;
+    ngx_uint_t    backlog;
+#if (NGX_THREADS)
+    ngx_array_t  *threads;       /* ngx_http_degradation_threads_t */
+#endif
 } ngx_http_degradation_main_conf_t;
 
 
 typedef struct {
-    ngx_uint_t  degrade;
+    ngx_uint_t    degrade;
+    time_t        retry_after;
 } ngx_http_degradation_loc_conf_t;
 
 
+#define NGX_HTTP_DEGRADATION_LAG_INTERVAL  100
+
+
 static ngx_conf_enum_t  ngx_http_degrade[] = {
     { ngx_string("204"), 204 },
     { ngx_string("444"), 444 },
+    { ngx_string("503"), 503 },
     { ngx_null_string, 0 }
 };
 
 
+static ngx_uint_t ngx_http_degradation_backlog(ngx_http_request_t *r);
+static void ngx_http_degradation_lag_handler(ngx_event_t *ev);
 static void *ngx_http_degradation_create_main_conf(ngx_conf_t *cf);
 static void *ngx_http_degradation_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_degradation_merge_loc_conf(ngx_conf_t *cf, void *parent,
@@ -34,12 +56,13 @@ static char *ngx_http_degradation_merge_loc_conf(ngx_conf_t *cf, void *parent,
 static char *ngx_http_degradation(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static ngx_int_t ngx_http_degradation_init(ngx_conf_t *cf);
+static ngx_int_t ngx_http_degradation_init_process(ngx_cycle_t *cycle);
 
 
 static ngx_command_t  ngx_http_degradation_commands[] = {
 
     { ngx_string("degradation"),
-      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      NGX_HTTP_MAIN_CONF|NGX_CONF_1MORE,
       ngx_http_degradation,
       NGX_HTTP_MAIN_CONF_OFFSET,
       0,
@@ -52,6 +75,13 @@ static ngx_command_t  ngx_http_degradation_commands[] = {
       offsetof(ngx_http_degradation_loc_conf_t, degrade),
       &ngx_http_degrade },
 
+    { ngx_string("degrade_retry_after"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_sec_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_degradation_loc_conf_t, retry_after),
+      NULL },
+
       ngx_null_command
 };
 
@@ -78,7 +108,7 @@ ngx_module_t  ngx_http_degradation_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_degradation_init_process,     /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -87,18 +117,43 @@ ngx_module_t  ngx_http_degradation_module = {
 };
 
 
+static ngx_event_t  ngx_http_degradation_lag_event;
+static ngx_msec_t   ngx_http_degradation_lag;
+static ngx_msec_t   ngx_http_degradation_lag_time;
+
+
 static ngx_int_t
 ngx_http_degradation_handler(ngx_http_request_t *r)
 {
+    ngx_table_elt_t                  *h;
     ngx_http_degradation_loc_conf_t  *dlcf;
 
     dlcf = ngx_http_get_module_loc_conf(r, ngx_http_degradation_module);
 
-    if (dlcf->degrade && ngx_http_degraded(r)) {
-        return dlcf->degrade;
+    if (dlcf->degrade == 0 || !ngx_http_degraded(r)) {
+        return NGX_DECLINED;
     }
 
-    return NGX_DECLINED;
+    if (dlcf->degrade == NGX_HTTP_SERVICE_UNAVAILABLE && dlcf->retry_after) {
+        h = ngx_list_push(&r->headers_out.headers);
+        if (h == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        h->value.data = ngx_pnalloc(r->pool, NGX_TIME_T_LEN);
+        if (h->value.data == NULL) {
+            h->hash = 0;
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        h->hash = 1;
+        h->next = NULL;
+        ngx_str_set(&h->key, "Retry-After");
+        h->value.len = ngx_sprintf(h->value.data, "%T", dlcf->retry_after)
+                       - h->value.data;
+    }
+
+    return dlcf->degrade;
 }
 
 
@@ -106,13 +161,68 @@ ngx_uint_t
 ngx_http_degraded(ngx_http_request_t *r)
 {
     time_t                             now;
-    ngx_uint_t                         log;
+    ngx_uint_t                         log, backlog;
     static size_t                      sbrk_size;
     static time_t                      sbrk_time;
+    static time_t                      log_time;
     ngx_http_degradation_main_conf_t  *dmcf;
+#if (NGX_THREADS)
+    ngx_uint_t                         i, queued;
+    ngx_http_degradation_threads_t    *t;
+#endif
 
     dmcf = ngx_http_get_module_main_conf(r, ngx_http_degradation_module);
 
+    /* the load is checked first, and is logged once a second */
+
+    log = (ngx_time() != log_time);
+
+    if (dmcf->lag && ngx_http_degradation_lag >= dmcf->lag) {
+        if (log) {
+            ngx_log_error(NGX_LOG_NOTICE, r->connection->log, 0,
+                          "degradation lag:%Mms", ngx_http_degradation_lag);
+            log_time = ngx_time();
+        }
+
+        return 1;
+    }
+
+    if (dmcf->backlog) {
+        backlog = ngx_http_degradation_backlog(r);
+
+        if (backlog >= dmcf->backlog) {
+            if (log) {
+                ngx_log_error(NGX_LOG_NOTICE, r->connection->log, 0,
+                              "degradation backlog:%ui", backlog);
+                log_time = ngx_time();
+            }
+
+            return 1;
+        }
+    }
+
+#if (NGX_THREADS)
+
+    if (dmcf->threads) {
+        t = dmcf->threads->elts;
+
+        for (i = 0; i < dmcf->threads->nelts; i++) {
+            queued = ngx_thread_pool_stats(t[i].pool)->queued;
+
+            if (queued >= t[i].queued) {
+                if (log) {
+                    ngx_log_error(NGX_LOG_NOTICE, r->connection->log, 0,
+                                  "degradation threads:%ui", queued);
+                    log_time = ngx_time();
+                }
+
+                return 1;
+            }
+        }
+    }
+
+#endif
+
     if (dmcf->sbrk_size) {
 
         log = 0;
@@ -151,6 +261,88 @@ ngx_http_degraded(ngx_http_request_t *r)
 }
 
 
+static ngx_uint_t
+ngx_http_degradation_backlog(ngx_http_request_t *r)
+{
+#if (NGX_HAVE_TCP_INFO)
+
+    socklen_t               len;
+    ngx_listening_t        *ls;
+    struct tcp_info         ti;
+    static ngx_uint_t       backlog;
+    static ngx_msec_t       backlog_time;
+    static ngx_listening_t *backlog_ls;
+
+    ls = r->connection->listening;
+
+    if (ls == NULL || ls->type != SOCK_STREAM) {
+        return 0;
+    }
+
+    /*
+     * for listening sockets, Linux reports the number of connections
+     * in the accept queue as tcpi_unacked; the value is cached for a
+     * timer resolution tick
+     */
+
+    if (ls == backlog_ls && ngx_current_msec == backlog_time) {
+        return backlog;
+    }
+
+    len = sizeof(struct tcp_info);
+
+    if (getsockopt(ls->fd, IPPROTO_TCP, TCP_INFO, &ti, &len) == -1) {
+        return 0;
+    }
+
+    backlog = ti.tcpi_unacked;
+    backlog_time = ngx_current_msec;
+    backlog_ls = ls;
+
+    return backlog;
+
+#else
+
+    return 0;
+
+#endif
+}
+
+
+static void
+ngx_http_degradation_lag_handler(ngx_event_t *ev)
+{
+    ngx_msec_int_t  lag;
+
+    /*
+     * the event loop lag is estimated from how late a periodic timer
+     * expires, as an exponentially weighted moving average; the expected
+     * time is kept separately as the timer key is reset on deletion
+     */
+
+    lag = (ngx_msec_int_t) (ngx_current_msec - ngx_http_degradation_lag_time);
+
+    if (lag < 0) {
+        lag = 0;
+    }
+
+    ngx_http_degradation_lag = (ngx_http_degradation_lag * 3 + lag) / 4;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "degradation lag: %M, average: %M",
+                   (ngx_msec_t) lag, ngx_http_degradation_lag);
+
+    if (ngx_exiting) {
+        return;
+    }
+
+    ngx_http_degradation_lag_time = ngx_current_msec
+                                    + NGX_HTTP_DEGRADATION_LAG_INTERVAL;
+
+    ngx_add_timer(ev, NGX_HTTP_DEGRADATION_LAG_INTERVAL);
+}
+
+
 static void *
 ngx_http_degradation_create_main_conf(ngx_conf_t *cf)
 {
@@ -161,6 +353,15 @@ ngx_http_degradation_create_main_conf(ngx_conf_t *cf)
         return NULL;
     }
 
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     dmcf->sbrk_size = 0;
+     *     dmcf->lag = 0;
+     *     dmcf->backlog = 0;
+     *     dmcf->threads = NULL;
+     */
+
     return dmcf;
 }
 
@@ -176,6 +377,7 @@ ngx_http_degradation_create_loc_conf(ngx_conf_t *cf)
     }
 
     conf->degrade = NGX_CONF_UNSET_UINT;
+    conf->retry_after = NGX_CONF_UNSET;
 
     return conf;
 }
@@ -188,6 +390,7 @@ ngx_http_degradation_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_http_degradation_loc_conf_t  *conf = child;
 
     ngx_conf_merge_uint_value(conf->degrade, prev->degrade, 0);
+    ngx_conf_merge_sec_value(conf->retry_after, prev->retry_after, 0);
 
     return NGX_CONF_OK;
 }
@@ -198,27 +401,124 @@ ngx_http_degradation(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_http_degradation_main_conf_t  *dmcf = conf;
 
-    ngx_str_t  *value, s;
+    ngx_int_t                        n;
+    ngx_str_t                       *value, s;
+    ngx_uint_t                       i;
+#if (NGX_THREADS)
+    u_char                          *p;
+    ngx_http_degradation_threads_t  *t;
+#endif
 
     value = cf->args->elts;
 
-    if (ngx_strncmp(value[1].data, "sbrk=", 5) == 0) {
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "sbrk=", 5) == 0) {
+
+            s.len = value[i].len - 5;
+            s.data = value[i].data + 5;
+
+            dmcf->sbrk_size = ngx_parse_size(&s);
+            if (dmcf->sbrk_size == (size_t) NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid sbrk size \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "lag=", 4) == 0) {
+
+            s.len = value[i].len - 4;
+            s.data = value[i].data + 4;
+
+            dmcf->lag = ngx_parse_time(&s, 0);
+            if (dmcf->lag == (ngx_msec_t) NGX_ERROR || dmcf->lag == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid lag \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "backlog=", 8) == 0) {
+
+#if (NGX_HAVE_TCP_INFO)
+            n = ngx_atoi(value[i].data + 8, value[i].len - 8);
+            if (n == NGX_ERROR || n == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid backlog \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            dmcf->backlog = n;
+
+            continue;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"%V\" is not supported "
+                               "on this platform", &value[i]);
+            return NGX_CONF_ERROR;
+#endif
+        }
+
+        if (ngx_strncmp(value[i].data, "threads=", 8) == 0) {
+
+#if (NGX_THREADS)
+            s.data = value[i].data + 8;
+            p = ngx_strlchr(s.data, value[i].data + value[i].len, ':');
+
+            if (p == NULL || p == s.data) {
+                goto invalid;
+            }
+
+            s.len = p - s.data;
+
+            n = ngx_atoi(p + 1, value[i].data + value[i].len - p - 1);
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            if (dmcf->threads == NULL) {
+                dmcf->threads = ngx_array_create(cf->pool, 1,
+                                       sizeof(ngx_http_degradation_threads_t));
+                if (dmcf->threads == NULL) {
+                    return NGX_CONF_ERROR;
+                }
+            }
+
+            t = ngx_array_push(dmcf->threads);
+            if (t == NULL) {
+                return NGX_CONF_ERROR;
+            }
+
+            t->pool = ngx_thread_pool_add(cf, &s);
+            if (t->pool == NULL) {
+                return NGX_CONF_ERROR;
+            }
 
-        s.len = value[1].len - 5;
-        s.data = value[1].data + 5;
+            t->queued = n;
 
-        dmcf->sbrk_size = ngx_parse_size(&s);
-        if (dmcf->sbrk_size == (size_t) NGX_ERROR) {
+            continue;
+#else
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                               "invalid sbrk size \"%V\"", &value[1]);
+                               "\"%V\" requires thread pools support",
+                               &value[i]);
             return NGX_CONF_ERROR;
+#endif
         }
 
-        return NGX_CONF_OK;
+        goto invalid;
     }
 
+    return NGX_CONF_OK;
+
+invalid:
+
     ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                       "invalid parameter \"%V\"", &value[1]);
+                       "invalid parameter \"%V\"", &value[i]);
 
     return NGX_CONF_ERROR;
 }
@@ -241,3 +541,32 @@ ngx_http_degradation_init(ngx_conf_t *cf)
 
     return NGX_OK;
 }
+
+
+static ngx_int_t
+ngx_http_degradation_init_process(ngx_cycle_t *cycle)
+{
+    ngx_event_t                       *ev;
+    ngx_http_degradation_main_conf_t  *dmcf;
+
+    dmcf = ngx_http_cycle_get_module_main_conf(cycle,
+                                               ngx_http_degradation_module);
+
+    if (dmcf == NULL || dmcf->lag == 0) {
+        return NGX_OK;
+    }
+
+    ev = &ngx_http_degradation_lag_event;
+
+    ev->handler = ngx_http_degradation_lag_handler;
+    ev->log = cycle->log;
+    ev->data = cycle;
+    ev->cancelable = 1;
+
+    ngx_http_degradation_lag_time = ngx_current_msec
+                                    + NGX_HTTP_DEGRADATION_LAG_INTERVAL;
+
+    ngx_add_timer(ev, NGX_HTTP_DEGRADATION_LAG_INTERVAL);
+
+    return NGX_OK;
+}
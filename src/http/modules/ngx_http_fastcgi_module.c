@@ -24,6 +24,14 @@ typedef struct {
 } ngx_http_fastcgi_params_t;
 
 
+/*
+ * consecutive parameters without variables are encoded at configuration
+ * time into a single block, marked with this skip_empty value
+ */
+
+#define NGX_HTTP_FASTCGI_PARAMS_BLOCK  2
+
+
 typedef struct {
     ngx_http_upstream_conf_t       upstream;
 
@@ -176,6 +184,8 @@ static char *ngx_http_fastcgi_merge_loc_conf(ngx_conf_t *cf,
 static ngx_int_t ngx_http_fastcgi_init_params(ngx_conf_t *cf,
     ngx_http_fastcgi_loc_conf_t *conf, ngx_http_fastcgi_params_t *params,
     ngx_keyval_t *default_params);
+static ngx_int_t ngx_http_fastcgi_add_params_block(
+    ngx_http_fastcgi_params_t *params, ngx_array_t *block);
 
 static ngx_int_t ngx_http_fastcgi_script_name_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
@@ -296,6 +306,13 @@ static ngx_command_t  ngx_http_fastcgi_commands[] = {
       offsetof(ngx_http_fastcgi_loc_conf_t, upstream.socket_keepalive),
       NULL },
 
+    { ngx_string("fastcgi_fastopen"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_fastcgi_loc_conf_t, upstream.fastopen),
+      NULL },
+
     { ngx_string("fastcgi_connect_timeout"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_msec_slot,
@@ -487,6 +504,13 @@ static ngx_command_t  ngx_http_fastcgi_commands[] = {
       offsetof(ngx_http_fastcgi_loc_conf_t, upstream.cache_background_update),
       NULL },
 
+    { ngx_string("fastcgi_cache_write_back"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_set_complex_value_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_fastcgi_loc_conf_t, upstream.cache_write_back),
+      NULL },
+
 #endif
 
     { ngx_string("fastcgi_temp_path"),
@@ -887,6 +911,11 @@ ngx_http_fastcgi_create_request(ngx_http_request_t *r)
             }
             le.ip += sizeof(uintptr_t);
 
+            if (skip_empty == NGX_HTTP_FASTCGI_PARAMS_BLOCK) {
+                len += key_len;
+                continue;
+            }
+
             if (skip_empty && val_len == 0) {
                 continue;
             }
@@ -1066,6 +1095,20 @@ ngx_http_fastcgi_create_request(ngx_http_request_t *r)
             }
             le.ip += sizeof(uintptr_t);
 
+            if (skip_empty == NGX_HTTP_FASTCGI_PARAMS_BLOCK) {
+
+                while (*(uintptr_t *) e.ip) {
+                    code = *(ngx_http_script_code_pt *) e.ip;
+                    code((ngx_http_script_engine_t *) &e);
+                }
+                e.ip += sizeof(uintptr_t);
+
+                ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                               "fastcgi static params block");
+
+                continue;
+            }
+
             if (skip_empty && val_len == 0) {
                 e.skip = 1;
 
@@ -2890,6 +2933,7 @@ ngx_http_fastcgi_create_loc_conf(ngx_conf_t *cf)
 
     conf->upstream.local = NGX_CONF_UNSET_PTR;
     conf->upstream.socket_keepalive = NGX_CONF_UNSET;
+    conf->upstream.fastopen = NGX_CONF_UNSET;
 
     conf->upstream.connect_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.send_timeout = NGX_CONF_UNSET_MSEC;
@@ -2919,6 +2963,7 @@ ngx_http_fastcgi_create_loc_conf(ngx_conf_t *cf)
     conf->upstream.cache_lock_age = NGX_CONF_UNSET_MSEC;
     conf->upstream.cache_revalidate = NGX_CONF_UNSET;
     conf->upstream.cache_background_update = NGX_CONF_UNSET;
+    conf->upstream.cache_write_back = NGX_CONF_UNSET_PTR;
 #endif
 
     conf->upstream.hide_headers = NGX_CONF_UNSET_PTR;
@@ -2996,6 +3041,9 @@ ngx_http_fastcgi_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->upstream.socket_keepalive,
                               prev->upstream.socket_keepalive, 0);
 
+    ngx_conf_merge_value(conf->upstream.fastopen,
+                              prev->upstream.fastopen, 0);
+
     ngx_conf_merge_msec_value(conf->upstream.connect_timeout,
                               prev->upstream.connect_timeout, 60000);
 
@@ -3217,6 +3265,9 @@ ngx_http_fastcgi_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->upstream.cache_background_update,
                               prev->upstream.cache_background_update, 0);
 
+    ngx_conf_merge_ptr_value(conf->upstream.cache_write_back,
+                              prev->upstream.cache_write_back, NULL);
+
 #endif
 
     ngx_conf_merge_value(conf->upstream.pass_request_headers,
@@ -3316,10 +3367,10 @@ ngx_http_fastcgi_init_params(ngx_conf_t *cf, ngx_http_fastcgi_loc_conf_t *conf,
     ngx_http_fastcgi_params_t *params, ngx_keyval_t *default_params)
 {
     u_char                       *p;
-    size_t                        size;
+    size_t                        size, key_len, val_len;
     uintptr_t                    *code;
     ngx_uint_t                    i, nsrc;
-    ngx_array_t                   headers_names, params_merged;
+    ngx_array_t                   headers_names, params_merged, block;
     ngx_keyval_t                 *h;
     ngx_hash_key_t               *hk;
     ngx_hash_init_t               hash;
@@ -3352,6 +3403,10 @@ ngx_http_fastcgi_init_params(ngx_conf_t *cf, ngx_http_fastcgi_loc_conf_t *conf,
         return NGX_ERROR;
     }
 
+    if (ngx_array_init(&block, cf->temp_pool, 256, 1) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     if (conf->params_source) {
         src = conf->params_source->elts;
         nsrc = conf->params_source->nelts;
@@ -3430,6 +3485,53 @@ ngx_http_fastcgi_init_params(ngx_conf_t *cf, ngx_http_fastcgi_loc_conf_t *conf,
             }
         }
 
+        if (ngx_http_script_variables_count(&src[i].value) == 0) {
+
+            if (src[i].skip_empty && src[i].value.len == 0) {
+                continue;
+            }
+
+            key_len = src[i].key.len;
+            val_len = src[i].value.len;
+
+            size = ((key_len > 127) ? 4 : 1) + key_len
+                   + ((val_len > 127) ? 4 : 1) + val_len;
+
+            p = ngx_array_push_n(&block, size);
+            if (p == NULL) {
+                return NGX_ERROR;
+            }
+
+            if (key_len > 127) {
+                *p++ = (u_char) (((key_len >> 24) & 0x7f) | 0x80);
+                *p++ = (u_char) ((key_len >> 16) & 0xff);
+                *p++ = (u_char) ((key_len >> 8) & 0xff);
+                *p++ = (u_char) (key_len & 0xff);
+
+            } else {
+                *p++ = (u_char) key_len;
+            }
+
+            if (val_len > 127) {
+                *p++ = (u_char) (((val_len >> 24) & 0x7f) | 0x80);
+                *p++ = (u_char) ((val_len >> 16) & 0xff);
+                *p++ = (u_char) ((val_len >> 8) & 0xff);
+                *p++ = (u_char) (val_len & 0xff);
+
+            } else {
+                *p++ = (u_char) val_len;
+            }
+
+            p = ngx_cpymem(p, src[i].key.data, key_len);
+            ngx_memcpy(p, src[i].value.data, val_len);
+
+            continue;
+        }
+
+        if (ngx_http_fastcgi_add_params_block(params, &block) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
         copy = ngx_array_push_n(params->lengths,
                                 sizeof(ngx_http_script_copy_code_t));
         if (copy == NULL) {
@@ -3495,6 +3597,10 @@ ngx_http_fastcgi_init_params(ngx_conf_t *cf, ngx_http_fastcgi_loc_conf_t *conf,
         *code = (uintptr_t) NULL;
     }
 
+    if (ngx_http_fastcgi_add_params_block(params, &block) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     code = ngx_array_push_n(params->lengths, sizeof(uintptr_t));
     if (code == NULL) {
         return NGX_ERROR;
@@ -3516,6 +3622,75 @@ ngx_http_fastcgi_init_params(ngx_conf_t *cf, ngx_http_fastcgi_loc_conf_t *conf,
 }
 
 
+static ngx_int_t
+ngx_http_fastcgi_add_params_block(ngx_http_fastcgi_params_t *params,
+    ngx_array_t *block)
+{
+    u_char                       *p;
+    size_t                        size;
+    uintptr_t                    *code;
+    ngx_http_script_copy_code_t  *copy;
+
+    if (block->nelts == 0) {
+        return NGX_OK;
+    }
+
+    copy = ngx_array_push_n(params->lengths,
+                            sizeof(ngx_http_script_copy_code_t));
+    if (copy == NULL) {
+        return NGX_ERROR;
+    }
+
+    copy->code = (ngx_http_script_code_pt) (void *)
+                                             ngx_http_script_copy_len_code;
+    copy->len = block->nelts;
+
+    copy = ngx_array_push_n(params->lengths,
+                            sizeof(ngx_http_script_copy_code_t));
+    if (copy == NULL) {
+        return NGX_ERROR;
+    }
+
+    copy->code = (ngx_http_script_code_pt) (void *)
+                                             ngx_http_script_copy_len_code;
+    copy->len = NGX_HTTP_FASTCGI_PARAMS_BLOCK;
+
+    code = ngx_array_push_n(params->lengths, sizeof(uintptr_t));
+    if (code == NULL) {
+        return NGX_ERROR;
+    }
+
+    *code = (uintptr_t) NULL;
+
+
+    size = (sizeof(ngx_http_script_copy_code_t)
+            + block->nelts + sizeof(uintptr_t) - 1)
+           & ~(sizeof(uintptr_t) - 1);
+
+    copy = ngx_array_push_n(params->values, size);
+    if (copy == NULL) {
+        return NGX_ERROR;
+    }
+
+    copy->code = ngx_http_script_copy_code;
+    copy->len = block->nelts;
+
+    p = (u_char *) copy + sizeof(ngx_http_script_copy_code_t);
+    ngx_memcpy(p, block->elts, block->nelts);
+
+    code = ngx_array_push_n(params->values, sizeof(uintptr_t));
+    if (code == NULL) {
+        return NGX_ERROR;
+    }
+
+    *code = (uintptr_t) NULL;
+
+    block->nelts = 0;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_fastcgi_script_name_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
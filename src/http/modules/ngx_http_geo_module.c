@@ -66,6 +66,22 @@ typedef struct {
 } ngx_http_geo_conf_ctx_t;
 
 
+typedef struct ngx_http_geo_binary_s  ngx_http_geo_binary_t;
+
+struct ngx_http_geo_binary_s {
+    ngx_http_geo_binary_t           *next;
+    ngx_uint_t                       count;
+
+    u_char                          *base;
+    ngx_http_geo_range_t           **ranges;
+
+    ngx_file_uniq_t                  uniq;
+    time_t                           mtime;
+    size_t                           size;
+    ngx_str_t                        name;
+};
+
+
 typedef struct {
     union {
         ngx_http_geo_trees_t         trees;
@@ -105,6 +121,7 @@ static char *ngx_http_geo_include(ngx_conf_t *cf, ngx_http_geo_conf_ctx_t *ctx,
     ngx_str_t *name);
 static ngx_int_t ngx_http_geo_include_binary_base(ngx_conf_t *cf,
     ngx_http_geo_conf_ctx_t *ctx, ngx_str_t *name);
+static void ngx_http_geo_binary_base_cleanup(void *data);
 static void ngx_http_geo_create_binary_base(ngx_http_geo_conf_ctx_t *ctx);
 static u_char *ngx_http_geo_copy_values(u_char *base, u_char *p,
     ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel);
@@ -168,6 +185,16 @@ static ngx_http_geo_header_t  ngx_http_geo_header = {
 };
 
 
+/*
+ * binary bases are kept outside of the cycle pools and shared by all
+ * cycles which include the same unchanged file, so a reload does not
+ * read a large base again and does not keep another copy of it while
+ * old worker processes exit; the workers share the pages with the master
+ */
+
+static ngx_http_geo_binary_t  *ngx_http_geo_binary_bases;
+
+
 /* geo range is AF_INET only */
 
 static ngx_int_t
@@ -567,6 +594,16 @@ ngx_http_geo_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             goto failed;
         }
 #endif
+
+        if (ngx_radix_tree_compile(ctx.tree) != NGX_OK) {
+            goto failed;
+        }
+
+#if (NGX_HAVE_INET6)
+        if (ngx_radix_tree_compile(ctx.tree6) != NGX_OK) {
+            goto failed;
+        }
+#endif
     }
 
     ngx_destroy_pool(ctx.temp_pool);
@@ -1412,7 +1449,10 @@ ngx_http_geo_include_binary_base(ngx_conf_t *cf, ngx_http_geo_conf_ctx_t *ctx,
     ngx_uint_t                  i;
     ngx_file_t                  file;
     ngx_file_info_t             fi;
+    ngx_file_uniq_t             uniq;
+    ngx_pool_cleanup_t         *cln;
     ngx_http_geo_range_t       *range, **ranges;
+    ngx_http_geo_binary_t      *bin;
     ngx_http_geo_header_t      *header;
     ngx_http_variable_value_t  *vv;
 
@@ -1420,6 +1460,8 @@ ngx_http_geo_include_binary_base(ngx_conf_t *cf, ngx_http_geo_conf_ctx_t *ctx,
     file.name = *name;
     file.log = cf->log;
 
+    base = NULL;
+
     file.fd = ngx_open_file(name->data, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
 
     if (file.fd == NGX_INVALID_FILE) {
@@ -1455,6 +1497,7 @@ ngx_http_geo_include_binary_base(ngx_conf_t *cf, ngx_http_geo_conf_ctx_t *ctx,
 
     size = (size_t) ngx_file_size(&fi);
     mtime = ngx_file_mtime(&fi);
+    uniq = ngx_file_uniq(&fi);
 
     ch = name->data[name->len - 4];
     name->data[name->len - 4] = '\0';
@@ -1473,7 +1516,31 @@ ngx_http_geo_include_binary_base(ngx_conf_t *cf, ngx_http_geo_conf_ctx_t *ctx,
         goto failed;
     }
 
-    base = ngx_palloc(ctx->pool, size);
+    cln = ngx_pool_cleanup_add(ctx->pool, 0);
+    if (cln == NULL) {
+        goto failed;
+    }
+
+    for (bin = ngx_http_geo_binary_bases; bin; bin = bin->next) {
+
+        if (bin->uniq == uniq
+            && bin->mtime == mtime
+            && bin->size == size
+            && bin->name.len == name->len
+            && ngx_strncmp(bin->name.data, name->data, name->len) == 0)
+        {
+            bin->count++;
+
+            cln->handler = ngx_http_geo_binary_base_cleanup;
+            cln->data = bin;
+
+            ranges = bin->ranges;
+
+            goto found;
+        }
+    }
+
+    base = ngx_alloc(size, cf->log);
     if (base == NULL) {
         goto failed;
     }
@@ -1547,6 +1614,29 @@ ngx_http_geo_include_binary_base(ngx_conf_t *cf, ngx_http_geo_conf_ctx_t *ctx,
         goto failed;
     }
 
+    bin = ngx_alloc(sizeof(ngx_http_geo_binary_t) + name->len, cf->log);
+    if (bin == NULL) {
+        goto failed;
+    }
+
+    bin->next = ngx_http_geo_binary_bases;
+    bin->count = 1;
+    bin->base = base;
+    bin->ranges = ranges;
+    bin->uniq = uniq;
+    bin->mtime = mtime;
+    bin->size = size;
+    bin->name.len = name->len;
+    bin->name.data = (u_char *) bin + sizeof(ngx_http_geo_binary_t);
+    ngx_memcpy(bin->name.data, name->data, name->len);
+
+    ngx_http_geo_binary_bases = bin;
+
+    cln->handler = ngx_http_geo_binary_base_cleanup;
+    cln->data = bin;
+
+found:
+
     ngx_conf_log_error(NGX_LOG_NOTICE, cf, 0,
                        "using binary geo range base \"%s\"", name->data);
 
@@ -1559,6 +1649,10 @@ ngx_http_geo_include_binary_base(ngx_conf_t *cf, ngx_http_geo_conf_ctx_t *ctx,
 
 failed:
 
+    if (base) {
+        ngx_free(base);
+    }
+
     rc = NGX_DECLINED;
 
 done:
@@ -1572,6 +1666,28 @@ done:
 }
 
 
+static void
+ngx_http_geo_binary_base_cleanup(void *data)
+{
+    ngx_http_geo_binary_t  *bin = data;
+
+    ngx_http_geo_binary_t  **p;
+
+    if (--bin->count) {
+        return;
+    }
+
+    for (p = &ngx_http_geo_binary_bases; *p != bin; p = &(*p)->next) {
+        /* void */
+    }
+
+    *p = bin->next;
+
+    ngx_free(bin->base);
+    ngx_free(bin);
+}
+
+
 static void
 ngx_http_geo_create_binary_base(ngx_http_geo_conf_ctx_t *ctx)
 {
@@ -30,6 +30,8 @@ typedef struct {
     ngx_array_t               *grpc_lengths;
     ngx_array_t               *grpc_values;
 
+    ngx_flag_t                 web;
+
 #if (NGX_HTTP_SSL)
     ngx_uint_t                 ssl;
     ngx_uint_t                 ssl_protocols;
@@ -110,6 +112,14 @@ typedef struct {
     size_t                     field_rest;
     u_char                     field_state;
 
+    ngx_str_t                  web_type;
+    ngx_chain_t               *web_free;
+    ngx_chain_t               *web_busy;
+    ngx_uint_t                 web_nin;
+    ngx_uint_t                 web_nout;
+    u_char                     web_in[4];
+    u_char                     web_out[3];
+
     unsigned                   literal:1;
     unsigned                   field_huffman:1;
 
@@ -122,10 +132,13 @@ typedef struct {
     unsigned                   status:1;
     unsigned                   rst:1;
     unsigned                   goaway:1;
+    unsigned                   web:1;
+    unsigned                   web_text:1;
+    unsigned                   web_done:1;
 
     ngx_http_request_t        *request;
 
-    ngx_str_t                  host;
+    ngx_http_grpc_request_t    req;
 } ngx_http_grpc_ctx_t;
 
 
@@ -142,6 +155,8 @@ typedef struct {
 } ngx_http_grpc_frame_t;
 
 
+static void ngx_http_grpc_set_upstream(ngx_http_request_t *r,
+    ngx_http_grpc_ctx_t *ctx);
 static ngx_int_t ngx_http_grpc_eval(ngx_http_request_t *r,
     ngx_http_grpc_ctx_t *ctx, ngx_http_grpc_loc_conf_t *glcf);
 static ngx_int_t ngx_http_grpc_create_request(ngx_http_request_t *r);
@@ -151,6 +166,21 @@ static ngx_int_t ngx_http_grpc_process_header(ngx_http_request_t *r);
 static ngx_int_t ngx_http_grpc_filter_init(void *data);
 static ngx_int_t ngx_http_grpc_filter(void *data, ssize_t bytes);
 
+static void ngx_http_grpc_web_init(ngx_http_request_t *r,
+    ngx_http_grpc_ctx_t *ctx);
+static ngx_chain_t *ngx_http_grpc_web_decode(ngx_http_request_t *r,
+    ngx_http_grpc_ctx_t *ctx, ngx_chain_t *in);
+static ngx_int_t ngx_http_grpc_web_process_header(ngx_http_request_t *r,
+    ngx_http_grpc_ctx_t *ctx);
+static ngx_int_t ngx_http_grpc_web_filter(void *data, ssize_t bytes);
+static ngx_int_t ngx_http_grpc_web_trailers(ngx_http_request_t *r,
+    ngx_http_grpc_ctx_t *ctx, ngx_str_t *frame);
+static ngx_int_t ngx_http_grpc_web_encode(ngx_http_request_t *r,
+    ngx_http_grpc_ctx_t *ctx, ngx_chain_t *in, ngx_str_t *frame,
+    ngx_chain_t **out);
+static u_char *ngx_http_grpc_web_encode_data(ngx_http_grpc_ctx_t *ctx,
+    u_char *p, u_char *data, size_t len);
+
 static ngx_int_t ngx_http_grpc_parse_frame(ngx_http_request_t *r,
     ngx_http_grpc_ctx_t *ctx, ngx_buf_t *b);
 static ngx_int_t ngx_http_grpc_parse_header(ngx_http_request_t *r,
@@ -192,6 +222,10 @@ static void ngx_http_grpc_finalize_request(ngx_http_request_t *r,
 
 static ngx_int_t ngx_http_grpc_internal_trailers_variable(
     ngx_http_request_t *r, ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_grpc_internal_content_type_variable(
+    ngx_http_request_t *r, ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_grpc_internal_body_length_variable(
+    ngx_http_request_t *r, ngx_http_variable_value_t *v, uintptr_t data);
 
 static ngx_int_t ngx_http_grpc_add_variables(ngx_conf_t *cf);
 static void *ngx_http_grpc_create_loc_conf(ngx_conf_t *cf);
@@ -274,6 +308,20 @@ static ngx_command_t  ngx_http_grpc_commands[] = {
       offsetof(ngx_http_grpc_loc_conf_t, upstream.socket_keepalive),
       NULL },
 
+    { ngx_string("grpc_fastopen"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_grpc_loc_conf_t, upstream.fastopen),
+      NULL },
+
+    { ngx_string("grpc_web"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_grpc_loc_conf_t, web),
+      NULL },
+
     { ngx_string("grpc_connect_timeout"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_msec_slot,
@@ -501,7 +549,8 @@ static u_char  ngx_http_grpc_connection_start[] =
 
 
 static ngx_keyval_t  ngx_http_grpc_headers[] = {
-    { ngx_string("Content-Length"), ngx_string("$content_length") },
+    { ngx_string("Content-Length"), ngx_string("$grpc_internal_body_length") },
+    { ngx_string("Content-Type"), ngx_string("$grpc_internal_content_type") },
     { ngx_string("TE"), ngx_string("$grpc_internal_trailers") },
     { ngx_string("Host"), ngx_string("") },
     { ngx_string("Connection"), ngx_string("") },
@@ -531,6 +580,14 @@ static ngx_http_variable_t  ngx_http_grpc_vars[] = {
       ngx_http_grpc_internal_trailers_variable, 0,
       NGX_HTTP_VAR_NOCACHEABLE|NGX_HTTP_VAR_NOHASH, 0 },
 
+    { ngx_string("grpc_internal_content_type"), NULL,
+      ngx_http_grpc_internal_content_type_variable, 0,
+      NGX_HTTP_VAR_NOCACHEABLE|NGX_HTTP_VAR_NOHASH, 0 },
+
+    { ngx_string("grpc_internal_body_length"), NULL,
+      ngx_http_grpc_internal_body_length_variable, 0,
+      NGX_HTTP_VAR_NOCACHEABLE|NGX_HTTP_VAR_NOHASH, 0 },
+
       ngx_http_null_variable
 };
 
@@ -560,8 +617,14 @@ ngx_http_grpc_handler(ngx_http_request_t *r)
 
     u = r->upstream;
 
+    ctx->req.host_set = glcf->host_set;
+    ctx->req.headers_flushes = glcf->headers.flushes;
+    ctx->req.headers_lengths = glcf->headers.lengths;
+    ctx->req.headers_values = glcf->headers.values;
+    ctx->req.headers_hash = &glcf->headers.hash;
+
     if (glcf->grpc_lengths == NULL) {
-        ctx->host = glcf->host;
+        ctx->req.host = glcf->host;
 
 #if (NGX_HTTP_SSL)
         u->ssl = glcf->ssl;
@@ -586,15 +649,11 @@ ngx_http_grpc_handler(ngx_http_request_t *r)
 
     u->conf = &glcf->upstream;
 
-    u->create_request = ngx_http_grpc_create_request;
-    u->reinit_request = ngx_http_grpc_reinit_request;
-    u->process_header = ngx_http_grpc_process_header;
-    u->abort_request = ngx_http_grpc_abort_request;
-    u->finalize_request = ngx_http_grpc_finalize_request;
+    ngx_http_grpc_set_upstream(r, ctx);
 
-    u->input_filter_init = ngx_http_grpc_filter_init;
-    u->input_filter = ngx_http_grpc_filter;
-    u->input_filter_ctx = ctx;
+    if (glcf->web && r->headers_in.content_type) {
+        ngx_http_grpc_web_init(r, ctx);
+    }
 
     r->request_body_no_buffering = 1;
 
@@ -608,6 +667,51 @@ ngx_http_grpc_handler(ngx_http_request_t *r)
 }
 
 
+ngx_int_t
+ngx_http_grpc_init_request(ngx_http_request_t *r, ngx_http_grpc_request_t *gr)
+{
+    ngx_http_grpc_ctx_t  *ctx;
+
+    /*
+     * sends the request of another upstream module, such as proxy,
+     * over http2; the upstream is created and configured by the caller
+     */
+
+    ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_grpc_ctx_t));
+    if (ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->request = r;
+    ctx->req = *gr;
+
+    ngx_http_set_ctx(r, ctx, ngx_http_grpc_module);
+
+    ngx_http_grpc_set_upstream(r, ctx);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_grpc_set_upstream(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx)
+{
+    ngx_http_upstream_t  *u;
+
+    u = r->upstream;
+
+    u->create_request = ngx_http_grpc_create_request;
+    u->reinit_request = ngx_http_grpc_reinit_request;
+    u->process_header = ngx_http_grpc_process_header;
+    u->abort_request = ngx_http_grpc_abort_request;
+    u->finalize_request = ngx_http_grpc_finalize_request;
+
+    u->input_filter_init = ngx_http_grpc_filter_init;
+    u->input_filter = ngx_http_grpc_filter;
+    u->input_filter_ctx = ctx;
+}
+
+
 static ngx_int_t
 ngx_http_grpc_eval(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx,
     ngx_http_grpc_loc_conf_t *glcf)
@@ -690,15 +794,15 @@ ngx_http_grpc_eval(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx,
     if (url.family != AF_UNIX) {
 
         if (url.no_port) {
-            ctx->host = url.host;
+            ctx->req.host = url.host;
 
         } else {
-            ctx->host.len = url.host.len + 1 + url.port_text.len;
-            ctx->host.data = url.host.data;
+            ctx->req.host.len = url.host.len + 1 + url.port_text.len;
+            ctx->req.host.data = url.host.data;
         }
 
     } else {
-        ngx_str_set(&ctx->host, "localhost");
+        ngx_str_set(&ctx->req.host, "localhost");
     }
 
     return NGX_OK;
@@ -712,7 +816,8 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
     size_t                        len, tmp_len, key_len, val_len, uri_len;
     uintptr_t                     escape;
     ngx_buf_t                    *b;
-    ngx_uint_t                    i, next;
+    ngx_str_t                     method;
+    ngx_uint_t                    i, next, index;
     ngx_chain_t                  *cl, *body;
     ngx_list_part_t              *part;
     ngx_table_elt_t              *header;
@@ -720,14 +825,11 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
     ngx_http_upstream_t          *u;
     ngx_http_grpc_frame_t        *f;
     ngx_http_script_code_pt       code;
-    ngx_http_grpc_loc_conf_t     *glcf;
     ngx_http_script_engine_t      e, le;
     ngx_http_script_len_code_pt   lcode;
 
     u = r->upstream;
 
-    glcf = ngx_http_get_module_loc_conf(r, ngx_http_grpc_module);
-
     ctx = ngx_http_get_module_ctx(r, ngx_http_grpc_module);
 
     len = sizeof(ngx_http_grpc_connection_start) - 1
@@ -735,13 +837,30 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
 
     /* :method header */
 
-    if (r->method == NGX_HTTP_GET || r->method == NGX_HTTP_POST) {
+    if (ctx->req.method.len) {
+        method = ctx->req.method;
+
+    } else {
+        method = r->method_name;
+    }
+
+    if (method.len == 3 && ngx_strncmp(method.data, "GET", 3) == 0) {
+        index = NGX_HTTP_V2_METHOD_GET_INDEX;
+
+    } else if (method.len == 4 && ngx_strncmp(method.data, "POST", 4) == 0) {
+        index = NGX_HTTP_V2_METHOD_POST_INDEX;
+
+    } else {
+        index = 0;
+    }
+
+    if (index) {
         len += 1;
         tmp_len = 0;
 
     } else {
-        len += 1 + NGX_HTTP_V2_INT_OCTETS + r->method_name.len;
-        tmp_len = r->method_name.len;
+        len += 1 + NGX_HTTP_V2_INT_OCTETS + method.len;
+        tmp_len = method.len;
     }
 
     /* :scheme header */
@@ -750,7 +869,11 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
 
     /* :path header */
 
-    if (r->valid_unparsed_uri) {
+    if (ctx->req.path.len) {
+        escape = 0;
+        uri_len = ctx->req.path.len;
+
+    } else if (r->valid_unparsed_uri) {
         escape = 0;
         uri_len = r->unparsed_uri.len;
 
@@ -768,20 +891,20 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
 
     /* :authority header */
 
-    if (!glcf->host_set) {
-        len += 1 + NGX_HTTP_V2_INT_OCTETS + ctx->host.len;
+    if (!ctx->req.host_set) {
+        len += 1 + NGX_HTTP_V2_INT_OCTETS + ctx->req.host.len;
 
-        if (tmp_len < ctx->host.len) {
-            tmp_len = ctx->host.len;
+        if (tmp_len < ctx->req.host.len) {
+            tmp_len = ctx->req.host.len;
         }
     }
 
     /* other headers */
 
-    ngx_http_script_flush_no_cacheable_variables(r, glcf->headers.flushes);
+    ngx_http_script_flush_no_cacheable_variables(r, ctx->req.headers_flushes);
     ngx_memzero(&le, sizeof(ngx_http_script_engine_t));
 
-    le.ip = glcf->headers.lengths->elts;
+    le.ip = ctx->req.headers_lengths->elts;
     le.request = r;
     le.flushed = 1;
 
@@ -811,7 +934,7 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
         }
     }
 
-    if (glcf->upstream.pass_request_headers) {
+    if (u->conf->pass_request_headers) {
         part = &r->headers_in.headers.part;
         header = part->elts;
 
@@ -827,7 +950,7 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
                 i = 0;
             }
 
-            if (ngx_hash_find(&glcf->headers.hash, header[i].hash,
+            if (ngx_hash_find(ctx->req.headers_hash, header[i].hash,
                               header[i].lowcase_key, header[i].key.len))
             {
                 continue;
@@ -895,27 +1018,18 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
     f->stream_id_2 = 0;
     f->stream_id_3 = 1;
 
-    if (r->method == NGX_HTTP_GET) {
-        *b->last++ = ngx_http_v2_indexed(NGX_HTTP_V2_METHOD_GET_INDEX);
-
-        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "grpc header: \":method: GET\"");
-
-    } else if (r->method == NGX_HTTP_POST) {
-        *b->last++ = ngx_http_v2_indexed(NGX_HTTP_V2_METHOD_POST_INDEX);
-
-        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "grpc header: \":method: POST\"");
+    if (index) {
+        *b->last++ = ngx_http_v2_indexed(index);
 
     } else {
         *b->last++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_METHOD_INDEX);
-        b->last = ngx_http_v2_write_value(b->last, r->method_name.data,
-                                          r->method_name.len, tmp);
-
-        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "grpc header: \":method: %V\"", &r->method_name);
+        b->last = ngx_http_v2_write_value(b->last, method.data, method.len,
+                                          tmp);
     }
 
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "grpc header: \":method: %V\"", &method);
+
 #if (NGX_HTTP_SSL)
     if (u->ssl) {
         *b->last++ = ngx_http_v2_indexed(NGX_HTTP_V2_SCHEME_HTTPS_INDEX);
@@ -931,7 +1045,21 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
                        "grpc header: \":scheme: http\"");
     }
 
-    if (r->valid_unparsed_uri) {
+    if (ctx->req.path.len) {
+
+        if (ctx->req.path.len == 1 && ctx->req.path.data[0] == '/') {
+            *b->last++ = ngx_http_v2_indexed(NGX_HTTP_V2_PATH_ROOT_INDEX);
+
+        } else {
+            *b->last++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_PATH_INDEX);
+            b->last = ngx_http_v2_write_value(b->last, ctx->req.path.data,
+                                              ctx->req.path.len, tmp);
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "grpc header: \":path: %V\"", &ctx->req.path);
+
+    } else if (r->valid_unparsed_uri) {
 
         if (r->unparsed_uri.len == 1 && r->unparsed_uri.data[0] == '/') {
             *b->last++ = ngx_http_v2_indexed(NGX_HTTP_V2_PATH_ROOT_INDEX);
@@ -976,22 +1104,22 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
                        "grpc header: \":path: %V\"", &r->uri);
     }
 
-    if (!glcf->host_set) {
+    if (!ctx->req.host_set) {
         *b->last++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_AUTHORITY_INDEX);
-        b->last = ngx_http_v2_write_value(b->last, ctx->host.data,
-                                          ctx->host.len, tmp);
+        b->last = ngx_http_v2_write_value(b->last, ctx->req.host.data,
+                                          ctx->req.host.len, tmp);
 
         ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "grpc header: \":authority: %V\"", &ctx->host);
+                       "grpc header: \":authority: %V\"", &ctx->req.host);
     }
 
     ngx_memzero(&e, sizeof(ngx_http_script_engine_t));
 
-    e.ip = glcf->headers.values->elts;
+    e.ip = ctx->req.headers_values->elts;
     e.request = r;
     e.flushed = 1;
 
-    le.ip = glcf->headers.lengths->elts;
+    le.ip = ctx->req.headers_lengths->elts;
 
     while (*(uintptr_t *) le.ip) {
 
@@ -1047,7 +1175,7 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
 #endif
     }
 
-    if (glcf->upstream.pass_request_headers) {
+    if (u->conf->pass_request_headers) {
         part = &r->headers_in.headers.part;
         header = part->elts;
 
@@ -1063,7 +1191,7 @@ ngx_http_grpc_create_request(ngx_http_request_t *r)
                 i = 0;
             }
 
-            if (ngx_hash_find(&glcf->headers.hash, header[i].hash,
+            if (ngx_hash_find(ctx->req.headers_hash, header[i].hash,
                               header[i].lowcase_key, header[i].key.len))
             {
                 continue;
@@ -1214,6 +1342,9 @@ ngx_http_grpc_reinit_request(ngx_http_request_t *r)
     ctx->status = 0;
     ctx->rst = 0;
     ctx->goaway = 0;
+    ctx->web_done = 0;
+    ctx->web_nin = 0;
+    ctx->web_nout = 0;
     ctx->connection = NULL;
 
     return NGX_OK;
@@ -1245,6 +1376,13 @@ ngx_http_grpc_body_output_filter(void *data, ngx_chain_t *in)
         return NGX_ERROR;
     }
 
+    if (in && ctx->web_text) {
+        in = ngx_http_grpc_web_decode(r, ctx, in);
+        if (in == NGX_CHAIN_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
     if (in) {
         if (ngx_chain_add_copy(r->pool, &ctx->in, in) != NGX_OK) {
             return NGX_ERROR;
@@ -1914,6 +2052,12 @@ ngx_http_grpc_process_header(ngx_http_request_t *r)
                 ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                                "grpc header done");
 
+                if (ctx->web
+                    && ngx_http_grpc_web_process_header(r, ctx) != NGX_OK)
+                {
+                    return NGX_ERROR;
+                }
+
                 if (ctx->end_stream) {
                     u->headers_in.content_length_n = 0;
 
@@ -2505,6 +2649,555 @@ ngx_http_grpc_filter(void *data, ssize_t bytes)
 }
 
 
+static void
+ngx_http_grpc_web_init(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx)
+{
+    size_t   len;
+    u_char  *p;
+
+    /*
+     * "application/grpc-web[+proto]" and "application/grpc-web-text[+proto]"
+     * requests are sent to the upstream as "application/grpc[+proto]"
+     */
+
+    p = r->headers_in.content_type->value.data;
+    len = r->headers_in.content_type->value.len;
+
+    if (len < sizeof("application/grpc-web") - 1
+        || ngx_strncasecmp(p, (u_char *) "application/grpc-web",
+                           sizeof("application/grpc-web") - 1)
+           != 0)
+    {
+        return;
+    }
+
+    p += sizeof("application/grpc-web") - 1;
+    len -= sizeof("application/grpc-web") - 1;
+
+    if (len >= sizeof("-text") - 1
+        && ngx_strncasecmp(p, (u_char *) "-text", sizeof("-text") - 1) == 0)
+    {
+        p += sizeof("-text") - 1;
+        len -= sizeof("-text") - 1;
+
+        ctx->web_text = 1;
+    }
+
+    if (len && *p != '+' && *p != ';') {
+        ctx->web_text = 0;
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "grpc web%s", ctx->web_text ? " text" : "");
+
+    ctx->web = 1;
+    ctx->web_type.len = len;
+    ctx->web_type.data = p;
+
+    r->upstream->input_filter = ngx_http_grpc_web_filter;
+}
+
+
+static ngx_chain_t *
+ngx_http_grpc_web_decode(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx,
+    ngx_chain_t *in)
+{
+    u_char       *p;
+    size_t        size;
+    ngx_buf_t    *b, *header;
+    ngx_str_t     src, dst;
+    ngx_chain_t  *cl, *out, **ll;
+
+    /*
+     * the text request body is decoded by 4-character quanta, so
+     * separately padded messages can be concatenated
+     */
+
+    /* the first buffer sent contains headers */
+
+    header = ctx->header_sent ? NULL : in->buf;
+
+    out = NULL;
+    ll = &out;
+
+    for ( /* void */ ; in; in = in->next) {
+
+        if (in->buf == header) {
+            b = in->buf;
+            goto next;
+        }
+
+        if (!ngx_buf_special(in->buf) && !ngx_buf_in_memory(in->buf)) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "grpc-web text request body in file "
+                          "is not supported");
+            return NGX_CHAIN_ERROR;
+        }
+
+        b = ngx_calloc_buf(r->pool);
+        if (b == NULL) {
+            return NGX_CHAIN_ERROR;
+        }
+
+        size = (ctx->web_nin + (in->buf->last - in->buf->pos)) / 4 * 3;
+
+        if (size) {
+            b->start = ngx_pnalloc(r->pool, size);
+            if (b->start == NULL) {
+                return NGX_CHAIN_ERROR;
+            }
+
+            b->pos = b->start;
+            b->last = b->start;
+            b->end = b->start + size;
+            b->temporary = 1;
+        }
+
+        for (p = in->buf->pos; p < in->buf->last; p++) {
+
+            ctx->web_in[ctx->web_nin++] = *p;
+
+            if (ctx->web_nin < 4) {
+                continue;
+            }
+
+            ctx->web_nin = 0;
+
+            src.len = 4;
+            src.data = ctx->web_in;
+            dst.data = b->last;
+
+            if (ngx_decode_base64(&dst, &src) != NGX_OK) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                              "client sent invalid base64 in "
+                              "grpc-web text request body");
+                return NGX_CHAIN_ERROR;
+            }
+
+            b->last += dst.len;
+        }
+
+        in->buf->pos = in->buf->last;
+
+        b->flush = in->buf->flush;
+        b->last_buf = in->buf->last_buf;
+        b->last_in_chain = in->buf->last_in_chain;
+
+        if (b->last_buf && ctx->web_nin) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "client sent truncated grpc-web text request body");
+            return NGX_CHAIN_ERROR;
+        }
+
+        if (b->pos == b->last && !ngx_buf_special(b)) {
+            continue;
+        }
+
+    next:
+
+        cl = ngx_alloc_chain_link(r->pool);
+        if (cl == NULL) {
+            return NGX_CHAIN_ERROR;
+        }
+
+        cl->buf = b;
+        *ll = cl;
+        ll = &cl->next;
+    }
+
+    *ll = NULL;
+
+    return out;
+}
+
+
+static ngx_int_t
+ngx_http_grpc_web_process_header(ngx_http_request_t *r,
+    ngx_http_grpc_ctx_t *ctx)
+{
+    u_char               *p, *last;
+    size_t                len;
+    ngx_table_elt_t      *h;
+    ngx_http_upstream_t  *u;
+
+    u = r->upstream;
+    h = u->headers_in.content_type;
+
+    if (h
+        && h->value.len >= sizeof("application/grpc") - 1
+        && ngx_strncasecmp(h->value.data, (u_char *) "application/grpc",
+                           sizeof("application/grpc") - 1)
+           == 0)
+    {
+        len = h->value.len + (ctx->web_text ? sizeof("-web-text") - 1
+                                            : sizeof("-web") - 1);
+
+        p = ngx_pnalloc(r->pool, len);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        last = ngx_cpymem(p, "application/grpc-web",
+                          sizeof("application/grpc-web") - 1);
+
+        if (ctx->web_text) {
+            last = ngx_cpymem(last, "-text", sizeof("-text") - 1);
+        }
+
+        ngx_memcpy(last, h->value.data + sizeof("application/grpc") - 1,
+                   h->value.len - (sizeof("application/grpc") - 1));
+
+        h->value.len = len;
+        h->value.data = p;
+    }
+
+    if (!ctx->end_stream) {
+        /* trailers will be sent in the response body */
+        u->headers_in.content_length_n = -1;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_grpc_web_filter(void *data, ssize_t bytes)
+{
+    ngx_http_grpc_ctx_t  *ctx = data;
+
+    ngx_int_t             rc;
+    ngx_str_t             frame;
+    ngx_buf_t            *b;
+    ngx_chain_t          *cl, *in, **ll;
+    ngx_http_request_t   *r;
+    ngx_http_upstream_t  *u;
+
+    r = ctx->request;
+    u = r->upstream;
+
+    for (ll = &u->out_bufs; *ll; ll = &(*ll)->next) { /* void */ }
+
+    rc = ngx_http_grpc_filter(data, bytes);
+
+    if (rc == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    ngx_str_null(&frame);
+
+    if (ctx->done && !ctx->web_done) {
+        ctx->web_done = 1;
+
+        if (ngx_http_grpc_web_trailers(r, ctx, &frame) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (ctx->web_text) {
+        in = *ll;
+        *ll = NULL;
+
+        if (ngx_http_grpc_web_encode(r, ctx, in, &frame, ll) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        return rc;
+    }
+
+    if (frame.len) {
+        cl = ngx_chain_get_free_buf(r->pool, &u->free_bufs);
+        if (cl == NULL) {
+            return NGX_ERROR;
+        }
+
+        b = cl->buf;
+
+        b->flush = 1;
+        b->memory = 1;
+
+        b->pos = frame.data;
+        b->last = frame.data + frame.len;
+        b->tag = u->output.tag;
+
+        while (*ll) {
+            ll = &(*ll)->next;
+        }
+
+        *ll = cl;
+    }
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_http_grpc_web_trailers(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx,
+    ngx_str_t *frame)
+{
+    u_char               *p;
+    size_t                len;
+    ngx_uint_t            i;
+    ngx_list_part_t      *part;
+    ngx_table_elt_t      *h;
+    ngx_http_upstream_t  *u;
+
+    /*
+     * trailers are sent as the last message, with the 0x80 flag,
+     * in the HTTP/1.x header format
+     */
+
+    u = r->upstream;
+
+    len = 0;
+
+    part = &u->headers_in.trailers.part;
+    h = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            h = part->elts;
+            i = 0;
+        }
+
+        if (ngx_hash_find(&u->conf->hide_headers_hash, h[i].hash,
+                          h[i].lowcase_key, h[i].key.len))
+        {
+            continue;
+        }
+
+        len += h[i].key.len + sizeof(":" CRLF) - 1 + h[i].value.len;
+    }
+
+    if (len == 0) {
+        return NGX_OK;
+    }
+
+    p = ngx_pnalloc(r->pool, 5 + len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    frame->len = 5 + len;
+    frame->data = p;
+
+    *p++ = 0x80;
+    *p++ = (u_char) ((len >> 24) & 0xff);
+    *p++ = (u_char) ((len >> 16) & 0xff);
+    *p++ = (u_char) ((len >> 8) & 0xff);
+    *p++ = (u_char) (len & 0xff);
+
+    part = &u->headers_in.trailers.part;
+    h = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            h = part->elts;
+            i = 0;
+        }
+
+        if (ngx_hash_find(&u->conf->hide_headers_hash, h[i].hash,
+                          h[i].lowcase_key, h[i].key.len))
+        {
+            continue;
+        }
+
+        p = ngx_copy(p, h[i].key.data, h[i].key.len);
+        *p++ = ':';
+        p = ngx_copy(p, h[i].value.data, h[i].value.len);
+        *p++ = CR; *p++ = LF;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "grpc web trailers: %uz", len);
+
+    /* the trailers are not sent again as HTTP trailers */
+
+    if (ngx_list_init(&u->headers_in.trailers, r->pool, 2,
+                      sizeof(ngx_table_elt_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_grpc_web_encode(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx,
+    ngx_chain_t *in, ngx_str_t *frame, ngx_chain_t **out)
+{
+    u_char               *p;
+    size_t                size, len;
+    ngx_buf_t            *b;
+    ngx_str_t             src, dst;
+    ngx_chain_t          *cl, *ln, *next;
+    ngx_http_upstream_t  *u;
+
+    u = r->upstream;
+
+    size = ctx->web_nout + frame->len;
+
+    for (cl = in; cl; cl = cl->next) {
+        size += cl->buf->last - cl->buf->pos;
+    }
+
+    if (ctx->web_done) {
+        size = ngx_base64_encoded_length(size);
+
+    } else {
+        size = size / 3 * 4;
+    }
+
+    b = NULL;
+    p = NULL;
+
+    if (size) {
+
+        /*
+         * the encoded data are copied to own buffers, which are
+         * reused once sent
+         */
+
+        cl = ngx_chain_get_free_buf(r->pool, &ctx->web_free);
+        if (cl == NULL) {
+            return NGX_ERROR;
+        }
+
+        b = cl->buf;
+
+        if ((size_t) (b->end - b->start) < size) {
+            len = ngx_base64_encoded_length(u->conf->buffer_size);
+            len = ngx_max(len, size);
+
+            b->start = ngx_palloc(r->pool, len);
+            if (b->start == NULL) {
+                return NGX_ERROR;
+            }
+
+            b->end = b->start + len;
+        }
+
+        b->pos = b->start;
+        b->last = b->start;
+        b->temporary = 1;
+        b->flush = 1;
+        b->tag = (ngx_buf_tag_t) &ngx_http_grpc_web_encode;
+
+        ln = ngx_alloc_chain_link(r->pool);
+        if (ln == NULL) {
+            return NGX_ERROR;
+        }
+
+        ln->buf = b;
+        ln->next = NULL;
+
+        *out = ln;
+
+        ngx_chain_update_chains(r->pool, &ctx->web_free, &ctx->web_busy, &cl,
+                                (ngx_buf_tag_t) &ngx_http_grpc_web_encode);
+
+        p = b->pos;
+    }
+
+    for (cl = in; cl; cl = next) {
+        p = ngx_http_grpc_web_encode_data(ctx, p, cl->buf->pos,
+                                          cl->buf->last - cl->buf->pos);
+
+        /* the data are copied, the buffer can be reused */
+
+        next = cl->next;
+        cl->next = u->free_bufs;
+        u->free_bufs = cl;
+    }
+
+    if (frame->len) {
+        p = ngx_http_grpc_web_encode_data(ctx, p, frame->data, frame->len);
+    }
+
+    if (ctx->web_done && ctx->web_nout) {
+        src.len = ctx->web_nout;
+        src.data = ctx->web_out;
+        dst.data = p;
+
+        ngx_encode_base64(&dst, &src);
+
+        p += dst.len;
+        ctx->web_nout = 0;
+    }
+
+    if (b) {
+        b->last = p;
+    }
+
+    return NGX_OK;
+}
+
+
+static u_char *
+ngx_http_grpc_web_encode_data(ngx_http_grpc_ctx_t *ctx, u_char *p,
+    u_char *data, size_t len)
+{
+    size_t     n;
+    ngx_str_t  src, dst;
+
+    /* only complete 3-byte groups are encoded, the rest is kept */
+
+    if (ctx->web_nout) {
+        n = ngx_min(3 - ctx->web_nout, len);
+
+        ngx_memcpy(&ctx->web_out[ctx->web_nout], data, n);
+
+        ctx->web_nout += n;
+        data += n;
+        len -= n;
+
+        if (ctx->web_nout < 3) {
+            return p;
+        }
+
+        src.len = 3;
+        src.data = ctx->web_out;
+        dst.data = p;
+
+        ngx_encode_base64(&dst, &src);
+
+        p += dst.len;
+        ctx->web_nout = 0;
+    }
+
+    n = len / 3 * 3;
+
+    if (n) {
+        src.len = n;
+        src.data = data;
+        dst.data = p;
+
+        ngx_encode_base64(&dst, &src);
+
+        p += dst.len;
+    }
+
+    ngx_memcpy(ctx->web_out, data + n, len - n);
+    ctx->web_nout = len - n;
+
+    return p;
+}
+
+
 static ngx_int_t
 ngx_http_grpc_parse_frame(ngx_http_request_t *r, ngx_http_grpc_ctx_t *ctx,
     ngx_buf_t *b)
@@ -4216,13 +4909,19 @@ ngx_http_grpc_get_connection_data(ngx_http_request_t *r,
             }
         }
 
-        if (ctx->connection == NULL) {
+        if (ctx->connection == NULL && c->requests > 1) {
             ngx_log_error(NGX_LOG_ERR, c->log, 0,
                           "no connection data found for "
                           "keepalive http2 connection");
             return NGX_ERROR;
         }
 
+        /* a connection prewarmed by keepalive, used for the first time */
+
+        if (ctx->connection == NULL) {
+            goto new;
+        }
+
         ctx->send_window = ctx->connection->init_window;
         ctx->recv_window = NGX_HTTP_V2_MAX_WINDOW;
 
@@ -4232,6 +4931,8 @@ ngx_http_grpc_get_connection_data(ngx_http_request_t *r,
         return NGX_OK;
     }
 
+new:
+
     cln = ngx_pool_cleanup_add(c->pool, sizeof(ngx_http_grpc_conn_t));
     if (cln == NULL) {
         return NGX_ERROR;
@@ -4287,7 +4988,15 @@ static ngx_int_t
 ngx_http_grpc_internal_trailers_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
 {
-    ngx_table_elt_t  *te;
+    ngx_table_elt_t      *te;
+    ngx_http_grpc_ctx_t  *ctx;
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_grpc_module);
+
+    if (ctx && ctx->web) {
+        /* grpc-web clients do not send "TE: trailers" */
+        goto trailers;
+    }
 
     te = r->headers_in.te;
 
@@ -4304,6 +5013,8 @@ ngx_http_grpc_internal_trailers_variable(ngx_http_request_t *r,
         return NGX_OK;
     }
 
+trailers:
+
     v->valid = 1;
     v->no_cacheable = 0;
     v->not_found = 0;
@@ -4315,6 +5026,78 @@ ngx_http_grpc_internal_trailers_variable(ngx_http_request_t *r,
 }
 
 
+static ngx_int_t
+ngx_http_grpc_internal_content_type_variable(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    u_char               *p;
+    ngx_table_elt_t      *h;
+    ngx_http_grpc_ctx_t  *ctx;
+
+    h = r->headers_in.content_type;
+
+    if (h == NULL) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_grpc_module);
+
+    if (ctx && ctx->web) {
+        v->len = sizeof("application/grpc") - 1 + ctx->web_type.len;
+
+        p = ngx_pnalloc(r->pool, v->len);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        v->data = p;
+
+        p = ngx_cpymem(p, "application/grpc", sizeof("application/grpc") - 1);
+        ngx_memcpy(p, ctx->web_type.data, ctx->web_type.len);
+
+    } else {
+        v->len = h->value.len;
+        v->data = h->value.data;
+    }
+
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_grpc_internal_body_length_variable(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    ngx_str_t                   name;
+    ngx_http_grpc_ctx_t        *ctx;
+    ngx_http_variable_value_t  *vv;
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_grpc_module);
+
+    if (ctx && ctx->web_text) {
+        /* the length of the decoded body is not known in advance */
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    ngx_str_set(&name, "content_length");
+
+    vv = ngx_http_get_variable(r, &name, ngx_hash_key(name.data, name.len));
+    if (vv == NULL) {
+        return NGX_ERROR;
+    }
+
+    *v = *vv;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_grpc_add_variables(ngx_conf_t *cf)
 {
@@ -4365,6 +5148,8 @@ ngx_http_grpc_create_loc_conf(ngx_conf_t *cf)
 
     conf->upstream.local = NGX_CONF_UNSET_PTR;
     conf->upstream.socket_keepalive = NGX_CONF_UNSET;
+    conf->upstream.fastopen = NGX_CONF_UNSET;
+    conf->web = NGX_CONF_UNSET;
     conf->upstream.next_upstream_tries = NGX_CONF_UNSET_UINT;
     conf->upstream.connect_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.send_timeout = NGX_CONF_UNSET_MSEC;
@@ -4429,6 +5214,11 @@ ngx_http_grpc_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->upstream.socket_keepalive,
                               prev->upstream.socket_keepalive, 0);
 
+    ngx_conf_merge_value(conf->upstream.fastopen,
+                              prev->upstream.fastopen, 0);
+
+    ngx_conf_merge_value(conf->web, prev->web, 0);
+
     ngx_conf_merge_uint_value(conf->upstream.next_upstream_tries,
                               prev->upstream.next_upstream_tries, 0);
 
@@ -0,0 +1,36 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_HTTP_GRPC_H_INCLUDED_
+#define _NGX_HTTP_GRPC_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+typedef struct {
+    ngx_str_t                  method;
+    ngx_str_t                  path;
+    ngx_str_t                  host;
+    ngx_uint_t                 host_set;
+
+    ngx_array_t               *headers_flushes;
+    ngx_array_t               *headers_lengths;
+    ngx_array_t               *headers_values;
+    ngx_hash_t                *headers_hash;
+} ngx_http_grpc_request_t;
+
+
+ngx_int_t ngx_http_grpc_init_request(ngx_http_request_t *r,
+    ngx_http_grpc_request_t *gr);
+
+
+extern ngx_module_t  ngx_http_grpc_module;
+
+
+#endif /* _NGX_HTTP_GRPC_H_INCLUDED_ */
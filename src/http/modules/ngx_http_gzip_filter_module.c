@@ -12,6 +12,27 @@
 #include <zlib.h>
 
 
+#define NGX_HTTP_GZIP_PRESET_SPEED     0
+#define NGX_HTTP_GZIP_PRESET_BALANCED  1
+#define NGX_HTTP_GZIP_PRESET_RATIO     2
+
+
+typedef struct {
+    ngx_int_t            level;
+    size_t               wbits;
+    size_t               memlevel;
+} ngx_http_gzip_preset_t;
+
+
+#if (NGX_HTTP_CACHE)
+
+typedef struct {
+    ngx_array_t          caches;  /* ngx_http_file_cache_t * */
+} ngx_http_gzip_main_conf_t;
+
+#endif
+
+
 typedef struct {
     ngx_flag_t           enable;
     ngx_flag_t           no_buffer;
@@ -21,12 +42,17 @@ typedef struct {
     ngx_bufs_t           bufs;
 
     size_t               postpone_gzipping;
+    ngx_uint_t           preset;
     ngx_int_t            level;
     size_t               wbits;
     size_t               memlevel;
     ssize_t              min_length;
 
     ngx_array_t         *types_keys;
+
+#if (NGX_HTTP_CACHE)
+    ngx_shm_zone_t      *cache_zone;
+#endif
 } ngx_http_gzip_conf_t;
 
 
@@ -58,10 +84,17 @@ typedef struct {
     unsigned             buffering:1;
     unsigned             zlib_ng:1;
     unsigned             state_allocated:1;
+    unsigned             cache:1;
 
     size_t               zin;
     size_t               zout;
 
+#if (NGX_HTTP_CACHE)
+    off_t                cache_length;
+    ngx_temp_file_t     *temp_file;
+    ngx_chain_t         *cache_header;
+#endif
+
     z_stream             zstream;
     ngx_http_request_t  *request;
 } ngx_http_gzip_ctx_t;
@@ -88,6 +121,15 @@ static void ngx_http_gzip_filter_free(void *opaque, void *address);
 static void ngx_http_gzip_filter_free_copy_buf(ngx_http_request_t *r,
     ngx_http_gzip_ctx_t *ctx);
 
+#if (NGX_HTTP_CACHE)
+static ngx_int_t ngx_http_gzip_cache_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_gzip_cache_start(ngx_http_request_t *r,
+    ngx_http_gzip_ctx_t *ctx);
+static void ngx_http_gzip_cache_write(ngx_http_request_t *r,
+    ngx_http_gzip_ctx_t *ctx);
+static void ngx_http_gzip_cache_cleanup(void *data);
+#endif
+
 static ngx_int_t ngx_http_gzip_add_variables(ngx_conf_t *cf);
 static ngx_int_t ngx_http_gzip_ratio_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
@@ -98,6 +140,35 @@ static char *ngx_http_gzip_merge_conf(ngx_conf_t *cf,
     void *parent, void *child);
 static char *ngx_http_gzip_window(ngx_conf_t *cf, void *post, void *data);
 static char *ngx_http_gzip_hash(ngx_conf_t *cf, void *post, void *data);
+static ngx_uint_t ngx_http_gzip_zlib_ng(void);
+#if (NGX_HTTP_CACHE)
+static void *ngx_http_gzip_create_main_conf(ngx_conf_t *cf);
+static char *ngx_http_gzip_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+#endif
+
+
+static ngx_conf_enum_t  ngx_http_gzip_preset[] = {
+    { ngx_string("speed"), NGX_HTTP_GZIP_PRESET_SPEED },
+    { ngx_string("balanced"), NGX_HTTP_GZIP_PRESET_BALANCED },
+    { ngx_string("ratio"), NGX_HTTP_GZIP_PRESET_RATIO },
+    { ngx_null_string, 0 }
+};
+
+
+/*
+ * zlib-ng is faster on all levels, and its level 1 uses a static
+ * Huffman tree only, so its presets are shifted to higher levels
+ */
+
+static ngx_http_gzip_preset_t  ngx_http_gzip_presets[2][3] = {
+
+    /* zlib */
+    { { 1, 15, 8 }, { 4, 15, 8 }, { 6, 15, 9 } },
+
+    /* zlib-ng */
+    { { 2, 15, 8 }, { 6, 15, 8 }, { 9, 15, 8 } }
+};
 
 
 static ngx_conf_num_bounds_t  ngx_http_gzip_comp_level_bounds = {
@@ -108,6 +179,9 @@ static ngx_conf_post_handler_pt  ngx_http_gzip_window_p = ngx_http_gzip_window;
 static ngx_conf_post_handler_pt  ngx_http_gzip_hash_p = ngx_http_gzip_hash;
 
 
+ngx_module_t  ngx_http_gzip_filter_module;
+
+
 static ngx_command_t  ngx_http_gzip_filter_commands[] = {
 
     { ngx_string("gzip"),
@@ -132,6 +206,13 @@ static ngx_command_t  ngx_http_gzip_filter_commands[] = {
       offsetof(ngx_http_gzip_conf_t, types_keys),
       &ngx_http_html_default_types[0] },
 
+    { ngx_string("gzip_preset"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_enum_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_gzip_conf_t, preset),
+      &ngx_http_gzip_preset },
+
     { ngx_string("gzip_comp_level"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_num_slot,
@@ -174,6 +255,24 @@ static ngx_command_t  ngx_http_gzip_filter_commands[] = {
       offsetof(ngx_http_gzip_conf_t, min_length),
       NULL },
 
+#if (NGX_HTTP_CACHE)
+
+    { ngx_string("gzip_cache_path"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_2MORE,
+      ngx_http_file_cache_set_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_gzip_main_conf_t, caches),
+      &ngx_http_gzip_filter_module },
+
+    { ngx_string("gzip_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_gzip_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+#endif
+
       ngx_null_command
 };
 
@@ -182,7 +281,11 @@ static ngx_http_module_t  ngx_http_gzip_filter_module_ctx = {
     ngx_http_gzip_add_variables,           /* preconfiguration */
     ngx_http_gzip_filter_init,             /* postconfiguration */
 
+#if (NGX_HTTP_CACHE)
+    ngx_http_gzip_create_main_conf,        /* create main configuration */
+#else
     NULL,                                  /* create main configuration */
+#endif
     NULL,                                  /* init main configuration */
 
     NULL,                                  /* create server configuration */
@@ -263,18 +366,33 @@ ngx_http_gzip_header_filter(ngx_http_request_t *r)
         return ngx_http_next_header_filter(r);
     }
 
-    ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_gzip_ctx_t));
+    /* the context may be already created by the cache handler */
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_gzip_filter_module);
+
     if (ctx == NULL) {
-        return NGX_ERROR;
-    }
+        ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_gzip_ctx_t));
+        if (ctx == NULL) {
+            return NGX_ERROR;
+        }
 
-    ngx_http_set_ctx(r, ctx, ngx_http_gzip_filter_module);
+        ngx_http_set_ctx(r, ctx, ngx_http_gzip_filter_module);
+    }
 
     ctx->request = r;
     ctx->buffering = (conf->postpone_gzipping != 0);
+    ctx->done = 0;
 
     ngx_http_gzip_filter_memory(r, ctx);
 
+#if (NGX_HTTP_CACHE)
+
+    if (ctx->cache && ngx_http_gzip_cache_start(r, ctx) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+#endif
+
     h = ngx_list_push(&r->headers_out.headers);
     if (h == NULL) {
         return NGX_ERROR;
@@ -427,6 +545,14 @@ ngx_http_gzip_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
             return ctx->busy ? NGX_AGAIN : NGX_OK;
         }
 
+#if (NGX_HTTP_CACHE)
+
+        if (ctx->temp_file) {
+            ngx_http_gzip_cache_write(r, ctx);
+        }
+
+#endif
+
         rc = ngx_http_next_body_filter(r, ctx->out);
 
         if (rc == NGX_ERROR) {
@@ -999,6 +1125,337 @@ ngx_http_gzip_filter_free_copy_buf(ngx_http_request_t *r,
 }
 
 
+#if (NGX_HTTP_CACHE)
+
+static ngx_int_t
+ngx_http_gzip_cache_handler(ngx_http_request_t *r)
+{
+    u_char                    *last;
+    size_t                     root;
+    ngx_int_t                  rc;
+    ngx_str_t                  path, *key;
+    ngx_log_t                 *log;
+    ngx_table_elt_t           *h;
+    ngx_http_cache_t          *c;
+    ngx_open_file_info_t       of;
+    ngx_http_gzip_ctx_t       *ctx;
+    ngx_http_gzip_conf_t      *conf;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    if (r != r->main || !(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_DECLINED;
+    }
+
+    if (r->uri.data[r->uri.len - 1] == '/') {
+        return NGX_DECLINED;
+    }
+
+    conf = ngx_http_get_module_loc_conf(r, ngx_http_gzip_filter_module);
+
+    if (!conf->enable || conf->cache_zone == NULL) {
+        return NGX_DECLINED;
+    }
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    /* the cache file is read synchronously */
+
+    if (clcf->aio != NGX_HTTP_AIO_OFF) {
+        return NGX_DECLINED;
+    }
+
+    if (ngx_http_gzip_ok(r) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    if (ngx_http_set_content_type(r) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    if (ngx_http_test_content_type(r, &conf->types) == NULL) {
+        return NGX_DECLINED;
+    }
+
+    log = r->connection->log;
+
+    last = ngx_http_map_uri_to_path(r, &path, &root, 0);
+    if (last == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    path.len = last - path.data;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
+                   "http gzip cache filename: \"%s\"", path.data);
+
+    ngx_memzero(&of, sizeof(ngx_open_file_info_t));
+
+    of.test_only = 1;
+    of.valid = clcf->open_file_cache_valid;
+    of.min_uses = clcf->open_file_cache_min_uses;
+    of.errors = clcf->open_file_cache_errors;
+    of.events = clcf->open_file_cache_events;
+
+    if (ngx_http_set_disable_symlinks(r, clcf, &path, &of) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    /* the static module reports errors */
+
+    if (ngx_open_cached_file(clcf->open_file_cache, &path, &of, r->pool)
+        != NGX_OK)
+    {
+        return NGX_DECLINED;
+    }
+
+    if (!of.is_file || of.size < conf->min_length) {
+        return NGX_DECLINED;
+    }
+
+    if (ngx_http_file_cache_new(r) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    c = r->cache;
+
+    key = ngx_array_push_n(&c->keys, 2);
+    if (key == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    key[0] = path;
+
+    key[1].data = ngx_pnalloc(r->pool,
+                              sizeof(" :: ") - 1 + NGX_TIME_T_LEN
+                              + NGX_OFF_T_LEN + 3 * NGX_INT_T_LEN);
+    if (key[1].data == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    key[1].len = ngx_sprintf(key[1].data, " %T %O %i:%uz:%uz",
+                             of.mtime, of.size, conf->level,
+                             conf->wbits, conf->memlevel)
+                 - key[1].data;
+
+    c->file_cache = conf->cache_zone->data;
+
+    ngx_http_file_cache_create_key(r);
+
+    c->body_start = c->header_start;
+    c->min_uses = 1;
+
+    rc = ngx_http_file_cache_open(r);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
+                   "http gzip cache: %i", rc);
+
+    switch (rc) {
+
+    case NGX_OK:
+        break;
+
+    case NGX_DECLINED:
+
+        /* let the static module send the file and compress it on the fly */
+
+        ngx_http_file_cache_count(c, NGX_HTTP_CACHE_MISS);
+
+        ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_gzip_ctx_t));
+        if (ctx == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        ngx_http_set_ctx(r, ctx, ngx_http_gzip_filter_module);
+
+        ctx->done = 1;
+        ctx->cache = 1;
+        ctx->cache_length = of.size;
+
+        c->last_modified = of.mtime;
+
+        return NGX_DECLINED;
+
+    case NGX_ERROR:
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+
+    default:
+        return NGX_DECLINED;
+    }
+
+    ngx_http_file_cache_count(c, NGX_HTTP_CACHE_HIT);
+
+    r->root_tested = !r->error_page;
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    log->action = "sending response to client";
+
+    /* the entity tag is made from the original file */
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = of.size;
+    r->headers_out.last_modified_time = of.mtime;
+
+    if (ngx_http_set_etag(r) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    ngx_http_weak_etag(r);
+
+    r->headers_out.content_length_n = c->length - c->body_start;
+
+    h = ngx_list_push(&r->headers_out.headers);
+    if (h == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    h->hash = 1;
+    h->next = NULL;
+    ngx_str_set(&h->key, "Content-Encoding");
+    ngx_str_set(&h->value, "gzip");
+    r->headers_out.content_encoding = h;
+
+    r->gzip_vary = 1;
+    r->allow_ranges = 1;
+
+    return ngx_http_cache_send(r);
+}
+
+
+static ngx_int_t
+ngx_http_gzip_cache_start(ngx_http_request_t *r, ngx_http_gzip_ctx_t *ctx)
+{
+    ngx_buf_t           *b;
+    ngx_temp_file_t     *tf;
+    ngx_http_cache_t    *c;
+    ngx_pool_cleanup_t  *cln;
+
+    c = r->cache;
+
+    /* the response should be the file tested by the cache handler */
+
+    if (c == NULL
+        || r->headers_out.status != NGX_HTTP_OK
+        || r->headers_out.content_length_n != ctx->cache_length
+        || r->headers_out.last_modified_time != c->last_modified)
+    {
+        ctx->cache = 0;
+        return NGX_OK;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http gzip cache start");
+
+    tf = ngx_pcalloc(r->pool, sizeof(ngx_temp_file_t));
+    if (tf == NULL) {
+        return NGX_ERROR;
+    }
+
+    tf->file.fd = NGX_INVALID_FILE;
+    tf->file.log = r->connection->log;
+    tf->file.name = c->file.name;
+    tf->path = c->file_cache->path;
+    tf->pool = r->pool;
+    tf->persistent = 1;
+
+    /* the compressed variant does not expire until the file is changed */
+
+    c->valid_sec = NGX_MAX_TIME_T_VALUE;
+    c->date = ngx_time();
+
+    b = ngx_create_temp_buf(r->pool, c->body_start);
+    if (b == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_http_file_cache_set_header(r, b->pos) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    b->last += c->body_start;
+
+    ctx->cache_header = ngx_alloc_chain_link(r->pool);
+    if (ctx->cache_header == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->cache_header->buf = b;
+    ctx->cache_header->next = NULL;
+
+    cln = ngx_pool_cleanup_add(r->pool, 0);
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    cln->handler = ngx_http_gzip_cache_cleanup;
+    cln->data = ctx;
+
+    ctx->temp_file = tf;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_gzip_cache_write(ngx_http_request_t *r, ngx_http_gzip_ctx_t *ctx)
+{
+    ssize_t           n;
+    ngx_chain_t      *cl;
+    ngx_temp_file_t  *tf;
+
+    tf = ctx->temp_file;
+
+    if (ctx->cache_header) {
+        cl = ctx->cache_header;
+        cl->next = ctx->out;
+        ctx->cache_header = NULL;
+
+    } else {
+        cl = ctx->out;
+    }
+
+    if (cl) {
+        n = ngx_write_chain_to_temp_file(tf, cl);
+
+        if (n == NGX_ERROR) {
+
+            /* the response is still sent to the client */
+
+            ngx_http_file_cache_free(r->cache, tf);
+            ctx->temp_file = NULL;
+            return;
+        }
+
+        tf->offset += n;
+    }
+
+    if (ctx->done) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http gzip cache stored: %O", tf->offset);
+
+        ngx_http_file_cache_update(r, tf);
+        ctx->temp_file = NULL;
+    }
+}
+
+
+static void
+ngx_http_gzip_cache_cleanup(void *data)
+{
+    ngx_http_gzip_ctx_t *ctx = data;
+
+    if (ctx->temp_file) {
+        ngx_http_file_cache_free(ctx->request->cache, ctx->temp_file);
+    }
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_gzip_add_variables(ngx_conf_t *cf)
 {
@@ -1059,6 +1516,31 @@ ngx_http_gzip_ratio_variable(ngx_http_request_t *r,
 }
 
 
+#if (NGX_HTTP_CACHE)
+
+static void *
+ngx_http_gzip_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_gzip_main_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_gzip_main_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    if (ngx_array_init(&conf->caches, cf->pool, 4,
+                       sizeof(ngx_http_file_cache_t *))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    return conf;
+}
+
+#endif
+
+
 static void *
 ngx_http_gzip_create_conf(ngx_conf_t *cf)
 {
@@ -1081,11 +1563,16 @@ ngx_http_gzip_create_conf(ngx_conf_t *cf)
     conf->no_buffer = NGX_CONF_UNSET;
 
     conf->postpone_gzipping = NGX_CONF_UNSET_SIZE;
+    conf->preset = NGX_CONF_UNSET_UINT;
     conf->level = NGX_CONF_UNSET;
     conf->wbits = NGX_CONF_UNSET_SIZE;
     conf->memlevel = NGX_CONF_UNSET_SIZE;
     conf->min_length = NGX_CONF_UNSET;
 
+#if (NGX_HTTP_CACHE)
+    conf->cache_zone = NGX_CONF_UNSET_PTR;
+#endif
+
     return conf;
 }
 
@@ -1096,20 +1583,46 @@ ngx_http_gzip_merge_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_http_gzip_conf_t *prev = parent;
     ngx_http_gzip_conf_t *conf = child;
 
+    ngx_http_gzip_preset_t  *preset;
+
     ngx_conf_merge_value(conf->enable, prev->enable, 0);
     ngx_conf_merge_value(conf->no_buffer, prev->no_buffer, 0);
 
+    if (conf->enable) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
+
     ngx_conf_merge_bufs_value(conf->bufs, prev->bufs,
                               (128 * 1024) / ngx_pagesize, ngx_pagesize);
 
     ngx_conf_merge_size_value(conf->postpone_gzipping, prev->postpone_gzipping,
                               0);
+
+    /*
+     * a preset sets the parameters not specified on the same level,
+     * an inherited preset is already applied to the inherited parameters
+     */
+
+    if (conf->preset != NGX_CONF_UNSET_UINT) {
+        preset = &ngx_http_gzip_presets[ngx_http_gzip_zlib_ng()][conf->preset];
+
+        ngx_conf_init_value(conf->level, preset->level);
+        ngx_conf_init_size_value(conf->wbits, preset->wbits);
+        ngx_conf_init_size_value(conf->memlevel, preset->memlevel);
+    }
+
+    ngx_conf_merge_uint_value(conf->preset, prev->preset,
+                              NGX_CONF_UNSET_UINT);
     ngx_conf_merge_value(conf->level, prev->level, 1);
     ngx_conf_merge_size_value(conf->wbits, prev->wbits, MAX_WBITS);
     ngx_conf_merge_size_value(conf->memlevel, prev->memlevel,
                               MAX_MEM_LEVEL - 1);
     ngx_conf_merge_value(conf->min_length, prev->min_length, 20);
 
+#if (NGX_HTTP_CACHE)
+    ngx_conf_merge_ptr_value(conf->cache_zone, prev->cache_zone, NULL);
+#endif
+
     if (ngx_http_merge_types(cf, &conf->types_keys, &conf->types,
                              &prev->types_keys, &prev->types,
                              ngx_http_html_default_types)
@@ -1125,16 +1638,56 @@ ngx_http_gzip_merge_conf(ngx_conf_t *cf, void *parent, void *child)
 static ngx_int_t
 ngx_http_gzip_filter_init(ngx_conf_t *cf)
 {
+#if (NGX_HTTP_CACHE)
+    ngx_http_handler_pt        *h;
+    ngx_http_core_main_conf_t  *cmcf;
+    ngx_http_gzip_main_conf_t  *gmcf;
+
+    gmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_gzip_filter_module);
+
+    if (gmcf->caches.nelts) {
+        cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
+
+        h = ngx_array_push(&cmcf->phases[NGX_HTTP_CONTENT_PHASE].handlers);
+        if (h == NULL) {
+            return NGX_ERROR;
+        }
+
+        *h = ngx_http_gzip_cache_handler;
+    }
+#endif
+
     ngx_http_next_header_filter = ngx_http_top_header_filter;
     ngx_http_top_header_filter = ngx_http_gzip_header_filter;
 
     ngx_http_next_body_filter = ngx_http_top_body_filter;
     ngx_http_top_body_filter = ngx_http_gzip_body_filter;
 
+    if (ngx_http_gzip_zlib_ng()) {
+        ngx_http_gzip_assume_zlib_ng = 1;
+    }
+
     return NGX_OK;
 }
 
 
+static ngx_uint_t
+ngx_http_gzip_zlib_ng(void)
+{
+#if (NGX_ZLIB_NG)
+
+    return 1;
+
+#else
+
+    /* zlib-ng in zlib compat mode might be used as a shared library */
+
+    return ngx_strstr(zlibVersion(), "zlib-ng") ? 1 : 0;
+
+#endif
+}
+
+
 static char *
 ngx_http_gzip_window(ngx_conf_t *cf, void *post, void *data)
 {
@@ -1181,3 +1734,35 @@ ngx_http_gzip_hash(ngx_conf_t *cf, void *post, void *data)
 
     return "must be 512, 1k, 2k, 4k, 8k, 16k, 32k, 64k, or 128k";
 }
+
+
+#if (NGX_HTTP_CACHE)
+
+static char *
+ngx_http_gzip_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_gzip_conf_t *gcf = conf;
+
+    ngx_str_t  *value;
+
+    value = cf->args->elts;
+
+    if (gcf->cache_zone != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        gcf->cache_zone = NULL;
+        return NGX_CONF_OK;
+    }
+
+    gcf->cache_zone = ngx_shared_memory_add(cf, &value[1], 0,
+                                            &ngx_http_gzip_filter_module);
+    if (gcf->cache_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+#endif
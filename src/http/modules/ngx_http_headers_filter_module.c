@@ -49,6 +49,7 @@ typedef struct {
     ngx_http_complex_value_t  *expires_value;
     ngx_array_t               *headers;
     ngx_array_t               *trailers;
+    ngx_str_t                  block;
 } ngx_http_headers_conf_t;
 
 
@@ -60,6 +61,8 @@ static ngx_int_t ngx_http_add_multi_header_lines(ngx_http_request_t *r,
     ngx_http_header_val_t *hv, ngx_str_t *value);
 static ngx_int_t ngx_http_add_header(ngx_http_request_t *r,
     ngx_http_header_val_t *hv, ngx_str_t *value);
+static ngx_int_t ngx_http_add_header_block(ngx_http_request_t *r,
+    ngx_http_headers_conf_t *conf);
 static ngx_int_t ngx_http_set_last_modified(ngx_http_request_t *r,
     ngx_http_header_val_t *hv, ngx_str_t *value);
 static ngx_int_t ngx_http_set_response_header(ngx_http_request_t *r,
@@ -68,6 +71,8 @@ static ngx_int_t ngx_http_set_response_header(ngx_http_request_t *r,
 static void *ngx_http_headers_create_conf(ngx_conf_t *cf);
 static char *ngx_http_headers_merge_conf(ngx_conf_t *cf,
     void *parent, void *child);
+static ngx_int_t ngx_http_headers_compile_block(ngx_conf_t *cf,
+    ngx_http_headers_conf_t *conf);
 static ngx_int_t ngx_http_headers_filter_init(ngx_conf_t *cf);
 static char *ngx_http_headers_expires(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
@@ -209,7 +214,12 @@ ngx_http_headers_filter(ngx_http_request_t *r)
         }
     }
 
-    if (conf->headers) {
+    if (conf->headers && conf->block.len && safe_status) {
+        if (ngx_http_add_header_block(r, conf) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+    } else if (conf->headers) {
         h = conf->headers->elts;
         for (i = 0; i < conf->headers->nelts; i++) {
 
@@ -554,6 +564,44 @@ ngx_http_add_header(ngx_http_request_t *r, ngx_http_header_val_t *hv,
 }
 
 
+static ngx_int_t
+ngx_http_add_header_block(ngx_http_request_t *r, ngx_http_headers_conf_t *conf)
+{
+    ngx_uint_t              i;
+    ngx_table_elt_t        *h;
+    ngx_http_header_val_t  *hv;
+
+    /*
+     * the headers are added to the list as usual, and the preformatted
+     * block is used by the HTTP/1.x header filter instead of formatting
+     * them once again
+     */
+
+    hv = conf->headers->elts;
+
+    for (i = 0; i < conf->headers->nelts; i++) {
+
+        h = ngx_list_push(&r->headers_out.headers);
+        if (h == NULL) {
+            return NGX_ERROR;
+        }
+
+        h->hash = 1;
+        h->key = hv[i].key;
+        h->value = hv[i].value.value;
+
+        if (i == 0) {
+            r->headers_out.header_block_start = h;
+        }
+    }
+
+    r->headers_out.header_block = &conf->block;
+    r->headers_out.header_block_n = conf->headers->nelts;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_add_multi_header_lines(ngx_http_request_t *r,
     ngx_http_header_val_t *hv, ngx_str_t *value)
@@ -654,6 +702,7 @@ ngx_http_headers_create_conf(ngx_conf_t *cf)
      *     conf->trailers = NULL;
      *     conf->expires_time = 0;
      *     conf->expires_value = NULL;
+     *     conf->block = { 0, NULL };
      */
 
     conf->expires = NGX_HTTP_EXPIRES_UNSET;
@@ -680,16 +729,78 @@ ngx_http_headers_merge_conf(ngx_conf_t *cf, void *parent, void *child)
 
     if (conf->headers == NULL) {
         conf->headers = prev->headers;
+        conf->block = prev->block;
+
+    } else if (ngx_http_headers_compile_block(cf, conf) != NGX_OK) {
+        return NGX_CONF_ERROR;
     }
 
     if (conf->trailers == NULL) {
         conf->trailers = prev->trailers;
     }
 
+    if (conf->expires != NGX_HTTP_EXPIRES_OFF
+        || conf->headers
+        || conf->trailers)
+    {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
+
     return NGX_CONF_OK;
 }
 
 
+static ngx_int_t
+ngx_http_headers_compile_block(ngx_conf_t *cf, ngx_http_headers_conf_t *conf)
+{
+    u_char                 *p;
+    size_t                  len;
+    ngx_uint_t              i;
+    ngx_http_header_val_t  *h;
+
+    /*
+     * if all headers are constant and are added with ngx_http_add_header(),
+     * they are formatted once, along with the end of the header
+     */
+
+    h = conf->headers->elts;
+
+    len = sizeof(CRLF) - 1;
+
+    for (i = 0; i < conf->headers->nelts; i++) {
+
+        if (h[i].handler != ngx_http_add_header
+            || h[i].value.lengths
+            || h[i].value.value.len == 0)
+        {
+            return NGX_OK;
+        }
+
+        len += h[i].key.len + sizeof(": ") - 1 + h[i].value.value.len
+               + sizeof(CRLF) - 1;
+    }
+
+    p = ngx_pnalloc(cf->pool, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    conf->block.len = len;
+    conf->block.data = p;
+
+    for (i = 0; i < conf->headers->nelts; i++) {
+        p = ngx_copy(p, h[i].key.data, h[i].key.len);
+        *p++ = ':'; *p++ = ' ';
+        p = ngx_copy(p, h[i].value.value.data, h[i].value.value.len);
+        *p++ = CR; *p++ = LF;
+    }
+
+    *p++ = CR; *p = LF;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_headers_filter_init(ngx_conf_t *cf)
 {
@@ -25,6 +25,7 @@
 #define NGX_HTTP_IMAGE_PROCESS   2
 #define NGX_HTTP_IMAGE_PASS      3
 #define NGX_HTTP_IMAGE_DONE      4
+#define NGX_HTTP_IMAGE_THREAD    5
 
 
 #define NGX_HTTP_IMAGE_NONE      0
@@ -57,6 +58,10 @@ typedef struct {
     ngx_http_complex_value_t    *shcv;
 
     size_t                       buffer_size;
+
+#if (NGX_THREADS)
+    ngx_thread_pool_t           *thread_pool;
+#endif
 } ngx_http_image_filter_conf_t;
 
 
@@ -71,10 +76,21 @@ typedef struct {
     ngx_uint_t                   max_width;
     ngx_uint_t                   max_height;
     ngx_uint_t                   angle;
+    ngx_int_t                    quality;
+    ngx_int_t                    sharpen;
 
     ngx_uint_t                   phase;
     ngx_uint_t                   type;
     ngx_uint_t                   force;
+
+    u_char                      *out;
+    int                          out_size;
+
+#if (NGX_THREADS)
+    ngx_int_t                    rc;
+    ngx_http_request_t          *request;
+    unsigned                     busy:1;
+#endif
 } ngx_http_image_filter_ctx_t;
 
 
@@ -93,12 +109,22 @@ static ngx_int_t ngx_http_image_size(ngx_http_request_t *r,
 
 static ngx_buf_t *ngx_http_image_resize(ngx_http_request_t *r,
     ngx_http_image_filter_ctx_t *ctx);
+static ngx_int_t ngx_http_image_transform(ngx_http_request_t *r,
+    ngx_http_image_filter_ctx_t *ctx);
+static ngx_buf_t *ngx_http_image_result(ngx_http_request_t *r,
+    ngx_http_image_filter_ctx_t *ctx, ngx_int_t rc);
+#if (NGX_THREADS)
+static ngx_int_t ngx_http_image_thread_post(ngx_http_request_t *r,
+    ngx_http_image_filter_ctx_t *ctx, ngx_thread_pool_t *tp);
+static void ngx_http_image_thread_handler(void *data, ngx_log_t *log);
+static void ngx_http_image_thread_event_handler(ngx_event_t *ev);
+#endif
 static gdImagePtr ngx_http_image_source(ngx_http_request_t *r,
     ngx_http_image_filter_ctx_t *ctx);
 static gdImagePtr ngx_http_image_new(ngx_http_request_t *r, int w, int h,
     int colors);
-static u_char *ngx_http_image_out(ngx_http_request_t *r, ngx_uint_t type,
-    gdImagePtr img, int *size);
+static u_char *ngx_http_image_out(ngx_http_request_t *r,
+    ngx_http_image_filter_ctx_t *ctx, gdImagePtr img, int *size);
 static void ngx_http_image_cleanup(void *data);
 static ngx_uint_t ngx_http_image_filter_get_value(ngx_http_request_t *r,
     ngx_http_complex_value_t *cv, ngx_uint_t v);
@@ -116,6 +142,10 @@ static char *ngx_http_image_filter_webp_quality(ngx_conf_t *cf,
     ngx_command_t *cmd, void *conf);
 static char *ngx_http_image_filter_sharpen(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+#if (NGX_THREADS)
+static char *ngx_http_image_filter_threads(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+#endif
 static ngx_int_t ngx_http_image_filter_init(ngx_conf_t *cf);
 
 
@@ -170,6 +200,17 @@ static ngx_command_t  ngx_http_image_filter_commands[] = {
       offsetof(ngx_http_image_filter_conf_t, buffer_size),
       NULL },
 
+#if (NGX_THREADS)
+
+    { ngx_string("image_filter_threads"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_image_filter_threads,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+#endif
+
       ngx_null_command
 };
 
@@ -299,13 +340,11 @@ ngx_http_image_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0, "image filter");
 
-    if (in == NULL) {
-        return ngx_http_next_body_filter(r, in);
-    }
-
     ctx = ngx_http_get_module_ctx(r, ngx_http_image_filter_module);
 
-    if (ctx == NULL) {
+    if (ctx == NULL
+        || (in == NULL && ctx->phase != NGX_HTTP_IMAGE_THREAD))
+    {
         return ngx_http_next_body_filter(r, in);
     }
 
@@ -372,6 +411,10 @@ ngx_http_image_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
         out.buf = ngx_http_image_process(r);
 
+        if (ctx->phase == NGX_HTTP_IMAGE_THREAD) {
+            return NGX_OK;
+        }
+
         if (out.buf == NULL) {
             return ngx_http_filter_finalize_request(r,
                                               &ngx_http_image_filter_module,
@@ -383,6 +426,31 @@ ngx_http_image_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
         return ngx_http_image_send(r, ctx, &out);
 
+#if (NGX_THREADS)
+
+    case NGX_HTTP_IMAGE_THREAD:
+
+        if (ctx->busy) {
+            return NGX_AGAIN;
+        }
+
+        r->connection->buffered &= ~NGX_HTTP_IMAGE_BUFFERED;
+
+        out.buf = ngx_http_image_result(r, ctx, ctx->rc);
+
+        if (out.buf == NULL) {
+            return ngx_http_filter_finalize_request(r,
+                                              &ngx_http_image_filter_module,
+                                              NGX_HTTP_UNSUPPORTED_MEDIA_TYPE);
+        }
+
+        out.next = NULL;
+        ctx->phase = NGX_HTTP_IMAGE_PASS;
+
+        return ngx_http_image_send(r, ctx, &out);
+
+#endif
+
     case NGX_HTTP_IMAGE_PASS:
 
         return ngx_http_next_body_filter(r, in);
@@ -819,20 +887,74 @@ ngx_http_image_size(ngx_http_request_t *r, ngx_http_image_filter_ctx_t *ctx)
 static ngx_buf_t *
 ngx_http_image_resize(ngx_http_request_t *r, ngx_http_image_filter_ctx_t *ctx)
 {
-    int                            sx, sy, dx, dy, ox, oy, ax, ay, size,
-                                   colors, palette, transparent, sharpen,
+    ngx_http_image_filter_conf_t  *conf;
+
+    conf = ngx_http_get_module_loc_conf(r, ngx_http_image_filter_module);
+
+    /*
+     * the values are evaluated in advance, as the image may be
+     * transformed in a thread, which cannot use the request pool
+     */
+
+    ctx->sharpen = ngx_http_image_filter_get_value(r, conf->shcv,
+                                                   conf->sharpen);
+
+    switch (ctx->type) {
+
+    case NGX_HTTP_IMAGE_JPEG:
+        ctx->quality = ngx_http_image_filter_get_value(r, conf->jqcv,
+                                                       conf->jpeg_quality);
+        if (ctx->quality <= 0) {
+            return NULL;
+        }
+
+        break;
+
+#if (NGX_HAVE_GD_WEBP)
+    case NGX_HTTP_IMAGE_WEBP:
+        ctx->quality = ngx_http_image_filter_get_value(r, conf->wqcv,
+                                                       conf->webp_quality);
+        if (ctx->quality <= 0) {
+            return NULL;
+        }
+
+        break;
+#endif
+    }
+
+#if (NGX_THREADS)
+
+    if (conf->thread_pool) {
+        if (ngx_http_image_thread_post(r, ctx, conf->thread_pool) != NGX_OK) {
+            return NULL;
+        }
+
+        ctx->phase = NGX_HTTP_IMAGE_THREAD;
+
+        return NULL;
+    }
+
+#endif
+
+    return ngx_http_image_result(r, ctx, ngx_http_image_transform(r, ctx));
+}
+
+
+static ngx_int_t
+ngx_http_image_transform(ngx_http_request_t *r,
+    ngx_http_image_filter_ctx_t *ctx)
+{
+    int                            sx, sy, dx, dy, ox, oy, ax, ay,
+                                   colors, palette, transparent,
                                    red, green, blue, t;
-    u_char                        *out;
-    ngx_buf_t                     *b;
     ngx_uint_t                     resize;
     gdImagePtr                     src, dst;
-    ngx_pool_cleanup_t            *cln;
     ngx_http_image_filter_conf_t  *conf;
 
     src = ngx_http_image_source(r, ctx);
 
     if (src == NULL) {
-        return NULL;
+        return NGX_ERROR;
     }
 
     sx = gdImageSX(src);
@@ -846,7 +968,7 @@ ngx_http_image_resize(ngx_http_request_t *r, ngx_http_image_filter_ctx_t *ctx)
         && (ngx_uint_t) sy <= ctx->max_height)
     {
         gdImageDestroy(src);
-        return ngx_http_image_asis(r, ctx);
+        return NGX_DECLINED;
     }
 
     colors = gdImageColorsTotal(src);
@@ -923,7 +1045,7 @@ transparent:
         dst = ngx_http_image_new(r, dx, dy, palette);
         if (dst == NULL) {
             gdImageDestroy(src);
-            return NULL;
+            return NGX_ERROR;
         }
 
         if (colors == 0) {
@@ -956,7 +1078,7 @@ transparent:
             dst = ngx_http_image_new(r, dy, dx, palette);
             if (dst == NULL) {
                 gdImageDestroy(src);
-                return NULL;
+                return NGX_ERROR;
             }
             if (ctx->angle == 90) {
                 ox = dy / 2 + ay;
@@ -980,7 +1102,7 @@ transparent:
             dst = ngx_http_image_new(r, dx, dy, palette);
             if (dst == NULL) {
                 gdImageDestroy(src);
-                return NULL;
+                return NGX_ERROR;
             }
             gdImageCopyRotated(dst, src, dx / 2 - ax, dy / 2 - ay, 0, 0,
                                dx + ax, dy + ay, ctx->angle);
@@ -1013,7 +1135,7 @@ transparent:
 
             if (dst == NULL) {
                 gdImageDestroy(src);
-                return NULL;
+                return NGX_ERROR;
             }
 
             ox /= 2;
@@ -1042,42 +1164,61 @@ transparent:
         gdImageColorTransparent(dst, gdImageColorExact(dst, red, green, blue));
     }
 
-    sharpen = ngx_http_image_filter_get_value(r, conf->shcv, conf->sharpen);
-    if (sharpen > 0) {
-        gdImageSharpen(dst, sharpen);
+    if (ctx->sharpen > 0) {
+        gdImageSharpen(dst, (int) ctx->sharpen);
     }
 
     gdImageInterlace(dst, (int) conf->interlace);
 
-    out = ngx_http_image_out(r, ctx->type, dst, &size);
+    ctx->out = ngx_http_image_out(r, ctx, dst, &ctx->out_size);
 
     ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                    "image: %d x %d %d", sx, sy, colors);
 
     gdImageDestroy(dst);
+
+    return NGX_OK;
+}
+
+
+static ngx_buf_t *
+ngx_http_image_result(ngx_http_request_t *r, ngx_http_image_filter_ctx_t *ctx,
+    ngx_int_t rc)
+{
+    ngx_buf_t           *b;
+    ngx_pool_cleanup_t  *cln;
+
+    if (rc == NGX_DECLINED) {
+        return ngx_http_image_asis(r, ctx);
+    }
+
+    if (rc == NGX_ERROR) {
+        return NULL;
+    }
+
     ngx_pfree(r->pool, ctx->image);
 
-    if (out == NULL) {
+    if (ctx->out == NULL) {
         return NULL;
     }
 
     cln = ngx_pool_cleanup_add(r->pool, 0);
     if (cln == NULL) {
-        gdFree(out);
+        gdFree(ctx->out);
         return NULL;
     }
 
     b = ngx_calloc_buf(r->pool);
     if (b == NULL) {
-        gdFree(out);
+        gdFree(ctx->out);
         return NULL;
     }
 
     cln->handler = ngx_http_image_cleanup;
-    cln->data = out;
+    cln->data = ctx->out;
 
-    b->pos = out;
-    b->last = out + size;
+    b->pos = ctx->out;
+    b->last = ctx->out + ctx->out_size;
     b->memory = 1;
     b->last_buf = 1;
 
@@ -1088,6 +1229,90 @@ transparent:
 }
 
 
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_http_image_thread_post(ngx_http_request_t *r,
+    ngx_http_image_filter_ctx_t *ctx, ngx_thread_pool_t *tp)
+{
+    ngx_thread_task_t  *task;
+
+    task = ngx_thread_task_alloc(r->pool, 0);
+    if (task == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->request = r;
+
+    task->ctx = ctx;
+    task->handler = ngx_http_image_thread_handler;
+    task->event.data = ctx;
+    task->event.handler = ngx_http_image_thread_event_handler;
+
+    if (ngx_thread_task_post(tp, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ctx->busy = 1;
+
+    r->main->blocked++;
+    r->aio = 1;
+
+    r->connection->buffered |= NGX_HTTP_IMAGE_BUFFERED;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_image_thread_handler(void *data, ngx_log_t *log)
+{
+    ngx_http_image_filter_ctx_t *ctx = data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, log, 0, "image thread handler");
+
+    ctx->rc = ngx_http_image_transform(ctx->request, ctx);
+}
+
+
+static void
+ngx_http_image_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_connection_t             *c;
+    ngx_http_request_t           *r;
+    ngx_http_image_filter_ctx_t  *ctx;
+
+    ctx = ev->data;
+    r = ctx->request;
+    c = r->connection;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "image thread: \"%V?%V\"", &r->uri, &r->args);
+
+    ctx->busy = 0;
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    if (r->done || r->main->terminated) {
+        if (ctx->out) {
+            gdFree(ctx->out);
+            ctx->out = NULL;
+        }
+
+        c->write->handler(c->write);
+        return;
+    }
+
+    r->write_event_handler(r);
+    ngx_http_run_posted_requests(c);
+}
+
+#endif
+
+
 static gdImagePtr
 ngx_http_image_source(ngx_http_request_t *r, ngx_http_image_filter_ctx_t *ctx)
 {
@@ -1164,27 +1389,18 @@ ngx_http_image_new(ngx_http_request_t *r, int w, int h, int colors)
 
 
 static u_char *
-ngx_http_image_out(ngx_http_request_t *r, ngx_uint_t type, gdImagePtr img,
-    int *size)
+ngx_http_image_out(ngx_http_request_t *r, ngx_http_image_filter_ctx_t *ctx,
+    gdImagePtr img, int *size)
 {
-    char                          *failed;
-    u_char                        *out;
-    ngx_int_t                      q;
-    ngx_http_image_filter_conf_t  *conf;
+    char    *failed;
+    u_char  *out;
 
     out = NULL;
 
-    switch (type) {
+    switch (ctx->type) {
 
     case NGX_HTTP_IMAGE_JPEG:
-        conf = ngx_http_get_module_loc_conf(r, ngx_http_image_filter_module);
-
-        q = ngx_http_image_filter_get_value(r, conf->jqcv, conf->jpeg_quality);
-        if (q <= 0) {
-            return NULL;
-        }
-
-        out = gdImageJpegPtr(img, size, q);
+        out = gdImageJpegPtr(img, size, (int) ctx->quality);
         failed = "gdImageJpegPtr() failed";
         break;
 
@@ -1200,14 +1416,7 @@ ngx_http_image_out(ngx_http_request_t *r, ngx_uint_t type, gdImagePtr img,
 
     case NGX_HTTP_IMAGE_WEBP:
 #if (NGX_HAVE_GD_WEBP)
-        conf = ngx_http_get_module_loc_conf(r, ngx_http_image_filter_module);
-
-        q = ngx_http_image_filter_get_value(r, conf->wqcv, conf->webp_quality);
-        if (q <= 0) {
-            return NULL;
-        }
-
-        out = gdImageWebpPtrEx(img, size, q);
+        out = gdImageWebpPtrEx(img, size, (int) ctx->quality);
         failed = "gdImageWebpPtrEx() failed";
 #else
         failed = "nginx was built without GD WebP support";
@@ -1303,6 +1512,10 @@ ngx_http_image_filter_create_conf(ngx_conf_t *cf)
     conf->interlace = NGX_CONF_UNSET;
     conf->buffer_size = NGX_CONF_UNSET_SIZE;
 
+#if (NGX_THREADS)
+    conf->thread_pool = NGX_CONF_UNSET_PTR;
+#endif
+
     return conf;
 }
 
@@ -1329,6 +1542,10 @@ ngx_http_image_filter_merge_conf(ngx_conf_t *cf, void *parent, void *child)
         }
     }
 
+    if (conf->filter != NGX_HTTP_IMAGE_OFF) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
+
     if (conf->jpeg_quality == NGX_CONF_UNSET_UINT) {
 
         /* 75 is libjpeg default quality */
@@ -1364,6 +1581,10 @@ ngx_http_image_filter_merge_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_size_value(conf->buffer_size, prev->buffer_size,
                               1 * 1024 * 1024);
 
+#if (NGX_THREADS)
+    ngx_conf_merge_ptr_value(conf->thread_pool, prev->thread_pool, NULL);
+#endif
+
     return NGX_CONF_OK;
 }
 
@@ -1662,6 +1883,43 @@ ngx_http_image_filter_sharpen(ngx_conf_t *cf, ngx_command_t *cmd,
 }
 
 
+#if (NGX_THREADS)
+
+static char *
+ngx_http_image_filter_threads(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_image_filter_conf_t *imcf = conf;
+
+    ngx_str_t  *value;
+
+    if (imcf->thread_pool != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        imcf->thread_pool = NULL;
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strcmp(value[1].data, "on") == 0) {
+        imcf->thread_pool = ngx_thread_pool_add(cf, NULL);
+
+    } else {
+        imcf->thread_pool = ngx_thread_pool_add(cf, &value[1]);
+    }
+
+    if (imcf->thread_pool == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_image_filter_init(ngx_conf_t *cf)
 {
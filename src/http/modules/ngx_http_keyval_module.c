@@ -0,0 +1,1337 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+typedef struct {
+    ngx_str_node_t               sn;
+    ngx_str_t                    value;
+    u_char                       data[1];
+} ngx_http_keyval_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t                 rbtree;
+    ngx_rbtree_node_t            sentinel;
+    ngx_uint_t                   generation;
+    ngx_uint_t                   saved;
+} ngx_http_keyval_shctx_t;
+
+
+typedef struct {
+    ngx_http_keyval_shctx_t     *sh;
+    ngx_slab_pool_t             *shpool;
+    ngx_str_t                    state;
+} ngx_http_keyval_ctx_t;
+
+
+typedef struct {
+    ngx_http_complex_value_t     key;
+    ngx_shm_zone_t              *shm_zone;
+} ngx_http_keyval_variable_t;
+
+
+typedef struct {
+    ngx_array_t                  zones;       /* ngx_shm_zone_t * */
+} ngx_http_keyval_main_conf_t;
+
+
+typedef struct {
+    ngx_shm_zone_t              *shm_zone;
+} ngx_http_keyval_loc_conf_t;
+
+
+static ngx_int_t ngx_http_keyval_handler(ngx_http_request_t *r);
+static void ngx_http_keyval_body_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_keyval_update(ngx_http_request_t *r,
+    ngx_http_keyval_ctx_t *ctx, ngx_str_t *key);
+static ngx_int_t ngx_http_keyval_get(ngx_http_request_t *r,
+    ngx_http_keyval_ctx_t *ctx, ngx_str_t *key);
+static ngx_int_t ngx_http_keyval_get_all(ngx_http_request_t *r,
+    ngx_http_keyval_ctx_t *ctx);
+static ngx_int_t ngx_http_keyval_send(ngx_http_request_t *r, ngx_buf_t *b);
+static ngx_int_t ngx_http_keyval_key(ngx_http_request_t *r, ngx_str_t *key);
+static ngx_int_t ngx_http_keyval_body(ngx_http_request_t *r,
+    ngx_str_t *body);
+
+static ngx_int_t ngx_http_keyval_parse(u_char **pos, u_char *last,
+    ngx_str_t *key, ngx_str_t *value);
+static ngx_int_t ngx_http_keyval_set_locked(ngx_http_keyval_ctx_t *ctx,
+    ngx_str_t *key, ngx_str_t *value);
+static ngx_int_t ngx_http_keyval_delete_locked(ngx_http_keyval_ctx_t *ctx,
+    ngx_str_t *key);
+static void ngx_http_keyval_clear_locked(ngx_http_keyval_ctx_t *ctx);
+static void ngx_http_keyval_save(ngx_http_keyval_ctx_t *ctx,
+    ngx_pool_t *pool, ngx_log_t *log);
+static ngx_int_t ngx_http_keyval_load(ngx_shm_zone_t *shm_zone);
+
+static ngx_int_t ngx_http_keyval_variable(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_keyval_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+
+static void *ngx_http_keyval_create_main_conf(ngx_conf_t *cf);
+static char *ngx_http_keyval_init_main_conf(ngx_conf_t *cf, void *conf);
+static void *ngx_http_keyval_create_loc_conf(ngx_conf_t *cf);
+static char *ngx_http_keyval_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_keyval(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_keyval_api(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_shm_zone_t *ngx_http_keyval_add_zone(ngx_conf_t *cf,
+    ngx_str_t *value);
+
+
+static ngx_command_t  ngx_http_keyval_commands[] = {
+
+    { ngx_string("keyval_zone"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_1MORE,
+      ngx_http_keyval_zone,
+      0,
+      0,
+      NULL },
+
+    { ngx_string("keyval"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE3,
+      ngx_http_keyval,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("keyval_api"),
+      NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_keyval_api,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_keyval_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    ngx_http_keyval_create_main_conf,      /* create main configuration */
+    ngx_http_keyval_init_main_conf,        /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    ngx_http_keyval_create_loc_conf,       /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_keyval_module = {
+    NGX_MODULE_V1,
+    &ngx_http_keyval_module_ctx,           /* module context */
+    ngx_http_keyval_commands,              /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * The API of a keyval_api location "/kv/":
+ *
+ *     GET /kv/             all pairs as a JSON object
+ *     GET /kv/key          the value of the key
+ *     PUT /kv/key          sets the value of the key to the request body
+ *     DELETE /kv/key       removes the key
+ *     DELETE /kv/          removes all keys
+ *     PATCH /kv/           applies the "key value" lines of the request
+ *                          body, a line with a key only removes the key
+ *
+ * The state file uses the same "key value" lines.
+ */
+
+
+static ngx_int_t
+ngx_http_keyval_handler(ngx_http_request_t *r)
+{
+    ngx_int_t                    rc;
+    ngx_str_t                    key;
+    ngx_http_keyval_ctx_t       *ctx;
+    ngx_http_keyval_loc_conf_t  *klcf;
+
+    klcf = ngx_http_get_module_loc_conf(r, ngx_http_keyval_module);
+
+    ctx = klcf->shm_zone->data;
+
+    if (ngx_http_keyval_key(r, &key) != NGX_OK) {
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    switch (r->method) {
+
+    case NGX_HTTP_PUT:
+    case NGX_HTTP_PATCH:
+
+        if ((r->method == NGX_HTTP_PUT) != (key.len != 0)) {
+            return NGX_HTTP_NOT_ALLOWED;
+        }
+
+        rc = ngx_http_read_client_request_body(r,
+                                               ngx_http_keyval_body_handler);
+
+        if (rc >= NGX_HTTP_SPECIAL_RESPONSE) {
+            return rc;
+        }
+
+        return NGX_DONE;
+
+    case NGX_HTTP_GET:
+    case NGX_HTTP_HEAD:
+    case NGX_HTTP_DELETE:
+        break;
+
+    default:
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    if (r->method != NGX_HTTP_DELETE) {
+        return key.len ? ngx_http_keyval_get(r, ctx, &key)
+                       : ngx_http_keyval_get_all(r, ctx);
+    }
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    if (key.len) {
+        rc = ngx_http_keyval_delete_locked(ctx, &key);
+
+    } else {
+        ngx_http_keyval_clear_locked(ctx);
+        rc = NGX_OK;
+    }
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    if (rc != NGX_OK) {
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    if (ctx->state.len) {
+        ngx_http_keyval_save(ctx, r->pool, r->connection->log);
+    }
+
+    return NGX_HTTP_NO_CONTENT;
+}
+
+
+static void
+ngx_http_keyval_body_handler(ngx_http_request_t *r)
+{
+    ngx_str_t                    key;
+    ngx_http_keyval_ctx_t       *ctx;
+    ngx_http_keyval_loc_conf_t  *klcf;
+
+    klcf = ngx_http_get_module_loc_conf(r, ngx_http_keyval_module);
+
+    ctx = klcf->shm_zone->data;
+
+    (void) ngx_http_keyval_key(r, &key);
+
+    ngx_http_finalize_request(r, ngx_http_keyval_update(r, ctx, &key));
+}
+
+
+static ngx_int_t
+ngx_http_keyval_update(ngx_http_request_t *r, ngx_http_keyval_ctx_t *ctx,
+    ngx_str_t *key)
+{
+    u_char     *p, *last;
+    ngx_int_t   rc;
+    ngx_str_t   body, k, v;
+
+    rc = ngx_http_keyval_body(r, &body);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    p = body.data;
+    last = body.data + body.len;
+
+    if (key->len) {
+
+        /* PUT, a trailing line feed is not a part of the value */
+
+        if (last > p && last[-1] == LF) {
+            last--;
+
+            if (last > p && last[-1] == CR) {
+                last--;
+            }
+        }
+
+        v.data = p;
+        v.len = last - p;
+
+        if (ngx_strlchr(p, last, LF) || ngx_strlchr(p, last, CR)) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "keyval value contains line breaks");
+            return NGX_HTTP_BAD_REQUEST;
+        }
+
+        ngx_shmtx_lock(&ctx->shpool->mutex);
+        rc = ngx_http_keyval_set_locked(ctx, key, &v);
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+        goto done;
+    }
+
+    /* PATCH, the body is checked before anything is changed */
+
+    while ((rc = ngx_http_keyval_parse(&p, last, &k, &v)) == NGX_OK) {
+        /* void */
+    }
+
+    if (rc != NGX_DONE) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "invalid keyval line in request body");
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    p = body.data;
+    rc = NGX_OK;
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    while (ngx_http_keyval_parse(&p, last, &k, &v) == NGX_OK) {
+
+        if (v.data == NULL) {
+            (void) ngx_http_keyval_delete_locked(ctx, &k);
+            continue;
+        }
+
+        rc = ngx_http_keyval_set_locked(ctx, &k, &v);
+
+        if (rc != NGX_OK) {
+            break;
+        }
+    }
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+done:
+
+    if (ctx->state.len) {
+        ngx_http_keyval_save(ctx, r->pool, r->connection->log);
+    }
+
+    if (rc != NGX_OK) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "keyval zone is full");
+        return NGX_HTTP_INSUFFICIENT_STORAGE;
+    }
+
+    return NGX_HTTP_NO_CONTENT;
+}
+
+
+static ngx_int_t
+ngx_http_keyval_get(ngx_http_request_t *r, ngx_http_keyval_ctx_t *ctx,
+    ngx_str_t *key)
+{
+    uint32_t                 hash;
+    ngx_buf_t               *b;
+    ngx_http_keyval_node_t  *node;
+
+    hash = ngx_crc32_short(key->data, key->len);
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    node = (ngx_http_keyval_node_t *)
+               ngx_str_rbtree_lookup(&ctx->sh->rbtree, key, hash);
+
+    if (node == NULL) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    b = ngx_create_temp_buf(r->pool, node->value.len + 1);
+    if (b == NULL) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    b->last = ngx_cpymem(b->last, node->value.data, node->value.len);
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    return ngx_http_keyval_send(r, b);
+}
+
+
+static ngx_int_t
+ngx_http_keyval_get_all(ngx_http_request_t *r, ngx_http_keyval_ctx_t *ctx)
+{
+    size_t                   size;
+    ngx_buf_t               *b;
+    ngx_rbtree_t            *tree;
+    ngx_rbtree_node_t       *rn;
+    ngx_http_keyval_node_t  *node;
+
+    tree = &ctx->sh->rbtree;
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    size = sizeof("{}\n") - 1;
+
+    if (tree->root != tree->sentinel) {
+
+        for (rn = ngx_rbtree_min(tree->root, tree->sentinel);
+             rn;
+             rn = ngx_rbtree_next(tree, rn))
+        {
+            node = (ngx_http_keyval_node_t *) rn;
+
+            size += sizeof("\"\":\"\",") - 1
+                    + node->sn.str.len
+                    + ngx_escape_json(NULL, node->sn.str.data,
+                                      node->sn.str.len)
+                    + node->value.len
+                    + ngx_escape_json(NULL, node->value.data,
+                                      node->value.len);
+        }
+    }
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    *b->last++ = '{';
+
+    if (tree->root != tree->sentinel) {
+
+        for (rn = ngx_rbtree_min(tree->root, tree->sentinel);
+             rn;
+             rn = ngx_rbtree_next(tree, rn))
+        {
+            node = (ngx_http_keyval_node_t *) rn;
+
+            *b->last++ = '"';
+            b->last = (u_char *) ngx_escape_json(b->last, node->sn.str.data,
+                                                 node->sn.str.len);
+            *b->last++ = '"';
+            *b->last++ = ':';
+            *b->last++ = '"';
+            b->last = (u_char *) ngx_escape_json(b->last, node->value.data,
+                                                 node->value.len);
+            *b->last++ = '"';
+            *b->last++ = ',';
+        }
+
+        b->last--;
+    }
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    *b->last++ = '}';
+    *b->last++ = LF;
+
+    r->headers_out.content_type_len = sizeof("application/json") - 1;
+    ngx_str_set(&r->headers_out.content_type, "application/json");
+    r->headers_out.content_type_lowcase = NULL;
+
+    return ngx_http_keyval_send(r, b);
+}
+
+
+static ngx_int_t
+ngx_http_keyval_send(ngx_http_request_t *r, ngx_buf_t *b)
+{
+    ngx_int_t    rc;
+    ngx_chain_t  out;
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    if (b->last == b->pos) {
+        r->header_only = 1;
+    }
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static ngx_int_t
+ngx_http_keyval_key(ngx_http_request_t *r, ngx_str_t *key)
+{
+    u_char                    *p, *last;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    key->len = 0;
+    key->data = NULL;
+
+    if (r->uri.len <= clcf->name.len) {
+        return NGX_OK;
+    }
+
+    p = r->uri.data + clcf->name.len;
+    last = r->uri.data + r->uri.len;
+
+    if (*p == '/') {
+        p++;
+    }
+
+    key->data = p;
+    key->len = last - p;
+
+    for ( /* void */ ; p < last; p++) {
+        if (*p == ' ' || *p == CR || *p == LF) {
+            return NGX_DECLINED;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_keyval_body(ngx_http_request_t *r, ngx_str_t *body)
+{
+    u_char       *p;
+    size_t        len;
+    ngx_chain_t  *cl;
+
+    ngx_str_null(body);
+
+    if (r->request_body == NULL || r->request_body->bufs == NULL) {
+        return NGX_OK;
+    }
+
+    len = 0;
+
+    for (cl = r->request_body->bufs; cl; cl = cl->next) {
+
+        if (cl->buf->in_file) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "keyval request body is buffered to a file");
+            return NGX_HTTP_REQUEST_ENTITY_TOO_LARGE;
+        }
+
+        len += cl->buf->last - cl->buf->pos;
+    }
+
+    if (len == 0) {
+        return NGX_OK;
+    }
+
+    p = ngx_pnalloc(r->pool, len);
+    if (p == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    body->data = p;
+    body->len = len;
+
+    for (cl = r->request_body->bufs; cl; cl = cl->next) {
+        p = ngx_cpymem(p, cl->buf->pos, cl->buf->last - cl->buf->pos);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_keyval_parse(u_char **pos, u_char *last, ngx_str_t *key,
+    ngx_str_t *value)
+{
+    u_char  *p, *eol, *end, *sp;
+
+    for (p = *pos; p < last; p = eol + 1) {
+
+        eol = ngx_strlchr(p, last, LF);
+
+        if (eol == NULL) {
+            eol = last;
+        }
+
+        end = eol;
+
+        if (end > p && end[-1] == CR) {
+            end--;
+        }
+
+        if (end == p) {
+            continue;
+        }
+
+        *pos = (eol == last) ? last : eol + 1;
+
+        sp = ngx_strlchr(p, end, ' ');
+
+        key->data = p;
+        key->len = (sp ? sp : end) - p;
+
+        if (key->len == 0) {
+            return NGX_DECLINED;
+        }
+
+        if (sp == NULL) {
+            ngx_str_null(value);
+            return NGX_OK;
+        }
+
+        value->data = sp + 1;
+        value->len = end - (sp + 1);
+
+        return NGX_OK;
+    }
+
+    *pos = last;
+
+    return NGX_DONE;
+}
+
+
+static ngx_int_t
+ngx_http_keyval_set_locked(ngx_http_keyval_ctx_t *ctx, ngx_str_t *key,
+    ngx_str_t *value)
+{
+    uint32_t                 hash;
+    ngx_http_keyval_node_t  *node, *old;
+
+    hash = ngx_crc32_short(key->data, key->len);
+
+    old = (ngx_http_keyval_node_t *)
+              ngx_str_rbtree_lookup(&ctx->sh->rbtree, key, hash);
+
+    ctx->sh->generation++;
+
+    if (old && old->value.len == value->len) {
+        ngx_memcpy(old->value.data, value->data, value->len);
+        return NGX_OK;
+    }
+
+    node = ngx_slab_alloc_locked(ctx->shpool,
+                                 offsetof(ngx_http_keyval_node_t, data)
+                                 + key->len + value->len);
+    if (node == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (old) {
+        ngx_rbtree_delete(&ctx->sh->rbtree, &old->sn.node);
+        ngx_slab_free_locked(ctx->shpool, old);
+    }
+
+    node->sn.node.key = hash;
+    node->sn.str.len = key->len;
+    node->sn.str.data = node->data;
+    node->value.len = value->len;
+    node->value.data = ngx_cpymem(node->data, key->data, key->len);
+
+    ngx_memcpy(node->value.data, value->data, value->len);
+
+    ngx_rbtree_insert(&ctx->sh->rbtree, &node->sn.node);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_keyval_delete_locked(ngx_http_keyval_ctx_t *ctx, ngx_str_t *key)
+{
+    uint32_t                 hash;
+    ngx_http_keyval_node_t  *node;
+
+    hash = ngx_crc32_short(key->data, key->len);
+
+    node = (ngx_http_keyval_node_t *)
+               ngx_str_rbtree_lookup(&ctx->sh->rbtree, key, hash);
+
+    if (node == NULL) {
+        return NGX_DECLINED;
+    }
+
+    ngx_rbtree_delete(&ctx->sh->rbtree, &node->sn.node);
+    ngx_slab_free_locked(ctx->shpool, node);
+
+    ctx->sh->generation++;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_keyval_clear_locked(ngx_http_keyval_ctx_t *ctx)
+{
+    ngx_rbtree_node_t  *node;
+
+    while (ctx->sh->rbtree.root != ctx->sh->rbtree.sentinel) {
+        node = ctx->sh->rbtree.root;
+
+        ngx_rbtree_delete(&ctx->sh->rbtree, node);
+        ngx_slab_free_locked(ctx->shpool, node);
+    }
+
+    ctx->sh->generation++;
+}
+
+
+static void
+ngx_http_keyval_save(ngx_http_keyval_ctx_t *ctx, ngx_pool_t *pool,
+    ngx_log_t *log)
+{
+    u_char                  *buf, *p, *name;
+    size_t                   size;
+    ssize_t                  n;
+    ngx_fd_t                 fd;
+    ngx_uint_t               generation;
+    ngx_rbtree_t            *tree;
+    ngx_rbtree_node_t       *rn;
+    ngx_http_keyval_node_t  *node;
+
+    tree = &ctx->sh->rbtree;
+
+    name = ngx_pnalloc(pool, ctx->state.len + 1 + NGX_INT64_LEN + 1);
+    if (name == NULL) {
+        return;
+    }
+
+    ngx_sprintf(name, "%V.%P%Z", &ctx->state, ngx_pid);
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    generation = ctx->sh->generation;
+
+    size = 0;
+
+    if (tree->root != tree->sentinel) {
+
+        for (rn = ngx_rbtree_min(tree->root, tree->sentinel);
+             rn;
+             rn = ngx_rbtree_next(tree, rn))
+        {
+            node = (ngx_http_keyval_node_t *) rn;
+            size += node->sn.str.len + 1 + node->value.len + 1;
+        }
+    }
+
+    buf = ngx_pnalloc(pool, size ? size : 1);
+    if (buf == NULL) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        return;
+    }
+
+    p = buf;
+
+    if (tree->root != tree->sentinel) {
+
+        for (rn = ngx_rbtree_min(tree->root, tree->sentinel);
+             rn;
+             rn = ngx_rbtree_next(tree, rn))
+        {
+            node = (ngx_http_keyval_node_t *) rn;
+
+            p = ngx_cpymem(p, node->sn.str.data, node->sn.str.len);
+            *p++ = ' ';
+            p = ngx_cpymem(p, node->value.data, node->value.len);
+            *p++ = LF;
+        }
+    }
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    /*
+     * the snapshot is written to a temporary file outside of the lock;
+     * the file is renamed under the lock, and only if no other worker
+     * has saved a more recent snapshot in the meantime
+     */
+
+    fd = ngx_open_file(name, NGX_FILE_WRONLY, NGX_FILE_TRUNCATE,
+                       NGX_FILE_DEFAULT_ACCESS);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", name);
+        return;
+    }
+
+    n = ngx_write_fd(fd, buf, p - buf);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_write_fd_n " to \"%s\" failed", name);
+
+    } else if ((size_t) n != (size_t) (p - buf)) {
+        ngx_log_error(NGX_LOG_CRIT, log, 0,
+                      ngx_write_fd_n " to \"%s\" was incomplete: %z of %uz",
+                      name, n, (size_t) (p - buf));
+        n = -1;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", name);
+    }
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    if (n != -1 && generation > ctx->sh->saved) {
+
+        if (ngx_rename_file(name, ctx->state.data) != NGX_FILE_ERROR) {
+            ctx->sh->saved = generation;
+            ngx_shmtx_unlock(&ctx->shpool->mutex);
+            return;
+        }
+
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_rename_file_n " \"%s\" to \"%V\" failed",
+                      name, &ctx->state);
+    }
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    if (ngx_delete_file(name) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_delete_file_n " \"%s\" failed", name);
+    }
+}
+
+
+static ngx_int_t
+ngx_http_keyval_load(ngx_shm_zone_t *shm_zone)
+{
+    ngx_http_keyval_ctx_t  *ctx = shm_zone->data;
+
+    u_char           *buf, *p;
+    size_t            size;
+    ssize_t           n;
+    ngx_fd_t          fd;
+    ngx_int_t         rc;
+    ngx_str_t         key, value;
+    ngx_err_t         err;
+    ngx_log_t        *log;
+    ngx_file_info_t   fi;
+
+    log = shm_zone->shm.log;
+
+    fd = ngx_open_file(ctx->state.data, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        err = ngx_errno;
+
+        if (err == NGX_ENOENT) {
+            return NGX_OK;
+        }
+
+        ngx_log_error(NGX_LOG_CRIT, log, err,
+                      ngx_open_file_n " \"%V\" failed", &ctx->state);
+        return NGX_ERROR;
+    }
+
+    buf = NULL;
+    rc = NGX_ERROR;
+
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_fd_info_n " \"%V\" failed", &ctx->state);
+        goto done;
+    }
+
+    size = (size_t) ngx_file_size(&fi);
+
+    buf = ngx_alloc(size ? size : 1, log);
+    if (buf == NULL) {
+        goto done;
+    }
+
+    n = ngx_read_fd(fd, buf, size);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_read_fd_n " \"%V\" failed", &ctx->state);
+        goto done;
+    }
+
+    if ((size_t) n != size) {
+        ngx_log_error(NGX_LOG_CRIT, log, 0,
+                      ngx_read_fd_n " \"%V\" returned only %z bytes "
+                      "instead of %uz", &ctx->state, n, size);
+        goto done;
+    }
+
+    p = buf;
+
+    for ( ;; ) {
+        rc = ngx_http_keyval_parse(&p, buf + size, &key, &value);
+
+        if (rc == NGX_DONE) {
+            rc = NGX_OK;
+            break;
+        }
+
+        if (rc == NGX_DECLINED || value.data == NULL) {
+            ngx_log_error(NGX_LOG_WARN, log, 0,
+                          "invalid line in keyval state file \"%V\"",
+                          &ctx->state);
+            continue;
+        }
+
+        if (ngx_http_keyval_set_locked(ctx, &key, &value) != NGX_OK) {
+            ngx_log_error(NGX_LOG_EMERG, log, 0,
+                          "keyval state file \"%V\" does not fit "
+                          "into zone \"%V\"", &ctx->state,
+                          &shm_zone->shm.name);
+            rc = NGX_ERROR;
+            break;
+        }
+    }
+
+    ctx->sh->saved = ctx->sh->generation;
+
+done:
+
+    if (buf) {
+        ngx_free(buf);
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%V\" failed", &ctx->state);
+    }
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_http_keyval_variable(ngx_http_request_t *r, ngx_http_variable_value_t *v,
+    uintptr_t data)
+{
+    ngx_http_keyval_variable_t  *kv = (ngx_http_keyval_variable_t *) data;
+
+    uint32_t                 hash;
+    ngx_str_t                key;
+    ngx_http_keyval_ctx_t   *ctx;
+    ngx_http_keyval_node_t  *node;
+
+    if (ngx_http_complex_value(r, &kv->key, &key) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ctx = kv->shm_zone->data;
+
+    hash = ngx_crc32_short(key.data, key.len);
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    node = (ngx_http_keyval_node_t *)
+               ngx_str_rbtree_lookup(&ctx->sh->rbtree, &key, hash);
+
+    if (node == NULL) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    v->data = ngx_pnalloc(r->pool, node->value.len + 1);
+    if (v->data == NULL) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(v->data, node->value.data, node->value.len);
+    v->len = node->value.len;
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http keyval: \"%V\" \"%v\"", &key, v);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_keyval_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_keyval_ctx_t  *octx = data;
+
+    size_t                  len;
+    ngx_http_keyval_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+
+    if (octx) {
+        ctx->sh = octx->sh;
+        ctx->shpool = octx->shpool;
+
+        return NGX_OK;
+    }
+
+    ctx->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        ctx->sh = ctx->shpool->data;
+
+        return NGX_OK;
+    }
+
+    ctx->sh = ngx_slab_alloc(ctx->shpool, sizeof(ngx_http_keyval_shctx_t));
+    if (ctx->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->shpool->data = ctx->sh;
+
+    ngx_rbtree_init(&ctx->sh->rbtree, &ctx->sh->sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ctx->sh->generation = 0;
+    ctx->sh->saved = 0;
+
+    len = sizeof(" in keyval zone \"\"") + shm_zone->shm.name.len;
+
+    ctx->shpool->log_ctx = ngx_slab_alloc(ctx->shpool, len);
+    if (ctx->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(ctx->shpool->log_ctx, " in keyval zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    if (ctx->state.len) {
+        return ngx_http_keyval_load(shm_zone);
+    }
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_http_keyval_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_keyval_main_conf_t  *kmcf;
+
+    kmcf = ngx_pcalloc(cf->pool, sizeof(ngx_http_keyval_main_conf_t));
+    if (kmcf == NULL) {
+        return NULL;
+    }
+
+    if (ngx_array_init(&kmcf->zones, cf->pool, 4, sizeof(ngx_shm_zone_t *))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    return kmcf;
+}
+
+
+static char *
+ngx_http_keyval_init_main_conf(ngx_conf_t *cf, void *conf)
+{
+    ngx_http_keyval_main_conf_t *kmcf = conf;
+
+    ngx_uint_t        i;
+    ngx_shm_zone_t  **zones;
+
+    zones = kmcf->zones.elts;
+
+    for (i = 0; i < kmcf->zones.nelts; i++) {
+
+        if (zones[i]->data == NULL) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "unknown keyval_zone \"%V\"",
+                               &zones[i]->shm.name);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    return NGX_CONF_OK;
+}
+
+
+static void *
+ngx_http_keyval_create_loc_conf(ngx_conf_t *cf)
+{
+    ngx_http_keyval_loc_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_keyval_loc_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     conf->shm_zone = NULL;
+     */
+
+    return conf;
+}
+
+
+static char *
+ngx_http_keyval_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    u_char                 *p;
+    ssize_t                 size;
+    ngx_str_t              *value, name, s;
+    ngx_uint_t              i, hugepages;
+    ngx_shm_zone_t         *shm_zone;
+    ngx_http_keyval_ctx_t  *ctx;
+
+    value = cf->args->elts;
+
+    ctx = ngx_pcalloc(cf->pool, sizeof(ngx_http_keyval_ctx_t));
+    if (ctx == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    size = 0;
+    hugepages = 0;
+    name.len = 0;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            hugepages = 1;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "zone=", 5) == 0) {
+
+            name.data = value[i].data + 5;
+
+            p = (u_char *) ngx_strchr(name.data, ':');
+
+            if (p == NULL) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid zone size \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            name.len = p - name.data;
+
+            s.data = p + 1;
+            s.len = value[i].data + value[i].len - s.data;
+
+            size = ngx_parse_size(&s);
+
+            if (size == NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid zone size \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            if (size < (ssize_t) (8 * ngx_pagesize)) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "zone \"%V\" is too small", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "state=", 6) == 0) {
+
+            ctx->state.len = value[i].len - 6;
+            ctx->state.data = value[i].data + 6;
+
+            if (ctx->state.len == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid state file \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            if (ngx_conf_full_name(cf->cycle, &ctx->state, 0) != NGX_OK) {
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (name.len == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"%V\" must have \"zone\" parameter",
+                           &cmd->name);
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                     &ngx_http_keyval_module);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (shm_zone->data) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"", &name);
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone->init = ngx_http_keyval_init_zone;
+    shm_zone->data = ctx;
+    shm_zone->shm.hugepages = hugepages;
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_keyval(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_str_t                         *value, name;
+    ngx_http_variable_t               *var;
+    ngx_http_keyval_variable_t        *kv;
+    ngx_http_compile_complex_value_t   ccv;
+
+    value = cf->args->elts;
+
+    kv = ngx_pcalloc(cf->pool, sizeof(ngx_http_keyval_variable_t));
+    if (kv == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_memzero(&ccv, sizeof(ngx_http_compile_complex_value_t));
+
+    ccv.cf = cf;
+    ccv.value = &value[1];
+    ccv.complex_value = &kv->key;
+
+    if (ngx_http_compile_complex_value(&ccv) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    name = value[2];
+
+    if (name.data[0] != '$') {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid variable name \"%V\"", &name);
+        return NGX_CONF_ERROR;
+    }
+
+    name.len--;
+    name.data++;
+
+    kv->shm_zone = ngx_http_keyval_add_zone(cf, &value[3]);
+    if (kv->shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    var = ngx_http_add_variable(cf, &name, NGX_HTTP_VAR_CHANGEABLE);
+    if (var == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    var->get_handler = ngx_http_keyval_variable;
+    var->data = (uintptr_t) kv;
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_keyval_api(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_keyval_loc_conf_t *klcf = conf;
+
+    ngx_str_t                 *value;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    if (klcf->shm_zone) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    klcf->shm_zone = ngx_http_keyval_add_zone(cf, &value[1]);
+    if (klcf->shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_keyval_handler;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_shm_zone_t *
+ngx_http_keyval_add_zone(ngx_conf_t *cf, ngx_str_t *value)
+{
+    ngx_str_t                     name;
+    ngx_shm_zone_t               *shm_zone, **zonep;
+    ngx_http_keyval_main_conf_t  *kmcf;
+
+    if (ngx_strncmp(value->data, "zone=", 5) != 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", value);
+        return NULL;
+    }
+
+    name.len = value->len - 5;
+    name.data = value->data + 5;
+
+    shm_zone = ngx_shared_memory_add(cf, &name, 0, &ngx_http_keyval_module);
+    if (shm_zone == NULL) {
+        return NULL;
+    }
+
+    kmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_keyval_module);
+
+    zonep = ngx_array_push(&kmcf->zones);
+    if (zonep == NULL) {
+        return NULL;
+    }
+
+    *zonep = shm_zone;
+
+    return shm_zone;
+}
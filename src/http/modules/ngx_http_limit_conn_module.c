@@ -18,7 +18,7 @@
 typedef struct {
     u_char                        color;
     u_char                        len;
-    u_short                       conn;
+    ngx_atomic_t                  conn;
     u_char                        data[1];
 } ngx_http_limit_conn_node_t;
 
@@ -29,15 +29,32 @@ typedef struct {
 } ngx_http_limit_conn_cleanup_t;
 
 
+/*
+ * Keys are partitioned between shards by hash, each shard with its own
+ * tree and mutex, so that connections with different keys do not
+ * contend for the lock; the zone mutex then only protects allocations.
+ * A single shard uses the zone mutex.
+ */
+
 typedef struct {
     ngx_rbtree_t                  rbtree;
     ngx_rbtree_node_t             sentinel;
+    ngx_shmtx_t                  *mutex;
+    ngx_shmtx_t                   shmtx;
+    ngx_shmtx_sh_t                lock;
+} ngx_http_limit_conn_shard_t;
+
+
+typedef struct {
+    ngx_uint_t                    nshards;
+    ngx_http_limit_conn_shard_t   shards[1];
 } ngx_http_limit_conn_shctx_t;
 
 
 typedef struct {
     ngx_http_limit_conn_shctx_t  *sh;
     ngx_slab_pool_t              *shpool;
+    ngx_uint_t                    nshards;
     ngx_http_complex_value_t      key;
 } ngx_http_limit_conn_ctx_t;
 
@@ -59,6 +76,10 @@ typedef struct {
 static ngx_rbtree_node_t *ngx_http_limit_conn_lookup(ngx_rbtree_t *rbtree,
     ngx_str_t *key, uint32_t hash);
 static void ngx_http_limit_conn_cleanup(void *data);
+static ngx_inline void *ngx_http_limit_conn_alloc(
+    ngx_http_limit_conn_ctx_t *ctx, size_t size);
+static ngx_inline void ngx_http_limit_conn_free(ngx_http_limit_conn_ctx_t *ctx,
+    void *p);
 static ngx_inline void ngx_http_limit_conn_cleanup_all(ngx_pool_t *pool);
 
 static ngx_int_t ngx_http_limit_conn_status_variable(ngx_http_request_t *r,
@@ -91,7 +112,7 @@ static ngx_conf_num_bounds_t  ngx_http_limit_conn_status_bounds = {
 static ngx_command_t  ngx_http_limit_conn_commands[] = {
 
     { ngx_string("limit_conn_zone"),
-      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE2,
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE23,
       ngx_http_limit_conn_zone,
       0,
       0,
@@ -188,6 +209,7 @@ ngx_http_limit_conn_handler(ngx_http_request_t *r)
     ngx_http_limit_conn_ctx_t      *ctx;
     ngx_http_limit_conn_node_t     *lc;
     ngx_http_limit_conn_conf_t     *lccf;
+    ngx_http_limit_conn_shard_t    *shard;
     ngx_http_limit_conn_limit_t    *limits;
     ngx_http_limit_conn_cleanup_t  *lccln;
 
@@ -219,11 +241,13 @@ ngx_http_limit_conn_handler(ngx_http_request_t *r)
 
         r->main->limit_conn_status = NGX_HTTP_LIMIT_CONN_PASSED;
 
-        hash = ngx_crc32_short(key.data, key.len);
+        hash = ngx_crc32c(key.data, key.len);
+
+        shard = &ctx->sh->shards[hash % ctx->nshards];
 
-        ngx_shmtx_lock(&ctx->shpool->mutex);
+        ngx_shmtx_lock(shard->mutex);
 
-        node = ngx_http_limit_conn_lookup(&ctx->sh->rbtree, &key, hash);
+        node = ngx_http_limit_conn_lookup(&shard->rbtree, &key, hash);
 
         if (node == NULL) {
 
@@ -231,10 +255,10 @@ ngx_http_limit_conn_handler(ngx_http_request_t *r)
                 + offsetof(ngx_http_limit_conn_node_t, data)
                 + key.len;
 
-            node = ngx_slab_alloc_locked(ctx->shpool, n);
+            node = ngx_http_limit_conn_alloc(ctx, n);
 
             if (node == NULL) {
-                ngx_shmtx_unlock(&ctx->shpool->mutex);
+                ngx_shmtx_unlock(shard->mutex);
                 ngx_http_limit_conn_cleanup_all(r->pool);
 
                 if (lccf->dry_run) {
@@ -255,7 +279,7 @@ ngx_http_limit_conn_handler(ngx_http_request_t *r)
             lc->conn = 1;
             ngx_memcpy(lc->data, key.data, key.len);
 
-            ngx_rbtree_insert(&ctx->sh->rbtree, node);
+            ngx_rbtree_insert(&shard->rbtree, node);
 
         } else {
 
@@ -263,7 +287,7 @@ ngx_http_limit_conn_handler(ngx_http_request_t *r)
 
             if ((ngx_uint_t) lc->conn >= limits[i].conn) {
 
-                ngx_shmtx_unlock(&ctx->shpool->mutex);
+                ngx_shmtx_unlock(shard->mutex);
 
                 ngx_log_error(lccf->log_level, r->connection->log, 0,
                               "limiting connections%s by zone \"%V\"",
@@ -283,13 +307,15 @@ ngx_http_limit_conn_handler(ngx_http_request_t *r)
                 return lccf->status_code;
             }
 
-            lc->conn++;
+            /* cleanups of other connections decrement without the lock */
+
+            (void) ngx_atomic_fetch_add(&lc->conn, 1);
         }
 
         ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "limit conn: %08Xi %d", node->key, lc->conn);
+                       "limit conn: %08Xi %uA", node->key, lc->conn);
 
-        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        ngx_shmtx_unlock(shard->mutex);
 
         cln = ngx_pool_cleanup_add(r->pool,
                                    sizeof(ngx_http_limit_conn_cleanup_t));
@@ -393,27 +419,78 @@ ngx_http_limit_conn_cleanup(void *data)
 {
     ngx_http_limit_conn_cleanup_t  *lccln = data;
 
-    ngx_rbtree_node_t           *node;
-    ngx_http_limit_conn_ctx_t   *ctx;
-    ngx_http_limit_conn_node_t  *lc;
+    ngx_rbtree_node_t            *node;
+    ngx_atomic_uint_t             conn;
+    ngx_http_limit_conn_ctx_t    *ctx;
+    ngx_http_limit_conn_node_t   *lc;
+    ngx_http_limit_conn_shard_t  *shard;
 
     ctx = lccln->shm_zone->data;
     node = lccln->node;
     lc = (ngx_http_limit_conn_node_t *) &node->color;
 
-    ngx_shmtx_lock(&ctx->shpool->mutex);
-
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, lccln->shm_zone->shm.log, 0,
-                   "limit conn cleanup: %08Xi %d", node->key, lc->conn);
+                   "limit conn cleanup: %08Xi %uA", node->key, lc->conn);
+
+#if (NGX_HAVE_ATOMIC_OPS)
+
+    /*
+     * the node cannot be deleted while there are other connections,
+     * so the counter is decremented without the lock unless it is the
+     * last connection
+     */
+
+    for ( ;; ) {
+        conn = lc->conn;
+
+        if (conn <= 1) {
+            break;
+        }
+
+        if (ngx_atomic_cmp_set(&lc->conn, conn, conn - 1)) {
+            return;
+        }
+    }
+
+#endif
+
+    shard = &ctx->sh->shards[node->key % ctx->nshards];
+
+    ngx_shmtx_lock(shard->mutex);
+
+    conn = ngx_atomic_fetch_add(&lc->conn, -1);
+
+    if (conn == 1) {
+        ngx_rbtree_delete(&shard->rbtree, node);
+        ngx_http_limit_conn_free(ctx, node);
+    }
+
+    ngx_shmtx_unlock(shard->mutex);
+}
+
+
+static ngx_inline void *
+ngx_http_limit_conn_alloc(ngx_http_limit_conn_ctx_t *ctx, size_t size)
+{
+    /* with a single shard, the zone mutex is already held */
+
+    if (ctx->nshards == 1) {
+        return ngx_slab_alloc_locked(ctx->shpool, size);
+    }
+
+    return ngx_slab_alloc(ctx->shpool, size);
+}
 
-    lc->conn--;
 
-    if (lc->conn == 0) {
-        ngx_rbtree_delete(&ctx->sh->rbtree, node);
-        ngx_slab_free_locked(ctx->shpool, node);
+static ngx_inline void
+ngx_http_limit_conn_free(ngx_http_limit_conn_ctx_t *ctx, void *p)
+{
+    if (ctx->nshards == 1) {
+        ngx_slab_free_locked(ctx->shpool, p);
+        return;
     }
 
-    ngx_shmtx_unlock(&ctx->shpool->mutex);
+    ngx_slab_free(ctx->shpool, p);
 }
 
 
@@ -438,8 +515,10 @@ ngx_http_limit_conn_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 {
     ngx_http_limit_conn_ctx_t  *octx = data;
 
-    size_t                      len;
-    ngx_http_limit_conn_ctx_t  *ctx;
+    size_t                        len;
+    ngx_uint_t                    i;
+    ngx_http_limit_conn_ctx_t    *ctx;
+    ngx_http_limit_conn_shard_t  *shard;
 
     ctx = shm_zone->data;
 
@@ -457,6 +536,14 @@ ngx_http_limit_conn_init_zone(ngx_shm_zone_t *shm_zone, void *data)
             return NGX_ERROR;
         }
 
+        if (ctx->nshards != octx->nshards) {
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "limit_conn_zone \"%V\" uses %ui shards "
+                          "while previously it used %ui shards",
+                          &shm_zone->shm.name, ctx->nshards, octx->nshards);
+            return NGX_ERROR;
+        }
+
         ctx->sh = octx->sh;
         ctx->shpool = octx->shpool;
 
@@ -471,15 +558,36 @@ ngx_http_limit_conn_init_zone(ngx_shm_zone_t *shm_zone, void *data)
         return NGX_OK;
     }
 
-    ctx->sh = ngx_slab_alloc(ctx->shpool, sizeof(ngx_http_limit_conn_shctx_t));
+    len = offsetof(ngx_http_limit_conn_shctx_t, shards)
+          + ctx->nshards * sizeof(ngx_http_limit_conn_shard_t);
+
+    ctx->sh = ngx_slab_alloc(ctx->shpool, len);
     if (ctx->sh == NULL) {
         return NGX_ERROR;
     }
 
+    ngx_memzero(ctx->sh, len);
+
     ctx->shpool->data = ctx->sh;
+    ctx->sh->nshards = ctx->nshards;
+
+    for (i = 0; i < ctx->nshards; i++) {
+        shard = &ctx->sh->shards[i];
+
+        ngx_rbtree_init(&shard->rbtree, &shard->sentinel,
+                        ngx_http_limit_conn_rbtree_insert_value);
+
+        if (ctx->nshards == 1) {
+            shard->mutex = &ctx->shpool->mutex;
+            continue;
+        }
+
+        if (ngx_shmtx_create(&shard->shmtx, &shard->lock, NULL) != NGX_OK) {
+            return NGX_ERROR;
+        }
 
-    ngx_rbtree_init(&ctx->sh->rbtree, &ctx->sh->sentinel,
-                    ngx_http_limit_conn_rbtree_insert_value);
+        shard->mutex = &shard->shmtx;
+    }
 
     len = sizeof(" in limit_conn_zone \"\"") + shm_zone->shm.name.len;
 
@@ -564,6 +672,7 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     u_char                            *p;
     ssize_t                            size;
     ngx_str_t                         *value, name, s;
+    ngx_int_t                          shards;
     ngx_uint_t                         i;
     ngx_shm_zone_t                    *shm_zone;
     ngx_http_limit_conn_ctx_t         *ctx;
@@ -588,6 +697,7 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     size = 0;
     name.len = 0;
+    shards = 1;
 
     for (i = 2; i < cf->args->nelts; i++) {
 
@@ -625,6 +735,29 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "shards=", 7) == 0) {
+
+            shards = ngx_atoi(value[i].data + 7, value[i].len - 7);
+
+            if (shards <= 0 || shards > 256) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid number of shards \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+#if !(NGX_HAVE_ATOMIC_OPS)
+            if (shards != 1) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "\"shards\" requires atomic operations "
+                                   "support on this platform");
+                return NGX_CONF_ERROR;
+            }
+#endif
+
+            continue;
+        }
+
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                            "invalid parameter \"%V\"", &value[i]);
         return NGX_CONF_ERROR;
@@ -652,6 +785,8 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    ctx->nshards = shards;
+
     shm_zone->init = ngx_http_limit_conn_init_zone;
     shm_zone->data = ctx;
 
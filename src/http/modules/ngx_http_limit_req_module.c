@@ -21,11 +21,13 @@ typedef struct {
     u_char                       color;
     u_char                       dummy;
     u_short                      len;
+    uint32_t                     hash;
     ngx_queue_t                  queue;
     ngx_msec_t                   last;
     /* integer value, 1 corresponds to 0.001 r/s */
     ngx_uint_t                   excess;
-    ngx_uint_t                   count;
+    /* the requests of the previous window, 1 corresponds to 0.001 */
+    ngx_uint_t                   prev;
     u_char                       data[1];
 } ngx_http_limit_req_node_t;
 
@@ -34,19 +36,58 @@ typedef struct {
     ngx_rbtree_t                  rbtree;
     ngx_rbtree_node_t             sentinel;
     ngx_queue_t                   queue;
+    ngx_shm_index_t               index;
 } ngx_http_limit_req_shctx_t;
 
 
+/*
+ * with the "sync" parameter, a worker process checks requests against
+ * its own copies of the nodes, and publishes the requests it passed
+ * to the zone once per the interval
+ */
+
+typedef struct {
+    ngx_str_node_t               sn;
+    ngx_queue_t                  queue;
+    ngx_msec_t                   last;
+    ngx_msec_t                   synced;
+    ngx_msec_t                   accessed;
+    /* integer value, 1 corresponds to 0.001 r/s */
+    ngx_uint_t                   excess;
+    ngx_uint_t                   pending;
+    u_char                       data[1];
+} ngx_http_limit_req_local_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t                 rbtree;
+    ngx_rbtree_node_t            sentinel;
+    ngx_queue_t                  queue;
+    ngx_uint_t                   count;
+    ngx_msec_t                   synced;
+    ngx_event_t                  event;
+    ngx_shm_zone_t              *shm_zone;
+} ngx_http_limit_req_local_t;
+
+
 typedef struct {
     ngx_http_limit_req_shctx_t  *sh;
     ngx_slab_pool_t             *shpool;
     /* integer value, 1 corresponds to 0.001 r/s */
     ngx_uint_t                   rate;
     ngx_http_complex_value_t     key;
-    ngx_http_limit_req_node_t   *node;
+    ngx_uint_t                   hash;   /* unsigned  hash:1; */
+    ngx_msec_t                   sync;
+    ngx_http_limit_req_local_t  *local;
+    ngx_msec_t                   window;
+    /* requests per window, 1 corresponds to 0.001 */
+    ngx_uint_t                   quota;
 } ngx_http_limit_req_ctx_t;
 
 
+#define NGX_HTTP_LIMIT_REQ_LOCAL_MAX  65536
+
+
 typedef struct {
     ngx_shm_zone_t              *shm_zone;
     /* integer value, 1 corresponds to 0.001 r/s */
@@ -65,14 +106,31 @@ typedef struct {
 
 
 static void ngx_http_limit_req_delay(ngx_http_request_t *r);
+static ngx_http_limit_req_node_t *ngx_http_limit_req_find(
+    ngx_http_limit_req_ctx_t *ctx, ngx_uint_t hash, ngx_str_t *key);
 static ngx_int_t ngx_http_limit_req_lookup(ngx_http_limit_req_limit_t *limit,
-    ngx_uint_t hash, ngx_str_t *key, ngx_uint_t *ep, ngx_uint_t account);
-static ngx_msec_t ngx_http_limit_req_account(ngx_http_limit_req_limit_t *limits,
-    ngx_uint_t n, ngx_uint_t *ep, ngx_http_limit_req_limit_t **limit);
-static void ngx_http_limit_req_unlock(ngx_http_limit_req_limit_t *limits,
-    ngx_uint_t n);
+    ngx_uint_t hash, ngx_str_t *key, ngx_uint_t *ep);
+static ngx_int_t ngx_http_limit_req_window(ngx_http_limit_req_limit_t *limit,
+    ngx_http_limit_req_node_t *lr, ngx_uint_t *ep);
+static ngx_http_limit_req_node_t *ngx_http_limit_req_alloc(
+    ngx_http_limit_req_ctx_t *ctx, ngx_uint_t hash, ngx_str_t *key);
+static ngx_int_t ngx_http_limit_req_lookup_local(
+    ngx_http_limit_req_limit_t *limit, ngx_uint_t hash, ngx_str_t *key,
+    ngx_uint_t *ep);
+static ngx_int_t ngx_http_limit_req_sync_node(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_local_node_t *ln);
+static void ngx_http_limit_req_sync_handler(ngx_event_t *ev);
+static void ngx_http_limit_req_free_local(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_local_node_t *ln);
+static void ngx_http_limit_req_rollback(ngx_http_request_t *r,
+    ngx_http_limit_req_limit_t *limits, ngx_uint_t n);
+static ngx_uint_t ngx_http_limit_req_stale(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_node_t *lr, ngx_msec_int_t ms);
 static void ngx_http_limit_req_expire(ngx_http_limit_req_ctx_t *ctx,
     ngx_uint_t n);
+static void ngx_http_limit_req_delete(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_node_t *lr);
+static void ngx_http_limit_req_defrag(ngx_shm_zone_t *shm_zone);
 
 static ngx_int_t ngx_http_limit_req_status_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
@@ -85,6 +143,7 @@ static char *ngx_http_limit_req(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static ngx_int_t ngx_http_limit_req_add_variables(ngx_conf_t *cf);
 static ngx_int_t ngx_http_limit_req_init(ngx_conf_t *cf);
+static ngx_int_t ngx_http_limit_req_init_process(ngx_cycle_t *cycle);
 
 
 static ngx_conf_enum_t  ngx_http_limit_req_log_levels[] = {
@@ -104,7 +163,7 @@ static ngx_conf_num_bounds_t  ngx_http_limit_req_status_bounds = {
 static ngx_command_t  ngx_http_limit_req_commands[] = {
 
     { ngx_string("limit_req_zone"),
-      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE3,
+      NGX_HTTP_MAIN_CONF|NGX_CONF_2MORE,
       ngx_http_limit_req_zone,
       0,
       0,
@@ -164,7 +223,7 @@ ngx_module_t  ngx_http_limit_req_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_limit_req_init_process,       /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -197,11 +256,11 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
     uint32_t                     hash;
     ngx_str_t                    key;
     ngx_int_t                    rc;
-    ngx_uint_t                   n, excess;
-    ngx_msec_t                   delay;
+    ngx_uint_t                   n, excess, delay_excess;
+    ngx_msec_t                   delay, max_delay;
     ngx_http_limit_req_ctx_t    *ctx;
     ngx_http_limit_req_conf_t   *lrcf;
-    ngx_http_limit_req_limit_t  *limit, *limits;
+    ngx_http_limit_req_limit_t  *limit, *limits, *delayed;
 
     if (r->main->limit_req_status) {
         return NGX_DECLINED;
@@ -211,6 +270,9 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
     limits = lrcf->limits.elts;
 
     excess = 0;
+    delay_excess = 0;
+    max_delay = 0;
+    delayed = NULL;
 
     rc = NGX_DECLINED;
 
@@ -218,6 +280,11 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
     limit = NULL;
 #endif
 
+    /*
+     * the request is accounted in each zone with a single lock;
+     * if a zone rejects it, it is taken back from the zones before
+     */
+
     for (n = 0; n < lrcf->limits.nelts; n++) {
 
         limit = &limits[n];
@@ -225,7 +292,7 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
         ctx = limit->shm_zone->data;
 
         if (ngx_http_complex_value(r, &ctx->key, &key) != NGX_OK) {
-            ngx_http_limit_req_unlock(limits, n);
+            ngx_http_limit_req_rollback(r, limits, n);
             return NGX_HTTP_INTERNAL_SERVER_ERROR;
         }
 
@@ -241,22 +308,38 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
             continue;
         }
 
-        hash = ngx_crc32_short(key.data, key.len);
+        hash = ngx_crc32c(key.data, key.len);
 
-        ngx_shmtx_lock(&ctx->shpool->mutex);
+        if (ctx->local) {
+            rc = ngx_http_limit_req_lookup_local(limit, hash, &key, &excess);
 
-        rc = ngx_http_limit_req_lookup(limit, hash, &key, &excess,
-                                       (n == lrcf->limits.nelts - 1));
+        } else {
+            ngx_shmtx_lock(&ctx->shpool->mutex);
 
-        ngx_shmtx_unlock(&ctx->shpool->mutex);
+            rc = ngx_http_limit_req_lookup(limit, hash, &key, &excess);
+
+            ngx_shmtx_unlock(&ctx->shpool->mutex);
+        }
 
         ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                        "limit_req[%ui]: %i %ui.%03ui",
                        n, rc, excess / 1000, excess % 1000);
 
-        if (rc != NGX_AGAIN) {
+        if (rc != NGX_OK) {
             break;
         }
+
+        if (excess <= limit->delay) {
+            continue;
+        }
+
+        delay = (excess - limit->delay) * 1000 / ctx->rate;
+
+        if (delay > max_delay) {
+            max_delay = delay;
+            delay_excess = excess;
+            delayed = limit;
+        }
     }
 
     if (rc == NGX_DECLINED) {
@@ -273,7 +356,7 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
                         &limit->shm_zone->shm.name);
         }
 
-        ngx_http_limit_req_unlock(limits, n);
+        ngx_http_limit_req_rollback(r, limits, n);
 
         if (lrcf->dry_run) {
             r->main->limit_req_status = NGX_HTTP_LIMIT_REQ_REJECTED_DRY_RUN;
@@ -285,19 +368,17 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
         return lrcf->status_code;
     }
 
-    /* rc == NGX_AGAIN || rc == NGX_OK */
-
-    if (rc == NGX_AGAIN) {
-        excess = 0;
-    }
-
-    delay = ngx_http_limit_req_account(limits, n, &excess, &limit);
+    /* rc == NGX_OK */
 
-    if (!delay) {
+    if (!max_delay) {
         r->main->limit_req_status = NGX_HTTP_LIMIT_REQ_PASSED;
         return NGX_DECLINED;
     }
 
+    excess = delay_excess;
+    limit = delayed;
+    delay = max_delay;
+
     ngx_log_error(lrcf->delay_log_level, r->connection->log, 0,
                   "delaying request%s, excess: %ui.%03ui, by zone \"%V\"",
                   lrcf->dry_run ? ", dry run" : "",
@@ -401,21 +482,30 @@ ngx_http_limit_req_rbtree_insert_value(ngx_rbtree_node_t *temp,
 }
 
 
-static ngx_int_t
-ngx_http_limit_req_lookup(ngx_http_limit_req_limit_t *limit, ngx_uint_t hash,
-    ngx_str_t *key, ngx_uint_t *ep, ngx_uint_t account)
+static ngx_http_limit_req_node_t *
+ngx_http_limit_req_find(ngx_http_limit_req_ctx_t *ctx, ngx_uint_t hash,
+    ngx_str_t *key)
 {
-    size_t                      size;
-    ngx_int_t                   rc, excess;
-    ngx_msec_t                  now;
-    ngx_msec_int_t              ms;
+    ngx_int_t                   rc;
     ngx_rbtree_node_t          *node, *sentinel;
-    ngx_http_limit_req_ctx_t   *ctx;
+    ngx_shm_index_iter_t        it;
     ngx_http_limit_req_node_t  *lr;
 
-    now = ngx_current_msec;
+    if (ctx->hash) {
 
-    ctx = limit->shm_zone->data;
+        for (lr = ngx_shm_index_lookup(&ctx->sh->index, hash, &it);
+             lr;
+             lr = ngx_shm_index_next(&ctx->sh->index, &it))
+        {
+            if (ngx_memn2cmp(key->data, lr->data, key->len, (size_t) lr->len)
+                == 0)
+            {
+                return lr;
+            }
+        }
+
+        return NULL;
+    }
 
     node = ctx->sh->rbtree.root;
     sentinel = ctx->sh->rbtree.sentinel;
@@ -439,204 +529,537 @@ ngx_http_limit_req_lookup(ngx_http_limit_req_limit_t *limit, ngx_uint_t hash,
         rc = ngx_memn2cmp(key->data, lr->data, key->len, (size_t) lr->len);
 
         if (rc == 0) {
-            ngx_queue_remove(&lr->queue);
-            ngx_queue_insert_head(&ctx->sh->queue, &lr->queue);
+            return lr;
+        }
 
-            ms = (ngx_msec_int_t) (now - lr->last);
+        node = (rc < 0) ? node->left : node->right;
+    }
 
-            if (ms < -60000) {
-                ms = 1;
+    return NULL;
+}
 
-            } else if (ms < 0) {
-                ms = 0;
-            }
 
-            excess = lr->excess - ctx->rate * ms / 1000 + 1000;
+static ngx_int_t
+ngx_http_limit_req_lookup(ngx_http_limit_req_limit_t *limit, ngx_uint_t hash,
+    ngx_str_t *key, ngx_uint_t *ep)
+{
+    ngx_int_t                   excess;
+    ngx_msec_t                  now;
+    ngx_msec_int_t              ms;
+    ngx_http_limit_req_ctx_t   *ctx;
+    ngx_http_limit_req_node_t  *lr;
 
-            if (excess < 0) {
-                excess = 0;
-            }
+    now = ngx_current_msec;
 
-            *ep = excess;
+    ctx = limit->shm_zone->data;
 
-            if ((ngx_uint_t) excess > limit->burst) {
-                return NGX_BUSY;
-            }
+    lr = ngx_http_limit_req_find(ctx, hash, key);
 
-            if (account) {
-                lr->excess = excess;
+    if (lr) {
+        ngx_queue_remove(&lr->queue);
+        ngx_queue_insert_head(&ctx->sh->queue, &lr->queue);
 
-                if (ms) {
-                    lr->last = now;
-                }
+        if (ctx->window) {
+            return ngx_http_limit_req_window(limit, lr, ep);
+        }
 
-                return NGX_OK;
-            }
+        ms = (ngx_msec_int_t) (now - lr->last);
 
-            lr->count++;
+        if (ms < -60000) {
+            ms = 1;
 
-            ctx->node = lr;
+        } else if (ms < 0) {
+            ms = 0;
+        }
 
-            return NGX_AGAIN;
+        excess = lr->excess - ctx->rate * ms / 1000 + 1000;
+
+        if (excess < 0) {
+            excess = 0;
         }
 
-        node = (rc < 0) ? node->left : node->right;
+        *ep = excess;
+
+        if ((ngx_uint_t) excess > limit->burst) {
+            return NGX_BUSY;
+        }
+
+        lr->excess = excess;
+
+        if (ms) {
+            lr->last = now;
+        }
+
+        return NGX_OK;
     }
 
     *ep = 0;
 
-    size = offsetof(ngx_rbtree_node_t, color)
-           + offsetof(ngx_http_limit_req_node_t, data)
-           + key->len;
+    lr = ngx_http_limit_req_alloc(ctx, hash, key);
+    if (lr == NULL) {
+        return NGX_ERROR;
+    }
+
+    lr->last = now;
+
+    if (ctx->window) {
+        lr->excess = 1000;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_limit_req_window(ngx_http_limit_req_limit_t *limit,
+    ngx_http_limit_req_node_t *lr, ngx_uint_t *ep)
+{
+    uint64_t                   count;
+    ngx_msec_t                 now;
+    ngx_msec_int_t             ms;
+    ngx_http_limit_req_ctx_t  *ctx;
+
+    /*
+     * a sliding window counter: the requests of the current fixed window
+     * are added to those of the previous one, weighted by the part of
+     * the previous window still within the sliding window
+     */
+
+    ctx = limit->shm_zone->data;
+
+    now = ngx_current_msec;
+    ms = (ngx_msec_int_t) (now - lr->last);
+
+    if (ms < 0) {
+        ms = 0;
+    }
+
+    if ((ngx_msec_t) ms >= ctx->window) {
+        lr->prev = ((ngx_msec_t) ms < 2 * ctx->window) ? lr->excess : 0;
+        lr->excess = 0;
+
+        ms %= ctx->window;
+        lr->last = now - ms;
+    }
+
+    count = (uint64_t) lr->prev * (ctx->window - ms) / ctx->window
+            + lr->excess + 1000;
+
+    *ep = (count > ctx->quota) ? (ngx_uint_t) (count - ctx->quota) : 0;
+
+    if (*ep > limit->burst) {
+        return NGX_BUSY;
+    }
+
+    lr->excess += 1000;
+
+    return NGX_OK;
+}
+
+
+static ngx_http_limit_req_node_t *
+ngx_http_limit_req_alloc(ngx_http_limit_req_ctx_t *ctx, ngx_uint_t hash,
+    ngx_str_t *key)
+{
+    u_char                     *p;
+    size_t                      size;
+    ngx_rbtree_node_t          *node;
+    ngx_http_limit_req_node_t  *lr;
+
+    /* nodes indexed by hash are allocated without an rbtree node */
+
+    size = offsetof(ngx_http_limit_req_node_t, data) + key->len;
+
+    if (!ctx->hash) {
+        size += offsetof(ngx_rbtree_node_t, color);
+    }
 
     ngx_http_limit_req_expire(ctx, 1);
 
-    node = ngx_slab_alloc_locked(ctx->shpool, size);
+    p = ngx_slab_alloc_locked(ctx->shpool, size);
 
-    if (node == NULL) {
+    if (p == NULL) {
         ngx_http_limit_req_expire(ctx, 0);
 
-        node = ngx_slab_alloc_locked(ctx->shpool, size);
-        if (node == NULL) {
+        p = ngx_slab_alloc_locked(ctx->shpool, size);
+        if (p == NULL) {
             ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
                           "could not allocate node%s", ctx->shpool->log_ctx);
-            return NGX_ERROR;
+            return NULL;
         }
     }
 
-    node->key = hash;
+    if (ctx->hash) {
+        lr = (ngx_http_limit_req_node_t *) p;
+
+    } else {
+        node = (ngx_rbtree_node_t *) p;
+        node->key = hash;
 
-    lr = (ngx_http_limit_req_node_t *) &node->color;
+        lr = (ngx_http_limit_req_node_t *) &node->color;
+    }
 
     lr->len = (u_short) key->len;
+    lr->hash = hash;
     lr->excess = 0;
+    lr->prev = 0;
 
     ngx_memcpy(lr->data, key->data, key->len);
 
-    ngx_rbtree_insert(&ctx->sh->rbtree, node);
+    if (ctx->hash) {
+        if (ngx_shm_index_insert(&ctx->sh->index, hash, lr) != NGX_OK) {
+            ngx_http_limit_req_expire(ctx, 0);
+
+            if (ngx_shm_index_insert(&ctx->sh->index, hash, lr) != NGX_OK) {
+                ngx_slab_free_locked(ctx->shpool, p);
+                ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                              "could not index node%s", ctx->shpool->log_ctx);
+                return NULL;
+            }
+        }
+
+    } else {
+        ngx_rbtree_insert(&ctx->sh->rbtree, (ngx_rbtree_node_t *) p);
+    }
 
     ngx_queue_insert_head(&ctx->sh->queue, &lr->queue);
 
-    if (account) {
-        lr->last = now;
-        lr->count = 0;
-        return NGX_OK;
+    return lr;
+}
+
+
+static ngx_int_t
+ngx_http_limit_req_lookup_local(ngx_http_limit_req_limit_t *limit,
+    ngx_uint_t hash, ngx_str_t *key, ngx_uint_t *ep)
+{
+    ngx_int_t                         rc, excess;
+    ngx_msec_t                        now;
+    ngx_msec_int_t                    ms;
+    ngx_queue_t                      *q;
+    ngx_http_limit_req_ctx_t         *ctx;
+    ngx_http_limit_req_local_t       *local;
+    ngx_http_limit_req_local_node_t  *ln;
+
+    now = ngx_current_msec;
+
+    ctx = limit->shm_zone->data;
+    local = ctx->local;
+
+    ln = (ngx_http_limit_req_local_node_t *)
+             ngx_str_rbtree_lookup(&local->rbtree, key, hash);
+
+    if (ln) {
+        ngx_queue_remove(&ln->queue);
+
+    } else {
+
+        if (local->count >= NGX_HTTP_LIMIT_REQ_LOCAL_MAX) {
+            q = ngx_queue_last(&local->queue);
+            ngx_http_limit_req_free_local(ctx,
+                   ngx_queue_data(q, ngx_http_limit_req_local_node_t, queue));
+        }
+
+        ln = ngx_alloc(offsetof(ngx_http_limit_req_local_node_t, data)
+                       + key->len, ngx_cycle->log);
+        if (ln == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(ln->data, key->data, key->len);
+
+        ln->sn.node.key = hash;
+        ln->sn.str.len = key->len;
+        ln->sn.str.data = ln->data;
+
+        ln->last = now;
+        ln->synced = now - ctx->sync;
+        ln->excess = 0;
+        ln->pending = 0;
+
+        ngx_rbtree_insert(&local->rbtree, &ln->sn.node);
+
+        local->count++;
     }
 
-    lr->last = 0;
-    lr->count = 1;
+    ln->accessed = now;
 
-    ctx->node = lr;
+    ngx_queue_insert_head(&local->queue, &ln->queue);
 
-    return NGX_AGAIN;
+    if ((ngx_msec_int_t) (now - ln->synced) >= (ngx_msec_int_t) ctx->sync) {
+
+        /* the node is stale or new, the zone is checked for it */
+
+        ngx_shmtx_lock(&ctx->shpool->mutex);
+
+        rc = ngx_http_limit_req_sync_node(ctx, ln);
+
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+        if (rc != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    ms = (ngx_msec_int_t) (now - ln->last);
+
+    if (ms < -60000) {
+        ms = 1;
+
+    } else if (ms < 0) {
+        ms = 0;
+    }
+
+    excess = ln->excess - ctx->rate * ms / 1000 + 1000;
+
+    if (excess < 0) {
+        excess = 0;
+    }
+
+    *ep = excess;
+
+    if ((ngx_uint_t) excess > limit->burst) {
+        return NGX_BUSY;
+    }
+
+    ln->excess = excess;
+    ln->pending++;
+
+    if (ms) {
+        ln->last = now;
+    }
+
+    return NGX_OK;
 }
 
 
-static ngx_msec_t
-ngx_http_limit_req_account(ngx_http_limit_req_limit_t *limits, ngx_uint_t n,
-    ngx_uint_t *ep, ngx_http_limit_req_limit_t **limit)
+static ngx_int_t
+ngx_http_limit_req_sync_node(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_local_node_t *ln)
 {
     ngx_int_t                   excess;
-    ngx_msec_t                  now, delay, max_delay;
+    ngx_msec_t                  now;
     ngx_msec_int_t              ms;
-    ngx_http_limit_req_ctx_t   *ctx;
     ngx_http_limit_req_node_t  *lr;
 
-    excess = *ep;
+    /*
+     * the requests passed by the worker since the last synchronization
+     * are added to the zone node, and the result is copied back
+     */
 
-    if ((ngx_uint_t) excess <= (*limit)->delay) {
-        max_delay = 0;
+    now = ngx_current_msec;
 
-    } else {
-        ctx = (*limit)->shm_zone->data;
-        max_delay = (excess - (*limit)->delay) * 1000 / ctx->rate;
-    }
+    lr = ngx_http_limit_req_find(ctx, ln->sn.node.key, &ln->sn.str);
 
-    while (n--) {
-        ctx = limits[n].shm_zone->data;
-        lr = ctx->node;
+    if (lr) {
+        ngx_queue_remove(&lr->queue);
+        ngx_queue_insert_head(&ctx->sh->queue, &lr->queue);
 
+    } else if (ln->pending) {
+        lr = ngx_http_limit_req_alloc(ctx, ln->sn.node.key, &ln->sn.str);
         if (lr == NULL) {
-            continue;
+            return NGX_ERROR;
         }
 
-        ngx_shmtx_lock(&ctx->shpool->mutex);
+        lr->last = now;
+    }
 
-        now = ngx_current_msec;
-        ms = (ngx_msec_int_t) (now - lr->last);
+    if (lr == NULL) {
+        excess = 0;
+        goto done;
+    }
 
-        if (ms < -60000) {
-            ms = 1;
+    ms = (ngx_msec_int_t) (now - lr->last);
 
-        } else if (ms < 0) {
-            ms = 0;
-        }
+    if (ms < -60000) {
+        ms = 1;
 
-        excess = lr->excess - ctx->rate * ms / 1000 + 1000;
+    } else if (ms < 0) {
+        ms = 0;
+    }
 
-        if (excess < 0) {
-            excess = 0;
+    excess = lr->excess - ctx->rate * ms / 1000;
+
+    if (excess < 0) {
+        excess = 0;
+    }
+
+    excess += ln->pending * 1000;
+
+    lr->excess = excess;
+
+    if (ms) {
+        lr->last = now;
+    }
+
+done:
+
+    ln->excess = excess;
+    ln->last = now;
+    ln->synced = now;
+    ln->pending = 0;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_limit_req_sync_handler(ngx_event_t *ev)
+{
+    ngx_msec_t                        now;
+    ngx_queue_t                      *q, *next;
+    ngx_http_limit_req_ctx_t         *ctx;
+    ngx_http_limit_req_local_t       *local;
+    ngx_http_limit_req_local_node_t  *ln;
+
+    local = ev->data;
+    ctx = local->shm_zone->data;
+
+    now = ngx_current_msec;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "limit_req \"%V\" sync: %ui nodes",
+                   &local->shm_zone->shm.name, local->count);
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    /* nodes are kept in the order of access */
+
+    for (q = ngx_queue_head(&local->queue);
+         q != ngx_queue_sentinel(&local->queue);
+         q = ngx_queue_next(q))
+    {
+        ln = ngx_queue_data(q, ngx_http_limit_req_local_node_t, queue);
+
+        if ((ngx_msec_int_t) (ln->accessed - local->synced) < 0) {
+            break;
         }
 
-        if (ms) {
-            lr->last = now;
+        if (ln->pending) {
+            (void) ngx_http_limit_req_sync_node(ctx, ln);
         }
+    }
 
-        lr->excess = excess;
-        lr->count--;
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
 
-        ngx_shmtx_unlock(&ctx->shpool->mutex);
+    local->synced = now;
 
-        ctx->node = NULL;
+    /* nodes not used for a minute are freed */
 
-        if ((ngx_uint_t) excess <= limits[n].delay) {
-            continue;
-        }
+    for (q = ngx_queue_last(&local->queue);
+         q != ngx_queue_sentinel(&local->queue);
+         q = next)
+    {
+        next = ngx_queue_prev(q);
 
-        delay = (excess - limits[n].delay) * 1000 / ctx->rate;
+        ln = ngx_queue_data(q, ngx_http_limit_req_local_node_t, queue);
 
-        if (delay > max_delay) {
-            max_delay = delay;
-            *ep = excess;
-            *limit = &limits[n];
+        if ((ngx_msec_int_t) (now - ln->accessed) < 60000) {
+            break;
         }
+
+        ngx_http_limit_req_free_local(ctx, ln);
     }
 
-    return max_delay;
+    if (ngx_exiting) {
+        return;
+    }
+
+    ngx_add_timer(ev, ctx->sync);
 }
 
 
 static void
-ngx_http_limit_req_unlock(ngx_http_limit_req_limit_t *limits, ngx_uint_t n)
+ngx_http_limit_req_free_local(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_local_node_t *ln)
 {
-    ngx_http_limit_req_ctx_t  *ctx;
+    if (ln->pending) {
+        ngx_shmtx_lock(&ctx->shpool->mutex);
+        (void) ngx_http_limit_req_sync_node(ctx, ln);
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+    }
+
+    ngx_queue_remove(&ln->queue);
+    ngx_rbtree_delete(&ctx->local->rbtree, &ln->sn.node);
+
+    ctx->local->count--;
+
+    ngx_free(ln);
+}
+
+
+static void
+ngx_http_limit_req_rollback(ngx_http_request_t *r,
+    ngx_http_limit_req_limit_t *limits, ngx_uint_t n)
+{
+    uint32_t                          hash;
+    ngx_str_t                         key;
+    ngx_http_limit_req_ctx_t         *ctx;
+    ngx_http_limit_req_node_t        *lr;
+    ngx_http_limit_req_local_node_t  *ln;
 
     while (n--) {
         ctx = limits[n].shm_zone->data;
 
-        if (ctx->node == NULL) {
+        if (ngx_http_complex_value(r, &ctx->key, &key) != NGX_OK
+            || key.len == 0
+            || key.len > 65535)
+        {
+            continue;
+        }
+
+        hash = ngx_crc32c(key.data, key.len);
+
+        if (ctx->local) {
+            ln = (ngx_http_limit_req_local_node_t *)
+                     ngx_str_rbtree_lookup(&ctx->local->rbtree, &key, hash);
+
+            if (ln && ln->pending) {
+                ln->pending--;
+                ln->excess = (ln->excess > 1000) ? ln->excess - 1000 : 0;
+            }
+
             continue;
         }
 
         ngx_shmtx_lock(&ctx->shpool->mutex);
 
-        ctx->node->count--;
+        lr = ngx_http_limit_req_find(ctx, hash, &key);
+
+        if (lr) {
+            lr->excess = (lr->excess > 1000) ? lr->excess - 1000 : 0;
+        }
 
         ngx_shmtx_unlock(&ctx->shpool->mutex);
+    }
+}
+
 
-        ctx->node = NULL;
+static ngx_uint_t
+ngx_http_limit_req_stale(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_node_t *lr, ngx_msec_int_t ms)
+{
+    ngx_int_t  excess;
+
+    if (ms < 60000) {
+        return 0;
     }
+
+    if (ctx->window) {
+        return (ngx_msec_t) ms >= 2 * ctx->window;
+    }
+
+    excess = lr->excess - ctx->rate * ms / 1000;
+
+    return excess <= 0;
 }
 
 
 static void
 ngx_http_limit_req_expire(ngx_http_limit_req_ctx_t *ctx, ngx_uint_t n)
 {
-    ngx_int_t                   excess;
     ngx_msec_t                  now;
     ngx_queue_t                *q;
     ngx_msec_int_t              ms;
-    ngx_rbtree_node_t          *node;
     ngx_http_limit_req_node_t  *lr;
 
     now = ngx_current_msec;
@@ -657,41 +1080,86 @@ ngx_http_limit_req_expire(ngx_http_limit_req_ctx_t *ctx, ngx_uint_t n)
 
         lr = ngx_queue_data(q, ngx_http_limit_req_node_t, queue);
 
-        if (lr->count) {
-
-            /*
-             * There is not much sense in looking further,
-             * because we bump nodes on the lookup stage.
-             */
-
-            return;
-        }
-
         if (n++ != 0) {
 
             ms = (ngx_msec_int_t) (now - lr->last);
             ms = ngx_abs(ms);
 
-            if (ms < 60000) {
+            if (!ngx_http_limit_req_stale(ctx, lr, ms)) {
                 return;
             }
+        }
 
-            excess = lr->excess - ctx->rate * ms / 1000;
+        ngx_http_limit_req_delete(ctx, lr);
+    }
+}
 
-            if (excess > 0) {
-                return;
-            }
-        }
 
-        ngx_queue_remove(q);
+static void
+ngx_http_limit_req_delete(ngx_http_limit_req_ctx_t *ctx,
+    ngx_http_limit_req_node_t *lr)
+{
+    ngx_rbtree_node_t  *node;
+
+    ngx_queue_remove(&lr->queue);
+
+    if (ctx->hash) {
+        ngx_shm_index_delete(&ctx->sh->index, lr->hash, lr);
+        ngx_slab_free_locked(ctx->shpool, lr);
+        return;
+    }
+
+    node = (ngx_rbtree_node_t *)
+               ((u_char *) lr - offsetof(ngx_rbtree_node_t, color));
+
+    ngx_rbtree_delete(&ctx->sh->rbtree, node);
+
+    ngx_slab_free_locked(ctx->shpool, node);
+}
 
-        node = (ngx_rbtree_node_t *)
-                   ((u_char *) lr - offsetof(ngx_rbtree_node_t, color));
 
-        ngx_rbtree_delete(&ctx->sh->rbtree, node);
+static void
+ngx_http_limit_req_defrag(ngx_shm_zone_t *shm_zone)
+{
+    ngx_msec_t                  now;
+    ngx_uint_t                  n;
+    ngx_queue_t                *q;
+    ngx_msec_int_t              ms;
+    ngx_http_limit_req_ctx_t   *ctx;
+    ngx_http_limit_req_node_t  *lr;
+
+    /* all stale entries are deleted, not only the ones seen on lookups */
+
+    ctx = shm_zone->data;
+
+    now = ngx_current_msec;
+    n = 0;
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    while (!ngx_queue_empty(&ctx->sh->queue)) {
+
+        q = ngx_queue_last(&ctx->sh->queue);
+
+        lr = ngx_queue_data(q, ngx_http_limit_req_node_t, queue);
+
+        ms = (ngx_msec_int_t) (now - lr->last);
+        ms = ngx_abs(ms);
 
-        ngx_slab_free_locked(ctx->shpool, node);
+        if (!ngx_http_limit_req_stale(ctx, lr, ms)) {
+            break;
+        }
+
+        ngx_http_limit_req_delete(ctx, lr);
+
+        n++;
     }
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "limit_req \"%V\" defrag: %ui entries deleted",
+                   &shm_zone->shm.name, n);
 }
 
 
@@ -719,6 +1187,13 @@ ngx_http_limit_req_init_zone(ngx_shm_zone_t *shm_zone, void *data)
             return NGX_ERROR;
         }
 
+        if (ctx->hash != octx->hash) {
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "limit_req \"%V\" index cannot be changed",
+                          &shm_zone->shm.name);
+            return NGX_ERROR;
+        }
+
         ctx->sh = octx->sh;
         ctx->shpool = octx->shpool;
 
@@ -745,6 +1220,12 @@ ngx_http_limit_req_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 
     ngx_queue_init(&ctx->sh->queue);
 
+    if (ctx->hash
+        && ngx_shm_index_init(&ctx->sh->index, ctx->shpool, 0) != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
     len = sizeof(" in limit_req zone \"\"") + shm_zone->shm.name.len;
 
     ctx->shpool->log_ctx = ngx_slab_alloc(ctx->shpool, len);
@@ -837,7 +1318,7 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ssize_t                            size;
     ngx_str_t                         *value, name, s;
     ngx_int_t                          rate, scale;
-    ngx_uint_t                         i;
+    ngx_uint_t                         i, hugepages;
     ngx_shm_zone_t                    *shm_zone;
     ngx_http_limit_req_ctx_t          *ctx;
     ngx_http_compile_complex_value_t   ccv;
@@ -862,10 +1343,33 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     size = 0;
     rate = 1;
     scale = 1;
+    hugepages = 0;
     name.len = 0;
 
     for (i = 2; i < cf->args->nelts; i++) {
 
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            hugepages = 1;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "index=", 6) == 0) {
+
+            if (ngx_strcmp(&value[i].data[6], "hash") == 0) {
+                ctx->hash = 1;
+
+            } else if (ngx_strcmp(&value[i].data[6], "rbtree") == 0) {
+                ctx->hash = 0;
+
+            } else {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid index \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         if (ngx_strncmp(value[i].data, "zone=", 5) == 0) {
 
             name.data = value[i].data + 5;
@@ -900,6 +1404,37 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "window=", 7) == 0) {
+
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            ctx->window = ngx_parse_time(&s, 0);
+            if (ctx->window == (ngx_msec_t) NGX_ERROR || ctx->window == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid window \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "sync=", 5) == 0) {
+
+            s.len = value[i].len - 5;
+            s.data = value[i].data + 5;
+
+            ctx->sync = ngx_parse_time(&s, 0);
+            if (ctx->sync == (ngx_msec_t) NGX_ERROR || ctx->sync == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid sync interval \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         if (ngx_strncmp(value[i].data, "rate=", 5) == 0) {
 
             len = value[i].len;
@@ -938,6 +1473,18 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     ctx->rate = rate * 1000 / scale;
 
+    if (ctx->window) {
+
+        if (ctx->sync) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"window\" and \"sync\" parameters "
+                               "cannot be used together");
+            return NGX_CONF_ERROR;
+        }
+
+        ctx->quota = (uint64_t) rate * ctx->window / scale;
+    }
+
     shm_zone = ngx_shared_memory_add(cf, &name, size,
                                      &ngx_http_limit_req_module);
     if (shm_zone == NULL) {
@@ -954,7 +1501,9 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     shm_zone->init = ngx_http_limit_req_init_zone;
+    shm_zone->defrag = ngx_http_limit_req_defrag;
     shm_zone->data = ctx;
+    shm_zone->shm.hugepages = hugepages;
 
     return NGX_CONF_OK;
 }
@@ -1100,3 +1649,56 @@ ngx_http_limit_req_init(ngx_conf_t *cf)
 
     return NGX_OK;
 }
+
+
+static ngx_int_t
+ngx_http_limit_req_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                   i;
+    ngx_shm_zone_t              *shm_zone;
+    ngx_list_part_t             *part;
+    ngx_http_limit_req_ctx_t    *ctx;
+    ngx_http_limit_req_local_t  *local;
+
+    for (part = &cycle->shared_memory.part; part; part = part->next) {
+        shm_zone = part->elts;
+
+        for (i = 0; i < part->nelts; i++) {
+
+            if (shm_zone[i].tag != &ngx_http_limit_req_module) {
+                continue;
+            }
+
+            ctx = shm_zone[i].data;
+
+            if (ctx->sync == 0) {
+                continue;
+            }
+
+            local = ngx_pcalloc(cycle->pool,
+                                sizeof(ngx_http_limit_req_local_t));
+            if (local == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_rbtree_init(&local->rbtree, &local->sentinel,
+                            ngx_str_rbtree_insert_value);
+
+            ngx_queue_init(&local->queue);
+
+            local->synced = ngx_current_msec;
+            local->shm_zone = &shm_zone[i];
+
+            local->event.handler = ngx_http_limit_req_sync_handler;
+            local->event.data = local;
+            local->event.log = cycle->log;
+            local->event.cancelable = 1;
+
+            ngx_add_timer(&local->event, ctx->sync);
+
+            ctx->local = local;
+        }
+    }
+
+    return NGX_OK;
+}
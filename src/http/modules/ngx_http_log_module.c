@@ -26,6 +26,7 @@ typedef size_t (*ngx_http_log_op_getlen_pt) (ngx_http_request_t *r,
 struct ngx_http_log_op_s {
     size_t                      len;
     ngx_http_log_op_getlen_pt   getlen;
+    ngx_http_log_op_getlen_pt   maxlen;
     ngx_http_log_op_run_pt      run;
     uintptr_t                   data;
 };
@@ -52,23 +53,55 @@ typedef struct {
     ngx_event_t                *event;
     ngx_msec_t                  flush;
     ngx_int_t                   gzip;
+
+#if (NGX_THREADS)
+    ngx_thread_pool_t          *thread_pool;
+    ngx_thread_task_t          *free;
+    ngx_uint_t                  tasks;
+    ngx_uint_t                  queue;
+    ngx_uint_t                  drop;       /* unsigned  drop:1 */
+#endif
 } ngx_http_log_buf_t;
 
 
+#if (NGX_THREADS)
+
+typedef struct {
+    ngx_open_file_t            *file;
+    u_char                     *start;
+    size_t                      len;
+    ngx_fd_t                    fd;
+    ngx_int_t                   gzip;
+    ssize_t                     n;
+    ngx_err_t                   err;
+} ngx_http_log_thread_ctx_t;
+
+#endif
+
+
 typedef struct {
     ngx_array_t                *lengths;
     ngx_array_t                *values;
 } ngx_http_log_script_t;
 
 
+typedef struct {
+    ngx_uint_t                  low;
+    ngx_uint_t                  high;
+    ngx_uint_t                  rate;       /* in 1/10000 */
+} ngx_http_log_sample_t;
+
+
 typedef struct {
     ngx_open_file_t            *file;
     ngx_http_log_script_t      *script;
     time_t                      disk_full_time;
     time_t                      error_log_time;
     ngx_syslog_peer_t          *syslog_peer;
+    ngx_log_ring_t             *ring;
     ngx_http_log_fmt_t         *format;
     ngx_http_complex_value_t   *filter;
+    ngx_array_t                *sample;     /* of ngx_http_log_sample_t */
 } ngx_http_log_t;
 
 
@@ -95,6 +128,10 @@ typedef struct {
 #define NGX_HTTP_LOG_ESCAPE_NONE     2
 
 
+static ngx_uint_t ngx_http_log_sampled(ngx_http_request_t *r,
+    ngx_array_t *sample);
+static ngx_int_t ngx_http_log_buffered(ngx_http_request_t *r,
+    ngx_http_log_t *log, ngx_http_log_buf_t *buffer);
 static void ngx_http_log_write(ngx_http_request_t *r, ngx_http_log_t *log,
     u_char *buf, size_t len);
 static ssize_t ngx_http_log_script_write(ngx_http_request_t *r,
@@ -111,6 +148,13 @@ static void ngx_http_log_gzip_free(void *opaque, void *address);
 static void ngx_http_log_flush(ngx_open_file_t *file, ngx_log_t *log);
 static void ngx_http_log_flush_handler(ngx_event_t *ev);
 
+#if (NGX_THREADS)
+static ngx_int_t ngx_http_log_thread_flush(ngx_open_file_t *file,
+    ngx_log_t *log);
+static void ngx_http_log_thread_handler(void *data, ngx_log_t *log);
+static void ngx_http_log_thread_event_handler(ngx_event_t *ev);
+#endif
+
 static u_char *ngx_http_log_pipe(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op);
 static u_char *ngx_http_log_time(ngx_http_request_t *r, u_char *buf,
@@ -134,11 +178,15 @@ static ngx_int_t ngx_http_log_variable_compile(ngx_conf_t *cf,
     ngx_http_log_op_t *op, ngx_str_t *value, ngx_uint_t escape);
 static size_t ngx_http_log_variable_getlen(ngx_http_request_t *r,
     uintptr_t data);
+static size_t ngx_http_log_variable_maxlen(ngx_http_request_t *r,
+    uintptr_t data);
 static u_char *ngx_http_log_variable(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op);
 static uintptr_t ngx_http_log_escape(u_char *dst, u_char *src, size_t size);
 static size_t ngx_http_log_json_variable_getlen(ngx_http_request_t *r,
     uintptr_t data);
+static size_t ngx_http_log_json_variable_maxlen(ngx_http_request_t *r,
+    uintptr_t data);
 static u_char *ngx_http_log_json_variable(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op);
 static size_t ngx_http_log_unescaped_variable_getlen(ngx_http_request_t *r,
@@ -153,6 +201,8 @@ static char *ngx_http_log_merge_loc_conf(ngx_conf_t *cf, void *parent,
     void *child);
 static char *ngx_http_log_set_log(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_log_set_sample(ngx_conf_t *cf, ngx_http_log_t *log,
+    ngx_str_t *value);
 static char *ngx_http_log_set_format(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_log_compile_format(ngx_conf_t *cf,
@@ -237,7 +287,7 @@ static ngx_http_log_var_t  ngx_http_log_vars[] = {
     { ngx_string("time_iso8601"), sizeof("1970-09-28T12:00:00+06:00") - 1,
                           ngx_http_log_iso8601 },
     { ngx_string("msec"), NGX_TIME_T_LEN + 4, ngx_http_log_msec },
-    { ngx_string("request_time"), NGX_TIME_T_LEN + 4,
+    { ngx_string("request_time"), NGX_TIME_T_LEN + 7,
                           ngx_http_log_request_time },
     { ngx_string("status"), NGX_INT_T_LEN, ngx_http_log_status },
     { ngx_string("bytes_sent"), NGX_OFF_T_LEN, ngx_http_log_bytes_sent },
@@ -259,6 +309,7 @@ ngx_http_log_handler(ngx_http_request_t *r)
     ngx_str_t                 val;
     ngx_uint_t                i, l;
     ngx_http_log_t           *log;
+    ngx_atomic_uint_t         pos;
     ngx_http_log_op_t        *op;
     ngx_http_log_buf_t       *buffer;
     ngx_http_log_loc_conf_t  *lcf;
@@ -275,6 +326,10 @@ ngx_http_log_handler(ngx_http_request_t *r)
     log = lcf->logs->elts;
     for (l = 0; l < lcf->logs->nelts; l++) {
 
+        if (log[l].sample && !ngx_http_log_sampled(r, log[l].sample)) {
+            continue;
+        }
+
         if (log[l].filter) {
             if (ngx_http_complex_value(r, log[l].filter, &val) != NGX_OK) {
                 return NGX_ERROR;
@@ -298,6 +353,16 @@ ngx_http_log_handler(ngx_http_request_t *r)
 
         ngx_http_script_flush_no_cacheable_variables(r, log[l].format->flushes);
 
+        buffer = log[l].file ? log[l].file->data : NULL;
+
+        if (buffer) {
+            if (ngx_http_log_buffered(r, &log[l], buffer) != NGX_OK) {
+                return NGX_ERROR;
+            }
+
+            continue;
+        }
+
         len = 0;
         op = log[l].format->ops->elts;
         for (i = 0; i < log[l].format->ops->nelts; i++) {
@@ -319,44 +384,26 @@ ngx_http_log_handler(ngx_http_request_t *r)
             goto alloc_line;
         }
 
-        len += NGX_LINEFEED_SIZE;
-
-        buffer = log[l].file ? log[l].file->data : NULL;
-
-        if (buffer) {
-
-            if (len > (size_t) (buffer->last - buffer->pos)) {
+        if (log[l].ring) {
 
-                ngx_http_log_write(r, &log[l], buffer->start,
-                                   buffer->pos - buffer->start);
-
-                buffer->pos = buffer->start;
+            line = ngx_log_ring_reserve(log[l].ring, len, &pos);
+            if (line == NULL) {
+                continue;
             }
 
-            if (len <= (size_t) (buffer->last - buffer->pos)) {
-
-                p = buffer->pos;
-
-                if (buffer->event && p == buffer->start) {
-                    ngx_add_timer(buffer->event, buffer->flush);
-                }
-
-                for (i = 0; i < log[l].format->ops->nelts; i++) {
-                    p = op[i].run(r, p, &op[i]);
-                }
-
-                ngx_linefeed(p);
-
-                buffer->pos = p;
+            p = line;
 
-                continue;
+            for (i = 0; i < log[l].format->ops->nelts; i++) {
+                p = op[i].run(r, p, &op[i]);
             }
 
-            if (buffer->event && buffer->event->timer_set) {
-                ngx_del_timer(buffer->event);
-            }
+            ngx_log_ring_commit(log[l].ring, pos, p - line);
+
+            continue;
         }
 
+        len += NGX_LINEFEED_SIZE;
+
     alloc_line:
 
         line = ngx_pnalloc(r->pool, len);
@@ -402,6 +449,153 @@ ngx_http_log_handler(ngx_http_request_t *r)
 }
 
 
+static ngx_int_t
+ngx_http_log_buffered(ngx_http_request_t *r, ngx_http_log_t *log,
+    ngx_http_log_buf_t *buffer)
+{
+    u_char             *line, *p, *last;
+    size_t              len, n;
+    ngx_uint_t          i, k;
+    ngx_http_log_op_t  *op;
+
+    /*
+     * the line is formatted in a single pass directly into the buffer,
+     * and each field is sized just before it is written; for escaped
+     * variables the worst case length is tried first, so the value is
+     * not scanned twice as long as it fits
+     */
+
+    op = log->format->ops->elts;
+
+    line = buffer->pos;
+    last = buffer->last;
+
+    p = line;
+
+    for (i = 0; i < log->format->ops->nelts; i++) {
+
+        if (op[i].len) {
+            n = op[i].len;
+
+        } else if (op[i].maxlen == NULL
+                   || (n = op[i].maxlen(r, op[i].data)) > (size_t) (last - p))
+        {
+            n = op[i].getlen(r, op[i].data);
+        }
+
+        if (n > (size_t) (last - p)) {
+            goto spill;
+        }
+
+        p = op[i].run(r, p, &op[i]);
+    }
+
+    if (NGX_LINEFEED_SIZE <= last - p) {
+
+        if (buffer->event && line == buffer->start) {
+            ngx_add_timer(buffer->event, buffer->flush);
+        }
+
+        ngx_linefeed(p);
+
+        buffer->pos = p;
+
+        return NGX_OK;
+    }
+
+spill:
+
+    /* the rest of the line does not fit, use a continuation buffer */
+
+    len = (p - line) + NGX_LINEFEED_SIZE;
+
+    for (k = i; k < log->format->ops->nelts; k++) {
+        len += op[k].len ? op[k].len : op[k].getlen(r, op[k].data);
+    }
+
+    line = ngx_pnalloc(r->pool, len);
+    if (line == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = ngx_cpymem(line, buffer->pos, p - buffer->pos);
+
+    for (k = i; k < log->format->ops->nelts; k++) {
+        p = op[k].run(r, p, &op[k]);
+    }
+
+    ngx_linefeed(p);
+
+    len = p - line;
+
+    if (buffer->pos != buffer->start) {
+
+#if (NGX_THREADS)
+        if (buffer->thread_pool == NULL
+            || ngx_http_log_thread_flush(log->file, r->connection->log)
+               != NGX_OK)
+#endif
+        {
+            ngx_http_log_write(r, log, buffer->start,
+                               buffer->pos - buffer->start);
+
+            buffer->pos = buffer->start;
+        }
+    }
+
+    if (len <= (size_t) (buffer->last - buffer->pos)) {
+
+        if (buffer->event && buffer->pos == buffer->start) {
+            ngx_add_timer(buffer->event, buffer->flush);
+        }
+
+        buffer->pos = ngx_cpymem(buffer->pos, line, len);
+
+        return NGX_OK;
+    }
+
+    if (buffer->event && buffer->event->timer_set) {
+        ngx_del_timer(buffer->event);
+    }
+
+    ngx_http_log_write(r, log, line, len);
+
+    return NGX_OK;
+}
+
+
+static ngx_uint_t
+ngx_http_log_sampled(ngx_http_request_t *r, ngx_array_t *sample)
+{
+    ngx_uint_t              i, status;
+    ngx_http_log_sample_t  *ls;
+
+    if (r->err_status) {
+        status = r->err_status;
+
+    } else if (r->headers_out.status) {
+        status = r->headers_out.status;
+
+    } else {
+        status = 0;
+    }
+
+    ls = sample->elts;
+
+    for (i = 0; i < sample->nelts; i++) {
+        if (status >= ls[i].low && status <= ls[i].high) {
+            break;
+        }
+    }
+
+    if (i == sample->nelts || ls[i].rate == 10000) {
+        return 1;
+    }
+
+    return (ngx_uint_t) ngx_random() % 10000 < ls[i].rate;
+}
+
+
 static void
 ngx_http_log_write(ngx_http_request_t *r, ngx_http_log_t *log, u_char *buf,
     size_t len)
@@ -762,13 +956,197 @@ ngx_http_log_flush(ngx_open_file_t *file, ngx_log_t *log)
 static void
 ngx_http_log_flush_handler(ngx_event_t *ev)
 {
+#if (NGX_THREADS)
+    ngx_open_file_t     *file;
+    ngx_http_log_buf_t  *buffer;
+#endif
+
     ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ev->log, 0,
                    "http log buffer flush handler");
 
+#if (NGX_THREADS)
+
+    file = ev->data;
+    buffer = file->data;
+
+    if (buffer->thread_pool
+        && ngx_http_log_thread_flush(file, ev->log) == NGX_OK)
+    {
+        return;
+    }
+
+#endif
+
     ngx_http_log_flush(ev->data, ev->log);
 }
 
 
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_http_log_thread_flush(ngx_open_file_t *file, ngx_log_t *log)
+{
+    u_char                     *p;
+    size_t                      len, size;
+    ngx_fd_t                    fd;
+    ngx_thread_task_t          *task;
+    ngx_http_log_buf_t         *buffer;
+    ngx_http_log_thread_ctx_t  *ctx;
+
+    buffer = file->data;
+
+    len = buffer->pos - buffer->start;
+    size = buffer->last - buffer->start;
+
+    if (len == 0) {
+        return NGX_OK;
+    }
+
+    task = buffer->free;
+
+    if (task) {
+        buffer->free = task->next;
+
+    } else if (buffer->tasks < buffer->queue) {
+
+        /* each task owns a spare buffer which is swapped with the full one */
+
+        task = ngx_thread_task_alloc(ngx_cycle->pool,
+                                     sizeof(ngx_http_log_thread_ctx_t) + size);
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        ctx = task->ctx;
+
+        ctx->file = file;
+        ctx->start = (u_char *) ctx + sizeof(ngx_http_log_thread_ctx_t);
+        ctx->gzip = buffer->gzip;
+
+        task->handler = ngx_http_log_thread_handler;
+        task->event.data = task;
+        task->event.handler = ngx_http_log_thread_event_handler;
+        task->event.log = ngx_cycle->log;
+
+        buffer->tasks++;
+
+    } else if (buffer->drop) {
+        ngx_log_error(NGX_LOG_WARN, log, 0,
+                      "aio queue of access log \"%s\" is full, "
+                      "%uz bytes dropped", file->name.data, len);
+        goto done;
+
+    } else {
+        return NGX_DECLINED;
+    }
+
+    /*
+     * the descriptor is duplicated, so the file can be safely
+     * reopened while the task is in progress
+     */
+
+    fd = dup(file->fd);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "dup() \"%s\" failed", file->name.data);
+        goto failed;
+    }
+
+    ctx = task->ctx;
+
+    p = ctx->start;
+
+    ctx->start = buffer->start;
+    ctx->len = len;
+    ctx->fd = fd;
+
+    if (ngx_thread_task_post(buffer->thread_pool, task) != NGX_OK) {
+        ctx->start = p;
+        (void) ngx_close_file(fd);
+        goto failed;
+    }
+
+    buffer->start = p;
+    buffer->last = p + size;
+
+done:
+
+    buffer->pos = buffer->start;
+
+    if (buffer->event && buffer->event->timer_set) {
+        ngx_del_timer(buffer->event);
+    }
+
+    return NGX_OK;
+
+failed:
+
+    task->next = buffer->free;
+    buffer->free = task;
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_http_log_thread_handler(void *data, ngx_log_t *log)
+{
+    ngx_http_log_thread_ctx_t *ctx = data;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
+                   "http log thread handler: %uz", ctx->len);
+
+#if (NGX_ZLIB)
+    if (ctx->gzip) {
+        ctx->n = ngx_http_log_gzip(ctx->fd, ctx->start, ctx->len, ctx->gzip,
+                                   log);
+    } else {
+        ctx->n = ngx_write_fd(ctx->fd, ctx->start, ctx->len);
+    }
+#else
+    ctx->n = ngx_write_fd(ctx->fd, ctx->start, ctx->len);
+#endif
+
+    ctx->err = (ctx->n == -1) ? ngx_errno : 0;
+
+    (void) ngx_close_file(ctx->fd);
+}
+
+
+static void
+ngx_http_log_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_thread_task_t          *task;
+    ngx_http_log_buf_t         *buffer;
+    ngx_http_log_thread_ctx_t  *ctx;
+
+    task = ev->data;
+    ctx = task->ctx;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "http log thread: %z", ctx->n);
+
+    if (ctx->n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, ctx->err,
+                      ngx_write_fd_n " to \"%s\" failed",
+                      ctx->file->name.data);
+
+    } else if ((size_t) ctx->n != ctx->len) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, 0,
+                      ngx_write_fd_n " to \"%s\" was incomplete: %z of %uz",
+                      ctx->file->name.data, ctx->n, ctx->len);
+    }
+
+    buffer = ctx->file->data;
+
+    task->next = buffer->free;
+    buffer->free = task;
+}
+
+#endif
+
+
 static u_char *
 ngx_http_log_copy_short(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op)
@@ -838,9 +1216,17 @@ static u_char *
 ngx_http_log_request_time(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op)
 {
+    uint64_t         us;
     ngx_time_t      *tp;
     ngx_msec_int_t   ms;
 
+    if (r->start_usec) {
+        us = ngx_monotonic_usec() - r->start_usec;
+
+        return ngx_sprintf(buf, "%T.%06uL",
+                           (time_t) (us / 1000000), us % 1000000);
+    }
+
     tp = ngx_timeofday();
 
     ms = (ngx_msec_int_t)
@@ -928,16 +1314,19 @@ ngx_http_log_variable_compile(ngx_conf_t *cf, ngx_http_log_op_t *op,
     switch (escape) {
     case NGX_HTTP_LOG_ESCAPE_JSON:
         op->getlen = ngx_http_log_json_variable_getlen;
+        op->maxlen = ngx_http_log_json_variable_maxlen;
         op->run = ngx_http_log_json_variable;
         break;
 
     case NGX_HTTP_LOG_ESCAPE_NONE:
         op->getlen = ngx_http_log_unescaped_variable_getlen;
+        op->maxlen = NULL;
         op->run = ngx_http_log_unescaped_variable;
         break;
 
     default: /* NGX_HTTP_LOG_ESCAPE_DEFAULT */
         op->getlen = ngx_http_log_variable_getlen;
+        op->maxlen = ngx_http_log_variable_maxlen;
         op->run = ngx_http_log_variable;
     }
 
@@ -967,6 +1356,25 @@ ngx_http_log_variable_getlen(ngx_http_request_t *r, uintptr_t data)
 }
 
 
+static size_t
+ngx_http_log_variable_maxlen(ngx_http_request_t *r, uintptr_t data)
+{
+    ngx_http_variable_value_t  *value;
+
+    value = ngx_http_get_indexed_variable(r, data);
+
+    if (value == NULL || value->not_found) {
+        return 1;
+    }
+
+    /* all characters may be escaped as "\xXX" */
+
+    value->escape = 1;
+
+    return value->len * 4;
+}
+
+
 static u_char *
 ngx_http_log_variable(ngx_http_request_t *r, u_char *buf, ngx_http_log_op_t *op)
 {
@@ -1068,6 +1476,25 @@ ngx_http_log_json_variable_getlen(ngx_http_request_t *r, uintptr_t data)
 }
 
 
+static size_t
+ngx_http_log_json_variable_maxlen(ngx_http_request_t *r, uintptr_t data)
+{
+    ngx_http_variable_value_t  *value;
+
+    value = ngx_http_get_indexed_variable(r, data);
+
+    if (value == NULL || value->not_found) {
+        return 0;
+    }
+
+    /* control characters are escaped as "\u00XX" */
+
+    value->escape = 1;
+
+    return value->len * 6;
+}
+
+
 static u_char *
 ngx_http_log_json_variable(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op)
@@ -1244,6 +1671,11 @@ ngx_http_log_set_log(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ngx_uint_t                         i, n;
     ngx_msec_t                         flush;
     ngx_str_t                         *value, name, s;
+#if (NGX_THREADS)
+    ngx_int_t                          queue;
+    ngx_uint_t                         drop;
+    ngx_thread_pool_t                 *tp;
+#endif
     ngx_http_log_t                    *log;
     ngx_syslog_peer_t                 *peer;
     ngx_http_log_buf_t                *buffer;
@@ -1298,6 +1730,16 @@ ngx_http_log_set_log(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         goto process_formats;
     }
 
+    if (ngx_strncmp(value[1].data, "shm:", 4) == 0) {
+
+        log->ring = ngx_log_ring_process_conf(cf, &value[1]);
+        if (log->ring == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        goto process_formats;
+    }
+
     n = ngx_http_script_variables_count(&value[1]);
 
     if (n == 0) {
@@ -1365,6 +1807,12 @@ process_formats:
     flush = 0;
     gzip = 0;
 
+#if (NGX_THREADS)
+    tp = NULL;
+    queue = 4;
+    drop = 0;
+#endif
+
     for (i = 3; i < cf->args->nelts; i++) {
 
         if (ngx_strncmp(value[i].data, "buffer=", 7) == 0) {
@@ -1430,6 +1878,74 @@ process_formats:
 #endif
         }
 
+        if (ngx_strncmp(value[i].data, "aio=", 4) == 0) {
+#if (NGX_THREADS)
+            s.len = value[i].len - 4;
+            s.data = value[i].data + 4;
+
+            if (s.len >= 7 && ngx_strncmp(s.data, "threads", 7) == 0
+                && (s.len == 7 || s.data[7] == ':'))
+            {
+                if (s.len == 7) {
+                    tp = ngx_thread_pool_add(cf, NULL);
+
+                } else {
+                    s.len -= 8;
+                    s.data += 8;
+
+                    tp = ngx_thread_pool_add(cf, &s);
+                }
+
+                if (tp == NULL) {
+                    return NGX_CONF_ERROR;
+                }
+
+                if (size == 0) {
+                    size = 64 * 1024;
+                }
+
+                continue;
+            }
+
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid aio \"%V\"", &s);
+            return NGX_CONF_ERROR;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"aio\" requires threads support, "
+                               "use the \"--with-threads\" "
+                               "configuration parameter");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
+#if (NGX_THREADS)
+
+        if (ngx_strncmp(value[i].data, "aio_queue=", 10) == 0) {
+            queue = ngx_atoi(value[i].data + 10, value[i].len - 10);
+
+            if (queue == NGX_ERROR || queue == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid aio queue size \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "aio_overflow=drop") == 0) {
+            drop = 1;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "aio_overflow=block") == 0) {
+            drop = 0;
+            continue;
+        }
+
+#endif
+
         if (ngx_strncmp(value[i].data, "if=", 3) == 0) {
             s.len = value[i].len - 3;
             s.data = value[i].data + 3;
@@ -1453,6 +1969,17 @@ process_formats:
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "sample=", 7) == 0) {
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            if (ngx_http_log_set_sample(cf, log, &s) != NGX_CONF_OK) {
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                            "invalid parameter \"%V\"", &value[i]);
         return NGX_CONF_ERROR;
@@ -1479,12 +2006,24 @@ process_formats:
             return NGX_CONF_ERROR;
         }
 
+        if (log->ring) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "logs to shared memory cannot be buffered");
+            return NGX_CONF_ERROR;
+        }
+
         if (log->file->data) {
             buffer = log->file->data;
 
             if (buffer->last - buffer->start != size
                 || buffer->flush != flush
-                || buffer->gzip != gzip)
+                || buffer->gzip != gzip
+#if (NGX_THREADS)
+                || buffer->thread_pool != tp
+                || (tp && (buffer->queue != (ngx_uint_t) queue
+                           || buffer->drop != drop))
+#endif
+               )
             {
                 ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                                    "access_log \"%V\" already defined "
@@ -1525,6 +2064,12 @@ process_formats:
 
         buffer->gzip = gzip;
 
+#if (NGX_THREADS)
+        buffer->thread_pool = tp;
+        buffer->queue = queue;
+        buffer->drop = drop;
+#endif
+
         log->file->flush = ngx_http_log_flush;
         log->file->data = buffer;
     }
@@ -1533,6 +2078,110 @@ process_formats:
 }
 
 
+static char *
+ngx_http_log_set_sample(ngx_conf_t *cf, ngx_http_log_t *log, ngx_str_t *value)
+{
+    u_char                 *p, *last, *colon, *end;
+    ngx_int_t               n;
+    ngx_str_t               s;
+    ngx_uint_t              rate, dflt;
+    ngx_http_log_sample_t  *ls;
+
+    if (log->sample) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate sample parameter \"%V\"", value);
+        return NGX_CONF_ERROR;
+    }
+
+    log->sample = ngx_array_create(cf->pool, 4,
+                                   sizeof(ngx_http_log_sample_t));
+    if (log->sample == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    dflt = 10000;
+
+    p = value->data;
+    last = value->data + value->len;
+
+    while (p < last) {
+
+        end = ngx_strlchr(p, last, ',');
+        if (end == NULL) {
+            end = last;
+        }
+
+        colon = ngx_strlchr(p, end, ':');
+
+        s.data = colon ? colon + 1 : p;
+        s.len = end - s.data;
+
+        if (s.len < 2 || s.data[s.len - 1] != '%') {
+            goto invalid;
+        }
+
+        n = ngx_atofp(s.data, s.len - 1, 2);
+
+        if (n == NGX_ERROR || n > 10000) {
+            goto invalid;
+        }
+
+        rate = n;
+
+        if (colon == NULL) {
+            dflt = rate;
+            p = end + 1;
+            continue;
+        }
+
+        ls = ngx_array_push(log->sample);
+        if (ls == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        ls->rate = rate;
+
+        if (colon - p == 3 && p[1] == 'x' && p[2] == 'x'
+            && p[0] >= '1' && p[0] <= '5')
+        {
+            ls->low = (p[0] - '0') * 100;
+            ls->high = ls->low + 99;
+
+        } else {
+            n = ngx_atoi(p, colon - p);
+
+            if (n < 100 || n > 599) {
+                goto invalid;
+            }
+
+            ls->low = n;
+            ls->high = n;
+        }
+
+        p = end + 1;
+    }
+
+    /* the default rate applies to all other statuses */
+
+    ls = ngx_array_push(log->sample);
+    if (ls == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ls->low = 0;
+    ls->high = NGX_MAX_UINT32_VALUE;
+    ls->rate = dflt;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid sample rate \"%V\"", value);
+    return NGX_CONF_ERROR;
+}
+
+
 static char *
 ngx_http_log_set_format(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -1681,6 +2330,7 @@ ngx_http_log_compile_format(ngx_conf_t *cf, ngx_array_t *flushes,
                     {
                         op->len = v->len;
                         op->getlen = NULL;
+                        op->maxlen = NULL;
                         op->run = v->run;
                         op->data = 0;
 
@@ -1721,6 +2371,7 @@ ngx_http_log_compile_format(ngx_conf_t *cf, ngx_array_t *flushes,
 
                 op->len = len;
                 op->getlen = NULL;
+                op->maxlen = NULL;
 
                 if (len <= sizeof(uintptr_t)) {
                     op->run = ngx_http_log_copy_short;
@@ -0,0 +1,155 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_LOOP_STATUS_NAME_LEN  (sizeof("lateness_msec") - 1)
+
+
+static ngx_int_t ngx_http_loop_status_handler(ngx_http_request_t *r);
+static char *ngx_http_set_loop_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_loop_status_commands[] = {
+
+    { ngx_string("loop_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_set_loop_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_loop_status_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_loop_status_module = {
+    NGX_MODULE_V1,
+    &ngx_http_loop_status_module_ctx,      /* module context */
+    ngx_http_loop_status_commands,         /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_int_t
+ngx_http_loop_status_handler(ngx_http_request_t *r)
+{
+    size_t                   size;
+    ngx_int_t                rc;
+    ngx_buf_t               *b;
+    ngx_uint_t               i;
+    ngx_chain_t              out;
+    ngx_event_conf_t        *ecf;
+    ngx_event_stats_t       *st;
+    ngx_event_loop_stats_t  *ls;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    ecf = ngx_event_get_conf(ngx_cycle->conf_ctx, ngx_event_core_module);
+    st = ecf->loop_stats;
+
+    if (st == NULL) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "loop statistics are disabled, "
+                      "see the \"loop_stats\" directive");
+        return NGX_HTTP_SERVICE_UNAVAILABLE;
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    size = st->workers
+           * (sizeof("Worker  pid \n") - 1 + 2 * NGX_ATOMIC_T_LEN
+              + 4 * (NGX_HTTP_LOOP_STATUS_NAME_LEN
+                     + NGX_EVENT_HISTOGRAM_LEN));
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    for (i = 0; i < st->workers; i++) {
+        ls = &st->stats[i];
+
+        b->last = ngx_sprintf(b->last, "Worker %ui pid %uA\n", i, ls->pid);
+
+        b->last = ngx_event_histogram_print(b->last, "loop_usec",
+                                            &ls->loop);
+        b->last = ngx_event_histogram_print(b->last, "handler_usec",
+                                            &ls->handler);
+        b->last = ngx_event_histogram_print(b->last, "events",
+                                            &ls->events);
+        b->last = ngx_event_histogram_print(b->last, "lateness_msec",
+                                            &ls->lateness);
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+
+static char *
+ngx_http_set_loop_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_loop_status_handler;
+
+    return NGX_CONF_OK;
+}
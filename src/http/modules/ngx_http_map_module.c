@@ -16,6 +16,13 @@ typedef struct {
 } ngx_http_map_conf_t;
 
 
+typedef struct {
+    u_char                     *base;
+    uint32_t                   *buckets;
+    ngx_uint_t                  nbuckets;
+} ngx_http_map_binary_t;
+
+
 typedef struct {
     ngx_hash_keys_arrays_t      keys;
 
@@ -26,8 +33,14 @@ typedef struct {
 
     ngx_http_variable_value_t  *default_value;
     ngx_conf_t                 *cf;
+
+    ngx_array_t                *binary_keys;
+    ngx_http_map_binary_t      *binary;
+
     unsigned                    hostnames:1;
     unsigned                    no_cacheable:1;
+    unsigned                    include:1;
+    unsigned                    allow_binary:1;
 } ngx_http_map_conf_ctx_t;
 
 
@@ -35,15 +48,61 @@ typedef struct {
     ngx_http_map_t              map;
     ngx_http_complex_value_t    value;
     ngx_http_variable_value_t  *default_value;
+    ngx_http_map_binary_t      *binary;
     ngx_uint_t                  hostnames;      /* unsigned  hostnames:1 */
 } ngx_http_map_ctx_t;
 
 
+typedef struct {
+    u_char                      MAPBIN[6];
+    u_char                      version;
+    u_char                      hostnames;
+    uint32_t                    endianness;
+    uint32_t                    crc32;
+    uint32_t                    nbuckets;
+} ngx_http_map_header_t;
+
+
+/*
+ * the binary base is the header, the offsets of nbuckets + 1 buckets,
+ * and the buckets of keys, each key is followed by its value
+ */
+
+typedef struct {
+    uint16_t                    len;
+    uint16_t                    value_len;
+    u_char                      data[1];
+} ngx_http_map_binary_key_t;
+
+
+typedef struct {
+    ngx_str_t                   key;
+    ngx_http_variable_value_t  *value;
+} ngx_http_map_binary_entry_t;
+
+
+#define ngx_http_map_binary_key_size(len, value_len)                          \
+    ngx_align(offsetof(ngx_http_map_binary_key_t, data) + (len) + (value_len), \
+              sizeof(uint32_t))
+
+
 static int ngx_libc_cdecl ngx_http_map_cmp_dns_wildcards(const void *one,
     const void *two);
 static void *ngx_http_map_create_conf(ngx_conf_t *cf);
 static char *ngx_http_map_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 static char *ngx_http_map(ngx_conf_t *cf, ngx_command_t *dummy, void *conf);
+static char *ngx_http_map_include(ngx_conf_t *cf, ngx_command_t *dummy,
+    void *conf);
+static char *ngx_http_map_add_binary_key(ngx_http_map_conf_ctx_t *ctx,
+    ngx_str_t *key, ngx_http_variable_value_t *value);
+static ngx_int_t ngx_http_map_include_binary_base(ngx_conf_t *cf,
+    ngx_http_map_conf_ctx_t *ctx, ngx_str_t *name);
+static void ngx_http_map_create_binary_base(ngx_conf_t *cf,
+    ngx_http_map_conf_ctx_t *ctx, ngx_str_t *name);
+static void ngx_http_map_binary_cleanup(void *data);
+static ngx_int_t ngx_http_map_binary_find(ngx_http_map_binary_t *binary,
+    ngx_str_t *match, ngx_http_variable_value_t *v);
+static uint32_t ngx_http_map_binary_hash(u_char *data, size_t len);
 
 
 static ngx_command_t  ngx_http_map_commands[] = {
@@ -104,6 +163,11 @@ ngx_module_t  ngx_http_map_module = {
 };
 
 
+static ngx_http_map_header_t  ngx_http_map_header = {
+    { 'M', 'A', 'P', 'B', 'I', 'N' }, 0, 0, 0x12345678, 0, 0
+};
+
+
 static ngx_int_t
 ngx_http_map_variable(ngx_http_request_t *r, ngx_http_variable_value_t *v,
     uintptr_t data)
@@ -125,6 +189,15 @@ ngx_http_map_variable(ngx_http_request_t *r, ngx_http_variable_value_t *v,
         val.len--;
     }
 
+    if (map->binary
+        && ngx_http_map_binary_find(map->binary, &val, v) == NGX_OK)
+    {
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http map binary: \"%V\" \"%v\"", &val, v);
+
+        return NGX_OK;
+    }
+
     value = ngx_http_map_find(r, &map->map, &val);
 
     if (value == NULL) {
@@ -265,8 +338,12 @@ ngx_http_map_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     ctx.default_value = NULL;
     ctx.cf = &save;
+    ctx.binary_keys = NULL;
+    ctx.binary = NULL;
     ctx.hostnames = 0;
     ctx.no_cacheable = 0;
+    ctx.include = 0;
+    ctx.allow_binary = 0;
 
     save = *cf;
     cf->pool = pool;
@@ -291,6 +368,7 @@ ngx_http_map_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
                                              &ngx_http_variable_null_value;
 
     map->hostnames = ctx.hostnames;
+    map->binary = ctx.binary;
 
     hash.key = ngx_hash_key_lc;
     hash.max_size = mcf->hash_max_size;
@@ -415,7 +493,7 @@ ngx_http_map(ngx_conf_t *cf, ngx_command_t *dummy, void *conf)
     }
 
     if (ngx_strcmp(value[0].data, "include") == 0) {
-        return ngx_conf_include(cf, dummy, conf);
+        return ngx_http_map_include(cf, dummy, conf);
     }
 
     key = 0;
@@ -520,6 +598,7 @@ found:
         }
 
         ctx->default_value = var;
+        ctx->allow_binary = 0;
 
         return NGX_CONF_OK;
     }
@@ -558,6 +637,8 @@ found:
 
         regex->value = var;
 
+        ctx->allow_binary = 0;
+
         return NGX_CONF_OK;
     }
 
@@ -572,6 +653,11 @@ found:
                           (ctx->hostnames) ? NGX_HASH_WILDCARD_KEY : 0);
 
     if (rv == NGX_OK) {
+
+        if (ctx->include && ctx->allow_binary) {
+            return ngx_http_map_add_binary_key(ctx, &value[0], var);
+        }
+
         return NGX_CONF_OK;
     }
 
@@ -587,3 +673,426 @@ found:
 
     return NGX_CONF_ERROR;
 }
+
+
+static char *
+ngx_http_map_include(ngx_conf_t *cf, ngx_command_t *dummy, void *conf)
+{
+    char                     *rv;
+    ngx_str_t                *value, file, name;
+    ngx_http_map_conf_ctx_t  *ctx;
+
+    ctx = cf->ctx;
+
+    value = cf->args->elts;
+
+    if (ctx->include
+        || ctx->binary
+        || strpbrk((char *) value[1].data, "*?[") != NULL)
+    {
+        ctx->allow_binary = 0;
+        return ngx_conf_include(cf, dummy, conf);
+    }
+
+    file.len = value[1].len + 4;
+    file.data = ngx_pnalloc(cf->pool, value[1].len + 5);
+    if (file.data == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_sprintf(file.data, "%V.bin%Z", &value[1]);
+
+    if (ngx_conf_full_name(cf->cycle, &file, 1) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, cf->log, 0, "include %s", file.data);
+
+    switch (ngx_http_map_include_binary_base(cf, ctx, &file)) {
+    case NGX_OK:
+        return NGX_CONF_OK;
+    case NGX_ERROR:
+        return NGX_CONF_ERROR;
+    default:
+        break;
+    }
+
+    name.len = file.len - 4;
+    name.data = ngx_pnalloc(cf->pool, name.len + 1);
+    if (name.data == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_cpystrn(name.data, file.data, name.len + 1);
+
+    ctx->binary_keys = ngx_array_create(cf->pool, 1024,
+                                        sizeof(ngx_http_map_binary_entry_t));
+    if (ctx->binary_keys == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ctx->include = 1;
+    ctx->allow_binary = 1;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, cf->log, 0, "include %s", name.data);
+
+    rv = ngx_conf_parse(cf, &name);
+
+    ctx->include = 0;
+
+    if (rv == NGX_CONF_OK
+        && ctx->allow_binary
+        && ctx->binary_keys->nelts > 100000)
+    {
+        ngx_http_map_create_binary_base(cf, ctx, &file);
+    }
+
+    ctx->binary_keys = NULL;
+
+    return rv;
+}
+
+
+static char *
+ngx_http_map_add_binary_key(ngx_http_map_conf_ctx_t *ctx, ngx_str_t *key,
+    ngx_http_variable_value_t *value)
+{
+    ngx_http_map_binary_entry_t  *entry;
+
+    /* the binary base keeps exact keys with constant values only */
+
+    if (!value->valid
+        || key->len > 0xffff
+        || value->len > 0xffff
+        || (ctx->hostnames
+            && key->len
+            && (key->data[0] == '.'
+                || key->data[0] == '*'
+                || key->data[key->len - 1] == '*')))
+    {
+        ctx->allow_binary = 0;
+        return NGX_CONF_OK;
+    }
+
+    entry = ngx_array_push(ctx->binary_keys);
+    if (entry == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    entry->key = *key;
+    entry->value = value;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_map_include_binary_base(ngx_conf_t *cf, ngx_http_map_conf_ctx_t *ctx,
+    ngx_str_t *name)
+{
+    u_char                  ch;
+    time_t                  mtime;
+    size_t                  size;
+    uint32_t                crc32;
+    ngx_fd_t                fd;
+    ngx_err_t               err;
+    ngx_file_info_t         fi;
+    ngx_pool_cleanup_t     *cln;
+    ngx_file_mapping_t     *fm;
+    ngx_http_map_header_t  *header, h;
+    ngx_http_map_binary_t  *binary;
+
+    fd = ngx_open_file(name->data, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        err = ngx_errno;
+        if (err != NGX_ENOENT) {
+            ngx_conf_log_error(NGX_LOG_CRIT, cf, err,
+                               ngx_open_file_n " \"%s\" failed", name->data);
+        }
+        return NGX_DECLINED;
+    }
+
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        ngx_conf_log_error(NGX_LOG_CRIT, cf, ngx_errno,
+                           ngx_fd_info_n " \"%s\" failed", name->data);
+        goto failed;
+    }
+
+    fm = NULL;
+
+    size = (size_t) ngx_file_size(&fi);
+    mtime = ngx_file_mtime(&fi);
+
+    ch = name->data[name->len - 4];
+    name->data[name->len - 4] = '\0';
+
+    if (ngx_file_info(name->data, &fi) == NGX_FILE_ERROR) {
+        ngx_conf_log_error(NGX_LOG_CRIT, cf, ngx_errno,
+                           ngx_file_info_n " \"%s\" failed", name->data);
+        goto failed;
+    }
+
+    name->data[name->len - 4] = ch;
+
+    if (mtime < ngx_file_mtime(&fi)) {
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "stale binary map base \"%s\"", name->data);
+        goto failed;
+    }
+
+    if (size < sizeof(ngx_http_map_header_t) + sizeof(uint32_t)
+        || size > 0xffffffff)
+    {
+        goto incompatible;
+    }
+
+    /* the mapping lives as long as the configuration */
+
+    cln = ngx_pool_cleanup_add(ctx->keys.pool, sizeof(ngx_file_mapping_t));
+    if (cln == NULL) {
+        goto failed;
+    }
+
+    fm = cln->data;
+
+    fm->name = ngx_pnalloc(ctx->keys.pool, name->len + 1);
+    if (fm->name == NULL) {
+        goto failed;
+    }
+
+    ngx_cpystrn(fm->name, name->data, name->len + 1);
+
+    fm->fd = fd;
+    fm->size = size;
+    fm->log = cf->cycle->log;
+
+    if (ngx_open_file_mapping(fm) != NGX_OK) {
+        goto failed;
+    }
+
+    cln->handler = ngx_http_map_binary_cleanup;
+
+    header = fm->addr;
+
+    h = ngx_http_map_header;
+    h.hostnames = ctx->hostnames;
+
+    if (ngx_memcmp(&h, header, offsetof(ngx_http_map_header_t, crc32)) != 0
+        || header->nbuckets == 0
+        || (size - sizeof(ngx_http_map_header_t)) / sizeof(uint32_t)
+           <= header->nbuckets)
+    {
+        goto incompatible;
+    }
+
+    binary = ngx_palloc(ctx->keys.pool, sizeof(ngx_http_map_binary_t));
+    if (binary == NULL) {
+        return NGX_ERROR;
+    }
+
+    binary->base = fm->addr;
+    binary->buckets = (uint32_t *) (binary->base
+                                    + sizeof(ngx_http_map_header_t));
+    binary->nbuckets = header->nbuckets;
+
+    if (binary->buckets[binary->nbuckets] != size) {
+        goto incompatible;
+    }
+
+    crc32 = ngx_crc32_long(binary->base + sizeof(ngx_http_map_header_t),
+                           size - sizeof(ngx_http_map_header_t));
+
+    if (crc32 != header->crc32) {
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                        "CRC32 mismatch in binary map base \"%s\"", name->data);
+        return NGX_DECLINED;
+    }
+
+    ngx_conf_log_error(NGX_LOG_NOTICE, cf, 0,
+                       "using binary map base \"%s\"", name->data);
+
+    ctx->binary = binary;
+
+    return NGX_OK;
+
+incompatible:
+
+    ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                       "incompatible binary map base \"%s\"", name->data);
+
+    if (fm && fm->addr) {
+        /* unmapped and closed by the pool cleanup */
+        return NGX_DECLINED;
+    }
+
+failed:
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, cf->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", name->data);
+    }
+
+    return NGX_DECLINED;
+}
+
+
+static void
+ngx_http_map_create_binary_base(ngx_conf_t *cf, ngx_http_map_conf_ctx_t *ctx,
+    ngx_str_t *name)
+{
+    u_char                       *p;
+    size_t                        size;
+    uint32_t                     *buckets, *next, *hash;
+    ngx_uint_t                    i, n, nbuckets;
+    ngx_file_mapping_t            fm;
+    ngx_http_map_header_t        *header;
+    ngx_http_map_binary_key_t    *key;
+    ngx_http_map_binary_entry_t  *entry;
+
+    entry = ctx->binary_keys->elts;
+    n = ctx->binary_keys->nelts;
+
+    nbuckets = n;
+
+    hash = ngx_alloc((n + 2 * (nbuckets + 1)) * sizeof(uint32_t), cf->log);
+    if (hash == NULL) {
+        return;
+    }
+
+    buckets = hash + n;
+    next = buckets + nbuckets + 1;
+
+    ngx_memzero(buckets, (nbuckets + 1) * sizeof(uint32_t));
+
+    size = sizeof(ngx_http_map_header_t) + (nbuckets + 1) * sizeof(uint32_t);
+
+    for (i = 0; i < n; i++) {
+        hash[i] = ngx_http_map_binary_hash(entry[i].key.data, entry[i].key.len)
+                  % nbuckets;
+
+        buckets[hash[i] + 1] += ngx_http_map_binary_key_size(
+                                    entry[i].key.len, entry[i].value->len);
+
+        size += ngx_http_map_binary_key_size(entry[i].key.len,
+                                             entry[i].value->len);
+
+        if (size > 0xffffffff) {
+            goto done;
+        }
+    }
+
+    buckets[0] = sizeof(ngx_http_map_header_t)
+                 + (nbuckets + 1) * sizeof(uint32_t);
+
+    for (i = 1; i <= nbuckets; i++) {
+        buckets[i] += buckets[i - 1];
+    }
+
+    ngx_memcpy(next, buckets, (nbuckets + 1) * sizeof(uint32_t));
+
+    fm.name = name->data;
+    fm.size = size;
+    fm.log = cf->log;
+
+    ngx_log_error(NGX_LOG_NOTICE, fm.log, 0,
+                  "creating binary map base \"%s\"", fm.name);
+
+    if (ngx_create_file_mapping(&fm) != NGX_OK) {
+        goto done;
+    }
+
+    p = fm.addr;
+
+    ngx_memcpy(p + sizeof(ngx_http_map_header_t), buckets,
+               (nbuckets + 1) * sizeof(uint32_t));
+
+    for (i = 0; i < n; i++) {
+        key = (ngx_http_map_binary_key_t *) (p + next[hash[i]]);
+
+        key->len = (uint16_t) entry[i].key.len;
+        key->value_len = (uint16_t) entry[i].value->len;
+
+        ngx_strlow(key->data, entry[i].key.data, entry[i].key.len);
+        ngx_memcpy(key->data + key->len, entry[i].value->data, key->value_len);
+
+        next[hash[i]] += ngx_http_map_binary_key_size(key->len,
+                                                      key->value_len);
+    }
+
+    header = fm.addr;
+
+    *header = ngx_http_map_header;
+    header->hostnames = ctx->hostnames;
+    header->nbuckets = (uint32_t) nbuckets;
+    header->crc32 = ngx_crc32_long(p + sizeof(ngx_http_map_header_t),
+                                   size - sizeof(ngx_http_map_header_t));
+
+    ngx_close_file_mapping(&fm);
+
+done:
+
+    ngx_free(hash);
+}
+
+
+static void
+ngx_http_map_binary_cleanup(void *data)
+{
+    ngx_file_mapping_t  *fm = data;
+
+    ngx_close_file_mapping(fm);
+}
+
+
+static ngx_int_t
+ngx_http_map_binary_find(ngx_http_map_binary_t *binary, ngx_str_t *match,
+    ngx_http_variable_value_t *v)
+{
+    u_char                     *p, *last;
+    uint32_t                    n;
+    ngx_http_map_binary_key_t  *key;
+
+    n = ngx_http_map_binary_hash(match->data, match->len) % binary->nbuckets;
+
+    p = binary->base + binary->buckets[n];
+    last = binary->base + binary->buckets[n + 1];
+
+    while (p < last) {
+        key = (ngx_http_map_binary_key_t *) p;
+
+        if (key->len == match->len
+            && ngx_strncasecmp(key->data, match->data, match->len) == 0)
+        {
+            v->len = key->value_len;
+            v->valid = 1;
+            v->no_cacheable = 0;
+            v->not_found = 0;
+            v->data = key->data + key->len;
+
+            return NGX_OK;
+        }
+
+        p += ngx_http_map_binary_key_size(key->len, key->value_len);
+    }
+
+    return NGX_DECLINED;
+}
+
+
+static uint32_t
+ngx_http_map_binary_hash(u_char *data, size_t len)
+{
+    uint32_t  key;
+
+    /* 32-bit arithmetic keeps the base valid across platforms */
+
+    key = 0;
+
+    while (len--) {
+        key = key * 31 + ngx_tolower(*data);
+        data++;
+    }
+
+    return key;
+}
@@ -10,10 +10,16 @@
 #include <ngx_http.h>
 
 
+#define NGX_HTTP_MEMCACHED_OFF   2
+
+
 typedef struct {
     ngx_http_upstream_conf_t   upstream;
     ngx_int_t                  index;
     ngx_uint_t                 gzip_flag;
+    ngx_uint_t                 methods;
+    ngx_uint_t                 flags;
+    time_t                     expire;
 } ngx_http_memcached_loc_conf_t;
 
 
@@ -51,6 +57,14 @@ static ngx_conf_bitmask_t  ngx_http_memcached_next_upstream_masks[] = {
 };
 
 
+static ngx_conf_bitmask_t  ngx_http_memcached_methods_mask[] = {
+    { ngx_string("off"), NGX_HTTP_MEMCACHED_OFF },
+    { ngx_string("put"), NGX_HTTP_PUT },
+    { ngx_string("delete"), NGX_HTTP_DELETE },
+    { ngx_null_string, 0 }
+};
+
+
 static ngx_command_t  ngx_http_memcached_commands[] = {
 
     { ngx_string("memcached_pass"),
@@ -74,6 +88,13 @@ static ngx_command_t  ngx_http_memcached_commands[] = {
       offsetof(ngx_http_memcached_loc_conf_t, upstream.socket_keepalive),
       NULL },
 
+    { ngx_string("memcached_fastopen"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_memcached_loc_conf_t, upstream.fastopen),
+      NULL },
+
     { ngx_string("memcached_connect_timeout"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_msec_slot,
@@ -130,6 +151,27 @@ static ngx_command_t  ngx_http_memcached_commands[] = {
       offsetof(ngx_http_memcached_loc_conf_t, gzip_flag),
       NULL },
 
+    { ngx_string("memcached_methods"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_conf_set_bitmask_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_memcached_loc_conf_t, methods),
+      &ngx_http_memcached_methods_mask },
+
+    { ngx_string("memcached_flags"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_memcached_loc_conf_t, flags),
+      NULL },
+
+    { ngx_string("memcached_expire"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_sec_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_memcached_loc_conf_t, expire),
+      NULL },
+
       ngx_null_command
 };
 
@@ -180,14 +222,20 @@ ngx_http_memcached_handler(ngx_http_request_t *r)
     ngx_http_memcached_ctx_t       *ctx;
     ngx_http_memcached_loc_conf_t  *mlcf;
 
-    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+    mlcf = ngx_http_get_module_loc_conf(r, ngx_http_memcached_module);
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))
+        && !(r->method & mlcf->methods & (NGX_HTTP_PUT|NGX_HTTP_DELETE)))
+    {
         return NGX_HTTP_NOT_ALLOWED;
     }
 
-    rc = ngx_http_discard_request_body(r);
+    if (r->method != NGX_HTTP_PUT) {
+        rc = ngx_http_discard_request_body(r);
 
-    if (rc != NGX_OK) {
-        return rc;
+        if (rc != NGX_OK) {
+            return rc;
+        }
     }
 
     if (ngx_http_set_content_type(r) != NGX_OK) {
@@ -203,8 +251,6 @@ ngx_http_memcached_handler(ngx_http_request_t *r)
     ngx_str_set(&u->schema, "memcached://");
     u->output.tag = (ngx_buf_tag_t) &ngx_http_memcached_module;
 
-    mlcf = ngx_http_get_module_loc_conf(r, ngx_http_memcached_module);
-
     u->conf = &mlcf->upstream;
 
     u->create_request = ngx_http_memcached_create_request;
@@ -226,6 +272,16 @@ ngx_http_memcached_handler(ngx_http_request_t *r)
     u->input_filter = ngx_http_memcached_filter;
     u->input_filter_ctx = ctx;
 
+    if (r->method == NGX_HTTP_PUT) {
+        rc = ngx_http_read_client_request_body(r, ngx_http_upstream_init);
+
+        if (rc >= NGX_HTTP_SPECIAL_RESPONSE) {
+            return rc;
+        }
+
+        return NGX_DONE;
+    }
+
     r->main->count++;
 
     ngx_http_upstream_init(r);
@@ -237,10 +293,12 @@ ngx_http_memcached_handler(ngx_http_request_t *r)
 static ngx_int_t
 ngx_http_memcached_create_request(ngx_http_request_t *r)
 {
+    off_t                           size;
     size_t                          len;
     uintptr_t                       escape;
     ngx_buf_t                      *b;
-    ngx_chain_t                    *cl;
+    ngx_str_t                       command;
+    ngx_chain_t                    *cl, *body;
     ngx_http_memcached_ctx_t       *ctx;
     ngx_http_variable_value_t      *vv;
     ngx_http_memcached_loc_conf_t  *mlcf;
@@ -257,7 +315,32 @@ ngx_http_memcached_create_request(ngx_http_request_t *r)
 
     escape = 2 * ngx_escape_uri(NULL, vv->data, vv->len, NGX_ESCAPE_MEMCACHED);
 
-    len = sizeof("get ") - 1 + vv->len + escape + sizeof(CRLF) - 1;
+    if (r->method == NGX_HTTP_PUT) {
+        ngx_str_set(&command, "set ");
+
+    } else if (r->method == NGX_HTTP_DELETE) {
+        ngx_str_set(&command, "delete ");
+
+    } else {
+        ngx_str_set(&command, "get ");
+    }
+
+    len = command.len + vv->len + escape + sizeof(CRLF) - 1;
+
+    size = 0;
+
+    if (r->method == NGX_HTTP_PUT) {
+
+        /* "set <key> <flags> <exptime> <bytes>" */
+
+        len += sizeof(" ") - 1 + NGX_INT_T_LEN
+               + sizeof(" ") - 1 + NGX_TIME_T_LEN
+               + sizeof(" ") - 1 + NGX_OFF_T_LEN;
+
+        for (body = r->upstream->request_bufs; body; body = body->next) {
+            size += ngx_buf_size(body->buf);
+        }
+    }
 
     b = ngx_create_temp_buf(r->pool, len);
     if (b == NULL) {
@@ -272,9 +355,10 @@ ngx_http_memcached_create_request(ngx_http_request_t *r)
     cl->buf = b;
     cl->next = NULL;
 
+    body = r->upstream->request_bufs;
     r->upstream->request_bufs = cl;
 
-    *b->last++ = 'g'; *b->last++ = 'e'; *b->last++ = 't'; *b->last++ = ' ';
+    b->last = ngx_copy(b->last, command.data, command.len);
 
     ctx = ngx_http_get_module_ctx(r, ngx_http_memcached_module);
 
@@ -290,10 +374,65 @@ ngx_http_memcached_create_request(ngx_http_request_t *r)
 
     ctx->key.len = b->last - ctx->key.data;
 
-    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http memcached request: \"%V\"", &ctx->key);
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http memcached request: %*s\"%V\"",
+                   command.len - 1, command.data, &ctx->key);
+
+    if (r->method != NGX_HTTP_PUT) {
+        *b->last++ = CR; *b->last++ = LF;
+        return NGX_OK;
+    }
+
+    b->last = ngx_sprintf(b->last, " %ui %T %O" CRLF,
+                          mlcf->flags, mlcf->expire, size);
+
+    /* the value is the request body, followed by CRLF */
+
+    while (body) {
+
+        if (ngx_buf_size(body->buf) == 0) {
+            body = body->next;
+            continue;
+        }
+
+        b = ngx_alloc_buf(r->pool);
+        if (b == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(b, body->buf, sizeof(ngx_buf_t));
+
+        b->last_buf = 0;
+        b->last_in_chain = 0;
+
+        cl->next = ngx_alloc_chain_link(r->pool);
+        if (cl->next == NULL) {
+            return NGX_ERROR;
+        }
+
+        cl = cl->next;
+        cl->buf = b;
 
-    *b->last++ = CR; *b->last++ = LF;
+        body = body->next;
+    }
+
+    b = ngx_calloc_buf(r->pool);
+    if (b == NULL) {
+        return NGX_ERROR;
+    }
+
+    b->pos = (u_char *) CRLF;
+    b->last = b->pos + sizeof(CRLF) - 1;
+    b->memory = 1;
+
+    cl->next = ngx_alloc_chain_link(r->pool);
+    if (cl->next == NULL) {
+        return NGX_ERROR;
+    }
+
+    cl = cl->next;
+    cl->buf = b;
+    cl->next = NULL;
 
     return NGX_OK;
 }
@@ -347,6 +486,10 @@ found:
     ctx = ngx_http_get_module_ctx(r, ngx_http_memcached_module);
     mlcf = ngx_http_get_module_loc_conf(r, ngx_http_memcached_module);
 
+    if (r->method & (NGX_HTTP_PUT|NGX_HTTP_DELETE)) {
+        goto store;
+    }
+
     if (ngx_strncmp(p, "VALUE ", sizeof("VALUE ") - 1) == 0) {
 
         p += sizeof("VALUE ") - 1;
@@ -441,6 +584,35 @@ found:
         return NGX_OK;
     }
 
+    goto no_valid;
+
+store:
+
+    if (ngx_strcmp(p, "STORED\x0d") == 0
+        || ngx_strcmp(p, "DELETED\x0d") == 0)
+    {
+        u->headers_in.content_length_n = 0;
+        u->headers_in.status_n = NGX_HTTP_NO_CONTENT;
+        u->state->status = NGX_HTTP_NO_CONTENT;
+        u->buffer.pos = p + line.len + sizeof(CRLF) - 1;
+        u->keepalive = 1;
+
+        return NGX_OK;
+    }
+
+    if (ngx_strcmp(p, "NOT_FOUND\x0d") == 0) {
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0,
+                      "key: \"%V\" was not found by memcached", &ctx->key);
+
+        u->headers_in.content_length_n = 0;
+        u->headers_in.status_n = 404;
+        u->state->status = 404;
+        u->buffer.pos = p + sizeof("NOT_FOUND" CRLF) - 1;
+        u->keepalive = 1;
+
+        return NGX_OK;
+    }
+
 no_valid:
 
     ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
@@ -459,7 +631,7 @@ ngx_http_memcached_filter_init(void *data)
 
     u = ctx->request->upstream;
 
-    if (u->headers_in.status_n != 404) {
+    if (u->headers_in.status_n == 200) {
         u->length = u->headers_in.content_length_n + NGX_HTTP_MEMCACHED_END;
         ctx->rest = NGX_HTTP_MEMCACHED_END;
 
@@ -607,6 +779,7 @@ ngx_http_memcached_create_loc_conf(ngx_conf_t *cf)
 
     conf->upstream.local = NGX_CONF_UNSET_PTR;
     conf->upstream.socket_keepalive = NGX_CONF_UNSET;
+    conf->upstream.fastopen = NGX_CONF_UNSET;
     conf->upstream.next_upstream_tries = NGX_CONF_UNSET_UINT;
     conf->upstream.connect_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.send_timeout = NGX_CONF_UNSET_MSEC;
@@ -632,6 +805,8 @@ ngx_http_memcached_create_loc_conf(ngx_conf_t *cf)
 
     conf->index = NGX_CONF_UNSET;
     conf->gzip_flag = NGX_CONF_UNSET_UINT;
+    conf->flags = NGX_CONF_UNSET_UINT;
+    conf->expire = NGX_CONF_UNSET;
 
     return conf;
 }
@@ -649,6 +824,9 @@ ngx_http_memcached_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->upstream.socket_keepalive,
                               prev->upstream.socket_keepalive, 0);
 
+    ngx_conf_merge_value(conf->upstream.fastopen,
+                              prev->upstream.fastopen, 0);
+
     ngx_conf_merge_uint_value(conf->upstream.next_upstream_tries,
                               prev->upstream.next_upstream_tries, 0);
 
@@ -689,6 +867,12 @@ ngx_http_memcached_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_uint_value(conf->gzip_flag, prev->gzip_flag, 0);
 
+    ngx_conf_merge_bitmask_value(conf->methods, prev->methods,
+                              (NGX_CONF_BITMASK_SET|NGX_HTTP_MEMCACHED_OFF));
+
+    ngx_conf_merge_uint_value(conf->flags, prev->flags, 0);
+    ngx_conf_merge_sec_value(conf->expire, prev->expire, 0);
+
     return NGX_CONF_OK;
 }
 
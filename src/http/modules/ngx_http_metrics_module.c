@@ -0,0 +1,1253 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_METRICS_PROMETHEUS  0
+#define NGX_HTTP_METRICS_JSON        1
+
+/* histogram buckets of 1, 2, 4, ... 65536 milliseconds */
+#define NGX_HTTP_METRICS_BUCKETS     17
+
+/* lines of an entity in the Prometheus format, excluding its names */
+#define NGX_HTTP_METRICS_LINES       (10 + NGX_HTTP_METRICS_BUCKETS + 1)
+#define NGX_HTTP_METRICS_LINE_LEN    (128 + 2 * NGX_ATOMIC_T_LEN)
+
+/* server zone timings, the phases and the following */
+#define NGX_HTTP_METRICS_TIMINGS     9
+#define NGX_HTTP_METRICS_BODY        NGX_HTTP_TIMED_PHASES
+#define NGX_HTTP_METRICS_FIRST_BYTE  (NGX_HTTP_TIMED_PHASES + 1)
+
+
+typedef struct {
+    ngx_atomic_t                    requests;
+    ngx_atomic_t                    responses[5];   /* 1xx .. 5xx */
+    ngx_atomic_t                    received;
+    ngx_atomic_t                    sent;
+    ngx_event_histogram_t           time;           /* msec */
+} ngx_http_metrics_counters_t;
+
+
+typedef struct {
+    ngx_event_histogram_t           time[NGX_HTTP_METRICS_TIMINGS];  /* msec */
+} ngx_http_metrics_timings_t;
+
+
+typedef struct {
+    ngx_str_t                       name;
+    ngx_uint_t                      type;
+} ngx_http_metrics_timing_t;
+
+
+typedef struct {
+    ngx_str_t                       zone;           /* or upstream name */
+    ngx_str_t                       peer;           /* empty for zones */
+} ngx_http_metrics_entity_t;
+
+
+typedef struct {
+    ngx_http_upstream_srv_conf_t   *upstream;
+    ngx_http_metrics_entity_t      *peers;
+    ngx_uint_t                      npeers;
+    ngx_uint_t                      index;
+} ngx_http_metrics_upstream_t;
+
+
+typedef struct {
+    ngx_array_t                     entities;   /* ngx_http_metrics_entity_t */
+    ngx_uint_t                      nzones;
+    ngx_array_t                     upstreams;
+                                        /* ngx_http_metrics_upstream_t */
+
+    ngx_uint_t                      workers;
+    size_t                          timings;    /* offset in a slot */
+    size_t                          slot_size;
+    u_char                         *slots;
+    ngx_shm_zone_t                 *shm_zone;
+
+    ngx_uint_t                      enabled;    /* unsigned  enabled:1; */
+} ngx_http_metrics_main_conf_t;
+
+
+typedef struct {
+    ngx_uint_t                      zone;
+} ngx_http_metrics_srv_conf_t;
+
+
+typedef struct {
+    ngx_uint_t                      format;
+} ngx_http_metrics_loc_conf_t;
+
+
+static ngx_int_t ngx_http_metrics_log_handler(ngx_http_request_t *r);
+static void ngx_http_metrics_count(ngx_http_metrics_counters_t *c,
+    ngx_uint_t status, off_t received, off_t sent, ngx_msec_t time);
+static void ngx_http_metrics_count_timings(ngx_http_request_t *r,
+    ngx_http_metrics_timings_t *t);
+static ngx_int_t ngx_http_metrics_handler(ngx_http_request_t *r);
+static void ngx_http_metrics_sum(ngx_http_metrics_main_conf_t *mmcf,
+    ngx_http_metrics_counters_t *sum, ngx_http_metrics_timings_t *tsum);
+static void ngx_http_metrics_sum_histogram(ngx_event_histogram_t *s,
+    ngx_event_histogram_t *h);
+static u_char *ngx_http_metrics_prometheus(u_char *p,
+    ngx_http_metrics_main_conf_t *mmcf, ngx_http_metrics_counters_t *sum,
+    ngx_http_metrics_timings_t *tsum);
+static u_char *ngx_http_metrics_prometheus_histogram(u_char *p, char *name,
+    ngx_http_metrics_entity_t *e, ngx_str_t *phase, ngx_event_histogram_t *h);
+static u_char *ngx_http_metrics_prometheus_labels(u_char *p,
+    ngx_http_metrics_entity_t *e);
+static u_char *ngx_http_metrics_json(u_char *p,
+    ngx_http_metrics_main_conf_t *mmcf, ngx_http_metrics_counters_t *sum,
+    ngx_http_metrics_timings_t *tsum);
+static u_char *ngx_http_metrics_json_counters(u_char *p,
+    ngx_http_metrics_counters_t *c, char *time);
+static u_char *ngx_http_metrics_json_histogram(u_char *p, ngx_str_t *name,
+    ngx_event_histogram_t *h);
+static u_char *ngx_http_metrics_escape(u_char *p, ngx_str_t *s);
+
+static void *ngx_http_metrics_create_main_conf(ngx_conf_t *cf);
+static void *ngx_http_metrics_create_srv_conf(ngx_conf_t *cf);
+static void *ngx_http_metrics_create_loc_conf(ngx_conf_t *cf);
+static char *ngx_http_metrics_merge_loc_conf(ngx_conf_t *cf, void *parent,
+    void *child);
+static char *ngx_http_metrics_status_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_metrics(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_int_t ngx_http_metrics_init(ngx_conf_t *cf);
+static ngx_int_t ngx_http_metrics_init_upstreams(ngx_conf_t *cf,
+    ngx_http_metrics_main_conf_t *mmcf);
+static ngx_int_t ngx_http_metrics_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+static ngx_int_t ngx_http_metrics_init_module(ngx_cycle_t *cycle);
+static ngx_int_t ngx_http_metrics_init_process(ngx_cycle_t *cycle);
+
+
+static ngx_conf_enum_t  ngx_http_metrics_formats[] = {
+    { ngx_string("prometheus"), NGX_HTTP_METRICS_PROMETHEUS },
+    { ngx_string("json"), NGX_HTTP_METRICS_JSON },
+    { ngx_null_string, 0 }
+};
+
+
+static ngx_command_t  ngx_http_metrics_commands[] = {
+
+    { ngx_string("status_zone"),
+      NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_http_metrics_status_zone,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("metrics"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS|NGX_CONF_TAKE1,
+      ngx_http_metrics,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_metrics_loc_conf_t, format),
+      &ngx_http_metrics_formats },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_metrics_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    ngx_http_metrics_init,                 /* postconfiguration */
+
+    ngx_http_metrics_create_main_conf,     /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    ngx_http_metrics_create_srv_conf,      /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    ngx_http_metrics_create_loc_conf,      /* create location configuration */
+    ngx_http_metrics_merge_loc_conf        /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_metrics_module = {
+    NGX_MODULE_V1,
+    &ngx_http_metrics_module_ctx,          /* module context */
+    ngx_http_metrics_commands,             /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    ngx_http_metrics_init_module,          /* init module */
+    ngx_http_metrics_init_process,         /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_str_t  ngx_http_metrics_zone_name = ngx_string("http_metrics");
+
+
+static ngx_http_metrics_timing_t  ngx_http_metrics_timings[] = {
+    { ngx_string("post_read"), NGX_HTTP_POST_READ_PHASE },
+    { ngx_string("server_rewrite"), NGX_HTTP_SERVER_REWRITE_PHASE },
+    { ngx_string("rewrite"), NGX_HTTP_REWRITE_PHASE },
+    { ngx_string("preaccess"), NGX_HTTP_PREACCESS_PHASE },
+    { ngx_string("access"), NGX_HTTP_ACCESS_PHASE },
+    { ngx_string("precontent"), NGX_HTTP_PRECONTENT_PHASE },
+    { ngx_string("content"), NGX_HTTP_CONTENT_PHASE },
+    { ngx_string("request_body"), NGX_HTTP_METRICS_BODY },
+    { ngx_string("first_byte"), NGX_HTTP_METRICS_FIRST_BYTE }
+};
+
+/* the counters of the current worker process */
+static ngx_http_metrics_counters_t  *ngx_http_metrics_slot;
+
+
+static ngx_int_t
+ngx_http_metrics_log_handler(ngx_http_request_t *r)
+{
+    ngx_uint_t                      i, k, status;
+    ngx_time_t                     *tp;
+    ngx_msec_int_t                  ms;
+    ngx_http_metrics_entity_t      *peer;
+    ngx_http_upstream_state_t      *state;
+    ngx_http_metrics_upstream_t    *mu;
+    ngx_http_metrics_srv_conf_t    *mscf;
+    ngx_http_metrics_main_conf_t   *mmcf;
+    ngx_http_upstream_srv_conf_t   *uscf;
+
+    if (ngx_http_metrics_slot == NULL) {
+        return NGX_OK;
+    }
+
+    mmcf = ngx_http_get_module_main_conf(r, ngx_http_metrics_module);
+    mscf = ngx_http_get_module_srv_conf(r, ngx_http_metrics_module);
+
+    if (mscf->zone != NGX_CONF_UNSET_UINT) {
+
+        if (r->err_status) {
+            status = r->err_status;
+
+        } else {
+            status = r->headers_out.status;
+        }
+
+        tp = ngx_timeofday();
+
+        ms = (ngx_msec_int_t)
+                 ((tp->sec - r->start_sec) * 1000
+                  + (tp->msec - r->start_msec));
+
+        ngx_http_metrics_count(&ngx_http_metrics_slot[mscf->zone], status,
+                               r->request_length, r->connection->sent,
+                               (ngx_msec_t) ngx_max(ms, 0));
+
+        if (r->phase_start) {
+            ngx_http_metrics_count_timings(r, (ngx_http_metrics_timings_t *)
+                                    ((u_char *) ngx_http_metrics_slot
+                                     + mmcf->timings)
+                                    + mscf->zone);
+        }
+    }
+
+    if (r->upstream == NULL
+        || r->upstream->upstream == NULL
+        || r->upstream_states == NULL)
+    {
+        return NGX_OK;
+    }
+
+    uscf = r->upstream->upstream;
+    mu = mmcf->upstreams.elts;
+
+    for (i = 0; i < mmcf->upstreams.nelts; i++) {
+        if (mu[i].upstream == uscf) {
+            break;
+        }
+    }
+
+    if (i == mmcf->upstreams.nelts) {
+        return NGX_OK;
+    }
+
+    mu = &mu[i];
+    state = r->upstream_states->elts;
+
+    for (i = 0; i < r->upstream_states->nelts; i++) {
+
+        if (state[i].peer == NULL) {
+            continue;
+        }
+
+        peer = mu->peers;
+
+        for (k = 0; k < mu->npeers; k++) {
+            if (peer[k].peer.data == state[i].peer->data
+                || (peer[k].peer.len == state[i].peer->len
+                    && ngx_strncmp(peer[k].peer.data, state[i].peer->data,
+                                   peer[k].peer.len)
+                       == 0))
+            {
+                break;
+            }
+        }
+
+        if (k == mu->npeers) {
+            continue;
+        }
+
+        ngx_http_metrics_count(&ngx_http_metrics_slot[mu->index + k],
+                               state[i].status, state[i].bytes_received,
+                               state[i].bytes_sent,
+                               state[i].response_time != (ngx_msec_t) -1
+                               ? state[i].response_time : 0);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_metrics_count(ngx_http_metrics_counters_t *c, ngx_uint_t status,
+    off_t received, off_t sent, ngx_msec_t time)
+{
+    /* each worker updates its own counters only */
+
+    c->requests++;
+
+    if (status >= 100 && status < 600) {
+        c->responses[status / 100 - 1]++;
+    }
+
+    c->received += received;
+    c->sent += sent;
+
+    ngx_event_histogram_add(&c->time, time);
+}
+
+
+static void
+ngx_http_metrics_count_timings(ngx_http_request_t *r,
+    ngx_http_metrics_timings_t *t)
+{
+    ngx_uint_t                  n;
+    ngx_http_metrics_timing_t  *timing;
+
+    timing = ngx_http_metrics_timings;
+
+    for (n = 0; n < NGX_HTTP_METRICS_TIMINGS; n++) {
+
+        switch (timing[n].type) {
+
+        case NGX_HTTP_METRICS_BODY:
+            if (r->request_body && r->request_body->last_saved) {
+                ngx_event_histogram_add(&t->time[n],
+                                        r->request_body->read_time);
+            }
+
+            break;
+
+        case NGX_HTTP_METRICS_FIRST_BYTE:
+            if (r->first_byte_sent) {
+                ngx_event_histogram_add(&t->time[n], r->first_byte_time);
+            }
+
+            break;
+
+        default:
+            ngx_event_histogram_add(&t->time[n],
+                                    ngx_http_core_phase_time(r,
+                                                             timing[n].type));
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_http_metrics_handler(ngx_http_request_t *r)
+{
+    size_t                         size;
+    ngx_int_t                      rc;
+    ngx_buf_t                     *b;
+    ngx_uint_t                     i;
+    ngx_chain_t                    out;
+    ngx_http_metrics_entity_t     *e;
+    ngx_http_metrics_timings_t    *tsum;
+    ngx_http_metrics_counters_t   *sum;
+    ngx_http_metrics_loc_conf_t   *mlcf;
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    mmcf = ngx_http_get_module_main_conf(r, ngx_http_metrics_module);
+    mlcf = ngx_http_get_module_loc_conf(r, ngx_http_metrics_module);
+
+    if (mlcf->format == NGX_HTTP_METRICS_JSON) {
+        r->headers_out.content_type_len = sizeof("application/json") - 1;
+        ngx_str_set(&r->headers_out.content_type, "application/json");
+
+    } else {
+        r->headers_out.content_type_len =
+                                    sizeof("text/plain; version=0.0.4") - 1;
+        ngx_str_set(&r->headers_out.content_type,
+                    "text/plain; version=0.0.4");
+    }
+
+    r->headers_out.content_type_lowcase = NULL;
+
+    sum = ngx_pcalloc(r->pool, (mmcf->entities.nelts + 1)
+                               * sizeof(ngx_http_metrics_counters_t));
+    if (sum == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    tsum = ngx_pcalloc(r->pool, (mmcf->nzones + 1)
+                                * sizeof(ngx_http_metrics_timings_t));
+    if (tsum == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    ngx_http_metrics_sum(mmcf, sum, tsum);
+
+    size = sizeof("{\"server_zones\":{},\"upstreams\":{}}\n") - 1
+           + 32 * NGX_HTTP_METRICS_LINE_LEN;
+
+    e = mmcf->entities.elts;
+
+    for (i = 0; i < mmcf->entities.nelts; i++) {
+        size += NGX_HTTP_METRICS_LINES
+                * (NGX_HTTP_METRICS_LINE_LEN
+                   + 6 * (e[i].zone.len + e[i].peer.len));
+    }
+
+    for (i = 0; i < mmcf->nzones; i++) {
+        size += NGX_HTTP_METRICS_TIMINGS * (NGX_HTTP_METRICS_BUCKETS + 3)
+                * (NGX_HTTP_METRICS_LINE_LEN + 6 * e[i].zone.len);
+    }
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    if (mlcf->format == NGX_HTTP_METRICS_JSON) {
+        b->last = ngx_http_metrics_json(b->last, mmcf, sum, tsum);
+
+    } else {
+        b->last = ngx_http_metrics_prometheus(b->last, mmcf, sum, tsum);
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static void
+ngx_http_metrics_sum(ngx_http_metrics_main_conf_t *mmcf,
+    ngx_http_metrics_counters_t *sum, ngx_http_metrics_timings_t *tsum)
+{
+    ngx_uint_t                    w, i, k;
+    ngx_http_metrics_timings_t   *t;
+    ngx_http_metrics_counters_t  *c, *s;
+
+    if (mmcf->slots == NULL) {
+        return;
+    }
+
+    /* the counters are updated concurrently, and read without locks */
+
+    for (w = 0; w < mmcf->workers; w++) {
+        c = (ngx_http_metrics_counters_t *) (mmcf->slots
+                                             + w * mmcf->slot_size);
+
+        for (i = 0; i < mmcf->entities.nelts; i++) {
+            s = &sum[i];
+
+            s->requests += c[i].requests;
+
+            for (k = 0; k < 5; k++) {
+                s->responses[k] += c[i].responses[k];
+            }
+
+            s->received += c[i].received;
+            s->sent += c[i].sent;
+
+            ngx_http_metrics_sum_histogram(&s->time, &c[i].time);
+        }
+
+        t = (ngx_http_metrics_timings_t *) ((u_char *) c + mmcf->timings);
+
+        for (i = 0; i < mmcf->nzones; i++) {
+            for (k = 0; k < NGX_HTTP_METRICS_TIMINGS; k++) {
+                ngx_http_metrics_sum_histogram(&tsum[i].time[k],
+                                               &t[i].time[k]);
+            }
+        }
+    }
+}
+
+
+static void
+ngx_http_metrics_sum_histogram(ngx_event_histogram_t *s,
+    ngx_event_histogram_t *h)
+{
+    ngx_uint_t  n;
+
+    s->count += h->count;
+    s->sum += h->sum;
+
+    if (h->max > s->max) {
+        s->max = h->max;
+    }
+
+    for (n = 0; n < NGX_EVENT_STATS_BUCKETS; n++) {
+        s->bucket[n] += h->bucket[n];
+    }
+}
+
+
+static u_char *
+ngx_http_metrics_prometheus(u_char *p, ngx_http_metrics_main_conf_t *mmcf,
+    ngx_http_metrics_counters_t *sum, ngx_http_metrics_timings_t *tsum)
+{
+    char                       *prefix;
+    u_char                      name[64];
+    ngx_uint_t                  i, k, type, first, last;
+    ngx_http_metrics_entity_t  *e;
+
+    e = mmcf->entities.elts;
+
+    for (type = 0; type < 2; type++) {
+
+        if (type == 0) {
+            prefix = "nginx_http_server_zone";
+            first = 0;
+            last = mmcf->nzones;
+
+        } else {
+            prefix = "nginx_http_upstream_peer";
+            first = mmcf->nzones;
+            last = mmcf->entities.nelts;
+        }
+
+        if (first == last) {
+            continue;
+        }
+
+        p = ngx_sprintf(p, "# TYPE %s_requests_total counter\n", prefix);
+
+        for (i = first; i < last; i++) {
+            p = ngx_sprintf(p, "%s_requests_total", prefix);
+            p = ngx_http_metrics_prometheus_labels(p, &e[i]);
+            p = ngx_sprintf(p, "} %uA\n", sum[i].requests);
+        }
+
+        p = ngx_sprintf(p, "# TYPE %s_responses_total counter\n", prefix);
+
+        for (i = first; i < last; i++) {
+            for (k = 0; k < 5; k++) {
+                p = ngx_sprintf(p, "%s_responses_total", prefix);
+                p = ngx_http_metrics_prometheus_labels(p, &e[i]);
+                p = ngx_sprintf(p, ",code=\"%uixx\"} %uA\n",
+                                k + 1, sum[i].responses[k]);
+            }
+        }
+
+        p = ngx_sprintf(p, "# TYPE %s_received_bytes_total counter\n",
+                        prefix);
+
+        for (i = first; i < last; i++) {
+            p = ngx_sprintf(p, "%s_received_bytes_total", prefix);
+            p = ngx_http_metrics_prometheus_labels(p, &e[i]);
+            p = ngx_sprintf(p, "} %uA\n", sum[i].received);
+        }
+
+        p = ngx_sprintf(p, "# TYPE %s_sent_bytes_total counter\n", prefix);
+
+        for (i = first; i < last; i++) {
+            p = ngx_sprintf(p, "%s_sent_bytes_total", prefix);
+            p = ngx_http_metrics_prometheus_labels(p, &e[i]);
+            p = ngx_sprintf(p, "} %uA\n", sum[i].sent);
+        }
+
+        p = ngx_sprintf(p, "# TYPE %s_duration_seconds histogram\n",
+                        prefix);
+
+        ngx_sprintf(name, "%s_duration_seconds%Z", prefix);
+
+        for (i = first; i < last; i++) {
+            p = ngx_http_metrics_prometheus_histogram(p, (char *) name, &e[i],
+                                                      NULL, &sum[i].time);
+        }
+    }
+
+    if (mmcf->nzones == 0) {
+        return p;
+    }
+
+    p = ngx_sprintf(p, "# TYPE nginx_http_server_zone_phase_duration_seconds "
+                    "histogram\n");
+
+    for (i = 0; i < mmcf->nzones; i++) {
+        for (k = 0; k < NGX_HTTP_METRICS_TIMINGS; k++) {
+            p = ngx_http_metrics_prometheus_histogram(p,
+                          "nginx_http_server_zone_phase_duration_seconds",
+                          &e[i], &ngx_http_metrics_timings[k].name,
+                          &tsum[i].time[k]);
+        }
+    }
+
+    return p;
+}
+
+
+static u_char *
+ngx_http_metrics_prometheus_histogram(u_char *p, char *name,
+    ngx_http_metrics_entity_t *e, ngx_str_t *phase, ngx_event_histogram_t *h)
+{
+    ngx_uint_t         b, n;
+    ngx_atomic_uint_t  count;
+
+    count = 0;
+    b = 0;
+
+    for (n = 0; n <= NGX_HTTP_METRICS_BUCKETS; n++) {
+
+        p = ngx_sprintf(p, "%s_bucket", name);
+        p = ngx_http_metrics_prometheus_labels(p, e);
+
+        if (phase) {
+            p = ngx_sprintf(p, ",phase=\"%V\"", phase);
+        }
+
+        if (n == NGX_HTTP_METRICS_BUCKETS) {
+            p = ngx_sprintf(p, ",le=\"+Inf\"} %uA\n", h->count);
+            break;
+        }
+
+        /* values below 2^n milliseconds */
+
+        while (b < NGX_EVENT_STATS_BUCKETS
+               && ngx_event_histogram_value(b) < ((uint64_t) 1 << n))
+        {
+            count += h->bucket[b++];
+        }
+
+        p = ngx_sprintf(p, ",le=\"%ui.%03ui\"} %uA\n",
+                        ((ngx_uint_t) 1 << n) / 1000,
+                        ((ngx_uint_t) 1 << n) % 1000, count);
+    }
+
+    p = ngx_sprintf(p, "%s_sum", name);
+    p = ngx_http_metrics_prometheus_labels(p, e);
+
+    if (phase) {
+        p = ngx_sprintf(p, ",phase=\"%V\"", phase);
+    }
+
+    p = ngx_sprintf(p, "} %uA.%03uA\n", h->sum / 1000, h->sum % 1000);
+
+    p = ngx_sprintf(p, "%s_count", name);
+    p = ngx_http_metrics_prometheus_labels(p, e);
+
+    if (phase) {
+        p = ngx_sprintf(p, ",phase=\"%V\"", phase);
+    }
+
+    p = ngx_sprintf(p, "} %uA\n", h->count);
+
+    return p;
+}
+
+
+static u_char *
+ngx_http_metrics_prometheus_labels(u_char *p, ngx_http_metrics_entity_t *e)
+{
+    if (e->peer.len == 0) {
+        p = ngx_cpymem(p, "{zone=\"", sizeof("{zone=\"") - 1);
+        p = ngx_http_metrics_escape(p, &e->zone);
+        *p++ = '"';
+
+        return p;
+    }
+
+    p = ngx_cpymem(p, "{upstream=\"", sizeof("{upstream=\"") - 1);
+    p = ngx_http_metrics_escape(p, &e->zone);
+    p = ngx_cpymem(p, "\",peer=\"", sizeof("\",peer=\"") - 1);
+    p = ngx_http_metrics_escape(p, &e->peer);
+    *p++ = '"';
+
+    return p;
+}
+
+
+static u_char *
+ngx_http_metrics_json(u_char *p, ngx_http_metrics_main_conf_t *mmcf,
+    ngx_http_metrics_counters_t *sum, ngx_http_metrics_timings_t *tsum)
+{
+    ngx_uint_t                    i, k;
+    ngx_http_metrics_entity_t    *e;
+    ngx_http_metrics_upstream_t  *mu;
+
+    e = mmcf->entities.elts;
+
+    p = ngx_cpymem(p, "{\"server_zones\":{", sizeof("{\"server_zones\":{") - 1);
+
+    for (i = 0; i < mmcf->nzones; i++) {
+        if (i) {
+            *p++ = ',';
+        }
+
+        *p++ = '"';
+        p = ngx_http_metrics_escape(p, &e[i].zone);
+        p = ngx_cpymem(p, "\":", 2);
+        p = ngx_http_metrics_json_counters(p, &sum[i], "request_time");
+
+        p = ngx_cpymem(p, ",\"timings\":{", sizeof(",\"timings\":{") - 1);
+
+        for (k = 0; k < NGX_HTTP_METRICS_TIMINGS; k++) {
+            if (k) {
+                *p++ = ',';
+            }
+
+            p = ngx_http_metrics_json_histogram(p,
+                                            &ngx_http_metrics_timings[k].name,
+                                            &tsum[i].time[k]);
+        }
+
+        p = ngx_cpymem(p, "}}", 2);
+    }
+
+    p = ngx_cpymem(p, "},\"upstreams\":{", sizeof("},\"upstreams\":{") - 1);
+
+    mu = mmcf->upstreams.elts;
+
+    for (i = 0; i < mmcf->upstreams.nelts; i++) {
+        if (i) {
+            *p++ = ',';
+        }
+
+        *p++ = '"';
+        p = ngx_http_metrics_escape(p, &mu[i].peers[0].zone);
+        p = ngx_cpymem(p, "\":{\"peers\":[", sizeof("\":{\"peers\":[") - 1);
+
+        for (k = 0; k < mu[i].npeers; k++) {
+            if (k) {
+                *p++ = ',';
+            }
+
+            p = ngx_cpymem(p, "{\"server\":\"", sizeof("{\"server\":\"") - 1);
+            p = ngx_http_metrics_escape(p, &mu[i].peers[k].peer);
+            p = ngx_cpymem(p, "\",\"stats\":", sizeof("\",\"stats\":") - 1);
+            p = ngx_http_metrics_json_counters(p, &sum[mu[i].index + k],
+                                               "response_time");
+            p = ngx_cpymem(p, "}}", 2);
+        }
+
+        p = ngx_cpymem(p, "]}", 2);
+    }
+
+    p = ngx_cpymem(p, "}}\n", 3);
+
+    return p;
+}
+
+
+static u_char *
+ngx_http_metrics_json_counters(u_char *p, ngx_http_metrics_counters_t *c,
+    char *time)
+{
+    ngx_str_t  name;
+
+    /* the object is left open */
+
+    p = ngx_sprintf(p, "{\"requests\":%uA,\"responses\":{\"1xx\":%uA,"
+                    "\"2xx\":%uA,\"3xx\":%uA,\"4xx\":%uA,\"5xx\":%uA},"
+                    "\"received\":%uA,\"sent\":%uA,",
+                    c->requests, c->responses[0], c->responses[1],
+                    c->responses[2], c->responses[3], c->responses[4],
+                    c->received, c->sent);
+
+    name.len = ngx_strlen(time);
+    name.data = (u_char *) time;
+
+    return ngx_http_metrics_json_histogram(p, &name, &c->time);
+}
+
+
+static u_char *
+ngx_http_metrics_json_histogram(u_char *p, ngx_str_t *name,
+    ngx_event_histogram_t *h)
+{
+    return ngx_sprintf(p, "\"%V\":{\"count\":%uA,\"sum\":%uA,\"max\":%uA,"
+                       "\"p50\":%uL,\"p90\":%uL,\"p99\":%uL}",
+                       name, h->count, h->sum, h->max,
+                       ngx_event_histogram_percentile(h, 50),
+                       ngx_event_histogram_percentile(h, 90),
+                       ngx_event_histogram_percentile(h, 99));
+}
+
+
+static u_char *
+ngx_http_metrics_escape(u_char *p, ngx_str_t *s)
+{
+    /* JSON escaping is also valid for Prometheus label values */
+
+    return (u_char *) ngx_escape_json(p, s->data, s->len);
+}
+
+
+static void *
+ngx_http_metrics_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    mmcf = ngx_pcalloc(cf->pool, sizeof(ngx_http_metrics_main_conf_t));
+    if (mmcf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     mmcf->nzones = 0;
+     *     mmcf->slots = NULL;
+     *     mmcf->shm_zone = NULL;
+     *     mmcf->enabled = 0;
+     */
+
+    if (ngx_array_init(&mmcf->entities, cf->pool, 4,
+                       sizeof(ngx_http_metrics_entity_t))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    if (ngx_array_init(&mmcf->upstreams, cf->pool, 4,
+                       sizeof(ngx_http_metrics_upstream_t))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    return mmcf;
+}
+
+
+static void *
+ngx_http_metrics_create_srv_conf(ngx_conf_t *cf)
+{
+    ngx_http_metrics_srv_conf_t  *mscf;
+
+    mscf = ngx_palloc(cf->pool, sizeof(ngx_http_metrics_srv_conf_t));
+    if (mscf == NULL) {
+        return NULL;
+    }
+
+    mscf->zone = NGX_CONF_UNSET_UINT;
+
+    return mscf;
+}
+
+
+static void *
+ngx_http_metrics_create_loc_conf(ngx_conf_t *cf)
+{
+    ngx_http_metrics_loc_conf_t  *mlcf;
+
+    mlcf = ngx_palloc(cf->pool, sizeof(ngx_http_metrics_loc_conf_t));
+    if (mlcf == NULL) {
+        return NULL;
+    }
+
+    mlcf->format = NGX_CONF_UNSET_UINT;
+
+    return mlcf;
+}
+
+
+static char *
+ngx_http_metrics_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
+{
+    ngx_http_metrics_loc_conf_t *prev = parent;
+    ngx_http_metrics_loc_conf_t *conf = child;
+
+    ngx_conf_merge_uint_value(conf->format, prev->format,
+                              NGX_HTTP_METRICS_PROMETHEUS);
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_metrics_status_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_metrics_srv_conf_t *mscf = conf;
+
+    ngx_str_t                     *value;
+    ngx_uint_t                     i;
+    ngx_http_metrics_entity_t     *e;
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    if (mscf->zone != NGX_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (value[1].len == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid status zone name \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    mmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_metrics_module);
+
+    mmcf->enabled = 1;
+
+    e = mmcf->entities.elts;
+
+    for (i = 0; i < mmcf->entities.nelts; i++) {
+        if (e[i].zone.len == value[1].len
+            && ngx_strncmp(e[i].zone.data, value[1].data, value[1].len) == 0)
+        {
+            mscf->zone = i;
+            return NGX_CONF_OK;
+        }
+    }
+
+    e = ngx_array_push(&mmcf->entities);
+    if (e == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    e->zone = value[1];
+    ngx_str_null(&e->peer);
+
+    mscf->zone = i;
+    mmcf->nzones++;
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_metrics(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_metrics_loc_conf_t *mlcf = conf;
+
+    ngx_http_core_loc_conf_t      *clcf;
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    if (mlcf->format != NGX_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    if (cf->args->nelts == 2) {
+        if (ngx_conf_set_enum_slot(cf, cmd, conf) != NGX_CONF_OK) {
+            return NGX_CONF_ERROR;
+        }
+
+    } else {
+        mlcf->format = NGX_HTTP_METRICS_PROMETHEUS;
+    }
+
+    mmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_metrics_module);
+    mmcf->enabled = 1;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_metrics_handler;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_metrics_init(ngx_conf_t *cf)
+{
+    ngx_core_conf_t               *ccf;
+    ngx_http_handler_pt           *h;
+    ngx_http_core_main_conf_t     *cmcf;
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    mmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_metrics_module);
+
+    if (!mmcf->enabled) {
+        return NGX_OK;
+    }
+
+    if (ngx_http_metrics_init_upstreams(cf, mmcf) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (mmcf->entities.nelts == 0) {
+        return NGX_OK;
+    }
+
+    /*
+     * the counters are sharded into per-worker slots, so they are updated
+     * without atomic operations; worker_processes is expected to precede
+     * the http block, and this is checked in ngx_http_metrics_init_module()
+     */
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cf->cycle->conf_ctx,
+                                           ngx_core_module);
+
+    mmcf->workers = (ccf->worker_processes == NGX_CONF_UNSET
+                     || ccf->master == 0)
+                    ? 1 : (ngx_uint_t) ccf->worker_processes;
+
+    mmcf->timings = mmcf->entities.nelts
+                    * sizeof(ngx_http_metrics_counters_t);
+
+    mmcf->slot_size = ngx_align(mmcf->timings
+                                + mmcf->nzones
+                                  * sizeof(ngx_http_metrics_timings_t),
+                                ngx_cacheline_size);
+
+    mmcf->shm_zone = ngx_shared_memory_add(cf, &ngx_http_metrics_zone_name,
+                                           8 * ngx_pagesize
+                                           + ngx_align(mmcf->workers
+                                                       * mmcf->slot_size,
+                                                       ngx_pagesize),
+                                           &ngx_http_metrics_module);
+    if (mmcf->shm_zone == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (mmcf->shm_zone->data) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"",
+                           &ngx_http_metrics_zone_name);
+        return NGX_ERROR;
+    }
+
+    mmcf->shm_zone->init = ngx_http_metrics_init_zone;
+    mmcf->shm_zone->data = mmcf;
+
+    cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
+
+    h = ngx_array_push(&cmcf->phases[NGX_HTTP_LOG_PHASE].handlers);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    *h = ngx_http_metrics_log_handler;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_metrics_init_upstreams(ngx_conf_t *cf,
+    ngx_http_metrics_main_conf_t *mmcf)
+{
+    ngx_uint_t                      i, n;
+    ngx_http_metrics_entity_t      *e;
+    ngx_http_upstream_rr_peer_t    *peer;
+    ngx_http_upstream_rr_peers_t   *peers;
+    ngx_http_metrics_upstream_t    *mu;
+    ngx_http_upstream_srv_conf_t  **uscfp;
+    ngx_http_upstream_main_conf_t  *umcf;
+
+    umcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_upstream_module);
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        /* the upstream{} blocks, balanced with round-robin peers */
+
+        if (!(uscfp[i]->flags & NGX_HTTP_UPSTREAM_CREATE)
+            || uscfp[i]->peer.data == NULL)
+        {
+            continue;
+        }
+
+        n = 0;
+
+        for (peers = uscfp[i]->peer.data; peers; peers = peers->next) {
+            n += peers->number;
+        }
+
+        if (n == 0) {
+            continue;
+        }
+
+        mu = ngx_array_push(&mmcf->upstreams);
+        if (mu == NULL) {
+            return NGX_ERROR;
+        }
+
+        mu->upstream = uscfp[i];
+        mu->index = mmcf->entities.nelts;
+        mu->npeers = 0;
+
+        e = ngx_array_push_n(&mmcf->entities, n);
+        if (e == NULL) {
+            return NGX_ERROR;
+        }
+
+        mu->peers = e;
+
+        /* primary and backup peers */
+
+        for (peers = uscfp[i]->peer.data; peers; peers = peers->next) {
+            for (peer = peers->peer; peer; peer = peer->next) {
+                e[mu->npeers].zone = uscfp[i]->host;
+                e[mu->npeers].peer = peer->name;
+                mu->npeers++;
+            }
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_metrics_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_metrics_main_conf_t  *ommcf = data;
+
+    size_t                         size;
+    ngx_uint_t                     i;
+    ngx_slab_pool_t               *shpool;
+    ngx_http_metrics_entity_t     *e, *oe;
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    mmcf = shm_zone->data;
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    size = mmcf->workers * mmcf->slot_size;
+
+    if (ommcf) {
+
+        /* the counters are kept if the layout is the same */
+
+        if (ommcf->workers == mmcf->workers
+            && ommcf->entities.nelts == mmcf->entities.nelts)
+        {
+            e = mmcf->entities.elts;
+            oe = ommcf->entities.elts;
+
+            for (i = 0; i < mmcf->entities.nelts; i++) {
+                if (e[i].zone.len != oe[i].zone.len
+                    || e[i].peer.len != oe[i].peer.len
+                    || ngx_strncmp(e[i].zone.data, oe[i].zone.data,
+                                   e[i].zone.len) != 0
+                    || ngx_strncmp(e[i].peer.data, oe[i].peer.data,
+                                   e[i].peer.len) != 0)
+                {
+                    break;
+                }
+            }
+
+            if (i == mmcf->entities.nelts) {
+                mmcf->slots = ommcf->slots;
+                return NGX_OK;
+            }
+        }
+
+        ngx_slab_free(shpool, ommcf->slots);
+
+    } else if (shm_zone->shm.exists) {
+        mmcf->slots = shpool->data;
+        return NGX_OK;
+    }
+
+    mmcf->slots = ngx_slab_calloc(shpool, size);
+    if (mmcf->slots == NULL) {
+        return NGX_ERROR;
+    }
+
+    shpool->data = mmcf->slots;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_metrics_init_module(ngx_cycle_t *cycle)
+{
+    ngx_core_conf_t               *ccf;
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    mmcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_metrics_module);
+
+    if (mmcf == NULL || mmcf->shm_zone == NULL) {
+        return NGX_OK;
+    }
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    if (ccf->master && (ngx_uint_t) ccf->worker_processes > mmcf->workers) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "the \"worker_processes\" directive must be specified "
+                      "before the \"http\" block to use metrics");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_metrics_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                     n;
+    ngx_http_metrics_main_conf_t  *mmcf;
+
+    ngx_http_metrics_slot = NULL;
+
+    mmcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_metrics_module);
+
+    if (mmcf == NULL || mmcf->slots == NULL) {
+        return NGX_OK;
+    }
+
+    if (ngx_process == NGX_PROCESS_WORKER) {
+        n = ngx_worker;
+
+    } else if (ngx_process == NGX_PROCESS_SINGLE) {
+        n = 0;
+
+    } else {
+        return NGX_OK;
+    }
+
+    if (n >= mmcf->workers) {
+        return NGX_OK;
+    }
+
+    ngx_http_metrics_slot = (ngx_http_metrics_counters_t *)
+                                (mmcf->slots + n * mmcf->slot_size);
+
+    return NGX_OK;
+}
@@ -11,23 +11,64 @@
 
 
 typedef struct {
-    ngx_array_t  *mirror;
-    ngx_flag_t    request_body;
+    ngx_addr_t                   *addr;
+    ngx_msec_t                    timeout;
+} ngx_http_mirror_detached_t;
+
+
+typedef struct {
+    ngx_array_t                  *mirror;
+    ngx_flag_t                    request_body;
+    ngx_http_mirror_detached_t   *detached;
+    ngx_uint_t                    sample;      /* 1/10000 */
+    ngx_uint_t                    limit;
+    ngx_uint_t                    active;
 } ngx_http_mirror_loc_conf_t;
 
 
 typedef struct {
-    ngx_int_t     status;
+    ngx_int_t                     status;
 } ngx_http_mirror_ctx_t;
 
 
+typedef struct {
+    ngx_http_mirror_loc_conf_t   *conf;
+    ngx_uint_t                    done;        /* unsigned  done:1; */
+} ngx_http_mirror_slot_t;
+
+
+typedef struct {
+    ngx_http_mirror_loc_conf_t   *conf;
+    ngx_peer_connection_t         pc;
+    ngx_buf_t                    *request;
+    ngx_pool_t                   *pool;
+} ngx_http_mirror_peer_t;
+
+
 static ngx_int_t ngx_http_mirror_handler(ngx_http_request_t *r);
 static void ngx_http_mirror_body_handler(ngx_http_request_t *r);
 static ngx_int_t ngx_http_mirror_handler_internal(ngx_http_request_t *r);
+static ngx_uint_t ngx_http_mirror_sampled(ngx_http_mirror_loc_conf_t *mlcf);
+static ngx_int_t ngx_http_mirror_acquire(ngx_http_request_t *r,
+    ngx_http_mirror_loc_conf_t *mlcf, ngx_http_post_subrequest_t **psp);
+static ngx_int_t ngx_http_mirror_done(ngx_http_request_t *r, void *data,
+    ngx_int_t rc);
+static void ngx_http_mirror_cleanup(void *data);
+static void ngx_http_mirror_detach(ngx_http_request_t *r,
+    ngx_http_mirror_loc_conf_t *mlcf);
+static ngx_buf_t *ngx_http_mirror_create_request(ngx_http_request_t *r,
+    ngx_http_mirror_loc_conf_t *mlcf, ngx_pool_t *pool);
+static void ngx_http_mirror_write_handler(ngx_event_t *wev);
+static void ngx_http_mirror_read_handler(ngx_event_t *rev);
+static void ngx_http_mirror_finalize(ngx_http_mirror_peer_t *mp);
 static void *ngx_http_mirror_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_mirror_merge_loc_conf(ngx_conf_t *cf, void *parent,
     void *child);
 static char *ngx_http_mirror(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static char *ngx_http_mirror_detached(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_mirror_sample(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static ngx_int_t ngx_http_mirror_init(ngx_conf_t *cf);
 
 
@@ -47,6 +88,27 @@ static ngx_command_t  ngx_http_mirror_commands[] = {
       offsetof(ngx_http_mirror_loc_conf_t, request_body),
       NULL },
 
+    { ngx_string("mirror_detached"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE12,
+      ngx_http_mirror_detached,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("mirror_sample"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_mirror_sample,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("mirror_limit"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_mirror_loc_conf_t, limit),
+      NULL },
+
       ngx_null_command
 };
 
@@ -95,7 +157,7 @@ ngx_http_mirror_handler(ngx_http_request_t *r)
 
     mlcf = ngx_http_get_module_loc_conf(r, ngx_http_mirror_module);
 
-    if (mlcf->mirror == NULL) {
+    if (mlcf->mirror == NULL && mlcf->detached == NULL) {
         return NGX_DECLINED;
     }
 
@@ -113,10 +175,15 @@ ngx_http_mirror_handler(ngx_http_request_t *r)
             return NGX_ERROR;
         }
 
-        ctx->status = NGX_DONE;
-
         ngx_http_set_ctx(r, ctx, ngx_http_mirror_module);
 
+        if (!ngx_http_mirror_sampled(mlcf)) {
+            ctx->status = NGX_DECLINED;
+            return NGX_DECLINED;
+        }
+
+        ctx->status = NGX_DONE;
+
         rc = ngx_http_read_client_request_body(r, ngx_http_mirror_body_handler);
         if (rc >= NGX_HTTP_SPECIAL_RESPONSE) {
             return rc;
@@ -126,6 +193,10 @@ ngx_http_mirror_handler(ngx_http_request_t *r)
         return NGX_DONE;
     }
 
+    if (!ngx_http_mirror_sampled(mlcf)) {
+        return NGX_DECLINED;
+    }
+
     return ngx_http_mirror_handler_internal(r);
 }
 
@@ -149,17 +220,38 @@ ngx_http_mirror_body_handler(ngx_http_request_t *r)
 static ngx_int_t
 ngx_http_mirror_handler_internal(ngx_http_request_t *r)
 {
+    ngx_int_t                    rc;
     ngx_str_t                   *name;
     ngx_uint_t                   i;
     ngx_http_request_t          *sr;
+    ngx_http_post_subrequest_t  *ps;
     ngx_http_mirror_loc_conf_t  *mlcf;
 
     mlcf = ngx_http_get_module_loc_conf(r, ngx_http_mirror_module);
 
+    if (mlcf->detached) {
+        ngx_http_mirror_detach(r, mlcf);
+    }
+
+    if (mlcf->mirror == NULL) {
+        return NGX_DECLINED;
+    }
+
     name = mlcf->mirror->elts;
 
     for (i = 0; i < mlcf->mirror->nelts; i++) {
-        if (ngx_http_subrequest(r, &name[i], &r->args, &sr, NULL,
+
+        rc = ngx_http_mirror_acquire(r, mlcf, &ps);
+
+        if (rc == NGX_DECLINED) {
+            break;
+        }
+
+        if (rc == NGX_ERROR) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        if (ngx_http_subrequest(r, &name[i], &r->args, &sr, ps,
                                 NGX_HTTP_SUBREQUEST_BACKGROUND)
             != NGX_OK)
         {
@@ -175,6 +267,439 @@ ngx_http_mirror_handler_internal(ngx_http_request_t *r)
 }
 
 
+static ngx_uint_t
+ngx_http_mirror_sampled(ngx_http_mirror_loc_conf_t *mlcf)
+{
+    return mlcf->sample >= 10000
+           || (ngx_uint_t) ngx_random() % 10000 < mlcf->sample;
+}
+
+
+static ngx_int_t
+ngx_http_mirror_acquire(ngx_http_request_t *r,
+    ngx_http_mirror_loc_conf_t *mlcf, ngx_http_post_subrequest_t **psp)
+{
+    ngx_pool_cleanup_t          *cln;
+    ngx_http_mirror_slot_t      *slot;
+    ngx_http_post_subrequest_t  *ps;
+
+    *psp = NULL;
+
+    if (mlcf->limit == 0) {
+        return NGX_OK;
+    }
+
+    if (mlcf->active >= mlcf->limit) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "mirror limit %ui reached", mlcf->limit);
+        return NGX_DECLINED;
+    }
+
+    /*
+     * the slot is released when the subrequest is finalized, and
+     * at the latest, when the main request is freed
+     */
+
+    cln = ngx_pool_cleanup_add(r->pool, sizeof(ngx_http_mirror_slot_t));
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    slot = cln->data;
+    slot->conf = mlcf;
+    slot->done = 0;
+
+    cln->handler = ngx_http_mirror_cleanup;
+
+    ps = ngx_palloc(r->pool, sizeof(ngx_http_post_subrequest_t));
+    if (ps == NULL) {
+        return NGX_ERROR;
+    }
+
+    ps->handler = ngx_http_mirror_done;
+    ps->data = slot;
+
+    mlcf->active++;
+
+    *psp = ps;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_mirror_done(ngx_http_request_t *r, void *data, ngx_int_t rc)
+{
+    ngx_http_mirror_cleanup(data);
+
+    return rc;
+}
+
+
+static void
+ngx_http_mirror_cleanup(void *data)
+{
+    ngx_http_mirror_slot_t  *slot = data;
+
+    if (!slot->done) {
+        slot->done = 1;
+        slot->conf->active--;
+    }
+}
+
+
+static void
+ngx_http_mirror_detach(ngx_http_request_t *r, ngx_http_mirror_loc_conf_t *mlcf)
+{
+    ngx_int_t                  rc;
+    ngx_pool_t                *pool;
+    ngx_connection_t          *c;
+    ngx_http_mirror_peer_t    *mp;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    /*
+     * a detached mirror is a copy of the request sent over a connection
+     * of its own, with its own pool, so it neither holds the client
+     * connection nor delays the main request; the response is discarded
+     */
+
+    if (mlcf->limit && mlcf->active >= mlcf->limit) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "mirror limit %ui reached", mlcf->limit);
+        return;
+    }
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    pool = ngx_create_pool(1024, clcf->error_log);
+    if (pool == NULL) {
+        return;
+    }
+
+    mp = ngx_pcalloc(pool, sizeof(ngx_http_mirror_peer_t));
+    if (mp == NULL) {
+        ngx_destroy_pool(pool);
+        return;
+    }
+
+    mp->conf = mlcf;
+    mp->pool = pool;
+
+    mp->request = ngx_http_mirror_create_request(r, mlcf, pool);
+    if (mp->request == NULL) {
+        ngx_destroy_pool(pool);
+        return;
+    }
+
+    mp->pc.sockaddr = mlcf->detached->addr->sockaddr;
+    mp->pc.socklen = mlcf->detached->addr->socklen;
+    mp->pc.name = &mlcf->detached->addr->name;
+    mp->pc.get = ngx_event_get_peer;
+    mp->pc.log = clcf->error_log;
+    mp->pc.log_error = NGX_ERROR_ERR;
+
+    mlcf->active++;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "mirror detached to %V", mp->pc.name);
+
+    rc = ngx_event_connect_peer(&mp->pc);
+
+    if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
+        ngx_http_mirror_finalize(mp);
+        return;
+    }
+
+    c = mp->pc.connection;
+
+    c->data = mp;
+    c->pool = pool;
+
+    c->write->handler = ngx_http_mirror_write_handler;
+    c->read->handler = ngx_http_mirror_read_handler;
+
+    ngx_add_timer(c->write, mlcf->detached->timeout);
+
+    if (rc == NGX_OK) {
+        ngx_http_mirror_write_handler(c->write);
+    }
+}
+
+
+static ngx_buf_t *
+ngx_http_mirror_create_request(ngx_http_request_t *r,
+    ngx_http_mirror_loc_conf_t *mlcf, ngx_pool_t *pool)
+{
+    off_t              body;
+    size_t             len;
+    ssize_t            n;
+    ngx_buf_t         *b;
+    ngx_uint_t         i, k;
+    ngx_chain_t       *cl;
+    ngx_list_part_t   *part;
+    ngx_table_elt_t   *header;
+
+    static ngx_str_t   hop[] = {
+        ngx_string("Connection"),
+        ngx_string("Keep-Alive"),
+        ngx_string("Content-Length"),
+        ngx_string("Transfer-Encoding"),
+        ngx_string("Expect"),
+        ngx_string("Upgrade"),
+        ngx_null_string
+    };
+
+    len = r->method_name.len + 1 + r->unparsed_uri.len
+          + sizeof(" HTTP/1.0" CRLF "Connection: close" CRLF) - 1
+          + sizeof(CRLF) - 1;
+
+    part = &r->headers_in.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        len += header[i].key.len + sizeof(": ") - 1
+               + header[i].value.len + sizeof(CRLF) - 1;
+    }
+
+    body = -1;
+
+    if (mlcf->request_body
+        && r->request_body
+        && (r->headers_in.content_length_n >= 0 || r->headers_in.chunked))
+    {
+        body = 0;
+
+        for (cl = r->request_body->bufs; cl; cl = cl->next) {
+            body += ngx_buf_size(cl->buf);
+        }
+
+        len += sizeof("Content-Length: " CRLF) - 1 + NGX_OFF_T_LEN
+               + (size_t) body;
+    }
+
+    b = ngx_create_temp_buf(pool, len);
+    if (b == NULL) {
+        return NULL;
+    }
+
+    b->last = ngx_sprintf(b->last, "%V %V HTTP/1.0" CRLF
+                          "Connection: close" CRLF,
+                          &r->method_name, &r->unparsed_uri);
+
+    part = &r->headers_in.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        for (k = 0; hop[k].len; k++) {
+            if (header[i].key.len == hop[k].len
+                && ngx_strncasecmp(header[i].key.data, hop[k].data,
+                                   hop[k].len)
+                   == 0)
+            {
+                break;
+            }
+        }
+
+        if (hop[k].len) {
+            continue;
+        }
+
+        b->last = ngx_sprintf(b->last, "%V: %V" CRLF,
+                              &header[i].key, &header[i].value);
+    }
+
+    if (body >= 0) {
+        b->last = ngx_sprintf(b->last, "Content-Length: %O" CRLF, body);
+    }
+
+    *b->last++ = CR; *b->last++ = LF;
+
+    if (body <= 0) {
+        return b;
+    }
+
+    for (cl = r->request_body->bufs; cl; cl = cl->next) {
+
+        if (!cl->buf->in_file) {
+            b->last = ngx_cpymem(b->last, cl->buf->pos,
+                                 cl->buf->last - cl->buf->pos);
+            continue;
+        }
+
+        n = ngx_read_file(cl->buf->file, b->last,
+                          (size_t) (cl->buf->file_last - cl->buf->file_pos),
+                          cl->buf->file_pos);
+
+        if (n != cl->buf->file_last - cl->buf->file_pos) {
+            ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                          ngx_read_file_n " read only %z of %O from \"%s\"",
+                          n, cl->buf->file_last - cl->buf->file_pos,
+                          cl->buf->file->name.data);
+            return NULL;
+        }
+
+        b->last += n;
+    }
+
+    return b;
+}
+
+
+static void
+ngx_http_mirror_write_handler(ngx_event_t *wev)
+{
+    ssize_t                  n;
+    ngx_buf_t               *b;
+    ngx_connection_t        *c;
+    ngx_http_mirror_peer_t  *mp;
+
+    c = wev->data;
+    mp = c->data;
+    b = mp->request;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, wev->log, 0,
+                   "mirror write handler, timedout:%d", wev->timedout);
+
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "mirror to %V timed out", mp->pc.name);
+        ngx_http_mirror_finalize(mp);
+        return;
+    }
+
+    while (b->pos < b->last) {
+
+        n = c->send(c, b->pos, b->last - b->pos);
+
+        if (n == NGX_AGAIN) {
+            if (ngx_handle_write_event(wev, 0) != NGX_OK) {
+                ngx_http_mirror_finalize(mp);
+            }
+
+            return;
+        }
+
+        if (n == NGX_ERROR) {
+            ngx_http_mirror_finalize(mp);
+            return;
+        }
+
+        b->pos += n;
+    }
+
+    if (wev->timer_set) {
+        ngx_del_timer(wev);
+    }
+
+    wev->handler = ngx_http_empty_handler;
+
+    if (!c->read->timer_set) {
+        ngx_add_timer(c->read, mp->conf->detached->timeout);
+    }
+
+    if (c->read->ready) {
+        ngx_http_mirror_read_handler(c->read);
+        return;
+    }
+
+    if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+        ngx_http_mirror_finalize(mp);
+    }
+}
+
+
+static void
+ngx_http_mirror_read_handler(ngx_event_t *rev)
+{
+    ssize_t                  n;
+    ngx_connection_t        *c;
+    ngx_http_mirror_peer_t  *mp;
+    u_char                   buffer[NGX_HTTP_DISCARD_BUFFER_SIZE];
+
+    c = rev->data;
+    mp = c->data;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, rev->log, 0,
+                   "mirror read handler, timedout:%d", rev->timedout);
+
+    if (rev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "mirror to %V timed out", mp->pc.name);
+        ngx_http_mirror_finalize(mp);
+        return;
+    }
+
+    if (mp->request->pos < mp->request->last) {
+
+        /* the request is still being sent by the write event */
+
+        if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+            ngx_http_mirror_finalize(mp);
+        }
+
+        return;
+    }
+
+    /* the response is read until the mirror closes the connection */
+
+    for ( ;; ) {
+
+        n = c->recv(c, buffer, NGX_HTTP_DISCARD_BUFFER_SIZE);
+
+        if (n == NGX_AGAIN) {
+            if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+                ngx_http_mirror_finalize(mp);
+            }
+
+            return;
+        }
+
+        if (n == NGX_ERROR || n == 0) {
+            ngx_http_mirror_finalize(mp);
+            return;
+        }
+    }
+}
+
+
+static void
+ngx_http_mirror_finalize(ngx_http_mirror_peer_t *mp)
+{
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, mp->pc.log, 0,
+                   "mirror to %V done", mp->pc.name);
+
+    mp->conf->active--;
+
+    if (mp->pc.connection) {
+        ngx_close_connection(mp->pc.connection);
+    }
+
+    ngx_destroy_pool(mp->pool);
+}
+
+
 static void *
 ngx_http_mirror_create_loc_conf(ngx_conf_t *cf)
 {
@@ -185,8 +710,17 @@ ngx_http_mirror_create_loc_conf(ngx_conf_t *cf)
         return NULL;
     }
 
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     mlcf->active = 0;
+     */
+
     mlcf->mirror = NGX_CONF_UNSET_PTR;
     mlcf->request_body = NGX_CONF_UNSET;
+    mlcf->detached = NGX_CONF_UNSET_PTR;
+    mlcf->sample = NGX_CONF_UNSET_UINT;
+    mlcf->limit = NGX_CONF_UNSET_UINT;
 
     return mlcf;
 }
@@ -200,6 +734,9 @@ ngx_http_mirror_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_ptr_value(conf->mirror, prev->mirror, NULL);
     ngx_conf_merge_value(conf->request_body, prev->request_body, 1);
+    ngx_conf_merge_ptr_value(conf->detached, prev->detached, NULL);
+    ngx_conf_merge_uint_value(conf->sample, prev->sample, 10000);
+    ngx_conf_merge_uint_value(conf->limit, prev->limit, 0);
 
     return NGX_CONF_OK;
 }
@@ -245,6 +782,132 @@ ngx_http_mirror(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+static char *
+ngx_http_mirror_detached(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_mirror_loc_conf_t *mlcf = conf;
+
+    ngx_str_t                   *value, s;
+    ngx_url_t                    u;
+    ngx_uint_t                   i;
+    ngx_http_mirror_detached_t  *md;
+
+    if (mlcf->detached != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts != 2) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        mlcf->detached = NULL;
+        return NGX_CONF_OK;
+    }
+
+    md = ngx_pcalloc(cf->pool, sizeof(ngx_http_mirror_detached_t));
+    if (md == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_memzero(&u, sizeof(ngx_url_t));
+
+    u.url = value[1];
+    u.default_port = 80;
+
+    if (ngx_parse_url(cf->pool, &u) != NGX_OK) {
+        if (u.err) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "%s in \"%V\" of the \"mirror_detached\"",
+                               u.err, &u.url);
+        }
+
+        return NGX_CONF_ERROR;
+    }
+
+    if (u.naddrs == 0 || u.uri.len) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid address \"%V\"", &u.url);
+        return NGX_CONF_ERROR;
+    }
+
+    md->addr = &u.addrs[0];
+    md->timeout = 10000;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "timeout=", 8) == 0) {
+
+            s.len = value[i].len - 8;
+            s.data = value[i].data + 8;
+
+            md->timeout = ngx_parse_time(&s, 0);
+
+            if (md->timeout == (ngx_msec_t) NGX_ERROR || md->timeout == 0) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    mlcf->detached = md;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
+static char *
+ngx_http_mirror_sample(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_mirror_loc_conf_t *mlcf = conf;
+
+    ngx_int_t   n;
+    ngx_str_t  *value;
+
+    if (mlcf->sample != NGX_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (value[1].len < 2 || value[1].data[value[1].len - 1] != '%') {
+        goto invalid;
+    }
+
+    n = ngx_atofp(value[1].data, value[1].len - 1, 2);
+
+    if (n == NGX_ERROR || n > 10000) {
+        goto invalid;
+    }
+
+    mlcf->sample = n;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid value \"%V\"", &value[1]);
+
+    return NGX_CONF_ERROR;
+}
+
+
 static ngx_int_t
 ngx_http_mirror_init(ngx_conf_t *cf)
 {
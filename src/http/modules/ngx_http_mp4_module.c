@@ -46,9 +46,38 @@ typedef struct {
     size_t                buffer_size;
     size_t                max_buffer_size;
     ngx_flag_t            start_key_frame;
+    ngx_shm_zone_t       *moov_cache;
 } ngx_http_mp4_conf_t;
 
 
+typedef struct {
+    ngx_rbtree_node_t     node;
+    ngx_queue_t           queue;
+
+    ngx_file_uniq_t       uniq;
+    time_t                mtime;
+    off_t                 size;
+    uint32_t              crc32;
+
+    size_t                len;
+    u_char                data[1];
+} ngx_http_mp4_cache_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t          rbtree;
+    ngx_rbtree_node_t     sentinel;
+    ngx_queue_t           queue;
+} ngx_http_mp4_cache_shctx_t;
+
+
+typedef struct {
+    ngx_http_mp4_cache_shctx_t  *sh;
+    ngx_slab_pool_t             *shpool;
+    size_t                       max_len;
+} ngx_http_mp4_cache_ctx_t;
+
+
 typedef struct {
     u_char                chunk[4];
     u_char                samples[4];
@@ -147,6 +176,8 @@ typedef struct {
 
 typedef struct {
     ngx_file_t            file;
+    ngx_file_uniq_t       uniq;
+    time_t                mtime;
 
     u_char               *buffer;
     u_char               *buffer_start;
@@ -355,7 +386,17 @@ static ngx_int_t ngx_http_mp4_update_co64_atom(ngx_http_mp4_file_t *mp4,
 static void ngx_http_mp4_adjust_co64_atom(ngx_http_mp4_file_t *mp4,
     ngx_http_mp4_trak_t *trak, off_t adjustment);
 
+static ngx_int_t ngx_http_mp4_cache_get(ngx_http_mp4_file_t *mp4,
+    size_t len);
+static void ngx_http_mp4_cache_put(ngx_http_mp4_file_t *mp4, size_t len);
+static ngx_http_mp4_cache_node_t *ngx_http_mp4_cache_lookup(
+    ngx_http_mp4_cache_ctx_t *ctx, ngx_http_mp4_file_t *mp4, uint32_t crc32);
+static ngx_int_t ngx_http_mp4_cache_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+
 static char *ngx_http_mp4(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static char *ngx_http_mp4_moov_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static void *ngx_http_mp4_create_conf(ngx_conf_t *cf);
 static char *ngx_http_mp4_merge_conf(ngx_conf_t *cf, void *parent, void *child);
 
@@ -390,6 +431,13 @@ static ngx_command_t  ngx_http_mp4_commands[] = {
       offsetof(ngx_http_mp4_conf_t, start_key_frame),
       NULL },
 
+    { ngx_string("mp4_moov_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_mp4_moov_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -622,6 +670,8 @@ ngx_http_mp4_handler(ngx_http_request_t *r)
         mp4->file.fd = of.fd;
         mp4->file.name = path;
         mp4->file.log = r->connection->log;
+        mp4->uniq = of.uniq;
+        mp4->mtime = of.mtime;
         mp4->end = of.size;
         mp4->start = (ngx_uint_t) start;
         mp4->length = length;
@@ -1170,7 +1220,7 @@ static ngx_int_t
 ngx_http_mp4_read_moov_atom(ngx_http_mp4_file_t *mp4, uint64_t atom_data_size)
 {
     ngx_int_t             rc;
-    ngx_uint_t            no_mdat;
+    ngx_uint_t            no_mdat, cache;
     ngx_buf_t            *atom;
     ngx_http_mp4_conf_t  *conf;
 
@@ -1194,6 +1244,8 @@ ngx_http_mp4_read_moov_atom(ngx_http_mp4_file_t *mp4, uint64_t atom_data_size)
 
     conf = ngx_http_get_module_loc_conf(mp4->request, ngx_http_mp4_module);
 
+    cache = 0;
+
     if (atom_data_size > mp4->buffer_size) {
 
         if (atom_data_size > conf->max_buffer_size) {
@@ -1211,12 +1263,31 @@ ngx_http_mp4_read_moov_atom(ngx_http_mp4_file_t *mp4, uint64_t atom_data_size)
 
         mp4->buffer_size = (size_t) atom_data_size
                          + NGX_HTTP_MP4_MOOV_BUFFER_EXCESS * no_mdat;
+
+        /*
+         * only moov atoms not fitting into the initial buffer are cached,
+         * smaller ones are read along with the atoms before them
+         */
+
+        if (conf->moov_cache) {
+            rc = ngx_http_mp4_cache_get(mp4, (size_t) atom_data_size);
+
+            if (rc == NGX_ERROR) {
+                return NGX_ERROR;
+            }
+
+            cache = (rc == NGX_DECLINED);
+        }
     }
 
     if (ngx_http_mp4_read(mp4, (size_t) atom_data_size) != NGX_OK) {
         return NGX_ERROR;
     }
 
+    if (cache) {
+        ngx_http_mp4_cache_put(mp4, (size_t) atom_data_size);
+    }
+
     mp4->trak.elts = &mp4->traks;
     mp4->trak.size = sizeof(ngx_http_mp4_trak_t);
     mp4->trak.nalloc = 2;
@@ -3911,6 +3982,241 @@ ngx_http_mp4_adjust_co64_atom(ngx_http_mp4_file_t *mp4,
 }
 
 
+static ngx_int_t
+ngx_http_mp4_cache_get(ngx_http_mp4_file_t *mp4, size_t len)
+{
+    uint32_t                    crc32;
+    ngx_http_mp4_conf_t        *conf;
+    ngx_http_mp4_cache_ctx_t   *ctx;
+    ngx_http_mp4_cache_node_t  *cn;
+
+    conf = ngx_http_get_module_loc_conf(mp4->request, ngx_http_mp4_module);
+
+    ctx = conf->moov_cache->data;
+
+    if (len > ctx->max_len) {
+        return NGX_ABORT;
+    }
+
+    crc32 = ngx_crc32_short(mp4->file.name.data, mp4->file.name.len);
+
+    /*
+     * the cached moov atom is copied, as it is modified in place while
+     * the response is being prepared
+     */
+
+    mp4->buffer = ngx_palloc(mp4->request->pool, mp4->buffer_size);
+    if (mp4->buffer == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    cn = ngx_http_mp4_cache_lookup(ctx, mp4, crc32);
+
+    if (cn == NULL || cn->len != len) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+        mp4->buffer_start = mp4->buffer;
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, mp4->file.log, 0,
+                       "mp4 moov cache miss: %uz", len);
+
+        return NGX_DECLINED;
+    }
+
+    ngx_queue_remove(&cn->queue);
+    ngx_queue_insert_head(&ctx->sh->queue, &cn->queue);
+
+    ngx_memcpy(mp4->buffer, cn->data, len);
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, mp4->file.log, 0,
+                   "mp4 moov cache hit: %uz", len);
+
+    mp4->buffer_start = mp4->buffer;
+    mp4->buffer_pos = mp4->buffer;
+    mp4->buffer_end = mp4->buffer + len;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_mp4_cache_put(ngx_http_mp4_file_t *mp4, size_t len)
+{
+    uint32_t                    crc32;
+    ngx_queue_t                *q;
+    ngx_http_mp4_conf_t        *conf;
+    ngx_http_mp4_cache_ctx_t   *ctx;
+    ngx_http_mp4_cache_node_t  *cn;
+
+    conf = ngx_http_get_module_loc_conf(mp4->request, ngx_http_mp4_module);
+
+    ctx = conf->moov_cache->data;
+
+    crc32 = ngx_crc32_short(mp4->file.name.data, mp4->file.name.len);
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+
+    if (ngx_http_mp4_cache_lookup(ctx, mp4, crc32) != NULL) {
+
+        /* added by another worker */
+
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        return;
+    }
+
+    for ( ;; ) {
+        cn = ngx_slab_alloc_locked(ctx->shpool,
+                                   offsetof(ngx_http_mp4_cache_node_t, data)
+                                   + len);
+        if (cn) {
+            break;
+        }
+
+        /* evict the least recently used moov atoms */
+
+        if (ngx_queue_empty(&ctx->sh->queue)) {
+            ngx_shmtx_unlock(&ctx->shpool->mutex);
+            return;
+        }
+
+        q = ngx_queue_last(&ctx->sh->queue);
+        ngx_queue_remove(q);
+
+        cn = ngx_queue_data(q, ngx_http_mp4_cache_node_t, queue);
+
+        ngx_rbtree_delete(&ctx->sh->rbtree, &cn->node);
+        ngx_slab_free_locked(ctx->shpool, cn);
+    }
+
+    cn->node.key = (ngx_rbtree_key_t) mp4->uniq;
+    cn->uniq = mp4->uniq;
+    cn->mtime = mp4->mtime;
+    cn->size = mp4->end;
+    cn->crc32 = crc32;
+    cn->len = len;
+
+    ngx_memcpy(cn->data, mp4->buffer_pos, len);
+
+    ngx_rbtree_insert(&ctx->sh->rbtree, &cn->node);
+    ngx_queue_insert_head(&ctx->sh->queue, &cn->queue);
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, mp4->file.log, 0,
+                   "mp4 moov cache add: %uz", len);
+}
+
+
+static ngx_http_mp4_cache_node_t *
+ngx_http_mp4_cache_lookup(ngx_http_mp4_cache_ctx_t *ctx,
+    ngx_http_mp4_file_t *mp4, uint32_t crc32)
+{
+    ngx_rbtree_key_t            key;
+    ngx_rbtree_node_t          *node, *sentinel;
+    ngx_http_mp4_cache_node_t  *cn;
+
+    key = (ngx_rbtree_key_t) mp4->uniq;
+
+    node = ctx->sh->rbtree.root;
+    sentinel = ctx->sh->rbtree.sentinel;
+
+    while (node != sentinel) {
+
+        if (key < node->key) {
+            node = node->left;
+            continue;
+        }
+
+        if (key > node->key) {
+            node = node->right;
+            continue;
+        }
+
+        /* key == node->key */
+
+        cn = (ngx_http_mp4_cache_node_t *) node;
+
+        if (cn->uniq == mp4->uniq && cn->crc32 == crc32) {
+
+            if (cn->mtime == mp4->mtime && cn->size == mp4->end) {
+                return cn;
+            }
+
+            /* the file was changed */
+
+            ngx_queue_remove(&cn->queue);
+            ngx_rbtree_delete(&ctx->sh->rbtree, node);
+            ngx_slab_free_locked(ctx->shpool, cn);
+
+            return NULL;
+        }
+
+        node = node->right;
+    }
+
+    return NULL;
+}
+
+
+static ngx_int_t
+ngx_http_mp4_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_mp4_cache_ctx_t  *octx = data;
+
+    size_t                     len;
+    ngx_http_mp4_cache_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+
+    ctx->max_len = shm_zone->shm.size / 4;
+
+    if (octx) {
+        ctx->sh = octx->sh;
+        ctx->shpool = octx->shpool;
+
+        return NGX_OK;
+    }
+
+    ctx->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        ctx->sh = ctx->shpool->data;
+
+        return NGX_OK;
+    }
+
+    ctx->sh = ngx_slab_alloc(ctx->shpool, sizeof(ngx_http_mp4_cache_shctx_t));
+    if (ctx->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->shpool->data = ctx->sh;
+
+    ngx_rbtree_init(&ctx->sh->rbtree, &ctx->sh->sentinel,
+                    ngx_rbtree_insert_value);
+
+    ngx_queue_init(&ctx->sh->queue);
+
+    len = sizeof(" in mp4_moov_cache zone \"\"") + shm_zone->shm.name.len;
+
+    ctx->shpool->log_ctx = ngx_slab_alloc(ctx->shpool, len);
+    if (ctx->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(ctx->shpool->log_ctx, " in mp4_moov_cache zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    ctx->shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
 static char *
 ngx_http_mp4(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -3936,6 +4242,7 @@ ngx_http_mp4_create_conf(ngx_conf_t *cf)
     conf->buffer_size = NGX_CONF_UNSET_SIZE;
     conf->max_buffer_size = NGX_CONF_UNSET_SIZE;
     conf->start_key_frame = NGX_CONF_UNSET;
+    conf->moov_cache = NGX_CONF_UNSET_PTR;
 
     return conf;
 }
@@ -3951,6 +4258,85 @@ ngx_http_mp4_merge_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_size_value(conf->max_buffer_size, prev->max_buffer_size,
                               10 * 1024 * 1024);
     ngx_conf_merge_value(conf->start_key_frame, prev->start_key_frame, 0);
+    ngx_conf_merge_ptr_value(conf->moov_cache, prev->moov_cache, NULL);
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_mp4_moov_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_mp4_conf_t *mcf = conf;
+
+    u_char                    *p;
+    ssize_t                    size;
+    ngx_str_t                 *value, name, s;
+    ngx_shm_zone_t            *shm_zone;
+    ngx_http_mp4_cache_ctx_t  *ctx;
+
+    if (mcf->moov_cache != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        mcf->moov_cache = NULL;
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strncmp(value[1].data, "zone=", 5) != 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.data = value[1].data + 5;
+
+    p = (u_char *) ngx_strchr(name.data, ':');
+
+    if (p == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.len = p - name.data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = ngx_parse_size(&s);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * ngx_pagesize)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &name, size, &ngx_http_mp4_module);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (shm_zone->data == NULL) {
+        ctx = ngx_pcalloc(cf->pool, sizeof(ngx_http_mp4_cache_ctx_t));
+        if (ctx == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        shm_zone->init = ngx_http_mp4_cache_init_zone;
+        shm_zone->data = ctx;
+    }
+
+    mcf->moov_cache = shm_zone;
 
     return NGX_CONF_OK;
 }
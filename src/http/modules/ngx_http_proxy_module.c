@@ -89,6 +89,10 @@ typedef struct {
     ngx_http_proxy_headers_t       headers;
 #if (NGX_HTTP_CACHE)
     ngx_http_proxy_headers_t       headers_cache;
+#endif
+#if (NGX_HTTP_GRPC)
+    ngx_http_proxy_headers_t       headers_v2;
+    ngx_uint_t                     host_set;
 #endif
     ngx_array_t                   *headers_source;
 
@@ -148,6 +152,10 @@ typedef struct {
 
 static ngx_int_t ngx_http_proxy_eval(ngx_http_request_t *r,
     ngx_http_proxy_ctx_t *ctx, ngx_http_proxy_loc_conf_t *plcf);
+#if (NGX_HTTP_GRPC)
+static ngx_int_t ngx_http_proxy_v2_init(ngx_http_request_t *r,
+    ngx_http_proxy_ctx_t *ctx, ngx_http_proxy_loc_conf_t *plcf);
+#endif
 #if (NGX_HTTP_CACHE)
 static ngx_int_t ngx_http_proxy_create_key(ngx_http_request_t *r);
 #endif
@@ -222,6 +230,8 @@ static char *ngx_http_proxy_store(ngx_conf_t *cf, ngx_command_t *cmd,
 #if (NGX_HTTP_CACHE)
 static char *ngx_http_proxy_cache(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_proxy_cache_peer(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static char *ngx_http_proxy_cache_key(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 #endif
@@ -291,6 +301,9 @@ static ngx_conf_post_t  ngx_http_proxy_ssl_conf_command_post =
 static ngx_conf_enum_t  ngx_http_proxy_http_version[] = {
     { ngx_string("1.0"), NGX_HTTP_VERSION_10 },
     { ngx_string("1.1"), NGX_HTTP_VERSION_11 },
+#if (NGX_HTTP_GRPC)
+    { ngx_string("2"), NGX_HTTP_VERSION_20 },
+#endif
     { ngx_null_string, 0 }
 };
 
@@ -356,6 +369,17 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.buffering),
       NULL },
 
+#if (NGX_HAVE_SPLICE)
+
+    { ngx_string("proxy_splice"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.splice),
+      NULL },
+
+#endif
+
     { ngx_string("proxy_request_buffering"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
       ngx_conf_set_flag_slot,
@@ -384,6 +408,13 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.socket_keepalive),
       NULL },
 
+    { ngx_string("proxy_fastopen"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.fastopen),
+      NULL },
+
     { ngx_string("proxy_connect_timeout"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_msec_slot,
@@ -547,6 +578,27 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.no_cache),
       NULL },
 
+    { ngx_string("proxy_cache_purge"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_http_set_predicate_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_purge),
+      NULL },
+
+    { ngx_string("proxy_cache_peer"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE12,
+      ngx_http_proxy_cache_peer,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("proxy_cache_tag_header"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_str_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_tag_header),
+      NULL },
+
     { ngx_string("proxy_cache_valid"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
       ngx_http_file_cache_valid_set_slot,
@@ -603,6 +655,13 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_lock_age),
       NULL },
 
+    { ngx_string("proxy_cache_lock_stream"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_lock_stream),
+      NULL },
+
     { ngx_string("proxy_cache_revalidate"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
       ngx_conf_set_flag_slot,
@@ -624,6 +683,13 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_background_update),
       NULL },
 
+    { ngx_string("proxy_cache_write_back"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_set_complex_value_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.cache_write_back),
+      NULL },
+
 #endif
 
     { ngx_string("proxy_temp_path"),
@@ -668,6 +734,20 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
       offsetof(ngx_http_proxy_loc_conf_t, upstream.next_upstream_timeout),
       NULL },
 
+    { ngx_string("proxy_connect_attempt_delay"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.connect_attempt_delay),
+      NULL },
+
+    { ngx_string("proxy_hedge_delay"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_proxy_loc_conf_t, upstream.hedge_delay),
+      NULL },
+
     { ngx_string("proxy_pass_header"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_str_array_slot,
@@ -843,6 +923,23 @@ static ngx_keyval_t  ngx_http_proxy_headers[] = {
 };
 
 
+#if (NGX_HTTP_GRPC)
+
+static ngx_keyval_t  ngx_http_proxy_v2_headers[] = {
+    { ngx_string("Content-Length"), ngx_string("$content_length") },
+    { ngx_string("TE"), ngx_string("$grpc_internal_trailers") },
+    { ngx_string("Host"), ngx_string("") },
+    { ngx_string("Connection"), ngx_string("") },
+    { ngx_string("Transfer-Encoding"), ngx_string("") },
+    { ngx_string("Keep-Alive"), ngx_string("") },
+    { ngx_string("Expect"), ngx_string("") },
+    { ngx_string("Upgrade"), ngx_string("") },
+    { ngx_null_string, ngx_null_string }
+};
+
+#endif
+
+
 static ngx_str_t  ngx_http_proxy_hide_headers[] = {
     ngx_string("Date"),
     ngx_string("Server"),
@@ -1026,11 +1123,21 @@ ngx_http_proxy_handler(ngx_http_request_t *r)
     if (!plcf->upstream.request_buffering
         && plcf->body_values == NULL && plcf->upstream.pass_request_body
         && (!r->headers_in.chunked
-            || plcf->http_version == NGX_HTTP_VERSION_11))
+            || plcf->http_version != NGX_HTTP_VERSION_10))
     {
         r->request_body_no_buffering = 1;
     }
 
+#if (NGX_HTTP_GRPC)
+
+    if (plcf->http_version == NGX_HTTP_VERSION_20) {
+        if (ngx_http_proxy_v2_init(r, ctx, plcf) != NGX_OK) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+#endif
+
     rc = ngx_http_read_client_request_body(r, ngx_http_upstream_init);
 
     if (rc >= NGX_HTTP_SPECIAL_RESPONSE) {
@@ -1143,6 +1250,102 @@ ngx_http_proxy_eval(ngx_http_request_t *r, ngx_http_proxy_ctx_t *ctx,
 }
 
 
+#if (NGX_HTTP_GRPC)
+
+static ngx_int_t
+ngx_http_proxy_v2_init(ngx_http_request_t *r, ngx_http_proxy_ctx_t *ctx,
+    ngx_http_proxy_loc_conf_t *plcf)
+{
+    u_char                   *p;
+    size_t                    len, loc_len;
+    uintptr_t                 escape;
+    ngx_http_upstream_t      *u;
+    ngx_http_grpc_request_t   gr;
+
+    u = r->upstream;
+
+    ngx_memzero(&gr, sizeof(ngx_http_grpc_request_t));
+
+    if (plcf->method) {
+        if (ngx_http_complex_value(r, plcf->method, &gr.method) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    /* the ":path" pseudo-header is the URI of the HTTP/1.x request line */
+
+    if (plcf->proxy_lengths && ctx->vars.uri.len) {
+        gr.path = ctx->vars.uri;
+
+    } else if (ctx->vars.uri.len == 0 && r->valid_unparsed_uri) {
+        gr.path = r->unparsed_uri;
+
+    } else {
+        loc_len = (r->valid_location && ctx->vars.uri.len) ?
+                      plcf->location.len : 0;
+
+        if (r->quoted_uri || r->internal) {
+            escape = 2 * ngx_escape_uri(NULL, r->uri.data + loc_len,
+                                        r->uri.len - loc_len, NGX_ESCAPE_URI);
+        } else {
+            escape = 0;
+        }
+
+        len = ctx->vars.uri.len + r->uri.len - loc_len + escape
+              + sizeof("?") - 1 + r->args.len;
+
+        p = ngx_pnalloc(r->pool, len);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        gr.path.data = p;
+
+        if (r->valid_location) {
+            p = ngx_copy(p, ctx->vars.uri.data, ctx->vars.uri.len);
+        }
+
+        if (escape) {
+            ngx_escape_uri(p, r->uri.data + loc_len,
+                           r->uri.len - loc_len, NGX_ESCAPE_URI);
+            p += r->uri.len - loc_len + escape;
+
+        } else {
+            p = ngx_copy(p, r->uri.data + loc_len, r->uri.len - loc_len);
+        }
+
+        if (r->args.len > 0) {
+            *p++ = '?';
+            p = ngx_copy(p, r->args.data, r->args.len);
+        }
+
+        gr.path.len = p - gr.path.data;
+    }
+
+    if (gr.path.len == 0) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "zero length URI to proxy");
+        return NGX_ERROR;
+    }
+
+    u->uri = gr.path;
+
+    gr.host = ctx->vars.host_header;
+    gr.host_set = plcf->host_set;
+
+    gr.headers_flushes = plcf->headers_v2.flushes;
+    gr.headers_lengths = plcf->headers_v2.lengths;
+    gr.headers_values = plcf->headers_v2.values;
+    gr.headers_hash = &plcf->headers_v2.hash;
+
+    u->buffering = 0;
+
+    return ngx_http_grpc_init_request(r, &gr);
+}
+
+#endif
+
+
 #if (NGX_HTTP_CACHE)
 
 static ngx_int_t
@@ -1377,6 +1580,17 @@ ngx_http_proxy_create_request(ngx_http_request_t *r)
         len += key_len + sizeof(": ") - 1 + val_len + sizeof(CRLF) - 1;
     }
 
+    if (r->upstream_range.len) {
+        len += sizeof("Range: ") - 1 + r->upstream_range.len
+               + sizeof(CRLF) - 1;
+    }
+
+#if (NGX_HTTP_CACHE)
+    if (u->cache_peer) {
+        len += sizeof(NGX_HTTP_UPSTREAM_CACHE_PEER ": 1" CRLF) - 1;
+    }
+#endif
+
 
     if (plcf->upstream.pass_request_headers) {
         part = &r->headers_in.headers.part;
@@ -1400,6 +1614,12 @@ ngx_http_proxy_create_request(ngx_http_request_t *r)
                 continue;
             }
 
+            if (r->upstream_range.len
+                && &header[i] == r->headers_in.range)
+            {
+                continue;
+            }
+
             len += header[i].key.len + sizeof(": ") - 1
                 + header[i].value.len + sizeof(CRLF) - 1;
         }
@@ -1513,6 +1733,25 @@ ngx_http_proxy_create_request(ngx_http_request_t *r)
 
     b->last = e.pos;
 
+    if (r->upstream_range.len) {
+        b->last = ngx_cpymem(b->last, "Range: ", sizeof("Range: ") - 1);
+        b->last = ngx_copy(b->last, r->upstream_range.data,
+                           r->upstream_range.len);
+        *b->last++ = CR; *b->last++ = LF;
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http proxy header: \"Range: %V\"",
+                       &r->upstream_range);
+    }
+
+#if (NGX_HTTP_CACHE)
+    if (u->cache_peer) {
+        b->last = ngx_cpymem(b->last, NGX_HTTP_UPSTREAM_CACHE_PEER ": 1" CRLF,
+                             sizeof(NGX_HTTP_UPSTREAM_CACHE_PEER ": 1" CRLF)
+                             - 1);
+    }
+#endif
+
 
     if (plcf->upstream.pass_request_headers) {
         part = &r->headers_in.headers.part;
@@ -1536,6 +1775,12 @@ ngx_http_proxy_create_request(ngx_http_request_t *r)
                 continue;
             }
 
+            if (r->upstream_range.len
+                && &header[i] == r->headers_in.range)
+            {
+                continue;
+            }
+
             b->last = ngx_copy(b->last, header[i].key.data, header[i].key.len);
 
             *b->last++ = ':'; *b->last++ = ' ';
@@ -1579,6 +1824,9 @@ ngx_http_proxy_create_request(ngx_http_request_t *r)
         if (ctx->internal_chunked) {
             u->output.output_filter = ngx_http_proxy_body_output_filter;
             u->output.filter_ctx = r;
+
+        } else {
+            u->request_splice = 1;
         }
 
     } else if (plcf->body_values == NULL && plcf->upstream.pass_request_body) {
@@ -1965,6 +2213,30 @@ ngx_http_proxy_process_header(ngx_http_request_t *r)
             ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "http proxy header done");
 
+            u = r->upstream;
+
+            if (u->headers_in.status_n >= NGX_HTTP_CONTINUE
+                && u->headers_in.status_n < NGX_HTTP_OK
+                && u->headers_in.status_n != NGX_HTTP_SWITCHING_PROTOCOLS)
+            {
+                /* an interim response, the final one follows */
+
+                if (ngx_http_upstream_process_early_hints(r, u) != NGX_OK) {
+                    return NGX_ERROR;
+                }
+
+                ctx = ngx_http_get_module_ctx(r, ngx_http_proxy_module);
+
+                ctx->status.code = 0;
+                ctx->status.count = 0;
+                ctx->status.start = NULL;
+                ctx->status.end = NULL;
+
+                u->process_header = ngx_http_proxy_process_status_line;
+
+                return ngx_http_proxy_process_status_line(r);
+            }
+
             /*
              * if no "Server" and "Date" in header line,
              * then add the special empty headers
@@ -2001,8 +2273,6 @@ ngx_http_proxy_process_header(ngx_http_request_t *r)
 
             /* clear content length if response is chunked */
 
-            u = r->upstream;
-
             if (u->headers_in.chunked) {
                 u->headers_in.content_length_n = -1;
             }
@@ -2103,6 +2373,8 @@ ngx_http_proxy_input_filter_init(void *data)
 
         u->pipe->length = u->headers_in.content_length_n;
         u->length = u->headers_in.content_length_n;
+
+        u->splice = 1;
     }
 
     return NGX_OK;
@@ -3534,6 +3806,7 @@ ngx_http_proxy_create_loc_conf(ngx_conf_t *cf)
      *     conf->upstream.cache_zone = NULL;
      *     conf->upstream.cache_use_stale = 0;
      *     conf->upstream.cache_methods = 0;
+     *     conf->upstream.cache_tag_header = { 0, NULL };
      *     conf->upstream.temp_path = NULL;
      *     conf->upstream.hide_headers_hash = { NULL, 0 };
      *     conf->upstream.store_lengths = NULL;
@@ -3562,17 +3835,21 @@ ngx_http_proxy_create_loc_conf(ngx_conf_t *cf)
     conf->upstream.store_access = NGX_CONF_UNSET_UINT;
     conf->upstream.next_upstream_tries = NGX_CONF_UNSET_UINT;
     conf->upstream.buffering = NGX_CONF_UNSET;
+    conf->upstream.splice = NGX_CONF_UNSET;
     conf->upstream.request_buffering = NGX_CONF_UNSET;
     conf->upstream.ignore_client_abort = NGX_CONF_UNSET;
     conf->upstream.force_ranges = NGX_CONF_UNSET;
 
     conf->upstream.local = NGX_CONF_UNSET_PTR;
     conf->upstream.socket_keepalive = NGX_CONF_UNSET;
+    conf->upstream.fastopen = NGX_CONF_UNSET;
 
     conf->upstream.connect_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.send_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.read_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.next_upstream_timeout = NGX_CONF_UNSET_MSEC;
+    conf->upstream.hedge_delay = NGX_CONF_UNSET_MSEC;
+    conf->upstream.connect_attempt_delay = NGX_CONF_UNSET_MSEC;
 
     conf->upstream.send_lowat = NGX_CONF_UNSET_SIZE;
     conf->upstream.buffer_size = NGX_CONF_UNSET_SIZE;
@@ -3591,14 +3868,18 @@ ngx_http_proxy_create_loc_conf(ngx_conf_t *cf)
     conf->upstream.cache_min_uses = NGX_CONF_UNSET_UINT;
     conf->upstream.cache_max_range_offset = NGX_CONF_UNSET;
     conf->upstream.cache_bypass = NGX_CONF_UNSET_PTR;
+    conf->upstream.cache_purge = NGX_CONF_UNSET_PTR;
+    conf->upstream.cache_peer = NGX_CONF_UNSET_PTR;
     conf->upstream.no_cache = NGX_CONF_UNSET_PTR;
     conf->upstream.cache_valid = NGX_CONF_UNSET_PTR;
     conf->upstream.cache_lock = NGX_CONF_UNSET;
     conf->upstream.cache_lock_timeout = NGX_CONF_UNSET_MSEC;
     conf->upstream.cache_lock_age = NGX_CONF_UNSET_MSEC;
+    conf->upstream.cache_lock_stream = NGX_CONF_UNSET;
     conf->upstream.cache_revalidate = NGX_CONF_UNSET;
     conf->upstream.cache_convert_head = NGX_CONF_UNSET;
     conf->upstream.cache_background_update = NGX_CONF_UNSET;
+    conf->upstream.cache_write_back = NGX_CONF_UNSET_PTR;
 #endif
 
     conf->upstream.hide_headers = NGX_CONF_UNSET_PTR;
@@ -3681,12 +3962,18 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_uint_value(conf->upstream.store_access,
                               prev->upstream.store_access, 0600);
 
+    ngx_conf_merge_uint_value(conf->http_version, prev->http_version,
+                              NGX_HTTP_VERSION_10);
+
     ngx_conf_merge_uint_value(conf->upstream.next_upstream_tries,
                               prev->upstream.next_upstream_tries, 0);
 
     ngx_conf_merge_value(conf->upstream.buffering,
                               prev->upstream.buffering, 1);
 
+    ngx_conf_merge_value(conf->upstream.splice,
+                              prev->upstream.splice, 0);
+
     ngx_conf_merge_value(conf->upstream.request_buffering,
                               prev->upstream.request_buffering, 1);
 
@@ -3702,6 +3989,9 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->upstream.socket_keepalive,
                               prev->upstream.socket_keepalive, 0);
 
+    ngx_conf_merge_value(conf->upstream.fastopen,
+                              prev->upstream.fastopen, 0);
+
     ngx_conf_merge_msec_value(conf->upstream.connect_timeout,
                               prev->upstream.connect_timeout, 60000);
 
@@ -3714,6 +4004,17 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_msec_value(conf->upstream.next_upstream_timeout,
                               prev->upstream.next_upstream_timeout, 0);
 
+    ngx_conf_merge_msec_value(conf->upstream.hedge_delay,
+                              prev->upstream.hedge_delay, 0);
+
+    ngx_conf_merge_msec_value(conf->upstream.connect_attempt_delay,
+                              prev->upstream.connect_attempt_delay, 0);
+
+    if (conf->http_version == NGX_HTTP_VERSION_20) {
+        /* an HTTP/2 request is bound to its connection */
+        conf->upstream.hedge_delay = 0;
+    }
+
     ngx_conf_merge_size_value(conf->upstream.send_lowat,
                               prev->upstream.send_lowat, 0);
 
@@ -3892,9 +4193,18 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_ptr_value(conf->upstream.cache_bypass,
                              prev->upstream.cache_bypass, NULL);
 
+    ngx_conf_merge_ptr_value(conf->upstream.cache_purge,
+                             prev->upstream.cache_purge, NULL);
+
+    ngx_conf_merge_ptr_value(conf->upstream.cache_peer,
+                             prev->upstream.cache_peer, NULL);
+
     ngx_conf_merge_ptr_value(conf->upstream.no_cache,
                              prev->upstream.no_cache, NULL);
 
+    ngx_conf_merge_str_value(conf->upstream.cache_tag_header,
+                             prev->upstream.cache_tag_header, "");
+
     ngx_conf_merge_ptr_value(conf->upstream.cache_valid,
                              prev->upstream.cache_valid, NULL);
 
@@ -3911,6 +4221,9 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_msec_value(conf->upstream.cache_lock_age,
                               prev->upstream.cache_lock_age, 5000);
 
+    ngx_conf_merge_value(conf->upstream.cache_lock_stream,
+                              prev->upstream.cache_lock_stream, 0);
+
     ngx_conf_merge_value(conf->upstream.cache_revalidate,
                               prev->upstream.cache_revalidate, 0);
 
@@ -3920,6 +4233,9 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->upstream.cache_background_update,
                               prev->upstream.cache_background_update, 0);
 
+    ngx_conf_merge_ptr_value(conf->upstream.cache_write_back,
+                              prev->upstream.cache_write_back, NULL);
+
 #endif
 
     ngx_conf_merge_value(conf->upstream.pass_request_headers,
@@ -4037,9 +4353,6 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_ptr_value(conf->cookie_flags, prev->cookie_flags, NULL);
 
-    ngx_conf_merge_uint_value(conf->http_version, prev->http_version,
-                              NGX_HTTP_VERSION_10);
-
     ngx_conf_merge_uint_value(conf->headers_hash_max_size,
                               prev->headers_hash_max_size, 512);
 
@@ -4113,6 +4426,10 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         conf->headers = prev->headers;
 #if (NGX_HTTP_CACHE)
         conf->headers_cache = prev->headers_cache;
+#endif
+#if (NGX_HTTP_GRPC)
+        conf->headers_v2 = prev->headers_v2;
+        conf->host_set = prev->host_set;
 #endif
     }
 
@@ -4132,6 +4449,50 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         }
     }
 
+#endif
+
+#if (NGX_HTTP_GRPC)
+
+    if (conf->http_version == NGX_HTTP_VERSION_20) {
+
+        if (clcf->handler == ngx_http_proxy_handler) {
+
+            if (conf->upstream.store) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "\"proxy_store\" cannot be used "
+                                   "with \"proxy_http_version 2\"");
+                return NGX_CONF_ERROR;
+            }
+
+#if (NGX_HTTP_CACHE)
+            if (conf->upstream.cache) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "\"proxy_cache\" cannot be used "
+                                   "with \"proxy_http_version 2\"");
+                return NGX_CONF_ERROR;
+            }
+#endif
+
+            if (conf->body_values) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "\"proxy_set_body\" cannot be used "
+                                   "with \"proxy_http_version 2\"");
+                return NGX_CONF_ERROR;
+            }
+        }
+
+        rc = ngx_http_proxy_init_headers(cf, conf, &conf->headers_v2,
+                                         ngx_http_proxy_v2_headers);
+        if (rc != NGX_OK) {
+            return NGX_CONF_ERROR;
+        }
+
+        /* the response is parsed by the grpc module without buffering */
+
+        conf->upstream.change_buffering = 0;
+        conf->upstream.preserve_output = 1;
+    }
+
 #endif
 
     /*
@@ -4145,6 +4506,10 @@ ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         prev->headers = conf->headers;
 #if (NGX_HTTP_CACHE)
         prev->headers_cache = conf->headers_cache;
+#endif
+#if (NGX_HTTP_GRPC)
+        prev->headers_v2 = conf->headers_v2;
+        prev->host_set = conf->host_set;
 #endif
     }
 
@@ -4198,6 +4563,14 @@ ngx_http_proxy_init_headers(ngx_conf_t *cf, ngx_http_proxy_loc_conf_t *conf,
         src = conf->headers_source->elts;
         for (i = 0; i < conf->headers_source->nelts; i++) {
 
+#if (NGX_HTTP_GRPC)
+            if (src[i].key.len == 4
+                && ngx_strncasecmp(src[i].key.data, (u_char *) "Host", 4) == 0)
+            {
+                conf->host_set = 1;
+            }
+#endif
+
             s = ngx_array_push(&headers_merged);
             if (s == NULL) {
                 return NGX_ERROR;
@@ -5039,6 +5412,81 @@ ngx_http_proxy_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+static char *
+ngx_http_proxy_cache_peer(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_proxy_loc_conf_t *plcf = conf;
+
+    ngx_str_t                       *value, s;
+    ngx_url_t                        u;
+    ngx_http_upstream_cache_peer_t  *cp;
+
+    if (plcf->upstream.cache_peer != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts != 2) {
+            return "is invalid";
+        }
+
+        plcf->upstream.cache_peer = NULL;
+        return NGX_CONF_OK;
+    }
+
+    cp = ngx_pcalloc(cf->pool, sizeof(ngx_http_upstream_cache_peer_t));
+    if (cp == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_memzero(&u, sizeof(ngx_url_t));
+
+    u.url = value[1];
+    u.no_resolve = 1;
+
+    cp->upstream = ngx_http_upstream_add(cf, &u, 0);
+    if (cp->upstream == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (cf->args->nelts == 3) {
+
+        if (ngx_strncmp(value[2].data, "self=", 5) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        s.len = value[2].len - 5;
+        s.data = value[2].data + 5;
+
+        ngx_memzero(&u, sizeof(ngx_url_t));
+
+        u.url = s;
+        u.default_port = 80;
+
+        if (ngx_parse_url(cf->pool, &u) != NGX_OK) {
+            if (u.err) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "%s in \"%V\"", u.err, &s);
+            }
+
+            return NGX_CONF_ERROR;
+        }
+
+        cp->self = u.addrs;
+        cp->nself = u.naddrs;
+    }
+
+    plcf->upstream.cache_peer = cp;
+
+    return NGX_CONF_OK;
+}
+
+
 static char *
 ngx_http_proxy_cache_key(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -5154,7 +5602,12 @@ ngx_http_proxy_merge_ssl(ngx_conf_t *cf, ngx_http_proxy_loc_conf_t *conf,
         && conf->ssl_trusted_certificate.data == NULL
         && conf->ssl_crl.data == NULL
         && conf->upstream.ssl_session_reuse == NGX_CONF_UNSET
-        && conf->ssl_conf_commands == NGX_CONF_UNSET_PTR)
+        && conf->ssl_conf_commands == NGX_CONF_UNSET_PTR
+#if (NGX_HTTP_GRPC)
+        && (conf->http_version == NGX_HTTP_VERSION_20)
+           == (prev->http_version == NGX_HTTP_VERSION_20)
+#endif
+       )
     {
         if (prev->upstream.ssl) {
             conf->upstream.ssl = prev->upstream.ssl;
@@ -5217,6 +5670,22 @@ ngx_http_proxy_set_ssl(ngx_conf_t *cf, ngx_http_proxy_loc_conf_t *plcf)
         return NGX_ERROR;
     }
 
+#if (NGX_HTTP_GRPC)
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+
+    if (plcf->http_version == NGX_HTTP_VERSION_20
+        && SSL_CTX_set_alpn_protos(plcf->upstream.ssl->ctx,
+                                   (u_char *) "\x02h2", 3)
+           != 0)
+    {
+        ngx_ssl_error(NGX_LOG_EMERG, cf->log, 0,
+                      "SSL_CTX_set_alpn_protos() failed");
+        return NGX_ERROR;
+    }
+
+#endif
+#endif
+
     if (plcf->upstream.ssl_certificate
         && plcf->upstream.ssl_certificate->value.len)
     {
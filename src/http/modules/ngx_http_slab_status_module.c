@@ -0,0 +1,207 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_SLAB_STATUS_ZONE_LEN                                         \
+    (sizeof("Zone \"\" size  pages  free  largest_free \n") - 1               \
+     + 4 * NGX_ATOMIC_T_LEN)
+
+#define NGX_HTTP_SLAB_STATUS_SLOT_LEN                                         \
+    (sizeof(" slot  total  used  reqs  fails \n") - 1 + 5 * NGX_ATOMIC_T_LEN)
+
+
+static ngx_int_t ngx_http_slab_status_handler(ngx_http_request_t *r);
+static u_char *ngx_http_slab_status_slots(u_char *p, ngx_slab_info_t *info);
+static char *ngx_http_set_slab_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_slab_status_commands[] = {
+
+    { ngx_string("slab_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_set_slab_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_slab_status_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_slab_status_module = {
+    NGX_MODULE_V1,
+    &ngx_http_slab_status_module_ctx,      /* module context */
+    ngx_http_slab_status_commands,         /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_int_t
+ngx_http_slab_status_handler(ngx_http_request_t *r)
+{
+    size_t            size;
+    ngx_int_t         rc;
+    ngx_buf_t        *b;
+    ngx_uint_t        i, n, zones;
+    ngx_chain_t       out;
+    ngx_cycle_t      *cycle;
+    ngx_list_part_t  *part;
+    ngx_shm_zone_t   *shm_zone;
+    ngx_slab_info_t  *info;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    cycle = (ngx_cycle_t *) ngx_cycle;
+
+    zones = 0;
+
+    for (part = &cycle->shared_memory.part; part; part = part->next) {
+        zones += part->nelts;
+    }
+
+    info = ngx_pcalloc(r->pool, (zones ? zones : 1) * sizeof(ngx_slab_info_t));
+    if (info == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    size = 0;
+    n = 0;
+
+    for (part = &cycle->shared_memory.part; part; part = part->next) {
+        shm_zone = part->elts;
+
+        for (i = 0; i < part->nelts; i++) {
+            info[n].stats = ngx_palloc(r->pool,
+                                       ngx_pagesize_shift
+                                       * sizeof(ngx_slab_stat_t));
+            if (info[n].stats == NULL) {
+                return NGX_HTTP_INTERNAL_SERVER_ERROR;
+            }
+
+            ngx_slab_info((ngx_slab_pool_t *) shm_zone[i].shm.addr, &info[n]);
+
+            size += NGX_HTTP_SLAB_STATUS_ZONE_LEN + shm_zone[i].shm.name.len
+                    + info[n].slots * NGX_HTTP_SLAB_STATUS_SLOT_LEN;
+            n++;
+        }
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    b = ngx_create_temp_buf(r->pool, size ? size : 1);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    n = 0;
+
+    for (part = &cycle->shared_memory.part; part; part = part->next) {
+        shm_zone = part->elts;
+
+        for (i = 0; i < part->nelts; i++, n++) {
+            b->last = ngx_sprintf(b->last,
+                                  "Zone \"%V\" size %uz pages %ui free %ui "
+                                  "largest_free %ui\n",
+                                  &shm_zone[i].shm.name, shm_zone[i].shm.size,
+                                  info[n].pages, info[n].free,
+                                  info[n].largest_free);
+
+            b->last = ngx_http_slab_status_slots(b->last, &info[n]);
+        }
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static u_char *
+ngx_http_slab_status_slots(u_char *p, ngx_slab_info_t *info)
+{
+    ngx_uint_t        i;
+    ngx_slab_stat_t  *st;
+
+    for (i = 0; i < info->slots; i++) {
+        st = &info->stats[i];
+
+        if (st->total == 0 && st->reqs == 0) {
+            continue;
+        }
+
+        /* slot i holds chunks of min_size << i bytes */
+
+        p = ngx_sprintf(p, " slot %uz total %ui used %ui reqs %ui fails %ui\n",
+                        ngx_pagesize >> (info->slots - i),
+                        st->total, st->used, st->reqs, st->fails);
+    }
+
+    return p;
+}
+
+
+static char *
+ngx_http_set_slab_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_slab_status_handler;
+
+    return NGX_CONF_OK;
+}
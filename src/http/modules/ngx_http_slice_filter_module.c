@@ -12,18 +12,25 @@
 
 typedef struct {
     size_t               size;
+    ngx_uint_t           prefetch;
+    ngx_flag_t           auto_range;
 } ngx_http_slice_loc_conf_t;
 
 
-typedef struct {
-    off_t                start;
-    off_t                end;
-    ngx_str_t            range;
-    ngx_str_t            etag;
-    unsigned             last:1;
-    unsigned             active:1;
-    ngx_http_request_t  *sr;
-} ngx_http_slice_ctx_t;
+typedef struct ngx_http_slice_ctx_s  ngx_http_slice_ctx_t;
+
+struct ngx_http_slice_ctx_s {
+    off_t                  start;
+    off_t                  end;
+    off_t                  next;
+    ngx_str_t              range;
+    ngx_str_t              etag;
+    unsigned               last:1;
+    unsigned               active:1;
+    unsigned               background:1;
+    ngx_http_request_t    *sr;
+    ngx_http_slice_ctx_t  *prefetch;
+};
 
 
 typedef struct {
@@ -33,9 +40,14 @@ typedef struct {
 } ngx_http_slice_content_range_t;
 
 
+static ngx_int_t ngx_http_slice_handler(ngx_http_request_t *r);
+static ngx_http_slice_ctx_t *ngx_http_slice_create_ctx(ngx_http_request_t *r,
+    ngx_http_slice_loc_conf_t *slcf);
 static ngx_int_t ngx_http_slice_header_filter(ngx_http_request_t *r);
 static ngx_int_t ngx_http_slice_body_filter(ngx_http_request_t *r,
     ngx_chain_t *in);
+static ngx_int_t ngx_http_slice_prefetch(ngx_http_request_t *r,
+    ngx_http_slice_ctx_t *ctx, ngx_http_slice_loc_conf_t *slcf);
 static ngx_int_t ngx_http_slice_parse_content_range(ngx_http_request_t *r,
     ngx_http_slice_content_range_t *cr);
 static ngx_int_t ngx_http_slice_range_variable(ngx_http_request_t *r,
@@ -57,6 +69,20 @@ static ngx_command_t  ngx_http_slice_filter_commands[] = {
       offsetof(ngx_http_slice_loc_conf_t, size),
       NULL },
 
+    { ngx_string("slice_prefetch"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_slice_loc_conf_t, prefetch),
+      NULL },
+
+    { ngx_string("slice_auto"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_slice_loc_conf_t, auto_range),
+      NULL },
+
       ngx_null_command
 };
 
@@ -98,6 +124,74 @@ static ngx_http_output_header_filter_pt  ngx_http_next_header_filter;
 static ngx_http_output_body_filter_pt    ngx_http_next_body_filter;
 
 
+static ngx_int_t
+ngx_http_slice_handler(ngx_http_request_t *r)
+{
+    ngx_http_slice_ctx_t       *ctx;
+    ngx_http_slice_loc_conf_t  *slcf;
+
+    /*
+     * with "slice_auto", the slice range is requested from upstream and
+     * added to the cache key without the $slice_range variable
+     */
+
+    if (r != r->main) {
+        return NGX_DECLINED;
+    }
+
+    ngx_str_null(&r->upstream_range);
+
+    slcf = ngx_http_get_module_loc_conf(r, ngx_http_slice_filter_module);
+
+    if (slcf->size == 0 || !slcf->auto_range) {
+        return NGX_DECLINED;
+    }
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_slice_filter_module);
+
+    if (ctx == NULL) {
+        ctx = ngx_http_slice_create_ctx(r, slcf);
+        if (ctx == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+    r->upstream_range = ctx->range;
+
+    return NGX_DECLINED;
+}
+
+
+static ngx_http_slice_ctx_t *
+ngx_http_slice_create_ctx(ngx_http_request_t *r,
+    ngx_http_slice_loc_conf_t *slcf)
+{
+    u_char                *p;
+    ngx_http_slice_ctx_t  *ctx;
+
+    ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_slice_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ngx_http_set_ctx(r, ctx, ngx_http_slice_filter_module);
+
+    p = ngx_pnalloc(r->pool, sizeof("bytes=-") - 1 + 2 * NGX_OFF_T_LEN);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    ctx->start = slcf->size * (ngx_http_slice_get_start(r) / slcf->size);
+
+    ctx->range.data = p;
+    ctx->range.len = ngx_sprintf(p, "bytes=%O-%O", ctx->start,
+                                 ctx->start + (off_t) slcf->size - 1)
+                     - p;
+
+    return ctx;
+}
+
+
 static ngx_int_t
 ngx_http_slice_header_filter(ngx_http_request_t *r)
 {
@@ -113,6 +207,11 @@ ngx_http_slice_header_filter(ngx_http_request_t *r)
         return ngx_http_next_header_filter(r);
     }
 
+    if (ctx->background) {
+        /* a prefetched slice, only stored in cache */
+        return ngx_http_next_header_filter(r);
+    }
+
     if (r->headers_out.status != NGX_HTTP_PARTIAL_CONTENT) {
         if (r == r->main) {
             ngx_http_set_ctx(r, NULL, ngx_http_slice_filter_module);
@@ -239,7 +338,19 @@ ngx_http_slice_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
     rc = ngx_http_next_body_filter(r, in);
 
-    if (rc == NGX_ERROR || !ctx->last) {
+    if (rc == NGX_ERROR) {
+        return rc;
+    }
+
+    slcf = ngx_http_get_module_loc_conf(r, ngx_http_slice_filter_module);
+
+    if (slcf->prefetch && ctx->active && !r->header_only) {
+        if (ngx_http_slice_prefetch(r, ctx, slcf) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (!ctx->last) {
         return rc;
     }
 
@@ -272,14 +383,16 @@ ngx_http_slice_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
     ngx_http_set_ctx(ctx->sr, ctx, ngx_http_slice_filter_module);
 
-    slcf = ngx_http_get_module_loc_conf(r, ngx_http_slice_filter_module);
-
     ctx->range.len = ngx_sprintf(ctx->range.data, "bytes=%O-%O", ctx->start,
                                  ctx->start + (off_t) slcf->size - 1)
                      - ctx->range.data;
 
     ctx->active = 0;
 
+    if (slcf->auto_range) {
+        ctx->sr->upstream_range = ctx->range;
+    }
+
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                    "http slice subrequest: \"%V\"", &ctx->range);
 
@@ -287,6 +400,92 @@ ngx_http_slice_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 }
 
 
+static ngx_int_t
+ngx_http_slice_prefetch(ngx_http_request_t *r, ngx_http_slice_ctx_t *ctx,
+    ngx_http_slice_loc_conf_t *slcf)
+{
+    off_t                  end;
+    u_char                *p;
+    ngx_uint_t             i;
+    ngx_http_slice_ctx_t  *pctx;
+
+    /*
+     * the slices following the one being sent are fetched in background
+     * subrequests, which only store them in cache; as the next slice is
+     * requested once the previous one is sent, no more than "slice_prefetch"
+     * slices are prefetched ahead of the client
+     */
+
+    end = ngx_min(ctx->start + (off_t) (slcf->prefetch * slcf->size),
+                  ctx->end);
+
+    if (ctx->next < ctx->start) {
+        ctx->next = ctx->start;
+    }
+
+    if (ctx->next >= end) {
+        return NGX_OK;
+    }
+
+    if (ctx->prefetch == NULL) {
+        ctx->prefetch = ngx_pcalloc(r->pool, slcf->prefetch
+                                             * sizeof(ngx_http_slice_ctx_t));
+        if (ctx->prefetch == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    for (i = 0; i < slcf->prefetch && ctx->next < end; i++) {
+        pctx = &ctx->prefetch[i];
+
+        if (pctx->sr && !pctx->sr->done) {
+            continue;
+        }
+
+        if (pctx->range.data == NULL) {
+            p = ngx_pnalloc(r->pool,
+                            sizeof("bytes=-") - 1 + 2 * NGX_OFF_T_LEN);
+            if (p == NULL) {
+                return NGX_ERROR;
+            }
+
+            pctx->range.data = p;
+            pctx->background = 1;
+        }
+
+        if (ngx_http_subrequest(r, &r->uri, &r->args, &pctx->sr, NULL,
+                                NGX_HTTP_SUBREQUEST_CLONE
+                                |NGX_HTTP_SUBREQUEST_BACKGROUND)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        pctx->sr->header_only = 1;
+
+        ngx_http_set_ctx(pctx->sr, pctx, ngx_http_slice_filter_module);
+
+        pctx->start = ctx->next;
+        pctx->range.len = ngx_sprintf(pctx->range.data, "bytes=%O-%O",
+                                      ctx->next,
+                                      ctx->next + (off_t) slcf->size - 1)
+                          - pctx->range.data;
+
+        ctx->next += slcf->size;
+
+        if (slcf->auto_range) {
+            pctx->sr->upstream_range = pctx->range;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http slice prefetch subrequest: \"%V\"",
+                       &pctx->range);
+    }
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_slice_parse_content_range(ngx_http_request_t *r,
     ngx_http_slice_content_range_t *cr)
@@ -395,7 +594,6 @@ static ngx_int_t
 ngx_http_slice_range_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
 {
-    u_char                     *p;
     ngx_http_slice_ctx_t       *ctx;
     ngx_http_slice_loc_conf_t  *slcf;
 
@@ -414,24 +612,10 @@ ngx_http_slice_range_variable(ngx_http_request_t *r,
             return NGX_OK;
         }
 
-        ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_slice_ctx_t));
+        ctx = ngx_http_slice_create_ctx(r, slcf);
         if (ctx == NULL) {
             return NGX_ERROR;
         }
-
-        ngx_http_set_ctx(r, ctx, ngx_http_slice_filter_module);
-
-        p = ngx_pnalloc(r->pool, sizeof("bytes=-") - 1 + 2 * NGX_OFF_T_LEN);
-        if (p == NULL) {
-            return NGX_ERROR;
-        }
-
-        ctx->start = slcf->size * (ngx_http_slice_get_start(r) / slcf->size);
-
-        ctx->range.data = p;
-        ctx->range.len = ngx_sprintf(p, "bytes=%O-%O", ctx->start,
-                                     ctx->start + (off_t) slcf->size - 1)
-                         - p;
     }
 
     v->data = ctx->range.data;
@@ -504,6 +688,8 @@ ngx_http_slice_create_loc_conf(ngx_conf_t *cf)
     }
 
     slcf->size = NGX_CONF_UNSET_SIZE;
+    slcf->prefetch = NGX_CONF_UNSET_UINT;
+    slcf->auto_range = NGX_CONF_UNSET;
 
     return slcf;
 }
@@ -516,6 +702,12 @@ ngx_http_slice_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_http_slice_loc_conf_t *conf = child;
 
     ngx_conf_merge_size_value(conf->size, prev->size, 0);
+    ngx_conf_merge_uint_value(conf->prefetch, prev->prefetch, 0);
+    ngx_conf_merge_value(conf->auto_range, prev->auto_range, 0);
+
+    if (conf->size) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
 
     return NGX_CONF_OK;
 }
@@ -540,6 +732,18 @@ ngx_http_slice_add_variables(ngx_conf_t *cf)
 static ngx_int_t
 ngx_http_slice_init(ngx_conf_t *cf)
 {
+    ngx_http_handler_pt        *h;
+    ngx_http_core_main_conf_t  *cmcf;
+
+    cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
+
+    h = ngx_array_push(&cmcf->phases[NGX_HTTP_PRECONTENT_PHASE].handlers);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    *h = ngx_http_slice_handler;
+
     ngx_http_next_header_filter = ngx_http_top_header_filter;
     ngx_http_top_header_filter = ngx_http_slice_header_filter;
 
@@ -18,17 +18,66 @@
 
 
 typedef struct {
-    ngx_flag_t    enable;
-    ngx_flag_t    silent_errors;
-    ngx_flag_t    ignore_recycled_buffers;
-    ngx_flag_t    last_modified;
+    ngx_rbtree_t                rbtree;
+    ngx_rbtree_node_t           sentinel;
+    ngx_queue_t                 queue;
 
-    ngx_hash_t    types;
+    ngx_uint_t                  current;
+    ngx_uint_t                  max;
+    time_t                      inactive;
+} ngx_http_ssi_cache_t;
 
-    size_t        min_file_chunk;
-    size_t        value_len;
 
-    ngx_array_t  *types_keys;
+typedef struct {
+    size_t                      saved;
+    off_t                       start;
+    off_t                       end;
+    off_t                       pos;
+
+    ngx_int_t                   rc;
+
+    ngx_uint_t                  key;
+    ngx_str_t                   command;
+    ngx_table_elt_t            *params;
+    ngx_uint_t                  nparams;
+} ngx_http_ssi_segment_t;
+
+
+typedef struct {
+    ngx_str_node_t              sn;
+    ngx_queue_t                 queue;
+
+    ngx_file_uniq_t             uniq;
+    time_t                      mtime;
+    off_t                       size;
+    size_t                      value_len;
+
+    time_t                      accessed;
+    ngx_uint_t                  count;
+
+    ngx_array_t                 segments;
+
+    ngx_http_ssi_cache_t       *cache;
+    ngx_pool_t                 *pool;
+
+    unsigned                    cached:1;
+} ngx_http_ssi_template_t;
+
+
+typedef struct {
+    ngx_flag_t             enable;
+    ngx_flag_t             silent_errors;
+    ngx_flag_t             ignore_recycled_buffers;
+    ngx_flag_t             last_modified;
+
+    ngx_hash_t             types;
+
+    size_t                 min_file_chunk;
+    size_t                 value_len;
+
+    ngx_http_ssi_cache_t  *cache;
+
+    ngx_array_t           *types_keys;
 } ngx_http_ssi_loc_conf_t;
 
 
@@ -76,6 +125,19 @@ static void ngx_http_ssi_buffered(ngx_http_request_t *r,
     ngx_http_ssi_ctx_t *ctx);
 static ngx_int_t ngx_http_ssi_parse(ngx_http_request_t *r,
     ngx_http_ssi_ctx_t *ctx);
+static ngx_int_t ngx_http_ssi_replay(ngx_http_request_t *r,
+    ngx_http_ssi_ctx_t *ctx);
+static ngx_int_t ngx_http_ssi_record(ngx_http_request_t *r,
+    ngx_http_ssi_ctx_t *ctx, ngx_int_t rc);
+static ngx_int_t ngx_http_ssi_cache_lookup(ngx_http_request_t *r,
+    ngx_http_ssi_ctx_t *ctx, ngx_http_ssi_cache_t *cache);
+static void ngx_http_ssi_cache_insert(ngx_http_request_t *r,
+    ngx_http_ssi_ctx_t *ctx);
+static void ngx_http_ssi_cache_expire(ngx_http_ssi_cache_t *cache,
+    ngx_uint_t n);
+static void ngx_http_ssi_cache_delete(ngx_http_ssi_cache_t *cache,
+    ngx_http_ssi_template_t *t);
+static void ngx_http_ssi_cache_cleanup(void *data);
 static ngx_str_t *ngx_http_ssi_get_variable(ngx_http_request_t *r,
     ngx_str_t *name, ngx_uint_t key);
 static ngx_int_t ngx_http_ssi_evaluate_string(ngx_http_request_t *r,
@@ -115,6 +177,8 @@ static char *ngx_http_ssi_init_main_conf(ngx_conf_t *cf, void *conf);
 static void *ngx_http_ssi_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_ssi_merge_loc_conf(ngx_conf_t *cf,
     void *parent, void *child);
+static char *ngx_http_ssi_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static ngx_int_t ngx_http_ssi_filter_init(ngx_conf_t *cf);
 
 
@@ -170,6 +234,13 @@ static ngx_command_t  ngx_http_ssi_filter_commands[] = {
       offsetof(ngx_http_ssi_loc_conf_t, last_modified),
       NULL },
 
+    { ngx_string("ssi_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_http_ssi_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -366,6 +437,12 @@ ngx_http_ssi_header_filter(ngx_http_request_t *r)
     ngx_str_set(&ctx->errmsg,
                 "[an error occurred while processing the directive]");
 
+    if (slcf->cache && !r->filter_need_in_memory) {
+        if (ngx_http_ssi_cache_lookup(r, ctx, slcf->cache) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
     r->filter_need_in_memory = 1;
 
     if (r == r->main) {
@@ -503,7 +580,12 @@ ngx_http_ssi_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
             ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "saved: %uz state: %ui", ctx->saved, ctx->state);
 
-            rc = ngx_http_ssi_parse(r, ctx);
+            if (ctx->replay) {
+                rc = ngx_http_ssi_replay(r, ctx);
+
+            } else {
+                rc = ngx_http_ssi_parse(r, ctx);
+            }
 
             ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "parse: %i, looked: %uz %p-%p",
@@ -513,6 +595,10 @@ ngx_http_ssi_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
                 return rc;
             }
 
+            if (ctx->record && ngx_http_ssi_record(r, ctx, rc) != NGX_OK) {
+                return NGX_ERROR;
+            }
+
             if (ctx->copy_start != ctx->copy_end) {
 
                 if (ctx->output) {
@@ -929,6 +1015,15 @@ ngx_http_ssi_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
             }
         }
 
+        if (ngx_buf_in_memory(ctx->buf)) {
+            ctx->offset += ctx->buf->last - ctx->buf->pos;
+        }
+
+        if (ctx->record && (ctx->buf->last_buf || ctx->buf->last_in_chain)) {
+            ngx_http_ssi_cache_insert(r, ctx);
+            ctx->record = 0;
+        }
+
         ctx->buf = NULL;
 
         ctx->saved = ctx->looked;
@@ -1583,6 +1678,453 @@ ngx_http_ssi_parse(ngx_http_request_t *r, ngx_http_ssi_ctx_t *ctx)
 }
 
 
+static ngx_int_t
+ngx_http_ssi_replay(ngx_http_request_t *r, ngx_http_ssi_ctx_t *ctx)
+{
+    off_t                     offset, last, start, end;
+    ngx_uint_t                i;
+    ngx_table_elt_t          *param;
+    ngx_http_ssi_segment_t   *seg;
+    ngx_http_ssi_template_t  *t;
+
+    t = ctx->tmpl;
+
+    offset = ctx->offset + (ctx->pos - ctx->buf->pos);
+    last = ctx->offset + (ctx->buf->last - ctx->buf->pos);
+
+    if (ctx->segment == t->segments.nelts) {
+
+        /* an incomplete command at the end of the template */
+
+        ctx->pos = ctx->buf->last;
+        return NGX_AGAIN;
+    }
+
+    seg = (ngx_http_ssi_segment_t *) t->segments.elts + ctx->segment;
+
+    start = ngx_max(offset, seg->start);
+    end = ngx_min(last, seg->end);
+
+    if (start < end) {
+        ctx->copy_start = ctx->buf->pos + (start - ctx->offset);
+        ctx->copy_end = ctx->buf->pos + (end - ctx->offset);
+
+        if (start == seg->start) {
+            ctx->saved = seg->saved;
+        }
+    }
+
+    if (seg->pos > last) {
+        ctx->pos = ctx->buf->last;
+        return NGX_AGAIN;
+    }
+
+    ctx->pos = ctx->buf->pos + (seg->pos - ctx->offset);
+    ctx->segment++;
+
+    if (seg->rc != NGX_OK) {
+        return seg->rc;
+    }
+
+    ctx->key = seg->key;
+    ctx->command = seg->command;
+    ctx->params.nelts = 0;
+
+    for (i = 0; i < seg->nparams; i++) {
+
+        param = ngx_array_push(&ctx->params);
+        if (param == NULL) {
+            return NGX_ERROR;
+        }
+
+        param->key = seg->params[i].key;
+
+        /* command handlers may modify parameter values in place */
+
+        param->value.len = seg->params[i].value.len;
+        param->value.data = ngx_pnalloc(r->pool, param->value.len + 1);
+        if (param->value.data == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(param->value.data, seg->params[i].value.data,
+                   param->value.len);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_ssi_record(ngx_http_request_t *r, ngx_http_ssi_ctx_t *ctx,
+    ngx_int_t rc)
+{
+    off_t                     start, end;
+    ngx_uint_t                i;
+    ngx_table_elt_t          *param;
+    ngx_http_ssi_segment_t   *seg;
+    ngx_http_ssi_template_t  *t;
+
+    t = ctx->tmpl;
+
+    seg = NULL;
+
+    if (t->segments.nelts) {
+        seg = (ngx_http_ssi_segment_t *) t->segments.elts
+              + t->segments.nelts - 1;
+
+        if (seg->rc != NGX_AGAIN) {
+            seg = NULL;
+        }
+    }
+
+    if (ctx->copy_start != ctx->copy_end) {
+
+        start = ctx->offset + (ctx->copy_start - ctx->buf->pos);
+        end = ctx->offset + (ctx->copy_end - ctx->buf->pos);
+
+        if (seg && seg->end == start && ctx->saved == 0) {
+            seg->end = end;
+            seg->pos = end;
+
+        } else {
+            seg = ngx_array_push(&t->segments);
+            if (seg == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_memzero(seg, sizeof(ngx_http_ssi_segment_t));
+
+            seg->saved = ctx->saved;
+            seg->start = start;
+            seg->end = end;
+            seg->pos = end;
+            seg->rc = NGX_AGAIN;
+        }
+    }
+
+    if (rc == NGX_AGAIN) {
+        return NGX_OK;
+    }
+
+    if (seg == NULL) {
+        seg = ngx_array_push(&t->segments);
+        if (seg == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memzero(seg, sizeof(ngx_http_ssi_segment_t));
+
+        seg->start = ctx->offset + (ctx->pos - ctx->buf->pos);
+        seg->end = seg->start;
+    }
+
+    seg->pos = ctx->offset + (ctx->pos - ctx->buf->pos);
+    seg->rc = rc;
+
+    if (rc != NGX_OK) {
+        return NGX_OK;
+    }
+
+    seg->key = ctx->key;
+
+    seg->command.len = ctx->command.len;
+    seg->command.data = ngx_pstrdup(t->pool, &ctx->command);
+    if (seg->command.data == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (ctx->params.nelts == 0) {
+        return NGX_OK;
+    }
+
+    seg->params = ngx_palloc(t->pool,
+                             ctx->params.nelts * sizeof(ngx_table_elt_t));
+    if (seg->params == NULL) {
+        return NGX_ERROR;
+    }
+
+    param = ctx->params.elts;
+
+    for (i = 0; i < ctx->params.nelts; i++) {
+
+        seg->params[i].key.len = param[i].key.len;
+        seg->params[i].key.data = ngx_pstrdup(t->pool, &param[i].key);
+        if (seg->params[i].key.data == NULL) {
+            return NGX_ERROR;
+        }
+
+        seg->params[i].value.len = param[i].value.len;
+        seg->params[i].value.data = ngx_pstrdup(t->pool, &param[i].value);
+        if (seg->params[i].value.data == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    seg->nparams = ctx->params.nelts;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_ssi_cache_lookup(ngx_http_request_t *r, ngx_http_ssi_ctx_t *ctx,
+    ngx_http_ssi_cache_t *cache)
+{
+    size_t                     root;
+    u_char                    *last;
+    uint32_t                   hash;
+    ngx_str_t                  path;
+    ngx_pool_t                *pool;
+    ngx_pool_cleanup_t        *cln;
+    ngx_open_file_info_t       of;
+    ngx_http_ssi_template_t   *t;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    /*
+     * only the unmodified static files are cached: the validators
+     * must match the file, and no filter before us changes the body
+     */
+
+    if (r->headers_out.status != NGX_HTTP_OK
+        || r->headers_out.last_modified_time == -1
+        || r->headers_out.content_length_n <= 0)
+    {
+        return NGX_OK;
+    }
+
+    last = ngx_http_map_uri_to_path(r, &path, &root, 0);
+    if (last == NULL) {
+        return NGX_ERROR;
+    }
+
+    path.len = last - path.data;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    ngx_memzero(&of, sizeof(ngx_open_file_info_t));
+
+    of.test_only = 1;
+    of.valid = clcf->open_file_cache_valid;
+    of.min_uses = clcf->open_file_cache_min_uses;
+    of.errors = clcf->open_file_cache_errors;
+    of.events = clcf->open_file_cache_events;
+
+    if (ngx_http_set_disable_symlinks(r, clcf, &path, &of) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_open_cached_file(clcf->open_file_cache, &path, &of, r->pool)
+        != NGX_OK)
+    {
+        return NGX_OK;
+    }
+
+    if (!of.is_file
+        || of.mtime != r->headers_out.last_modified_time
+        || of.size != r->headers_out.content_length_n)
+    {
+        return NGX_OK;
+    }
+
+    cln = ngx_pool_cleanup_add(r->pool, 0);
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    hash = ngx_crc32_long(path.data, path.len);
+
+    t = (ngx_http_ssi_template_t *) ngx_str_rbtree_lookup(&cache->rbtree,
+                                                          &path, hash);
+
+    if (t) {
+        if (t->uniq == of.uniq
+            && t->mtime == of.mtime
+            && t->size == of.size
+            && t->value_len == ctx->value_len)
+        {
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "http ssi cache hit: \"%V\"", &path);
+
+            t->count++;
+            t->accessed = ngx_time();
+
+            ngx_queue_remove(&t->queue);
+            ngx_queue_insert_head(&cache->queue, &t->queue);
+
+            cln->handler = ngx_http_ssi_cache_cleanup;
+            cln->data = t;
+
+            ctx->tmpl = t;
+            ctx->replay = 1;
+
+            return NGX_OK;
+        }
+
+        ngx_http_ssi_cache_delete(cache, t);
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http ssi cache miss: \"%V\"", &path);
+
+    pool = ngx_create_pool(1024, ngx_cycle->log);
+    if (pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    t = ngx_pcalloc(pool, sizeof(ngx_http_ssi_template_t));
+    if (t == NULL) {
+        ngx_destroy_pool(pool);
+        return NGX_ERROR;
+    }
+
+    t->sn.node.key = hash;
+    t->sn.str.len = path.len;
+    t->sn.str.data = ngx_pstrdup(pool, &path);
+    if (t->sn.str.data == NULL) {
+        ngx_destroy_pool(pool);
+        return NGX_ERROR;
+    }
+
+    if (ngx_array_init(&t->segments, pool, 16, sizeof(ngx_http_ssi_segment_t))
+        != NGX_OK)
+    {
+        ngx_destroy_pool(pool);
+        return NGX_ERROR;
+    }
+
+    t->uniq = of.uniq;
+    t->mtime = of.mtime;
+    t->size = of.size;
+    t->value_len = ctx->value_len;
+    t->count = 1;
+    t->cache = cache;
+    t->pool = pool;
+
+    cln->handler = ngx_http_ssi_cache_cleanup;
+    cln->data = t;
+
+    ctx->tmpl = t;
+    ctx->record = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_ssi_cache_insert(ngx_http_request_t *r, ngx_http_ssi_ctx_t *ctx)
+{
+    ngx_http_ssi_cache_t     *cache;
+    ngx_http_ssi_template_t  *t, *old;
+
+    t = ctx->tmpl;
+    cache = t->cache;
+
+    if (ctx->offset != t->size) {
+        return;
+    }
+
+    old = (ngx_http_ssi_template_t *) ngx_str_rbtree_lookup(&cache->rbtree,
+                                                            &t->sn.str,
+                                                            t->sn.node.key);
+
+    if (old) {
+        if (old->uniq == t->uniq
+            && old->mtime == t->mtime
+            && old->size == t->size
+            && old->value_len == t->value_len)
+        {
+            /* the template was compiled by a concurrent request */
+            return;
+        }
+
+        ngx_http_ssi_cache_delete(cache, old);
+    }
+
+    ngx_http_ssi_cache_expire(cache, 1);
+
+    if (cache->current >= cache->max) {
+        ngx_http_ssi_cache_expire(cache, 0);
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http ssi cache add: \"%V\" %ui segments",
+                   &t->sn.str, t->segments.nelts);
+
+    ngx_rbtree_insert(&cache->rbtree, &t->sn.node);
+    ngx_queue_insert_head(&cache->queue, &t->queue);
+
+    t->accessed = ngx_time();
+    t->cached = 1;
+
+    cache->current++;
+}
+
+
+static void
+ngx_http_ssi_cache_expire(ngx_http_ssi_cache_t *cache, ngx_uint_t n)
+{
+    time_t                    now;
+    ngx_queue_t              *q;
+    ngx_http_ssi_template_t  *t;
+
+    now = ngx_time();
+
+    /*
+     * n == 1 deletes one or two inactive templates
+     * n == 0 deletes least recently used template by force
+     *        and one or two inactive templates
+     */
+
+    while (n < 3) {
+
+        if (ngx_queue_empty(&cache->queue)) {
+            return;
+        }
+
+        q = ngx_queue_last(&cache->queue);
+
+        t = ngx_queue_data(q, ngx_http_ssi_template_t, queue);
+
+        if (n++ != 0 && now - t->accessed <= cache->inactive) {
+            return;
+        }
+
+        ngx_http_ssi_cache_delete(cache, t);
+    }
+}
+
+
+static void
+ngx_http_ssi_cache_delete(ngx_http_ssi_cache_t *cache,
+    ngx_http_ssi_template_t *t)
+{
+    ngx_queue_remove(&t->queue);
+    ngx_rbtree_delete(&cache->rbtree, &t->sn.node);
+
+    cache->current--;
+
+    t->cached = 0;
+
+    if (t->count == 0) {
+        ngx_destroy_pool(t->pool);
+    }
+}
+
+
+static void
+ngx_http_ssi_cache_cleanup(void *data)
+{
+    ngx_http_ssi_template_t  *t = data;
+
+    t->count--;
+
+    if (t->count == 0 && !t->cached) {
+        ngx_destroy_pool(t->pool);
+    }
+}
+
+
 static ngx_str_t *
 ngx_http_ssi_get_variable(ngx_http_request_t *r, ngx_str_t *name,
     ngx_uint_t key)
@@ -2920,6 +3462,8 @@ ngx_http_ssi_create_loc_conf(ngx_conf_t *cf)
     slcf->min_file_chunk = NGX_CONF_UNSET_SIZE;
     slcf->value_len = NGX_CONF_UNSET_SIZE;
 
+    slcf->cache = NGX_CONF_UNSET_PTR;
+
     return slcf;
 }
 
@@ -2932,6 +3476,10 @@ ngx_http_ssi_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_value(conf->enable, prev->enable, 0);
     ngx_conf_merge_value(conf->silent_errors, prev->silent_errors, 0);
+
+    if (conf->enable) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
     ngx_conf_merge_value(conf->ignore_recycled_buffers,
                          prev->ignore_recycled_buffers, 0);
     ngx_conf_merge_value(conf->last_modified, prev->last_modified, 0);
@@ -2939,6 +3487,8 @@ ngx_http_ssi_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_size_value(conf->min_file_chunk, prev->min_file_chunk, 1024);
     ngx_conf_merge_size_value(conf->value_len, prev->value_len, 255);
 
+    ngx_conf_merge_ptr_value(conf->cache, prev->cache, NULL);
+
     if (ngx_http_merge_types(cf, &conf->types_keys, &conf->types,
                              &prev->types_keys, &prev->types,
                              ngx_http_html_default_types)
@@ -2951,6 +3501,95 @@ ngx_http_ssi_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 }
 
 
+static char *
+ngx_http_ssi_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_ssi_loc_conf_t *slcf = conf;
+
+    time_t                 inactive;
+    ngx_str_t             *value, s;
+    ngx_int_t              max;
+    ngx_uint_t             i;
+    ngx_http_ssi_cache_t  *cache;
+
+    if (slcf->cache != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    max = 0;
+    inactive = 60;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "max=", 4) == 0) {
+
+            max = ngx_atoi(value[i].data + 4, value[i].len - 4);
+            if (max <= 0) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "inactive=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            inactive = ngx_parse_time(&s, 1);
+            if (inactive == (time_t) NGX_ERROR) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "off") == 0) {
+
+            slcf->cache = NULL;
+
+            continue;
+        }
+
+    failed:
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid \"ssi_cache\" parameter \"%V\"",
+                           &value[i]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (slcf->cache == NULL) {
+        return NGX_CONF_OK;
+    }
+
+    if (max == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"ssi_cache\" must have the \"max\" parameter");
+        return NGX_CONF_ERROR;
+    }
+
+    cache = ngx_pcalloc(cf->pool, sizeof(ngx_http_ssi_cache_t));
+    if (cache == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_rbtree_init(&cache->rbtree, &cache->sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&cache->queue);
+
+    cache->max = max;
+    cache->inactive = inactive;
+
+    slcf->cache = cache;
+
+    return NGX_CONF_OK;
+}
+
+
 static ngx_int_t
 ngx_http_ssi_filter_init(ngx_conf_t *cf)
 {
@@ -65,6 +65,10 @@ typedef struct {
     ngx_list_t               *variables;
     ngx_array_t              *blocks;
 
+    off_t                     offset;
+    void                     *tmpl;
+    ngx_uint_t                segment;
+
 #if (NGX_PCRE)
     ngx_uint_t                ncaptures;
     int                      *captures;
@@ -77,6 +81,8 @@ typedef struct {
     unsigned                  block:1;
     unsigned                  output:1;
     unsigned                  output_chosen:1;
+    unsigned                  record:1;
+    unsigned                  replay:1;
 
     ngx_http_request_t       *wait;
     void                     *value_buf;
@@ -20,6 +20,9 @@ typedef struct {
     ngx_flag_t                      prefer_server_ciphers;
     ngx_flag_t                      early_data;
     ngx_flag_t                      reject_handshake;
+    ngx_flag_t                      async;
+    ngx_flag_t                      ktls;
+    ngx_flag_t                      certificate_compression;
 
     ngx_uint_t                      protocols;
 
@@ -27,6 +30,8 @@ typedef struct {
     ngx_uint_t                      verify_depth;
 
     size_t                          buffer_size;
+    ngx_flag_t                      dynamic_records;
+    size_t                          dynamic_records_threshold;
 
     ssize_t                         builtin_session_cache;
 
@@ -45,6 +50,7 @@ typedef struct {
     ngx_str_t                       crl;
 
     ngx_str_t                       ciphers;
+    ngx_str_t                       stats;
 
     ngx_array_t                    *passwords;
     ngx_array_t                    *conf_commands;
@@ -53,15 +59,19 @@ typedef struct {
 
     ngx_flag_t                      session_tickets;
     ngx_array_t                    *session_ticket_keys;
+    time_t                          session_ticket_key_rotation;
 
     ngx_uint_t                      ocsp;
     ngx_str_t                       ocsp_responder;
     ngx_shm_zone_t                 *ocsp_cache_zone;
 
+    ngx_shm_zone_t                 *certificate_cache;
+
     ngx_flag_t                      stapling;
     ngx_flag_t                      stapling_verify;
     ngx_str_t                       stapling_file;
     ngx_str_t                       stapling_responder;
+    ngx_shm_zone_t                 *stapling_cache;
 } ngx_http_ssl_srv_conf_t;
 
 
@@ -0,0 +1,221 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_SSL_STATUS_GROUP_LEN  32
+
+#define NGX_HTTP_SSL_STATUS_LEN                                               \
+    (sizeof(" handshakes  failed  reused_cache  reused_ticket \n") - 1        \
+     + 4 * NGX_ATOMIC_T_LEN                                                   \
+     + sizeof(" protocols") - 1                                               \
+     + NGX_SSL_STATS_PROTOCOLS * (sizeof(" TLSv1.1 ") - 1 + NGX_ATOMIC_T_LEN) \
+     + sizeof(" groups \n") - 1                                               \
+     + (NGX_SSL_STATS_GROUPS + 1) * (NGX_HTTP_SSL_STATUS_GROUP_LEN + 2        \
+                                     + NGX_ATOMIC_T_LEN)                      \
+     + 2 * (sizeof("latency_msec") - 1 + NGX_EVENT_HISTOGRAM_LEN))
+
+
+static ngx_int_t ngx_http_ssl_status_handler(ngx_http_request_t *r);
+static u_char *ngx_http_ssl_status_group(u_char *p, ngx_atomic_uint_t nid);
+static char *ngx_http_set_ssl_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_ssl_status_commands[] = {
+
+    { ngx_string("ssl_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_set_ssl_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_ssl_status_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_ssl_status_module = {
+    NGX_MODULE_V1,
+    &ngx_http_ssl_status_module_ctx,       /* module context */
+    ngx_http_ssl_status_commands,          /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static char  *ngx_http_ssl_status_protocols[] = {
+    "TLSv1", "TLSv1.1", "TLSv1.2", "TLSv1.3", "other"
+};
+
+
+static ngx_int_t
+ngx_http_ssl_status_handler(ngx_http_request_t *r)
+{
+    size_t                 size;
+    ngx_int_t              rc;
+    ngx_buf_t             *b;
+    ngx_str_t             *name;
+    ngx_uint_t             i, k;
+    ngx_chain_t            out;
+    ngx_ssl_stats_t       *st;
+    ngx_ssl_stats_zone_t  *sz;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    sz = ngx_ssl_stats_zone((ngx_cycle_t *) ngx_cycle);
+
+    if (sz == NULL) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "SSL statistics are disabled, "
+                      "see the \"ssl_stats\" directive");
+        return NGX_HTTP_SERVICE_UNAVAILABLE;
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    name = sz->names.elts;
+
+    size = 0;
+
+    for (i = 0; i < sz->names.nelts; i++) {
+        size += sizeof("Server \n") - 1 + name[i].len
+                + NGX_HTTP_SSL_STATUS_LEN;
+    }
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    for (i = 0; i < sz->names.nelts; i++) {
+        st = &sz->stats[i];
+
+        b->last = ngx_sprintf(b->last, "Server %V\n", &name[i]);
+
+        b->last = ngx_sprintf(b->last,
+                              " handshakes %uA failed %uA"
+                              " reused_cache %uA reused_ticket %uA\n",
+                              st->handshakes, st->failed,
+                              st->reused_cache, st->reused_ticket);
+
+        b->last = ngx_cpymem(b->last, " protocols", sizeof(" protocols") - 1);
+
+        for (k = 0; k < NGX_SSL_STATS_PROTOCOLS; k++) {
+            b->last = ngx_sprintf(b->last, " %s %uA",
+                                  ngx_http_ssl_status_protocols[k],
+                                  st->protocol[k]);
+        }
+
+        b->last = ngx_cpymem(b->last, "\n groups", sizeof("\n groups") - 1);
+
+        for (k = 0; k < NGX_SSL_STATS_GROUPS; k++) {
+            if (st->group_nid[k] == 0) {
+                break;
+            }
+
+            b->last = ngx_http_ssl_status_group(b->last, st->group_nid[k]);
+            b->last = ngx_sprintf(b->last, " %uA", st->group[k]);
+        }
+
+        b->last = ngx_sprintf(b->last, " other %uA\n",
+                              st->group[NGX_SSL_STATS_GROUPS]);
+
+        b->last = ngx_event_histogram_print(b->last, "latency_msec",
+                                            &st->latency);
+        b->last = ngx_event_histogram_print(b->last, "cpu_usec", &st->cpu);
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static u_char *
+ngx_http_ssl_status_group(u_char *p, ngx_atomic_uint_t nid)
+{
+    size_t       len;
+    const char  *name;
+
+#ifdef TLSEXT_nid_unknown
+    if (nid & TLSEXT_nid_unknown) {
+        return ngx_sprintf(p, " 0x%04xA", nid & 0xffff);
+    }
+#endif
+
+    name = OBJ_nid2sn((int) nid);
+
+    if (name) {
+        len = ngx_min(ngx_strlen(name), NGX_HTTP_SSL_STATUS_GROUP_LEN);
+
+        *p++ = ' ';
+        return ngx_cpymem(p, name, len);
+    }
+
+    return ngx_sprintf(p, " 0x%04xA", nid & 0xffff);
+}
+
+
+static char *
+ngx_http_set_ssl_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_ssl_status_handler;
+
+    return NGX_CONF_OK;
+}
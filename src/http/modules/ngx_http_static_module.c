@@ -10,10 +10,104 @@
 #include <ngx_http.h>
 
 
+typedef struct {
+    ngx_rbtree_node_t               node;
+    ngx_queue_t                     queue;
+
+    ngx_file_uniq_t                 uniq;
+    time_t                          mtime;
+    size_t                          size;
+
+    time_t                          checked;
+    time_t                          accessed;
+
+    ngx_uint_t                      count;
+
+#if (NGX_HAVE_OPENAT)
+    size_t                          disable_symlinks_from;
+    unsigned                        disable_symlinks:2;
+#endif
+
+    unsigned                        deleted:1;
+
+    u_char                         *data;
+    size_t                          len;
+    u_char                          name[1];
+} ngx_http_static_cache_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t                    rbtree;
+    ngx_rbtree_node_t               sentinel;
+    ngx_queue_t                     queue;
+} ngx_http_static_cache_sh_t;
+
+
+typedef struct {
+    ngx_http_static_cache_sh_t     *sh;
+    ngx_slab_pool_t                *shpool;
+} ngx_http_static_cache_t;
+
+
+typedef struct {
+    ngx_http_static_cache_t        *cache;
+    ngx_http_static_cache_node_t   *node;
+} ngx_http_static_cache_cleanup_t;
+
+
+typedef struct {
+    ngx_shm_zone_t                 *shm_zone;
+    size_t                          max_size;
+    time_t                          inactive;
+} ngx_http_static_loc_conf_t;
+
+
 static ngx_int_t ngx_http_static_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_static_passthrough(ngx_http_request_t *r,
+    ngx_http_core_loc_conf_t *clcf, ngx_open_file_info_t *of);
+static ngx_http_static_cache_node_t *ngx_http_static_cache_get(
+    ngx_http_request_t *r, ngx_http_static_loc_conf_t *slcf, ngx_str_t *path,
+    ngx_open_file_info_t *of);
+static ngx_http_static_cache_node_t *ngx_http_static_cache_set(
+    ngx_http_request_t *r, ngx_http_static_loc_conf_t *slcf, ngx_str_t *path,
+    ngx_open_file_info_t *of);
+static ngx_http_static_cache_cleanup_t *ngx_http_static_cache_cleanup_add(
+    ngx_http_request_t *r, ngx_http_static_cache_t *cache);
+static void ngx_http_static_cache_cleanup(void *data);
+static void ngx_http_static_cache_delete(ngx_http_static_cache_t *cache,
+    ngx_http_static_cache_node_t *node);
+static void ngx_http_static_cache_expire(ngx_http_static_cache_t *cache,
+    ngx_uint_t force, time_t inactive);
+static ngx_http_static_cache_node_t *ngx_http_static_cache_lookup(
+    ngx_http_static_cache_t *cache, ngx_str_t *path, uint32_t hash);
+static void ngx_http_static_cache_rbtree_insert_value(ngx_rbtree_node_t *temp,
+    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel);
+static ngx_int_t ngx_http_static_cache_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+static void *ngx_http_static_create_loc_conf(ngx_conf_t *cf);
+static char *ngx_http_static_merge_loc_conf(ngx_conf_t *cf, void *parent,
+    void *child);
+static char *ngx_http_static_memory_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static ngx_int_t ngx_http_static_init(ngx_conf_t *cf);
 
 
+static ngx_uint_t  ngx_http_static_filter_passthrough;
+
+
+static ngx_command_t  ngx_http_static_commands[] = {
+
+    { ngx_string("static_memory_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_http_static_memory_cache,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
 static ngx_http_module_t  ngx_http_static_module_ctx = {
     NULL,                                  /* preconfiguration */
     ngx_http_static_init,                  /* postconfiguration */
@@ -24,15 +118,15 @@ static ngx_http_module_t  ngx_http_static_module_ctx = {
     NULL,                                  /* create server configuration */
     NULL,                                  /* merge server configuration */
 
-    NULL,                                  /* create location configuration */
-    NULL                                   /* merge location configuration */
+    ngx_http_static_create_loc_conf,       /* create location configuration */
+    ngx_http_static_merge_loc_conf         /* merge location configuration */
 };
 
 
 ngx_module_t  ngx_http_static_module = {
     NGX_MODULE_V1,
     &ngx_http_static_module_ctx,           /* module context */
-    NULL,                                  /* module directives */
+    ngx_http_static_commands,              /* module directives */
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
@@ -48,17 +142,19 @@ ngx_module_t  ngx_http_static_module = {
 static ngx_int_t
 ngx_http_static_handler(ngx_http_request_t *r)
 {
-    u_char                    *last, *location;
-    size_t                     root, len;
-    uintptr_t                  escape;
-    ngx_str_t                  path;
-    ngx_int_t                  rc;
-    ngx_uint_t                 level;
-    ngx_log_t                 *log;
-    ngx_buf_t                 *b;
-    ngx_chain_t                out;
-    ngx_open_file_info_t       of;
-    ngx_http_core_loc_conf_t  *clcf;
+    u_char                        *last, *location;
+    size_t                         root, len;
+    uintptr_t                      escape;
+    ngx_str_t                      path;
+    ngx_int_t                      rc;
+    ngx_uint_t                     level;
+    ngx_log_t                     *log;
+    ngx_buf_t                     *b;
+    ngx_chain_t                    out;
+    ngx_open_file_info_t           of;
+    ngx_http_core_loc_conf_t      *clcf;
+    ngx_http_static_loc_conf_t    *slcf;
+    ngx_http_static_cache_node_t  *node;
 
     if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD|NGX_HTTP_POST))) {
         return NGX_HTTP_NOT_ALLOWED;
@@ -100,8 +196,17 @@ ngx_http_static_handler(ngx_http_request_t *r)
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
-    if (ngx_open_cached_file(clcf->open_file_cache, &path, &of, r->pool)
-        != NGX_OK)
+    slcf = ngx_http_get_module_loc_conf(r, ngx_http_static_module);
+
+    node = NULL;
+
+    if (slcf->shm_zone && r->method != NGX_HTTP_POST) {
+        node = ngx_http_static_cache_get(r, slcf, &path, &of);
+    }
+
+    if (node == NULL
+        && ngx_open_cached_file(clcf->open_file_cache, &path, &of, r->pool)
+           != NGX_OK)
     {
         switch (of.err) {
 
@@ -224,6 +329,10 @@ ngx_http_static_handler(ngx_http_request_t *r)
         return rc;
     }
 
+    if (slcf->shm_zone && node == NULL) {
+        node = ngx_http_static_cache_set(r, slcf, &path, &of);
+    }
+
     log->action = "sending response to client";
 
     r->headers_out.status = NGX_HTTP_OK;
@@ -247,8 +356,17 @@ ngx_http_static_handler(ngx_http_request_t *r)
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
-    b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t));
-    if (b->file == NULL) {
+    if (node) {
+        of.is_directio = 0;
+
+    } else {
+        b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t));
+        if (b->file == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+    if (ngx_http_static_passthrough(r, clcf, &of) == NGX_ERROR) {
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
@@ -258,6 +376,23 @@ ngx_http_static_handler(ngx_http_request_t *r)
         return rc;
     }
 
+    if (node) {
+
+        /* the node is referenced till the request pool is destroyed */
+
+        b->pos = node->data;
+        b->last = node->data + node->size;
+
+        b->memory = 1;
+        b->last_buf = (r == r->main) ? 1 : 0;
+        b->last_in_chain = 1;
+
+        out.buf = b;
+        out.next = NULL;
+
+        return ngx_http_output_filter(r, &out);
+    }
+
     b->file_pos = 0;
     b->file_last = of.size;
 
@@ -270,6 +405,7 @@ ngx_http_static_handler(ngx_http_request_t *r)
     b->file->name = path;
     b->file->log = log;
     b->file->directio = of.is_directio;
+    b->file->prefetch_max = clcf->read_ahead_window;
 
     out.buf = b;
     out.next = NULL;
@@ -278,9 +414,712 @@ ngx_http_static_handler(ngx_http_request_t *r)
 }
 
 
+static ngx_int_t
+ngx_http_static_passthrough(ngx_http_request_t *r,
+    ngx_http_core_loc_conf_t *clcf, ngx_open_file_info_t *of)
+{
+    ngx_table_elt_t  *h;
+
+    /*
+     * if no filter modules are enabled in the location, the response
+     * of the main request is sent by the header and write filters directly,
+     * unless it is to be changed by the not modified or range filters, or
+     * a file is to be read by the copy filter
+     */
+
+    if (!ngx_http_static_filter_passthrough
+        || !clcf->filter_passthrough
+        || r != r->main
+        || r->err_status
+        || r->http_version < NGX_HTTP_VERSION_10
+        || r->http_version >= NGX_HTTP_VERSION_20
+        || !r->connection->sendfile
+        || r->main_filter_need_in_memory
+        || r->filter_need_in_memory
+        || of->is_directio
+        || r->headers_in.range
+        || r->headers_in.if_unmodified_since
+        || r->headers_in.if_match
+        || r->headers_in.if_modified_since
+        || r->headers_in.if_none_match)
+    {
+        return NGX_DECLINED;
+    }
+
+    /* the range filter would add "Accept-Ranges" */
+
+    if (clcf->max_ranges) {
+        h = ngx_list_push(&r->headers_out.headers);
+        if (h == NULL) {
+            return NGX_ERROR;
+        }
+
+        h->hash = 1;
+        h->next = NULL;
+        ngx_str_set(&h->key, "Accept-Ranges");
+        ngx_str_set(&h->value, "bytes");
+
+        r->headers_out.accept_ranges = h;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http static filter passthrough");
+
+    r->filter_passthrough = 1;
+
+    if (of->size) {
+        r->request_output = 1;
+    }
+
+    return NGX_OK;
+}
+
+
+/*
+ * the contents of small files are kept in the shared memory zone and
+ * sent from memory; a file is revalidated via ngx_open_cached_file()
+ * once in "open_file_cache_valid" time by any worker
+ */
+
+static ngx_http_static_cache_node_t *
+ngx_http_static_cache_get(ngx_http_request_t *r,
+    ngx_http_static_loc_conf_t *slcf, ngx_str_t *path,
+    ngx_open_file_info_t *of)
+{
+    time_t                            now;
+    uint32_t                          hash;
+    ngx_http_static_cache_t          *cache;
+    ngx_http_static_cache_node_t     *node;
+    ngx_http_static_cache_cleanup_t  *scln;
+
+    cache = slcf->shm_zone->data;
+
+    scln = ngx_http_static_cache_cleanup_add(r, cache);
+    if (scln == NULL) {
+        return NULL;
+    }
+
+    now = ngx_time();
+
+    hash = ngx_crc32_long(path->data, path->len);
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node = ngx_http_static_cache_lookup(cache, path, hash);
+
+    if (node == NULL
+        || now - node->checked >= of->valid
+#if (NGX_HAVE_OPENAT)
+        || of->disable_symlinks != node->disable_symlinks
+        || of->disable_symlinks_from != node->disable_symlinks_from
+#endif
+       )
+    {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+        return NULL;
+    }
+
+    node->count++;
+    node->accessed = now;
+
+    ngx_queue_remove(&node->queue);
+    ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    scln->node = node;
+
+    of->fd = NGX_INVALID_FILE;
+    of->uniq = node->uniq;
+    of->mtime = node->mtime;
+    of->size = node->size;
+    of->is_file = 1;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http static memory cache hit: %uz", node->size);
+
+    return node;
+}
+
+
+static ngx_http_static_cache_node_t *
+ngx_http_static_cache_set(ngx_http_request_t *r,
+    ngx_http_static_loc_conf_t *slcf, ngx_str_t *path,
+    ngx_open_file_info_t *of)
+{
+    size_t                            n;
+    time_t                            now;
+    ssize_t                           size;
+    uint32_t                          hash;
+    ngx_uint_t                        revalidated;
+    ngx_file_t                        file;
+    ngx_http_static_cache_t          *cache;
+    ngx_http_static_cache_node_t     *node, *old;
+    ngx_http_static_cache_cleanup_t  *scln;
+
+    cache = slcf->shm_zone->data;
+
+    scln = ngx_http_static_cache_cleanup_add(r, cache);
+    if (scln == NULL) {
+        return NULL;
+    }
+
+    now = ngx_time();
+
+    hash = ngx_crc32_long(path->data, path->len);
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    ngx_http_static_cache_expire(cache, 0, slcf->inactive);
+
+    revalidated = 0;
+
+    old = ngx_http_static_cache_lookup(cache, path, hash);
+
+    if (old
+        && old->uniq == of->uniq
+        && old->mtime == of->mtime
+        && (off_t) old->size == of->size)
+    {
+        revalidated = 1;
+
+        old->checked = now;
+#if (NGX_HAVE_OPENAT)
+        old->disable_symlinks = of->disable_symlinks;
+        old->disable_symlinks_from = of->disable_symlinks_from;
+#endif
+        node = old;
+        goto found;
+    }
+
+    if (old) {
+        ngx_http_static_cache_delete(cache, old);
+    }
+
+    if (of->size == 0
+        || of->size > (off_t) slcf->max_size
+        || of->is_directio)
+    {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+        return NULL;
+    }
+
+    n = offsetof(ngx_http_static_cache_node_t, name) + path->len
+        + (size_t) of->size;
+
+    node = ngx_slab_alloc_locked(cache->shpool, n);
+
+    if (node == NULL) {
+        ngx_http_static_cache_expire(cache, 1, slcf->inactive);
+
+        node = ngx_slab_alloc_locked(cache->shpool, n);
+
+        if (node == NULL) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+            return NULL;
+        }
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    /* the node is not yet visible to other workers while it is read */
+
+    node->node.key = hash;
+    node->len = path->len;
+    ngx_memcpy(node->name, path->data, path->len);
+
+    node->data = node->name + path->len;
+    node->size = (size_t) of->size;
+
+    node->uniq = of->uniq;
+    node->mtime = of->mtime;
+    node->checked = now;
+    node->count = 0;
+    node->deleted = 0;
+#if (NGX_HAVE_OPENAT)
+    node->disable_symlinks = of->disable_symlinks;
+    node->disable_symlinks_from = of->disable_symlinks_from;
+#endif
+
+    ngx_memzero(&file, sizeof(ngx_file_t));
+
+    file.fd = of->fd;
+    file.name = *path;
+    file.log = r->connection->log;
+
+    size = ngx_read_file(&file, node->data, node->size, 0);
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    if (size != (ssize_t) node->size) {
+
+        if (size != NGX_ERROR) {
+            ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                          ngx_read_file_n " \"%V\" returned "
+                          "only %z bytes instead of %uz",
+                          path, size, node->size);
+        }
+
+        ngx_slab_free_locked(cache->shpool, node);
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+        return NULL;
+    }
+
+    /* another worker may have cached the file meanwhile */
+
+    old = ngx_http_static_cache_lookup(cache, path, hash);
+
+    if (old) {
+        ngx_http_static_cache_delete(cache, old);
+    }
+
+    ngx_rbtree_insert(&cache->sh->rbtree, &node->node);
+
+    ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+found:
+
+    node->count++;
+    node->accessed = now;
+
+    if (revalidated) {
+        ngx_queue_remove(&node->queue);
+        ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    scln->node = node;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http static memory cache set: %uz, revalidated:%ui",
+                   node->size, revalidated);
+
+    return node;
+}
+
+
+static ngx_http_static_cache_cleanup_t *
+ngx_http_static_cache_cleanup_add(ngx_http_request_t *r,
+    ngx_http_static_cache_t *cache)
+{
+    ngx_pool_cleanup_t               *cln;
+    ngx_http_static_cache_cleanup_t  *scln;
+
+    cln = ngx_pool_cleanup_add(r->pool,
+                               sizeof(ngx_http_static_cache_cleanup_t));
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    scln = cln->data;
+
+    scln->cache = cache;
+    scln->node = NULL;
+
+    cln->handler = ngx_http_static_cache_cleanup;
+
+    return scln;
+}
+
+
+static void
+ngx_http_static_cache_cleanup(void *data)
+{
+    ngx_http_static_cache_cleanup_t  *scln = data;
+
+    ngx_http_static_cache_t       *cache;
+    ngx_http_static_cache_node_t  *node;
+
+    node = scln->node;
+
+    if (node == NULL) {
+        return;
+    }
+
+    cache = scln->cache;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node->count--;
+
+    if (node->deleted && node->count == 0) {
+        ngx_slab_free_locked(cache->shpool, node);
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+}
+
+
+static void
+ngx_http_static_cache_delete(ngx_http_static_cache_t *cache,
+    ngx_http_static_cache_node_t *node)
+{
+    ngx_queue_remove(&node->queue);
+
+    ngx_rbtree_delete(&cache->sh->rbtree, &node->node);
+
+    /* the node being sent is freed by the last request */
+
+    if (node->count) {
+        node->deleted = 1;
+        return;
+    }
+
+    ngx_slab_free_locked(cache->shpool, node);
+}
+
+
+static void
+ngx_http_static_cache_expire(ngx_http_static_cache_t *cache,
+    ngx_uint_t force, time_t inactive)
+{
+    time_t                         now;
+    ngx_uint_t                     n;
+    ngx_queue_t                   *q, *prev;
+    ngx_http_static_cache_node_t  *node;
+
+    /*
+     * force == 0 deletes one or two inactive nodes,
+     * force == 1 deletes the least recently used node not being sent
+     */
+
+    now = ngx_time();
+
+    n = 0;
+
+    for (q = ngx_queue_last(&cache->sh->queue);
+         q != ngx_queue_sentinel(&cache->sh->queue) && n < 20;
+         q = prev, n++)
+    {
+        prev = ngx_queue_prev(q);
+
+        node = ngx_queue_data(q, ngx_http_static_cache_node_t, queue);
+
+        if (!force && now - node->accessed <= inactive) {
+            return;
+        }
+
+        if (node->count) {
+            continue;
+        }
+
+        ngx_http_static_cache_delete(cache, node);
+
+        if (force || n == 1) {
+            return;
+        }
+    }
+}
+
+
+static ngx_http_static_cache_node_t *
+ngx_http_static_cache_lookup(ngx_http_static_cache_t *cache, ngx_str_t *path,
+    uint32_t hash)
+{
+    ngx_int_t                      rc;
+    ngx_rbtree_node_t             *node, *sentinel;
+    ngx_http_static_cache_node_t  *sn;
+
+    node = cache->sh->rbtree.root;
+    sentinel = cache->sh->rbtree.sentinel;
+
+    while (node != sentinel) {
+
+        if (hash < node->key) {
+            node = node->left;
+            continue;
+        }
+
+        if (hash > node->key) {
+            node = node->right;
+            continue;
+        }
+
+        /* hash == node->key */
+
+        sn = (ngx_http_static_cache_node_t *) node;
+
+        rc = ngx_memn2cmp(path->data, sn->name, path->len, sn->len);
+
+        if (rc == 0) {
+            return sn;
+        }
+
+        node = (rc < 0) ? node->left : node->right;
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_http_static_cache_rbtree_insert_value(ngx_rbtree_node_t *temp,
+    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
+{
+    ngx_rbtree_node_t             **p;
+    ngx_http_static_cache_node_t   *sn, *snt;
+
+    for ( ;; ) {
+
+        if (node->key < temp->key) {
+
+            p = &temp->left;
+
+        } else if (node->key > temp->key) {
+
+            p = &temp->right;
+
+        } else { /* node->key == temp->key */
+
+            sn = (ngx_http_static_cache_node_t *) node;
+            snt = (ngx_http_static_cache_node_t *) temp;
+
+            p = (ngx_memn2cmp(sn->name, snt->name, sn->len, snt->len) < 0)
+                    ? &temp->left : &temp->right;
+        }
+
+        if (*p == sentinel) {
+            break;
+        }
+
+        temp = *p;
+    }
+
+    *p = node;
+    node->parent = temp;
+    node->left = sentinel;
+    node->right = sentinel;
+    ngx_rbt_red(node);
+}
+
+
+static ngx_int_t
+ngx_http_static_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_static_cache_t  *ocache = data;
+
+    size_t                    len;
+    ngx_http_static_cache_t  *cache;
+
+    cache = shm_zone->data;
+
+    if (ocache) {
+        cache->sh = ocache->sh;
+        cache->shpool = ocache->shpool;
+        return NGX_OK;
+    }
+
+    cache->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cache->sh = cache->shpool->data;
+        return NGX_OK;
+    }
+
+    cache->sh = ngx_slab_alloc(cache->shpool,
+                               sizeof(ngx_http_static_cache_sh_t));
+    if (cache->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->shpool->data = cache->sh;
+
+    ngx_rbtree_init(&cache->sh->rbtree, &cache->sh->sentinel,
+                    ngx_http_static_cache_rbtree_insert_value);
+
+    ngx_queue_init(&cache->sh->queue);
+
+    len = sizeof(" in static memory cache zone \"\"") + shm_zone->shm.name.len;
+
+    cache->shpool->log_ctx = ngx_slab_alloc(cache->shpool, len);
+    if (cache->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(cache->shpool->log_ctx,
+                " in static memory cache zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    cache->shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_http_static_create_loc_conf(ngx_conf_t *cf)
+{
+    ngx_http_static_loc_conf_t  *conf;
+
+    conf = ngx_palloc(cf->pool, sizeof(ngx_http_static_loc_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->shm_zone = NGX_CONF_UNSET_PTR;
+    conf->max_size = NGX_CONF_UNSET_SIZE;
+    conf->inactive = NGX_CONF_UNSET;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_static_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
+{
+    ngx_http_static_loc_conf_t *prev = parent;
+    ngx_http_static_loc_conf_t *conf = child;
+
+    ngx_conf_merge_ptr_value(conf->shm_zone, prev->shm_zone, NULL);
+    ngx_conf_merge_size_value(conf->max_size, prev->max_size, 64 * 1024);
+    ngx_conf_merge_sec_value(conf->inactive, prev->inactive, 60);
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_static_memory_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_static_loc_conf_t *slcf = conf;
+
+    u_char                   *p;
+    ssize_t                   size;
+    ngx_str_t                *value, name, s;
+    ngx_uint_t                i;
+    ngx_http_static_cache_t  *cache;
+
+    if (slcf->shm_zone != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts != 2) {
+            return "is invalid";
+        }
+
+        slcf->shm_zone = NULL;
+        return NGX_CONF_OK;
+    }
+
+    size = 0;
+    ngx_str_null(&name);
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "zone=", 5) == 0) {
+
+            name.data = value[i].data + 5;
+
+            p = (u_char *) ngx_strchr(name.data, ':');
+
+            if (p) {
+                name.len = p - name.data;
+
+                s.data = p + 1;
+                s.len = value[i].data + value[i].len - s.data;
+
+                size = ngx_parse_size(&s);
+
+                if (size == NGX_ERROR) {
+                    goto invalid;
+                }
+
+                if (size < (ssize_t) (8 * ngx_pagesize)) {
+                    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                       "zone \"%V\" is too small", &value[i]);
+                    return NGX_CONF_ERROR;
+                }
+
+            } else {
+                name.len = value[i].len - 5;
+            }
+
+            if (name.len == 0) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "max_size=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            slcf->max_size = ngx_parse_size(&s);
+            if (slcf->max_size == (size_t) NGX_ERROR
+                || slcf->max_size == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "inactive=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            slcf->inactive = ngx_parse_time(&s, 1);
+            if (slcf->inactive == (time_t) NGX_ERROR) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+    invalid:
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (name.len == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"%V\" must have \"zone\" parameter",
+                           &cmd->name);
+        return NGX_CONF_ERROR;
+    }
+
+    if (slcf->max_size == NGX_CONF_UNSET_SIZE) {
+        slcf->max_size = 64 * 1024;
+    }
+
+    if (slcf->inactive == NGX_CONF_UNSET) {
+        slcf->inactive = 60;
+    }
+
+    slcf->shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                           &ngx_http_static_module);
+    if (slcf->shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (slcf->shm_zone->data == NULL) {
+        cache = ngx_pcalloc(cf->pool, sizeof(ngx_http_static_cache_t));
+        if (cache == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        slcf->shm_zone->init = ngx_http_static_cache_init_zone;
+        slcf->shm_zone->data = cache;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 static ngx_int_t
 ngx_http_static_init(ngx_conf_t *cf)
 {
+    ngx_uint_t                  n;
     ngx_http_handler_pt        *h;
     ngx_http_core_main_conf_t  *cmcf;
 
@@ -293,5 +1132,11 @@ ngx_http_static_init(ngx_conf_t *cf)
 
     *h = ngx_http_static_handler;
 
+    /* filters of dynamic modules do not know about passthrough */
+
+    for (n = 0; ngx_modules[n]; n++) { /* void */ }
+
+    ngx_http_static_filter_passthrough = (cf->cycle->modules_n == n);
+
     return NGX_OK;
 }
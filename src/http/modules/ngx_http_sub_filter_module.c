@@ -22,12 +22,29 @@ typedef struct {
 } ngx_http_sub_match_t;
 
 
+#define NGX_HTTP_SUB_NONE  255
+
+
+/*
+ * the search patterns are kept in a trie over byte classes, so a potential
+ * match is checked by a single walk regardless of the number of patterns;
+ * "match" is the first pattern ending at a node, "below" is the first one
+ * passing through it, and "same" links the duplicate patterns
+ */
+
 typedef struct {
     ngx_uint_t                 min_match_len;
     ngx_uint_t                 max_match_len;
 
-    u_char                     index[257];
     u_char                     shift[256];
+    u_char                     class[256];
+
+    ngx_uint_t                 nclasses;
+
+    uint32_t                  *next;
+    u_char                    *match;
+    u_char                    *below;
+    u_char                    *same;
 } ngx_http_sub_tables_t;
 
 
@@ -77,14 +94,13 @@ typedef struct {
 } ngx_http_sub_ctx_t;
 
 
-static ngx_uint_t ngx_http_sub_cmp_index;
-
-
 static ngx_int_t ngx_http_sub_output(ngx_http_request_t *r,
     ngx_http_sub_ctx_t *ctx);
 static ngx_int_t ngx_http_sub_parse(ngx_http_request_t *r,
     ngx_http_sub_ctx_t *ctx, ngx_uint_t flush);
 static ngx_int_t ngx_http_sub_match(ngx_http_sub_ctx_t *ctx, ngx_int_t start,
+    ngx_str_t *sub);
+static ngx_int_t ngx_http_sub_compare(ngx_http_sub_ctx_t *ctx, ngx_int_t start,
     ngx_str_t *m);
 
 static char * ngx_http_sub_filter(ngx_conf_t *cf, ngx_command_t *cmd,
@@ -92,9 +108,8 @@ static char * ngx_http_sub_filter(ngx_conf_t *cf, ngx_command_t *cmd,
 static void *ngx_http_sub_create_conf(ngx_conf_t *cf);
 static char *ngx_http_sub_merge_conf(ngx_conf_t *cf,
     void *parent, void *child);
-static void ngx_http_sub_init_tables(ngx_http_sub_tables_t *tables,
-    ngx_http_sub_match_t *match, ngx_uint_t n);
-static ngx_int_t ngx_http_sub_cmp_matches(const void *one, const void *two);
+static ngx_int_t ngx_http_sub_init_tables(ngx_pool_t *pool,
+    ngx_http_sub_tables_t *tables, ngx_http_sub_match_t *match, ngx_uint_t n);
 static ngx_int_t ngx_http_sub_filter_init(ngx_conf_t *cf);
 
 
@@ -244,8 +259,12 @@ ngx_http_sub_header_filter(ngx_http_request_t *r)
             return NGX_ERROR;
         }
 
-        ngx_http_sub_init_tables(ctx->tables, ctx->matches->elts,
-                                 ctx->matches->nelts);
+        if (ngx_http_sub_init_tables(r->pool, ctx->tables, ctx->matches->elts,
+                                     ctx->matches->nelts)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
     }
 
     ctx->saved.data = ngx_pnalloc(r->pool, ctx->tables->max_match_len - 1);
@@ -614,7 +633,7 @@ ngx_http_sub_parse(ngx_http_request_t *r, ngx_http_sub_ctx_t *ctx,
     u_char                   *p, c;
     ngx_str_t                *m;
     ngx_int_t                 offset, start, next, end, len, rc;
-    ngx_uint_t                shift, i, j;
+    ngx_uint_t                shift;
     ngx_http_sub_match_t     *match;
     ngx_http_sub_tables_t    *tables;
     ngx_http_sub_loc_conf_t  *slcf;
@@ -649,43 +668,23 @@ ngx_http_sub_parse(ngx_http_request_t *r, ngx_http_sub_ctx_t *ctx,
 
         start = offset - (ngx_int_t) tables->min_match_len + 1;
 
-        i = ngx_max((ngx_uint_t) tables->index[c], ctx->index);
-        j = tables->index[c + 1];
-
-        while (i != j) {
-
-            if (slcf->once && ctx->sub && ctx->sub[i].data) {
-                goto next;
-            }
-
-            m = &match[i].match;
-
-            rc = ngx_http_sub_match(ctx, start, m);
-
-            if (rc == NGX_DECLINED) {
-                goto next;
-            }
+        rc = ngx_http_sub_match(ctx, start, slcf->once ? ctx->sub : NULL);
 
-            ctx->index = i;
+        if (rc == NGX_AGAIN) {
+            goto again;
+        }
 
-            if (rc == NGX_AGAIN) {
-                goto again;
-            }
+        if (rc == NGX_OK) {
+            m = &match[ctx->index].match;
 
             ctx->offset = offset + (ngx_int_t) m->len;
             next = start + (ngx_int_t) m->len;
             end = ngx_max(next, 0);
-            rc = NGX_OK;
 
             goto done;
-
-        next:
-
-            i++;
         }
 
         offset++;
-        ctx->index = 0;
     }
 
     if (flush) {
@@ -696,12 +695,8 @@ ngx_http_sub_parse(ngx_http_request_t *r, ngx_http_sub_ctx_t *ctx,
                 break;
             }
 
-            for (i = 0; i < ctx->matches->nelts; i++) {
-                m = &match[i].match;
-
-                if (ngx_http_sub_match(ctx, start, m) == NGX_AGAIN) {
-                    goto again;
-                }
+            if (ngx_http_sub_match(ctx, start, NULL) == NGX_AGAIN) {
+                goto again;
             }
 
             offset++;
@@ -745,7 +740,113 @@ done:
 
 
 static ngx_int_t
-ngx_http_sub_match(ngx_http_sub_ctx_t *ctx, ngx_int_t start, ngx_str_t *m)
+ngx_http_sub_match(ngx_http_sub_ctx_t *ctx, ngx_int_t start, ngx_str_t *sub)
+{
+    u_char                 *p, *last;
+    ngx_uint_t              node, depth, i, best, n;
+    ngx_http_sub_match_t   *match;
+    ngx_http_sub_tables_t  *tables;
+
+    /*
+     * walks the trie from the start position, the first pattern
+     * in the configuration order which matches completely or partially
+     * at the end of the buffer wins; with "sub = NULL" already applied
+     * patterns are not skipped
+     */
+
+    tables = ctx->tables;
+
+    if (start >= 0) {
+        p = ctx->pos + start;
+        last = ctx->buf->last;
+
+    } else {
+        last = ctx->looked.data + ctx->looked.len;
+        p = last + start;
+    }
+
+    node = 0;
+    depth = 0;
+    best = NGX_HTTP_SUB_NONE;
+
+    for ( ;; ) {
+
+        if (p == last) {
+            if (last == ctx->buf->last) {
+                break;
+            }
+
+            p = ctx->pos;
+            last = ctx->buf->last;
+            continue;
+        }
+
+        node = tables->next[node * tables->nclasses
+                            + tables->class[ngx_tolower(*p)]];
+
+        if (node == 0) {
+            goto done;
+        }
+
+        p++;
+        depth++;
+
+        for (i = tables->match[node];
+             i != NGX_HTTP_SUB_NONE;
+             i = tables->same[i])
+        {
+            if (sub == NULL || sub[i].data == NULL) {
+                best = ngx_min(best, i);
+                break;
+            }
+        }
+    }
+
+    /* the end of the buffer, patterns passing through the node are partial */
+
+    i = tables->below[node];
+
+    if (i != NGX_HTTP_SUB_NONE && sub && sub[i].data) {
+
+        /* the first one is already applied, look for another */
+
+        match = ctx->matches->elts;
+        n = ngx_min(best, ctx->matches->nelts);
+
+        for (i++; i < n; i++) {
+            if (sub[i].data == NULL
+                && match[i].match.len > depth
+                && ngx_http_sub_compare(ctx, start, &match[i].match)
+                   == NGX_AGAIN)
+            {
+                break;
+            }
+        }
+
+        if (i == n) {
+            i = NGX_HTTP_SUB_NONE;
+        }
+    }
+
+    if (i < best) {
+        ctx->index = i;
+        return NGX_AGAIN;
+    }
+
+done:
+
+    if (best == NGX_HTTP_SUB_NONE) {
+        return NGX_DECLINED;
+    }
+
+    ctx->index = best;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_sub_compare(ngx_http_sub_ctx_t *ctx, ngx_int_t start, ngx_str_t *m)
 {
     u_char  *p, *last, *pat, *pat_end;
 
@@ -913,6 +1014,10 @@ ngx_http_sub_merge_conf(ngx_conf_t *cf, void *parent, void *child)
         conf->tables = prev->tables;
     }
 
+    if (conf->pairs) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
+
     if (conf->pairs && conf->dynamic == 0 && conf->tables == NULL) {
         pairs = conf->pairs->elts;
         n = conf->pairs->nelts;
@@ -940,72 +1045,123 @@ ngx_http_sub_merge_conf(ngx_conf_t *cf, void *parent, void *child)
             return NGX_CONF_ERROR;
         }
 
-        ngx_http_sub_init_tables(conf->tables, conf->matches->elts,
-                                 conf->matches->nelts);
+        if (ngx_http_sub_init_tables(cf->pool, conf->tables,
+                                     conf->matches->elts, conf->matches->nelts)
+            != NGX_OK)
+        {
+            return NGX_CONF_ERROR;
+        }
     }
 
     return NGX_CONF_OK;
 }
 
 
-static void
-ngx_http_sub_init_tables(ngx_http_sub_tables_t *tables,
+static ngx_int_t
+ngx_http_sub_init_tables(ngx_pool_t *pool, ngx_http_sub_tables_t *tables,
     ngx_http_sub_match_t *match, ngx_uint_t n)
 {
     u_char      c;
-    ngx_uint_t  i, j, min, max, ch;
+    ngx_uint_t  i, j, min, max, nodes, node, next;
 
     min = match[0].match.len;
     max = match[0].match.len;
+    nodes = 1;
 
-    for (i = 1; i < n; i++) {
+    ngx_memzero(tables->class, 256);
+
+    for (i = 0; i < n; i++) {
         min = ngx_min(min, match[i].match.len);
         max = ngx_max(max, match[i].match.len);
+        nodes += match[i].match.len;
+
+        for (j = 0; j < match[i].match.len; j++) {
+            tables->class[match[i].match.data[j]] = 1;
+        }
     }
 
     tables->min_match_len = min;
     tables->max_match_len = max;
 
-    ngx_http_sub_cmp_index = tables->min_match_len - 1;
-    ngx_sort(match, n, sizeof(ngx_http_sub_match_t), ngx_http_sub_cmp_matches);
+    /* class 0 is for bytes not found in patterns, it has no transitions */
 
-    min = ngx_min(min, 255);
-    ngx_memset(tables->shift, min, 256);
+    tables->nclasses = 1;
+
+    for (i = 0; i < 256; i++) {
+        if (tables->class[i]) {
+            tables->class[i] = (u_char) tables->nclasses++;
+        }
+    }
+
+    tables->next = ngx_pcalloc(pool,
+                               nodes * tables->nclasses * sizeof(uint32_t));
+    if (tables->next == NULL) {
+        return NGX_ERROR;
+    }
 
-    ch = 0;
+    tables->match = ngx_pnalloc(pool, 2 * nodes + n);
+    if (tables->match == NULL) {
+        return NGX_ERROR;
+    }
+
+    tables->below = tables->match + nodes;
+    tables->same = tables->below + nodes;
+
+    ngx_memset(tables->match, NGX_HTTP_SUB_NONE, 2 * nodes + n);
+
+    nodes = 1;
 
     for (i = 0; i < n; i++) {
 
-        for (j = 0; j < min; j++) {
-            c = match[i].match.data[tables->min_match_len - 1 - j];
-            tables->shift[c] = ngx_min(tables->shift[c], (u_char) j);
-        }
+        node = 0;
 
-        c = match[i].match.data[tables->min_match_len - 1];
-        while (ch <= (ngx_uint_t) c) {
-            tables->index[ch++] = (u_char) i;
+        for (j = 0; j < match[i].match.len; j++) {
+
+            if (tables->below[node] == NGX_HTTP_SUB_NONE) {
+                tables->below[node] = (u_char) i;
+            }
+
+            c = match[i].match.data[j];
+
+            next = tables->next[node * tables->nclasses + tables->class[c]];
+
+            if (next == 0) {
+                next = nodes++;
+                tables->next[node * tables->nclasses + tables->class[c]] =
+                                                              (uint32_t) next;
+            }
+
+            node = next;
         }
-    }
 
-    while (ch < 257) {
-        tables->index[ch++] = (u_char) n;
-    }
-}
+        /* duplicate patterns are linked in the configuration order */
 
+        if (tables->match[node] == NGX_HTTP_SUB_NONE) {
+            tables->match[node] = (u_char) i;
 
-static ngx_int_t
-ngx_http_sub_cmp_matches(const void *one, const void *two)
-{
-    ngx_int_t              c1, c2;
-    ngx_http_sub_match_t  *first, *second;
+        } else {
+            for (j = tables->match[node];
+                 tables->same[j] != NGX_HTTP_SUB_NONE;
+                 j = tables->same[j])
+            {
+                /* void */
+            }
 
-    first = (ngx_http_sub_match_t *) one;
-    second = (ngx_http_sub_match_t *) two;
+            tables->same[j] = (u_char) i;
+        }
+    }
 
-    c1 = first->match.data[ngx_http_sub_cmp_index];
-    c2 = second->match.data[ngx_http_sub_cmp_index];
+    min = ngx_min(min, 255);
+    ngx_memset(tables->shift, min, 256);
 
-    return c1 - c2;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < min; j++) {
+            c = match[i].match.data[tables->min_match_len - 1 - j];
+            tables->shift[c] = ngx_min(tables->shift[c], (u_char) j);
+        }
+    }
+
+    return NGX_OK;
 }
 
 
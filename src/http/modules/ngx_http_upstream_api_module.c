@@ -0,0 +1,847 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_UPSTREAM_API_PEER_LEN                                        \
+    (sizeof("{\"id\":,\"name\":\"\",\"server\":\"\",\"backup\":false,"        \
+            "\"weight\":,\"max_conns\":,\"max_fails\":,\"fail_timeout\":,"    \
+            "\"state\":\"unavailable\",\"conns\":,\"fails\":},") - 1          \
+     + 6 * NGX_INT_T_LEN + NGX_TIME_T_LEN + NGX_SOCKADDR_STRLEN)
+
+
+static ngx_int_t ngx_http_upstream_api_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_upstream_api_uri(ngx_http_request_t *r,
+    ngx_str_t *name, ngx_int_t *id);
+static ngx_http_upstream_srv_conf_t *ngx_http_upstream_api_find(
+    ngx_http_request_t *r, ngx_str_t *name);
+static ngx_http_upstream_rr_peer_t *ngx_http_upstream_api_peer(
+    ngx_http_upstream_rr_peers_t *peers, ngx_int_t id,
+    ngx_http_upstream_rr_peers_t **list);
+static ngx_int_t ngx_http_upstream_api_add(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peers_t *peers);
+static ngx_int_t ngx_http_upstream_api_modify(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peers_t *peers, ngx_int_t id);
+static ngx_int_t ngx_http_upstream_api_remove(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peers_t *peers, ngx_int_t id);
+static ngx_int_t ngx_http_upstream_api_args(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peer_t *peer, ngx_uint_t add);
+static void ngx_http_upstream_api_weights(ngx_http_upstream_rr_peers_t *peers);
+static ngx_int_t ngx_http_upstream_api_show(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *uscf, ngx_int_t id);
+static size_t ngx_http_upstream_api_size(ngx_http_upstream_srv_conf_t *uscf);
+static u_char *ngx_http_upstream_api_peers(u_char *p,
+    ngx_http_upstream_srv_conf_t *uscf, ngx_int_t id);
+static u_char *ngx_http_upstream_api_peer_json(u_char *p,
+    ngx_http_upstream_rr_peer_t *peer, ngx_uint_t id, ngx_uint_t backup);
+static ngx_int_t ngx_http_upstream_api_send(ngx_http_request_t *r,
+    ngx_uint_t status, ngx_buf_t *b);
+static char *ngx_http_upstream_api(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_upstream_api_commands[] = {
+
+    { ngx_string("upstream_api"),
+      NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_upstream_api,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_upstream_api_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_upstream_api_module = {
+    NGX_MODULE_V1,
+    &ngx_http_upstream_api_module_ctx,     /* module context */
+    ngx_http_upstream_api_commands,        /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * The API of an upstream_api location "/upstreams/", for upstreams
+ * with a shared memory zone:
+ *
+ *     GET /upstreams/              peers of all upstreams as JSON
+ *     GET /upstreams/name          peers of the upstream
+ *     GET /upstreams/name/id       the peer
+ *     POST /upstreams/name?server=addr:port
+ *                                  adds a peer, takes a spare slot
+ *                                  of the "zone" directive
+ *     PATCH /upstreams/name/id?weight=2&drain=1
+ *                                  changes the peer
+ *     DELETE /upstreams/name/id    removes the peer
+ *
+ * The arguments are "weight", "max_conns", "max_fails", "fail_timeout",
+ * "down", and "drain" for PATCH.  The changes are made to the peers
+ * in the zone and are seen by all worker processes at once; they last
+ * until the configuration is reloaded.
+ */
+
+
+static ngx_int_t
+ngx_http_upstream_api_handler(ngx_http_request_t *r)
+{
+    ngx_int_t                      rc, id;
+    ngx_str_t                      name;
+    ngx_http_upstream_srv_conf_t  *uscf;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD|NGX_HTTP_POST
+                       |NGX_HTTP_PATCH|NGX_HTTP_DELETE)))
+    {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    if (ngx_http_upstream_api_uri(r, &name, &id) != NGX_OK) {
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    if (name.len == 0) {
+        if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+            return NGX_HTTP_NOT_ALLOWED;
+        }
+
+        return ngx_http_upstream_api_show(r, NULL, -1);
+    }
+
+    uscf = ngx_http_upstream_api_find(r, &name);
+
+    if (uscf == NULL) {
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    switch (r->method) {
+
+    case NGX_HTTP_POST:
+
+        if (id != -1) {
+            return NGX_HTTP_NOT_ALLOWED;
+        }
+
+        return ngx_http_upstream_api_add(r, uscf->peer.data);
+
+    case NGX_HTTP_PATCH:
+    case NGX_HTTP_DELETE:
+
+        if (id == -1) {
+            return NGX_HTTP_NOT_ALLOWED;
+        }
+
+        if (r->method == NGX_HTTP_PATCH) {
+            return ngx_http_upstream_api_modify(r, uscf->peer.data, id);
+        }
+
+        return ngx_http_upstream_api_remove(r, uscf->peer.data, id);
+
+    default: /* GET, HEAD */
+        return ngx_http_upstream_api_show(r, uscf, id);
+    }
+}
+
+
+static ngx_int_t
+ngx_http_upstream_api_uri(ngx_http_request_t *r, ngx_str_t *name,
+    ngx_int_t *id)
+{
+    u_char                    *p, *last, *slash;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    ngx_str_null(name);
+    *id = -1;
+
+    if (r->uri.len <= clcf->name.len) {
+        return NGX_OK;
+    }
+
+    p = r->uri.data + clcf->name.len;
+    last = r->uri.data + r->uri.len;
+
+    if (*p == '/') {
+        p++;
+    }
+
+    if (p < last && last[-1] == '/') {
+        last--;
+    }
+
+    slash = ngx_strlchr(p, last, '/');
+
+    name->data = p;
+    name->len = (slash ? slash : last) - p;
+
+    if (slash == NULL) {
+        return NGX_OK;
+    }
+
+    *id = ngx_atoi(slash + 1, last - slash - 1);
+
+    if (*id == NGX_ERROR) {
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_http_upstream_srv_conf_t *
+ngx_http_upstream_api_find(ngx_http_request_t *r, ngx_str_t *name)
+{
+    ngx_uint_t                      i;
+    ngx_http_upstream_srv_conf_t  **uscfp;
+    ngx_http_upstream_main_conf_t  *umcf;
+
+    umcf = ngx_http_get_module_main_conf(r, ngx_http_upstream_module);
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->shm_zone == NULL
+            || uscfp[i]->peer.data == NULL
+            || uscfp[i]->host.len != name->len
+            || ngx_strncmp(uscfp[i]->host.data, name->data, name->len) != 0)
+        {
+            continue;
+        }
+
+        return uscfp[i];
+    }
+
+    return NULL;
+}
+
+
+static ngx_http_upstream_rr_peer_t *
+ngx_http_upstream_api_peer(ngx_http_upstream_rr_peers_t *peers, ngx_int_t id,
+    ngx_http_upstream_rr_peers_t **list)
+{
+    ngx_http_upstream_rr_peer_t  *peer;
+
+    /* the peers are numbered over the primary and backup lists */
+
+    for ( /* void */ ; peers; peers = peers->next) {
+
+        if ((ngx_uint_t) id >= peers->number) {
+            id -= peers->number;
+            continue;
+        }
+
+        for (peer = peers->peer; id; peer = peer->next) {
+            id--;
+        }
+
+        *list = peers;
+
+        return peer;
+    }
+
+    return NULL;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_api_add(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peers_t *peers)
+{
+    ngx_int_t                     rc;
+    ngx_str_t                     value;
+    ngx_buf_t                    *b;
+    ngx_uint_t                    id, n;
+    ngx_addr_t                    addr;
+    ngx_http_upstream_rr_peer_t  *peer, *slot, tmp;
+
+    if (ngx_http_arg(r, (u_char *) "server", 6, &value) != NGX_OK) {
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    rc = ngx_parse_addr_port(r->pool, &addr, value.data, value.len);
+
+    if (rc != NGX_OK) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "invalid server address \"%V\"", &value);
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    if (ngx_inet_get_port(addr.sockaddr) == 0) {
+        ngx_inet_set_port(addr.sockaddr, 80);
+    }
+
+    ngx_memzero(&tmp, sizeof(ngx_http_upstream_rr_peer_t));
+
+    tmp.weight = 1;
+    tmp.max_fails = 1;
+    tmp.fail_timeout = 10;
+
+    if (ngx_http_upstream_api_args(r, &tmp, 1) != NGX_OK) {
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    ngx_http_upstream_rr_peers_wlock(peers);
+
+    slot = NULL;
+    id = 0;
+    n = 0;
+
+    for (peer = peers->peer; peer; peer = peer->next, n++) {
+
+        if (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED) {
+
+            /* a slot may still be used by requests to a removed peer */
+
+            if (slot == NULL && peer->host == NULL && peer->conns == 0) {
+                slot = peer;
+                id = n;
+            }
+
+            continue;
+        }
+
+        if (ngx_cmp_sockaddr(peer->sockaddr, peer->socklen,
+                             addr.sockaddr, addr.socklen, 1)
+            == NGX_OK)
+        {
+            ngx_http_upstream_rr_peers_unlock(peers);
+            return NGX_HTTP_CONFLICT;
+        }
+    }
+
+    if (slot == NULL) {
+        ngx_http_upstream_rr_peers_unlock(peers);
+
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "upstream \"%V\": no free slots for %V, "
+                      "see the \"spare\" parameter of the \"zone\" directive",
+                      peers->name, &value);
+
+        return NGX_HTTP_INSUFFICIENT_STORAGE;
+    }
+
+    peer = slot;
+
+    ngx_memcpy(peer->sockaddr, addr.sockaddr, addr.socklen);
+    peer->socklen = addr.socklen;
+    peer->name.len = ngx_sock_ntop(peer->sockaddr, peer->socklen,
+                                   peer->name.data, NGX_SOCKADDR_STRLEN, 1);
+    peer->server.len = 0;
+
+    peer->weight = tmp.weight;
+    peer->effective_weight = tmp.weight;
+    peer->current_weight = 0;
+    peer->max_conns = tmp.max_conns;
+    peer->max_fails = tmp.max_fails;
+    peer->fail_timeout = tmp.fail_timeout;
+
+    peer->fails = 0;
+    peer->accessed = 0;
+    peer->checked = 0;
+    peer->latency = 0;
+    peer->hc_fails = 0;
+    peer->hc_passes = 0;
+
+#if (NGX_HTTP_SSL)
+    if (peer->ssl_session) {
+        ngx_slab_free(peers->shpool, peer->ssl_session);
+        peer->ssl_session = NULL;
+        peer->ssl_session_len = 0;
+    }
+#endif
+
+    peer->down = tmp.down;
+
+    ngx_http_upstream_api_weights(peers);
+
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+    ngx_log_error(NGX_LOG_NOTICE, r->connection->log, 0,
+                  "upstream \"%V\": %V added", peers->name, &peer->name);
+
+    b = ngx_create_temp_buf(r->pool, sizeof("{\"id\":}\n") + NGX_INT_T_LEN);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    b->last = ngx_sprintf(b->last, "{\"id\":%ui}\n", id);
+
+    return ngx_http_upstream_api_send(r, NGX_HTTP_CREATED, b);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_api_modify(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peers_t *peers, ngx_int_t id)
+{
+    ngx_http_upstream_rr_peer_t   *peer, tmp;
+    ngx_http_upstream_rr_peers_t  *list;
+
+    peer = ngx_http_upstream_api_peer(peers, id, &list);
+
+    if (peer == NULL) {
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    ngx_http_upstream_rr_peers_wlock(list);
+
+    if (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED) {
+        ngx_http_upstream_rr_peers_unlock(list);
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    tmp = *peer;
+
+    if (ngx_http_upstream_api_args(r, &tmp, 0) != NGX_OK) {
+        ngx_http_upstream_rr_peers_unlock(list);
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    if (peer->weight != tmp.weight) {
+        peer->weight = tmp.weight;
+        peer->effective_weight = tmp.weight;
+        peer->current_weight = 0;
+
+        ngx_http_upstream_api_weights(list);
+    }
+
+    peer->max_conns = tmp.max_conns;
+    peer->max_fails = tmp.max_fails;
+    peer->fail_timeout = tmp.fail_timeout;
+    peer->down = tmp.down;
+
+    ngx_http_upstream_rr_peers_unlock(list);
+
+    return NGX_HTTP_NO_CONTENT;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_api_remove(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peers_t *peers, ngx_int_t id)
+{
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *list;
+
+    peer = ngx_http_upstream_api_peer(peers, id, &list);
+
+    if (peer == NULL) {
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    ngx_http_upstream_rr_peers_wlock(list);
+
+    if (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED) {
+        ngx_http_upstream_rr_peers_unlock(list);
+        return NGX_HTTP_NOT_FOUND;
+    }
+
+    if (peer->host) {
+
+        /* the addresses of a "resolve" server follow the DNS */
+
+        ngx_http_upstream_rr_peers_unlock(list);
+        return NGX_HTTP_CONFLICT;
+    }
+
+    /*
+     * the address is kept as is: requests in progress still use it,
+     * and the slot is not reused until they are finished
+     */
+
+    peer->down |= NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED;
+
+    ngx_http_upstream_rr_peers_unlock(list);
+
+    ngx_log_error(NGX_LOG_NOTICE, r->connection->log, 0,
+                  "upstream \"%V\": %V removed", list->name, &peer->name);
+
+    return NGX_HTTP_NO_CONTENT;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_api_args(ngx_http_request_t *r,
+    ngx_http_upstream_rr_peer_t *peer, ngx_uint_t add)
+{
+    time_t     t;
+    ngx_int_t  n;
+    ngx_str_t  value;
+
+    if (ngx_http_arg(r, (u_char *) "weight", 6, &value) == NGX_OK) {
+        n = ngx_atoi(value.data, value.len);
+
+        if (n == NGX_ERROR || n == 0) {
+            goto invalid;
+        }
+
+        peer->weight = n;
+    }
+
+    if (ngx_http_arg(r, (u_char *) "max_conns", 9, &value) == NGX_OK) {
+        n = ngx_atoi(value.data, value.len);
+
+        if (n == NGX_ERROR) {
+            goto invalid;
+        }
+
+        peer->max_conns = n;
+    }
+
+    if (ngx_http_arg(r, (u_char *) "max_fails", 9, &value) == NGX_OK) {
+        n = ngx_atoi(value.data, value.len);
+
+        if (n == NGX_ERROR) {
+            goto invalid;
+        }
+
+        peer->max_fails = n;
+    }
+
+    if (ngx_http_arg(r, (u_char *) "fail_timeout", 12, &value) == NGX_OK) {
+        t = ngx_parse_time(&value, 1);
+
+        if (t == (time_t) NGX_ERROR) {
+            goto invalid;
+        }
+
+        peer->fail_timeout = t;
+    }
+
+    if (ngx_http_arg(r, (u_char *) "down", 4, &value) == NGX_OK) {
+        if (value.len != 1 || (value.data[0] != '0' && value.data[0] != '1')) {
+            goto invalid;
+        }
+
+        if (value.data[0] == '1') {
+            peer->down |= 1;
+
+        } else {
+            peer->down &= ~1;
+        }
+    }
+
+    if (add) {
+        return NGX_OK;
+    }
+
+    if (ngx_http_arg(r, (u_char *) "drain", 5, &value) == NGX_OK) {
+        if (value.len != 1 || (value.data[0] != '0' && value.data[0] != '1')) {
+            goto invalid;
+        }
+
+        if (value.data[0] == '1') {
+            peer->down |= NGX_HTTP_UPSTREAM_RR_PEER_DRAIN;
+
+        } else {
+            peer->down &= ~NGX_HTTP_UPSTREAM_RR_PEER_DRAIN;
+        }
+    }
+
+    return NGX_OK;
+
+invalid:
+
+    ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                  "invalid argument value \"%V\"", &value);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_http_upstream_api_weights(ngx_http_upstream_rr_peers_t *peers)
+{
+    ngx_uint_t                    w;
+    ngx_http_upstream_rr_peer_t  *peer;
+
+    /* as in ngx_http_upstream_init_round_robin(), slots included */
+
+    w = 0;
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+        w += peer->weight;
+    }
+
+    peers->total_weight = w;
+    peers->weighted = (w != peers->number);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_api_show(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *uscf, ngx_int_t id)
+{
+    u_char                         *p;
+    size_t                          size;
+    ngx_buf_t                      *b;
+    ngx_uint_t                      i;
+    ngx_http_upstream_srv_conf_t  **uscfp;
+    ngx_http_upstream_main_conf_t  *umcf;
+
+    umcf = ngx_http_get_module_main_conf(r, ngx_http_upstream_module);
+
+    uscfp = umcf->upstreams.elts;
+
+    if (uscf) {
+        size = ngx_http_upstream_api_size(uscf);
+
+    } else {
+        size = sizeof("{}\n");
+
+        for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+            if (uscfp[i]->shm_zone == NULL || uscfp[i]->peer.data == NULL) {
+                continue;
+            }
+
+            size += sizeof("\"\":,") - 1 + uscfp[i]->host.len
+                    + ngx_escape_json(NULL, uscfp[i]->host.data,
+                                      uscfp[i]->host.len)
+                    + ngx_http_upstream_api_size(uscfp[i]);
+        }
+    }
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    if (uscf) {
+        p = ngx_http_upstream_api_peers(b->last, uscf, id);
+
+        if (p == NULL) {
+            return NGX_HTTP_NOT_FOUND;
+        }
+
+        b->last = p;
+
+    } else {
+        *b->last++ = '{';
+
+        for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+            if (uscfp[i]->shm_zone == NULL || uscfp[i]->peer.data == NULL) {
+                continue;
+            }
+
+            *b->last++ = '"';
+            b->last = (u_char *) ngx_escape_json(b->last, uscfp[i]->host.data,
+                                                 uscfp[i]->host.len);
+            *b->last++ = '"';
+            *b->last++ = ':';
+
+            b->last = ngx_http_upstream_api_peers(b->last, uscfp[i], -1);
+            *b->last++ = ',';
+        }
+
+        if (b->last[-1] == ',') {
+            b->last--;
+        }
+
+        *b->last++ = '}';
+    }
+
+    *b->last++ = LF;
+
+    return ngx_http_upstream_api_send(r, NGX_HTTP_OK, b);
+}
+
+
+static size_t
+ngx_http_upstream_api_size(ngx_http_upstream_srv_conf_t *uscf)
+{
+    size_t                         size;
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    /* the lists are of fixed sizes, and server names do not grow */
+
+    size = sizeof("{\"peers\":[]}") - 1;
+
+    for (peers = uscf->peer.data; peers; peers = peers->next) {
+
+        ngx_http_upstream_rr_peers_rlock(peers);
+
+        for (peer = peers->peer; peer; peer = peer->next) {
+            size += NGX_HTTP_UPSTREAM_API_PEER_LEN + 6 * peer->server.len;
+        }
+
+        ngx_http_upstream_rr_peers_unlock(peers);
+    }
+
+    return size;
+}
+
+
+static u_char *
+ngx_http_upstream_api_peers(u_char *p, ngx_http_upstream_srv_conf_t *uscf,
+    ngx_int_t id)
+{
+    u_char                        *start;
+    ngx_uint_t                     n;
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    start = p;
+
+    if (id == -1) {
+        p = ngx_cpymem(p, "{\"peers\":[", sizeof("{\"peers\":[") - 1);
+    }
+
+    n = 0;
+
+    for (peers = uscf->peer.data; peers; peers = peers->next) {
+
+        ngx_http_upstream_rr_peers_rlock(peers);
+
+        for (peer = peers->peer; peer; peer = peer->next, n++) {
+
+            if (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED) {
+                continue;
+            }
+
+            if (id != -1 && (ngx_uint_t) id != n) {
+                continue;
+            }
+
+            p = ngx_http_upstream_api_peer_json(p, peer, n,
+                                                peers != uscf->peer.data);
+        }
+
+        ngx_http_upstream_rr_peers_unlock(peers);
+    }
+
+    if (id != -1) {
+        if (p == start) {
+            return NULL;
+        }
+
+        return p - 1;
+    }
+
+    if (p[-1] == ',') {
+        p--;
+    }
+
+    return ngx_cpymem(p, "]}", 2);
+}
+
+
+static u_char *
+ngx_http_upstream_api_peer_json(u_char *p, ngx_http_upstream_rr_peer_t *peer,
+    ngx_uint_t id, ngx_uint_t backup)
+{
+    char    *state;
+    time_t   now;
+
+    now = ngx_time();
+
+    if (peer->down & 1) {
+        state = "down";
+
+    } else if (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_DRAIN) {
+        state = "draining";
+
+    } else if (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY) {
+        state = "unhealthy";
+
+    } else if (peer->max_fails && peer->fails >= peer->max_fails
+               && now - peer->checked <= peer->fail_timeout)
+    {
+        state = "unavailable";
+
+    } else {
+        state = "up";
+    }
+
+    p = ngx_sprintf(p, "{\"id\":%ui,\"name\":\"%V\",\"server\":\"",
+                    id, &peer->name);
+
+    p = (u_char *) ngx_escape_json(p, peer->server.data, peer->server.len);
+
+    return ngx_sprintf(p, "\",\"backup\":%s,\"weight\":%i,\"max_conns\":%ui,"
+                       "\"max_fails\":%ui,\"fail_timeout\":%T,"
+                       "\"state\":\"%s\",\"conns\":%ui,\"fails\":%ui},",
+                       backup ? "true" : "false", peer->weight,
+                       peer->max_conns, peer->max_fails, peer->fail_timeout,
+                       state, peer->conns, peer->fails);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_api_send(ngx_http_request_t *r, ngx_uint_t status,
+    ngx_buf_t *b)
+{
+    ngx_int_t    rc;
+    ngx_chain_t  out;
+
+    r->headers_out.status = status;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    r->headers_out.content_type_len = sizeof("application/json") - 1;
+    ngx_str_set(&r->headers_out.content_type, "application/json");
+    r->headers_out.content_type_lowcase = NULL;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static char *
+ngx_http_upstream_api(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_upstream_api_handler;
+
+    return NGX_CONF_OK;
+}
@@ -22,9 +22,16 @@ typedef struct {
 } ngx_http_upstream_chash_points_t;
 
 
+typedef struct {
+    ngx_uint_t                          number;
+    uint32_t                            peer[1];
+} ngx_http_upstream_maglev_t;
+
+
 typedef struct {
     ngx_http_complex_value_t            key;
     ngx_http_upstream_chash_points_t   *points;
+    ngx_http_upstream_maglev_t         *maglev;
 } ngx_http_upstream_hash_srv_conf_t;
 
 
@@ -58,11 +65,28 @@ static ngx_int_t ngx_http_upstream_init_chash_peer(ngx_http_request_t *r,
 static ngx_int_t ngx_http_upstream_get_chash_peer(ngx_peer_connection_t *pc,
     void *data);
 
+static ngx_int_t ngx_http_upstream_init_maglev(ngx_conf_t *cf,
+    ngx_http_upstream_srv_conf_t *us);
+static ngx_int_t ngx_http_upstream_init_maglev_peer(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *us);
+static ngx_int_t ngx_http_upstream_get_maglev_peer(ngx_peer_connection_t *pc,
+    void *data);
+
 static void *ngx_http_upstream_hash_create_conf(ngx_conf_t *cf);
 static char *ngx_http_upstream_hash(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 
 
+/*
+ * the lookup table size is a prime number,
+ * at least 100 times larger than the number of peers
+ */
+
+static ngx_uint_t  ngx_http_upstream_maglev_sizes[] = {
+    65537, 131071, 262139, 524287, 1048573, 2097143, 4194301
+};
+
+
 static ngx_command_t  ngx_http_upstream_hash_commands[] = {
 
     { ngx_string("hash"),
@@ -619,6 +643,227 @@ found:
 }
 
 
+static ngx_int_t
+ngx_http_upstream_init_maglev(ngx_conf_t *cf, ngx_http_upstream_srv_conf_t *us)
+{
+    size_t                              size;
+    uint32_t                            c, *offset, *skip;
+    ngx_uint_t                          i, n, w, filled;
+    ngx_http_upstream_rr_peer_t        *peer;
+    ngx_http_upstream_maglev_t         *maglev;
+    ngx_http_upstream_rr_peers_t       *peers;
+    ngx_http_upstream_hash_srv_conf_t  *hcf;
+
+    if (ngx_http_upstream_init_round_robin(cf, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    us->peer.init = ngx_http_upstream_init_maglev_peer;
+
+    peers = us->peer.data;
+
+    for (i = 0; i < sizeof(ngx_http_upstream_maglev_sizes)
+                    / sizeof(ngx_uint_t) - 1; i++)
+    {
+        if (ngx_http_upstream_maglev_sizes[i] >= peers->number * 100) {
+            break;
+        }
+    }
+
+    n = ngx_http_upstream_maglev_sizes[i];
+
+    maglev = ngx_palloc(cf->pool, sizeof(ngx_http_upstream_maglev_t)
+                                  + sizeof(uint32_t) * (n - 1));
+    if (maglev == NULL) {
+        return NGX_ERROR;
+    }
+
+    maglev->number = n;
+
+    for (i = 0; i < n; i++) {
+        maglev->peer[i] = (uint32_t) -1;
+    }
+
+    size = sizeof(uint32_t) * peers->number;
+
+    offset = ngx_palloc(cf->temp_pool, size);
+    if (offset == NULL) {
+        return NGX_ERROR;
+    }
+
+    skip = ngx_palloc(cf->temp_pool, size);
+    if (skip == NULL) {
+        return NGX_ERROR;
+    }
+
+    /*
+     * each peer fills the table in the order of its own permutation,
+     * (offset + j * skip) mod n, taking as many slots per round
+     * as its weight, until the table is full
+     */
+
+    for (peer = peers->peer, i = 0; peer; peer = peer->next, i++) {
+        offset[i] = ngx_crc32_long(peer->name.data, peer->name.len) % n;
+        skip[i] = ngx_murmur_hash2(peer->name.data, peer->name.len)
+                  % (n - 1) + 1;
+    }
+
+    filled = 0;
+
+    for ( ;; ) {
+        for (peer = peers->peer, i = 0; peer; peer = peer->next, i++) {
+            for (w = 0; w < (ngx_uint_t) peer->weight; w++) {
+
+                c = offset[i];
+
+                while (maglev->peer[c] != (uint32_t) -1) {
+                    c = (uint32_t) ((c + skip[i]) % n);
+                }
+
+                maglev->peer[c] = (uint32_t) i;
+                offset[i] = (uint32_t) ((c + skip[i]) % n);
+
+                if (++filled == n) {
+                    goto done;
+                }
+            }
+        }
+    }
+
+done:
+
+    hcf = ngx_http_conf_upstream_srv_conf(us, ngx_http_upstream_hash_module);
+    hcf->maglev = maglev;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_init_maglev_peer(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_http_upstream_hash_srv_conf_t   *hcf;
+    ngx_http_upstream_hash_peer_data_t  *hp;
+
+    if (ngx_http_upstream_init_hash_peer(r, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->upstream->peer.get = ngx_http_upstream_get_maglev_peer;
+
+    hp = r->upstream->peer.data;
+    hcf = ngx_http_conf_upstream_srv_conf(us, ngx_http_upstream_hash_module);
+
+    hp->hash = ngx_crc32_long(hp->key.data, hp->key.len)
+               % hcf->maglev->number;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_get_maglev_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_http_upstream_hash_peer_data_t  *hp = data;
+
+    time_t                        now;
+    uintptr_t                     m;
+    ngx_uint_t                    i, n, p;
+    ngx_http_upstream_rr_peer_t  *peer;
+    ngx_http_upstream_maglev_t   *maglev;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "get maglev hash peer, try: %ui", pc->tries);
+
+    ngx_http_upstream_rr_peers_rlock(hp->rrp.peers);
+
+    if (hp->tries > 20 || hp->rrp.peers->single || hp->key.len == 0) {
+        ngx_http_upstream_rr_peers_unlock(hp->rrp.peers);
+        return hp->get_rr_peer(pc, &hp->rrp);
+    }
+
+    now = ngx_time();
+
+    pc->cached = 0;
+    pc->connection = NULL;
+
+    maglev = hp->conf->maglev;
+
+    for ( ;; ) {
+
+        /* the next slots of the table are used on failures */
+
+        p = maglev->peer[hp->hash % maglev->number];
+
+        for (peer = hp->rrp.peers->peer, i = 0; i < p; i++) {
+            peer = peer->next;
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                       "get maglev hash peer, value:%uD, peer:%ui",
+                       hp->hash, p);
+
+        n = p / (8 * sizeof(uintptr_t));
+        m = (uintptr_t) 1 << p % (8 * sizeof(uintptr_t));
+
+        if (hp->rrp.tried[n] & m) {
+            goto next;
+        }
+
+        ngx_http_upstream_rr_peer_lock(hp->rrp.peers, peer);
+
+        if (peer->down) {
+            ngx_http_upstream_rr_peer_unlock(hp->rrp.peers, peer);
+            goto next;
+        }
+
+        if (peer->max_fails
+            && peer->fails >= peer->max_fails
+            && now - peer->checked <= peer->fail_timeout)
+        {
+            ngx_http_upstream_rr_peer_unlock(hp->rrp.peers, peer);
+            goto next;
+        }
+
+        if (peer->max_conns && peer->conns >= peer->max_conns) {
+            ngx_http_upstream_rr_peer_unlock(hp->rrp.peers, peer);
+            goto next;
+        }
+
+        break;
+
+    next:
+
+        hp->hash++;
+
+        if (++hp->tries > 20) {
+            ngx_http_upstream_rr_peers_unlock(hp->rrp.peers);
+            return hp->get_rr_peer(pc, &hp->rrp);
+        }
+    }
+
+    hp->rrp.current = peer;
+
+    pc->sockaddr = peer->sockaddr;
+    pc->socklen = peer->socklen;
+    pc->name = &peer->name;
+
+    peer->conns++;
+
+    if (now - peer->checked > peer->fail_timeout) {
+        peer->checked = now;
+    }
+
+    ngx_http_upstream_rr_peer_unlock(hp->rrp.peers, peer);
+    ngx_http_upstream_rr_peers_unlock(hp->rrp.peers);
+
+    hp->rrp.tried[n] |= m;
+
+    return NGX_OK;
+}
+
+
 static void *
 ngx_http_upstream_hash_create_conf(ngx_conf_t *cf)
 {
@@ -630,6 +875,7 @@ ngx_http_upstream_hash_create_conf(ngx_conf_t *cf)
     }
 
     conf->points = NULL;
+    conf->maglev = NULL;
 
     return conf;
 }
@@ -676,6 +922,9 @@ ngx_http_upstream_hash(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     } else if (ngx_strcmp(value[2].data, "consistent") == 0) {
         uscf->peer.init_upstream = ngx_http_upstream_init_chash;
 
+    } else if (ngx_strcmp(value[2].data, "maglev") == 0) {
+        uscf->peer.init_upstream = ngx_http_upstream_init_maglev;
+
     } else {
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                            "invalid parameter \"%V\"", &value[2]);
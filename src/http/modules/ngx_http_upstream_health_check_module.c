@@ -0,0 +1,772 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_UPSTREAM_HC_TCP    0
+#define NGX_HTTP_UPSTREAM_HC_HTTP   1
+
+#define NGX_HTTP_UPSTREAM_HC_BUFFER_SIZE  1024
+
+
+typedef struct {
+    ngx_uint_t                        type;
+    ngx_msec_t                        interval;
+    ngx_msec_t                        timeout;
+    ngx_uint_t                        fails;
+    ngx_uint_t                        passes;
+    ngx_str_t                         uri;
+    ngx_str_t                         request;
+
+    ngx_http_upstream_srv_conf_t     *upstream;
+    ngx_event_t                       event;
+} ngx_http_upstream_hc_srv_conf_t;
+
+
+typedef struct {
+    ngx_http_upstream_hc_srv_conf_t  *conf;
+    ngx_http_upstream_rr_peers_t     *peers;
+    ngx_http_upstream_rr_peer_t      *peer;
+    ngx_peer_connection_t             pc;
+    ngx_buf_t                        *buffer;
+    size_t                            sent;
+    ngx_pool_t                       *pool;
+} ngx_http_upstream_hc_probe_t;
+
+
+static void ngx_http_upstream_hc_handler(ngx_event_t *ev);
+static void ngx_http_upstream_hc_start(ngx_http_upstream_hc_srv_conf_t *hcf,
+    ngx_http_upstream_rr_peers_t *peers, ngx_http_upstream_rr_peer_t *peer);
+static void ngx_http_upstream_hc_write_handler(ngx_event_t *wev);
+static void ngx_http_upstream_hc_read_handler(ngx_event_t *rev);
+static ngx_int_t ngx_http_upstream_hc_test_connect(ngx_connection_t *c);
+static ngx_int_t ngx_http_upstream_hc_parse_status(ngx_buf_t *b);
+static void ngx_http_upstream_hc_finalize(ngx_http_upstream_hc_probe_t *hp,
+    ngx_uint_t ok);
+
+static void *ngx_http_upstream_hc_create_conf(ngx_conf_t *cf);
+static char *ngx_http_upstream_hc_init_main_conf(ngx_conf_t *cf, void *conf);
+static char *ngx_http_upstream_health_check(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_int_t ngx_http_upstream_hc_init_process(ngx_cycle_t *cycle);
+
+
+static ngx_command_t  ngx_http_upstream_hc_commands[] = {
+
+    { ngx_string("health_check"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_ANY,
+      ngx_http_upstream_health_check,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_upstream_health_check_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    ngx_http_upstream_hc_init_main_conf,   /* init main configuration */
+
+    ngx_http_upstream_hc_create_conf,      /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_upstream_health_check_module = {
+    NGX_MODULE_V1,
+    &ngx_http_upstream_health_check_module_ctx, /* module context */
+    ngx_http_upstream_hc_commands,         /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    ngx_http_upstream_hc_init_process,     /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * Each worker process runs the timer, and a peer is probed by the worker
+ * which first notices that its interval has passed: peer->hc_checked is
+ * in the upstream zone, so the probes are not multiplied by the number
+ * of workers.
+ */
+
+static void
+ngx_http_upstream_hc_handler(ngx_event_t *ev)
+{
+    ngx_uint_t                        due;
+    ngx_http_upstream_rr_peer_t      *peer;
+    ngx_http_upstream_rr_peers_t     *peers;
+    ngx_http_upstream_hc_srv_conf_t  *hcf;
+
+    hcf = ev->data;
+
+    if (ngx_exiting || ngx_terminate || ngx_quit) {
+        return;
+    }
+
+    for (peers = hcf->upstream->peer.data; peers; peers = peers->next) {
+
+        ngx_http_upstream_rr_peers_rlock(peers);
+
+        for (peer = peers->peer; peer; peer = peer->next) {
+
+            if (peer->down & ~NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY) {
+                continue;
+            }
+
+            ngx_http_upstream_rr_peer_lock(peers, peer);
+
+            due = (ngx_msec_int_t) (ngx_current_msec - peer->hc_checked)
+                  >= (ngx_msec_int_t) hcf->interval;
+
+            if (due) {
+                peer->hc_checked = ngx_current_msec;
+            }
+
+            ngx_http_upstream_rr_peer_unlock(peers, peer);
+
+            if (due) {
+                ngx_http_upstream_hc_start(hcf, peers, peer);
+            }
+        }
+
+        ngx_http_upstream_rr_peers_unlock(peers);
+    }
+
+    ngx_add_timer(ev, hcf->interval);
+}
+
+
+static void
+ngx_http_upstream_hc_start(ngx_http_upstream_hc_srv_conf_t *hcf,
+    ngx_http_upstream_rr_peers_t *peers, ngx_http_upstream_rr_peer_t *peer)
+{
+    ngx_int_t                      rc;
+    ngx_pool_t                    *pool;
+    ngx_connection_t              *c;
+    ngx_http_upstream_hc_probe_t  *hp;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "health check %V", &peer->name);
+
+    pool = ngx_create_pool(1024, ngx_cycle->log);
+    if (pool == NULL) {
+        return;
+    }
+
+    hp = ngx_pcalloc(pool, sizeof(ngx_http_upstream_hc_probe_t));
+    if (hp == NULL) {
+        ngx_destroy_pool(pool);
+        return;
+    }
+
+    hp->conf = hcf;
+    hp->peers = peers;
+    hp->peer = peer;
+    hp->pool = pool;
+
+    if (hcf->type == NGX_HTTP_UPSTREAM_HC_HTTP) {
+        hp->buffer = ngx_create_temp_buf(pool,
+                                         NGX_HTTP_UPSTREAM_HC_BUFFER_SIZE);
+        if (hp->buffer == NULL) {
+            ngx_destroy_pool(pool);
+            return;
+        }
+    }
+
+    hp->pc.sockaddr = peer->sockaddr;
+    hp->pc.socklen = peer->socklen;
+    hp->pc.name = &peer->name;
+    hp->pc.get = ngx_event_get_peer;
+    hp->pc.log = ngx_cycle->log;
+    hp->pc.log_error = NGX_ERROR_ERR;
+
+    rc = ngx_event_connect_peer(&hp->pc);
+
+    if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
+        ngx_http_upstream_hc_finalize(hp, 0);
+        return;
+    }
+
+    c = hp->pc.connection;
+
+    c->data = hp;
+    c->pool = pool;
+
+    c->write->handler = ngx_http_upstream_hc_write_handler;
+    c->read->handler = ngx_http_upstream_hc_read_handler;
+
+    ngx_add_timer(c->write, hcf->timeout);
+
+    if (rc == NGX_OK) {
+        ngx_http_upstream_hc_write_handler(c->write);
+    }
+}
+
+
+static void
+ngx_http_upstream_hc_write_handler(ngx_event_t *wev)
+{
+    ssize_t                           n;
+    ngx_connection_t                 *c;
+    ngx_http_upstream_hc_probe_t     *hp;
+    ngx_http_upstream_hc_srv_conf_t  *hcf;
+
+    c = wev->data;
+    hp = c->data;
+    hcf = hp->conf;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, wev->log, 0,
+                   "health check write handler, timedout:%d", wev->timedout);
+
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "health check of %V timed out", &hp->peer->name);
+        ngx_http_upstream_hc_finalize(hp, 0);
+        return;
+    }
+
+    if (ngx_http_upstream_hc_test_connect(c) != NGX_OK) {
+        ngx_http_upstream_hc_finalize(hp, 0);
+        return;
+    }
+
+    if (hcf->type == NGX_HTTP_UPSTREAM_HC_TCP) {
+        ngx_http_upstream_hc_finalize(hp, 1);
+        return;
+    }
+
+    while (hp->sent < hcf->request.len) {
+
+        n = c->send(c, hcf->request.data + hp->sent,
+                    hcf->request.len - hp->sent);
+
+        if (n == NGX_AGAIN) {
+            if (ngx_handle_write_event(wev, 0) != NGX_OK) {
+                ngx_http_upstream_hc_finalize(hp, 0);
+            }
+
+            return;
+        }
+
+        if (n == NGX_ERROR) {
+            ngx_http_upstream_hc_finalize(hp, 0);
+            return;
+        }
+
+        hp->sent += n;
+    }
+
+    if (wev->timer_set) {
+        ngx_del_timer(wev);
+    }
+
+    wev->handler = ngx_http_empty_handler;
+
+    if (!c->read->timer_set) {
+        ngx_add_timer(c->read, hcf->timeout);
+    }
+
+    if (c->read->ready) {
+        ngx_http_upstream_hc_read_handler(c->read);
+        return;
+    }
+
+    if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+        ngx_http_upstream_hc_finalize(hp, 0);
+    }
+}
+
+
+static void
+ngx_http_upstream_hc_read_handler(ngx_event_t *rev)
+{
+    ssize_t                        n;
+    ngx_int_t                      rc;
+    ngx_buf_t                     *b;
+    ngx_connection_t              *c;
+    ngx_http_upstream_hc_probe_t  *hp;
+
+    c = rev->data;
+    hp = c->data;
+    b = hp->buffer;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, rev->log, 0,
+                   "health check read handler, timedout:%d", rev->timedout);
+
+    if (rev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "health check of %V timed out", &hp->peer->name);
+        ngx_http_upstream_hc_finalize(hp, 0);
+        return;
+    }
+
+    if (b == NULL || hp->sent < hp->conf->request.len) {
+
+        /* the check is completed or the request is sent by the write event */
+
+        if (ngx_http_upstream_hc_test_connect(c) != NGX_OK
+            || ngx_handle_read_event(rev, 0) != NGX_OK)
+        {
+            ngx_http_upstream_hc_finalize(hp, 0);
+        }
+
+        return;
+    }
+
+    for ( ;; ) {
+
+        n = c->recv(c, b->last, b->end - b->last);
+
+        if (n == NGX_AGAIN) {
+            if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+                ngx_http_upstream_hc_finalize(hp, 0);
+            }
+
+            return;
+        }
+
+        if (n == NGX_ERROR || n == 0) {
+            ngx_log_error(NGX_LOG_ERR, c->log, 0,
+                          "health check of %V: "
+                          "connection closed prematurely", &hp->peer->name);
+            ngx_http_upstream_hc_finalize(hp, 0);
+            return;
+        }
+
+        b->last += n;
+
+        rc = ngx_http_upstream_hc_parse_status(b);
+
+        if (rc == NGX_AGAIN && b->last < b->end) {
+            continue;
+        }
+
+        if (rc == NGX_AGAIN || rc == NGX_ERROR) {
+            ngx_log_error(NGX_LOG_ERR, c->log, 0,
+                          "health check of %V: invalid status line",
+                          &hp->peer->name);
+            ngx_http_upstream_hc_finalize(hp, 0);
+            return;
+        }
+
+        if (rc < NGX_HTTP_OK || rc >= NGX_HTTP_BAD_REQUEST) {
+            ngx_log_error(NGX_LOG_ERR, c->log, 0,
+                          "health check of %V: status %i",
+                          &hp->peer->name, rc);
+            ngx_http_upstream_hc_finalize(hp, 0);
+            return;
+        }
+
+        ngx_http_upstream_hc_finalize(hp, 1);
+        return;
+    }
+}
+
+
+static ngx_int_t
+ngx_http_upstream_hc_test_connect(ngx_connection_t *c)
+{
+    int        err;
+    socklen_t  len;
+
+#if (NGX_HAVE_KQUEUE)
+
+    if (ngx_event_flags & NGX_USE_KQUEUE_EVENT) {
+        if (c->write->pending_eof || c->read->pending_eof) {
+            err = c->write->pending_eof ? c->write->kq_errno
+                                        : c->read->kq_errno;
+
+            ngx_log_error(NGX_LOG_ERR, c->log, err,
+                          "kevent() reported that health check "
+                          "connect() failed");
+            return NGX_ERROR;
+        }
+
+    } else
+#endif
+    {
+        err = 0;
+        len = sizeof(int);
+
+        if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, (void *) &err, &len)
+            == -1)
+        {
+            err = ngx_socket_errno;
+        }
+
+        if (err) {
+            ngx_log_error(NGX_LOG_ERR, c->log, err,
+                          "health check connect() failed");
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_hc_parse_status(ngx_buf_t *b)
+{
+    u_char      *p;
+    ngx_uint_t   i;
+    ngx_int_t    status;
+
+    /* "HTTP/1.x NNN" */
+
+    if (b->last - b->pos < 12) {
+        return (ngx_strncmp(b->pos, "HTTP/1.",
+                            ngx_min(b->last - b->pos, 7)) == 0)
+               ? NGX_AGAIN : NGX_ERROR;
+    }
+
+    p = b->pos;
+
+    if (ngx_strncmp(p, "HTTP/1.", 7) != 0 || p[8] != ' ') {
+        return NGX_ERROR;
+    }
+
+    status = 0;
+
+    for (i = 9; i < 12; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return NGX_ERROR;
+        }
+
+        status = status * 10 + (p[i] - '0');
+    }
+
+    return status;
+}
+
+
+static void
+ngx_http_upstream_hc_finalize(ngx_http_upstream_hc_probe_t *hp, ngx_uint_t ok)
+{
+    ngx_http_upstream_rr_peer_t      *peer;
+    ngx_http_upstream_rr_peers_t     *peers;
+    ngx_http_upstream_hc_srv_conf_t  *hcf;
+
+    hcf = hp->conf;
+    peers = hp->peers;
+    peer = hp->peer;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "health check %V: %ui", &peer->name, ok);
+
+    ngx_http_upstream_rr_peers_rlock(peers);
+    ngx_http_upstream_rr_peer_lock(peers, peer);
+
+    if (ok) {
+        peer->hc_fails = 0;
+        peer->hc_passes++;
+
+        if ((peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY)
+            && peer->hc_passes >= hcf->passes)
+        {
+            peer->down &= ~NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY;
+
+            /* forget passive failures */
+
+            peer->fails = 0;
+
+            ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
+                          "upstream server %V in upstream \"%V\" "
+                          "is healthy", &peer->name, &hcf->upstream->host);
+        }
+
+    } else {
+        peer->hc_passes = 0;
+        peer->hc_fails++;
+
+        if (!(peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY)
+            && peer->hc_fails >= hcf->fails)
+        {
+            peer->down |= NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY;
+
+            ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, 0,
+                          "upstream server %V in upstream \"%V\" "
+                          "is unhealthy", &peer->name, &hcf->upstream->host);
+        }
+    }
+
+    ngx_http_upstream_rr_peer_unlock(peers, peer);
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+    if (hp->pc.connection) {
+        ngx_close_connection(hp->pc.connection);
+    }
+
+    ngx_destroy_pool(hp->pool);
+}
+
+
+static void *
+ngx_http_upstream_hc_create_conf(ngx_conf_t *cf)
+{
+    ngx_http_upstream_hc_srv_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_upstream_hc_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     conf->type = 0;
+     *     conf->uri = { 0, NULL };
+     *     conf->request = { 0, NULL };
+     *     conf->upstream = NULL;
+     */
+
+    return conf;
+}
+
+
+static char *
+ngx_http_upstream_hc_init_main_conf(ngx_conf_t *cf, void *conf)
+{
+    ngx_uint_t                         i;
+    ngx_http_upstream_srv_conf_t     **uscfp;
+    ngx_http_upstream_main_conf_t     *umcf;
+    ngx_http_upstream_hc_srv_conf_t   *hcf;
+
+    umcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_upstream_module);
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        hcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                        ngx_http_upstream_health_check_module);
+
+        if (hcf->upstream == NULL) {
+            continue;
+        }
+
+        if (uscfp[i]->shm_zone == NULL) {
+            ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                          "health_check requires \"zone\" "
+                          "in upstream \"%V\" in %s:%ui",
+                          &uscfp[i]->host, uscfp[i]->file_name,
+                          uscfp[i]->line);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_upstream_health_check(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_upstream_hc_srv_conf_t  *hcf = conf;
+
+    u_char                        *p;
+    ngx_int_t                      n;
+    ngx_str_t                     *value, s;
+    ngx_uint_t                     i;
+    ngx_http_upstream_srv_conf_t  *uscf;
+
+    if (hcf->upstream) {
+        return "is duplicate";
+    }
+
+    uscf = ngx_http_conf_get_module_srv_conf(cf, ngx_http_upstream_module);
+
+    hcf->upstream = uscf;
+    hcf->type = NGX_HTTP_UPSTREAM_HC_HTTP;
+    hcf->interval = 5000;
+    hcf->timeout = 1000;
+    hcf->fails = 1;
+    hcf->passes = 1;
+    ngx_str_set(&hcf->uri, "/");
+
+    value = cf->args->elts;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "interval=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            hcf->interval = ngx_parse_time(&s, 0);
+
+            if (hcf->interval == (ngx_msec_t) NGX_ERROR
+                || hcf->interval == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "timeout=", 8) == 0) {
+
+            s.len = value[i].len - 8;
+            s.data = value[i].data + 8;
+
+            hcf->timeout = ngx_parse_time(&s, 0);
+
+            if (hcf->timeout == (ngx_msec_t) NGX_ERROR
+                || hcf->timeout == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "fails=", 6) == 0) {
+
+            n = ngx_atoi(&value[i].data[6], value[i].len - 6);
+
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            hcf->fails = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "passes=", 7) == 0) {
+
+            n = ngx_atoi(&value[i].data[7], value[i].len - 7);
+
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            hcf->passes = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "uri=", 4) == 0) {
+
+            hcf->uri.len = value[i].len - 4;
+            hcf->uri.data = value[i].data + 4;
+
+            if (hcf->uri.len == 0 || hcf->uri.data[0] != '/') {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "type=tcp") == 0) {
+            hcf->type = NGX_HTTP_UPSTREAM_HC_TCP;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "type=http") == 0) {
+            hcf->type = NGX_HTTP_UPSTREAM_HC_HTTP;
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    if (hcf->type == NGX_HTTP_UPSTREAM_HC_HTTP) {
+
+        hcf->request.len = sizeof("GET  HTTP/1.0" CRLF "Host: " CRLF
+                                  "User-Agent: nginx" CRLF CRLF) - 1
+                           + hcf->uri.len + uscf->host.len;
+
+        p = ngx_pnalloc(cf->pool, hcf->request.len);
+        if (p == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        hcf->request.data = p;
+
+        ngx_sprintf(p, "GET %V HTTP/1.0" CRLF "Host: %V" CRLF
+                    "User-Agent: nginx" CRLF CRLF, &hcf->uri, &uscf->host);
+    }
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_hc_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                         i;
+    ngx_event_t                       *ev;
+    ngx_http_upstream_srv_conf_t     **uscfp;
+    ngx_http_upstream_main_conf_t     *umcf;
+    ngx_http_upstream_hc_srv_conf_t   *hcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    umcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_upstream_module);
+
+    if (umcf == NULL) {
+        return NGX_OK;
+    }
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        hcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                        ngx_http_upstream_health_check_module);
+
+        if (hcf->upstream == NULL) {
+            continue;
+        }
+
+        ev = &hcf->event;
+
+        ev->handler = ngx_http_upstream_hc_handler;
+        ev->data = hcf;
+        ev->log = cycle->log;
+        ev->cancelable = 1;
+
+        ngx_add_timer(ev, 0);
+    }
+
+    return NGX_OK;
+}
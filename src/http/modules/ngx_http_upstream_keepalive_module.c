@@ -19,12 +19,36 @@ typedef struct {
     ngx_queue_t                        cache;
     ngx_queue_t                        free;
 
+    ngx_uint_t                         prewarm;
+    ngx_msec_t                         prewarm_interval;
+
+    ngx_queue_t                        connecting;
+    ngx_event_t                        prewarm_event;
+
+    ngx_array_t                        stats;
+
+    ngx_http_upstream_srv_conf_t      *upstream;
+
     ngx_http_upstream_init_pt          original_init_upstream;
     ngx_http_upstream_init_peer_pt     original_init_peer;
 
 } ngx_http_upstream_keepalive_srv_conf_t;
 
 
+typedef struct {
+    ngx_str_t                          name;
+
+    socklen_t                          socklen;
+    ngx_sockaddr_t                     sockaddr;
+
+    ngx_uint_t                         opened;
+    ngx_uint_t                         reused;
+    ngx_uint_t                         missed;
+    ngx_uint_t                         closed;
+
+} ngx_http_upstream_keepalive_stats_t;
+
+
 typedef struct {
     ngx_http_upstream_keepalive_srv_conf_t  *conf;
 
@@ -66,6 +90,20 @@ static void ngx_http_upstream_keepalive_dummy_handler(ngx_event_t *ev);
 static void ngx_http_upstream_keepalive_close_handler(ngx_event_t *ev);
 static void ngx_http_upstream_keepalive_close(ngx_connection_t *c);
 
+static void ngx_http_upstream_keepalive_prewarm_handler(ngx_event_t *ev);
+static ngx_int_t ngx_http_upstream_keepalive_prewarm_peer(
+    ngx_http_upstream_keepalive_srv_conf_t *kcf,
+    ngx_http_upstream_rr_peer_t *peer);
+static void ngx_http_upstream_keepalive_connected_handler(ngx_event_t *ev);
+static ngx_uint_t ngx_http_upstream_keepalive_count(ngx_queue_t *queue,
+    struct sockaddr *sockaddr, socklen_t socklen);
+static ngx_http_upstream_keepalive_stats_t *
+    ngx_http_upstream_keepalive_get_stats(
+    ngx_http_upstream_keepalive_srv_conf_t *kcf, struct sockaddr *sockaddr,
+    socklen_t socklen, ngx_str_t *name);
+static ngx_int_t ngx_http_upstream_keepalive_status_handler(
+    ngx_http_request_t *r);
+
 #if (NGX_HTTP_SSL)
 static ngx_int_t ngx_http_upstream_keepalive_set_session(
     ngx_peer_connection_t *pc, void *data);
@@ -76,6 +114,11 @@ static void ngx_http_upstream_keepalive_save_session(ngx_peer_connection_t *pc,
 static void *ngx_http_upstream_keepalive_create_conf(ngx_conf_t *cf);
 static char *ngx_http_upstream_keepalive(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_upstream_keepalive_prewarm(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+static char *ngx_http_upstream_keepalive_status(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+static ngx_int_t ngx_http_upstream_keepalive_init_process(ngx_cycle_t *cycle);
 
 
 static ngx_command_t  ngx_http_upstream_keepalive_commands[] = {
@@ -108,6 +151,20 @@ static ngx_command_t  ngx_http_upstream_keepalive_commands[] = {
       offsetof(ngx_http_upstream_keepalive_srv_conf_t, requests),
       NULL },
 
+    { ngx_string("keepalive_prewarm"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_TAKE12,
+      ngx_http_upstream_keepalive_prewarm,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("upstream_keepalive_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_upstream_keepalive_status,
+      0,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -134,7 +191,7 @@ ngx_module_t  ngx_http_upstream_keepalive_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_upstream_keepalive_init_process, /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -148,6 +205,7 @@ ngx_http_upstream_init_keepalive(ngx_conf_t *cf,
     ngx_http_upstream_srv_conf_t *us)
 {
     ngx_uint_t                               i;
+    ngx_http_upstream_rr_peers_t            *peers;
     ngx_http_upstream_keepalive_srv_conf_t  *kcf;
     ngx_http_upstream_keepalive_cache_t     *cached;
 
@@ -160,11 +218,31 @@ ngx_http_upstream_init_keepalive(ngx_conf_t *cf,
     ngx_conf_init_msec_value(kcf->time, 3600000);
     ngx_conf_init_msec_value(kcf->timeout, 60000);
     ngx_conf_init_uint_value(kcf->requests, 1000);
+    ngx_conf_init_msec_value(kcf->prewarm_interval, 1000);
 
     if (kcf->original_init_upstream(cf, us) != NGX_OK) {
         return NGX_ERROR;
     }
 
+    kcf->upstream = us;
+
+    if (ngx_array_init(&kcf->stats, cf->pool, 4,
+                       sizeof(ngx_http_upstream_keepalive_stats_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    peers = us->peer.data;
+
+    if (kcf->prewarm && kcf->prewarm * peers->number > kcf->max_cached) {
+        ngx_log_error(NGX_LOG_WARN, cf->log, 0,
+                      "keepalive_prewarm %ui for %ui servers in upstream "
+                      "\"%V\" exceeds keepalive %ui",
+                      kcf->prewarm, peers->number, &us->host,
+                      kcf->max_cached);
+    }
+
     kcf->original_init_peer = us->peer.init;
 
     us->peer.init = ngx_http_upstream_init_keepalive_peer;
@@ -179,6 +257,7 @@ ngx_http_upstream_init_keepalive(ngx_conf_t *cf,
 
     ngx_queue_init(&kcf->cache);
     ngx_queue_init(&kcf->free);
+    ngx_queue_init(&kcf->connecting);
 
     for (i = 0; i < kcf->max_cached; i++) {
         ngx_queue_insert_head(&kcf->free, &cached[i].queue);
@@ -237,6 +316,7 @@ ngx_http_upstream_get_keepalive_peer(ngx_peer_connection_t *pc, void *data)
 {
     ngx_http_upstream_keepalive_peer_data_t  *kp = data;
     ngx_http_upstream_keepalive_cache_t      *item;
+    ngx_http_upstream_keepalive_stats_t      *stats;
 
     ngx_int_t          rc;
     ngx_queue_t       *q, *cache;
@@ -255,6 +335,9 @@ ngx_http_upstream_get_keepalive_peer(ngx_peer_connection_t *pc, void *data)
 
     /* search cache for suitable connection */
 
+    stats = ngx_http_upstream_keepalive_get_stats(kp->conf, pc->sockaddr,
+                                                  pc->socklen, pc->name);
+
     cache = &kp->conf->cache;
 
     for (q = ngx_queue_head(cache);
@@ -275,10 +358,18 @@ ngx_http_upstream_get_keepalive_peer(ngx_peer_connection_t *pc, void *data)
         }
     }
 
+    if (stats) {
+        stats->missed++;
+    }
+
     return NGX_OK;
 
 found:
 
+    if (stats) {
+        stats->reused++;
+    }
+
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
                    "get keepalive peer: using connection %p", c);
 
@@ -423,6 +514,7 @@ ngx_http_upstream_keepalive_close_handler(ngx_event_t *ev)
 {
     ngx_http_upstream_keepalive_srv_conf_t  *conf;
     ngx_http_upstream_keepalive_cache_t     *item;
+    ngx_http_upstream_keepalive_stats_t     *stats;
 
     int                n;
     char               buf[1];
@@ -454,6 +546,13 @@ close:
     item = c->data;
     conf = item->conf;
 
+    stats = ngx_http_upstream_keepalive_get_stats(conf,
+                                         &item->sockaddr.sockaddr,
+                                         item->socklen, NULL);
+    if (stats) {
+        stats->closed++;
+    }
+
     ngx_http_upstream_keepalive_close(c);
 
     ngx_queue_remove(&item->queue);
@@ -484,6 +583,435 @@ ngx_http_upstream_keepalive_close(ngx_connection_t *c)
 }
 
 
+static void
+ngx_http_upstream_keepalive_prewarm_handler(ngx_event_t *ev)
+{
+    ngx_http_upstream_keepalive_srv_conf_t  *kcf;
+
+    time_t                         now;
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    kcf = ev->data;
+
+    if (ngx_exiting || ngx_terminate) {
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "keepalive prewarm \"%V\"", &kcf->upstream->host);
+
+    now = ngx_time();
+    peers = kcf->upstream->peer.data;
+
+    ngx_http_upstream_rr_peers_rlock(peers);
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+
+        if (peer->down) {
+            continue;
+        }
+
+        if (peer->max_fails
+            && peer->fails >= peer->max_fails
+            && now - peer->checked <= peer->fail_timeout)
+        {
+            continue;
+        }
+
+        if (ngx_http_upstream_keepalive_prewarm_peer(kcf, peer) != NGX_OK) {
+            break;
+        }
+    }
+
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+    ngx_add_timer(ev, kcf->prewarm_interval);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_keepalive_prewarm_peer(
+    ngx_http_upstream_keepalive_srv_conf_t *kcf,
+    ngx_http_upstream_rr_peer_t *peer)
+{
+    ngx_int_t                             rc;
+    ngx_uint_t                            n;
+    ngx_queue_t                          *q;
+    ngx_connection_t                     *c;
+    ngx_peer_connection_t                 pc;
+    ngx_http_upstream_keepalive_cache_t  *item;
+
+    n = ngx_http_upstream_keepalive_count(&kcf->cache, peer->sockaddr,
+                                          peer->socklen)
+        + ngx_http_upstream_keepalive_count(&kcf->connecting, peer->sockaddr,
+                                            peer->socklen);
+
+    if (n >= kcf->prewarm) {
+        return NGX_OK;
+    }
+
+    if (ngx_http_upstream_keepalive_get_stats(kcf, peer->sockaddr,
+                                              peer->socklen, &peer->name)
+        == NULL)
+    {
+        return NGX_ERROR;
+    }
+
+    while (n++ < kcf->prewarm) {
+
+        if (ngx_queue_empty(&kcf->free)) {
+            return NGX_DECLINED;
+        }
+
+        ngx_memzero(&pc, sizeof(ngx_peer_connection_t));
+
+        pc.sockaddr = peer->sockaddr;
+        pc.socklen = peer->socklen;
+        pc.name = &peer->name;
+        pc.get = ngx_event_get_peer;
+        pc.log = ngx_cycle->log;
+        pc.log_error = NGX_ERROR_ERR;
+
+        rc = ngx_event_connect_peer(&pc);
+
+        if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
+            return NGX_OK;
+        }
+
+        c = pc.connection;
+
+        c->pool = ngx_create_pool(128, ngx_cycle->log);
+        if (c->pool == NULL) {
+            ngx_close_connection(c);
+            return NGX_ERROR;
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                       "keepalive prewarm %V: connection %p",
+                       &peer->name, c);
+
+        q = ngx_queue_head(&kcf->free);
+        ngx_queue_remove(q);
+        ngx_queue_insert_head(&kcf->connecting, q);
+
+        item = ngx_queue_data(q, ngx_http_upstream_keepalive_cache_t, queue);
+
+        item->connection = c;
+        item->socklen = peer->socklen;
+        ngx_memcpy(&item->sockaddr, peer->sockaddr, peer->socklen);
+
+        c->data = item;
+        c->idle = 1;
+
+        c->read->handler = ngx_http_upstream_keepalive_connected_handler;
+        c->write->handler = ngx_http_upstream_keepalive_connected_handler;
+
+        if (rc == NGX_OK) {
+            ngx_http_upstream_keepalive_connected_handler(c->write);
+            continue;
+        }
+
+        /* rc == NGX_AGAIN */
+
+        ngx_add_timer(c->write, kcf->timeout);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_keepalive_connected_handler(ngx_event_t *ev)
+{
+    ngx_http_upstream_keepalive_srv_conf_t  *kcf;
+    ngx_http_upstream_keepalive_cache_t     *item;
+    ngx_http_upstream_keepalive_stats_t     *stats;
+
+    int                err;
+    socklen_t          len;
+    ngx_connection_t  *c;
+
+    c = ev->data;
+    item = c->data;
+    kcf = item->conf;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "keepalive connected handler, timedout:%d", ev->timedout);
+
+    if (c->close) {
+        goto close;
+    }
+
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "keepalive prewarm connect() timed out");
+        goto close;
+    }
+
+#if (NGX_HAVE_KQUEUE)
+
+    if (ngx_event_flags & NGX_USE_KQUEUE_EVENT) {
+        if (c->write->pending_eof || c->read->pending_eof) {
+            err = c->write->pending_eof ? c->write->kq_errno
+                                        : c->read->kq_errno;
+
+            ngx_log_error(NGX_LOG_ERR, c->log, err,
+                          "kevent() reported that keepalive prewarm "
+                          "connect() failed");
+            goto close;
+        }
+
+    } else
+#endif
+    {
+        err = 0;
+        len = sizeof(int);
+
+        if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, (void *) &err, &len)
+            == -1)
+        {
+            err = ngx_socket_errno;
+        }
+
+        if (err) {
+            ngx_log_error(NGX_LOG_ERR, c->log, err,
+                          "keepalive prewarm connect() failed");
+            goto close;
+        }
+    }
+
+    if (c->write->timer_set) {
+        ngx_del_timer(c->write);
+    }
+
+    c->write->handler = ngx_http_upstream_keepalive_dummy_handler;
+    c->read->handler = ngx_http_upstream_keepalive_close_handler;
+
+    if (ngx_handle_write_event(c->write, 0) != NGX_OK
+        || ngx_handle_read_event(c->read, 0) != NGX_OK)
+    {
+        goto close;
+    }
+
+    ngx_queue_remove(&item->queue);
+    ngx_queue_insert_head(&kcf->cache, &item->queue);
+
+    ngx_add_timer(c->read, kcf->timeout);
+
+    stats = ngx_http_upstream_keepalive_get_stats(kcf,
+                                                  &item->sockaddr.sockaddr,
+                                                  item->socklen, NULL);
+    if (stats) {
+        stats->opened++;
+    }
+
+    if (c->read->ready) {
+        ngx_http_upstream_keepalive_close_handler(c->read);
+    }
+
+    return;
+
+close:
+
+    ngx_http_upstream_keepalive_close(c);
+
+    ngx_queue_remove(&item->queue);
+    ngx_queue_insert_head(&kcf->free, &item->queue);
+}
+
+
+static ngx_uint_t
+ngx_http_upstream_keepalive_count(ngx_queue_t *queue,
+    struct sockaddr *sockaddr, socklen_t socklen)
+{
+    ngx_uint_t                            n;
+    ngx_queue_t                          *q;
+    ngx_http_upstream_keepalive_cache_t  *item;
+
+    n = 0;
+
+    for (q = ngx_queue_head(queue);
+         q != ngx_queue_sentinel(queue);
+         q = ngx_queue_next(q))
+    {
+        item = ngx_queue_data(q, ngx_http_upstream_keepalive_cache_t, queue);
+
+        if (sockaddr == NULL
+            || ngx_memn2cmp((u_char *) &item->sockaddr, (u_char *) sockaddr,
+                            item->socklen, socklen)
+               == 0)
+        {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+
+static ngx_http_upstream_keepalive_stats_t *
+ngx_http_upstream_keepalive_get_stats(
+    ngx_http_upstream_keepalive_srv_conf_t *kcf, struct sockaddr *sockaddr,
+    socklen_t socklen, ngx_str_t *name)
+{
+    ngx_uint_t                            i;
+    ngx_http_upstream_keepalive_stats_t  *st;
+
+    /* the statistics are kept per worker */
+
+    st = kcf->stats.elts;
+
+    for (i = 0; i < kcf->stats.nelts; i++) {
+        if (ngx_memn2cmp((u_char *) &st[i].sockaddr, (u_char *) sockaddr,
+                         st[i].socklen, socklen)
+            == 0)
+        {
+            return &st[i];
+        }
+    }
+
+    if (name == NULL || socklen > sizeof(ngx_sockaddr_t)) {
+        return NULL;
+    }
+
+    st = ngx_array_push(&kcf->stats);
+    if (st == NULL) {
+        return NULL;
+    }
+
+    ngx_memzero(st, sizeof(ngx_http_upstream_keepalive_stats_t));
+
+    st->name.data = ngx_pstrdup(ngx_cycle->pool, name);
+    if (st->name.data == NULL) {
+        kcf->stats.nelts--;
+        return NULL;
+    }
+
+    st->name.len = name->len;
+
+    st->socklen = socklen;
+    ngx_memcpy(&st->sockaddr, sockaddr, socklen);
+
+    return st;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_keepalive_status_handler(ngx_http_request_t *r)
+{
+    size_t                                   size;
+    ngx_int_t                                rc;
+    ngx_buf_t                               *b;
+    ngx_uint_t                               i, j;
+    ngx_chain_t                              out;
+    ngx_http_upstream_srv_conf_t           **uscfp;
+    ngx_http_upstream_main_conf_t           *umcf;
+    ngx_http_upstream_keepalive_stats_t     *st;
+    ngx_http_upstream_keepalive_srv_conf_t  *kcf;
+
+    if (!(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    umcf = ngx_http_get_module_main_conf(r, ngx_http_upstream_module);
+    uscfp = umcf->upstreams.elts;
+
+    size = sizeof("Worker pid \n") - 1 + NGX_INT64_LEN;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        kcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                          ngx_http_upstream_keepalive_module);
+
+        if (kcf->upstream == NULL) {
+            continue;
+        }
+
+        size += sizeof("Upstream  cached  connecting \n") - 1
+                + uscfp[i]->host.len + 2 * NGX_INT_T_LEN;
+
+        size += kcf->stats.nelts
+                * (sizeof("   cached  opened  reused  missed  closed \n") - 1
+                   + NGX_SOCKADDR_STRLEN + 5 * NGX_INT_T_LEN);
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    b->last = ngx_sprintf(b->last, "Worker pid %P\n", ngx_pid);
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        kcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                          ngx_http_upstream_keepalive_module);
+
+        if (kcf->upstream == NULL) {
+            continue;
+        }
+
+        b->last = ngx_sprintf(b->last,
+                     "Upstream %V cached %ui connecting %ui\n",
+                              &uscfp[i]->host,
+                     ngx_http_upstream_keepalive_count(&kcf->cache, NULL, 0),
+                     ngx_http_upstream_keepalive_count(&kcf->connecting,
+                                                       NULL, 0));
+
+        st = kcf->stats.elts;
+
+        for (j = 0; j < kcf->stats.nelts; j++) {
+            b->last = ngx_sprintf(b->last,
+                                  "  %*s cached %ui opened %ui reused %ui"
+                                  " missed %ui closed %ui\n",
+                                  ngx_min(st[j].name.len, NGX_SOCKADDR_STRLEN),
+                                  st[j].name.data,
+                                  ngx_http_upstream_keepalive_count(
+                                      &kcf->cache, &st[j].sockaddr.sockaddr,
+                                      st[j].socklen),
+                                  st[j].opened, st[j].reused, st[j].missed,
+                                  st[j].closed);
+        }
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
 #if (NGX_HTTP_SSL)
 
 static ngx_int_t
@@ -524,11 +1052,14 @@ ngx_http_upstream_keepalive_create_conf(ngx_conf_t *cf)
      *     conf->original_init_upstream = NULL;
      *     conf->original_init_peer = NULL;
      *     conf->max_cached = 0;
+     *     conf->prewarm = 0;
+     *     conf->upstream = NULL;
      */
 
     conf->time = NGX_CONF_UNSET_MSEC;
     conf->timeout = NGX_CONF_UNSET_MSEC;
     conf->requests = NGX_CONF_UNSET_UINT;
+    conf->prewarm_interval = NGX_CONF_UNSET_MSEC;
 
     return conf;
 }
@@ -574,3 +1105,119 @@ ngx_http_upstream_keepalive(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     return NGX_CONF_OK;
 }
+
+
+static char *
+ngx_http_upstream_keepalive_prewarm(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_http_upstream_keepalive_srv_conf_t  *kcf = conf;
+
+    ngx_int_t    n;
+    ngx_str_t   *value, s;
+    ngx_msec_t   interval;
+
+    if (kcf->prewarm) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    n = ngx_atoi(value[1].data, value[1].len);
+
+    if (n == NGX_ERROR || n == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid value \"%V\" in \"%V\" directive",
+                           &value[1], &cmd->name);
+        return NGX_CONF_ERROR;
+    }
+
+    kcf->prewarm = n;
+
+    if (cf->args->nelts == 3) {
+
+        if (ngx_strncmp(value[2].data, "interval=", 9) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        s.len = value[2].len - 9;
+        s.data = value[2].data + 9;
+
+        interval = ngx_parse_time(&s, 0);
+
+        if (interval == (ngx_msec_t) NGX_ERROR || interval == 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid interval \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        kcf->prewarm_interval = interval;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_upstream_keepalive_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_upstream_keepalive_status_handler;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_keepalive_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                               i;
+    ngx_event_t                             *ev;
+    ngx_http_upstream_srv_conf_t           **uscfp;
+    ngx_http_upstream_main_conf_t           *umcf;
+    ngx_http_upstream_keepalive_srv_conf_t  *kcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    umcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_upstream_module);
+
+    if (umcf == NULL) {
+        return NGX_OK;
+    }
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        kcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                          ngx_http_upstream_keepalive_module);
+
+        if (kcf->upstream == NULL || kcf->prewarm == 0) {
+            continue;
+        }
+
+        ev = &kcf->prewarm_event;
+
+        ev->handler = ngx_http_upstream_keepalive_prewarm_handler;
+        ev->data = kcf;
+        ev->log = cycle->log;
+        ev->cancelable = 1;
+
+        ngx_add_timer(ev, 0);
+    }
+
+    return NGX_OK;
+}
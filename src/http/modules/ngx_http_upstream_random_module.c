@@ -17,6 +17,7 @@ typedef struct {
 
 typedef struct {
     ngx_uint_t                            two;
+    ngx_uint_t                            least_time;
     ngx_http_upstream_random_range_t     *ranges;
 } ngx_http_upstream_random_srv_conf_t;
 
@@ -26,6 +27,7 @@ typedef struct {
     ngx_http_upstream_rr_peer_data_t      rrp;
 
     ngx_http_upstream_random_srv_conf_t  *conf;
+    ngx_http_upstream_t                  *upstream;
     u_char                                tries;
 } ngx_http_upstream_random_peer_data_t;
 
@@ -41,6 +43,8 @@ static ngx_int_t ngx_http_upstream_get_random_peer(ngx_peer_connection_t *pc,
     void *data);
 static ngx_int_t ngx_http_upstream_get_random2_peer(ngx_peer_connection_t *pc,
     void *data);
+static void ngx_http_upstream_free_random2_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
 static ngx_uint_t ngx_http_upstream_peek_random_peer(
     ngx_http_upstream_rr_peers_t *peers,
     ngx_http_upstream_random_peer_data_t *rp);
@@ -176,11 +180,16 @@ ngx_http_upstream_init_random_peer(ngx_http_request_t *r,
     if (rcf->two) {
         r->upstream->peer.get = ngx_http_upstream_get_random2_peer;
 
+        if (rcf->least_time) {
+            r->upstream->peer.free = ngx_http_upstream_free_random2_peer;
+        }
+
     } else {
         r->upstream->peer.get = ngx_http_upstream_get_random_peer;
     }
 
     rp->conf = rcf;
+    rp->upstream = r->upstream;
     rp->tries = 0;
 
     ngx_http_upstream_rr_peers_rlock(rp->rrp.peers);
@@ -301,7 +310,7 @@ ngx_http_upstream_get_random2_peer(ngx_peer_connection_t *pc, void *data)
 
     time_t                             now;
     uintptr_t                          m;
-    ngx_uint_t                         i, n, p;
+    ngx_uint_t                         i, n, p, more;
     ngx_http_upstream_rr_peer_t       *peer, *prev;
     ngx_http_upstream_rr_peers_t      *peers;
     ngx_http_upstream_rr_peer_data_t  *rrp;
@@ -363,7 +372,20 @@ ngx_http_upstream_get_random2_peer(ngx_peer_connection_t *pc, void *data)
         }
 
         if (prev) {
-            if (peer->conns * prev->weight > prev->conns * peer->weight) {
+            if (rp->conf->least_time) {
+                more = (uint64_t) (peer->conns + 1)
+                       * (ngx_http_upstream_rr_peer_latency(peer) + 1)
+                       * prev->weight
+                       > (uint64_t) (prev->conns + 1)
+                         * (ngx_http_upstream_rr_peer_latency(prev) + 1)
+                         * peer->weight;
+
+            } else {
+                more = peer->conns * prev->weight
+                       > prev->conns * peer->weight;
+            }
+
+            if (more) {
                 peer = prev;
                 n = p / (8 * sizeof(uintptr_t));
                 m = (uintptr_t) 1 << p % (8 * sizeof(uintptr_t));
@@ -403,6 +425,23 @@ ngx_http_upstream_get_random2_peer(ngx_peer_connection_t *pc, void *data)
 }
 
 
+static void
+ngx_http_upstream_free_random2_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
+{
+    ngx_http_upstream_random_peer_data_t  *rp = data;
+
+    if (!rp->rrp.peers->single) {
+        ngx_http_upstream_update_round_robin_latency(pc, &rp->rrp,
+                                                     rp->upstream,
+                                                     rp->conf->least_time,
+                                                     state);
+    }
+
+    ngx_http_upstream_free_round_robin_peer(pc, &rp->rrp, state);
+}
+
+
 static ngx_uint_t
 ngx_http_upstream_peek_random_peer(ngx_http_upstream_rr_peers_t *peers,
     ngx_http_upstream_random_peer_data_t *rp)
@@ -443,6 +482,7 @@ ngx_http_upstream_random_create_conf(ngx_conf_t *cf)
      * set by ngx_pcalloc():
      *
      *     conf->two = 0;
+     *     conf->least_time = 0;
      */
 
     return conf;
@@ -492,11 +532,23 @@ ngx_http_upstream_random(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_OK;
     }
 
-    if (ngx_strcmp(value[2].data, "least_conn") != 0) {
-        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                           "invalid parameter \"%V\"", &value[2]);
-        return NGX_CONF_ERROR;
+    if (ngx_strcmp(value[2].data, "least_conn") == 0) {
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strcmp(value[2].data, "least_time=header") == 0) {
+        rcf->least_time = NGX_HTTP_UPSTREAM_LATENCY_HEADER
+                          |NGX_HTTP_UPSTREAM_LATENCY_PEAK;
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strcmp(value[2].data, "least_time=last_byte") == 0) {
+        rcf->least_time = NGX_HTTP_UPSTREAM_LATENCY_LAST_BYTE
+                          |NGX_HTTP_UPSTREAM_LATENCY_PEAK;
+        return NGX_CONF_OK;
     }
 
-    return NGX_CONF_OK;
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[2]);
+    return NGX_CONF_ERROR;
 }
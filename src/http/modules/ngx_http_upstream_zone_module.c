@@ -12,18 +12,26 @@
 
 static char *ngx_http_upstream_zone(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static ngx_int_t ngx_http_upstream_zone_add_spare(ngx_conf_t *cf,
+    ngx_http_upstream_srv_conf_t *uscf, ngx_uint_t n);
 static ngx_int_t ngx_http_upstream_init_zone(ngx_shm_zone_t *shm_zone,
     void *data);
 static ngx_http_upstream_rr_peers_t *ngx_http_upstream_zone_copy_peers(
     ngx_slab_pool_t *shpool, ngx_http_upstream_srv_conf_t *uscf);
 static ngx_http_upstream_rr_peer_t *ngx_http_upstream_zone_copy_peer(
     ngx_http_upstream_rr_peers_t *peers, ngx_http_upstream_rr_peer_t *src);
+#if (NGX_HTTP_SSL)
+static ngx_int_t ngx_http_upstream_zone_copy_sessions(ngx_shm_zone_t *shm_zone,
+    ngx_shm_zone_t *oshm_zone);
+static void ngx_http_upstream_zone_copy_peer_sessions(
+    ngx_http_upstream_rr_peers_t *peers, ngx_http_upstream_rr_peers_t *opeers);
+#endif
 
 
 static ngx_command_t  ngx_http_upstream_zone_commands[] = {
 
     { ngx_string("zone"),
-      NGX_HTTP_UPS_CONF|NGX_CONF_TAKE12,
+      NGX_HTTP_UPS_CONF|NGX_CONF_1MORE,
       ngx_http_upstream_zone,
       0,
       0,
@@ -68,7 +76,9 @@ static char *
 ngx_http_upstream_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ssize_t                         size;
+    ngx_int_t                       spare;
     ngx_str_t                      *value;
+    ngx_uint_t                      i, hugepages;
     ngx_http_upstream_srv_conf_t   *uscf;
     ngx_http_upstream_main_conf_t  *umcf;
 
@@ -83,12 +93,46 @@ ngx_http_upstream_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
-    if (cf->args->nelts == 3) {
-        size = ngx_parse_size(&value[2]);
+    size = 0;
+    spare = 0;
+    hugepages = 0;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            hugepages = 1;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "read_mostly") == 0) {
+            uscf->read_mostly = 1;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "spare=", 6) == 0) {
+
+            spare = ngx_atoi(value[i].data + 6, value[i].len - 6);
+
+            if (spare == NGX_ERROR || spare == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid parameter \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (i != 2) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[i]);
+            return NGX_CONF_ERROR;
+        }
+
+        size = ngx_parse_size(&value[i]);
 
         if (size == NGX_ERROR) {
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                               "invalid zone size \"%V\"", &value[2]);
+                               "invalid zone size \"%V\"", &value[i]);
             return NGX_CONF_ERROR;
         }
 
@@ -97,9 +141,6 @@ ngx_http_upstream_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
                                "zone \"%V\" is too small", &value[1]);
             return NGX_CONF_ERROR;
         }
-
-    } else {
-        size = 0;
     }
 
     uscf->shm_zone = ngx_shared_memory_add(cf, &value[1], size,
@@ -113,10 +154,67 @@ ngx_http_upstream_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     uscf->shm_zone->noreuse = 1;
 
+#if (NGX_HTTP_SSL)
+    uscf->shm_zone->resize = ngx_http_upstream_zone_copy_sessions;
+#endif
+
+    if (hugepages) {
+        uscf->shm_zone->shm.hugepages = 1;
+    }
+
+    if (spare && ngx_http_upstream_zone_add_spare(cf, uscf, spare) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
     return NGX_CONF_OK;
 }
 
 
+static ngx_int_t
+ngx_http_upstream_zone_add_spare(ngx_conf_t *cf,
+    ngx_http_upstream_srv_conf_t *uscf, ngx_uint_t n)
+{
+    ngx_uint_t                   i;
+    ngx_addr_t                  *addrs;
+    ngx_http_upstream_server_t  *us;
+
+    /*
+     * spare slots for peers added at run time are the addresses
+     * of a pseudo server, marked with the AF_UNSPEC family
+     */
+
+    addrs = ngx_pcalloc(cf->pool, n * sizeof(ngx_addr_t));
+    if (addrs == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+
+        addrs[i].sockaddr = ngx_pcalloc(cf->pool, sizeof(ngx_sockaddr_t));
+        if (addrs[i].sockaddr == NULL) {
+            return NGX_ERROR;
+        }
+
+        addrs[i].socklen = sizeof(struct sockaddr_in);
+    }
+
+    us = ngx_array_push(uscf->servers);
+    if (us == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(us, sizeof(ngx_http_upstream_server_t));
+
+    us->addrs = addrs;
+    us->naddrs = n;
+    us->weight = 1;
+    us->max_fails = 1;
+    us->fail_timeout = 10;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_upstream_init_zone(ngx_shm_zone_t *shm_zone, void *data)
 {
@@ -215,6 +313,13 @@ ngx_http_upstream_zone_copy_peers(ngx_slab_pool_t *shpool,
 
     peers->shpool = shpool;
 
+    if (uscf->read_mostly) {
+        peers->brlock = ngx_slab_calloc(shpool, sizeof(ngx_brlock_t));
+        if (peers->brlock == NULL) {
+            return NULL;
+        }
+    }
+
     for (peerp = &peers->peer; *peerp; peerp = &peer->next) {
         /* pool is unlocked */
         peer = ngx_http_upstream_zone_copy_peer(peers, *peerp);
@@ -240,6 +345,13 @@ ngx_http_upstream_zone_copy_peers(ngx_slab_pool_t *shpool,
 
     backup->shpool = shpool;
 
+    if (uscf->read_mostly) {
+        backup->brlock = ngx_slab_calloc(shpool, sizeof(ngx_brlock_t));
+        if (backup->brlock == NULL) {
+            return NULL;
+        }
+    }
+
     for (peerp = &backup->peer; *peerp; peerp = &peer->next) {
         /* pool is unlocked */
         peer = ngx_http_upstream_zone_copy_peer(backup, *peerp);
@@ -323,3 +435,95 @@ failed:
 
     return NULL;
 }
+
+
+#if (NGX_HTTP_SSL)
+
+static ngx_int_t
+ngx_http_upstream_zone_copy_sessions(ngx_shm_zone_t *shm_zone,
+    ngx_shm_zone_t *oshm_zone)
+{
+    ngx_slab_pool_t               *shpool, *oshpool;
+    ngx_http_upstream_rr_peers_t  *peers, *opeers;
+
+    /*
+     * the zone is not reused on reload, so the upstream SSL sessions
+     * saved by the old worker processes are copied to the new zone
+     */
+
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+    oshpool = (ngx_slab_pool_t *) oshm_zone->shm.addr;
+
+    for (peers = shpool->data; peers; peers = peers->zone_next) {
+
+        for (opeers = oshpool->data; opeers; opeers = opeers->zone_next) {
+            if (ngx_memn2cmp(peers->name->data, opeers->name->data,
+                             peers->name->len, opeers->name->len)
+                == 0)
+            {
+                break;
+            }
+        }
+
+        if (opeers == NULL) {
+            continue;
+        }
+
+        ngx_http_upstream_zone_copy_peer_sessions(peers, opeers);
+
+        if (peers->next && opeers->next) {
+            ngx_http_upstream_zone_copy_peer_sessions(peers->next,
+                                                        opeers->next);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_zone_copy_peer_sessions(ngx_http_upstream_rr_peers_t *peers,
+    ngx_http_upstream_rr_peers_t *opeers)
+{
+    ngx_http_upstream_rr_peer_t  *peer, *opeer;
+
+    ngx_http_upstream_rr_peers_rlock(opeers);
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+
+        for (opeer = opeers->peer; opeer; opeer = opeer->next) {
+            if (ngx_memn2cmp(peer->name.data, opeer->name.data,
+                             peer->name.len, opeer->name.len)
+                == 0
+                && ngx_memn2cmp(peer->server.data, opeer->server.data,
+                                peer->server.len, opeer->server.len)
+                   == 0)
+            {
+                break;
+            }
+        }
+
+        if (opeer == NULL) {
+            continue;
+        }
+
+        ngx_http_upstream_rr_peer_lock(opeers, opeer);
+
+        if (opeer->ssl_session) {
+            peer->ssl_session = ngx_slab_alloc(peers->shpool,
+                                               opeer->ssl_session_len);
+
+            if (peer->ssl_session) {
+                ngx_memcpy(peer->ssl_session, opeer->ssl_session,
+                           opeer->ssl_session_len);
+                peer->ssl_session_len = opeer->ssl_session_len;
+            }
+        }
+
+        ngx_http_upstream_rr_peer_unlock(opeers, opeer);
+    }
+
+    ngx_http_upstream_rr_peers_unlock(opeers);
+}
+
+#endif
@@ -750,6 +750,10 @@ ngx_http_userid_merge_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_uint_value(conf->enable, prev->enable,
                               NGX_HTTP_USERID_OFF);
 
+    if (conf->enable != NGX_HTTP_USERID_OFF) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
+
     ngx_conf_merge_bitmask_value(conf->flags, prev->flags,
                             (NGX_CONF_BITMASK_SET|NGX_HTTP_USERID_COOKIE_OFF));
 
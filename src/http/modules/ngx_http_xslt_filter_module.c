@@ -27,6 +27,9 @@
 #endif
 
 
+#define NGX_HTTP_XSLT_BUFFERED   0x08
+
+
 typedef struct {
     u_char                    *name;
     void                      *data;
@@ -42,6 +45,7 @@ typedef struct {
 typedef struct {
     u_char                    *name;
     ngx_http_complex_value_t   value;
+    ngx_array_t               *args;         /* char * */
     ngx_uint_t                 quote;        /* unsigned  quote:1; */
 } ngx_http_xslt_param_t;
 
@@ -59,17 +63,37 @@ typedef struct {
     ngx_array_t               *types_keys;
     ngx_array_t               *params;       /* ngx_http_xslt_param_t */
     ngx_flag_t                 last_modified;
+
+#if (NGX_THREADS)
+    ngx_thread_pool_t         *thread_pool;
+#endif
 } ngx_http_xslt_filter_loc_conf_t;
 
 
+typedef struct {
+    ngx_array_t                params;       /* char * */
+    ngx_array_t                quoted;       /* char * */
+} ngx_http_xslt_params_t;
+
+
 typedef struct {
     xmlDocPtr                  doc;
     xmlParserCtxtPtr           ctxt;
     xsltTransformContextPtr    transform;
     ngx_http_request_t        *request;
-    ngx_array_t                params;
+    ngx_array_t                params;       /* ngx_http_xslt_params_t */
+
+    xmlChar                   *out;
+    int                        len;
+    int                        doc_type;
 
     ngx_uint_t                 done;         /* unsigned  done:1; */
+
+#if (NGX_THREADS)
+    ngx_int_t                  rc;
+    unsigned                   thread:1;
+    unsigned                   busy:1;
+#endif
 } ngx_http_xslt_filter_ctx_t;
 
 
@@ -86,8 +110,20 @@ static void ngx_cdecl ngx_http_xslt_sax_error(void *data, const char *msg, ...);
 
 static ngx_buf_t *ngx_http_xslt_apply_stylesheet(ngx_http_request_t *r,
     ngx_http_xslt_filter_ctx_t *ctx);
+static ngx_int_t ngx_http_xslt_transform(ngx_http_request_t *r,
+    ngx_http_xslt_filter_ctx_t *ctx);
+static ngx_buf_t *ngx_http_xslt_result(ngx_http_request_t *r,
+    ngx_http_xslt_filter_ctx_t *ctx, ngx_int_t rc);
+#if (NGX_THREADS)
+static ngx_int_t ngx_http_xslt_thread_post(ngx_http_request_t *r,
+    ngx_http_xslt_filter_ctx_t *ctx, ngx_thread_pool_t *tp);
+static void ngx_http_xslt_thread_handler(void *data, ngx_log_t *log);
+static void ngx_http_xslt_thread_event_handler(ngx_event_t *ev);
+#endif
 static ngx_int_t ngx_http_xslt_params(ngx_http_request_t *r,
-    ngx_http_xslt_filter_ctx_t *ctx, ngx_array_t *params, ngx_uint_t final);
+    ngx_http_xslt_params_t *sp, ngx_array_t *params, ngx_uint_t final);
+static ngx_int_t ngx_http_xslt_split_params(ngx_log_t *log, u_char *p,
+    ngx_array_t *params);
 static u_char *ngx_http_xslt_content_type(xsltStylesheetPtr s);
 static u_char *ngx_http_xslt_encoding(xsltStylesheetPtr s);
 static void ngx_http_xslt_cleanup(void *data);
@@ -98,6 +134,10 @@ static char *ngx_http_xslt_stylesheet(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_xslt_param(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+#if (NGX_THREADS)
+static char *ngx_http_xslt_threads(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+#endif
 static void ngx_http_xslt_cleanup_dtd(void *data);
 static void ngx_http_xslt_cleanup_stylesheet(void *data);
 static void *ngx_http_xslt_filter_create_main_conf(ngx_conf_t *cf);
@@ -159,6 +199,17 @@ static ngx_command_t  ngx_http_xslt_filter_commands[] = {
       offsetof(ngx_http_xslt_filter_loc_conf_t, last_modified),
       NULL },
 
+#if (NGX_THREADS)
+
+    { ngx_string("xslt_threads"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_xslt_threads,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+#endif
+
       ngx_null_command
 };
 
@@ -243,19 +294,36 @@ static ngx_int_t
 ngx_http_xslt_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
     int                          wellFormed;
+    ngx_buf_t                   *b;
     ngx_chain_t                 *cl;
     ngx_http_xslt_filter_ctx_t  *ctx;
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                    "xslt filter body");
 
-    if (in == NULL) {
+    ctx = ngx_http_get_module_ctx(r, ngx_http_xslt_filter_module);
+
+    if (ctx == NULL || ctx->done) {
         return ngx_http_next_body_filter(r, in);
     }
 
-    ctx = ngx_http_get_module_ctx(r, ngx_http_xslt_filter_module);
+#if (NGX_THREADS)
 
-    if (ctx == NULL || ctx->done) {
+    if (ctx->thread) {
+
+        if (ctx->busy) {
+            return NGX_AGAIN;
+        }
+
+        ctx->thread = 0;
+        r->buffered &= ~NGX_HTTP_XSLT_BUFFERED;
+
+        return ngx_http_xslt_send(r, ctx, ngx_http_xslt_result(r, ctx, ctx->rc));
+    }
+
+#endif
+
+    if (in == NULL) {
         return ngx_http_next_body_filter(r, in);
     }
 
@@ -289,8 +357,15 @@ ngx_http_xslt_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
             xmlFreeParserCtxt(ctx->ctxt);
 
             if (wellFormed) {
-                return ngx_http_xslt_send(r, ctx,
-                                       ngx_http_xslt_apply_stylesheet(r, ctx));
+                b = ngx_http_xslt_apply_stylesheet(r, ctx);
+
+#if (NGX_THREADS)
+                if (ctx->thread) {
+                    return NGX_OK;
+                }
+#endif
+
+                return ngx_http_xslt_send(r, ctx, b);
             }
 
             xmlFreeDoc(ctx->doc);
@@ -489,52 +564,119 @@ static ngx_buf_t *
 ngx_http_xslt_apply_stylesheet(ngx_http_request_t *r,
     ngx_http_xslt_filter_ctx_t *ctx)
 {
-    int                               len, rc, doc_type;
-    u_char                           *type, *encoding;
-    ngx_buf_t                        *b;
     ngx_uint_t                        i;
-    xmlChar                          *buf;
-    xmlDocPtr                         doc, res;
     ngx_http_xslt_sheet_t            *sheet;
+    ngx_http_xslt_params_t           *sp;
     ngx_http_xslt_filter_loc_conf_t  *conf;
 
     conf = ngx_http_get_module_loc_conf(r, ngx_http_xslt_filter_module);
     sheet = conf->sheets.elts;
-    doc = ctx->doc;
 
-    /* preallocate array for 4 params */
+    /*
+     * the parameters are evaluated in advance, as the document may be
+     * transformed in a thread, which cannot use the request pool
+     */
 
-    if (ngx_array_init(&ctx->params, r->pool, 4 * 2 + 1, sizeof(char *))
+    if (ngx_array_init(&ctx->params, r->pool, conf->sheets.nelts,
+                       sizeof(ngx_http_xslt_params_t))
         != NGX_OK)
     {
-        xmlFreeDoc(doc);
+        xmlFreeDoc(ctx->doc);
         return NULL;
     }
 
     for (i = 0; i < conf->sheets.nelts; i++) {
 
-        ctx->transform = xsltNewTransformContext(sheet[i].stylesheet, doc);
-        if (ctx->transform == NULL) {
-            xmlFreeDoc(doc);
+        sp = ngx_array_push(&ctx->params);
+        if (sp == NULL) {
+            xmlFreeDoc(ctx->doc);
+            return NULL;
+        }
+
+        ngx_memzero(sp, sizeof(ngx_http_xslt_params_t));
+
+        /* preallocate array for 4 params */
+
+        if (ngx_array_init(&sp->params, r->pool, 4 * 2 + 1, sizeof(char *))
+            != NGX_OK)
+        {
+            xmlFreeDoc(ctx->doc);
             return NULL;
         }
 
         if (conf->params
-            && ngx_http_xslt_params(r, ctx, conf->params, 0) != NGX_OK)
+            && ngx_http_xslt_params(r, sp, conf->params, 0) != NGX_OK)
         {
-            xsltFreeTransformContext(ctx->transform);
-            xmlFreeDoc(doc);
+            xmlFreeDoc(ctx->doc);
             return NULL;
         }
 
-        if (ngx_http_xslt_params(r, ctx, &sheet[i].params, 1) != NGX_OK) {
-            xsltFreeTransformContext(ctx->transform);
-            xmlFreeDoc(doc);
+        if (ngx_http_xslt_params(r, sp, &sheet[i].params, 1) != NGX_OK) {
+            xmlFreeDoc(ctx->doc);
             return NULL;
         }
+    }
+
+#if (NGX_THREADS)
+
+    if (conf->thread_pool) {
+        if (ngx_http_xslt_thread_post(r, ctx, conf->thread_pool) != NGX_OK) {
+            xmlFreeDoc(ctx->doc);
+            return NULL;
+        }
+
+        ctx->thread = 1;
+
+        return NULL;
+    }
+
+#endif
+
+    return ngx_http_xslt_result(r, ctx, ngx_http_xslt_transform(r, ctx));
+}
+
+
+static ngx_int_t
+ngx_http_xslt_transform(ngx_http_request_t *r, ngx_http_xslt_filter_ctx_t *ctx)
+{
+    int                               rc;
+    u_char                          **s;
+    ngx_uint_t                        i, n;
+    xmlDocPtr                         doc, res;
+    ngx_http_xslt_sheet_t            *sheet;
+    ngx_http_xslt_params_t           *sp;
+    ngx_http_xslt_filter_loc_conf_t  *conf;
+
+    conf = ngx_http_get_module_loc_conf(r, ngx_http_xslt_filter_module);
+    sheet = conf->sheets.elts;
+    sp = ctx->params.elts;
+    doc = ctx->doc;
+
+    for (i = 0; i < conf->sheets.nelts; i++) {
+
+        ctx->transform = xsltNewTransformContext(sheet[i].stylesheet, doc);
+        if (ctx->transform == NULL) {
+            xmlFreeDoc(doc);
+            return NGX_ERROR;
+        }
+
+        s = sp[i].quoted.elts;
+
+        for (n = 0; n < sp[i].quoted.nelts; n += 2) {
+
+            if (xsltQuoteOneUserParam(ctx->transform, s[n], s[n + 1]) != 0) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                              "xsltQuoteOneUserParam(\"%s\", \"%s\") failed",
+                              s[n], s[n + 1]);
+
+                xsltFreeTransformContext(ctx->transform);
+                xmlFreeDoc(doc);
+                return NGX_ERROR;
+            }
+        }
 
         res = xsltApplyStylesheetUser(sheet[i].stylesheet, doc,
-                                      ctx->params.elts, NULL, NULL,
+                                      sp[i].params.elts, NULL, NULL,
                                       ctx->transform);
 
         xsltFreeTransformContext(ctx->transform);
@@ -543,56 +685,78 @@ ngx_http_xslt_apply_stylesheet(ngx_http_request_t *r,
         if (res == NULL) {
             ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
                           "xsltApplyStylesheet() failed");
-            return NULL;
+            return NGX_ERROR;
         }
 
         doc = res;
-
-        /* reset array elements */
-        ctx->params.nelts = 0;
     }
 
     /* there must be at least one stylesheet */
 
-    if (r == r->main) {
-        type = ngx_http_xslt_content_type(sheet[i - 1].stylesheet);
+    ctx->doc_type = doc->type;
 
-    } else {
-        type = NULL;
-    }
-
-    encoding = ngx_http_xslt_encoding(sheet[i - 1].stylesheet);
-    doc_type = doc->type;
-
-    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "xslt filter type: %d t:%s e:%s",
-                   doc_type, type ? type : (u_char *) "(null)",
-                   encoding ? encoding : (u_char *) "(null)");
-
-    rc = xsltSaveResultToString(&buf, &len, doc, sheet[i - 1].stylesheet);
+    rc = xsltSaveResultToString(&ctx->out, &ctx->len, doc,
+                                sheet[i - 1].stylesheet);
 
     xmlFreeDoc(doc);
 
     if (rc != 0) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
                       "xsltSaveResultToString() failed");
-        return NULL;
+        return NGX_ERROR;
     }
 
-    if (len == 0) {
+    if (ctx->len == 0) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
                       "xsltSaveResultToString() returned zero-length result");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_buf_t *
+ngx_http_xslt_result(ngx_http_request_t *r, ngx_http_xslt_filter_ctx_t *ctx,
+    ngx_int_t rc)
+{
+    size_t                            len;
+    u_char                           *type, *encoding;
+    ngx_buf_t                        *b;
+    xsltStylesheetPtr                 stylesheet;
+    ngx_http_xslt_sheet_t            *sheet;
+    ngx_http_xslt_filter_loc_conf_t  *conf;
+
+    if (rc != NGX_OK) {
         return NULL;
     }
 
+    conf = ngx_http_get_module_loc_conf(r, ngx_http_xslt_filter_module);
+    sheet = conf->sheets.elts;
+    stylesheet = sheet[conf->sheets.nelts - 1].stylesheet;
+
+    if (r == r->main) {
+        type = ngx_http_xslt_content_type(stylesheet);
+
+    } else {
+        type = NULL;
+    }
+
+    encoding = ngx_http_xslt_encoding(stylesheet);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "xslt filter type: %d t:%s e:%s",
+                   ctx->doc_type, type ? type : (u_char *) "(null)",
+                   encoding ? encoding : (u_char *) "(null)");
+
     b = ngx_calloc_buf(r->pool);
     if (b == NULL) {
-        ngx_free(buf);
+        ngx_free(ctx->out);
         return NULL;
     }
 
-    b->pos = buf;
-    b->last = buf + len;
+    b->pos = ctx->out;
+    b->last = ctx->out + ctx->len;
     b->memory = 1;
 
     if (encoding) {
@@ -613,7 +777,7 @@ ngx_http_xslt_apply_stylesheet(ngx_http_request_t *r,
         r->headers_out.content_type.len = len;
         r->headers_out.content_type.data = type;
 
-    } else if (doc_type == XML_HTML_DOCUMENT_NODE) {
+    } else if (ctx->doc_type == XML_HTML_DOCUMENT_NODE) {
 
         r->headers_out.content_type_len = sizeof("text/html") - 1;
         ngx_str_set(&r->headers_out.content_type, "text/html");
@@ -625,20 +789,115 @@ ngx_http_xslt_apply_stylesheet(ngx_http_request_t *r,
 }
 
 
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_http_xslt_thread_post(ngx_http_request_t *r,
+    ngx_http_xslt_filter_ctx_t *ctx, ngx_thread_pool_t *tp)
+{
+    ngx_thread_task_t  *task;
+
+    task = ngx_thread_task_alloc(r->pool, 0);
+    if (task == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->request = r;
+
+    task->ctx = ctx;
+    task->handler = ngx_http_xslt_thread_handler;
+    task->event.data = ctx;
+    task->event.handler = ngx_http_xslt_thread_event_handler;
+
+    if (ngx_thread_task_post(tp, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ctx->busy = 1;
+
+    r->main->blocked++;
+    r->aio = 1;
+
+    r->buffered |= NGX_HTTP_XSLT_BUFFERED;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_xslt_thread_handler(void *data, ngx_log_t *log)
+{
+    ngx_http_xslt_filter_ctx_t *ctx = data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, log, 0, "xslt thread handler");
+
+    ctx->rc = ngx_http_xslt_transform(ctx->request, ctx);
+}
+
+
+static void
+ngx_http_xslt_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_connection_t            *c;
+    ngx_http_request_t          *r;
+    ngx_http_xslt_filter_ctx_t  *ctx;
+
+    ctx = ev->data;
+    r = ctx->request;
+    c = r->connection;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "xslt thread: \"%V?%V\"", &r->uri, &r->args);
+
+    ctx->busy = 0;
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    if (r->done || r->main->terminated) {
+        if (ctx->rc == NGX_OK) {
+            ngx_free(ctx->out);
+            ctx->out = NULL;
+        }
+
+        c->write->handler(c->write);
+        return;
+    }
+
+    r->write_event_handler(r);
+    ngx_http_run_posted_requests(c);
+}
+
+#endif
+
+
 static ngx_int_t
-ngx_http_xslt_params(ngx_http_request_t *r, ngx_http_xslt_filter_ctx_t *ctx,
+ngx_http_xslt_params(ngx_http_request_t *r, ngx_http_xslt_params_t *sp,
     ngx_array_t *params, ngx_uint_t final)
 {
-    u_char                 *p, *value, *dst, *src, **s;
-    size_t                  len;
-    ngx_uint_t              i;
-    ngx_str_t               string;
-    ngx_http_xslt_param_t  *param;
+    u_char                 **s;
+    ngx_uint_t               i;
+    ngx_str_t                string;
+    ngx_http_xslt_param_t   *param;
 
     param = params->elts;
 
     for (i = 0; i < params->nelts; i++) {
 
+        if (param[i].args) {
+            s = ngx_array_push_n(&sp->params, param[i].args->nelts);
+            if (s == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_memcpy(s, param[i].args->elts,
+                       param[i].args->nelts * sizeof(u_char *));
+
+            continue;
+        }
+
         if (ngx_http_complex_value(r, &param[i].value, &string) != NGX_OK) {
             return NGX_ERROR;
         }
@@ -652,27 +911,35 @@ ngx_http_xslt_params(ngx_http_request_t *r, ngx_http_xslt_filter_ctx_t *ctx,
                            "xslt filter param name: \"%s\"", param[i].name);
 
             if (param[i].quote) {
-                if (xsltQuoteOneUserParam(ctx->transform, param[i].name,
-                                          string.data)
-                    != 0)
-                {
-                    ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
-                                "xsltQuoteOneUserParam(\"%s\", \"%s\") failed",
-                                param[i].name, string.data);
+
+                if (sp->quoted.elts == NULL) {
+                    if (ngx_array_init(&sp->quoted, r->pool, 2,
+                                       sizeof(u_char *))
+                        != NGX_OK)
+                    {
+                        return NGX_ERROR;
+                    }
+                }
+
+                s = ngx_array_push_n(&sp->quoted, 2);
+                if (s == NULL) {
                     return NGX_ERROR;
                 }
 
+                s[0] = param[i].name;
+                s[1] = string.data;
+
                 continue;
             }
 
-            s = ngx_array_push(&ctx->params);
+            s = ngx_array_push(&sp->params);
             if (s == NULL) {
                 return NGX_ERROR;
             }
 
             *s = param[i].name;
 
-            s = ngx_array_push(&ctx->params);
+            s = ngx_array_push(&sp->params);
             if (s == NULL) {
                 return NGX_ERROR;
             }
@@ -683,83 +950,93 @@ ngx_http_xslt_params(ngx_http_request_t *r, ngx_http_xslt_filter_ctx_t *ctx,
         }
 
         /*
-         * parse param1=value1:param2=value2 syntax as used by parameters
-         * specified in xslt_stylesheet directives
+         * the value contains variables, as constant parameters specified
+         * in xslt_stylesheet directives are parsed at configuration time
          */
 
-        if (param[i].value.lengths) {
-            p = string.data;
-
-        } else {
-            p = ngx_pnalloc(r->pool, string.len + 1);
-            if (p == NULL) {
-                return NGX_ERROR;
-            }
+        if (ngx_http_xslt_split_params(r->connection->log, string.data,
+                                       &sp->params)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
 
-            ngx_memcpy(p, string.data, string.len + 1);
+    if (final) {
+        s = ngx_array_push(&sp->params);
+        if (s == NULL) {
+            return NGX_ERROR;
         }
 
-        while (p && *p) {
+        *s = NULL;
+    }
 
-            value = p;
-            p = (u_char *) ngx_strchr(p, '=');
-            if (p == NULL) {
-                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
-                                "invalid libxslt parameter \"%s\"", value);
-                return NGX_ERROR;
-            }
-            *p++ = '\0';
+    return NGX_OK;
+}
 
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                           "xslt filter param name: \"%s\"", value);
 
-            s = ngx_array_push(&ctx->params);
-            if (s == NULL) {
-                return NGX_ERROR;
-            }
+/*
+ * parse param1=value1:param2=value2 syntax as used by parameters
+ * specified in xslt_stylesheet directives
+ */
 
-            *s = value;
+static ngx_int_t
+ngx_http_xslt_split_params(ngx_log_t *log, u_char *p, ngx_array_t *params)
+{
+    u_char   *value, *dst, *src, **s;
+    size_t    len;
 
-            value = p;
-            p = (u_char *) ngx_strchr(p, ':');
+    while (p && *p) {
 
-            if (p) {
-                len = p - value;
-                *p++ = '\0';
+        value = p;
+        p = (u_char *) ngx_strchr(p, '=');
+        if (p == NULL) {
+            ngx_log_error(NGX_LOG_ERR, log, 0,
+                          "invalid libxslt parameter \"%s\"", value);
+            return NGX_ERROR;
+        }
+        *p++ = '\0';
 
-            } else {
-                len = ngx_strlen(value);
-            }
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
+                       "xslt filter param name: \"%s\"", value);
 
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                           "xslt filter param value: \"%s\"", value);
+        s = ngx_array_push(params);
+        if (s == NULL) {
+            return NGX_ERROR;
+        }
 
-            dst = value;
-            src = value;
+        *s = value;
 
-            ngx_unescape_uri(&dst, &src, len, 0);
+        value = p;
+        p = (u_char *) ngx_strchr(p, ':');
 
-            *dst = '\0';
+        if (p) {
+            len = p - value;
+            *p++ = '\0';
 
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                           "xslt filter param unescaped: \"%s\"", value);
+        } else {
+            len = ngx_strlen(value);
+        }
 
-            s = ngx_array_push(&ctx->params);
-            if (s == NULL) {
-                return NGX_ERROR;
-            }
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
+                       "xslt filter param value: \"%s\"", value);
 
-            *s = value;
-        }
-    }
+        dst = value;
+        src = value;
 
-    if (final) {
-        s = ngx_array_push(&ctx->params);
+        ngx_unescape_uri(&dst, &src, len, 0);
+
+        *dst = '\0';
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
+                       "xslt filter param unescaped: \"%s\"", value);
+
+        s = ngx_array_push(params);
         if (s == NULL) {
             return NGX_ERROR;
         }
 
-        *s = NULL;
+        *s = value;
     }
 
     return NGX_OK;
@@ -877,6 +1154,7 @@ ngx_http_xslt_stylesheet(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_http_xslt_filter_loc_conf_t *xlcf = conf;
 
+    u_char                            *p;
     ngx_str_t                         *value;
     ngx_uint_t                         i, n;
     ngx_pool_cleanup_t                *cln;
@@ -975,6 +1253,28 @@ found:
         if (ngx_http_compile_complex_value(&ccv) != NGX_OK) {
             return NGX_CONF_ERROR;
         }
+
+        if (param->value.lengths) {
+            continue;
+        }
+
+        /* parameters without variables are parsed once */
+
+        param->args = ngx_array_create(cf->pool, 2, sizeof(u_char *));
+        if (param->args == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        p = ngx_pnalloc(cf->pool, value[i].len + 1);
+        if (p == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        ngx_cpystrn(p, value[i].data, value[i].len + 1);
+
+        if (ngx_http_xslt_split_params(cf->log, p, param->args) != NGX_OK) {
+            return NGX_CONF_ERROR;
+        }
     }
 
     return NGX_CONF_OK;
@@ -1006,6 +1306,7 @@ ngx_http_xslt_param(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     param->name = value[1].data;
+    param->args = NULL;
     param->quote = (cmd->post == NULL) ? 0 : 1;
 
     ngx_memzero(&ccv, sizeof(ngx_http_compile_complex_value_t));
@@ -1023,6 +1324,43 @@ ngx_http_xslt_param(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+#if (NGX_THREADS)
+
+static char *
+ngx_http_xslt_threads(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_xslt_filter_loc_conf_t *xlcf = conf;
+
+    ngx_str_t  *value;
+
+    if (xlcf->thread_pool != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        xlcf->thread_pool = NULL;
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strcmp(value[1].data, "on") == 0) {
+        xlcf->thread_pool = ngx_thread_pool_add(cf, NULL);
+
+    } else {
+        xlcf->thread_pool = ngx_thread_pool_add(cf, &value[1]);
+    }
+
+    if (xlcf->thread_pool == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+#endif
+
+
 static void
 ngx_http_xslt_cleanup_dtd(void *data)
 {
@@ -1087,6 +1425,10 @@ ngx_http_xslt_filter_create_conf(ngx_conf_t *cf)
 
     conf->last_modified = NGX_CONF_UNSET;
 
+#if (NGX_THREADS)
+    conf->thread_pool = NGX_CONF_UNSET_PTR;
+#endif
+
     return conf;
 }
 
@@ -1109,6 +1451,10 @@ ngx_http_xslt_filter_merge_conf(ngx_conf_t *cf, void *parent, void *child)
         conf->params = prev->params;
     }
 
+    if (conf->sheets.nelts) {
+        ngx_http_conf_disable_filter_passthrough(cf);
+    }
+
     if (ngx_http_merge_types(cf, &conf->types_keys, &conf->types,
                              &prev->types_keys, &prev->types,
                              ngx_http_xslt_default_types)
@@ -1119,6 +1465,10 @@ ngx_http_xslt_filter_merge_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_value(conf->last_modified, prev->last_modified, 0);
 
+#if (NGX_THREADS)
+    ngx_conf_merge_ptr_value(conf->thread_pool, prev->thread_pool, NULL);
+#endif
+
     return NGX_CONF_OK;
 }
 
@@ -35,6 +35,10 @@ static char *ngx_http_merge_locations(ngx_conf_t *cf,
     ngx_uint_t ctx_index);
 static ngx_int_t ngx_http_init_locations(ngx_conf_t *cf,
     ngx_http_core_srv_conf_t *cscf, ngx_http_core_loc_conf_t *pclcf);
+#if (NGX_PCRE)
+static ngx_int_t ngx_http_init_regex_location_sets(ngx_conf_t *cf,
+    ngx_http_core_loc_conf_t **clcfp);
+#endif
 static ngx_int_t ngx_http_init_static_location_trees(ngx_conf_t *cf,
     ngx_http_core_loc_conf_t *pclcf);
 static ngx_int_t ngx_http_escape_location_name(ngx_conf_t *cf,
@@ -74,6 +78,7 @@ ngx_uint_t   ngx_http_max_module;
 ngx_http_output_header_filter_pt  ngx_http_top_header_filter;
 ngx_http_output_body_filter_pt    ngx_http_top_body_filter;
 ngx_http_request_body_filter_pt   ngx_http_top_request_body_filter;
+ngx_http_output_early_hints_filter_pt  ngx_http_top_early_hints_filter;
 
 
 ngx_str_t  ngx_http_html_default_types[] = {
@@ -500,6 +505,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
             find_config_index = n;
 
             ph->checker = ngx_http_core_find_config_phase;
+            ph->phase = i;
             n++;
             ph++;
 
@@ -517,6 +523,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
             if (use_rewrite) {
                 ph->checker = ngx_http_core_post_rewrite_phase;
                 ph->next = find_config_index;
+                ph->phase = i;
                 n++;
                 ph++;
             }
@@ -532,6 +539,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
             if (use_access) {
                 ph->checker = ngx_http_core_post_access_phase;
                 ph->next = n;
+                ph->phase = i;
                 ph++;
             }
 
@@ -551,6 +559,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
             ph->checker = checker;
             ph->handler = h[j];
             ph->next = n;
+            ph->phase = i;
             ph++;
         }
     }
@@ -787,6 +796,12 @@ ngx_http_init_locations(ngx_conf_t *cf, ngx_http_core_srv_conf_t *cscf,
         *clcfp = NULL;
 
         ngx_queue_split(locations, regex, &tail);
+
+        if (ngx_http_init_regex_location_sets(cf, pclcf->regex_locations)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
     }
 
 #endif
@@ -795,6 +810,87 @@ ngx_http_init_locations(ngx_conf_t *cf, ngx_http_core_srv_conf_t *cscf,
 }
 
 
+#if (NGX_PCRE)
+
+static ngx_int_t
+ngx_http_init_regex_location_sets(ngx_conf_t *cf,
+    ngx_http_core_loc_conf_t **clcfp)
+{
+    ngx_int_t                       rc;
+    ngx_uint_t                      i, n;
+    ngx_regex_compile_t             set, *elts;
+    ngx_http_core_loc_conf_t      **first;
+    ngx_http_location_regex_set_t  *rs;
+    u_char                          errstr[NGX_MAX_CONF_ERRSTR];
+
+    /* consecutive locations with supported patterns are tested at once */
+
+    for ( ;; ) {
+
+        while (*clcfp && !ngx_regex_set_supported(&(*clcfp)->name)) {
+            clcfp++;
+        }
+
+        if (*clcfp == NULL) {
+            return NGX_OK;
+        }
+
+        first = clcfp;
+
+        while (*clcfp && ngx_regex_set_supported(&(*clcfp)->name)) {
+            clcfp++;
+        }
+
+        n = clcfp - first;
+
+        if (n < 2) {
+            continue;
+        }
+
+        elts = ngx_pcalloc(cf->temp_pool, n * sizeof(ngx_regex_compile_t));
+        if (elts == NULL) {
+            return NGX_ERROR;
+        }
+
+        for (i = 0; i < n; i++) {
+            elts[i].pattern = first[i]->name;
+            elts[i].options = first[i]->regex_caseless ? NGX_REGEX_CASELESS
+                                                       : 0;
+        }
+
+        ngx_memzero(&set, sizeof(ngx_regex_compile_t));
+
+        set.pool = cf->pool;
+        set.err.len = NGX_MAX_CONF_ERRSTR;
+        set.err.data = errstr;
+
+        rc = ngx_regex_compile_set(&set, elts, n);
+
+        if (rc == NGX_DECLINED) {
+            continue;
+        }
+
+        if (rc != NGX_OK) {
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, cf->log, 0,
+                           "regex locations set not used: %V", &set.err);
+            continue;
+        }
+
+        rs = ngx_palloc(cf->pool, sizeof(ngx_http_location_regex_set_t));
+        if (rs == NULL) {
+            return NGX_ERROR;
+        }
+
+        rs->regex = set.regex;
+        rs->nelts = n;
+
+        (*first)->regex_set = rs;
+    }
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_init_static_location_trees(ngx_conf_t *cf,
     ngx_http_core_loc_conf_t *pclcf)
@@ -1450,7 +1546,6 @@ static ngx_int_t
 ngx_http_add_server(ngx_conf_t *cf, ngx_http_core_srv_conf_t *cscf,
     ngx_http_conf_addr_t *addr)
 {
-    ngx_uint_t                  i;
     ngx_http_core_srv_conf_t  **server;
 
     if (addr->servers.elts == NULL) {
@@ -1462,14 +1557,20 @@ ngx_http_add_server(ngx_conf_t *cf, ngx_http_core_srv_conf_t *cscf,
         }
 
     } else {
+
+        /*
+         * all listen sockets of a server are added while its block
+         * is parsed, so a duplicate can only be the last server added;
+         * checking the whole list is quadratic with many virtual servers
+         */
+
         server = addr->servers.elts;
-        for (i = 0; i < addr->servers.nelts; i++) {
-            if (server[i] == cscf) {
-                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                                   "a duplicate listen %V",
-                                   &addr->opt.addr_text);
-                return NGX_ERROR;
-            }
+
+        if (server[addr->servers.nelts - 1] == cscf) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "a duplicate listen %V",
+                               &addr->opt.addr_text);
+            return NGX_ERROR;
         }
     }
 
@@ -1878,6 +1979,7 @@ ngx_http_add_listening(ngx_conf_t *cf, ngx_http_conf_addr_t *addr)
 
 #if (NGX_HAVE_REUSEPORT)
     ls->reuseport = addr->opt.reuseport;
+    ls->cpu_steer = addr->opt.cpu_steer;
 #endif
 
     ls->wildcard = addr->opt.wildcard;
@@ -19,6 +19,7 @@ typedef struct ngx_http_cache_s       ngx_http_cache_t;
 typedef struct ngx_http_file_cache_s  ngx_http_file_cache_t;
 typedef struct ngx_http_log_ctx_s     ngx_http_log_ctx_t;
 typedef struct ngx_http_chunked_s     ngx_http_chunked_t;
+typedef struct ngx_http_trace_s       ngx_http_trace_t;
 typedef struct ngx_http_v2_stream_s   ngx_http_v2_stream_t;
 typedef struct ngx_http_v3_parse_s    ngx_http_v3_parse_t;
 typedef struct ngx_http_v3_session_s  ngx_http_v3_session_t;
@@ -35,6 +36,7 @@ typedef u_char *(*ngx_http_log_handler_pt)(ngx_http_request_t *r,
 #include <ngx_http_script.h>
 #include <ngx_http_upstream.h>
 #include <ngx_http_upstream_round_robin.h>
+#include <ngx_http_trace.h>
 #include <ngx_http_core_module.h>
 
 #if (NGX_HTTP_V2)
@@ -49,6 +51,9 @@ typedef u_char *(*ngx_http_log_handler_pt)(ngx_http_request_t *r,
 #if (NGX_HTTP_SSI)
 #include <ngx_http_ssi_filter_module.h>
 #endif
+#if (NGX_HTTP_GRPC)
+#include <ngx_http_grpc_module.h>
+#endif
 #if (NGX_HTTP_SSL)
 #include <ngx_http_ssl_module.h>
 #endif
@@ -121,6 +126,8 @@ ngx_int_t ngx_http_parse_chunked(ngx_http_request_t *r, ngx_buf_t *b,
 
 
 ngx_http_request_t *ngx_http_create_request(ngx_connection_t *c);
+ngx_http_request_t *ngx_http_create_request_in_pool(ngx_connection_t *c,
+    ngx_pool_t *pool);
 ngx_int_t ngx_http_process_request_uri(ngx_http_request_t *r);
 ngx_int_t ngx_http_process_request_header(ngx_http_request_t *r);
 void ngx_http_process_request(ngx_http_request_t *r);
@@ -152,6 +159,8 @@ ngx_int_t ngx_http_read_client_request_body(ngx_http_request_t *r,
 ngx_int_t ngx_http_read_unbuffered_request_body(ngx_http_request_t *r);
 
 ngx_int_t ngx_http_send_header(ngx_http_request_t *r);
+ngx_int_t ngx_http_send_early_hints(ngx_http_request_t *r,
+    ngx_list_t *headers);
 ngx_int_t ngx_http_special_response_handler(ngx_http_request_t *r,
     ngx_int_t error);
 ngx_int_t ngx_http_filter_finalize_request(ngx_http_request_t *r,
@@ -193,6 +202,7 @@ extern ngx_str_t  ngx_http_html_default_types[];
 extern ngx_http_output_header_filter_pt  ngx_http_top_header_filter;
 extern ngx_http_output_body_filter_pt    ngx_http_top_body_filter;
 extern ngx_http_request_body_filter_pt   ngx_http_top_request_body_filter;
+extern ngx_http_output_early_hints_filter_pt  ngx_http_top_early_hints_filter;
 
 
 #endif /* _NGX_HTTP_H_INCLUDED_ */
@@ -26,9 +26,15 @@
 #define NGX_HTTP_CACHE_KEY_LEN       16
 #define NGX_HTTP_CACHE_ETAG_LEN      128
 #define NGX_HTTP_CACHE_VARY_LEN      128
+#define NGX_HTTP_CACHE_TAG_KEYS      7
 
 #define NGX_HTTP_CACHE_VERSION       5
 
+#define NGX_HTTP_CACHE_KEY_MD5       0
+#define NGX_HTTP_CACHE_KEY_MURMUR3   1
+
+#define NGX_HTTP_CACHE_STATS_SLOTS   32
+
 
 typedef struct {
     ngx_uint_t                       status;
@@ -51,7 +57,11 @@ typedef struct {
     unsigned                         updating:1;
     unsigned                         deleting:1;
     unsigned                         purged:1;
-                                     /* 10 unused bits */
+    unsigned                         waiting:1;
+    unsigned                         streaming:1;
+    unsigned                         frequent:1;
+    unsigned                         tagged:1;
+                                     /* 6 unused bits */
 
     ngx_file_uniq_t                  uniq;
     time_t                           expire;
@@ -59,6 +69,7 @@ typedef struct {
     size_t                           body_start;
     off_t                            fs_size;
     ngx_msec_t                       lock_time;
+    uint32_t                         temp_number;
 } ngx_http_file_cache_node_t;
 
 
@@ -80,6 +91,8 @@ struct ngx_http_cache_s {
     ngx_str_t                        vary;
     u_char                           variant[NGX_HTTP_CACHE_KEY_LEN];
 
+    ngx_str_t                        tags;
+
     size_t                           buffer_size;
     size_t                           header_start;
     size_t                           body_start;
@@ -104,11 +117,18 @@ struct ngx_http_cache_s {
     ngx_msec_t                       lock_age;
     ngx_msec_t                       lock_time;
     ngx_msec_t                       wait_time;
+    ngx_msec_t                       wait_start;
 
     ngx_event_t                      wait_event;
+    ngx_queue_t                      wait_queue;
+
+    /* the temp file size published by the updater, or sent by the reader */
+    off_t                            streamed;
 
     unsigned                         lock:1;
+    unsigned                         lock_stream:1;
     unsigned                         waiting:1;
+    unsigned                         streaming:1;
 
     unsigned                         updated:1;
     unsigned                         updating:1;
@@ -116,6 +136,7 @@ struct ngx_http_cache_s {
     unsigned                         temp_file:1;
     unsigned                         purged:1;
     unsigned                         reading:1;
+    unsigned                         mem:1;
     unsigned                         secondary:1;
     unsigned                         update_variant:1;
     unsigned                         background:1;
@@ -145,17 +166,134 @@ typedef struct {
 
 
 typedef struct {
+    ngx_atomic_t                     status[NGX_HTTP_CACHE_SCARCE + 1];
+    ngx_atomic_t                     bytes;
+    ngx_atomic_t                     lock_waits;
+    ngx_atomic_t                     lock_timeouts;
+    ngx_atomic_t                     lock_wait_msec;
+} ngx_http_file_cache_counters_t;
+
+
+typedef union {
+    ngx_http_file_cache_counters_t   counters;
+    u_char                           padding[ngx_align(
+                                         sizeof(ngx_http_file_cache_counters_t),
+                                         NGX_CPU_CACHE_LINE)];
+} ngx_http_file_cache_stats_slot_t;
+
+
+typedef struct {
+    ngx_http_file_cache_counters_t   counters;
+    off_t                            size;
+    ngx_uint_t                       count;
+    ngx_uint_t                       shards;
+} ngx_http_file_cache_stats_t;
+
+
+typedef struct {
+    /*
+     * the counters of worker processes, in separate cache lines;
+     * the first in the page aligned allocation
+     */
+    ngx_http_file_cache_stats_slot_t stats[NGX_HTTP_CACHE_STATS_SLOTS];
+
     ngx_rbtree_t                     rbtree;
     ngx_rbtree_node_t                sentinel;
     ngx_queue_t                      queue;
+    ngx_queue_t                      frequent;
+    ngx_uint_t                       frequent_count;
     ngx_atomic_t                     cold;
     ngx_atomic_t                     loading;
     off_t                            size;
     ngx_uint_t                       count;
     ngx_uint_t                       watermark;
+    uintptr_t                        waiters;
+
+    /* 4-bit counters of the key frequency sketch, 4 rows */
+    u_char                          *sketch;
+    ngx_uint_t                       sketch_mask;
+    ngx_uint_t                       sketch_samples;
+
+    /* the tags index, and the purges pending in the cache manager */
+    ngx_rbtree_t                     tags;
+    ngx_rbtree_node_t                tags_sentinel;
+    ngx_queue_t                      purges;
+    ngx_uint_t                       prefixes;
+
+    /* the slot of the cache manager process */
+    ngx_int_t                        manager;
 } ngx_http_file_cache_sh_t;
 
 
+typedef struct ngx_http_file_cache_tag_keys_s  ngx_http_file_cache_tag_keys_t;
+
+struct ngx_http_file_cache_tag_keys_s {
+    ngx_http_file_cache_tag_keys_t  *next;
+    ngx_uint_t                       nelts;
+    u_char                           key[NGX_HTTP_CACHE_TAG_KEYS]
+                                        [NGX_HTTP_CACHE_KEY_LEN];
+};
+
+
+typedef struct {
+    ngx_str_node_t                   sn;
+    ngx_http_file_cache_tag_keys_t  *keys;
+    u_char                           data[1];
+} ngx_http_file_cache_tag_t;
+
+
+typedef struct {
+    ngx_queue_t                      queue;
+    time_t                           time;
+
+    /* the keys of a purged tag, or the key prefix */
+    ngx_http_file_cache_tag_keys_t  *keys;
+    ngx_uint_t                       tag;
+
+    /* the last node walked for the prefix */
+    ngx_uint_t                       walked;
+    u_char                           key[NGX_HTTP_CACHE_KEY_LEN];
+
+    size_t                           len;
+    u_char                           prefix[1];
+} ngx_http_file_cache_purge_t;
+
+
+typedef struct {
+    ngx_str_node_t                   sn;
+    ngx_queue_t                      queue;
+    u_char                           key[NGX_HTTP_CACHE_KEY_LEN];
+    ngx_file_uniq_t                  uniq;
+    size_t                           size;
+    u_char                           data[1];
+} ngx_http_file_cache_mem_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t                     rbtree;
+    ngx_rbtree_node_t                sentinel;
+    ngx_queue_t                      queue;
+} ngx_http_file_cache_mem_sh_t;
+
+
+typedef struct {
+    ngx_str_t                        name;
+    ngx_str_t                        temp;
+    time_t                           interval;
+
+    /* the index being written by the cache manager */
+    ngx_file_t                       file;
+    time_t                           time;
+    time_t                           next;
+    ngx_uint_t                       count;
+    ngx_uint_t                       walked;
+    u_char                           key[NGX_HTTP_CACHE_KEY_LEN];
+
+    /* the time of the index loaded by the cache loader */
+    time_t                           loaded;
+} ngx_http_file_cache_index_t;
+
+
 struct ngx_http_file_cache_s {
     ngx_http_file_cache_sh_t        *sh;
     ngx_slab_pool_t                 *shpool;
@@ -182,8 +320,34 @@ struct ngx_http_file_cache_s {
 
     ngx_shm_zone_t                  *shm_zone;
 
+    ngx_http_file_cache_mem_sh_t    *mem_sh;
+    ngx_slab_pool_t                 *mem_shpool;
+    ngx_shm_zone_t                  *mem_zone;
+    size_t                           mem_max_object;
+
+    ngx_http_file_cache_index_t     *index;
+
+    /* the keys zone shards, selected by the key */
+    ngx_http_file_cache_t          **shards;
+    ngx_uint_t                       nshards;
+
+    ngx_uint_t                       waiting;
+
     ngx_uint_t                       use_temp_path;
                                      /* unsigned use_temp_path:1 */
+
+    ngx_uint_t                       key_hash;
+
+    ngx_uint_t                       slru;
+                                     /* unsigned slru:1 */
+
+    ngx_uint_t                       admission;
+                                     /* unsigned admission:1 */
+
+    /* the tags index position of the cache manager sweep */
+    ngx_rbtree_key_t                 tags_key;
+    ngx_uint_t                       tags_walked;
+    time_t                           tags_next;
 };
 
 
@@ -194,8 +358,14 @@ ngx_int_t ngx_http_file_cache_open(ngx_http_request_t *r);
 ngx_int_t ngx_http_file_cache_set_header(ngx_http_request_t *r, u_char *buf);
 void ngx_http_file_cache_update(ngx_http_request_t *r, ngx_temp_file_t *tf);
 void ngx_http_file_cache_update_header(ngx_http_request_t *r);
+void ngx_http_file_cache_stream_update(ngx_http_request_t *r,
+    ngx_temp_file_t *tf);
 ngx_int_t ngx_http_cache_send(ngx_http_request_t *);
 void ngx_http_file_cache_free(ngx_http_cache_t *c, ngx_temp_file_t *tf);
+ngx_int_t ngx_http_file_cache_purge(ngx_http_request_t *r);
+void ngx_http_file_cache_count(ngx_http_cache_t *c, ngx_uint_t status);
+ngx_int_t ngx_http_file_cache_stats(ngx_shm_zone_t *shm_zone,
+    ngx_http_file_cache_stats_t *st);
 time_t ngx_http_file_cache_valid(ngx_array_t *cache_valid, ngx_uint_t status);
 
 char *ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd,
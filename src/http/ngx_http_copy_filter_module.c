@@ -86,6 +86,7 @@ ngx_http_copy_filter(ngx_http_request_t *r, ngx_chain_t *in)
     ngx_connection_t             *c;
     ngx_output_chain_ctx_t       *ctx;
     ngx_http_core_loc_conf_t     *clcf;
+    ngx_http_core_main_conf_t    *cmcf;
     ngx_http_copy_filter_conf_t  *conf;
 
     c = r->connection;
@@ -105,6 +106,7 @@ ngx_http_copy_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
         conf = ngx_http_get_module_loc_conf(r, ngx_http_copy_filter_module);
         clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+        cmcf = ngx_http_get_module_main_conf(r, ngx_http_core_module);
 
         ctx->sendfile = c->sendfile;
         ctx->need_in_memory = r->main_filter_need_in_memory
@@ -112,6 +114,8 @@ ngx_http_copy_filter(ngx_http_request_t *r, ngx_chain_t *in)
         ctx->need_in_temp = r->filter_need_temporary;
 
         ctx->alignment = clcf->directio_alignment;
+        ctx->directio_pool = cmcf->directio_pool;
+        ctx->read_ahead = clcf->read_ahead_window;
 
         ctx->pool = r->pool;
         ctx->bufs = conf->bufs;
@@ -62,8 +62,12 @@ static char *ngx_http_core_set_aio(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_core_directio(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_core_directio_pool(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 static char *ngx_http_core_error_page(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_core_early_hints_link(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
 static char *ngx_http_core_open_file_cache(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_core_error_log(ngx_conf_t *cf, ngx_command_t *cmd,
@@ -75,7 +79,9 @@ static char *ngx_http_core_internal(ngx_conf_t *cf, ngx_command_t *cmd,
 static char *ngx_http_core_resolver(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 #if (NGX_HTTP_GZIP)
-static ngx_int_t ngx_http_gzip_accept_encoding(ngx_str_t *ae);
+static ngx_int_t ngx_http_gzip_allowed(ngx_http_request_t *r);
+static ngx_int_t ngx_http_gzip_accept_encoding(ngx_str_t *ae,
+    ngx_str_t *encoding);
 static ngx_uint_t ngx_http_gzip_quantity(u_char *p, u_char *last);
 static char *ngx_http_gzip_disable(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
@@ -89,11 +95,18 @@ static char *ngx_http_disable_symlinks(ngx_conf_t *cf, ngx_command_t *cmd,
 #endif
 
 static char *ngx_http_core_lowat_check(ngx_conf_t *cf, void *post, void *data);
+static char *ngx_http_core_notsent_lowat_check(ngx_conf_t *cf, void *post,
+    void *data);
 static char *ngx_http_core_pool_size(ngx_conf_t *cf, void *post, void *data);
+static char *ngx_http_core_request_pool_size(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
 
 static ngx_conf_post_t  ngx_http_core_lowat_post =
     { ngx_http_core_lowat_check };
 
+static ngx_conf_post_t  ngx_http_core_notsent_lowat_post =
+    { ngx_http_core_notsent_lowat_check };
+
 static ngx_conf_post_handler_pt  ngx_http_core_pool_size_p =
     ngx_http_core_pool_size;
 
@@ -196,6 +209,20 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_main_conf_t, variables_hash_bucket_size),
       NULL },
 
+    { ngx_string("keepalive_handoff"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_core_main_conf_t, keepalive_handoff),
+      NULL },
+
+    { ngx_string("precise_timing"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_core_main_conf_t, precise_timing),
+      NULL },
+
     { ngx_string("server_names_hash_max_size"),
       NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_num_slot,
@@ -226,7 +253,7 @@ static ngx_command_t  ngx_http_core_commands[] = {
 
     { ngx_string("request_pool_size"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
-      ngx_conf_set_size_slot,
+      ngx_http_core_request_pool_size,
       NGX_HTTP_SRV_CONF_OFFSET,
       offsetof(ngx_http_core_srv_conf_t, request_pool_size),
       &ngx_http_core_pool_size_p },
@@ -238,6 +265,13 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_srv_conf_t, client_header_timeout),
       NULL },
 
+    { ngx_string("request_trace"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_1MORE,
+      ngx_http_trace_set_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_core_srv_conf_t, trace),
+      NULL },
+
     { ngx_string("client_header_buffer_size"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_size_slot,
@@ -423,6 +457,13 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_loc_conf_t, aio_write),
       NULL },
 
+    { ngx_string("client_body_aio_write"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_core_loc_conf_t, client_body_aio_write),
+      NULL },
+
     { ngx_string("read_ahead"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_size_slot,
@@ -430,6 +471,13 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_loc_conf_t, read_ahead),
       NULL },
 
+    { ngx_string("read_ahead_window"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_core_loc_conf_t, read_ahead_window),
+      NULL },
+
     { ngx_string("directio"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_http_core_directio,
@@ -444,6 +492,13 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_loc_conf_t, directio_alignment),
       NULL },
 
+    { ngx_string("directio_pool"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE12,
+      ngx_http_core_directio_pool,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
     { ngx_string("tcp_nopush"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
       ngx_conf_set_flag_slot,
@@ -451,6 +506,13 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_loc_conf_t, tcp_nopush),
       NULL },
 
+    { ngx_string("zerocopy"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_core_loc_conf_t, zerocopy),
+      NULL },
+
     { ngx_string("tcp_nodelay"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
       ngx_conf_set_flag_slot,
@@ -472,6 +534,13 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_loc_conf_t, send_lowat),
       &ngx_http_core_lowat_post },
 
+    { ngx_string("tcp_notsent_lowat"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_core_loc_conf_t, tcp_notsent_lowat),
+      &ngx_http_core_notsent_lowat_post },
+
     { ngx_string("postpone_output"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_size_slot,
@@ -663,6 +732,20 @@ static ngx_command_t  ngx_http_core_commands[] = {
       offsetof(ngx_http_core_loc_conf_t, etag),
       NULL },
 
+    { ngx_string("early_hints"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_core_loc_conf_t, early_hints),
+      NULL },
+
+    { ngx_string("early_hints_link"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_core_early_hints_link,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
     { ngx_string("error_page"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_HTTP_LIF_CONF
                         |NGX_CONF_2MORE,
@@ -687,7 +770,7 @@ static ngx_command_t  ngx_http_core_commands[] = {
       NULL },
 
     { ngx_string("open_file_cache"),
-      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE12,
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE123,
       ngx_http_core_open_file_cache,
       NGX_HTTP_LOC_CONF_OFFSET,
       offsetof(ngx_http_core_loc_conf_t, open_file_cache),
@@ -819,6 +902,7 @@ ngx_str_t  ngx_http_core_get_method = { 3, (u_char *) "GET" };
 void
 ngx_http_handler(ngx_http_request_t *r)
 {
+    ngx_http_core_srv_conf_t   *cscf;
     ngx_http_core_main_conf_t  *cmcf;
 
     r->connection->log->action = NULL;
@@ -841,6 +925,13 @@ ngx_http_handler(ngx_http_request_t *r)
         r->lingering_close = (r->headers_in.content_length_n > 0
                               || r->headers_in.chunked);
         r->phase_handler = 0;
+        r->phase_start = ngx_current_msec;
+
+        cscf = ngx_http_get_module_srv_conf(r, ngx_http_core_module);
+
+        if (cscf->trace) {
+            ngx_http_trace_start(r, cscf->trace);
+        }
 
     } else {
         cmcf = ngx_http_get_module_main_conf(r, ngx_http_core_module);
@@ -872,6 +963,18 @@ ngx_http_core_run_phases(ngx_http_request_t *r)
 
     while (ph[r->phase_handler].checker) {
 
+        if (ph[r->phase_handler].phase != r->phase) {
+
+            /*
+             * the time is accounted to a phase until the next one starts,
+             * including waiting for subrequests, the request body, etc.
+             */
+
+            r->phase_time[r->phase] += ngx_current_msec - r->phase_start;
+            r->phase_start = ngx_current_msec;
+            r->phase = ph[r->phase_handler].phase;
+        }
+
         rc = ph[r->phase_handler].checker(r, &ph[r->phase_handler]);
 
         if (rc == NGX_OK) {
@@ -881,6 +984,23 @@ ngx_http_core_run_phases(ngx_http_request_t *r)
 }
 
 
+ngx_msec_t
+ngx_http_core_phase_time(ngx_http_request_t *r, ngx_uint_t phase)
+{
+    ngx_msec_t  ms;
+
+    ms = r->phase_time[phase];
+
+    /* the content phase lasts until the request is finalized */
+
+    if (r->phase == phase && r->phase_start) {
+        ms += ngx_current_msec - r->phase_start;
+    }
+
+    return ms;
+}
+
+
 ngx_int_t
 ngx_http_core_generic_phase(ngx_http_request_t *r, ngx_http_phase_handler_t *ph)
 {
@@ -1378,6 +1498,12 @@ ngx_http_update_location_config(ngx_http_request_t *r)
         r->connection->tcp_nopush = NGX_TCP_NOPUSH_DISABLED;
     }
 
+#if (NGX_HAVE_MSG_ZEROCOPY)
+    if (r == r->main && r->connection->fd != (ngx_socket_t) -1) {
+        ngx_linux_zerocopy(r->connection, clcf->zerocopy);
+    }
+#endif
+
     if (clcf->handler) {
         r->content_handler = clcf->handler;
     }
@@ -1395,12 +1521,13 @@ ngx_http_update_location_config(ngx_http_request_t *r)
 static ngx_int_t
 ngx_http_core_find_location(ngx_http_request_t *r)
 {
-    ngx_int_t                  rc;
-    ngx_http_core_loc_conf_t  *pclcf;
+    ngx_int_t                       rc;
+    ngx_http_core_loc_conf_t       *pclcf;
 #if (NGX_PCRE)
-    ngx_int_t                  n;
-    ngx_uint_t                 noregex;
-    ngx_http_core_loc_conf_t  *clcf, **clcfp;
+    ngx_int_t                       n;
+    ngx_uint_t                      noregex;
+    ngx_http_core_loc_conf_t       *clcf, **clcfp;
+    ngx_http_location_regex_set_t  *set;
 
     noregex = 0;
 #endif
@@ -1434,6 +1561,32 @@ ngx_http_core_find_location(ngx_http_request_t *r)
 
         for (clcfp = pclcf->regex_locations; *clcfp; clcfp++) {
 
+            set = (*clcfp)->regex_set;
+
+            if (set) {
+                n = ngx_regex_exec_set(set->regex, &r->uri);
+
+                if (n == NGX_REGEX_NO_MATCHED) {
+                    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                                   "test locations: ~ \"%V\" and %ui more",
+                                   &(*clcfp)->name, set->nelts - 1);
+
+                    clcfp += set->nelts - 1;
+                    continue;
+                }
+
+                if (n < 0) {
+                    ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                                  ngx_regex_exec_n " failed: %i on \"%V\" "
+                                  "using regex locations set", n, &r->uri);
+                    return NGX_ERROR;
+                }
+
+                /* the first matching location, captures are set below */
+
+                clcfp += n;
+            }
+
             ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "test location: ~ \"%V\"", &(*clcfp)->name);
 
@@ -1846,10 +1999,52 @@ ngx_http_send_header(ngx_http_request_t *r)
         r->headers_out.status_line.len = 0;
     }
 
+    if (r->filter_passthrough) {
+        return ngx_http_header_filter(r);
+    }
+
     return ngx_http_top_header_filter(r);
 }
 
 
+ngx_int_t
+ngx_http_send_early_hints(ngx_http_request_t *r, ngx_list_t *headers)
+{
+    ngx_int_t                  rc;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    /*
+     * interim responses are only sent for main requests before
+     * the response header, and never to HTTP/1.0 clients
+     */
+
+    if (!clcf->early_hints
+        || r != r->main
+        || r->header_sent
+        || r->post_action
+        || r->http_version < NGX_HTTP_VERSION_11
+        || headers->part.nelts == 0)
+    {
+        return NGX_OK;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http send early hints");
+
+    rc = ngx_http_top_early_hints_filter(r, headers);
+
+    if (rc == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    /* the rest of a partially sent interim response goes with the header */
+
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_http_output_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
@@ -1861,7 +2056,12 @@ ngx_http_output_filter(ngx_http_request_t *r, ngx_chain_t *in)
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
                    "http output filter \"%V?%V\"", &r->uri, &r->args);
 
-    rc = ngx_http_top_body_filter(r, in);
+    if (r->filter_passthrough) {
+        rc = ngx_http_write_filter(r, in);
+
+    } else {
+        rc = ngx_http_top_body_filter(r, in);
+    }
 
     if (rc == NGX_ERROR) {
         /* NGX_ERROR may be returned by any filter */
@@ -2023,10 +2223,9 @@ ngx_http_auth_basic_user(ngx_http_request_t *r)
 ngx_int_t
 ngx_http_gzip_ok(ngx_http_request_t *r)
 {
-    time_t                     date, expires;
-    ngx_uint_t                 p;
-    ngx_table_elt_t           *e, *d, *ae, *cc;
-    ngx_http_core_loc_conf_t  *clcf;
+    ngx_table_elt_t  *ae;
+
+    static ngx_str_t  gzip = ngx_string("gzip");
 
     r->gzip_tested = 1;
 
@@ -2053,11 +2252,60 @@ ngx_http_gzip_ok(ngx_http_request_t *r)
      */
 
     if (ngx_memcmp(ae->value.data, "gzip,", 5) != 0
-        && ngx_http_gzip_accept_encoding(&ae->value) != NGX_OK)
+        && ngx_http_gzip_accept_encoding(&ae->value, &gzip) != NGX_OK)
     {
         return NGX_DECLINED;
     }
 
+    if (ngx_http_gzip_allowed(r) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    r->gzip_ok = 1;
+
+    return NGX_OK;
+}
+
+
+/*
+ * other content codings, e.g., "br" and "zstd", are subject
+ * to the same "gzip_http_version", "gzip_proxied", and "gzip_disable"
+ */
+
+ngx_int_t
+ngx_http_encoding_ok(ngx_http_request_t *r, ngx_str_t *encoding)
+{
+    ngx_table_elt_t  *ae;
+
+    if (r != r->main) {
+        return NGX_DECLINED;
+    }
+
+    ae = r->headers_in.accept_encoding;
+    if (ae == NULL) {
+        return NGX_DECLINED;
+    }
+
+    if (ae->value.len < encoding->len) {
+        return NGX_DECLINED;
+    }
+
+    if (ngx_http_gzip_accept_encoding(&ae->value, encoding) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    return ngx_http_gzip_allowed(r);
+}
+
+
+static ngx_int_t
+ngx_http_gzip_allowed(ngx_http_request_t *r)
+{
+    time_t                     date, expires;
+    ngx_uint_t                 p;
+    ngx_table_elt_t           *e, *d, *cc;
+    ngx_http_core_loc_conf_t  *clcf;
+
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     if (r->headers_in.msie6 && clcf->gzip_disable_msie6) {
@@ -2174,8 +2422,6 @@ ok:
 
 #endif
 
-    r->gzip_ok = 1;
-
     return NGX_OK;
 }
 
@@ -2188,7 +2434,7 @@ ok:
  */
 
 static ngx_int_t
-ngx_http_gzip_accept_encoding(ngx_str_t *ae)
+ngx_http_gzip_accept_encoding(ngx_str_t *ae, ngx_str_t *encoding)
 {
     u_char  *p, *start, *last;
 
@@ -2196,7 +2442,7 @@ ngx_http_gzip_accept_encoding(ngx_str_t *ae)
     last = start + ae->len;
 
     for ( ;; ) {
-        p = ngx_strcasestrn(start, "gzip", 4 - 1);
+        p = ngx_strcasestrn(start, (char *) encoding->data, encoding->len - 1);
         if (p == NULL) {
             return NGX_DECLINED;
         }
@@ -2205,10 +2451,10 @@ ngx_http_gzip_accept_encoding(ngx_str_t *ae)
             break;
         }
 
-        start = p + 4;
+        start = p + encoding->len;
     }
 
-    p += 4;
+    p += encoding->len;
 
     while (p < last) {
         switch (*p++) {
@@ -2465,6 +2711,11 @@ ngx_http_subrequest(ngx_http_request_t *r,
     tp = ngx_timeofday();
     sr->start_sec = tp->sec;
     sr->start_msec = tp->msec;
+    sr->phase_start = ngx_current_msec;
+
+    if (r->start_usec) {
+        sr->start_usec = ngx_monotonic_usec();
+    }
 
     r->main->count++;
 
@@ -3256,6 +3507,7 @@ ngx_http_core_regex_location(ngx_conf_t *cf, ngx_http_core_loc_conf_t *clcf,
     }
 
     clcf->name = *regex;
+    clcf->regex_caseless = (rc.options & NGX_REGEX_CASELESS) ? 1 : 0;
 
     return NGX_OK;
 
@@ -3402,6 +3654,9 @@ ngx_http_core_create_main_conf(ngx_conf_t *cf)
     cmcf->variables_hash_max_size = NGX_CONF_UNSET_UINT;
     cmcf->variables_hash_bucket_size = NGX_CONF_UNSET_UINT;
 
+    cmcf->keepalive_handoff = NGX_CONF_UNSET;
+    cmcf->precise_timing = NGX_CONF_UNSET;
+
     return cmcf;
 }
 
@@ -3425,6 +3680,9 @@ ngx_http_core_init_main_conf(ngx_conf_t *cf, void *conf)
     cmcf->variables_hash_bucket_size =
                ngx_align(cmcf->variables_hash_bucket_size, ngx_cacheline_size);
 
+    ngx_conf_init_value(cmcf->keepalive_handoff, 0);
+    ngx_conf_init_value(cmcf->precise_timing, 0);
+
     if (cmcf->ncaptures) {
         cmcf->ncaptures = (cmcf->ncaptures + 1) * 3;
     }
@@ -3458,6 +3716,8 @@ ngx_http_core_create_srv_conf(ngx_conf_t *cf)
 
     cscf->connection_pool_size = NGX_CONF_UNSET_SIZE;
     cscf->request_pool_size = NGX_CONF_UNSET_SIZE;
+    cscf->request_pool_auto = NGX_CONF_UNSET;
+    cscf->trace = NGX_CONF_UNSET_PTR;
     cscf->client_header_timeout = NGX_CONF_UNSET_MSEC;
     cscf->client_header_buffer_size = NGX_CONF_UNSET_SIZE;
     cscf->ignore_invalid_headers = NGX_CONF_UNSET;
@@ -3486,6 +3746,8 @@ ngx_http_core_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
                               prev->connection_pool_size, 64 * sizeof(void *));
     ngx_conf_merge_size_value(conf->request_pool_size,
                               prev->request_pool_size, 4096);
+    ngx_conf_merge_value(conf->request_pool_auto, prev->request_pool_auto, 0);
+    ngx_conf_merge_ptr_value(conf->trace, prev->trace, NULL);
     ngx_conf_merge_msec_value(conf->client_header_timeout,
                               prev->client_header_timeout, 60000);
     ngx_conf_merge_size_value(conf->client_header_buffer_size,
@@ -3565,6 +3827,7 @@ ngx_http_core_create_loc_conf(ngx_conf_t *cf)
      *     clcf->default_type = { 0, NULL };
      *     clcf->error_log = NULL;
      *     clcf->error_pages = NULL;
+     *     clcf->early_hints_links = NULL;
      *     clcf->client_body_path = NULL;
      *     clcf->regex = NULL;
      *     clcf->exact_match = 0;
@@ -3589,17 +3852,21 @@ ngx_http_core_create_loc_conf(ngx_conf_t *cf)
     clcf->subrequest_output_buffer_size = NGX_CONF_UNSET_SIZE;
     clcf->aio = NGX_CONF_UNSET;
     clcf->aio_write = NGX_CONF_UNSET;
+    clcf->client_body_aio_write = NGX_CONF_UNSET;
 #if (NGX_THREADS)
     clcf->thread_pool = NGX_CONF_UNSET_PTR;
     clcf->thread_pool_value = NGX_CONF_UNSET_PTR;
 #endif
     clcf->read_ahead = NGX_CONF_UNSET_SIZE;
+    clcf->read_ahead_window = NGX_CONF_UNSET_SIZE;
     clcf->directio = NGX_CONF_UNSET;
     clcf->directio_alignment = NGX_CONF_UNSET;
     clcf->tcp_nopush = NGX_CONF_UNSET;
+    clcf->zerocopy = NGX_CONF_UNSET;
     clcf->tcp_nodelay = NGX_CONF_UNSET;
     clcf->send_timeout = NGX_CONF_UNSET_MSEC;
     clcf->send_lowat = NGX_CONF_UNSET_SIZE;
+    clcf->tcp_notsent_lowat = NGX_CONF_UNSET_SIZE;
     clcf->postpone_output = NGX_CONF_UNSET_SIZE;
     clcf->limit_rate = NGX_CONF_UNSET_PTR;
     clcf->limit_rate_after = NGX_CONF_UNSET_PTR;
@@ -3622,6 +3889,7 @@ ngx_http_core_create_loc_conf(ngx_conf_t *cf)
     clcf->recursive_error_pages = NGX_CONF_UNSET;
     clcf->chunked_transfer_encoding = NGX_CONF_UNSET;
     clcf->etag = NGX_CONF_UNSET;
+    clcf->early_hints = NGX_CONF_UNSET;
     clcf->server_tokens = NGX_CONF_UNSET_UINT;
     clcf->types_hash_max_size = NGX_CONF_UNSET_UINT;
     clcf->types_hash_bucket_size = NGX_CONF_UNSET_UINT;
@@ -3780,6 +4048,10 @@ ngx_http_core_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
         conf->error_pages = prev->error_pages;
     }
 
+    if (conf->early_hints_links == NULL) {
+        conf->early_hints_links = prev->early_hints_links;
+    }
+
     ngx_conf_merge_str_value(conf->default_type,
                               prev->default_type, "text/plain");
 
@@ -3816,21 +4088,28 @@ ngx_http_core_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
                               (size_t) ngx_pagesize);
     ngx_conf_merge_value(conf->aio, prev->aio, NGX_HTTP_AIO_OFF);
     ngx_conf_merge_value(conf->aio_write, prev->aio_write, 0);
+    ngx_conf_merge_value(conf->client_body_aio_write,
+                              prev->client_body_aio_write, 0);
 #if (NGX_THREADS)
     ngx_conf_merge_ptr_value(conf->thread_pool, prev->thread_pool, NULL);
     ngx_conf_merge_ptr_value(conf->thread_pool_value, prev->thread_pool_value,
                              NULL);
 #endif
     ngx_conf_merge_size_value(conf->read_ahead, prev->read_ahead, 0);
+    ngx_conf_merge_size_value(conf->read_ahead_window,
+                              prev->read_ahead_window, 0);
     ngx_conf_merge_off_value(conf->directio, prev->directio,
                               NGX_OPEN_FILE_DIRECTIO_OFF);
     ngx_conf_merge_off_value(conf->directio_alignment, prev->directio_alignment,
                               512);
     ngx_conf_merge_value(conf->tcp_nopush, prev->tcp_nopush, 0);
+    ngx_conf_merge_value(conf->zerocopy, prev->zerocopy, 0);
     ngx_conf_merge_value(conf->tcp_nodelay, prev->tcp_nodelay, 1);
 
     ngx_conf_merge_msec_value(conf->send_timeout, prev->send_timeout, 60000);
     ngx_conf_merge_size_value(conf->send_lowat, prev->send_lowat, 0);
+    ngx_conf_merge_size_value(conf->tcp_notsent_lowat,
+                              prev->tcp_notsent_lowat, 0);
     ngx_conf_merge_size_value(conf->postpone_output, prev->postpone_output,
                               1460);
 
@@ -3897,6 +4176,7 @@ ngx_http_core_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->chunked_transfer_encoding,
                               prev->chunked_transfer_encoding, 1);
     ngx_conf_merge_value(conf->etag, prev->etag, 1);
+    ngx_conf_merge_value(conf->early_hints, prev->early_hints, 0);
 
     ngx_conf_merge_uint_value(conf->server_tokens, prev->server_tokens,
                               NGX_HTTP_SERVER_TOKENS_ON);
@@ -3950,6 +4230,10 @@ ngx_http_core_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
                              prev->disable_symlinks_from, NULL);
 #endif
 
+    /* filter modules enabled in the location clear the flag when merged */
+
+    conf->filter_passthrough = (conf->aio == NGX_HTTP_AIO_OFF);
+
     return NGX_CONF_OK;
 }
 
@@ -4166,6 +4450,20 @@ ngx_http_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[n].data, "cpu_steer") == 0) {
+#if (NGX_HAVE_REUSEPORT && NGX_HAVE_INCOMING_CPU)
+            lsopt.cpu_steer = 1;
+            lsopt.set = 1;
+            lsopt.bind = 1;
+            continue;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "cpu_steer is not supported "
+                               "on this platform");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
         if (ngx_strcmp(value[n].data, "ssl") == 0) {
 #if (NGX_HTTP_SSL)
             lsopt.ssl = 1;
@@ -4309,7 +4607,15 @@ ngx_http_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    if (lsopt.cpu_steer && !lsopt.reuseport) {
+        return "\"cpu_steer\" parameter requires \"reuseport\"";
+    }
+
     if (lsopt.quic) {
+        if (lsopt.cpu_steer) {
+            return "\"cpu_steer\" parameter is incompatible with \"quic\"";
+        }
+
 #if (NGX_HAVE_TCP_FASTOPEN)
         if (lsopt.fastopen != -1) {
             return "\"fastopen\" parameter is incompatible with \"quic\"";
@@ -4827,6 +5133,50 @@ ngx_http_core_directio(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+static char *
+ngx_http_core_directio_pool(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_main_conf_t *cmcf = conf;
+
+    ssize_t     size;
+    ngx_str_t  *value;
+    ngx_uint_t  hugepages;
+
+    if (cmcf->directio_pool) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    size = ngx_parse_size(&value[1]);
+
+    if (size == NGX_ERROR || size == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    hugepages = 0;
+
+    if (cf->args->nelts == 3) {
+        if (ngx_strcmp(value[2].data, "hugepages") != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        hugepages = 1;
+    }
+
+    cmcf->directio_pool = ngx_directio_pool_create(cf->pool, size, hugepages);
+    if (cmcf->directio_pool == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 static char *
 ngx_http_core_error_page(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -4946,14 +5296,55 @@ ngx_http_core_error_page(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+static char *
+ngx_http_core_early_hints_link(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_http_core_loc_conf_t *clcf = conf;
+
+    ngx_str_t                         *value;
+    ngx_http_complex_value_t          *cv;
+    ngx_http_compile_complex_value_t   ccv;
+
+    if (clcf->early_hints_links == NULL) {
+        clcf->early_hints_links = ngx_array_create(cf->pool, 2,
+                                          sizeof(ngx_http_complex_value_t));
+        if (clcf->early_hints_links == NULL) {
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    cv = ngx_array_push(clcf->early_hints_links);
+    if (cv == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    value = cf->args->elts;
+
+    ngx_memzero(&ccv, sizeof(ngx_http_compile_complex_value_t));
+
+    ccv.cf = cf;
+    ccv.value = &value[1];
+    ccv.complex_value = cv;
+
+    if (ngx_http_compile_complex_value(&ccv) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 static char *
 ngx_http_core_open_file_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_http_core_loc_conf_t *clcf = conf;
 
+    u_char      *p;
     time_t       inactive;
-    ngx_str_t   *value, s;
-    ngx_int_t    max;
+    ssize_t      size;
+    ngx_str_t   *value, s, name;
+    ngx_int_t    max, dirs;
     ngx_uint_t   i;
 
     if (clcf->open_file_cache != NGX_CONF_UNSET_PTR) {
@@ -4963,7 +5354,10 @@ ngx_http_core_open_file_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     value = cf->args->elts;
 
     max = 0;
+    dirs = 0;
     inactive = 60;
+    size = 0;
+    ngx_str_null(&name);
 
     for (i = 1; i < cf->args->nelts; i++) {
 
@@ -4990,6 +5384,53 @@ ngx_http_core_open_file_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "zone=", 5) == 0) {
+
+            name.data = value[i].data + 5;
+
+            p = (u_char *) ngx_strchr(name.data, ':');
+
+            if (p == NULL) {
+                goto failed;
+            }
+
+            name.len = p - name.data;
+
+            s.data = p + 1;
+            s.len = value[i].data + value[i].len - s.data;
+
+            size = ngx_parse_size(&s);
+
+            if (name.len == 0 || size == NGX_ERROR) {
+                goto failed;
+            }
+
+            if (size < (ssize_t) (8 * ngx_pagesize)) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "zone \"%V\" is too small", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "dirs=", 5) == 0) {
+
+#if (NGX_HAVE_OPENAT)
+            dirs = ngx_atoi(value[i].data + 5, value[i].len - 5);
+            if (dirs <= 0) {
+                goto failed;
+            }
+
+            continue;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"dirs\" parameter is not supported "
+                               "on this platform");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
         if (ngx_strcmp(value[i].data, "off") == 0) {
 
             clcf->open_file_cache = NULL;
@@ -5016,11 +5457,26 @@ ngx_http_core_open_file_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     clcf->open_file_cache = ngx_open_file_cache_init(cf->pool, max, inactive);
-    if (clcf->open_file_cache) {
-        return NGX_CONF_OK;
+    if (clcf->open_file_cache == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (dirs
+        && ngx_open_file_cache_dirs(cf->pool, clcf->open_file_cache, dirs)
+           != NGX_OK)
+    {
+        return NGX_CONF_ERROR;
+    }
+
+    if (name.len
+        && ngx_open_file_cache_zone(cf, clcf->open_file_cache, &name, size,
+                                    &ngx_http_core_module)
+           != NGX_OK)
+    {
+        return NGX_CONF_ERROR;
     }
 
-    return NGX_CONF_ERROR;
+    return NGX_CONF_OK;
 }
 
 
@@ -5328,6 +5784,56 @@ ngx_http_core_lowat_check(ngx_conf_t *cf, void *post, void *data)
 }
 
 
+static char *
+ngx_http_core_notsent_lowat_check(ngx_conf_t *cf, void *post, void *data)
+{
+    size_t *np = data;
+
+    if (*np > NGX_MAX_INT32_VALUE) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"tcp_notsent_lowat\" is too big");
+        return NGX_CONF_ERROR;
+    }
+
+#if !(NGX_HAVE_TCP_NOTSENT_LOWAT)
+
+    ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                       "\"tcp_notsent_lowat\" is not supported, ignored");
+
+    *np = 0;
+
+#endif
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_core_request_pool_size(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_http_core_srv_conf_t *cscf = conf;
+
+    ngx_str_t  *value;
+
+    if (cscf->request_pool_auto != NGX_CONF_UNSET) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "auto") == 0) {
+        cscf->request_pool_auto = 1;
+        cscf->request_pool_size = 4096;
+        return NGX_CONF_OK;
+    }
+
+    cscf->request_pool_auto = 0;
+
+    return ngx_conf_set_size_slot(cf, cmd, conf);
+}
+
+
 static char *
 ngx_http_core_pool_size(ngx_conf_t *cf, void *post, void *data)
 {
@@ -81,6 +81,7 @@ typedef struct {
 #endif
     unsigned                   deferred_accept:1;
     unsigned                   reuseport:1;
+    unsigned                   cpu_steer:1;
     unsigned                   so_keepalive:2;
     unsigned                   proxy_protocol:1;
 
@@ -136,6 +137,7 @@ struct ngx_http_phase_handler_s {
     ngx_http_phase_handler_pt  checker;
     ngx_http_handler_pt        handler;
     ngx_uint_t                 next;
+    ngx_uint_t                 phase;
 };
 
 
@@ -172,6 +174,11 @@ typedef struct {
 
     ngx_hash_keys_arrays_t    *variables_keys;
 
+    ngx_flag_t                 keepalive_handoff;
+    ngx_flag_t                 precise_timing;
+
+    ngx_directio_pool_t       *directio_pool;
+
     ngx_array_t               *ports;
 
     ngx_http_phase_t           phases[NGX_HTTP_LOG_PHASE + 1];
@@ -194,10 +201,15 @@ typedef struct {
     size_t                      request_pool_size;
     size_t                      client_header_buffer_size;
 
+    ngx_flag_t                  request_pool_auto;
+    size_t                      request_pool_used;   /* moving average */
+
     ngx_bufs_t                  large_client_header_buffers;
 
     ngx_msec_t                  client_header_timeout;
 
+    ngx_http_trace_conf_t      *trace;
+
     ngx_flag_t                  ignore_invalid_headers;
     ngx_flag_t                  merge_slashes;
     ngx_flag_t                  underscores_in_headers;
@@ -305,12 +317,25 @@ typedef struct {
 } ngx_http_err_page_t;
 
 
+#if (NGX_PCRE)
+
+/* the regex locations starting from the current one tested at once */
+
+typedef struct {
+    ngx_regex_t                *regex;
+    ngx_uint_t                  nelts;
+} ngx_http_location_regex_set_t;
+
+#endif
+
+
 struct ngx_http_core_loc_conf_s {
     ngx_str_t     name;          /* location name */
     ngx_str_t     escaped_name;
 
 #if (NGX_PCRE)
     ngx_http_regex_t  *regex;
+    ngx_http_location_regex_set_t  *regex_set;
 #endif
 
     unsigned      noname:1;   /* "if () {}" block or limit_except */
@@ -319,8 +344,15 @@ struct ngx_http_core_loc_conf_s {
 
     unsigned      exact_match:1;
     unsigned      noregex:1;
+#if (NGX_PCRE)
+    unsigned      regex_caseless:1;
+#endif
 
     unsigned      auto_redirect:1;
+
+    /* no filter modules change responses, see ngx_http_static_handler() */
+    unsigned      filter_passthrough:1;
+
 #if (NGX_HTTP_GZIP)
     unsigned      gzip_disable_msie6:2;
     unsigned      gzip_disable_degradation:2;
@@ -357,9 +389,11 @@ struct ngx_http_core_loc_conf_s {
 
     size_t        client_body_buffer_size; /* client_body_buffer_size */
     size_t        send_lowat;              /* send_lowat */
+    size_t        tcp_notsent_lowat;       /* tcp_notsent_lowat */
     size_t        postpone_output;         /* postpone_output */
     size_t        sendfile_max_chunk;      /* sendfile_max_chunk */
     size_t        read_ahead;              /* read_ahead */
+    size_t        read_ahead_window;       /* read_ahead_window */
     size_t        subrequest_output_buffer_size;
                                            /* subrequest_output_buffer_size */
 
@@ -393,7 +427,9 @@ struct ngx_http_core_loc_conf_s {
     ngx_flag_t    sendfile;                /* sendfile */
     ngx_flag_t    aio;                     /* aio */
     ngx_flag_t    aio_write;               /* aio_write */
+    ngx_flag_t    client_body_aio_write;   /* client_body_aio_write */
     ngx_flag_t    tcp_nopush;              /* tcp_nopush */
+    ngx_flag_t    zerocopy;                /* zerocopy */
     ngx_flag_t    tcp_nodelay;             /* tcp_nodelay */
     ngx_flag_t    reset_timedout_connection; /* reset_timedout_connection */
     ngx_flag_t    absolute_redirect;       /* absolute_redirect */
@@ -407,6 +443,9 @@ struct ngx_http_core_loc_conf_s {
     ngx_uint_t    server_tokens;           /* server_tokens */
     ngx_flag_t    chunked_transfer_encoding; /* chunked_transfer_encoding */
     ngx_flag_t    etag;                    /* etag */
+    ngx_flag_t    early_hints;             /* early_hints */
+
+    ngx_array_t  *early_hints_links;       /* early_hints_link */
 
 #if (NGX_HTTP_GZIP)
     ngx_flag_t    gzip_vary;               /* gzip_vary */
@@ -478,6 +517,7 @@ struct ngx_http_location_tree_node_s {
 
 
 void ngx_http_core_run_phases(ngx_http_request_t *r);
+ngx_msec_t ngx_http_core_phase_time(ngx_http_request_t *r, ngx_uint_t phase);
 ngx_int_t ngx_http_core_generic_phase(ngx_http_request_t *r,
     ngx_http_phase_handler_t *ph);
 ngx_int_t ngx_http_core_rewrite_phase(ngx_http_request_t *r,
@@ -506,6 +546,7 @@ u_char *ngx_http_map_uri_to_path(ngx_http_request_t *r, ngx_str_t *name,
 ngx_int_t ngx_http_auth_basic_user(ngx_http_request_t *r);
 #if (NGX_HTTP_GZIP)
 ngx_int_t ngx_http_gzip_ok(ngx_http_request_t *r);
+ngx_int_t ngx_http_encoding_ok(ngx_http_request_t *r, ngx_str_t *encoding);
 #endif
 
 
@@ -525,14 +566,26 @@ typedef ngx_int_t (*ngx_http_output_body_filter_pt)
     (ngx_http_request_t *r, ngx_chain_t *chain);
 typedef ngx_int_t (*ngx_http_request_body_filter_pt)
     (ngx_http_request_t *r, ngx_chain_t *chain);
+typedef ngx_int_t (*ngx_http_output_early_hints_filter_pt)
+    (ngx_http_request_t *r, ngx_list_t *headers);
 
 
 ngx_int_t ngx_http_output_filter(ngx_http_request_t *r, ngx_chain_t *chain);
+ngx_int_t ngx_http_header_filter(ngx_http_request_t *r);
 ngx_int_t ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *chain);
+void ngx_http_write_filter_set_handler(ngx_connection_t *c,
+    ngx_http_connection_t *hc, ngx_event_handler_pt handler);
+void ngx_http_write_filter_close(ngx_http_request_t *r);
 ngx_int_t ngx_http_request_body_save_filter(ngx_http_request_t *r,
     ngx_chain_t *chain);
 
 
+#define ngx_http_conf_disable_filter_passthrough(cf)                          \
+    ((ngx_http_core_loc_conf_t *)                                             \
+         ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module))         \
+        ->filter_passthrough = 0
+
+
 ngx_int_t ngx_http_set_disable_symlinks(ngx_http_request_t *r,
     ngx_http_core_loc_conf_t *clcf, ngx_str_t *path, ngx_open_file_info_t *of);
 
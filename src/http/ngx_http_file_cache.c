@@ -11,13 +11,72 @@
 #include <ngx_md5.h>
 
 
+#define NGX_HTTP_CACHE_INDEX_VERSION  1
+#define NGX_HTTP_CACHE_INDEX_ENTRIES  256
+#define NGX_HTTP_CACHE_INDEX_MARGIN   2
+
+/* the files with MurmurHash3 keys have a distinct header version */
+#define ngx_http_file_cache_version(cache)                                    \
+    (NGX_HTTP_CACHE_VERSION | (cache)->key_hash << 8)
+
+/* the share of the nodes in the frequent segment, in percents */
+#define NGX_HTTP_CACHE_FREQUENT_SHARE  80
+
+/* the tags index keys checked by the cache manager at once */
+#define NGX_HTTP_CACHE_TAGS_SWEEP      1024
+
+
+typedef struct {
+    uint32_t                         version;
+    uint32_t                         entry_size;
+    uint32_t                         crc32;
+    time_t                           time;
+    size_t                           bsize;
+    ngx_uint_t                       count;
+} ngx_http_file_cache_index_header_t;
+
+
+typedef struct {
+    u_char                           key[NGX_HTTP_CACHE_KEY_LEN];
+    off_t                            fs_size;
+    time_t                           expire;
+    ngx_uint_t                       uses;
+} ngx_http_file_cache_index_entry_t;
+
+
+static ngx_int_t ngx_http_file_cache_resize(ngx_shm_zone_t *shm_zone,
+    ngx_shm_zone_t *oshm_zone);
+static ngx_int_t ngx_http_file_cache_mem_init(ngx_shm_zone_t *shm_zone,
+    void *data);
 static ngx_int_t ngx_http_file_cache_lock(ngx_http_request_t *r,
     ngx_http_cache_t *c);
 static void ngx_http_file_cache_lock_wait_handler(ngx_event_t *ev);
 static ngx_int_t ngx_http_file_cache_lock_wait(ngx_http_request_t *r,
     ngx_http_cache_t *c);
+static void ngx_http_file_cache_wait_done(ngx_http_cache_t *c);
+static void ngx_http_file_cache_wakeup(ngx_http_file_cache_t *cache,
+    uintptr_t waiters);
+static void ngx_http_file_cache_notify_handler(void);
+static ngx_int_t ngx_http_file_cache_stream_open(ngx_http_request_t *r,
+    ngx_http_cache_t *c, uint32_t number);
+static ngx_int_t ngx_http_file_cache_stream(ngx_http_request_t *r);
+static ngx_int_t ngx_http_file_cache_stream_send(ngx_http_request_t *r);
+static void ngx_http_file_cache_stream_handler(ngx_http_request_t *r);
+static void ngx_http_file_cache_stream_wait_handler(ngx_event_t *ev);
 static ngx_int_t ngx_http_file_cache_read(ngx_http_request_t *r,
     ngx_http_cache_t *c);
+static ngx_int_t ngx_http_file_cache_mem_read(ngx_http_request_t *r,
+    ngx_http_cache_t *c);
+static void ngx_http_file_cache_mem_add(ngx_http_request_t *r,
+    ngx_http_cache_t *c);
+static void ngx_http_file_cache_mem_update(ngx_http_cache_t *c,
+    ngx_http_file_cache_header_t *h);
+static void ngx_http_file_cache_mem_delete(ngx_http_file_cache_t *cache,
+    u_char *key);
+static ngx_http_file_cache_mem_node_t *
+    ngx_http_file_cache_mem_lookup(ngx_http_file_cache_t *cache, u_char *key);
+static void ngx_http_file_cache_mem_free(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_mem_node_t *mn);
 static ssize_t ngx_http_file_cache_aio_read(ngx_http_request_t *r,
     ngx_http_cache_t *c);
 #if (NGX_HAVE_FILE_AIO)
@@ -49,6 +108,14 @@ static time_t ngx_http_file_cache_forced_expire(ngx_http_file_cache_t *cache);
 static time_t ngx_http_file_cache_expire(ngx_http_file_cache_t *cache);
 static void ngx_http_file_cache_delete(ngx_http_file_cache_t *cache,
     ngx_queue_t *q, u_char *name);
+static ngx_int_t ngx_http_file_cache_index_write(ngx_http_file_cache_t *cache);
+static ngx_int_t ngx_http_file_cache_index_open(ngx_http_file_cache_t *cache);
+static void ngx_http_file_cache_index_close(ngx_http_file_cache_t *cache,
+    ngx_uint_t complete);
+static ngx_rbtree_node_t *ngx_http_file_cache_next(
+    ngx_http_file_cache_t *cache, u_char *key);
+static ngx_int_t ngx_http_file_cache_index_load(ngx_http_file_cache_t *cache);
+static uint32_t ngx_http_file_cache_index_crc32(ngx_http_file_cache_t *cache);
 static void ngx_http_file_cache_loader_sleep(ngx_http_file_cache_t *cache);
 static ngx_int_t ngx_http_file_cache_noop(ngx_tree_ctx_t *ctx,
     ngx_str_t *path);
@@ -63,6 +130,48 @@ static ngx_int_t ngx_http_file_cache_add(ngx_http_file_cache_t *cache,
 static ngx_int_t ngx_http_file_cache_delete_file(ngx_tree_ctx_t *ctx,
     ngx_str_t *path);
 static void ngx_http_file_cache_set_watermark(ngx_http_file_cache_t *cache);
+static ngx_http_file_cache_t *ngx_http_file_cache_shard(
+    ngx_http_file_cache_t *cache, u_char *key);
+static ngx_http_file_cache_counters_t *ngx_http_file_cache_counters(
+    ngx_http_file_cache_t *cache);
+static ngx_msec_t ngx_http_file_cache_manage(ngx_http_file_cache_t *cache);
+static ngx_int_t ngx_http_file_cache_add_shards(ngx_conf_t *cf,
+    ngx_http_file_cache_t *cache, ngx_uint_t n, void *tag);
+static ngx_queue_t *ngx_http_file_cache_queue(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_node_t *fcn);
+static ngx_queue_t *ngx_http_file_cache_victim(ngx_http_file_cache_t *cache);
+static ngx_queue_t *ngx_http_file_cache_oldest(ngx_http_file_cache_t *cache);
+static ngx_int_t ngx_http_file_cache_sketch_init(ngx_http_file_cache_t *cache,
+    size_t size);
+static void ngx_http_file_cache_sketch_add(ngx_http_file_cache_sh_t *sh,
+    u_char *key);
+static ngx_uint_t ngx_http_file_cache_sketch_estimate(
+    ngx_http_file_cache_sh_t *sh, u_char *key);
+static ngx_uint_t ngx_http_file_cache_admit(ngx_http_file_cache_t *cache,
+    ngx_http_cache_t *c);
+static ngx_uint_t ngx_http_file_cache_purged(ngx_http_file_cache_t *cache,
+    ngx_http_cache_t *c, time_t mtime);
+static ngx_uint_t ngx_http_file_cache_match(ngx_http_cache_t *c, u_char *prefix,
+    size_t len);
+static ngx_int_t ngx_http_file_cache_purge_key(ngx_http_request_t *r,
+    ngx_http_file_cache_t *cache);
+static ngx_int_t ngx_http_file_cache_purge_prefix(ngx_http_request_t *r,
+    ngx_http_file_cache_t *cache);
+static ngx_int_t ngx_http_file_cache_purge_tags(ngx_http_request_t *r,
+    ngx_http_file_cache_t *cache);
+static void ngx_http_file_cache_purge_notify(ngx_http_file_cache_t *cache);
+static void ngx_http_file_cache_purge_node(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_node_t *fcn);
+static ngx_int_t ngx_http_file_cache_purge_process(
+    ngx_http_file_cache_t *cache);
+static ngx_int_t ngx_http_file_cache_purge_file(ngx_http_file_cache_t *cache,
+    u_char *name, u_char *key, u_char *buf, size_t len, time_t time,
+    ngx_file_uniq_t *uniq);
+static void ngx_http_file_cache_tag(ngx_http_file_cache_t *cache,
+    ngx_http_cache_t *c);
+static ngx_int_t ngx_http_file_cache_tag_next(u_char **pos, u_char *last,
+    ngx_str_t *tag);
+static void ngx_http_file_cache_tags_sweep(ngx_http_file_cache_t *cache);
 
 
 ngx_str_t  ngx_http_cache_status[] = {
@@ -79,6 +188,18 @@ ngx_str_t  ngx_http_cache_status[] = {
 static u_char  ngx_http_file_cache_key[] = { LF, 'K', 'E', 'Y', ':', ' ' };
 
 
+/* memory zones are never reused as keys zones */
+
+static ngx_uint_t  ngx_http_file_cache_mem_tag;
+
+
+/* requests of the process waiting for cache locks */
+
+static ngx_queue_t  ngx_http_file_cache_waiting = {
+    &ngx_http_file_cache_waiting, &ngx_http_file_cache_waiting
+};
+
+
 static ngx_int_t
 ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 {
@@ -90,6 +211,8 @@ ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 
     cache = shm_zone->data;
 
+    ngx_process_notify_handler = ngx_http_file_cache_notify_handler;
+
     if (ocache) {
         if (ngx_strcmp(cache->path->name.data, ocache->path->name.data) != 0) {
             ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
@@ -110,6 +233,13 @@ ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
             }
         }
 
+        if (cache->nshards != ocache->nshards) {
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "cache \"%V\" had previously different shards",
+                          &shm_zone->shm.name);
+            return NGX_ERROR;
+        }
+
         cache->sh = ocache->sh;
 
         cache->shpool = ocache->shpool;
@@ -117,10 +247,16 @@ ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 
         cache->max_size /= cache->bsize;
 
-        if (!cache->sh->cold || cache->sh->loading) {
+        /* the loader of a sharded cache checks all shards */
+
+        if (cache->nshards == 1 && (!cache->sh->cold || cache->sh->loading)) {
             cache->path->loader = NULL;
         }
 
+        if (cache->admission && cache->sh->sketch == NULL) {
+            return ngx_http_file_cache_sketch_init(cache, shm_zone->shm.size);
+        }
+
         return NGX_OK;
     }
 
@@ -141,16 +277,36 @@ ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 
     cache->shpool->data = cache->sh;
 
+    ngx_memzero(cache->sh->stats, sizeof(cache->sh->stats));
+
     ngx_rbtree_init(&cache->sh->rbtree, &cache->sh->sentinel,
                     ngx_http_file_cache_rbtree_insert_value);
 
     ngx_queue_init(&cache->sh->queue);
+    ngx_queue_init(&cache->sh->frequent);
 
+    cache->sh->frequent_count = 0;
     cache->sh->cold = 1;
     cache->sh->loading = 0;
     cache->sh->size = 0;
     cache->sh->count = 0;
     cache->sh->watermark = (ngx_uint_t) -1;
+    cache->sh->waiters = 0;
+    cache->sh->sketch = NULL;
+
+    ngx_rbtree_init(&cache->sh->tags, &cache->sh->tags_sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&cache->sh->purges);
+    cache->sh->prefixes = 0;
+    cache->sh->manager = -1;
+
+    if (cache->admission
+        && ngx_http_file_cache_sketch_init(cache, shm_zone->shm.size)
+           != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
 
     cache->bsize = ngx_fs_bsize(cache->path->name.data);
 
@@ -172,6 +328,212 @@ ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 }
 
 
+static ngx_int_t
+ngx_http_file_cache_resize(ngx_shm_zone_t *shm_zone, ngx_shm_zone_t *oshm_zone)
+{
+    size_t                           size;
+    ngx_uint_t                       i, n, all;
+    ngx_queue_t                     *q, *queue[2];
+    ngx_http_file_cache_t           *cache, *ocache;
+    ngx_http_file_cache_node_t      *fcn, *ofcn;
+    ngx_http_file_cache_purge_t     *purge, *opurge;
+    ngx_http_file_cache_tag_keys_t  *keys;
+
+    cache = shm_zone->data;
+    ocache = oshm_zone->data;
+
+    if (ngx_strcmp(cache->path->name.data, ocache->path->name.data) != 0
+        || ngx_memcmp(cache->path->level, ocache->path->level,
+                      NGX_MAX_PATH_LEVEL * sizeof(size_t))
+           != 0
+        || cache->nshards != ocache->nshards)
+    {
+        return NGX_OK;
+    }
+
+    /*
+     * the nodes are copied in the LRU order, the frequent ones first;
+     * the changes made by old worker processes after the copy are not seen
+     */
+
+    n = 0;
+    all = 1;
+
+    ngx_shmtx_lock(&ocache->shpool->mutex);
+
+    ngx_memcpy(cache->sh->stats, ocache->sh->stats, sizeof(cache->sh->stats));
+
+    queue[0] = &ocache->sh->frequent;
+    queue[1] = &ocache->sh->queue;
+
+    for (i = 0; i < 2 && all; i++) {
+
+        for (q = ngx_queue_head(queue[i]);
+             q != ngx_queue_sentinel(queue[i]);
+             q = ngx_queue_next(q))
+        {
+            ofcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
+
+            if (ofcn->deleting) {
+                continue;
+            }
+
+            fcn = ngx_slab_alloc(cache->shpool,
+                                 sizeof(ngx_http_file_cache_node_t));
+            if (fcn == NULL) {
+                break;
+            }
+
+            ngx_memcpy(fcn, ofcn, sizeof(ngx_http_file_cache_node_t));
+
+            fcn->count = 0;
+            fcn->updating = 0;
+
+            /* the tags index is not copied, the entries are tagged again */
+            fcn->tagged = 0;
+
+            ngx_rbtree_insert(&cache->sh->rbtree, &fcn->node);
+            ngx_queue_insert_tail(ngx_http_file_cache_queue(cache, fcn),
+                                  &fcn->queue);
+
+            if (fcn->frequent) {
+                cache->sh->frequent_count++;
+            }
+
+            cache->sh->size += fcn->fs_size;
+            cache->sh->count++;
+
+            n++;
+        }
+
+        /* the loader adds the files not copied */
+
+        all = (q == ngx_queue_sentinel(queue[i]));
+    }
+
+    if (all && !ocache->sh->cold && !ocache->sh->loading) {
+        cache->sh->cold = 0;
+    }
+
+    /*
+     * the entries of pending tag purges are marked as purged,
+     * pending prefix purges are restarted
+     */
+
+    for (q = ngx_queue_head(&ocache->sh->purges);
+         q != ngx_queue_sentinel(&ocache->sh->purges);
+         q = ngx_queue_next(q))
+    {
+        opurge = ngx_queue_data(q, ngx_http_file_cache_purge_t, queue);
+
+        if (opurge->tag) {
+            for (keys = opurge->keys; keys; keys = keys->next) {
+                for (i = 0; i < keys->nelts; i++) {
+                    fcn = ngx_http_file_cache_lookup(cache, keys->key[i]);
+
+                    if (fcn) {
+                        fcn->purged = 1;
+                    }
+                }
+            }
+
+            continue;
+        }
+
+        size = offsetof(ngx_http_file_cache_purge_t, prefix) + opurge->len;
+
+        purge = ngx_slab_alloc(cache->shpool, size);
+        if (purge == NULL) {
+            ngx_log_error(NGX_LOG_WARN, shm_zone->shm.log, 0,
+                          "cache \"%V\" purge of \"%*s*\" is lost on resize",
+                          &shm_zone->shm.name, opurge->len, opurge->prefix);
+            continue;
+        }
+
+        ngx_memcpy(purge, opurge, size);
+        purge->walked = 0;
+
+        ngx_queue_insert_tail(&cache->sh->purges, &purge->queue);
+        cache->sh->prefixes++;
+    }
+
+    ngx_shmtx_unlock(&ocache->shpool->mutex);
+
+    ngx_log_error(NGX_LOG_NOTICE, shm_zone->shm.log, 0,
+                  "cache \"%V\" resized from %uz to %uz, %ui entries kept%s",
+                  &shm_zone->shm.name, oshm_zone->shm.size,
+                  shm_zone->shm.size, n, all ? "" : ", others are reloaded");
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_mem_init(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_file_cache_t  *ocache = data;
+
+    size_t                  len;
+    ngx_uint_t              i;
+    ngx_http_file_cache_t  *cache;
+
+    cache = shm_zone->data;
+
+    if (ocache) {
+        cache->mem_sh = ocache->mem_sh;
+        cache->mem_shpool = ocache->mem_shpool;
+
+        goto done;
+    }
+
+    cache->mem_shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cache->mem_sh = cache->mem_shpool->data;
+
+        goto done;
+    }
+
+    cache->mem_sh = ngx_slab_alloc(cache->mem_shpool,
+                                   sizeof(ngx_http_file_cache_mem_sh_t));
+    if (cache->mem_sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->mem_shpool->data = cache->mem_sh;
+
+    ngx_rbtree_init(&cache->mem_sh->rbtree, &cache->mem_sh->sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&cache->mem_sh->queue);
+
+    len = sizeof(" in cache memory zone \"\"") + shm_zone->shm.name.len;
+
+    cache->mem_shpool->log_ctx = ngx_slab_alloc(cache->mem_shpool, len);
+    if (cache->mem_shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(cache->mem_shpool->log_ctx, " in cache memory zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    /* the least recently used objects are evicted on allocation failures */
+
+    cache->mem_shpool->log_nomem = 0;
+
+done:
+
+    /* the memory zone is shared by the keys zone shards */
+
+    for (i = 1; i < cache->nshards; i++) {
+        cache->shards[i]->mem_sh = cache->mem_sh;
+        cache->shards[i]->mem_shpool = cache->mem_shpool;
+    }
+
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_http_file_cache_new(ngx_http_request_t *r)
 {
@@ -202,6 +564,8 @@ ngx_http_file_cache_create(ngx_http_request_t *r)
     ngx_http_file_cache_t  *cache;
 
     c = r->cache;
+
+    c->file_cache = ngx_http_file_cache_shard(c->file_cache, c->key);
     cache = c->file_cache;
 
     cln = ngx_pool_cleanup_add(r->pool, 0);
@@ -227,18 +591,26 @@ ngx_http_file_cache_create(ngx_http_request_t *r)
 void
 ngx_http_file_cache_create_key(ngx_http_request_t *r)
 {
-    size_t             len;
-    ngx_str_t         *key;
-    ngx_uint_t         i;
-    ngx_md5_t          md5;
-    ngx_http_cache_t  *c;
+    size_t               len;
+    ngx_str_t           *key;
+    ngx_uint_t           i, murmur3;
+    ngx_md5_t            md5;
+    ngx_http_cache_t    *c;
+    ngx_murmur_hash3_t   mh;
 
     c = r->cache;
 
     len = 0;
+    murmur3 = (c->file_cache->key_hash == NGX_HTTP_CACHE_KEY_MURMUR3);
 
     ngx_crc32_init(c->crc32);
-    ngx_md5_init(&md5);
+
+    if (murmur3) {
+        ngx_murmur_hash3_init(&mh);
+
+    } else {
+        ngx_md5_init(&md5);
+    }
 
     key = c->keys.elts;
     for (i = 0; i < c->keys.nelts; i++) {
@@ -248,14 +620,26 @@ ngx_http_file_cache_create_key(ngx_http_request_t *r)
         len += key[i].len;
 
         ngx_crc32_update(&c->crc32, key[i].data, key[i].len);
-        ngx_md5_update(&md5, key[i].data, key[i].len);
+
+        if (murmur3) {
+            ngx_murmur_hash3_update(&mh, key[i].data, key[i].len);
+
+        } else {
+            ngx_md5_update(&md5, key[i].data, key[i].len);
+        }
     }
 
     c->header_start = sizeof(ngx_http_file_cache_header_t)
                       + sizeof(ngx_http_file_cache_key) + len + 1;
 
     ngx_crc32_final(c->crc32);
-    ngx_md5_final(c->key, &md5);
+
+    if (murmur3) {
+        ngx_murmur_hash3_final(c->key, &mh);
+
+    } else {
+        ngx_md5_final(c->key, &md5);
+    }
 
     ngx_memcpy(c->main, c->key, NGX_HTTP_CACHE_KEY_LEN);
 }
@@ -264,6 +648,7 @@ ngx_http_file_cache_create_key(ngx_http_request_t *r)
 ngx_int_t
 ngx_http_file_cache_open(ngx_http_request_t *r)
 {
+    size_t                     size;
     ngx_int_t                  rc, rv;
     ngx_uint_t                 test;
     ngx_http_cache_t          *c;
@@ -282,6 +667,7 @@ ngx_http_file_cache_open(ngx_http_request_t *r)
         return ngx_http_file_cache_read(r, c);
     }
 
+    c->file_cache = ngx_http_file_cache_shard(c->file_cache, c->key);
     cache = c->file_cache;
 
     if (c->node == NULL) {
@@ -295,6 +681,7 @@ ngx_http_file_cache_open(ngx_http_request_t *r)
     }
 
     c->buffer_size = c->body_start;
+    c->mem = 0;
 
     rc = ngx_http_file_cache_exists(cache, c);
 
@@ -345,6 +732,20 @@ ngx_http_file_cache_open(ngx_http_request_t *r)
         goto done;
     }
 
+    /* files are checked against pending prefix purges, see below */
+
+    if (c->exists && cache->mem_zone && cache->sh->prefixes == 0) {
+        rc = ngx_http_file_cache_mem_read(r, c);
+
+        if (rc == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        if (rc == NGX_OK) {
+            return ngx_http_file_cache_read(r, c);
+        }
+    }
+
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     ngx_memzero(&of, sizeof(ngx_open_file_info_t));
@@ -378,13 +779,30 @@ ngx_http_file_cache_open(ngx_http_request_t *r)
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                    "http file cache fd: %d", of.fd);
 
+    if (cache->sh->prefixes && ngx_http_file_cache_purged(cache, c, of.mtime)) {
+        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http file cache purged");
+        goto done;
+    }
+
     c->file.fd = of.fd;
     c->file.log = r->connection->log;
     c->uniq = of.uniq;
     c->length = of.size;
     c->fs_size = (of.fs_size + cache->bsize - 1) / cache->bsize;
 
-    c->buf = ngx_create_temp_buf(r->pool, c->body_start);
+    size = c->body_start;
+
+    /* small objects are read whole to be added to the memory zone */
+
+    if (cache->mem_zone
+        && c->length > (off_t) size
+        && c->length <= (off_t) cache->mem_max_object)
+    {
+        size = (size_t) c->length;
+    }
+
+    c->buf = ngx_create_temp_buf(r->pool, size);
     if (c->buf == NULL) {
         return NGX_ERROR;
     }
@@ -404,6 +822,9 @@ done:
 static ngx_int_t
 ngx_http_file_cache_lock(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
+    uint32_t                   number;
+    ngx_int_t                  rc;
+    ngx_uint_t                 stream;
     ngx_msec_t                 now, timer;
     ngx_http_file_cache_t     *cache;
 
@@ -418,12 +839,46 @@ ngx_http_file_cache_lock(ngx_http_request_t *r, ngx_http_cache_t *c)
     ngx_shmtx_lock(&cache->shpool->mutex);
 
     timer = c->node->lock_time - now;
+    stream = 0;
+    number = 0;
 
     if (!c->node->updating || (ngx_msec_int_t) timer <= 0) {
         c->node->updating = 1;
+        c->node->streaming = 0;
         c->node->lock_time = now + c->lock_age;
         c->updating = 1;
         c->lock_time = c->node->lock_time;
+
+    } else if (!c->updating
+               && c->lock_stream
+               && c->node->streaming
+               && r == r->main)
+    {
+
+        /* the response is read from the temp file of the lock holder */
+
+        stream = 1;
+        number = c->node->temp_number;
+        c->lock_time = c->node->lock_time;
+
+    } else if (!c->updating && c->lock_timeout) {
+
+        /*
+         * the lock holder wakes up the waiters when it releases the lock,
+         * the waiters of other workers are notified via channels
+         */
+
+        c->node->waiting = 1;
+
+#if !(NGX_WIN32)
+        if (cache->waiting == 0
+            && ngx_process_slot < (ngx_int_t) (8 * sizeof(uintptr_t)))
+        {
+            cache->sh->waiters |= (uintptr_t) 1 << ngx_process_slot;
+        }
+#endif
+
+        cache->waiting++;
     }
 
     ngx_shmtx_unlock(&cache->shpool->mutex);
@@ -436,15 +891,35 @@ ngx_http_file_cache_lock(ngx_http_request_t *r, ngx_http_cache_t *c)
         return NGX_DECLINED;
     }
 
+    if (stream) {
+        rc = ngx_http_file_cache_stream_open(r, c, number);
+
+        if (rc != NGX_DECLINED) {
+            return rc;
+        }
+
+        /* the temp file is already renamed or deleted, wait */
+
+        c->lock_stream = 0;
+
+        return ngx_http_file_cache_lock(r, c);
+    }
+
     if (c->lock_timeout == 0) {
         return NGX_HTTP_CACHE_SCARCE;
     }
 
     c->waiting = 1;
+    c->wait_start = now;
+
+    ngx_queue_insert_tail(&ngx_http_file_cache_waiting, &c->wait_queue);
 
     if (c->wait_time == 0) {
         c->wait_time = now + c->lock_timeout;
 
+        ngx_atomic_fetch_add(&ngx_http_file_cache_counters(cache)->lock_waits,
+                             1);
+
         c->wait_event.handler = ngx_http_file_cache_lock_wait_handler;
         c->wait_event.data = r;
         c->wait_event.log = r->connection->log;
@@ -481,6 +956,12 @@ ngx_http_file_cache_lock_wait_handler(ngx_event_t *ev)
         return;
     }
 
+    ngx_atomic_fetch_add(
+        &ngx_http_file_cache_counters(r->cache->file_cache)->lock_wait_msec,
+        ngx_current_msec - r->cache->wait_start);
+
+    ngx_http_file_cache_wait_done(r->cache);
+
     r->cache->waiting = 0;
     r->main->blocked--;
 
@@ -514,6 +995,9 @@ ngx_http_file_cache_lock_wait(ngx_http_request_t *r, ngx_http_cache_t *c)
         ngx_log_error(NGX_LOG_INFO, r->connection->log, 0,
                       "cache lock timeout");
         c->lock_timeout = 0;
+
+        ngx_atomic_fetch_add(
+            &ngx_http_file_cache_counters(c->file_cache)->lock_timeouts, 1);
         return NGX_OK;
     }
 
@@ -539,1813 +1023,4256 @@ ngx_http_file_cache_lock_wait(ngx_http_request_t *r, ngx_http_cache_t *c)
 }
 
 
-static ngx_int_t
-ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
+static void
+ngx_http_file_cache_wait_done(ngx_http_cache_t *c)
 {
-    u_char                        *p;
-    time_t                         now;
-    ssize_t                        n;
-    ngx_str_t                     *key;
-    ngx_int_t                      rc;
-    ngx_uint_t                     i;
-    ngx_http_file_cache_t         *cache;
-    ngx_http_file_cache_header_t  *h;
+    ngx_http_file_cache_t  *cache;
 
-    n = ngx_http_file_cache_aio_read(r, c);
+    cache = c->file_cache;
 
-    if (n < 0) {
-        return n;
-    }
+    ngx_queue_remove(&c->wait_queue);
 
-    if ((size_t) n < c->header_start) {
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
-                      "cache file \"%s\" is too small", c->file.name.data);
-        return NGX_DECLINED;
+    if (c->wait_event.timer_set) {
+        ngx_del_timer(&c->wait_event);
     }
 
-    h = (ngx_http_file_cache_header_t *) c->buf->pos;
+    if (c->wait_event.posted) {
+        ngx_delete_posted_event(&c->wait_event);
+    }
 
-    if (h->version != NGX_HTTP_CACHE_VERSION) {
-        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0,
-                      "cache file \"%s\" version mismatch", c->file.name.data);
-        return NGX_DECLINED;
+    if (--cache->waiting) {
+        return;
     }
 
-    if (h->crc32 != c->crc32 || (size_t) h->header_start != c->header_start) {
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
-                      "cache file \"%s\" has md5 collision", c->file.name.data);
-        return NGX_DECLINED;
+#if !(NGX_WIN32)
+    if (ngx_process_slot < (ngx_int_t) (8 * sizeof(uintptr_t))) {
+        ngx_shmtx_lock(&cache->shpool->mutex);
+        cache->sh->waiters &= ~((uintptr_t) 1 << ngx_process_slot);
+        ngx_shmtx_unlock(&cache->shpool->mutex);
     }
+#endif
+}
 
-    p = c->buf->pos + sizeof(ngx_http_file_cache_header_t)
-        + sizeof(ngx_http_file_cache_key);
 
-    key = c->keys.elts;
-    for (i = 0; i < c->keys.nelts; i++) {
-        if (ngx_memcmp(p, key[i].data, key[i].len) != 0) {
-            ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
-                          "cache file \"%s\" has md5 collision",
-                          c->file.name.data);
-            return NGX_DECLINED;
-        }
+static void
+ngx_http_file_cache_wakeup(ngx_http_file_cache_t *cache, uintptr_t waiters)
+{
+    ngx_int_t          slot;
+    ngx_queue_t       *q;
+    ngx_http_cache_t  *c;
 
-        p += key[i].len;
-    }
+    for (q = ngx_queue_head(&ngx_http_file_cache_waiting);
+         q != ngx_queue_sentinel(&ngx_http_file_cache_waiting);
+         q = ngx_queue_next(q))
+    {
+        c = ngx_queue_data(q, ngx_http_cache_t, wait_queue);
 
-    if ((size_t) h->body_start > c->body_start) {
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
-                      "cache file \"%s\" has too long header",
-                      c->file.name.data);
-        return NGX_DECLINED;
+        if (c->file_cache->sh == cache->sh) {
+            ngx_post_event(&c->wait_event, &ngx_posted_events);
+        }
     }
 
-    if (h->vary_len > NGX_HTTP_CACHE_VARY_LEN) {
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
-                      "cache file \"%s\" has incorrect vary length",
-                      c->file.name.data);
-        return NGX_DECLINED;
+#if !(NGX_WIN32)
+    for (slot = 0; waiters; slot++, waiters >>= 1) {
+        if (waiters & 1) {
+            (void) ngx_notify_process(slot);
+        }
     }
+#else
+    (void) slot;
+#endif
+}
 
-    if (h->vary_len) {
-        ngx_http_file_cache_vary(r, h->vary, h->vary_len, c->variant);
 
-        if (ngx_memcmp(c->variant, h->variant, NGX_HTTP_CACHE_KEY_LEN) != 0) {
-            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                           "http file cache vary mismatch");
-            return ngx_http_file_cache_reopen(r, c);
-        }
-    }
+static void
+ngx_http_file_cache_notify_handler(void)
+{
+    ngx_queue_t       *q;
+    ngx_http_cache_t  *c;
 
-    c->buf->last += n;
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache notify");
 
-    c->valid_sec = h->valid_sec;
-    c->updating_sec = h->updating_sec;
-    c->error_sec = h->error_sec;
-    c->last_modified = h->last_modified;
-    c->date = h->date;
-    c->valid_msec = h->valid_msec;
-    c->body_start = h->body_start;
-    c->etag.len = h->etag_len;
-    c->etag.data = h->etag;
+    for (q = ngx_queue_head(&ngx_http_file_cache_waiting);
+         q != ngx_queue_sentinel(&ngx_http_file_cache_waiting);
+         q = ngx_queue_next(q))
+    {
+        c = ngx_queue_data(q, ngx_http_cache_t, wait_queue);
+        ngx_post_event(&c->wait_event, &ngx_posted_events);
+    }
+}
 
-    r->cached = 1;
 
+void
+ngx_http_file_cache_stream_update(ngx_http_request_t *r, ngx_temp_file_t *tf)
+{
+    uintptr_t               waiters;
+    ngx_int_t               number;
+    ngx_uint_t              wakeup;
+    ngx_http_cache_t       *c;
+    ngx_http_file_cache_t  *cache;
+
+    c = r->cache;
     cache = c->file_cache;
 
-    if (cache->sh->cold) {
+    if (!c->lock_stream
+        || !c->updating
+        || cache->use_temp_path
+        || tf->file.fd == NGX_INVALID_FILE
+        || tf->offset == c->streamed
+        || tf->file.name.len < c->file.name.len + 1 + 10)
+    {
+        return;
+    }
 
-        ngx_shmtx_lock(&cache->shpool->mutex);
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache stream update: %O", tf->offset);
 
-        if (!c->node->exists) {
-            c->node->uses = 1;
-            c->node->body_start = c->body_start;
-            c->node->exists = 1;
-            c->node->uniq = c->uniq;
-            c->node->fs_size = c->fs_size;
+    /* the temp file name is the cache file name with a 10-digit suffix */
 
-            cache->sh->size += c->fs_size;
-        }
+    number = NGX_ERROR;
 
-        ngx_shmtx_unlock(&cache->shpool->mutex);
+    if (c->streamed == 0) {
+        number = ngx_atoi(tf->file.name.data + tf->file.name.len - 10, 10);
     }
 
-    now = ngx_time();
+    c->streamed = tf->offset;
 
-    if (c->valid_sec < now) {
-        c->stale_updating = c->valid_sec + c->updating_sec >= now;
-        c->stale_error = c->valid_sec + c->error_sec >= now;
+    waiters = 0;
+    wakeup = 0;
 
-        ngx_shmtx_lock(&cache->shpool->mutex);
+    ngx_shmtx_lock(&cache->shpool->mutex);
 
-        if (c->node->updating) {
-            rc = NGX_HTTP_CACHE_UPDATING;
+    if (c->node->updating && c->node->lock_time == c->lock_time) {
 
-        } else {
-            c->node->updating = 1;
-            c->updating = 1;
-            c->lock_time = c->node->lock_time;
-            rc = NGX_HTTP_CACHE_STALE;
+        if (number != NGX_ERROR) {
+            c->node->temp_number = (uint32_t) number;
+            c->node->streaming = 1;
         }
 
-        ngx_shmtx_unlock(&cache->shpool->mutex);
+        if (c->node->waiting) {
+            c->node->waiting = 0;
+            waiters = cache->sh->waiters;
+            wakeup = 1;
+        }
+    }
 
-        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "http file cache expired: %i %T %T",
-                       rc, c->valid_sec, now);
+    ngx_shmtx_unlock(&cache->shpool->mutex);
 
-        return rc;
+    if (wakeup) {
+        ngx_http_file_cache_wakeup(cache, waiters);
     }
-
-    return NGX_OK;
 }
 
 
-static ssize_t
-ngx_http_file_cache_aio_read(ngx_http_request_t *r, ngx_http_cache_t *c)
+static ngx_int_t
+ngx_http_file_cache_stream_open(ngx_http_request_t *r, ngx_http_cache_t *c,
+    uint32_t number)
 {
-#if (NGX_HAVE_FILE_AIO || NGX_THREADS)
-    ssize_t                    n;
-    ngx_http_core_loc_conf_t  *clcf;
+    ngx_fd_t                  fd;
+    ngx_str_t                 name;
+    ngx_file_info_t           fi;
+    ngx_pool_cleanup_t       *cln;
+    ngx_pool_cleanup_file_t  *clnf;
 
-    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
-#endif
+    name.len = c->file.name.len + 1 + 10;
 
-#if (NGX_HAVE_FILE_AIO)
+    name.data = ngx_pnalloc(r->pool, name.len + 1);
+    if (name.data == NULL) {
+        return NGX_ERROR;
+    }
 
-    if (clcf->aio == NGX_HTTP_AIO_ON && ngx_file_aio) {
-        n = ngx_file_aio_read(&c->file, c->buf->pos, c->body_start, 0, r->pool);
+    (void) ngx_sprintf(name.data, "%V.%010uD%Z", &c->file.name, number);
 
-        if (n != NGX_AGAIN) {
-            c->reading = 0;
-            return n;
-        }
+    cln = ngx_pool_cleanup_add(r->pool, sizeof(ngx_pool_cleanup_file_t));
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
 
-        c->reading = 1;
+    fd = ngx_open_file(name.data, NGX_FILE_RDONLY|NGX_FILE_NONBLOCK,
+                       NGX_FILE_OPEN, 0);
 
-        c->file.aio->data = r;
-        c->file.aio->handler = ngx_http_cache_aio_event_handler;
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, ngx_errno,
+                       "http file cache stream \"%s\" not found", name.data);
+        return NGX_DECLINED;
+    }
 
-        ngx_add_timer(&c->file.aio->event, 60000);
+    cln->handler = ngx_pool_cleanup_file;
+    clnf = cln->data;
 
-        r->main->blocked++;
-        r->aio = 1;
+    clnf->fd = fd;
+    clnf->name = name.data;
+    clnf->log = r->pool->log;
 
-        return NGX_AGAIN;
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", name.data);
+        return NGX_ERROR;
     }
 
-#endif
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache stream: \"%s\" %O",
+                   name.data, ngx_file_size(&fi));
 
-#if (NGX_THREADS)
+    c->file.fd = fd;
+    c->file.name = name;
+    c->file.log = r->connection->log;
+    c->uniq = ngx_file_uniq(&fi);
+    c->length = ngx_file_size(&fi);
+    c->fs_size = 0;
+    c->streaming = 1;
 
-    if (clcf->aio == NGX_HTTP_AIO_THREADS) {
-        c->file.thread_task = c->thread_task;
-        c->file.thread_handler = ngx_http_cache_thread_handler;
-        c->file.thread_ctx = r;
+    c->buf = ngx_create_temp_buf(r->pool, c->body_start);
+    if (c->buf == NULL) {
+        return NGX_ERROR;
+    }
 
-        n = ngx_thread_read(&c->file, c->buf->pos, c->body_start, 0, r->pool);
+    return ngx_http_file_cache_read(r, c);
+}
 
-        c->thread_task = c->file.thread_task;
-        c->reading = (n == NGX_AGAIN);
 
-        return n;
-    }
+static ngx_int_t
+ngx_http_file_cache_stream_send(ngx_http_request_t *r)
+{
+    ngx_int_t                  rc;
+    ngx_buf_t                 *b;
+    ngx_uint_t                 done;
+    ngx_chain_t                out;
+    ngx_file_info_t            fi;
+    ngx_http_cache_t          *c;
+    ngx_http_file_cache_t     *cache;
 
-#endif
+    c = r->cache;
+    cache = c->file_cache;
 
-    return ngx_read_file(&c->file, c->buf->pos, c->body_start, 0);
-}
+    /* the waiter is registered before the size is checked */
 
+    ngx_shmtx_lock(&cache->shpool->mutex);
 
-#if (NGX_HAVE_FILE_AIO)
+    if (c->node->exists && c->node->uniq == c->uniq) {
+        rc = NGX_OK;
 
-static void
-ngx_http_cache_aio_event_handler(ngx_event_t *ev)
-{
-    ngx_event_aio_t     *aio;
-    ngx_connection_t    *c;
-    ngx_http_request_t  *r;
+    } else if (c->node->updating && c->node->lock_time == c->lock_time) {
+        rc = NGX_AGAIN;
 
-    aio = ev->data;
-    r = aio->data;
-    c = r->connection;
+        c->node->waiting = 1;
 
-    ngx_http_set_log_request(c->log, r);
+        if (!c->waiting) {
+#if !(NGX_WIN32)
+            if (cache->waiting == 0
+                && ngx_process_slot < (ngx_int_t) (8 * sizeof(uintptr_t)))
+            {
+                cache->sh->waiters |= (uintptr_t) 1 << ngx_process_slot;
+            }
+#endif
+            cache->waiting++;
+        }
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "http file cache aio: \"%V?%V\"", &r->uri, &r->args);
+    } else {
+        rc = NGX_ERROR;
+    }
 
-    if (ev->timedout) {
-        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
-                      "aio operation took too long");
-        ev->timedout = 0;
-        return;
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    if (rc == NGX_AGAIN && !c->waiting) {
+        c->waiting = 1;
+
+        ngx_queue_insert_tail(&ngx_http_file_cache_waiting, &c->wait_queue);
+
+        c->wait_event.handler = ngx_http_file_cache_stream_wait_handler;
+        c->wait_event.data = r;
+        c->wait_event.log = r->connection->log;
+
+    } else if (rc != NGX_AGAIN && c->waiting) {
+        ngx_http_file_cache_wait_done(c);
+        c->waiting = 0;
     }
 
-    if (ev->timer_set) {
-        ngx_del_timer(ev);
+    if (rc == NGX_ERROR) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "cache file \"%s\" was not completed",
+                      c->file.name.data);
+        return NGX_ERROR;
     }
 
-    r->main->blocked--;
-    r->aio = 0;
+    done = (rc == NGX_OK);
 
-    if (r->main->terminated) {
-        /*
-         * trigger connection event handler if the request was
-         * terminated
-         */
+    if (ngx_fd_info(c->file.fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", c->file.name.data);
+        return NGX_ERROR;
+    }
 
-        c->write->handler(c->write);
+    c->length = ngx_file_size(&fi);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache stream send: %O-%O done:%ui",
+                   c->streamed, c->length, done);
+
+    if (!done && (r->connection->buffered || c->length == c->streamed)) {
+
+        rc = ngx_http_output_filter(r, NULL);
 
     } else {
-        r->write_event_handler(r);
-        ngx_http_run_posted_requests(c);
+        b = ngx_calloc_buf(r->pool);
+        if (b == NULL) {
+            return NGX_ERROR;
+        }
+
+        b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t));
+        if (b->file == NULL) {
+            return NGX_ERROR;
+        }
+
+        b->file_pos = c->streamed;
+        b->file_last = c->length;
+
+        b->in_file = (c->length - c->streamed) ? 1 : 0;
+        b->flush = done ? 0 : 1;
+        b->last_buf = (done && r == r->main) ? 1 : 0;
+        b->last_in_chain = done ? 1 : 0;
+        b->sync = (b->last_buf || b->in_file || b->flush) ? 0 : 1;
+
+        b->file->fd = c->file.fd;
+        b->file->name = c->file.name;
+        b->file->log = r->connection->log;
+
+        out.buf = b;
+        out.next = NULL;
+
+        ngx_atomic_fetch_add(&ngx_http_file_cache_counters(c->file_cache)->bytes,
+                             c->length - c->streamed);
+
+        c->streamed = c->length;
+
+        rc = ngx_http_output_filter(r, &out);
     }
-}
 
-#endif
+    if (done || rc == NGX_ERROR) {
+        return rc;
+    }
+
+    if (c->waiting) {
+        ngx_add_timer(&c->wait_event, 500);
+    }
 
+    return NGX_DONE;
+}
 
-#if (NGX_THREADS)
 
 static ngx_int_t
-ngx_http_cache_thread_handler(ngx_thread_task_t *task, ngx_file_t *file)
+ngx_http_file_cache_stream(ngx_http_request_t *r)
 {
-    ngx_str_t                  name;
-    ngx_thread_pool_t         *tp;
-    ngx_http_request_t        *r;
+    ngx_int_t                  rc;
+    ngx_event_t               *wev;
     ngx_http_core_loc_conf_t  *clcf;
 
-    r = file->thread_ctx;
+    rc = ngx_http_file_cache_stream_send(r);
 
-    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
-    tp = clcf->thread_pool;
+    if (rc != NGX_DONE) {
+        return rc;
+    }
 
-    if (tp == NULL) {
-        if (ngx_http_complex_value(r, clcf->thread_pool_value, &name)
-            != NGX_OK)
-        {
-            return NGX_ERROR;
-        }
+    r->write_event_handler = ngx_http_file_cache_stream_handler;
 
-        tp = ngx_thread_pool_get((ngx_cycle_t *) ngx_cycle, &name);
+    wev = r->connection->write;
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
-        if (tp == NULL) {
-            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
-                          "thread pool \"%V\" not found", &name);
-            return NGX_ERROR;
+    if (!wev->delayed) {
+        if (wev->active && !wev->ready) {
+            ngx_add_timer(wev, clcf->send_timeout);
+
+        } else if (wev->timer_set) {
+            ngx_del_timer(wev);
         }
     }
 
-    task->event.data = r;
-    task->event.handler = ngx_http_cache_thread_event_handler;
-
-    if (ngx_thread_task_post(tp, task) != NGX_OK) {
+    if (ngx_handle_write_event(wev, clcf->send_lowat) != NGX_OK) {
         return NGX_ERROR;
     }
 
-    ngx_add_timer(&task->event, 60000);
-
-    r->main->blocked++;
-    r->aio = 1;
-
-    return NGX_OK;
+    return NGX_DONE;
 }
 
 
 static void
-ngx_http_cache_thread_event_handler(ngx_event_t *ev)
+ngx_http_file_cache_stream_handler(ngx_http_request_t *r)
 {
-    ngx_connection_t    *c;
-    ngx_http_request_t  *r;
+    ngx_int_t          rc;
+    ngx_event_t       *wev;
+    ngx_connection_t  *c;
 
-    r = ev->data;
     c = r->connection;
-
-    ngx_http_set_log_request(c->log, r);
+    wev = c->write;
 
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "http file cache thread: \"%V?%V\"", &r->uri, &r->args);
+                   "http file cache stream handler: \"%V?%V\"",
+                   &r->uri, &r->args);
 
-    if (ev->timedout) {
-        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
-                      "thread operation took too long");
-        ev->timedout = 0;
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_INFO, c->log, NGX_ETIMEDOUT,
+                      "client timed out");
+        c->timedout = 1;
+
+        ngx_http_finalize_request(r, NGX_HTTP_REQUEST_TIME_OUT);
         return;
     }
 
-    if (ev->timer_set) {
-        ngx_del_timer(ev);
+    rc = ngx_http_file_cache_stream(r);
+
+    if (rc != NGX_DONE) {
+        ngx_http_finalize_request(r, rc);
     }
+}
 
-    r->main->blocked--;
-    r->aio = 0;
 
-    if (r->main->terminated) {
-        /*
-         * trigger connection event handler if the request was
-         * terminated
-         */
+static void
+ngx_http_file_cache_stream_wait_handler(ngx_event_t *ev)
+{
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
 
-        c->write->handler(c->write);
+    r = ev->data;
+    c = r->connection;
 
-    } else {
-        r->write_event_handler(r);
-        ngx_http_run_posted_requests(c);
-    }
-}
+    ngx_http_set_log_request(c->log, r);
 
-#endif
+    ngx_http_file_cache_stream_handler(r);
+    ngx_http_run_posted_requests(c);
+}
 
 
 static ngx_int_t
-ngx_http_file_cache_exists(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
+ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
-    ngx_int_t                    rc;
-    ngx_http_file_cache_node_t  *fcn;
+    u_char                        *p;
+    time_t                         now;
+    ssize_t                        n;
+    ngx_str_t                     *key;
+    ngx_int_t                      rc;
+    ngx_uint_t                     i;
+    ngx_http_file_cache_t         *cache;
+    ngx_http_file_cache_header_t  *h;
 
-    ngx_shmtx_lock(&cache->shpool->mutex);
+    if (c->mem) {
+        n = (ssize_t) c->length;
 
-    fcn = c->node;
+    } else {
+        n = ngx_http_file_cache_aio_read(r, c);
 
-    if (fcn == NULL) {
-        fcn = ngx_http_file_cache_lookup(cache, c->key);
+        if (n < 0) {
+            return n;
+        }
     }
 
-    if (fcn) {
-        ngx_queue_remove(&fcn->queue);
+    if ((size_t) n < c->header_start) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                      "cache file \"%s\" is too small", c->file.name.data);
+        return NGX_DECLINED;
+    }
 
-        if (c->node == NULL) {
-            fcn->uses++;
-            fcn->count++;
-        }
+    h = (ngx_http_file_cache_header_t *) c->buf->pos;
 
-        if (fcn->error) {
+    if (h->version != ngx_http_file_cache_version(c->file_cache)) {
+        ngx_log_error(NGX_LOG_INFO, r->connection->log, 0,
+                      "cache file \"%s\" version mismatch", c->file.name.data);
+        return NGX_DECLINED;
+    }
 
-            if (fcn->valid_sec < ngx_time()) {
-                goto renew;
-            }
+    if (h->crc32 != c->crc32 || (size_t) h->header_start != c->header_start) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                      "cache file \"%s\" has md5 collision", c->file.name.data);
+        return NGX_DECLINED;
+    }
 
-            rc = NGX_OK;
+    p = c->buf->pos + sizeof(ngx_http_file_cache_header_t)
+        + sizeof(ngx_http_file_cache_key);
 
-            goto done;
+    key = c->keys.elts;
+    for (i = 0; i < c->keys.nelts; i++) {
+        if (ngx_memcmp(p, key[i].data, key[i].len) != 0) {
+            ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                          "cache file \"%s\" has md5 collision",
+                          c->file.name.data);
+            return NGX_DECLINED;
         }
 
-        if (fcn->exists || fcn->uses >= c->min_uses) {
-
-            c->exists = fcn->exists;
-            if (fcn->body_start && !c->update_variant) {
-                c->body_start = fcn->body_start;
-            }
+        p += key[i].len;
+    }
 
-            rc = NGX_OK;
+    if ((size_t) h->body_start > c->body_start) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                      "cache file \"%s\" has too long header",
+                      c->file.name.data);
+        return NGX_DECLINED;
+    }
 
-            goto done;
-        }
+    if (h->vary_len > NGX_HTTP_CACHE_VARY_LEN) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                      "cache file \"%s\" has incorrect vary length",
+                      c->file.name.data);
+        return NGX_DECLINED;
+    }
 
-        rc = NGX_AGAIN;
+    if (h->vary_len) {
+        ngx_http_file_cache_vary(r, h->vary, h->vary_len, c->variant);
 
-        goto done;
+        if (ngx_memcmp(c->variant, h->variant, NGX_HTTP_CACHE_KEY_LEN) != 0) {
+            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "http file cache vary mismatch");
+            return ngx_http_file_cache_reopen(r, c);
+        }
     }
 
-    fcn = ngx_slab_calloc_locked(cache->shpool,
-                                 sizeof(ngx_http_file_cache_node_t));
-    if (fcn == NULL) {
-        ngx_http_file_cache_set_watermark(cache);
-
-        ngx_shmtx_unlock(&cache->shpool->mutex);
+    c->buf->last += n;
 
-        (void) ngx_http_file_cache_forced_expire(cache);
+    c->valid_sec = h->valid_sec;
+    c->updating_sec = h->updating_sec;
+    c->error_sec = h->error_sec;
+    c->last_modified = h->last_modified;
+    c->date = h->date;
+    c->valid_msec = h->valid_msec;
+    c->body_start = h->body_start;
+    c->etag.len = h->etag_len;
+    c->etag.data = h->etag;
 
-        ngx_shmtx_lock(&cache->shpool->mutex);
+    r->cached = 1;
 
-        fcn = ngx_slab_calloc_locked(cache->shpool,
-                                     sizeof(ngx_http_file_cache_node_t));
-        if (fcn == NULL) {
-            ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
-                          "could not allocate node%s", cache->shpool->log_ctx);
-            rc = NGX_ERROR;
-            goto failed;
-        }
-    }
+    cache = c->file_cache;
 
-    cache->sh->count++;
+    if (cache->sh->cold && !c->streaming && !c->mem) {
 
-    ngx_memcpy((u_char *) &fcn->node.key, c->key, sizeof(ngx_rbtree_key_t));
+        ngx_shmtx_lock(&cache->shpool->mutex);
 
-    ngx_memcpy(fcn->key, &c->key[sizeof(ngx_rbtree_key_t)],
-               NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+        if (!c->node->exists) {
+            c->node->uses = 1;
+            c->node->body_start = c->body_start;
+            c->node->exists = 1;
+            c->node->uniq = c->uniq;
+            c->node->fs_size = c->fs_size;
 
-    ngx_rbtree_insert(&cache->sh->rbtree, &fcn->node);
+            cache->sh->size += c->fs_size;
+        }
 
-    fcn->uses = 1;
-    fcn->count = 1;
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+    }
 
-renew:
+    if (cache->mem_zone
+        && !c->mem
+        && !c->streaming
+        && (off_t) n == c->length
+        && c->length <= (off_t) cache->mem_max_object)
+    {
+        ngx_http_file_cache_mem_add(r, c);
+    }
 
-    rc = NGX_DECLINED;
+    now = ngx_time();
 
-    fcn->valid_msec = 0;
-    fcn->error = 0;
-    fcn->exists = 0;
-    fcn->valid_sec = 0;
-    fcn->uniq = 0;
-    fcn->body_start = 0;
-    fcn->fs_size = 0;
+    if (c->valid_sec < now) {
+        c->stale_updating = c->valid_sec + c->updating_sec >= now;
+        c->stale_error = c->valid_sec + c->error_sec >= now;
 
-done:
+        ngx_shmtx_lock(&cache->shpool->mutex);
 
-    fcn->expire = ngx_time() + cache->inactive;
+        if (c->node->updating) {
+            rc = NGX_HTTP_CACHE_UPDATING;
 
-    ngx_queue_insert_head(&cache->sh->queue, &fcn->queue);
+        } else {
+            c->node->updating = 1;
+            c->updating = 1;
+            c->lock_time = c->node->lock_time;
+            rc = NGX_HTTP_CACHE_STALE;
+        }
 
-    c->uniq = fcn->uniq;
-    c->error = fcn->error;
-    c->node = fcn;
+        ngx_shmtx_unlock(&cache->shpool->mutex);
 
-failed:
+        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http file cache expired: %i %T %T",
+                       rc, c->valid_sec, now);
 
-    ngx_shmtx_unlock(&cache->shpool->mutex);
+        return rc;
+    }
 
-    return rc;
+    return NGX_OK;
 }
 
 
 static ngx_int_t
-ngx_http_file_cache_name(ngx_http_request_t *r, ngx_path_t *path)
+ngx_http_file_cache_mem_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
-    u_char            *p;
-    ngx_http_cache_t  *c;
+    ngx_http_file_cache_t           *cache;
+    ngx_http_file_cache_mem_node_t  *mn;
 
-    c = r->cache;
+    cache = c->file_cache;
 
-    if (c->file.name.len) {
-        return NGX_OK;
-    }
+    ngx_shmtx_lock(&cache->mem_shpool->mutex);
 
-    c->file.name.len = path->name.len + 1 + path->len
-                       + 2 * NGX_HTTP_CACHE_KEY_LEN;
+    mn = ngx_http_file_cache_mem_lookup(cache, c->key);
 
-    c->file.name.data = ngx_pnalloc(r->pool, c->file.name.len + 1);
-    if (c->file.name.data == NULL) {
+    if (mn == NULL || mn->uniq != c->uniq) {
+        ngx_shmtx_unlock(&cache->mem_shpool->mutex);
+        return NGX_DECLINED;
+    }
+
+    c->buf = ngx_create_temp_buf(r->pool, mn->size);
+    if (c->buf == NULL) {
+        ngx_shmtx_unlock(&cache->mem_shpool->mutex);
         return NGX_ERROR;
     }
 
-    ngx_memcpy(c->file.name.data, path->name.data, path->name.len);
+    ngx_memcpy(c->buf->pos, mn->data, mn->size);
 
-    p = c->file.name.data + path->name.len + 1 + path->len;
-    p = ngx_hex_dump(p, c->key, NGX_HTTP_CACHE_KEY_LEN);
-    *p = '\0';
+    c->length = mn->size;
 
-    ngx_create_hashed_filename(path, c->file.name.data, c->file.name.len);
+    ngx_queue_remove(&mn->queue);
+    ngx_queue_insert_head(&cache->mem_sh->queue, &mn->queue);
+
+    ngx_shmtx_unlock(&cache->mem_shpool->mutex);
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "cache file: \"%s\"", c->file.name.data);
+                   "http file cache mem: %O", c->length);
+
+    c->mem = 1;
 
     return NGX_OK;
 }
 
 
-static ngx_http_file_cache_node_t *
-ngx_http_file_cache_lookup(ngx_http_file_cache_t *cache, u_char *key)
+static void
+ngx_http_file_cache_mem_add(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
-    ngx_int_t                    rc;
-    ngx_rbtree_key_t             node_key;
-    ngx_rbtree_node_t           *node, *sentinel;
-    ngx_http_file_cache_node_t  *fcn;
+    size_t                           size, len;
+    uint32_t                         hash;
+    ngx_uint_t                       tries;
+    ngx_queue_t                     *q;
+    ngx_http_file_cache_t           *cache;
+    ngx_http_file_cache_mem_node_t  *mn;
 
-    ngx_memcpy((u_char *) &node_key, key, sizeof(ngx_rbtree_key_t));
+    cache = c->file_cache;
 
-    node = cache->sh->rbtree.root;
-    sentinel = cache->sh->rbtree.sentinel;
+    size = (size_t) c->length;
+    len = offsetof(ngx_http_file_cache_mem_node_t, data) + size;
 
-    while (node != sentinel) {
+    ngx_shmtx_lock(&cache->mem_shpool->mutex);
 
-        if (node_key < node->key) {
-            node = node->left;
-            continue;
-        }
+    mn = ngx_http_file_cache_mem_lookup(cache, c->key);
 
-        if (node_key > node->key) {
-            node = node->right;
-            continue;
+    if (mn) {
+        if (mn->uniq == c->uniq) {
+            ngx_shmtx_unlock(&cache->mem_shpool->mutex);
+            return;
         }
 
-        /* node_key == node->key */
-
-        fcn = (ngx_http_file_cache_node_t *) node;
+        ngx_http_file_cache_mem_free(cache, mn);
+    }
 
-        rc = ngx_memcmp(&key[sizeof(ngx_rbtree_key_t)], fcn->key,
-                        NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+    for (tries = 0; /* void */ ; tries++) {
 
-        if (rc == 0) {
-            return fcn;
+        mn = ngx_slab_alloc_locked(cache->mem_shpool, len);
+        if (mn) {
+            break;
         }
 
-        node = (rc < 0) ? node->left : node->right;
+        if (tries == 16 || ngx_queue_empty(&cache->mem_sh->queue)) {
+            ngx_shmtx_unlock(&cache->mem_shpool->mutex);
+
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "http file cache mem no memory for %uz", size);
+            return;
+        }
+
+        /* evict the least recently used object */
+
+        q = ngx_queue_last(&cache->mem_sh->queue);
+        mn = ngx_queue_data(q, ngx_http_file_cache_mem_node_t, queue);
+
+        ngx_http_file_cache_mem_free(cache, mn);
     }
 
-    /* not found */
+    ngx_memcpy(mn->key, c->key, NGX_HTTP_CACHE_KEY_LEN);
+    ngx_memcpy(&hash, c->key, sizeof(uint32_t));
 
-    return NULL;
+    mn->sn.node.key = hash;
+    mn->sn.str.len = NGX_HTTP_CACHE_KEY_LEN;
+    mn->sn.str.data = mn->key;
+
+    mn->uniq = c->uniq;
+    mn->size = size;
+
+    ngx_memcpy(mn->data, c->buf->pos, size);
+
+    ngx_rbtree_insert(&cache->mem_sh->rbtree, &mn->sn.node);
+    ngx_queue_insert_head(&cache->mem_sh->queue, &mn->queue);
+
+    ngx_shmtx_unlock(&cache->mem_shpool->mutex);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache mem add: %uz", size);
 }
 
 
 static void
-ngx_http_file_cache_rbtree_insert_value(ngx_rbtree_node_t *temp,
-    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
+ngx_http_file_cache_mem_update(ngx_http_cache_t *c,
+    ngx_http_file_cache_header_t *h)
 {
-    ngx_rbtree_node_t           **p;
-    ngx_http_file_cache_node_t   *cn, *cnt;
+    ngx_http_file_cache_t           *cache;
+    ngx_http_file_cache_mem_node_t  *mn;
 
-    for ( ;; ) {
+    cache = c->file_cache;
 
-        if (node->key < temp->key) {
+    ngx_shmtx_lock(&cache->mem_shpool->mutex);
 
-            p = &temp->left;
+    mn = ngx_http_file_cache_mem_lookup(cache, c->key);
 
-        } else if (node->key > temp->key) {
+    if (mn && mn->uniq == c->uniq) {
+        ngx_memcpy(mn->data, h, sizeof(ngx_http_file_cache_header_t));
+    }
 
-            p = &temp->right;
+    ngx_shmtx_unlock(&cache->mem_shpool->mutex);
+}
 
-        } else { /* node->key == temp->key */
 
-            cn = (ngx_http_file_cache_node_t *) node;
-            cnt = (ngx_http_file_cache_node_t *) temp;
+static void
+ngx_http_file_cache_mem_delete(ngx_http_file_cache_t *cache, u_char *key)
+{
+    ngx_http_file_cache_mem_node_t  *mn;
 
-            p = (ngx_memcmp(cn->key, cnt->key,
-                            NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t))
-                 < 0)
-                    ? &temp->left : &temp->right;
-        }
+    ngx_shmtx_lock(&cache->mem_shpool->mutex);
 
-        if (*p == sentinel) {
-            break;
-        }
+    mn = ngx_http_file_cache_mem_lookup(cache, key);
 
-        temp = *p;
+    if (mn) {
+        ngx_http_file_cache_mem_free(cache, mn);
     }
 
-    *p = node;
-    node->parent = temp;
-    node->left = sentinel;
-    node->right = sentinel;
-    ngx_rbt_red(node);
+    ngx_shmtx_unlock(&cache->mem_shpool->mutex);
 }
 
 
-static void
-ngx_http_file_cache_vary(ngx_http_request_t *r, u_char *vary, size_t len,
-    u_char *hash)
+static ngx_http_file_cache_mem_node_t *
+ngx_http_file_cache_mem_lookup(ngx_http_file_cache_t *cache, u_char *key)
 {
-    u_char     *p, *last;
-    ngx_str_t   name;
-    ngx_md5_t   md5;
-    u_char      buf[NGX_HTTP_CACHE_VARY_LEN];
+    uint32_t   hash;
+    ngx_str_t  name;
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http file cache vary: \"%*s\"", len, vary);
+    name.len = NGX_HTTP_CACHE_KEY_LEN;
+    name.data = key;
 
-    ngx_md5_init(&md5);
-    ngx_md5_update(&md5, r->cache->main, NGX_HTTP_CACHE_KEY_LEN);
+    ngx_memcpy(&hash, key, sizeof(uint32_t));
 
-    ngx_strlow(buf, vary, len);
+    return (ngx_http_file_cache_mem_node_t *)
+               ngx_str_rbtree_lookup(&cache->mem_sh->rbtree, &name, hash);
+}
 
-    p = buf;
-    last = buf + len;
 
-    while (p < last) {
+static void
+ngx_http_file_cache_mem_free(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_mem_node_t *mn)
+{
+    ngx_rbtree_delete(&cache->mem_sh->rbtree, &mn->sn.node);
+    ngx_queue_remove(&mn->queue);
+    ngx_slab_free_locked(cache->mem_shpool, mn);
+}
 
-        while (p < last && (*p == ' ' || *p == ',')) { p++; }
 
-        name.data = p;
+static ssize_t
+ngx_http_file_cache_aio_read(ngx_http_request_t *r, ngx_http_cache_t *c)
+{
+    size_t                     size;
+#if (NGX_HAVE_FILE_AIO || NGX_THREADS)
+    ssize_t                    n;
+    ngx_http_core_loc_conf_t  *clcf;
 
-        while (p < last && *p != ',' && *p != ' ') { p++; }
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+#endif
 
-        name.len = p - name.data;
+    size = c->buf->end - c->buf->pos;
 
-        if (name.len == 0) {
-            break;
+#if (NGX_HAVE_FILE_AIO)
+
+    if (clcf->aio == NGX_HTTP_AIO_ON && ngx_file_aio) {
+        n = ngx_file_aio_read(&c->file, c->buf->pos, size, 0, r->pool);
+
+        if (n != NGX_AGAIN) {
+            c->reading = 0;
+            return n;
         }
 
-        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "http file cache vary: %V", &name);
+        c->reading = 1;
 
-        ngx_md5_update(&md5, name.data, name.len);
-        ngx_md5_update(&md5, (u_char *) ":", sizeof(":") - 1);
+        c->file.aio->data = r;
+        c->file.aio->handler = ngx_http_cache_aio_event_handler;
 
-        ngx_http_file_cache_vary_header(r, &md5, &name);
+        ngx_add_timer(&c->file.aio->event, 60000);
 
-        ngx_md5_update(&md5, (u_char *) CRLF, sizeof(CRLF) - 1);
+        r->main->blocked++;
+        r->aio = 1;
+
+        return NGX_AGAIN;
     }
 
-    ngx_md5_final(hash, &md5);
+#endif
+
+#if (NGX_THREADS)
+
+    if (clcf->aio == NGX_HTTP_AIO_THREADS) {
+        c->file.thread_task = c->thread_task;
+        c->file.thread_handler = ngx_http_cache_thread_handler;
+        c->file.thread_ctx = r;
+
+        n = ngx_thread_read(&c->file, c->buf->pos, size, 0, r->pool);
+
+        c->thread_task = c->file.thread_task;
+        c->reading = (n == NGX_AGAIN);
+
+        return n;
+    }
+
+#endif
+
+    return ngx_read_file(&c->file, c->buf->pos, size, 0);
 }
 
 
+#if (NGX_HAVE_FILE_AIO)
+
 static void
-ngx_http_file_cache_vary_header(ngx_http_request_t *r, ngx_md5_t *md5,
-    ngx_str_t *name)
+ngx_http_cache_aio_event_handler(ngx_event_t *ev)
 {
-    size_t            len;
-    u_char           *p, *start, *last;
-    ngx_uint_t        i, multiple, normalize;
-    ngx_list_part_t  *part;
-    ngx_table_elt_t  *header;
+    ngx_event_aio_t     *aio;
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
 
-    multiple = 0;
-    normalize = 0;
+    aio = ev->data;
+    r = aio->data;
+    c = r->connection;
 
-    if (name->len == sizeof("Accept-Charset") - 1
-        && ngx_strncasecmp(name->data, (u_char *) "Accept-Charset",
-                           sizeof("Accept-Charset") - 1) == 0)
-    {
-        normalize = 1;
+    ngx_http_set_log_request(c->log, r);
 
-    } else if (name->len == sizeof("Accept-Encoding") - 1
-        && ngx_strncasecmp(name->data, (u_char *) "Accept-Encoding",
-                           sizeof("Accept-Encoding") - 1) == 0)
-    {
-        normalize = 1;
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http file cache aio: \"%V?%V\"", &r->uri, &r->args);
 
-    } else if (name->len == sizeof("Accept-Language") - 1
-        && ngx_strncasecmp(name->data, (u_char *) "Accept-Language",
-                           sizeof("Accept-Language") - 1) == 0)
-    {
-        normalize = 1;
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
+                      "aio operation took too long");
+        ev->timedout = 0;
+        return;
     }
 
-    part = &r->headers_in.headers.part;
-    header = part->elts;
+    if (ev->timer_set) {
+        ngx_del_timer(ev);
+    }
 
-    for (i = 0; /* void */ ; i++) {
+    r->main->blocked--;
+    r->aio = 0;
 
-        if (i >= part->nelts) {
-            if (part->next == NULL) {
-                break;
-            }
+    if (r->main->terminated) {
+        /*
+         * trigger connection event handler if the request was
+         * terminated
+         */
 
-            part = part->next;
-            header = part->elts;
-            i = 0;
-        }
+        c->write->handler(c->write);
 
-        if (header[i].hash == 0) {
-            continue;
-        }
+    } else {
+        r->write_event_handler(r);
+        ngx_http_run_posted_requests(c);
+    }
+}
 
-        if (header[i].key.len != name->len) {
-            continue;
+#endif
+
+
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_http_cache_thread_handler(ngx_thread_task_t *task, ngx_file_t *file)
+{
+    ngx_str_t                  name;
+    ngx_thread_pool_t         *tp;
+    ngx_http_request_t        *r;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    r = file->thread_ctx;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+    tp = clcf->thread_pool;
+
+    if (tp == NULL) {
+        if (ngx_http_complex_value(r, clcf->thread_pool_value, &name)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
         }
 
-        if (ngx_strncasecmp(header[i].key.data, name->data, name->len) != 0) {
-            continue;
+        tp = ngx_thread_pool_get((ngx_cycle_t *) ngx_cycle, &name);
+
+        if (tp == NULL) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "thread pool \"%V\" not found", &name);
+            return NGX_ERROR;
         }
+    }
 
-        if (!normalize) {
+    task->event.data = r;
+    task->event.handler = ngx_http_cache_thread_event_handler;
 
-            if (multiple) {
-                ngx_md5_update(md5, (u_char *) ",", sizeof(",") - 1);
-            }
+    if (ngx_thread_task_post(tp, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
 
-            ngx_md5_update(md5, header[i].value.data, header[i].value.len);
+    ngx_add_timer(&task->event, 60000);
 
-            multiple = 1;
+    r->main->blocked++;
+    r->aio = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_cache_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
+
+    r = ev->data;
+    c = r->connection;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http file cache thread: \"%V?%V\"", &r->uri, &r->args);
+
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
+                      "thread operation took too long");
+        ev->timedout = 0;
+        return;
+    }
+
+    if (ev->timer_set) {
+        ngx_del_timer(ev);
+    }
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    if (r->main->terminated) {
+        /*
+         * trigger connection event handler if the request was
+         * terminated
+         */
+
+        c->write->handler(c->write);
+
+    } else {
+        r->write_event_handler(r);
+        ngx_http_run_posted_requests(c);
+    }
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_http_file_cache_exists(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
+{
+    ngx_int_t                    rc;
+    ngx_http_file_cache_node_t  *fcn;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    fcn = c->node;
+
+    if (fcn == NULL) {
+        fcn = ngx_http_file_cache_lookup(cache, c->key);
+
+        if (cache->admission) {
+            ngx_http_file_cache_sketch_add(cache->sh, c->key);
+        }
+    }
+
+    if (fcn) {
+        ngx_queue_remove(&fcn->queue);
+
+        if (c->node == NULL) {
+            fcn->uses++;
+            fcn->count++;
+        }
+
+        if (fcn->error) {
+
+            if (fcn->valid_sec < ngx_time()) {
+                goto renew;
+            }
+
+            rc = NGX_OK;
+
+            goto done;
+        }
+
+        if (fcn->exists || fcn->uses >= c->min_uses) {
+
+            if (fcn->exists) {
+
+                /* the second hit promotes an entry to the frequent segment */
+
+                if (cache->slru && !fcn->frequent) {
+                    fcn->frequent = 1;
+                    cache->sh->frequent_count++;
+                }
+
+            } else if (!fcn->updating && !ngx_http_file_cache_admit(cache, c))
+            {
+                rc = NGX_AGAIN;
+                goto done;
+            }
+
+            /* a purged entry is counted until its file is replaced */
+
+            c->exists = fcn->exists && !fcn->purged;
+            if (fcn->body_start && !c->update_variant) {
+                c->body_start = fcn->body_start;
+            }
+
+            rc = NGX_OK;
+
+            goto done;
+        }
+
+        rc = NGX_AGAIN;
+
+        goto done;
+    }
+
+    fcn = ngx_slab_calloc_locked(cache->shpool,
+                                 sizeof(ngx_http_file_cache_node_t));
+    if (fcn == NULL) {
+        ngx_http_file_cache_set_watermark(cache);
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        (void) ngx_http_file_cache_forced_expire(cache);
+
+        ngx_shmtx_lock(&cache->shpool->mutex);
+
+        fcn = ngx_slab_calloc_locked(cache->shpool,
+                                     sizeof(ngx_http_file_cache_node_t));
+        if (fcn == NULL) {
+            ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                          "could not allocate node%s", cache->shpool->log_ctx);
+            rc = NGX_ERROR;
+            goto failed;
+        }
+    }
+
+    cache->sh->count++;
+
+    ngx_memcpy((u_char *) &fcn->node.key, c->key, sizeof(ngx_rbtree_key_t));
+
+    ngx_memcpy(fcn->key, &c->key[sizeof(ngx_rbtree_key_t)],
+               NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+    ngx_rbtree_insert(&cache->sh->rbtree, &fcn->node);
+
+    fcn->uses = 1;
+    fcn->count = 1;
+
+renew:
+
+    rc = NGX_DECLINED;
+
+    fcn->valid_msec = 0;
+    fcn->error = 0;
+    fcn->exists = 0;
+    fcn->valid_sec = 0;
+    fcn->uniq = 0;
+    fcn->body_start = 0;
+    fcn->fs_size = 0;
+
+    if (fcn->frequent) {
+        fcn->frequent = 0;
+        cache->sh->frequent_count--;
+    }
+
+    if (!ngx_http_file_cache_admit(cache, c)) {
+        rc = NGX_AGAIN;
+    }
+
+done:
+
+    fcn->expire = ngx_time() + cache->inactive;
+
+    ngx_queue_insert_head(ngx_http_file_cache_queue(cache, fcn), &fcn->queue);
+
+    c->uniq = fcn->uniq;
+    c->error = fcn->error;
+    c->node = fcn;
+
+failed:
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_name(ngx_http_request_t *r, ngx_path_t *path)
+{
+    u_char            *p;
+    ngx_http_cache_t  *c;
+
+    c = r->cache;
+
+    if (c->file.name.len) {
+        return NGX_OK;
+    }
+
+    c->file.name.len = path->name.len + 1 + path->len
+                       + 2 * NGX_HTTP_CACHE_KEY_LEN;
+
+    c->file.name.data = ngx_pnalloc(r->pool, c->file.name.len + 1);
+    if (c->file.name.data == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(c->file.name.data, path->name.data, path->name.len);
+
+    p = c->file.name.data + path->name.len + 1 + path->len;
+    p = ngx_hex_dump(p, c->key, NGX_HTTP_CACHE_KEY_LEN);
+    *p = '\0';
+
+    ngx_create_hashed_filename(path, c->file.name.data, c->file.name.len);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "cache file: \"%s\"", c->file.name.data);
+
+    return NGX_OK;
+}
+
+
+static ngx_http_file_cache_node_t *
+ngx_http_file_cache_lookup(ngx_http_file_cache_t *cache, u_char *key)
+{
+    ngx_int_t                    rc;
+    ngx_rbtree_key_t             node_key;
+    ngx_rbtree_node_t           *node, *sentinel;
+    ngx_http_file_cache_node_t  *fcn;
+
+    ngx_memcpy((u_char *) &node_key, key, sizeof(ngx_rbtree_key_t));
+
+    node = cache->sh->rbtree.root;
+    sentinel = cache->sh->rbtree.sentinel;
+
+    while (node != sentinel) {
+
+        if (node_key < node->key) {
+            node = node->left;
+            continue;
+        }
+
+        if (node_key > node->key) {
+            node = node->right;
+            continue;
+        }
+
+        /* node_key == node->key */
+
+        fcn = (ngx_http_file_cache_node_t *) node;
+
+        rc = ngx_memcmp(&key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                        NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+        if (rc == 0) {
+            return fcn;
+        }
+
+        node = (rc < 0) ? node->left : node->right;
+    }
+
+    /* not found */
+
+    return NULL;
+}
+
+
+static void
+ngx_http_file_cache_rbtree_insert_value(ngx_rbtree_node_t *temp,
+    ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
+{
+    ngx_rbtree_node_t           **p;
+    ngx_http_file_cache_node_t   *cn, *cnt;
+
+    for ( ;; ) {
+
+        if (node->key < temp->key) {
+
+            p = &temp->left;
+
+        } else if (node->key > temp->key) {
+
+            p = &temp->right;
+
+        } else { /* node->key == temp->key */
+
+            cn = (ngx_http_file_cache_node_t *) node;
+            cnt = (ngx_http_file_cache_node_t *) temp;
+
+            p = (ngx_memcmp(cn->key, cnt->key,
+                            NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t))
+                 < 0)
+                    ? &temp->left : &temp->right;
+        }
+
+        if (*p == sentinel) {
+            break;
+        }
+
+        temp = *p;
+    }
+
+    *p = node;
+    node->parent = temp;
+    node->left = sentinel;
+    node->right = sentinel;
+    ngx_rbt_red(node);
+}
+
+
+static void
+ngx_http_file_cache_vary(ngx_http_request_t *r, u_char *vary, size_t len,
+    u_char *hash)
+{
+    u_char     *p, *last;
+    ngx_str_t   name;
+    ngx_md5_t   md5;
+    u_char      buf[NGX_HTTP_CACHE_VARY_LEN];
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache vary: \"%*s\"", len, vary);
+
+    ngx_md5_init(&md5);
+    ngx_md5_update(&md5, r->cache->main, NGX_HTTP_CACHE_KEY_LEN);
+
+    ngx_strlow(buf, vary, len);
+
+    p = buf;
+    last = buf + len;
+
+    while (p < last) {
+
+        while (p < last && (*p == ' ' || *p == ',')) { p++; }
+
+        name.data = p;
+
+        while (p < last && *p != ',' && *p != ' ') { p++; }
+
+        name.len = p - name.data;
+
+        if (name.len == 0) {
+            break;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http file cache vary: %V", &name);
+
+        ngx_md5_update(&md5, name.data, name.len);
+        ngx_md5_update(&md5, (u_char *) ":", sizeof(":") - 1);
+
+        ngx_http_file_cache_vary_header(r, &md5, &name);
+
+        ngx_md5_update(&md5, (u_char *) CRLF, sizeof(CRLF) - 1);
+    }
+
+    ngx_md5_final(hash, &md5);
+}
+
+
+static void
+ngx_http_file_cache_vary_header(ngx_http_request_t *r, ngx_md5_t *md5,
+    ngx_str_t *name)
+{
+    size_t            len;
+    u_char           *p, *start, *last;
+    ngx_uint_t        i, multiple, normalize;
+    ngx_list_part_t  *part;
+    ngx_table_elt_t  *header;
+
+    multiple = 0;
+    normalize = 0;
+
+    if (name->len == sizeof("Accept-Charset") - 1
+        && ngx_strncasecmp(name->data, (u_char *) "Accept-Charset",
+                           sizeof("Accept-Charset") - 1) == 0)
+    {
+        normalize = 1;
+
+    } else if (name->len == sizeof("Accept-Encoding") - 1
+        && ngx_strncasecmp(name->data, (u_char *) "Accept-Encoding",
+                           sizeof("Accept-Encoding") - 1) == 0)
+    {
+        normalize = 1;
+
+    } else if (name->len == sizeof("Accept-Language") - 1
+        && ngx_strncasecmp(name->data, (u_char *) "Accept-Language",
+                           sizeof("Accept-Language") - 1) == 0)
+    {
+        normalize = 1;
+    }
+
+    part = &r->headers_in.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        if (header[i].key.len != name->len) {
+            continue;
+        }
+
+        if (ngx_strncasecmp(header[i].key.data, name->data, name->len) != 0) {
+            continue;
+        }
+
+        if (!normalize) {
+
+            if (multiple) {
+                ngx_md5_update(md5, (u_char *) ",", sizeof(",") - 1);
+            }
+
+            ngx_md5_update(md5, header[i].value.data, header[i].value.len);
+
+            multiple = 1;
+
+            continue;
+        }
+
+        /* normalize spaces */
+
+        p = header[i].value.data;
+        last = p + header[i].value.len;
+
+        while (p < last) {
+
+            while (p < last && (*p == ' ' || *p == ',')) { p++; }
+
+            start = p;
+
+            while (p < last && *p != ',' && *p != ' ') { p++; }
+
+            len = p - start;
+
+            if (len == 0) {
+                break;
+            }
+
+            if (multiple) {
+                ngx_md5_update(md5, (u_char *) ",", sizeof(",") - 1);
+            }
+
+            ngx_md5_update(md5, start, len);
+
+            multiple = 1;
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_reopen(ngx_http_request_t *r, ngx_http_cache_t *c)
+{
+    ngx_http_file_cache_t  *cache;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
+                   "http file cache reopen");
+
+    if (c->secondary) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                      "cache file \"%s\" has incorrect vary hash",
+                      c->file.name.data);
+        return NGX_DECLINED;
+    }
+
+    cache = c->file_cache;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    c->node->count--;
+    c->node = NULL;
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    c->secondary = 1;
+    c->file.name.len = 0;
+    c->body_start = c->buffer_size;
+
+    ngx_memcpy(c->key, c->variant, NGX_HTTP_CACHE_KEY_LEN);
+
+    return ngx_http_file_cache_open(r);
+}
+
+
+ngx_int_t
+ngx_http_file_cache_set_header(ngx_http_request_t *r, u_char *buf)
+{
+    ngx_http_file_cache_header_t  *h = (ngx_http_file_cache_header_t *) buf;
+
+    u_char            *p;
+    ngx_str_t         *key;
+    ngx_uint_t         i;
+    ngx_http_cache_t  *c;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache set header");
+
+    c = r->cache;
+
+    ngx_memzero(h, sizeof(ngx_http_file_cache_header_t));
+
+    h->version = ngx_http_file_cache_version(c->file_cache);
+    h->valid_sec = c->valid_sec;
+    h->updating_sec = c->updating_sec;
+    h->error_sec = c->error_sec;
+    h->last_modified = c->last_modified;
+    h->date = c->date;
+    h->crc32 = c->crc32;
+    h->valid_msec = (u_short) c->valid_msec;
+    h->header_start = (u_short) c->header_start;
+    h->body_start = (u_short) c->body_start;
+
+    if (c->etag.len <= NGX_HTTP_CACHE_ETAG_LEN) {
+        h->etag_len = (u_char) c->etag.len;
+        ngx_memcpy(h->etag, c->etag.data, c->etag.len);
+    }
+
+    if (c->vary.len) {
+        if (c->vary.len > NGX_HTTP_CACHE_VARY_LEN) {
+            /* should not happen */
+            c->vary.len = NGX_HTTP_CACHE_VARY_LEN;
+        }
+
+        h->vary_len = (u_char) c->vary.len;
+        ngx_memcpy(h->vary, c->vary.data, c->vary.len);
+
+        ngx_http_file_cache_vary(r, c->vary.data, c->vary.len, c->variant);
+        ngx_memcpy(h->variant, c->variant, NGX_HTTP_CACHE_KEY_LEN);
+    }
+
+    if (ngx_http_file_cache_update_variant(r, c) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    p = buf + sizeof(ngx_http_file_cache_header_t);
+
+    p = ngx_cpymem(p, ngx_http_file_cache_key, sizeof(ngx_http_file_cache_key));
+
+    key = c->keys.elts;
+    for (i = 0; i < c->keys.nelts; i++) {
+        p = ngx_copy(p, key[i].data, key[i].len);
+    }
+
+    *p = LF;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_update_variant(ngx_http_request_t *r, ngx_http_cache_t *c)
+{
+    uintptr_t               waiters;
+    ngx_uint_t              wakeup;
+    ngx_http_file_cache_t  *cache;
+
+    if (!c->secondary) {
+        return NGX_OK;
+    }
+
+    if (c->vary.len
+        && ngx_memcmp(c->variant, c->key, NGX_HTTP_CACHE_KEY_LEN) == 0)
+    {
+        return NGX_OK;
+    }
+
+    /*
+     * if the variant hash doesn't match one we used as a secondary
+     * cache key, switch back to the original key
+     */
+
+    cache = c->file_cache;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache main key");
+
+    waiters = 0;
+    wakeup = 0;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    c->node->count--;
+    c->node->updating = 0;
+
+    if (c->node->waiting) {
+        c->node->waiting = 0;
+        waiters = cache->sh->waiters;
+        wakeup = 1;
+    }
+
+    c->node = NULL;
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    if (wakeup) {
+        ngx_http_file_cache_wakeup(cache, waiters);
+    }
+
+    c->file.name.len = 0;
+    c->update_variant = 1;
+
+    ngx_memcpy(c->key, c->main, NGX_HTTP_CACHE_KEY_LEN);
+
+    c->file_cache = ngx_http_file_cache_shard(cache, c->key);
+    cache = c->file_cache;
+
+    if (ngx_http_file_cache_exists(cache, c) == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_http_file_cache_name(r, cache->path) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+void
+ngx_http_file_cache_update(ngx_http_request_t *r, ngx_temp_file_t *tf)
+{
+    off_t                   fs_size;
+    uintptr_t               waiters;
+    ngx_int_t               rc;
+    ngx_uint_t              wakeup;
+    ngx_file_uniq_t         uniq;
+    ngx_file_info_t         fi;
+    ngx_http_cache_t        *c;
+    ngx_ext_rename_file_t   ext;
+    ngx_http_file_cache_t  *cache;
+
+    c = r->cache;
+
+    if (c->updated) {
+        return;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache update");
+
+    cache = c->file_cache;
+
+    c->updated = 1;
+    c->updating = 0;
+
+    uniq = 0;
+    fs_size = 0;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache rename: \"%s\" to \"%s\"",
+                   tf->file.name.data, c->file.name.data);
+
+    ext.access = NGX_FILE_OWNER_ACCESS;
+    ext.path_access = NGX_FILE_OWNER_ACCESS;
+    ext.time = -1;
+    ext.create_path = 1;
+    ext.delete_file = 1;
+    ext.log = r->connection->log;
+
+    rc = ngx_ext_rename_file(&tf->file.name, &c->file.name, &ext);
+
+    if (rc == NGX_OK) {
+
+        if (ngx_fd_info(tf->file.fd, &fi) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_CRIT, r->connection->log, ngx_errno,
+                          ngx_fd_info_n " \"%s\" failed", tf->file.name.data);
+
+            rc = NGX_ERROR;
+
+        } else {
+            uniq = ngx_file_uniq(&fi);
+            fs_size = (ngx_file_fs_size(&fi) + cache->bsize - 1) / cache->bsize;
+        }
+    }
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    c->node->count--;
+    c->node->error = 0;
+    c->node->uniq = uniq;
+    c->node->body_start = c->body_start;
+
+    cache->sh->size += fs_size - c->node->fs_size;
+    c->node->fs_size = fs_size;
+
+    if (rc == NGX_OK) {
+        c->node->exists = 1;
+        c->node->purged = 0;
+
+        if (c->tags.len && !c->node->tagged) {
+            ngx_http_file_cache_tag(cache, c);
+        }
+    }
+
+    c->node->updating = 0;
+
+    waiters = 0;
+    wakeup = 0;
+
+    if (c->node->waiting) {
+        c->node->waiting = 0;
+        waiters = cache->sh->waiters;
+        wakeup = 1;
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    if (cache->mem_zone) {
+        ngx_http_file_cache_mem_delete(cache, c->key);
+    }
+
+    if (wakeup) {
+        ngx_http_file_cache_wakeup(cache, waiters);
+    }
+}
+
+
+void
+ngx_http_file_cache_update_header(ngx_http_request_t *r)
+{
+    ssize_t                        n;
+    ngx_err_t                      err;
+    ngx_file_t                     file;
+    ngx_file_info_t                fi;
+    ngx_http_cache_t              *c;
+    ngx_http_file_cache_header_t   h;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache update header");
+
+    c = r->cache;
+
+    ngx_memzero(&file, sizeof(ngx_file_t));
+
+    file.name = c->file.name;
+    file.log = r->connection->log;
+    file.fd = ngx_open_file(file.name.data, NGX_FILE_RDWR, NGX_FILE_OPEN, 0);
+
+    if (file.fd == NGX_INVALID_FILE) {
+        err = ngx_errno;
+
+        /* cache file may have been deleted */
+
+        if (err == NGX_ENOENT) {
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "http file cache \"%s\" not found",
+                           file.name.data);
+            return;
+        }
+
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, err,
+                      ngx_open_file_n " \"%s\" failed", file.name.data);
+        return;
+    }
+
+    /*
+     * make sure cache file wasn't replaced;
+     * if it was, do nothing
+     */
+
+    if (ngx_fd_info(file.fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", file.name.data);
+        goto done;
+    }
+
+    if (c->uniq != ngx_file_uniq(&fi)
+        || c->length != ngx_file_size(&fi))
+    {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http file cache \"%s\" changed",
+                       file.name.data);
+        goto done;
+    }
+
+    n = ngx_read_file(&file, (u_char *) &h,
+                      sizeof(ngx_http_file_cache_header_t), 0);
+
+    if (n == NGX_ERROR) {
+        goto done;
+    }
+
+    if ((size_t) n != sizeof(ngx_http_file_cache_header_t)) {
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
+                      ngx_read_file_n " read only %z of %z from \"%s\"",
+                      n, sizeof(ngx_http_file_cache_header_t), file.name.data);
+        goto done;
+    }
+
+    if (h.version != ngx_http_file_cache_version(c->file_cache)
+        || h.last_modified != c->last_modified
+        || h.crc32 != c->crc32
+        || (size_t) h.header_start != c->header_start
+        || (size_t) h.body_start != c->body_start)
+    {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http file cache \"%s\" content changed",
+                       file.name.data);
+        goto done;
+    }
+
+    /*
+     * update cache file header with new data,
+     * notably h.valid_sec and h.date
+     */
+
+    ngx_memzero(&h, sizeof(ngx_http_file_cache_header_t));
+
+    h.version = ngx_http_file_cache_version(c->file_cache);
+    h.valid_sec = c->valid_sec;
+    h.updating_sec = c->updating_sec;
+    h.error_sec = c->error_sec;
+    h.last_modified = c->last_modified;
+    h.date = c->date;
+    h.crc32 = c->crc32;
+    h.valid_msec = (u_short) c->valid_msec;
+    h.header_start = (u_short) c->header_start;
+    h.body_start = (u_short) c->body_start;
+
+    if (c->etag.len <= NGX_HTTP_CACHE_ETAG_LEN) {
+        h.etag_len = (u_char) c->etag.len;
+        ngx_memcpy(h.etag, c->etag.data, c->etag.len);
+    }
+
+    if (c->vary.len) {
+        if (c->vary.len > NGX_HTTP_CACHE_VARY_LEN) {
+            /* should not happen */
+            c->vary.len = NGX_HTTP_CACHE_VARY_LEN;
+        }
+
+        h.vary_len = (u_char) c->vary.len;
+        ngx_memcpy(h.vary, c->vary.data, c->vary.len);
+
+        ngx_http_file_cache_vary(r, c->vary.data, c->vary.len, c->variant);
+        ngx_memcpy(h.variant, c->variant, NGX_HTTP_CACHE_KEY_LEN);
+    }
+
+    n = ngx_write_file(&file, (u_char *) &h,
+                       sizeof(ngx_http_file_cache_header_t), 0);
+
+    if (n != NGX_ERROR && c->file_cache->mem_zone) {
+        ngx_http_file_cache_mem_update(c, &h);
+    }
+
+done:
+
+    if (ngx_close_file(file.fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, r->connection->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", file.name.data);
+    }
+}
+
+
+ngx_int_t
+ngx_http_cache_send(ngx_http_request_t *r)
+{
+    ngx_int_t          rc;
+    ngx_buf_t         *b;
+    ngx_chain_t        out;
+    ngx_http_cache_t  *c;
+
+    c = r->cache;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache send: %s", c->file.name.data);
+
+    /* we need to allocate all before the header would be sent */
+
+    b = ngx_calloc_buf(r->pool);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t));
+    if (b->file == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    if (c->streaming) {
+        c->streamed = c->body_start;
+        return ngx_http_file_cache_stream(r);
+    }
+
+    ngx_atomic_fetch_add(&ngx_http_file_cache_counters(c->file_cache)->bytes,
+                         c->length - c->body_start);
+
+    if (c->mem) {
+        b->pos = c->buf->pos + c->body_start;
+        b->last = c->buf->pos + c->length;
+
+        b->memory = (c->length - c->body_start) ? 1 : 0;
+
+    } else {
+        b->file_pos = c->body_start;
+        b->file_last = c->length;
+
+        b->in_file = (c->length - c->body_start) ? 1 : 0;
+
+        b->file->fd = c->file.fd;
+        b->file->name = c->file.name;
+        b->file->log = r->connection->log;
+    }
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+    b->sync = (b->last_buf || b->in_file || b->memory) ? 0 : 1;
+
+    out.buf = b;
+    out.next = NULL;
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+void
+ngx_http_file_cache_free(ngx_http_cache_t *c, ngx_temp_file_t *tf)
+{
+    uintptr_t                    waiters;
+    ngx_uint_t                   wakeup;
+    ngx_http_file_cache_t       *cache;
+    ngx_http_file_cache_node_t  *fcn;
+
+    if (c->waiting) {
+        ngx_http_file_cache_wait_done(c);
+        c->waiting = 0;
+    }
+
+    if (c->updated || c->node == NULL) {
+        return;
+    }
+
+    cache = c->file_cache;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
+                   "http file cache free, fd: %d", c->file.fd);
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    fcn = c->node;
+    fcn->count--;
+
+    waiters = 0;
+    wakeup = 0;
+
+    if (c->updating && fcn->lock_time == c->lock_time) {
+        fcn->updating = 0;
+
+        if (fcn->waiting) {
+            fcn->waiting = 0;
+            waiters = cache->sh->waiters;
+            wakeup = 1;
+        }
+    }
+
+    if (c->error) {
+        fcn->error = c->error;
+
+        if (c->valid_sec) {
+            fcn->valid_sec = c->valid_sec;
+            fcn->valid_msec = c->valid_msec;
+        }
+
+    } else if (!fcn->exists && fcn->count == 0 && c->min_uses == 1) {
+        ngx_queue_remove(&fcn->queue);
+
+        if (fcn->frequent) {
+            cache->sh->frequent_count--;
+        }
+
+        ngx_rbtree_delete(&cache->sh->rbtree, &fcn->node);
+        ngx_slab_free_locked(cache->shpool, fcn);
+        cache->sh->count--;
+        c->node = NULL;
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    c->updated = 1;
+    c->updating = 0;
+
+    if (wakeup) {
+        ngx_http_file_cache_wakeup(cache, waiters);
+    }
+
+    if (c->temp_file) {
+        if (tf && tf->file.fd != NGX_INVALID_FILE) {
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
+                           "http file cache incomplete: \"%s\"",
+                           tf->file.name.data);
+
+            if (ngx_delete_file(tf->file.name.data) == NGX_FILE_ERROR) {
+                ngx_log_error(NGX_LOG_CRIT, c->file.log, ngx_errno,
+                              ngx_delete_file_n " \"%s\" failed",
+                              tf->file.name.data);
+            }
+        }
+    }
+
+    if (c->wait_event.timer_set) {
+        ngx_del_timer(&c->wait_event);
+    }
+}
+
+
+static void
+ngx_http_file_cache_cleanup(void *data)
+{
+    ngx_http_cache_t  *c = data;
+
+    if (c->updated) {
+        return;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
+                   "http file cache cleanup");
+
+    if (c->updating && !c->background) {
+        ngx_log_error(NGX_LOG_ALERT, c->file.log, 0,
+                      "stalled cache updating, error:%ui", c->error);
+    }
+
+    ngx_http_file_cache_free(c, NULL);
+}
+
+
+static time_t
+ngx_http_file_cache_forced_expire(ngx_http_file_cache_t *cache)
+{
+    u_char                      *name, *p;
+    size_t                       len;
+    time_t                       wait;
+    ngx_uint_t                   tries;
+    ngx_path_t                  *path;
+    ngx_queue_t                 *q, *queue, *sentinel;
+    ngx_http_file_cache_node_t  *fcn;
+    u_char                       key[2 * NGX_HTTP_CACHE_KEY_LEN];
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache forced expire");
+
+    path = cache->path;
+    len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
+
+    name = ngx_alloc(len + 1, ngx_cycle->log);
+    if (name == NULL) {
+        return 10;
+    }
+
+    ngx_memcpy(name, path->name.data, path->name.len);
+
+    wait = 10;
+    tries = 20;
+    sentinel = NULL;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    for ( ;; ) {
+        queue = ngx_http_file_cache_victim(cache);
+
+        if (ngx_queue_empty(queue)) {
+            break;
+        }
+
+        q = ngx_queue_last(queue);
+
+        if (q == sentinel) {
+            break;
+        }
+
+        fcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
+
+        ngx_log_debug6(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                  "http file cache forced expire: #%d %d %02xd%02xd%02xd%02xd",
+                  fcn->count, fcn->exists,
+                  fcn->key[0], fcn->key[1], fcn->key[2], fcn->key[3]);
+
+        if (fcn->count == 0) {
+            ngx_http_file_cache_delete(cache, q, name);
+            wait = 0;
+            break;
+        }
+
+        if (fcn->deleting) {
+            wait = 1;
+            break;
+        }
+
+        p = ngx_hex_dump(key, (u_char *) &fcn->node.key,
+                         sizeof(ngx_rbtree_key_t));
+        len = NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t);
+        (void) ngx_hex_dump(p, fcn->key, len);
+
+        /*
+         * abnormally exited workers may leave locked cache entries,
+         * and although it may be safe to remove them completely,
+         * we prefer to just move them to the top of the inactive queue
+         */
+
+        ngx_queue_remove(q);
+        fcn->expire = ngx_time() + cache->inactive;
+        ngx_queue_insert_head(queue, &fcn->queue);
+
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                      "ignore long locked inactive cache entry %*s, count:%d",
+                      (size_t) 2 * NGX_HTTP_CACHE_KEY_LEN, key, fcn->count);
+
+        if (sentinel == NULL) {
+            sentinel = q;
+        }
+
+        if (--tries) {
+            continue;
+        }
+
+        wait = 1;
+        break;
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    ngx_free(name);
+
+    return wait;
+}
+
+
+static time_t
+ngx_http_file_cache_expire(ngx_http_file_cache_t *cache)
+{
+    u_char                      *name, *p;
+    size_t                       len;
+    time_t                       now, wait;
+    ngx_path_t                  *path;
+    ngx_msec_t                   elapsed;
+    ngx_queue_t                 *q, *queue;
+    ngx_http_file_cache_node_t  *fcn;
+    u_char                       key[2 * NGX_HTTP_CACHE_KEY_LEN];
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache expire");
+
+    path = cache->path;
+    len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
+
+    name = ngx_alloc(len + 1, ngx_cycle->log);
+    if (name == NULL) {
+        return 10;
+    }
+
+    ngx_memcpy(name, path->name.data, path->name.len);
+
+    now = ngx_time();
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    for ( ;; ) {
+
+        if (ngx_quit || ngx_terminate) {
+            wait = 1;
+            break;
+        }
+
+        queue = ngx_http_file_cache_oldest(cache);
+
+        if (ngx_queue_empty(queue)) {
+            wait = 10;
+            break;
+        }
+
+        q = ngx_queue_last(queue);
+
+        fcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
+
+        wait = fcn->expire - now;
+
+        if (wait > 0) {
+            wait = wait > 10 ? 10 : wait;
+            break;
+        }
+
+        ngx_log_debug6(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                       "http file cache expire: #%d %d %02xd%02xd%02xd%02xd",
+                       fcn->count, fcn->exists,
+                       fcn->key[0], fcn->key[1], fcn->key[2], fcn->key[3]);
+
+        if (fcn->count == 0) {
+            ngx_http_file_cache_delete(cache, q, name);
+            goto next;
+        }
+
+        if (fcn->deleting) {
+            wait = 1;
+            break;
+        }
+
+        p = ngx_hex_dump(key, (u_char *) &fcn->node.key,
+                         sizeof(ngx_rbtree_key_t));
+        len = NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t);
+        (void) ngx_hex_dump(p, fcn->key, len);
+
+        /*
+         * abnormally exited workers may leave locked cache entries,
+         * and although it may be safe to remove them completely,
+         * we prefer to just move them to the top of the inactive queue
+         */
+
+        ngx_queue_remove(q);
+        fcn->expire = ngx_time() + cache->inactive;
+        ngx_queue_insert_head(queue, &fcn->queue);
+
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                      "ignore long locked inactive cache entry %*s, count:%d",
+                      (size_t) 2 * NGX_HTTP_CACHE_KEY_LEN, key, fcn->count);
+
+next:
+
+        if (++cache->files >= cache->manager_files) {
+            wait = 0;
+            break;
+        }
+
+        ngx_time_update();
+
+        elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
+
+        if (elapsed >= cache->manager_threshold) {
+            wait = 0;
+            break;
+        }
+    }
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    ngx_free(name);
+
+    return wait;
+}
+
+
+static void
+ngx_http_file_cache_delete(ngx_http_file_cache_t *cache, ngx_queue_t *q,
+    u_char *name)
+{
+    u_char                      *p;
+    size_t                       len;
+    ngx_err_t                    err;
+    ngx_path_t                  *path;
+    ngx_http_file_cache_node_t  *fcn;
+    u_char                       key[NGX_HTTP_CACHE_KEY_LEN];
+
+    fcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
+
+    if (fcn->exists) {
+        cache->sh->size -= fcn->fs_size;
+
+        path = cache->path;
+        p = name + path->name.len + 1 + path->len;
+        p = ngx_hex_dump(p, (u_char *) &fcn->node.key,
+                         sizeof(ngx_rbtree_key_t));
+        len = NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t);
+        p = ngx_hex_dump(p, fcn->key, len);
+        *p = '\0';
+
+        fcn->count++;
+        fcn->deleting = 1;
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        if (cache->mem_zone) {
+            ngx_memcpy(key, &fcn->node.key, sizeof(ngx_rbtree_key_t));
+            ngx_memcpy(&key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                       NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+            ngx_http_file_cache_mem_delete(cache, key);
+        }
+
+        len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
+        ngx_create_hashed_filename(path, name, len);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                       "http file cache expire: \"%s\"", name);
+
+        if (ngx_delete_file(name) == NGX_FILE_ERROR) {
+            err = ngx_errno;
+
+            /* files removed after the index was written are in the index */
+
+            if (err != NGX_ENOENT || cache->index == NULL) {
+                ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, err,
+                              ngx_delete_file_n " \"%s\" failed", name);
+            }
+        }
+
+        ngx_shmtx_lock(&cache->shpool->mutex);
+        fcn->count--;
+        fcn->deleting = 0;
+    }
+
+    if (fcn->count == 0) {
+        ngx_queue_remove(q);
+
+        if (fcn->frequent) {
+            cache->sh->frequent_count--;
+        }
+
+        ngx_rbtree_delete(&cache->sh->rbtree, &fcn->node);
+        ngx_slab_free_locked(cache->shpool, fcn);
+        cache->sh->count--;
+    }
+}
+
+
+static ngx_msec_t
+ngx_http_file_cache_manager(void *data)
+{
+    ngx_http_file_cache_t  *cache = data;
+
+    ngx_uint_t  i;
+    ngx_msec_t  next, n;
+
+    if (cache->shards == NULL) {
+        return ngx_http_file_cache_manage(cache);
+    }
+
+    next = 60 * 60 * 1000;
+
+    for (i = 0; i < cache->nshards; i++) {
+        n = ngx_http_file_cache_manage(cache->shards[i]);
+
+        next = ngx_min(next, n);
+
+        ngx_time_update();
+    }
+
+    return next;
+}
+
+
+static ngx_msec_t
+ngx_http_file_cache_manage(ngx_http_file_cache_t *cache)
+{
+    off_t       size, free;
+    time_t      wait;
+    ngx_msec_t  elapsed, next;
+    ngx_uint_t  count, watermark, purge;
+
+    cache->last = ngx_current_msec;
+    cache->files = 0;
+
+    cache->sh->manager = ngx_process_slot;
+
+    /* the purged entries are deleted as expired */
+
+    purge = 0;
+
+    if (!ngx_queue_empty(&cache->sh->purges)) {
+        purge = (ngx_http_file_cache_purge_process(cache) == NGX_AGAIN);
+    }
+
+    next = (ngx_msec_t) ngx_http_file_cache_expire(cache) * 1000;
+
+    if (next == 0) {
+        next = cache->manager_sleep;
+        goto done;
+    }
+
+    for ( ;; ) {
+        ngx_shmtx_lock(&cache->shpool->mutex);
+
+        size = cache->sh->size;
+        count = cache->sh->count;
+        watermark = cache->sh->watermark;
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                       "http file cache size: %O c:%ui w:%i",
+                       size, count, (ngx_int_t) watermark);
+
+        if (size < cache->max_size && count < watermark) {
+
+            if (!cache->min_free) {
+                break;
+            }
+
+            free = ngx_fs_available(cache->path->name.data);
+
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                           "http file cache free: %O", free);
+
+            if (free > cache->min_free) {
+                break;
+            }
+        }
+
+        wait = ngx_http_file_cache_forced_expire(cache);
+
+        if (wait > 0) {
+            next = (ngx_msec_t) wait * 1000;
+            break;
+        }
+
+        if (ngx_quit || ngx_terminate) {
+            break;
+        }
+
+        if (++cache->files >= cache->manager_files) {
+            next = cache->manager_sleep;
+            break;
+        }
+
+        ngx_time_update();
+
+        elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
+
+        if (elapsed >= cache->manager_threshold) {
+            next = cache->manager_sleep;
+            break;
+        }
+    }
+
+done:
+
+    if (purge) {
+        next = ngx_min(next, cache->manager_sleep);
+    }
+
+    ngx_http_file_cache_tags_sweep(cache);
+
+    if (cache->index && ngx_http_file_cache_index_write(cache) == NGX_AGAIN) {
+        next = ngx_min(next, cache->manager_sleep);
+    }
+
+    elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache manager: %ui e:%M n:%M",
+                   cache->files, elapsed, next);
+
+    return next;
+}
+
+
+static void
+ngx_http_file_cache_loader(void *data)
+{
+    ngx_http_file_cache_t  *cache = data;
+
+    off_t            size;
+    ngx_uint_t       i, cold;
+    ngx_tree_ctx_t   tree;
+    ngx_file_info_t  fi;
+
+    cold = cache->sh->cold;
+
+    for (i = 1; i < cache->nshards; i++) {
+        cold |= cache->shards[i]->sh->cold;
+    }
+
+    if (!cold || cache->sh->loading) {
+        return;
+    }
+
+    if (!ngx_atomic_cmp_set(&cache->sh->loading, 0, ngx_pid)) {
+        return;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache loader");
+
+    if (cache->index) {
+        cache->index->loaded = 0;
+
+        if (ngx_http_file_cache_index_load(cache) == NGX_ABORT) {
+            cache->sh->loading = 0;
+            return;
+        }
+
+        /* without levels, the cache directory itself is checked */
+
+        if (cache->index->loaded
+            && cache->path->len == 0
+            && ngx_file_info(cache->path->name.data, &fi) != NGX_FILE_ERROR
+            && ngx_file_mtime(&fi) < cache->index->loaded)
+        {
+            goto done;
+        }
+    }
+
+    tree.init_handler = NULL;
+    tree.file_handler = ngx_http_file_cache_manage_file;
+    tree.pre_tree_handler = ngx_http_file_cache_manage_directory;
+    tree.post_tree_handler = ngx_http_file_cache_noop;
+    tree.spec_handler = ngx_http_file_cache_delete_file;
+    tree.data = cache;
+    tree.alloc = 0;
+    tree.log = ngx_cycle->log;
+
+    cache->last = ngx_current_msec;
+    cache->files = 0;
+
+    if (ngx_walk_tree(&tree, &cache->path->name) == NGX_ABORT) {
+        cache->sh->loading = 0;
+        return;
+    }
+
+done:
+
+    size = cache->sh->size;
+
+    for (i = 1; i < cache->nshards; i++) {
+        cache->shards[i]->sh->cold = 0;
+        size += cache->shards[i]->sh->size;
+    }
+
+    cache->sh->cold = 0;
+    cache->sh->loading = 0;
+
+    ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
+                  "http file cache: %V %.3fM, bsize: %uz",
+                  &cache->path->name,
+                  ((double) size * cache->bsize) / (1024 * 1024),
+                  cache->bsize);
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_index_write(ngx_http_file_cache_t *cache)
+{
+    ssize_t                             n;
+    ngx_msec_t                          start, elapsed;
+    ngx_uint_t                          i;
+    ngx_rbtree_node_t                  *node, *last;
+    ngx_http_file_cache_node_t         *fcn;
+    ngx_http_file_cache_index_t        *index;
+    ngx_http_file_cache_index_entry_t  *entry;
+    ngx_http_file_cache_index_entry_t   entries[NGX_HTTP_CACHE_INDEX_ENTRIES];
+
+    index = cache->index;
+
+    if (index->file.fd == NGX_INVALID_FILE) {
+
+        if (cache->sh->cold || ngx_time() < index->next) {
+            return NGX_OK;
+        }
+
+        if (ngx_http_file_cache_index_open(cache) != NGX_OK) {
+            return NGX_OK;
+        }
+    }
+
+    start = ngx_current_msec;
+
+    for ( ;; ) {
+
+        /*
+         * the nodes are written in the tree order, so the nodes added
+         * or removed while the manager sleeps do not break the walk
+         */
+
+        ngx_shmtx_lock(&cache->shpool->mutex);
+
+        node = ngx_http_file_cache_next(cache,
+                                        index->walked ? index->key : NULL);
+        last = NULL;
+
+        for (i = 0;
+             node && i < NGX_HTTP_CACHE_INDEX_ENTRIES;
+             node = ngx_rbtree_next(&cache->sh->rbtree, node))
+        {
+            last = node;
+            index->walked++;
+
+            fcn = (ngx_http_file_cache_node_t *) node;
+
+            if (!fcn->exists || fcn->deleting || fcn->purged) {
+                continue;
+            }
+
+            entry = &entries[i++];
+
+            ngx_memcpy(entry->key, &fcn->node.key, sizeof(ngx_rbtree_key_t));
+            ngx_memcpy(&entry->key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                       NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+            entry->fs_size = fcn->fs_size;
+            entry->expire = fcn->expire;
+            entry->uses = fcn->uses;
+        }
+
+        if (last) {
+            fcn = (ngx_http_file_cache_node_t *) last;
+
+            ngx_memcpy(index->key, &fcn->node.key, sizeof(ngx_rbtree_key_t));
+            ngx_memcpy(&index->key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                       NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+        }
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        if (i) {
+            n = ngx_write_file(&index->file, (u_char *) entries,
+                               i * sizeof(ngx_http_file_cache_index_entry_t),
+                               index->file.offset);
+
+            if (n == NGX_ERROR) {
+                ngx_http_file_cache_index_close(cache, 0);
+                return NGX_OK;
+            }
+
+            index->count += i;
+        }
+
+        if (node == NULL) {
+            ngx_http_file_cache_index_close(cache, 1);
+            return NGX_OK;
+        }
+
+        if (ngx_quit || ngx_terminate) {
+            ngx_http_file_cache_index_close(cache, 0);
+            return NGX_OK;
+        }
+
+        ngx_time_update();
+
+        elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - start));
+
+        if (elapsed >= cache->manager_threshold) {
+            return NGX_AGAIN;
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_index_open(ngx_http_file_cache_t *cache)
+{
+    ngx_http_file_cache_index_t  *index;
+
+    index = cache->index;
+
+    index->file.name = index->temp;
+    index->file.log = ngx_cycle->log;
+    index->file.offset = 0;
+
+    index->file.fd = ngx_open_file(index->temp.data, NGX_FILE_WRONLY,
+                                   NGX_FILE_TRUNCATE, NGX_FILE_DEFAULT_ACCESS);
+
+    if (index->file.fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", index->temp.data);
+
+        index->next = ngx_time() + index->interval;
+
+        return NGX_ERROR;
+    }
+
+    /*
+     * the directories changed since the index was started are walked
+     * by the loader, the margin covers cache files being renamed
+     */
+
+    index->time = ngx_time() - NGX_HTTP_CACHE_INDEX_MARGIN;
+    index->count = 0;
+    index->walked = 0;
+
+    /* the header is written when the index is complete */
+
+    index->file.offset = sizeof(ngx_http_file_cache_index_header_t);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache index: \"%s\"", index->temp.data);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_file_cache_index_close(ngx_http_file_cache_t *cache,
+    ngx_uint_t complete)
+{
+    ssize_t                              n;
+    ngx_http_file_cache_index_t         *index;
+    ngx_http_file_cache_index_header_t   h;
+
+    index = cache->index;
+
+    index->next = ngx_time() + index->interval;
+
+    if (complete) {
+        ngx_memzero(&h, sizeof(ngx_http_file_cache_index_header_t));
+
+        h.version = NGX_HTTP_CACHE_INDEX_VERSION;
+        h.entry_size = sizeof(ngx_http_file_cache_index_entry_t);
+        h.crc32 = ngx_http_file_cache_index_crc32(cache);
+        h.time = index->time;
+        h.bsize = cache->bsize;
+        h.count = index->count;
+
+        n = ngx_write_file(&index->file, (u_char *) &h,
+                           sizeof(ngx_http_file_cache_index_header_t), 0);
+
+        if (n == NGX_ERROR) {
+            complete = 0;
+        }
+    }
+
+    if (ngx_close_file(index->file.fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", index->temp.data);
+        complete = 0;
+    }
+
+    index->file.fd = NGX_INVALID_FILE;
+
+    if (complete) {
+        if (ngx_rename_file(index->temp.data, index->name.data)
+            != NGX_FILE_ERROR)
+        {
+            ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
+                          "http file cache: %V index %ui entries",
+                          &cache->path->name, index->count);
+            return;
+        }
+
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_rename_file_n " \"%s\" to \"%s\" failed",
+                      index->temp.data, index->name.data);
+    }
+
+    if (ngx_delete_file(index->temp.data) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_delete_file_n " \"%s\" failed", index->temp.data);
+    }
+}
+
+
+static ngx_rbtree_node_t *
+ngx_http_file_cache_next(ngx_http_file_cache_t *cache, u_char *key)
+{
+    ngx_int_t                    rc;
+    ngx_rbtree_key_t             node_key;
+    ngx_rbtree_node_t           *node, *sentinel, *next;
+    ngx_http_file_cache_node_t  *fcn;
+
+    node = cache->sh->rbtree.root;
+    sentinel = cache->sh->rbtree.sentinel;
+
+    if (node == sentinel) {
+        return NULL;
+    }
+
+    if (key == NULL) {
+        return ngx_rbtree_min(node, sentinel);
+    }
+
+    /* the first node following the last one walked */
+
+    ngx_memcpy((u_char *) &node_key, key, sizeof(ngx_rbtree_key_t));
+
+    next = NULL;
+
+    while (node != sentinel) {
+
+        if (node->key != node_key) {
+            rc = (node->key < node_key) ? -1 : 1;
+
+        } else {
+            fcn = (ngx_http_file_cache_node_t *) node;
+
+            rc = ngx_memcmp(fcn->key, &key[sizeof(ngx_rbtree_key_t)],
+                            NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+        }
+
+        if (rc > 0) {
+            next = node;
+            node = node->left;
+
+        } else {
+            node = node->right;
+        }
+    }
+
+    return next;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_index_load(ngx_http_file_cache_t *cache)
+{
+    off_t                                offset, size;
+    time_t                               now, expire;
+    ssize_t                              n;
+    ngx_int_t                            rc;
+    ngx_err_t                            err;
+    ngx_uint_t                           i, count, loaded;
+    ngx_file_t                           file;
+    ngx_file_info_t                      fi;
+    ngx_http_file_cache_node_t          *fcn;
+    ngx_http_file_cache_index_t         *index;
+    ngx_http_file_cache_index_entry_t   *entry;
+    ngx_http_file_cache_index_header_t   h;
+    ngx_http_file_cache_index_entry_t    entries[NGX_HTTP_CACHE_INDEX_ENTRIES];
+
+    index = cache->index;
+
+    ngx_memzero(&file, sizeof(ngx_file_t));
+
+    file.name = index->name;
+    file.log = ngx_cycle->log;
+
+    file.fd = ngx_open_file(file.name.data, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (file.fd == NGX_INVALID_FILE) {
+        err = ngx_errno;
+
+        if (err != NGX_ENOENT) {
+            ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, err,
+                          ngx_open_file_n " \"%s\" failed", file.name.data);
+        }
+
+        return NGX_DECLINED;
+    }
+
+    rc = NGX_DECLINED;
+
+    if (ngx_fd_info(file.fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", file.name.data);
+        goto done;
+    }
+
+    n = ngx_read_file(&file, (u_char *) &h,
+                      sizeof(ngx_http_file_cache_index_header_t), 0);
+
+    if (n == NGX_ERROR) {
+        goto done;
+    }
+
+    size = ngx_file_size(&fi);
+
+    if ((size_t) n != sizeof(ngx_http_file_cache_index_header_t)
+        || h.version != NGX_HTTP_CACHE_INDEX_VERSION
+        || h.entry_size != sizeof(ngx_http_file_cache_index_entry_t)
+        || h.crc32 != ngx_http_file_cache_index_crc32(cache)
+        || h.bsize != cache->bsize
+        || size != (off_t) (sizeof(ngx_http_file_cache_index_header_t)
+                            + h.count
+                              * sizeof(ngx_http_file_cache_index_entry_t)))
+    {
+        ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, 0,
+                      "cache index \"%s\" is invalid, ignored",
+                      file.name.data);
+        goto done;
+    }
+
+    offset = sizeof(ngx_http_file_cache_index_header_t);
+    loaded = 0;
+
+    while (offset < size) {
+
+        if (ngx_quit || ngx_terminate) {
+            rc = NGX_ABORT;
+            goto done;
+        }
+
+        n = ngx_read_file(&file, (u_char *) entries,
+                          ngx_min((size_t) (size - offset), sizeof(entries)),
+                          offset);
+
+        if (n == NGX_ERROR) {
+            goto done;
+        }
+
+        count = n / sizeof(ngx_http_file_cache_index_entry_t);
+
+        if (count == 0) {
+            goto done;
+        }
+
+        offset += count * sizeof(ngx_http_file_cache_index_entry_t);
+
+        now = ngx_time();
+
+        ngx_shmtx_lock(&cache->shpool->mutex);
+
+        for (i = 0; i < count; i++) {
+            entry = &entries[i];
+
+            fcn = ngx_http_file_cache_lookup(cache, entry->key);
+
+            if (fcn) {
+                continue;
+            }
+
+            fcn = ngx_slab_calloc_locked(cache->shpool,
+                                         sizeof(ngx_http_file_cache_node_t));
+            if (fcn == NULL) {
+                ngx_http_file_cache_set_watermark(cache);
+
+                ngx_shmtx_unlock(&cache->shpool->mutex);
+
+                ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                              "could not allocate node%s",
+                              cache->shpool->log_ctx);
+                goto done;
+            }
+
+            cache->sh->count++;
+
+            ngx_memcpy((u_char *) &fcn->node.key, entry->key,
+                       sizeof(ngx_rbtree_key_t));
+
+            ngx_memcpy(fcn->key, &entry->key[sizeof(ngx_rbtree_key_t)],
+                       NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+            ngx_rbtree_insert(&cache->sh->rbtree, &fcn->node);
+
+            fcn->uses = ngx_min(entry->uses, 1023);
+            fcn->exists = 1;
+            fcn->fs_size = entry->fs_size;
+
+            expire = now + cache->inactive;
+            fcn->expire = ngx_min(entry->expire, expire);
+
+            ngx_queue_insert_head(&cache->sh->queue, &fcn->queue);
+
+            cache->sh->size += entry->fs_size;
+
+            loaded++;
+        }
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+    }
+
+    index->loaded = h.time;
+    rc = NGX_OK;
+
+    ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
+                  "http file cache: %V index %ui entries, %ui loaded",
+                  &cache->path->name, h.count, loaded);
+
+done:
+
+    if (ngx_close_file(file.fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", file.name.data);
+    }
+
+    return rc;
+}
+
+
+static uint32_t
+ngx_http_file_cache_index_crc32(ngx_http_file_cache_t *cache)
+{
+    uint32_t  crc;
+
+    ngx_crc32_init(crc);
+    ngx_crc32_update(&crc, cache->path->name.data, cache->path->name.len);
+    ngx_crc32_update(&crc, (u_char *) cache->path->level,
+                     NGX_MAX_PATH_LEVEL * sizeof(size_t));
+    ngx_crc32_final(crc);
+
+    return crc;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_noop(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+{
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_manage_file(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+{
+    ngx_msec_t              elapsed;
+    ngx_http_file_cache_t  *cache;
+
+    cache = ctx->data;
+
+    if (cache->index
+        && ((path->len == cache->index->name.len
+             && ngx_strcmp(path->data, cache->index->name.data) == 0)
+            || (path->len == cache->index->temp.len
+                && ngx_strcmp(path->data, cache->index->temp.data) == 0)))
+    {
+        return NGX_OK;
+    }
+
+    if (ngx_http_file_cache_add_file(ctx, path) != NGX_OK) {
+        (void) ngx_http_file_cache_delete_file(ctx, path);
+    }
+
+    if (++cache->files >= cache->loader_files) {
+        ngx_http_file_cache_loader_sleep(cache);
+
+    } else {
+        ngx_time_update();
+
+        elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                       "http file cache loader time elapsed: %M", elapsed);
+
+        if (elapsed >= cache->loader_threshold) {
+            ngx_http_file_cache_loader_sleep(cache);
+        }
+    }
+
+    return (ngx_quit || ngx_terminate) ? NGX_ABORT : NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_manage_directory(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+{
+    ngx_http_file_cache_t  *cache;
+
+    if (path->len >= 5
+        && ngx_strncmp(path->data + path->len - 5, "/temp", 5) == 0)
+    {
+        return NGX_DECLINED;
+    }
+
+    cache = ctx->data;
+
+    /* the files of directories not changed since the index are loaded */
+
+    if (cache->index
+        && cache->index->loaded
+        && path->len == cache->path->name.len + cache->path->len
+        && ctx->mtime < cache->index->loaded)
+    {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ctx->log, 0,
+                       "http file cache indexed: \"%s\"", path->data);
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_file_cache_loader_sleep(ngx_http_file_cache_t *cache)
+{
+    ngx_msleep(cache->loader_sleep);
+
+    ngx_time_update();
+
+    cache->last = ngx_current_msec;
+    cache->files = 0;
+}
+
+
+static ngx_int_t
+ngx_http_file_cache_add_file(ngx_tree_ctx_t *ctx, ngx_str_t *name)
+{
+    u_char                 *p;
+    ngx_int_t               n;
+    ngx_uint_t              i;
+    ngx_http_cache_t        c;
+    ngx_http_file_cache_t  *cache;
+
+    if (name->len < 2 * NGX_HTTP_CACHE_KEY_LEN) {
+        return NGX_ERROR;
+    }
 
-            continue;
-        }
+    /*
+     * Temporary files in cache have a suffix consisting of a dot
+     * followed by 10 digits.
+     */
 
-        /* normalize spaces */
+    if (name->len >= 2 * NGX_HTTP_CACHE_KEY_LEN + 1 + 10
+        && name->data[name->len - 10 - 1] == '.')
+    {
+        return NGX_OK;
+    }
 
-        p = header[i].value.data;
-        last = p + header[i].value.len;
+    if (ctx->size < (off_t) sizeof(ngx_http_file_cache_header_t)) {
+        ngx_log_error(NGX_LOG_CRIT, ctx->log, 0,
+                      "cache file \"%s\" is too small", name->data);
+        return NGX_ERROR;
+    }
 
-        while (p < last) {
+    ngx_memzero(&c, sizeof(ngx_http_cache_t));
+    cache = ctx->data;
 
-            while (p < last && (*p == ' ' || *p == ',')) { p++; }
+    c.length = ctx->size;
+    c.fs_size = (ctx->fs_size + cache->bsize - 1) / cache->bsize;
 
-            start = p;
+    p = &name->data[name->len - 2 * NGX_HTTP_CACHE_KEY_LEN];
 
-            while (p < last && *p != ',' && *p != ' ') { p++; }
+    for (i = 0; i < NGX_HTTP_CACHE_KEY_LEN; i++) {
+        n = ngx_hextoi(p, 2);
 
-            len = p - start;
+        if (n == NGX_ERROR) {
+            return NGX_ERROR;
+        }
 
-            if (len == 0) {
-                break;
-            }
+        p += 2;
 
-            if (multiple) {
-                ngx_md5_update(md5, (u_char *) ",", sizeof(",") - 1);
-            }
+        c.key[i] = (u_char) n;
+    }
 
-            ngx_md5_update(md5, start, len);
+    cache = ngx_http_file_cache_shard(cache, c.key);
 
-            multiple = 1;
-        }
-    }
+    return ngx_http_file_cache_add(cache, &c);
 }
 
 
 static ngx_int_t
-ngx_http_file_cache_reopen(ngx_http_request_t *r, ngx_http_cache_t *c)
+ngx_http_file_cache_add(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
 {
-    ngx_http_file_cache_t  *cache;
+    ngx_http_file_cache_node_t  *fcn;
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
-                   "http file cache reopen");
+    ngx_shmtx_lock(&cache->shpool->mutex);
 
-    if (c->secondary) {
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
-                      "cache file \"%s\" has incorrect vary hash",
-                      c->file.name.data);
-        return NGX_DECLINED;
-    }
+    fcn = ngx_http_file_cache_lookup(cache, c->key);
 
-    cache = c->file_cache;
+    if (fcn == NULL) {
 
-    ngx_shmtx_lock(&cache->shpool->mutex);
+        fcn = ngx_slab_calloc_locked(cache->shpool,
+                                     sizeof(ngx_http_file_cache_node_t));
+        if (fcn == NULL) {
+            ngx_http_file_cache_set_watermark(cache);
 
-    c->node->count--;
-    c->node = NULL;
+            if (cache->fail_time != ngx_time()) {
+                cache->fail_time = ngx_time();
+                ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                           "could not allocate node%s", cache->shpool->log_ctx);
+            }
 
-    ngx_shmtx_unlock(&cache->shpool->mutex);
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+            return NGX_ERROR;
+        }
 
-    c->secondary = 1;
-    c->file.name.len = 0;
-    c->body_start = c->buffer_size;
+        cache->sh->count++;
 
-    ngx_memcpy(c->key, c->variant, NGX_HTTP_CACHE_KEY_LEN);
+        ngx_memcpy((u_char *) &fcn->node.key, c->key, sizeof(ngx_rbtree_key_t));
 
-    return ngx_http_file_cache_open(r);
-}
+        ngx_memcpy(fcn->key, &c->key[sizeof(ngx_rbtree_key_t)],
+                   NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
 
+        ngx_rbtree_insert(&cache->sh->rbtree, &fcn->node);
 
-ngx_int_t
-ngx_http_file_cache_set_header(ngx_http_request_t *r, u_char *buf)
-{
-    ngx_http_file_cache_header_t  *h = (ngx_http_file_cache_header_t *) buf;
+        fcn->uses = 1;
+        fcn->exists = 1;
+        fcn->fs_size = c->fs_size;
 
-    u_char            *p;
-    ngx_str_t         *key;
-    ngx_uint_t         i;
-    ngx_http_cache_t  *c;
+        cache->sh->size += c->fs_size;
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http file cache set header");
+    } else {
+        ngx_queue_remove(&fcn->queue);
+    }
 
-    c = r->cache;
+    fcn->expire = ngx_time() + cache->inactive;
 
-    ngx_memzero(h, sizeof(ngx_http_file_cache_header_t));
+    ngx_queue_insert_head(ngx_http_file_cache_queue(cache, fcn), &fcn->queue);
 
-    h->version = NGX_HTTP_CACHE_VERSION;
-    h->valid_sec = c->valid_sec;
-    h->updating_sec = c->updating_sec;
-    h->error_sec = c->error_sec;
-    h->last_modified = c->last_modified;
-    h->date = c->date;
-    h->crc32 = c->crc32;
-    h->valid_msec = (u_short) c->valid_msec;
-    h->header_start = (u_short) c->header_start;
-    h->body_start = (u_short) c->body_start;
+    ngx_shmtx_unlock(&cache->shpool->mutex);
 
-    if (c->etag.len <= NGX_HTTP_CACHE_ETAG_LEN) {
-        h->etag_len = (u_char) c->etag.len;
-        ngx_memcpy(h->etag, c->etag.data, c->etag.len);
-    }
+    return NGX_OK;
+}
 
-    if (c->vary.len) {
-        if (c->vary.len > NGX_HTTP_CACHE_VARY_LEN) {
-            /* should not happen */
-            c->vary.len = NGX_HTTP_CACHE_VARY_LEN;
-        }
 
-        h->vary_len = (u_char) c->vary.len;
-        ngx_memcpy(h->vary, c->vary.data, c->vary.len);
+static ngx_int_t
+ngx_http_file_cache_delete_file(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+{
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ctx->log, 0,
+                   "http file cache delete: \"%s\"", path->data);
 
-        ngx_http_file_cache_vary(r, c->vary.data, c->vary.len, c->variant);
-        ngx_memcpy(h->variant, c->variant, NGX_HTTP_CACHE_KEY_LEN);
+    if (ngx_delete_file(path->data) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, ctx->log, ngx_errno,
+                      ngx_delete_file_n " \"%s\" failed", path->data);
     }
 
-    if (ngx_http_file_cache_update_variant(r, c) != NGX_OK) {
-        return NGX_ERROR;
-    }
+    return NGX_OK;
+}
 
-    p = buf + sizeof(ngx_http_file_cache_header_t);
 
-    p = ngx_cpymem(p, ngx_http_file_cache_key, sizeof(ngx_http_file_cache_key));
+static void
+ngx_http_file_cache_set_watermark(ngx_http_file_cache_t *cache)
+{
+    cache->sh->watermark = cache->sh->count - cache->sh->count / 8;
 
-    key = c->keys.elts;
-    for (i = 0; i < c->keys.nelts; i++) {
-        p = ngx_copy(p, key[i].data, key[i].len);
-    }
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache watermark: %ui", cache->sh->watermark);
+}
 
-    *p = LF;
 
-    return NGX_OK;
+static ngx_http_file_cache_t *
+ngx_http_file_cache_shard(ngx_http_file_cache_t *cache, u_char *key)
+{
+    if (cache->shards == NULL) {
+        return cache;
+    }
+
+    return cache->shards[key[NGX_HTTP_CACHE_KEY_LEN - 1] % cache->nshards];
 }
 
 
-static ngx_int_t
-ngx_http_file_cache_update_variant(ngx_http_request_t *r, ngx_http_cache_t *c)
+static ngx_queue_t *
+ngx_http_file_cache_queue(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_node_t *fcn)
 {
-    ngx_http_file_cache_t  *cache;
+    return fcn->frequent ? &cache->sh->frequent : &cache->sh->queue;
+}
 
-    if (!c->secondary) {
-        return NGX_OK;
-    }
 
-    if (c->vary.len
-        && ngx_memcmp(c->variant, c->key, NGX_HTTP_CACHE_KEY_LEN) == 0)
-    {
-        return NGX_OK;
-    }
+static ngx_queue_t *
+ngx_http_file_cache_victim(ngx_http_file_cache_t *cache)
+{
+    ngx_http_file_cache_sh_t  *sh;
 
     /*
-     * if the variant hash doesn't match one we used as a secondary
-     * cache key, switch back to the original key
+     * the probationary segment is evicted first unless the frequent one
+     * holds more than its share of nodes
      */
 
-    cache = c->file_cache;
-
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http file cache main key");
+    sh = cache->sh;
 
-    ngx_shmtx_lock(&cache->shpool->mutex);
+    if (!ngx_queue_empty(&sh->frequent)
+        && (ngx_queue_empty(&sh->queue)
+            || sh->frequent_count * 100
+               > sh->count * NGX_HTTP_CACHE_FREQUENT_SHARE))
+    {
+        return &sh->frequent;
+    }
 
-    c->node->count--;
-    c->node->updating = 0;
-    c->node = NULL;
+    return &sh->queue;
+}
 
-    ngx_shmtx_unlock(&cache->shpool->mutex);
 
-    c->file.name.len = 0;
-    c->update_variant = 1;
+static ngx_queue_t *
+ngx_http_file_cache_oldest(ngx_http_file_cache_t *cache)
+{
+    ngx_http_file_cache_sh_t    *sh;
+    ngx_http_file_cache_node_t  *fcn, *ffcn;
 
-    ngx_memcpy(c->key, c->main, NGX_HTTP_CACHE_KEY_LEN);
+    sh = cache->sh;
 
-    if (ngx_http_file_cache_exists(cache, c) == NGX_ERROR) {
-        return NGX_ERROR;
+    if (ngx_queue_empty(&sh->frequent)) {
+        return &sh->queue;
     }
 
-    if (ngx_http_file_cache_name(r, cache->path) != NGX_OK) {
-        return NGX_ERROR;
+    if (ngx_queue_empty(&sh->queue)) {
+        return &sh->frequent;
     }
 
-    return NGX_OK;
+    fcn = ngx_queue_data(ngx_queue_last(&sh->queue),
+                         ngx_http_file_cache_node_t, queue);
+    ffcn = ngx_queue_data(ngx_queue_last(&sh->frequent),
+                          ngx_http_file_cache_node_t, queue);
+
+    return (ffcn->expire < fcn->expire) ? &sh->frequent : &sh->queue;
 }
 
 
-void
-ngx_http_file_cache_update(ngx_http_request_t *r, ngx_temp_file_t *tf)
+static ngx_int_t
+ngx_http_file_cache_sketch_init(ngx_http_file_cache_t *cache, size_t size)
 {
-    off_t                   fs_size;
-    ngx_int_t               rc;
-    ngx_file_uniq_t         uniq;
-    ngx_file_info_t         fi;
-    ngx_http_cache_t        *c;
-    ngx_ext_rename_file_t   ext;
-    ngx_http_file_cache_t  *cache;
+    ngx_uint_t  width;
 
-    c = r->cache;
+    /* a counter in each row per node the keys zone is able to hold */
 
-    if (c->updated) {
-        return;
+    width = 1024;
+
+    while (width < size / sizeof(ngx_http_file_cache_node_t)) {
+        width *= 2;
     }
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http file cache update");
+    cache->sh->sketch_mask = width - 1;
+    cache->sh->sketch_samples = 0;
 
-    cache = c->file_cache;
+    cache->sh->sketch = ngx_slab_calloc(cache->shpool, 4 * width / 2);
+    if (cache->sh->sketch == NULL) {
+        return NGX_ERROR;
+    }
 
-    c->updated = 1;
-    c->updating = 0;
+    return NGX_OK;
+}
 
-    uniq = 0;
-    fs_size = 0;
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http file cache rename: \"%s\" to \"%s\"",
-                   tf->file.name.data, c->file.name.data);
+static void
+ngx_http_file_cache_sketch_add(ngx_http_file_cache_sh_t *sh, u_char *key)
+{
+    uint32_t    hash;
+    ngx_uint_t  i, r, n, min, width, counter[4];
 
-    ext.access = NGX_FILE_OWNER_ACCESS;
-    ext.path_access = NGX_FILE_OWNER_ACCESS;
-    ext.time = -1;
-    ext.create_path = 1;
-    ext.delete_file = 1;
-    ext.log = r->connection->log;
+    /* a count-min sketch with conservative update */
 
-    rc = ngx_ext_rename_file(&tf->file.name, &c->file.name, &ext);
+    width = sh->sketch_mask + 1;
+    min = 15;
 
-    if (rc == NGX_OK) {
+    for (r = 0; r < 4; r++) {
+        ngx_memcpy(&hash, &key[r * sizeof(uint32_t)], sizeof(uint32_t));
 
-        if (ngx_fd_info(tf->file.fd, &fi) == NGX_FILE_ERROR) {
-            ngx_log_error(NGX_LOG_CRIT, r->connection->log, ngx_errno,
-                          ngx_fd_info_n " \"%s\" failed", tf->file.name.data);
+        i = r * width + (hash & sh->sketch_mask);
+        n = (sh->sketch[i / 2] >> (i % 2 * 4)) & 0x0f;
 
-            rc = NGX_ERROR;
+        counter[r] = i;
 
-        } else {
-            uniq = ngx_file_uniq(&fi);
-            fs_size = (ngx_file_fs_size(&fi) + cache->bsize - 1) / cache->bsize;
+        if (n < min) {
+            min = n;
         }
     }
 
-    ngx_shmtx_lock(&cache->shpool->mutex);
+    if (min < 15) {
+        for (r = 0; r < 4; r++) {
+            i = counter[r];
+            n = (sh->sketch[i / 2] >> (i % 2 * 4)) & 0x0f;
 
-    c->node->count--;
-    c->node->error = 0;
-    c->node->uniq = uniq;
-    c->node->body_start = c->body_start;
+            if (n == min) {
+                sh->sketch[i / 2] += (u_char) (1 << (i % 2 * 4));
+            }
+        }
+    }
 
-    cache->sh->size += fs_size - c->node->fs_size;
-    c->node->fs_size = fs_size;
+    /* the counters are halved periodically to forget old keys */
 
-    if (rc == NGX_OK) {
-        c->node->exists = 1;
+    if (++sh->sketch_samples < 10 * width) {
+        return;
     }
 
-    c->node->updating = 0;
+    for (i = 0; i < 4 * width / 2; i++) {
+        sh->sketch[i] = (sh->sketch[i] >> 1) & 0x77;
+    }
 
-    ngx_shmtx_unlock(&cache->shpool->mutex);
+    sh->sketch_samples /= 2;
 }
 
 
-void
-ngx_http_file_cache_update_header(ngx_http_request_t *r)
+static ngx_uint_t
+ngx_http_file_cache_sketch_estimate(ngx_http_file_cache_sh_t *sh, u_char *key)
 {
-    ssize_t                        n;
-    ngx_err_t                      err;
-    ngx_file_t                     file;
-    ngx_file_info_t                fi;
-    ngx_http_cache_t              *c;
-    ngx_http_file_cache_header_t   h;
-
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http file cache update header");
+    uint32_t    hash;
+    ngx_uint_t  i, r, n, min, width;
 
-    c = r->cache;
+    width = sh->sketch_mask + 1;
+    min = 15;
 
-    ngx_memzero(&file, sizeof(ngx_file_t));
+    for (r = 0; r < 4; r++) {
+        ngx_memcpy(&hash, &key[r * sizeof(uint32_t)], sizeof(uint32_t));
 
-    file.name = c->file.name;
-    file.log = r->connection->log;
-    file.fd = ngx_open_file(file.name.data, NGX_FILE_RDWR, NGX_FILE_OPEN, 0);
+        i = r * width + (hash & sh->sketch_mask);
+        n = (sh->sketch[i / 2] >> (i % 2 * 4)) & 0x0f;
 
-    if (file.fd == NGX_INVALID_FILE) {
-        err = ngx_errno;
+        if (n < min) {
+            min = n;
+        }
+    }
 
-        /* cache file may have been deleted */
+    return min;
+}
 
-        if (err == NGX_ENOENT) {
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                           "http file cache \"%s\" not found",
-                           file.name.data);
-            return;
-        }
 
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, err,
-                      ngx_open_file_n " \"%s\" failed", file.name.data);
-        return;
-    }
+static ngx_uint_t
+ngx_http_file_cache_admit(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
+{
+    ngx_queue_t                 *q;
+    ngx_http_file_cache_sh_t    *sh;
+    ngx_http_file_cache_node_t  *fcn;
+    u_char                       key[NGX_HTTP_CACHE_KEY_LEN];
 
     /*
-     * make sure cache file wasn't replaced;
-     * if it was, do nothing
+     * when the cache is full, a new entry is only admitted
+     * if its key is requested more often than the key to be evicted
      */
 
-    if (ngx_fd_info(file.fd, &fi) == NGX_FILE_ERROR) {
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, ngx_errno,
-                      ngx_fd_info_n " \"%s\" failed", file.name.data);
-        goto done;
+    if (!cache->admission) {
+        return 1;
     }
 
-    if (c->uniq != ngx_file_uniq(&fi)
-        || c->length != ngx_file_size(&fi))
-    {
-        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "http file cache \"%s\" changed",
-                       file.name.data);
-        goto done;
+    sh = cache->sh;
+
+    if (sh->size < cache->max_size && sh->count < sh->watermark) {
+        return 1;
     }
 
-    n = ngx_read_file(&file, (u_char *) &h,
-                      sizeof(ngx_http_file_cache_header_t), 0);
+    q = ngx_http_file_cache_victim(cache);
 
-    if (n == NGX_ERROR) {
-        goto done;
+    if (ngx_queue_empty(q)) {
+        return 1;
     }
 
-    if ((size_t) n != sizeof(ngx_http_file_cache_header_t)) {
-        ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
-                      ngx_read_file_n " read only %z of %z from \"%s\"",
-                      n, sizeof(ngx_http_file_cache_header_t), file.name.data);
-        goto done;
-    }
+    fcn = ngx_queue_data(ngx_queue_last(q), ngx_http_file_cache_node_t, queue);
 
-    if (h.version != NGX_HTTP_CACHE_VERSION
-        || h.last_modified != c->last_modified
-        || h.crc32 != c->crc32
-        || (size_t) h.header_start != c->header_start
-        || (size_t) h.body_start != c->body_start)
+    ngx_memcpy(key, &fcn->node.key, sizeof(ngx_rbtree_key_t));
+    ngx_memcpy(&key[sizeof(ngx_rbtree_key_t)], fcn->key,
+               NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+
+    if (ngx_http_file_cache_sketch_estimate(sh, c->key)
+        > ngx_http_file_cache_sketch_estimate(sh, key))
     {
-        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "http file cache \"%s\" content changed",
-                       file.name.data);
-        goto done;
+        return 1;
     }
 
-    /*
-     * update cache file header with new data,
-     * notably h.valid_sec and h.date
-     */
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache entry not admitted");
 
-    ngx_memzero(&h, sizeof(ngx_http_file_cache_header_t));
+    return 0;
+}
 
-    h.version = NGX_HTTP_CACHE_VERSION;
-    h.valid_sec = c->valid_sec;
-    h.updating_sec = c->updating_sec;
-    h.error_sec = c->error_sec;
-    h.last_modified = c->last_modified;
-    h.date = c->date;
-    h.crc32 = c->crc32;
-    h.valid_msec = (u_short) c->valid_msec;
-    h.header_start = (u_short) c->header_start;
-    h.body_start = (u_short) c->body_start;
 
-    if (c->etag.len <= NGX_HTTP_CACHE_ETAG_LEN) {
-        h.etag_len = (u_char) c->etag.len;
-        ngx_memcpy(h.etag, c->etag.data, c->etag.len);
-    }
+static ngx_uint_t
+ngx_http_file_cache_purged(ngx_http_file_cache_t *cache, ngx_http_cache_t *c,
+    time_t mtime)
+{
+    ngx_uint_t                    purged;
+    ngx_queue_t                  *q;
+    ngx_http_file_cache_purge_t  *purge;
 
-    if (c->vary.len) {
-        if (c->vary.len > NGX_HTTP_CACHE_VARY_LEN) {
-            /* should not happen */
-            c->vary.len = NGX_HTTP_CACHE_VARY_LEN;
-        }
+    /* a file not modified after a prefix purge is purged */
 
-        h.vary_len = (u_char) c->vary.len;
-        ngx_memcpy(h.vary, c->vary.data, c->vary.len);
+    purged = 0;
 
-        ngx_http_file_cache_vary(r, c->vary.data, c->vary.len, c->variant);
-        ngx_memcpy(h.variant, c->variant, NGX_HTTP_CACHE_KEY_LEN);
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    for (q = ngx_queue_head(&cache->sh->purges);
+         q != ngx_queue_sentinel(&cache->sh->purges);
+         q = ngx_queue_next(q))
+    {
+        purge = ngx_queue_data(q, ngx_http_file_cache_purge_t, queue);
+
+        if (purge->tag || mtime > purge->time) {
+            continue;
+        }
+
+        if (ngx_http_file_cache_match(c, purge->prefix, purge->len)) {
+            purged = 1;
+            break;
+        }
     }
 
-    (void) ngx_write_file(&file, (u_char *) &h,
-                          sizeof(ngx_http_file_cache_header_t), 0);
+    if (purged && c->node->exists) {
+        c->node->purged = 1;
+    }
 
-done:
+    ngx_shmtx_unlock(&cache->shpool->mutex);
 
-    if (ngx_close_file(file.fd) == NGX_FILE_ERROR) {
-        ngx_log_error(NGX_LOG_ALERT, r->connection->log, ngx_errno,
-                      ngx_close_file_n " \"%s\" failed", file.name.data);
+    if (purged) {
+        c->exists = 0;
     }
+
+    return purged;
 }
 
 
-ngx_int_t
-ngx_http_cache_send(ngx_http_request_t *r)
+static ngx_uint_t
+ngx_http_file_cache_match(ngx_http_cache_t *c, u_char *prefix, size_t len)
 {
-    ngx_int_t          rc;
-    ngx_buf_t         *b;
-    ngx_chain_t        out;
-    ngx_http_cache_t  *c;
+    size_t      n;
+    ngx_str_t  *key;
+    ngx_uint_t  i;
 
-    c = r->cache;
+    key = c->keys.elts;
 
-    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http file cache send: %s", c->file.name.data);
+    for (i = 0; i < c->keys.nelts && len; i++) {
+        n = ngx_min(len, key[i].len);
 
-    /* we need to allocate all before the header would be sent */
+        if (ngx_memcmp(prefix, key[i].data, n) != 0) {
+            return 0;
+        }
 
-    b = ngx_calloc_buf(r->pool);
-    if (b == NULL) {
-        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        prefix += n;
+        len -= n;
     }
 
-    b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t));
-    if (b->file == NULL) {
-        return NGX_HTTP_INTERNAL_SERVER_ERROR;
-    }
+    return (len == 0);
+}
 
-    rc = ngx_http_send_header(r);
 
-    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
-        return rc;
+ngx_int_t
+ngx_http_file_cache_purge(ngx_http_request_t *r)
+{
+    ngx_str_t              *key;
+    ngx_uint_t              i;
+    ngx_http_cache_t       *c;
+    ngx_http_file_cache_t  *cache;
+
+    c = r->cache;
+    cache = c->file_cache;
+
+    if (c->tags.len) {
+        return ngx_http_file_cache_purge_tags(r, cache);
     }
 
-    b->file_pos = c->body_start;
-    b->file_last = c->length;
+    /* a key ending with "*" is a prefix of the keys purged */
 
-    b->in_file = (c->length - c->body_start) ? 1 : 0;
-    b->last_buf = (r == r->main) ? 1 : 0;
-    b->last_in_chain = 1;
-    b->sync = (b->last_buf || b->in_file) ? 0 : 1;
+    key = c->keys.elts;
 
-    b->file->fd = c->file.fd;
-    b->file->name = c->file.name;
-    b->file->log = r->connection->log;
+    for (i = c->keys.nelts; i; i--) {
+        if (key[i - 1].len) {
+            break;
+        }
+    }
 
-    out.buf = b;
-    out.next = NULL;
+    if (i && key[i - 1].data[key[i - 1].len - 1] == '*') {
+        return ngx_http_file_cache_purge_prefix(r, cache);
+    }
 
-    return ngx_http_output_filter(r, &out);
+    return ngx_http_file_cache_purge_key(r,
+                                         ngx_http_file_cache_shard(cache,
+                                                                   c->key));
 }
 
 
-void
-ngx_http_file_cache_free(ngx_http_cache_t *c, ngx_temp_file_t *tf)
+static ngx_int_t
+ngx_http_file_cache_purge_key(ngx_http_request_t *r,
+    ngx_http_file_cache_t *cache)
 {
-    ngx_http_file_cache_t       *cache;
+    ngx_int_t                    rc;
+    ngx_err_t                    err;
+    ngx_http_cache_t            *c;
     ngx_http_file_cache_node_t  *fcn;
 
-    if (c->updated || c->node == NULL) {
-        return;
-    }
-
-    cache = c->file_cache;
-
-    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
-                   "http file cache free, fd: %d", c->file.fd);
+    c = r->cache;
 
     ngx_shmtx_lock(&cache->shpool->mutex);
 
-    fcn = c->node;
-    fcn->count--;
-
-    if (c->updating && fcn->lock_time == c->lock_time) {
-        fcn->updating = 0;
-    }
-
-    if (c->error) {
-        fcn->error = c->error;
+    fcn = ngx_http_file_cache_lookup(cache, c->key);
 
-        if (c->valid_sec) {
-            fcn->valid_sec = c->valid_sec;
-            fcn->valid_msec = c->valid_msec;
-        }
+    if (fcn && (fcn->exists || fcn->error) && !fcn->purged) {
+        ngx_http_file_cache_purge_node(cache, fcn);
+        rc = NGX_OK;
 
-    } else if (!fcn->exists && fcn->count == 0 && c->min_uses == 1) {
-        ngx_queue_remove(&fcn->queue);
-        ngx_rbtree_delete(&cache->sh->rbtree, &fcn->node);
-        ngx_slab_free_locked(cache->shpool, fcn);
-        cache->sh->count--;
-        c->node = NULL;
+    } else {
+        rc = NGX_DECLINED;
     }
 
     ngx_shmtx_unlock(&cache->shpool->mutex);
 
-    c->updated = 1;
-    c->updating = 0;
-
-    if (c->temp_file) {
-        if (tf && tf->file.fd != NGX_INVALID_FILE) {
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
-                           "http file cache incomplete: \"%s\"",
-                           tf->file.name.data);
-
-            if (ngx_delete_file(tf->file.name.data) == NGX_FILE_ERROR) {
-                ngx_log_error(NGX_LOG_CRIT, c->file.log, ngx_errno,
-                              ngx_delete_file_n " \"%s\" failed",
-                              tf->file.name.data);
-            }
-        }
-    }
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache purge key: %i", rc);
 
-    if (c->wait_event.timer_set) {
-        ngx_del_timer(&c->wait_event);
+    if (rc == NGX_OK || !cache->sh->cold) {
+        return rc;
     }
-}
-
 
-static void
-ngx_http_file_cache_cleanup(void *data)
-{
-    ngx_http_cache_t  *c = data;
+    /* the file is not loaded yet */
 
-    if (c->updated) {
-        return;
+    if (ngx_http_file_cache_name(r, cache->path) != NGX_OK) {
+        return NGX_ERROR;
     }
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->file.log, 0,
-                   "http file cache cleanup");
+    if (ngx_delete_file(c->file.name.data) == NGX_FILE_ERROR) {
+        err = ngx_errno;
 
-    if (c->updating && !c->background) {
-        ngx_log_error(NGX_LOG_ALERT, c->file.log, 0,
-                      "stalled cache updating, error:%ui", c->error);
+        if (err == NGX_ENOENT) {
+            return NGX_DECLINED;
+        }
+
+        ngx_log_error(NGX_LOG_CRIT, r->connection->log, err,
+                      ngx_delete_file_n " \"%s\" failed", c->file.name.data);
+        return NGX_ERROR;
     }
 
-    ngx_http_file_cache_free(c, NULL);
+    return NGX_OK;
 }
 
 
-static time_t
-ngx_http_file_cache_forced_expire(ngx_http_file_cache_t *cache)
-{
-    u_char                      *name, *p;
-    size_t                       len;
-    time_t                       wait;
-    ngx_uint_t                   tries;
-    ngx_path_t                  *path;
-    ngx_queue_t                 *q, *sentinel;
-    ngx_http_file_cache_node_t  *fcn;
-    u_char                       key[2 * NGX_HTTP_CACHE_KEY_LEN];
+static ngx_int_t
+ngx_http_file_cache_purge_prefix(ngx_http_request_t *r,
+    ngx_http_file_cache_t *cache)
+{
+    u_char                       *p;
+    size_t                        len, n;
+    ngx_str_t                    *key;
+    ngx_uint_t                    i;
+    ngx_http_cache_t             *c;
+    ngx_http_file_cache_t        *shard;
+    ngx_http_file_cache_purge_t  *purge;
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                   "http file cache forced expire");
+    c = r->cache;
+    key = c->keys.elts;
 
-    path = cache->path;
-    len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
+    len = 0;
 
-    name = ngx_alloc(len + 1, ngx_cycle->log);
-    if (name == NULL) {
-        return 10;
+    for (i = 0; i < c->keys.nelts; i++) {
+        len += key[i].len;
     }
 
-    ngx_memcpy(name, path->name.data, path->name.len);
+    /* the trailing "*" */
+    len--;
 
-    wait = 10;
-    tries = 20;
-    sentinel = NULL;
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http file cache purge prefix");
 
-    ngx_shmtx_lock(&cache->shpool->mutex);
+    for (i = 0; i < cache->nshards; i++) {
+        shard = cache->shards ? cache->shards[i] : cache;
 
-    for ( ;; ) {
-        if (ngx_queue_empty(&cache->sh->queue)) {
-            break;
-        }
+        ngx_shmtx_lock(&shard->shpool->mutex);
 
-        q = ngx_queue_last(&cache->sh->queue);
+        purge = ngx_slab_alloc_locked(shard->shpool,
+                               offsetof(ngx_http_file_cache_purge_t, prefix)
+                               + len);
+        if (purge == NULL) {
+            ngx_shmtx_unlock(&shard->shpool->mutex);
 
-        if (q == sentinel) {
-            break;
+            ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                          "could not allocate purge%s",
+                          shard->shpool->log_ctx);
+            return NGX_ERROR;
         }
 
-        fcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
-
-        ngx_log_debug6(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                  "http file cache forced expire: #%d %d %02xd%02xd%02xd%02xd",
-                  fcn->count, fcn->exists,
-                  fcn->key[0], fcn->key[1], fcn->key[2], fcn->key[3]);
+        purge->time = ngx_time();
+        purge->keys = NULL;
+        purge->tag = 0;
+        purge->walked = 0;
+        purge->len = len;
 
-        if (fcn->count == 0) {
-            ngx_http_file_cache_delete(cache, q, name);
-            wait = 0;
-            break;
-        }
+        p = purge->prefix;
 
-        if (fcn->deleting) {
-            wait = 1;
-            break;
+        for (n = 0; n < c->keys.nelts && p < purge->prefix + len; n++) {
+            p = ngx_cpymem(p, key[n].data,
+                           ngx_min(key[n].len,
+                                   (size_t) (purge->prefix + len - p)));
         }
 
-        p = ngx_hex_dump(key, (u_char *) &fcn->node.key,
-                         sizeof(ngx_rbtree_key_t));
-        len = NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t);
-        (void) ngx_hex_dump(p, fcn->key, len);
+        ngx_queue_insert_tail(&shard->sh->purges, &purge->queue);
+        shard->sh->prefixes++;
 
-        /*
-         * abnormally exited workers may leave locked cache entries,
-         * and although it may be safe to remove them completely,
-         * we prefer to just move them to the top of the inactive queue
-         */
+        ngx_shmtx_unlock(&shard->shpool->mutex);
 
-        ngx_queue_remove(q);
-        fcn->expire = ngx_time() + cache->inactive;
-        ngx_queue_insert_head(&cache->sh->queue, &fcn->queue);
+        ngx_http_file_cache_purge_notify(shard);
+    }
 
-        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
-                      "ignore long locked inactive cache entry %*s, count:%d",
-                      (size_t) 2 * NGX_HTTP_CACHE_KEY_LEN, key, fcn->count);
+    return NGX_OK;
+}
 
-        if (sentinel == NULL) {
-            sentinel = q;
-        }
 
-        if (--tries) {
-            continue;
-        }
+static ngx_int_t
+ngx_http_file_cache_purge_tags(ngx_http_request_t *r,
+    ngx_http_file_cache_t *cache)
+{
+    u_char                       *p, *last;
+    uint32_t                      hash;
+    ngx_int_t                     rc;
+    ngx_str_t                     name;
+    ngx_uint_t                    i;
+    ngx_http_cache_t             *c;
+    ngx_http_file_cache_t        *shard;
+    ngx_http_file_cache_tag_t    *tag;
+    ngx_http_file_cache_purge_t  *purge;
 
-        wait = 1;
-        break;
-    }
+    c = r->cache;
 
-    ngx_shmtx_unlock(&cache->shpool->mutex);
+    rc = NGX_DECLINED;
 
-    ngx_free(name);
+    p = c->tags.data;
+    last = p + c->tags.len;
 
-    return wait;
-}
+    while (ngx_http_file_cache_tag_next(&p, last, &name) == NGX_OK) {
 
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http file cache purge tag: \"%V\"", &name);
 
-static time_t
-ngx_http_file_cache_expire(ngx_http_file_cache_t *cache)
-{
-    u_char                      *name, *p;
-    size_t                       len;
-    time_t                       now, wait;
-    ngx_path_t                  *path;
-    ngx_msec_t                   elapsed;
-    ngx_queue_t                 *q;
-    ngx_http_file_cache_node_t  *fcn;
-    u_char                       key[2 * NGX_HTTP_CACHE_KEY_LEN];
+        hash = ngx_crc32_short(name.data, name.len);
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                   "http file cache expire");
+        for (i = 0; i < cache->nshards; i++) {
+            shard = cache->shards ? cache->shards[i] : cache;
 
-    path = cache->path;
-    len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
+            ngx_shmtx_lock(&shard->shpool->mutex);
 
-    name = ngx_alloc(len + 1, ngx_cycle->log);
-    if (name == NULL) {
-        return 10;
-    }
+            tag = (ngx_http_file_cache_tag_t *)
+                      ngx_str_rbtree_lookup(&shard->sh->tags, &name, hash);
 
-    ngx_memcpy(name, path->name.data, path->name.len);
+            if (tag == NULL) {
+                ngx_shmtx_unlock(&shard->shpool->mutex);
+                continue;
+            }
 
-    now = ngx_time();
+            /* the tagged entries are purged by the cache manager */
 
-    ngx_shmtx_lock(&cache->shpool->mutex);
+            if (tag->keys) {
+                purge = ngx_slab_alloc_locked(shard->shpool,
+                                        sizeof(ngx_http_file_cache_purge_t));
+                if (purge == NULL) {
+                    ngx_shmtx_unlock(&shard->shpool->mutex);
 
-    for ( ;; ) {
+                    ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                                  "could not allocate purge%s",
+                                  shard->shpool->log_ctx);
+                    return NGX_ERROR;
+                }
 
-        if (ngx_quit || ngx_terminate) {
-            wait = 1;
-            break;
-        }
+                purge->time = ngx_time();
+                purge->keys = tag->keys;
+                purge->tag = 1;
+                purge->walked = 0;
+                purge->len = 0;
 
-        if (ngx_queue_empty(&cache->sh->queue)) {
-            wait = 10;
-            break;
-        }
+                ngx_queue_insert_tail(&shard->sh->purges, &purge->queue);
+            }
 
-        q = ngx_queue_last(&cache->sh->queue);
+            ngx_rbtree_delete(&shard->sh->tags, &tag->sn.node);
+            ngx_slab_free_locked(shard->shpool, tag);
 
-        fcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
+            ngx_shmtx_unlock(&shard->shpool->mutex);
 
-        wait = fcn->expire - now;
+            ngx_http_file_cache_purge_notify(shard);
 
-        if (wait > 0) {
-            wait = wait > 10 ? 10 : wait;
-            break;
+            rc = NGX_OK;
         }
+    }
 
-        ngx_log_debug6(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                       "http file cache expire: #%d %d %02xd%02xd%02xd%02xd",
-                       fcn->count, fcn->exists,
-                       fcn->key[0], fcn->key[1], fcn->key[2], fcn->key[3]);
-
-        if (fcn->count == 0) {
-            ngx_http_file_cache_delete(cache, q, name);
-            goto next;
-        }
+    return rc;
+}
 
-        if (fcn->deleting) {
-            wait = 1;
-            break;
-        }
 
-        p = ngx_hex_dump(key, (u_char *) &fcn->node.key,
-                         sizeof(ngx_rbtree_key_t));
-        len = NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t);
-        (void) ngx_hex_dump(p, fcn->key, len);
+static void
+ngx_http_file_cache_purge_notify(ngx_http_file_cache_t *cache)
+{
+#if !(NGX_WIN32)
+    ngx_int_t  slot;
 
-        /*
-         * abnormally exited workers may leave locked cache entries,
-         * and although it may be safe to remove them completely,
-         * we prefer to just move them to the top of the inactive queue
-         */
+    /* the cache manager processes the purge without waiting for its timer */
 
-        ngx_queue_remove(q);
-        fcn->expire = ngx_time() + cache->inactive;
-        ngx_queue_insert_head(&cache->sh->queue, &fcn->queue);
+    slot = cache->sh->manager;
 
-        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
-                      "ignore long locked inactive cache entry %*s, count:%d",
-                      (size_t) 2 * NGX_HTTP_CACHE_KEY_LEN, key, fcn->count);
+    if (slot != -1) {
+        (void) ngx_notify_process(slot);
+    }
+#endif
+}
 
-next:
 
-        if (++cache->files >= cache->manager_files) {
-            wait = 0;
-            break;
-        }
+static void
+ngx_http_file_cache_purge_node(ngx_http_file_cache_t *cache,
+    ngx_http_file_cache_node_t *fcn)
+{
+    fcn->tagged = 0;
 
-        ngx_time_update();
+    if (fcn->error) {
+        fcn->valid_sec = 0;
 
-        elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
+    } else {
+        fcn->purged = 1;
+    }
 
-        if (elapsed >= cache->manager_threshold) {
-            wait = 0;
-            break;
-        }
+    if (fcn->count) {
+        return;
     }
 
-    ngx_shmtx_unlock(&cache->shpool->mutex);
+    /* an unused entry is deleted by the cache manager as expired */
 
-    ngx_free(name);
+    fcn->expire = 0;
 
-    return wait;
+    ngx_queue_remove(&fcn->queue);
+    ngx_queue_insert_tail(ngx_http_file_cache_queue(cache, fcn), &fcn->queue);
 }
 
 
-static void
-ngx_http_file_cache_delete(ngx_http_file_cache_t *cache, ngx_queue_t *q,
-    u_char *name)
+static ngx_int_t
+ngx_http_file_cache_purge_process(ngx_http_file_cache_t *cache)
 {
-    u_char                      *p;
-    size_t                       len;
-    ngx_path_t                  *path;
-    ngx_http_file_cache_node_t  *fcn;
-
-    fcn = ngx_queue_data(q, ngx_http_file_cache_node_t, queue);
+    u_char                          *name, *buf;
+    size_t                           len, size;
+    time_t                           time;
+    ngx_int_t                        rc;
+    ngx_uint_t                       i, files;
+    ngx_path_t                      *path;
+    ngx_msec_t                       elapsed;
+    ngx_queue_t                     *q;
+    ngx_file_uniq_t                  uniq;
+    ngx_rbtree_node_t               *node;
+    ngx_http_file_cache_node_t      *fcn;
+    ngx_http_file_cache_purge_t     *purge;
+    ngx_http_file_cache_tag_keys_t  *keys;
+    u_char                           key[NGX_HTTP_CACHE_KEY_LEN];
 
-    if (fcn->exists) {
-        cache->sh->size -= fcn->fs_size;
+    path = cache->path;
+    len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
 
-        path = cache->path;
-        p = name + path->name.len + 1 + path->len;
-        p = ngx_hex_dump(p, (u_char *) &fcn->node.key,
-                         sizeof(ngx_rbtree_key_t));
-        len = NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t);
-        p = ngx_hex_dump(p, fcn->key, len);
-        *p = '\0';
+    name = ngx_alloc(len + 1, ngx_cycle->log);
+    if (name == NULL) {
+        return NGX_OK;
+    }
 
-        fcn->count++;
-        fcn->deleting = 1;
-        ngx_shmtx_unlock(&cache->shpool->mutex);
+    ngx_memcpy(name, path->name.data, path->name.len);
 
-        len = path->name.len + 1 + path->len + 2 * NGX_HTTP_CACHE_KEY_LEN;
-        ngx_create_hashed_filename(path, name, len);
+    buf = NULL;
+    size = 0;
+    files = 0;
 
-        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                       "http file cache expire: \"%s\"", name);
+    for ( ;; ) {
 
-        if (ngx_delete_file(name) == NGX_FILE_ERROR) {
-            ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
-                          ngx_delete_file_n " \"%s\" failed", name);
+        if (ngx_quit || ngx_terminate) {
+            rc = NGX_OK;
+            break;
         }
 
         ngx_shmtx_lock(&cache->shpool->mutex);
-        fcn->count--;
-        fcn->deleting = 0;
-    }
 
-    if (fcn->count == 0) {
-        ngx_queue_remove(q);
-        ngx_rbtree_delete(&cache->sh->rbtree, &fcn->node);
-        ngx_slab_free_locked(cache->shpool, fcn);
-        cache->sh->count--;
-    }
-}
+        if (ngx_queue_empty(&cache->sh->purges)) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+            rc = NGX_OK;
+            break;
+        }
 
+        q = ngx_queue_head(&cache->sh->purges);
+        purge = ngx_queue_data(q, ngx_http_file_cache_purge_t, queue);
 
-static ngx_msec_t
-ngx_http_file_cache_manager(void *data)
-{
-    ngx_http_file_cache_t  *cache = data;
+        if (purge->tag) {
 
-    off_t       size, free;
-    time_t      wait;
-    ngx_msec_t  elapsed, next;
-    ngx_uint_t  count, watermark;
+            /* the keys of a purged tag are processed in chunks */
 
-    cache->last = ngx_current_msec;
-    cache->files = 0;
+            keys = purge->keys;
+            purge->keys = keys->next;
 
-    next = (ngx_msec_t) ngx_http_file_cache_expire(cache) * 1000;
+            for (i = 0; i < keys->nelts; i++) {
+                fcn = ngx_http_file_cache_lookup(cache, keys->key[i]);
 
-    if (next == 0) {
-        next = cache->manager_sleep;
-        goto done;
-    }
+                if (fcn && (fcn->exists || fcn->error) && !fcn->purged) {
+                    ngx_http_file_cache_purge_node(cache, fcn);
+                }
+            }
+
+            ngx_slab_free_locked(cache->shpool, keys);
+
+            if (purge->keys == NULL) {
+                ngx_queue_remove(q);
+                ngx_slab_free_locked(cache->shpool, purge);
+            }
+
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+
+            goto next;
+        }
+
+        /*
+         * the keys of the files are compared with the prefix in the tree
+         * order, the key of the last node walked is kept with the purge
+         */
+
+        node = ngx_http_file_cache_next(cache,
+                                        purge->walked ? purge->key : NULL);
+
+        for ( /* void */ ; node; node = ngx_rbtree_next(&cache->sh->rbtree,
+                                                        node))
+        {
+            fcn = (ngx_http_file_cache_node_t *) node;
+
+            if (fcn->exists && !fcn->deleting && !fcn->purged) {
+                break;
+            }
+        }
 
-    for ( ;; ) {
-        ngx_shmtx_lock(&cache->shpool->mutex);
+        if (node == NULL) {
+            ngx_log_debug2(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                           "http file cache purge prefix \"%*s\" done",
+                           purge->len, purge->prefix);
 
-        size = cache->sh->size;
-        count = cache->sh->count;
-        watermark = cache->sh->watermark;
+            ngx_queue_remove(q);
+            cache->sh->prefixes--;
+            ngx_slab_free_locked(cache->shpool, purge);
 
-        ngx_shmtx_unlock(&cache->shpool->mutex);
+            ngx_shmtx_unlock(&cache->shpool->mutex);
 
-        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                       "http file cache size: %O c:%ui w:%i",
-                       size, count, (ngx_int_t) watermark);
+            continue;
+        }
 
-        if (size < cache->max_size && count < watermark) {
+        fcn = (ngx_http_file_cache_node_t *) node;
 
-            if (!cache->min_free) {
-                break;
-            }
+        ngx_memcpy(key, &fcn->node.key, sizeof(ngx_rbtree_key_t));
+        ngx_memcpy(&key[sizeof(ngx_rbtree_key_t)], fcn->key,
+                   NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
 
-            free = ngx_fs_available(cache->path->name.data);
+        ngx_memcpy(purge->key, key, NGX_HTTP_CACHE_KEY_LEN);
+        purge->walked = 1;
 
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                           "http file cache free: %O", free);
+        /* the buffer holds the file header and the prefix */
 
-            if (free > cache->min_free) {
+        len = sizeof(ngx_http_file_cache_header_t)
+              + sizeof(ngx_http_file_cache_key) + 2 * purge->len;
+
+        if (len > size) {
+            if (buf) {
+                ngx_free(buf);
+            }
+
+            buf = ngx_alloc(len, ngx_cycle->log);
+            if (buf == NULL) {
+                ngx_shmtx_unlock(&cache->shpool->mutex);
+                rc = NGX_OK;
                 break;
             }
+
+            size = len;
         }
 
-        wait = ngx_http_file_cache_forced_expire(cache);
+        len = purge->len;
+        time = purge->time;
 
-        if (wait > 0) {
-            next = (ngx_msec_t) wait * 1000;
-            break;
-        }
+        ngx_memcpy(buf + size - len, purge->prefix, len);
 
-        if (ngx_quit || ngx_terminate) {
-            break;
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        files++;
+
+        if (ngx_http_file_cache_purge_file(cache, name, key, buf, len, time,
+                                           &uniq)
+            == NGX_OK)
+        {
+            ngx_shmtx_lock(&cache->shpool->mutex);
+
+            fcn = ngx_http_file_cache_lookup(cache, key);
+
+            if (fcn && fcn->exists && !fcn->purged
+                && (fcn->uniq == 0 || fcn->uniq == uniq))
+            {
+                ngx_http_file_cache_purge_node(cache, fcn);
+            }
+
+            ngx_shmtx_unlock(&cache->shpool->mutex);
         }
 
-        if (++cache->files >= cache->manager_files) {
-            next = cache->manager_sleep;
+        if (files >= cache->manager_files) {
+            rc = NGX_AGAIN;
             break;
         }
 
+    next:
+
         ngx_time_update();
 
         elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
 
         if (elapsed >= cache->manager_threshold) {
-            next = cache->manager_sleep;
+            rc = NGX_AGAIN;
             break;
         }
     }
 
-done:
-
-    elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
+    ngx_free(name);
 
-    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                   "http file cache manager: %ui e:%M n:%M",
-                   cache->files, elapsed, next);
+    if (buf) {
+        ngx_free(buf);
+    }
 
-    return next;
+    return rc;
 }
 
 
-static void
-ngx_http_file_cache_loader(void *data)
+static ngx_int_t
+ngx_http_file_cache_purge_file(ngx_http_file_cache_t *cache, u_char *name,
+    u_char *key, u_char *buf, size_t len, time_t time, ngx_file_uniq_t *uniq)
 {
-    ngx_http_file_cache_t  *cache = data;
+    u_char                        *p;
+    size_t                         size;
+    ssize_t                        n;
+    ngx_int_t                      rc;
+    ngx_err_t                      err;
+    ngx_file_t                     file;
+    ngx_path_t                    *path;
+    ngx_file_info_t                fi;
+    ngx_http_file_cache_header_t  *h;
+
+    path = cache->path;
 
-    ngx_tree_ctx_t  tree;
+    p = name + path->name.len + 1 + path->len;
+    p = ngx_hex_dump(p, key, NGX_HTTP_CACHE_KEY_LEN);
+    *p = '\0';
 
-    if (!cache->sh->cold || cache->sh->loading) {
-        return;
+    ngx_memzero(&file, sizeof(ngx_file_t));
+
+    file.name.data = name;
+    file.name.len = p - name;
+    file.log = ngx_cycle->log;
+
+    ngx_create_hashed_filename(path, name, file.name.len);
+
+    file.fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (file.fd == NGX_INVALID_FILE) {
+        err = ngx_errno;
+
+        if (err != NGX_ENOENT) {
+            ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, err,
+                          ngx_open_file_n " \"%s\" failed", name);
+        }
+
+        return NGX_DECLINED;
     }
 
-    if (!ngx_atomic_cmp_set(&cache->sh->loading, 0, ngx_pid)) {
-        return;
+    rc = NGX_DECLINED;
+
+    if (ngx_fd_info(file.fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, ngx_cycle->log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", name);
+        goto done;
     }
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                   "http file cache loader");
+    /* the files stored after the purge are kept */
 
-    tree.init_handler = NULL;
-    tree.file_handler = ngx_http_file_cache_manage_file;
-    tree.pre_tree_handler = ngx_http_file_cache_manage_directory;
-    tree.post_tree_handler = ngx_http_file_cache_noop;
-    tree.spec_handler = ngx_http_file_cache_delete_file;
-    tree.data = cache;
-    tree.alloc = 0;
-    tree.log = ngx_cycle->log;
+    if (ngx_file_mtime(&fi) > time) {
+        goto done;
+    }
 
-    cache->last = ngx_current_msec;
-    cache->files = 0;
+    size = sizeof(ngx_http_file_cache_header_t)
+           + sizeof(ngx_http_file_cache_key) + len;
 
-    if (ngx_walk_tree(&tree, &cache->path->name) == NGX_ABORT) {
-        cache->sh->loading = 0;
-        return;
+    n = ngx_read_file(&file, buf, size, 0);
+
+    if (n == NGX_ERROR || (size_t) n != size) {
+        goto done;
     }
 
-    cache->sh->cold = 0;
-    cache->sh->loading = 0;
+    h = (ngx_http_file_cache_header_t *) buf;
+    p = buf + sizeof(ngx_http_file_cache_header_t);
 
-    ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
-                  "http file cache: %V %.3fM, bsize: %uz",
-                  &cache->path->name,
-                  ((double) cache->sh->size * cache->bsize) / (1024 * 1024),
-                  cache->bsize);
-}
+    if (h->version != ngx_http_file_cache_version(cache)
+        || ngx_memcmp(p, ngx_http_file_cache_key,
+                      sizeof(ngx_http_file_cache_key))
+           != 0
+        || ngx_memcmp(p + sizeof(ngx_http_file_cache_key), buf + size, len)
+           != 0)
+    {
+        goto done;
+    }
 
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "http file cache purge file: \"%s\"", name);
 
-static ngx_int_t
-ngx_http_file_cache_noop(ngx_tree_ctx_t *ctx, ngx_str_t *path)
-{
-    return NGX_OK;
+    *uniq = ngx_file_uniq(&fi);
+    rc = NGX_OK;
+
+done:
+
+    if (ngx_close_file(file.fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", name);
+    }
+
+    return rc;
 }
 
 
-static ngx_int_t
-ngx_http_file_cache_manage_file(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+static void
+ngx_http_file_cache_tag(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
 {
-    ngx_msec_t              elapsed;
-    ngx_http_file_cache_t  *cache;
+    u_char                          *p, *last;
+    uint32_t                         hash;
+    ngx_str_t                        name;
+    ngx_http_file_cache_tag_t       *tag;
+    ngx_http_file_cache_tag_keys_t  *keys;
 
-    cache = ctx->data;
+    p = c->tags.data;
+    last = p + c->tags.len;
 
-    if (ngx_http_file_cache_add_file(ctx, path) != NGX_OK) {
-        (void) ngx_http_file_cache_delete_file(ctx, path);
-    }
+    while (ngx_http_file_cache_tag_next(&p, last, &name) == NGX_OK) {
 
-    if (++cache->files >= cache->loader_files) {
-        ngx_http_file_cache_loader_sleep(cache);
+        hash = ngx_crc32_short(name.data, name.len);
 
-    } else {
-        ngx_time_update();
+        tag = (ngx_http_file_cache_tag_t *)
+                  ngx_str_rbtree_lookup(&cache->sh->tags, &name, hash);
 
-        elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
+        if (tag == NULL) {
+            tag = ngx_slab_alloc_locked(cache->shpool,
+                                   offsetof(ngx_http_file_cache_tag_t, data)
+                                   + name.len);
+            if (tag == NULL) {
+                goto failed;
+            }
 
-        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                       "http file cache loader time elapsed: %M", elapsed);
+            ngx_memcpy(tag->data, name.data, name.len);
 
-        if (elapsed >= cache->loader_threshold) {
-            ngx_http_file_cache_loader_sleep(cache);
+            tag->sn.node.key = hash;
+            tag->sn.str.len = name.len;
+            tag->sn.str.data = tag->data;
+            tag->keys = NULL;
+
+            ngx_rbtree_insert(&cache->sh->tags, &tag->sn.node);
+        }
+
+        keys = tag->keys;
+
+        if (keys == NULL || keys->nelts == NGX_HTTP_CACHE_TAG_KEYS) {
+            keys = ngx_slab_alloc_locked(cache->shpool,
+                                      sizeof(ngx_http_file_cache_tag_keys_t));
+            if (keys == NULL) {
+                goto failed;
+            }
+
+            keys->next = tag->keys;
+            keys->nelts = 0;
+            tag->keys = keys;
         }
+
+        ngx_memcpy(keys->key[keys->nelts++], c->key, NGX_HTTP_CACHE_KEY_LEN);
     }
 
-    return (ngx_quit || ngx_terminate) ? NGX_ABORT : NGX_OK;
+    c->node->tagged = 1;
+
+    return;
+
+failed:
+
+    ngx_log_error(NGX_LOG_WARN, ngx_cycle->log, 0,
+                  "could not allocate cache tag%s", cache->shpool->log_ctx);
 }
 
 
 static ngx_int_t
-ngx_http_file_cache_manage_directory(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+ngx_http_file_cache_tag_next(u_char **pos, u_char *last, ngx_str_t *tag)
 {
-    if (path->len >= 5
-        && ngx_strncmp(path->data + path->len - 5, "/temp", 5) == 0)
-    {
-        return NGX_DECLINED;
+    u_char  *p;
+
+    /* the tags are separated by spaces or commas */
+
+    for (p = *pos; p < last; p++) {
+        if (*p != ' ' && *p != ',' && *p != '\t') {
+            break;
+        }
     }
 
-    return NGX_OK;
-}
+    if (p == last) {
+        *pos = p;
+        return NGX_DONE;
+    }
 
+    tag->data = p;
 
-static void
-ngx_http_file_cache_loader_sleep(ngx_http_file_cache_t *cache)
-{
-    ngx_msleep(cache->loader_sleep);
+    while (p < last && *p != ' ' && *p != ',' && *p != '\t') {
+        p++;
+    }
 
-    ngx_time_update();
+    tag->len = p - tag->data;
 
-    cache->last = ngx_current_msec;
-    cache->files = 0;
+    *pos = p;
+
+    return NGX_OK;
 }
 
 
-static ngx_int_t
-ngx_http_file_cache_add_file(ngx_tree_ctx_t *ctx, ngx_str_t *name)
+static void
+ngx_http_file_cache_tags_sweep(ngx_http_file_cache_t *cache)
 {
-    u_char                 *p;
-    ngx_int_t               n;
-    ngx_uint_t              i;
-    ngx_http_cache_t        c;
-    ngx_http_file_cache_t  *cache;
-
-    if (name->len < 2 * NGX_HTTP_CACHE_KEY_LEN) {
-        return NGX_ERROR;
-    }
+    ngx_uint_t                       i, n;
+    ngx_msec_t                       elapsed;
+    ngx_rbtree_node_t               *node, *next, *sentinel;
+    ngx_http_file_cache_tag_t       *tag;
+    ngx_http_file_cache_node_t      *fcn;
+    ngx_http_file_cache_tag_keys_t  *keys, **kp;
 
     /*
-     * Temporary files in cache have a suffix consisting of a dot
-     * followed by 10 digits.
+     * the keys of the entries deleted or purged since they were tagged
+     * are removed from the tags index once a minute
      */
 
-    if (name->len >= 2 * NGX_HTTP_CACHE_KEY_LEN + 1 + 10
-        && name->data[name->len - 10 - 1] == '.')
-    {
-        return NGX_OK;
+    if (ngx_time() < cache->tags_next) {
+        return;
     }
 
-    if (ctx->size < (off_t) sizeof(ngx_http_file_cache_header_t)) {
-        ngx_log_error(NGX_LOG_CRIT, ctx->log, 0,
-                      "cache file \"%s\" is too small", name->data);
-        return NGX_ERROR;
-    }
+    for ( ;; ) {
+        ngx_shmtx_lock(&cache->shpool->mutex);
 
-    ngx_memzero(&c, sizeof(ngx_http_cache_t));
-    cache = ctx->data;
+        node = cache->sh->tags.root;
+        sentinel = cache->sh->tags.sentinel;
 
-    c.length = ctx->size;
-    c.fs_size = (ctx->fs_size + cache->bsize - 1) / cache->bsize;
+        if (node == sentinel) {
+            node = NULL;
 
-    p = &name->data[name->len - 2 * NGX_HTTP_CACHE_KEY_LEN];
+        } else if (cache->tags_walked == 0) {
+            node = ngx_rbtree_min(node, sentinel);
 
-    for (i = 0; i < NGX_HTTP_CACHE_KEY_LEN; i++) {
-        n = ngx_hextoi(p, 2);
+        } else {
+            next = NULL;
 
-        if (n == NGX_ERROR) {
-            return NGX_ERROR;
+            while (node != sentinel) {
+                if (node->key > cache->tags_key) {
+                    next = node;
+                    node = node->left;
+
+                } else {
+                    node = node->right;
+                }
+            }
+
+            node = next;
         }
 
-        p += 2;
+        for (n = 0; node && n < NGX_HTTP_CACHE_TAGS_SWEEP; node = next) {
+            next = ngx_rbtree_next(&cache->sh->tags, node);
 
-        c.key[i] = (u_char) n;
-    }
+            tag = (ngx_http_file_cache_tag_t *) node;
+
+            for (kp = &tag->keys; *kp; /* void */) {
+                keys = *kp;
+
+                for (i = 0; i < keys->nelts; /* void */) {
+                    fcn = ngx_http_file_cache_lookup(cache, keys->key[i]);
+
+                    if (fcn && fcn->tagged) {
+                        i++;
+                        continue;
+                    }
+
+                    if (i != --keys->nelts) {
+                        ngx_memcpy(keys->key[i], keys->key[keys->nelts],
+                                   NGX_HTTP_CACHE_KEY_LEN);
+                    }
+                }
+
+                n += NGX_HTTP_CACHE_TAG_KEYS;
+
+                if (keys->nelts == 0) {
+                    *kp = keys->next;
+                    ngx_slab_free_locked(cache->shpool, keys);
+                    continue;
+                }
+
+                kp = &keys->next;
+            }
+
+            cache->tags_key = node->key;
+            cache->tags_walked = 1;
+
+            if (tag->keys == NULL) {
+                ngx_rbtree_delete(&cache->sh->tags, node);
+                ngx_slab_free_locked(cache->shpool, tag);
+            }
+        }
+
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        if (node == NULL) {
+            cache->tags_walked = 0;
+            cache->tags_next = ngx_time() + 60;
+            return;
+        }
+
+        if (ngx_quit || ngx_terminate) {
+            return;
+        }
+
+        ngx_time_update();
+
+        elapsed = ngx_abs((ngx_msec_int_t) (ngx_current_msec - cache->last));
 
-    return ngx_http_file_cache_add(cache, &c);
+        if (elapsed >= cache->manager_threshold) {
+            return;
+        }
+    }
 }
 
 
-static ngx_int_t
-ngx_http_file_cache_add(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
+void
+ngx_http_file_cache_count(ngx_http_cache_t *c, ngx_uint_t status)
 {
-    ngx_http_file_cache_node_t  *fcn;
-
-    ngx_shmtx_lock(&cache->shpool->mutex);
-
-    fcn = ngx_http_file_cache_lookup(cache, c->key);
+    if (status == 0 || status > NGX_HTTP_CACHE_SCARCE) {
+        return;
+    }
 
-    if (fcn == NULL) {
+    ngx_atomic_fetch_add(
+        &ngx_http_file_cache_counters(c->file_cache)->status[status], 1);
+}
 
-        fcn = ngx_slab_calloc_locked(cache->shpool,
-                                     sizeof(ngx_http_file_cache_node_t));
-        if (fcn == NULL) {
-            ngx_http_file_cache_set_watermark(cache);
 
-            if (cache->fail_time != ngx_time()) {
-                cache->fail_time = ngx_time();
-                ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
-                           "could not allocate node%s", cache->shpool->log_ctx);
-            }
+ngx_int_t
+ngx_http_file_cache_stats(ngx_shm_zone_t *shm_zone,
+    ngx_http_file_cache_stats_t *st)
+{
+    ngx_uint_t                       i, n, k;
+    ngx_http_file_cache_t           *cache, *shard;
+    ngx_http_file_cache_counters_t  *sc;
 
-            ngx_shmtx_unlock(&cache->shpool->mutex);
-            return NGX_ERROR;
-        }
+    if (shm_zone->init != ngx_http_file_cache_init) {
+        return NGX_DECLINED;
+    }
 
-        cache->sh->count++;
+    cache = shm_zone->data;
 
-        ngx_memcpy((u_char *) &fcn->node.key, c->key, sizeof(ngx_rbtree_key_t));
+    if (cache->sh == NULL) {
+        return NGX_DECLINED;
+    }
 
-        ngx_memcpy(fcn->key, &c->key[sizeof(ngx_rbtree_key_t)],
-                   NGX_HTTP_CACHE_KEY_LEN - sizeof(ngx_rbtree_key_t));
+    /* the shards are accounted with their cache */
 
-        ngx_rbtree_insert(&cache->sh->rbtree, &fcn->node);
+    if (cache->shards && cache->shards[0] != cache) {
+        return NGX_DECLINED;
+    }
 
-        fcn->uses = 1;
-        fcn->exists = 1;
-        fcn->fs_size = c->fs_size;
+    ngx_memzero(st, sizeof(ngx_http_file_cache_stats_t));
 
-        cache->sh->size += c->fs_size;
+    st->shards = cache->nshards;
 
-    } else {
-        ngx_queue_remove(&fcn->queue);
-    }
+    for (n = 0; n < cache->nshards; n++) {
+        shard = cache->shards ? cache->shards[n] : cache;
 
-    fcn->expire = ngx_time() + cache->inactive;
+        /* the counters are updated concurrently, and read without lock */
 
-    ngx_queue_insert_head(&cache->sh->queue, &fcn->queue);
+        for (i = 0; i < NGX_HTTP_CACHE_STATS_SLOTS; i++) {
+            sc = &shard->sh->stats[i].counters;
 
-    ngx_shmtx_unlock(&cache->shpool->mutex);
+            for (k = 0; k <= NGX_HTTP_CACHE_SCARCE; k++) {
+                st->counters.status[k] += sc->status[k];
+            }
 
-    return NGX_OK;
-}
+            st->counters.bytes += sc->bytes;
+            st->counters.lock_waits += sc->lock_waits;
+            st->counters.lock_timeouts += sc->lock_timeouts;
+            st->counters.lock_wait_msec += sc->lock_wait_msec;
+        }
 
+        ngx_shmtx_lock(&shard->shpool->mutex);
 
-static ngx_int_t
-ngx_http_file_cache_delete_file(ngx_tree_ctx_t *ctx, ngx_str_t *path)
-{
-    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ctx->log, 0,
-                   "http file cache delete: \"%s\"", path->data);
+        st->size += shard->sh->size * shard->bsize;
+        st->count += shard->sh->count;
 
-    if (ngx_delete_file(path->data) == NGX_FILE_ERROR) {
-        ngx_log_error(NGX_LOG_CRIT, ctx->log, ngx_errno,
-                      ngx_delete_file_n " \"%s\" failed", path->data);
+        ngx_shmtx_unlock(&shard->shpool->mutex);
     }
 
     return NGX_OK;
 }
 
 
-static void
-ngx_http_file_cache_set_watermark(ngx_http_file_cache_t *cache)
+static ngx_http_file_cache_counters_t *
+ngx_http_file_cache_counters(ngx_http_file_cache_t *cache)
 {
-    cache->sh->watermark = cache->sh->count - cache->sh->count / 8;
-
-    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
-                   "http file cache watermark: %ui", cache->sh->watermark);
+    return &cache->sh->stats[ngx_worker % NGX_HTTP_CACHE_STATS_SLOTS].counters;
 }
 
 
@@ -2383,12 +5310,14 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     off_t                   max_size, min_free;
     u_char                 *last, *p;
     time_t                  inactive;
-    ssize_t                 size;
-    ngx_str_t               s, name, *value;
-    ngx_int_t               loader_files, manager_files;
+    time_t                  index_interval;
+    ssize_t                 size, mem_size, mem_max_object;
+    ngx_str_t               s, name, mem_name, index, *value;
+    ngx_int_t               loader_files, manager_files, shards;
     ngx_msec_t              loader_sleep, manager_sleep, loader_threshold,
                             manager_threshold;
-    ngx_uint_t              i, n, use_temp_path;
+    ngx_uint_t              i, n, use_temp_path, hugepages, slru, admission,
+                            key_hash;
     ngx_array_t            *caches;
     ngx_http_file_cache_t  *cache, **ce;
 
@@ -2403,6 +5332,11 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     use_temp_path = 1;
+    hugepages = 0;
+    slru = 0;
+    admission = 0;
+    shards = 1;
+    key_hash = NGX_HTTP_CACHE_KEY_MD5;
 
     inactive = 600;
 
@@ -2419,6 +5353,13 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     max_size = NGX_MAX_OFF_T_VALUE;
     min_free = 0;
 
+    mem_name.len = 0;
+    mem_size = 0;
+    mem_max_object = 65536;
+
+    index.len = 0;
+    index_interval = 3600;
+
     value = cf->args->elts;
 
     cache->path->name = value[1];
@@ -2489,6 +5430,49 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            hugepages = 1;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "eviction=", 9) == 0) {
+
+            if (ngx_strcmp(&value[i].data[9], "lru") == 0) {
+                slru = 0;
+
+            } else if (ngx_strcmp(&value[i].data[9], "slru") == 0) {
+                slru = 1;
+
+            } else {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid eviction value \"%V\", "
+                                   "it must be \"lru\" or \"slru\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "admission=", 10) == 0) {
+
+            if (ngx_strcmp(&value[i].data[10], "off") == 0) {
+                admission = 0;
+
+            } else if (ngx_strcmp(&value[i].data[10], "frequency") == 0) {
+                admission = 1;
+
+            } else {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid admission value \"%V\", "
+                                   "it must be \"off\" or \"frequency\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         if (ngx_strncmp(value[i].data, "keys_zone=", 10) == 0) {
 
             name.data = value[i].data + 10;
@@ -2523,6 +5507,118 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "key_hash=", 9) == 0) {
+
+            if (ngx_strcmp(&value[i].data[9], "md5") == 0) {
+                key_hash = NGX_HTTP_CACHE_KEY_MD5;
+
+            } else if (ngx_strcmp(&value[i].data[9], "murmur3") == 0) {
+                key_hash = NGX_HTTP_CACHE_KEY_MURMUR3;
+
+            } else {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid key_hash value \"%V\", "
+                                   "it must be \"md5\" or \"murmur3\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "shards=", 7) == 0) {
+
+            shards = ngx_atoi(value[i].data + 7, value[i].len - 7);
+            if (shards == NGX_ERROR || shards == 0 || shards > 64) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid shards value \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "mem_zone=", 9) == 0) {
+
+            mem_name.data = value[i].data + 9;
+
+            p = (u_char *) ngx_strchr(mem_name.data, ':');
+
+            if (p == NULL) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid memory zone size \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            mem_name.len = p - mem_name.data;
+
+            s.data = p + 1;
+            s.len = value[i].data + value[i].len - s.data;
+
+            mem_size = ngx_parse_size(&s);
+
+            if (mem_size == NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid memory zone size \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            if (mem_size < (ssize_t) (8 * ngx_pagesize)) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "memory zone \"%V\" is too small",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "mem_max_object=", 15) == 0) {
+
+            s.len = value[i].len - 15;
+            s.data = value[i].data + 15;
+
+            mem_max_object = ngx_parse_size(&s);
+            if (mem_max_object == NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid mem_max_object value \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "index=", 6) == 0) {
+
+            index.len = value[i].len - 6;
+            index.data = value[i].data + 6;
+
+            if (index.len == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid index \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "index_interval=", 15) == 0) {
+
+            s.len = value[i].len - 15;
+            s.data = value[i].data + 15;
+
+            index_interval = ngx_parse_time(&s, 1);
+            if (index_interval == (time_t) NGX_ERROR || index_interval == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid index_interval value \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         if (ngx_strncmp(value[i].data, "inactive=", 9) == 0) {
 
             s.len = value[i].len - 9;
@@ -2672,6 +5768,30 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    if (shards > 1) {
+
+        if (index.len) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"index\" cannot be used with \"shards\"");
+            return NGX_CONF_ERROR;
+        }
+
+        /* the keys zone size and max_size are divided between the shards */
+
+        size /= shards;
+
+        if (size < (ssize_t) (2 * ngx_pagesize)) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "keys zone \"%V\" is too small for %i shards",
+                               &name, shards);
+            return NGX_CONF_ERROR;
+        }
+
+        if (max_size != NGX_MAX_OFF_T_VALUE) {
+            max_size /= shards;
+        }
+    }
+
     cache->path->manager = ngx_http_file_cache_manager;
     cache->path->loader = ngx_http_file_cache_loader;
     cache->path->data = cache;
@@ -2701,13 +5821,80 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
 
     cache->shm_zone->init = ngx_http_file_cache_init;
+    cache->shm_zone->resize = ngx_http_file_cache_resize;
     cache->shm_zone->data = cache;
+    cache->shm_zone->shm.hugepages = hugepages;
+
+    if (mem_name.len) {
+
+        if (mem_max_object > mem_size / 4) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"mem_max_object\" must not exceed "
+                               "a quarter of the memory zone size");
+            return NGX_CONF_ERROR;
+        }
+
+        cache->mem_zone = ngx_shared_memory_add(cf, &mem_name, mem_size,
+                                                &ngx_http_file_cache_mem_tag);
+        if (cache->mem_zone == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        if (cache->mem_zone->data) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "duplicate zone \"%V\"", &mem_name);
+            return NGX_CONF_ERROR;
+        }
+
+        cache->mem_zone->init = ngx_http_file_cache_mem_init;
+        cache->mem_zone->data = cache;
+        cache->mem_zone->shm.hugepages = hugepages;
+
+        cache->mem_max_object = mem_max_object;
+    }
+
+    if (index.len) {
+        cache->index = ngx_pcalloc(cf->pool,
+                                   sizeof(ngx_http_file_cache_index_t));
+        if (cache->index == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        if (ngx_conf_full_name(cf->cycle, &index, 0) != NGX_OK) {
+            return NGX_CONF_ERROR;
+        }
+
+        cache->index->name = index;
+
+        cache->index->temp.len = index.len + sizeof(".tmp") - 1;
+        cache->index->temp.data = ngx_pnalloc(cf->pool,
+                                              cache->index->temp.len + 1);
+        if (cache->index->temp.data == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        ngx_sprintf(cache->index->temp.data, "%V.tmp%Z", &index);
+
+        cache->index->interval = index_interval;
+        cache->index->file.fd = NGX_INVALID_FILE;
+    }
 
     cache->use_temp_path = use_temp_path;
+    cache->slru = slru;
+    cache->admission = admission;
+    cache->key_hash = key_hash;
 
     cache->inactive = inactive;
     cache->max_size = max_size;
     cache->min_free = min_free;
+    cache->nshards = 1;
+
+    if (shards > 1
+        && ngx_http_file_cache_add_shards(cf, cache, shards, cmd->post)
+           != NGX_OK)
+    {
+        return NGX_CONF_ERROR;
+    }
 
     caches = (ngx_array_t *) (confp + cmd->offset);
 
@@ -2722,6 +5909,72 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+static ngx_int_t
+ngx_http_file_cache_add_shards(ngx_conf_t *cf, ngx_http_file_cache_t *cache,
+    ngx_uint_t n, void *tag)
+{
+    ngx_str_t               name;
+    ngx_uint_t              i;
+    ngx_shm_zone_t         *shm_zone;
+    ngx_http_file_cache_t  *shard;
+
+    /*
+     * each shard is a copy of the cache with its own keys zone,
+     * the zones are named "name#1", "name#2", and so on
+     */
+
+    cache->shards = ngx_palloc(cf->pool, n * sizeof(ngx_http_file_cache_t *));
+    if (cache->shards == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->shards[0] = cache;
+    cache->nshards = n;
+
+    shm_zone = cache->shm_zone;
+
+    for (i = 1; i < n; i++) {
+        shard = ngx_palloc(cf->pool, sizeof(ngx_http_file_cache_t));
+        if (shard == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(shard, cache, sizeof(ngx_http_file_cache_t));
+
+        name.len = shm_zone->shm.name.len + 1 + NGX_INT_T_LEN;
+
+        name.data = ngx_pnalloc(cf->pool, name.len);
+        if (name.data == NULL) {
+            return NGX_ERROR;
+        }
+
+        name.len = ngx_sprintf(name.data, "%V#%ui", &shm_zone->shm.name, i)
+                   - name.data;
+
+        shard->shm_zone = ngx_shared_memory_add(cf, &name, shm_zone->shm.size,
+                                                tag);
+        if (shard->shm_zone == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (shard->shm_zone->data) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "duplicate zone \"%V\"", &name);
+            return NGX_ERROR;
+        }
+
+        shard->shm_zone->init = ngx_http_file_cache_init;
+        shard->shm_zone->resize = ngx_http_file_cache_resize;
+        shard->shm_zone->data = shard;
+        shard->shm_zone->shm.hugepages = shm_zone->shm.hugepages;
+
+        cache->shards[i] = shard;
+    }
+
+    return NGX_OK;
+}
+
+
 char *
 ngx_http_file_cache_valid_set_slot(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf)
@@ -11,8 +11,9 @@
 #include <nginx.h>
 
 
+static ngx_int_t ngx_http_header_early_hints_filter(ngx_http_request_t *r,
+    ngx_list_t *headers);
 static ngx_int_t ngx_http_header_filter_init(ngx_conf_t *cf);
-static ngx_int_t ngx_http_header_filter(ngx_http_request_t *r);
 
 
 static ngx_http_module_t  ngx_http_header_filter_module_ctx = {
@@ -153,15 +154,15 @@ ngx_http_header_out_t  ngx_http_headers_out[] = {
 };
 
 
-static ngx_int_t
+ngx_int_t
 ngx_http_header_filter(ngx_http_request_t *r)
 {
     u_char                    *p;
-    size_t                     len;
-    ngx_str_t                  host, *status_line;
-    ngx_buf_t                 *b;
-    ngx_uint_t                 status, i, port;
-    ngx_chain_t                out;
+    size_t                     len, size, preset;
+    ngx_str_t                  host, *status_line, *block;
+    ngx_buf_t                 *b, *hb;
+    ngx_uint_t                 status, i, n, port;
+    ngx_chain_t                out, tail;
     ngx_list_part_t           *part;
     ngx_table_elt_t           *header;
     ngx_connection_t          *c;
@@ -412,6 +413,16 @@ ngx_http_header_filter(ngx_http_request_t *r)
     }
 #endif
 
+    /*
+     * the headers added by the headers filter module may come preformatted
+     * in a block which also includes the end of the header; the block is
+     * not used if some of the headers were changed since then
+     */
+
+    block = r->headers_out.header_block;
+    preset = 0;
+    n = 0;
+
     part = &r->headers_out.headers.part;
     header = part->elts;
 
@@ -427,12 +438,35 @@ ngx_http_header_filter(ngx_http_request_t *r)
             i = 0;
         }
 
+        if (block && &header[i] == r->headers_out.header_block_start) {
+            n = r->headers_out.header_block_n;
+        }
+
         if (header[i].hash == 0) {
+            if (n) {
+                block = NULL;
+                n--;
+            }
+
             continue;
         }
 
-        len += header[i].key.len + sizeof(": ") - 1 + header[i].value.len
+        size = header[i].key.len + sizeof(": ") - 1 + header[i].value.len
                + sizeof(CRLF) - 1;
+
+        len += size;
+
+        if (n) {
+            preset += size;
+            n--;
+        }
+    }
+
+    if (block && preset + sizeof(CRLF) - 1 == block->len) {
+        len -= block->len;
+
+    } else {
+        block = NULL;
     }
 
     b = ngx_create_temp_buf(r->pool, len);
@@ -595,6 +629,15 @@ ngx_http_header_filter(ngx_http_request_t *r)
             i = 0;
         }
 
+        if (block && &header[i] == r->headers_out.header_block_start) {
+            n = r->headers_out.header_block_n;
+        }
+
+        if (n) {
+            n--;
+            continue;
+        }
+
         if (header[i].hash == 0) {
             continue;
         }
@@ -606,18 +649,130 @@ ngx_http_header_filter(ngx_http_request_t *r)
         *b->last++ = CR; *b->last++ = LF;
     }
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "%*s", (size_t) (b->last - b->pos), b->pos);
+    out.buf = b;
+    out.next = NULL;
 
-    /* the end of HTTP header */
-    *b->last++ = CR; *b->last++ = LF;
+    if (block) {
+        hb = ngx_calloc_buf(r->pool);
+        if (hb == NULL) {
+            return NGX_ERROR;
+        }
+
+        hb->pos = block->data;
+        hb->last = block->data + block->len;
+        hb->memory = 1;
 
-    r->header_size = b->last - b->pos;
+        ngx_log_debug4(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                       "%*s%*s", (size_t) (b->last - b->pos), b->pos,
+                       block->len - 2, hb->pos);
+
+        r->header_size = b->last - b->pos + block->len;
+
+        tail.buf = hb;
+        tail.next = NULL;
+
+        out.next = &tail;
+
+        b = hb;
+
+    } else {
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                       "%*s", (size_t) (b->last - b->pos), b->pos);
+
+        /* the end of HTTP header */
+        *b->last++ = CR; *b->last++ = LF;
+
+        r->header_size = b->last - b->pos;
+    }
 
     if (r->header_only) {
         b->last_buf = 1;
     }
 
+    return ngx_http_write_filter(r, &out);
+}
+
+
+static ngx_int_t
+ngx_http_header_early_hints_filter(ngx_http_request_t *r, ngx_list_t *headers)
+{
+    size_t            len;
+    ngx_buf_t        *b;
+    ngx_uint_t        i;
+    ngx_chain_t       out;
+    ngx_list_part_t  *part;
+    ngx_table_elt_t  *header;
+
+    len = sizeof("HTTP/1.1 103 Early Hints" CRLF) - 1
+          /* the end of the header */
+          + sizeof(CRLF) - 1;
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        len += header[i].key.len + sizeof(": ") - 1 + header[i].value.len
+               + sizeof(CRLF) - 1;
+    }
+
+    b = ngx_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        return NGX_ERROR;
+    }
+
+    b->last = ngx_cpymem(b->last, "HTTP/1.1 103 Early Hints" CRLF,
+                         sizeof("HTTP/1.1 103 Early Hints" CRLF) - 1);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        b->last = ngx_copy(b->last, header[i].key.data, header[i].key.len);
+        *b->last++ = ':'; *b->last++ = ' ';
+
+        b->last = ngx_copy(b->last, header[i].value.data, header[i].value.len);
+        *b->last++ = CR; *b->last++ = LF;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "%*s", (size_t) (b->last - b->pos), b->pos);
+
+    *b->last++ = CR; *b->last++ = LF;
+
+    /* the interim response is not delayed until the response header */
+
+    b->flush = 1;
+
     out.buf = b;
     out.next = NULL;
 
@@ -629,6 +784,7 @@ static ngx_int_t
 ngx_http_header_filter_init(ngx_conf_t *cf)
 {
     ngx_http_top_header_filter = ngx_http_header_filter;
+    ngx_http_top_early_hints_filter = ngx_http_header_early_hints_filter;
 
     return NGX_OK;
 }
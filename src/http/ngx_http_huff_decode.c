@@ -18,8 +18,20 @@ typedef struct {
 } ngx_http_huff_decode_code_t;
 
 
+typedef struct {
+    u_char  bits;
+    u_char  emit;
+    u_char  sym[2];
+} ngx_http_huff_decode_fast_t;
+
+
+#define NGX_HTTP_HUFF_DECODE_FAST_BITS  11
+#define NGX_HTTP_HUFF_DECODE_FAST_MIN   8
+
+
 static ngx_inline ngx_int_t ngx_http_huff_decode_bits(u_char *state,
     u_char *ending, ngx_uint_t bits, u_char **dst);
+static size_t ngx_http_huff_decode_fast(u_char *src, size_t len, u_char **dst);
 
 
 static ngx_http_huff_decode_code_t  ngx_http_huff_decode_codes[256][16] =
@@ -2639,17 +2651,1076 @@ static ngx_http_huff_decode_code_t  ngx_http_huff_decode_codes[256][16] =
 };
 
 
+/*
+ * the symbols of the codes that fit into the next 11 bits, up to two,
+ * and the number of bits consumed; zero bits mean a longer code
+ */
+
+static ngx_http_huff_decode_fast_t
+    ngx_http_huff_decode_fast_codes[1 << NGX_HTTP_HUFF_DECODE_FAST_BITS] =
+{
+    {0x0a, 0x02, {0x30, 0x30}}, {0x0a, 0x02, {0x30, 0x30}},
+    {0x0a, 0x02, {0x30, 0x31}}, {0x0a, 0x02, {0x30, 0x31}},
+    {0x0a, 0x02, {0x30, 0x32}}, {0x0a, 0x02, {0x30, 0x32}},
+    {0x0a, 0x02, {0x30, 0x61}}, {0x0a, 0x02, {0x30, 0x61}},
+    {0x0a, 0x02, {0x30, 0x63}}, {0x0a, 0x02, {0x30, 0x63}},
+    {0x0a, 0x02, {0x30, 0x65}}, {0x0a, 0x02, {0x30, 0x65}},
+    {0x0a, 0x02, {0x30, 0x69}}, {0x0a, 0x02, {0x30, 0x69}},
+    {0x0a, 0x02, {0x30, 0x6f}}, {0x0a, 0x02, {0x30, 0x6f}},
+    {0x0a, 0x02, {0x30, 0x73}}, {0x0a, 0x02, {0x30, 0x73}},
+    {0x0a, 0x02, {0x30, 0x74}}, {0x0a, 0x02, {0x30, 0x74}},
+    {0x0b, 0x02, {0x30, 0x20}}, {0x0b, 0x02, {0x30, 0x25}},
+    {0x0b, 0x02, {0x30, 0x2d}}, {0x0b, 0x02, {0x30, 0x2e}},
+    {0x0b, 0x02, {0x30, 0x2f}}, {0x0b, 0x02, {0x30, 0x33}},
+    {0x0b, 0x02, {0x30, 0x34}}, {0x0b, 0x02, {0x30, 0x35}},
+    {0x0b, 0x02, {0x30, 0x36}}, {0x0b, 0x02, {0x30, 0x37}},
+    {0x0b, 0x02, {0x30, 0x38}}, {0x0b, 0x02, {0x30, 0x39}},
+    {0x0b, 0x02, {0x30, 0x3d}}, {0x0b, 0x02, {0x30, 0x41}},
+    {0x0b, 0x02, {0x30, 0x5f}}, {0x0b, 0x02, {0x30, 0x62}},
+    {0x0b, 0x02, {0x30, 0x64}}, {0x0b, 0x02, {0x30, 0x66}},
+    {0x0b, 0x02, {0x30, 0x67}}, {0x0b, 0x02, {0x30, 0x68}},
+    {0x0b, 0x02, {0x30, 0x6c}}, {0x0b, 0x02, {0x30, 0x6d}},
+    {0x0b, 0x02, {0x30, 0x6e}}, {0x0b, 0x02, {0x30, 0x70}},
+    {0x0b, 0x02, {0x30, 0x72}}, {0x0b, 0x02, {0x30, 0x75}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x05, 0x01, {0x30, 0x00}}, {0x05, 0x01, {0x30, 0x00}},
+    {0x0a, 0x02, {0x31, 0x30}}, {0x0a, 0x02, {0x31, 0x30}},
+    {0x0a, 0x02, {0x31, 0x31}}, {0x0a, 0x02, {0x31, 0x31}},
+    {0x0a, 0x02, {0x31, 0x32}}, {0x0a, 0x02, {0x31, 0x32}},
+    {0x0a, 0x02, {0x31, 0x61}}, {0x0a, 0x02, {0x31, 0x61}},
+    {0x0a, 0x02, {0x31, 0x63}}, {0x0a, 0x02, {0x31, 0x63}},
+    {0x0a, 0x02, {0x31, 0x65}}, {0x0a, 0x02, {0x31, 0x65}},
+    {0x0a, 0x02, {0x31, 0x69}}, {0x0a, 0x02, {0x31, 0x69}},
+    {0x0a, 0x02, {0x31, 0x6f}}, {0x0a, 0x02, {0x31, 0x6f}},
+    {0x0a, 0x02, {0x31, 0x73}}, {0x0a, 0x02, {0x31, 0x73}},
+    {0x0a, 0x02, {0x31, 0x74}}, {0x0a, 0x02, {0x31, 0x74}},
+    {0x0b, 0x02, {0x31, 0x20}}, {0x0b, 0x02, {0x31, 0x25}},
+    {0x0b, 0x02, {0x31, 0x2d}}, {0x0b, 0x02, {0x31, 0x2e}},
+    {0x0b, 0x02, {0x31, 0x2f}}, {0x0b, 0x02, {0x31, 0x33}},
+    {0x0b, 0x02, {0x31, 0x34}}, {0x0b, 0x02, {0x31, 0x35}},
+    {0x0b, 0x02, {0x31, 0x36}}, {0x0b, 0x02, {0x31, 0x37}},
+    {0x0b, 0x02, {0x31, 0x38}}, {0x0b, 0x02, {0x31, 0x39}},
+    {0x0b, 0x02, {0x31, 0x3d}}, {0x0b, 0x02, {0x31, 0x41}},
+    {0x0b, 0x02, {0x31, 0x5f}}, {0x0b, 0x02, {0x31, 0x62}},
+    {0x0b, 0x02, {0x31, 0x64}}, {0x0b, 0x02, {0x31, 0x66}},
+    {0x0b, 0x02, {0x31, 0x67}}, {0x0b, 0x02, {0x31, 0x68}},
+    {0x0b, 0x02, {0x31, 0x6c}}, {0x0b, 0x02, {0x31, 0x6d}},
+    {0x0b, 0x02, {0x31, 0x6e}}, {0x0b, 0x02, {0x31, 0x70}},
+    {0x0b, 0x02, {0x31, 0x72}}, {0x0b, 0x02, {0x31, 0x75}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x05, 0x01, {0x31, 0x00}}, {0x05, 0x01, {0x31, 0x00}},
+    {0x0a, 0x02, {0x32, 0x30}}, {0x0a, 0x02, {0x32, 0x30}},
+    {0x0a, 0x02, {0x32, 0x31}}, {0x0a, 0x02, {0x32, 0x31}},
+    {0x0a, 0x02, {0x32, 0x32}}, {0x0a, 0x02, {0x32, 0x32}},
+    {0x0a, 0x02, {0x32, 0x61}}, {0x0a, 0x02, {0x32, 0x61}},
+    {0x0a, 0x02, {0x32, 0x63}}, {0x0a, 0x02, {0x32, 0x63}},
+    {0x0a, 0x02, {0x32, 0x65}}, {0x0a, 0x02, {0x32, 0x65}},
+    {0x0a, 0x02, {0x32, 0x69}}, {0x0a, 0x02, {0x32, 0x69}},
+    {0x0a, 0x02, {0x32, 0x6f}}, {0x0a, 0x02, {0x32, 0x6f}},
+    {0x0a, 0x02, {0x32, 0x73}}, {0x0a, 0x02, {0x32, 0x73}},
+    {0x0a, 0x02, {0x32, 0x74}}, {0x0a, 0x02, {0x32, 0x74}},
+    {0x0b, 0x02, {0x32, 0x20}}, {0x0b, 0x02, {0x32, 0x25}},
+    {0x0b, 0x02, {0x32, 0x2d}}, {0x0b, 0x02, {0x32, 0x2e}},
+    {0x0b, 0x02, {0x32, 0x2f}}, {0x0b, 0x02, {0x32, 0x33}},
+    {0x0b, 0x02, {0x32, 0x34}}, {0x0b, 0x02, {0x32, 0x35}},
+    {0x0b, 0x02, {0x32, 0x36}}, {0x0b, 0x02, {0x32, 0x37}},
+    {0x0b, 0x02, {0x32, 0x38}}, {0x0b, 0x02, {0x32, 0x39}},
+    {0x0b, 0x02, {0x32, 0x3d}}, {0x0b, 0x02, {0x32, 0x41}},
+    {0x0b, 0x02, {0x32, 0x5f}}, {0x0b, 0x02, {0x32, 0x62}},
+    {0x0b, 0x02, {0x32, 0x64}}, {0x0b, 0x02, {0x32, 0x66}},
+    {0x0b, 0x02, {0x32, 0x67}}, {0x0b, 0x02, {0x32, 0x68}},
+    {0x0b, 0x02, {0x32, 0x6c}}, {0x0b, 0x02, {0x32, 0x6d}},
+    {0x0b, 0x02, {0x32, 0x6e}}, {0x0b, 0x02, {0x32, 0x70}},
+    {0x0b, 0x02, {0x32, 0x72}}, {0x0b, 0x02, {0x32, 0x75}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x05, 0x01, {0x32, 0x00}}, {0x05, 0x01, {0x32, 0x00}},
+    {0x0a, 0x02, {0x61, 0x30}}, {0x0a, 0x02, {0x61, 0x30}},
+    {0x0a, 0x02, {0x61, 0x31}}, {0x0a, 0x02, {0x61, 0x31}},
+    {0x0a, 0x02, {0x61, 0x32}}, {0x0a, 0x02, {0x61, 0x32}},
+    {0x0a, 0x02, {0x61, 0x61}}, {0x0a, 0x02, {0x61, 0x61}},
+    {0x0a, 0x02, {0x61, 0x63}}, {0x0a, 0x02, {0x61, 0x63}},
+    {0x0a, 0x02, {0x61, 0x65}}, {0x0a, 0x02, {0x61, 0x65}},
+    {0x0a, 0x02, {0x61, 0x69}}, {0x0a, 0x02, {0x61, 0x69}},
+    {0x0a, 0x02, {0x61, 0x6f}}, {0x0a, 0x02, {0x61, 0x6f}},
+    {0x0a, 0x02, {0x61, 0x73}}, {0x0a, 0x02, {0x61, 0x73}},
+    {0x0a, 0x02, {0x61, 0x74}}, {0x0a, 0x02, {0x61, 0x74}},
+    {0x0b, 0x02, {0x61, 0x20}}, {0x0b, 0x02, {0x61, 0x25}},
+    {0x0b, 0x02, {0x61, 0x2d}}, {0x0b, 0x02, {0x61, 0x2e}},
+    {0x0b, 0x02, {0x61, 0x2f}}, {0x0b, 0x02, {0x61, 0x33}},
+    {0x0b, 0x02, {0x61, 0x34}}, {0x0b, 0x02, {0x61, 0x35}},
+    {0x0b, 0x02, {0x61, 0x36}}, {0x0b, 0x02, {0x61, 0x37}},
+    {0x0b, 0x02, {0x61, 0x38}}, {0x0b, 0x02, {0x61, 0x39}},
+    {0x0b, 0x02, {0x61, 0x3d}}, {0x0b, 0x02, {0x61, 0x41}},
+    {0x0b, 0x02, {0x61, 0x5f}}, {0x0b, 0x02, {0x61, 0x62}},
+    {0x0b, 0x02, {0x61, 0x64}}, {0x0b, 0x02, {0x61, 0x66}},
+    {0x0b, 0x02, {0x61, 0x67}}, {0x0b, 0x02, {0x61, 0x68}},
+    {0x0b, 0x02, {0x61, 0x6c}}, {0x0b, 0x02, {0x61, 0x6d}},
+    {0x0b, 0x02, {0x61, 0x6e}}, {0x0b, 0x02, {0x61, 0x70}},
+    {0x0b, 0x02, {0x61, 0x72}}, {0x0b, 0x02, {0x61, 0x75}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x05, 0x01, {0x61, 0x00}}, {0x05, 0x01, {0x61, 0x00}},
+    {0x0a, 0x02, {0x63, 0x30}}, {0x0a, 0x02, {0x63, 0x30}},
+    {0x0a, 0x02, {0x63, 0x31}}, {0x0a, 0x02, {0x63, 0x31}},
+    {0x0a, 0x02, {0x63, 0x32}}, {0x0a, 0x02, {0x63, 0x32}},
+    {0x0a, 0x02, {0x63, 0x61}}, {0x0a, 0x02, {0x63, 0x61}},
+    {0x0a, 0x02, {0x63, 0x63}}, {0x0a, 0x02, {0x63, 0x63}},
+    {0x0a, 0x02, {0x63, 0x65}}, {0x0a, 0x02, {0x63, 0x65}},
+    {0x0a, 0x02, {0x63, 0x69}}, {0x0a, 0x02, {0x63, 0x69}},
+    {0x0a, 0x02, {0x63, 0x6f}}, {0x0a, 0x02, {0x63, 0x6f}},
+    {0x0a, 0x02, {0x63, 0x73}}, {0x0a, 0x02, {0x63, 0x73}},
+    {0x0a, 0x02, {0x63, 0x74}}, {0x0a, 0x02, {0x63, 0x74}},
+    {0x0b, 0x02, {0x63, 0x20}}, {0x0b, 0x02, {0x63, 0x25}},
+    {0x0b, 0x02, {0x63, 0x2d}}, {0x0b, 0x02, {0x63, 0x2e}},
+    {0x0b, 0x02, {0x63, 0x2f}}, {0x0b, 0x02, {0x63, 0x33}},
+    {0x0b, 0x02, {0x63, 0x34}}, {0x0b, 0x02, {0x63, 0x35}},
+    {0x0b, 0x02, {0x63, 0x36}}, {0x0b, 0x02, {0x63, 0x37}},
+    {0x0b, 0x02, {0x63, 0x38}}, {0x0b, 0x02, {0x63, 0x39}},
+    {0x0b, 0x02, {0x63, 0x3d}}, {0x0b, 0x02, {0x63, 0x41}},
+    {0x0b, 0x02, {0x63, 0x5f}}, {0x0b, 0x02, {0x63, 0x62}},
+    {0x0b, 0x02, {0x63, 0x64}}, {0x0b, 0x02, {0x63, 0x66}},
+    {0x0b, 0x02, {0x63, 0x67}}, {0x0b, 0x02, {0x63, 0x68}},
+    {0x0b, 0x02, {0x63, 0x6c}}, {0x0b, 0x02, {0x63, 0x6d}},
+    {0x0b, 0x02, {0x63, 0x6e}}, {0x0b, 0x02, {0x63, 0x70}},
+    {0x0b, 0x02, {0x63, 0x72}}, {0x0b, 0x02, {0x63, 0x75}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x05, 0x01, {0x63, 0x00}}, {0x05, 0x01, {0x63, 0x00}},
+    {0x0a, 0x02, {0x65, 0x30}}, {0x0a, 0x02, {0x65, 0x30}},
+    {0x0a, 0x02, {0x65, 0x31}}, {0x0a, 0x02, {0x65, 0x31}},
+    {0x0a, 0x02, {0x65, 0x32}}, {0x0a, 0x02, {0x65, 0x32}},
+    {0x0a, 0x02, {0x65, 0x61}}, {0x0a, 0x02, {0x65, 0x61}},
+    {0x0a, 0x02, {0x65, 0x63}}, {0x0a, 0x02, {0x65, 0x63}},
+    {0x0a, 0x02, {0x65, 0x65}}, {0x0a, 0x02, {0x65, 0x65}},
+    {0x0a, 0x02, {0x65, 0x69}}, {0x0a, 0x02, {0x65, 0x69}},
+    {0x0a, 0x02, {0x65, 0x6f}}, {0x0a, 0x02, {0x65, 0x6f}},
+    {0x0a, 0x02, {0x65, 0x73}}, {0x0a, 0x02, {0x65, 0x73}},
+    {0x0a, 0x02, {0x65, 0x74}}, {0x0a, 0x02, {0x65, 0x74}},
+    {0x0b, 0x02, {0x65, 0x20}}, {0x0b, 0x02, {0x65, 0x25}},
+    {0x0b, 0x02, {0x65, 0x2d}}, {0x0b, 0x02, {0x65, 0x2e}},
+    {0x0b, 0x02, {0x65, 0x2f}}, {0x0b, 0x02, {0x65, 0x33}},
+    {0x0b, 0x02, {0x65, 0x34}}, {0x0b, 0x02, {0x65, 0x35}},
+    {0x0b, 0x02, {0x65, 0x36}}, {0x0b, 0x02, {0x65, 0x37}},
+    {0x0b, 0x02, {0x65, 0x38}}, {0x0b, 0x02, {0x65, 0x39}},
+    {0x0b, 0x02, {0x65, 0x3d}}, {0x0b, 0x02, {0x65, 0x41}},
+    {0x0b, 0x02, {0x65, 0x5f}}, {0x0b, 0x02, {0x65, 0x62}},
+    {0x0b, 0x02, {0x65, 0x64}}, {0x0b, 0x02, {0x65, 0x66}},
+    {0x0b, 0x02, {0x65, 0x67}}, {0x0b, 0x02, {0x65, 0x68}},
+    {0x0b, 0x02, {0x65, 0x6c}}, {0x0b, 0x02, {0x65, 0x6d}},
+    {0x0b, 0x02, {0x65, 0x6e}}, {0x0b, 0x02, {0x65, 0x70}},
+    {0x0b, 0x02, {0x65, 0x72}}, {0x0b, 0x02, {0x65, 0x75}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x05, 0x01, {0x65, 0x00}}, {0x05, 0x01, {0x65, 0x00}},
+    {0x0a, 0x02, {0x69, 0x30}}, {0x0a, 0x02, {0x69, 0x30}},
+    {0x0a, 0x02, {0x69, 0x31}}, {0x0a, 0x02, {0x69, 0x31}},
+    {0x0a, 0x02, {0x69, 0x32}}, {0x0a, 0x02, {0x69, 0x32}},
+    {0x0a, 0x02, {0x69, 0x61}}, {0x0a, 0x02, {0x69, 0x61}},
+    {0x0a, 0x02, {0x69, 0x63}}, {0x0a, 0x02, {0x69, 0x63}},
+    {0x0a, 0x02, {0x69, 0x65}}, {0x0a, 0x02, {0x69, 0x65}},
+    {0x0a, 0x02, {0x69, 0x69}}, {0x0a, 0x02, {0x69, 0x69}},
+    {0x0a, 0x02, {0x69, 0x6f}}, {0x0a, 0x02, {0x69, 0x6f}},
+    {0x0a, 0x02, {0x69, 0x73}}, {0x0a, 0x02, {0x69, 0x73}},
+    {0x0a, 0x02, {0x69, 0x74}}, {0x0a, 0x02, {0x69, 0x74}},
+    {0x0b, 0x02, {0x69, 0x20}}, {0x0b, 0x02, {0x69, 0x25}},
+    {0x0b, 0x02, {0x69, 0x2d}}, {0x0b, 0x02, {0x69, 0x2e}},
+    {0x0b, 0x02, {0x69, 0x2f}}, {0x0b, 0x02, {0x69, 0x33}},
+    {0x0b, 0x02, {0x69, 0x34}}, {0x0b, 0x02, {0x69, 0x35}},
+    {0x0b, 0x02, {0x69, 0x36}}, {0x0b, 0x02, {0x69, 0x37}},
+    {0x0b, 0x02, {0x69, 0x38}}, {0x0b, 0x02, {0x69, 0x39}},
+    {0x0b, 0x02, {0x69, 0x3d}}, {0x0b, 0x02, {0x69, 0x41}},
+    {0x0b, 0x02, {0x69, 0x5f}}, {0x0b, 0x02, {0x69, 0x62}},
+    {0x0b, 0x02, {0x69, 0x64}}, {0x0b, 0x02, {0x69, 0x66}},
+    {0x0b, 0x02, {0x69, 0x67}}, {0x0b, 0x02, {0x69, 0x68}},
+    {0x0b, 0x02, {0x69, 0x6c}}, {0x0b, 0x02, {0x69, 0x6d}},
+    {0x0b, 0x02, {0x69, 0x6e}}, {0x0b, 0x02, {0x69, 0x70}},
+    {0x0b, 0x02, {0x69, 0x72}}, {0x0b, 0x02, {0x69, 0x75}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x05, 0x01, {0x69, 0x00}}, {0x05, 0x01, {0x69, 0x00}},
+    {0x0a, 0x02, {0x6f, 0x30}}, {0x0a, 0x02, {0x6f, 0x30}},
+    {0x0a, 0x02, {0x6f, 0x31}}, {0x0a, 0x02, {0x6f, 0x31}},
+    {0x0a, 0x02, {0x6f, 0x32}}, {0x0a, 0x02, {0x6f, 0x32}},
+    {0x0a, 0x02, {0x6f, 0x61}}, {0x0a, 0x02, {0x6f, 0x61}},
+    {0x0a, 0x02, {0x6f, 0x63}}, {0x0a, 0x02, {0x6f, 0x63}},
+    {0x0a, 0x02, {0x6f, 0x65}}, {0x0a, 0x02, {0x6f, 0x65}},
+    {0x0a, 0x02, {0x6f, 0x69}}, {0x0a, 0x02, {0x6f, 0x69}},
+    {0x0a, 0x02, {0x6f, 0x6f}}, {0x0a, 0x02, {0x6f, 0x6f}},
+    {0x0a, 0x02, {0x6f, 0x73}}, {0x0a, 0x02, {0x6f, 0x73}},
+    {0x0a, 0x02, {0x6f, 0x74}}, {0x0a, 0x02, {0x6f, 0x74}},
+    {0x0b, 0x02, {0x6f, 0x20}}, {0x0b, 0x02, {0x6f, 0x25}},
+    {0x0b, 0x02, {0x6f, 0x2d}}, {0x0b, 0x02, {0x6f, 0x2e}},
+    {0x0b, 0x02, {0x6f, 0x2f}}, {0x0b, 0x02, {0x6f, 0x33}},
+    {0x0b, 0x02, {0x6f, 0x34}}, {0x0b, 0x02, {0x6f, 0x35}},
+    {0x0b, 0x02, {0x6f, 0x36}}, {0x0b, 0x02, {0x6f, 0x37}},
+    {0x0b, 0x02, {0x6f, 0x38}}, {0x0b, 0x02, {0x6f, 0x39}},
+    {0x0b, 0x02, {0x6f, 0x3d}}, {0x0b, 0x02, {0x6f, 0x41}},
+    {0x0b, 0x02, {0x6f, 0x5f}}, {0x0b, 0x02, {0x6f, 0x62}},
+    {0x0b, 0x02, {0x6f, 0x64}}, {0x0b, 0x02, {0x6f, 0x66}},
+    {0x0b, 0x02, {0x6f, 0x67}}, {0x0b, 0x02, {0x6f, 0x68}},
+    {0x0b, 0x02, {0x6f, 0x6c}}, {0x0b, 0x02, {0x6f, 0x6d}},
+    {0x0b, 0x02, {0x6f, 0x6e}}, {0x0b, 0x02, {0x6f, 0x70}},
+    {0x0b, 0x02, {0x6f, 0x72}}, {0x0b, 0x02, {0x6f, 0x75}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x05, 0x01, {0x6f, 0x00}}, {0x05, 0x01, {0x6f, 0x00}},
+    {0x0a, 0x02, {0x73, 0x30}}, {0x0a, 0x02, {0x73, 0x30}},
+    {0x0a, 0x02, {0x73, 0x31}}, {0x0a, 0x02, {0x73, 0x31}},
+    {0x0a, 0x02, {0x73, 0x32}}, {0x0a, 0x02, {0x73, 0x32}},
+    {0x0a, 0x02, {0x73, 0x61}}, {0x0a, 0x02, {0x73, 0x61}},
+    {0x0a, 0x02, {0x73, 0x63}}, {0x0a, 0x02, {0x73, 0x63}},
+    {0x0a, 0x02, {0x73, 0x65}}, {0x0a, 0x02, {0x73, 0x65}},
+    {0x0a, 0x02, {0x73, 0x69}}, {0x0a, 0x02, {0x73, 0x69}},
+    {0x0a, 0x02, {0x73, 0x6f}}, {0x0a, 0x02, {0x73, 0x6f}},
+    {0x0a, 0x02, {0x73, 0x73}}, {0x0a, 0x02, {0x73, 0x73}},
+    {0x0a, 0x02, {0x73, 0x74}}, {0x0a, 0x02, {0x73, 0x74}},
+    {0x0b, 0x02, {0x73, 0x20}}, {0x0b, 0x02, {0x73, 0x25}},
+    {0x0b, 0x02, {0x73, 0x2d}}, {0x0b, 0x02, {0x73, 0x2e}},
+    {0x0b, 0x02, {0x73, 0x2f}}, {0x0b, 0x02, {0x73, 0x33}},
+    {0x0b, 0x02, {0x73, 0x34}}, {0x0b, 0x02, {0x73, 0x35}},
+    {0x0b, 0x02, {0x73, 0x36}}, {0x0b, 0x02, {0x73, 0x37}},
+    {0x0b, 0x02, {0x73, 0x38}}, {0x0b, 0x02, {0x73, 0x39}},
+    {0x0b, 0x02, {0x73, 0x3d}}, {0x0b, 0x02, {0x73, 0x41}},
+    {0x0b, 0x02, {0x73, 0x5f}}, {0x0b, 0x02, {0x73, 0x62}},
+    {0x0b, 0x02, {0x73, 0x64}}, {0x0b, 0x02, {0x73, 0x66}},
+    {0x0b, 0x02, {0x73, 0x67}}, {0x0b, 0x02, {0x73, 0x68}},
+    {0x0b, 0x02, {0x73, 0x6c}}, {0x0b, 0x02, {0x73, 0x6d}},
+    {0x0b, 0x02, {0x73, 0x6e}}, {0x0b, 0x02, {0x73, 0x70}},
+    {0x0b, 0x02, {0x73, 0x72}}, {0x0b, 0x02, {0x73, 0x75}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x05, 0x01, {0x73, 0x00}}, {0x05, 0x01, {0x73, 0x00}},
+    {0x0a, 0x02, {0x74, 0x30}}, {0x0a, 0x02, {0x74, 0x30}},
+    {0x0a, 0x02, {0x74, 0x31}}, {0x0a, 0x02, {0x74, 0x31}},
+    {0x0a, 0x02, {0x74, 0x32}}, {0x0a, 0x02, {0x74, 0x32}},
+    {0x0a, 0x02, {0x74, 0x61}}, {0x0a, 0x02, {0x74, 0x61}},
+    {0x0a, 0x02, {0x74, 0x63}}, {0x0a, 0x02, {0x74, 0x63}},
+    {0x0a, 0x02, {0x74, 0x65}}, {0x0a, 0x02, {0x74, 0x65}},
+    {0x0a, 0x02, {0x74, 0x69}}, {0x0a, 0x02, {0x74, 0x69}},
+    {0x0a, 0x02, {0x74, 0x6f}}, {0x0a, 0x02, {0x74, 0x6f}},
+    {0x0a, 0x02, {0x74, 0x73}}, {0x0a, 0x02, {0x74, 0x73}},
+    {0x0a, 0x02, {0x74, 0x74}}, {0x0a, 0x02, {0x74, 0x74}},
+    {0x0b, 0x02, {0x74, 0x20}}, {0x0b, 0x02, {0x74, 0x25}},
+    {0x0b, 0x02, {0x74, 0x2d}}, {0x0b, 0x02, {0x74, 0x2e}},
+    {0x0b, 0x02, {0x74, 0x2f}}, {0x0b, 0x02, {0x74, 0x33}},
+    {0x0b, 0x02, {0x74, 0x34}}, {0x0b, 0x02, {0x74, 0x35}},
+    {0x0b, 0x02, {0x74, 0x36}}, {0x0b, 0x02, {0x74, 0x37}},
+    {0x0b, 0x02, {0x74, 0x38}}, {0x0b, 0x02, {0x74, 0x39}},
+    {0x0b, 0x02, {0x74, 0x3d}}, {0x0b, 0x02, {0x74, 0x41}},
+    {0x0b, 0x02, {0x74, 0x5f}}, {0x0b, 0x02, {0x74, 0x62}},
+    {0x0b, 0x02, {0x74, 0x64}}, {0x0b, 0x02, {0x74, 0x66}},
+    {0x0b, 0x02, {0x74, 0x67}}, {0x0b, 0x02, {0x74, 0x68}},
+    {0x0b, 0x02, {0x74, 0x6c}}, {0x0b, 0x02, {0x74, 0x6d}},
+    {0x0b, 0x02, {0x74, 0x6e}}, {0x0b, 0x02, {0x74, 0x70}},
+    {0x0b, 0x02, {0x74, 0x72}}, {0x0b, 0x02, {0x74, 0x75}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x05, 0x01, {0x74, 0x00}}, {0x05, 0x01, {0x74, 0x00}},
+    {0x0b, 0x02, {0x20, 0x30}}, {0x0b, 0x02, {0x20, 0x31}},
+    {0x0b, 0x02, {0x20, 0x32}}, {0x0b, 0x02, {0x20, 0x61}},
+    {0x0b, 0x02, {0x20, 0x63}}, {0x0b, 0x02, {0x20, 0x65}},
+    {0x0b, 0x02, {0x20, 0x69}}, {0x0b, 0x02, {0x20, 0x6f}},
+    {0x0b, 0x02, {0x20, 0x73}}, {0x0b, 0x02, {0x20, 0x74}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x06, 0x01, {0x20, 0x00}}, {0x06, 0x01, {0x20, 0x00}},
+    {0x0b, 0x02, {0x25, 0x30}}, {0x0b, 0x02, {0x25, 0x31}},
+    {0x0b, 0x02, {0x25, 0x32}}, {0x0b, 0x02, {0x25, 0x61}},
+    {0x0b, 0x02, {0x25, 0x63}}, {0x0b, 0x02, {0x25, 0x65}},
+    {0x0b, 0x02, {0x25, 0x69}}, {0x0b, 0x02, {0x25, 0x6f}},
+    {0x0b, 0x02, {0x25, 0x73}}, {0x0b, 0x02, {0x25, 0x74}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x06, 0x01, {0x25, 0x00}}, {0x06, 0x01, {0x25, 0x00}},
+    {0x0b, 0x02, {0x2d, 0x30}}, {0x0b, 0x02, {0x2d, 0x31}},
+    {0x0b, 0x02, {0x2d, 0x32}}, {0x0b, 0x02, {0x2d, 0x61}},
+    {0x0b, 0x02, {0x2d, 0x63}}, {0x0b, 0x02, {0x2d, 0x65}},
+    {0x0b, 0x02, {0x2d, 0x69}}, {0x0b, 0x02, {0x2d, 0x6f}},
+    {0x0b, 0x02, {0x2d, 0x73}}, {0x0b, 0x02, {0x2d, 0x74}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x06, 0x01, {0x2d, 0x00}}, {0x06, 0x01, {0x2d, 0x00}},
+    {0x0b, 0x02, {0x2e, 0x30}}, {0x0b, 0x02, {0x2e, 0x31}},
+    {0x0b, 0x02, {0x2e, 0x32}}, {0x0b, 0x02, {0x2e, 0x61}},
+    {0x0b, 0x02, {0x2e, 0x63}}, {0x0b, 0x02, {0x2e, 0x65}},
+    {0x0b, 0x02, {0x2e, 0x69}}, {0x0b, 0x02, {0x2e, 0x6f}},
+    {0x0b, 0x02, {0x2e, 0x73}}, {0x0b, 0x02, {0x2e, 0x74}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x06, 0x01, {0x2e, 0x00}}, {0x06, 0x01, {0x2e, 0x00}},
+    {0x0b, 0x02, {0x2f, 0x30}}, {0x0b, 0x02, {0x2f, 0x31}},
+    {0x0b, 0x02, {0x2f, 0x32}}, {0x0b, 0x02, {0x2f, 0x61}},
+    {0x0b, 0x02, {0x2f, 0x63}}, {0x0b, 0x02, {0x2f, 0x65}},
+    {0x0b, 0x02, {0x2f, 0x69}}, {0x0b, 0x02, {0x2f, 0x6f}},
+    {0x0b, 0x02, {0x2f, 0x73}}, {0x0b, 0x02, {0x2f, 0x74}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x06, 0x01, {0x2f, 0x00}}, {0x06, 0x01, {0x2f, 0x00}},
+    {0x0b, 0x02, {0x33, 0x30}}, {0x0b, 0x02, {0x33, 0x31}},
+    {0x0b, 0x02, {0x33, 0x32}}, {0x0b, 0x02, {0x33, 0x61}},
+    {0x0b, 0x02, {0x33, 0x63}}, {0x0b, 0x02, {0x33, 0x65}},
+    {0x0b, 0x02, {0x33, 0x69}}, {0x0b, 0x02, {0x33, 0x6f}},
+    {0x0b, 0x02, {0x33, 0x73}}, {0x0b, 0x02, {0x33, 0x74}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x06, 0x01, {0x33, 0x00}}, {0x06, 0x01, {0x33, 0x00}},
+    {0x0b, 0x02, {0x34, 0x30}}, {0x0b, 0x02, {0x34, 0x31}},
+    {0x0b, 0x02, {0x34, 0x32}}, {0x0b, 0x02, {0x34, 0x61}},
+    {0x0b, 0x02, {0x34, 0x63}}, {0x0b, 0x02, {0x34, 0x65}},
+    {0x0b, 0x02, {0x34, 0x69}}, {0x0b, 0x02, {0x34, 0x6f}},
+    {0x0b, 0x02, {0x34, 0x73}}, {0x0b, 0x02, {0x34, 0x74}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x06, 0x01, {0x34, 0x00}}, {0x06, 0x01, {0x34, 0x00}},
+    {0x0b, 0x02, {0x35, 0x30}}, {0x0b, 0x02, {0x35, 0x31}},
+    {0x0b, 0x02, {0x35, 0x32}}, {0x0b, 0x02, {0x35, 0x61}},
+    {0x0b, 0x02, {0x35, 0x63}}, {0x0b, 0x02, {0x35, 0x65}},
+    {0x0b, 0x02, {0x35, 0x69}}, {0x0b, 0x02, {0x35, 0x6f}},
+    {0x0b, 0x02, {0x35, 0x73}}, {0x0b, 0x02, {0x35, 0x74}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x06, 0x01, {0x35, 0x00}}, {0x06, 0x01, {0x35, 0x00}},
+    {0x0b, 0x02, {0x36, 0x30}}, {0x0b, 0x02, {0x36, 0x31}},
+    {0x0b, 0x02, {0x36, 0x32}}, {0x0b, 0x02, {0x36, 0x61}},
+    {0x0b, 0x02, {0x36, 0x63}}, {0x0b, 0x02, {0x36, 0x65}},
+    {0x0b, 0x02, {0x36, 0x69}}, {0x0b, 0x02, {0x36, 0x6f}},
+    {0x0b, 0x02, {0x36, 0x73}}, {0x0b, 0x02, {0x36, 0x74}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x06, 0x01, {0x36, 0x00}}, {0x06, 0x01, {0x36, 0x00}},
+    {0x0b, 0x02, {0x37, 0x30}}, {0x0b, 0x02, {0x37, 0x31}},
+    {0x0b, 0x02, {0x37, 0x32}}, {0x0b, 0x02, {0x37, 0x61}},
+    {0x0b, 0x02, {0x37, 0x63}}, {0x0b, 0x02, {0x37, 0x65}},
+    {0x0b, 0x02, {0x37, 0x69}}, {0x0b, 0x02, {0x37, 0x6f}},
+    {0x0b, 0x02, {0x37, 0x73}}, {0x0b, 0x02, {0x37, 0x74}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x06, 0x01, {0x37, 0x00}}, {0x06, 0x01, {0x37, 0x00}},
+    {0x0b, 0x02, {0x38, 0x30}}, {0x0b, 0x02, {0x38, 0x31}},
+    {0x0b, 0x02, {0x38, 0x32}}, {0x0b, 0x02, {0x38, 0x61}},
+    {0x0b, 0x02, {0x38, 0x63}}, {0x0b, 0x02, {0x38, 0x65}},
+    {0x0b, 0x02, {0x38, 0x69}}, {0x0b, 0x02, {0x38, 0x6f}},
+    {0x0b, 0x02, {0x38, 0x73}}, {0x0b, 0x02, {0x38, 0x74}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x06, 0x01, {0x38, 0x00}}, {0x06, 0x01, {0x38, 0x00}},
+    {0x0b, 0x02, {0x39, 0x30}}, {0x0b, 0x02, {0x39, 0x31}},
+    {0x0b, 0x02, {0x39, 0x32}}, {0x0b, 0x02, {0x39, 0x61}},
+    {0x0b, 0x02, {0x39, 0x63}}, {0x0b, 0x02, {0x39, 0x65}},
+    {0x0b, 0x02, {0x39, 0x69}}, {0x0b, 0x02, {0x39, 0x6f}},
+    {0x0b, 0x02, {0x39, 0x73}}, {0x0b, 0x02, {0x39, 0x74}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x06, 0x01, {0x39, 0x00}}, {0x06, 0x01, {0x39, 0x00}},
+    {0x0b, 0x02, {0x3d, 0x30}}, {0x0b, 0x02, {0x3d, 0x31}},
+    {0x0b, 0x02, {0x3d, 0x32}}, {0x0b, 0x02, {0x3d, 0x61}},
+    {0x0b, 0x02, {0x3d, 0x63}}, {0x0b, 0x02, {0x3d, 0x65}},
+    {0x0b, 0x02, {0x3d, 0x69}}, {0x0b, 0x02, {0x3d, 0x6f}},
+    {0x0b, 0x02, {0x3d, 0x73}}, {0x0b, 0x02, {0x3d, 0x74}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x06, 0x01, {0x3d, 0x00}}, {0x06, 0x01, {0x3d, 0x00}},
+    {0x0b, 0x02, {0x41, 0x30}}, {0x0b, 0x02, {0x41, 0x31}},
+    {0x0b, 0x02, {0x41, 0x32}}, {0x0b, 0x02, {0x41, 0x61}},
+    {0x0b, 0x02, {0x41, 0x63}}, {0x0b, 0x02, {0x41, 0x65}},
+    {0x0b, 0x02, {0x41, 0x69}}, {0x0b, 0x02, {0x41, 0x6f}},
+    {0x0b, 0x02, {0x41, 0x73}}, {0x0b, 0x02, {0x41, 0x74}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x06, 0x01, {0x41, 0x00}}, {0x06, 0x01, {0x41, 0x00}},
+    {0x0b, 0x02, {0x5f, 0x30}}, {0x0b, 0x02, {0x5f, 0x31}},
+    {0x0b, 0x02, {0x5f, 0x32}}, {0x0b, 0x02, {0x5f, 0x61}},
+    {0x0b, 0x02, {0x5f, 0x63}}, {0x0b, 0x02, {0x5f, 0x65}},
+    {0x0b, 0x02, {0x5f, 0x69}}, {0x0b, 0x02, {0x5f, 0x6f}},
+    {0x0b, 0x02, {0x5f, 0x73}}, {0x0b, 0x02, {0x5f, 0x74}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x06, 0x01, {0x5f, 0x00}}, {0x06, 0x01, {0x5f, 0x00}},
+    {0x0b, 0x02, {0x62, 0x30}}, {0x0b, 0x02, {0x62, 0x31}},
+    {0x0b, 0x02, {0x62, 0x32}}, {0x0b, 0x02, {0x62, 0x61}},
+    {0x0b, 0x02, {0x62, 0x63}}, {0x0b, 0x02, {0x62, 0x65}},
+    {0x0b, 0x02, {0x62, 0x69}}, {0x0b, 0x02, {0x62, 0x6f}},
+    {0x0b, 0x02, {0x62, 0x73}}, {0x0b, 0x02, {0x62, 0x74}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x06, 0x01, {0x62, 0x00}}, {0x06, 0x01, {0x62, 0x00}},
+    {0x0b, 0x02, {0x64, 0x30}}, {0x0b, 0x02, {0x64, 0x31}},
+    {0x0b, 0x02, {0x64, 0x32}}, {0x0b, 0x02, {0x64, 0x61}},
+    {0x0b, 0x02, {0x64, 0x63}}, {0x0b, 0x02, {0x64, 0x65}},
+    {0x0b, 0x02, {0x64, 0x69}}, {0x0b, 0x02, {0x64, 0x6f}},
+    {0x0b, 0x02, {0x64, 0x73}}, {0x0b, 0x02, {0x64, 0x74}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x06, 0x01, {0x64, 0x00}}, {0x06, 0x01, {0x64, 0x00}},
+    {0x0b, 0x02, {0x66, 0x30}}, {0x0b, 0x02, {0x66, 0x31}},
+    {0x0b, 0x02, {0x66, 0x32}}, {0x0b, 0x02, {0x66, 0x61}},
+    {0x0b, 0x02, {0x66, 0x63}}, {0x0b, 0x02, {0x66, 0x65}},
+    {0x0b, 0x02, {0x66, 0x69}}, {0x0b, 0x02, {0x66, 0x6f}},
+    {0x0b, 0x02, {0x66, 0x73}}, {0x0b, 0x02, {0x66, 0x74}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x06, 0x01, {0x66, 0x00}}, {0x06, 0x01, {0x66, 0x00}},
+    {0x0b, 0x02, {0x67, 0x30}}, {0x0b, 0x02, {0x67, 0x31}},
+    {0x0b, 0x02, {0x67, 0x32}}, {0x0b, 0x02, {0x67, 0x61}},
+    {0x0b, 0x02, {0x67, 0x63}}, {0x0b, 0x02, {0x67, 0x65}},
+    {0x0b, 0x02, {0x67, 0x69}}, {0x0b, 0x02, {0x67, 0x6f}},
+    {0x0b, 0x02, {0x67, 0x73}}, {0x0b, 0x02, {0x67, 0x74}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x06, 0x01, {0x67, 0x00}}, {0x06, 0x01, {0x67, 0x00}},
+    {0x0b, 0x02, {0x68, 0x30}}, {0x0b, 0x02, {0x68, 0x31}},
+    {0x0b, 0x02, {0x68, 0x32}}, {0x0b, 0x02, {0x68, 0x61}},
+    {0x0b, 0x02, {0x68, 0x63}}, {0x0b, 0x02, {0x68, 0x65}},
+    {0x0b, 0x02, {0x68, 0x69}}, {0x0b, 0x02, {0x68, 0x6f}},
+    {0x0b, 0x02, {0x68, 0x73}}, {0x0b, 0x02, {0x68, 0x74}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x06, 0x01, {0x68, 0x00}}, {0x06, 0x01, {0x68, 0x00}},
+    {0x0b, 0x02, {0x6c, 0x30}}, {0x0b, 0x02, {0x6c, 0x31}},
+    {0x0b, 0x02, {0x6c, 0x32}}, {0x0b, 0x02, {0x6c, 0x61}},
+    {0x0b, 0x02, {0x6c, 0x63}}, {0x0b, 0x02, {0x6c, 0x65}},
+    {0x0b, 0x02, {0x6c, 0x69}}, {0x0b, 0x02, {0x6c, 0x6f}},
+    {0x0b, 0x02, {0x6c, 0x73}}, {0x0b, 0x02, {0x6c, 0x74}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x06, 0x01, {0x6c, 0x00}}, {0x06, 0x01, {0x6c, 0x00}},
+    {0x0b, 0x02, {0x6d, 0x30}}, {0x0b, 0x02, {0x6d, 0x31}},
+    {0x0b, 0x02, {0x6d, 0x32}}, {0x0b, 0x02, {0x6d, 0x61}},
+    {0x0b, 0x02, {0x6d, 0x63}}, {0x0b, 0x02, {0x6d, 0x65}},
+    {0x0b, 0x02, {0x6d, 0x69}}, {0x0b, 0x02, {0x6d, 0x6f}},
+    {0x0b, 0x02, {0x6d, 0x73}}, {0x0b, 0x02, {0x6d, 0x74}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x06, 0x01, {0x6d, 0x00}}, {0x06, 0x01, {0x6d, 0x00}},
+    {0x0b, 0x02, {0x6e, 0x30}}, {0x0b, 0x02, {0x6e, 0x31}},
+    {0x0b, 0x02, {0x6e, 0x32}}, {0x0b, 0x02, {0x6e, 0x61}},
+    {0x0b, 0x02, {0x6e, 0x63}}, {0x0b, 0x02, {0x6e, 0x65}},
+    {0x0b, 0x02, {0x6e, 0x69}}, {0x0b, 0x02, {0x6e, 0x6f}},
+    {0x0b, 0x02, {0x6e, 0x73}}, {0x0b, 0x02, {0x6e, 0x74}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x06, 0x01, {0x6e, 0x00}}, {0x06, 0x01, {0x6e, 0x00}},
+    {0x0b, 0x02, {0x70, 0x30}}, {0x0b, 0x02, {0x70, 0x31}},
+    {0x0b, 0x02, {0x70, 0x32}}, {0x0b, 0x02, {0x70, 0x61}},
+    {0x0b, 0x02, {0x70, 0x63}}, {0x0b, 0x02, {0x70, 0x65}},
+    {0x0b, 0x02, {0x70, 0x69}}, {0x0b, 0x02, {0x70, 0x6f}},
+    {0x0b, 0x02, {0x70, 0x73}}, {0x0b, 0x02, {0x70, 0x74}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x06, 0x01, {0x70, 0x00}}, {0x06, 0x01, {0x70, 0x00}},
+    {0x0b, 0x02, {0x72, 0x30}}, {0x0b, 0x02, {0x72, 0x31}},
+    {0x0b, 0x02, {0x72, 0x32}}, {0x0b, 0x02, {0x72, 0x61}},
+    {0x0b, 0x02, {0x72, 0x63}}, {0x0b, 0x02, {0x72, 0x65}},
+    {0x0b, 0x02, {0x72, 0x69}}, {0x0b, 0x02, {0x72, 0x6f}},
+    {0x0b, 0x02, {0x72, 0x73}}, {0x0b, 0x02, {0x72, 0x74}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x06, 0x01, {0x72, 0x00}}, {0x06, 0x01, {0x72, 0x00}},
+    {0x0b, 0x02, {0x75, 0x30}}, {0x0b, 0x02, {0x75, 0x31}},
+    {0x0b, 0x02, {0x75, 0x32}}, {0x0b, 0x02, {0x75, 0x61}},
+    {0x0b, 0x02, {0x75, 0x63}}, {0x0b, 0x02, {0x75, 0x65}},
+    {0x0b, 0x02, {0x75, 0x69}}, {0x0b, 0x02, {0x75, 0x6f}},
+    {0x0b, 0x02, {0x75, 0x73}}, {0x0b, 0x02, {0x75, 0x74}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x06, 0x01, {0x75, 0x00}}, {0x06, 0x01, {0x75, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x3a, 0x00}}, {0x07, 0x01, {0x3a, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x42, 0x00}}, {0x07, 0x01, {0x42, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x43, 0x00}}, {0x07, 0x01, {0x43, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x44, 0x00}}, {0x07, 0x01, {0x44, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x45, 0x00}}, {0x07, 0x01, {0x45, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x46, 0x00}}, {0x07, 0x01, {0x46, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x47, 0x00}}, {0x07, 0x01, {0x47, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x48, 0x00}}, {0x07, 0x01, {0x48, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x49, 0x00}}, {0x07, 0x01, {0x49, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4a, 0x00}}, {0x07, 0x01, {0x4a, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4b, 0x00}}, {0x07, 0x01, {0x4b, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4c, 0x00}}, {0x07, 0x01, {0x4c, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4d, 0x00}}, {0x07, 0x01, {0x4d, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4e, 0x00}}, {0x07, 0x01, {0x4e, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x4f, 0x00}}, {0x07, 0x01, {0x4f, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x50, 0x00}}, {0x07, 0x01, {0x50, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x51, 0x00}}, {0x07, 0x01, {0x51, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x52, 0x00}}, {0x07, 0x01, {0x52, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x53, 0x00}}, {0x07, 0x01, {0x53, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x54, 0x00}}, {0x07, 0x01, {0x54, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x55, 0x00}}, {0x07, 0x01, {0x55, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x56, 0x00}}, {0x07, 0x01, {0x56, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x57, 0x00}}, {0x07, 0x01, {0x57, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x59, 0x00}}, {0x07, 0x01, {0x59, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6a, 0x00}}, {0x07, 0x01, {0x6a, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x6b, 0x00}}, {0x07, 0x01, {0x6b, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x71, 0x00}}, {0x07, 0x01, {0x71, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x76, 0x00}}, {0x07, 0x01, {0x76, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x77, 0x00}}, {0x07, 0x01, {0x77, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x78, 0x00}}, {0x07, 0x01, {0x78, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x79, 0x00}}, {0x07, 0x01, {0x79, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x07, 0x01, {0x7a, 0x00}}, {0x07, 0x01, {0x7a, 0x00}},
+    {0x08, 0x01, {0x26, 0x00}}, {0x08, 0x01, {0x26, 0x00}},
+    {0x08, 0x01, {0x26, 0x00}}, {0x08, 0x01, {0x26, 0x00}},
+    {0x08, 0x01, {0x26, 0x00}}, {0x08, 0x01, {0x26, 0x00}},
+    {0x08, 0x01, {0x26, 0x00}}, {0x08, 0x01, {0x26, 0x00}},
+    {0x08, 0x01, {0x2a, 0x00}}, {0x08, 0x01, {0x2a, 0x00}},
+    {0x08, 0x01, {0x2a, 0x00}}, {0x08, 0x01, {0x2a, 0x00}},
+    {0x08, 0x01, {0x2a, 0x00}}, {0x08, 0x01, {0x2a, 0x00}},
+    {0x08, 0x01, {0x2a, 0x00}}, {0x08, 0x01, {0x2a, 0x00}},
+    {0x08, 0x01, {0x2c, 0x00}}, {0x08, 0x01, {0x2c, 0x00}},
+    {0x08, 0x01, {0x2c, 0x00}}, {0x08, 0x01, {0x2c, 0x00}},
+    {0x08, 0x01, {0x2c, 0x00}}, {0x08, 0x01, {0x2c, 0x00}},
+    {0x08, 0x01, {0x2c, 0x00}}, {0x08, 0x01, {0x2c, 0x00}},
+    {0x08, 0x01, {0x3b, 0x00}}, {0x08, 0x01, {0x3b, 0x00}},
+    {0x08, 0x01, {0x3b, 0x00}}, {0x08, 0x01, {0x3b, 0x00}},
+    {0x08, 0x01, {0x3b, 0x00}}, {0x08, 0x01, {0x3b, 0x00}},
+    {0x08, 0x01, {0x3b, 0x00}}, {0x08, 0x01, {0x3b, 0x00}},
+    {0x08, 0x01, {0x58, 0x00}}, {0x08, 0x01, {0x58, 0x00}},
+    {0x08, 0x01, {0x58, 0x00}}, {0x08, 0x01, {0x58, 0x00}},
+    {0x08, 0x01, {0x58, 0x00}}, {0x08, 0x01, {0x58, 0x00}},
+    {0x08, 0x01, {0x58, 0x00}}, {0x08, 0x01, {0x58, 0x00}},
+    {0x08, 0x01, {0x5a, 0x00}}, {0x08, 0x01, {0x5a, 0x00}},
+    {0x08, 0x01, {0x5a, 0x00}}, {0x08, 0x01, {0x5a, 0x00}},
+    {0x08, 0x01, {0x5a, 0x00}}, {0x08, 0x01, {0x5a, 0x00}},
+    {0x08, 0x01, {0x5a, 0x00}}, {0x08, 0x01, {0x5a, 0x00}},
+    {0x0a, 0x01, {0x21, 0x00}}, {0x0a, 0x01, {0x21, 0x00}},
+    {0x0a, 0x01, {0x22, 0x00}}, {0x0a, 0x01, {0x22, 0x00}},
+    {0x0a, 0x01, {0x28, 0x00}}, {0x0a, 0x01, {0x28, 0x00}},
+    {0x0a, 0x01, {0x29, 0x00}}, {0x0a, 0x01, {0x29, 0x00}},
+    {0x0a, 0x01, {0x3f, 0x00}}, {0x0a, 0x01, {0x3f, 0x00}},
+    {0x0b, 0x01, {0x27, 0x00}}, {0x0b, 0x01, {0x2b, 0x00}},
+    {0x0b, 0x01, {0x7c, 0x00}}, {0x00, 0x00, {0x00, 0x00}},
+    {0x00, 0x00, {0x00, 0x00}}, {0x00, 0x00, {0x00, 0x00}}
+};
+
+
 ngx_int_t
 ngx_http_huff_decode(u_char *state, u_char *src, size_t len, u_char **dst,
     ngx_uint_t last, ngx_log_t *log)
 {
     u_char  *end, ch, ending;
+    size_t   n;
 
     ch = 0;
     ending = 1;
 
     end = src + len;
 
+    if (*state == 0 && len >= NGX_HTTP_HUFF_DECODE_FAST_MIN) {
+
+        /* the fast path stops at a symbol boundary aligned to 4 bits */
+
+        n = ngx_http_huff_decode_fast(src, len, dst);
+
+        src += n / 8;
+
+        if (n % 8) {
+            ch = *src++;
+
+            if (ngx_http_huff_decode_bits(state, &ending, ch & 0xf, dst)
+                != NGX_OK)
+            {
+                ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
+                               "http huffman decoding error at state %d: "
+                               "bad code 0x%Xd", *state, ch & 0xf);
+
+                return NGX_ERROR;
+            }
+        }
+    }
+
     while (src != end) {
         ch = *src++;
 
@@ -2712,3 +3783,67 @@ ngx_http_huff_decode_bits(u_char *state, u_char *ending, ngx_uint_t bits,
 
     return NGX_OK;
 }
+
+
+static size_t
+ngx_http_huff_decode_fast(u_char *src, size_t len, u_char **dst)
+{
+    u_char                       *end, *d, *last;
+    size_t                        pos, aligned;
+    uint64_t                      buf;
+    ngx_uint_t                    bits;
+    ngx_http_huff_decode_fast_t  *code;
+
+    end = src + len;
+
+    d = *dst;
+    last = d;
+
+    buf = 0;
+    bits = 0;
+    pos = 0;
+    aligned = 0;
+
+    for ( ;; ) {
+
+        while (bits <= 56 && src != end) {
+            buf |= (uint64_t) *src++ << (56 - bits);
+            bits += 8;
+        }
+
+        if (bits < NGX_HTTP_HUFF_DECODE_FAST_BITS) {
+            break;
+        }
+
+        code = &ngx_http_huff_decode_fast_codes
+                    [buf >> (64 - NGX_HTTP_HUFF_DECODE_FAST_BITS)];
+
+        if (code->bits == 0) {
+            break;
+        }
+
+        /*
+         * the second symbol is stored unconditionally: the destination
+         * has room for one symbol per 5 bits of input, the shortest code
+         */
+
+        d[0] = code->sym[0];
+        d[1] = code->sym[1];
+        d += code->emit;
+
+        buf <<= code->bits;
+        bits -= code->bits;
+        pos += code->bits;
+
+        if (pos % 4 == 0) {
+            aligned = pos;
+            last = d;
+        }
+    }
+
+    /* the rest is decoded by the state machine */
+
+    *dst = last;
+
+    return aligned;
+}
@@ -210,6 +210,19 @@ ngx_http_huff_encode(u_char *src, size_t len, u_char *dst, ngx_uint_t lower)
         code = next->code;
         pending += next->len;
 
+#if (NGX_PTR_SIZE == 8)
+
+        /* two codes of up to 30 bits are appended to the buffer at once */
+
+        if (src != end) {
+            next = &table[*src++];
+
+            code = (code << next->len) | next->code;
+            pending += next->len;
+        }
+
+#endif
+
         /* accumulate bits */
         if (pending < sizeof(buf) * 8) {
             buf |= code << (sizeof(buf) * 8 - pending);
@@ -9,6 +9,17 @@
 #include <ngx_core.h>
 #include <ngx_http.h>
 
+#if (NGX_HAVE_SSE2)
+#include <emmintrin.h>
+#elif (NGX_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+static ngx_inline u_char *ngx_http_parse_skip_value(u_char *p, u_char *last);
+#endif
+
 
 static uint32_t  usual[] = {
     0x00000000, /* 0000 0000 0000 0000  0000 0000 0000 0000 */
@@ -994,6 +1005,20 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
 
         /* header value */
         case sw_value:
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+            p = ngx_http_parse_skip_value(p, b->last);
+
+            if (p == b->last) {
+                p--;
+                break;
+            }
+
+            ch = *p;
+
+#endif
+
             switch (ch) {
             case ' ':
                 r->header_end = p;
@@ -2413,3 +2438,68 @@ invalid:
 
     return NGX_ERROR;
 }
+
+
+#if (NGX_HAVE_SSE2 || NGX_HAVE_NEON)
+
+/*
+ * skips 16 bytes at a time up to a byte which may end the header value,
+ * that is, a space or a control character; the rest is left
+ * to the state machine
+ */
+
+static ngx_inline u_char *
+ngx_http_parse_skip_value(u_char *p, u_char *last)
+{
+#if (NGX_HAVE_SSE2)
+
+    int       mask;
+    __m128i   v, space;
+
+    space = _mm_set1_epi8(' ');
+
+    while (last - p >= 16) {
+        v = _mm_loadu_si128((const __m128i *) p);
+
+        /* v <= ' ' */
+
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, space), v));
+
+        if (mask) {
+            while (!(mask & 1)) {
+                mask >>= 1;
+                p++;
+            }
+
+            return p;
+        }
+
+        p += 16;
+    }
+
+#else /* NGX_HAVE_NEON */
+
+    uint8x16_t  v, space;
+
+    space = vdupq_n_u8(' ');
+
+    while (last - p >= 16) {
+        v = vld1q_u8(p);
+
+        if (vmaxvq_u8(vcleq_u8(v, space))) {
+            while (*p > ' ') {
+                p++;
+            }
+
+            return p;
+        }
+
+        p += 16;
+    }
+
+#endif
+
+    return p;
+}
+
+#endif
@@ -10,13 +10,45 @@
 #include <ngx_http.h>
 
 
+typedef struct {
+    size_t                     buffer_size;
+} ngx_http_postpone_conf_t;
+
+
+typedef struct {
+    size_t                     size;
+    ngx_temp_file_t           *temp_file;
+} ngx_http_postpone_ctx_t;
+
+
 static ngx_int_t ngx_http_postpone_filter_add(ngx_http_request_t *r,
     ngx_chain_t *in);
+static ngx_int_t ngx_http_postpone_filter_limit(ngx_http_request_t *r,
+    ngx_chain_t **ll, ngx_chain_t *in, ngx_http_postpone_conf_t *conf);
+static ngx_int_t ngx_http_postpone_filter_spill(ngx_http_request_t *r,
+    ngx_http_postpone_ctx_t *ctx, ngx_chain_t **ll, ngx_chain_t *in);
+static size_t ngx_http_postpone_filter_memory(ngx_chain_t *in);
 static ngx_int_t ngx_http_postpone_filter_in_memory(ngx_http_request_t *r,
     ngx_chain_t *in);
+static void *ngx_http_postpone_create_conf(ngx_conf_t *cf);
+static char *ngx_http_postpone_merge_conf(ngx_conf_t *cf, void *parent,
+    void *child);
 static ngx_int_t ngx_http_postpone_filter_init(ngx_conf_t *cf);
 
 
+static ngx_command_t  ngx_http_postpone_filter_commands[] = {
+
+    { ngx_string("postponed_output_buffer_size"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_postpone_conf_t, buffer_size),
+      NULL },
+
+      ngx_null_command
+};
+
+
 static ngx_http_module_t  ngx_http_postpone_filter_module_ctx = {
     NULL,                                  /* preconfiguration */
     ngx_http_postpone_filter_init,         /* postconfiguration */
@@ -27,15 +59,15 @@ static ngx_http_module_t  ngx_http_postpone_filter_module_ctx = {
     NULL,                                  /* create server configuration */
     NULL,                                  /* merge server configuration */
 
-    NULL,                                  /* create location configuration */
-    NULL                                   /* merge location configuration */
+    ngx_http_postpone_create_conf,         /* create location configuration */
+    ngx_http_postpone_merge_conf           /* merge location configuration */
 };
 
 
 ngx_module_t  ngx_http_postpone_filter_module = {
     NGX_MODULE_V1,
     &ngx_http_postpone_filter_module_ctx,  /* module context */
-    NULL,                                  /* module directives */
+    ngx_http_postpone_filter_commands,     /* module directives */
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
@@ -54,7 +86,9 @@ static ngx_http_output_body_filter_pt    ngx_http_next_body_filter;
 static ngx_int_t
 ngx_http_postpone_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
+    size_t                         size;
     ngx_connection_t              *c;
+    ngx_http_postpone_ctx_t       *ctx;
     ngx_http_postponed_request_t  *pr;
 
     c = r->connection;
@@ -125,6 +159,14 @@ ngx_http_postpone_filter(ngx_http_request_t *r, ngx_chain_t *in)
                            "http postpone filter output \"%V?%V\"",
                            &r->uri, &r->args);
 
+            ctx = ngx_http_get_module_ctx(r->main,
+                                          ngx_http_postpone_filter_module);
+
+            if (ctx) {
+                size = ngx_http_postpone_filter_memory(pr->out);
+                ctx->size -= ngx_min(size, ctx->size);
+            }
+
             if (ngx_http_next_body_filter(r->main, pr->out) == NGX_ERROR) {
                 return NGX_ERROR;
             }
@@ -141,6 +183,7 @@ ngx_http_postpone_filter(ngx_http_request_t *r, ngx_chain_t *in)
 static ngx_int_t
 ngx_http_postpone_filter_add(ngx_http_request_t *r, ngx_chain_t *in)
 {
+    ngx_http_postpone_conf_t      *conf;
     ngx_http_postponed_request_t  *pr, **ppr;
 
     if (r->postponed) {
@@ -169,6 +212,13 @@ ngx_http_postpone_filter_add(ngx_http_request_t *r, ngx_chain_t *in)
 
 found:
 
+    conf = ngx_http_get_module_loc_conf(r->main,
+                                        ngx_http_postpone_filter_module);
+
+    if (conf->buffer_size) {
+        return ngx_http_postpone_filter_limit(r, &pr->out, in, conf);
+    }
+
     if (ngx_chain_add_copy(r->pool, &pr->out, in) == NGX_OK) {
         return NGX_OK;
     }
@@ -177,6 +227,191 @@ found:
 }
 
 
+static ngx_int_t
+ngx_http_postpone_filter_limit(ngx_http_request_t *r, ngx_chain_t **ll,
+    ngx_chain_t *in, ngx_http_postpone_conf_t *conf)
+{
+    size_t                    size;
+    ngx_http_request_t       *mr;
+    ngx_http_postpone_ctx_t  *ctx;
+
+    mr = r->main;
+
+    ctx = ngx_http_get_module_ctx(mr, ngx_http_postpone_filter_module);
+
+    if (ctx == NULL) {
+        ctx = ngx_pcalloc(r->pool, sizeof(ngx_http_postpone_ctx_t));
+        if (ctx == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_http_set_ctx(mr, ctx, ngx_http_postpone_filter_module);
+    }
+
+    size = ngx_http_postpone_filter_memory(in);
+
+    /*
+     * output postponed by the subrequests of a request is kept in memory
+     * up to postponed_output_buffer_size, and then written to a temporary
+     * file; this is only possible if the filters which follow may handle
+     * the output in a file, much like the copy filter decides
+     */
+
+    if (ctx->size + size <= conf->buffer_size
+        || !r->connection->sendfile
+        || mr->main_filter_need_in_memory)
+    {
+        if (ngx_chain_add_copy(r->pool, ll, in) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        ctx->size += size;
+
+        return NGX_OK;
+    }
+
+    return ngx_http_postpone_filter_spill(r, ctx, ll, in);
+}
+
+
+static ngx_int_t
+ngx_http_postpone_filter_spill(ngx_http_request_t *r,
+    ngx_http_postpone_ctx_t *ctx, ngx_chain_t **ll, ngx_chain_t *in)
+{
+    off_t                      offset;
+    ssize_t                    n;
+    ngx_buf_t                 *b, *fb;
+    ngx_chain_t                one, *cl;
+    ngx_temp_file_t           *tf;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    tf = ctx->temp_file;
+
+    if (tf == NULL) {
+        tf = ngx_pcalloc(r->pool, sizeof(ngx_temp_file_t));
+        if (tf == NULL) {
+            return NGX_ERROR;
+        }
+
+        clcf = ngx_http_get_module_loc_conf(r->main, ngx_http_core_module);
+
+        tf->file.fd = NGX_INVALID_FILE;
+        tf->file.log = r->connection->log;
+        tf->path = clcf->client_body_temp_path;
+        tf->pool = r->pool;
+        tf->warn = "postponed output is buffered to a temporary file";
+        tf->log_level = NGX_LOG_WARN;
+
+        ctx->temp_file = tf;
+    }
+
+    fb = NULL;
+
+    for (cl = *ll; cl; cl = cl->next) {
+        fb = cl->buf;
+        ll = &cl->next;
+    }
+
+    for ( /* void */ ; in; in = in->next) {
+        b = in->buf;
+
+        if (!ngx_buf_in_memory(b) || b->in_file || ngx_buf_special(b)) {
+
+            cl = ngx_alloc_chain_link(r->pool);
+            if (cl == NULL) {
+                return NGX_ERROR;
+            }
+
+            cl->buf = b;
+            *ll = cl;
+            ll = &cl->next;
+
+            fb = b;
+
+            continue;
+        }
+
+        offset = tf->offset;
+
+        one.buf = b;
+        one.next = NULL;
+
+        n = ngx_write_chain_to_temp_file(tf, &one);
+
+        if (n == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        tf->offset += n;
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http postpone filter spill %O bytes at %O",
+                       (off_t) (b->last - b->pos), offset);
+
+        /* neighbouring buffers are coalesced */
+
+        if (fb == NULL
+            || fb->tag != (ngx_buf_tag_t) &ngx_http_postpone_filter_module
+            || fb->file_last != offset
+            || fb->flush
+            || fb->last_in_chain
+            || fb->last_buf)
+        {
+            fb = ngx_calloc_buf(r->pool);
+            if (fb == NULL) {
+                return NGX_ERROR;
+            }
+
+            fb->in_file = 1;
+            fb->file = &tf->file;
+            fb->file_pos = offset;
+            fb->file_last = offset;
+            fb->tag = (ngx_buf_tag_t) &ngx_http_postpone_filter_module;
+
+            cl = ngx_alloc_chain_link(r->pool);
+            if (cl == NULL) {
+                return NGX_ERROR;
+            }
+
+            cl->buf = fb;
+            *ll = cl;
+            ll = &cl->next;
+        }
+
+        fb->file_last += b->last - b->pos;
+
+        fb->flush = b->flush;
+        fb->last_in_chain = b->last_in_chain;
+        fb->last_buf = b->last_buf;
+
+        /* the buffer may be reused */
+
+        b->pos = b->last;
+    }
+
+    *ll = NULL;
+
+    return NGX_OK;
+}
+
+
+static size_t
+ngx_http_postpone_filter_memory(ngx_chain_t *in)
+{
+    size_t  size;
+
+    size = 0;
+
+    for ( /* void */ ; in; in = in->next) {
+        if (ngx_buf_in_memory(in->buf) && !in->buf->in_file) {
+            size += in->buf->last - in->buf->pos;
+        }
+    }
+
+    return size;
+}
+
+
 static ngx_int_t
 ngx_http_postpone_filter_in_memory(ngx_http_request_t *r, ngx_chain_t *in)
 {
@@ -249,6 +484,34 @@ ngx_http_postpone_filter_in_memory(ngx_http_request_t *r, ngx_chain_t *in)
 }
 
 
+static void *
+ngx_http_postpone_create_conf(ngx_conf_t *cf)
+{
+    ngx_http_postpone_conf_t  *conf;
+
+    conf = ngx_palloc(cf->pool, sizeof(ngx_http_postpone_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->buffer_size = NGX_CONF_UNSET_SIZE;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_postpone_merge_conf(ngx_conf_t *cf, void *parent, void *child)
+{
+    ngx_http_postpone_conf_t *prev = parent;
+    ngx_http_postpone_conf_t *conf = child;
+
+    ngx_conf_merge_size_value(conf->buffer_size, prev->buffer_size, 0);
+
+    return NGX_CONF_OK;
+}
+
+
 static ngx_int_t
 ngx_http_postpone_filter_init(ngx_conf_t *cf)
 {
@@ -11,7 +11,8 @@
 
 
 static void ngx_http_wait_request_handler(ngx_event_t *ev);
-static ngx_http_request_t *ngx_http_alloc_request(ngx_connection_t *c);
+static ngx_http_request_t *ngx_http_alloc_request(ngx_connection_t *c,
+    ngx_pool_t *pool);
 static void ngx_http_process_request_line(ngx_event_t *rev);
 static void ngx_http_process_request_headers(ngx_event_t *rev);
 static ssize_t ngx_http_read_request_header(ngx_http_request_t *r);
@@ -43,10 +44,16 @@ static void ngx_http_request_finalizer(ngx_http_request_t *r);
 
 static void ngx_http_set_keepalive(ngx_http_request_t *r);
 static void ngx_http_keepalive_handler(ngx_event_t *ev);
+#if !(NGX_WIN32)
+static ngx_int_t ngx_http_keepalive_handoff(ngx_connection_t *c);
+#endif
 static void ngx_http_set_lingering_close(ngx_connection_t *c);
 static void ngx_http_lingering_close_handler(ngx_event_t *ev);
 static ngx_int_t ngx_http_post_action(ngx_http_request_t *r);
 static void ngx_http_log_request(ngx_http_request_t *r);
+static size_t ngx_http_request_pool_size(ngx_http_core_srv_conf_t *cscf);
+static void ngx_http_request_pool_update(ngx_http_request_t *r,
+    ngx_pool_t *pool);
 
 static u_char *ngx_http_log_error(ngx_log_t *log, u_char *buf, size_t len);
 static u_char *ngx_http_log_error_handler(ngx_http_request_t *r,
@@ -341,7 +348,7 @@ ngx_http_init_connection(ngx_connection_t *c)
     if (rev->ready) {
         /* the deferred accept(), iocp */
 
-        if (ngx_use_accept_mutex) {
+        if (ngx_use_accept_mutex || rev->low_priority) {
             ngx_post_event(rev, &ngx_posted_events);
             return;
         }
@@ -526,18 +533,28 @@ ngx_http_wait_request_handler(ngx_event_t *rev)
 
 ngx_http_request_t *
 ngx_http_create_request(ngx_connection_t *c)
+{
+    return ngx_http_create_request_in_pool(c, NULL);
+}
+
+
+ngx_http_request_t *
+ngx_http_create_request_in_pool(ngx_connection_t *c, ngx_pool_t *pool)
 {
     ngx_http_request_t        *r;
     ngx_http_log_ctx_t        *ctx;
     ngx_http_core_loc_conf_t  *clcf;
 
-    r = ngx_http_alloc_request(c);
+    r = ngx_http_alloc_request(c, pool);
     if (r == NULL) {
         return NULL;
     }
 
     c->requests++;
 
+    c->read->low_priority = 0;
+    c->write->low_priority = 0;
+
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     ngx_set_connection_log(c, clcf->error_log);
@@ -557,9 +574,8 @@ ngx_http_create_request(ngx_connection_t *c)
 
 
 static ngx_http_request_t *
-ngx_http_alloc_request(ngx_connection_t *c)
+ngx_http_alloc_request(ngx_connection_t *c, ngx_pool_t *pool)
 {
-    ngx_pool_t                 *pool;
     ngx_time_t                 *tp;
     ngx_http_request_t         *r;
     ngx_http_connection_t      *hc;
@@ -570,9 +586,11 @@ ngx_http_alloc_request(ngx_connection_t *c)
 
     cscf = ngx_http_get_module_srv_conf(hc->conf_ctx, ngx_http_core_module);
 
-    pool = ngx_create_pool(cscf->request_pool_size, c->log);
     if (pool == NULL) {
-        return NULL;
+        pool = ngx_create_pool(ngx_http_request_pool_size(cscf), c->log);
+        if (pool == NULL) {
+            return NULL;
+        }
     }
 
     r = ngx_pcalloc(pool, sizeof(ngx_http_request_t));
@@ -639,6 +657,10 @@ ngx_http_alloc_request(ngx_connection_t *c)
     r->start_sec = tp->sec;
     r->start_msec = tp->msec;
 
+    if (cmcf->precise_timing) {
+        r->start_usec = ngx_monotonic_usec();
+    }
+
     r->method = NGX_HTTP_UNKNOWN;
     r->http_version = NGX_HTTP_VERSION_10;
 
@@ -948,6 +970,8 @@ ngx_http_ssl_servername(ngx_ssl_conn_t *ssl_conn, int *ad, void *arg)
     sscf = ngx_http_get_module_srv_conf(hc->conf_ctx, ngx_http_ssl_module);
 
     c->ssl->buffer_size = sscf->buffer_size;
+    c->ssl->dynamic_records = sscf->dynamic_records;
+    c->ssl->dynamic_threshold = sscf->dynamic_records_threshold;
 
     if (sscf->ssl.ctx) {
         if (SSL_set_SSL_CTX(ssl_conn, sscf->ssl.ctx) == NULL) {
@@ -1024,7 +1048,7 @@ ngx_http_ssl_certificate(ngx_ssl_conn_t *ssl_conn, void *arg)
         return 0;
     }
 
-    r = ngx_http_alloc_request(c);
+    r = ngx_http_alloc_request(c, NULL);
     if (r == NULL) {
         return 0;
     }
@@ -1054,7 +1078,8 @@ ngx_http_ssl_certificate(ngx_ssl_conn_t *ssl_conn, void *arg)
                        "ssl key: \"%s\"", key.data);
 
         if (ngx_ssl_connection_certificate(c, r->pool, &cert, &key,
-                                           sscf->passwords)
+                                           sscf->passwords,
+                                           sscf->certificate_cache)
             != NGX_OK)
         {
             goto failed;
@@ -2134,9 +2159,12 @@ ngx_http_process_request(ngx_http_request_t *r)
 #endif
 
     c->read->handler = ngx_http_request_handler;
-    c->write->handler = ngx_http_request_handler;
+    ngx_http_write_filter_set_handler(c, r->http_connection,
+                                      ngx_http_request_handler);
     r->read_event_handler = ngx_http_block_reading;
 
+    ngx_probe3(http__request__start, r, r->uri.data, r->uri.len);
+
     ngx_http_handler(r);
 }
 
@@ -2423,6 +2451,11 @@ ngx_http_request_handler(ngx_event_t *ev)
         return;
     }
 
+    if (r->main->trace) {
+        ngx_http_trace_add(r, ev->write ? NGX_HTTP_TRACE_CLIENT_WRITE
+                                        : NGX_HTTP_TRACE_CLIENT_READ, ev);
+    }
+
     if (ev->delayed && ev->timedout) {
         ev->delayed = 0;
         ev->timedout = 0;
@@ -2562,7 +2595,8 @@ ngx_http_finalize_request(ngx_http_request_t *r, ngx_int_t rc)
         }
 
         c->read->handler = ngx_http_request_handler;
-        c->write->handler = ngx_http_request_handler;
+        ngx_http_write_filter_set_handler(c, r->http_connection,
+                                          ngx_http_request_handler);
 
         ngx_http_finalize_request(r, ngx_http_special_response_handler(r, rc));
         return;
@@ -3176,7 +3210,7 @@ ngx_http_set_keepalive(ngx_http_request_t *r)
     }
 
     wev = c->write;
-    wev->handler = ngx_http_empty_handler;
+    ngx_http_write_filter_set_handler(c, hc, ngx_http_empty_handler);
 
     if (b->pos < b->last) {
 
@@ -3323,6 +3357,12 @@ ngx_http_keepalive_handler(ngx_event_t *rev)
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http keepalive handler");
 
+#if !(NGX_WIN32)
+    if (c->close && ngx_exiting && ngx_http_keepalive_handoff(c) == NGX_OK) {
+        return;
+    }
+#endif
+
     if (rev->timedout || c->close) {
         ngx_http_close_connection(c);
         return;
@@ -3442,6 +3482,59 @@ ngx_http_keepalive_handler(ngx_event_t *rev)
 }
 
 
+#if !(NGX_WIN32)
+
+static ngx_int_t
+ngx_http_keepalive_handoff(ngx_connection_t *c)
+{
+    ngx_buf_t                  *b;
+    ngx_http_connection_t      *hc;
+    ngx_http_core_main_conf_t  *cmcf;
+
+    hc = c->data;
+
+    cmcf = ngx_http_get_module_main_conf(hc->conf_ctx, ngx_http_core_module);
+
+    if (!cmcf->keepalive_handoff) {
+        return NGX_DECLINED;
+    }
+
+    /*
+     * only a plain idle connection can be passed: TLS and proxy protocol
+     * connections keep their state in the process memory
+     */
+
+    if (hc->addr_conf->proxy_protocol) {
+        return NGX_DECLINED;
+    }
+
+#if (NGX_HTTP_SSL)
+    if (c->ssl) {
+        return NGX_DECLINED;
+    }
+#endif
+
+    b = c->buffer;
+
+    if (b && b->pos && b->pos != b->last) {
+        return NGX_DECLINED;
+    }
+
+    if (ngx_pass_connection(c) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http keepalive connection passed");
+
+    ngx_http_close_connection(c);
+
+    return NGX_OK;
+}
+
+#endif
+
+
 static void
 ngx_http_set_lingering_close(ngx_connection_t *c)
 {
@@ -3486,7 +3579,8 @@ ngx_http_set_lingering_close(ngx_connection_t *c)
     }
 
     wev = c->write;
-    wev->handler = ngx_http_empty_handler;
+    ngx_http_write_filter_set_handler(c, r->http_connection,
+                                      ngx_http_empty_handler);
 
     if (wev->active && (ngx_event_flags & NGX_USE_LEVEL_EVENT)) {
         if (ngx_del_event(wev, NGX_WRITE_EVENT, 0) != NGX_OK) {
@@ -3690,6 +3784,8 @@ ngx_http_close_request(ngx_http_request_t *r, ngx_int_t rc)
     }
 #endif
 
+    ngx_http_write_filter_close(r);
+
     ngx_http_free_request(r, rc);
     ngx_http_close_connection(c);
 }
@@ -3747,6 +3843,13 @@ ngx_http_free_request(ngx_http_request_t *r, ngx_int_t rc)
         ngx_http_log_request(r);
     }
 
+    ngx_probe3(http__request__done, r, r->headers_out.status,
+               r->connection->sent);
+
+    if (r->trace) {
+        ngx_http_trace_finalize(r);
+    }
+
     log->action = "closing request";
 
     if (r->connection->timedout
@@ -3786,10 +3889,77 @@ ngx_http_free_request(ngx_http_request_t *r, ngx_int_t rc)
     pool = r->pool;
     r->pool = NULL;
 
+    ngx_http_request_pool_update(r, pool);
+
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        ngx_http_v2_release_pool(r->stream->connection, pool);
+        return;
+    }
+#endif
+
     ngx_destroy_pool(pool);
 }
 
 
+static size_t
+ngx_http_request_pool_size(ngx_http_core_srv_conf_t *cscf)
+{
+    size_t  size, need;
+
+    if (!cscf->request_pool_auto || cscf->request_pool_used == 0) {
+        return cscf->request_pool_size;
+    }
+
+    /*
+     * a power of two with 25% headroom above the average usage,
+     * so the pool blocks can be reused by the pool cache
+     */
+
+    need = cscf->request_pool_used + cscf->request_pool_used / 4;
+
+    for (size = NGX_HTTP_REQUEST_POOL_MIN;
+         size < need && size < NGX_HTTP_REQUEST_POOL_MAX;
+         size <<= 1)
+    {
+        /* void */
+    }
+
+    return size;
+}
+
+
+static void
+ngx_http_request_pool_update(ngx_http_request_t *r, ngx_pool_t *pool)
+{
+    ngx_pool_usage_t           u;
+    ngx_http_core_srv_conf_t  *cscf;
+
+    /* the pool was sized by the configuration of the connection */
+
+    cscf = ngx_http_get_module_srv_conf(r->http_connection->conf_ctx,
+                                        ngx_http_core_module);
+
+    if (!cscf->request_pool_auto) {
+        return;
+    }
+
+    ngx_pool_usage(pool, &u);
+
+    if (cscf->request_pool_used == 0) {
+        cscf->request_pool_used = u.used;
+
+    } else {
+        cscf->request_pool_used = cscf->request_pool_used
+                                  - cscf->request_pool_used / 8 + u.used / 8;
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http request pool size:%uz used:%uz blocks:%uz avg:%uz",
+                   u.size, u.used, u.blocks, cscf->request_pool_used);
+}
+
+
 static void
 ngx_http_log_request(ngx_http_request_t *r)
 {
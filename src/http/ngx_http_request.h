@@ -15,10 +15,17 @@
 /* must be 2^n */
 #define NGX_HTTP_LC_HEADER_LEN             32
 
+/* the phases preceding NGX_HTTP_LOG_PHASE */
+#define NGX_HTTP_TIMED_PHASES              10
+
 
 #define NGX_HTTP_DISCARD_BUFFER_SIZE       4096
+#define NGX_HTTP_PIPELINED_BUFFER_SIZE     16384
 #define NGX_HTTP_LINGERING_BUFFER_SIZE     4096
 
+#define NGX_HTTP_REQUEST_POOL_MIN          1024
+#define NGX_HTTP_REQUEST_POOL_MAX          65536
+
 
 #define NGX_HTTP_VERSION_9                 9
 #define NGX_HTTP_VERSION_10                1000
@@ -74,6 +81,7 @@
 #define NGX_HTTP_CONTINUE                  100
 #define NGX_HTTP_SWITCHING_PROTOCOLS       101
 #define NGX_HTTP_PROCESSING                102
+#define NGX_HTTP_EARLY_HINTS               103
 
 #define NGX_HTTP_OK                        200
 #define NGX_HTTP_CREATED                   201
@@ -180,8 +188,24 @@ typedef struct {
 } ngx_http_header_out_t;
 
 
+typedef struct {
+    ngx_uint_t                        hash;
+    ngx_table_elt_t                  *header;
+} ngx_http_header_index_elt_t;
+
+
+typedef struct {
+    ngx_list_part_t                  *last;
+    ngx_uint_t                        nelts;
+
+    ngx_uint_t                        mask;
+    ngx_http_header_index_elt_t      *elts;
+} ngx_http_headers_index_t;
+
+
 typedef struct {
     ngx_list_t                        headers;
+    ngx_http_headers_index_t         *index;
 
     ngx_table_elt_t                  *host;
     ngx_table_elt_t                  *connection;
@@ -278,6 +302,10 @@ typedef struct {
     ngx_table_elt_t                  *cache_control;
     ngx_table_elt_t                  *link;
 
+    ngx_str_t                        *header_block;
+    ngx_table_elt_t                  *header_block_start;
+    ngx_uint_t                        header_block_n;
+
     ngx_str_t                        *override_charset;
 
     size_t                            content_type_len;
@@ -305,6 +333,8 @@ typedef struct {
     ngx_chain_t                      *busy;
     ngx_http_chunked_t               *chunked;
     ngx_http_client_body_handler_pt   post_handler;
+    ngx_msec_t                        start_time;
+    ngx_msec_t                        read_time;
     unsigned                          filter_need_buffering:1;
     unsigned                          last_sent:1;
     unsigned                          last_saved:1;
@@ -312,6 +342,7 @@ typedef struct {
 
 
 typedef struct ngx_http_addr_conf_s  ngx_http_addr_conf_t;
+typedef struct ngx_http_pipelined_out_s  ngx_http_pipelined_out_t;
 
 typedef struct {
     ngx_http_addr_conf_t             *addr_conf;
@@ -329,6 +360,13 @@ typedef struct {
 
     ngx_chain_t                      *free;
 
+    ngx_http_pipelined_out_t         *pipelined;
+
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+    size_t                            notsent_lowat;
+    off_t                             notsent_queued;
+#endif
+
     unsigned                          ssl:1;
     unsigned                          proxy_protocol:1;
 } ngx_http_connection_t;
@@ -403,10 +441,19 @@ struct ngx_http_request_s {
     ngx_http_headers_out_t            headers_out;
 
     ngx_http_request_body_t          *request_body;
+    ngx_http_trace_t                 *trace;
 
     time_t                            lingering_time;
     time_t                            start_sec;
     ngx_msec_t                        start_msec;
+    uint64_t                          start_usec;
+
+    /* the time spent in each phase, and in the current one since */
+    ngx_msec_t                        phase_time[NGX_HTTP_TIMED_PHASES];
+    ngx_msec_t                        phase_start;
+
+    /* from the request start to the first byte of the response sent */
+    ngx_msec_t                        first_byte_time;
 
     ngx_uint_t                        method;
     ngx_uint_t                        http_version;
@@ -421,6 +468,9 @@ struct ngx_http_request_s {
     ngx_str_t                         http_protocol;
     ngx_str_t                         schema;
 
+    /* the range requested from upstream and cached as a separate chunk */
+    ngx_str_t                         upstream_range;
+
     ngx_chain_t                      *out;
     ngx_http_request_t               *main;
     ngx_http_request_t               *parent;
@@ -546,6 +596,7 @@ struct ngx_http_request_s {
     unsigned                          request_output:1;
     unsigned                          header_sent:1;
     unsigned                          response_sent:1;
+    unsigned                          first_byte_sent:1;
     unsigned                          expect_tested:1;
     unsigned                          root_tested:1;
     unsigned                          done:1;
@@ -562,10 +613,13 @@ struct ngx_http_request_s {
     unsigned                          subrequest_ranges:1;
     unsigned                          single_range:1;
     unsigned                          disable_not_modified:1;
+    unsigned                          filter_passthrough:1;
     unsigned                          stat_reading:1;
     unsigned                          stat_writing:1;
     unsigned                          stat_processing:1;
 
+    unsigned                          phase:4;
+
     unsigned                          background:1;
     unsigned                          health_check:1;
 
@@ -15,6 +15,11 @@ static ngx_int_t ngx_http_do_read_client_request_body(ngx_http_request_t *r);
 static ngx_int_t ngx_http_copy_pipelined_header(ngx_http_request_t *r,
     ngx_buf_t *buf);
 static ngx_int_t ngx_http_write_request_body(ngx_http_request_t *r);
+#if (NGX_THREADS)
+static ngx_int_t ngx_http_request_body_thread_handler(ngx_thread_task_t *task,
+    ngx_file_t *file);
+static void ngx_http_request_body_thread_event_handler(ngx_event_t *ev);
+#endif
 static ngx_int_t ngx_http_read_discarded_request_body(ngx_http_request_t *r);
 static ngx_int_t ngx_http_discard_request_body_filter(ngx_http_request_t *r,
     ngx_buf_t *b);
@@ -69,6 +74,7 @@ ngx_http_read_client_request_body(ngx_http_request_t *r,
      *     rb->busy = NULL;
      *     rb->chunked = NULL;
      *     rb->received = 0;
+     *     rb->read_time = 0;
      *     rb->filter_need_buffering = 0;
      *     rb->last_sent = 0;
      *     rb->last_saved = 0;
@@ -76,6 +82,7 @@ ngx_http_read_client_request_body(ngx_http_request_t *r,
 
     rb->rest = -1;
     rb->post_handler = post_handler;
+    rb->start_time = ngx_current_msec;
 
     r->request_body = rb;
 
@@ -156,7 +163,7 @@ ngx_http_read_client_request_body(ngx_http_request_t *r,
         }
     }
 
-    if (rb->rest == 0 && rb->last_saved) {
+    if (rb->rest == 0 && rb->last_saved && !r->aio) {
         /* the whole request body was pre-read */
         r->request_body_no_buffering = 0;
         post_handler(r);
@@ -328,7 +335,13 @@ ngx_http_do_read_client_request_body(ngx_http_request_t *r)
                 }
 
                 if (rb->busy != NULL) {
-                    if (r->request_body_no_buffering) {
+
+                    /*
+                     * the buffer is being sent to an upstream,
+                     * or written to a file in a thread
+                     */
+
+                    if (r->request_body_no_buffering || r->aio) {
                         if (c->read->timer_set) {
                             ngx_del_timer(c->read);
                         }
@@ -428,6 +441,25 @@ ngx_http_do_read_client_request_body(ngx_http_request_t *r)
             }
         }
 
+#if (NGX_THREADS)
+
+        if (r->aio) {
+
+            /* the rest of the body is being written to a file */
+
+            if (c->read->timer_set) {
+                ngx_del_timer(c->read);
+            }
+
+            if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+                return NGX_HTTP_INTERNAL_SERVER_ERROR;
+            }
+
+            return NGX_AGAIN;
+        }
+
+#endif
+
         if (rb->rest == 0 && rb->last_saved) {
             break;
         }
@@ -579,6 +611,20 @@ ngx_http_write_request_body(ngx_http_request_t *r)
             tf->access = 0660;
         }
 
+#if (NGX_THREADS && NGX_HAVE_PWRITEV)
+
+        /* HTTP/2 and HTTP/3 bodies are written to files synchronously */
+
+        if (clcf->aio == NGX_HTTP_AIO_THREADS
+            && clcf->client_body_aio_write
+            && r->http_version < NGX_HTTP_VERSION_20)
+        {
+            tf->file.thread_handler = ngx_http_request_body_thread_handler;
+            tf->file.thread_ctx = r;
+        }
+
+#endif
+
         rb->temp_file = tf;
 
         if (rb->bufs == NULL) {
@@ -599,6 +645,29 @@ ngx_http_write_request_body(ngx_http_request_t *r)
         return NGX_OK;
     }
 
+#if (NGX_THREADS)
+
+    if (r->aio) {
+        /* the buffers are being written */
+        return NGX_AGAIN;
+    }
+
+    if (rb->temp_file->file.thread_handler) {
+
+        /* an empty last buffer is not worth a thread */
+
+        rb->temp_file->thread_write = 0;
+
+        for (cl = rb->bufs; cl; cl = cl->next) {
+            if (ngx_buf_size(cl->buf)) {
+                rb->temp_file->thread_write = 1;
+                break;
+            }
+        }
+    }
+
+#endif
+
     n = ngx_write_chain_to_temp_file(rb->temp_file, rb->bufs);
 
     /* TODO: n == 0 or not complete and level event */
@@ -607,6 +676,12 @@ ngx_http_write_request_body(ngx_http_request_t *r)
         return NGX_ERROR;
     }
 
+#if (NGX_THREADS)
+    if (n == NGX_AGAIN) {
+        return NGX_AGAIN;
+    }
+#endif
+
     rb->temp_file->offset += n;
 
     /* mark all buffers as written */
@@ -626,6 +701,101 @@ ngx_http_write_request_body(ngx_http_request_t *r)
 }
 
 
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_http_request_body_thread_handler(ngx_thread_task_t *task, ngx_file_t *file)
+{
+    ngx_str_t                  name;
+    ngx_thread_pool_t         *tp;
+    ngx_http_request_t        *r;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    r = file->thread_ctx;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+    tp = clcf->thread_pool;
+
+    if (tp == NULL) {
+        if (ngx_http_complex_value(r, clcf->thread_pool_value, &name)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        tp = ngx_thread_pool_get((ngx_cycle_t *) ngx_cycle, &name);
+
+        if (tp == NULL) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "thread pool \"%V\" not found", &name);
+            return NGX_ERROR;
+        }
+    }
+
+    task->event.data = r;
+    task->event.handler = ngx_http_request_body_thread_event_handler;
+
+    if (ngx_thread_task_post(tp, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->main->blocked++;
+    r->aio = 1;
+
+    ngx_add_timer(&task->event, 60000);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_request_body_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
+
+    r = ev->data;
+    c = r->connection;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http request body thread: \"%V?%V\"", &r->uri, &r->args);
+
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
+                      "thread operation took too long");
+        ev->timedout = 0;
+        return;
+    }
+
+    if (ev->timer_set) {
+        ngx_del_timer(ev);
+    }
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    if (r->main->terminated) {
+        c->write->handler(c->write);
+        return;
+    }
+
+    /* get the result of the write, and continue reading the body */
+
+    if (ngx_http_write_request_body(r) != NGX_OK) {
+        ngx_http_finalize_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
+
+    } else {
+        r->read_event_handler(r);
+    }
+
+    ngx_http_run_posted_requests(c);
+}
+
+#endif
+
+
 ngx_int_t
 ngx_http_discard_request_body(ngx_http_request_t *r)
 {
@@ -1271,6 +1441,7 @@ ngx_http_request_body_chunked_filter(ngx_http_request_t *r, ngx_chain_t *in)
 ngx_int_t
 ngx_http_request_body_save_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
+    ngx_int_t                  rc;
     ngx_buf_t                 *b;
     ngx_chain_t               *cl, *tl, **ll;
     ngx_http_request_body_t   *rb;
@@ -1316,6 +1487,7 @@ ngx_http_request_body_save_filter(ngx_http_request_t *r, ngx_chain_t *in)
             }
 
             rb->last_saved = 1;
+            rb->read_time = ngx_current_msec - rb->start_time;
         }
 
         tl = ngx_alloc_chain_link(r->pool);
@@ -1338,7 +1510,7 @@ ngx_http_request_body_save_filter(ngx_http_request_t *r, ngx_chain_t *in)
     if (rb->rest > 0) {
 
         if (rb->bufs && rb->buf && rb->buf->last == rb->buf->end
-            && ngx_http_write_request_body(r) != NGX_OK)
+            && ngx_http_write_request_body(r) == NGX_ERROR)
         {
             return NGX_HTTP_INTERNAL_SERVER_ERROR;
         }
@@ -1358,10 +1530,17 @@ ngx_http_request_body_save_filter(ngx_http_request_t *r, ngx_chain_t *in)
             return NGX_HTTP_INTERNAL_SERVER_ERROR;
         }
 
-        if (ngx_http_write_request_body(r) != NGX_OK) {
+        rc = ngx_http_write_request_body(r);
+
+        if (rc == NGX_ERROR) {
             return NGX_HTTP_INTERNAL_SERVER_ERROR;
         }
 
+        if (rc == NGX_AGAIN) {
+            /* the file buffer is added once the write is complete */
+            return NGX_OK;
+        }
+
         if (rb->temp_file->file.offset != 0) {
 
             cl = ngx_chain_get_free_buf(r->pool, &rb->free);
@@ -10,6 +10,10 @@
 #include <ngx_http.h>
 
 
+static ngx_int_t ngx_http_complex_value_parts(ngx_http_request_t *r,
+    ngx_http_complex_value_part_t *part, ngx_str_t *value);
+static ngx_int_t ngx_http_compile_complex_value_parts(ngx_conf_t *cf,
+    ngx_http_complex_value_t *cv, size_t size);
 static ngx_int_t ngx_http_script_init_arrays(ngx_http_script_compile_t *sc);
 static ngx_int_t ngx_http_script_done(ngx_http_script_compile_t *sc);
 static ngx_int_t ngx_http_script_add_copy_code(ngx_http_script_compile_t *sc,
@@ -70,6 +74,10 @@ ngx_http_complex_value(ngx_http_request_t *r, ngx_http_complex_value_t *val,
 
     ngx_http_script_flush_complex_value(r, val);
 
+    if (val->parts) {
+        return ngx_http_complex_value_parts(r, val->parts, value);
+    }
+
     ngx_memzero(&e, sizeof(ngx_http_script_engine_t));
 
     e.ip = val->lengths;
@@ -104,6 +112,62 @@ ngx_http_complex_value(ngx_http_request_t *r, ngx_http_complex_value_t *val,
 }
 
 
+static ngx_int_t
+ngx_http_complex_value_parts(ngx_http_request_t *r,
+    ngx_http_complex_value_part_t *part, ngx_str_t *value)
+{
+    u_char                         *p;
+    size_t                          len;
+    ngx_http_variable_value_t      *vv;
+    ngx_http_complex_value_part_t  *pt;
+
+    len = 0;
+
+    for (pt = part; /* void */ ; pt++) {
+        len += pt->text.len;
+
+        if (pt->index == (ngx_uint_t) -1) {
+            break;
+        }
+
+        vv = ngx_http_get_indexed_variable(r, pt->index);
+
+        if (vv && !vv->not_found) {
+            len += vv->len;
+        }
+    }
+
+    p = ngx_pnalloc(r->pool, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    value->len = len;
+    value->data = p;
+
+    /* the variables are already evaluated and cached in r->variables */
+
+    for (pt = part; /* void */ ; pt++) {
+        p = ngx_copy(p, pt->text.data, pt->text.len);
+
+        if (pt->index == (ngx_uint_t) -1) {
+            break;
+        }
+
+        vv = &r->variables[pt->index];
+
+        if (!vv->not_found) {
+            p = ngx_copy(p, vv->data, vv->len);
+        }
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http complex value: \"%V\"", value);
+
+    return NGX_OK;
+}
+
+
 size_t
 ngx_http_complex_value_size(ngx_http_request_t *r,
     ngx_http_complex_value_t *val, size_t default_value)
@@ -174,6 +238,7 @@ ngx_http_compile_complex_value(ngx_http_compile_complex_value_t *ccv)
     ccv->complex_value->flushes = NULL;
     ccv->complex_value->lengths = NULL;
     ccv->complex_value->values = NULL;
+    ccv->complex_value->parts = NULL;
 
     if (nv == 0 && nc == 0) {
         return NGX_OK;
@@ -235,6 +300,94 @@ ngx_http_compile_complex_value(ngx_http_compile_complex_value_t *ccv)
     ccv->complex_value->lengths = lengths.elts;
     ccv->complex_value->values = values.elts;
 
+    if (nc == 0 && !sc.conf_prefix && !sc.root_prefix) {
+        return ngx_http_compile_complex_value_parts(ccv->cf,
+                                                    ccv->complex_value,
+                                                    sc.size + ccv->zero);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_compile_complex_value_parts(ngx_conf_t *cf,
+    ngx_http_complex_value_t *cv, size_t size)
+{
+    u_char                         *ip, *p, *text;
+    ngx_uint_t                      n;
+    ngx_http_script_code_pt         code;
+    ngx_http_script_var_code_t     *vcode;
+    ngx_http_script_copy_code_t    *ccode;
+    ngx_http_complex_value_part_t  *part;
+
+    /*
+     * a program of literals and variables only is evaluated in a single
+     * pass over its parts, adjacent literals are merged
+     */
+
+    n = 1;
+
+    for (ip = cv->values; *(uintptr_t *) ip; /* void */ ) {
+        code = *(ngx_http_script_code_pt *) ip;
+
+        if (code == ngx_http_script_copy_code) {
+            ccode = (ngx_http_script_copy_code_t *) ip;
+            ip += sizeof(ngx_http_script_copy_code_t)
+                  + ngx_align(ccode->len, sizeof(uintptr_t));
+            continue;
+        }
+
+        if (code == ngx_http_script_copy_var_code) {
+            ip += sizeof(ngx_http_script_var_code_t);
+            n++;
+            continue;
+        }
+
+        return NGX_OK;
+    }
+
+    part = ngx_palloc(cf->pool, n * sizeof(ngx_http_complex_value_part_t));
+    if (part == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = ngx_pnalloc(cf->pool, size);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    cv->parts = part;
+
+    text = p;
+
+    for (ip = cv->values; *(uintptr_t *) ip; /* void */ ) {
+        code = *(ngx_http_script_code_pt *) ip;
+
+        if (code == ngx_http_script_copy_code) {
+            ccode = (ngx_http_script_copy_code_t *) ip;
+            p = ngx_cpymem(p, ip + sizeof(ngx_http_script_copy_code_t),
+                           ccode->len);
+            ip += sizeof(ngx_http_script_copy_code_t)
+                  + ngx_align(ccode->len, sizeof(uintptr_t));
+            continue;
+        }
+
+        vcode = (ngx_http_script_var_code_t *) ip;
+        ip += sizeof(ngx_http_script_var_code_t);
+
+        part->text.len = p - text;
+        part->text.data = text;
+        part->index = vcode->index;
+        part++;
+
+        text = p;
+    }
+
+    part->text.len = p - text;
+    part->text.data = text;
+    part->index = (ngx_uint_t) -1;
+
     return NGX_OK;
 }
 
@@ -63,11 +63,20 @@ typedef struct {
 } ngx_http_script_compile_t;
 
 
+/* a literal followed by a variable, the last part has no variable */
+
+typedef struct {
+    ngx_str_t                   text;
+    ngx_uint_t                  index;
+} ngx_http_complex_value_part_t;
+
+
 typedef struct {
     ngx_str_t                   value;
     ngx_uint_t                 *flushes;
     void                       *lengths;
     void                       *values;
+    ngx_http_complex_value_part_t  *parts;
 
     union {
         size_t                  size;
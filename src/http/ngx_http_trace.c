@@ -0,0 +1,318 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_TRACE_EVENT_LEN                                              \
+    (sizeof("{\"at\":,\"event\":\"upstream_connect\","                        \
+            "\"flags\":[\"timedout\",\"delayed\"]},") - 1 + NGX_INT32_LEN)
+
+
+static ngx_str_t  ngx_http_trace_events[] = {
+    ngx_string("start"),
+    ngx_string("client_read"),
+    ngx_string("client_write"),
+    ngx_string("client_blocked"),
+    ngx_string("upstream_connect"),
+    ngx_string("upstream_read"),
+    ngx_string("upstream_write"),
+    ngx_string("upstream_header")
+};
+
+
+void
+ngx_http_trace_start(ngx_http_request_t *r, ngx_http_trace_conf_t *tcf)
+{
+    ngx_time_t        *tp;
+    ngx_msec_int_t     ms;
+    ngx_http_trace_t  *trace;
+
+    if (tcf->rate < 10000 && (ngx_uint_t) ngx_random() % 10000 >= tcf->rate) {
+        return;
+    }
+
+    /* tracing is best effort, allocation errors just disable it */
+
+    trace = ngx_palloc(r->pool, sizeof(ngx_http_trace_t));
+    if (trace == NULL) {
+        return;
+    }
+
+    if (ngx_array_init(&trace->events, r->pool, 16,
+                       sizeof(ngx_http_trace_event_t))
+        != NGX_OK)
+    {
+        return;
+    }
+
+    /* the times are relative to the request start, as in $request_time */
+
+    tp = ngx_timeofday();
+
+    ms = (ngx_msec_int_t)
+             ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
+
+    trace->conf = tcf;
+    trace->start = ngx_current_msec - ngx_max(ms, 0);
+    trace->dropped = 0;
+
+    r->trace = trace;
+
+    ngx_http_trace_add(r, NGX_HTTP_TRACE_START, NULL);
+}
+
+
+void
+ngx_http_trace_add(ngx_http_request_t *r, ngx_uint_t type, ngx_event_t *ev)
+{
+    ngx_http_trace_t        *trace;
+    ngx_http_trace_event_t  *e;
+
+    trace = r->main->trace;
+
+    if (trace->events.nelts >= trace->conf->max_events) {
+        trace->dropped++;
+        return;
+    }
+
+    e = ngx_array_push(&trace->events);
+    if (e == NULL) {
+        trace->dropped++;
+        return;
+    }
+
+    e->time = (uint32_t) (ngx_current_msec - trace->start);
+    e->type = (uint16_t) type;
+    e->flags = 0;
+
+    if (ev) {
+        if (ev->timedout) {
+            e->flags |= NGX_HTTP_TRACE_TIMEDOUT;
+        }
+
+        if (ev->delayed) {
+            e->flags |= NGX_HTTP_TRACE_DELAYED;
+        }
+    }
+}
+
+
+void
+ngx_http_trace_finalize(ngx_http_request_t *r)
+{
+    u_char                  *buf, *p;
+    size_t                   len;
+    ssize_t                  n;
+    ngx_uint_t               i, status;
+    ngx_time_t              *tp;
+    ngx_msec_int_t           ms;
+    ngx_open_file_t         *file;
+    ngx_http_trace_t        *trace;
+    ngx_http_trace_event_t  *e;
+
+    trace = r->trace;
+    r->trace = NULL;
+
+    tp = ngx_timeofday();
+
+    ms = (ngx_msec_int_t)
+             ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
+    ms = ngx_max(ms, 0);
+
+    if ((ngx_msec_t) ms < trace->conf->threshold) {
+        return;
+    }
+
+    if (r->err_status) {
+        status = r->err_status;
+
+    } else {
+        status = r->headers_out.status;
+    }
+
+    len = sizeof("{\"time\":\"\",\"connection\":,\"request\":\"\","
+                 "\"status\":,\"request_time\":,\"events\":[],"
+                 "\"dropped\":}\n") - 1
+          + ngx_cached_http_log_iso8601.len + 4 * NGX_ATOMIC_T_LEN
+          + r->request_line.len
+          + ngx_escape_json(NULL, r->request_line.data, r->request_line.len)
+          + trace->events.nelts * NGX_HTTP_TRACE_EVENT_LEN;
+
+    buf = ngx_pnalloc(r->pool, len);
+    if (buf == NULL) {
+        return;
+    }
+
+    p = ngx_cpymem(buf, "{\"time\":\"", sizeof("{\"time\":\"") - 1);
+    p = ngx_cpymem(p, ngx_cached_http_log_iso8601.data,
+                   ngx_cached_http_log_iso8601.len);
+
+    p = ngx_sprintf(p, "\",\"connection\":%uA,\"request\":\"",
+                    r->connection->number);
+
+    p = (u_char *) ngx_escape_json(p, r->request_line.data,
+                                   r->request_line.len);
+
+    p = ngx_sprintf(p, "\",\"status\":%ui,\"request_time\":%M,\"events\":[",
+                    status, (ngx_msec_t) ms);
+
+    e = trace->events.elts;
+
+    for (i = 0; i < trace->events.nelts; i++) {
+        if (i) {
+            *p++ = ',';
+        }
+
+        p = ngx_sprintf(p, "{\"at\":%uD,\"event\":\"%V\"",
+                        e[i].time, &ngx_http_trace_events[e[i].type]);
+
+        if (e[i].flags) {
+            p = ngx_cpymem(p, ",\"flags\":[", sizeof(",\"flags\":[") - 1);
+
+            if (e[i].flags & NGX_HTTP_TRACE_TIMEDOUT) {
+                p = ngx_cpymem(p, "\"timedout\",", sizeof("\"timedout\",") - 1);
+            }
+
+            if (e[i].flags & NGX_HTTP_TRACE_DELAYED) {
+                p = ngx_cpymem(p, "\"delayed\",", sizeof("\"delayed\",") - 1);
+            }
+
+            p[-1] = ']';
+        }
+
+        *p++ = '}';
+    }
+
+    p = ngx_sprintf(p, "],\"dropped\":%ui}\n", trace->dropped);
+
+    file = trace->conf->file;
+
+    n = ngx_write_fd(file->fd, buf, p - buf);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, r->connection->log, ngx_errno,
+                      ngx_write_fd_n " to \"%s\" failed", file->name.data);
+        return;
+    }
+
+    if ((size_t) n != (size_t) (p - buf)) {
+        ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                      ngx_write_fd_n " to \"%s\" was incomplete: %z of %uz",
+                      file->name.data, n, (size_t) (p - buf));
+    }
+}
+
+
+char *
+ngx_http_trace_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    char  *p = conf;
+
+    ngx_str_t              *value, s;
+    ngx_int_t               n;
+    ngx_uint_t              i;
+    ngx_msec_t              ms;
+    ngx_http_trace_conf_t  *tcf, **tcfp;
+
+    tcfp = (ngx_http_trace_conf_t **) (p + cmd->offset);
+
+    if (*tcfp != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts != 2) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        *tcfp = NULL;
+        return NGX_CONF_OK;
+    }
+
+    tcf = ngx_pcalloc(cf->pool, sizeof(ngx_http_trace_conf_t));
+    if (tcf == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    tcf->file = ngx_conf_open_file(cf->cycle, &value[1]);
+    if (tcf->file == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    tcf->rate = 10000;
+    tcf->threshold = 1000;
+    tcf->max_events = 256;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "sample=", 7) == 0) {
+
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            if (s.len < 2 || s.data[s.len - 1] != '%') {
+                goto invalid;
+            }
+
+            n = ngx_atofp(s.data, s.len - 1, 2);
+
+            if (n == NGX_ERROR || n > 10000) {
+                goto invalid;
+            }
+
+            tcf->rate = n;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "threshold=", 10) == 0) {
+
+            s.len = value[i].len - 10;
+            s.data = value[i].data + 10;
+
+            ms = ngx_parse_time(&s, 0);
+
+            if (ms == (ngx_msec_t) NGX_ERROR) {
+                goto invalid;
+            }
+
+            tcf->threshold = ms;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "events=", 7) == 0) {
+
+            n = ngx_atoi(value[i].data + 7, value[i].len - 7);
+
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            tcf->max_events = n;
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    *tcfp = tcf;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
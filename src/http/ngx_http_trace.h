@@ -0,0 +1,60 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_HTTP_TRACE_H_INCLUDED_
+#define _NGX_HTTP_TRACE_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_TRACE_START            0
+#define NGX_HTTP_TRACE_CLIENT_READ      1
+#define NGX_HTTP_TRACE_CLIENT_WRITE     2
+#define NGX_HTTP_TRACE_CLIENT_BLOCKED   3
+#define NGX_HTTP_TRACE_UPSTREAM_CONNECT 4
+#define NGX_HTTP_TRACE_UPSTREAM_READ    5
+#define NGX_HTTP_TRACE_UPSTREAM_WRITE   6
+#define NGX_HTTP_TRACE_UPSTREAM_HEADER  7
+
+#define NGX_HTTP_TRACE_TIMEDOUT         0x01
+#define NGX_HTTP_TRACE_DELAYED          0x02
+
+
+typedef struct {
+    ngx_open_file_t            *file;
+    ngx_uint_t                  rate;        /* 1/10000 */
+    ngx_msec_t                  threshold;
+    ngx_uint_t                  max_events;
+} ngx_http_trace_conf_t;
+
+
+typedef struct {
+    uint32_t                    time;        /* msec since request start */
+    uint16_t                    type;
+    uint16_t                    flags;
+} ngx_http_trace_event_t;
+
+
+struct ngx_http_trace_s {
+    ngx_http_trace_conf_t      *conf;
+    ngx_msec_t                  start;
+    ngx_array_t                 events;      /* ngx_http_trace_event_t */
+    ngx_uint_t                  dropped;
+};
+
+
+void ngx_http_trace_start(ngx_http_request_t *r, ngx_http_trace_conf_t *tcf);
+void ngx_http_trace_add(ngx_http_request_t *r, ngx_uint_t type,
+    ngx_event_t *ev);
+void ngx_http_trace_finalize(ngx_http_request_t *r);
+char *ngx_http_trace_set_slot(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+#endif /* _NGX_HTTP_TRACE_H_INCLUDED_ */
@@ -10,15 +10,39 @@
 #include <ngx_http.h>
 
 
+/* the time since start_usec, if precise_timing is enabled */
+
+#define ngx_http_upstream_usec(u)                                             \
+    ((u)->start_usec ? ngx_monotonic_usec() - (u)->start_usec : 0)
+
+
 #if (NGX_HTTP_CACHE)
 static ngx_int_t ngx_http_upstream_cache(ngx_http_request_t *r,
     ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_cache_purge(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_cache_tags(ngx_http_request_t *r,
+    ngx_list_t *headers, ngx_str_t *tags);
 static ngx_int_t ngx_http_upstream_cache_get(ngx_http_request_t *r,
     ngx_http_upstream_t *u, ngx_http_file_cache_t **cache);
 static ngx_int_t ngx_http_upstream_cache_send(ngx_http_request_t *r,
     ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_cache_peer(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_get_cache_peer(ngx_peer_connection_t *pc,
+    void *data);
+static void ngx_http_upstream_free_cache_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
+#if (NGX_HTTP_SSL)
+static ngx_int_t ngx_http_upstream_cache_peer_set_session(
+    ngx_peer_connection_t *pc, void *data);
+static void ngx_http_upstream_cache_peer_save_session(
+    ngx_peer_connection_t *pc, void *data);
+#endif
 static ngx_int_t ngx_http_upstream_cache_background_update(
     ngx_http_request_t *r, ngx_http_upstream_t *u);
+static void ngx_http_upstream_cache_write_back(ngx_http_request_t *r,
+    ngx_http_upstream_t *u, ngx_temp_file_t *tf);
 static ngx_int_t ngx_http_upstream_cache_check_range(ngx_http_request_t *r,
     ngx_http_upstream_t *u);
 static ngx_int_t ngx_http_upstream_cache_status(ngx_http_request_t *r,
@@ -30,6 +54,7 @@ static ngx_int_t ngx_http_upstream_cache_etag(ngx_http_request_t *r,
 #endif
 
 static void ngx_http_upstream_init_request(ngx_http_request_t *r);
+static ngx_int_t ngx_http_upstream_send_early_hints(ngx_http_request_t *r);
 static void ngx_http_upstream_resolve_handler(ngx_resolver_ctx_t *ctx);
 static void ngx_http_upstream_rd_check_broken_connection(ngx_http_request_t *r);
 static void ngx_http_upstream_wr_check_broken_connection(ngx_http_request_t *r);
@@ -77,6 +102,19 @@ static void
 static void
     ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
     ngx_uint_t do_write);
+#if (NGX_HAVE_SPLICE)
+static ngx_int_t ngx_http_upstream_splice_init(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_process_splice(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_request_splice_init(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_splice_request_body(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_splice_create(ngx_http_request_t *r,
+    ngx_http_upstream_splice_t **spp);
+static void ngx_http_upstream_splice_cleanup(void *data);
+#endif
 #if (NGX_THREADS)
 static ngx_int_t ngx_http_upstream_thread_handler(ngx_thread_task_t *task,
     ngx_file_t *file);
@@ -95,6 +133,46 @@ static void ngx_http_upstream_dummy_handler(ngx_http_request_t *r,
     ngx_http_upstream_t *u);
 static void ngx_http_upstream_next(ngx_http_request_t *r,
     ngx_http_upstream_t *u, ngx_uint_t ft_type);
+static ngx_int_t ngx_http_upstream_hedge_init(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static void ngx_http_upstream_hedge_start(ngx_event_t *ev);
+static void ngx_http_upstream_hedge_handler(ngx_event_t *ev);
+static void ngx_http_upstream_hedge_send(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static void ngx_http_upstream_hedge_read(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static void ngx_http_upstream_hedge_swap(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static void ngx_http_upstream_hedge_close(ngx_http_request_t *r,
+    ngx_http_upstream_t *u, ngx_uint_t state);
+static ngx_int_t ngx_http_upstream_hedge_get_peer(ngx_peer_connection_t *pc,
+    void *data);
+static void ngx_http_upstream_hedge_free_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
+static ngx_int_t ngx_http_upstream_race_init(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static void ngx_http_upstream_race_start(ngx_event_t *ev);
+static void ngx_http_upstream_race_handler(ngx_event_t *ev);
+static void ngx_http_upstream_race_adopt(ngx_http_request_t *r,
+    ngx_http_upstream_t *u, ngx_http_upstream_attempt_t *a);
+static void ngx_http_upstream_race_swap(ngx_http_request_t *r,
+    ngx_http_upstream_t *u, ngx_http_upstream_attempt_t *a);
+static ngx_int_t ngx_http_upstream_race_promote(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static void ngx_http_upstream_race_close(ngx_http_request_t *r,
+    ngx_http_upstream_t *u, ngx_uint_t state);
+static void ngx_http_upstream_race_close_attempt(ngx_http_request_t *r,
+    ngx_http_upstream_attempt_t *a, ngx_uint_t state);
+static ngx_int_t ngx_http_upstream_race_get_peer(ngx_peer_connection_t *pc,
+    void *data);
+static void ngx_http_upstream_race_free_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
+static ngx_int_t ngx_http_upstream_queue(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static void ngx_http_upstream_queue_handler(ngx_event_t *ev);
+static void ngx_http_upstream_queue_remove(ngx_http_upstream_t *u);
+static void ngx_http_upstream_queue_dispatch(
+    ngx_http_upstream_srv_conf_t *uscf);
 static void ngx_http_upstream_cleanup(void *data);
 static void ngx_http_upstream_finalize_request(ngx_http_request_t *r,
     ngx_http_upstream_t *u, ngx_int_t rc);
@@ -169,12 +247,19 @@ static ngx_int_t ngx_http_upstream_cookie_variable(ngx_http_request_t *r,
 static char *ngx_http_upstream(ngx_conf_t *cf, ngx_command_t *cmd, void *dummy);
 static char *ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static ngx_int_t ngx_http_upstream_server_resolve(ngx_conf_t *cf,
+    ngx_http_upstream_server_t *us, ngx_url_t *u, ngx_uint_t max_addrs);
+static char *ngx_http_upstream_hedge_budget(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+static char *ngx_http_upstream_queue_set(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 static ngx_int_t ngx_http_upstream_set_local(ngx_http_request_t *r,
   ngx_http_upstream_t *u, ngx_http_upstream_local_t *local);
 
 static void *ngx_http_upstream_create_main_conf(ngx_conf_t *cf);
 static char *ngx_http_upstream_init_main_conf(ngx_conf_t *cf, void *conf);
+static ngx_int_t ngx_http_upstream_init_process(ngx_cycle_t *cycle);
 
 #if (NGX_HTTP_SSL)
 static void ngx_http_upstream_ssl_init_connection(ngx_http_request_t *,
@@ -339,6 +424,27 @@ static ngx_command_t  ngx_http_upstream_commands[] = {
       0,
       NULL },
 
+    { ngx_string("hedge_budget"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_TAKE1,
+      ngx_http_upstream_hedge_budget,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("queue"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_TAKE12,
+      ngx_http_upstream_queue_set,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("upstream_buffer_pool"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_upstream_main_conf_t, buffer_pool_size),
+      NULL },
+
       ngx_null_command
 };
 
@@ -365,7 +471,7 @@ ngx_module_t  ngx_http_upstream_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_upstream_init_process,        /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -396,6 +502,10 @@ static ngx_http_variable_t  ngx_http_upstream_vars[] = {
       ngx_http_upstream_response_time_variable, 0,
       NGX_HTTP_VAR_NOCACHEABLE, 0 },
 
+    { ngx_string("upstream_queue_time"), NULL,
+      ngx_http_upstream_response_time_variable, 3,
+      NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
     { ngx_string("upstream_response_length"), NULL,
       ngx_http_upstream_response_length_variable, 0,
       NGX_HTTP_VAR_NOCACHEABLE, 0 },
@@ -580,6 +690,8 @@ ngx_http_upstream_init_request(ngx_http_request_t *r)
 
         r->write_event_handler = ngx_http_request_empty_handler;
 
+        ngx_probe2(http__cache__lookup, r, u->cache_status);
+
         if (rc == NGX_ERROR) {
             ngx_http_finalize_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
             return;
@@ -588,6 +700,10 @@ ngx_http_upstream_init_request(ngx_http_request_t *r)
         if (rc == NGX_OK) {
             rc = ngx_http_upstream_cache_send(r, u);
 
+            if (rc != NGX_HTTP_UPSTREAM_INVALID_HEADER) {
+                ngx_http_file_cache_count(r->cache, u->cache_status);
+            }
+
             if (rc == NGX_DONE) {
                 return;
             }
@@ -605,6 +721,14 @@ ngx_http_upstream_init_request(ngx_http_request_t *r)
             ngx_http_finalize_request(r, rc);
             return;
         }
+
+        if (u->conf->cache_peer
+            && u->cache_status == NGX_HTTP_CACHE_MISS
+            && ngx_http_upstream_cache_peer(r, u) != NGX_OK)
+        {
+            ngx_http_finalize_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
     }
 
 #endif
@@ -645,6 +769,10 @@ ngx_http_upstream_init_request(ngx_http_request_t *r)
         u->peer.so_keepalive = 1;
     }
 
+    if (u->conf->fastopen) {
+        u->peer.fastopen = 1;
+    }
+
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     u->output.alignment = clcf->directio_alignment;
@@ -690,6 +818,21 @@ ngx_http_upstream_init_request(ngx_http_request_t *r)
     cln->data = r;
     u->cleanup = &cln->handler;
 
+    if (ngx_http_upstream_send_early_hints(r) != NGX_OK) {
+        ngx_http_upstream_finalize_request(r, u,
+                                           NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+#if (NGX_HTTP_CACHE)
+
+    if (u->cache_peer) {
+        uscf = u->conf->cache_peer->upstream;
+        goto found;
+    }
+
+#endif
+
     if (u->resolved == NULL) {
 
         uscf = u->conf->upstream;
@@ -802,6 +945,13 @@ found:
     u->ssl_name = uscf->host;
 #endif
 
+#if (NGX_HTTP_CACHE)
+
+    if (u->cache_peer) {
+        /* already initialized by ngx_http_upstream_cache_peer() */
+
+    } else
+#endif
     if (uscf->peer.init(r, uscf) != NGX_OK) {
         ngx_http_upstream_finalize_request(r, u,
                                            NGX_HTTP_INTERNAL_SERVER_ERROR);
@@ -816,6 +966,12 @@ found:
         u->peer.tries = u->conf->next_upstream_tries;
     }
 
+    if (ngx_http_upstream_hedge_init(r, u) != NGX_OK) {
+        ngx_http_upstream_finalize_request(r, u,
+                                           NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
     ngx_http_upstream_connect(r, u);
 }
 
@@ -826,6 +982,8 @@ static ngx_int_t
 ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
 {
     ngx_int_t               rc;
+    ngx_str_t              *key;
+    ngx_uint_t              purge;
     ngx_http_cache_t       *c;
     ngx_http_file_cache_t  *cache;
 
@@ -833,7 +991,22 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
     if (c == NULL) {
 
-        if (!(r->method & u->conf->cache_methods)) {
+        purge = 0;
+
+        switch (ngx_http_test_predicates(r, u->conf->cache_purge)) {
+
+        case NGX_ERROR:
+            return NGX_ERROR;
+
+        case NGX_DECLINED:
+            purge = 1;
+            break;
+
+        default: /* NGX_OK */
+            break;
+        }
+
+        if (!purge && !(r->method & u->conf->cache_methods)) {
             return NGX_DECLINED;
         }
 
@@ -851,14 +1024,34 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
             return NGX_ERROR;
         }
 
+        r->cache->file_cache = cache;
+
         if (u->create_key(r) != NGX_OK) {
             return NGX_ERROR;
         }
 
-        /* TODO: add keys */
+        if (r->upstream_range.len) {
+
+            /*
+             * ranges of an object are cached as chunks with keys derived
+             * from the object key, so purging by the key prefix removes
+             * all of them
+             */
+
+            key = ngx_array_push(&r->cache->keys);
+            if (key == NULL) {
+                return NGX_ERROR;
+            }
+
+            *key = r->upstream_range;
+        }
 
         ngx_http_file_cache_create_key(r);
 
+        if (purge) {
+            return ngx_http_upstream_cache_purge(r, u);
+        }
+
         if (r->cache->header_start + 256 > u->conf->buffer_size) {
             ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
                           "%V_buffer_size %uz is not enough for cache key, "
@@ -876,7 +1069,6 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
         c->body_start = u->conf->buffer_size;
         c->min_uses = u->conf->cache_min_uses;
-        c->file_cache = cache;
 
         switch (ngx_http_test_predicates(r, u->conf->cache_bypass)) {
 
@@ -894,6 +1086,7 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
         c->lock = u->conf->cache_lock;
         c->lock_timeout = u->conf->cache_lock_timeout;
         c->lock_age = u->conf->cache_lock_age;
+        c->lock_stream = u->conf->cache_lock_stream;
 
         u->cache_status = NGX_HTTP_CACHE_MISS;
     }
@@ -1003,6 +1196,102 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
 }
 
 
+static ngx_int_t
+ngx_http_upstream_cache_purge(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ngx_int_t  rc;
+
+    /* the tags of a purge request are in the request header */
+
+    if (u->conf->cache_tag_header.len
+        && ngx_http_upstream_cache_tags(r, &r->headers_in.headers,
+                                        &r->cache->tags)
+           != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    rc = ngx_http_file_cache_purge(r);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream cache purge: %i", rc);
+
+    switch (rc) {
+
+    case NGX_OK:
+        return NGX_HTTP_NO_CONTENT;
+
+    case NGX_DECLINED:
+        return NGX_HTTP_NOT_FOUND;
+
+    default:
+        return NGX_ERROR;
+    }
+}
+
+
+static ngx_int_t
+ngx_http_upstream_cache_tags(ngx_http_request_t *r, ngx_list_t *headers,
+    ngx_str_t *tags)
+{
+    u_char           *p;
+    size_t            len;
+    ngx_str_t        *name;
+    ngx_uint_t        i;
+    ngx_list_part_t  *part;
+    ngx_table_elt_t  *h;
+
+    name = &r->upstream->conf->cache_tag_header;
+
+    /* the values of all the header lines are joined */
+
+    len = 0;
+
+    for (part = &headers->part; part; part = part->next) {
+        h = part->elts;
+
+        for (i = 0; i < part->nelts; i++) {
+            if (h[i].hash
+                && h[i].key.len == name->len
+                && ngx_strncasecmp(h[i].key.data, name->data, name->len) == 0)
+            {
+                len += h[i].value.len + 1;
+            }
+        }
+    }
+
+    if (len == 0) {
+        ngx_str_null(tags);
+        return NGX_OK;
+    }
+
+    p = ngx_pnalloc(r->pool, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    tags->data = p;
+
+    for (part = &headers->part; part; part = part->next) {
+        h = part->elts;
+
+        for (i = 0; i < part->nelts; i++) {
+            if (h[i].hash
+                && h[i].key.len == name->len
+                && ngx_strncasecmp(h[i].key.data, name->data, name->len) == 0)
+            {
+                p = ngx_cpymem(p, h[i].value.data, h[i].value.len);
+                *p++ = ' ';
+            }
+        }
+    }
+
+    tags->len = len - 1;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_upstream_cache_get(ngx_http_request_t *r, ngx_http_upstream_t *u,
     ngx_http_file_cache_t **cache)
@@ -1114,102 +1403,389 @@ ngx_http_upstream_cache_send(ngx_http_request_t *r, ngx_http_upstream_t *u)
 }
 
 
-static ngx_int_t
-ngx_http_upstream_cache_background_update(ngx_http_request_t *r,
-    ngx_http_upstream_t *u)
-{
-    ngx_http_request_t  *sr;
+/*
+ * On a cache miss the response is requested from the peer which owns
+ * the key according to the balancing method of the peers upstream,
+ * usually "hash ... consistent"; the peer then gets it from its cache or
+ * from the origin.  The peer is selected here, before the request is
+ * created, to find out if it is this server itself, and the selection
+ * is reused when connecting.  Requests from other peers are not passed
+ * to peers again.
+ */
 
-    if (r == r->main) {
-        r->preserve_body = 1;
-    }
+typedef struct {
+    void                            *data;
 
-    if (ngx_http_subrequest(r, &r->uri, &r->args, &sr, NULL,
-                            NGX_HTTP_SUBREQUEST_CLONE
-                            |NGX_HTTP_SUBREQUEST_BACKGROUND)
-        != NGX_OK)
-    {
-        return NGX_ERROR;
-    }
+    ngx_event_get_peer_pt            original_get_peer;
+    ngx_event_free_peer_pt           original_free_peer;
 
-    sr->header_only = 1;
+#if (NGX_HTTP_SSL)
+    ngx_event_set_peer_session_pt    original_set_session;
+    ngx_event_save_peer_session_pt   original_save_session;
+#endif
 
-    return NGX_OK;
-}
+    ngx_int_t                        rc;
+    ngx_uint_t                       selected;  /* unsigned  selected:1; */
+} ngx_http_upstream_cache_peer_data_t;
 
 
 static ngx_int_t
-ngx_http_upstream_cache_check_range(ngx_http_request_t *r,
-    ngx_http_upstream_t *u)
+ngx_http_upstream_cache_peer(ngx_http_request_t *r, ngx_http_upstream_t *u)
 {
-    off_t             offset;
-    u_char           *p, *start;
-    ngx_table_elt_t  *h;
+    ngx_int_t                             rc;
+    ngx_uint_t                            i;
+    ngx_addr_t                           *addr;
+    ngx_list_part_t                      *part;
+    ngx_table_elt_t                      *h;
+    ngx_http_upstream_srv_conf_t         *uscf;
+    ngx_http_upstream_cache_peer_t       *cp;
+    ngx_http_upstream_cache_peer_data_t  *pd;
+
+    part = &r->headers_in.headers.part;
+    h = part->elts;
 
-    h = r->headers_in.range;
+    for (i = 0; /* void */ ; i++) {
 
-    if (h == NULL
-        || !u->cacheable
-        || u->conf->cache_max_range_offset == NGX_MAX_OFF_T_VALUE)
-    {
-        return NGX_OK;
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            h = part->elts;
+            i = 0;
+        }
+
+        if (h[i].key.len == sizeof(NGX_HTTP_UPSTREAM_CACHE_PEER) - 1
+            && ngx_strncasecmp(h[i].key.data,
+                               (u_char *) NGX_HTTP_UPSTREAM_CACHE_PEER,
+                               sizeof(NGX_HTTP_UPSTREAM_CACHE_PEER) - 1)
+               == 0)
+        {
+            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "http upstream cache peer request");
+            return NGX_OK;
+        }
     }
 
-    if (u->conf->cache_max_range_offset == 0) {
-        return NGX_DECLINED;
+    cp = u->conf->cache_peer;
+    uscf = cp->upstream;
+
+    if (uscf->peer.init(r, uscf) != NGX_OK) {
+        return NGX_ERROR;
     }
 
-    if (h->value.len < 7
-        || ngx_strncasecmp(h->value.data, (u_char *) "bytes=", 6) != 0)
-    {
+    rc = u->peer.get(&u->peer, u->peer.data);
+
+    if (rc != NGX_OK && rc != NGX_DONE) {
+        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http upstream cache peer: no live peers");
         return NGX_OK;
     }
 
-    p = h->value.data + 6;
+    if (rc == NGX_OK) {
+        addr = cp->self;
 
-    while (*p == ' ') { p++; }
+        for (i = 0; i < cp->nself; i++) {
+            if (ngx_cmp_sockaddr(u->peer.sockaddr, u->peer.socklen,
+                                 addr[i].sockaddr, addr[i].socklen, 1)
+                == NGX_OK)
+            {
+                ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                               "http upstream cache peer: \"%V\" is self",
+                               u->peer.name);
 
-    if (*p == '-') {
-        return NGX_DECLINED;
+                u->peer.free(&u->peer, u->peer.data, 0);
+
+                return NGX_OK;
+            }
+        }
     }
 
-    start = p;
+    pd = ngx_palloc(r->pool, sizeof(ngx_http_upstream_cache_peer_data_t));
+    if (pd == NULL) {
+        return NGX_ERROR;
+    }
 
-    while (*p >= '0' && *p <= '9') { p++; }
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream cache peer: \"%V\"", u->peer.name);
 
-    offset = ngx_atoof(start, p - start);
+    pd->data = u->peer.data;
+    pd->original_get_peer = u->peer.get;
+    pd->original_free_peer = u->peer.free;
 
-    if (offset >= u->conf->cache_max_range_offset) {
-        return NGX_DECLINED;
-    }
+    pd->rc = rc;
+    pd->selected = 1;
+
+    u->peer.data = pd;
+    u->peer.get = ngx_http_upstream_get_cache_peer;
+    u->peer.free = ngx_http_upstream_free_cache_peer;
+
+#if (NGX_HTTP_SSL)
+    pd->original_set_session = u->peer.set_session;
+    pd->original_save_session = u->peer.save_session;
+    u->peer.set_session = ngx_http_upstream_cache_peer_set_session;
+    u->peer.save_session = ngx_http_upstream_cache_peer_save_session;
+#endif
+
+    u->cache_peer = 1;
 
     return NGX_OK;
 }
 
-#endif
+
+static ngx_int_t
+ngx_http_upstream_get_cache_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_http_upstream_cache_peer_data_t  *pd = data;
+
+    if (pd->selected) {
+        pd->selected = 0;
+        return pd->rc;
+    }
+
+    return pd->original_get_peer(pc, pd->data);
+}
 
 
 static void
-ngx_http_upstream_resolve_handler(ngx_resolver_ctx_t *ctx)
+ngx_http_upstream_free_cache_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
 {
-    ngx_uint_t                     run_posted;
-    ngx_connection_t              *c;
-    ngx_http_request_t            *r;
-    ngx_http_upstream_t           *u;
-    ngx_http_upstream_resolved_t  *ur;
+    ngx_http_upstream_cache_peer_data_t  *pd = data;
 
-    run_posted = ctx->async;
+    pd->original_free_peer(pc, pd->data, state);
+}
 
-    r = ctx->data;
-    c = r->connection;
 
-    u = r->upstream;
-    ur = u->resolved;
+#if (NGX_HTTP_SSL)
 
-    ngx_http_set_log_request(c->log, r);
+static ngx_int_t
+ngx_http_upstream_cache_peer_set_session(ngx_peer_connection_t *pc,
+    void *data)
+{
+    ngx_http_upstream_cache_peer_data_t  *pd = data;
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "http upstream resolve: \"%V?%V\"", &r->uri, &r->args);
+    return pd->original_set_session(pc, pd->data);
+}
+
+
+static void
+ngx_http_upstream_cache_peer_save_session(ngx_peer_connection_t *pc,
+    void *data)
+{
+    ngx_http_upstream_cache_peer_data_t  *pd = data;
+
+    pd->original_save_session(pc, pd->data);
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_http_upstream_cache_background_update(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    ngx_http_request_t  *sr;
+
+    if (r == r->main) {
+        r->preserve_body = 1;
+    }
+
+    if (ngx_http_subrequest(r, &r->uri, &r->args, &sr, NULL,
+                            NGX_HTTP_SUBREQUEST_CLONE
+                            |NGX_HTTP_SUBREQUEST_BACKGROUND)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    sr->header_only = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_cache_write_back(ngx_http_request_t *r,
+    ngx_http_upstream_t *u, ngx_temp_file_t *tf)
+{
+    off_t                      size;
+    ssize_t                    n;
+    ngx_buf_t                 *b;
+    ngx_str_t                  uri, args;
+    ngx_uint_t                 flags;
+    ngx_http_request_t        *sr;
+    ngx_http_request_body_t   *rb;
+
+    /*
+     * a response just stored in the cache is also written to a second
+     * cache tier, usually a memcached location, with a background PUT
+     * subrequest; errors are not fatal as the response is already cached
+     */
+
+    if (u->conf->cache_write_back == NULL
+        || u->headers_in.status_n != NGX_HTTP_OK)
+    {
+        return;
+    }
+
+    size = tf->offset - (off_t) r->cache->body_start;
+
+    /* the default memcached item size limit */
+
+    if (size < 0 || size > 1024 * 1024) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http upstream cache write back skipped: %O", size);
+        return;
+    }
+
+    if (ngx_http_complex_value(r, u->conf->cache_write_back, &uri) != NGX_OK) {
+        return;
+    }
+
+    if (uri.len == 0) {
+        return;
+    }
+
+    ngx_str_null(&args);
+    flags = NGX_HTTP_LOG_UNSAFE;
+
+    if (ngx_http_parse_unsafe_uri(r, &uri, &args, &flags) != NGX_OK) {
+        return;
+    }
+
+    rb = ngx_pcalloc(r->pool, sizeof(ngx_http_request_body_t));
+    if (rb == NULL) {
+        return;
+    }
+
+    rb->bufs = ngx_alloc_chain_link(r->pool);
+    if (rb->bufs == NULL) {
+        return;
+    }
+
+    if (size) {
+        b = ngx_create_temp_buf(r->pool, (size_t) size);
+        if (b == NULL) {
+            return;
+        }
+
+        n = ngx_read_file(&tf->file, b->pos, (size_t) size,
+                          r->cache->body_start);
+
+        if (n != (ssize_t) size) {
+            ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                          ngx_read_file_n " read only %z of %O from \"%s\"",
+                          n, size, tf->file.name.data);
+            return;
+        }
+
+        b->last += n;
+
+    } else {
+        b = ngx_calloc_buf(r->pool);
+        if (b == NULL) {
+            return;
+        }
+    }
+
+    b->last_buf = 1;
+
+    rb->bufs->buf = b;
+    rb->bufs->next = NULL;
+    rb->rest = 0;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream cache write back: \"%V\" %O", &uri, size);
+
+    if (ngx_http_subrequest(r, &uri, &args, &sr, NULL,
+                            NGX_HTTP_SUBREQUEST_BACKGROUND)
+        != NGX_OK)
+    {
+        return;
+    }
+
+    sr->method = NGX_HTTP_PUT;
+    ngx_str_set(&sr->method_name, "PUT");
+
+    sr->request_body = rb;
+    sr->header_only = 1;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_cache_check_range(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    off_t             offset;
+    u_char           *p, *start;
+    ngx_table_elt_t  *h;
+
+    h = r->headers_in.range;
+
+    if (h == NULL
+        || !u->cacheable
+        || u->conf->cache_max_range_offset == NGX_MAX_OFF_T_VALUE)
+    {
+        return NGX_OK;
+    }
+
+    if (u->conf->cache_max_range_offset == 0) {
+        return NGX_DECLINED;
+    }
+
+    if (h->value.len < 7
+        || ngx_strncasecmp(h->value.data, (u_char *) "bytes=", 6) != 0)
+    {
+        return NGX_OK;
+    }
+
+    p = h->value.data + 6;
+
+    while (*p == ' ') { p++; }
+
+    if (*p == '-') {
+        return NGX_DECLINED;
+    }
+
+    start = p;
+
+    while (*p >= '0' && *p <= '9') { p++; }
+
+    offset = ngx_atoof(start, p - start);
+
+    if (offset >= u->conf->cache_max_range_offset) {
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static void
+ngx_http_upstream_resolve_handler(ngx_resolver_ctx_t *ctx)
+{
+    ngx_uint_t                     run_posted;
+    ngx_connection_t              *c;
+    ngx_http_request_t            *r;
+    ngx_http_upstream_t           *u;
+    ngx_http_upstream_resolved_t  *ur;
+
+    run_posted = ctx->async;
+
+    r = ctx->data;
+    c = r->connection;
+
+    u = r->upstream;
+    ur = u->resolved;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream resolve: \"%V?%V\"", &r->uri, &r->args);
 
     if (ctx->state) {
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
@@ -1287,6 +1863,11 @@ ngx_http_upstream_handler(ngx_event_t *ev)
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
                    "http upstream request: \"%V?%V\"", &r->uri, &r->args);
 
+    if (r->main->trace) {
+        ngx_http_trace_add(r, ev->write ? NGX_HTTP_TRACE_UPSTREAM_WRITE
+                                        : NGX_HTTP_TRACE_UPSTREAM_READ, ev);
+    }
+
     if (ev->delayed && ev->timedout) {
         ev->delayed = 0;
         ev->timedout = 0;
@@ -1533,24 +2114,35 @@ ngx_http_upstream_connect(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
     r->connection->log->action = "connecting to upstream";
 
-    if (u->state && u->state->response_time == (ngx_msec_t) -1) {
-        u->state->response_time = ngx_current_msec - u->start_time;
-    }
+    if (u->waiter && u->waiter->dispatched) {
 
-    u->state = ngx_array_push(r->upstream_states);
-    if (u->state == NULL) {
-        ngx_http_upstream_finalize_request(r, u,
-                                           NGX_HTTP_INTERNAL_SERVER_ERROR);
-        return;
-    }
+        /* a request dispatched from the queue keeps its state */
 
-    ngx_memzero(u->state, sizeof(ngx_http_upstream_state_t));
+        u->waiter->dispatched = 0;
 
-    u->start_time = ngx_current_msec;
+    } else {
 
-    u->state->response_time = (ngx_msec_t) -1;
-    u->state->connect_time = (ngx_msec_t) -1;
-    u->state->header_time = (ngx_msec_t) -1;
+        if (u->state && u->state->response_time == (ngx_msec_t) -1) {
+            u->state->response_time = ngx_current_msec - u->start_time;
+            u->state->response_usec = ngx_http_upstream_usec(u);
+        }
+
+        u->state = ngx_array_push(r->upstream_states);
+        if (u->state == NULL) {
+            ngx_http_upstream_finalize_request(r, u,
+                                               NGX_HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
+
+        ngx_memzero(u->state, sizeof(ngx_http_upstream_state_t));
+
+        u->state->response_time = (ngx_msec_t) -1;
+        u->state->connect_time = (ngx_msec_t) -1;
+        u->state->header_time = (ngx_msec_t) -1;
+    }
+
+    u->start_time = ngx_current_msec;
+    u->start_usec = r->start_usec ? ngx_monotonic_usec() : 0;
 
     rc = ngx_event_connect_peer(&u->peer);
 
@@ -1565,7 +2157,20 @@ ngx_http_upstream_connect(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
     u->state->peer = u->peer.name;
 
+    ngx_probe4(http__upstream__connect, r,
+               u->peer.name ? u->peer.name->data : NULL,
+               u->peer.name ? u->peer.name->len : 0, rc);
+
+    if (r->main->trace) {
+        ngx_http_trace_add(r, NGX_HTTP_TRACE_UPSTREAM_CONNECT, NULL);
+    }
+
     if (rc == NGX_BUSY) {
+
+        if (ngx_http_upstream_queue(r, u) == NGX_OK) {
+            return;
+        }
+
         ngx_log_error(NGX_LOG_ERR, r->connection->log, 0, "no live upstreams");
         ngx_http_upstream_next(r, u, NGX_HTTP_UPSTREAM_FT_NOLIVE);
         return;
@@ -1663,6 +2268,12 @@ ngx_http_upstream_connect(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
     if (rc == NGX_AGAIN) {
         ngx_add_timer(c->write, u->conf->connect_timeout);
+
+        if (ngx_http_upstream_race_init(r, u) != NGX_OK) {
+            ngx_http_upstream_finalize_request(r, u,
+                                               NGX_HTTP_INTERNAL_SERVER_ERROR);
+        }
+
         return;
     }
 
@@ -1693,6 +2304,8 @@ ngx_http_upstream_ssl_init_connection(ngx_http_request_t *r,
         return;
     }
 
+    ngx_http_upstream_race_close(r, u, 0);
+
     if (ngx_ssl_create_connection(u->conf->ssl, c,
                                   NGX_SSL_BUFFER|NGX_SSL_CLIENT)
         != NGX_OK)
@@ -1977,7 +2590,7 @@ ngx_http_upstream_ssl_certificate(ngx_http_request_t *r,
                    "http upstream ssl key: \"%s\"", key.data);
 
     if (ngx_ssl_connection_certificate(c, r->pool, &cert, &key,
-                                       u->conf->ssl_passwords)
+                                       u->conf->ssl_passwords, NULL)
         != NGX_OK)
     {
         return NGX_ERROR;
@@ -2089,6 +2702,7 @@ ngx_http_upstream_send_request(ngx_http_request_t *r, ngx_http_upstream_t *u,
 
     if (u->state->connect_time == (ngx_msec_t) -1) {
         u->state->connect_time = ngx_current_msec - u->start_time;
+        u->state->connect_usec = ngx_http_upstream_usec(u);
     }
 
     if (!u->request_sent && ngx_http_upstream_test_connect(c) != NGX_OK) {
@@ -2096,6 +2710,8 @@ ngx_http_upstream_send_request(ngx_http_request_t *r, ngx_http_upstream_t *u,
         return;
     }
 
+    ngx_http_upstream_race_close(r, u, 0);
+
     c->log->action = "sending request to upstream";
 
     rc = ngx_http_upstream_send_request_body(r, u, do_write);
@@ -2243,6 +2859,12 @@ ngx_http_upstream_send_request_body(ngx_http_request_t *r,
 
         r->read_event_handler = ngx_http_upstream_read_request_handler;
 
+#if (NGX_HAVE_SPLICE)
+        if (ngx_http_upstream_request_splice_init(r, u) != NGX_OK) {
+            return NGX_ERROR;
+        }
+#endif
+
     } else {
         out = NULL;
     }
@@ -2274,6 +2896,25 @@ ngx_http_upstream_send_request_body(ngx_http_request_t *r,
             }
         }
 
+#if (NGX_HAVE_SPLICE)
+
+        /* the data read into buffers are sent before splicing */
+
+        if (r->reading_body
+            && u->request_splice_pipe
+            && !u->request_body_blocked)
+        {
+            rc = ngx_http_upstream_splice_request_body(r, u);
+
+            if (rc == NGX_ERROR || rc >= NGX_HTTP_SPECIAL_RESPONSE) {
+                return rc;
+            }
+
+            break;
+        }
+
+#endif
+
         if (r->reading_body) {
             /* read client request body */
 
@@ -2463,6 +3104,10 @@ ngx_http_upstream_process_header(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
         u->state->bytes_received += n;
 
+        if (u->hedge) {
+            ngx_http_upstream_hedge_close(r, u, 0);
+        }
+
         u->buffer.last += n;
 
 #if 0
@@ -2504,6 +3149,13 @@ ngx_http_upstream_process_header(ngx_http_request_t *r, ngx_http_upstream_t *u)
     /* rc == NGX_OK */
 
     u->state->header_time = ngx_current_msec - u->start_time;
+    u->state->header_usec = ngx_http_upstream_usec(u);
+
+    ngx_probe2(http__upstream__response, r, u->headers_in.status_n);
+
+    if (r->main->trace) {
+        ngx_http_trace_add(r, NGX_HTTP_TRACE_UPSTREAM_HEADER, NULL);
+    }
 
     if (u->headers_in.status_n >= NGX_HTTP_SPECIAL_RESPONSE) {
 
@@ -2525,24 +3177,185 @@ ngx_http_upstream_process_header(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
 
 static ngx_int_t
-ngx_http_upstream_test_next(ngx_http_request_t *r, ngx_http_upstream_t *u)
+ngx_http_upstream_send_early_hints(ngx_http_request_t *r)
 {
-    ngx_msec_t                 timeout;
-    ngx_uint_t                 status, mask;
-    ngx_http_upstream_next_t  *un;
+    ngx_str_t                  value;
+    ngx_uint_t                 i;
+    ngx_list_t                 headers;
+    ngx_table_elt_t           *h;
+    ngx_http_complex_value_t  *cv;
+    ngx_http_core_loc_conf_t  *clcf;
 
-    status = u->headers_in.status_n;
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
-    for (un = ngx_http_upstream_next_errors; un->status; un++) {
+    /* the links are sent while the upstream server prepares the response */
 
-        if (status != un->status) {
-            continue;
-        }
+    if (!clcf->early_hints || clcf->early_hints_links == NULL) {
+        return NGX_OK;
+    }
 
-        timeout = u->conf->next_upstream_timeout;
+    if (ngx_list_init(&headers, r->pool, clcf->early_hints_links->nelts,
+                      sizeof(ngx_table_elt_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
 
-        if (u->request_sent
-            && (r->method & (NGX_HTTP_POST|NGX_HTTP_LOCK|NGX_HTTP_PATCH)))
+    cv = clcf->early_hints_links->elts;
+
+    for (i = 0; i < clcf->early_hints_links->nelts; i++) {
+
+        if (ngx_http_complex_value(r, &cv[i], &value) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        if (value.len == 0) {
+            continue;
+        }
+
+        h = ngx_list_push(&headers);
+        if (h == NULL) {
+            return NGX_ERROR;
+        }
+
+        h->hash = 1;
+        h->next = NULL;
+        ngx_str_set(&h->key, "Link");
+        h->value = value;
+    }
+
+    return ngx_http_send_early_hints(r, &headers);
+}
+
+
+ngx_int_t
+ngx_http_upstream_process_early_hints(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    u_char           *start;
+    ngx_uint_t        i;
+    ngx_list_t        headers;
+    ngx_list_part_t  *part;
+    ngx_table_elt_t  *h, *header;
+
+    /*
+     * called by protocol modules once an interim 1xx response header
+     * is parsed; links of 103 responses are relayed to the client, and
+     * the header is discarded before the final response is parsed
+     */
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream interim response: %ui",
+                   u->headers_in.status_n);
+
+    if (u->headers_in.status_n == NGX_HTTP_EARLY_HINTS) {
+
+        if (ngx_list_init(&headers, r->pool, 2, sizeof(ngx_table_elt_t))
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        part = &u->headers_in.headers.part;
+        header = part->elts;
+
+        for (i = 0; /* void */; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                header = part->elts;
+                i = 0;
+            }
+
+            if (header[i].hash == 0
+                || header[i].key.len != sizeof("Link") - 1
+                || ngx_strncasecmp(header[i].key.data, (u_char *) "Link",
+                                   sizeof("Link") - 1)
+                   != 0)
+            {
+                continue;
+            }
+
+            h = ngx_list_push(&headers);
+            if (h == NULL) {
+                return NGX_ERROR;
+            }
+
+            *h = header[i];
+            h->next = NULL;
+        }
+
+        if (ngx_http_send_early_hints(r, &headers) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    ngx_memzero(&u->headers_in, sizeof(ngx_http_upstream_headers_in_t));
+    u->headers_in.content_length_n = -1;
+    u->headers_in.last_modified_time = -1;
+
+    if (ngx_list_init(&u->headers_in.headers, r->pool, 8,
+                      sizeof(ngx_table_elt_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    if (ngx_list_init(&u->headers_in.trailers, r->pool, 2,
+                      sizeof(ngx_table_elt_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    if (u->state) {
+        u->state->status = 0;
+    }
+
+    /*
+     * the interim response is dropped from the buffer, so the final
+     * response header has the whole buffer and is cached without it
+     */
+
+    start = u->buffer.start;
+
+#if (NGX_HTTP_CACHE)
+    if (r->cache) {
+        start += r->cache->header_start;
+    }
+#endif
+
+    u->buffer.last = ngx_movemem(start, u->buffer.pos,
+                                 u->buffer.last - u->buffer.pos);
+    u->buffer.pos = start;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_test_next(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ngx_msec_t                 timeout;
+    ngx_uint_t                 status, mask;
+    ngx_http_upstream_next_t  *un;
+
+    status = u->headers_in.status_n;
+
+    for (un = ngx_http_upstream_next_errors; un->status; un++) {
+
+        if (status != un->status) {
+            continue;
+        }
+
+        timeout = u->conf->next_upstream_timeout;
+
+        if (u->request_sent
+            && (r->method & (NGX_HTTP_POST|NGX_HTTP_LOCK|NGX_HTTP_PATCH)))
         {
             mask = un->mask | NGX_HTTP_UPSTREAM_FT_NON_IDEMPOTENT;
 
@@ -3013,11 +3826,12 @@ ngx_http_upstream_process_trailers(ngx_http_request_t *r,
 static void
 ngx_http_upstream_send_response(ngx_http_request_t *r, ngx_http_upstream_t *u)
 {
-    ssize_t                    n;
-    ngx_int_t                  rc;
-    ngx_event_pipe_t          *p;
-    ngx_connection_t          *c;
-    ngx_http_core_loc_conf_t  *clcf;
+    ssize_t                         n;
+    ngx_int_t                       rc;
+    ngx_event_pipe_t               *p;
+    ngx_connection_t               *c;
+    ngx_http_core_loc_conf_t       *clcf;
+    ngx_http_upstream_main_conf_t  *umcf;
 
     rc = ngx_http_send_header(r);
 
@@ -3097,6 +3911,13 @@ ngx_http_upstream_send_response(ngx_http_request_t *r, ngx_http_upstream_t *u)
             return;
         }
 
+#if (NGX_HAVE_SPLICE)
+        if (ngx_http_upstream_splice_init(r, u) != NGX_OK) {
+            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+            return;
+        }
+#endif
+
         if (clcf->tcp_nodelay && ngx_tcp_nodelay(c) != NGX_OK) {
             ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
             return;
@@ -3201,6 +4022,15 @@ ngx_http_upstream_send_response(ngx_http_request_t *r, ngx_http_upstream_t *u)
                 ngx_str_null(&r->cache->etag);
             }
 
+            if (u->conf->cache_tag_header.len
+                && ngx_http_upstream_cache_tags(r, &u->headers_in.headers,
+                                                &r->cache->tags)
+                   != NGX_OK)
+            {
+                ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+                return;
+            }
+
             if (ngx_http_file_cache_set_header(r, u->buffer.start) != NGX_OK) {
                 ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
                 return;
@@ -3239,6 +4069,15 @@ ngx_http_upstream_send_response(ngx_http_request_t *r, ngx_http_upstream_t *u)
     p->limit_rate = ngx_http_complex_value_size(r, u->conf->limit_rate, 0);
     p->start_sec = ngx_time();
 
+    umcf = ngx_http_get_module_main_conf(r, ngx_http_upstream_module);
+
+    if (umcf->buffer_pool) {
+        if (ngx_event_pipe_set_buf_pool(p, umcf->buffer_pool) != NGX_OK) {
+            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+            return;
+        }
+    }
+
     p->cacheable = u->cacheable || u->store;
 
     p->temp_file = ngx_pcalloc(r->pool, sizeof(ngx_temp_file_t));
@@ -3748,6 +4587,24 @@ ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
             }
         }
 
+#if (NGX_HAVE_SPLICE)
+
+        /* the data read into the buffer are sent before splicing */
+
+        if (u->splice_pipe
+            && u->out_bufs == NULL
+            && u->busy_bufs == NULL
+            && !downstream->buffered)
+        {
+            if (ngx_http_upstream_process_splice(r, u) == NGX_DONE) {
+                return;
+            }
+
+            break;
+        }
+
+#endif
+
         size = b->end - b->last;
 
         if (size && upstream->read->ready) {
@@ -3815,673 +4672,2230 @@ ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
 }
 
 
-ngx_int_t
-ngx_http_upstream_non_buffered_filter_init(void *data)
-{
-    return NGX_OK;
-}
-
+#if (NGX_HAVE_SPLICE)
 
-ngx_int_t
-ngx_http_upstream_non_buffered_filter(void *data, ssize_t bytes)
+static ngx_int_t
+ngx_http_upstream_splice_init(ngx_http_request_t *r, ngx_http_upstream_t *u)
 {
-    ngx_http_request_t  *r = data;
-
-    ngx_buf_t            *b;
-    ngx_chain_t          *cl, **ll;
-    ngx_http_upstream_t  *u;
+    ngx_http_upstream_splice_t  *sp;
 
-    u = r->upstream;
+    /*
+     * the body is passed from the upstream socket to the client socket
+     * via a pipe if it is not changed by filters, that is, the length
+     * of the response is still known and no filter needs the data
+     */
 
-    if (u->length == 0) {
-        ngx_log_error(NGX_LOG_WARN, r->connection->log, 0,
-                      "upstream sent more data than specified in "
-                      "\"Content-Length\" header");
+    if (!u->splice
+        || !u->conf->splice
+        || r != r->main
+        || r->header_only
+        || r->http_version > NGX_HTTP_VERSION_11
+        || r->filter_need_in_memory
+        || r->main_filter_need_in_memory
+        || r->filter_need_temporary
+        || r->chunked
+        || r->limit_rate
+        || u->length <= 0
+        || r->headers_out.content_length_n != u->length
+#if (NGX_HTTP_SSL)
+        || r->connection->ssl
+        || u->peer.connection->ssl
+#endif
+       )
+    {
         return NGX_OK;
     }
 
-    for (cl = u->out_bufs, ll = &u->out_bufs; cl; cl = cl->next) {
-        ll = &cl->next;
+    if (ngx_http_upstream_splice_create(r, &u->splice_pipe) != NGX_OK) {
+        return NGX_ERROR;
     }
 
-    cl = ngx_chain_get_free_buf(r->pool, &u->free_bufs);
-    if (cl == NULL) {
-        return NGX_ERROR;
+    sp = u->splice_pipe;
+
+    if (sp) {
+        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http upstream splice: %d %d, length:%O",
+                       sp->fd[0], sp->fd[1], u->length);
     }
 
-    *ll = cl;
+    return NGX_OK;
+}
 
-    cl->buf->flush = 1;
-    cl->buf->memory = 1;
 
-    b = &u->buffer;
+static ngx_int_t
+ngx_http_upstream_process_splice(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    size_t                       size;
+    ssize_t                      n;
+    ngx_err_t                    err;
+    ngx_connection_t            *downstream, *upstream;
+    ngx_http_upstream_splice_t  *sp;
 
-    cl->buf->pos = b->last;
-    b->last += bytes;
-    cl->buf->last = b->last;
-    cl->buf->tag = u->output.tag;
+    sp = u->splice_pipe;
+    downstream = r->connection;
+    upstream = u->peer.connection;
 
-    if (u->length == -1) {
-        return NGX_OK;
-    }
+    for ( ;; ) {
 
-    if (bytes > u->length) {
+        if (sp->size && downstream->write->ready) {
 
-        ngx_log_error(NGX_LOG_WARN, r->connection->log, 0,
-                      "upstream sent more data than specified in "
-                      "\"Content-Length\" header");
+            n = splice(sp->fd[0], NULL, downstream->fd, NULL, sp->size,
+                       SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
 
-        cl->buf->last = cl->buf->pos + u->length;
-        u->length = 0;
+            ngx_log_debug2(NGX_LOG_DEBUG_HTTP, downstream->log, 0,
+                           "splice to client: %z of %uz", n, sp->size);
 
-        return NGX_OK;
-    }
+            if (n == -1) {
+                err = ngx_errno;
 
-    u->length -= bytes;
+                if (err == NGX_EAGAIN) {
+                    downstream->write->ready = 0;
 
-    return NGX_OK;
-}
+                } else if (err != NGX_EINTR) {
+                    downstream->write->error = 1;
+                    ngx_connection_error(downstream, err,
+                                         "splice() to client failed");
+                    ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+                    return NGX_DONE;
+                }
 
+            } else {
+                sp->size -= n;
+                downstream->sent += n;
+            }
 
-#if (NGX_THREADS)
+            continue;
+        }
 
-static ngx_int_t
-ngx_http_upstream_thread_handler(ngx_thread_task_t *task, ngx_file_t *file)
-{
-    ngx_str_t                  name;
-    ngx_event_pipe_t          *p;
-    ngx_connection_t          *c;
-    ngx_thread_pool_t         *tp;
-    ngx_http_request_t        *r;
-    ngx_http_core_loc_conf_t  *clcf;
+        if (sp->size == 0) {
 
-    r = file->thread_ctx;
-    p = r->upstream->pipe;
+            if (u->length == 0) {
+                ngx_http_upstream_finalize_request(r, u, 0);
+                return NGX_DONE;
+            }
 
-    if (r->aio) {
-        /*
-         * tolerate sendfile() calls if another operation is already
-         * running; this can happen due to subrequests, multiple calls
-         * of the next body filter from a filter, or in HTTP/2 due to
-         * a write event on the main connection
-         */
+            if (upstream->read->eof) {
+                ngx_log_error(NGX_LOG_ERR, upstream->log, 0,
+                              "upstream prematurely closed connection");
 
-        c = r->connection;
+                ngx_http_upstream_finalize_request(r, u, NGX_HTTP_BAD_GATEWAY);
+                return NGX_DONE;
+            }
 
-#if (NGX_HTTP_V2)
-        if (r->stream) {
-            c = r->stream->connection->connection;
+            if (upstream->read->error || u->error) {
+                ngx_http_upstream_finalize_request(r, u, NGX_HTTP_BAD_GATEWAY);
+                return NGX_DONE;
+            }
         }
-#endif
 
-        if (task == c->sendfile_task) {
+        size = NGX_HTTP_UPSTREAM_SPLICE_SIZE - sp->size;
+
+        if (size == 0 || u->length == 0 || !upstream->read->ready) {
             return NGX_OK;
         }
-    }
 
-    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
-    tp = clcf->thread_pool;
+        if ((off_t) size > u->length) {
+            size = (size_t) u->length;
+        }
 
-    if (tp == NULL) {
-        if (ngx_http_complex_value(r, clcf->thread_pool_value, &name)
-            != NGX_OK)
+        n = splice(upstream->fd, NULL, sp->fd[1], NULL, size,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, upstream->log, 0,
+                       "splice from upstream: %z of %uz", n, size);
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            if (err != NGX_EAGAIN) {
+                upstream->read->error = 1;
+                ngx_connection_error(upstream, err,
+                                     "splice() from upstream failed");
+                continue;
+            }
+
+            /* the pipe may be full, the socket is only known to be empty */
+
+            if (sp->size == 0) {
+                upstream->read->ready = 0;
+            }
+
+            return NGX_OK;
+        }
+
+        if (n == 0) {
+            upstream->read->ready = 0;
+            upstream->read->eof = 1;
+            continue;
+        }
+
+        sp->size += n;
+
+        u->state->bytes_received += n;
+        u->state->response_length += n;
+        u->length -= n;
+    }
+}
+
+
+static ngx_int_t
+ngx_http_upstream_request_splice_init(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    ngx_http_upstream_splice_t  *sp;
+
+    /*
+     * a request body of a known length is passed from the client socket
+     * to the upstream socket via a pipe if the module passes it as is;
+     * client_max_body_size was already tested against the length
+     */
+
+    if (!u->request_splice
+        || !u->conf->splice
+        || !r->reading_body
+        || r->http_version > NGX_HTTP_VERSION_11
+        || r->headers_in.chunked
+        || r->request_body->rest <= 0
+#if (NGX_HTTP_SSL)
+        || r->connection->ssl
+        || u->peer.connection->ssl
+#endif
+       )
+    {
+        return NGX_OK;
+    }
+
+    if (ngx_http_upstream_splice_create(r, &u->request_splice_pipe) != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    sp = u->request_splice_pipe;
+
+    if (sp) {
+        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http upstream request splice: %d %d, rest:%O",
+                       sp->fd[0], sp->fd[1], r->request_body->rest);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_splice_request_body(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    size_t                       size;
+    ssize_t                      n;
+    ngx_err_t                    err;
+    ngx_connection_t            *c, *pc;
+    ngx_http_request_body_t     *rb;
+    ngx_http_core_loc_conf_t    *clcf;
+    ngx_http_upstream_splice_t  *sp;
+
+    sp = u->request_splice_pipe;
+    rb = r->request_body;
+    c = r->connection;
+    pc = u->peer.connection;
+
+    if (c->read->timedout) {
+        c->timedout = 1;
+        return NGX_HTTP_REQUEST_TIME_OUT;
+    }
+
+    for ( ;; ) {
+
+        if (sp->size && pc->write->ready) {
+
+            n = splice(sp->fd[0], NULL, pc->fd, NULL, sp->size,
+                       SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+            ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                           "splice to upstream: %z of %uz", n, sp->size);
+
+            if (n == -1) {
+                err = ngx_errno;
+
+                if (err == NGX_EAGAIN) {
+                    pc->write->ready = 0;
+
+                } else if (err != NGX_EINTR) {
+                    pc->write->error = 1;
+                    ngx_connection_error(pc, err,
+                                         "splice() to upstream failed");
+                    return NGX_ERROR;
+                }
+
+            } else {
+                sp->size -= n;
+                pc->sent += n;
+            }
+
+            continue;
+        }
+
+        if (sp->size == 0 && rb->rest == 0) {
+            break;
+        }
+
+        size = NGX_HTTP_UPSTREAM_SPLICE_SIZE - sp->size;
+
+        if (size == 0 || rb->rest == 0 || !c->read->ready) {
+            goto again;
+        }
+
+        if ((off_t) size > rb->rest) {
+            size = (size_t) rb->rest;
+        }
+
+        n = splice(c->fd, NULL, sp->fd[1], NULL, size,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                       "splice from client: %z of %uz", n, size);
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            if (err != NGX_EAGAIN) {
+                c->error = 1;
+                ngx_connection_error(c, err, "splice() from client failed");
+                return NGX_HTTP_BAD_REQUEST;
+            }
+
+            /* the pipe may be full, the socket is only known to be empty */
+
+            if (sp->size == 0) {
+                c->read->ready = 0;
+            }
+
+            goto again;
+        }
+
+        if (n == 0) {
+            ngx_log_error(NGX_LOG_INFO, c->log, 0,
+                          "client prematurely closed connection");
+            c->error = 1;
+            return NGX_HTTP_BAD_REQUEST;
+        }
+
+        sp->size += n;
+        rb->rest -= n;
+        r->request_length += n;
+    }
+
+    /* the whole request body was sent */
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream request body spliced");
+
+    rb->last_saved = 1;
+    rb->read_time = ngx_current_msec - rb->start_time;
+
+    r->reading_body = 0;
+
+    if (c->read->timer_set) {
+        ngx_del_timer(c->read);
+    }
+
+    return NGX_OK;
+
+again:
+
+    if (sp->size == 0) {
+
+        /* waiting for the client */
+
+        clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+        ngx_add_timer(c->read, clcf->client_body_timeout);
+
+    } else if (c->read->timer_set) {
+
+        /* waiting for the upstream, send_timeout is used */
+
+        ngx_del_timer(c->read);
+    }
+
+    if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_splice_create(ngx_http_request_t *r,
+    ngx_http_upstream_splice_t **spp)
+{
+    ngx_pool_cleanup_t          *cln;
+    ngx_http_upstream_splice_t  *sp;
+
+    /* a failure to create a pipe is not fatal, buffers are used then */
+
+    cln = ngx_pool_cleanup_add(r->pool, sizeof(ngx_http_upstream_splice_t));
+    if (cln == NULL) {
+        return NGX_ERROR;
+    }
+
+    sp = cln->data;
+
+    if (pipe2(sp->fd, O_NONBLOCK|O_CLOEXEC) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, r->connection->log, ngx_errno,
+                      "pipe2() failed");
+        return NGX_OK;
+    }
+
+    sp->size = 0;
+
+    cln->handler = ngx_http_upstream_splice_cleanup;
+
+    *spp = sp;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_splice_cleanup(void *data)
+{
+    ngx_http_upstream_splice_t  *sp = data;
+
+    if (close(sp->fd[0]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "close() splice pipe failed");
+    }
+
+    if (close(sp->fd[1]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "close() splice pipe failed");
+    }
+}
+
+#endif
+
+
+ngx_int_t
+ngx_http_upstream_non_buffered_filter_init(void *data)
+{
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_upstream_non_buffered_filter(void *data, ssize_t bytes)
+{
+    ngx_http_request_t  *r = data;
+
+    ngx_buf_t            *b;
+    ngx_chain_t          *cl, **ll;
+    ngx_http_upstream_t  *u;
+
+    u = r->upstream;
+
+    if (u->length == 0) {
+        ngx_log_error(NGX_LOG_WARN, r->connection->log, 0,
+                      "upstream sent more data than specified in "
+                      "\"Content-Length\" header");
+        return NGX_OK;
+    }
+
+    for (cl = u->out_bufs, ll = &u->out_bufs; cl; cl = cl->next) {
+        ll = &cl->next;
+    }
+
+    cl = ngx_chain_get_free_buf(r->pool, &u->free_bufs);
+    if (cl == NULL) {
+        return NGX_ERROR;
+    }
+
+    *ll = cl;
+
+    cl->buf->flush = 1;
+    cl->buf->memory = 1;
+
+    b = &u->buffer;
+
+    cl->buf->pos = b->last;
+    b->last += bytes;
+    cl->buf->last = b->last;
+    cl->buf->tag = u->output.tag;
+
+    if (u->length == -1) {
+        return NGX_OK;
+    }
+
+    if (bytes > u->length) {
+
+        ngx_log_error(NGX_LOG_WARN, r->connection->log, 0,
+                      "upstream sent more data than specified in "
+                      "\"Content-Length\" header");
+
+        cl->buf->last = cl->buf->pos + u->length;
+        u->length = 0;
+
+        return NGX_OK;
+    }
+
+    u->length -= bytes;
+
+    return NGX_OK;
+}
+
+
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_http_upstream_thread_handler(ngx_thread_task_t *task, ngx_file_t *file)
+{
+    ngx_str_t                  name;
+    ngx_event_pipe_t          *p;
+    ngx_connection_t          *c;
+    ngx_thread_pool_t         *tp;
+    ngx_http_request_t        *r;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    r = file->thread_ctx;
+    p = r->upstream->pipe;
+
+    if (r->aio) {
+        /*
+         * tolerate sendfile() calls if another operation is already
+         * running; this can happen due to subrequests, multiple calls
+         * of the next body filter from a filter, or in HTTP/2 due to
+         * a write event on the main connection
+         */
+
+        c = r->connection;
+
+#if (NGX_HTTP_V2)
+        if (r->stream) {
+            c = r->stream->connection->connection;
+        }
+#endif
+
+        if (task == c->sendfile_task) {
+            return NGX_OK;
+        }
+    }
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+    tp = clcf->thread_pool;
+
+    if (tp == NULL) {
+        if (ngx_http_complex_value(r, clcf->thread_pool_value, &name)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        tp = ngx_thread_pool_get((ngx_cycle_t *) ngx_cycle, &name);
+
+        if (tp == NULL) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "thread pool \"%V\" not found", &name);
+            return NGX_ERROR;
+        }
+    }
+
+    task->event.data = r;
+    task->event.handler = ngx_http_upstream_thread_event_handler;
+
+    if (ngx_thread_task_post(tp, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->main->blocked++;
+    r->aio = 1;
+    p->aio = 1;
+
+    ngx_add_timer(&task->event, 60000);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
+
+    r = ev->data;
+    c = r->connection;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream thread: \"%V?%V\"", &r->uri, &r->args);
+
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
+                      "thread operation took too long");
+        ev->timedout = 0;
+        return;
+    }
+
+    if (ev->timer_set) {
+        ngx_del_timer(ev);
+    }
+
+    r->main->blocked--;
+    r->aio = 0;
+
+#if (NGX_HTTP_V2)
+
+    if (r->stream) {
+        /*
+         * for HTTP/2, update write event to make sure processing will
+         * reach the main connection to handle sendfile() in threads
+         */
+
+        c->write->ready = 1;
+        c->write->active = 0;
+    }
+
+#endif
+
+    if (r->done || r->main->terminated) {
+        /*
+         * trigger connection event handler if the subrequest was
+         * already finalized (this can happen if the handler is used
+         * for sendfile() in threads), or if the request was terminated
+         */
+
+        c->write->handler(c->write);
+
+    } else {
+        r->write_event_handler(r);
+        ngx_http_run_posted_requests(c);
+    }
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_http_upstream_output_filter(void *data, ngx_chain_t *chain)
+{
+    ngx_int_t            rc;
+    ngx_event_pipe_t    *p;
+    ngx_http_request_t  *r;
+
+    r = data;
+    p = r->upstream->pipe;
+
+    rc = ngx_http_output_filter(r, chain);
+
+    p->aio = r->aio;
+
+    return rc;
+}
+
+
+static void
+ngx_http_upstream_process_downstream(ngx_http_request_t *r)
+{
+    ngx_event_t          *wev;
+    ngx_connection_t     *c;
+    ngx_event_pipe_t     *p;
+    ngx_http_upstream_t  *u;
+
+    c = r->connection;
+    u = r->upstream;
+    p = u->pipe;
+    wev = c->write;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream process downstream");
+
+    c->log->action = "sending to client";
+
+#if (NGX_THREADS)
+    p->aio = r->aio;
+#endif
+
+    if (wev->timedout) {
+
+        p->downstream_error = 1;
+        c->timedout = 1;
+        ngx_connection_error(c, NGX_ETIMEDOUT, "client timed out");
+
+    } else {
+
+        if (wev->delayed) {
+
+            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                           "http downstream delayed");
+
+            if (ngx_handle_write_event(wev, p->send_lowat) != NGX_OK) {
+                ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+            }
+
+            return;
+        }
+
+        if (ngx_event_pipe(p, 1) == NGX_ABORT) {
+            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+            return;
+        }
+    }
+
+    ngx_http_upstream_process_request(r, u);
+}
+
+
+static void
+ngx_http_upstream_process_upstream(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    ngx_event_t       *rev;
+    ngx_event_pipe_t  *p;
+    ngx_connection_t  *c;
+
+    c = u->peer.connection;
+    p = u->pipe;
+    rev = c->read;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream process upstream");
+
+    c->log->action = "reading upstream";
+
+    if (rev->timedout) {
+
+        p->upstream_error = 1;
+        ngx_connection_error(c, NGX_ETIMEDOUT, "upstream timed out");
+
+    } else {
+
+        if (rev->delayed) {
+
+            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                           "http upstream delayed");
+
+            if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+                ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+            }
+
+            return;
+        }
+
+        if (ngx_event_pipe(p, 0) == NGX_ABORT) {
+            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+            return;
+        }
+    }
+
+    ngx_http_upstream_process_request(r, u);
+}
+
+
+static void
+ngx_http_upstream_process_request(ngx_http_request_t *r,
+    ngx_http_upstream_t *u)
+{
+    ngx_temp_file_t   *tf;
+    ngx_event_pipe_t  *p;
+
+    p = u->pipe;
+
+#if (NGX_THREADS)
+
+    if (p->writing && !p->aio) {
+
+        /*
+         * make sure to call ngx_event_pipe()
+         * if there is an incomplete aio write
+         */
+
+        if (ngx_event_pipe(p, 1) == NGX_ABORT) {
+            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+            return;
+        }
+    }
+
+    if (p->writing) {
+        return;
+    }
+
+#endif
+
+    if (u->peer.connection) {
+
+        if (u->store) {
+
+            if (p->upstream_eof || p->upstream_done) {
+
+                tf = p->temp_file;
+
+                if (u->headers_in.status_n == NGX_HTTP_OK
+                    && (p->upstream_done || p->length == -1)
+                    && (u->headers_in.content_length_n == -1
+                        || u->headers_in.content_length_n == tf->offset))
+                {
+                    ngx_http_upstream_store(r, u);
+                }
+            }
+        }
+
+#if (NGX_HTTP_CACHE)
+
+        if (u->cacheable) {
+
+            if (p->upstream_done) {
+                ngx_http_file_cache_update(r, p->temp_file);
+                ngx_http_upstream_cache_write_back(r, u, p->temp_file);
+
+            } else if (p->upstream_eof) {
+
+                tf = p->temp_file;
+
+                if (p->length == -1
+                    && (u->headers_in.content_length_n == -1
+                        || u->headers_in.content_length_n
+                           == tf->offset - (off_t) r->cache->body_start))
+                {
+                    ngx_http_file_cache_update(r, tf);
+                    ngx_http_upstream_cache_write_back(r, u, tf);
+
+                } else {
+                    ngx_http_file_cache_free(r->cache, tf);
+                }
+
+            } else if (p->upstream_error) {
+                ngx_http_file_cache_free(r->cache, p->temp_file);
+
+            } else {
+                ngx_http_file_cache_stream_update(r, p->temp_file);
+            }
+        }
+
+#endif
+
+        if (p->upstream_done || p->upstream_eof || p->upstream_error) {
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "http upstream exit: %p", p->out);
+
+            if (p->upstream_done
+                || (p->upstream_eof && p->length == -1))
+            {
+                ngx_http_upstream_finalize_request(r, u, 0);
+                return;
+            }
+
+            if (p->upstream_eof) {
+                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                              "upstream prematurely closed connection");
+            }
+
+            ngx_http_upstream_finalize_request(r, u, NGX_HTTP_BAD_GATEWAY);
+            return;
+        }
+    }
+
+    if (p->downstream_error) {
+        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http upstream downstream error");
+
+        if (!u->cacheable && !u->store && u->peer.connection) {
+            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+        }
+    }
+}
+
+
+static void
+ngx_http_upstream_store(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    size_t                  root;
+    time_t                  lm;
+    ngx_str_t               path;
+    ngx_temp_file_t        *tf;
+    ngx_ext_rename_file_t   ext;
+
+    tf = u->pipe->temp_file;
+
+    if (tf->file.fd == NGX_INVALID_FILE) {
+
+        /* create file for empty 200 response */
+
+        tf = ngx_pcalloc(r->pool, sizeof(ngx_temp_file_t));
+        if (tf == NULL) {
+            return;
+        }
+
+        tf->file.fd = NGX_INVALID_FILE;
+        tf->file.log = r->connection->log;
+        tf->path = u->conf->temp_path;
+        tf->pool = r->pool;
+        tf->persistent = 1;
+
+        if (ngx_create_temp_file(&tf->file, tf->path, tf->pool,
+                                 tf->persistent, tf->clean, tf->access)
+            != NGX_OK)
         {
-            return NGX_ERROR;
+            return;
+        }
+
+        u->pipe->temp_file = tf;
+    }
+
+    ext.access = u->conf->store_access;
+    ext.path_access = u->conf->store_access;
+    ext.time = -1;
+    ext.create_path = 1;
+    ext.delete_file = 1;
+    ext.log = r->connection->log;
+
+    if (u->headers_in.last_modified) {
+
+        lm = ngx_parse_http_time(u->headers_in.last_modified->value.data,
+                                 u->headers_in.last_modified->value.len);
+
+        if (lm != NGX_ERROR) {
+            ext.time = lm;
+            ext.fd = tf->file.fd;
+        }
+    }
+
+    if (u->conf->store_lengths == NULL) {
+
+        if (ngx_http_map_uri_to_path(r, &path, &root, 0) == NULL) {
+            return;
+        }
+
+    } else {
+        if (ngx_http_script_run(r, &path, u->conf->store_lengths->elts, 0,
+                                u->conf->store_values->elts)
+            == NULL)
+        {
+            return;
+        }
+    }
+
+    path.len--;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "upstream stores \"%s\" to \"%s\"",
+                   tf->file.name.data, path.data);
+
+    (void) ngx_ext_rename_file(&tf->file.name, &path, &ext);
+
+    u->store = 0;
+}
+
+
+static void
+ngx_http_upstream_dummy_handler(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream dummy handler");
+}
+
+
+static void
+ngx_http_upstream_next(ngx_http_request_t *r, ngx_http_upstream_t *u,
+    ngx_uint_t ft_type)
+{
+    ngx_int_t   rc;
+    ngx_msec_t  timeout;
+    ngx_uint_t  status, state;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http next upstream, %xi", ft_type);
+
+    ngx_http_upstream_hedge_close(r, u, 0);
+
+    if (u->peer.sockaddr) {
+
+        if (u->peer.connection) {
+            u->state->bytes_sent = u->peer.connection->sent;
+        }
+
+        if (ft_type == NGX_HTTP_UPSTREAM_FT_HTTP_403
+            || ft_type == NGX_HTTP_UPSTREAM_FT_HTTP_404)
+        {
+            state = NGX_PEER_NEXT;
+
+        } else {
+            state = NGX_PEER_FAILED;
+        }
+
+        u->peer.free(&u->peer, u->peer.data, state);
+        u->peer.sockaddr = NULL;
+
+        ngx_http_upstream_queue_dispatch(u->upstream);
+    }
+
+    if (ft_type == NGX_HTTP_UPSTREAM_FT_TIMEOUT) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, NGX_ETIMEDOUT,
+                      "upstream timed out");
+    }
+
+    if (u->peer.cached && ft_type == NGX_HTTP_UPSTREAM_FT_ERROR) {
+        /* TODO: inform balancer instead */
+        u->peer.tries++;
+    }
+
+    switch (ft_type) {
+
+    case NGX_HTTP_UPSTREAM_FT_TIMEOUT:
+    case NGX_HTTP_UPSTREAM_FT_HTTP_504:
+        status = NGX_HTTP_GATEWAY_TIME_OUT;
+        break;
+
+    case NGX_HTTP_UPSTREAM_FT_HTTP_500:
+        status = NGX_HTTP_INTERNAL_SERVER_ERROR;
+        break;
+
+    case NGX_HTTP_UPSTREAM_FT_HTTP_503:
+        status = NGX_HTTP_SERVICE_UNAVAILABLE;
+        break;
+
+    case NGX_HTTP_UPSTREAM_FT_HTTP_403:
+        status = NGX_HTTP_FORBIDDEN;
+        break;
+
+    case NGX_HTTP_UPSTREAM_FT_HTTP_404:
+        status = NGX_HTTP_NOT_FOUND;
+        break;
+
+    case NGX_HTTP_UPSTREAM_FT_HTTP_429:
+        status = NGX_HTTP_TOO_MANY_REQUESTS;
+        break;
+
+    /*
+     * NGX_HTTP_UPSTREAM_FT_BUSY_LOCK and NGX_HTTP_UPSTREAM_FT_MAX_WAITING
+     * never reach here
+     */
+
+    default:
+        status = NGX_HTTP_BAD_GATEWAY;
+    }
+
+    if (r->connection->error) {
+        ngx_http_upstream_finalize_request(r, u,
+                                           NGX_HTTP_CLIENT_CLOSED_REQUEST);
+        return;
+    }
+
+    u->state->status = status;
+
+    timeout = u->conf->next_upstream_timeout;
+
+    if (u->request_sent
+        && (r->method & (NGX_HTTP_POST|NGX_HTTP_LOCK|NGX_HTTP_PATCH)))
+    {
+        ft_type |= NGX_HTTP_UPSTREAM_FT_NON_IDEMPOTENT;
+    }
+
+    if (u->peer.tries == 0
+        || ((u->conf->next_upstream & ft_type) != ft_type)
+        || (u->request_sent && r->request_body_no_buffering)
+        || (timeout && ngx_current_msec - u->peer.start_time >= timeout))
+    {
+#if (NGX_HTTP_CACHE)
+
+        if (u->cache_status == NGX_HTTP_CACHE_EXPIRED
+            && ((u->conf->cache_use_stale & ft_type) || r->cache->stale_error))
+        {
+            rc = u->reinit_request(r);
+
+            if (rc != NGX_OK) {
+                ngx_http_upstream_finalize_request(r, u, rc);
+                return;
+            }
+
+            u->cache_status = NGX_HTTP_CACHE_STALE;
+            rc = ngx_http_upstream_cache_send(r, u);
+
+            if (rc == NGX_DONE) {
+                return;
+            }
+
+            if (rc == NGX_HTTP_UPSTREAM_INVALID_HEADER) {
+                rc = NGX_HTTP_INTERNAL_SERVER_ERROR;
+            }
+
+            ngx_http_upstream_finalize_request(r, u, rc);
+            return;
+        }
+#endif
+
+        ngx_http_upstream_finalize_request(r, u, status);
+        return;
+    }
+
+    if (u->peer.connection) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "close http upstream connection: %d",
+                       u->peer.connection->fd);
+#if (NGX_HTTP_SSL)
+
+        if (u->peer.connection->ssl) {
+            u->peer.connection->ssl->no_wait_shutdown = 1;
+            u->peer.connection->ssl->no_send_shutdown = 1;
+
+            (void) ngx_ssl_shutdown(u->peer.connection);
+        }
+#endif
+
+        if (u->peer.connection->pool) {
+            ngx_destroy_pool(u->peer.connection->pool);
+        }
+
+        ngx_close_connection(u->peer.connection);
+        u->peer.connection = NULL;
+    }
+
+    rc = ngx_http_upstream_race_promote(r, u);
+
+    if (rc == NGX_OK) {
+        return;
+    }
+
+    if (rc == NGX_ERROR) {
+        ngx_http_upstream_finalize_request(r, u,
+                                           NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    ngx_http_upstream_connect(r, u);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_hedge_init(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ngx_http_upstream_hedge_t     *h;
+    ngx_http_upstream_srv_conf_t  *uscf;
+
+    uscf = u->upstream;
+
+    if (u->conf->hedge_delay == 0
+        || uscf->hedge_budget == 0
+        || u->ssl
+        || !(r->method & (NGX_HTTP_GET|NGX_HTTP_HEAD))
+        || r->headers_in.content_length_n > 0
+        || r->headers_in.chunked)
+    {
+        return NGX_OK;
+    }
+
+    /*
+     * each request adds its share of a hedge to the budget,
+     * unused hedges are accumulated up to a limit
+     */
+
+    if (uscf->hedge_tokens
+        < NGX_HTTP_UPSTREAM_HEDGE_COST * NGX_HTTP_UPSTREAM_HEDGE_BURST)
+    {
+        uscf->hedge_tokens += uscf->hedge_budget;
+    }
+
+    h = ngx_pcalloc(r->pool, sizeof(ngx_http_upstream_hedge_t));
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    h->upstream = u;
+
+    h->event.handler = ngx_http_upstream_hedge_start;
+    h->event.data = r;
+    h->event.log = r->connection->log;
+
+    ngx_add_timer(&h->event, u->conf->hedge_delay);
+
+    u->hedge = h;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_hedge_start(ngx_event_t *ev)
+{
+    size_t                         size;
+    u_char                        *p;
+    ngx_int_t                      rc;
+    ngx_chain_t                   *cl;
+    ngx_connection_t              *c;
+    ngx_http_request_t            *r;
+    ngx_http_upstream_t           *u;
+    ngx_peer_connection_t          peer;
+    ngx_http_upstream_hedge_t     *h;
+    ngx_http_upstream_srv_conf_t  *uscf;
+
+    r = ev->data;
+    u = r->upstream;
+    h = u->hedge;
+
+    uscf = u->upstream;
+
+    if (uscf->hedge_tokens < NGX_HTTP_UPSTREAM_HEDGE_COST) {
+        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                       "http upstream hedge budget exhausted");
+        u->hedge = NULL;
+        return;
+    }
+
+    /* a copy of the request, the request buffers are used by the upstream */
+
+    size = 0;
+
+    for (cl = u->request_bufs; cl; cl = cl->next) {
+
+        if (ngx_buf_special(cl->buf)) {
+            continue;
+        }
+
+        if (!ngx_buf_in_memory_only(cl->buf)) {
+            u->hedge = NULL;
+            return;
+        }
+
+        size += cl->buf->last - cl->buf->start;
+    }
+
+    h->buf = ngx_create_temp_buf(r->pool, size);
+    if (h->buf == NULL) {
+        u->hedge = NULL;
+        return;
+    }
+
+    p = h->buf->last;
+
+    for (cl = u->request_bufs; cl; cl = cl->next) {
+        if (!ngx_buf_special(cl->buf)) {
+            p = ngx_cpymem(p, cl->buf->start, cl->buf->last - cl->buf->start);
+        }
+    }
+
+    h->buf->last = p;
+
+    /* a separate balancer state, the peer of the request is not changed */
+
+    peer = u->peer;
+    u->peer.data = NULL;
+
+    rc = uscf->peer.init(r, uscf);
+
+    h->peer = u->peer;
+    u->peer = peer;
+
+    if (rc != NGX_OK) {
+        u->hedge = NULL;
+        return;
+    }
+
+    h->data = h->peer.data;
+    h->get = h->peer.get;
+    h->free = h->peer.free;
+
+    h->peer.data = h;
+    h->peer.get = ngx_http_upstream_hedge_get_peer;
+    h->peer.free = ngx_http_upstream_hedge_free_peer;
+
+    h->peer.connection = NULL;
+    h->peer.sockaddr = NULL;
+    h->peer.name = NULL;
+    h->peer.cached = 0;
+    h->peer.start_time = ngx_current_msec;
+
+    h->start_time = ngx_current_msec;
+    h->connect_time = (ngx_msec_t) -1;
+    h->start_usec = r->start_usec ? ngx_monotonic_usec() : 0;
+
+    r->connection->log->action = "hedging request to upstream";
+
+    rc = ngx_event_connect_peer(&h->peer);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "http upstream hedge connect: %i", rc);
+
+    if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
+        ngx_http_upstream_hedge_close(r, u, NGX_PEER_FAILED);
+        return;
+    }
+
+    uscf->hedge_tokens -= NGX_HTTP_UPSTREAM_HEDGE_COST;
+
+    c = h->peer.connection;
+
+    c->requests++;
+
+    c->data = r;
+
+    c->write->handler = ngx_http_upstream_hedge_handler;
+    c->read->handler = ngx_http_upstream_hedge_handler;
+
+    if (c->pool == NULL) {
+        c->pool = ngx_create_pool(128, r->connection->log);
+        if (c->pool == NULL) {
+            ngx_http_upstream_hedge_close(r, u, 0);
+            return;
+        }
+    }
+
+    c->log = r->connection->log;
+    c->pool->log = c->log;
+    c->read->log = c->log;
+    c->write->log = c->log;
+
+    if (rc == NGX_AGAIN) {
+        ngx_add_timer(c->write, u->conf->connect_timeout);
+        return;
+    }
+
+    ngx_http_upstream_hedge_send(r, u);
+}
+
+
+static void
+ngx_http_upstream_hedge_handler(ngx_event_t *ev)
+{
+    ngx_connection_t     *c;
+    ngx_http_request_t   *r;
+    ngx_http_upstream_t  *u;
+
+    c = ev->data;
+    r = c->data;
+
+    u = r->upstream;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream hedge request: \"%V?%V\"", &r->uri, &r->args);
+
+    c->log->action = "hedging request to upstream";
+
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "upstream %V timed out", u->hedge->peer.name);
+        ngx_http_upstream_hedge_close(r, u, NGX_PEER_FAILED);
+
+    } else if (ev->write) {
+        ngx_http_upstream_hedge_send(r, u);
+
+    } else {
+        ngx_http_upstream_hedge_read(r, u);
+    }
+
+    ngx_http_run_posted_requests(r->connection);
+}
+
+
+static void
+ngx_http_upstream_hedge_send(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ssize_t                     n;
+    ngx_buf_t                  *b;
+    ngx_connection_t           *c;
+    ngx_http_upstream_hedge_t  *h;
+
+    h = u->hedge;
+    c = h->peer.connection;
+    b = h->buf;
+
+    if (h->connect_time == (ngx_msec_t) -1) {
+
+        if (ngx_http_upstream_test_connect(c) != NGX_OK) {
+            ngx_http_upstream_hedge_close(r, u, NGX_PEER_FAILED);
+            return;
+        }
+
+        h->connect_time = ngx_current_msec - h->start_time;
+        h->connect_usec = ngx_http_upstream_usec(h);
+    }
+
+    while (b->pos < b->last) {
+
+        n = c->send(c, b->pos, b->last - b->pos);
+
+        if (n == NGX_ERROR) {
+            ngx_http_upstream_hedge_close(r, u, NGX_PEER_FAILED);
+            return;
+        }
+
+        if (n == NGX_AGAIN) {
+            ngx_add_timer(c->write, u->conf->send_timeout);
+
+            if (ngx_handle_write_event(c->write, 0) != NGX_OK) {
+                ngx_http_upstream_hedge_close(r, u, 0);
+            }
+
+            return;
+        }
+
+        b->pos += n;
+    }
+
+    if (c->write->timer_set) {
+        ngx_del_timer(c->write);
+    }
+
+    if (ngx_handle_write_event(c->write, 0) != NGX_OK) {
+        ngx_http_upstream_hedge_close(r, u, 0);
+        return;
+    }
+
+    if (!c->read->timer_set) {
+        ngx_add_timer(c->read, u->conf->read_timeout);
+    }
+
+    ngx_http_upstream_hedge_read(r, u);
+}
+
+
+static void
+ngx_http_upstream_hedge_read(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    int                         n;
+    char                        buf[1];
+    ngx_err_t                   err;
+    ngx_connection_t           *c;
+    ngx_http_upstream_hedge_t  *h;
+
+    h = u->hedge;
+    c = h->peer.connection;
+
+    if (h->buf->pos < h->buf->last) {
+        /* the request is not yet sent */
+        return;
+    }
+
+    n = recv(c->fd, buf, 1, MSG_PEEK);
+
+    err = ngx_socket_errno;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, err,
+                   "http upstream hedge recv(): %d", n);
+
+    if (n > 0) {
+        ngx_http_upstream_hedge_swap(r, u);
+        return;
+    }
+
+    if (n == -1 && err == NGX_EAGAIN) {
+        c->read->ready = 0;
+
+        if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+            ngx_http_upstream_hedge_close(r, u, 0);
+        }
+
+        return;
+    }
+
+    if (n == 0) {
+        ngx_log_error(NGX_LOG_ERR, c->log, 0,
+                      "upstream %V prematurely closed connection",
+                      h->peer.name);
+
+    } else {
+        ngx_log_error(NGX_LOG_ERR, c->log, err,
+                      "recv() from upstream %V failed", h->peer.name);
+    }
+
+    ngx_http_upstream_hedge_close(r, u, NGX_PEER_FAILED);
+}
+
+
+static void
+ngx_http_upstream_hedge_swap(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ngx_connection_t           *c;
+    ngx_http_upstream_hedge_t  *h;
+
+    h = u->hedge;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream hedge responded first: %V", h->peer.name);
+
+    /* the original request is abandoned, it is not a failure of the peer */
+
+    if (u->peer.connection) {
+        u->state->bytes_sent = u->peer.connection->sent;
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "close http upstream connection: %d",
+                       u->peer.connection->fd);
+
+        if (u->peer.connection->pool) {
+            ngx_destroy_pool(u->peer.connection->pool);
         }
 
-        tp = ngx_thread_pool_get((ngx_cycle_t *) ngx_cycle, &name);
+        ngx_close_connection(u->peer.connection);
+        u->peer.connection = NULL;
+    }
 
-        if (tp == NULL) {
-            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
-                          "thread pool \"%V\" not found", &name);
-            return NGX_ERROR;
-        }
+    if (u->peer.sockaddr) {
+        u->peer.free(&u->peer, u->peer.data, 0);
+        u->peer.sockaddr = NULL;
+
+        ngx_http_upstream_queue_dispatch(u->upstream);
     }
 
-    task->event.data = r;
-    task->event.handler = ngx_http_upstream_thread_event_handler;
+    if (u->state->response_time == (ngx_msec_t) -1) {
+        u->state->response_time = ngx_current_msec - u->start_time;
+        u->state->response_usec = ngx_http_upstream_usec(u);
+    }
 
-    if (ngx_thread_task_post(tp, task) != NGX_OK) {
-        return NGX_ERROR;
+    u->state = ngx_array_push(r->upstream_states);
+    if (u->state == NULL) {
+        ngx_http_upstream_finalize_request(r, u,
+                                           NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
     }
 
-    r->main->blocked++;
-    r->aio = 1;
-    p->aio = 1;
+    ngx_memzero(u->state, sizeof(ngx_http_upstream_state_t));
 
-    ngx_add_timer(&task->event, 60000);
+    u->start_time = h->start_time;
+    u->start_usec = h->start_usec;
 
-    return NGX_OK;
+    u->state->response_time = (ngx_msec_t) -1;
+    u->state->connect_time = h->connect_time;
+    u->state->connect_usec = h->connect_usec;
+    u->state->header_time = (ngx_msec_t) -1;
+    u->state->peer = h->peer.name;
+
+    u->peer = h->peer;
+    u->peer.data = h->data;
+    u->peer.get = h->get;
+    u->peer.free = h->free;
+
+    u->hedge = NULL;
+
+    c = u->peer.connection;
+
+    c->write->handler = ngx_http_upstream_handler;
+    c->read->handler = ngx_http_upstream_handler;
+
+    u->write_event_handler = ngx_http_upstream_dummy_handler;
+    u->read_event_handler = ngx_http_upstream_process_header;
+
+    u->writer.connection = c;
+
+    u->request_sent = 1;
+    u->request_body_sent = 1;
+
+    ngx_http_upstream_process_header(r, u);
 }
 
 
 static void
-ngx_http_upstream_thread_event_handler(ngx_event_t *ev)
+ngx_http_upstream_hedge_close(ngx_http_request_t *r, ngx_http_upstream_t *u,
+    ngx_uint_t state)
 {
-    ngx_connection_t    *c;
-    ngx_http_request_t  *r;
-
-    r = ev->data;
-    c = r->connection;
-
-    ngx_http_set_log_request(c->log, r);
+    ngx_http_upstream_hedge_t  *h;
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "http upstream thread: \"%V?%V\"", &r->uri, &r->args);
+    h = u->hedge;
 
-    if (ev->timedout) {
-        ngx_log_error(NGX_LOG_ALERT, c->log, 0,
-                      "thread operation took too long");
-        ev->timedout = 0;
+    if (h == NULL) {
         return;
     }
 
-    if (ev->timer_set) {
-        ngx_del_timer(ev);
+    u->hedge = NULL;
+
+    if (h->event.timer_set) {
+        ngx_del_timer(&h->event);
     }
 
-    r->main->blocked--;
-    r->aio = 0;
+    if (h->peer.connection) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "close http upstream hedge connection: %d",
+                       h->peer.connection->fd);
 
-#if (NGX_HTTP_V2)
+        if (h->peer.connection->pool) {
+            ngx_destroy_pool(h->peer.connection->pool);
+        }
 
-    if (r->stream) {
-        /*
-         * for HTTP/2, update write event to make sure processing will
-         * reach the main connection to handle sendfile() in threads
-         */
+        ngx_close_connection(h->peer.connection);
+        h->peer.connection = NULL;
+    }
 
-        c->write->ready = 1;
-        c->write->active = 0;
+    if (h->peer.sockaddr) {
+        h->free(&h->peer, h->data, state);
+        h->peer.sockaddr = NULL;
+
+        ngx_http_upstream_queue_dispatch(u->upstream);
     }
+}
 
-#endif
 
-    if (r->done || r->main->terminated) {
-        /*
-         * trigger connection event handler if the subrequest was
-         * already finalized (this can happen if the handler is used
-         * for sendfile() in threads), or if the request was terminated
-         */
+static ngx_int_t
+ngx_http_upstream_hedge_get_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_http_upstream_hedge_t *h = data;
 
-        c->write->handler(c->write);
+    ngx_int_t             rc;
+    ngx_http_upstream_t  *u;
 
-    } else {
-        r->write_event_handler(r);
-        ngx_http_run_posted_requests(c);
+    u = h->upstream;
+
+    /* the peer of the original request is skipped, if possible */
+
+    for ( ;; ) {
+        rc = h->get(pc, h->data);
+
+        if (rc != NGX_OK
+            || u->peer.sockaddr == NULL
+            || ngx_cmp_sockaddr(pc->sockaddr, pc->socklen,
+                                u->peer.sockaddr, u->peer.socklen, 1)
+               != NGX_OK)
+        {
+            return rc;
+        }
+
+        h->free(pc, h->data, 0);
+        pc->sockaddr = NULL;
+
+        if (pc->tries == 0) {
+            return NGX_BUSY;
+        }
     }
 }
 
-#endif
+
+static void
+ngx_http_upstream_hedge_free_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
+{
+    ngx_http_upstream_hedge_t *h = data;
+
+    h->free(pc, h->data, state);
+}
 
 
 static ngx_int_t
-ngx_http_upstream_output_filter(void *data, ngx_chain_t *chain)
+ngx_http_upstream_race_init(ngx_http_request_t *r, ngx_http_upstream_t *u)
 {
-    ngx_int_t            rc;
-    ngx_event_pipe_t    *p;
-    ngx_http_request_t  *r;
+    ngx_http_upstream_race_t  *race;
 
-    r = data;
-    p = r->upstream->pipe;
+    if (u->conf->connect_attempt_delay == 0
+        || u->upstream == NULL
+        || u->peer.tries < 2
+        || u->race)
+    {
+        return NGX_OK;
+    }
 
-    rc = ngx_http_output_filter(r, chain);
+    race = ngx_pcalloc(r->pool, sizeof(ngx_http_upstream_race_t));
+    if (race == NULL) {
+        return NGX_ERROR;
+    }
 
-    p->aio = r->aio;
+    race->event.handler = ngx_http_upstream_race_start;
+    race->event.data = r;
+    race->event.log = r->connection->log;
 
-    return rc;
+    ngx_add_timer(&race->event, u->conf->connect_attempt_delay);
+
+    u->race = race;
+
+    return NGX_OK;
 }
 
 
 static void
-ngx_http_upstream_process_downstream(ngx_http_request_t *r)
+ngx_http_upstream_race_start(ngx_event_t *ev)
 {
-    ngx_event_t          *wev;
-    ngx_connection_t     *c;
-    ngx_event_pipe_t     *p;
-    ngx_http_upstream_t  *u;
+    ngx_int_t                      rc;
+    ngx_connection_t              *c, *pc;
+    ngx_http_request_t            *r;
+    ngx_http_upstream_t           *u;
+    ngx_peer_connection_t          peer;
+    ngx_http_upstream_race_t      *race;
+    ngx_http_upstream_attempt_t   *a;
+    ngx_http_upstream_srv_conf_t  *uscf;
 
+    r = ev->data;
     c = r->connection;
+
     u = r->upstream;
-    p = u->pipe;
-    wev = c->write;
+    race = u->race;
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "http upstream process downstream");
+    uscf = u->upstream;
 
-    c->log->action = "sending to client";
+    while (race->nattempts < NGX_HTTP_UPSTREAM_ATTEMPTS) {
 
-#if (NGX_THREADS)
-    p->aio = r->aio;
-#endif
+        a = &race->attempts[race->nattempts++];
 
-    if (wev->timedout) {
+        /* a separate balancer state, the peer of the request is not changed */
 
-        p->downstream_error = 1;
-        c->timedout = 1;
-        ngx_connection_error(c, NGX_ETIMEDOUT, "client timed out");
+        peer = u->peer;
+        u->peer.data = NULL;
 
-    } else {
+        rc = uscf->peer.init(r, uscf);
 
-        if (wev->delayed) {
+        a->peer = u->peer;
+        u->peer = peer;
 
-            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                           "http downstream delayed");
+        a->peer.connection = NULL;
+        a->peer.sockaddr = NULL;
+        a->peer.name = NULL;
+        a->peer.cached = 0;
 
-            if (ngx_handle_write_event(wev, p->send_lowat) != NGX_OK) {
-                ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
+        if (rc != NGX_OK) {
+            break;
+        }
+
+        a->upstream = u;
+
+        a->data = a->peer.data;
+        a->get = a->peer.get;
+        a->free = a->peer.free;
+
+        a->peer.data = a;
+        a->peer.get = ngx_http_upstream_race_get_peer;
+        a->peer.free = ngx_http_upstream_race_free_peer;
+
+        a->peer.start_time = ngx_current_msec;
+        a->start_usec = r->start_usec ? ngx_monotonic_usec() : 0;
+
+        rc = ngx_event_connect_peer(&a->peer);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                       "http upstream connect attempt: %i", rc);
+
+        if (rc == NGX_DECLINED) {
+            /* the address is unreachable, the next one is tried at once */
+            ngx_http_upstream_race_close_attempt(r, a, NGX_PEER_FAILED);
+            continue;
+        }
+
+        if (rc == NGX_ERROR || rc == NGX_BUSY) {
+            ngx_http_upstream_race_close_attempt(r, a, NGX_PEER_FAILED);
+            break;
+        }
+
+        pc = a->peer.connection;
+
+        pc->data = r;
+
+        pc->write->handler = ngx_http_upstream_race_handler;
+        pc->read->handler = ngx_http_upstream_race_handler;
+
+        if (pc->pool == NULL) {
+            pc->pool = ngx_create_pool(128, r->connection->log);
+            if (pc->pool == NULL) {
+                ngx_http_upstream_race_close_attempt(r, a, 0);
+                break;
             }
+        }
 
-            return;
+        pc->log = r->connection->log;
+        pc->pool->log = pc->log;
+        pc->read->log = pc->log;
+        pc->write->log = pc->log;
+
+        if (rc == NGX_AGAIN) {
+            ngx_add_timer(pc->write, u->conf->connect_timeout);
+
+            if (race->nattempts < NGX_HTTP_UPSTREAM_ATTEMPTS) {
+                ngx_add_timer(ev, u->conf->connect_attempt_delay);
+            }
+
+            break;
         }
 
-        if (ngx_event_pipe(p, 1) == NGX_ABORT) {
-            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
-            return;
+        /* rc == NGX_OK || rc == NGX_DONE */
+
+        ngx_http_upstream_race_swap(r, u, a);
+        break;
+    }
+
+    ngx_http_run_posted_requests(c);
+}
+
+
+static void
+ngx_http_upstream_race_handler(ngx_event_t *ev)
+{
+    ngx_uint_t                    i;
+    ngx_connection_t             *c;
+    ngx_http_request_t           *r;
+    ngx_http_upstream_t          *u;
+    ngx_http_upstream_race_t     *race;
+    ngx_http_upstream_attempt_t  *a;
+
+    c = ev->data;
+    r = c->data;
+
+    u = r->upstream;
+    race = u->race;
+
+    ngx_http_set_log_request(c->log, r);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream connect attempt: \"%V?%V\"",
+                   &r->uri, &r->args);
+
+    for (i = 0; i < race->nattempts; i++) {
+        if (race->attempts[i].peer.connection == c) {
+            break;
         }
     }
 
-    ngx_http_upstream_process_request(r, u);
+    a = &race->attempts[i];
+
+    c = r->connection;
+
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "upstream %V timed out", a->peer.name);
+        ngx_http_upstream_race_close_attempt(r, a, NGX_PEER_FAILED);
+
+    } else if (ngx_http_upstream_test_connect(a->peer.connection) != NGX_OK) {
+        ngx_http_upstream_race_close_attempt(r, a, NGX_PEER_FAILED);
+
+    } else if (ev->write) {
+        ngx_http_upstream_race_swap(r, u, a);
+    }
+
+    ngx_http_run_posted_requests(c);
 }
 
 
 static void
-ngx_http_upstream_process_upstream(ngx_http_request_t *r,
-    ngx_http_upstream_t *u)
+ngx_http_upstream_race_adopt(ngx_http_request_t *r, ngx_http_upstream_t *u,
+    ngx_http_upstream_attempt_t *a)
 {
-    ngx_event_t       *rev;
-    ngx_event_pipe_t  *p;
+    ngx_uint_t         tries;
+    ngx_msec_t         start_time;
     ngx_connection_t  *c;
 
-    c = u->peer.connection;
-    p = u->pipe;
-    rev = c->read;
+    tries = u->peer.tries;
+    start_time = u->peer.start_time;
 
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "http upstream process upstream");
+    u->peer = a->peer;
+    u->peer.data = a->data;
+    u->peer.get = a->get;
+    u->peer.free = a->free;
 
-    c->log->action = "reading upstream";
+    /* the attempts do not add to the tries of the request */
 
-    if (rev->timedout) {
+    if (u->peer.tries > tries) {
+        u->peer.tries = tries;
+    }
 
-        p->upstream_error = 1;
-        ngx_connection_error(c, NGX_ETIMEDOUT, "upstream timed out");
+    u->peer.start_time = start_time;
 
-    } else {
+    a->peer.connection = NULL;
+    a->peer.sockaddr = NULL;
 
-        if (rev->delayed) {
+    u->state->peer = u->peer.name;
 
-            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                           "http upstream delayed");
+    c = u->peer.connection;
 
-            if (ngx_handle_read_event(rev, 0) != NGX_OK) {
-                ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
-            }
+    c->requests++;
 
-            return;
-        }
+    c->write->handler = ngx_http_upstream_handler;
+    c->read->handler = ngx_http_upstream_handler;
 
-        if (ngx_event_pipe(p, 0) == NGX_ABORT) {
-            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
-            return;
-        }
+    u->write_event_handler = ngx_http_upstream_send_request_handler;
+    u->read_event_handler = ngx_http_upstream_process_header;
+
+    c->sendfile &= r->connection->sendfile;
+    u->output.sendfile = c->sendfile;
+
+    if (r->connection->tcp_nopush == NGX_TCP_NOPUSH_DISABLED) {
+        c->tcp_nopush = NGX_TCP_NOPUSH_DISABLED;
     }
 
-    ngx_http_upstream_process_request(r, u);
+    u->writer.connection = c;
 }
 
 
 static void
-ngx_http_upstream_process_request(ngx_http_request_t *r,
-    ngx_http_upstream_t *u)
+ngx_http_upstream_race_swap(ngx_http_request_t *r, ngx_http_upstream_t *u,
+    ngx_http_upstream_attempt_t *a)
 {
-    ngx_temp_file_t   *tf;
-    ngx_event_pipe_t  *p;
+    ngx_peer_connection_t   peer;
+#if (NGX_HTTP_SSL)
+    ngx_connection_t       *c;
+#endif
 
-    p = u->pipe;
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream connect attempt won: %V", a->peer.name);
 
-#if (NGX_THREADS)
+    peer = u->peer;
 
-    if (p->writing && !p->aio) {
+    ngx_http_upstream_race_adopt(r, u, a);
+    ngx_http_upstream_race_close(r, u, 0);
 
-        /*
-         * make sure to call ngx_event_pipe()
-         * if there is an incomplete aio write
-         */
+    /* the first connection is abandoned, it is not a failure of the peer */
 
-        if (ngx_event_pipe(p, 1) == NGX_ABORT) {
-            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
-            return;
+    if (peer.connection) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "close http upstream connection: %d",
+                       peer.connection->fd);
+
+        if (peer.connection->pool) {
+            ngx_destroy_pool(peer.connection->pool);
         }
+
+        ngx_close_connection(peer.connection);
+        peer.connection = NULL;
     }
 
-    if (p->writing) {
+    if (peer.sockaddr) {
+        peer.free(&peer, peer.data, 0);
+    }
+
+#if (NGX_HTTP_SSL)
+
+    c = u->peer.connection;
+
+    if (u->ssl && c->ssl == NULL) {
+        ngx_http_upstream_ssl_init_connection(r, u, c);
         return;
     }
 
 #endif
 
-    if (u->peer.connection) {
+    ngx_http_upstream_send_request(r, u, 1);
+}
 
-        if (u->store) {
 
-            if (p->upstream_eof || p->upstream_done) {
+static ngx_int_t
+ngx_http_upstream_race_promote(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ngx_uint_t                    i;
+    ngx_http_upstream_race_t     *race;
+    ngx_http_upstream_attempt_t  *a;
 
-                tf = p->temp_file;
+    race = u->race;
 
-                if (u->headers_in.status_n == NGX_HTTP_OK
-                    && (p->upstream_done || p->length == -1)
-                    && (u->headers_in.content_length_n == -1
-                        || u->headers_in.content_length_n == tf->offset))
-                {
-                    ngx_http_upstream_store(r, u);
-                }
-            }
+    if (race == NULL) {
+        return NGX_DECLINED;
+    }
+
+    for (i = 0; i < race->nattempts; i++) {
+        if (race->attempts[i].peer.connection) {
+            break;
         }
+    }
 
-#if (NGX_HTTP_CACHE)
+    if (i == race->nattempts) {
+        ngx_http_upstream_race_close(r, u, 0);
+        return NGX_DECLINED;
+    }
 
-        if (u->cacheable) {
+    a = &race->attempts[i];
 
-            if (p->upstream_done) {
-                ngx_http_file_cache_update(r, p->temp_file);
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream connect attempt continued: %V",
+                   a->peer.name);
 
-            } else if (p->upstream_eof) {
+    /* the connection being established replaces the failed one */
 
-                tf = p->temp_file;
+    if (u->state->response_time == (ngx_msec_t) -1) {
+        u->state->response_time = ngx_current_msec - u->start_time;
+        u->state->response_usec = ngx_http_upstream_usec(u);
+    }
 
-                if (p->length == -1
-                    && (u->headers_in.content_length_n == -1
-                        || u->headers_in.content_length_n
-                           == tf->offset - (off_t) r->cache->body_start))
-                {
-                    ngx_http_file_cache_update(r, tf);
+    u->state = ngx_array_push(r->upstream_states);
+    if (u->state == NULL) {
+        return NGX_ERROR;
+    }
 
-                } else {
-                    ngx_http_file_cache_free(r->cache, tf);
-                }
+    ngx_memzero(u->state, sizeof(ngx_http_upstream_state_t));
 
-            } else if (p->upstream_error) {
-                ngx_http_file_cache_free(r->cache, p->temp_file);
-            }
-        }
+    u->start_time = a->peer.start_time;
+    u->start_usec = a->start_usec;
 
-#endif
+    u->state->response_time = (ngx_msec_t) -1;
+    u->state->connect_time = (ngx_msec_t) -1;
+    u->state->header_time = (ngx_msec_t) -1;
 
-        if (p->upstream_done || p->upstream_eof || p->upstream_error) {
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                           "http upstream exit: %p", p->out);
+    ngx_http_upstream_race_adopt(r, u, a);
 
-            if (p->upstream_done
-                || (p->upstream_eof && p->length == -1))
-            {
-                ngx_http_upstream_finalize_request(r, u, 0);
-                return;
-            }
+    return NGX_OK;
+}
 
-            if (p->upstream_eof) {
-                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
-                              "upstream prematurely closed connection");
-            }
 
-            ngx_http_upstream_finalize_request(r, u, NGX_HTTP_BAD_GATEWAY);
-            return;
-        }
+static void
+ngx_http_upstream_race_close(ngx_http_request_t *r, ngx_http_upstream_t *u,
+    ngx_uint_t state)
+{
+    ngx_uint_t                 i;
+    ngx_http_upstream_race_t  *race;
+
+    race = u->race;
+
+    if (race == NULL) {
+        return;
     }
 
-    if (p->downstream_error) {
-        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "http upstream downstream error");
+    u->race = NULL;
 
-        if (!u->cacheable && !u->store && u->peer.connection) {
-            ngx_http_upstream_finalize_request(r, u, NGX_ERROR);
-        }
+    if (race->event.timer_set) {
+        ngx_del_timer(&race->event);
+    }
+
+    for (i = 0; i < race->nattempts; i++) {
+        ngx_http_upstream_race_close_attempt(r, &race->attempts[i], state);
     }
 }
 
 
 static void
-ngx_http_upstream_store(ngx_http_request_t *r, ngx_http_upstream_t *u)
+ngx_http_upstream_race_close_attempt(ngx_http_request_t *r,
+    ngx_http_upstream_attempt_t *a, ngx_uint_t state)
 {
-    size_t                  root;
-    time_t                  lm;
-    ngx_str_t               path;
-    ngx_temp_file_t        *tf;
-    ngx_ext_rename_file_t   ext;
+    if (a->peer.connection) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "close http upstream connection attempt: %d",
+                       a->peer.connection->fd);
 
-    tf = u->pipe->temp_file;
+        if (a->peer.connection->pool) {
+            ngx_destroy_pool(a->peer.connection->pool);
+        }
 
-    if (tf->file.fd == NGX_INVALID_FILE) {
+        ngx_close_connection(a->peer.connection);
+        a->peer.connection = NULL;
+    }
 
-        /* create file for empty 200 response */
+    if (a->peer.sockaddr) {
+        a->free(&a->peer, a->data, state);
+        a->peer.sockaddr = NULL;
 
-        tf = ngx_pcalloc(r->pool, sizeof(ngx_temp_file_t));
-        if (tf == NULL) {
-            return;
-        }
+        ngx_http_upstream_queue_dispatch(a->upstream->upstream);
+    }
+}
 
-        tf->file.fd = NGX_INVALID_FILE;
-        tf->file.log = r->connection->log;
-        tf->path = u->conf->temp_path;
-        tf->pool = r->pool;
-        tf->persistent = 1;
 
-        if (ngx_create_temp_file(&tf->file, tf->path, tf->pool,
-                                 tf->persistent, tf->clean, tf->access)
-            != NGX_OK)
-        {
-            return;
-        }
+static ngx_int_t
+ngx_http_upstream_race_get_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_http_upstream_attempt_t *a = data;
 
-        u->pipe->temp_file = tf;
-    }
+    ngx_int_t                  rc;
+    ngx_uint_t                 i, used;
+    ngx_http_upstream_t       *u;
+    ngx_peer_connection_t     *peer;
+    ngx_http_upstream_race_t  *race;
 
-    ext.access = u->conf->store_access;
-    ext.path_access = u->conf->store_access;
-    ext.time = -1;
-    ext.create_path = 1;
-    ext.delete_file = 1;
-    ext.log = r->connection->log;
+    u = a->upstream;
+    race = u->race;
 
-    if (u->headers_in.last_modified) {
+    /* the addresses being connected to are skipped */
 
-        lm = ngx_parse_http_time(u->headers_in.last_modified->value.data,
-                                 u->headers_in.last_modified->value.len);
+    for ( ;; ) {
+        rc = a->get(pc, a->data);
 
-        if (lm != NGX_ERROR) {
-            ext.time = lm;
-            ext.fd = tf->file.fd;
+        if (rc != NGX_OK) {
+            return rc;
         }
-    }
 
-    if (u->conf->store_lengths == NULL) {
+        used = (u->peer.sockaddr
+                && ngx_cmp_sockaddr(pc->sockaddr, pc->socklen,
+                                    u->peer.sockaddr, u->peer.socklen, 1)
+                   == NGX_OK);
 
-        if (ngx_http_map_uri_to_path(r, &path, &root, 0) == NULL) {
-            return;
-        }
+        for (i = 0; !used && i < race->nattempts; i++) {
+            peer = &race->attempts[i].peer;
 
-    } else {
-        if (ngx_http_script_run(r, &path, u->conf->store_lengths->elts, 0,
-                                u->conf->store_values->elts)
-            == NULL)
-        {
-            return;
+            used = (peer != pc
+                    && peer->sockaddr
+                    && ngx_cmp_sockaddr(pc->sockaddr, pc->socklen,
+                                        peer->sockaddr, peer->socklen, 1)
+                       == NGX_OK);
         }
-    }
-
-    path.len--;
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "upstream stores \"%s\" to \"%s\"",
-                   tf->file.name.data, path.data);
+        if (!used) {
+            return NGX_OK;
+        }
 
-    (void) ngx_ext_rename_file(&tf->file.name, &path, &ext);
+        a->free(pc, a->data, 0);
+        pc->sockaddr = NULL;
 
-    u->store = 0;
+        if (pc->tries == 0) {
+            return NGX_BUSY;
+        }
+    }
 }
 
 
 static void
-ngx_http_upstream_dummy_handler(ngx_http_request_t *r, ngx_http_upstream_t *u)
+ngx_http_upstream_race_free_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
 {
-    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http upstream dummy handler");
+    ngx_http_upstream_attempt_t *a = data;
+
+    a->free(pc, a->data, state);
 }
 
 
-static void
-ngx_http_upstream_next(ngx_http_request_t *r, ngx_http_upstream_t *u,
-    ngx_uint_t ft_type)
+static ngx_int_t
+ngx_http_upstream_queue(ngx_http_request_t *r, ngx_http_upstream_t *u)
 {
-    ngx_msec_t  timeout;
-    ngx_uint_t  status, state;
+    ngx_msec_int_t                 timer;
+    ngx_http_upstream_waiter_t    *w;
+    ngx_http_upstream_srv_conf_t  *uscf;
 
-    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                   "http next upstream, %xi", ft_type);
+    uscf = u->upstream;
 
-    if (u->peer.sockaddr) {
+    if (uscf == NULL || uscf->queue_size == 0) {
+        return NGX_DECLINED;
+    }
 
-        if (u->peer.connection) {
-            u->state->bytes_sent = u->peer.connection->sent;
-        }
+    w = u->waiter;
 
-        if (ft_type == NGX_HTTP_UPSTREAM_FT_HTTP_403
-            || ft_type == NGX_HTTP_UPSTREAM_FT_HTTP_404)
-        {
-            state = NGX_PEER_NEXT;
+    if (w == NULL) {
 
-        } else {
-            state = NGX_PEER_FAILED;
+        if (uscf->queue_length >= uscf->queue_size) {
+            ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                          "upstream queue is full");
+            return NGX_DECLINED;
         }
 
-        u->peer.free(&u->peer, u->peer.data, state);
-        u->peer.sockaddr = NULL;
+        w = ngx_pcalloc(r->pool, sizeof(ngx_http_upstream_waiter_t));
+        if (w == NULL) {
+            return NGX_ERROR;
+        }
+
+        w->event.handler = ngx_http_upstream_queue_handler;
+        w->event.data = r;
+        w->event.log = r->connection->log;
+
+        w->start = ngx_current_msec;
+
+        u->waiter = w;
     }
 
-    if (ft_type == NGX_HTTP_UPSTREAM_FT_TIMEOUT) {
-        ngx_log_error(NGX_LOG_ERR, r->connection->log, NGX_ETIMEDOUT,
-                      "upstream timed out");
+    /* the timeout is counted from the first time the request was queued */
+
+    timer = (ngx_msec_int_t) (w->start + uscf->queue_timeout
+                              - ngx_current_msec);
+
+    if (timer <= 0) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "upstream queue timed out");
+        return NGX_DECLINED;
     }
 
-    if (u->peer.cached && ft_type == NGX_HTTP_UPSTREAM_FT_ERROR) {
-        /* TODO: inform balancer instead */
-        u->peer.tries++;
+    if (w->queued_at == 0) {
+        ngx_queue_insert_tail(&uscf->queue, &w->queue);
+
+    } else {
+        /* a dispatched request which found no free peer keeps its place */
+        ngx_queue_insert_head(&uscf->queue, &w->queue);
     }
 
-    switch (ft_type) {
+    uscf->queue_length++;
 
-    case NGX_HTTP_UPSTREAM_FT_TIMEOUT:
-    case NGX_HTTP_UPSTREAM_FT_HTTP_504:
-        status = NGX_HTTP_GATEWAY_TIME_OUT;
-        break;
+    w->queued = 1;
+    w->queued_at = ngx_current_msec;
 
-    case NGX_HTTP_UPSTREAM_FT_HTTP_500:
-        status = NGX_HTTP_INTERNAL_SERVER_ERROR;
-        break;
+    ngx_add_timer(&w->event, (ngx_msec_t) timer);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http upstream queued, length:%ui timer:%M",
+                   uscf->queue_length, timer);
+
+    return NGX_OK;
+}
 
-    case NGX_HTTP_UPSTREAM_FT_HTTP_503:
-        status = NGX_HTTP_SERVICE_UNAVAILABLE;
-        break;
 
-    case NGX_HTTP_UPSTREAM_FT_HTTP_403:
-        status = NGX_HTTP_FORBIDDEN;
-        break;
+static void
+ngx_http_upstream_queue_handler(ngx_event_t *ev)
+{
+    ngx_connection_t            *c;
+    ngx_http_request_t          *r;
+    ngx_http_upstream_t         *u;
+    ngx_http_upstream_waiter_t  *w;
 
-    case NGX_HTTP_UPSTREAM_FT_HTTP_404:
-        status = NGX_HTTP_NOT_FOUND;
-        break;
+    r = ev->data;
+    c = r->connection;
+    u = r->upstream;
+    w = u->waiter;
 
-    case NGX_HTTP_UPSTREAM_FT_HTTP_429:
-        status = NGX_HTTP_TOO_MANY_REQUESTS;
-        break;
+    ngx_http_set_log_request(c->log, r);
 
-    /*
-     * NGX_HTTP_UPSTREAM_FT_BUSY_LOCK and NGX_HTTP_UPSTREAM_FT_MAX_WAITING
-     * never reach here
-     */
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http upstream queue handler, timedout:%d", ev->timedout);
 
-    default:
-        status = NGX_HTTP_BAD_GATEWAY;
-    }
+    ngx_http_upstream_queue_remove(u);
 
-    if (r->connection->error) {
-        ngx_http_upstream_finalize_request(r, u,
-                                           NGX_HTTP_CLIENT_CLOSED_REQUEST);
-        return;
-    }
+    u->state->queue_time += ngx_current_msec - w->queued_at;
 
-    u->state->status = status;
+    if (ev->timedout) {
+        ev->timedout = 0;
 
-    timeout = u->conf->next_upstream_timeout;
+        ngx_log_error(NGX_LOG_ERR, c->log, 0, "upstream queue timed out");
+        ngx_http_upstream_next(r, u, NGX_HTTP_UPSTREAM_FT_NOLIVE);
 
-    if (u->request_sent
-        && (r->method & (NGX_HTTP_POST|NGX_HTTP_LOCK|NGX_HTTP_PATCH)))
-    {
-        ft_type |= NGX_HTTP_UPSTREAM_FT_NON_IDEMPOTENT;
+    } else {
+        w->dispatched = 1;
+        ngx_http_upstream_connect(r, u);
     }
 
-    if (u->peer.tries == 0
-        || ((u->conf->next_upstream & ft_type) != ft_type)
-        || (u->request_sent && r->request_body_no_buffering)
-        || (timeout && ngx_current_msec - u->peer.start_time >= timeout))
-    {
-#if (NGX_HTTP_CACHE)
+    ngx_http_run_posted_requests(c);
+}
 
-        if (u->cache_status == NGX_HTTP_CACHE_EXPIRED
-            && ((u->conf->cache_use_stale & ft_type) || r->cache->stale_error))
-        {
-            ngx_int_t  rc;
 
-            rc = u->reinit_request(r);
+static void
+ngx_http_upstream_queue_remove(ngx_http_upstream_t *u)
+{
+    ngx_http_upstream_waiter_t  *w;
 
-            if (rc != NGX_OK) {
-                ngx_http_upstream_finalize_request(r, u, rc);
-                return;
-            }
+    w = u->waiter;
 
-            u->cache_status = NGX_HTTP_CACHE_STALE;
-            rc = ngx_http_upstream_cache_send(r, u);
+    if (w == NULL) {
+        return;
+    }
 
-            if (rc == NGX_DONE) {
-                return;
-            }
+    if (w->queued) {
+        ngx_queue_remove(&w->queue);
+        u->upstream->queue_length--;
+        w->queued = 0;
+    }
 
-            if (rc == NGX_HTTP_UPSTREAM_INVALID_HEADER) {
-                rc = NGX_HTTP_INTERNAL_SERVER_ERROR;
-            }
+    if (w->event.timer_set) {
+        ngx_del_timer(&w->event);
+    }
 
-            ngx_http_upstream_finalize_request(r, u, rc);
-            return;
-        }
-#endif
+    if (w->event.posted) {
+        ngx_delete_posted_event(&w->event);
+    }
+}
 
-        ngx_http_upstream_finalize_request(r, u, status);
+
+static void
+ngx_http_upstream_queue_dispatch(ngx_http_upstream_srv_conf_t *uscf)
+{
+    ngx_queue_t                 *q;
+    ngx_http_upstream_waiter_t  *w;
+
+    if (uscf == NULL || uscf->queue_size == 0 || ngx_queue_empty(&uscf->queue))
+    {
         return;
     }
 
-    if (u->peer.connection) {
-        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "close http upstream connection: %d",
-                       u->peer.connection->fd);
-#if (NGX_HTTP_SSL)
-
-        if (u->peer.connection->ssl) {
-            u->peer.connection->ssl->no_wait_shutdown = 1;
-            u->peer.connection->ssl->no_send_shutdown = 1;
+    /* a peer was freed, the first request in the queue is to try it */
 
-            (void) ngx_ssl_shutdown(u->peer.connection);
-        }
-#endif
+    q = ngx_queue_head(&uscf->queue);
+    ngx_queue_remove(q);
 
-        if (u->peer.connection->pool) {
-            ngx_destroy_pool(u->peer.connection->pool);
-        }
+    uscf->queue_length--;
 
-        ngx_close_connection(u->peer.connection);
-        u->peer.connection = NULL;
-    }
+    w = ngx_queue_data(q, ngx_http_upstream_waiter_t, queue);
+    w->queued = 0;
 
-    ngx_http_upstream_connect(r, u);
+    ngx_post_event(&w->event, &ngx_posted_events);
 }
 
 
@@ -4515,6 +6929,10 @@ ngx_http_upstream_finalize_request(ngx_http_request_t *r,
     *u->cleanup = NULL;
     u->cleanup = NULL;
 
+    ngx_http_upstream_hedge_close(r, u, 0);
+    ngx_http_upstream_race_close(r, u, 0);
+    ngx_http_upstream_queue_remove(u);
+
     if (u->resolved && u->resolved->ctx) {
         ngx_resolve_name_done(u->resolved->ctx);
         u->resolved->ctx = NULL;
@@ -4522,6 +6940,7 @@ ngx_http_upstream_finalize_request(ngx_http_request_t *r,
 
     if (u->state && u->state->response_time == (ngx_msec_t) -1) {
         u->state->response_time = ngx_current_msec - u->start_time;
+        u->state->response_usec = ngx_http_upstream_usec(u);
 
         if (u->pipe && u->pipe->read_length) {
             u->state->bytes_received += u->pipe->read_length
@@ -4539,6 +6958,8 @@ ngx_http_upstream_finalize_request(ngx_http_request_t *r,
     if (u->peer.free && u->peer.sockaddr) {
         u->peer.free(&u->peer, u->peer.data, 0);
         u->peer.sockaddr = NULL;
+
+        ngx_http_upstream_queue_dispatch(u->upstream);
     }
 
     if (u->peer.connection) {
@@ -4600,6 +7021,8 @@ ngx_http_upstream_finalize_request(ngx_http_request_t *r,
 
     if (r->cache) {
 
+        ngx_http_file_cache_count(r->cache, u->cache_status);
+
         if (u->cacheable) {
 
             if (rc == NGX_HTTP_BAD_GATEWAY || rc == NGX_HTTP_GATEWAY_TIME_OUT) {
@@ -5760,6 +8183,7 @@ ngx_http_upstream_response_time_variable(ngx_http_request_t *r,
 {
     u_char                     *p;
     size_t                      len;
+    uint64_t                    us;
     ngx_uint_t                  i;
     ngx_msec_int_t              ms;
     ngx_http_upstream_state_t  *state;
@@ -5773,7 +8197,7 @@ ngx_http_upstream_response_time_variable(ngx_http_request_t *r,
         return NGX_OK;
     }
 
-    len = r->upstream_states->nelts * (NGX_TIME_T_LEN + 4 + 2);
+    len = r->upstream_states->nelts * (NGX_TIME_T_LEN + 7 + 2);
 
     p = ngx_pnalloc(r->pool, len);
     if (p == NULL) {
@@ -5789,15 +8213,26 @@ ngx_http_upstream_response_time_variable(ngx_http_request_t *r,
 
         if (data == 1) {
             ms = state[i].header_time;
+            us = state[i].header_usec;
 
         } else if (data == 2) {
             ms = state[i].connect_time;
+            us = state[i].connect_usec;
+
+        } else if (data == 3) {
+            ms = state[i].queue_time;
+            us = (uint64_t) ms * 1000;
 
         } else {
             ms = state[i].response_time;
+            us = state[i].response_usec;
         }
 
-        if (ms != -1) {
+        if (ms != -1 && r->start_usec) {
+            p = ngx_sprintf(p, "%T.%06uL",
+                            (time_t) (us / 1000000), us % 1000000);
+
+        } else if (ms != -1) {
             ms = ngx_max(ms, 0);
             p = ngx_sprintf(p, "%T.%03M", (time_t) ms / 1000, ms % 1000);
 
@@ -6169,8 +8604,8 @@ ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     time_t                       fail_timeout;
     ngx_str_t                   *value, s;
     ngx_url_t                    u;
-    ngx_int_t                    weight, max_conns, max_fails;
-    ngx_uint_t                   i;
+    ngx_int_t                    weight, max_conns, max_fails, max_addrs;
+    ngx_uint_t                   i, resolve;
     ngx_http_upstream_server_t  *us;
 
     us = ngx_array_push(uscf->servers);
@@ -6186,6 +8621,8 @@ ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     max_conns = 0;
     max_fails = 1;
     fail_timeout = 10;
+    max_addrs = 8;
+    resolve = 0;
 
     for (i = 2; i < cf->args->nelts; i++) {
 
@@ -6274,6 +8711,22 @@ ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[i].data, "resolve") == 0) {
+            resolve = 1;
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "max_addrs=", 10) == 0) {
+
+            max_addrs = ngx_atoi(&value[i].data[10], value[i].len - 10);
+
+            if (max_addrs == NGX_ERROR || max_addrs == 0) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
         goto invalid;
     }
 
@@ -6281,6 +8734,7 @@ ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     u.url = value[1];
     u.default_port = 80;
+    u.no_resolve = resolve;
 
     if (ngx_parse_url(cf->pool, &u) != NGX_OK) {
         if (u.err) {
@@ -6294,6 +8748,18 @@ ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     us->name = u.url;
     us->addrs = u.addrs;
     us->naddrs = u.naddrs;
+
+    if (resolve && u.naddrs == 0) {
+
+        /* a name: the addresses are updated by the resolver at run time */
+
+        if (ngx_http_upstream_server_resolve(cf, us, &u, max_addrs)
+            != NGX_OK)
+        {
+            return NGX_CONF_ERROR;
+        }
+    }
+
     us->weight = weight;
     us->max_conns = max_conns;
     us->max_fails = max_fails;
@@ -6318,6 +8784,164 @@ not_supported:
 }
 
 
+static ngx_int_t
+ngx_http_upstream_server_resolve(ngx_conf_t *cf, ngx_http_upstream_server_t *us,
+    ngx_url_t *u, ngx_uint_t max_addrs)
+{
+    ngx_uint_t   i, n;
+    ngx_addr_t  *addrs;
+
+    us->host = u->host;
+    us->port = u->port;
+    us->resolve = 1;
+
+    /*
+     * the initial addresses are resolved as usual, but a failure
+     * is not fatal; the remaining peers are placeholders for addresses
+     * appearing later, and are marked with the AF_UNSPEC family
+     */
+
+    if (ngx_inet_resolve_host(cf->pool, u) != NGX_OK) {
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "%s in upstream \"%V\", will be resolved later",
+                           u->err ? u->err : "host not resolved", &u->url);
+        u->naddrs = 0;
+    }
+
+    if (u->naddrs > max_addrs) {
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "upstream \"%V\" has %ui addresses, only %ui used, "
+                           "see the \"max_addrs\" parameter",
+                           &u->url, u->naddrs, max_addrs);
+    }
+
+    addrs = ngx_pcalloc(cf->pool, max_addrs * sizeof(ngx_addr_t));
+    if (addrs == NULL) {
+        return NGX_ERROR;
+    }
+
+    n = ngx_min(u->naddrs, max_addrs);
+
+    for (i = 0; i < max_addrs; i++) {
+
+        addrs[i].sockaddr = ngx_pcalloc(cf->pool, sizeof(ngx_sockaddr_t));
+        if (addrs[i].sockaddr == NULL) {
+            return NGX_ERROR;
+        }
+
+        addrs[i].name.data = ngx_pnalloc(cf->pool, NGX_SOCKADDR_STRLEN);
+        if (addrs[i].name.data == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (i >= n) {
+            addrs[i].socklen = sizeof(struct sockaddr_in);
+            continue;
+        }
+
+        ngx_memcpy(addrs[i].sockaddr, u->addrs[i].sockaddr,
+                   u->addrs[i].socklen);
+        addrs[i].socklen = u->addrs[i].socklen;
+
+        addrs[i].name.len = ngx_min(u->addrs[i].name.len, NGX_SOCKADDR_STRLEN);
+        ngx_memcpy(addrs[i].name.data, u->addrs[i].name.data,
+                   addrs[i].name.len);
+    }
+
+    us->addrs = addrs;
+    us->naddrs = max_addrs;
+
+    return NGX_OK;
+}
+
+
+static char *
+ngx_http_upstream_hedge_budget(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_upstream_srv_conf_t  *uscf = conf;
+
+    ngx_int_t   n;
+    ngx_str_t  *value;
+
+    value = cf->args->elts;
+
+    if (value[1].len < 2 || value[1].data[value[1].len - 1] != '%') {
+        goto invalid;
+    }
+
+    n = ngx_atoi(value[1].data, value[1].len - 1);
+
+    if (n == NGX_ERROR || n > 100) {
+        goto invalid;
+    }
+
+    uscf->hedge_budget = n;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid hedge budget \"%V\"", &value[1]);
+
+    return NGX_CONF_ERROR;
+}
+
+
+static char *
+ngx_http_upstream_queue_set(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_upstream_srv_conf_t  *uscf = conf;
+
+    ngx_int_t   n;
+    ngx_str_t  *value, s;
+    ngx_msec_t  timeout;
+
+    if (uscf->queue_size) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    n = ngx_atoi(value[1].data, value[1].len);
+
+    if (n == NGX_ERROR || n == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid queue size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    timeout = 60000;
+
+    if (cf->args->nelts == 3) {
+
+        if (ngx_strncmp(value[2].data, "timeout=", 8) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        s.len = value[2].len - 8;
+        s.data = value[2].data + 8;
+
+        timeout = ngx_parse_time(&s, 0);
+
+        if (timeout == (ngx_msec_t) NGX_ERROR || timeout == 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid queue timeout \"%V\"", &s);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    uscf->queue_size = n;
+    uscf->queue_timeout = timeout;
+
+    ngx_queue_init(&uscf->queue);
+
+    return NGX_CONF_OK;
+}
+
+
 ngx_http_upstream_srv_conf_t *
 ngx_http_upstream_add(ngx_conf_t *cf, ngx_url_t *u, ngx_uint_t flags)
 {
@@ -6394,6 +9018,7 @@ ngx_http_upstream_add(ngx_conf_t *cf, ngx_url_t *u, ngx_uint_t flags)
     }
 
     uscf->flags = flags;
+    uscf->hedge_budget = NGX_HTTP_UPSTREAM_HEDGE_BUDGET;
     uscf->host = u->host;
     uscf->file_name = cf->conf_file->file.name.data;
     uscf->line = cf->conf_file->line;
@@ -6766,6 +9391,8 @@ ngx_http_upstream_create_main_conf(ngx_conf_t *cf)
         return NULL;
     }
 
+    umcf->buffer_pool_size = NGX_CONF_UNSET_SIZE;
+
     return umcf;
 }
 
@@ -6827,5 +9454,49 @@ ngx_http_upstream_init_main_conf(ngx_conf_t *cf, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    ngx_conf_init_size_value(umcf->buffer_pool_size, 0);
+
+    if (umcf->buffer_pool_size) {
+        umcf->buffer_pool = ngx_event_pipe_create_buf_pool(cf->pool,
+                                                     umcf->buffer_pool_size);
+        if (umcf->buffer_pool == NULL) {
+            return NGX_CONF_ERROR;
+        }
+    }
+
     return NGX_CONF_OK;
 }
+
+
+static ngx_int_t
+ngx_http_upstream_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                      i;
+    ngx_http_upstream_srv_conf_t  **uscfp;
+    ngx_http_upstream_main_conf_t  *umcf;
+
+    umcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_upstream_module);
+
+    if (umcf == NULL) {
+        return NGX_OK;
+    }
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        /* set for upstreams with "server ... resolve" only */
+
+        if (uscfp[i]->resolver == NULL) {
+            continue;
+        }
+
+        if (ngx_http_upstream_init_round_robin_resolve(cycle, uscfp[i])
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
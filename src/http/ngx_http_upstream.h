@@ -62,6 +62,9 @@ typedef struct {
     ngx_msec_t                       connect_time;
     ngx_msec_t                       header_time;
     ngx_msec_t                       queue_time;
+    uint64_t                         response_usec;
+    uint64_t                         connect_usec;
+    uint64_t                         header_usec;
     off_t                            response_length;
     off_t                            bytes_received;
     off_t                            bytes_sent;
@@ -74,6 +77,9 @@ typedef struct {
     ngx_hash_t                       headers_in_hash;
     ngx_array_t                      upstreams;
                                              /* ngx_http_upstream_srv_conf_t */
+
+    size_t                           buffer_pool_size;
+    ngx_event_pipe_buf_pool_t       *buffer_pool;
 } ngx_http_upstream_main_conf_t;
 
 typedef struct ngx_http_upstream_srv_conf_s  ngx_http_upstream_srv_conf_t;
@@ -102,7 +108,11 @@ typedef struct {
     ngx_msec_t                       slow_start;
     ngx_uint_t                       down;
 
+    ngx_str_t                        host;
+    in_port_t                        port;
+
     unsigned                         backup:1;
+    unsigned                         resolve:1;
 
     NGX_COMPAT_BEGIN(6)
     NGX_COMPAT_END
@@ -131,8 +141,20 @@ struct ngx_http_upstream_srv_conf_s {
     in_port_t                        port;
     ngx_uint_t                       no_port;  /* unsigned no_port:1 */
 
+    ngx_resolver_t                  *resolver;
+    ngx_msec_t                       resolver_timeout;
+
+    ngx_uint_t                       hedge_budget;
+    ngx_uint_t                       hedge_tokens;
+
+    ngx_uint_t                       queue_size;
+    ngx_msec_t                       queue_timeout;
+    ngx_uint_t                       queue_length;
+    ngx_queue_t                      queue;
+
 #if (NGX_HTTP_UPSTREAM_ZONE)
     ngx_shm_zone_t                  *shm_zone;
+    ngx_uint_t                       read_mostly;  /* unsigned read_mostly:1 */
 #endif
 };
 
@@ -146,6 +168,16 @@ typedef struct {
 } ngx_http_upstream_local_t;
 
 
+#define NGX_HTTP_UPSTREAM_CACHE_PEER  "X-Cache-Peer"
+
+
+typedef struct {
+    ngx_http_upstream_srv_conf_t    *upstream;
+    ngx_addr_t                      *self;
+    ngx_uint_t                       nself;
+} ngx_http_upstream_cache_peer_t;
+
+
 typedef struct {
     ngx_http_upstream_srv_conf_t    *upstream;
 
@@ -153,6 +185,8 @@ typedef struct {
     ngx_msec_t                       send_timeout;
     ngx_msec_t                       read_timeout;
     ngx_msec_t                       next_upstream_timeout;
+    ngx_msec_t                       hedge_delay;
+    ngx_msec_t                       connect_attempt_delay;
 
     size_t                           send_lowat;
     size_t                           buffer_size;
@@ -177,6 +211,7 @@ typedef struct {
     ngx_flag_t                       pass_request_headers;
     ngx_flag_t                       pass_request_body;
     ngx_flag_t                       pass_trailers;
+    ngx_flag_t                       splice;
 
     ngx_flag_t                       ignore_client_abort;
     ngx_flag_t                       intercept_errors;
@@ -191,11 +226,14 @@ typedef struct {
 
     ngx_http_upstream_local_t       *local;
     ngx_flag_t                       socket_keepalive;
+    ngx_flag_t                       fastopen;
 
 #if (NGX_HTTP_CACHE)
     ngx_shm_zone_t                  *cache_zone;
     ngx_http_complex_value_t        *cache_value;
 
+    ngx_http_upstream_cache_peer_t  *cache_peer;
+
     ngx_uint_t                       cache_min_uses;
     ngx_uint_t                       cache_use_stale;
     ngx_uint_t                       cache_methods;
@@ -205,15 +243,20 @@ typedef struct {
     ngx_flag_t                       cache_lock;
     ngx_msec_t                       cache_lock_timeout;
     ngx_msec_t                       cache_lock_age;
+    ngx_flag_t                       cache_lock_stream;
 
     ngx_flag_t                       cache_revalidate;
     ngx_flag_t                       cache_convert_head;
     ngx_flag_t                       cache_background_update;
 
+    ngx_http_complex_value_t        *cache_write_back;
+
     ngx_array_t                     *cache_valid;
     ngx_array_t                     *cache_bypass;
     ngx_array_t                     *cache_purge;
     ngx_array_t                     *no_cache;
+
+    ngx_str_t                        cache_tag_header;
 #endif
 
     ngx_array_t                     *store_lengths;
@@ -314,6 +357,91 @@ typedef struct {
 } ngx_http_upstream_resolved_t;
 
 
+/*
+ * the hedge budget is a percentage of requests, each request adds its
+ * percentage to the tokens, a hedged request costs 100
+ */
+
+#define NGX_HTTP_UPSTREAM_HEDGE_BUDGET  10
+#define NGX_HTTP_UPSTREAM_HEDGE_COST    100
+#define NGX_HTTP_UPSTREAM_HEDGE_BURST   10
+
+
+typedef struct {
+    ngx_peer_connection_t            peer;
+    ngx_event_t                      event;
+    ngx_buf_t                       *buf;
+    ngx_http_upstream_t             *upstream;
+
+    ngx_msec_t                       start_time;
+    ngx_msec_t                       connect_time;
+    uint64_t                         start_usec;
+    uint64_t                         connect_usec;
+
+    /* the balancer of the hedged request */
+    void                            *data;
+    ngx_event_get_peer_pt            get;
+    ngx_event_free_peer_pt           free;
+} ngx_http_upstream_hedge_t;
+
+
+/*
+ * while a connection is being established, another address of the upstream
+ * is tried each connect_attempt_delay, up to NGX_HTTP_UPSTREAM_ATTEMPTS
+ * connections in addition to the first one, as in RFC 8305
+ */
+
+#define NGX_HTTP_UPSTREAM_ATTEMPTS      3
+
+
+typedef struct {
+    ngx_peer_connection_t            peer;
+    ngx_http_upstream_t             *upstream;
+    uint64_t                         start_usec;
+
+    /* the balancer of the attempt */
+    void                            *data;
+    ngx_event_get_peer_pt            get;
+    ngx_event_free_peer_pt           free;
+} ngx_http_upstream_attempt_t;
+
+
+typedef struct {
+    ngx_event_t                      event;
+    ngx_uint_t                       nattempts;
+    ngx_http_upstream_attempt_t      attempts[NGX_HTTP_UPSTREAM_ATTEMPTS];
+} ngx_http_upstream_race_t;
+
+
+#if (NGX_HAVE_SPLICE)
+
+#define NGX_HTTP_UPSTREAM_SPLICE_SIZE   65536
+
+typedef struct {
+    ngx_fd_t                         fd[2];
+    size_t                           size;
+} ngx_http_upstream_splice_t;
+
+#endif
+
+
+/*
+ * a request waits in the queue of the upstream while all its peers are busy,
+ * and is dispatched when a peer is freed in this worker process
+ */
+
+typedef struct {
+    ngx_queue_t                      queue;
+    ngx_event_t                      event;
+
+    ngx_msec_t                       start;
+    ngx_msec_t                       queued_at;
+
+    unsigned                         queued:1;
+    unsigned                         dispatched:1;
+} ngx_http_upstream_waiter_t;
+
+
 typedef void (*ngx_http_upstream_handler_pt)(ngx_http_request_t *r,
     ngx_http_upstream_t *u);
 
@@ -341,6 +469,15 @@ struct ngx_http_upstream_s {
 
     ngx_http_upstream_resolved_t    *resolved;
 
+    ngx_http_upstream_hedge_t       *hedge;
+    ngx_http_upstream_race_t        *race;
+    ngx_http_upstream_waiter_t      *waiter;
+
+#if (NGX_HAVE_SPLICE)
+    ngx_http_upstream_splice_t      *splice_pipe;
+    ngx_http_upstream_splice_t      *request_splice_pipe;
+#endif
+
     ngx_buf_t                        from_client;
 
     ngx_buf_t                        buffer;
@@ -369,6 +506,7 @@ struct ngx_http_upstream_s {
                                          ngx_table_elt_t *h);
 
     ngx_msec_t                       start_time;
+    uint64_t                         start_usec;
 
     ngx_http_upstream_state_t       *state;
 
@@ -388,6 +526,7 @@ struct ngx_http_upstream_s {
     unsigned                         ssl:1;
 #if (NGX_HTTP_CACHE)
     unsigned                         cache_status:3;
+    unsigned                         cache_peer:1;
 #endif
 
     unsigned                         buffering:1;
@@ -399,6 +538,12 @@ struct ngx_http_upstream_s {
     unsigned                         request_body_sent:1;
     unsigned                         request_body_blocked:1;
     unsigned                         header_sent:1;
+
+    /* the response body may be passed as is, set by input_filter_init */
+    unsigned                         splice:1;
+
+    /* the unbuffered request body is passed as is, set by create_request */
+    unsigned                         request_splice:1;
 };
 
 
@@ -419,6 +564,8 @@ ngx_int_t ngx_http_upstream_create(ngx_http_request_t *r);
 void ngx_http_upstream_init(ngx_http_request_t *r);
 ngx_int_t ngx_http_upstream_non_buffered_filter_init(void *data);
 ngx_int_t ngx_http_upstream_non_buffered_filter(void *data, ssize_t bytes);
+ngx_int_t ngx_http_upstream_process_early_hints(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
 ngx_http_upstream_srv_conf_t *ngx_http_upstream_add(ngx_conf_t *cf,
     ngx_url_t *u, ngx_uint_t flags);
 char *ngx_http_upstream_bind_set_slot(ngx_conf_t *cf, ngx_command_t *cmd,
@@ -14,8 +14,20 @@
                                     + ((p)->next ? (p)->next->tries : 0))
 
 
+typedef struct {
+    ngx_http_upstream_srv_conf_t   *upstream;
+    ngx_http_upstream_server_t     *server;
+    ngx_event_t                     event;
+} ngx_http_upstream_rr_resolve_t;
+
+
 static ngx_http_upstream_rr_peer_t *ngx_http_upstream_get_peer(
     ngx_http_upstream_rr_peer_data_t *rrp);
+static void ngx_http_upstream_rr_resolve_handler(ngx_event_t *ev);
+static void ngx_http_upstream_rr_resolved(ngx_resolver_ctx_t *ctx);
+static void ngx_http_upstream_rr_update_peers(
+    ngx_http_upstream_rr_resolve_t *rs, ngx_http_upstream_rr_peers_t *peers,
+    ngx_resolver_addr_t *addrs, ngx_uint_t naddrs);
 
 #if (NGX_HTTP_SSL)
 
@@ -33,6 +45,7 @@ ngx_http_upstream_init_round_robin(ngx_conf_t *cf,
 {
     ngx_url_t                      u;
     ngx_uint_t                     i, j, n, w, t;
+    ngx_http_core_loc_conf_t      *clcf;
     ngx_http_upstream_server_t    *server;
     ngx_http_upstream_rr_peer_t   *peer, **peerp;
     ngx_http_upstream_rr_peers_t  *peers, *backup;
@@ -47,6 +60,25 @@ ngx_http_upstream_init_round_robin(ngx_conf_t *cf,
         t = 0;
 
         for (i = 0; i < us->servers->nelts; i++) {
+            if (server[i].resolve && us->resolver == NULL) {
+                clcf = ngx_http_conf_get_module_loc_conf(cf,
+                                                         ngx_http_core_module);
+
+                if (clcf->resolver == NULL) {
+                    ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                                  "no resolver defined to resolve \"%V\" "
+                                  "in upstream \"%V\" in %s:%ui",
+                                  &server[i].host, &us->host,
+                                  us->file_name, us->line);
+                    return NGX_ERROR;
+                }
+
+                us->resolver = clcf->resolver;
+                us->resolver_timeout =
+                               (clcf->resolver_timeout == NGX_CONF_UNSET_MSEC)
+                               ? 30000 : clcf->resolver_timeout;
+            }
+
             if (server[i].backup) {
                 continue;
             }
@@ -104,6 +136,14 @@ ngx_http_upstream_init_round_robin(ngx_conf_t *cf,
                 peer[n].down = server[i].down;
                 peer[n].server = server[i].name;
 
+                if (server[i].resolve) {
+                    peer[n].host = &server[i];
+                }
+
+                if (peer[n].sockaddr->sa_family == AF_UNSPEC) {
+                    peer[n].down |= NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED;
+                }
+
                 *peerp = &peer[n];
                 peerp = &peer[n].next;
                 n++;
@@ -174,6 +214,14 @@ ngx_http_upstream_init_round_robin(ngx_conf_t *cf,
                 peer[n].down = server[i].down;
                 peer[n].server = server[i].name;
 
+                if (server[i].resolve) {
+                    peer[n].host = &server[i];
+                }
+
+                if (peer[n].sockaddr->sa_family == AF_UNSPEC) {
+                    peer[n].down |= NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED;
+                }
+
                 *peerp = &peer[n];
                 peerp = &peer[n].next;
                 n++;
@@ -670,6 +718,320 @@ ngx_http_upstream_free_round_robin_peer(ngx_peer_connection_t *pc, void *data,
 }
 
 
+ngx_msec_t
+ngx_http_upstream_rr_peer_latency(ngx_http_upstream_rr_peer_t *peer)
+{
+    ngx_msec_int_t  elapsed;
+
+    elapsed = (ngx_msec_int_t) (ngx_current_msec - peer->latency_updated);
+
+    if (elapsed < NGX_HTTP_UPSTREAM_LATENCY_PERIOD) {
+        return peer->latency;
+    }
+
+    elapsed /= NGX_HTTP_UPSTREAM_LATENCY_PERIOD;
+
+    if (elapsed >= (ngx_msec_int_t) (8 * sizeof(ngx_msec_t))) {
+        return 0;
+    }
+
+    return peer->latency >> elapsed;
+}
+
+
+void
+ngx_http_upstream_update_round_robin_latency(ngx_peer_connection_t *pc,
+    ngx_http_upstream_rr_peer_data_t *rrp, ngx_http_upstream_t *u,
+    ngx_uint_t mode, ngx_uint_t state)
+{
+    ngx_int_t                     delta;
+    ngx_msec_t                    time;
+    ngx_http_upstream_rr_peer_t  *peer;
+
+    if ((state & NGX_PEER_FAILED) || u->state == NULL) {
+        return;
+    }
+
+    if (mode & NGX_HTTP_UPSTREAM_LATENCY_LAST_BYTE) {
+        time = u->state->response_time;
+
+        if (time == (ngx_msec_t) -1) {
+            /* next upstream is tried */
+            time = ngx_current_msec - u->start_time;
+        }
+
+    } else {
+        time = u->state->header_time;
+    }
+
+    if (time == (ngx_msec_t) -1) {
+        return;
+    }
+
+    peer = rrp->current;
+
+    ngx_http_upstream_rr_peers_rlock(rrp->peers);
+    ngx_http_upstream_rr_peer_lock(rrp->peers, peer);
+
+    if (mode & NGX_HTTP_UPSTREAM_LATENCY_PEAK) {
+        peer->latency = ngx_http_upstream_rr_peer_latency(peer);
+        peer->latency_updated = ngx_current_msec;
+    }
+
+    delta = (ngx_int_t) (time << NGX_HTTP_UPSTREAM_LATENCY_SHIFT)
+            - (ngx_int_t) peer->latency;
+
+    if ((mode & NGX_HTTP_UPSTREAM_LATENCY_PEAK) && delta > 0) {
+        peer->latency += delta;
+
+    } else {
+        peer->latency += delta / (1 << NGX_HTTP_UPSTREAM_LATENCY_DECAY);
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "rr peer %V time:%M latency:%M",
+                   &peer->name, time,
+                   peer->latency >> NGX_HTTP_UPSTREAM_LATENCY_SHIFT);
+
+    ngx_http_upstream_rr_peer_unlock(rrp->peers, peer);
+    ngx_http_upstream_rr_peers_unlock(rrp->peers);
+}
+
+
+ngx_int_t
+ngx_http_upstream_init_round_robin_resolve(ngx_cycle_t *cycle,
+    ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_uint_t                       i;
+    ngx_http_upstream_server_t      *server;
+    ngx_http_upstream_rr_resolve_t  *rs;
+
+    /* each worker process resolves the names, the updates are idempotent */
+
+    server = us->servers->elts;
+
+    for (i = 0; i < us->servers->nelts; i++) {
+        if (!server[i].resolve) {
+            continue;
+        }
+
+        rs = ngx_pcalloc(cycle->pool, sizeof(ngx_http_upstream_rr_resolve_t));
+        if (rs == NULL) {
+            return NGX_ERROR;
+        }
+
+        rs->upstream = us;
+        rs->server = &server[i];
+
+        rs->event.handler = ngx_http_upstream_rr_resolve_handler;
+        rs->event.data = rs;
+        rs->event.log = cycle->log;
+        rs->event.cancelable = 1;
+
+        ngx_add_timer(&rs->event, 1);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_rr_resolve_handler(ngx_event_t *ev)
+{
+    ngx_resolver_ctx_t              *ctx;
+    ngx_http_upstream_rr_resolve_t  *rs;
+
+    rs = ev->data;
+
+    if (ngx_exiting || ngx_terminate || ngx_quit) {
+        return;
+    }
+
+    ctx = ngx_resolve_start(rs->upstream->resolver, NULL);
+    if (ctx == NULL) {
+        goto retry;
+    }
+
+    if (ctx == NGX_NO_RESOLVER) {
+        ngx_log_error(NGX_LOG_ERR, ev->log, 0,
+                      "no resolver defined to resolve %V", &rs->server->host);
+        return;
+    }
+
+    ctx->name = rs->server->host;
+    ctx->handler = ngx_http_upstream_rr_resolved;
+    ctx->data = rs;
+    ctx->timeout = rs->upstream->resolver_timeout;
+
+    if (ngx_resolve_name(ctx) == NGX_OK) {
+        return;
+    }
+
+retry:
+
+    ngx_add_timer(ev, 1000);
+}
+
+
+static void
+ngx_http_upstream_rr_resolved(ngx_resolver_ctx_t *ctx)
+{
+    time_t                           valid;
+    ngx_uint_t                       naddrs;
+    ngx_http_upstream_rr_peers_t    *peers;
+    ngx_http_upstream_rr_resolve_t  *rs;
+
+    rs = ctx->data;
+    naddrs = ctx->naddrs;
+
+    if (ctx->state) {
+        ngx_log_error(NGX_LOG_ERR, rs->event.log, 0,
+                      "upstream \"%V\": %V could not be resolved (%i: %s)",
+                      &rs->upstream->host, &ctx->name, ctx->state,
+                      ngx_resolver_strerror(ctx->state));
+
+        /* the addresses are kept unless the name does not exist */
+
+        if (ctx->state != NGX_RESOLVE_NXDOMAIN) {
+            goto done;
+        }
+
+        naddrs = 0;
+    }
+
+    peers = rs->upstream->peer.data;
+
+    ngx_http_upstream_rr_peers_wlock(peers);
+
+    ngx_http_upstream_rr_update_peers(rs,
+                                      rs->server->backup ? peers->next : peers,
+                                      ctx->addrs, naddrs);
+
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+done:
+
+    valid = ctx->valid - ngx_time();
+
+    ngx_resolve_name_done(ctx);
+
+    if (ngx_exiting || ngx_terminate || ngx_quit) {
+        return;
+    }
+
+    ngx_add_timer(&rs->event, (ngx_msec_t) ngx_max(valid, 1) * 1000);
+}
+
+
+static void
+ngx_http_upstream_rr_update_peers(ngx_http_upstream_rr_resolve_t *rs,
+    ngx_http_upstream_rr_peers_t *peers, ngx_resolver_addr_t *addrs,
+    ngx_uint_t naddrs)
+{
+    ngx_uint_t                    i;
+    ngx_sockaddr_t                sa;
+    ngx_http_upstream_rr_peer_t  *peer, *slot;
+
+    /* the addresses gone are not used anymore */
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+
+        if (peer->host != rs->server
+            || (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED))
+        {
+            continue;
+        }
+
+        for (i = 0; i < naddrs; i++) {
+            ngx_memcpy(&sa, addrs[i].sockaddr, addrs[i].socklen);
+            ngx_inet_set_port(&sa.sockaddr, rs->server->port);
+
+            if (ngx_cmp_sockaddr(peer->sockaddr, peer->socklen,
+                                 &sa.sockaddr, addrs[i].socklen, 1)
+                == NGX_OK)
+            {
+                break;
+            }
+        }
+
+        if (i == naddrs) {
+            ngx_log_error(NGX_LOG_NOTICE, rs->event.log, 0,
+                          "upstream \"%V\": %V removed, %V",
+                          &rs->upstream->host, &peer->name,
+                          &rs->server->name);
+
+            peer->down |= NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED;
+        }
+    }
+
+    /* new addresses take the free slots */
+
+    for (i = 0; i < naddrs; i++) {
+        ngx_memcpy(&sa, addrs[i].sockaddr, addrs[i].socklen);
+        ngx_inet_set_port(&sa.sockaddr, rs->server->port);
+
+        slot = NULL;
+
+        for (peer = peers->peer; peer; peer = peer->next) {
+
+            if (peer->host != rs->server) {
+                continue;
+            }
+
+            if (peer->down & NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED) {
+                if (slot == NULL && peer->conns == 0) {
+                    slot = peer;
+                }
+
+                continue;
+            }
+
+            if (ngx_cmp_sockaddr(peer->sockaddr, peer->socklen,
+                                 &sa.sockaddr, addrs[i].socklen, 1)
+                == NGX_OK)
+            {
+                break;
+            }
+        }
+
+        if (peer) {
+            continue;
+        }
+
+        if (slot == NULL) {
+            ngx_log_error(NGX_LOG_WARN, rs->event.log, 0,
+                          "upstream \"%V\": no free address slots for %V, "
+                          "see the \"max_addrs\" parameter",
+                          &rs->upstream->host, &rs->server->name);
+            break;
+        }
+
+        peer = slot;
+
+        ngx_memcpy(peer->sockaddr, &sa, addrs[i].socklen);
+        peer->socklen = addrs[i].socklen;
+        peer->name.len = ngx_sock_ntop(peer->sockaddr, peer->socklen,
+                                       peer->name.data, NGX_SOCKADDR_STRLEN, 1);
+
+        peer->fails = 0;
+        peer->accessed = 0;
+        peer->checked = 0;
+        peer->current_weight = 0;
+        peer->effective_weight = peer->weight;
+        peer->latency = 0;
+        peer->hc_fails = 0;
+        peer->hc_passes = 0;
+
+        peer->down &= ~(NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED
+                        |NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY);
+
+        ngx_log_error(NGX_LOG_NOTICE, rs->event.log, 0,
+                      "upstream \"%V\": %V added, %V",
+                      &rs->upstream->host, &peer->name, &rs->server->name);
+    }
+}
+
+
 #if (NGX_HTTP_SSL)
 
 ngx_int_t
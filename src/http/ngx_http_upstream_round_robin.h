@@ -40,6 +40,15 @@ struct ngx_http_upstream_rr_peer_s {
 
     ngx_uint_t                      down;
 
+    ngx_msec_t                      latency;
+    ngx_msec_t                      latency_updated;
+
+    ngx_msec_t                      hc_checked;
+    ngx_uint_t                      hc_fails;
+    ngx_uint_t                      hc_passes;
+
+    ngx_http_upstream_server_t     *host;
+
 #if (NGX_HTTP_SSL || NGX_COMPAT)
     void                           *ssl_session;
     int                             ssl_session_len;
@@ -56,6 +65,22 @@ struct ngx_http_upstream_rr_peer_s {
 };
 
 
+/* peer->down bit set by active health checks */
+
+#define NGX_HTTP_UPSTREAM_RR_PEER_UNHEALTHY  0x02
+
+/*
+ * peer->down bit of an address slot not in use: of a "resolve" server,
+ * or a spare slot of an upstream zone for peers added at run time
+ */
+
+#define NGX_HTTP_UPSTREAM_RR_PEER_UNRESOLVED 0x04
+
+/* peer->down bit of a peer being drained, set at run time */
+
+#define NGX_HTTP_UPSTREAM_RR_PEER_DRAIN      0x08
+
+
 typedef struct ngx_http_upstream_rr_peers_s  ngx_http_upstream_rr_peers_t;
 
 struct ngx_http_upstream_rr_peers_s {
@@ -64,6 +89,7 @@ struct ngx_http_upstream_rr_peers_s {
 #if (NGX_HTTP_UPSTREAM_ZONE)
     ngx_slab_pool_t                *shpool;
     ngx_atomic_t                    rwlock;
+    ngx_brlock_t                   *brlock;
     ngx_http_upstream_rr_peers_t   *zone_next;
 #endif
 
@@ -85,19 +111,28 @@ struct ngx_http_upstream_rr_peers_s {
 
 #define ngx_http_upstream_rr_peers_rlock(peers)                               \
                                                                               \
-    if (peers->shpool) {                                                      \
+    if (peers->brlock) {                                                      \
+        ngx_brlock_rlock(peers->brlock);                                      \
+                                                                              \
+    } else if (peers->shpool) {                                               \
         ngx_rwlock_rlock(&peers->rwlock);                                     \
     }
 
 #define ngx_http_upstream_rr_peers_wlock(peers)                               \
                                                                               \
-    if (peers->shpool) {                                                      \
+    if (peers->brlock) {                                                      \
+        ngx_brlock_wlock(peers->brlock);                                      \
+                                                                              \
+    } else if (peers->shpool) {                                               \
         ngx_rwlock_wlock(&peers->rwlock);                                     \
     }
 
 #define ngx_http_upstream_rr_peers_unlock(peers)                              \
                                                                               \
-    if (peers->shpool) {                                                      \
+    if (peers->brlock) {                                                      \
+        ngx_brlock_unlock(peers->brlock);                                     \
+                                                                              \
+    } else if (peers->shpool) {                                               \
         ngx_rwlock_unlock(&peers->rwlock);                                    \
     }
 
@@ -125,6 +160,23 @@ struct ngx_http_upstream_rr_peers_s {
 #endif
 
 
+/*
+ * peer->latency is an exponentially weighted moving average of
+ * the response time in 1/16 of millisecond, with the weight of 1/8
+ * for a new sample; in the peak mode a larger sample replaces it,
+ * and the value is halved for each NGX_HTTP_UPSTREAM_LATENCY_PERIOD
+ * without samples
+ */
+
+#define NGX_HTTP_UPSTREAM_LATENCY_SHIFT      4
+#define NGX_HTTP_UPSTREAM_LATENCY_DECAY      3
+#define NGX_HTTP_UPSTREAM_LATENCY_PERIOD     10000
+
+#define NGX_HTTP_UPSTREAM_LATENCY_HEADER     0x01
+#define NGX_HTTP_UPSTREAM_LATENCY_LAST_BYTE  0x02
+#define NGX_HTTP_UPSTREAM_LATENCY_PEAK       0x04
+
+
 typedef struct {
     ngx_uint_t                      config;
     ngx_http_upstream_rr_peers_t   *peers;
@@ -144,6 +196,12 @@ ngx_int_t ngx_http_upstream_get_round_robin_peer(ngx_peer_connection_t *pc,
     void *data);
 void ngx_http_upstream_free_round_robin_peer(ngx_peer_connection_t *pc,
     void *data, ngx_uint_t state);
+ngx_int_t ngx_http_upstream_init_round_robin_resolve(ngx_cycle_t *cycle,
+    ngx_http_upstream_srv_conf_t *us);
+ngx_msec_t ngx_http_upstream_rr_peer_latency(ngx_http_upstream_rr_peer_t *peer);
+void ngx_http_upstream_update_round_robin_latency(ngx_peer_connection_t *pc,
+    ngx_http_upstream_rr_peer_data_t *rrp, ngx_http_upstream_t *u,
+    ngx_uint_t mode, ngx_uint_t state);
 
 #if (NGX_HTTP_SSL)
 ngx_int_t
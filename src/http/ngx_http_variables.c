@@ -11,6 +11,10 @@
 #include <nginx.h>
 
 
+#define ngx_http_header_index_char(c)                                         \
+    (((c) >= 'A' && (c) <= 'Z') ? ((c) | 0x20) : ((c) == '-' ? '_' : (c)))
+
+
 static ngx_http_variable_t *ngx_http_add_prefix_variable(ngx_conf_t *cf,
     ngx_str_t *name, ngx_uint_t flags);
 
@@ -36,6 +40,10 @@ static ngx_int_t ngx_http_variable_unknown_header_out(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_unknown_trailer_out(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_http_headers_index_t *ngx_http_headers_index(
+    ngx_http_request_t *r);
+static ngx_int_t ngx_http_header_index_cmp(ngx_table_elt_t *one,
+    ngx_table_elt_t *two);
 static ngx_int_t ngx_http_variable_request_line(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_cookie(ngx_http_request_t *r,
@@ -103,6 +111,16 @@ static ngx_int_t ngx_http_variable_request_length(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_request_time(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_variable_phase_time(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_variable_request_body_time(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_variable_first_byte_time(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_variable_msec_value(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, ngx_msec_t ms);
+static ngx_int_t ngx_http_variable_request_pool(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_request_id(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_status(ngx_http_request_t *r,
@@ -302,6 +320,46 @@ static ngx_http_variable_t  ngx_http_core_variables[] = {
     { ngx_string("request_time"), NULL, ngx_http_variable_request_time,
       0, NGX_HTTP_VAR_NOCACHEABLE, 0 },
 
+    { ngx_string("phase_post_read_time"), NULL, ngx_http_variable_phase_time,
+      NGX_HTTP_POST_READ_PHASE, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("phase_server_rewrite_time"), NULL,
+      ngx_http_variable_phase_time,
+      NGX_HTTP_SERVER_REWRITE_PHASE, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("phase_rewrite_time"), NULL, ngx_http_variable_phase_time,
+      NGX_HTTP_REWRITE_PHASE, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("phase_preaccess_time"), NULL, ngx_http_variable_phase_time,
+      NGX_HTTP_PREACCESS_PHASE, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("phase_access_time"), NULL, ngx_http_variable_phase_time,
+      NGX_HTTP_ACCESS_PHASE, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("phase_precontent_time"), NULL, ngx_http_variable_phase_time,
+      NGX_HTTP_PRECONTENT_PHASE, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("phase_content_time"), NULL, ngx_http_variable_phase_time,
+      NGX_HTTP_CONTENT_PHASE, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("request_body_time"), NULL,
+      ngx_http_variable_request_body_time, 0, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("first_byte_time"), NULL, ngx_http_variable_first_byte_time,
+      0, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("request_pool_size"), NULL, ngx_http_variable_request_pool,
+      offsetof(ngx_pool_usage_t, size), NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("request_pool_used"), NULL, ngx_http_variable_request_pool,
+      offsetof(ngx_pool_usage_t, used), NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("request_pool_blocks"), NULL, ngx_http_variable_request_pool,
+      offsetof(ngx_pool_usage_t, blocks), NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("request_pool_large"), NULL, ngx_http_variable_request_pool,
+      offsetof(ngx_pool_usage_t, large), NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
     { ngx_string("request_id"), NULL,
       ngx_http_variable_request_id,
       0, 0, 0 },
@@ -936,6 +994,28 @@ ngx_http_variable_unknown_header(ngx_http_request_t *r,
     len = 0;
 #endif
 
+    if (part == &r->headers_in.headers.part) {
+
+        /* headers with the same name are linked in the index */
+
+        for (header = ngx_http_find_header_in(r, var->data + prefix,
+                                              var->len - prefix);
+             header;
+             header = header->next)
+        {
+            if (header->hash == 0) {
+                continue;
+            }
+
+            len += header->value.len + 2;
+
+            *ph = header;
+            ph = &header->next;
+        }
+
+        goto found;
+    }
+
     header = part->elts;
 
     for (i = 0; /* void */ ; i++) {
@@ -983,6 +1063,8 @@ ngx_http_variable_unknown_header(ngx_http_request_t *r,
         ph = &header[i].next;
     }
 
+found:
+
     *ph = NULL;
 
     if (h == NULL) {
@@ -1031,6 +1113,187 @@ ngx_http_variable_unknown_header(ngx_http_request_t *r,
 }
 
 
+/*
+ * the index of request headers is built on the first lookup and is rebuilt
+ * if headers are added; names are compared case-insensitively, and "-"
+ * matches "_" as in variable names
+ */
+
+ngx_table_elt_t *
+ngx_http_find_header_in(ngx_http_request_t *r, u_char *name, size_t len)
+{
+    u_char                         ch;
+    ngx_uint_t                     i, n, hash;
+    ngx_table_elt_t               *h;
+    ngx_http_headers_index_t      *index;
+    ngx_http_header_index_elt_t   *elt;
+
+    index = r->headers_in.index;
+
+    if (index == NULL
+        || index->last != r->headers_in.headers.last
+        || index->nelts != r->headers_in.headers.last->nelts)
+    {
+        index = ngx_http_headers_index(r);
+        if (index == NULL) {
+            return NULL;
+        }
+    }
+
+    hash = 0;
+
+    for (n = 0; n < len; n++) {
+        ch = ngx_http_header_index_char(name[n]);
+        hash = ngx_hash(hash, ch);
+    }
+
+    for (i = hash & index->mask; /* void */ ; i = (i + 1) & index->mask) {
+        elt = &index->elts[i];
+
+        if (elt->header == NULL) {
+            return NULL;
+        }
+
+        if (elt->hash != hash) {
+            continue;
+        }
+
+        h = elt->header;
+
+        if (h->key.len != len) {
+            continue;
+        }
+
+        for (n = 0; n < len; n++) {
+            if (ngx_http_header_index_char(h->key.data[n])
+                != ngx_http_header_index_char(name[n]))
+            {
+                break;
+            }
+        }
+
+        if (n == len) {
+            while (h && h->hash == 0) {
+                h = h->next;
+            }
+
+            return h;
+        }
+    }
+}
+
+
+static ngx_http_headers_index_t *
+ngx_http_headers_index(ngx_http_request_t *r)
+{
+    ngx_uint_t                     i, n, size, hash;
+    ngx_list_part_t               *part;
+    ngx_table_elt_t               *header, *h;
+    ngx_http_headers_index_t      *index;
+    ngx_http_header_index_elt_t   *elt;
+
+    n = 0;
+
+    for (part = &r->headers_in.headers.part; part; part = part->next) {
+        n += part->nelts;
+    }
+
+    for (size = 8; size < 2 * n; size *= 2) { /* void */ }
+
+    /* the previous index, if any, is not freed */
+
+    index = ngx_palloc(r->pool, sizeof(ngx_http_headers_index_t));
+    if (index == NULL) {
+        return NULL;
+    }
+
+    index->elts = ngx_pcalloc(r->pool,
+                              size * sizeof(ngx_http_header_index_elt_t));
+    if (index->elts == NULL) {
+        return NULL;
+    }
+
+    index->mask = size - 1;
+    index->last = r->headers_in.headers.last;
+    index->nelts = r->headers_in.headers.last->nelts;
+
+    part = &r->headers_in.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        hash = 0;
+
+        for (n = 0; n < header[i].key.len; n++) {
+            hash = ngx_hash(hash,
+                            ngx_http_header_index_char(header[i].key.data[n]));
+        }
+
+        for (n = hash & index->mask; /* void */ ; n = (n + 1) & index->mask) {
+            elt = &index->elts[n];
+
+            if (elt->header == NULL) {
+                elt->hash = hash;
+                elt->header = &header[i];
+                break;
+            }
+
+            if (elt->hash != hash
+                || ngx_http_header_index_cmp(elt->header, &header[i]) != 0)
+            {
+                continue;
+            }
+
+            for (h = elt->header; h->next; h = h->next) { /* void */ }
+
+            h->next = &header[i];
+            break;
+        }
+
+        header[i].next = NULL;
+    }
+
+    r->headers_in.index = index;
+
+    return index;
+}
+
+
+static ngx_int_t
+ngx_http_header_index_cmp(ngx_table_elt_t *one, ngx_table_elt_t *two)
+{
+    ngx_uint_t  n;
+
+    if (one->key.len != two->key.len) {
+        return 1;
+    }
+
+    for (n = 0; n < one->key.len; n++) {
+        if (ngx_http_header_index_char(one->key.data[n])
+            != ngx_http_header_index_char(two->key.data[n]))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
 static ngx_int_t
 ngx_http_variable_request_line(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
@@ -2215,19 +2478,98 @@ ngx_http_variable_request_time(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
 {
     u_char          *p;
+    uint64_t         us;
     ngx_time_t      *tp;
     ngx_msec_int_t   ms;
 
-    p = ngx_pnalloc(r->pool, NGX_TIME_T_LEN + 4);
+    p = ngx_pnalloc(r->pool, NGX_TIME_T_LEN + 7);
     if (p == NULL) {
         return NGX_ERROR;
     }
 
-    tp = ngx_timeofday();
+    if (r->start_usec) {
 
-    ms = (ngx_msec_int_t)
-             ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
-    ms = ngx_max(ms, 0);
+        /* precise_timing */
+
+        us = ngx_monotonic_usec() - r->start_usec;
+
+        v->len = ngx_sprintf(p, "%T.%06uL",
+                             (time_t) (us / 1000000), us % 1000000)
+                 - p;
+
+    } else {
+        tp = ngx_timeofday();
+
+        ms = (ngx_msec_int_t) ((tp->sec - r->start_sec) * 1000
+                               + (tp->msec - r->start_msec));
+        ms = ngx_max(ms, 0);
+
+        v->len = ngx_sprintf(p, "%T.%03M", (time_t) ms / 1000, ms % 1000) - p;
+    }
+
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->data = p;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_variable_phase_time(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    if (r->phase_start == 0) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    return ngx_http_variable_msec_value(r, v,
+                                        ngx_http_core_phase_time(r, data));
+}
+
+
+static ngx_int_t
+ngx_http_variable_request_body_time(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    ngx_http_request_body_t  *rb;
+
+    rb = r->main->request_body;
+
+    if (rb == NULL || !rb->last_saved) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    return ngx_http_variable_msec_value(r, v, rb->read_time);
+}
+
+
+static ngx_int_t
+ngx_http_variable_first_byte_time(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    if (!r->main->first_byte_sent) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    return ngx_http_variable_msec_value(r, v, r->main->first_byte_time);
+}
+
+
+static ngx_int_t
+ngx_http_variable_msec_value(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, ngx_msec_t ms)
+{
+    u_char  *p;
+
+    p = ngx_pnalloc(r->pool, NGX_TIME_T_LEN + 4);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
 
     v->len = ngx_sprintf(p, "%T.%03M", (time_t) ms / 1000, ms % 1000) - p;
     v->valid = 1;
@@ -2239,6 +2581,35 @@ ngx_http_variable_request_time(ngx_http_request_t *r,
 }
 
 
+static ngx_int_t
+ngx_http_variable_request_pool(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    u_char            *p;
+    size_t            *sp;
+    ngx_pool_usage_t   u;
+
+    /* the main request pool, subrequests share it */
+
+    ngx_pool_usage(r->main->pool, &u);
+
+    sp = (size_t *) ((char *) &u + data);
+
+    p = ngx_pnalloc(r->pool, NGX_SIZE_T_LEN);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    v->len = ngx_sprintf(p, "%uz", *sp) - p;
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->data = p;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_variable_request_id(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
@@ -60,6 +60,8 @@ ngx_http_variable_value_t *ngx_http_get_variable(ngx_http_request_t *r,
 ngx_int_t ngx_http_variable_unknown_header(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, ngx_str_t *var, ngx_list_part_t *part,
     size_t prefix);
+ngx_table_elt_t *ngx_http_find_header_in(ngx_http_request_t *r,
+    u_char *name, size_t len);
 
 
 #if (NGX_PCRE)
@@ -10,6 +10,32 @@
 #include <ngx_http.h>
 
 
+struct ngx_http_pipelined_out_s {
+    ngx_buf_t                 *buf;
+    ngx_connection_t          *connection;
+    ngx_event_t                event;
+    ngx_event_handler_pt       write_handler;
+    ngx_msec_t                 send_timeout;
+    unsigned                   busy:1;
+    unsigned                   write:1;
+};
+
+
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+static off_t ngx_http_write_filter_notsent(ngx_http_request_t *r,
+    size_t lowat, off_t limit);
+#endif
+static void ngx_http_write_filter_first_byte(ngx_http_request_t *r);
+static ngx_int_t ngx_http_write_filter_pipelined(ngx_http_request_t *r,
+    off_t *size, ngx_uint_t last);
+static ngx_http_pipelined_out_t *ngx_http_write_filter_create_pipelined(
+    ngx_connection_t *c);
+static void ngx_http_write_filter_pipelined_handler(ngx_event_t *ev);
+static void ngx_http_write_filter_pipelined_write_handler(ngx_event_t *wev);
+static ngx_int_t ngx_http_write_filter_pipelined_send(
+    ngx_http_pipelined_out_t *po);
+static void ngx_http_write_filter_pipelined_done(ngx_http_pipelined_out_t *po);
+static void ngx_http_write_filter_pipelined_cleanup(void *data);
 static ngx_int_t ngx_http_write_filter_init(ngx_conf_t *cf);
 
 
@@ -220,6 +246,15 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
         return NGX_OK;
     }
 
+    switch (ngx_http_write_filter_pipelined(r, &size, last)) {
+    case NGX_OK:
+        return NGX_OK;
+    case NGX_ERROR:
+        return NGX_ERROR;
+    default:
+        break;
+    }
+
     if (c->write->delayed) {
         c->buffered |= NGX_HTTP_WRITE_BUFFERED;
         return NGX_AGAIN;
@@ -291,6 +326,17 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
         limit = clcf->sendfile_max_chunk;
     }
 
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+
+    if ((clcf->tcp_notsent_lowat || r->http_connection->notsent_lowat)
+        && r->http_version < NGX_HTTP_VERSION_20)
+    {
+        limit = ngx_http_write_filter_notsent(r, clcf->tcp_notsent_lowat,
+                                              limit);
+    }
+
+#endif
+
     sent = c->sent;
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
@@ -306,6 +352,14 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
         return NGX_ERROR;
     }
 
+    if (!r->main->first_byte_sent && c->sent != sent) {
+        ngx_http_write_filter_first_byte(r->main);
+    }
+
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+    r->http_connection->notsent_queued += c->sent - sent;
+#endif
+
     if (r->limit_rate) {
 
         nsent = c->sent;
@@ -345,6 +399,11 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
     if (chain) {
         c->buffered |= NGX_HTTP_WRITE_BUFFERED;
+
+        if (r->main->trace) {
+            ngx_http_trace_add(r, NGX_HTTP_TRACE_CLIENT_BLOCKED, c->write);
+        }
+
         return NGX_AGAIN;
     }
 
@@ -362,6 +421,465 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
 }
 
 
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+
+static off_t
+ngx_http_write_filter_notsent(ngx_http_request_t *r, size_t lowat,
+    off_t limit)
+{
+#if (NGX_HAVE_SIOCOUTQNSD)
+    int                     unsent;
+    off_t                   drained, size;
+#endif
+    ngx_connection_t       *c;
+    ngx_http_connection_t  *hc;
+
+    c = r->connection;
+    hc = r->http_connection;
+
+    /*
+     * the socket is reported as writable once its unsent data are below
+     * the low-water mark, the kernel holds little more than the mark
+     */
+
+    if (hc->notsent_lowat != lowat) {
+        if (ngx_tcp_notsent_lowat(c->fd, lowat) == -1) {
+            ngx_connection_error(c, ngx_socket_errno,
+                                 ngx_tcp_notsent_lowat_n " failed");
+        }
+
+        hc->notsent_lowat = lowat;
+
+        if (lowat == 0) {
+            /* the system default of the previous request's location */
+            return limit;
+        }
+    }
+
+#if (NGX_HAVE_SIOCOUTQNSD)
+
+    /*
+     * the bytes sent out by the kernel since the previous write are
+     * the drain rate, twice of them are written at once: this keeps
+     * the send queue short on slow links and does not limit fast ones
+     */
+
+    if (ngx_socket_nunsent(c->fd, &unsent) == -1) {
+        return limit;
+    }
+
+    drained = hc->notsent_queued - unsent;
+    hc->notsent_queued = unsent;
+
+    size = ngx_max((off_t) lowat, 2 * drained);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http write filter unsent:%d drained:%O size:%O",
+                   unsent, drained, size);
+
+    if (limit == 0 || size < limit) {
+        limit = size;
+    }
+
+#endif
+
+    return limit;
+}
+
+#endif
+
+
+static void
+ngx_http_write_filter_first_byte(ngx_http_request_t *r)
+{
+    ngx_time_t      *tp;
+    ngx_msec_int_t   ms;
+
+    tp = ngx_timeofday();
+
+    ms = (ngx_msec_int_t)
+             ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
+
+    r->first_byte_time = (ngx_msec_t) ngx_max(ms, 0);
+    r->first_byte_sent = 1;
+}
+
+
+static ngx_int_t
+ngx_http_write_filter_pipelined(ngx_http_request_t *r, off_t *size,
+    ngx_uint_t last)
+{
+    u_char                    *p;
+    ngx_buf_t                 *b;
+    ngx_chain_t               *cl, *ln;
+    ngx_connection_t          *c;
+    ngx_http_pipelined_out_t  *po;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    /*
+     * a complete response to a request followed by a pipelined one
+     * is copied to the connection buffer instead of being sent, and is
+     * sent along with the following responses, or in the next event loop
+     * iteration at the latest
+     */
+
+    c = r->connection;
+    po = r->http_connection->pipelined;
+
+    if (po && po->busy && po->buf->pos == po->buf->last) {
+        po->busy = 0;
+        po->buf->pos = po->buf->start;
+        po->buf->last = po->buf->start;
+    }
+
+    if (!last
+        || r != r->main
+        || !r->keepalive
+        || r->http_version < NGX_HTTP_VERSION_11
+        || r->http_version >= NGX_HTTP_VERSION_20
+        || r->headers_in.content_length_n > 0
+        || r->headers_in.chunked
+        || r->header_in->pos == r->header_in->last
+        || *size > NGX_HTTP_PIPELINED_BUFFER_SIZE
+        || c->write->delayed
+        || (c->buffered & NGX_LOWLEVEL_BUFFERED)
+        || (po && po->busy))
+    {
+        goto send;
+    }
+
+    for (cl = r->out; cl; cl = cl->next) {
+        if (!ngx_buf_special(cl->buf) && !ngx_buf_in_memory_only(cl->buf)) {
+            goto send;
+        }
+    }
+
+    if (po == NULL) {
+        po = ngx_http_write_filter_create_pipelined(c);
+        if (po == NULL) {
+            return NGX_ERROR;
+        }
+
+        r->http_connection->pipelined = po;
+    }
+
+    b = po->buf;
+
+    if (*size > b->end - b->last) {
+        goto send;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http write filter pipelined: %O", *size);
+
+    p = b->last;
+
+    for (cl = r->out; cl; /* void */) {
+        if (!ngx_buf_special(cl->buf)) {
+            p = ngx_cpymem(p, cl->buf->pos, cl->buf->last - cl->buf->pos);
+            cl->buf->pos = cl->buf->last;
+        }
+
+        ln = cl;
+        cl = cl->next;
+        ngx_free_chain(r->pool, ln);
+    }
+
+    b->last = p;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+    po->send_timeout = clcf->send_timeout;
+
+    r->out = NULL;
+    c->buffered &= ~NGX_HTTP_WRITE_BUFFERED;
+    c->sent += *size;
+
+    if (!r->first_byte_sent && *size) {
+        ngx_http_write_filter_first_byte(r);
+    }
+
+    r->response_sent = 1;
+
+    if (!po->event.posted) {
+        ngx_post_event(&po->event, &ngx_posted_next_events);
+    }
+
+    return NGX_OK;
+
+send:
+
+    if (po == NULL || po->busy || po->buf->pos == po->buf->last) {
+        return NGX_DECLINED;
+    }
+
+    /* the saved responses precede the output */
+
+    cl = ngx_alloc_chain_link(r->pool);
+    if (cl == NULL) {
+        return NGX_ERROR;
+    }
+
+    cl->buf = po->buf;
+    cl->next = r->out;
+    r->out = cl;
+
+    po->busy = 1;
+
+    if (po->event.posted) {
+        ngx_delete_posted_event(&po->event);
+    }
+
+    /* the request now sends the rest itself */
+
+    ngx_http_write_filter_pipelined_done(po);
+
+    /* the bytes were accounted for by the previous requests */
+
+    *size += ngx_buf_size(po->buf);
+    c->sent -= ngx_buf_size(po->buf);
+
+    return NGX_DECLINED;
+}
+
+
+static ngx_http_pipelined_out_t *
+ngx_http_write_filter_create_pipelined(ngx_connection_t *c)
+{
+    ngx_pool_cleanup_t        *cln;
+    ngx_http_pipelined_out_t  *po;
+
+    po = ngx_pcalloc(c->pool, sizeof(ngx_http_pipelined_out_t));
+    if (po == NULL) {
+        return NULL;
+    }
+
+    po->buf = ngx_create_temp_buf(c->pool, NGX_HTTP_PIPELINED_BUFFER_SIZE);
+    if (po->buf == NULL) {
+        return NULL;
+    }
+
+    cln = ngx_pool_cleanup_add(c->pool, 0);
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    cln->handler = ngx_http_write_filter_pipelined_cleanup;
+    cln->data = po;
+
+    po->connection = c;
+
+    po->event.handler = ngx_http_write_filter_pipelined_handler;
+    po->event.data = po;
+    po->event.log = c->log;
+
+    return po;
+}
+
+
+static void
+ngx_http_write_filter_pipelined_handler(ngx_event_t *ev)
+{
+    ngx_http_pipelined_out_t  *po;
+
+    po = ev->data;
+
+    if (po->busy || po->connection->error || po->buf->pos == po->buf->last) {
+        return;
+    }
+
+    if (ngx_http_write_filter_pipelined_send(po) == NGX_ERROR) {
+        po->connection->error = 1;
+    }
+}
+
+
+static void
+ngx_http_write_filter_pipelined_write_handler(ngx_event_t *wev)
+{
+    ngx_connection_t          *c;
+    ngx_http_request_t        *r;
+    ngx_http_pipelined_out_t  *po;
+
+    /* the handler is only set while a pipelined request is processed */
+
+    c = wev->data;
+    r = c->data;
+    po = r->http_connection->pipelined;
+
+    ngx_http_set_log_request(c->log, r);
+
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_INFO, c->log, NGX_ETIMEDOUT,
+                      "client timed out");
+        c->timedout = 1;
+
+        ngx_http_write_filter_pipelined_done(po);
+        ngx_http_finalize_request(r, NGX_HTTP_REQUEST_TIME_OUT);
+        return;
+    }
+
+    if (ngx_http_write_filter_pipelined_send(po) == NGX_ERROR) {
+        c->error = 1;
+
+        ngx_http_write_filter_pipelined_done(po);
+        ngx_http_finalize_request(r, NGX_ERROR);
+        return;
+    }
+}
+
+
+static ngx_int_t
+ngx_http_write_filter_pipelined_send(ngx_http_pipelined_out_t *po)
+{
+    off_t              sent;
+    ngx_event_t       *wev;
+    ngx_chain_t        out, *cl;
+    ngx_connection_t  *c;
+
+    c = po->connection;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http write filter pipelined send: %z",
+                   po->buf->last - po->buf->pos);
+
+    out.buf = po->buf;
+    out.next = NULL;
+
+    /* the bytes were accounted for by the requests */
+
+    sent = c->sent;
+
+    cl = c->send_chain(c, &out, 0);
+
+    c->sent = sent;
+
+    if (cl == NGX_CHAIN_ERROR) {
+        return NGX_ERROR;
+    }
+
+    if (po->buf->pos == po->buf->last) {
+        po->buf->pos = po->buf->start;
+        po->buf->last = po->buf->start;
+
+        ngx_http_write_filter_pipelined_done(po);
+
+        return NGX_OK;
+    }
+
+    /*
+     * the rest is sent when the socket becomes writable, or along
+     * with the next response, whichever is first; the handler of
+     * the connection is restored then
+     */
+
+    wev = c->write;
+
+    if (!po->write) {
+        po->write = 1;
+        po->write_handler = wev->handler;
+        wev->handler = ngx_http_write_filter_pipelined_write_handler;
+    }
+
+    ngx_add_timer(wev, po->send_timeout);
+
+    if (ngx_handle_write_event(wev, 0) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static void
+ngx_http_write_filter_pipelined_done(ngx_http_pipelined_out_t *po)
+{
+    ngx_event_t  *wev;
+
+    if (!po->write) {
+        return;
+    }
+
+    po->write = 0;
+
+    wev = po->connection->write;
+    wev->handler = po->write_handler;
+
+    if (wev->timer_set) {
+        ngx_del_timer(wev);
+    }
+}
+
+
+void
+ngx_http_write_filter_set_handler(ngx_connection_t *c,
+    ngx_http_connection_t *hc, ngx_event_handler_pt handler)
+{
+    ngx_http_pipelined_out_t  *po;
+
+    po = hc->pipelined;
+
+    if (po && po->write) {
+
+        /*
+         * the handler is restored once the saved responses are sent;
+         * the send timer might have been removed by request finalization
+         */
+
+        po->write_handler = handler;
+
+        if (!c->write->timer_set) {
+            ngx_add_timer(c->write, po->send_timeout);
+        }
+
+        return;
+    }
+
+    c->write->handler = handler;
+}
+
+
+void
+ngx_http_write_filter_close(ngx_http_request_t *r)
+{
+    size_t                     size;
+    ngx_connection_t          *c;
+    ngx_http_pipelined_out_t  *po;
+
+    c = r->connection;
+    po = r->http_connection->pipelined;
+
+    if (po == NULL || po->busy || po->buf->pos == po->buf->last) {
+        return;
+    }
+
+    ngx_http_write_filter_pipelined_done(po);
+
+    if (!c->error && !c->timedout) {
+        (void) ngx_http_write_filter_pipelined_send(po);
+        ngx_http_write_filter_pipelined_done(po);
+    }
+
+    size = po->buf->last - po->buf->pos;
+
+    if (size) {
+        ngx_log_error(NGX_LOG_INFO, c->log, 0,
+                      "%uz bytes of responses to pipelined requests "
+                      "were not sent", size);
+    }
+}
+
+
+static void
+ngx_http_write_filter_pipelined_cleanup(void *data)
+{
+    ngx_http_pipelined_out_t  *po = data;
+
+    if (po->event.posted) {
+        ngx_delete_posted_event(&po->event);
+    }
+}
+
+
 static ngx_int_t
 ngx_http_write_filter_init(ngx_conf_t *cf)
 {
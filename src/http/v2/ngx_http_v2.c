@@ -43,9 +43,12 @@
 #define NGX_HTTP_V2_MAX_STREAMS_SETTING          0x3
 #define NGX_HTTP_V2_INIT_WINDOW_SIZE_SETTING     0x4
 #define NGX_HTTP_V2_MAX_FRAME_SIZE_SETTING       0x5
+#define NGX_HTTP_V2_NO_RFC7540_PRIORITIES_SETTING  0x9
 
 #define NGX_HTTP_V2_FRAME_BUFFER_SIZE            24
 
+#define NGX_HTTP_V2_DIRECT_READ_SIZE             16384
+
 #define NGX_HTTP_V2_ROOT                         (void *) -1
 
 
@@ -65,6 +68,8 @@ static u_char *ngx_http_v2_state_data(ngx_http_v2_connection_t *h2c,
     u_char *pos, u_char *end);
 static u_char *ngx_http_v2_state_read_data(ngx_http_v2_connection_t *h2c,
     u_char *pos, u_char *end);
+static u_char *ngx_http_v2_read_data_buffer(ngx_http_v2_connection_t *h2c,
+    size_t *size);
 static u_char *ngx_http_v2_state_headers(ngx_http_v2_connection_t *h2c,
     u_char *pos, u_char *end);
 static u_char *ngx_http_v2_state_header_block(ngx_http_v2_connection_t *h2c,
@@ -85,6 +90,8 @@ static u_char *ngx_http_v2_handle_continuation(ngx_http_v2_connection_t *h2c,
     u_char *pos, u_char *end, ngx_http_v2_handler_pt handler);
 static u_char *ngx_http_v2_state_priority(ngx_http_v2_connection_t *h2c,
     u_char *pos, u_char *end);
+static u_char *ngx_http_v2_state_priority_update(
+    ngx_http_v2_connection_t *h2c, u_char *pos, u_char *end);
 static u_char *ngx_http_v2_state_rst_stream(ngx_http_v2_connection_t *h2c,
     u_char *pos, u_char *end);
 static u_char *ngx_http_v2_state_settings(ngx_http_v2_connection_t *h2c,
@@ -133,6 +140,7 @@ static ngx_int_t ngx_http_v2_send_window_update(ngx_http_v2_connection_t *h2c,
     ngx_uint_t sid, size_t window);
 static ngx_int_t ngx_http_v2_send_rst_stream(ngx_http_v2_connection_t *h2c,
     ngx_uint_t sid, ngx_uint_t status);
+static ngx_int_t ngx_http_v2_send_ping(ngx_http_v2_connection_t *h2c);
 static ngx_int_t ngx_http_v2_send_goaway(ngx_http_v2_connection_t *h2c,
     ngx_uint_t status);
 
@@ -157,12 +165,15 @@ static ngx_int_t ngx_http_v2_parse_authority(ngx_http_request_t *r,
 static ngx_int_t ngx_http_v2_construct_request_line(ngx_http_request_t *r);
 static ngx_int_t ngx_http_v2_cookie(ngx_http_request_t *r,
     ngx_http_v2_header_t *header);
+static void ngx_http_v2_parse_priority(ngx_http_v2_stream_t *stream,
+    u_char *p, u_char *last);
 static ngx_int_t ngx_http_v2_construct_cookie_header(ngx_http_request_t *r);
 static void ngx_http_v2_run_request(ngx_http_request_t *r);
 static ngx_int_t ngx_http_v2_process_request_body(ngx_http_request_t *r,
     u_char *pos, size_t size, ngx_uint_t last, ngx_uint_t flush);
 static ngx_int_t ngx_http_v2_filter_request_body(ngx_http_request_t *r);
 static void ngx_http_v2_read_client_request_body_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_v2_tune_body_window(ngx_http_request_t *r);
 
 static ngx_int_t ngx_http_v2_terminate_stream(ngx_http_v2_connection_t *h2c,
     ngx_http_v2_stream_t *stream, ngx_uint_t status);
@@ -179,9 +190,14 @@ static void ngx_http_v2_set_dependency(ngx_http_v2_connection_t *h2c,
     ngx_http_v2_node_t *node, ngx_uint_t depend, ngx_uint_t exclusive);
 static void ngx_http_v2_node_children_update(ngx_http_v2_node_t *node);
 
+static void ngx_http_v2_free_pools(ngx_http_v2_connection_t *h2c);
 static void ngx_http_v2_pool_cleanup(void *data);
 
 
+ngx_uint_t  ngx_http_v2_pools_reused;
+ngx_uint_t  ngx_http_v2_pools_created;
+
+
 static ngx_http_v2_handler_pt ngx_http_v2_frame_states[] = {
     ngx_http_v2_state_data,               /* NGX_HTTP_V2_DATA_FRAME */
     ngx_http_v2_state_headers,            /* NGX_HTTP_V2_HEADERS_FRAME */
@@ -210,6 +226,9 @@ ngx_http_v2_init(ngx_event_t *rev)
     ngx_http_v2_main_conf_t   *h2mcf;
     ngx_http_v2_connection_t  *h2c;
     ngx_http_core_srv_conf_t  *cscf;
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+    ngx_http_core_loc_conf_t  *clcf;
+#endif
 
     c = rev->data;
     hc = c->data;
@@ -218,6 +237,9 @@ ngx_http_v2_init(ngx_event_t *rev)
 
     c->log->action = "processing HTTP/2 connection";
 
+    c->read->low_priority = 0;
+    c->write->low_priority = 0;
+
     h2mcf = ngx_http_get_module_main_conf(hc->conf_ctx, ngx_http_v2_module);
 
     if (h2mcf->recv_buffer == NULL) {
@@ -247,8 +269,29 @@ ngx_http_v2_init(ngx_event_t *rev)
 
     h2scf = ngx_http_get_module_srv_conf(hc->conf_ctx, ngx_http_v2_module);
 
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+
+    /* frames not yet in the socket still follow the priorities */
+
+    clcf = ngx_http_get_module_loc_conf(hc->conf_ctx, ngx_http_core_module);
+
+    if (clcf->tcp_notsent_lowat
+        && ngx_tcp_notsent_lowat(c->fd, clcf->tcp_notsent_lowat) == -1)
+    {
+        ngx_connection_error(c, ngx_socket_errno,
+                             ngx_tcp_notsent_lowat_n " failed");
+    }
+
+#endif
+
     h2c->priority_limit = ngx_max(h2scf->concurrent_streams, 100);
 
+    h2c->hpack_enc.limit = NGX_HTTP_V2_TABLE_SIZE;
+    h2c->hpack_enc.size = ngx_min(h2scf->hpack_table_size,
+                                  NGX_HTTP_V2_TABLE_SIZE);
+    h2c->hpack_enc.free = h2c->hpack_enc.size;
+    h2c->hpack_enc.allocated = h2scf->hpack_table_size / 32 + 1;
+
     h2c->pool = ngx_create_pool(h2scf->pool_size, h2c->connection->log);
     if (h2c->pool == NULL) {
         ngx_http_close_connection(c);
@@ -334,7 +377,7 @@ static void
 ngx_http_v2_read_handler(ngx_event_t *rev)
 {
     u_char                    *p, *end;
-    size_t                     available;
+    size_t                     available, size;
     ssize_t                    n;
     ngx_connection_t          *c;
     ngx_http_v2_main_conf_t   *h2mcf;
@@ -394,10 +437,21 @@ ngx_http_v2_read_handler(ngx_event_t *rev)
     available = h2mcf->recv_buffer_size - NGX_HTTP_V2_STATE_BUFFER_SIZE;
 
     do {
-        p = h2mcf->recv_buffer;
-        end = ngx_cpymem(p, h2c->state.buffer, h2c->state.buffer_used);
+        p = ngx_http_v2_read_data_buffer(h2c, &size);
+
+        if (p) {
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                           "http2 read data directly: %uz", size);
+
+            end = p;
+
+        } else {
+            p = h2mcf->recv_buffer;
+            end = ngx_cpymem(p, h2c->state.buffer, h2c->state.buffer_used);
+            size = available;
+        }
 
-        n = c->recv(c, end, available);
+        n = c->recv(c, end, size);
 
         if (n == NGX_AGAIN) {
             break;
@@ -681,6 +735,9 @@ ngx_http_v2_handle_connection(ngx_http_v2_connection_t *h2c)
     h2c->frames = 0;
     h2c->free_fake_connections = NULL;
 
+    ngx_http_v2_free_pools(h2c);
+    ngx_http_v2_table_hibernate(h2c);
+
 #if (NGX_HTTP_SSL)
     if (c->ssl) {
         ngx_ssl_free_buffer(c);
@@ -905,6 +962,10 @@ ngx_http_v2_state_head(ngx_http_v2_connection_t *h2c, u_char *pos, u_char *end)
                    "http2 frame type:%ui f:%Xd l:%uz sid:%ui",
                    type, h2c->state.flags, h2c->state.length, h2c->state.sid);
 
+    if (type == NGX_HTTP_V2_PRIORITY_UPDATE_FRAME) {
+        return ngx_http_v2_state_priority_update(h2c, pos, end);
+    }
+
     if (type >= NGX_HTTP_V2_FRAME_STATES) {
         ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
                       "client sent frame with unknown type %ui", type);
@@ -1017,6 +1078,7 @@ ngx_http_v2_state_data(ngx_http_v2_connection_t *h2c, u_char *pos, u_char *end)
     }
 
     stream->recv_window -= size;
+    stream->recv_bytes += size;
 
     if (stream->no_flow_control
         && stream->recv_window < NGX_HTTP_V2_MAX_WINDOW / 4)
@@ -1158,6 +1220,57 @@ ngx_http_v2_state_read_data(ngx_http_v2_connection_t *h2c, u_char *pos,
 }
 
 
+static u_char *
+ngx_http_v2_read_data_buffer(ngx_http_v2_connection_t *h2c, size_t *size)
+{
+    size_t                 n;
+    ngx_buf_t             *buf;
+    ngx_http_request_t    *r;
+    ngx_http_v2_stream_t  *stream;
+
+    /*
+     * The rest of a large DATA frame is read directly into the request
+     * body buffer instead of being copied there from the recv buffer.
+     * The frame is then processed by ngx_http_v2_state_read_data() as usual.
+     */
+
+    if (h2c->state.handler != ngx_http_v2_state_read_data
+        || h2c->state.buffer_used
+        || h2c->state.length < NGX_HTTP_V2_DIRECT_READ_SIZE)
+    {
+        return NULL;
+    }
+
+    stream = h2c->state.stream;
+
+    if (stream == NULL || stream->skip_data) {
+        return NULL;
+    }
+
+    r = stream->request;
+
+    if (r->request_body == NULL
+        || r->request_body->buf == NULL
+        || (r->reading_body && !r->request_body_no_buffering)
+        || (r->headers_in.content_length_n < 0 && !r->headers_in.chunked))
+    {
+        return NULL;
+    }
+
+    buf = r->request_body->buf;
+
+    n = buf->end - buf->last;
+
+    if (n < NGX_HTTP_V2_DIRECT_READ_SIZE) {
+        return NULL;
+    }
+
+    *size = ngx_min(n, h2c->state.length);
+
+    return buf->last;
+}
+
+
 static u_char *
 ngx_http_v2_state_headers(ngx_http_v2_connection_t *h2c, u_char *pos,
     u_char *end)
@@ -1719,6 +1832,7 @@ ngx_http_v2_state_process_header(ngx_http_v2_connection_t *h2c, u_char *pos,
     ngx_http_core_main_conf_t  *cmcf;
 
     static ngx_str_t cookie = ngx_string("cookie");
+    static ngx_str_t priority = ngx_string("priority");
 
     header = &h2c->state.header;
 
@@ -1850,6 +1964,13 @@ ngx_http_v2_state_process_header(ngx_http_v2_connection_t *h2c, u_char *pos,
         if (hh && hh->handler(r, h, hh->offset) != NGX_OK) {
             goto error;
         }
+
+        if (header->name.len == priority.len
+            && ngx_memcmp(header->name.data, priority.data, priority.len) == 0)
+        {
+            ngx_http_v2_parse_priority(h2c->state.stream, header->value.data,
+                                       header->value.data + header->value.len);
+        }
     }
 
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
@@ -2052,6 +2173,77 @@ ngx_http_v2_state_priority(ngx_http_v2_connection_t *h2c, u_char *pos,
 }
 
 
+static u_char *
+ngx_http_v2_state_priority_update(ngx_http_v2_connection_t *h2c, u_char *pos,
+    u_char *end)
+{
+    ngx_uint_t           sid;
+    ngx_http_v2_node_t  *node;
+
+    if (h2c->state.length < sizeof(uint32_t)) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent PRIORITY_UPDATE frame "
+                      "with incorrect length %uz", h2c->state.length);
+
+        return ngx_http_v2_connection_error(h2c, NGX_HTTP_V2_SIZE_ERROR);
+    }
+
+    if (h2c->state.sid) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent PRIORITY_UPDATE frame "
+                      "with incorrect identifier");
+
+        return ngx_http_v2_connection_error(h2c, NGX_HTTP_V2_PROTOCOL_ERROR);
+    }
+
+    if (h2c->state.length > NGX_HTTP_V2_STATE_BUFFER_SIZE) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                       "http2 PRIORITY_UPDATE frame ignored, length:%uz",
+                       h2c->state.length);
+
+        return ngx_http_v2_state_skip(h2c, pos, end);
+    }
+
+    if (--h2c->priority_limit == 0) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent too many PRIORITY_UPDATE frames");
+
+        return ngx_http_v2_connection_error(h2c, NGX_HTTP_V2_ENHANCE_YOUR_CALM);
+    }
+
+    if ((size_t) (end - pos) < h2c->state.length) {
+        return ngx_http_v2_state_save(h2c, pos, end,
+                                      ngx_http_v2_state_priority_update);
+    }
+
+    sid = ngx_http_v2_parse_sid(pos);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 PRIORITY_UPDATE frame sid:%ui \"%*s\"",
+                   sid, h2c->state.length - sizeof(uint32_t),
+                   pos + sizeof(uint32_t));
+
+    if (sid == 0) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent PRIORITY_UPDATE frame "
+                      "for incorrect stream");
+
+        return ngx_http_v2_connection_error(h2c, NGX_HTTP_V2_PROTOCOL_ERROR);
+    }
+
+    /* updates for streams not yet opened are not remembered */
+
+    node = ngx_http_v2_get_node_by_id(h2c, sid, 0);
+
+    if (node && node->stream) {
+        ngx_http_v2_parse_priority(node->stream, pos + sizeof(uint32_t),
+                                   pos + h2c->state.length);
+    }
+
+    return ngx_http_v2_state_complete(h2c, pos + h2c->state.length, end);
+}
+
+
 static u_char *
 ngx_http_v2_state_rst_stream(ngx_http_v2_connection_t *h2c, u_char *pos,
     u_char *end)
@@ -2246,6 +2438,7 @@ ngx_http_v2_state_settings_params(ngx_http_v2_connection_t *h2c, u_char *pos,
 
         case NGX_HTTP_V2_HEADER_TABLE_SIZE_SETTING:
 
+            h2c->hpack_enc.limit = value;
             h2c->table_update = 1;
             break;
 
@@ -2292,6 +2485,7 @@ ngx_http_v2_state_push_promise(ngx_http_v2_connection_t *h2c, u_char *pos,
 static u_char *
 ngx_http_v2_state_ping(ngx_http_v2_connection_t *h2c, u_char *pos, u_char *end)
 {
+    ngx_msec_t                rtt;
     ngx_buf_t                *buf;
     ngx_http_v2_out_frame_t  *frame;
 
@@ -2318,6 +2512,22 @@ ngx_http_v2_state_ping(ngx_http_v2_connection_t *h2c, u_char *pos, u_char *end)
     }
 
     if (h2c->state.flags & NGX_HTTP_V2_ACK_FLAG) {
+
+        if (h2c->ping_sent) {
+            h2c->ping_sent = 0;
+
+            rtt = ngx_current_msec - h2c->ping_time;
+
+            if (rtt == 0) {
+                rtt = 1;
+            }
+
+            h2c->rtt = h2c->rtt ? (7 * h2c->rtt + rtt) / 8 : rtt;
+
+            ngx_log_debug2(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                           "http2 PING ack rtt:%M srtt:%M", rtt, h2c->rtt);
+        }
+
         return ngx_http_v2_state_skip(h2c, pos, end);
     }
 
@@ -2718,7 +2928,7 @@ ngx_http_v2_send_settings(ngx_http_v2_connection_t *h2c)
         return NGX_ERROR;
     }
 
-    len = NGX_HTTP_V2_SETTINGS_PARAM_SIZE * 3;
+    len = NGX_HTTP_V2_SETTINGS_PARAM_SIZE * 4;
 
     buf = ngx_create_temp_buf(h2c->pool, NGX_HTTP_V2_FRAME_HEADER_SIZE + len);
     if (buf == NULL) {
@@ -2763,6 +2973,10 @@ ngx_http_v2_send_settings(ngx_http_v2_connection_t *h2c)
     buf->last = ngx_http_v2_write_uint32(buf->last,
                                          NGX_HTTP_V2_MAX_FRAME_SIZE);
 
+    buf->last = ngx_http_v2_write_uint16(buf->last,
+                                    NGX_HTTP_V2_NO_RFC7540_PRIORITIES_SETTING);
+    buf->last = ngx_http_v2_write_uint32(buf->last, 1);
+
     ngx_http_v2_queue_blocked_frame(h2c, frame);
 
     return NGX_OK;
@@ -2815,6 +3029,35 @@ ngx_http_v2_send_window_update(ngx_http_v2_connection_t *h2c, ngx_uint_t sid,
 }
 
 
+static ngx_int_t
+ngx_http_v2_send_ping(ngx_http_v2_connection_t *h2c)
+{
+    ngx_buf_t                *buf;
+    ngx_http_v2_out_frame_t  *frame;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 send PING frame");
+
+    frame = ngx_http_v2_get_frame(h2c, NGX_HTTP_V2_PING_SIZE,
+                                  NGX_HTTP_V2_PING_FRAME,
+                                  NGX_HTTP_V2_NO_FLAG, 0);
+    if (frame == NULL) {
+        return NGX_ERROR;
+    }
+
+    buf = frame->first->buf;
+
+    buf->last = ngx_cpymem(buf->last, "nginxrtt", NGX_HTTP_V2_PING_SIZE);
+
+    ngx_http_v2_queue_blocked_frame(h2c, frame);
+
+    h2c->ping_sent = 1;
+    h2c->ping_time = ngx_current_msec;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_v2_send_rst_stream(ngx_http_v2_connection_t *h2c, ngx_uint_t sid,
     ngx_uint_t status)
@@ -2972,6 +3215,7 @@ ngx_http_v2_create_stream(ngx_http_v2_connection_t *h2c)
     ngx_log_t                 *log;
     ngx_event_t               *rev, *wev;
     ngx_connection_t          *fc;
+    ngx_pool_t                *pool;
     ngx_http_log_ctx_t        *ctx;
     ngx_http_request_t        *r;
     ngx_http_v2_stream_t      *stream;
@@ -3046,7 +3290,19 @@ ngx_http_v2_create_stream(ngx_http_v2_connection_t *h2c)
     fc->sndlowat = 1;
     fc->tcp_nodelay = NGX_TCP_NODELAY_DISABLED;
 
-    r = ngx_http_create_request(fc);
+    if (h2c->nfree_pools) {
+        pool = h2c->free_pools[--h2c->nfree_pools];
+        pool->log = log;
+
+        ngx_http_v2_pools_reused++;
+
+    } else {
+        pool = NULL;
+
+        ngx_http_v2_pools_created++;
+    }
+
+    r = ngx_http_create_request_in_pool(fc, pool);
     if (r == NULL) {
         return NULL;
     }
@@ -3094,6 +3350,15 @@ ngx_http_v2_create_stream(ngx_http_v2_connection_t *h2c)
     stream->send_window = h2c->init_window;
     stream->recv_window = h2scf->preread_size;
 
+    stream->urgency = NGX_HTTP_V2_DEFAULT_URGENCY;
+
+    /*
+     * streams without priority signals share the bandwidth,
+     * RFC 9218 defaults apply once the client sends priorities
+     */
+
+    stream->incremental = 1;
+
     h2c->processing++;
 
     h2c->priority_limit += h2scf->concurrent_streams;
@@ -3643,6 +3908,96 @@ ngx_http_v2_cookie(ngx_http_request_t *r, ngx_http_v2_header_t *header)
 }
 
 
+static void
+ngx_http_v2_parse_priority(ngx_http_v2_stream_t *stream, u_char *p,
+    u_char *last)
+{
+    u_char      *key, *value;
+    size_t       key_len, value_len;
+    ngx_uint_t   urgency, incremental;
+
+    /*
+     * RFC 9218 priority field value, a structured field dictionary
+     * such as "u=1, i"; missing parameters take their default values
+     */
+
+    urgency = NGX_HTTP_V2_DEFAULT_URGENCY;
+    incremental = 0;
+
+    while (p < last) {
+
+        while (p < last && (*p == ' ' || *p == '\t' || *p == ',')) {
+            p++;
+        }
+
+        key = p;
+
+        while (p < last
+               && *p != '=' && *p != ',' && *p != ';'
+               && *p != ' ' && *p != '\t')
+        {
+            p++;
+        }
+
+        key_len = p - key;
+
+        value = NULL;
+        value_len = 0;
+
+        if (p < last && *p == '=') {
+            value = ++p;
+
+            while (p < last
+                   && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+            {
+                p++;
+            }
+
+            value_len = p - value;
+        }
+
+        /* parameters are ignored */
+
+        while (p < last && *p != ',') {
+            p++;
+        }
+
+        if (key_len != 1) {
+            continue;
+        }
+
+        switch (*key) {
+
+        case 'u':
+            if (value_len == 1 && value[0] >= '0' && value[0] <= '7') {
+                urgency = value[0] - '0';
+            }
+
+            break;
+
+        case 'i':
+            if (value == NULL) {
+                incremental = 1;
+
+            } else if (value_len == 2 && value[0] == '?'
+                       && (value[1] == '0' || value[1] == '1'))
+            {
+                incremental = value[1] - '0';
+            }
+
+            break;
+        }
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, stream->connection->connection->log, 0,
+                   "http2 stream %ui priority u:%ui i:%ui",
+                   stream->node->id, urgency, incremental);
+
+    stream->urgency = urgency;
+    stream->incremental = incremental;
+}
+
+
 static ngx_int_t
 ngx_http_v2_construct_cookie_header(ngx_http_request_t *r)
 {
@@ -3801,6 +4156,7 @@ ngx_http_v2_read_request_body(ngx_http_request_t *r)
     size_t                     size;
     ngx_buf_t                 *buf;
     ngx_int_t                  rc;
+    ngx_uint_t                 ping;
     ngx_http_v2_stream_t      *stream;
     ngx_http_v2_srv_conf_t    *h2scf;
     ngx_http_request_body_t   *rb;
@@ -3900,25 +4256,43 @@ ngx_http_v2_read_request_body(ngx_http_request_t *r)
         }
     }
 
+    h2c = stream->connection;
+    ping = 0;
+
     if (r->request_body_no_buffering || rb->filter_need_buffering) {
         size = (size_t) len - h2scf->preread_size;
 
+        if (h2scf->body_window_budget) {
+
+            /* the round trip time is needed to autotune the window */
+
+            if (!h2c->ping_sent) {
+                if (ngx_http_v2_send_ping(h2c) == NGX_ERROR) {
+                    stream->skip_data = 1;
+                    return NGX_HTTP_INTERNAL_SERVER_ERROR;
+                }
+
+                ping = 1;
+            }
+
+            stream->recv_bytes = 0;
+            stream->recv_start = ngx_current_msec;
+        }
+
     } else {
         stream->no_flow_control = 1;
         size = NGX_HTTP_V2_MAX_WINDOW - stream->recv_window;
     }
 
-    if (size) {
-        if (ngx_http_v2_send_window_update(stream->connection,
-                                           stream->node->id, size)
-            == NGX_ERROR)
+    if (size || ping) {
+        if (size
+            && ngx_http_v2_send_window_update(h2c, stream->node->id, size)
+               == NGX_ERROR)
         {
             stream->skip_data = 1;
             return NGX_HTTP_INTERNAL_SERVER_ERROR;
         }
 
-        h2c = stream->connection;
-
         if (!h2c->blocked) {
             if (ngx_http_v2_send_output_queue(h2c) == NGX_ERROR) {
                 stream->skip_data = 1;
@@ -4003,7 +4377,13 @@ ngx_http_v2_process_request_body(ngx_http_request_t *r, u_char *pos,
                 n = size;
             }
 
-            if (n > 0) {
+            if (pos == rb->buf->last) {
+
+                /* the data was read directly into the buffer */
+
+                rb->buf->last += n;
+
+            } else if (n > 0) {
                 rb->buf->last = ngx_cpymem(rb->buf->last, pos, n);
             }
 
@@ -4226,6 +4606,12 @@ ngx_http_v2_read_client_request_body_handler(ngx_http_request_t *r)
     stream = r->stream;
     h2c = stream->connection;
 
+    if (ngx_http_v2_tune_body_window(r) != NGX_OK) {
+        stream->skip_data = 1;
+        ngx_http_finalize_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
     buf = r->request_body->buf;
 
     buf->pos = buf->start;
@@ -4321,6 +4707,11 @@ ngx_http_v2_read_unbuffered_request_body(ngx_http_request_t *r)
         return NGX_AGAIN;
     }
 
+    if (ngx_http_v2_tune_body_window(r) != NGX_OK) {
+        stream->skip_data = 1;
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
     buf = r->request_body->buf;
 
     buf->pos = buf->start;
@@ -4363,6 +4754,126 @@ ngx_http_v2_read_unbuffered_request_body(ngx_http_request_t *r)
 }
 
 
+static ngx_int_t
+ngx_http_v2_tune_body_window(ngx_http_request_t *r)
+{
+    u_char                    *p;
+    size_t                     size, base, need, min, avail;
+    off_t                      bdp;
+    ngx_buf_t                 *buf;
+    ngx_msec_t                 elapsed;
+    ngx_http_v2_stream_t      *stream;
+    ngx_http_v2_srv_conf_t    *h2scf;
+    ngx_http_v2_connection_t  *h2c;
+
+    stream = r->stream;
+    h2c = stream->connection;
+
+    h2scf = ngx_http_get_module_srv_conf(r, ngx_http_v2_module);
+
+    if (h2scf->body_window_budget == 0 || h2c->rtt == 0) {
+        return NGX_OK;
+    }
+
+    buf = r->request_body->buf;
+
+    if (buf->pos != buf->last) {
+        return NGX_OK;
+    }
+
+    elapsed = ngx_current_msec - stream->recv_start;
+
+    if (elapsed < h2c->rtt) {
+        return NGX_OK;
+    }
+
+    /* the amount of body data received per round trip */
+
+    bdp = (off_t) stream->recv_bytes * h2c->rtt / elapsed;
+
+    stream->recv_bytes = 0;
+    stream->recv_start = ngx_current_msec;
+
+    size = buf->end - buf->start;
+    base = size - stream->recv_extra;
+
+    /*
+     * Much like TCP receive buffer autotuning, the window is set to twice
+     * the data received in a round trip: a window limited client can then
+     * double its rate each round trip, while a slow one lets it shrink.
+     */
+
+    if (bdp > NGX_HTTP_V2_MAX_WINDOW / 2) {
+        need = NGX_HTTP_V2_MAX_WINDOW;
+
+    } else {
+        need = ngx_max((size_t) bdp * 2, base);
+    }
+
+    if (need > size) {
+        avail = h2scf->body_window_budget > h2c->body_window
+                ? h2scf->body_window_budget - h2c->body_window : 0;
+
+        if (need - size > avail) {
+            need = size + avail;
+        }
+
+        /* do not reallocate the buffer for a small gain */
+
+        if (need < size + size / 4) {
+            return NGX_OK;
+        }
+
+    } else if (need <= size / 4) {
+
+        /*
+         * the window is halved at most, so that a temporarily slow
+         * consumer does not cause the buffer to be reallocated back and forth
+         */
+
+        need = size / 2;
+
+        /* the data the client was already allowed to send must fit */
+
+        min = ngx_max(base, stream->recv_window);
+
+        if (h2c->state.stream == stream) {
+            min += h2c->state.length;
+        }
+
+        need = ngx_max(need, min);
+
+        if (need >= size) {
+            return NGX_OK;
+        }
+
+    } else {
+        return NGX_OK;
+    }
+
+    p = ngx_palloc(r->pool, need);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_pfree(r->pool, buf->start);
+
+    buf->start = p;
+    buf->pos = p;
+    buf->last = p;
+    buf->end = p + need;
+
+    h2c->body_window = h2c->body_window - stream->recv_extra + (need - base);
+    stream->recv_extra = need - base;
+
+    ngx_log_debug4(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http2 body window:%uz bdp:%O rtt:%M budget used:%uz",
+                   need, bdp, h2c->rtt, h2c->body_window);
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_v2_terminate_stream(ngx_http_v2_connection_t *h2c,
     ngx_http_v2_stream_t *stream, ngx_uint_t status)
@@ -4457,6 +4968,7 @@ ngx_http_v2_close_stream(ngx_http_v2_stream_t *stream, ngx_int_t rc)
     pool = stream->pool;
 
     h2c->frames -= stream->frames;
+    h2c->body_window -= stream->recv_extra;
 
     ngx_http_free_request(stream->request, rc);
 
@@ -4638,6 +5150,11 @@ ngx_http_v2_idle_handler(ngx_event_t *rev)
         return;
     }
 
+    if (ngx_http_v2_table_wake(h2c) != NGX_OK) {
+        ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_INTERNAL_ERROR);
+        return;
+    }
+
     c->write->handler = ngx_http_v2_write_handler;
 
     rev->handler = ngx_http_v2_read_handler;
@@ -4906,11 +5423,68 @@ ngx_http_v2_node_children_update(ngx_http_v2_node_t *node)
 }
 
 
+void
+ngx_http_v2_release_pool(ngx_http_v2_connection_t *h2c, ngx_pool_t *pool)
+{
+    ngx_uint_t           n;
+    ngx_pool_t          *p;
+    ngx_pool_cleanup_t  *cln;
+
+    if (h2c->nfree_pools == NGX_HTTP_V2_FREE_POOLS
+        || h2c->connection->error)
+    {
+        ngx_destroy_pool(pool);
+        return;
+    }
+
+    /*
+     * pools grown by a large request are not kept,
+     * so that they do not pin memory for the connection lifetime
+     */
+
+    n = 0;
+
+    for (p = pool; p; p = p->d.next) {
+        if (++n > NGX_HTTP_V2_FREE_POOL_BLOCKS) {
+            ngx_destroy_pool(pool);
+            return;
+        }
+    }
+
+    for (cln = pool->cleanup; cln; cln = cln->next) {
+        if (cln->handler) {
+            cln->handler(cln->data);
+        }
+    }
+
+    pool->cleanup = NULL;
+
+    ngx_reset_pool(pool);
+
+    pool->log = h2c->connection->log;
+
+    h2c->free_pools[h2c->nfree_pools++] = pool;
+}
+
+
+static void
+ngx_http_v2_free_pools(ngx_http_v2_connection_t *h2c)
+{
+    while (h2c->nfree_pools) {
+        ngx_destroy_pool(h2c->free_pools[--h2c->nfree_pools]);
+    }
+}
+
+
 static void
 ngx_http_v2_pool_cleanup(void *data)
 {
     ngx_http_v2_connection_t  *h2c = data;
 
+    ngx_http_v2_table_free(h2c);
+
+    ngx_http_v2_free_pools(h2c);
+
     if (h2c->state.pool) {
         ngx_destroy_pool(h2c->state.pool);
     }
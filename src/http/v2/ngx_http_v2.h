@@ -26,6 +26,11 @@
 
 #define NGX_HTTP_V2_FRAME_HEADER_SIZE    9
 
+#define NGX_HTTP_V2_TABLE_SIZE           4096
+
+#define NGX_HTTP_V2_FREE_POOLS           8
+#define NGX_HTTP_V2_FREE_POOL_BLOCKS     4
+
 /* frame types */
 #define NGX_HTTP_V2_DATA_FRAME           0x0
 #define NGX_HTTP_V2_HEADERS_FRAME        0x1
@@ -37,6 +42,7 @@
 #define NGX_HTTP_V2_GOAWAY_FRAME         0x7
 #define NGX_HTTP_V2_WINDOW_UPDATE_FRAME  0x8
 #define NGX_HTTP_V2_CONTINUATION_FRAME   0x9
+#define NGX_HTTP_V2_PRIORITY_UPDATE_FRAME  0x10
 
 /* frame flags */
 #define NGX_HTTP_V2_NO_FLAG              0x00
@@ -50,6 +56,7 @@
 #define NGX_HTTP_V2_DEFAULT_WINDOW       65535
 
 #define NGX_HTTP_V2_DEFAULT_WEIGHT       16
+#define NGX_HTTP_V2_DEFAULT_URGENCY      3
 
 
 typedef struct ngx_http_v2_connection_s   ngx_http_v2_connection_t;
@@ -67,6 +74,8 @@ typedef struct {
     ngx_uint_t                       concurrent_streams;
     size_t                           preread_size;
     ngx_uint_t                       streams_index_mask;
+    size_t                           hpack_table_size;
+    size_t                           body_window_budget;
 } ngx_http_v2_srv_conf_t;
 
 
@@ -118,9 +127,28 @@ typedef struct {
     size_t                           free;
     u_char                          *storage;
     u_char                          *pos;
+
+    u_char                          *saved;
+    size_t                           saved_len;
+
+    unsigned                         hibernated:1;
+    unsigned                         cleanup:1;
 } ngx_http_v2_hpack_t;
 
 
+typedef struct {
+    ngx_http_v2_header_t           **entries;
+
+    ngx_uint_t                       added;
+    ngx_uint_t                       deleted;
+    ngx_uint_t                       allocated;
+
+    size_t                           size;
+    size_t                           free;
+    size_t                           limit;
+} ngx_http_v2_hpack_enc_t;
+
+
 struct ngx_http_v2_connection_s {
     ngx_connection_t                *connection;
     ngx_http_connection_t           *http_connection;
@@ -141,17 +169,26 @@ struct ngx_http_v2_connection_s {
 
     size_t                           frame_size;
 
+    /* request body window autotuning */
+    size_t                           body_window;
+    ngx_msec_t                       rtt;
+    ngx_msec_t                       ping_time;
+
     ngx_queue_t                      waiting;
 
     ngx_http_v2_state_t              state;
 
     ngx_http_v2_hpack_t              hpack;
+    ngx_http_v2_hpack_enc_t          hpack_enc;
 
     ngx_pool_t                      *pool;
 
     ngx_http_v2_out_frame_t         *free_frames;
     ngx_connection_t                *free_fake_connections;
 
+    ngx_pool_t                      *free_pools[NGX_HTTP_V2_FREE_POOLS];
+    ngx_uint_t                       nfree_pools;
+
     ngx_http_v2_node_t             **streams_index;
 
     ngx_http_v2_out_frame_t         *last_out;
@@ -168,6 +205,7 @@ struct ngx_http_v2_connection_s {
     unsigned                         table_update:1;
     unsigned                         blocked:1;
     unsigned                         goaway:1;
+    unsigned                         ping_sent:1;
 };
 
 
@@ -199,6 +237,11 @@ struct ngx_http_v2_stream_s {
     ssize_t                          send_window;
     size_t                           recv_window;
 
+    /* request body window autotuning */
+    size_t                           recv_extra;
+    size_t                           recv_bytes;
+    ngx_msec_t                       recv_start;
+
     ngx_buf_t                       *preread;
 
     ngx_uint_t                       frames;
@@ -221,6 +264,10 @@ struct ngx_http_v2_stream_s {
     unsigned                         rst_sent:1;
     unsigned                         no_flow_control:1;
     unsigned                         skip_data:1;
+
+    /* RFC 9218 priority parameters */
+    unsigned                         urgency:3;
+    unsigned                         incremental:1;
 };
 
 
@@ -239,6 +286,24 @@ struct ngx_http_v2_out_frame_s {
 };
 
 
+/*
+ * Streams are served in the order of urgency; within the same urgency
+ * non-incremental responses are sent one after another in the order of
+ * stream identifiers, while incremental ones share the bandwidth.
+ */
+
+static ngx_inline ngx_uint_t
+ngx_http_v2_stream_precedes(ngx_http_v2_stream_t *s1, ngx_http_v2_stream_t *s2)
+{
+    if (s1->urgency != s2->urgency) {
+        return s1->urgency < s2->urgency;
+    }
+
+    return s1->incremental || s2->incremental
+           || s1->node->id <= s2->node->id;
+}
+
+
 static ngx_inline void
 ngx_http_v2_queue_frame(ngx_http_v2_connection_t *h2c,
     ngx_http_v2_out_frame_t *frame)
@@ -251,11 +316,7 @@ ngx_http_v2_queue_frame(ngx_http_v2_connection_t *h2c,
             break;
         }
 
-        if ((*out)->stream->node->rank < frame->stream->node->rank
-            || ((*out)->stream->node->rank == frame->stream->node->rank
-                && (*out)->stream->node->rel_weight
-                   >= frame->stream->node->rel_weight))
-        {
+        if (ngx_http_v2_stream_precedes((*out)->stream, frame->stream)) {
             break;
         }
     }
@@ -298,6 +359,8 @@ ngx_int_t ngx_http_v2_read_request_body(ngx_http_request_t *r);
 ngx_int_t ngx_http_v2_read_unbuffered_request_body(ngx_http_request_t *r);
 
 void ngx_http_v2_close_stream(ngx_http_v2_stream_t *stream, ngx_int_t rc);
+void ngx_http_v2_release_pool(ngx_http_v2_connection_t *h2c,
+    ngx_pool_t *pool);
 
 ngx_int_t ngx_http_v2_send_output_queue(ngx_http_v2_connection_t *h2c);
 
@@ -311,6 +374,15 @@ ngx_int_t ngx_http_v2_add_header(ngx_http_v2_connection_t *h2c,
     ngx_http_v2_header_t *header);
 ngx_int_t ngx_http_v2_table_size(ngx_http_v2_connection_t *h2c, size_t size);
 
+ngx_uint_t ngx_http_v2_table_find(ngx_http_v2_connection_t *h2c,
+    ngx_str_t *name, ngx_str_t *value, ngx_uint_t *name_index);
+ngx_int_t ngx_http_v2_table_insert(ngx_http_v2_connection_t *h2c,
+    ngx_str_t *name, ngx_str_t *value);
+void ngx_http_v2_table_resize(ngx_http_v2_connection_t *h2c, size_t size);
+void ngx_http_v2_table_free(ngx_http_v2_connection_t *h2c);
+void ngx_http_v2_table_hibernate(ngx_http_v2_connection_t *h2c);
+ngx_int_t ngx_http_v2_table_wake(ngx_http_v2_connection_t *h2c);
+
 
 #define ngx_http_v2_prefix(bits)  ((1 << (bits)) - 1)
 
@@ -366,8 +438,10 @@ ngx_int_t ngx_http_v2_table_size(ngx_http_v2_connection_t *h2c, size_t size);
 #define ngx_http_v2_write_sid  ngx_http_v2_write_uint32
 
 
-#define ngx_http_v2_indexed(i)      (128 + (i))
-#define ngx_http_v2_inc_indexed(i)  (64 + (i))
+#define ngx_http_v2_indexed(i)        (128 + (i))
+#define ngx_http_v2_inc_indexed(i)    (64 + (i))
+#define ngx_http_v2_size_update(i)    (32 + (i))
+#define ngx_http_v2_never_indexed(i)  (16 + (i))
 
 #define ngx_http_v2_write_name(dst, src, len, tmp)                            \
     ngx_http_v2_string_encode(dst, src, len, tmp, 1)
@@ -414,7 +488,12 @@ ngx_int_t ngx_http_v2_table_size(ngx_http_v2_connection_t *h2c, size_t size);
 
 u_char *ngx_http_v2_string_encode(u_char *dst, u_char *src, size_t len,
     u_char *tmp, ngx_uint_t lower);
+u_char *ngx_http_v2_write_int(u_char *pos, ngx_uint_t prefix,
+    ngx_uint_t value);
+
 
+extern ngx_uint_t    ngx_http_v2_pools_reused;
+extern ngx_uint_t    ngx_http_v2_pools_created;
 
 extern ngx_module_t  ngx_http_v2_module;
 
@@ -27,6 +27,26 @@
 #define NGX_HTTP_V2_NO_TRAILERS           (ngx_http_v2_out_frame_t *) -1
 
 
+#define NGX_HTTP_V2_INDEX                 0
+#define NGX_HTTP_V2_NO_INDEX              1
+#define NGX_HTTP_V2_NEVER_INDEX           2
+
+
+typedef struct {
+    ngx_str_t                         name;
+    ngx_uint_t                        index;
+    ngx_uint_t                        policy;
+} ngx_http_v2_header_policy_t;
+
+
+static ngx_int_t ngx_http_v2_early_hints_filter(ngx_http_request_t *r,
+    ngx_list_t *headers);
+static u_char *ngx_http_v2_write_header(ngx_http_v2_connection_t *h2c,
+    u_char *pos, ngx_uint_t index, ngx_str_t *name, ngx_str_t *value,
+    ngx_uint_t policy, u_char *tmp);
+static ngx_uint_t ngx_http_v2_header_policy(ngx_str_t *name,
+    ngx_uint_t *index);
+
 static ngx_http_v2_out_frame_t *ngx_http_v2_create_headers_frame(
     ngx_http_request_t *r, u_char *pos, u_char *end, ngx_uint_t fin);
 static ngx_http_v2_out_frame_t *ngx_http_v2_create_trailers_frame(
@@ -63,6 +83,45 @@ static void ngx_http_v2_filter_cleanup(void *data);
 static ngx_int_t ngx_http_v2_filter_init(ngx_conf_t *cf);
 
 
+/*
+ * Headers whose values tend to repeat across responses are added to the
+ * dynamic table, per-response values are sent without indexing to avoid
+ * evicting useful entries, and cookies are never indexed.  Headers not
+ * listed here are indexed.
+ */
+
+static ngx_http_v2_header_policy_t  ngx_http_v2_header_policies[] = {
+    { ngx_string("accept-ranges"), 18, NGX_HTTP_V2_INDEX },
+    { ngx_string("access-control-allow-origin"), 20, NGX_HTTP_V2_INDEX },
+    { ngx_string("age"), 21, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("allow"), 22, NGX_HTTP_V2_INDEX },
+    { ngx_string("cache-control"), 24, NGX_HTTP_V2_INDEX },
+    { ngx_string("content-disposition"), 25, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("content-encoding"), 26, NGX_HTTP_V2_INDEX },
+    { ngx_string("content-language"), 27, NGX_HTTP_V2_INDEX },
+    { ngx_string("content-length"), 28, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("content-location"), 29, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("content-range"), 30, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("content-type"), 31, NGX_HTTP_V2_INDEX },
+    { ngx_string("date"), 33, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("etag"), 34, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("expires"), 36, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("last-modified"), 44, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("link"), 45, NGX_HTTP_V2_INDEX },
+    { ngx_string("location"), 46, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("proxy-authenticate"), 48, NGX_HTTP_V2_INDEX },
+    { ngx_string("refresh"), 52, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("retry-after"), 53, NGX_HTTP_V2_NO_INDEX },
+    { ngx_string("server"), 54, NGX_HTTP_V2_INDEX },
+    { ngx_string("set-cookie"), 55, NGX_HTTP_V2_NEVER_INDEX },
+    { ngx_string("strict-transport-security"), 56, NGX_HTTP_V2_INDEX },
+    { ngx_string("vary"), 59, NGX_HTTP_V2_INDEX },
+    { ngx_string("via"), 60, NGX_HTTP_V2_INDEX },
+    { ngx_string("www-authenticate"), 61, NGX_HTTP_V2_INDEX },
+    { ngx_null_string, 0, 0 }
+};
+
+
 static ngx_http_module_t  ngx_http_v2_filter_module_ctx = {
     NULL,                                  /* preconfiguration */
     ngx_http_v2_filter_init,               /* postconfiguration */
@@ -95,38 +154,29 @@ ngx_module_t  ngx_http_v2_filter_module = {
 
 
 static ngx_http_output_header_filter_pt  ngx_http_next_header_filter;
+static ngx_http_output_early_hints_filter_pt  ngx_http_next_early_hints_filter;
 
 
 static ngx_int_t
 ngx_http_v2_header_filter(ngx_http_request_t *r)
 {
-    u_char                     status, *pos, *start, *p, *tmp;
-    size_t                     len, tmp_len;
-    ngx_str_t                  host, location;
-    ngx_uint_t                 i, port, fin;
+    u_char                     status, *pos, *start, *p, *tmp, *low;
+    size_t                     len, tmp_len, size;
+    ngx_str_t                  host, location, name, value;
+    ngx_uint_t                 i, port, fin, index, policy, table_update;
     ngx_list_part_t           *part;
     ngx_table_elt_t           *header;
     ngx_connection_t          *fc;
     ngx_http_cleanup_t        *cln;
     ngx_http_v2_stream_t      *stream;
+    ngx_http_v2_srv_conf_t    *h2scf;
     ngx_http_v2_out_frame_t   *frame;
     ngx_http_v2_connection_t  *h2c;
     ngx_http_core_loc_conf_t  *clcf;
     ngx_http_core_srv_conf_t  *cscf;
     u_char                     addr[NGX_SOCKADDR_STRLEN];
-
-    static const u_char nginx[5] = "\x84\xaa\x63\x55\xe7";
-#if (NGX_HTTP_GZIP)
-    static const u_char accept_encoding[12] =
-        "\x8b\x84\x84\x2d\x69\x5b\x05\x44\x3c\x86\xaa\x6f";
-#endif
-
-    static size_t nginx_ver_len = ngx_http_v2_literal_size(NGINX_VER);
-    static u_char nginx_ver[ngx_http_v2_literal_size(NGINX_VER)];
-
-    static size_t nginx_ver_build_len =
-                                  ngx_http_v2_literal_size(NGINX_VER_BUILD);
-    static u_char nginx_ver_build[ngx_http_v2_literal_size(NGINX_VER_BUILD)];
+    u_char                     buf[ngx_max(NGX_OFF_T_LEN,
+                                   sizeof("Wed, 31 Dec 1986 18:00:00 GMT"))];
 
     stream = r->stream;
 
@@ -211,49 +261,78 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
 
     h2c = stream->connection;
 
-    len = h2c->table_update ? 1 : 0;
+    h2scf = ngx_http_get_module_srv_conf(h2c->http_connection->conf_ctx,
+                                         ngx_http_v2_module);
+
+    len = h2c->table_update ? NGX_HTTP_V2_INT_OCTETS : 0;
 
-    len += status ? 1 : 1 + ngx_http_v2_literal_size("418");
+    len += status ? 1
+                  : NGX_HTTP_V2_INT_OCTETS + ngx_http_v2_literal_size("418");
 
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     if (r->headers_out.server == NULL) {
 
         if (clcf->server_tokens == NGX_HTTP_SERVER_TOKENS_ON) {
-            len += 1 + nginx_ver_len;
+            len += NGX_HTTP_V2_INT_OCTETS + ngx_http_v2_literal_size(NGINX_VER);
 
         } else if (clcf->server_tokens == NGX_HTTP_SERVER_TOKENS_BUILD) {
-            len += 1 + nginx_ver_build_len;
+            len += NGX_HTTP_V2_INT_OCTETS
+                   + ngx_http_v2_literal_size(NGINX_VER_BUILD);
 
         } else {
-            len += 1 + sizeof(nginx);
+            len += NGX_HTTP_V2_INT_OCTETS + ngx_http_v2_literal_size("nginx");
         }
     }
 
     if (r->headers_out.date == NULL) {
-        len += 1 + ngx_http_v2_literal_size("Wed, 31 Dec 1986 18:00:00 GMT");
+        len += NGX_HTTP_V2_INT_OCTETS
+               + ngx_http_v2_literal_size("Wed, 31 Dec 1986 18:00:00 GMT");
     }
 
     if (r->headers_out.content_type.len) {
-        len += 1 + NGX_HTTP_V2_INT_OCTETS + r->headers_out.content_type.len;
 
         if (r->headers_out.content_type_len == r->headers_out.content_type.len
             && r->headers_out.charset.len)
         {
-            len += sizeof("; charset=") - 1 + r->headers_out.charset.len;
+            tmp_len = r->headers_out.content_type.len + sizeof("; charset=") - 1
+                      + r->headers_out.charset.len;
+
+            p = ngx_pnalloc(r->pool, tmp_len);
+            if (p == NULL) {
+                return NGX_ERROR;
+            }
+
+            p = ngx_cpymem(p, r->headers_out.content_type.data,
+                           r->headers_out.content_type.len);
+
+            p = ngx_cpymem(p, "; charset=", sizeof("; charset=") - 1);
+
+            p = ngx_cpymem(p, r->headers_out.charset.data,
+                           r->headers_out.charset.len);
+
+            /* updated r->headers_out.content_type is also needed for logging */
+
+            r->headers_out.content_type.len = tmp_len;
+            r->headers_out.content_type.data = p - tmp_len;
         }
+
+        len += NGX_HTTP_V2_INT_OCTETS + NGX_HTTP_V2_INT_OCTETS
+               + r->headers_out.content_type.len;
     }
 
     if (r->headers_out.content_length == NULL
         && r->headers_out.content_length_n >= 0)
     {
-        len += 1 + ngx_http_v2_integer_octets(NGX_OFF_T_LEN) + NGX_OFF_T_LEN;
+        len += NGX_HTTP_V2_INT_OCTETS
+               + ngx_http_v2_integer_octets(NGX_OFF_T_LEN) + NGX_OFF_T_LEN;
     }
 
     if (r->headers_out.last_modified == NULL
         && r->headers_out.last_modified_time != -1)
     {
-        len += 1 + ngx_http_v2_literal_size("Wed, 31 Dec 1986 18:00:00 GMT");
+        len += NGX_HTTP_V2_INT_OCTETS
+               + ngx_http_v2_literal_size("Wed, 31 Dec 1986 18:00:00 GMT");
     }
 
     if (r->headers_out.location && r->headers_out.location->value.len) {
@@ -331,7 +410,8 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
 
         r->headers_out.location->hash = 0;
 
-        len += 1 + NGX_HTTP_V2_INT_OCTETS + r->headers_out.location->value.len;
+        len += NGX_HTTP_V2_INT_OCTETS + NGX_HTTP_V2_INT_OCTETS
+               + r->headers_out.location->value.len;
     }
 
     tmp_len = len;
@@ -339,7 +419,8 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
 #if (NGX_HTTP_GZIP)
     if (r->gzip_vary) {
         if (clcf->gzip_vary) {
-            len += 1 + sizeof(accept_encoding);
+            len += NGX_HTTP_V2_INT_OCTETS
+                   + ngx_http_v2_literal_size("Accept-Encoding");
 
         } else {
             r->gzip_vary = 0;
@@ -393,18 +474,27 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
     }
 
     tmp = ngx_palloc(r->pool, tmp_len);
+    low = ngx_pnalloc(r->pool, tmp_len);
     pos = ngx_pnalloc(r->pool, len);
 
-    if (pos == NULL || tmp == NULL) {
+    if (pos == NULL || tmp == NULL || low == NULL) {
         return NGX_ERROR;
     }
 
     start = pos;
 
+    table_update = h2c->table_update;
+
     if (h2c->table_update) {
-        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, fc->log, 0,
-                       "http2 table size update: 0");
-        *pos++ = (1 << 5) | 0;
+        size = ngx_min(h2c->hpack_enc.limit, h2scf->hpack_table_size);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 table size update: %uz", size);
+
+        *pos = ngx_http_v2_size_update(0);
+        pos = ngx_http_v2_write_int(pos, ngx_http_v2_prefix(5), size);
+
+        ngx_http_v2_table_resize(h2c, size);
         h2c->table_update = 0;
     }
 
@@ -416,52 +506,35 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
         *pos++ = status;
 
     } else {
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_STATUS_INDEX);
-        *pos++ = NGX_HTTP_V2_ENCODE_RAW | 3;
-        pos = ngx_sprintf(pos, "%03ui", r->headers_out.status);
+        ngx_str_set(&name, ":status");
+
+        value.len = 3;
+        value.data = buf;
+        ngx_sprintf(buf, "%03ui", r->headers_out.status);
+
+        pos = ngx_http_v2_write_header(h2c, pos, NGX_HTTP_V2_STATUS_INDEX,
+                                       &name, &value, NGX_HTTP_V2_INDEX, tmp);
     }
 
     if (r->headers_out.server == NULL) {
 
         if (clcf->server_tokens == NGX_HTTP_SERVER_TOKENS_ON) {
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, fc->log, 0,
-                           "http2 output header: \"server: %s\"",
-                           NGINX_VER);
+            ngx_str_set(&value, NGINX_VER);
 
         } else if (clcf->server_tokens == NGX_HTTP_SERVER_TOKENS_BUILD) {
-            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, fc->log, 0,
-                           "http2 output header: \"server: %s\"",
-                           NGINX_VER_BUILD);
+            ngx_str_set(&value, NGINX_VER_BUILD);
 
         } else {
-            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, fc->log, 0,
-                           "http2 output header: \"server: nginx\"");
+            ngx_str_set(&value, "nginx");
         }
 
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_SERVER_INDEX);
-
-        if (clcf->server_tokens == NGX_HTTP_SERVER_TOKENS_ON) {
-            if (nginx_ver[0] == '\0') {
-                p = ngx_http_v2_write_value(nginx_ver, (u_char *) NGINX_VER,
-                                            sizeof(NGINX_VER) - 1, tmp);
-                nginx_ver_len = p - nginx_ver;
-            }
-
-            pos = ngx_cpymem(pos, nginx_ver, nginx_ver_len);
-
-        } else if (clcf->server_tokens == NGX_HTTP_SERVER_TOKENS_BUILD) {
-            if (nginx_ver_build[0] == '\0') {
-                p = ngx_http_v2_write_value(nginx_ver_build,
-                                            (u_char *) NGINX_VER_BUILD,
-                                            sizeof(NGINX_VER_BUILD) - 1, tmp);
-                nginx_ver_build_len = p - nginx_ver_build;
-            }
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 output header: \"server: %V\"", &value);
 
-            pos = ngx_cpymem(pos, nginx_ver_build, nginx_ver_build_len);
+        ngx_str_set(&name, "server");
 
-        } else {
-            pos = ngx_cpymem(pos, nginx, sizeof(nginx));
-        }
+        pos = ngx_http_v2_write_header(h2c, pos, NGX_HTTP_V2_SERVER_INDEX,
+                                       &name, &value, NGX_HTTP_V2_INDEX, tmp);
     }
 
     if (r->headers_out.date == NULL) {
@@ -469,45 +542,25 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
                        "http2 output header: \"date: %V\"",
                        &ngx_cached_http_time);
 
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_DATE_INDEX);
-        pos = ngx_http_v2_write_value(pos, ngx_cached_http_time.data,
-                                      ngx_cached_http_time.len, tmp);
+        ngx_str_set(&name, "date");
+        value = ngx_cached_http_time;
+
+        pos = ngx_http_v2_write_header(h2c, pos, NGX_HTTP_V2_DATE_INDEX,
+                                       &name, &value, NGX_HTTP_V2_NO_INDEX,
+                                       tmp);
     }
 
     if (r->headers_out.content_type.len) {
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_CONTENT_TYPE_INDEX);
-
-        if (r->headers_out.content_type_len == r->headers_out.content_type.len
-            && r->headers_out.charset.len)
-        {
-            len = r->headers_out.content_type.len + sizeof("; charset=") - 1
-                  + r->headers_out.charset.len;
-
-            p = ngx_pnalloc(r->pool, len);
-            if (p == NULL) {
-                return NGX_ERROR;
-            }
-
-            p = ngx_cpymem(p, r->headers_out.content_type.data,
-                           r->headers_out.content_type.len);
-
-            p = ngx_cpymem(p, "; charset=", sizeof("; charset=") - 1);
-
-            p = ngx_cpymem(p, r->headers_out.charset.data,
-                           r->headers_out.charset.len);
-
-            /* updated r->headers_out.content_type is also needed for logging */
-
-            r->headers_out.content_type.len = len;
-            r->headers_out.content_type.data = p - len;
-        }
-
         ngx_log_debug1(NGX_LOG_DEBUG_HTTP, fc->log, 0,
                        "http2 output header: \"content-type: %V\"",
                        &r->headers_out.content_type);
 
-        pos = ngx_http_v2_write_value(pos, r->headers_out.content_type.data,
-                                      r->headers_out.content_type.len, tmp);
+        ngx_str_set(&name, "content-type");
+
+        pos = ngx_http_v2_write_header(h2c, pos,
+                                       NGX_HTTP_V2_CONTENT_TYPE_INDEX,
+                                       &name, &r->headers_out.content_type,
+                                       NGX_HTTP_V2_INDEX, tmp);
     }
 
     if (r->headers_out.content_length == NULL
@@ -517,30 +570,34 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
                        "http2 output header: \"content-length: %O\"",
                        r->headers_out.content_length_n);
 
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_CONTENT_LENGTH_INDEX);
+        ngx_str_set(&name, "content-length");
+
+        value.data = buf;
+        value.len = ngx_sprintf(buf, "%O", r->headers_out.content_length_n)
+                    - buf;
 
-        p = pos;
-        pos = ngx_sprintf(pos + 1, "%O", r->headers_out.content_length_n);
-        *p = NGX_HTTP_V2_ENCODE_RAW | (u_char) (pos - p - 1);
+        pos = ngx_http_v2_write_header(h2c, pos,
+                                       NGX_HTTP_V2_CONTENT_LENGTH_INDEX,
+                                       &name, &value, NGX_HTTP_V2_NO_INDEX,
+                                       tmp);
     }
 
     if (r->headers_out.last_modified == NULL
         && r->headers_out.last_modified_time != -1)
     {
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_LAST_MODIFIED_INDEX);
+        ngx_str_set(&name, "last-modified");
 
-        ngx_http_time(pos, r->headers_out.last_modified_time);
-        len = sizeof("Wed, 31 Dec 1986 18:00:00 GMT") - 1;
+        value.data = buf;
+        value.len = ngx_http_time(buf, r->headers_out.last_modified_time)
+                    - buf;
 
-        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, fc->log, 0,
-                       "http2 output header: \"last-modified: %*s\"",
-                       len, pos);
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 output header: \"last-modified: %V\"", &value);
 
-        /*
-         * Date will always be encoded using huffman in the temporary buffer,
-         * so it's safe here to use src and dst pointing to the same address.
-         */
-        pos = ngx_http_v2_write_value(pos, pos, len, tmp);
+        pos = ngx_http_v2_write_header(h2c, pos,
+                                       NGX_HTTP_V2_LAST_MODIFIED_INDEX,
+                                       &name, &value, NGX_HTTP_V2_NO_INDEX,
+                                       tmp);
     }
 
     if (r->headers_out.location && r->headers_out.location->value.len) {
@@ -548,9 +605,11 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
                        "http2 output header: \"location: %V\"",
                        &r->headers_out.location->value);
 
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_LOCATION_INDEX);
-        pos = ngx_http_v2_write_value(pos, r->headers_out.location->value.data,
-                                      r->headers_out.location->value.len, tmp);
+        ngx_str_set(&name, "location");
+
+        pos = ngx_http_v2_write_header(h2c, pos, NGX_HTTP_V2_LOCATION_INDEX,
+                                       &name, &r->headers_out.location->value,
+                                       NGX_HTTP_V2_NO_INDEX, tmp);
     }
 
 #if (NGX_HTTP_GZIP)
@@ -558,8 +617,11 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
         ngx_log_debug0(NGX_LOG_DEBUG_HTTP, fc->log, 0,
                        "http2 output header: \"vary: Accept-Encoding\"");
 
-        *pos++ = ngx_http_v2_inc_indexed(NGX_HTTP_V2_VARY_INDEX);
-        pos = ngx_cpymem(pos, accept_encoding, sizeof(accept_encoding));
+        ngx_str_set(&name, "vary");
+        ngx_str_set(&value, "Accept-Encoding");
+
+        pos = ngx_http_v2_write_header(h2c, pos, NGX_HTTP_V2_VARY_INDEX,
+                                       &name, &value, NGX_HTTP_V2_INDEX, tmp);
     }
 #endif
 
@@ -582,23 +644,19 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
             continue;
         }
 
-#if (NGX_DEBUG)
-        if (fc->log->log_level & NGX_LOG_DEBUG_HTTP) {
-            ngx_strlow(tmp, header[i].key.data, header[i].key.len);
+        name.len = header[i].key.len;
+        name.data = low;
 
-            ngx_log_debug3(NGX_LOG_DEBUG_HTTP, fc->log, 0,
-                           "http2 output header: \"%*s: %V\"",
-                           header[i].key.len, tmp, &header[i].value);
-        }
-#endif
+        ngx_strlow(low, header[i].key.data, header[i].key.len);
 
-        *pos++ = 0;
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 output header: \"%V: %V\"",
+                       &name, &header[i].value);
 
-        pos = ngx_http_v2_write_name(pos, header[i].key.data,
-                                     header[i].key.len, tmp);
+        policy = ngx_http_v2_header_policy(&name, &index);
 
-        pos = ngx_http_v2_write_value(pos, header[i].value.data,
-                                      header[i].value.len, tmp);
+        pos = ngx_http_v2_write_header(h2c, pos, index, &name,
+                                       &header[i].value, policy, tmp);
     }
 
     fin = r->header_only
@@ -606,12 +664,25 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
 
     frame = ngx_http_v2_create_headers_frame(r, start, pos, fin);
     if (frame == NULL) {
+
+        /*
+         * the entries inserted into the table were never sent,
+         * so forget everything the client might not know about
+         */
+
+        size = h2c->hpack_enc.size;
+
+        ngx_http_v2_table_resize(h2c, 0);
+        ngx_http_v2_table_resize(h2c, size);
+
+        h2c->table_update = table_update;
+
         return NGX_ERROR;
     }
 
     ngx_http_v2_queue_blocked_frame(h2c, frame);
 
-    stream->queued = 1;
+    stream->queued++;
 
     cln = ngx_http_cleanup_add(r, 0);
     if (cln == NULL) {
@@ -629,6 +700,260 @@ ngx_http_v2_header_filter(ngx_http_request_t *r)
 }
 
 
+static ngx_int_t
+ngx_http_v2_early_hints_filter(ngx_http_request_t *r, ngx_list_t *headers)
+{
+    u_char                    *pos, *start, *tmp, *low;
+    size_t                     len, tmp_len, size;
+    ngx_int_t                  rc;
+    ngx_str_t                  name, value;
+    ngx_uint_t                 i, index, policy, table_update;
+    ngx_list_part_t           *part;
+    ngx_table_elt_t           *header;
+    ngx_connection_t          *fc;
+    ngx_http_v2_stream_t      *stream;
+    ngx_http_v2_srv_conf_t    *h2scf;
+    ngx_http_v2_out_frame_t   *frame;
+    ngx_http_v2_connection_t  *h2c;
+
+    stream = r->stream;
+
+    if (!stream) {
+        return ngx_http_next_early_hints_filter(r, headers);
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http2 early hints filter");
+
+    fc = r->connection;
+
+    if (fc->error) {
+        return NGX_ERROR;
+    }
+
+    h2c = stream->connection;
+
+    len = h2c->table_update ? NGX_HTTP_V2_INT_OCTETS : 0;
+    len += NGX_HTTP_V2_INT_OCTETS + ngx_http_v2_literal_size("103");
+
+    tmp_len = len;
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        if (header[i].key.len > NGX_HTTP_V2_MAX_FIELD
+            || header[i].value.len > NGX_HTTP_V2_MAX_FIELD)
+        {
+            ngx_log_error(NGX_LOG_ERR, fc->log, 0,
+                          "too long early hints header: \"%V\"",
+                          &header[i].key);
+            return NGX_OK;
+        }
+
+        len += 1 + NGX_HTTP_V2_INT_OCTETS + header[i].key.len
+                 + NGX_HTTP_V2_INT_OCTETS + header[i].value.len;
+
+        if (header[i].key.len > tmp_len) {
+            tmp_len = header[i].key.len;
+        }
+
+        if (header[i].value.len > tmp_len) {
+            tmp_len = header[i].value.len;
+        }
+    }
+
+    tmp = ngx_palloc(r->pool, tmp_len);
+    low = ngx_pnalloc(r->pool, tmp_len);
+    pos = ngx_pnalloc(r->pool, len);
+
+    if (pos == NULL || tmp == NULL || low == NULL) {
+        return NGX_ERROR;
+    }
+
+    start = pos;
+
+    table_update = h2c->table_update;
+
+    if (h2c->table_update) {
+        h2scf = ngx_http_get_module_srv_conf(h2c->http_connection->conf_ctx,
+                                             ngx_http_v2_module);
+
+        size = ngx_min(h2c->hpack_enc.limit, h2scf->hpack_table_size);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 table size update: %uz", size);
+
+        *pos = ngx_http_v2_size_update(0);
+        pos = ngx_http_v2_write_int(pos, ngx_http_v2_prefix(5), size);
+
+        ngx_http_v2_table_resize(h2c, size);
+        h2c->table_update = 0;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                   "http2 output header: \":status: 103\"");
+
+    ngx_str_set(&name, ":status");
+    ngx_str_set(&value, "103");
+
+    pos = ngx_http_v2_write_header(h2c, pos, NGX_HTTP_V2_STATUS_INDEX,
+                                   &name, &value, NGX_HTTP_V2_NO_INDEX, tmp);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        name.len = header[i].key.len;
+        name.data = low;
+
+        ngx_strlow(low, header[i].key.data, header[i].key.len);
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 output header: \"%V: %V\"",
+                       &name, &header[i].value);
+
+        policy = ngx_http_v2_header_policy(&name, &index);
+
+        pos = ngx_http_v2_write_header(h2c, pos, index, &name,
+                                       &header[i].value, policy, tmp);
+    }
+
+    frame = ngx_http_v2_create_headers_frame(r, start, pos, 0);
+    if (frame == NULL) {
+        size = h2c->hpack_enc.size;
+
+        ngx_http_v2_table_resize(h2c, 0);
+        ngx_http_v2_table_resize(h2c, size);
+
+        h2c->table_update = table_update;
+
+        return NGX_ERROR;
+    }
+
+    ngx_http_v2_queue_blocked_frame(h2c, frame);
+
+    stream->queued++;
+
+    rc = ngx_http_v2_filter_send(fc, stream);
+
+    if (rc == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    /* the frame stays in the queue and goes before the response header */
+
+    return NGX_OK;
+}
+
+
+static u_char *
+ngx_http_v2_write_header(ngx_http_v2_connection_t *h2c, u_char *pos,
+    ngx_uint_t index, ngx_str_t *name, ngx_str_t *value, ngx_uint_t policy,
+    u_char *tmp)
+{
+    ngx_uint_t  n, name_index;
+
+    if (h2c->hpack_enc.size
+        && (policy == NGX_HTTP_V2_INDEX || index == 0))
+    {
+        name_index = 0;
+
+        n = ngx_http_v2_table_find(h2c, name, value, &name_index);
+
+        if (n) {
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                           "http2 table index: %ui", n);
+
+            *pos = ngx_http_v2_indexed(0);
+            return ngx_http_v2_write_int(pos, ngx_http_v2_prefix(7), n);
+        }
+
+        if (index == 0) {
+            index = name_index;
+        }
+
+        /*
+         * an entry is only inserted if it leaves room for others, and
+         * a failed insertion is harmless: the value is sent as a literal
+         */
+
+        if (policy == NGX_HTTP_V2_INDEX
+            && 32 + name->len + value->len <= h2c->hpack_enc.size / 2
+            && ngx_http_v2_table_insert(h2c, name, value) == NGX_OK)
+        {
+            *pos = ngx_http_v2_inc_indexed(0);
+            pos = ngx_http_v2_write_int(pos, ngx_http_v2_prefix(6), index);
+
+            goto literal;
+        }
+    }
+
+    *pos = (policy == NGX_HTTP_V2_NEVER_INDEX) ? ngx_http_v2_never_indexed(0)
+                                               : 0;
+    pos = ngx_http_v2_write_int(pos, ngx_http_v2_prefix(4), index);
+
+literal:
+
+    if (index == 0) {
+        pos = ngx_http_v2_write_name(pos, name->data, name->len, tmp);
+    }
+
+    return ngx_http_v2_write_value(pos, value->data, value->len, tmp);
+}
+
+
+static ngx_uint_t
+ngx_http_v2_header_policy(ngx_str_t *name, ngx_uint_t *index)
+{
+    ngx_http_v2_header_policy_t  *hp;
+
+    for (hp = ngx_http_v2_header_policies; hp->name.len; hp++) {
+
+        if (hp->name.len == name->len
+            && ngx_memcmp(hp->name.data, name->data, name->len) == 0)
+        {
+            *index = hp->index;
+            return hp->policy;
+        }
+    }
+
+    *index = 0;
+
+    return NGX_HTTP_V2_INDEX;
+}
+
+
 static ngx_http_v2_out_frame_t *
 ngx_http_v2_create_headers_frame(ngx_http_request_t *r, u_char *pos,
     u_char *end, ngx_uint_t fin)
@@ -1235,10 +1560,7 @@ ngx_http_v2_waiting_queue(ngx_http_v2_connection_t *h2c,
     {
         s = ngx_queue_data(q, ngx_http_v2_stream_t, queue);
 
-        if (s->node->rank < stream->node->rank
-            || (s->node->rank == stream->node->rank
-                && s->node->rel_weight >= stream->node->rel_weight))
-        {
+        if (ngx_http_v2_stream_precedes(s, stream)) {
             break;
         }
     }
@@ -1566,5 +1888,8 @@ ngx_http_v2_filter_init(ngx_conf_t *cf)
     ngx_http_next_header_filter = ngx_http_top_header_filter;
     ngx_http_top_header_filter = ngx_http_v2_header_filter;
 
+    ngx_http_next_early_hints_filter = ngx_http_top_early_hints_filter;
+    ngx_http_top_early_hints_filter = ngx_http_v2_early_hints_filter;
+
     return NGX_OK;
 }
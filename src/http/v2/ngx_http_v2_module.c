@@ -17,6 +17,7 @@ static ngx_int_t ngx_http_v2_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 
 static ngx_int_t ngx_http_v2_module_init(ngx_cycle_t *cycle);
+static void ngx_http_v2_exit_process(ngx_cycle_t *cycle);
 
 static void *ngx_http_v2_create_main_conf(ngx_conf_t *cf);
 static char *ngx_http_v2_init_main_conf(ngx_conf_t *cf, void *conf);
@@ -143,6 +144,20 @@ static ngx_command_t  ngx_http_v2_commands[] = {
       offsetof(ngx_http_v2_srv_conf_t, streams_index_mask),
       &ngx_http_v2_streams_index_mask_post },
 
+    { ngx_string("http2_hpack_table_size"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v2_srv_conf_t, hpack_table_size),
+      NULL },
+
+    { ngx_string("http2_body_window_budget"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v2_srv_conf_t, body_window_budget),
+      NULL },
+
     { ngx_string("http2_recv_timeout"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
       ngx_http_v2_obsolete,
@@ -207,7 +222,7 @@ ngx_module_t  ngx_http_v2_module = {
     NULL,                                  /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
-    NULL,                                  /* exit process */
+    ngx_http_v2_exit_process,              /* exit process */
     NULL,                                  /* exit master */
     NGX_MODULE_V1_PADDING
 };
@@ -282,6 +297,17 @@ ngx_http_v2_module_init(ngx_cycle_t *cycle)
 }
 
 
+static void
+ngx_http_v2_exit_process(ngx_cycle_t *cycle)
+{
+    if (ngx_http_v2_pools_reused || ngx_http_v2_pools_created) {
+        ngx_log_error(NGX_LOG_INFO, cycle->log, 0,
+                      "http2 request pools: %ui reused, %ui created",
+                      ngx_http_v2_pools_reused, ngx_http_v2_pools_created);
+    }
+}
+
+
 static void *
 ngx_http_v2_create_main_conf(ngx_conf_t *cf)
 {
@@ -329,6 +355,10 @@ ngx_http_v2_create_srv_conf(ngx_conf_t *cf)
 
     h2scf->streams_index_mask = NGX_CONF_UNSET_UINT;
 
+    h2scf->hpack_table_size = NGX_CONF_UNSET_SIZE;
+
+    h2scf->body_window_budget = NGX_CONF_UNSET_SIZE;
+
     return h2scf;
 }
 
@@ -351,6 +381,12 @@ ngx_http_v2_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_uint_value(conf->streams_index_mask,
                               prev->streams_index_mask, 32 - 1);
 
+    ngx_conf_merge_size_value(conf->hpack_table_size, prev->hpack_table_size,
+                              NGX_HTTP_V2_TABLE_SIZE);
+
+    ngx_conf_merge_size_value(conf->body_window_budget,
+                              prev->body_window_budget, 0);
+
     return NGX_CONF_OK;
 }
 
@@ -10,11 +10,10 @@
 #include <ngx_http.h>
 
 
-#define NGX_HTTP_V2_TABLE_SIZE  4096
-
-
 static ngx_int_t ngx_http_v2_table_account(ngx_http_v2_connection_t *h2c,
     size_t size);
+static void ngx_http_v2_table_evict(ngx_http_v2_connection_t *h2c);
+static void ngx_http_v2_table_cleanup(void *data);
 
 
 static ngx_http_v2_header_t  ngx_http_v2_static_table[] = {
@@ -361,3 +360,294 @@ ngx_http_v2_table_size(ngx_http_v2_connection_t *h2c, size_t size)
 
     return NGX_OK;
 }
+
+
+/*
+ * The encoder side dynamic table mirrors the client's decoding table:
+ * entries are only added while a HEADERS frame is being built, and the
+ * frames are sent in the same order, so the indices stay synchronized.
+ */
+
+ngx_uint_t
+ngx_http_v2_table_find(ngx_http_v2_connection_t *h2c, ngx_str_t *name,
+    ngx_str_t *value, ngx_uint_t *name_index)
+{
+    ngx_uint_t                i, index;
+    ngx_http_v2_header_t     *entry;
+    ngx_http_v2_hpack_enc_t  *hpack;
+
+    hpack = &h2c->hpack_enc;
+
+    for (i = hpack->added; i != hpack->deleted; i--) {
+        entry = hpack->entries[(i - 1) % hpack->allocated];
+
+        if (entry->name.len != name->len
+            || ngx_memcmp(entry->name.data, name->data, name->len) != 0)
+        {
+            continue;
+        }
+
+        index = NGX_HTTP_V2_STATIC_TABLE_ENTRIES + hpack->added - i + 1;
+
+        if (entry->value.len == value->len
+            && ngx_memcmp(entry->value.data, value->data, value->len) == 0)
+        {
+            return index;
+        }
+
+        if (*name_index == 0) {
+            *name_index = index;
+        }
+    }
+
+    return 0;
+}
+
+
+ngx_int_t
+ngx_http_v2_table_insert(ngx_http_v2_connection_t *h2c, ngx_str_t *name,
+    ngx_str_t *value)
+{
+    size_t                    size;
+    ngx_http_v2_header_t     *entry;
+    ngx_http_v2_hpack_enc_t  *hpack;
+
+    hpack = &h2c->hpack_enc;
+
+    size = 32 + name->len + value->len;
+
+    if (size > hpack->size) {
+        return NGX_DECLINED;
+    }
+
+    if (hpack->entries == NULL) {
+        hpack->entries = ngx_palloc(h2c->connection->pool,
+                                    sizeof(ngx_http_v2_header_t *)
+                                    * hpack->allocated);
+        if (hpack->entries == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    entry = ngx_alloc(sizeof(ngx_http_v2_header_t) + name->len + value->len,
+                      h2c->connection->log);
+    if (entry == NULL) {
+        return NGX_ERROR;
+    }
+
+    entry->name.len = name->len;
+    entry->name.data = (u_char *) entry + sizeof(ngx_http_v2_header_t);
+    ngx_memcpy(entry->name.data, name->data, name->len);
+
+    entry->value.len = value->len;
+    entry->value.data = entry->name.data + name->len;
+    ngx_memcpy(entry->value.data, value->data, value->len);
+
+    while (size > hpack->free) {
+        ngx_http_v2_table_evict(h2c);
+    }
+
+    hpack->free -= size;
+    hpack->entries[hpack->added++ % hpack->allocated] = entry;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 table insert: \"%V: %V\" free:%uz",
+                   name, value, hpack->free);
+
+    return NGX_OK;
+}
+
+
+void
+ngx_http_v2_table_resize(ngx_http_v2_connection_t *h2c, size_t size)
+{
+    ngx_http_v2_hpack_enc_t  *hpack;
+
+    hpack = &h2c->hpack_enc;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 encoder table size: %uz was:%uz",
+                   size, hpack->size);
+
+    while (hpack->size - hpack->free > size) {
+        ngx_http_v2_table_evict(h2c);
+    }
+
+    hpack->free = size - (hpack->size - hpack->free);
+    hpack->size = size;
+}
+
+
+void
+ngx_http_v2_table_free(ngx_http_v2_connection_t *h2c)
+{
+    ngx_http_v2_hpack_enc_t  *hpack;
+
+    hpack = &h2c->hpack_enc;
+
+    while (hpack->deleted != hpack->added) {
+        ngx_http_v2_table_evict(h2c);
+    }
+}
+
+
+static void
+ngx_http_v2_table_evict(ngx_http_v2_connection_t *h2c)
+{
+    ngx_http_v2_header_t     *entry;
+    ngx_http_v2_hpack_enc_t  *hpack;
+
+    hpack = &h2c->hpack_enc;
+
+    entry = hpack->entries[hpack->deleted++ % hpack->allocated];
+    hpack->free += 32 + entry->name.len + entry->value.len;
+
+    ngx_free(entry);
+}
+
+
+/*
+ * While a connection is idle, the decoding table is kept in a buffer of
+ * the size of the live entries instead of the whole ring, and it is put
+ * back into a new ring at the same offsets on the next read event.
+ */
+
+void
+ngx_http_v2_table_hibernate(ngx_http_v2_connection_t *h2c)
+{
+    u_char                *start;
+    size_t                 len, rest;
+    ngx_pool_cleanup_t    *cln;
+    ngx_http_v2_hpack_t   *hpack;
+    ngx_http_v2_header_t  *entry;
+
+    hpack = &h2c->hpack;
+
+    if (hpack->storage == NULL || hpack->hibernated) {
+        return;
+    }
+
+    if (!hpack->cleanup) {
+        cln = ngx_pool_cleanup_add(h2c->connection->pool, 0);
+        if (cln == NULL) {
+            return;
+        }
+
+        cln->handler = ngx_http_v2_table_cleanup;
+        cln->data = hpack;
+
+        hpack->cleanup = 1;
+    }
+
+    if (hpack->added == hpack->deleted) {
+        len = 0;
+        start = hpack->pos;
+
+    } else {
+        entry = hpack->entries[hpack->deleted % hpack->allocated];
+        start = entry->name.data;
+
+        len = (hpack->pos >= start)
+              ? (size_t) (hpack->pos - start)
+              : NGX_HTTP_V2_TABLE_SIZE - (size_t) (start - hpack->pos);
+    }
+
+    hpack->saved = NULL;
+    hpack->saved_len = len;
+
+    if (len) {
+        hpack->saved = ngx_alloc(len, h2c->connection->log);
+        if (hpack->saved == NULL) {
+            return;
+        }
+
+        rest = hpack->storage + NGX_HTTP_V2_TABLE_SIZE - start;
+
+        if (rest >= len) {
+            ngx_memcpy(hpack->saved, start, len);
+
+        } else {
+            ngx_memcpy(hpack->saved, start, rest);
+            ngx_memcpy(hpack->saved + rest, hpack->storage, len - rest);
+        }
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 table hibernate: %uz", len);
+
+    (void) ngx_pfree(h2c->connection->pool, hpack->storage);
+
+    hpack->hibernated = 1;
+}
+
+
+ngx_int_t
+ngx_http_v2_table_wake(ngx_http_v2_connection_t *h2c)
+{
+    u_char                *storage, *start;
+    size_t                 len, rest;
+    ngx_uint_t             i;
+    ngx_http_v2_hpack_t   *hpack;
+    ngx_http_v2_header_t  *entry;
+
+    hpack = &h2c->hpack;
+
+    if (!hpack->hibernated) {
+        return NGX_OK;
+    }
+
+    storage = ngx_palloc(h2c->connection->pool, NGX_HTTP_V2_TABLE_SIZE);
+    if (storage == NULL) {
+        return NGX_ERROR;
+    }
+
+    /* the live entries end at the current position */
+
+    len = hpack->saved_len;
+
+    hpack->pos = storage + (hpack->pos - hpack->storage);
+
+    rest = hpack->pos - storage;
+
+    if (rest >= len) {
+        start = hpack->pos - len;
+        ngx_memcpy(start, hpack->saved, len);
+
+    } else {
+        start = storage + NGX_HTTP_V2_TABLE_SIZE - (len - rest);
+        ngx_memcpy(start, hpack->saved, len - rest);
+        ngx_memcpy(storage, hpack->saved + len - rest, rest);
+    }
+
+    for (i = hpack->deleted; i != hpack->added; i++) {
+        entry = hpack->entries[i % hpack->allocated];
+
+        entry->name.data = storage + (entry->name.data - hpack->storage);
+        entry->value.data = storage + (entry->value.data - hpack->storage);
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 table wake: %uz", len);
+
+    if (hpack->saved) {
+        ngx_free(hpack->saved);
+        hpack->saved = NULL;
+    }
+
+    hpack->storage = storage;
+    hpack->hibernated = 0;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_v2_table_cleanup(void *data)
+{
+    ngx_http_v2_hpack_t  *hpack = data;
+
+    if (hpack->saved) {
+        ngx_free(hpack->saved);
+        hpack->saved = NULL;
+    }
+}
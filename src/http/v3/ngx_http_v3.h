@@ -107,6 +107,7 @@ typedef struct {
     ngx_flag_t                    enable_hq;
     size_t                        max_table_capacity;
     ngx_uint_t                    max_blocked_streams;
+    size_t                        encoder_table_capacity;
     ngx_uint_t                    max_concurrent_streams;
     ngx_quic_conf_t               quic;
 } ngx_http_v3_srv_conf_t;
@@ -124,6 +125,7 @@ struct ngx_http_v3_session_s {
     ngx_http_connection_t        *http_connection;
 
     ngx_http_v3_dynamic_table_t   table;
+    ngx_http_v3_encoder_table_t   encoder;
 
     ngx_event_t                   keepalive;
     ngx_uint_t                    nrequests;
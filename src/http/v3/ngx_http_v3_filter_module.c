@@ -20,6 +20,7 @@
 #define NGX_HTTP_V3_HEADER_METHOD_GET                17
 #define NGX_HTTP_V3_HEADER_SCHEME_HTTP               22
 #define NGX_HTTP_V3_HEADER_SCHEME_HTTPS              23
+#define NGX_HTTP_V3_HEADER_STATUS_103                24
 #define NGX_HTTP_V3_HEADER_STATUS_200                25
 #define NGX_HTTP_V3_HEADER_ACCEPT_ENCODING           31
 #define NGX_HTTP_V3_HEADER_CONTENT_TYPE_TEXT_PLAIN   53
@@ -36,6 +37,11 @@ typedef struct {
 
 
 static ngx_int_t ngx_http_v3_header_filter(ngx_http_request_t *r);
+static ngx_int_t ngx_http_v3_early_hints_filter(ngx_http_request_t *r,
+    ngx_list_t *headers);
+static u_char *ngx_http_v3_encode_field(ngx_connection_t *c,
+    ngx_http_v3_section_t *s, u_char *p, ngx_int_t static_index,
+    ngx_str_t *name, ngx_str_t *value);
 static ngx_int_t ngx_http_v3_body_filter(ngx_http_request_t *r,
     ngx_chain_t *in);
 static ngx_chain_t *ngx_http_v3_create_trailers(ngx_http_request_t *r,
@@ -76,6 +82,7 @@ ngx_module_t  ngx_http_v3_filter_module = {
 
 static ngx_http_output_header_filter_pt  ngx_http_next_header_filter;
 static ngx_http_output_body_filter_pt    ngx_http_next_body_filter;
+static ngx_http_output_early_hints_filter_pt  ngx_http_next_early_hints_filter;
 
 
 static ngx_int_t
@@ -84,12 +91,13 @@ ngx_http_v3_header_filter(ngx_http_request_t *r)
     u_char                    *p;
     size_t                     len, n;
     ngx_buf_t                 *b;
-    ngx_str_t                  host, location;
-    ngx_uint_t                 i, port;
+    ngx_str_t                  host, location, name, value;
+    ngx_uint_t                 i, port, insert_count, sign, delta_base;
     ngx_chain_t               *out, *hl, *cl, **ll;
     ngx_list_part_t           *part;
     ngx_table_elt_t           *header;
     ngx_connection_t          *c;
+    ngx_http_v3_section_t      section;
     ngx_http_v3_session_t     *h3c;
     ngx_http_v3_filter_ctx_t  *ctx;
     ngx_http_core_loc_conf_t  *clcf;
@@ -144,7 +152,9 @@ ngx_http_v3_header_filter(ngx_http_request_t *r)
     out = NULL;
     ll = &out;
 
-    len = ngx_http_v3_encode_field_section_prefix(NULL, 0, 0, 0);
+    /* the prefix is written after the fields, see below */
+
+    len = NGX_HTTP_V3_PREFIX_INT_LEN * 2;
 
     if (r->headers_out.status == NGX_HTTP_OK) {
         len += ngx_http_v3_encode_field_ri(NULL, 0,
@@ -321,8 +331,10 @@ ngx_http_v3_header_filter(ngx_http_request_t *r)
         return NGX_ERROR;
     }
 
-    b->last = (u_char *) ngx_http_v3_encode_field_section_prefix(b->last,
-                                                                 0, 0, 0);
+    ngx_http_v3_init_section(c, &section);
+
+    b->pos += NGX_HTTP_V3_PREFIX_INT_LEN * 2;
+    b->last = b->pos;
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 output header: \":status: %03ui\"",
@@ -356,9 +368,16 @@ ngx_http_v3_header_filter(ngx_http_request_t *r)
         ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
                        "http3 output header: \"server: %*s\"", n, p);
 
-        b->last = (u_char *) ngx_http_v3_encode_field_lri(b->last, 0,
-                                                     NGX_HTTP_V3_HEADER_SERVER,
-                                                     p, n);
+        ngx_str_set(&name, "server");
+        value.len = n;
+        value.data = p;
+
+        b->last = ngx_http_v3_encode_field(c, &section, b->last,
+                                           NGX_HTTP_V3_HEADER_SERVER,
+                                           &name, &value);
+        if (b->last == NULL) {
+            return NGX_ERROR;
+        }
     }
 
     if (r->headers_out.date == NULL) {
@@ -402,10 +421,14 @@ ngx_http_v3_header_filter(ngx_http_request_t *r)
                        "http3 output header: \"content-type: %V\"",
                        &r->headers_out.content_type);
 
-        b->last = (u_char *) ngx_http_v3_encode_field_lri(b->last, 0,
+        ngx_str_set(&name, "content-type");
+
+        b->last = ngx_http_v3_encode_field(c, &section, b->last,
                                     NGX_HTTP_V3_HEADER_CONTENT_TYPE_TEXT_PLAIN,
-                                    r->headers_out.content_type.data,
-                                    r->headers_out.content_type.len);
+                                    &name, &r->headers_out.content_type);
+        if (b->last == NULL) {
+            return NGX_ERROR;
+        }
     }
 
     if (r->headers_out.content_length == NULL
@@ -496,11 +519,53 @@ ngx_http_v3_header_filter(ngx_http_request_t *r)
                        "http3 output header: \"%V: %V\"",
                        &header[i].key, &header[i].value);
 
-        b->last = (u_char *) ngx_http_v3_encode_field_l(b->last,
-                                                        &header[i].key,
-                                                        &header[i].value);
+        /* QPACK 7.1.3. Never-Indexed Literals */
+
+        if (header[i].key.len == sizeof("Set-Cookie") - 1
+            && ngx_strncasecmp(header[i].key.data, (u_char *) "Set-Cookie",
+                               sizeof("Set-Cookie") - 1)
+               == 0)
+        {
+            b->last = (u_char *) ngx_http_v3_encode_field_l(b->last,
+                                                            &header[i].key,
+                                                            &header[i].value);
+            continue;
+        }
+
+        b->last = ngx_http_v3_encode_field(c, &section, b->last, -1,
+                                           &header[i].key, &header[i].value);
+        if (b->last == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (ngx_http_v3_commit_section(c, &section) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    /* QPACK 4.5.1. Encoded Field Section Prefix */
+
+    insert_count = ngx_http_v3_encode_insert_count(c, section.insert_count);
+
+    if (section.insert_count == 0) {
+        sign = 0;
+        delta_base = 0;
+
+    } else if (section.base >= section.insert_count) {
+        sign = 0;
+        delta_base = section.base - section.insert_count;
+
+    } else {
+        sign = 1;
+        delta_base = section.insert_count - section.base - 1;
     }
 
+    b->pos -= ngx_http_v3_encode_field_section_prefix(NULL, insert_count,
+                                                      sign, delta_base);
+
+    (void) ngx_http_v3_encode_field_section_prefix(b->pos, insert_count,
+                                                   sign, delta_base);
+
     if (r->header_only) {
         b->last_buf = 1;
     }
@@ -588,6 +653,171 @@ ngx_http_v3_header_filter(ngx_http_request_t *r)
 }
 
 
+static ngx_int_t
+ngx_http_v3_early_hints_filter(ngx_http_request_t *r, ngx_list_t *headers)
+{
+    u_char                 *p;
+    size_t                  len, n;
+    ngx_buf_t              *b;
+    ngx_uint_t              i;
+    ngx_chain_t             out;
+    ngx_list_part_t        *part;
+    ngx_table_elt_t        *header;
+    ngx_connection_t       *c;
+    ngx_http_v3_session_t  *h3c;
+
+    if (r->http_version != NGX_HTTP_VERSION_30) {
+        return ngx_http_next_early_hints_filter(r, headers);
+    }
+
+    c = r->connection;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http3 early hints filter");
+
+    h3c = ngx_http_v3_get_session(c);
+
+    /*
+     * the dynamic table is not used: the field section is short,
+     * and the response header follows right away
+     */
+
+    len = ngx_http_v3_encode_field_section_prefix(NULL, 0, 0, 0);
+
+    len += ngx_http_v3_encode_field_ri(NULL, 0,
+                                       NGX_HTTP_V3_HEADER_STATUS_103);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        len += ngx_http_v3_encode_field_l(NULL, &header[i].key,
+                                          &header[i].value);
+    }
+
+    /*
+     * huffman encoding may make the section shorter than estimated,
+     * so room for the frame header is reserved for the estimated length
+     */
+
+    n = ngx_http_v3_encode_varlen_int(NULL, NGX_HTTP_V3_FRAME_HEADERS)
+        + ngx_http_v3_encode_varlen_int(NULL, len);
+
+    b = ngx_create_temp_buf(r->pool, n + len);
+    if (b == NULL) {
+        return NGX_ERROR;
+    }
+
+    b->pos += n;
+    b->last = b->pos;
+
+    b->last = (u_char *) ngx_http_v3_encode_field_section_prefix(b->last,
+                                                                 0, 0, 0);
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 output header: \":status: 103\"");
+
+    b->last = (u_char *) ngx_http_v3_encode_field_ri(b->last, 0,
+                                                NGX_HTTP_V3_HEADER_STATUS_103);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                       "http3 output header: \"%V: %V\"",
+                       &header[i].key, &header[i].value);
+
+        b->last = (u_char *) ngx_http_v3_encode_field_l(b->last,
+                                                        &header[i].key,
+                                                        &header[i].value);
+    }
+
+    n = b->last - b->pos;
+
+    h3c->payload_bytes += n;
+
+    b->pos -= ngx_http_v3_encode_varlen_int(NULL, NGX_HTTP_V3_FRAME_HEADERS)
+              + ngx_http_v3_encode_varlen_int(NULL, n);
+
+    p = (u_char *) ngx_http_v3_encode_varlen_int(b->pos,
+                                                 NGX_HTTP_V3_FRAME_HEADERS);
+    (void) ngx_http_v3_encode_varlen_int(p, n);
+
+    h3c->total_bytes += b->last - b->pos;
+
+    /* the interim response is not delayed until the response header */
+
+    b->flush = 1;
+
+    out.buf = b;
+    out.next = NULL;
+
+    return ngx_http_write_filter(r, &out);
+}
+
+
+static u_char *
+ngx_http_v3_encode_field(ngx_connection_t *c, ngx_http_v3_section_t *s,
+    u_char *p, ngx_int_t static_index, ngx_str_t *name, ngx_str_t *value)
+{
+    ngx_int_t   rc;
+    ngx_uint_t  index;
+
+    rc = ngx_http_v3_index_field(c, s, static_index, name, value, &index);
+
+    if (rc == NGX_ERROR) {
+        return NULL;
+    }
+
+    if (rc == NGX_OK) {
+        if (index < s->base) {
+            return (u_char *) ngx_http_v3_encode_field_ri(p, 1,
+                                                       s->base - 1 - index);
+        }
+
+        return (u_char *) ngx_http_v3_encode_field_pbi(p, index - s->base);
+    }
+
+    if (static_index >= 0) {
+        return (u_char *) ngx_http_v3_encode_field_lri(p, 0, static_index,
+                                                       value->data,
+                                                       value->len);
+    }
+
+    return (u_char *) ngx_http_v3_encode_field_l(p, name, value);
+}
+
+
 static ngx_int_t
 ngx_http_v3_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
@@ -845,6 +1075,9 @@ ngx_http_v3_filter_init(ngx_conf_t *cf)
     ngx_http_next_header_filter = ngx_http_top_header_filter;
     ngx_http_top_header_filter = ngx_http_v3_header_filter;
 
+    ngx_http_next_early_hints_filter = ngx_http_top_early_hints_filter;
+    ngx_http_top_early_hints_filter = ngx_http_v3_early_hints_filter;
+
     ngx_http_next_body_filter = ngx_http_top_body_filter;
     ngx_http_top_body_filter = ngx_http_v3_body_filter;
 
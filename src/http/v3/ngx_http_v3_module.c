@@ -12,6 +12,10 @@
 
 static ngx_int_t ngx_http_v3_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_v3_variable_quic(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_http_v3_variable_quic_memory(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_v3_add_variables(ngx_conf_t *cf);
 static void *ngx_http_v3_create_srv_conf(ngx_conf_t *cf);
 static char *ngx_http_v3_merge_srv_conf(ngx_conf_t *cf, void *parent,
@@ -20,6 +24,19 @@ static char *ngx_http_quic_host_key(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 
 
+static ngx_conf_enum_t  ngx_http_quic_congestion_control[] = {
+    { ngx_string("reno"), NGX_QUIC_CC_RENO },
+    { ngx_string("cubic"), NGX_QUIC_CC_CUBIC },
+    { ngx_string("bbr"), NGX_QUIC_CC_BBR },
+    { ngx_null_string, 0 }
+};
+
+
+static ngx_conf_num_bounds_t  ngx_http_quic_ack_frequency_bounds = {
+    ngx_conf_check_num_bounds, 1, 256
+};
+
+
 static ngx_command_t  ngx_http_v3_commands[] = {
 
     { ngx_string("http3"),
@@ -43,6 +60,13 @@ static ngx_command_t  ngx_http_v3_commands[] = {
       offsetof(ngx_http_v3_srv_conf_t, max_concurrent_streams),
       NULL },
 
+    { ngx_string("http3_encoder_table_capacity"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, encoder_table_capacity),
+      NULL },
+
     { ngx_string("http3_stream_buffer_size"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_size_slot,
@@ -50,6 +74,20 @@ static ngx_command_t  ngx_http_v3_commands[] = {
       offsetof(ngx_http_v3_srv_conf_t, quic.stream_buffer_size),
       NULL },
 
+    { ngx_string("quic_memory_limit"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, quic.memory_limit),
+      NULL },
+
+    { ngx_string("quic_worker_memory_limit"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, quic.worker_memory_limit),
+      NULL },
+
     { ngx_string("quic_retry"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_FLAG,
       ngx_conf_set_flag_slot,
@@ -64,6 +102,27 @@ static ngx_command_t  ngx_http_v3_commands[] = {
       offsetof(ngx_http_v3_srv_conf_t, quic.gso_enabled),
       NULL },
 
+    { ngx_string("quic_batch"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, quic.batch),
+      NULL },
+
+    { ngx_string("quic_pacing"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, quic.pacing),
+      NULL },
+
+    { ngx_string("quic_ecn"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, quic.ecn),
+      NULL },
+
     { ngx_string("quic_host_key"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
       ngx_http_quic_host_key,
@@ -78,6 +137,20 @@ static ngx_command_t  ngx_http_v3_commands[] = {
       offsetof(ngx_http_v3_srv_conf_t, quic.active_connection_id_limit),
       NULL },
 
+    { ngx_string("quic_congestion_control"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_enum_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, quic.congestion_control),
+      &ngx_http_quic_congestion_control },
+
+    { ngx_string("quic_ack_frequency"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v3_srv_conf_t, quic.ack_frequency),
+      &ngx_http_quic_ack_frequency_bounds },
+
       ngx_null_command
 };
 
@@ -117,6 +190,39 @@ static ngx_http_variable_t  ngx_http_v3_vars[] = {
 
     { ngx_string("http3"), NULL, ngx_http_v3_variable, 0, 0, 0 },
 
+    { ngx_string("quic_rtt"), NULL, ngx_http_v3_variable_quic,
+      0, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_rttvar"), NULL, ngx_http_v3_variable_quic,
+      1, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_min_rtt"), NULL, ngx_http_v3_variable_quic,
+      2, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_cwnd"), NULL, ngx_http_v3_variable_quic,
+      3, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_bytes_in_flight"), NULL, ngx_http_v3_variable_quic,
+      4, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_memory"), NULL, ngx_http_v3_variable_quic_memory,
+      0, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_frames"), NULL, ngx_http_v3_variable_quic_memory,
+      1, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_buffers"), NULL, ngx_http_v3_variable_quic_memory,
+      2, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_worker_memory"), NULL,
+      ngx_http_v3_variable_quic_memory, 3, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_worker_frames"), NULL,
+      ngx_http_v3_variable_quic_memory, 4, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("quic_worker_buffers"), NULL,
+      ngx_http_v3_variable_quic_memory, 5, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
       ngx_http_null_variable
 };
 
@@ -157,6 +263,125 @@ ngx_http_v3_variable(ngx_http_request_t *r,
 }
 
 
+static ngx_int_t
+ngx_http_v3_variable_quic(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    uint64_t                    value;
+    ngx_quic_congestion_info_t  ci;
+
+    if (r->connection->quic == NULL) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    ngx_quic_congestion_info(r->connection, &ci);
+
+    switch (data) {
+    case 0:
+        value = ci.rtt;
+        break;
+
+    case 1:
+        value = ci.rttvar;
+        break;
+
+    case 2:
+        if (ci.min_rtt == NGX_TIMER_INFINITE) {
+            v->not_found = 1;
+            return NGX_OK;
+        }
+
+        value = ci.min_rtt;
+        break;
+
+    case 3:
+        value = ci.window;
+        break;
+
+    case 4:
+        value = ci.in_flight;
+        break;
+
+    /* suppress warning */
+    default:
+        value = 0;
+        break;
+    }
+
+    v->data = ngx_pnalloc(r->pool, NGX_INT64_LEN);
+    if (v->data == NULL) {
+        return NGX_ERROR;
+    }
+
+    v->len = ngx_sprintf(v->data, "%uL", value) - v->data;
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v3_variable_quic_memory(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    uint64_t                value;
+    ngx_quic_memory_info_t  mi;
+
+    if (r->connection->quic == NULL) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    ngx_quic_memory_info(r->connection, &mi);
+
+    switch (data) {
+    case 0:
+        value = mi.memory;
+        break;
+
+    case 1:
+        value = mi.frames;
+        break;
+
+    case 2:
+        value = mi.buffers;
+        break;
+
+    case 3:
+        value = mi.worker_memory;
+        break;
+
+    case 4:
+        value = mi.worker_frames;
+        break;
+
+    case 5:
+        value = mi.worker_buffers;
+        break;
+
+    /* suppress warning */
+    default:
+        value = 0;
+        break;
+    }
+
+    v->data = ngx_pnalloc(r->pool, NGX_INT64_LEN);
+    if (v->data == NULL) {
+        return NGX_ERROR;
+    }
+
+    v->len = ngx_sprintf(v->data, "%uL", value) - v->data;
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_v3_add_variables(ngx_conf_t *cf)
 {
@@ -200,15 +425,23 @@ ngx_http_v3_create_srv_conf(ngx_conf_t *cf)
     h3scf->enable_hq = NGX_CONF_UNSET;
     h3scf->max_table_capacity = NGX_HTTP_V3_MAX_TABLE_CAPACITY;
     h3scf->max_concurrent_streams = NGX_CONF_UNSET_UINT;
+    h3scf->encoder_table_capacity = NGX_CONF_UNSET_SIZE;
 
     h3scf->quic.stream_buffer_size = NGX_CONF_UNSET_SIZE;
+    h3scf->quic.memory_limit = NGX_CONF_UNSET_SIZE;
+    h3scf->quic.worker_memory_limit = NGX_CONF_UNSET_SIZE;
     h3scf->quic.max_concurrent_streams_bidi = NGX_CONF_UNSET_UINT;
     h3scf->quic.max_concurrent_streams_uni = NGX_HTTP_V3_MAX_UNI_STREAMS;
     h3scf->quic.retry = NGX_CONF_UNSET;
     h3scf->quic.gso_enabled = NGX_CONF_UNSET;
+    h3scf->quic.batch = NGX_CONF_UNSET;
+    h3scf->quic.pacing = NGX_CONF_UNSET;
+    h3scf->quic.ecn = NGX_CONF_UNSET;
     h3scf->quic.stream_close_code = NGX_HTTP_V3_ERR_NO_ERROR;
     h3scf->quic.stream_reject_code_bidi = NGX_HTTP_V3_ERR_REQUEST_REJECTED;
     h3scf->quic.active_connection_id_limit = NGX_CONF_UNSET_UINT;
+    h3scf->quic.congestion_control = NGX_CONF_UNSET_UINT;
+    h3scf->quic.ack_frequency = NGX_CONF_UNSET_UINT;
 
     h3scf->quic.init = ngx_http_v3_init;
     h3scf->quic.shutdown = ngx_http_v3_shutdown;
@@ -235,14 +468,26 @@ ngx_http_v3_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
 
     conf->max_blocked_streams = conf->max_concurrent_streams;
 
+    ngx_conf_merge_size_value(conf->encoder_table_capacity,
+                              prev->encoder_table_capacity, 0);
+
     ngx_conf_merge_size_value(conf->quic.stream_buffer_size,
                               prev->quic.stream_buffer_size,
                               65536);
 
+    ngx_conf_merge_size_value(conf->quic.memory_limit,
+                              prev->quic.memory_limit, 0);
+
+    ngx_conf_merge_size_value(conf->quic.worker_memory_limit,
+                              prev->quic.worker_memory_limit, 0);
+
     conf->quic.max_concurrent_streams_bidi = conf->max_concurrent_streams;
 
     ngx_conf_merge_value(conf->quic.retry, prev->quic.retry, 0);
     ngx_conf_merge_value(conf->quic.gso_enabled, prev->quic.gso_enabled, 0);
+    ngx_conf_merge_value(conf->quic.batch, prev->quic.batch, 0);
+    ngx_conf_merge_value(conf->quic.pacing, prev->quic.pacing, 0);
+    ngx_conf_merge_value(conf->quic.ecn, prev->quic.ecn, 0);
 
     ngx_conf_merge_str_value(conf->quic.host_key, prev->quic.host_key, "");
 
@@ -250,6 +495,14 @@ ngx_http_v3_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
                               prev->quic.active_connection_id_limit,
                               2);
 
+    ngx_conf_merge_uint_value(conf->quic.congestion_control,
+                              prev->quic.congestion_control,
+                              NGX_QUIC_CC_RENO);
+
+    ngx_conf_merge_uint_value(conf->quic.ack_frequency,
+                              prev->quic.ack_frequency,
+                              NGX_QUIC_DEFAULT_ACK_FREQUENCY);
+
     if (conf->quic.host_key.len == 0) {
 
         conf->quic.host_key.len = NGX_QUIC_DEFAULT_HOST_KEY_LEN;
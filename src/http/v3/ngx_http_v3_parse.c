@@ -594,7 +594,6 @@ static ngx_int_t
 ngx_http_v3_parse_literal(ngx_connection_t *c, ngx_http_v3_parse_literal_t *st,
     ngx_buf_t *b)
 {
-    u_char                     ch;
     ngx_uint_t                 n;
     ngx_http_core_srv_conf_t  *cscf;
     enum {
@@ -643,11 +642,11 @@ ngx_http_v3_parse_literal(ngx_connection_t *c, ngx_http_v3_parse_literal_t *st,
                 return NGX_AGAIN;
             }
 
-            ch = *b->pos++;
+            n = ngx_min((ngx_uint_t) (b->last - b->pos), st->length);
 
             if (st->huffman) {
-                if (ngx_http_huff_decode(&st->huffstate, &ch, 1, &st->last,
-                                         st->length == 1, c->log)
+                if (ngx_http_huff_decode(&st->huffstate, b->pos, n, &st->last,
+                                         st->length == n, c->log)
                     != NGX_OK)
                 {
                     ngx_log_error(NGX_LOG_INFO, c->log, 0,
@@ -656,10 +655,13 @@ ngx_http_v3_parse_literal(ngx_connection_t *c, ngx_http_v3_parse_literal_t *st,
                 }
 
             } else {
-                *st->last++ = ch;
+                st->last = ngx_cpymem(st->last, b->pos, n);
             }
 
-            if (--st->length) {
+            b->pos += n;
+            st->length -= n;
+
+            if (st->length) {
                 break;
             }
 
@@ -16,6 +16,11 @@
 static ngx_int_t ngx_http_v3_evict(ngx_connection_t *c, size_t target);
 static void ngx_http_v3_unblock(void *data);
 static ngx_int_t ngx_http_v3_new_entry(ngx_connection_t *c);
+static ngx_int_t ngx_http_v3_encoder_insert(ngx_connection_t *c,
+    ngx_http_v3_section_t *s, ngx_int_t static_index, ngx_str_t *name,
+    ngx_str_t *value);
+static ngx_uint_t ngx_http_v3_encoder_seen(ngx_http_v3_encoder_table_t *et,
+    ngx_str_t *name, ngx_str_t *value);
 
 
 typedef struct {
@@ -332,18 +337,27 @@ ngx_http_v3_cleanup_table(ngx_http_v3_session_t *h3c)
 {
     ngx_uint_t                    n;
     ngx_http_v3_dynamic_table_t  *dt;
+    ngx_http_v3_encoder_table_t  *et;
 
     dt = &h3c->table;
 
-    if (dt->elts == NULL) {
-        return;
-    }
+    if (dt->elts) {
+        for (n = 0; n < dt->nelts; n++) {
+            ngx_free(dt->elts[n]);
+        }
 
-    for (n = 0; n < dt->nelts; n++) {
-        ngx_free(dt->elts[n]);
+        ngx_free(dt->elts);
     }
 
-    ngx_free(dt->elts);
+    et = &h3c->encoder;
+
+    if (et->elts) {
+        for (n = 0; n < et->nelts; n++) {
+            ngx_free(et->elts[n]);
+        }
+
+        ngx_free(et->elts);
+    }
 }
 
 
@@ -411,10 +425,39 @@ ngx_http_v3_duplicate(ngx_connection_t *c, ngx_uint_t index)
 ngx_int_t
 ngx_http_v3_ack_section(ngx_connection_t *c, ngx_uint_t stream_id)
 {
+    ngx_queue_t                  *q;
+    ngx_http_v3_section_t        *s;
+    ngx_http_v3_session_t        *h3c;
+    ngx_http_v3_encoder_table_t  *et;
+
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 ack section %ui", stream_id);
 
-    /* we do not use dynamic tables */
+    h3c = ngx_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    /* QPACK 4.4.1. Section Acknowledgment */
+
+    for (q = ngx_queue_head(&et->sections);
+         q != ngx_queue_sentinel(&et->sections);
+         q = ngx_queue_next(q))
+    {
+        s = ngx_queue_data(q, ngx_http_v3_section_t, queue);
+
+        if (s->stream_id != stream_id) {
+            continue;
+        }
+
+        if (et->known_received_count < s->insert_count) {
+            et->known_received_count = s->insert_count;
+        }
+
+        ngx_queue_remove(q);
+        ngx_queue_insert_tail(&et->free, q);
+        et->nsections--;
+
+        return NGX_OK;
+    }
 
     return NGX_HTTP_V3_ERR_DECODER_STREAM_ERROR;
 }
@@ -423,12 +466,54 @@ ngx_http_v3_ack_section(ngx_connection_t *c, ngx_uint_t stream_id)
 ngx_int_t
 ngx_http_v3_inc_insert_count(ngx_connection_t *c, ngx_uint_t inc)
 {
+    ngx_http_v3_session_t        *h3c;
+    ngx_http_v3_encoder_table_t  *et;
+
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 increment insert count %ui", inc);
 
-    /* we do not use dynamic tables */
+    h3c = ngx_http_v3_get_session(c);
+    et = &h3c->encoder;
 
-    return NGX_HTTP_V3_ERR_DECODER_STREAM_ERROR;
+    /* QPACK 4.4.3. Insert Count Increment */
+
+    if (inc == 0 || et->known_received_count + inc > et->base + et->nelts) {
+        return NGX_HTTP_V3_ERR_DECODER_STREAM_ERROR;
+    }
+
+    et->known_received_count += inc;
+
+    return NGX_OK;
+}
+
+
+void
+ngx_http_v3_cancel_sections(ngx_connection_t *c, uint64_t stream_id)
+{
+    ngx_queue_t                  *q, *next;
+    ngx_http_v3_section_t        *s;
+    ngx_http_v3_session_t        *h3c;
+    ngx_http_v3_encoder_table_t  *et;
+
+    h3c = ngx_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    /* QPACK 4.4.2. Stream Cancellation */
+
+    for (q = ngx_queue_head(&et->sections);
+         q != ngx_queue_sentinel(&et->sections);
+         q = next)
+    {
+        next = ngx_queue_next(q);
+
+        s = ngx_queue_data(q, ngx_http_v3_section_t, queue);
+
+        if (s->stream_id == stream_id) {
+            ngx_queue_remove(q);
+            ngx_queue_insert_tail(&et->free, q);
+            et->nsections--;
+        }
+    }
 }
 
 
@@ -687,11 +772,17 @@ ngx_http_v3_new_entry(ngx_connection_t *c)
 ngx_int_t
 ngx_http_v3_set_param(ngx_connection_t *c, uint64_t id, uint64_t value)
 {
+    ngx_http_v3_session_t  *h3c;
+
+    h3c = ngx_http_v3_get_session(c);
+
     switch (id) {
 
     case NGX_HTTP_V3_PARAM_MAX_TABLE_CAPACITY:
         ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
                        "http3 param QPACK_MAX_TABLE_CAPACITY:%uL", value);
+
+        h3c->encoder.max_capacity = value;
         break;
 
     case NGX_HTTP_V3_PARAM_MAX_FIELD_SECTION_SIZE:
@@ -703,6 +794,8 @@ ngx_http_v3_set_param(ngx_connection_t *c, uint64_t id, uint64_t value)
     case NGX_HTTP_V3_PARAM_BLOCKED_STREAMS:
         ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
                        "http3 param QPACK_BLOCKED_STREAMS:%uL", value);
+
+        h3c->encoder.max_blocked = value;
         break;
 
     default:
@@ -713,3 +806,333 @@ ngx_http_v3_set_param(ngx_connection_t *c, uint64_t id, uint64_t value)
 
     return NGX_OK;
 }
+
+
+void
+ngx_http_v3_init_section(ngx_connection_t *c, ngx_http_v3_section_t *s)
+{
+    ngx_uint_t                    nblocked;
+    ngx_queue_t                  *q;
+    ngx_http_v3_section_t        *bs;
+    ngx_http_v3_session_t        *h3c;
+    ngx_http_v3_srv_conf_t       *h3scf;
+    ngx_http_v3_encoder_table_t  *et;
+
+    h3c = ngx_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    ngx_memzero(s, sizeof(ngx_http_v3_section_t));
+
+    s->stream_id = c->quic->id;
+    s->base = et->base + et->nelts;
+    s->min_index = (ngx_uint_t) -1;
+
+    h3scf = ngx_http_v3_get_module_srv_conf(c, ngx_http_v3_module);
+
+    if (h3scf->encoder_table_capacity == 0 || et->max_capacity < 32) {
+        return;
+    }
+
+    /*
+     * unacknowledged sections pin the entries they reference;
+     * stop referencing the table if the client does not acknowledge them
+     */
+
+    if (et->nsections >= h3scf->max_concurrent_streams) {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                       "http3 encoder sections:%ui, table disabled",
+                       et->nsections);
+        return;
+    }
+
+    s->dynamic = 1;
+
+    /* QPACK 2.1.2. Blocked Streams */
+
+    nblocked = 0;
+
+    for (q = ngx_queue_head(&et->sections);
+         q != ngx_queue_sentinel(&et->sections);
+         q = ngx_queue_next(q))
+    {
+        bs = ngx_queue_data(q, ngx_http_v3_section_t, queue);
+
+        if (bs->insert_count > et->known_received_count) {
+            nblocked++;
+        }
+    }
+
+    s->blocking = (nblocked < et->max_blocked);
+}
+
+
+ngx_int_t
+ngx_http_v3_index_field(ngx_connection_t *c, ngx_http_v3_section_t *s,
+    ngx_int_t static_index, ngx_str_t *name, ngx_str_t *value,
+    ngx_uint_t *index)
+{
+    ngx_int_t                     rc;
+    ngx_uint_t                    i, n;
+    ngx_http_v3_field_t          *field;
+    ngx_http_v3_session_t        *h3c;
+    ngx_http_v3_encoder_table_t  *et;
+
+    if (!s->dynamic) {
+        return NGX_DECLINED;
+    }
+
+    h3c = ngx_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    for (i = et->nelts; i > 0; i--) {
+        field = et->elts[i - 1];
+
+        if (field->name.len == name->len
+            && field->value.len == value->len
+            && ngx_strncasecmp(field->name.data, name->data, name->len) == 0
+            && ngx_strncmp(field->value.data, value->data, value->len) == 0)
+        {
+            n = et->base + i - 1;
+            goto found;
+        }
+    }
+
+    /* only fields seen in a previous response are inserted */
+
+    if (!ngx_http_v3_encoder_seen(et, name, value)) {
+        return NGX_DECLINED;
+    }
+
+    rc = ngx_http_v3_encoder_insert(c, s, static_index, name, value);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    n = et->base + et->nelts - 1;
+
+found:
+
+    if (n >= et->known_received_count && !s->blocking) {
+        return NGX_DECLINED;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 encoder dynamic[%ui] \"%V\"", n, name);
+
+    if (s->insert_count < n + 1) {
+        s->insert_count = n + 1;
+    }
+
+    if (s->min_index > n) {
+        s->min_index = n;
+    }
+
+    *index = n;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_v3_commit_section(ngx_connection_t *c, ngx_http_v3_section_t *s)
+{
+    ngx_queue_t                  *q;
+    ngx_http_v3_section_t        *ns;
+    ngx_http_v3_session_t        *h3c;
+    ngx_http_v3_encoder_table_t  *et;
+
+    if (s->insert_count == 0) {
+        return NGX_OK;
+    }
+
+    h3c = ngx_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    if (!ngx_queue_empty(&et->free)) {
+        q = ngx_queue_head(&et->free);
+        ngx_queue_remove(q);
+
+        ns = ngx_queue_data(q, ngx_http_v3_section_t, queue);
+
+    } else {
+        ns = ngx_palloc(c->quic->parent->pool, sizeof(ngx_http_v3_section_t));
+        if (ns == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    *ns = *s;
+
+    ngx_queue_insert_tail(&et->sections, &ns->queue);
+    et->nsections++;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 encoder section insert_count:%ui base:%ui, "
+                   "sections:%ui", s->insert_count, s->base, et->nsections);
+
+    return NGX_OK;
+}
+
+
+ngx_uint_t
+ngx_http_v3_encode_insert_count(ngx_connection_t *c, ngx_uint_t insert_count)
+{
+    uint64_t                      max_entries;
+    ngx_http_v3_session_t        *h3c;
+
+    /* QPACK 4.5.1.1. Required Insert Count */
+
+    if (insert_count == 0) {
+        return 0;
+    }
+
+    h3c = ngx_http_v3_get_session(c);
+
+    max_entries = h3c->encoder.max_capacity / 32;
+
+    return insert_count % (2 * max_entries) + 1;
+}
+
+
+static ngx_int_t
+ngx_http_v3_encoder_insert(ngx_connection_t *c, ngx_http_v3_section_t *s,
+    ngx_int_t static_index, ngx_str_t *name, ngx_str_t *value)
+{
+    u_char                       *p;
+    size_t                        size, total, capacity;
+    ngx_uint_t                    n, limit;
+    ngx_queue_t                  *q;
+    ngx_http_v3_field_t          *field;
+    ngx_http_v3_section_t        *ps;
+    ngx_http_v3_session_t        *h3c;
+    ngx_http_v3_srv_conf_t       *h3scf;
+    ngx_http_v3_encoder_table_t  *et;
+
+    h3c = ngx_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    if (et->elts == NULL) {
+        h3scf = ngx_http_v3_get_module_srv_conf(c, ngx_http_v3_module);
+
+        capacity = (size_t) ngx_min(h3scf->encoder_table_capacity,
+                                    et->max_capacity);
+
+        et->elts = ngx_alloc((capacity / 32 + 1) * sizeof(void *), c->log);
+        if (et->elts == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (ngx_http_v3_send_set_capacity(c, capacity) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        et->capacity = capacity;
+    }
+
+    size = ngx_http_v3_table_entry_size(name, value);
+
+    if (size > et->capacity / 4) {
+        return NGX_DECLINED;
+    }
+
+    /* QPACK 2.1.1. Limits on Dynamic Table Insertions */
+
+    limit = s->min_index;
+
+    for (q = ngx_queue_head(&et->sections);
+         q != ngx_queue_sentinel(&et->sections);
+         q = ngx_queue_next(q))
+    {
+        ps = ngx_queue_data(q, ngx_http_v3_section_t, queue);
+
+        if (limit > ps->min_index) {
+            limit = ps->min_index;
+        }
+    }
+
+    n = 0;
+    total = et->size;
+
+    while (total + size > et->capacity) {
+
+        if (et->base + n >= limit) {
+            ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                           "http3 encoder table entries are referenced");
+            return NGX_DECLINED;
+        }
+
+        field = et->elts[n++];
+        total -= ngx_http_v3_table_entry_size(&field->name, &field->value);
+    }
+
+    if (ngx_http_v3_send_insert(c, static_index, name, value) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    while (n) {
+        field = et->elts[0];
+
+        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                       "http3 encoder evict [%ui] \"%V\":\"%V\"",
+                       et->base, &field->name, &field->value);
+
+        et->size -= ngx_http_v3_table_entry_size(&field->name, &field->value);
+        ngx_free(field);
+
+        et->nelts--;
+        et->base++;
+        ngx_memmove(et->elts, &et->elts[1], et->nelts * sizeof(void *));
+
+        n--;
+    }
+
+    p = ngx_alloc(sizeof(ngx_http_v3_field_t) + name->len + value->len,
+                  c->log);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    field = (ngx_http_v3_field_t *) p;
+
+    field->name.data = p + sizeof(ngx_http_v3_field_t);
+    field->name.len = name->len;
+    ngx_strlow(field->name.data, name->data, name->len);
+
+    field->value.data = field->name.data + name->len;
+    field->value.len = value->len;
+    ngx_memcpy(field->value.data, value->data, value->len);
+
+    et->elts[et->nelts++] = field;
+    et->size += size;
+
+    ngx_log_debug4(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 encoder insert [%ui] \"%V\":\"%V\", size:%uz",
+                   et->base + et->nelts - 1, &field->name, &field->value,
+                   size);
+
+    return NGX_OK;
+}
+
+
+static ngx_uint_t
+ngx_http_v3_encoder_seen(ngx_http_v3_encoder_table_t *et, ngx_str_t *name,
+    ngx_str_t *value)
+{
+    uint32_t    hash;
+    ngx_uint_t  i;
+
+    ngx_crc32_init(hash);
+    ngx_crc32_update(&hash, name->data, name->len);
+    ngx_crc32_update(&hash, value->data, value->len);
+    ngx_crc32_final(hash);
+
+    for (i = 0; i < NGX_HTTP_V3_ENCODER_HISTORY; i++) {
+        if (et->seen[i] == hash) {
+            return 1;
+        }
+    }
+
+    et->seen[et->nseen++ % NGX_HTTP_V3_ENCODER_HISTORY] = hash;
+
+    return 0;
+}
@@ -32,6 +32,37 @@ typedef struct {
 } ngx_http_v3_dynamic_table_t;
 
 
+#define NGX_HTTP_V3_ENCODER_HISTORY   16
+
+
+typedef struct {
+    ngx_queue_t                   queue;
+    uint64_t                      stream_id;
+    ngx_uint_t                    base;
+    ngx_uint_t                    insert_count;
+    ngx_uint_t                    min_index;
+    unsigned                      dynamic:1;
+    unsigned                      blocking:1;
+} ngx_http_v3_section_t;
+
+
+typedef struct {
+    ngx_http_v3_field_t         **elts;
+    ngx_uint_t                    nelts;
+    ngx_uint_t                    base;
+    size_t                        size;
+    size_t                        capacity;
+    uint64_t                      max_capacity;
+    uint64_t                      max_blocked;
+    uint64_t                      known_received_count;
+    ngx_queue_t                   sections;
+    ngx_queue_t                   free;
+    ngx_uint_t                    nsections;
+    uint32_t                      seen[NGX_HTTP_V3_ENCODER_HISTORY];
+    ngx_uint_t                    nseen;
+} ngx_http_v3_encoder_table_t;
+
+
 void ngx_http_v3_inc_insert_count_handler(ngx_event_t *ev);
 void ngx_http_v3_cleanup_table(ngx_http_v3_session_t *h3c);
 ngx_int_t ngx_http_v3_ref_insert(ngx_connection_t *c, ngx_uint_t dynamic,
@@ -54,5 +85,15 @@ void ngx_http_v3_ack_insert_count(ngx_connection_t *c, uint64_t insert_count);
 ngx_int_t ngx_http_v3_set_param(ngx_connection_t *c, uint64_t id,
     uint64_t value);
 
+void ngx_http_v3_init_section(ngx_connection_t *c, ngx_http_v3_section_t *s);
+ngx_int_t ngx_http_v3_index_field(ngx_connection_t *c,
+    ngx_http_v3_section_t *s, ngx_int_t static_index, ngx_str_t *name,
+    ngx_str_t *value, ngx_uint_t *index);
+ngx_int_t ngx_http_v3_commit_section(ngx_connection_t *c,
+    ngx_http_v3_section_t *s);
+ngx_uint_t ngx_http_v3_encode_insert_count(ngx_connection_t *c,
+    ngx_uint_t insert_count);
+void ngx_http_v3_cancel_sections(ngx_connection_t *c, uint64_t stream_id);
+
 
 #endif /* _NGX_HTTP_V3_TABLE_H_INCLUDED_ */
@@ -610,13 +610,112 @@ failed:
 }
 
 
+ngx_int_t
+ngx_http_v3_send_set_capacity(ngx_connection_t *c, ngx_uint_t capacity)
+{
+    u_char                  buf[NGX_HTTP_V3_PREFIX_INT_LEN];
+    size_t                  n;
+    ngx_connection_t       *ec;
+    ngx_http_v3_session_t  *h3c;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 send set capacity %ui", capacity);
+
+    ec = ngx_http_v3_get_uni_stream(c, NGX_HTTP_V3_STREAM_ENCODER);
+    if (ec == NULL) {
+        return NGX_ERROR;
+    }
+
+    n = (u_char *) ngx_http_v3_encode_set_capacity(buf, capacity) - buf;
+
+    h3c = ngx_http_v3_get_session(c);
+    h3c->total_bytes += n;
+
+    if (ec->send(ec, buf, n) != (ssize_t) n) {
+        goto failed;
+    }
+
+    return NGX_OK;
+
+failed:
+
+    ngx_log_error(NGX_LOG_ERR, c->log, 0, "failed to send set capacity");
+
+    ngx_http_v3_finalize_connection(c, NGX_HTTP_V3_ERR_EXCESSIVE_LOAD,
+                                    "failed to send set capacity");
+    ngx_http_v3_close_uni_stream(ec);
+
+    return NGX_ERROR;
+}
+
+
+ngx_int_t
+ngx_http_v3_send_insert(ngx_connection_t *c, ngx_int_t index,
+    ngx_str_t *name, ngx_str_t *value)
+{
+    u_char                 *buf, *p;
+    size_t                  n;
+    ngx_connection_t       *ec;
+    ngx_http_v3_session_t  *h3c;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 send insert static[%i] \"%V\":\"%V\"",
+                   index, name, value);
+
+    ec = ngx_http_v3_get_uni_stream(c, NGX_HTTP_V3_STREAM_ENCODER);
+    if (ec == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (index >= 0) {
+        n = ngx_http_v3_encode_insert_ref(NULL, index, value);
+
+    } else {
+        n = ngx_http_v3_encode_insert(NULL, name, value);
+    }
+
+    buf = ngx_pnalloc(c->pool, n);
+    if (buf == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (index >= 0) {
+        p = (u_char *) ngx_http_v3_encode_insert_ref(buf, index, value);
+
+    } else {
+        p = (u_char *) ngx_http_v3_encode_insert(buf, name, value);
+    }
+
+    n = p - buf;
+
+    h3c = ngx_http_v3_get_session(c);
+    h3c->total_bytes += n;
+
+    if (ec->send(ec, buf, n) != (ssize_t) n) {
+        goto failed;
+    }
+
+    return NGX_OK;
+
+failed:
+
+    ngx_log_error(NGX_LOG_ERR, c->log, 0, "failed to send insert");
+
+    ngx_http_v3_finalize_connection(c, NGX_HTTP_V3_ERR_EXCESSIVE_LOAD,
+                                    "failed to send insert");
+    ngx_http_v3_close_uni_stream(ec);
+
+    return NGX_ERROR;
+}
+
+
 ngx_int_t
 ngx_http_v3_cancel_stream(ngx_connection_t *c, ngx_uint_t stream_id)
 {
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 cancel stream %ui", stream_id);
 
-    /* we do not use dynamic tables */
+    ngx_http_v3_cancel_sections(c, stream_id);
 
     return NGX_OK;
 }
@@ -10,6 +10,7 @@
 #include <ngx_event.h>
 #include <ngx_event_connect.h>
 #include <ngx_mail.h>
+#include <ngx_md5.h>
 
 
 typedef struct {
@@ -24,11 +25,51 @@ typedef struct {
 
     ngx_array_t                    *headers;
 
+    ngx_uint_t                      keepalive;
+    ngx_msec_t                      keepalive_timeout;
+    ngx_queue_t                     cache;
+    ngx_queue_t                     free;
+
+    ngx_shm_zone_t                 *shm_zone;
+    time_t                          cache_valid;
+
     u_char                         *file;
     ngx_uint_t                      line;
 } ngx_mail_auth_http_conf_t;
 
 
+typedef struct {
+    ngx_queue_t                     queue;
+    ngx_connection_t               *connection;
+    ngx_mail_auth_http_conf_t      *conf;
+} ngx_mail_auth_http_keepalive_t;
+
+
+typedef struct {
+    ngx_str_node_t                  sn;
+    ngx_queue_t                     queue;
+    time_t                          expire;
+    u_short                         addr_len;
+    u_short                         port_len;
+    u_short                         login_len;
+    u_short                         passwd_len;
+    u_char                          data[1];
+} ngx_mail_auth_http_cache_node_t;
+
+
+typedef struct {
+    ngx_rbtree_t                    rbtree;
+    ngx_rbtree_node_t               sentinel;
+    ngx_queue_t                     queue;
+} ngx_mail_auth_http_cache_shctx_t;
+
+
+typedef struct {
+    ngx_mail_auth_http_cache_shctx_t  *sh;
+    ngx_slab_pool_t                   *shpool;
+} ngx_mail_auth_http_cache_t;
+
+
 typedef struct ngx_mail_auth_http_ctx_s  ngx_mail_auth_http_ctx_t;
 
 typedef void (*ngx_mail_auth_http_handler_pt)(ngx_mail_session_t *s,
@@ -56,10 +97,35 @@ struct ngx_mail_auth_http_ctx_s {
 
     time_t                          sleep;
 
+    off_t                           content_length;
+    u_char                          key[16];
+
     ngx_pool_t                     *pool;
+
+    unsigned                        keepalive:1;
+    unsigned                        reused:1;
+    unsigned                        cacheable:1;
 };
 
 
+static void ngx_mail_auth_http_connect(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx, ngx_mail_auth_http_conf_t *ahcf,
+    ngx_uint_t reuse);
+static ngx_int_t ngx_mail_auth_http_retry(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx);
+static void ngx_mail_auth_http_free_connection(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx);
+static void ngx_mail_auth_http_close_handler(ngx_event_t *ev);
+static void ngx_mail_auth_http_proxy(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx);
+static ngx_int_t ngx_mail_auth_http_cache_lookup(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx, ngx_mail_auth_http_conf_t *ahcf);
+static void ngx_mail_auth_http_cache_store(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx, ngx_mail_auth_http_conf_t *ahcf);
+static void ngx_mail_auth_http_cache_expire(ngx_mail_auth_http_cache_t *cache,
+    ngx_uint_t force);
+static ngx_int_t ngx_mail_auth_http_cache_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
 static void ngx_mail_auth_http_write_handler(ngx_event_t *wev);
 static void ngx_mail_auth_http_read_handler(ngx_event_t *rev);
 static void ngx_mail_auth_http_ignore_status_line(ngx_mail_session_t *s,
@@ -82,6 +148,8 @@ static char *ngx_mail_auth_http_merge_conf(ngx_conf_t *cf, void *parent,
 static char *ngx_mail_auth_http(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 static char *ngx_mail_auth_http_header(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_mail_auth_http_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 
 static ngx_command_t  ngx_mail_auth_http_commands[] = {
@@ -114,6 +182,27 @@ static ngx_command_t  ngx_mail_auth_http_commands[] = {
       offsetof(ngx_mail_auth_http_conf_t, pass_client_cert),
       NULL },
 
+    { ngx_string("auth_http_keepalive"),
+      NGX_MAIL_MAIN_CONF|NGX_MAIL_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_MAIL_SRV_CONF_OFFSET,
+      offsetof(ngx_mail_auth_http_conf_t, keepalive),
+      NULL },
+
+    { ngx_string("auth_http_keepalive_timeout"),
+      NGX_MAIL_MAIN_CONF|NGX_MAIL_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_MAIL_SRV_CONF_OFFSET,
+      offsetof(ngx_mail_auth_http_conf_t, keepalive_timeout),
+      NULL },
+
+    { ngx_string("auth_http_cache"),
+      NGX_MAIL_MAIN_CONF|NGX_MAIL_SRV_CONF|NGX_CONF_TAKE12,
+      ngx_mail_auth_http_cache,
+      NGX_MAIL_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -182,9 +271,27 @@ ngx_mail_auth_http_init(ngx_mail_session_t *s)
     }
 
     ctx->pool = pool;
+    ctx->content_length = -1;
 
     ahcf = ngx_mail_get_module_srv_conf(s, ngx_mail_auth_http_module);
 
+    ctx->peer.name = &ahcf->peer->name;
+
+    if (ahcf->shm_zone) {
+        rc = ngx_mail_auth_http_cache_lookup(s, ctx, ahcf);
+
+        if (rc == NGX_ERROR) {
+            ngx_destroy_pool(ctx->pool);
+            ngx_mail_session_internal_server_error(s);
+            return;
+        }
+
+        if (rc == NGX_OK) {
+            ngx_mail_auth_http_proxy(s, ctx);
+            return;
+        }
+    }
+
     ctx->request = ngx_mail_auth_http_create_request(s, pool, ahcf);
     if (ctx->request == NULL) {
         ngx_destroy_pool(ctx->pool);
@@ -196,27 +303,76 @@ ngx_mail_auth_http_init(ngx_mail_session_t *s)
 
     ctx->peer.sockaddr = ahcf->peer->sockaddr;
     ctx->peer.socklen = ahcf->peer->socklen;
-    ctx->peer.name = &ahcf->peer->name;
     ctx->peer.get = ngx_event_get_peer;
     ctx->peer.log = s->connection->log;
     ctx->peer.log_error = NGX_ERROR_ERR;
 
-    rc = ngx_event_connect_peer(&ctx->peer);
+    s->connection->read->handler = ngx_mail_auth_http_block_read;
 
-    if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
-        if (ctx->peer.connection) {
-            ngx_close_connection(ctx->peer.connection);
+    ngx_mail_auth_http_connect(s, ctx, ahcf, 1);
+}
+
+
+static void
+ngx_mail_auth_http_connect(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx, ngx_mail_auth_http_conf_t *ahcf,
+    ngx_uint_t reuse)
+{
+    ngx_int_t                        rc;
+    ngx_queue_t                     *q;
+    ngx_connection_t                *c;
+    ngx_mail_auth_http_keepalive_t  *item;
+
+    ctx->keepalive = 0;
+    ctx->reused = 0;
+
+    if (reuse && ahcf->keepalive && !ngx_queue_empty(&ahcf->cache)) {
+
+        q = ngx_queue_head(&ahcf->cache);
+        ngx_queue_remove(q);
+
+        item = ngx_queue_data(q, ngx_mail_auth_http_keepalive_t, queue);
+
+        ngx_queue_insert_head(&ahcf->free, q);
+
+        c = item->connection;
+
+        c->idle = 0;
+        c->log = s->connection->log;
+        c->read->log = c->log;
+        c->write->log = c->log;
+
+        if (c->read->timer_set) {
+            ngx_del_timer(c->read);
         }
 
-        ngx_destroy_pool(ctx->pool);
-        ngx_mail_session_internal_server_error(s);
-        return;
+        ngx_log_debug1(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
+                       "mail auth http reuse connection: %d", c->fd);
+
+        ctx->peer.connection = c;
+        ctx->reused = 1;
+
+        rc = NGX_OK;
+
+    } else {
+        rc = ngx_event_connect_peer(&ctx->peer);
+
+        if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
+            if (ctx->peer.connection) {
+                ngx_close_connection(ctx->peer.connection);
+            }
+
+            ngx_destroy_pool(ctx->pool);
+            ngx_mail_session_internal_server_error(s);
+            return;
+        }
     }
 
+    ctx->keepalive = (ahcf->keepalive != 0);
+
     ctx->peer.connection->data = s;
     ctx->peer.connection->pool = s->connection->pool;
 
-    s->connection->read->handler = ngx_mail_auth_http_block_read;
     ctx->peer.connection->read->handler = ngx_mail_auth_http_read_handler;
     ctx->peer.connection->write->handler = ngx_mail_auth_http_write_handler;
 
@@ -232,6 +388,545 @@ ngx_mail_auth_http_init(ngx_mail_session_t *s)
 }
 
 
+static ngx_int_t
+ngx_mail_auth_http_retry(ngx_mail_session_t *s, ngx_mail_auth_http_ctx_t *ctx)
+{
+    ngx_mail_auth_http_conf_t  *ahcf;
+
+    /*
+     * a cached connection may have been closed by the auth http server
+     * while idle, so the request is sent once more over a new connection
+     */
+
+    if (!ctx->reused
+        || (ctx->response && ctx->response->last != ctx->response->start))
+    {
+        return NGX_DECLINED;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
+                   "mail auth http retry");
+
+    ngx_close_connection(ctx->peer.connection);
+    ctx->peer.connection = NULL;
+
+    ctx->request->pos = ctx->request->start;
+
+    if (ctx->response) {
+        ctx->response->pos = ctx->response->start;
+        ctx->response->last = ctx->response->start;
+    }
+
+    ctx->state = 0;
+
+    ahcf = ngx_mail_get_module_srv_conf(s, ngx_mail_auth_http_module);
+
+    ngx_mail_auth_http_connect(s, ctx, ahcf, 0);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_mail_auth_http_free_connection(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx)
+{
+    ngx_queue_t                     *q;
+    ngx_connection_t                *c;
+    ngx_mail_auth_http_conf_t       *ahcf;
+    ngx_mail_auth_http_keepalive_t  *item;
+
+    c = ctx->peer.connection;
+    ctx->peer.connection = NULL;
+
+    ahcf = ngx_mail_get_module_srv_conf(s, ngx_mail_auth_http_module);
+
+    if (!ctx->keepalive
+        || ctx->content_length != ctx->response->last - ctx->response->pos
+        || c->read->eof
+        || c->read->error
+        || c->read->timedout
+        || c->error
+        || ngx_terminate
+        || ngx_exiting)
+    {
+        ngx_close_connection(c);
+        return;
+    }
+
+    if (ngx_queue_empty(&ahcf->free)) {
+
+        q = ngx_queue_last(&ahcf->cache);
+        ngx_queue_remove(q);
+
+        item = ngx_queue_data(q, ngx_mail_auth_http_keepalive_t, queue);
+
+        ngx_close_connection(item->connection);
+
+    } else {
+        q = ngx_queue_head(&ahcf->free);
+        ngx_queue_remove(q);
+
+        item = ngx_queue_data(q, ngx_mail_auth_http_keepalive_t, queue);
+    }
+
+    ngx_queue_insert_head(&ahcf->cache, q);
+
+    ngx_log_debug1(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
+                   "mail auth http keep connection: %d", c->fd);
+
+    item->connection = c;
+
+    if (c->read->timer_set) {
+        ngx_del_timer(c->read);
+    }
+
+    if (c->write->timer_set) {
+        ngx_del_timer(c->write);
+    }
+
+    c->write->handler = ngx_mail_auth_http_dummy_handler;
+    c->read->handler = ngx_mail_auth_http_close_handler;
+
+    c->data = item;
+    c->pool = NULL;
+    c->idle = 1;
+    c->log = ngx_cycle->log;
+    c->read->log = ngx_cycle->log;
+    c->write->log = ngx_cycle->log;
+
+    ngx_add_timer(c->read, ahcf->keepalive_timeout);
+
+    if (c->read->ready) {
+        ngx_mail_auth_http_close_handler(c->read);
+    }
+}
+
+
+static void
+ngx_mail_auth_http_close_handler(ngx_event_t *ev)
+{
+    int                              n;
+    char                             buf[1];
+    ngx_connection_t                *c;
+    ngx_mail_auth_http_keepalive_t  *item;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_MAIL, ev->log, 0,
+                   "mail auth http keepalive close handler");
+
+    c = ev->data;
+
+    if (c->close || ev->timedout) {
+        goto close;
+    }
+
+    n = recv(c->fd, buf, 1, MSG_PEEK);
+
+    if (n == -1 && ngx_socket_errno == NGX_EAGAIN) {
+        ev->ready = 0;
+
+        if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+            goto close;
+        }
+
+        return;
+    }
+
+close:
+
+    item = c->data;
+
+    ngx_queue_remove(&item->queue);
+    ngx_close_connection(item->connection);
+    ngx_queue_insert_head(&item->conf->free, &item->queue);
+}
+
+
+static void
+ngx_mail_auth_http_proxy(ngx_mail_session_t *s, ngx_mail_auth_http_ctx_t *ctx)
+{
+    size_t                      len;
+    ngx_int_t                   rc, port;
+    ngx_addr_t                 *peer;
+    ngx_mail_auth_http_conf_t  *ahcf;
+
+    if (ctx->addr.len == 0 || ctx->port.len == 0) {
+        ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
+                      "auth http server %V did not send server or port",
+                      ctx->peer.name);
+        ngx_destroy_pool(ctx->pool);
+        ngx_mail_session_internal_server_error(s);
+        return;
+    }
+
+    if (s->passwd.data == NULL
+        && s->protocol != NGX_MAIL_SMTP_PROTOCOL)
+    {
+        ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
+                      "auth http server %V did not send password",
+                      ctx->peer.name);
+        ngx_destroy_pool(ctx->pool);
+        ngx_mail_session_internal_server_error(s);
+        return;
+    }
+
+    peer = ngx_pcalloc(s->connection->pool, sizeof(ngx_addr_t));
+    if (peer == NULL) {
+        ngx_destroy_pool(ctx->pool);
+        ngx_mail_session_internal_server_error(s);
+        return;
+    }
+
+    rc = ngx_parse_addr(s->connection->pool, peer,
+                        ctx->addr.data, ctx->addr.len);
+
+    switch (rc) {
+    case NGX_OK:
+        break;
+
+    case NGX_DECLINED:
+        ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
+                      "auth http server %V sent invalid server "
+                      "address:\"%V\"",
+                      ctx->peer.name, &ctx->addr);
+        /* fall through */
+
+    default:
+        ngx_destroy_pool(ctx->pool);
+        ngx_mail_session_internal_server_error(s);
+        return;
+    }
+
+    port = ngx_atoi(ctx->port.data, ctx->port.len);
+    if (port == NGX_ERROR || port < 1 || port > 65535) {
+        ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
+                      "auth http server %V sent invalid server "
+                      "port:\"%V\"",
+                      ctx->peer.name, &ctx->port);
+        ngx_destroy_pool(ctx->pool);
+        ngx_mail_session_internal_server_error(s);
+        return;
+    }
+
+    ngx_inet_set_port(peer->sockaddr, (in_port_t) port);
+
+    len = ctx->addr.len + 1 + ctx->port.len;
+
+    peer->name.len = len;
+
+    peer->name.data = ngx_pnalloc(s->connection->pool, len);
+    if (peer->name.data == NULL) {
+        ngx_destroy_pool(ctx->pool);
+        ngx_mail_session_internal_server_error(s);
+        return;
+    }
+
+    len = ctx->addr.len;
+
+    ngx_memcpy(peer->name.data, ctx->addr.data, len);
+
+    peer->name.data[len++] = ':';
+
+    ngx_memcpy(peer->name.data + len, ctx->port.data, ctx->port.len);
+
+    if (ctx->cacheable) {
+        ahcf = ngx_mail_get_module_srv_conf(s, ngx_mail_auth_http_module);
+        ngx_mail_auth_http_cache_store(s, ctx, ahcf);
+    }
+
+    ngx_destroy_pool(ctx->pool);
+    ngx_mail_proxy_init(s, peer);
+}
+
+
+
+static ngx_int_t
+ngx_mail_auth_http_cache_lookup(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx, ngx_mail_auth_http_conf_t *ahcf)
+{
+    u_char                           *p;
+    uint32_t                          hash;
+    ngx_md5_t                         md5;
+    ngx_str_t                         key;
+    ngx_mail_core_srv_conf_t         *cscf;
+    ngx_mail_auth_http_cache_t       *cache;
+    ngx_mail_auth_http_cache_node_t  *node;
+
+    /*
+     * only the methods with a plain text password are cached: the key
+     * must identify the credentials, a digest of a one-time salt does not
+     */
+
+    if (s->auth_method > NGX_MAIL_AUTH_LOGIN_USERNAME || s->login.len == 0) {
+        return NGX_DECLINED;
+    }
+
+    cscf = ngx_mail_get_module_srv_conf(s, ngx_mail_core_module);
+
+    ngx_md5_init(&md5);
+    ngx_md5_update(&md5, cscf->protocol->name.data, cscf->protocol->name.len);
+    ngx_md5_update(&md5, "", 1);
+    ngx_md5_update(&md5, s->login.data, s->login.len);
+    ngx_md5_update(&md5, "", 1);
+    ngx_md5_update(&md5, s->passwd.data, s->passwd.len);
+    ngx_md5_update(&md5, "", 1);
+    ngx_md5_update(&md5, ahcf->host_header.data, ahcf->host_header.len);
+    ngx_md5_update(&md5, ahcf->uri.data, ahcf->uri.len);
+    ngx_md5_final(ctx->key, &md5);
+
+    ctx->cacheable = 1;
+
+    key.len = sizeof(ctx->key);
+    key.data = ctx->key;
+
+    ngx_memcpy(&hash, ctx->key, sizeof(uint32_t));
+
+    cache = ahcf->shm_zone->data;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    node = (ngx_mail_auth_http_cache_node_t *)
+               ngx_str_rbtree_lookup(&cache->sh->rbtree, &key, hash);
+
+    if (node == NULL || node->expire < ngx_time()) {
+        ngx_shmtx_unlock(&cache->shpool->mutex);
+
+        ngx_log_debug0(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
+                       "mail auth http cache miss");
+
+        return NGX_DECLINED;
+    }
+
+    ngx_queue_remove(&node->queue);
+    ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+    p = node->data + sizeof(ctx->key);
+
+    ctx->addr.len = node->addr_len;
+    ctx->addr.data = ngx_pnalloc(ctx->pool, node->addr_len + node->port_len);
+    if (ctx->addr.data == NULL) {
+        goto failed;
+    }
+
+    ngx_memcpy(ctx->addr.data, p, node->addr_len);
+    p += node->addr_len;
+
+    ctx->port.len = node->port_len;
+    ctx->port.data = ctx->addr.data + node->addr_len;
+
+    ngx_memcpy(ctx->port.data, p, node->port_len);
+    p += node->port_len;
+
+    s->login.len = node->login_len;
+    s->login.data = ngx_pnalloc(s->connection->pool,
+                                node->login_len + node->passwd_len);
+    if (s->login.data == NULL) {
+        goto failed;
+    }
+
+    ngx_memcpy(s->login.data, p, node->login_len);
+    p += node->login_len;
+
+    s->passwd.len = node->passwd_len;
+    s->passwd.data = s->login.data + node->login_len;
+
+    ngx_memcpy(s->passwd.data, p, node->passwd_len);
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
+                   "mail auth http cache hit: \"%V:%V\"",
+                   &ctx->addr, &ctx->port);
+
+    ctx->cacheable = 0;
+
+    return NGX_OK;
+
+failed:
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_mail_auth_http_cache_store(ngx_mail_session_t *s,
+    ngx_mail_auth_http_ctx_t *ctx, ngx_mail_auth_http_conf_t *ahcf)
+{
+    u_char                           *p;
+    size_t                            size;
+    uint32_t                          hash;
+    ngx_str_t                         key;
+    ngx_mail_auth_http_cache_t       *cache;
+    ngx_mail_auth_http_cache_node_t  *node, *old;
+
+    if (ctx->addr.len > 65535
+        || ctx->port.len > 65535
+        || s->login.len > 65535
+        || s->passwd.len > 65535)
+    {
+        return;
+    }
+
+    size = offsetof(ngx_mail_auth_http_cache_node_t, data)
+           + sizeof(ctx->key) + ctx->addr.len + ctx->port.len
+           + s->login.len + s->passwd.len;
+
+    key.len = sizeof(ctx->key);
+    key.data = ctx->key;
+
+    ngx_memcpy(&hash, ctx->key, sizeof(uint32_t));
+
+    cache = ahcf->shm_zone->data;
+
+    ngx_shmtx_lock(&cache->shpool->mutex);
+
+    old = (ngx_mail_auth_http_cache_node_t *)
+              ngx_str_rbtree_lookup(&cache->sh->rbtree, &key, hash);
+
+    if (old) {
+        ngx_queue_remove(&old->queue);
+        ngx_rbtree_delete(&cache->sh->rbtree, &old->sn.node);
+        ngx_slab_free_locked(cache->shpool, old);
+    }
+
+    ngx_mail_auth_http_cache_expire(cache, 0);
+
+    node = ngx_slab_alloc_locked(cache->shpool, size);
+
+    if (node == NULL) {
+        ngx_mail_auth_http_cache_expire(cache, 1);
+
+        node = ngx_slab_alloc_locked(cache->shpool, size);
+        if (node == NULL) {
+            ngx_shmtx_unlock(&cache->shpool->mutex);
+
+            ngx_log_error(NGX_LOG_ALERT, s->connection->log, 0,
+                          "could not allocate node%s",
+                          cache->shpool->log_ctx);
+            return;
+        }
+    }
+
+    node->expire = ngx_time() + ahcf->cache_valid;
+    node->addr_len = (u_short) ctx->addr.len;
+    node->port_len = (u_short) ctx->port.len;
+    node->login_len = (u_short) s->login.len;
+    node->passwd_len = (u_short) s->passwd.len;
+
+    node->sn.node.key = hash;
+    node->sn.str.len = sizeof(ctx->key);
+    node->sn.str.data = node->data;
+
+    p = ngx_cpymem(node->data, ctx->key, sizeof(ctx->key));
+    p = ngx_cpymem(p, ctx->addr.data, ctx->addr.len);
+    p = ngx_cpymem(p, ctx->port.data, ctx->port.len);
+    p = ngx_cpymem(p, s->login.data, s->login.len);
+    ngx_memcpy(p, s->passwd.data, s->passwd.len);
+
+    ngx_rbtree_insert(&cache->sh->rbtree, &node->sn.node);
+    ngx_queue_insert_head(&cache->sh->queue, &node->queue);
+
+    ngx_shmtx_unlock(&cache->shpool->mutex);
+
+    ngx_log_debug0(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
+                   "mail auth http cache store");
+}
+
+
+static void
+ngx_mail_auth_http_cache_expire(ngx_mail_auth_http_cache_t *cache,
+    ngx_uint_t force)
+{
+    time_t                            now;
+    ngx_uint_t                        n;
+    ngx_queue_t                      *q;
+    ngx_mail_auth_http_cache_node_t  *node;
+
+    now = ngx_time();
+
+    /*
+     * force == 0 deletes one or two expired entries
+     * force == 1 deletes the least recently used entry by force
+     *            and one or two expired entries
+     */
+
+    for (n = 0; n < 3; n++) {
+
+        if (ngx_queue_empty(&cache->sh->queue)) {
+            return;
+        }
+
+        q = ngx_queue_last(&cache->sh->queue);
+
+        node = ngx_queue_data(q, ngx_mail_auth_http_cache_node_t, queue);
+
+        if (!(force && n == 0) && node->expire >= now) {
+            return;
+        }
+
+        ngx_queue_remove(q);
+        ngx_rbtree_delete(&cache->sh->rbtree, &node->sn.node);
+        ngx_slab_free_locked(cache->shpool, node);
+    }
+}
+
+
+static ngx_int_t
+ngx_mail_auth_http_cache_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_mail_auth_http_cache_t  *ocache = data;
+
+    size_t                       len;
+    ngx_mail_auth_http_cache_t  *cache;
+
+    cache = shm_zone->data;
+
+    if (ocache) {
+        cache->sh = ocache->sh;
+        cache->shpool = ocache->shpool;
+
+        return NGX_OK;
+    }
+
+    cache->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cache->sh = cache->shpool->data;
+
+        return NGX_OK;
+    }
+
+    cache->sh = ngx_slab_alloc(cache->shpool,
+                               sizeof(ngx_mail_auth_http_cache_shctx_t));
+    if (cache->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->shpool->data = cache->sh;
+
+    ngx_rbtree_init(&cache->sh->rbtree, &cache->sh->sentinel,
+                    ngx_str_rbtree_insert_value);
+
+    ngx_queue_init(&cache->sh->queue);
+
+    len = sizeof(" in auth http cache zone \"\"") + shm_zone->shm.name.len;
+
+    cache->shpool->log_ctx = ngx_slab_alloc(cache->shpool, len);
+    if (cache->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(cache->shpool->log_ctx, " in auth http cache zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    cache->shpool->log_nomem = 0;
+
+    return NGX_OK;
+}
+
+
 static void
 ngx_mail_auth_http_write_handler(ngx_event_t *wev)
 {
@@ -263,6 +958,10 @@ ngx_mail_auth_http_write_handler(ngx_event_t *wev)
     n = ngx_send(c, ctx->request->pos, size);
 
     if (n == NGX_ERROR) {
+        if (ngx_mail_auth_http_retry(s, ctx) == NGX_OK) {
+            return;
+        }
+
         ngx_close_connection(c);
         ngx_destroy_pool(ctx->pool);
         ngx_mail_session_internal_server_error(s);
@@ -346,6 +1045,10 @@ ngx_mail_auth_http_read_handler(ngx_event_t *rev)
         return;
     }
 
+    if (ngx_mail_auth_http_retry(s, ctx) == NGX_OK) {
+        return;
+    }
+
     ngx_close_connection(c);
     ngx_destroy_pool(ctx->pool);
     ngx_mail_session_internal_server_error(s);
@@ -463,11 +1166,10 @@ static void
 ngx_mail_auth_http_process_headers(ngx_mail_session_t *s,
     ngx_mail_auth_http_ctx_t *ctx)
 {
-    u_char      *p;
-    time_t       timer;
-    size_t       len, size;
-    ngx_int_t    rc, port, n;
-    ngx_addr_t  *peer;
+    u_char     *p;
+    time_t      timer;
+    size_t      len, size;
+    ngx_int_t   rc, n;
 
     ngx_log_debug0(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
                    "mail auth http process headers");
@@ -677,6 +1379,43 @@ ngx_mail_auth_http_process_headers(ngx_mail_session_t *s,
                 continue;
             }
 
+            if (len == sizeof("Content-Length") - 1
+                && ngx_strncasecmp(ctx->header_name_start,
+                                   (u_char *) "Content-Length",
+                                   sizeof("Content-Length") - 1)
+                   == 0)
+            {
+                ctx->content_length = ngx_atoof(ctx->header_start,
+                                          ctx->header_end - ctx->header_start);
+                continue;
+            }
+
+            if (len == sizeof("Connection") - 1
+                && ngx_strncasecmp(ctx->header_name_start,
+                                   (u_char *) "Connection",
+                                   sizeof("Connection") - 1)
+                   == 0)
+            {
+                if (ngx_strlcasestrn(ctx->header_start, ctx->header_end,
+                                     (u_char *) "close", sizeof("close") - 2)
+                    != NULL)
+                {
+                    ctx->keepalive = 0;
+                }
+
+                continue;
+            }
+
+            if (len == sizeof("Transfer-Encoding") - 1
+                && ngx_strncasecmp(ctx->header_name_start,
+                                   (u_char *) "Transfer-Encoding",
+                                   sizeof("Transfer-Encoding") - 1)
+                   == 0)
+            {
+                ctx->keepalive = 0;
+                continue;
+            }
+
             /* ignore other headers */
 
             continue;
@@ -686,7 +1425,7 @@ ngx_mail_auth_http_process_headers(ngx_mail_session_t *s,
             ngx_log_debug0(NGX_LOG_DEBUG_MAIL, s->connection->log, 0,
                            "mail auth http header done");
 
-            ngx_close_connection(ctx->peer.connection);
+            ngx_mail_auth_http_free_connection(s, ctx);
 
             if (ctx->err.len) {
 
@@ -752,88 +1491,7 @@ ngx_mail_auth_http_process_headers(ngx_mail_session_t *s,
                 return;
             }
 
-            if (ctx->addr.len == 0 || ctx->port.len == 0) {
-                ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
-                              "auth http server %V did not send server or port",
-                              ctx->peer.name);
-                ngx_destroy_pool(ctx->pool);
-                ngx_mail_session_internal_server_error(s);
-                return;
-            }
-
-            if (s->passwd.data == NULL
-                && s->protocol != NGX_MAIL_SMTP_PROTOCOL)
-            {
-                ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
-                              "auth http server %V did not send password",
-                              ctx->peer.name);
-                ngx_destroy_pool(ctx->pool);
-                ngx_mail_session_internal_server_error(s);
-                return;
-            }
-
-            peer = ngx_pcalloc(s->connection->pool, sizeof(ngx_addr_t));
-            if (peer == NULL) {
-                ngx_destroy_pool(ctx->pool);
-                ngx_mail_session_internal_server_error(s);
-                return;
-            }
-
-            rc = ngx_parse_addr(s->connection->pool, peer,
-                                ctx->addr.data, ctx->addr.len);
-
-            switch (rc) {
-            case NGX_OK:
-                break;
-
-            case NGX_DECLINED:
-                ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
-                              "auth http server %V sent invalid server "
-                              "address:\"%V\"",
-                              ctx->peer.name, &ctx->addr);
-                /* fall through */
-
-            default:
-                ngx_destroy_pool(ctx->pool);
-                ngx_mail_session_internal_server_error(s);
-                return;
-            }
-
-            port = ngx_atoi(ctx->port.data, ctx->port.len);
-            if (port == NGX_ERROR || port < 1 || port > 65535) {
-                ngx_log_error(NGX_LOG_ERR, s->connection->log, 0,
-                              "auth http server %V sent invalid server "
-                              "port:\"%V\"",
-                              ctx->peer.name, &ctx->port);
-                ngx_destroy_pool(ctx->pool);
-                ngx_mail_session_internal_server_error(s);
-                return;
-            }
-
-            ngx_inet_set_port(peer->sockaddr, (in_port_t) port);
-
-            len = ctx->addr.len + 1 + ctx->port.len;
-
-            peer->name.len = len;
-
-            peer->name.data = ngx_pnalloc(s->connection->pool, len);
-            if (peer->name.data == NULL) {
-                ngx_destroy_pool(ctx->pool);
-                ngx_mail_session_internal_server_error(s);
-                return;
-            }
-
-            len = ctx->addr.len;
-
-            ngx_memcpy(peer->name.data, ctx->addr.data, len);
-
-            peer->name.data[len++] = ':';
-
-            ngx_memcpy(peer->name.data + len, ctx->port.data, ctx->port.len);
-
-            ngx_destroy_pool(ctx->pool);
-            ngx_mail_proxy_init(s, peer);
-
+            ngx_mail_auth_http_proxy(s, ctx);
             return;
         }
 
@@ -1298,8 +1956,14 @@ ngx_mail_auth_http_create_request(ngx_mail_session_t *s, ngx_pool_t *pool,
 
     b->last = ngx_cpymem(b->last, "GET ", sizeof("GET ") - 1);
     b->last = ngx_copy(b->last, ahcf->uri.data, ahcf->uri.len);
-    b->last = ngx_cpymem(b->last, " HTTP/1.0" CRLF,
-                         sizeof(" HTTP/1.0" CRLF) - 1);
+    if (ahcf->keepalive) {
+        b->last = ngx_cpymem(b->last, " HTTP/1.1" CRLF,
+                             sizeof(" HTTP/1.1" CRLF) - 1);
+
+    } else {
+        b->last = ngx_cpymem(b->last, " HTTP/1.0" CRLF,
+                             sizeof(" HTTP/1.0" CRLF) - 1);
+    }
 
     b->last = ngx_cpymem(b->last, "Host: ", sizeof("Host: ") - 1);
     b->last = ngx_copy(b->last, ahcf->host_header.data,
@@ -1512,6 +2176,10 @@ ngx_mail_auth_http_create_conf(ngx_conf_t *cf)
 
     ahcf->timeout = NGX_CONF_UNSET_MSEC;
     ahcf->pass_client_cert = NGX_CONF_UNSET;
+    ahcf->keepalive = NGX_CONF_UNSET_UINT;
+    ahcf->keepalive_timeout = NGX_CONF_UNSET_MSEC;
+    ahcf->shm_zone = NGX_CONF_UNSET_PTR;
+    ahcf->cache_valid = NGX_CONF_UNSET;
 
     ahcf->file = cf->conf_file->file.name.data;
     ahcf->line = cf->conf_file->line;
@@ -1526,10 +2194,11 @@ ngx_mail_auth_http_merge_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_mail_auth_http_conf_t *prev = parent;
     ngx_mail_auth_http_conf_t *conf = child;
 
-    u_char           *p;
-    size_t            len;
-    ngx_uint_t        i;
-    ngx_table_elt_t  *header;
+    u_char                          *p;
+    size_t                           len;
+    ngx_uint_t                       i;
+    ngx_table_elt_t                 *header;
+    ngx_mail_auth_http_keepalive_t  *item;
 
     if (conf->peer == NULL) {
         conf->peer = prev->peer;
@@ -1549,6 +2218,29 @@ ngx_mail_auth_http_merge_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_value(conf->pass_client_cert, prev->pass_client_cert, 0);
 
+    ngx_conf_merge_uint_value(conf->keepalive, prev->keepalive, 0);
+    ngx_conf_merge_msec_value(conf->keepalive_timeout,
+                              prev->keepalive_timeout, 60000);
+
+    if (conf->keepalive) {
+        ngx_queue_init(&conf->cache);
+        ngx_queue_init(&conf->free);
+
+        item = ngx_pcalloc(cf->pool, conf->keepalive
+                                     * sizeof(ngx_mail_auth_http_keepalive_t));
+        if (item == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        for (i = 0; i < conf->keepalive; i++) {
+            item[i].conf = conf;
+            ngx_queue_insert_head(&conf->free, &item[i].queue);
+        }
+    }
+
+    ngx_conf_merge_ptr_value(conf->shm_zone, prev->shm_zone, NULL);
+    ngx_conf_merge_value(conf->cache_valid, prev->cache_valid, 10);
+
     if (conf->headers == NULL) {
         conf->headers = prev->headers;
         conf->header = prev->header;
@@ -1657,3 +2349,123 @@ ngx_mail_auth_http_header(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     return NGX_CONF_OK;
 }
+
+
+static char *
+ngx_mail_auth_http_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_mail_auth_http_conf_t *ahcf = conf;
+
+    u_char                      *p;
+    time_t                       valid;
+    ssize_t                      size;
+    ngx_str_t                   *value, name, s;
+    ngx_uint_t                   i;
+    ngx_shm_zone_t              *shm_zone;
+    ngx_mail_auth_http_cache_t  *cache;
+
+    if (ahcf->shm_zone != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts != 2) {
+            return "has invalid number of arguments";
+        }
+
+        ahcf->shm_zone = NULL;
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strncmp(value[1].data, "zone=", 5) != 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.data = value[1].data + 5;
+
+    p = (u_char *) ngx_strchr(name.data, ':');
+
+    if (p == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.len = p - name.data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = ngx_parse_size(&s);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * ngx_pagesize)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (name.len == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone name \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    valid = 10;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "valid=", 6) == 0) {
+
+            s.len = value[i].len - 6;
+            s.data = value[i].data + 6;
+
+            valid = ngx_parse_time(&s, 1);
+
+            if (valid == (time_t) NGX_ERROR || valid == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid parameter \"%V\"", &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                     &ngx_mail_auth_http_module);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    /* the same zone may be shared by several servers */
+
+    if (shm_zone->data == NULL) {
+        cache = ngx_pcalloc(cf->pool, sizeof(ngx_mail_auth_http_cache_t));
+        if (cache == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        shm_zone->init = ngx_mail_auth_http_cache_init_zone;
+        shm_zone->data = cache;
+    }
+
+    ahcf->shm_zone = shm_zone;
+    ahcf->cache_valid = valid;
+
+    return NGX_CONF_OK;
+}
@@ -164,6 +164,9 @@ ngx_mail_init_connection(ngx_connection_t *c)
     c->log->data = ctx;
     c->log->action = "sending client greeting line";
 
+    c->read->low_priority = 0;
+    c->write->low_priority = 0;
+
     c->log_error = NGX_ERROR_INFO;
 
     rev = c->read;
@@ -185,7 +188,7 @@ ngx_mail_init_connection(ngx_connection_t *c)
         }
     }
 
-    if (ngx_use_accept_mutex) {
+    if (ngx_use_accept_mutex || rev->low_priority) {
         ngx_post_event(rev, &ngx_posted_events);
         return;
     }
@@ -53,6 +53,7 @@ typedef struct {
 
     ngx_flag_t       session_tickets;
     ngx_array_t     *session_ticket_keys;
+    time_t           session_ticket_key_rotation;
 
     u_char          *file;
     ngx_uint_t       line;
@@ -21,11 +21,36 @@ extern "C" {
 // nginx header files should go before other, because they define 64-bit off_t
 // #include <string>
 
+#include <ngx_cpp.h>
+#include <vector>
+
 
 void ngx_cpp_test_handler(void *data);
+void ngx_cpp_test_allocators(ngx_pool_t *pool, ngx_slab_pool_t *shpool);
 
 void
 ngx_cpp_test_handler(void *data)
 {
     return;
 }
+
+
+void
+ngx_cpp_test_allocators(ngx_pool_t *pool, ngx_slab_pool_t *shpool)
+{
+    ngx::pool_allocator<ngx_str_t>  pa(pool);
+    ngx::slab_allocator<ngx_uint_t>  sa(shpool);
+
+    std::vector<ngx_str_t, ngx::pool_allocator<ngx_str_t>>  v(pa);
+    std::vector<ngx_uint_t, ngx::slab_allocator<ngx_uint_t>>  w(sa);
+
+    v.push_back(ngx_str_t());
+
+    {
+        ngx::slab_lock  lock(shpool);
+    }
+
+    ngx::pool  tmp(ngx_create_pool(1024, pool->log));
+
+    (void) ngx::pool_new<std::vector<int>>(tmp.get());
+}
@@ -7,6 +7,7 @@
 
 #include <ngx_config.h>
 #include <ngx_core.h>
+#include <ngx_event.h>
 
 /*
  * declare Profiler interface here because
@@ -17,16 +18,55 @@ int ProfilerStart(u_char* fname);
 void ProfilerStop(void);
 void ProfilerRegisterThread(void);
 
+/*
+ * the heap profiler is a part of tcmalloc, which nginx is not linked with,
+ * so it is only looked up at run time, e.g. if tcmalloc is preloaded
+ */
 
-static void *ngx_google_perftools_create_conf(ngx_cycle_t *cycle);
-static ngx_int_t ngx_google_perftools_worker(ngx_cycle_t *cycle);
+typedef void (*ngx_heap_profiler_start_pt)(const char *prefix);
+typedef void (*ngx_heap_profiler_dump_pt)(const char *reason);
+typedef void (*ngx_heap_profiler_stop_pt)(void);
 
 
 typedef struct {
-    ngx_str_t  profiles;
+    ngx_str_t                    profiles;
+    ngx_msec_t                   on_demand;
+    ngx_flag_t                   heap;
 } ngx_google_perftools_conf_t;
 
 
+typedef struct {
+    ngx_event_t                  event;
+    ngx_msec_t                   stop;
+    ngx_uint_t                   number;
+    unsigned                     cpu:1;
+    unsigned                     heap:1;
+
+    ngx_heap_profiler_start_pt   heap_start;
+    ngx_heap_profiler_dump_pt    heap_dump;
+    ngx_heap_profiler_stop_pt    heap_stop;
+} ngx_google_perftools_ctx_t;
+
+
+static void *ngx_google_perftools_create_conf(ngx_cycle_t *cycle);
+static char *ngx_google_perftools_init_conf(ngx_cycle_t *cycle, void *conf);
+static ngx_int_t ngx_google_perftools_worker(ngx_cycle_t *cycle);
+static void ngx_google_perftools_exit(ngx_cycle_t *cycle);
+static ngx_int_t ngx_google_perftools_init_on_demand(ngx_cycle_t *cycle,
+    ngx_google_perftools_conf_t *gptcf);
+static void ngx_google_perftools_signal_handler(int signo);
+static void ngx_google_perftools_handler(ngx_event_t *ev);
+static void ngx_google_perftools_start(ngx_google_perftools_conf_t *gptcf,
+    ngx_log_t *log);
+static void ngx_google_perftools_stop(ngx_log_t *log);
+static char *ngx_google_perftools_on_demand(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+
+
+static ngx_google_perftools_ctx_t   ngx_google_perftools_ctx;
+static volatile sig_atomic_t        ngx_google_perftools_toggle;
+
+
 static ngx_command_t  ngx_google_perftools_commands[] = {
 
     { ngx_string("google_perftools_profiles"),
@@ -36,6 +76,13 @@ static ngx_command_t  ngx_google_perftools_commands[] = {
       offsetof(ngx_google_perftools_conf_t, profiles),
       NULL },
 
+    { ngx_string("google_perftools_on_demand"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE12,
+      ngx_google_perftools_on_demand,
+      0,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -43,7 +90,7 @@ static ngx_command_t  ngx_google_perftools_commands[] = {
 static ngx_core_module_t  ngx_google_perftools_module_ctx = {
     ngx_string("google_perftools"),
     ngx_google_perftools_create_conf,
-    NULL
+    ngx_google_perftools_init_conf
 };
 
 
@@ -57,7 +104,7 @@ ngx_module_t  ngx_google_perftools_module = {
     ngx_google_perftools_worker,           /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
-    NULL,                                  /* exit process */
+    ngx_google_perftools_exit,             /* exit process */
     NULL,                                  /* exit master */
     NGX_MODULE_V1_PADDING
 };
@@ -79,10 +126,32 @@ ngx_google_perftools_create_conf(ngx_cycle_t *cycle)
      *     gptcf->profiles = { 0, NULL };
      */
 
+    gptcf->on_demand = NGX_CONF_UNSET_MSEC;
+    gptcf->heap = NGX_CONF_UNSET;
+
     return gptcf;
 }
 
 
+static char *
+ngx_google_perftools_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_google_perftools_conf_t  *gptcf = conf;
+
+    ngx_conf_init_msec_value(gptcf->on_demand, 0);
+    ngx_conf_init_value(gptcf->heap, 0);
+
+    if (gptcf->on_demand && gptcf->profiles.len == 0) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "\"google_perftools_on_demand\" requires "
+                      "\"google_perftools_profiles\"");
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 static ngx_int_t
 ngx_google_perftools_worker(ngx_cycle_t *cycle)
 {
@@ -96,6 +165,14 @@ ngx_google_perftools_worker(ngx_cycle_t *cycle)
         return NGX_OK;
     }
 
+    if (gptcf->on_demand) {
+        if (getenv("CPUPROFILE")) {
+            ProfilerStop();
+        }
+
+        return ngx_google_perftools_init_on_demand(cycle, gptcf);
+    }
+
     profile = ngx_alloc(gptcf->profiles.len + NGX_INT_T_LEN + 2, cycle->log);
     if (profile == NULL) {
         return NGX_OK;
@@ -123,4 +200,228 @@ ngx_google_perftools_worker(ngx_cycle_t *cycle)
 }
 
 
+/*
+ * In the on demand mode the profiling of a worker process is started
+ * with SIGUSR2, which is otherwise ignored by worker processes, and
+ * stopped with another SIGUSR2 or after the configured time.  Each run
+ * is written to "profiles.pid.number" and, if the heap profiler is
+ * enabled and available, to "profiles.pid.number.*.heap".
+ */
+
+static ngx_int_t
+ngx_google_perftools_init_on_demand(ngx_cycle_t *cycle,
+    ngx_google_perftools_conf_t *gptcf)
+{
+    struct sigaction             sa;
+    ngx_google_perftools_ctx_t  *ctx;
+
+    ctx = &ngx_google_perftools_ctx;
+
+#if (NGX_HAVE_DLOPEN)
+
+    if (gptcf->heap) {
+        ctx->heap_start = (ngx_heap_profiler_start_pt)
+                              ngx_dlsym(RTLD_DEFAULT, "HeapProfilerStart");
+        ctx->heap_dump = (ngx_heap_profiler_dump_pt)
+                              ngx_dlsym(RTLD_DEFAULT, "HeapProfilerDump");
+        ctx->heap_stop = (ngx_heap_profiler_stop_pt)
+                              ngx_dlsym(RTLD_DEFAULT, "HeapProfilerStop");
+    }
+
+#endif
+
+    if (gptcf->heap
+        && (ctx->heap_start == NULL
+            || ctx->heap_dump == NULL
+            || ctx->heap_stop == NULL))
+    {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                      "heap profiler is not available, tcmalloc is not "
+                      "loaded");
+        ctx->heap_start = NULL;
+    }
+
+    ngx_memzero(&sa, sizeof(struct sigaction));
+    sa.sa_handler = ngx_google_perftools_signal_handler;
+    sigemptyset(&sa.sa_mask);
+
+    if (sigaction(SIGUSR2, &sa, NULL) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "sigaction(SIGUSR2) failed");
+        return NGX_OK;
+    }
+
+    /*
+     * signal handlers cannot start the profiler safely,
+     * so the flag set by the handler is checked once a second
+     */
+
+    ctx->event.handler = ngx_google_perftools_handler;
+    ctx->event.data = gptcf;
+    ctx->event.log = cycle->log;
+    ctx->event.cancelable = 1;
+
+    ngx_add_timer(&ctx->event, 1000);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_google_perftools_signal_handler(int signo)
+{
+    ngx_google_perftools_toggle = 1;
+}
+
+
+static void
+ngx_google_perftools_handler(ngx_event_t *ev)
+{
+    ngx_google_perftools_ctx_t   *ctx;
+    ngx_google_perftools_conf_t  *gptcf;
+
+    ctx = &ngx_google_perftools_ctx;
+    gptcf = ev->data;
+
+    if (ngx_google_perftools_toggle) {
+        ngx_google_perftools_toggle = 0;
+
+        if (ctx->cpu) {
+            ngx_google_perftools_stop(ev->log);
+
+        } else {
+            ngx_google_perftools_start(gptcf, ev->log);
+        }
+
+    } else if (ctx->cpu
+               && (ngx_msec_int_t) (ngx_current_msec - ctx->stop) >= 0)
+    {
+        ngx_google_perftools_stop(ev->log);
+    }
+
+    if (ngx_exiting) {
+        return;
+    }
+
+    ngx_add_timer(ev, 1000);
+}
+
+
+static void
+ngx_google_perftools_start(ngx_google_perftools_conf_t *gptcf, ngx_log_t *log)
+{
+    u_char                      *profile;
+    ngx_google_perftools_ctx_t  *ctx;
+
+    ctx = &ngx_google_perftools_ctx;
+
+    profile = ngx_alloc(gptcf->profiles.len + 2 * NGX_INT_T_LEN + 3, log);
+    if (profile == NULL) {
+        return;
+    }
+
+    ngx_sprintf(profile, "%V.%P.%ui%Z",
+                &gptcf->profiles, ngx_pid, ctx->number++);
+
+    if (!ProfilerStart(profile)) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      "ProfilerStart(%s) failed", profile);
+        ngx_free(profile);
+        return;
+    }
+
+    ProfilerRegisterThread();
+
+    ctx->cpu = 1;
+    ctx->stop = ngx_current_msec + gptcf->on_demand;
+
+    if (ctx->heap_start) {
+        ctx->heap_start((char *) profile);
+        ctx->heap = 1;
+    }
+
+    ngx_log_error(NGX_LOG_NOTICE, log, 0,
+                  "profiling started, writing to \"%s\" for %M ms",
+                  profile, gptcf->on_demand);
+
+    ngx_free(profile);
+}
+
+
+static void
+ngx_google_perftools_stop(ngx_log_t *log)
+{
+    ngx_google_perftools_ctx_t  *ctx;
+
+    ctx = &ngx_google_perftools_ctx;
+
+    if (ctx->heap) {
+        ctx->heap_dump("on demand profiling stopped");
+        ctx->heap_stop();
+        ctx->heap = 0;
+    }
+
+    if (ctx->cpu) {
+        ProfilerStop();
+        ctx->cpu = 0;
+    }
+
+    ngx_log_error(NGX_LOG_NOTICE, log, 0, "profiling stopped");
+}
+
+
+static void
+ngx_google_perftools_exit(ngx_cycle_t *cycle)
+{
+    if (ngx_google_perftools_ctx.cpu) {
+        ngx_google_perftools_stop(cycle->log);
+    }
+}
+
+
+static char *
+ngx_google_perftools_on_demand(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_google_perftools_conf_t  *gptcf = conf;
+
+    ngx_str_t  *value;
+
+    if (gptcf->on_demand != NGX_CONF_UNSET_MSEC) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts != 2) {
+            return "has invalid number of arguments";
+        }
+
+        gptcf->on_demand = 0;
+        return NGX_CONF_OK;
+    }
+
+    gptcf->on_demand = ngx_parse_time(&value[1], 0);
+
+    if (gptcf->on_demand == (ngx_msec_t) NGX_ERROR || gptcf->on_demand == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid value \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (cf->args->nelts == 3) {
+        if (ngx_strcmp(value[2].data, "heap") != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        gptcf->heap = 1;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 /* ProfilerStop() is called on Profiler destruction */
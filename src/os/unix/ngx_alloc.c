@@ -14,6 +14,154 @@ ngx_uint_t  ngx_pagesize_shift;
 ngx_uint_t  ngx_cacheline_size;
 
 
+#if (NGX_ALLOC_STATS)
+
+/*
+ * allocations are counted per call site in each process;
+ * the counters are not atomic, allocations in threads may be missed
+ */
+
+#define NGX_ALLOC_STATS_SITES  1024
+
+
+typedef struct {
+    char        *file;
+    ngx_uint_t   line;
+    ngx_uint_t   calls;
+    size_t       bytes;
+} ngx_alloc_site_t;
+
+
+#undef ngx_alloc
+#undef ngx_calloc
+
+static void *ngx_alloc(size_t size, ngx_log_t *log);
+static void *ngx_calloc(size_t size, ngx_log_t *log);
+
+#if (NGX_HAVE_POSIX_MEMALIGN || NGX_HAVE_MEMALIGN)
+#undef ngx_memalign
+static void *ngx_memalign(size_t alignment, size_t size, ngx_log_t *log);
+#endif
+
+static void ngx_alloc_stat(char *file, ngx_uint_t line, size_t size);
+static int ngx_libc_cdecl ngx_alloc_site_cmp(const void *one,
+    const void *two);
+
+
+static ngx_alloc_site_t  ngx_alloc_sites[NGX_ALLOC_STATS_SITES + 1];
+
+
+void *
+ngx_alloc_site(size_t size, ngx_log_t *log, char *file, ngx_uint_t line)
+{
+    ngx_alloc_stat(file, line, size);
+
+    return ngx_alloc(size, log);
+}
+
+
+void *
+ngx_calloc_site(size_t size, ngx_log_t *log, char *file, ngx_uint_t line)
+{
+    ngx_alloc_stat(file, line, size);
+
+    return ngx_calloc(size, log);
+}
+
+
+#if (NGX_HAVE_POSIX_MEMALIGN || NGX_HAVE_MEMALIGN)
+
+void *
+ngx_memalign_site(size_t alignment, size_t size, ngx_log_t *log, char *file,
+    ngx_uint_t line)
+{
+    ngx_alloc_stat(file, line, size);
+
+    return ngx_memalign(alignment, size, log);
+}
+
+#endif
+
+
+static void
+ngx_alloc_stat(char *file, ngx_uint_t line, size_t size)
+{
+    ngx_uint_t         i, n;
+    ngx_alloc_site_t  *site;
+
+    i = ((uintptr_t) file >> 3) * 31 + line;
+
+    for (n = 0; n < NGX_ALLOC_STATS_SITES; n++) {
+        site = &ngx_alloc_sites[(i + n) % NGX_ALLOC_STATS_SITES];
+
+        if (site->file == file && site->line == line) {
+            goto found;
+        }
+
+        if (site->file == NULL) {
+            site->file = file;
+            site->line = line;
+            goto found;
+        }
+    }
+
+    /* the table is full */
+
+    site = &ngx_alloc_sites[NGX_ALLOC_STATS_SITES];
+
+found:
+
+    site->calls++;
+    site->bytes += size;
+}
+
+
+void
+ngx_alloc_stats_log(ngx_log_t *log)
+{
+    ngx_uint_t         i, n;
+    ngx_alloc_site_t  *sites;
+
+    sites = ngx_alloc(sizeof(ngx_alloc_sites), log);
+    if (sites == NULL) {
+        return;
+    }
+
+    for (i = 0, n = 0; i < NGX_ALLOC_STATS_SITES + 1; i++) {
+        if (ngx_alloc_sites[i].calls) {
+            sites[n++] = ngx_alloc_sites[i];
+        }
+    }
+
+    ngx_qsort(sites, n, sizeof(ngx_alloc_site_t), ngx_alloc_site_cmp);
+
+    for (i = 0; i < n; i++) {
+        ngx_log_error(NGX_LOG_INFO, log, 0,
+                      "alloc site %s:%ui: %ui calls, %uz bytes",
+                      sites[i].file ? sites[i].file : "(other)",
+                      sites[i].line, sites[i].calls, sites[i].bytes);
+    }
+
+    ngx_free(sites);
+}
+
+
+static int ngx_libc_cdecl
+ngx_alloc_site_cmp(const void *one, const void *two)
+{
+    const ngx_alloc_site_t  *first = one;
+    const ngx_alloc_site_t  *second = two;
+
+    if (first->bytes == second->bytes) {
+        return 0;
+    }
+
+    return (first->bytes < second->bytes) ? 1 : -1;
+}
+
+#endif
+
+
 void *
 ngx_alloc(size_t size, ngx_log_t *log)
 {
@@ -13,9 +13,25 @@
 #include <ngx_core.h>
 
 
+#if (NGX_ALLOC_STATS)
+
+#define ngx_alloc(size, log)                                                  \
+    ngx_alloc_site(size, log, __FILE__, __LINE__)
+#define ngx_calloc(size, log)                                                 \
+    ngx_calloc_site(size, log, __FILE__, __LINE__)
+
+void *ngx_alloc_site(size_t size, ngx_log_t *log, char *file, ngx_uint_t line);
+void *ngx_calloc_site(size_t size, ngx_log_t *log, char *file,
+    ngx_uint_t line);
+void ngx_alloc_stats_log(ngx_log_t *log);
+
+#else
+
 void *ngx_alloc(size_t size, ngx_log_t *log);
 void *ngx_calloc(size_t size, ngx_log_t *log);
 
+#endif
+
 #define ngx_free          free
 
 
@@ -28,8 +44,20 @@ void *ngx_calloc(size_t size, ngx_log_t *log);
 
 #if (NGX_HAVE_POSIX_MEMALIGN || NGX_HAVE_MEMALIGN)
 
+#if (NGX_ALLOC_STATS)
+
+#define ngx_memalign(alignment, size, log)                                    \
+    ngx_memalign_site(alignment, size, log, __FILE__, __LINE__)
+
+void *ngx_memalign_site(size_t alignment, size_t size, ngx_log_t *log,
+    char *file, ngx_uint_t line);
+
+#else
+
 void *ngx_memalign(size_t alignment, size_t size, ngx_log_t *log);
 
+#endif
+
 #else
 
 #define ngx_memalign(alignment, size, log)  ngx_alloc(size, log)
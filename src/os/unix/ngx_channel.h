@@ -19,6 +19,10 @@ typedef struct {
     ngx_pid_t   pid;
     ngx_int_t   slot;
     ngx_fd_t    fd;
+
+    /* NGX_CMD_MESSAGE: the type, a zero byte, and the message itself */
+    size_t      len;
+    u_char      data[NGX_MESSAGE_LEN];
 } ngx_channel_t;
 
 
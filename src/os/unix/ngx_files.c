@@ -657,6 +657,23 @@ failed:
 }
 
 
+ngx_int_t
+ngx_open_file_mapping(ngx_file_mapping_t *fm)
+{
+    /* a read-only mapping of fm->size bytes of the opened fm->fd */
+
+    fm->addr = mmap(NULL, fm->size, PROT_READ, MAP_SHARED, fm->fd, 0);
+
+    if (fm->addr == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_CRIT, fm->log, ngx_errno,
+                      "mmap(%uz) \"%s\" failed", fm->size, fm->name);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
 void
 ngx_close_file_mapping(ngx_file_mapping_t *fm)
 {
@@ -830,6 +847,48 @@ ngx_read_ahead(ngx_fd_t fd, size_t n)
 #endif
 
 
+#if (NGX_HAVE_POSIX_FADVISE)
+
+ngx_int_t
+ngx_prefetch_file(ngx_fd_t fd, off_t offset, size_t n)
+{
+    int  err;
+
+    err = posix_fadvise(fd, offset, n, POSIX_FADV_WILLNEED);
+
+    if (err == 0) {
+        return 0;
+    }
+
+    ngx_set_errno(err);
+    return NGX_FILE_ERROR;
+}
+
+#endif
+
+
+#if (NGX_HAVE_FICLONE)
+
+ngx_int_t
+ngx_clone_file(ngx_fd_t from, ngx_fd_t to, off_t size)
+{
+    struct file_clone_range  fcr;
+
+    fcr.src_fd = from;
+    fcr.src_offset = 0;
+    fcr.src_length = size;
+    fcr.dest_offset = 0;
+
+    if (ioctl(to, FICLONERANGE, &fcr) == -1) {
+        return NGX_FILE_ERROR;
+    }
+
+    return 0;
+}
+
+#endif
+
+
 #if (NGX_HAVE_O_DIRECT)
 
 ngx_int_t
@@ -194,6 +194,7 @@ ngx_int_t ngx_set_file_time(u_char *name, ngx_fd_t fd, time_t s);
 
 
 ngx_int_t ngx_create_file_mapping(ngx_file_mapping_t *fm);
+ngx_int_t ngx_open_file_mapping(ngx_file_mapping_t *fm);
 void ngx_close_file_mapping(ngx_file_mapping_t *fm);
 
 
@@ -323,6 +324,36 @@ ngx_int_t ngx_read_ahead(ngx_fd_t fd, size_t n);
 #endif
 
 
+#if (NGX_HAVE_POSIX_FADVISE)
+
+ngx_int_t ngx_prefetch_file(ngx_fd_t fd, off_t offset, size_t n);
+#define ngx_prefetch_file_n      "posix_fadvise(POSIX_FADV_WILLNEED)"
+
+#else
+
+#define ngx_prefetch_file(fd, offset, n)  0
+#define ngx_prefetch_file_n      "ngx_prefetch_file_n"
+
+#endif
+
+
+#if (NGX_HAVE_COPY_FILE_RANGE)
+
+#define ngx_copy_file_range(from, to, size)                                  \
+    copy_file_range(from, NULL, to, NULL, size, 0)
+#define ngx_copy_file_range_n    "copy_file_range()"
+
+#endif
+
+
+#if (NGX_HAVE_FICLONE)
+
+ngx_int_t ngx_clone_file(ngx_fd_t from, ngx_fd_t to, off_t size);
+#define ngx_clone_file_n         "ioctl(FICLONERANGE)"
+
+#endif
+
+
 #if (NGX_HAVE_O_DIRECT)
 
 ngx_int_t ngx_directio_on(ngx_fd_t fd);
@@ -13,4 +13,27 @@ ngx_chain_t *ngx_linux_sendfile_chain(ngx_connection_t *c, ngx_chain_t *in,
     off_t limit);
 
 
+#if (NGX_HAVE_MSG_ZEROCOPY)
+
+#define NGX_LINUX_ZEROCOPY_SENDS  64
+
+
+typedef struct {
+    uint32_t      head;          /* the oldest send not yet released */
+    uint32_t      next;          /* the next send notification number */
+    off_t         inflight;
+    size_t        bytes[NGX_LINUX_ZEROCOPY_SENDS];
+    u_char        released[NGX_LINUX_ZEROCOPY_SENDS];
+    unsigned      enabled:1;
+    unsigned      copied:1;
+} ngx_linux_zerocopy_t;
+
+
+void ngx_linux_zerocopy(ngx_connection_t *c, ngx_uint_t enable);
+ngx_chain_t *ngx_linux_zerocopy_chain(ngx_connection_t *c, ngx_chain_t *in,
+    off_t limit);
+
+#endif
+
+
 #endif /* _NGX_LINUX_H_INCLUDED_ */
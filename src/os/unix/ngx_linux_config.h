@@ -89,6 +89,31 @@ extern ssize_t sendfile(int s, int fd, int32_t *offset, size_t size);
 #endif
 
 
+#if (NGX_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#endif
+
+
+#if (NGX_HAVE_INOTIFY)
+#include <sys/inotify.h>
+#endif
+
+
+#if (NGX_HAVE_NUMA)
+#include <linux/mempolicy.h>
+#endif
+
+
+#if (NGX_HAVE_FUTEX)
+#include <linux/futex.h>
+#endif
+
+
+#if (NGX_HAVE_FICLONE)
+#include <linux/fs.h>
+#endif
+
+
 #if (NGX_HAVE_SYS_EVENTFD_H)
 #include <sys/eventfd.h>
 #endif
@@ -103,10 +128,14 @@ typedef struct iocb  ngx_aiocb_t;
 #include <linux/capability.h>
 #endif
 
-#if (NGX_HAVE_UDP_SEGMENT)
+#if (NGX_HAVE_UDP_SEGMENT || NGX_HAVE_UDP_GRO)
 #include <netinet/udp.h>
 #endif
 
+#if (NGX_HAVE_SIOCOUTQNSD)
+#include <linux/sockios.h>
+#endif
+
 
 #define NGX_LISTEN_BACKLOG        511
 
@@ -60,6 +60,18 @@ ngx_linux_sendfile_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
     ngx_iovec_t    header;
     struct iovec   headers[NGX_IOVS_PREALLOCATE];
 
+#if (NGX_HAVE_MSG_ZEROCOPY)
+
+    if (c->zerocopy) {
+        in = ngx_linux_zerocopy_chain(c, in, limit);
+
+        if (in == NULL || in == NGX_CHAIN_ERROR || c->zerocopy->inflight) {
+            return in;
+        }
+    }
+
+#endif
+
     wev = c->write;
 
     if (!wev->ready) {
@@ -239,6 +251,10 @@ ngx_linux_sendfile(ngx_connection_t *c, ngx_buf_t *file, size_t size)
     ssize_t    n;
     ngx_err_t  err;
 
+    ngx_file_read_ahead(file->file, file->file_pos, size,
+                        ngx_max(file->file_last,
+                                file->file_pos + (off_t) size));
+
 #if (NGX_THREADS)
 
     if (file->file->thread_handler) {
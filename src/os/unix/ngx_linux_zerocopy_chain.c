@@ -0,0 +1,429 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+#include <linux/errqueue.h>
+
+
+/*
+ * The pages of the buffers sent with MSG_ZEROCOPY are used by the kernel
+ * until it reports their release in the socket error queue.  Till then
+ * the bytes are not marked as sent in the chain, so the buffers remain
+ * busy and are not reused by ngx_event_pipe() or upstream.
+ *
+ * The kernel copies data anyway for small sends, and may report that it
+ * has copied data, e.g., on loopback: zerocopy is not used then.
+ */
+
+#define NGX_LINUX_ZEROCOPY_MIN_SIZE  16384
+
+
+static off_t ngx_linux_zerocopy_release(ngx_connection_t *c);
+static ngx_uint_t ngx_linux_zerocopy_use(ngx_connection_t *c,
+    ngx_chain_t *in);
+static ssize_t ngx_linux_zerocopy_send(ngx_connection_t *c, ngx_iovec_t *vec,
+    int flags);
+
+
+void
+ngx_linux_zerocopy(ngx_connection_t *c, ngx_uint_t enable)
+{
+    int  zerocopy;
+
+    if (c->zerocopy) {
+        c->zerocopy->enabled = enable;
+        return;
+    }
+
+    if (!enable) {
+        return;
+    }
+
+    if (c->type != SOCK_STREAM
+        || (c->sockaddr->sa_family != AF_INET
+#if (NGX_HAVE_INET6)
+            && c->sockaddr->sa_family != AF_INET6
+#endif
+           )
+        || c->send_chain != ngx_linux_sendfile_chain)
+    {
+        return;
+    }
+
+    zerocopy = 1;
+
+    if (setsockopt(c->fd, SOL_SOCKET, SO_ZEROCOPY,
+                   (const void *) &zerocopy, sizeof(int))
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, c->log, ngx_socket_errno,
+                      "setsockopt(SO_ZEROCOPY) failed, ignored");
+        return;
+    }
+
+    c->zerocopy = ngx_pcalloc(c->pool, sizeof(ngx_linux_zerocopy_t));
+    if (c->zerocopy == NULL) {
+        return;
+    }
+
+    c->zerocopy->enabled = 1;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0, "zerocopy");
+}
+
+
+ngx_chain_t *
+ngx_linux_zerocopy_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
+{
+    off_t                  send, skip, released;
+    size_t                 size;
+    ssize_t                n;
+    u_char                *p;
+    ngx_chain_t           *cl;
+    ngx_event_t           *wev;
+    ngx_iovec_t            vec;
+    struct iovec          *iov, iovs[NGX_IOVS_PREALLOCATE];
+    ngx_linux_zerocopy_t  *zc;
+
+    zc = c->zerocopy;
+
+    if (zc->head != zc->next) {
+        released = ngx_linux_zerocopy_release(c);
+
+        if (released == NGX_ERROR) {
+            return NGX_CHAIN_ERROR;
+        }
+
+        if (released) {
+            zc->inflight -= released;
+            in = ngx_chain_update_sent(in, released);
+        }
+    }
+
+    if (in == NULL || !ngx_linux_zerocopy_use(c, in)) {
+        return in;
+    }
+
+    wev = c->write;
+
+    if (!wev->ready) {
+        return in;
+    }
+
+    if (limit == 0 || limit > (off_t) (NGX_MAX_SIZE_T_VALUE - ngx_pagesize)) {
+        limit = NGX_MAX_SIZE_T_VALUE - ngx_pagesize;
+    }
+
+    send = 0;
+
+    vec.iovs = iovs;
+    vec.nalloc = NGX_IOVS_PREALLOCATE;
+
+    for ( ;; ) {
+
+        if (zc->next - zc->head == NGX_LINUX_ZEROCOPY_SENDS) {
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                           "zerocopy sends limit reached");
+            return in;
+        }
+
+        /* the bytes in flight are skipped, file bufs wait for them */
+
+        skip = zc->inflight;
+        iov = NULL;
+        vec.count = 0;
+        vec.size = 0;
+
+        for (cl = in;
+             cl && vec.count < vec.nalloc && send < limit;
+             cl = cl->next)
+        {
+            if (ngx_buf_special(cl->buf)) {
+                continue;
+            }
+
+            if (!ngx_buf_in_memory_only(cl->buf)) {
+                break;
+            }
+
+            p = cl->buf->pos;
+            size = cl->buf->last - p;
+
+            if (skip >= (off_t) size) {
+                skip -= size;
+                continue;
+            }
+
+            p += (size_t) skip;
+            size -= (size_t) skip;
+            skip = 0;
+
+            if (send + (off_t) size > limit) {
+                size = (size_t) (limit - send);
+            }
+
+            if (iov && p == (u_char *) iov->iov_base + iov->iov_len) {
+                iov->iov_len += size;
+
+            } else {
+                iov = &vec.iovs[vec.count++];
+
+                iov->iov_base = (void *) p;
+                iov->iov_len = size;
+            }
+
+            vec.size += size;
+            send += size;
+        }
+
+        if (vec.size == 0) {
+            return in;
+        }
+
+        n = ngx_linux_zerocopy_send(c, &vec, MSG_ZEROCOPY);
+
+        if (n == NGX_ERROR) {
+            return NGX_CHAIN_ERROR;
+        }
+
+        if (n == NGX_DECLINED) {
+
+            /* ENOBUFS: the notifications limit, copy the data */
+
+            n = ngx_linux_zerocopy_send(c, &vec, 0);
+
+            if (n == NGX_ERROR) {
+                return NGX_CHAIN_ERROR;
+            }
+
+            if (n >= 0) {
+                c->sent += n;
+
+                if (zc->head == zc->next) {
+                    in = ngx_chain_update_sent(in, n);
+
+                } else {
+                    /* released along with the preceding zerocopy send */
+                    zc->bytes[(zc->next - 1) % NGX_LINUX_ZEROCOPY_SENDS] += n;
+                    zc->inflight += n;
+                }
+            }
+
+        } else if (n >= 0) {
+            c->sent += n;
+
+            zc->bytes[zc->next % NGX_LINUX_ZEROCOPY_SENDS] = n;
+            zc->released[zc->next % NGX_LINUX_ZEROCOPY_SENDS] = 0;
+            zc->next++;
+            zc->inflight += n;
+        }
+
+        if (n == NGX_AGAIN) {
+            wev->ready = 0;
+            return in;
+        }
+
+        if ((size_t) n != vec.size) {
+            send -= vec.size - n;
+        }
+
+        if (send >= limit || in == NULL) {
+            return in;
+        }
+    }
+}
+
+
+static off_t
+ngx_linux_zerocopy_release(ngx_connection_t *c)
+{
+    off_t                      released;
+    ssize_t                    n;
+    uint32_t                   seq, count;
+    ngx_err_t                  err;
+    struct msghdr              msg;
+    struct cmsghdr            *cmsg;
+    ngx_linux_zerocopy_t      *zc;
+    struct sock_extended_err  *serr;
+    u_char                     buf[CMSG_SPACE(sizeof(struct sock_extended_err))
+                                   + 64];
+
+    zc = c->zerocopy;
+
+    for ( ;; ) {
+        ngx_memzero(&msg, sizeof(struct msghdr));
+
+        msg.msg_control = buf;
+        msg.msg_controllen = sizeof(buf);
+
+        n = recvmsg(c->fd, &msg, MSG_ERRQUEUE|MSG_DONTWAIT);
+
+        if (n == -1) {
+            err = ngx_socket_errno;
+
+            if (err == NGX_EAGAIN) {
+                break;
+            }
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            c->write->error = 1;
+            ngx_connection_error(c, err, "recvmsg(MSG_ERRQUEUE) failed");
+            return NGX_ERROR;
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&msg);
+             cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (!(cmsg->cmsg_level == SOL_IP
+                  && cmsg->cmsg_type == IP_RECVERR)
+#if (NGX_HAVE_INET6)
+                && !(cmsg->cmsg_level == SOL_IPV6
+                     && cmsg->cmsg_type == IPV6_RECVERR)
+#endif
+               )
+            {
+                continue;
+            }
+
+            serr = (struct sock_extended_err *) CMSG_DATA(cmsg);
+
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY
+                || serr->ee_errno != 0)
+            {
+                continue;
+            }
+
+            ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                           "zerocopy released: %uD-%uD, code:%uD",
+                           serr->ee_info, serr->ee_data,
+                           (uint32_t) serr->ee_code);
+
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                zc->copied = 1;
+            }
+
+            count = serr->ee_data - serr->ee_info + 1;
+            seq = serr->ee_info;
+
+            while (count--) {
+                if (seq - zc->head < zc->next - zc->head) {
+                    zc->released[seq % NGX_LINUX_ZEROCOPY_SENDS] = 1;
+                }
+
+                seq++;
+            }
+        }
+    }
+
+    released = 0;
+
+    while (zc->head != zc->next
+           && zc->released[zc->head % NGX_LINUX_ZEROCOPY_SENDS])
+    {
+        released += zc->bytes[zc->head % NGX_LINUX_ZEROCOPY_SENDS];
+        zc->head++;
+    }
+
+    return released;
+}
+
+
+static ngx_uint_t
+ngx_linux_zerocopy_use(ngx_connection_t *c, ngx_chain_t *in)
+{
+    off_t                  size;
+    ngx_linux_zerocopy_t  *zc;
+
+    zc = c->zerocopy;
+
+    if (zc->inflight) {
+        return 1;
+    }
+
+    if (!zc->enabled || zc->copied) {
+        return 0;
+    }
+
+    size = 0;
+
+    for ( /* void */ ; in; in = in->next) {
+
+        if (ngx_buf_special(in->buf)) {
+            continue;
+        }
+
+        if (!ngx_buf_in_memory_only(in->buf)) {
+            break;
+        }
+
+        size += ngx_buf_size(in->buf);
+
+        if (size >= NGX_LINUX_ZEROCOPY_MIN_SIZE) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static ssize_t
+ngx_linux_zerocopy_send(ngx_connection_t *c, ngx_iovec_t *vec, int flags)
+{
+    ssize_t        n;
+    ngx_err_t      err;
+    struct msghdr  msg;
+
+    ngx_memzero(&msg, sizeof(struct msghdr));
+
+    msg.msg_iov = vec->iovs;
+    msg.msg_iovlen = vec->count;
+
+eintr:
+
+    n = sendmsg(c->fd, &msg, flags);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "sendmsg: %z of %uz, flags:%d", n, vec->size, flags);
+
+    if (n == -1) {
+        err = ngx_socket_errno;
+
+        switch (err) {
+        case NGX_EAGAIN:
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, err,
+                           "sendmsg() not ready");
+            return NGX_AGAIN;
+
+        case NGX_EINTR:
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, err,
+                           "sendmsg() was interrupted");
+            goto eintr;
+
+        case NGX_ENOBUFS:
+            if (flags & MSG_ZEROCOPY) {
+                ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, err,
+                               "sendmsg(MSG_ZEROCOPY) no buffers");
+                return NGX_DECLINED;
+            }
+
+            /* fall through */
+
+        default:
+            c->write->error = 1;
+            ngx_connection_error(c, err, "sendmsg() failed");
+            return NGX_ERROR;
+        }
+    }
+
+    return n;
+}
@@ -33,6 +33,7 @@ typedef struct {
     unsigned            detached:1;
     unsigned            exiting:1;
     unsigned            exited:1;
+    unsigned            handoff:1;
 } ngx_process_t;
 
 
@@ -16,6 +16,7 @@ static void ngx_start_worker_processes(ngx_cycle_t *cycle, ngx_int_t n,
 static void ngx_start_cache_manager_processes(ngx_cycle_t *cycle,
     ngx_uint_t respawn);
 static void ngx_pass_open_channel(ngx_cycle_t *cycle);
+static void ngx_pass_handoff_channel(ngx_cycle_t *cycle);
 static void ngx_signal_worker_processes(ngx_cycle_t *cycle, int signo);
 static ngx_uint_t ngx_reap_children(ngx_cycle_t *cycle);
 static void ngx_master_process_exit(ngx_cycle_t *cycle);
@@ -23,6 +24,7 @@ static void ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data);
 static void ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker);
 static void ngx_worker_process_exit(ngx_cycle_t *cycle);
 static void ngx_channel_handler(ngx_event_t *ev);
+static void ngx_message_process(ngx_channel_t *ch, ngx_log_t *log);
 static void ngx_cache_manager_process_cycle(ngx_cycle_t *cycle, void *data);
 static void ngx_cache_manager_process_handler(ngx_event_t *ev);
 static void ngx_cache_loader_process_handler(ngx_event_t *ev);
@@ -52,18 +54,25 @@ sig_atomic_t  ngx_noaccept;
 ngx_uint_t    ngx_noaccepting;
 ngx_uint_t    ngx_restart;
 
+ngx_process_notify_pt  ngx_process_notify_handler;
+
+static ngx_message_handler_t  *ngx_message_handlers;
+
 
 static u_char  master_process[] = "master process";
 
 
-static ngx_cache_manager_ctx_t  ngx_cache_manager_ctx = {
-    ngx_cache_manager_process_handler, "cache manager process", 0
-};
+static ngx_cache_manager_ctx_t  ngx_cache_manager_ctx[NGX_MAX_CACHE_MANAGERS];
 
 static ngx_cache_manager_ctx_t  ngx_cache_loader_ctx = {
-    ngx_cache_loader_process_handler, "cache loader process", 60000
+    ngx_cache_loader_process_handler, "cache loader process", 60000, 0, 1
 };
 
+static ngx_cache_manager_ctx_t  *ngx_cache_manager;
+static ngx_event_t              *ngx_cache_manager_event;
+
+static ngx_int_t                 ngx_handoff_last;
+
 
 static ngx_cycle_t      ngx_exit_cycle;
 static ngx_log_t        ngx_exit_log;
@@ -278,13 +287,18 @@ ngx_master_process_cycle(ngx_cycle_t *cycle)
 void
 ngx_single_process_cycle(ngx_cycle_t *cycle)
 {
-    ngx_uint_t  i;
+    ngx_uint_t        i;
+    ngx_core_conf_t  *ccf;
 
     if (ngx_set_environment(cycle, NULL) == NULL) {
         /* fatal */
         exit(2);
     }
 
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    ngx_pool_cache_init(ccf->pool_cache);
+
     for (i = 0; cycle->modules[i]; i++) {
         if (cycle->modules[i]->init_process) {
             if (cycle->modules[i]->init_process(cycle) == NGX_ERROR) {
@@ -321,6 +335,11 @@ ngx_single_process_cycle(ngx_cycle_t *cycle)
             }
 
             ngx_cycle = cycle;
+
+            ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx,
+                                                   ngx_core_module);
+
+            ngx_pool_cache_init(ccf->pool_cache);
         }
 
         if (ngx_reopen) {
@@ -345,6 +364,10 @@ ngx_start_worker_processes(ngx_cycle_t *cycle, ngx_int_t n, ngx_int_t type)
                           (void *) (intptr_t) i, "worker process", type);
 
         ngx_pass_open_channel(cycle);
+
+        if (type == NGX_PROCESS_JUST_RESPAWN) {
+            ngx_pass_handoff_channel(cycle);
+        }
     }
 }
 
@@ -352,8 +375,10 @@ ngx_start_worker_processes(ngx_cycle_t *cycle, ngx_int_t n, ngx_int_t type)
 static void
 ngx_start_cache_manager_processes(ngx_cycle_t *cycle, ngx_uint_t respawn)
 {
-    ngx_uint_t    i, manager, loader;
-    ngx_path_t  **path;
+    ngx_uint_t                i, n, manager, loader;
+    ngx_path_t              **path;
+    ngx_core_conf_t          *ccf;
+    ngx_cache_manager_ctx_t  *ctx;
 
     manager = 0;
     loader = 0;
@@ -362,7 +387,7 @@ ngx_start_cache_manager_processes(ngx_cycle_t *cycle, ngx_uint_t respawn)
     for (i = 0; i < ngx_cycle->paths.nelts; i++) {
 
         if (path[i]->manager) {
-            manager = 1;
+            manager++;
         }
 
         if (path[i]->loader) {
@@ -374,11 +399,28 @@ ngx_start_cache_manager_processes(ngx_cycle_t *cycle, ngx_uint_t respawn)
         return;
     }
 
-    ngx_spawn_process(cycle, ngx_cache_manager_process_cycle,
-                      &ngx_cache_manager_ctx, "cache manager process",
-                      respawn ? NGX_PROCESS_JUST_RESPAWN : NGX_PROCESS_RESPAWN);
+    /* the paths are distributed among the cache manager processes */
 
-    ngx_pass_open_channel(cycle);
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    n = ngx_min((ngx_uint_t) ccf->cache_manager_processes, manager);
+
+    for (i = 0; i < n; i++) {
+        ctx = &ngx_cache_manager_ctx[i];
+
+        ctx->handler = ngx_cache_manager_process_handler;
+        ctx->name = "cache manager process";
+        ctx->delay = 0;
+        ctx->slot = i;
+        ctx->number = n;
+
+        ngx_spawn_process(cycle, ngx_cache_manager_process_cycle,
+                          ctx, "cache manager process",
+                          respawn ? NGX_PROCESS_JUST_RESPAWN
+                                  : NGX_PROCESS_RESPAWN);
+
+        ngx_pass_open_channel(cycle);
+    }
 
     if (loader == 0) {
         return;
@@ -428,6 +470,44 @@ ngx_pass_open_channel(ngx_cycle_t *cycle)
 }
 
 
+/*
+ * the processes of the previous generation are told about the new worker,
+ * so that idle connections can be passed to it during a graceful shutdown
+ */
+
+static void
+ngx_pass_handoff_channel(ngx_cycle_t *cycle)
+{
+    ngx_int_t      i;
+    ngx_channel_t  ch;
+
+    ngx_memzero(&ch, sizeof(ngx_channel_t));
+
+    ch.command = NGX_CMD_HANDOFF;
+    ch.pid = ngx_processes[ngx_process_slot].pid;
+    ch.slot = ngx_process_slot;
+    ch.fd = -1;
+
+    for (i = 0; i < ngx_last_process; i++) {
+
+        if (ngx_processes[i].just_spawn
+            || ngx_processes[i].detached
+            || ngx_processes[i].pid == -1
+            || ngx_processes[i].channel[0] == -1)
+        {
+            continue;
+        }
+
+        ngx_log_debug4(NGX_LOG_DEBUG_CORE, cycle->log, 0,
+                       "pass handoff s:%i pid:%P to s:%i pid:%P",
+                       ch.slot, ch.pid, i, ngx_processes[i].pid);
+
+        ngx_write_channel(ngx_processes[i].channel[0],
+                          &ch, sizeof(ngx_channel_t), cycle->log);
+    }
+}
+
+
 static void
 ngx_signal_worker_processes(ngx_cycle_t *cycle, int signo)
 {
@@ -683,6 +763,7 @@ ngx_master_process_exit(ngx_cycle_t *cycle)
     ngx_exit_log.file = &ngx_exit_log_file;
     ngx_exit_log.next = NULL;
     ngx_exit_log.writer = NULL;
+    ngx_exit_log.limit = NULL;
 
     ngx_exit_cycle.log = &ngx_exit_log;
     ngx_exit_cycle.files = ngx_cycle->files;
@@ -767,6 +848,12 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
 
     ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
 
+    ngx_pool_cache_init(ccf->pool_cache);
+
+    if (worker >= 0) {
+        ngx_slab_magazine_init(ccf->slab_magazine);
+    }
+
     if (worker >= 0 && ccf->priority != 0) {
         if (setpriority(PRIO_PROCESS, 0, ccf->priority) == -1) {
             ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
@@ -855,6 +942,13 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
 
         if (cpu_affinity) {
             ngx_setaffinity(cpu_affinity, cycle->log);
+
+#if (NGX_HAVE_NUMA)
+            if (ccf->numa_memory != NGX_NUMA_OFF) {
+                (void) ngx_numa_setpolicy(cpu_affinity, ccf->numa_memory,
+                                          cycle->log);
+            }
+#endif
         }
     }
 
@@ -948,9 +1042,13 @@ ngx_worker_process_exit(ngx_cycle_t *cycle)
         }
     }
 
+    /* return the cached chunks to the shared zones */
+
+    ngx_slab_magazine_flush();
+
     if (ngx_exiting && !ngx_terminate) {
         c = cycle->connections;
-        for (i = 0; i < cycle->connection_n; i++) {
+        for (i = 0; i < cycle->connection_used; i++) {
             if (c[i].fd != -1
                 && c[i].read
                 && !c[i].read->accept
@@ -970,6 +1068,17 @@ ngx_worker_process_exit(ngx_cycle_t *cycle)
         ngx_debug_point();
     }
 
+    if (ngx_pool_cache_stats.hits || ngx_pool_cache_stats.misses) {
+        ngx_log_error(NGX_LOG_INFO, cycle->log, 0,
+                      "pool cache: %ui hits, %ui misses, %ui blocks cached",
+                      ngx_pool_cache_stats.hits, ngx_pool_cache_stats.misses,
+                      ngx_pool_cache_stats.cached);
+    }
+
+#if (NGX_ALLOC_STATS)
+    ngx_alloc_stats_log(cycle->log);
+#endif
+
     /*
      * Copy ngx_cycle->log related data to the special static exit cycle,
      * log, and log file structures enough to allow a signal handler to log.
@@ -983,6 +1092,7 @@ ngx_worker_process_exit(ngx_cycle_t *cycle)
     ngx_exit_log.file = &ngx_exit_log_file;
     ngx_exit_log.next = NULL;
     ngx_exit_log.writer = NULL;
+    ngx_exit_log.limit = NULL;
 
     ngx_exit_cycle.log = &ngx_exit_log;
     ngx_exit_cycle.files = ngx_cycle->files;
@@ -1064,6 +1174,12 @@ ngx_channel_handler(ngx_event_t *ev)
 
             ngx_processes[ch.slot].pid = ch.pid;
             ngx_processes[ch.slot].channel[0] = ch.fd;
+            ngx_processes[ch.slot].handoff = 0;
+
+            if (ngx_last_process <= ch.slot) {
+                ngx_last_process = ch.slot + 1;
+            }
+
             break;
 
         case NGX_CMD_CLOSE_CHANNEL:
@@ -1079,7 +1195,264 @@ ngx_channel_handler(ngx_event_t *ev)
             }
 
             ngx_processes[ch.slot].channel[0] = -1;
+            ngx_processes[ch.slot].handoff = 0;
+            break;
+
+        case NGX_CMD_NOTIFY:
+
+            ngx_log_debug2(NGX_LOG_DEBUG_CORE, ev->log, 0,
+                           "notify from s:%i pid:%P", ch.slot, ch.pid);
+
+            if (ngx_process_notify_handler) {
+                ngx_process_notify_handler();
+            }
+
+            /* a cache manager is notified of work, e.g., of cache purges */
+
+            if (ngx_cache_manager_event) {
+                ngx_post_event(ngx_cache_manager_event, &ngx_posted_events);
+            }
+
+            break;
+
+        case NGX_CMD_HANDOFF:
+
+            ngx_log_debug2(NGX_LOG_DEBUG_CORE, ev->log, 0,
+                           "handoff to s:%i pid:%P", ch.slot, ch.pid);
+
+            ngx_processes[ch.slot].handoff = 1;
+
+            if (ngx_handoff_last <= ch.slot) {
+                ngx_handoff_last = ch.slot + 1;
+            }
+
             break;
+
+        case NGX_CMD_CONNECTION:
+
+            ngx_log_debug3(NGX_LOG_DEBUG_CORE, ev->log, 0,
+                           "connection from s:%i pid:%P fd:%d",
+                           ch.slot, ch.pid, ch.fd);
+
+            if (ngx_process != NGX_PROCESS_WORKER
+                || ngx_exiting
+                || ngx_terminate
+                || ngx_quit)
+            {
+                if (ngx_close_socket(ch.fd) == -1) {
+                    ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_socket_errno,
+                                  ngx_close_socket_n " failed");
+                }
+
+                break;
+            }
+
+            ngx_event_accept_passed((ngx_cycle_t *) ngx_cycle, ch.fd);
+            break;
+
+        case NGX_CMD_MESSAGE:
+
+            ngx_log_debug2(NGX_LOG_DEBUG_CORE, ev->log, 0,
+                           "message from s:%i pid:%P", ch.slot, ch.pid);
+
+            ngx_message_process(&ch, ev->log);
+            break;
+        }
+    }
+}
+
+
+ngx_int_t
+ngx_notify_process(ngx_int_t slot)
+{
+    ngx_channel_t  ch;
+
+    /* processes spawned later are known from NGX_CMD_OPEN_CHANNEL */
+
+    if (slot == ngx_process_slot
+        || slot >= NGX_MAX_PROCESSES
+        || ngx_processes[slot].pid <= 0
+        || ngx_processes[slot].channel[0] == -1)
+    {
+        return NGX_DECLINED;
+    }
+
+    ngx_memzero(&ch, sizeof(ngx_channel_t));
+
+    ch.command = NGX_CMD_NOTIFY;
+    ch.pid = ngx_pid;
+    ch.slot = ngx_process_slot;
+    ch.fd = -1;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                   "notify s:%i pid:%P", slot, ngx_processes[slot].pid);
+
+    return ngx_write_channel(ngx_processes[slot].channel[0], &ch,
+                             sizeof(ngx_channel_t), ngx_cycle->log);
+}
+
+
+/*
+ * an idle connection is passed to a worker process of the new generation,
+ * which handles it as accepted; the caller closes its own descriptor
+ */
+
+ngx_int_t
+ngx_pass_connection(ngx_connection_t *c)
+{
+    ngx_int_t      i, n;
+    ngx_channel_t  ch;
+
+    static ngx_int_t  next;
+
+#if (NGX_BROKEN_SCM_RIGHTS)
+    return NGX_DECLINED;
+#endif
+
+    ngx_memzero(&ch, sizeof(ngx_channel_t));
+
+    ch.command = NGX_CMD_CONNECTION;
+    ch.pid = ngx_pid;
+    ch.slot = ngx_process_slot;
+    ch.fd = c->fd;
+
+    for (n = 0; n < ngx_handoff_last; n++) {
+
+        i = (next + n) % ngx_handoff_last;
+
+        if (!ngx_processes[i].handoff
+            || ngx_processes[i].pid == -1
+            || ngx_processes[i].channel[0] == -1)
+        {
+            continue;
+        }
+
+        if (ngx_write_channel(ngx_processes[i].channel[0], &ch,
+                              sizeof(ngx_channel_t), c->log)
+            == NGX_OK)
+        {
+            ngx_log_debug2(NGX_LOG_DEBUG_CORE, c->log, 0,
+                           "connection passed to s:%i pid:%P",
+                           i, ngx_processes[i].pid);
+
+            next = i + 1;
+            return NGX_OK;
+        }
+    }
+
+    return NGX_DECLINED;
+}
+
+
+/*
+ * handlers are statically allocated by modules, and are usually added
+ * by the init_process() callbacks; a handler is called for messages
+ * of its type broadcasted by other processes
+ */
+
+void
+ngx_subscribe_messages(ngx_message_handler_t *h)
+{
+    ngx_message_handler_t  *m;
+
+    for (m = ngx_message_handlers; m; m = m->next) {
+        if (m == h) {
+            return;
+        }
+    }
+
+    h->next = ngx_message_handlers;
+    ngx_message_handlers = h;
+}
+
+
+/*
+ * a message is sent to all other processes known, including those of
+ * the previous generation; delivery is not guaranteed, as the message
+ * is lost if a channel is full, so messages are to be used for things
+ * like cache invalidations, which otherwise happen on timeouts
+ */
+
+ngx_int_t
+ngx_broadcast_message(ngx_str_t *type, u_char *data, size_t len)
+{
+    u_char         *p;
+    ngx_int_t       s;
+    ngx_channel_t   ch;
+
+    if (type->len + 1 + len > NGX_MESSAGE_LEN) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                      "message of type \"%V\" is too long: %uz",
+                      type, len);
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(&ch, sizeof(ngx_channel_t));
+
+    ch.command = NGX_CMD_MESSAGE;
+    ch.pid = ngx_pid;
+    ch.slot = ngx_process_slot;
+    ch.fd = -1;
+
+    p = ngx_cpymem(ch.data, type->data, type->len);
+    *p++ = '\0';
+    p = ngx_cpymem(p, data, len);
+
+    ch.len = p - ch.data;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                   "broadcast message \"%V\", len:%uz", type, len);
+
+    for (s = 0; s < ngx_last_process; s++) {
+
+        if (s == ngx_process_slot
+            || ngx_processes[s].pid <= 0
+            || ngx_processes[s].channel[0] == -1)
+        {
+            continue;
+        }
+
+        if (ngx_write_channel(ngx_processes[s].channel[0], &ch,
+                              sizeof(ngx_channel_t), ngx_cycle->log)
+            != NGX_OK)
+        {
+            ngx_log_error(NGX_LOG_INFO, ngx_cycle->log, 0,
+                          "message of type \"%V\" to process %P lost",
+                          type, ngx_processes[s].pid);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_message_process(ngx_channel_t *ch, ngx_log_t *log)
+{
+    u_char                 *p;
+    ngx_str_t               type, msg;
+    ngx_message_handler_t  *h;
+
+    p = (ch->len <= NGX_MESSAGE_LEN)
+        ? ngx_strlchr(ch->data, ch->data + ch->len, '\0') : NULL;
+
+    if (p == NULL) {
+        ngx_log_error(NGX_LOG_ALERT, log, 0,
+                      "invalid message from process %P", ch->pid);
+        return;
+    }
+
+    type.len = p - ch->data;
+    type.data = ch->data;
+
+    msg.len = ch->data + ch->len - (p + 1);
+    msg.data = p + 1;
+
+    for (h = ngx_message_handlers; h; h = h->next) {
+        if (h->type.len == type.len
+            && ngx_strncmp(h->type.data, type.data, type.len) == 0)
+        {
+            h->handler(h, &msg);
         }
     }
 }
@@ -1114,6 +1487,12 @@ ngx_cache_manager_process_cycle(ngx_cycle_t *cycle, void *data)
 
     ngx_use_accept_mutex = 0;
 
+    ngx_cache_manager = ctx;
+
+    if (ctx->handler == ngx_cache_manager_process_handler) {
+        ngx_cache_manager_event = &ev;
+    }
+
     ngx_setproctitle(ctx->name);
 
     ngx_add_timer(&ev, ctx->delay);
@@ -1139,22 +1518,29 @@ ngx_cache_manager_process_cycle(ngx_cycle_t *cycle, void *data)
 static void
 ngx_cache_manager_process_handler(ngx_event_t *ev)
 {
-    ngx_uint_t    i;
+    ngx_uint_t    i, k;
     ngx_msec_t    next, n;
     ngx_path_t  **path;
 
     next = 60 * 60 * 1000;
+    k = 0;
 
     path = ngx_cycle->paths.elts;
     for (i = 0; i < ngx_cycle->paths.nelts; i++) {
 
-        if (path[i]->manager) {
-            n = path[i]->manager(path[i]->data);
-
-            next = (n <= next) ? n : next;
+        if (path[i]->manager == NULL) {
+            continue;
+        }
 
-            ngx_time_update();
+        if (k++ % ngx_cache_manager->number != ngx_cache_manager->slot) {
+            continue;
         }
+
+        n = path[i]->manager(path[i]->data);
+
+        next = (n <= next) ? n : next;
+
+        ngx_time_update();
     }
 
     if (next == 0) {
@@ -18,6 +18,14 @@
 #define NGX_CMD_QUIT           3
 #define NGX_CMD_TERMINATE      4
 #define NGX_CMD_REOPEN         5
+#define NGX_CMD_NOTIFY         6
+#define NGX_CMD_HANDOFF        7
+#define NGX_CMD_CONNECTION     8
+#define NGX_CMD_MESSAGE        9
+
+
+/* the maximum length of a message type, a zero byte, and the message */
+#define NGX_MESSAGE_LEN        512
 
 
 #define NGX_PROCESS_SINGLE     0
@@ -31,11 +39,33 @@ typedef struct {
     ngx_event_handler_pt       handler;
     char                      *name;
     ngx_msec_t                 delay;
+    ngx_uint_t                 slot;
+    ngx_uint_t                 number;
 } ngx_cache_manager_ctx_t;
 
 
+typedef void (*ngx_process_notify_pt)(void);
+
+
+typedef struct ngx_message_handler_s  ngx_message_handler_t;
+
+typedef void (*ngx_message_handler_pt)(ngx_message_handler_t *h,
+    ngx_str_t *msg);
+
+struct ngx_message_handler_s {
+    ngx_str_t                  type;
+    ngx_message_handler_pt     handler;
+    void                      *data;
+    ngx_message_handler_t     *next;
+};
+
+
 void ngx_master_process_cycle(ngx_cycle_t *cycle);
 void ngx_single_process_cycle(ngx_cycle_t *cycle);
+ngx_int_t ngx_notify_process(ngx_int_t slot);
+ngx_int_t ngx_pass_connection(ngx_connection_t *c);
+void ngx_subscribe_messages(ngx_message_handler_t *h);
+ngx_int_t ngx_broadcast_message(ngx_str_t *type, u_char *data, size_t len);
 
 
 extern ngx_uint_t      ngx_process;
@@ -57,5 +87,7 @@ extern sig_atomic_t    ngx_reconfigure;
 extern sig_atomic_t    ngx_reopen;
 extern sig_atomic_t    ngx_change_binary;
 
+extern ngx_process_notify_pt  ngx_process_notify_handler;
+
 
 #endif /* _NGX_PROCESS_CYCLE_H_INCLUDED_ */
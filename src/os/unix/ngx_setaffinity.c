@@ -51,3 +51,233 @@ ngx_setaffinity(ngx_cpuset_t *cpu_affinity, ngx_log_t *log)
 }
 
 #endif
+
+
+#if (NGX_HAVE_NUMA)
+
+/*
+ * Node and CPU lists are read from sysfs, in the "0-3,8-11" format,
+ * into bitmaps of the same layout the mempolicy system calls use.
+ */
+
+static ngx_int_t ngx_numa_read_list(char *name, ngx_numa_mask_t *mask,
+    ngx_log_t *log);
+static ngx_int_t ngx_numa_online(ngx_numa_mask_t *mask, ngx_log_t *log);
+
+
+#define ngx_numa_isset(n, mask)                                               \
+    ((mask)->bits[(n) / NGX_NUMA_BITS_PER_LONG]                               \
+     & (1UL << ((n) % NGX_NUMA_BITS_PER_LONG)))
+
+#define ngx_numa_set(n, mask)                                                 \
+    (mask)->bits[(n) / NGX_NUMA_BITS_PER_LONG]                                \
+        |= 1UL << ((n) % NGX_NUMA_BITS_PER_LONG)
+
+
+ngx_int_t
+ngx_numa_setpolicy(ngx_cpuset_t *cpu_affinity, ngx_uint_t policy,
+    ngx_log_t *log)
+{
+    ngx_uint_t       n, i, found;
+    ngx_numa_mask_t  online, local, cpus;
+    char             name[sizeof("/sys/devices/system/node/node/cpulist")
+                          + NGX_INT_T_LEN];
+
+    if (ngx_numa_online(&online, log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(&local, sizeof(ngx_numa_mask_t));
+    found = 0;
+
+    for (n = 0; n < NGX_NUMA_BITS; n++) {
+
+        if (!ngx_numa_isset(n, &online)) {
+            continue;
+        }
+
+        ngx_sprintf((u_char *) name,
+                    "/sys/devices/system/node/node%ui/cpulist%Z", n);
+
+        if (ngx_numa_read_list(name, &cpus, log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        for (i = 0; i < CPU_SETSIZE && i < NGX_NUMA_BITS; i++) {
+            if (CPU_ISSET(i, cpu_affinity) && ngx_numa_isset(i, &cpus)) {
+                ngx_numa_set(n, &local);
+                found = 1;
+
+                ngx_log_error(NGX_LOG_NOTICE, log, 0,
+                              "numa: using node #%ui", n);
+                break;
+            }
+        }
+    }
+
+    if (!found) {
+        ngx_log_error(NGX_LOG_NOTICE, log, 0,
+                      "numa: no node found for the worker CPUs");
+        return NGX_DECLINED;
+    }
+
+    /*
+     * pages the worker already owns, e.g., written after fork() on
+     * the CPU the master process ran on, are moved to the local nodes;
+     * new allocations are local by default once the affinity is set
+     */
+
+    if (syscall(SYS_migrate_pages, 0, NGX_NUMA_BITS + 1,
+                online.bits, local.bits)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "migrate_pages() failed");
+    }
+
+    if (policy != NGX_NUMA_BIND) {
+        return NGX_OK;
+    }
+
+    if (syscall(SYS_set_mempolicy, MPOL_BIND, local.bits,
+                NGX_NUMA_BITS + 1)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "set_mempolicy(MPOL_BIND) failed");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_numa_interleave(void *addr, size_t size, ngx_log_t *log)
+{
+    ngx_numa_mask_t  online;
+
+    if (ngx_numa_online(&online, log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (syscall(SYS_mbind, addr, size, MPOL_INTERLEAVE, online.bits,
+                NGX_NUMA_BITS + 1, 0)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "mbind(MPOL_INTERLEAVE, %uz) failed", size);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_numa_online(ngx_numa_mask_t *mask, ngx_log_t *log)
+{
+    static ngx_uint_t       cached;
+    static ngx_numa_mask_t  online;
+
+    if (!cached) {
+        if (ngx_numa_read_list("/sys/devices/system/node/online", &online,
+                               log)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        cached = 1;
+    }
+
+    *mask = online;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_numa_read_list(char *name, ngx_numa_mask_t *mask, ngx_log_t *log)
+{
+    u_char      *p, *last;
+    ssize_t      n;
+    ngx_fd_t     fd;
+    ngx_uint_t   i;
+    ngx_int_t    from, to;
+    u_char       buf[4096];
+
+    ngx_memzero(mask, sizeof(ngx_numa_mask_t));
+
+    fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_NOTICE, log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", name);
+        return NGX_ERROR;
+    }
+
+    n = read(fd, buf, sizeof(buf) - 1);
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", name);
+    }
+
+    if (n <= 0) {
+        ngx_log_error(NGX_LOG_NOTICE, log, ngx_errno,
+                      "read() \"%s\" failed", name);
+        return NGX_ERROR;
+    }
+
+    p = buf;
+    last = buf + n;
+
+    while (p < last && *p >= '0' && *p <= '9') {
+
+        for (i = 0; p + i < last && p[i] >= '0' && p[i] <= '9'; i++) {
+            /* void */
+        }
+
+        from = ngx_atoi(p, i);
+        p += i;
+        to = from;
+
+        if (p < last && *p == '-') {
+            p++;
+
+            for (i = 0; p + i < last && p[i] >= '0' && p[i] <= '9'; i++) {
+                /* void */
+            }
+
+            to = ngx_atoi(p, i);
+            p += i;
+        }
+
+        if (from == NGX_ERROR || to == NGX_ERROR || to < from) {
+            goto invalid;
+        }
+
+        for ( /* void */ ; from <= to && from < NGX_NUMA_BITS; from++) {
+            ngx_numa_set(from, mask);
+        }
+
+        if (p < last && *p == ',') {
+            p++;
+        }
+    }
+
+    if (p < last && *p != LF) {
+        goto invalid;
+    }
+
+    return NGX_OK;
+
+invalid:
+
+    ngx_log_error(NGX_LOG_NOTICE, log, 0, "invalid list in \"%s\"", name);
+
+    return NGX_ERROR;
+}
+
+#endif
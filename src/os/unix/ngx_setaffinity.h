@@ -34,4 +34,25 @@ typedef uint64_t  ngx_cpuset_t;
 #endif
 
 
+#define NGX_NUMA_OFF     0
+#define NGX_NUMA_LOCAL   1
+#define NGX_NUMA_BIND    2
+
+
+#if (NGX_HAVE_NUMA)
+
+#define NGX_NUMA_BITS           1024
+#define NGX_NUMA_BITS_PER_LONG  (8 * sizeof(unsigned long))
+
+typedef struct {
+    unsigned long  bits[NGX_NUMA_BITS / (8 * sizeof(unsigned long))];
+} ngx_numa_mask_t;
+
+ngx_int_t ngx_numa_setpolicy(ngx_cpuset_t *cpu_affinity, ngx_uint_t policy,
+    ngx_log_t *log);
+ngx_int_t ngx_numa_interleave(void *addr, size_t size, ngx_log_t *log);
+
+#endif
+
+
 #endif /* _NGX_SETAFFINITY_H_INCLUDED_ */
@@ -11,9 +11,32 @@
 
 #if (NGX_HAVE_MAP_ANON)
 
+#if (NGX_HAVE_MAP_HUGETLB)
+static ngx_int_t ngx_shm_alloc_hugetlb(ngx_shm_t *shm);
+static size_t ngx_shm_hugepage_size(ngx_log_t *log);
+#endif
+
+
 ngx_int_t
 ngx_shm_alloc(ngx_shm_t *shm)
 {
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    shm->huge_size = 0;
+
+    if (shm->hugepages && ngx_shm_alloc_hugetlb(shm) == NGX_OK) {
+
+#if (NGX_HAVE_NUMA)
+        if (shm->interleave) {
+            (void) ngx_numa_interleave(shm->addr, shm->huge_size, shm->log);
+        }
+#endif
+
+        return NGX_OK;
+    }
+
+#endif
+
     shm->addr = (u_char *) mmap(NULL, shm->size,
                                 PROT_READ|PROT_WRITE,
                                 MAP_ANON|MAP_SHARED, -1, 0);
@@ -24,16 +47,154 @@ ngx_shm_alloc(ngx_shm_t *shm)
         return NGX_ERROR;
     }
 
+#if (NGX_HAVE_MADV_HUGEPAGE)
+
+    /* transparent huge pages, if enabled for shared memory */
+
+    if (shm->hugepages
+        && madvise((void *) shm->addr, shm->size, MADV_HUGEPAGE) == -1)
+    {
+        ngx_log_error(NGX_LOG_NOTICE, shm->log, ngx_errno,
+                      "madvise(MADV_HUGEPAGE) for \"%V\" failed, ignored",
+                      &shm->name);
+    }
+
+#endif
+
+#if (NGX_HAVE_NUMA)
+
+    /*
+     * the zone is spread over all nodes before it is initialized,
+     * otherwise its pages follow the policy of the process which
+     * touches them first
+     */
+
+    if (shm->interleave) {
+        (void) ngx_numa_interleave(shm->addr, shm->size, shm->log);
+    }
+
+#endif
+
+    return NGX_OK;
+}
+
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+static ngx_int_t
+ngx_shm_alloc_hugetlb(ngx_shm_t *shm)
+{
+    size_t  size, huge;
+
+    huge = ngx_shm_hugepage_size(shm->log);
+
+    if (huge == 0) {
+        return NGX_DECLINED;
+    }
+
+    size = ngx_align(shm->size, huge);
+
+    shm->addr = (u_char *) mmap(NULL, size, PROT_READ|PROT_WRITE,
+                                MAP_ANON|MAP_SHARED|MAP_HUGETLB, -1, 0);
+
+    if (shm->addr == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_NOTICE, shm->log, ngx_errno,
+                      "mmap(MAP_HUGETLB, %uz) for \"%V\" failed, "
+                      "using regular pages", size, &shm->name);
+        return NGX_DECLINED;
+    }
+
+    shm->huge_size = size;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_CORE, shm->log, 0,
+                   "shared zone \"%V\": %uz in %uz byte huge pages",
+                   &shm->name, size, huge);
+
     return NGX_OK;
 }
 
 
+static size_t
+ngx_shm_hugepage_size(ngx_log_t *log)
+{
+    u_char     *p, *last;
+    ssize_t     n;
+    ngx_fd_t    fd;
+    ngx_int_t   size;
+    u_char      buf[4096];
+
+    static size_t  huge;
+
+    if (huge) {
+        return huge;
+    }
+
+    /* the default huge page size, "Hugepagesize:    2048 kB" */
+
+    fd = ngx_open_file("/proc/meminfo", NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_NOTICE, log, ngx_errno,
+                      ngx_open_file_n " \"/proc/meminfo\" failed");
+        return 0;
+    }
+
+    n = read(fd, buf, sizeof(buf) - 1);
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"/proc/meminfo\" failed");
+    }
+
+    if (n <= 0) {
+        return 0;
+    }
+
+    buf[n] = '\0';
+
+    p = (u_char *) ngx_strstr(buf, "Hugepagesize:");
+    if (p == NULL) {
+        return 0;
+    }
+
+    p += sizeof("Hugepagesize:") - 1;
+
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+
+    for (last = p; *last >= '0' && *last <= '9'; last++) { /* void */ }
+
+    size = ngx_atoi(p, last - p);
+
+    if (size <= 0) {
+        return 0;
+    }
+
+    huge = (size_t) size * 1024;
+
+    return huge;
+}
+
+#endif
+
+
 void
 ngx_shm_free(ngx_shm_t *shm)
 {
-    if (munmap((void *) shm->addr, shm->size) == -1) {
+    size_t  size;
+
+    size = shm->size;
+
+#if (NGX_HAVE_MAP_HUGETLB)
+    if (shm->huge_size) {
+        size = shm->huge_size;
+    }
+#endif
+
+    if (munmap((void *) shm->addr, size) == -1) {
         ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
-                      "munmap(%p, %uz) failed", shm->addr, shm->size);
+                      "munmap(%p, %uz) failed", shm->addr, size);
     }
 }
 
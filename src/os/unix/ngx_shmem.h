@@ -19,6 +19,11 @@ typedef struct {
     ngx_str_t    name;
     ngx_log_t   *log;
     ngx_uint_t   exists;   /* unsigned  exists:1;  */
+    ngx_uint_t   hugepages;  /* unsigned  hugepages:1;  */
+    ngx_uint_t   interleave;  /* unsigned  interleave:1;  */
+#if (NGX_HAVE_MAP_HUGETLB)
+    size_t       huge_size;
+#endif
 } ngx_shm_t;
 
 
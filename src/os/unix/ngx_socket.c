@@ -114,3 +114,19 @@ ngx_tcp_push(ngx_socket_t s)
 }
 
 #endif
+
+
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+
+int
+ngx_tcp_notsent_lowat(ngx_socket_t s, size_t lowat)
+{
+    int  notsent_lowat;
+
+    notsent_lowat = (int) lowat;
+
+    return setsockopt(s, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                      (const void *) &notsent_lowat, sizeof(int));
+}
+
+#endif
@@ -47,6 +47,13 @@ int ngx_blocking(ngx_socket_t s);
 
 #endif
 
+#if (NGX_HAVE_SIOCOUTQNSD)
+
+#define ngx_socket_nunsent(s, n)  ioctl(s, SIOCOUTQNSD, n)
+#define ngx_socket_nunsent_n      "ioctl(SIOCOUTQNSD)"
+
+#endif
+
 int ngx_tcp_nopush(ngx_socket_t s);
 int ngx_tcp_push(ngx_socket_t s);
 
@@ -63,6 +70,15 @@ int ngx_tcp_push(ngx_socket_t s);
 #endif
 
 
+#if (NGX_HAVE_TCP_NOTSENT_LOWAT)
+
+int ngx_tcp_notsent_lowat(ngx_socket_t s, size_t lowat);
+
+#define ngx_tcp_notsent_lowat_n  "setsockopt(TCP_NOTSENT_LOWAT)"
+
+#endif
+
+
 #define ngx_shutdown_socket    shutdown
 #define ngx_shutdown_socket_n  "shutdown()"
 
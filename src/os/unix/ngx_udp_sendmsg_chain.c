@@ -384,6 +384,37 @@ ngx_get_srcaddr_cmsg(struct cmsghdr *cmsg, struct sockaddr *local_sockaddr)
 #endif
 
 
+#if (NGX_HAVE_ECN_CMSG)
+
+size_t
+ngx_set_ecn_cmsg(struct cmsghdr *cmsg, struct sockaddr *sockaddr,
+    ngx_uint_t ecn)
+{
+    int  *tos;
+
+#if (NGX_HAVE_INET6)
+    if (sockaddr->sa_family == AF_INET6) {
+        cmsg->cmsg_level = IPPROTO_IPV6;
+        cmsg->cmsg_type = IPV6_TCLASS;
+
+    } else
+#endif
+    {
+        cmsg->cmsg_level = IPPROTO_IP;
+        cmsg->cmsg_type = IP_TOS;
+    }
+
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+
+    tos = (int *) CMSG_DATA(cmsg);
+    *tos = ecn;
+
+    return CMSG_SPACE(sizeof(int));
+}
+
+#endif
+
+
 ssize_t
 ngx_sendmsg(ngx_connection_t *c, struct msghdr *msg, int flags)
 {
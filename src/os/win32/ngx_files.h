@@ -166,6 +166,7 @@ ngx_int_t ngx_file_info(u_char *filename, ngx_file_info_t *fi);
                                           - 116444736000000000) / 10000000)
 
 ngx_int_t ngx_create_file_mapping(ngx_file_mapping_t *fm);
+ngx_int_t ngx_open_file_mapping(ngx_file_mapping_t *fm);
 void ngx_close_file_mapping(ngx_file_mapping_t *fm);
 
 
@@ -253,6 +254,9 @@ ssize_t ngx_write_chain_to_file(ngx_file_t *file, ngx_chain_t *ce,
 ngx_int_t ngx_read_ahead(ngx_fd_t fd, size_t n);
 #define ngx_read_ahead_n            "ngx_read_ahead_n"
 
+#define ngx_prefetch_file(fd, offset, n)  0
+#define ngx_prefetch_file_n         "ngx_prefetch_file_n"
+
 ngx_int_t ngx_directio_on(ngx_fd_t fd);
 #define ngx_directio_on_n           "ngx_directio_on_n"
 
@@ -836,7 +836,7 @@ ngx_worker_process_exit(ngx_cycle_t *cycle)
 
     if (ngx_exiting && !ngx_terminate) {
         c = cycle->connections;
-        for (i = 0; i < cycle->connection_n; i++) {
+        for (i = 0; i < cycle->connection_used; i++) {
             if (c[i].fd != (ngx_socket_t) -1
                 && c[i].read
                 && !c[i].read->accept
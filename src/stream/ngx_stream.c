@@ -629,7 +629,6 @@ static ngx_int_t
 ngx_stream_add_server(ngx_conf_t *cf, ngx_stream_core_srv_conf_t *cscf,
     ngx_stream_conf_addr_t *addr)
 {
-    ngx_uint_t                    i;
     ngx_stream_core_srv_conf_t  **server;
 
     if (addr->servers.elts == NULL) {
@@ -641,14 +640,16 @@ ngx_stream_add_server(ngx_conf_t *cf, ngx_stream_core_srv_conf_t *cscf,
         }
 
     } else {
+
+        /* a duplicate can only be the last server added, see ngx_http.c */
+
         server = addr->servers.elts;
-        for (i = 0; i < addr->servers.nelts; i++) {
-            if (server[i] == cscf) {
-                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                                   "a duplicate listen %V",
-                                   &addr->opt.addr_text);
-                return NGX_ERROR;
-            }
+
+        if (server[addr->servers.nelts - 1] == cscf) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "a duplicate listen %V",
+                               &addr->opt.addr_text);
+            return NGX_ERROR;
         }
     }
 
@@ -1043,6 +1044,7 @@ ngx_stream_add_listening(ngx_conf_t *cf, ngx_stream_conf_addr_t *addr)
 
 #if (NGX_HAVE_REUSEPORT)
     ls->reuseport = addr->opt.reuseport;
+    ls->cpu_steer = addr->opt.cpu_steer;
 #endif
 
     ls->wildcard = addr->opt.wildcard;
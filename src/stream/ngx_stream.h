@@ -55,6 +55,7 @@ typedef struct {
 #endif
     unsigned                       deferred_accept:1;
     unsigned                       reuseport:1;
+    unsigned                       cpu_steer:1;
     unsigned                       so_keepalive:2;
     unsigned                       proxy_protocol:1;
 
@@ -345,6 +346,7 @@ typedef struct {
 
 
 #define NGX_STREAM_WRITE_BUFFERED  0x10
+#define NGX_STREAM_SPLICE_BUFFERED 0x20
 
 
 ngx_int_t ngx_stream_add_listen(ngx_conf_t *cf,
@@ -377,6 +379,10 @@ typedef ngx_int_t (*ngx_stream_filter_pt)(ngx_stream_session_t *s,
     ngx_chain_t *chain, ngx_uint_t from_upstream);
 
 
+ngx_int_t ngx_stream_write_filter(ngx_stream_session_t *s, ngx_chain_t *in,
+    ngx_uint_t from_upstream);
+
+
 extern ngx_stream_filter_pt  ngx_stream_top_filter;
 
 
@@ -10,6 +10,10 @@
 #include <ngx_stream.h>
 
 
+/* longer lists of rules are compiled into radix trees */
+#define NGX_STREAM_ACCESS_TREE_RULES  16
+
+
 typedef struct {
     in_addr_t         mask;
     in_addr_t         addr;
@@ -35,12 +39,14 @@ typedef struct {
 #endif
 
 typedef struct {
-    ngx_array_t      *rules;     /* array of ngx_stream_access_rule_t */
+    ngx_array_t       *rules;     /* array of ngx_stream_access_rule_t */
+    ngx_radix_tree_t  *tree;
 #if (NGX_HAVE_INET6)
-    ngx_array_t      *rules6;    /* array of ngx_stream_access_rule6_t */
+    ngx_array_t       *rules6;    /* array of ngx_stream_access_rule6_t */
+    ngx_radix_tree_t  *tree6;
 #endif
 #if (NGX_HAVE_UNIX_DOMAIN)
-    ngx_array_t      *rules_un;  /* array of ngx_stream_access_rule_un_t */
+    ngx_array_t       *rules_un;  /* array of ngx_stream_access_rule_un_t */
 #endif
 } ngx_stream_access_srv_conf_t;
 
@@ -58,6 +64,10 @@ static ngx_int_t ngx_stream_access_unix(ngx_stream_session_t *s,
 #endif
 static ngx_int_t ngx_stream_access_found(ngx_stream_session_t *s,
     ngx_uint_t deny);
+static ngx_int_t ngx_stream_access_compile(ngx_conf_t *cf,
+    ngx_stream_access_srv_conf_t *ascf);
+static ngx_uint_t ngx_stream_access_shadowed(ngx_radix_tree_t *tree,
+    u_char *key, u_char *mask, ngx_uint_t len);
 static char *ngx_stream_access_rule(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static void *ngx_stream_access_create_srv_conf(ngx_conf_t *cf);
@@ -179,9 +189,23 @@ static ngx_int_t
 ngx_stream_access_inet(ngx_stream_session_t *s,
     ngx_stream_access_srv_conf_t *ascf, in_addr_t addr)
 {
+    uintptr_t                  deny;
     ngx_uint_t                 i;
     ngx_stream_access_rule_t  *rule;
 
+    if (ascf->tree) {
+        deny = ngx_radix32tree_find(ascf->tree, ntohl(addr));
+
+        ngx_log_debug2(NGX_LOG_DEBUG_STREAM, s->connection->log, 0,
+                       "access: %08XD tree: %i", addr, (ngx_int_t) deny);
+
+        if (deny == NGX_RADIX_NO_VALUE) {
+            return NGX_DECLINED;
+        }
+
+        return ngx_stream_access_found(s, deny);
+    }
+
     rule = ascf->rules->elts;
     for (i = 0; i < ascf->rules->nelts; i++) {
 
@@ -204,10 +228,24 @@ static ngx_int_t
 ngx_stream_access_inet6(ngx_stream_session_t *s,
     ngx_stream_access_srv_conf_t *ascf, u_char *p)
 {
+    uintptr_t                   deny;
     ngx_uint_t                  n;
     ngx_uint_t                  i;
     ngx_stream_access_rule6_t  *rule6;
 
+    if (ascf->tree6) {
+        deny = ngx_radix128tree_find(ascf->tree6, p);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_STREAM, s->connection->log, 0,
+                       "access6 tree: %i", (ngx_int_t) deny);
+
+        if (deny == NGX_RADIX_NO_VALUE) {
+            return NGX_DECLINED;
+        }
+
+        return ngx_stream_access_found(s, deny);
+    }
+
     rule6 = ascf->rules6->elts;
     for (i = 0; i < ascf->rules6->nelts; i++) {
 
@@ -421,19 +459,155 @@ ngx_stream_access_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
         && conf->rules_un == NULL
 #endif
     ) {
+        if (ngx_stream_access_compile(cf, prev) != NGX_OK) {
+            return NGX_CONF_ERROR;
+        }
+
         conf->rules = prev->rules;
+        conf->tree = prev->tree;
 #if (NGX_HAVE_INET6)
         conf->rules6 = prev->rules6;
+        conf->tree6 = prev->tree6;
 #endif
 #if (NGX_HAVE_UNIX_DOMAIN)
         conf->rules_un = prev->rules_un;
 #endif
+
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_stream_access_compile(cf, conf) != NGX_OK) {
+        return NGX_CONF_ERROR;
     }
 
     return NGX_CONF_OK;
 }
 
 
+static ngx_int_t
+ngx_stream_access_compile(ngx_conf_t *cf, ngx_stream_access_srv_conf_t *ascf)
+{
+    uint32_t                    key, mask;
+    ngx_uint_t                  i;
+    ngx_stream_access_rule_t   *rule;
+#if (NGX_HAVE_INET6)
+    ngx_stream_access_rule6_t  *rule6;
+#endif
+
+    /*
+     * a rule is not added to the tree if a preceding rule with the same
+     * or a shorter prefix matches all its addresses, so the longest prefix
+     * found by a lookup is that of the first rule matched
+     */
+
+    if (ascf->rules && ascf->tree == NULL
+        && ascf->rules->nelts >= NGX_STREAM_ACCESS_TREE_RULES)
+    {
+        ascf->tree = ngx_radix_tree_create(cf->pool, 0);
+        if (ascf->tree == NULL) {
+            return NGX_ERROR;
+        }
+
+        rule = ascf->rules->elts;
+        for (i = 0; i < ascf->rules->nelts; i++) {
+
+            if (ngx_stream_access_shadowed(ascf->tree,
+                                           (u_char *) &rule[i].addr,
+                                           (u_char *) &rule[i].mask, 4))
+            {
+                continue;
+            }
+
+            key = ntohl(rule[i].addr);
+            mask = ntohl(rule[i].mask);
+
+            if (ngx_radix32tree_insert(ascf->tree, key, mask, rule[i].deny)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+        }
+
+        if (ngx_radix_tree_compile(ascf->tree) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+#if (NGX_HAVE_INET6)
+
+    if (ascf->rules6 && ascf->tree6 == NULL
+        && ascf->rules6->nelts >= NGX_STREAM_ACCESS_TREE_RULES)
+    {
+        ascf->tree6 = ngx_radix_tree_create(cf->pool, 0);
+        if (ascf->tree6 == NULL) {
+            return NGX_ERROR;
+        }
+
+        rule6 = ascf->rules6->elts;
+        for (i = 0; i < ascf->rules6->nelts; i++) {
+
+            if (ngx_stream_access_shadowed(ascf->tree6, rule6[i].addr.s6_addr,
+                                           rule6[i].mask.s6_addr, 16))
+            {
+                continue;
+            }
+
+            if (ngx_radix128tree_insert(ascf->tree6, rule6[i].addr.s6_addr,
+                                        rule6[i].mask.s6_addr, rule6[i].deny)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+        }
+
+        if (ngx_radix_tree_compile(ascf->tree6) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+#endif
+
+    return NGX_OK;
+}
+
+
+static ngx_uint_t
+ngx_stream_access_shadowed(ngx_radix_tree_t *tree, u_char *key, u_char *mask,
+    ngx_uint_t len)
+{
+    u_char             bit;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node;
+
+    /* key and mask are in network byte order */
+
+    i = 0;
+    bit = 0x80;
+    node = tree->root;
+
+    while (node) {
+        if (node->value != NGX_RADIX_NO_VALUE) {
+            return 1;
+        }
+
+        if (i == len || !(mask[i] & bit)) {
+            break;
+        }
+
+        node = (key[i] & bit) ? node->right : node->left;
+
+        bit >>= 1;
+
+        if (bit == 0) {
+            i++;
+            bit = 0x80;
+        }
+    }
+
+    return 0;
+}
+
+
 static ngx_int_t
 ngx_stream_access_init(ngx_conf_t *cf)
 {
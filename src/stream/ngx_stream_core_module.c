@@ -448,6 +448,9 @@ ngx_stream_core_content_phase(ngx_stream_session_t *s,
 
     c->log->action = NULL;
 
+    c->read->low_priority = 0;
+    c->write->low_priority = 0;
+
     cscf = ngx_stream_get_module_srv_conf(s, ngx_stream_core_module);
 
     if (c->type == SOCK_STREAM
@@ -1101,6 +1104,20 @@ ngx_stream_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[i].data, "cpu_steer") == 0) {
+#if (NGX_HAVE_REUSEPORT && NGX_HAVE_INCOMING_CPU)
+            lsopt.cpu_steer = 1;
+            lsopt.set = 1;
+            lsopt.bind = 1;
+            continue;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "cpu_steer is not supported "
+                               "on this platform");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
         if (ngx_strcmp(value[i].data, "ssl") == 0) {
 #if (NGX_STREAM_SSL)
             lsopt.ssl = 1;
@@ -1214,6 +1231,10 @@ ngx_stream_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    if (lsopt.cpu_steer && !lsopt.reuseport) {
+        return "\"cpu_steer\" parameter requires \"reuseport\"";
+    }
+
     if (lsopt.type == SOCK_DGRAM) {
 #if (NGX_HAVE_TCP_FASTOPEN)
         if (lsopt.fastopen != -1) {
@@ -197,7 +197,7 @@ ngx_stream_init_connection(ngx_connection_t *c)
         }
     }
 
-    if (ngx_use_accept_mutex) {
+    if (ngx_use_accept_mutex || rev->low_priority) {
         ngx_post_event(rev, &ngx_posted_events);
         return;
     }
@@ -9,6 +9,10 @@
 #include <ngx_core.h>
 #include <ngx_stream.h>
 
+#if (NGX_THREADS)
+#include <ngx_thread_pool.h>
+#endif
+
 #if (NGX_ZLIB)
 #include <zlib.h>
 #endif
@@ -51,23 +55,55 @@ typedef struct {
     ngx_event_t                 *event;
     ngx_msec_t                   flush;
     ngx_int_t                    gzip;
+
+#if (NGX_THREADS)
+    ngx_thread_pool_t           *thread_pool;
+    ngx_thread_task_t           *free;
+    ngx_uint_t                   tasks;
+    ngx_uint_t                   queue;
+    ngx_uint_t                   drop;       /* unsigned  drop:1 */
+#endif
 } ngx_stream_log_buf_t;
 
 
+#if (NGX_THREADS)
+
+typedef struct {
+    ngx_open_file_t             *file;
+    u_char                      *start;
+    size_t                       len;
+    ngx_fd_t                     fd;
+    ngx_int_t                    gzip;
+    ssize_t                      n;
+    ngx_err_t                    err;
+} ngx_stream_log_thread_ctx_t;
+
+#endif
+
+
 typedef struct {
     ngx_array_t                 *lengths;
     ngx_array_t                 *values;
 } ngx_stream_log_script_t;
 
 
+typedef struct {
+    ngx_uint_t                   low;
+    ngx_uint_t                   high;
+    ngx_uint_t                   rate;       /* in 1/10000 */
+} ngx_stream_log_sample_t;
+
+
 typedef struct {
     ngx_open_file_t             *file;
     ngx_stream_log_script_t     *script;
     time_t                       disk_full_time;
     time_t                       error_log_time;
     ngx_syslog_peer_t           *syslog_peer;
+    ngx_log_ring_t              *ring;
     ngx_stream_log_fmt_t        *format;
     ngx_stream_complex_value_t  *filter;
+    ngx_array_t                 *sample;     /* of ngx_stream_log_sample_t */
 } ngx_stream_log_t;
 
 
@@ -94,6 +130,8 @@ typedef struct {
 #define NGX_STREAM_LOG_ESCAPE_NONE     2
 
 
+static ngx_uint_t ngx_stream_log_sampled(ngx_stream_session_t *s,
+    ngx_array_t *sample);
 static void ngx_stream_log_write(ngx_stream_session_t *s, ngx_stream_log_t *log,
     u_char *buf, size_t len);
 static ssize_t ngx_stream_log_script_write(ngx_stream_session_t *s,
@@ -110,6 +148,13 @@ static void ngx_stream_log_gzip_free(void *opaque, void *address);
 static void ngx_stream_log_flush(ngx_open_file_t *file, ngx_log_t *log);
 static void ngx_stream_log_flush_handler(ngx_event_t *ev);
 
+#if (NGX_THREADS)
+static ngx_int_t ngx_stream_log_thread_flush(ngx_open_file_t *file,
+    ngx_log_t *log);
+static void ngx_stream_log_thread_handler(void *data, ngx_log_t *log);
+static void ngx_stream_log_thread_event_handler(ngx_event_t *ev);
+#endif
+
 static ngx_int_t ngx_stream_log_variable_compile(ngx_conf_t *cf,
     ngx_stream_log_op_t *op, ngx_str_t *value, ngx_uint_t escape);
 static size_t ngx_stream_log_variable_getlen(ngx_stream_session_t *s,
@@ -133,6 +178,8 @@ static char *ngx_stream_log_merge_srv_conf(ngx_conf_t *cf, void *parent,
     void *child);
 static char *ngx_stream_log_set_log(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_stream_log_set_sample(ngx_conf_t *cf, ngx_stream_log_t *log,
+    ngx_str_t *value);
 static char *ngx_stream_log_set_format(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_stream_log_compile_format(ngx_conf_t *cf,
@@ -206,6 +253,7 @@ ngx_stream_log_handler(ngx_stream_session_t *s)
     ngx_str_t                   val;
     ngx_uint_t                  i, l;
     ngx_stream_log_t           *log;
+    ngx_atomic_uint_t           pos;
     ngx_stream_log_op_t        *op;
     ngx_stream_log_buf_t       *buffer;
     ngx_stream_log_srv_conf_t  *lscf;
@@ -222,6 +270,10 @@ ngx_stream_log_handler(ngx_stream_session_t *s)
     log = lscf->logs->elts;
     for (l = 0; l < lscf->logs->nelts; l++) {
 
+        if (log[l].sample && !ngx_stream_log_sampled(s, log[l].sample)) {
+            continue;
+        }
+
         if (log[l].filter) {
             if (ngx_stream_complex_value(s, log[l].filter, &val) != NGX_OK) {
                 return NGX_ERROR;
@@ -267,6 +319,24 @@ ngx_stream_log_handler(ngx_stream_session_t *s)
             goto alloc_line;
         }
 
+        if (log[l].ring) {
+
+            line = ngx_log_ring_reserve(log[l].ring, len, &pos);
+            if (line == NULL) {
+                continue;
+            }
+
+            p = line;
+
+            for (i = 0; i < log[l].format->ops->nelts; i++) {
+                p = op[i].run(s, p, &op[i]);
+            }
+
+            ngx_log_ring_commit(log[l].ring, pos, p - line);
+
+            continue;
+        }
+
         len += NGX_LINEFEED_SIZE;
 
         buffer = log[l].file ? log[l].file->data : NULL;
@@ -275,10 +345,18 @@ ngx_stream_log_handler(ngx_stream_session_t *s)
 
             if (len > (size_t) (buffer->last - buffer->pos)) {
 
-                ngx_stream_log_write(s, &log[l], buffer->start,
-                                     buffer->pos - buffer->start);
+#if (NGX_THREADS)
+                if (buffer->thread_pool == NULL
+                    || ngx_stream_log_thread_flush(log[l].file,
+                                                   s->connection->log)
+                       != NGX_OK)
+#endif
+                {
+                    ngx_stream_log_write(s, &log[l], buffer->start,
+                                         buffer->pos - buffer->start);
 
-                buffer->pos = buffer->start;
+                    buffer->pos = buffer->start;
+                }
             }
 
             if (len <= (size_t) (buffer->last - buffer->pos)) {
@@ -350,6 +428,28 @@ ngx_stream_log_handler(ngx_stream_session_t *s)
 }
 
 
+static ngx_uint_t
+ngx_stream_log_sampled(ngx_stream_session_t *s, ngx_array_t *sample)
+{
+    ngx_uint_t                i;
+    ngx_stream_log_sample_t  *ls;
+
+    ls = sample->elts;
+
+    for (i = 0; i < sample->nelts; i++) {
+        if (s->status >= ls[i].low && s->status <= ls[i].high) {
+            break;
+        }
+    }
+
+    if (i == sample->nelts || ls[i].rate == 10000) {
+        return 1;
+    }
+
+    return (ngx_uint_t) ngx_random() % 10000 < ls[i].rate;
+}
+
+
 static void
 ngx_stream_log_write(ngx_stream_session_t *s, ngx_stream_log_t *log,
     u_char *buf, size_t len)
@@ -655,13 +755,198 @@ ngx_stream_log_flush(ngx_open_file_t *file, ngx_log_t *log)
 static void
 ngx_stream_log_flush_handler(ngx_event_t *ev)
 {
+#if (NGX_THREADS)
+    ngx_open_file_t       *file;
+    ngx_stream_log_buf_t  *buffer;
+#endif
+
     ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ev->log, 0,
                    "stream log buffer flush handler");
 
+#if (NGX_THREADS)
+
+    file = ev->data;
+    buffer = file->data;
+
+    if (buffer->thread_pool
+        && ngx_stream_log_thread_flush(file, ev->log) == NGX_OK)
+    {
+        return;
+    }
+
+#endif
+
     ngx_stream_log_flush(ev->data, ev->log);
 }
 
 
+#if (NGX_THREADS)
+
+static ngx_int_t
+ngx_stream_log_thread_flush(ngx_open_file_t *file, ngx_log_t *log)
+{
+    u_char                       *p;
+    size_t                        len, size;
+    ngx_fd_t                      fd;
+    ngx_thread_task_t            *task;
+    ngx_stream_log_buf_t         *buffer;
+    ngx_stream_log_thread_ctx_t  *ctx;
+
+    buffer = file->data;
+
+    len = buffer->pos - buffer->start;
+    size = buffer->last - buffer->start;
+
+    if (len == 0) {
+        return NGX_OK;
+    }
+
+    task = buffer->free;
+
+    if (task) {
+        buffer->free = task->next;
+
+    } else if (buffer->tasks < buffer->queue) {
+
+        /* each task owns a spare buffer which is swapped with the full one */
+
+        task = ngx_thread_task_alloc(ngx_cycle->pool,
+                                     sizeof(ngx_stream_log_thread_ctx_t)
+                                     + size);
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        ctx = task->ctx;
+
+        ctx->file = file;
+        ctx->start = (u_char *) ctx + sizeof(ngx_stream_log_thread_ctx_t);
+        ctx->gzip = buffer->gzip;
+
+        task->handler = ngx_stream_log_thread_handler;
+        task->event.data = task;
+        task->event.handler = ngx_stream_log_thread_event_handler;
+        task->event.log = ngx_cycle->log;
+
+        buffer->tasks++;
+
+    } else if (buffer->drop) {
+        ngx_log_error(NGX_LOG_WARN, log, 0,
+                      "aio queue of access log \"%s\" is full, "
+                      "%uz bytes dropped", file->name.data, len);
+        goto done;
+
+    } else {
+        return NGX_DECLINED;
+    }
+
+    /*
+     * the descriptor is duplicated, so the file can be safely
+     * reopened while the task is in progress
+     */
+
+    fd = dup(file->fd);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "dup() \"%s\" failed", file->name.data);
+        goto failed;
+    }
+
+    ctx = task->ctx;
+
+    p = ctx->start;
+
+    ctx->start = buffer->start;
+    ctx->len = len;
+    ctx->fd = fd;
+
+    if (ngx_thread_task_post(buffer->thread_pool, task) != NGX_OK) {
+        ctx->start = p;
+        (void) ngx_close_file(fd);
+        goto failed;
+    }
+
+    buffer->start = p;
+    buffer->last = p + size;
+
+done:
+
+    buffer->pos = buffer->start;
+
+    if (buffer->event && buffer->event->timer_set) {
+        ngx_del_timer(buffer->event);
+    }
+
+    return NGX_OK;
+
+failed:
+
+    task->next = buffer->free;
+    buffer->free = task;
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_stream_log_thread_handler(void *data, ngx_log_t *log)
+{
+    ngx_stream_log_thread_ctx_t *ctx = data;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_STREAM, log, 0,
+                   "stream log thread handler: %uz", ctx->len);
+
+#if (NGX_ZLIB)
+    if (ctx->gzip) {
+        ctx->n = ngx_stream_log_gzip(ctx->fd, ctx->start, ctx->len,
+                                     ctx->gzip, log);
+    } else {
+        ctx->n = ngx_write_fd(ctx->fd, ctx->start, ctx->len);
+    }
+#else
+    ctx->n = ngx_write_fd(ctx->fd, ctx->start, ctx->len);
+#endif
+
+    ctx->err = (ctx->n == -1) ? ngx_errno : 0;
+
+    (void) ngx_close_file(ctx->fd);
+}
+
+
+static void
+ngx_stream_log_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_thread_task_t            *task;
+    ngx_stream_log_buf_t         *buffer;
+    ngx_stream_log_thread_ctx_t  *ctx;
+
+    task = ev->data;
+    ctx = task->ctx;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_STREAM, ev->log, 0,
+                   "stream log thread: %z", ctx->n);
+
+    if (ctx->n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, ctx->err,
+                      ngx_write_fd_n " to \"%s\" failed",
+                      ctx->file->name.data);
+
+    } else if ((size_t) ctx->n != ctx->len) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, 0,
+                      ngx_write_fd_n " to \"%s\" was incomplete: %z of %uz",
+                      ctx->file->name.data, ctx->n, ctx->len);
+    }
+
+    buffer = ctx->file->data;
+
+    task->next = buffer->free;
+    buffer->free = task;
+}
+
+#endif
+
+
 static u_char *
 ngx_stream_log_copy_short(ngx_stream_session_t *s, u_char *buf,
     ngx_stream_log_op_t *op)
@@ -976,6 +1261,11 @@ ngx_stream_log_set_log(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ngx_uint_t                           i, n;
     ngx_msec_t                           flush;
     ngx_str_t                           *value, name, s;
+#if (NGX_THREADS)
+    ngx_int_t                            queue;
+    ngx_uint_t                           drop;
+    ngx_thread_pool_t                   *tp;
+#endif
     ngx_stream_log_t                    *log;
     ngx_syslog_peer_t                   *peer;
     ngx_stream_log_buf_t                *buffer;
@@ -1030,6 +1320,16 @@ ngx_stream_log_set_log(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         goto process_formats;
     }
 
+    if (ngx_strncmp(value[1].data, "shm:", 4) == 0) {
+
+        log->ring = ngx_log_ring_process_conf(cf, &value[1]);
+        if (log->ring == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        goto process_formats;
+    }
+
     n = ngx_stream_script_variables_count(&value[1]);
 
     if (n == 0) {
@@ -1094,6 +1394,12 @@ process_formats:
     flush = 0;
     gzip = 0;
 
+#if (NGX_THREADS)
+    tp = NULL;
+    queue = 4;
+    drop = 0;
+#endif
+
     for (i = 3; i < cf->args->nelts; i++) {
 
         if (ngx_strncmp(value[i].data, "buffer=", 7) == 0) {
@@ -1159,6 +1465,74 @@ process_formats:
 #endif
         }
 
+        if (ngx_strncmp(value[i].data, "aio=", 4) == 0) {
+#if (NGX_THREADS)
+            s.len = value[i].len - 4;
+            s.data = value[i].data + 4;
+
+            if (s.len >= 7 && ngx_strncmp(s.data, "threads", 7) == 0
+                && (s.len == 7 || s.data[7] == ':'))
+            {
+                if (s.len == 7) {
+                    tp = ngx_thread_pool_add(cf, NULL);
+
+                } else {
+                    s.len -= 8;
+                    s.data += 8;
+
+                    tp = ngx_thread_pool_add(cf, &s);
+                }
+
+                if (tp == NULL) {
+                    return NGX_CONF_ERROR;
+                }
+
+                if (size == 0) {
+                    size = 64 * 1024;
+                }
+
+                continue;
+            }
+
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid aio \"%V\"", &s);
+            return NGX_CONF_ERROR;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"aio\" requires threads support, "
+                               "use the \"--with-threads\" "
+                               "configuration parameter");
+            return NGX_CONF_ERROR;
+#endif
+        }
+
+#if (NGX_THREADS)
+
+        if (ngx_strncmp(value[i].data, "aio_queue=", 10) == 0) {
+            queue = ngx_atoi(value[i].data + 10, value[i].len - 10);
+
+            if (queue == NGX_ERROR || queue == 0) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid aio queue size \"%V\"",
+                                   &value[i]);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "aio_overflow=drop") == 0) {
+            drop = 1;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "aio_overflow=block") == 0) {
+            drop = 0;
+            continue;
+        }
+
+#endif
+
         if (ngx_strncmp(value[i].data, "if=", 3) == 0) {
             s.len = value[i].len - 3;
             s.data = value[i].data + 3;
@@ -1182,6 +1556,17 @@ process_formats:
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "sample=", 7) == 0) {
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            if (ngx_stream_log_set_sample(cf, log, &s) != NGX_CONF_OK) {
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                            "invalid parameter \"%V\"", &value[i]);
         return NGX_CONF_ERROR;
@@ -1208,12 +1593,24 @@ process_formats:
             return NGX_CONF_ERROR;
         }
 
+        if (log->ring) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "logs to shared memory cannot be buffered");
+            return NGX_CONF_ERROR;
+        }
+
         if (log->file->data) {
             buffer = log->file->data;
 
             if (buffer->last - buffer->start != size
                 || buffer->flush != flush
-                || buffer->gzip != gzip)
+                || buffer->gzip != gzip
+#if (NGX_THREADS)
+                || buffer->thread_pool != tp
+                || (tp && (buffer->queue != (ngx_uint_t) queue
+                           || buffer->drop != drop))
+#endif
+               )
             {
                 ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                                    "access_log \"%V\" already defined "
@@ -1254,6 +1651,12 @@ process_formats:
 
         buffer->gzip = gzip;
 
+#if (NGX_THREADS)
+        buffer->thread_pool = tp;
+        buffer->queue = queue;
+        buffer->drop = drop;
+#endif
+
         log->file->flush = ngx_stream_log_flush;
         log->file->data = buffer;
     }
@@ -1262,6 +1665,111 @@ process_formats:
 }
 
 
+static char *
+ngx_stream_log_set_sample(ngx_conf_t *cf, ngx_stream_log_t *log,
+    ngx_str_t *value)
+{
+    u_char                   *p, *last, *colon, *end;
+    ngx_int_t                 n;
+    ngx_str_t                 s;
+    ngx_uint_t                rate, dflt;
+    ngx_stream_log_sample_t  *ls;
+
+    if (log->sample) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate sample parameter \"%V\"", value);
+        return NGX_CONF_ERROR;
+    }
+
+    log->sample = ngx_array_create(cf->pool, 4,
+                                   sizeof(ngx_stream_log_sample_t));
+    if (log->sample == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    dflt = 10000;
+
+    p = value->data;
+    last = value->data + value->len;
+
+    while (p < last) {
+
+        end = ngx_strlchr(p, last, ',');
+        if (end == NULL) {
+            end = last;
+        }
+
+        colon = ngx_strlchr(p, end, ':');
+
+        s.data = colon ? colon + 1 : p;
+        s.len = end - s.data;
+
+        if (s.len < 2 || s.data[s.len - 1] != '%') {
+            goto invalid;
+        }
+
+        n = ngx_atofp(s.data, s.len - 1, 2);
+
+        if (n == NGX_ERROR || n > 10000) {
+            goto invalid;
+        }
+
+        rate = n;
+
+        if (colon == NULL) {
+            dflt = rate;
+            p = end + 1;
+            continue;
+        }
+
+        ls = ngx_array_push(log->sample);
+        if (ls == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        ls->rate = rate;
+
+        if (colon - p == 3 && p[1] == 'x' && p[2] == 'x'
+            && p[0] >= '1' && p[0] <= '5')
+        {
+            ls->low = (p[0] - '0') * 100;
+            ls->high = ls->low + 99;
+
+        } else {
+            n = ngx_atoi(p, colon - p);
+
+            if (n < 100 || n > 599) {
+                goto invalid;
+            }
+
+            ls->low = n;
+            ls->high = n;
+        }
+
+        p = end + 1;
+    }
+
+    /* the default rate applies to all other statuses */
+
+    ls = ngx_array_push(log->sample);
+    if (ls == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ls->low = 0;
+    ls->high = NGX_MAX_UINT32_VALUE;
+    ls->rate = dflt;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid sample rate \"%V\"", value);
+    return NGX_CONF_ERROR;
+}
+
+
 static char *
 ngx_stream_log_set_format(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -0,0 +1,476 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_stream.h>
+
+
+#define NGX_STREAM_PROTOCOL_PREREAD_METHOD_LEN  16
+
+
+typedef struct {
+    ngx_flag_t      enabled;
+} ngx_stream_protocol_preread_srv_conf_t;
+
+
+typedef struct {
+    ngx_str_t       protocol;
+    ngx_str_t       host;
+} ngx_stream_protocol_preread_ctx_t;
+
+
+typedef struct {
+    ngx_str_t       signature;
+    ngx_str_t       protocol;
+} ngx_stream_protocol_preread_signature_t;
+
+
+static ngx_int_t ngx_stream_protocol_preread_handler(ngx_stream_session_t *s);
+static ngx_int_t ngx_stream_protocol_preread_parse(
+    ngx_stream_protocol_preread_ctx_t *ctx, u_char *pos, u_char *last);
+static ngx_int_t ngx_stream_protocol_preread_parse_http(
+    ngx_stream_protocol_preread_ctx_t *ctx, u_char *pos, u_char *last);
+static ngx_int_t ngx_stream_protocol_preread_host(ngx_stream_session_t *s,
+    ngx_stream_protocol_preread_ctx_t *ctx);
+static ngx_int_t ngx_stream_protocol_preread_protocol_variable(
+    ngx_stream_session_t *s, ngx_stream_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_stream_protocol_preread_http_host_variable(
+    ngx_stream_session_t *s, ngx_stream_variable_value_t *v, uintptr_t data);
+static ngx_int_t ngx_stream_protocol_preread_add_variables(ngx_conf_t *cf);
+static void *ngx_stream_protocol_preread_create_srv_conf(ngx_conf_t *cf);
+static char *ngx_stream_protocol_preread_merge_srv_conf(ngx_conf_t *cf,
+    void *parent, void *child);
+static ngx_int_t ngx_stream_protocol_preread_init(ngx_conf_t *cf);
+
+
+static ngx_command_t  ngx_stream_protocol_preread_commands[] = {
+
+    { ngx_string("protocol_preread"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      offsetof(ngx_stream_protocol_preread_srv_conf_t, enabled),
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_stream_module_t  ngx_stream_protocol_preread_module_ctx = {
+    ngx_stream_protocol_preread_add_variables,   /* preconfiguration */
+    ngx_stream_protocol_preread_init,            /* postconfiguration */
+
+    NULL,                                        /* create main conf */
+    NULL,                                        /* init main conf */
+
+    ngx_stream_protocol_preread_create_srv_conf, /* create server conf */
+    ngx_stream_protocol_preread_merge_srv_conf   /* merge server conf */
+};
+
+
+ngx_module_t  ngx_stream_protocol_preread_module = {
+    NGX_MODULE_V1,
+    &ngx_stream_protocol_preread_module_ctx,     /* module context */
+    ngx_stream_protocol_preread_commands,        /* module directives */
+    NGX_STREAM_MODULE,                           /* module type */
+    NULL,                                        /* init master */
+    NULL,                                        /* init module */
+    NULL,                                        /* init process */
+    NULL,                                        /* init thread */
+    NULL,                                        /* exit thread */
+    NULL,                                        /* exit process */
+    NULL,                                        /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_stream_variable_t  ngx_stream_protocol_preread_vars[] = {
+
+    { ngx_string("preread_protocol"), NULL,
+      ngx_stream_protocol_preread_protocol_variable, 0, 0, 0 },
+
+    { ngx_string("preread_http_host"), NULL,
+      ngx_stream_protocol_preread_http_host_variable, 0, 0, 0 },
+
+      ngx_stream_null_variable
+};
+
+
+static ngx_stream_protocol_preread_signature_t
+    ngx_stream_protocol_preread_signatures[] =
+{
+    { ngx_string("SSH-"), ngx_string("ssh") },
+    { ngx_string("PROXY "), ngx_string("proxy") },
+    { ngx_string("\r\n\r\n\0\r\nQUIT\n"), ngx_string("proxy") },
+    { ngx_string("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"), ngx_string("http2") },
+    { ngx_null_string, ngx_null_string }
+};
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_handler(ngx_stream_session_t *s)
+{
+    ngx_int_t                                rc;
+    ngx_connection_t                        *c;
+    ngx_stream_protocol_preread_ctx_t       *ctx;
+    ngx_stream_protocol_preread_srv_conf_t  *ppcf;
+
+    c = s->connection;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_STREAM, c->log, 0,
+                   "protocol preread handler");
+
+    ppcf = ngx_stream_get_module_srv_conf(s,
+                                          ngx_stream_protocol_preread_module);
+
+    if (!ppcf->enabled) {
+        return NGX_DECLINED;
+    }
+
+    if (c->type != SOCK_STREAM) {
+        return NGX_DECLINED;
+    }
+
+    if (c->buffer == NULL) {
+        return NGX_AGAIN;
+    }
+
+    ctx = ngx_stream_get_module_ctx(s, ngx_stream_protocol_preread_module);
+    if (ctx == NULL) {
+        ctx = ngx_pcalloc(c->pool, sizeof(ngx_stream_protocol_preread_ctx_t));
+        if (ctx == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_stream_set_ctx(s, ctx, ngx_stream_protocol_preread_module);
+    }
+
+    /*
+     * the data is parsed from the start of the buffer on each call,
+     * as it is not consumed while peeking
+     */
+
+    rc = ngx_stream_protocol_preread_parse(ctx, c->buffer->pos,
+                                           c->buffer->last);
+
+    if (rc == NGX_AGAIN) {
+
+        if (c->buffer->last != c->buffer->end) {
+            return NGX_AGAIN;
+        }
+
+        /* the buffer is full, but HTTP headers are not complete yet */
+
+        ngx_log_debug0(NGX_LOG_DEBUG_STREAM, c->log, 0,
+                       "protocol preread: no host in buffer");
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_STREAM, c->log, 0,
+                   "protocol preread: \"%V\" host: \"%V\"",
+                   &ctx->protocol, &ctx->host);
+
+    if (ngx_stream_protocol_preread_host(s, ctx) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    /* let other preread handlers, such as ssl_preread, see the data */
+
+    return NGX_DECLINED;
+}
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_parse(ngx_stream_protocol_preread_ctx_t *ctx,
+    u_char *pos, u_char *last)
+{
+    size_t                                    n;
+    ngx_stream_protocol_preread_signature_t  *sig;
+
+    if (pos == last) {
+        return NGX_AGAIN;
+    }
+
+    /* TLS handshake record */
+
+    if (pos[0] == 0x16) {
+        ngx_str_set(&ctx->protocol, "tls");
+        return NGX_OK;
+    }
+
+    for (sig = ngx_stream_protocol_preread_signatures;
+         sig->signature.len;
+         sig++)
+    {
+        n = ngx_min(sig->signature.len, (size_t) (last - pos));
+
+        if (ngx_memcmp(pos, sig->signature.data, n) != 0) {
+            continue;
+        }
+
+        if (n < sig->signature.len) {
+            return NGX_AGAIN;
+        }
+
+        ctx->protocol = sig->protocol;
+        return NGX_OK;
+    }
+
+    return ngx_stream_protocol_preread_parse_http(ctx, pos, last);
+}
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_parse_http(ngx_stream_protocol_preread_ctx_t *ctx,
+    u_char *pos, u_char *last)
+{
+    u_char  *p, *eol, *value;
+
+    /* method */
+
+    for (p = pos; p < last; p++) {
+
+        if (*p >= 'A' && *p <= 'Z') {
+            if (p - pos == NGX_STREAM_PROTOCOL_PREREAD_METHOD_LEN) {
+                return NGX_DECLINED;
+            }
+
+            continue;
+        }
+
+        if (*p == ' ' && p != pos) {
+            break;
+        }
+
+        return NGX_DECLINED;
+    }
+
+    if (p == last) {
+        return NGX_AGAIN;
+    }
+
+    /* the rest of the request line */
+
+    eol = ngx_strlchr(p, last, LF);
+    if (eol == NULL) {
+        return NGX_AGAIN;
+    }
+
+    p = eol;
+
+    if (p > pos && *(p - 1) == CR) {
+        p--;
+    }
+
+    if (p - pos < (ssize_t) sizeof(" HTTP/1.x") - 1
+        || ngx_strncmp(p - (sizeof(" HTTP/1.x") - 1), " HTTP/1.",
+                       sizeof(" HTTP/1.") - 1)
+           != 0)
+    {
+        return NGX_DECLINED;
+    }
+
+    ngx_str_set(&ctx->protocol, "http");
+
+    /* header lines, until the "Host" header or the end of headers */
+
+    for (p = eol + 1; /* void */; p = eol + 1) {
+
+        eol = ngx_strlchr(p, last, LF);
+        if (eol == NULL) {
+            return NGX_AGAIN;
+        }
+
+        if (p == eol || (p + 1 == eol && *p == CR)) {
+            return NGX_OK;
+        }
+
+        if (eol - p < (ssize_t) sizeof("Host:") - 1
+            || ngx_strncasecmp(p, (u_char *) "Host:", sizeof("Host:") - 1)
+               != 0)
+        {
+            continue;
+        }
+
+        value = p + sizeof("Host:") - 1;
+
+        while (value < eol && (*value == ' ' || *value == '\t')) {
+            value++;
+        }
+
+        p = eol;
+
+        while (p > value
+               && (*(p - 1) == CR || *(p - 1) == ' ' || *(p - 1) == '\t'))
+        {
+            p--;
+        }
+
+        ctx->host.len = p - value;
+        ctx->host.data = value;
+
+        return NGX_OK;
+    }
+}
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_host(ngx_stream_session_t *s,
+    ngx_stream_protocol_preread_ctx_t *ctx)
+{
+    ngx_int_t                    rc;
+    ngx_connection_t            *c;
+    ngx_stream_core_srv_conf_t  *cscf;
+
+    c = s->connection;
+
+    if (ctx->host.len == 0) {
+        return NGX_OK;
+    }
+
+    /* the buffer may be overwritten on later reads, so the host is copied */
+
+    rc = ngx_stream_validate_host(&ctx->host, c->pool, 1);
+
+    if (rc == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    if (rc == NGX_DECLINED) {
+        ngx_str_null(&ctx->host);
+        return NGX_OK;
+    }
+
+    rc = ngx_stream_find_virtual_server(s, &ctx->host, &cscf);
+
+    if (rc == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    if (rc == NGX_DECLINED) {
+        return NGX_OK;
+    }
+
+    s->srv_conf = cscf->ctx->srv_conf;
+
+    ngx_set_connection_log(c, cscf->error_log);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_protocol_variable(ngx_stream_session_t *s,
+    ngx_variable_value_t *v, uintptr_t data)
+{
+    ngx_stream_protocol_preread_ctx_t  *ctx;
+
+    ctx = ngx_stream_get_module_ctx(s, ngx_stream_protocol_preread_module);
+
+    if (ctx == NULL) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->len = ctx->protocol.len;
+    v->data = ctx->protocol.data;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_http_host_variable(ngx_stream_session_t *s,
+    ngx_variable_value_t *v, uintptr_t data)
+{
+    ngx_stream_protocol_preread_ctx_t  *ctx;
+
+    ctx = ngx_stream_get_module_ctx(s, ngx_stream_protocol_preread_module);
+
+    if (ctx == NULL) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->len = ctx->host.len;
+    v->data = ctx->host.data;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_add_variables(ngx_conf_t *cf)
+{
+    ngx_stream_variable_t  *var, *v;
+
+    for (v = ngx_stream_protocol_preread_vars; v->name.len; v++) {
+        var = ngx_stream_add_variable(cf, &v->name, v->flags);
+        if (var == NULL) {
+            return NGX_ERROR;
+        }
+
+        var->get_handler = v->get_handler;
+        var->data = v->data;
+    }
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_stream_protocol_preread_create_srv_conf(ngx_conf_t *cf)
+{
+    ngx_stream_protocol_preread_srv_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool,
+                       sizeof(ngx_stream_protocol_preread_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->enabled = NGX_CONF_UNSET;
+
+    return conf;
+}
+
+
+static char *
+ngx_stream_protocol_preread_merge_srv_conf(ngx_conf_t *cf, void *parent,
+    void *child)
+{
+    ngx_stream_protocol_preread_srv_conf_t *prev = parent;
+    ngx_stream_protocol_preread_srv_conf_t *conf = child;
+
+    ngx_conf_merge_value(conf->enabled, prev->enabled, 0);
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_protocol_preread_init(ngx_conf_t *cf)
+{
+    ngx_stream_handler_pt        *h;
+    ngx_stream_core_main_conf_t  *cmcf;
+
+    cmcf = ngx_stream_conf_get_module_main_conf(cf, ngx_stream_core_module);
+
+    h = ngx_array_push(&cmcf->phases[NGX_STREAM_PREREAD_PHASE].handlers);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    *h = ngx_stream_protocol_preread_handler;
+
+    return NGX_OK;
+}
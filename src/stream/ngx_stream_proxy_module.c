@@ -19,6 +19,12 @@ typedef struct {
 } ngx_stream_upstream_local_t;
 
 
+typedef struct {
+    ngx_uint_t                       type;
+    ngx_stream_complex_value_t       value;
+} ngx_stream_proxy_tlv_t;
+
+
 typedef struct {
     ngx_msec_t                       connect_timeout;
     ngx_msec_t                       timeout;
@@ -31,7 +37,12 @@ typedef struct {
     ngx_uint_t                       next_upstream_tries;
     ngx_flag_t                       next_upstream;
     ngx_flag_t                       proxy_protocol;
+    ngx_uint_t                       proxy_protocol_version;
+    ngx_array_t                     *proxy_protocol_tlvs;
     ngx_flag_t                       half_close;
+#if (NGX_HAVE_SPLICE)
+    ngx_flag_t                       splice;
+#endif
     ngx_stream_upstream_local_t     *local;
     ngx_flag_t                       socket_keepalive;
 
@@ -73,11 +84,19 @@ static void ngx_stream_proxy_downstream_handler(ngx_event_t *ev);
 static void ngx_stream_proxy_process_connection(ngx_event_t *ev,
     ngx_uint_t from_upstream);
 static void ngx_stream_proxy_connect_handler(ngx_event_t *ev);
+static ngx_int_t ngx_stream_proxy_protocol_header(ngx_stream_session_t *s,
+    ngx_str_t *header);
 static ngx_int_t ngx_stream_proxy_test_connect(ngx_connection_t *c);
 static void ngx_stream_proxy_process(ngx_stream_session_t *s,
     ngx_uint_t from_upstream, ngx_uint_t do_write);
 static ngx_int_t ngx_stream_proxy_test_finalize(ngx_stream_session_t *s,
     ngx_uint_t from_upstream);
+#if (NGX_HAVE_SPLICE)
+static ngx_int_t ngx_stream_proxy_splice_init(ngx_stream_session_t *s);
+static ngx_int_t ngx_stream_proxy_splice(ngx_stream_session_t *s,
+    ngx_uint_t from_upstream);
+static void ngx_stream_proxy_splice_cleanup(void *data);
+#endif
 static void ngx_stream_proxy_next_upstream(ngx_stream_session_t *s);
 static void ngx_stream_proxy_finalize(ngx_stream_session_t *s, ngx_uint_t rc);
 static u_char *ngx_stream_proxy_log_error(ngx_log_t *log, u_char *buf,
@@ -90,6 +109,8 @@ static char *ngx_stream_proxy_pass(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_stream_proxy_bind(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_stream_proxy_protocol_tlv(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 #if (NGX_STREAM_SSL)
 
@@ -125,6 +146,11 @@ static ngx_conf_post_t  ngx_stream_proxy_ssl_conf_command_post =
 #endif
 
 
+static ngx_conf_num_bounds_t  ngx_stream_proxy_protocol_version_bounds = {
+    ngx_conf_check_num_bounds, 1, 2
+};
+
+
 static ngx_conf_deprecated_t  ngx_conf_deprecated_proxy_downstream_buffer = {
     ngx_conf_deprecated, "proxy_downstream_buffer", "proxy_buffer_size"
 };
@@ -248,6 +274,20 @@ static ngx_command_t  ngx_stream_proxy_commands[] = {
       offsetof(ngx_stream_proxy_srv_conf_t, proxy_protocol),
       NULL },
 
+    { ngx_string("proxy_protocol_version"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      offsetof(ngx_stream_proxy_srv_conf_t, proxy_protocol_version),
+      &ngx_stream_proxy_protocol_version_bounds },
+
+    { ngx_string("proxy_protocol_tlv"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_TAKE2,
+      ngx_stream_proxy_protocol_tlv,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
     { ngx_string("proxy_half_close"),
       NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_FLAG,
       ngx_conf_set_flag_slot,
@@ -255,6 +295,17 @@ static ngx_command_t  ngx_stream_proxy_commands[] = {
       offsetof(ngx_stream_proxy_srv_conf_t, half_close),
       NULL },
 
+#if (NGX_HAVE_SPLICE)
+
+    { ngx_string("proxy_splice"),
+      NGX_STREAM_MAIN_CONF|NGX_STREAM_SRV_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      offsetof(ngx_stream_proxy_srv_conf_t, splice),
+      NULL },
+
+#endif
+
 #if (NGX_STREAM_SSL)
 
     { ngx_string("proxy_ssl"),
@@ -779,6 +830,7 @@ static void
 ngx_stream_proxy_init_upstream(ngx_stream_session_t *s)
 {
     u_char                       *p;
+    ngx_str_t                     header;
     ngx_chain_t                  *cl;
     ngx_connection_t             *c, *pc;
     ngx_log_handler_pt            handler;
@@ -894,22 +946,13 @@ ngx_stream_proxy_init_upstream(ngx_stream_session_t *s)
             return;
         }
 
-        p = ngx_pnalloc(c->pool, NGX_PROXY_PROTOCOL_V1_MAX_HEADER);
-        if (p == NULL) {
-            ngx_stream_proxy_finalize(s, NGX_STREAM_INTERNAL_SERVER_ERROR);
-            return;
-        }
-
-        cl->buf->pos = p;
-
-        p = ngx_proxy_protocol_write(c, p,
-                                     p + NGX_PROXY_PROTOCOL_V1_MAX_HEADER);
-        if (p == NULL) {
+        if (ngx_stream_proxy_protocol_header(s, &header) != NGX_OK) {
             ngx_stream_proxy_finalize(s, NGX_STREAM_INTERNAL_SERVER_ERROR);
             return;
         }
 
-        cl->buf->last = p;
+        cl->buf->pos = header.data;
+        cl->buf->last = header.data + header.len;
         cl->buf->temporary = 1;
         cl->buf->flush = 0;
         cl->buf->last_buf = 0;
@@ -924,6 +967,13 @@ ngx_stream_proxy_init_upstream(ngx_stream_session_t *s)
     u->upload_rate = ngx_stream_complex_value_size(s, pscf->upload_rate, 0);
     u->download_rate = ngx_stream_complex_value_size(s, pscf->download_rate, 0);
 
+#if (NGX_HAVE_SPLICE)
+    if (ngx_stream_proxy_splice_init(s) != NGX_OK) {
+        ngx_stream_proxy_finalize(s, NGX_STREAM_INTERNAL_SERVER_ERROR);
+        return;
+    }
+#endif
+
     u->connected = 1;
 
     pc->read->handler = ngx_stream_proxy_upstream_handler;
@@ -937,26 +987,111 @@ ngx_stream_proxy_init_upstream(ngx_stream_session_t *s)
 }
 
 
+static ngx_int_t
+ngx_stream_proxy_protocol_header(ngx_stream_session_t *s, ngx_str_t *header)
+{
+    u_char                          *p;
+    size_t                           len;
+    ngx_uint_t                       i, n;
+    ngx_connection_t                *c;
+    ngx_stream_proxy_tlv_t          *tlv;
+    ngx_stream_proxy_srv_conf_t     *pscf;
+    ngx_proxy_protocol_tlv_value_t  *values;
+
+    c = s->connection;
+
+    pscf = ngx_stream_get_module_srv_conf(s, ngx_stream_proxy_module);
+
+    if (pscf->proxy_protocol_version == 1) {
+        len = NGX_PROXY_PROTOCOL_V1_MAX_HEADER;
+
+        p = ngx_pnalloc(c->pool, len);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        header->data = p;
+
+        p = ngx_proxy_protocol_write(c, p, p + len);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        header->len = p - header->data;
+
+        return NGX_OK;
+    }
+
+    len = NGX_PROXY_PROTOCOL_V2_MAX_HEADER;
+    values = NULL;
+    n = 0;
+
+    if (pscf->proxy_protocol_tlvs) {
+        tlv = pscf->proxy_protocol_tlvs->elts;
+
+        values = ngx_palloc(c->pool, pscf->proxy_protocol_tlvs->nelts
+                                     * sizeof(ngx_proxy_protocol_tlv_value_t));
+        if (values == NULL) {
+            return NGX_ERROR;
+        }
+
+        for (i = 0; i < pscf->proxy_protocol_tlvs->nelts; i++) {
+            if (ngx_stream_complex_value(s, &tlv[i].value, &values[n].value)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+
+            /* TLVs with empty values are not sent */
+
+            if (values[n].value.len == 0) {
+                continue;
+            }
+
+            values[n].type = tlv[i].type;
+
+            /* type and length */
+            len += 3 + values[n].value.len;
+
+            n++;
+        }
+    }
+
+    p = ngx_pnalloc(c->pool, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    header->data = p;
+
+    p = ngx_proxy_protocol_v2_write(c, p, p + len, values, n);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    header->len = p - header->data;
+
+    return NGX_OK;
+}
+
+
 #if (NGX_STREAM_SSL)
 
 static ngx_int_t
 ngx_stream_proxy_send_proxy_protocol(ngx_stream_session_t *s)
 {
-    u_char                       *p;
     ssize_t                       n, size;
+    ngx_str_t                     header;
     ngx_connection_t             *c, *pc;
     ngx_stream_upstream_t        *u;
     ngx_stream_proxy_srv_conf_t  *pscf;
-    u_char                        buf[NGX_PROXY_PROTOCOL_V1_MAX_HEADER];
 
     c = s->connection;
 
     ngx_log_debug0(NGX_LOG_DEBUG_STREAM, c->log, 0,
                    "stream proxy send PROXY protocol header");
 
-    p = ngx_proxy_protocol_write(c, buf,
-                                 buf + NGX_PROXY_PROTOCOL_V1_MAX_HEADER);
-    if (p == NULL) {
+    if (ngx_stream_proxy_protocol_header(s, &header) != NGX_OK) {
         ngx_stream_proxy_finalize(s, NGX_STREAM_INTERNAL_SERVER_ERROR);
         return NGX_ERROR;
     }
@@ -965,9 +1100,9 @@ ngx_stream_proxy_send_proxy_protocol(ngx_stream_session_t *s)
 
     pc = u->peer.connection;
 
-    size = p - buf;
+    size = header.len;
 
-    n = pc->send(pc, buf, size);
+    n = pc->send(pc, header.data, size);
 
     if (n == NGX_AGAIN) {
         if (ngx_handle_write_event(pc->write, 0) != NGX_OK) {
@@ -1306,7 +1441,7 @@ ngx_stream_proxy_ssl_certificate(ngx_stream_session_t *s)
                    "stream upstream ssl key: \"%s\"", key.data);
 
     if (ngx_ssl_connection_certificate(c, c->pool, &cert, &key,
-                                       pscf->ssl_passwords)
+                                       pscf->ssl_passwords, NULL)
         != NGX_OK)
     {
         return NGX_ERROR;
@@ -1653,7 +1788,9 @@ ngx_stream_proxy_process(ngx_stream_session_t *s, ngx_uint_t from_upstream,
 
         if (do_write && dst) {
 
-            if (*out || *busy || dst->buffered) {
+            if (*out || *busy
+                || (dst->buffered & ~NGX_STREAM_SPLICE_BUFFERED))
+            {
                 c->log->action = send_action;
 
                 rc = ngx_stream_top_filter(s, *out, from_upstream);
@@ -1673,6 +1810,25 @@ ngx_stream_proxy_process(ngx_stream_session_t *s, ngx_uint_t from_upstream,
             }
         }
 
+#if (NGX_HAVE_SPLICE)
+
+        /* the data read into the buffer are sent before splicing */
+
+        if ((from_upstream ? u->upstream_splice : u->downstream_splice)
+            && *out == NULL
+            && *busy == NULL
+            && !(dst->buffered & ~NGX_STREAM_SPLICE_BUFFERED))
+        {
+            if (ngx_stream_proxy_splice(s, from_upstream) != NGX_OK) {
+                ngx_stream_proxy_finalize(s, NGX_STREAM_OK);
+                return;
+            }
+
+            break;
+        }
+
+#endif
+
         size = b->end - b->last;
 
         if (size && src->read->ready && !src->read->delayed) {
@@ -1889,6 +2045,258 @@ ngx_stream_proxy_test_finalize(ngx_stream_session_t *s,
 }
 
 
+
+#if (NGX_HAVE_SPLICE)
+
+static ngx_int_t
+ngx_stream_proxy_splice_init(ngx_stream_session_t *s)
+{
+    ngx_uint_t                     i;
+    ngx_connection_t              *c;
+    ngx_pool_cleanup_t            *cln;
+    ngx_stream_upstream_t         *u;
+    ngx_stream_proxy_srv_conf_t   *pscf;
+    ngx_stream_upstream_splice_t  *sp[2];
+
+    c = s->connection;
+    u = s->upstream;
+
+    pscf = ngx_stream_get_module_srv_conf(s, ngx_stream_proxy_module);
+
+    /*
+     * the data are passed between the sockets via pipes
+     * if they are not changed, that is, no SSL and no filters
+     */
+
+    if (!pscf->splice
+        || u->upstream_splice
+        || c->type != SOCK_STREAM
+        || ngx_stream_top_filter != ngx_stream_write_filter
+#if (NGX_STREAM_SSL)
+        || c->ssl
+        || u->peer.connection->ssl
+#endif
+       )
+    {
+        return NGX_OK;
+    }
+
+    for (i = 0; i < 2; i++) {
+        cln = ngx_pool_cleanup_add(c->pool,
+                                   sizeof(ngx_stream_upstream_splice_t));
+        if (cln == NULL) {
+            return NGX_ERROR;
+        }
+
+        sp[i] = cln->data;
+
+        if (pipe2(sp[i]->fd, O_NONBLOCK|O_CLOEXEC) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, c->log, ngx_errno, "pipe2() failed");
+            return NGX_OK;
+        }
+
+        sp[i]->size = 0;
+
+        cln->handler = ngx_stream_proxy_splice_cleanup;
+    }
+
+    u->upstream_splice = sp[0];
+    u->downstream_splice = sp[1];
+
+    ngx_log_debug4(NGX_LOG_DEBUG_STREAM, c->log, 0,
+                   "stream proxy splice: %d %d, %d %d",
+                   sp[0]->fd[0], sp[0]->fd[1], sp[1]->fd[0], sp[1]->fd[1]);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_proxy_splice(ngx_stream_session_t *s, ngx_uint_t from_upstream)
+{
+    char                          *recv_action, *send_action;
+    off_t                         *received, limit;
+    size_t                         size, limit_rate;
+    ssize_t                        n;
+    ngx_err_t                      err;
+    ngx_msec_t                     delay;
+    ngx_uint_t                    *packets;
+    ngx_connection_t              *c, *src, *dst;
+    ngx_stream_upstream_t         *u;
+    ngx_stream_upstream_splice_t  *sp;
+
+    u = s->upstream;
+    c = s->connection;
+
+    if (from_upstream) {
+        src = u->peer.connection;
+        dst = c;
+        sp = u->upstream_splice;
+        limit_rate = u->download_rate;
+        received = &u->received;
+        packets = &u->responses;
+        recv_action = "proxying and reading from upstream";
+        send_action = "proxying and sending to client";
+
+    } else {
+        src = c;
+        dst = u->peer.connection;
+        sp = u->downstream_splice;
+        limit_rate = u->upload_rate;
+        received = &s->received;
+        packets = &u->requests;
+        recv_action = "proxying and reading from client";
+        send_action = "proxying and sending to upstream";
+    }
+
+    for ( ;; ) {
+
+        if (sp->size && dst->write->ready) {
+            c->log->action = send_action;
+
+            n = splice(sp->fd[0], NULL, dst->fd, NULL, sp->size,
+                       SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+            ngx_log_debug3(NGX_LOG_DEBUG_STREAM, c->log, 0,
+                           "splice to %s: %z of %uz",
+                           from_upstream ? "client" : "upstream",
+                           n, sp->size);
+
+            if (n == -1) {
+                err = ngx_errno;
+
+                if (err == NGX_EAGAIN) {
+                    dst->write->ready = 0;
+
+                } else if (err != NGX_EINTR) {
+                    dst->write->error = 1;
+                    ngx_connection_error(dst, err, "splice() failed");
+                    return NGX_ERROR;
+                }
+
+            } else {
+                sp->size -= n;
+                dst->sent += n;
+            }
+
+            continue;
+        }
+
+        size = NGX_STREAM_UPSTREAM_SPLICE_SIZE - sp->size;
+
+        if (size == 0
+            || !src->read->ready
+            || src->read->delayed
+            || src->read->eof)
+        {
+            break;
+        }
+
+        if (limit_rate) {
+            limit = (off_t) limit_rate * (ngx_time() - u->start_sec + 1)
+                    - *received;
+
+            if (limit <= 0) {
+                src->read->delayed = 1;
+                delay = (ngx_msec_t) (- limit * 1000 / limit_rate + 1);
+                ngx_add_timer(src->read, delay);
+                break;
+            }
+
+            if ((off_t) size > limit) {
+                size = (size_t) limit;
+            }
+        }
+
+        c->log->action = recv_action;
+
+        n = splice(src->fd, NULL, sp->fd[1], NULL, size,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_STREAM, c->log, 0,
+                       "splice from %s: %z of %uz",
+                       from_upstream ? "upstream" : "client", n, size);
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            if (err == NGX_EAGAIN) {
+
+                /* the pipe may be full, the socket is only known to be empty */
+
+                if (sp->size == 0) {
+                    src->read->ready = 0;
+                }
+
+                break;
+            }
+
+            src->read->error = 1;
+            ngx_connection_error(src, err, "splice() failed");
+            n = 0;
+        }
+
+        if (n == 0) {
+            src->read->ready = 0;
+            src->read->eof = 1;
+            continue;
+        }
+
+        if (limit_rate) {
+            delay = (ngx_msec_t) (n * 1000 / limit_rate);
+
+            if (delay > 0) {
+                src->read->delayed = 1;
+                ngx_add_timer(src->read, delay);
+            }
+        }
+
+        if (from_upstream) {
+            if (u->state->first_byte_time == (ngx_msec_t) -1) {
+                u->state->first_byte_time = ngx_current_msec - u->start_time;
+            }
+        }
+
+        (*packets)++;
+        *received += n;
+        sp->size += n;
+    }
+
+    /* data in the pipe are not yet sent */
+
+    if (sp->size) {
+        dst->buffered |= NGX_STREAM_SPLICE_BUFFERED;
+
+    } else {
+        dst->buffered &= ~NGX_STREAM_SPLICE_BUFFERED;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_stream_proxy_splice_cleanup(void *data)
+{
+    ngx_stream_upstream_splice_t  *sp = data;
+
+    if (close(sp->fd[0]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "close() splice pipe failed");
+    }
+
+    if (close(sp->fd[1]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "close() splice pipe failed");
+    }
+}
+
+#endif
+
 static void
 ngx_stream_proxy_next_upstream(ngx_stream_session_t *s)
 {
@@ -2088,9 +2496,14 @@ ngx_stream_proxy_create_srv_conf(ngx_conf_t *cf)
     conf->next_upstream_tries = NGX_CONF_UNSET_UINT;
     conf->next_upstream = NGX_CONF_UNSET;
     conf->proxy_protocol = NGX_CONF_UNSET;
+    conf->proxy_protocol_version = NGX_CONF_UNSET_UINT;
+    conf->proxy_protocol_tlvs = NGX_CONF_UNSET_PTR;
     conf->local = NGX_CONF_UNSET_PTR;
     conf->socket_keepalive = NGX_CONF_UNSET;
     conf->half_close = NGX_CONF_UNSET;
+#if (NGX_HAVE_SPLICE)
+    conf->splice = NGX_CONF_UNSET;
+#endif
 
 #if (NGX_STREAM_SSL)
     conf->ssl_enable = NGX_CONF_UNSET;
@@ -2144,12 +2557,21 @@ ngx_stream_proxy_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_value(conf->proxy_protocol, prev->proxy_protocol, 0);
 
+    ngx_conf_merge_uint_value(conf->proxy_protocol_version,
+                              prev->proxy_protocol_version, 1);
+
+    ngx_conf_merge_ptr_value(conf->proxy_protocol_tlvs,
+                             prev->proxy_protocol_tlvs, NULL);
+
     ngx_conf_merge_ptr_value(conf->local, prev->local, NULL);
 
     ngx_conf_merge_value(conf->socket_keepalive,
                               prev->socket_keepalive, 0);
 
     ngx_conf_merge_value(conf->half_close, prev->half_close, 0);
+#if (NGX_HAVE_SPLICE)
+    ngx_conf_merge_value(conf->splice, prev->splice, 0);
+#endif
 
 #if (NGX_STREAM_SSL)
 
@@ -2505,3 +2927,52 @@ ngx_stream_proxy_bind(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     return NGX_CONF_OK;
 }
+
+
+static char *
+ngx_stream_proxy_protocol_tlv(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_stream_proxy_srv_conf_t *pscf = conf;
+
+    ngx_int_t                            type;
+    ngx_str_t                           *value;
+    ngx_stream_proxy_tlv_t              *tlv;
+    ngx_stream_compile_complex_value_t   ccv;
+
+    value = cf->args->elts;
+
+    type = ngx_proxy_protocol_tlv_type(&value[1]);
+
+    if (type == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid PROXY protocol TLV \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (pscf->proxy_protocol_tlvs == NGX_CONF_UNSET_PTR) {
+        pscf->proxy_protocol_tlvs = ngx_array_create(cf->pool, 4,
+                                               sizeof(ngx_stream_proxy_tlv_t));
+        if (pscf->proxy_protocol_tlvs == NULL) {
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    tlv = ngx_array_push(pscf->proxy_protocol_tlvs);
+    if (tlv == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    tlv->type = type;
+
+    ngx_memzero(&ccv, sizeof(ngx_stream_compile_complex_value_t));
+
+    ccv.cf = cf;
+    ccv.value = &value[2];
+    ccv.complex_value = &tlv->value;
+
+    if (ngx_stream_compile_complex_value(&ccv) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
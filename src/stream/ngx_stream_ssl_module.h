@@ -19,6 +19,9 @@ typedef struct {
 
     ngx_flag_t       prefer_server_ciphers;
     ngx_flag_t       reject_handshake;
+    ngx_flag_t       async;
+    ngx_flag_t       ktls;
+    ngx_flag_t       certificate_compression;
 
     ngx_ssl_t        ssl;
 
@@ -45,6 +48,7 @@ typedef struct {
     ngx_str_t        alpn;
 
     ngx_str_t        ciphers;
+    ngx_str_t        stats;
 
     ngx_array_t     *passwords;
     ngx_array_t     *conf_commands;
@@ -53,15 +57,19 @@ typedef struct {
 
     ngx_flag_t       session_tickets;
     ngx_array_t     *session_ticket_keys;
+    time_t           session_ticket_key_rotation;
 
     ngx_uint_t       ocsp;
     ngx_str_t        ocsp_responder;
     ngx_shm_zone_t  *ocsp_cache_zone;
 
+    ngx_shm_zone_t  *certificate_cache;
+
     ngx_flag_t       stapling;
     ngx_flag_t       stapling_verify;
     ngx_str_t        stapling_file;
     ngx_str_t        stapling_responder;
+    ngx_shm_zone_t  *stapling_cache;
 } ngx_stream_ssl_srv_conf_t;
 
 
@@ -0,0 +1,811 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_stream.h>
+
+
+typedef struct {
+    ngx_uint_t                         prewarm;
+    ngx_msec_t                         interval;
+    ngx_msec_t                         timeout;
+
+    ngx_queue_t                        cache;
+    ngx_queue_t                        connecting;
+    ngx_queue_t                        free;
+
+    ngx_event_t                        event;
+
+    ngx_stream_upstream_srv_conf_t    *upstream;
+
+    ngx_stream_upstream_init_pt        original_init_upstream;
+    ngx_stream_upstream_init_peer_pt   original_init_peer;
+
+} ngx_stream_upstream_prewarm_srv_conf_t;
+
+
+typedef struct {
+    ngx_stream_upstream_prewarm_srv_conf_t  *conf;
+
+    ngx_queue_t                        queue;
+    ngx_connection_t                  *connection;
+
+    socklen_t                          socklen;
+    ngx_sockaddr_t                     sockaddr;
+
+} ngx_stream_upstream_prewarm_cache_t;
+
+
+typedef struct {
+    ngx_stream_upstream_prewarm_srv_conf_t  *conf;
+
+    void                              *data;
+
+    ngx_event_get_peer_pt              original_get_peer;
+    ngx_event_free_peer_pt             original_free_peer;
+    ngx_event_notify_peer_pt           original_notify;
+
+#if (NGX_STREAM_SSL)
+    ngx_event_set_peer_session_pt      original_set_session;
+    ngx_event_save_peer_session_pt     original_save_session;
+#endif
+
+} ngx_stream_upstream_prewarm_peer_data_t;
+
+
+static ngx_int_t ngx_stream_upstream_init_prewarm_peer(
+    ngx_stream_session_t *s, ngx_stream_upstream_srv_conf_t *us);
+static ngx_int_t ngx_stream_upstream_get_prewarm_peer(
+    ngx_peer_connection_t *pc, void *data);
+static void ngx_stream_upstream_free_prewarm_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
+static void ngx_stream_upstream_notify_prewarm_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t type);
+
+static void ngx_stream_upstream_prewarm_handler(ngx_event_t *ev);
+static ngx_int_t ngx_stream_upstream_prewarm_peer(
+    ngx_stream_upstream_prewarm_srv_conf_t *pcf,
+    ngx_stream_upstream_rr_peer_t *peer);
+static void ngx_stream_upstream_prewarm_connected_handler(ngx_event_t *ev);
+static void ngx_stream_upstream_prewarm_dummy_handler(ngx_event_t *ev);
+static void ngx_stream_upstream_prewarm_close_handler(ngx_event_t *ev);
+static void ngx_stream_upstream_prewarm_close(
+    ngx_stream_upstream_prewarm_cache_t *item);
+static ngx_uint_t ngx_stream_upstream_prewarm_count(ngx_queue_t *queue,
+    struct sockaddr *sockaddr, socklen_t socklen);
+
+#if (NGX_STREAM_SSL)
+static ngx_int_t ngx_stream_upstream_prewarm_set_session(
+    ngx_peer_connection_t *pc, void *data);
+static void ngx_stream_upstream_prewarm_save_session(
+    ngx_peer_connection_t *pc, void *data);
+#endif
+
+static void *ngx_stream_upstream_prewarm_create_conf(ngx_conf_t *cf);
+static char *ngx_stream_upstream_prewarm(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_int_t ngx_stream_upstream_prewarm_init_process(ngx_cycle_t *cycle);
+
+
+static ngx_command_t  ngx_stream_upstream_prewarm_commands[] = {
+
+    { ngx_string("prewarm"),
+      NGX_STREAM_UPS_CONF|NGX_CONF_TAKE12,
+      ngx_stream_upstream_prewarm,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("prewarm_timeout"),
+      NGX_STREAM_UPS_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_STREAM_SRV_CONF_OFFSET,
+      offsetof(ngx_stream_upstream_prewarm_srv_conf_t, timeout),
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_stream_module_t  ngx_stream_upstream_prewarm_module_ctx = {
+    NULL,                                    /* preconfiguration */
+    NULL,                                    /* postconfiguration */
+
+    NULL,                                    /* create main configuration */
+    NULL,                                    /* init main configuration */
+
+    ngx_stream_upstream_prewarm_create_conf, /* create server configuration */
+    NULL                                     /* merge server configuration */
+};
+
+
+ngx_module_t  ngx_stream_upstream_prewarm_module = {
+    NGX_MODULE_V1,
+    &ngx_stream_upstream_prewarm_module_ctx, /* module context */
+    ngx_stream_upstream_prewarm_commands,    /* module directives */
+    NGX_STREAM_MODULE,                       /* module type */
+    NULL,                                    /* init master */
+    NULL,                                    /* init module */
+    ngx_stream_upstream_prewarm_init_process, /* init process */
+    NULL,                                    /* init thread */
+    NULL,                                    /* exit thread */
+    NULL,                                    /* exit process */
+    NULL,                                    /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_int_t
+ngx_stream_upstream_init_prewarm(ngx_conf_t *cf,
+    ngx_stream_upstream_srv_conf_t *us)
+{
+    ngx_uint_t                               i, n;
+    ngx_stream_upstream_rr_peers_t          *peers;
+    ngx_stream_upstream_prewarm_cache_t     *cached;
+    ngx_stream_upstream_prewarm_srv_conf_t  *pcf;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_STREAM, cf->log, 0,
+                   "init prewarm");
+
+    pcf = ngx_stream_conf_upstream_srv_conf(us,
+                                           ngx_stream_upstream_prewarm_module);
+
+    ngx_conf_init_msec_value(pcf->timeout, 60000);
+
+    if (pcf->original_init_upstream(cf, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    pcf->upstream = us;
+
+    pcf->original_init_peer = us->peer.init;
+
+    us->peer.init = ngx_stream_upstream_init_prewarm_peer;
+
+    /* allocate cache items for each server and add to free queue */
+
+    peers = us->peer.data;
+
+    n = pcf->prewarm * ngx_max(peers->number, 1);
+
+    cached = ngx_pcalloc(cf->pool,
+                         sizeof(ngx_stream_upstream_prewarm_cache_t) * n);
+    if (cached == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_queue_init(&pcf->cache);
+    ngx_queue_init(&pcf->connecting);
+    ngx_queue_init(&pcf->free);
+
+    for (i = 0; i < n; i++) {
+        ngx_queue_insert_head(&pcf->free, &cached[i].queue);
+        cached[i].conf = pcf;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_upstream_init_prewarm_peer(ngx_stream_session_t *s,
+    ngx_stream_upstream_srv_conf_t *us)
+{
+    ngx_stream_upstream_t                    *u;
+    ngx_stream_upstream_prewarm_peer_data_t  *pp;
+    ngx_stream_upstream_prewarm_srv_conf_t   *pcf;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_STREAM, s->connection->log, 0,
+                   "init prewarm peer");
+
+    pcf = ngx_stream_conf_upstream_srv_conf(us,
+                                           ngx_stream_upstream_prewarm_module);
+
+    pp = ngx_palloc(s->connection->pool,
+                    sizeof(ngx_stream_upstream_prewarm_peer_data_t));
+    if (pp == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (pcf->original_init_peer(s, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    u = s->upstream;
+
+    pp->conf = pcf;
+    pp->data = u->peer.data;
+    pp->original_get_peer = u->peer.get;
+    pp->original_free_peer = u->peer.free;
+    pp->original_notify = u->peer.notify;
+
+    u->peer.data = pp;
+    u->peer.get = ngx_stream_upstream_get_prewarm_peer;
+    u->peer.free = ngx_stream_upstream_free_prewarm_peer;
+    u->peer.notify = pp->original_notify
+                     ? ngx_stream_upstream_notify_prewarm_peer : NULL;
+
+#if (NGX_STREAM_SSL)
+    pp->original_set_session = u->peer.set_session;
+    pp->original_save_session = u->peer.save_session;
+    u->peer.set_session = ngx_stream_upstream_prewarm_set_session;
+    u->peer.save_session = ngx_stream_upstream_prewarm_save_session;
+#endif
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_upstream_get_prewarm_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_stream_upstream_prewarm_peer_data_t  *pp = data;
+
+    ngx_int_t                             rc;
+    ngx_queue_t                          *q, *cache;
+    ngx_connection_t                     *c;
+    ngx_stream_upstream_prewarm_cache_t  *item;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_STREAM, pc->log, 0,
+                   "get prewarm peer");
+
+    /* ask balancer */
+
+    rc = pp->original_get_peer(pc, pp->data);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    /* prewarmed connections are not bound to a local address */
+
+    if (pc->type == SOCK_DGRAM || pc->local) {
+        return NGX_OK;
+    }
+
+    /* search cache for a connection to the selected server */
+
+    cache = &pp->conf->cache;
+
+    for (q = ngx_queue_head(cache);
+         q != ngx_queue_sentinel(cache);
+         q = ngx_queue_next(q))
+    {
+        item = ngx_queue_data(q, ngx_stream_upstream_prewarm_cache_t, queue);
+
+        if (ngx_memn2cmp((u_char *) &item->sockaddr, (u_char *) pc->sockaddr,
+                         item->socklen, pc->socklen)
+            == 0)
+        {
+            goto found;
+        }
+    }
+
+    return NGX_OK;
+
+found:
+
+    ngx_queue_remove(q);
+    ngx_queue_insert_head(&pp->conf->free, q);
+
+    c = item->connection;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_STREAM, pc->log, 0,
+                   "get prewarm peer: using connection %p", c);
+
+    c->idle = 0;
+    c->data = NULL;
+    c->log = pc->log;
+    c->read->log = pc->log;
+    c->write->log = pc->log;
+
+    if (c->read->timer_set) {
+        ngx_del_timer(c->read);
+    }
+
+    pc->connection = c;
+    pc->cached = 1;
+
+    /* replace the connection taken */
+
+    if (!pp->conf->event.posted && pp->conf->event.handler) {
+        ngx_post_event(&pp->conf->event, &ngx_posted_events);
+    }
+
+    return NGX_DONE;
+}
+
+
+static void
+ngx_stream_upstream_free_prewarm_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
+{
+    ngx_stream_upstream_prewarm_peer_data_t  *pp = data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_STREAM, pc->log, 0,
+                   "free prewarm peer");
+
+    pp->original_free_peer(pc, pp->data, state);
+}
+
+
+static void
+ngx_stream_upstream_notify_prewarm_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t type)
+{
+    ngx_stream_upstream_prewarm_peer_data_t  *pp = data;
+
+    pp->original_notify(pc, pp->data, type);
+}
+
+
+static void
+ngx_stream_upstream_prewarm_handler(ngx_event_t *ev)
+{
+    ngx_stream_upstream_prewarm_srv_conf_t  *pcf;
+
+    time_t                           now;
+    ngx_stream_upstream_rr_peer_t   *peer;
+    ngx_stream_upstream_rr_peers_t  *peers;
+
+    pcf = ev->data;
+
+    if (ngx_exiting || ngx_terminate) {
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_STREAM, ev->log, 0,
+                   "prewarm \"%V\"", &pcf->upstream->host);
+
+    now = ngx_time();
+    peers = pcf->upstream->peer.data;
+
+    ngx_stream_upstream_rr_peers_rlock(peers);
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+
+        if (peer->down) {
+            continue;
+        }
+
+        if (peer->max_fails
+            && peer->fails >= peer->max_fails
+            && now - peer->checked <= peer->fail_timeout)
+        {
+            continue;
+        }
+
+        if (ngx_stream_upstream_prewarm_peer(pcf, peer) != NGX_OK) {
+            break;
+        }
+    }
+
+    ngx_stream_upstream_rr_peers_unlock(peers);
+
+    ngx_add_timer(ev, pcf->interval);
+}
+
+
+static ngx_int_t
+ngx_stream_upstream_prewarm_peer(ngx_stream_upstream_prewarm_srv_conf_t *pcf,
+    ngx_stream_upstream_rr_peer_t *peer)
+{
+    ngx_int_t                             rc;
+    ngx_uint_t                            n;
+    ngx_queue_t                          *q;
+    ngx_connection_t                     *c;
+    ngx_peer_connection_t                 pc;
+    ngx_stream_upstream_prewarm_cache_t  *item;
+
+    if (peer->socklen > sizeof(ngx_sockaddr_t)) {
+        return NGX_OK;
+    }
+
+    n = ngx_stream_upstream_prewarm_count(&pcf->cache, peer->sockaddr,
+                                          peer->socklen)
+        + ngx_stream_upstream_prewarm_count(&pcf->connecting, peer->sockaddr,
+                                            peer->socklen);
+
+    while (n++ < pcf->prewarm) {
+
+        if (ngx_queue_empty(&pcf->free)) {
+            return NGX_DECLINED;
+        }
+
+        ngx_memzero(&pc, sizeof(ngx_peer_connection_t));
+
+        pc.sockaddr = peer->sockaddr;
+        pc.socklen = peer->socklen;
+        pc.name = &peer->name;
+        pc.get = ngx_event_get_peer;
+        pc.log = ngx_cycle->log;
+        pc.log_error = NGX_ERROR_ERR;
+
+        rc = ngx_event_connect_peer(&pc);
+
+        if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
+            return NGX_OK;
+        }
+
+        c = pc.connection;
+
+        ngx_log_debug2(NGX_LOG_DEBUG_STREAM, ngx_cycle->log, 0,
+                       "prewarm %V: connection %p", &peer->name, c);
+
+        q = ngx_queue_head(&pcf->free);
+        ngx_queue_remove(q);
+        ngx_queue_insert_head(&pcf->connecting, q);
+
+        item = ngx_queue_data(q, ngx_stream_upstream_prewarm_cache_t, queue);
+
+        item->connection = c;
+        item->socklen = peer->socklen;
+        ngx_memcpy(&item->sockaddr, peer->sockaddr, peer->socklen);
+
+        c->data = item;
+        c->idle = 1;
+
+        c->read->handler = ngx_stream_upstream_prewarm_connected_handler;
+        c->write->handler = ngx_stream_upstream_prewarm_connected_handler;
+
+        if (rc == NGX_OK) {
+            ngx_stream_upstream_prewarm_connected_handler(c->write);
+            continue;
+        }
+
+        /* rc == NGX_AGAIN */
+
+        ngx_add_timer(c->write, pcf->timeout);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_stream_upstream_prewarm_connected_handler(ngx_event_t *ev)
+{
+    int                                   err;
+    socklen_t                             len;
+    ngx_connection_t                     *c;
+    ngx_stream_upstream_prewarm_cache_t  *item;
+
+    c = ev->data;
+    item = c->data;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_STREAM, ev->log, 0,
+                   "prewarm connected handler, timedout:%d", ev->timedout);
+
+    if (c->close) {
+        goto close;
+    }
+
+    if (ev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "prewarm connect() timed out");
+        goto close;
+    }
+
+#if (NGX_HAVE_KQUEUE)
+
+    if (ngx_event_flags & NGX_USE_KQUEUE_EVENT) {
+        if (c->write->pending_eof || c->read->pending_eof) {
+            err = c->write->pending_eof ? c->write->kq_errno
+                                        : c->read->kq_errno;
+
+            ngx_log_error(NGX_LOG_ERR, c->log, err,
+                          "kevent() reported that prewarm connect() failed");
+            goto close;
+        }
+
+    } else
+#endif
+    {
+        err = 0;
+        len = sizeof(int);
+
+        if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, (void *) &err, &len)
+            == -1)
+        {
+            err = ngx_socket_errno;
+        }
+
+        if (err) {
+            ngx_log_error(NGX_LOG_ERR, c->log, err,
+                          "prewarm connect() failed");
+            goto close;
+        }
+    }
+
+    if (c->write->timer_set) {
+        ngx_del_timer(c->write);
+    }
+
+    c->write->handler = ngx_stream_upstream_prewarm_dummy_handler;
+    c->read->handler = ngx_stream_upstream_prewarm_close_handler;
+
+    if (ngx_handle_write_event(c->write, 0) != NGX_OK
+        || ngx_handle_read_event(c->read, 0) != NGX_OK)
+    {
+        goto close;
+    }
+
+    ngx_queue_remove(&item->queue);
+    ngx_queue_insert_head(&item->conf->cache, &item->queue);
+
+    ngx_add_timer(c->read, item->conf->timeout);
+
+    if (c->read->ready) {
+        ngx_stream_upstream_prewarm_close_handler(c->read);
+    }
+
+    return;
+
+close:
+
+    ngx_stream_upstream_prewarm_close(item);
+}
+
+
+static void
+ngx_stream_upstream_prewarm_dummy_handler(ngx_event_t *ev)
+{
+    ngx_log_debug0(NGX_LOG_DEBUG_STREAM, ev->log, 0,
+                   "prewarm dummy handler");
+}
+
+
+static void
+ngx_stream_upstream_prewarm_close_handler(ngx_event_t *ev)
+{
+    int                n;
+    char               buf[1];
+    ngx_connection_t  *c;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_STREAM, ev->log, 0,
+                   "prewarm close handler");
+
+    c = ev->data;
+
+    if (c->close || c->read->timedout) {
+        goto close;
+    }
+
+    n = recv(c->fd, buf, 1, MSG_PEEK);
+
+    if (n == -1 && ngx_socket_errno == NGX_EAGAIN) {
+        ev->ready = 0;
+
+        if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+            goto close;
+        }
+
+        return;
+    }
+
+    if (n > 0) {
+
+        /*
+         * the server speaks first, the data is left in the socket
+         * to be passed to the client
+         */
+
+        if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+            goto close;
+        }
+
+        return;
+    }
+
+close:
+
+    ngx_stream_upstream_prewarm_close(c->data);
+}
+
+
+static void
+ngx_stream_upstream_prewarm_close(ngx_stream_upstream_prewarm_cache_t *item)
+{
+    ngx_close_connection(item->connection);
+
+    item->connection = NULL;
+
+    ngx_queue_remove(&item->queue);
+    ngx_queue_insert_head(&item->conf->free, &item->queue);
+}
+
+
+static ngx_uint_t
+ngx_stream_upstream_prewarm_count(ngx_queue_t *queue,
+    struct sockaddr *sockaddr, socklen_t socklen)
+{
+    ngx_uint_t                            n;
+    ngx_queue_t                          *q;
+    ngx_stream_upstream_prewarm_cache_t  *item;
+
+    n = 0;
+
+    for (q = ngx_queue_head(queue);
+         q != ngx_queue_sentinel(queue);
+         q = ngx_queue_next(q))
+    {
+        item = ngx_queue_data(q, ngx_stream_upstream_prewarm_cache_t, queue);
+
+        if (ngx_memn2cmp((u_char *) &item->sockaddr, (u_char *) sockaddr,
+                         item->socklen, socklen)
+            == 0)
+        {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+
+#if (NGX_STREAM_SSL)
+
+static ngx_int_t
+ngx_stream_upstream_prewarm_set_session(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_stream_upstream_prewarm_peer_data_t  *pp = data;
+
+    return pp->original_set_session(pc, pp->data);
+}
+
+
+static void
+ngx_stream_upstream_prewarm_save_session(ngx_peer_connection_t *pc,
+    void *data)
+{
+    ngx_stream_upstream_prewarm_peer_data_t  *pp = data;
+
+    pp->original_save_session(pc, pp->data);
+}
+
+#endif
+
+
+static void *
+ngx_stream_upstream_prewarm_create_conf(ngx_conf_t *cf)
+{
+    ngx_stream_upstream_prewarm_srv_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool,
+                       sizeof(ngx_stream_upstream_prewarm_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     conf->original_init_upstream = NULL;
+     *     conf->original_init_peer = NULL;
+     *     conf->prewarm = 0;
+     *     conf->upstream = NULL;
+     */
+
+    conf->interval = 1000;
+    conf->timeout = NGX_CONF_UNSET_MSEC;
+
+    return conf;
+}
+
+
+static char *
+ngx_stream_upstream_prewarm(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_stream_upstream_prewarm_srv_conf_t  *pcf = conf;
+
+    ngx_int_t                        n;
+    ngx_str_t                       *value, s;
+    ngx_msec_t                       interval;
+    ngx_stream_upstream_srv_conf_t  *uscf;
+
+    if (pcf->prewarm) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    n = ngx_atoi(value[1].data, value[1].len);
+
+    if (n == NGX_ERROR || n == 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid value \"%V\" in \"%V\" directive",
+                           &value[1], &cmd->name);
+        return NGX_CONF_ERROR;
+    }
+
+    pcf->prewarm = n;
+
+    if (cf->args->nelts == 3) {
+
+        if (ngx_strncmp(value[2].data, "interval=", 9) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        s.len = value[2].len - 9;
+        s.data = value[2].data + 9;
+
+        interval = ngx_parse_time(&s, 0);
+
+        if (interval == (ngx_msec_t) NGX_ERROR || interval == 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid interval \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        pcf->interval = interval;
+    }
+
+    /* init upstream handler */
+
+    uscf = ngx_stream_conf_get_module_srv_conf(cf, ngx_stream_upstream_module);
+
+    pcf->original_init_upstream = uscf->peer.init_upstream
+                                  ? uscf->peer.init_upstream
+                                  : ngx_stream_upstream_init_round_robin;
+
+    uscf->peer.init_upstream = ngx_stream_upstream_init_prewarm;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_stream_upstream_prewarm_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                                i;
+    ngx_event_t                              *ev;
+    ngx_stream_upstream_srv_conf_t          **uscfp;
+    ngx_stream_upstream_main_conf_t          *umcf;
+    ngx_stream_upstream_prewarm_srv_conf_t   *pcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    umcf = ngx_stream_cycle_get_module_main_conf(cycle,
+                                                 ngx_stream_upstream_module);
+
+    if (umcf == NULL) {
+        return NGX_OK;
+    }
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        pcf = ngx_stream_conf_upstream_srv_conf(uscfp[i],
+                                           ngx_stream_upstream_prewarm_module);
+
+        if (pcf->upstream == NULL) {
+            continue;
+        }
+
+        ev = &pcf->event;
+
+        ev->handler = ngx_stream_upstream_prewarm_handler;
+        ev->data = pcf;
+        ev->log = cycle->log;
+        ev->cancelable = 1;
+
+        ngx_add_timer(ev, 0);
+    }
+
+    return NGX_OK;
+}
@@ -676,6 +676,53 @@ ngx_stream_upstream_free_round_robin_peer(ngx_peer_connection_t *pc, void *data,
 }
 
 
+void
+ngx_stream_upstream_update_round_robin_latency(ngx_peer_connection_t *pc,
+    ngx_stream_upstream_rr_peer_data_t *rrp, ngx_stream_upstream_t *u,
+    ngx_uint_t mode, ngx_uint_t state)
+{
+    ngx_int_t                       delta;
+    ngx_msec_t                      time;
+    ngx_stream_upstream_rr_peer_t  *peer;
+
+    if ((state & NGX_PEER_FAILED) || u->state == NULL) {
+        return;
+    }
+
+    if (mode & NGX_STREAM_UPSTREAM_LATENCY_LAST_BYTE) {
+        time = u->state->response_time;
+
+    } else if (mode & NGX_STREAM_UPSTREAM_LATENCY_FIRST_BYTE) {
+        time = u->state->first_byte_time;
+
+    } else {
+        time = u->state->connect_time;
+    }
+
+    if (time == (ngx_msec_t) -1) {
+        return;
+    }
+
+    peer = rrp->current;
+
+    ngx_stream_upstream_rr_peers_rlock(rrp->peers);
+    ngx_stream_upstream_rr_peer_lock(rrp->peers, peer);
+
+    delta = (ngx_int_t) (time << NGX_STREAM_UPSTREAM_LATENCY_SHIFT)
+            - (ngx_int_t) peer->latency;
+
+    peer->latency += delta / (1 << NGX_STREAM_UPSTREAM_LATENCY_DECAY);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_STREAM, pc->log, 0,
+                   "rr peer %V time:%M latency:%M",
+                   &peer->name, time,
+                   peer->latency >> NGX_STREAM_UPSTREAM_LATENCY_SHIFT);
+
+    ngx_stream_upstream_rr_peer_unlock(rrp->peers, peer);
+    ngx_stream_upstream_rr_peers_unlock(rrp->peers);
+}
+
+
 static void
 ngx_stream_upstream_notify_round_robin_peer(ngx_peer_connection_t *pc,
     void *data, ngx_uint_t type)
@@ -40,6 +40,8 @@ struct ngx_stream_upstream_rr_peer_s {
 
     ngx_uint_t                       down;
 
+    ngx_msec_t                       latency;
+
     void                            *ssl_session;
     int                              ssl_session_len;
 
@@ -123,6 +125,20 @@ struct ngx_stream_upstream_rr_peers_s {
 #endif
 
 
+/*
+ * peer->latency is an exponentially weighted moving average of
+ * the connect, first byte or session time in 1/16 of millisecond,
+ * with the weight of 1/8 for a new sample
+ */
+
+#define NGX_STREAM_UPSTREAM_LATENCY_SHIFT       4
+#define NGX_STREAM_UPSTREAM_LATENCY_DECAY       3
+
+#define NGX_STREAM_UPSTREAM_LATENCY_CONNECT     0x01
+#define NGX_STREAM_UPSTREAM_LATENCY_FIRST_BYTE  0x02
+#define NGX_STREAM_UPSTREAM_LATENCY_LAST_BYTE   0x04
+
+
 typedef struct {
     ngx_uint_t                       config;
     ngx_stream_upstream_rr_peers_t  *peers;
@@ -142,6 +158,9 @@ ngx_int_t ngx_stream_upstream_get_round_robin_peer(ngx_peer_connection_t *pc,
     void *data);
 void ngx_stream_upstream_free_round_robin_peer(ngx_peer_connection_t *pc,
     void *data, ngx_uint_t state);
+void ngx_stream_upstream_update_round_robin_latency(ngx_peer_connection_t *pc,
+    ngx_stream_upstream_rr_peer_data_t *rrp, ngx_stream_upstream_t *u,
+    ngx_uint_t mode, ngx_uint_t state);
 
 
 #endif /* _NGX_STREAM_UPSTREAM_ROUND_ROBIN_H_INCLUDED_ */
@@ -18,6 +18,13 @@ static ngx_stream_upstream_rr_peers_t *ngx_stream_upstream_zone_copy_peers(
     ngx_slab_pool_t *shpool, ngx_stream_upstream_srv_conf_t *uscf);
 static ngx_stream_upstream_rr_peer_t *ngx_stream_upstream_zone_copy_peer(
     ngx_stream_upstream_rr_peers_t *peers, ngx_stream_upstream_rr_peer_t *src);
+#if (NGX_STREAM_SSL)
+static ngx_int_t ngx_stream_upstream_zone_copy_sessions(
+    ngx_shm_zone_t *shm_zone, ngx_shm_zone_t *oshm_zone);
+static void ngx_stream_upstream_zone_copy_peer_sessions(
+    ngx_stream_upstream_rr_peers_t *peers,
+    ngx_stream_upstream_rr_peers_t *opeers);
+#endif
 
 
 static ngx_command_t  ngx_stream_upstream_zone_commands[] = {
@@ -110,6 +117,10 @@ ngx_stream_upstream_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     uscf->shm_zone->noreuse = 1;
 
+#if (NGX_STREAM_SSL)
+    uscf->shm_zone->resize = ngx_stream_upstream_zone_copy_sessions;
+#endif
+
     return NGX_CONF_OK;
 }
 
@@ -320,3 +331,95 @@ failed:
 
     return NULL;
 }
+
+
+#if (NGX_STREAM_SSL)
+
+static ngx_int_t
+ngx_stream_upstream_zone_copy_sessions(ngx_shm_zone_t *shm_zone,
+    ngx_shm_zone_t *oshm_zone)
+{
+    ngx_slab_pool_t                 *shpool, *oshpool;
+    ngx_stream_upstream_rr_peers_t  *peers, *opeers;
+
+    /*
+     * the zone is not reused on reload, so the upstream SSL sessions
+     * saved by the old worker processes are copied to the new zone
+     */
+
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+    oshpool = (ngx_slab_pool_t *) oshm_zone->shm.addr;
+
+    for (peers = shpool->data; peers; peers = peers->zone_next) {
+
+        for (opeers = oshpool->data; opeers; opeers = opeers->zone_next) {
+            if (ngx_memn2cmp(peers->name->data, opeers->name->data,
+                             peers->name->len, opeers->name->len)
+                == 0)
+            {
+                break;
+            }
+        }
+
+        if (opeers == NULL) {
+            continue;
+        }
+
+        ngx_stream_upstream_zone_copy_peer_sessions(peers, opeers);
+
+        if (peers->next && opeers->next) {
+            ngx_stream_upstream_zone_copy_peer_sessions(peers->next,
+                                                          opeers->next);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_stream_upstream_zone_copy_peer_sessions(
+    ngx_stream_upstream_rr_peers_t *peers, ngx_stream_upstream_rr_peers_t *opeers)
+{
+    ngx_stream_upstream_rr_peer_t  *peer, *opeer;
+
+    ngx_stream_upstream_rr_peers_rlock(opeers);
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+
+        for (opeer = opeers->peer; opeer; opeer = opeer->next) {
+            if (ngx_memn2cmp(peer->name.data, opeer->name.data,
+                             peer->name.len, opeer->name.len)
+                == 0
+                && ngx_memn2cmp(peer->server.data, opeer->server.data,
+                                peer->server.len, opeer->server.len)
+                   == 0)
+            {
+                break;
+            }
+        }
+
+        if (opeer == NULL) {
+            continue;
+        }
+
+        ngx_stream_upstream_rr_peer_lock(opeers, opeer);
+
+        if (opeer->ssl_session) {
+            peer->ssl_session = ngx_slab_alloc(peers->shpool,
+                                               opeer->ssl_session_len);
+
+            if (peer->ssl_session) {
+                ngx_memcpy(peer->ssl_session, opeer->ssl_session,
+                           opeer->ssl_session_len);
+                peer->ssl_session_len = opeer->ssl_session_len;
+            }
+        }
+
+        ngx_stream_upstream_rr_peer_unlock(opeers, opeer);
+    }
+
+    ngx_stream_upstream_rr_peers_unlock(opeers);
+}
+
+#endif